@@ -0,0 +1,143 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Runs the cross-language workload benchmarks and prints comparable results.
+
+Every language reports the time of one iteration of a workload, i.e. building
+the aggregation, adding all entries and computing the result, or adding noise
+to all entries. This script converts the reports to nanoseconds per entry and
+prints one CSV row per language, workload and input size.
+
+Usage, from the root of the repository:
+
+  python3 benchmarks/run_workloads.py --languages=cc,go,java > results.csv
+
+Results saved earlier can be converted instead of running the benchmarks, e.g.
+--input=go=go_output.txt. C++ results must be in the JSON format of Google
+Benchmark, Go and Java results in the text format of Go benchmarks.
+"""
+
+import argparse
+import csv
+import json
+import os
+import re
+import subprocess
+import sys
+
+_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# Commands that run the workloads of every language, and the directory of the
+# workspace they run in.
+_COMMANDS = {
+    'cc': ('cc', [
+        'bazel', 'run', '-c', 'opt', '//algorithms:workload_benchmark_test',
+        '--', '--benchmark_format=json'
+    ]),
+    'go': ('go', [
+        'go', 'test', '-run=^$', '-bench=^BenchmarkWorkload$', './dpagg'
+    ]),
+    'java': ('java', [
+        'bazel', 'run', '-c', 'opt',
+        '//tests/com/google/privacy/differentialprivacy/benchmarks:'
+        'workload_benchmark'
+    ]),
+}
+
+# Matches lines like "BenchmarkWorkload/Count/1024-8  1000  1234.5 ns/op".
+_GO_LINE = re.compile(
+    r'^BenchmarkWorkload/(\w+)/(\d+)(?:-\d+)?\s+\d+\s+([\d.]+) ns/op')
+
+
+def parse_google_benchmark(output):
+  """Yields (workload, size, ns_per_op) from Google Benchmark JSON output."""
+  units = {'ns': 1, 'us': 1e3, 'ms': 1e6, 's': 1e9}
+  for benchmark in json.loads(output)['benchmarks']:
+    if benchmark.get('run_type', 'iteration') != 'iteration':
+      continue
+    # Names look like "BM_Workload/Count/1024".
+    _, workload, size = benchmark['name'].split('/')
+    yield (workload, int(size),
+           benchmark['real_time'] * units[benchmark['time_unit']])
+
+
+def parse_go_benchmark(output):
+  """Yields (workload, size, ns_per_op) from Go benchmark text output."""
+  for line in output.splitlines():
+    match = _GO_LINE.match(line.strip())
+    if match:
+      yield match.group(1), int(match.group(2)), float(match.group(3))
+
+
+_PARSERS = {
+    'cc': parse_google_benchmark,
+    'go': parse_go_benchmark,
+    'java': parse_go_benchmark,
+}
+
+
+def run(language):
+  directory, command = _COMMANDS[language]
+  return subprocess.run(
+      command,
+      cwd=os.path.join(_ROOT, directory),
+      check=True,
+      stdout=subprocess.PIPE,
+      text=True).stdout
+
+
+def main(argv):
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+  parser.add_argument(
+      '--languages',
+      help=('Comma separated languages to run, out of cc, go and java. '
+            'Defaults to all languages, unless --input is set.'))
+  parser.add_argument(
+      '--input',
+      action='append',
+      default=[],
+      metavar='LANGUAGE=FILE',
+      help='Reads the output of a language from FILE instead of running it.')
+  args = parser.parse_args(argv)
+
+  if args.languages is None:
+    args.languages = '' if args.input else ','.join(_COMMANDS)
+  outputs = {}
+  for language in filter(None, args.languages.split(',')):
+    if language not in _COMMANDS:
+      parser.error(f'Unknown language: {language}')
+    outputs[language] = None
+  for value in args.input:
+    language, _, path = value.partition('=')
+    if language not in _COMMANDS:
+      parser.error(f'Unknown language: {language}')
+    with open(path) as f:
+      outputs[language] = f.read()
+
+  writer = csv.writer(sys.stdout)
+  writer.writerow(
+      ['language', 'workload', 'size', 'ns_per_op', 'ns_per_entry',
+       'entries_per_second'])
+  for language, output in outputs.items():
+    if output is None:
+      output = run(language)
+    for workload, size, ns_per_op in _PARSERS[language](output):
+      ns_per_entry = ns_per_op / size
+      writer.writerow([
+          language, workload, size, f'{ns_per_op:.1f}', f'{ns_per_entry:.3f}',
+          f'{1e9 / ns_per_entry:.0f}'
+      ])
+
+
+if __name__ == '__main__':
+  main(sys.argv[1:])
@@ -13,34 +13,98 @@
 // limitations under the License.
 #include "accounting/accountant.h"
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
-#include "boost/math/special_functions/binomial.hpp"
+#include "absl/types/span.h"
 #include "accounting/common/common.h"
 #include "accounting/privacy_loss_distribution.h"
+#include "accounting/rdp_accountant.h"
+#include "base/instrumentation.h"
+#include "base/status_macros.h"
 
 namespace differential_privacy {
 namespace accounting {
 
+namespace {
+
+// Evaluates func at all points, running all but the first one on their own
+// threads.
+std::vector<absl::StatusOr<double>> EvaluateInParallel(
+    const std::function<absl::StatusOr<double>(double)>& func,
+    const std::vector<double>& points) {
+  std::vector<absl::StatusOr<double>> values(points.size());
+  std::vector<std::thread> threads;
+  threads.reserve(points.size());
+  for (int i = 1; i < points.size(); ++i) {
+    threads.emplace_back(
+        [&func, &points, &values, i]() { values[i] = func(points[i]); });
+  }
+  if (!points.empty()) {
+    values[0] = func(points[0]);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return values;
+}
+
+// Returns the smallest parameter for which the RDP accountant considers the
+// composition (epsilon, delta)-DP, or nullopt when RDP accounting does not
+// apply. Since RDP accounting is looser than PLD accounting, this is an upper
+// bound on the parameter found with PLDs.
+std::optional<double> GetRdpParameter(EpsilonDelta epsilon_delta,
+                                      int num_queries, double sensitivity,
+                                      const NoiseFunction& noise_function,
+                                      double upper_bound, double tolerance) {
+  if (epsilon_delta.delta <= 0) {
+    return std::nullopt;
+  }
+  auto compute_epsilon = [&](double parameter) -> absl::StatusOr<double> {
+    ASSIGN_OR_RETURN(std::unique_ptr<RdpAccountant> accountant,
+                     RdpAccountant::Create());
+    RETURN_IF_ERROR(accountant->Compose(*noise_function(parameter, sensitivity),
+                                        num_queries));
+    return accountant->GetEpsilonForDelta(epsilon_delta.delta);
+  };
+  absl::StatusOr<double> parameter = InverseMonotoneFunction(
+      compute_epsilon, epsilon_delta.epsilon,
+      {.lower_bound = 0,
+       .upper_bound = upper_bound,
+       .initial_guess = std::nullopt,
+       .tolerance = tolerance,
+       .interpolate = true});
+  if (!parameter.ok()) {
+    return std::nullopt;
+  }
+  return *parameter;
+}
+
+}  // namespace
+
 absl::StatusOr<double> GetSmallestParameter(EpsilonDelta epsilon_delta,
                                             int num_queries, double sensitivity,
                                             NoiseFunction noise_function,
                                             std::optional<double> upper_bound,
-                                            double tolerance) {
-  BinarySearchParameters search_parameters = {
-      .lower_bound = 0,
-      .upper_bound = upper_bound.has_value() ? upper_bound.value()
-                                             : 2 * num_queries * sensitivity /
-                                                   epsilon_delta.epsilon,
-      .initial_guess = std::nullopt,
-      .tolerance = tolerance};
-
-  auto compute_delta = [noise_function, sensitivity, num_queries,
-                        epsilon_delta](double parameter) {
+                                            double tolerance, int num_threads) {
+  instrumentation::ScopedEvent event(
+      instrumentation::Event::kAccountantSearch);
+  if (num_threads <= 0) {
+    num_threads = std::clamp<int>(std::thread::hardware_concurrency(), 1, 8);
+  }
+
+  std::function<absl::StatusOr<double>(double)> compute_delta =
+      [noise_function, sensitivity, num_queries,
+       epsilon_delta](double parameter) -> absl::StatusOr<double> {
     std::unique_ptr<PrivacyLossDistribution> pld =
         PrivacyLossDistribution::CreateForAdditiveNoise(
             *noise_function(parameter, sensitivity), EstimateType::kPessimistic,
@@ -50,27 +114,132 @@ absl::StatusOr<double> GetSmallestParameter(EpsilonDelta epsilon_delta,
     return pld->GetDeltaForEpsilon(epsilon_delta.epsilon);
   };
 
-  return InverseMonotoneFunction(compute_delta, epsilon_delta.delta,
-                                 search_parameters);
-}
+  double lower_x = 0;
+  double upper_x = upper_bound.has_value()
+                       ? upper_bound.value()
+                       : 2 * num_queries * sensitivity / epsilon_delta.epsilon;
 
-absl::StatusOr<double> AdvancedComposition(
-    const EpsilonDelta privacy_parameters, const int num_queries,
-    const double total_delta) {
-  double epsilon = privacy_parameters.epsilon;
-  double delta = privacy_parameters.delta;
-  int k = num_queries;
-
-  // The calculation follows Theorem 3.3 of https://arxiv.org/pdf/1311.0776.pdf.
-  for (int i = k / 2; i >= 0; --i) {
-    double delta_i = 0;
-    for (int l = 0; l < i; l++) {
-      delta_i +=
-          boost::math::binomial_coefficient<double>(k, l) *
-          (std::exp(epsilon * (k - l)) - std::exp(epsilon * (k - 2 * i + l)));
+  // Warm start: the RDP parameter bounds the solution from above and is
+  // usually within a factor of two of it, so probe it and half of it.
+  bool upper_x_checked = false;
+  std::optional<double> rdp_parameter =
+      GetRdpParameter(epsilon_delta, num_queries, sensitivity, noise_function,
+                      upper_x, tolerance);
+  if (rdp_parameter.has_value() && *rdp_parameter < upper_x) {
+    std::vector<absl::StatusOr<double>> deltas =
+        EvaluateInParallel(compute_delta, {*rdp_parameter / 2, *rdp_parameter});
+    for (const absl::StatusOr<double>& delta : deltas) {
+      RETURN_IF_ERROR(delta.status());
+    }
+    if (*deltas[1] <= epsilon_delta.delta) {
+      upper_x = *rdp_parameter;
+      upper_x_checked = true;
+      if (*deltas[0] <= epsilon_delta.delta) {
+        upper_x = *rdp_parameter / 2;
+      } else {
+        lower_x = *rdp_parameter / 2;
+      }
+    } else {
+      lower_x = *rdp_parameter;
     }
-    delta_i /= std::pow(1 + std::exp(epsilon), k);
-    if (1 - std::pow((1 - delta), k) * (1 - delta_i) <= total_delta) {
+  }
+
+  if (!upper_x_checked) {
+    ASSIGN_OR_RETURN(double delta, compute_delta(upper_x));
+    if (delta > epsilon_delta.delta) {
+      return absl::NotFoundError(absl::StrFormat(
+          "Cannot find parameter in range (%lf, %lf) for which delta is at "
+          "most %lf.",
+          lower_x, upper_x, epsilon_delta.delta));
+    }
+  }
+
+  // Search with num_threads probes per round, which shrinks the range by a
+  // factor of num_threads + 1 per round.
+  while (upper_x - lower_x > tolerance) {
+    std::vector<double> probes;
+    for (int i = 1; i <= num_threads; ++i) {
+      probes.push_back(lower_x + i * (upper_x - lower_x) / (num_threads + 1));
+    }
+    std::vector<absl::StatusOr<double>> deltas =
+        EvaluateInParallel(compute_delta, probes);
+    double new_lower_x = probes.back();
+    for (int i = probes.size() - 1; i >= 0; --i) {
+      RETURN_IF_ERROR(deltas[i].status());
+      if (*deltas[i] <= epsilon_delta.delta) {
+        upper_x = probes[i];
+        new_lower_x = i > 0 ? probes[i - 1] : lower_x;
+      }
+    }
+    lower_x = std::max(lower_x, new_lower_x);
+  }
+  return upper_x;
+}
+
+namespace {
+
+// Returns log(exp(a) + exp(b)).
+double LogAddExp(double a, double b) {
+  if (a == -std::numeric_limits<double>::infinity()) {
+    return b;
+  }
+  if (b == -std::numeric_limits<double>::infinity()) {
+    return a;
+  }
+  return std::max(a, b) + std::log1p(std::exp(-std::abs(a - b)));
+}
+
+// Returns log(binomial(k, l)) for l = 0, ..., max_l, each computed from the
+// previous one.
+std::vector<double> LogBinomialCoefficients(int k, int max_l) {
+  std::vector<double> log_binomials(max_l + 1);
+  log_binomials[0] = 0;
+  for (int l = 0; l < max_l; ++l) {
+    log_binomials[l + 1] =
+        log_binomials[l] + std::log(k - l) - std::log(l + 1);
+  }
+  return log_binomials;
+}
+
+// AdvancedComposition for log_binomials = LogBinomialCoefficients(k, k / 2).
+absl::StatusOr<double> AdvancedCompositionWithLogBinomials(
+    const EpsilonDelta privacy_parameters, const int k,
+    const double total_delta, const std::vector<double>& log_binomials) {
+  const double epsilon = privacy_parameters.epsilon;
+  const double delta = privacy_parameters.delta;
+
+  // The calculation follows Theorem 3.3 of https://arxiv.org/pdf/1311.0776.pdf,
+  // which bounds the total delta for total epsilon epsilon * (k - 2 * i) by
+  //   delta_i = sum_{l < i} binomial(k, l) *
+  //             (exp(epsilon * (k - l)) - exp(epsilon * (k - 2 * i + l))) /
+  //             (1 + exp(epsilon))^k.
+  // With p = exp(epsilon) / (1 + exp(epsilon)) and q = 1 - p this is
+  //   delta_i = P[X < i] - exp(epsilon * (k - 2 * i)) * P[Y < i]
+  // for X ~ Binomial(k, q) and Y ~ Binomial(k, p). Both CDFs are accumulated
+  // in log space for all i at once, which takes O(k) time and does not
+  // overflow for large epsilon * k.
+  const double log_p = -std::log1p(std::exp(-epsilon));
+  const double log_q = log_p - epsilon;
+  const int max_i = k / 2;
+  std::vector<double> log_cdf_x(max_i + 1);
+  std::vector<double> log_cdf_y(max_i + 1);
+  log_cdf_x[0] = -std::numeric_limits<double>::infinity();
+  log_cdf_y[0] = -std::numeric_limits<double>::infinity();
+  for (int l = 0; l < max_i; ++l) {
+    log_cdf_x[l + 1] = LogAddExp(
+        log_cdf_x[l], log_binomials[l] + (k - l) * log_p + l * log_q);
+    log_cdf_y[l + 1] = LogAddExp(
+        log_cdf_y[l], log_binomials[l] + l * log_p + (k - l) * log_q);
+  }
+
+  const double no_failure_probability = std::pow(1 - delta, k);
+  for (int i = max_i; i >= 0; --i) {
+    // Every summand of delta_i is non-negative, so a negative value is a
+    // rounding error.
+    const double delta_i = std::max(
+        0.0, std::exp(log_cdf_x[i]) -
+                 std::exp(log_cdf_y[i] + epsilon * (k - 2 * i)));
+    if (1 - no_failure_probability * (1 - delta_i) <= total_delta) {
       return epsilon * (k - 2 * i);
     }
   }
@@ -80,5 +249,64 @@ absl::StatusOr<double> AdvancedComposition(
                       "delta equal to %lf.",
                       total_delta, k, delta));
 }
+
+}  // namespace
+
+absl::StatusOr<double> AdvancedComposition(
+    const EpsilonDelta privacy_parameters, const int num_queries,
+    const double total_delta) {
+  return AdvancedCompositionWithLogBinomials(
+      privacy_parameters, num_queries, total_delta,
+      LogBinomialCoefficients(num_queries, num_queries / 2));
+}
+
+std::vector<absl::StatusOr<double>> BatchAdvancedComposition(
+    absl::Span<const EpsilonDelta> privacy_parameters, const int num_queries,
+    const double total_delta) {
+  const std::vector<double> log_binomials =
+      LogBinomialCoefficients(num_queries, num_queries / 2);
+  std::vector<absl::StatusOr<double>> total_epsilons;
+  total_epsilons.reserve(privacy_parameters.size());
+  for (const EpsilonDelta& parameters : privacy_parameters) {
+    total_epsilons.push_back(AdvancedCompositionWithLogBinomials(
+        parameters, num_queries, total_delta, log_binomials));
+  }
+  return total_epsilons;
+}
+
+namespace {
+
+absl::Status ValidateSamplingProbability(double sampling_probability) {
+  if (!(sampling_probability > 0 && sampling_probability <= 1)) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "sampling_probability should be in (0, 1]: %lf.",
+        sampling_probability));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::StatusOr<EpsilonDelta> AmplifyBySubsampling(
+    const EpsilonDelta privacy_parameters, const double sampling_probability) {
+  RETURN_IF_ERROR(privacy_parameters.Validate());
+  RETURN_IF_ERROR(ValidateSamplingProbability(sampling_probability));
+  return EpsilonDelta{
+      .epsilon = std::log1p(sampling_probability *
+                            std::expm1(privacy_parameters.epsilon)),
+      .delta = sampling_probability * privacy_parameters.delta};
+}
+
+absl::StatusOr<EpsilonDelta> ParametersBeforeSubsampling(
+    const EpsilonDelta amplified_parameters,
+    const double sampling_probability) {
+  RETURN_IF_ERROR(amplified_parameters.Validate());
+  RETURN_IF_ERROR(ValidateSamplingProbability(sampling_probability));
+  const double delta = amplified_parameters.delta / sampling_probability;
+  return EpsilonDelta{
+      .epsilon = std::log1p(std::expm1(amplified_parameters.epsilon) /
+                            sampling_probability),
+      .delta = std::min(1.0, delta)};
+}
 }  // namespace accounting
 }  // namespace differential_privacy
@@ -15,8 +15,10 @@
 #define DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_ACCOUNTANT_H_
 
 #include <functional>
+#include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "accounting/common/common.h"
 #include "accounting/privacy_loss_mechanism.h"
 namespace differential_privacy {
@@ -31,11 +33,19 @@ using NoiseFunction = std::function<std::unique_ptr<AdditiveNoisePrivacyLoss>(
 // Computes the smallest required noise parameter for the given privacy
 // parameters, privacy loss of additive noise mechanisms (Laplace or Gaussian)
 // and also the number of queries.
+//
+// When delta is positive and the mechanism is supported by RdpAccountant, the
+// search starts from the parameter calibrated with RDP, which is an upper
+// bound on the result. Each search round evaluates num_threads parameters
+// concurrently, so with more than one thread noise_function must be safe to
+// call from several threads. If num_threads is not positive, the number of
+// hardware threads (at most 8) is used.
 absl::StatusOr<double> GetSmallestParameter(EpsilonDelta epsilon_delta,
                                             int num_queries, double sensitivity,
                                             NoiseFunction noise_function,
                                             std::optional<double> upper_bound,
-                                            double tolerance = 1e-4);
+                                            double tolerance = 1e-4,
+                                            int num_threads = 1);
 
 // Uses the optimal advanced composition theorem, Theorem 3.3 from the paper
 // Kairouz, Oh, Viswanath. "The Composition Theorem for Differential Privacy"
@@ -59,6 +69,30 @@ absl::StatusOr<double> GetSmallestParameter(EpsilonDelta epsilon_delta,
 absl::StatusOr<double> AdvancedComposition(EpsilonDelta privacy_parameters,
                                            int num_queries, double total_delta);
 
+// Returns AdvancedComposition(privacy_parameters[j], num_queries, total_delta)
+// at index j, e.g., to search for the per-query epsilon that meets a total
+// budget. Both take O(num_queries) time per element, but the batch shares the
+// binomial coefficients between all elements.
+std::vector<absl::StatusOr<double>> BatchAdvancedComposition(
+    absl::Span<const EpsilonDelta> privacy_parameters, int num_queries,
+    double total_delta);
+
+// Returns the privacy parameters of a mechanism with the given parameters that
+// is applied to a Poisson subsample, in which every record is included
+// independently with probability sampling_probability. The amplified
+// parameters are (log(1 + q * (exp(epsilon) - 1)), q * delta) for the
+// sampling probability q and add/remove neighbouring datasets, see
+// Balle, Barthe, Gaboardi. "Privacy Amplification by Subsampling: Tight
+// Analyses via Couplings and Divergences". In NeurIPS 2018.
+absl::StatusOr<EpsilonDelta> AmplifyBySubsampling(
+    EpsilonDelta privacy_parameters, double sampling_probability);
+
+// Inverse of AmplifyBySubsampling: returns the largest privacy parameters of a
+// mechanism such that applying it to a Poisson subsample with the given
+// sampling probability satisfies the amplified privacy parameters.
+absl::StatusOr<EpsilonDelta> ParametersBeforeSubsampling(
+    EpsilonDelta amplified_parameters, double sampling_probability);
+
 }  // namespace accounting
 }  // namespace differential_privacy
 
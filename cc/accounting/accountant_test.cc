@@ -14,7 +14,9 @@
 
 #include "accounting/accountant.h"
 
+#include <cmath>
 #include <optional>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -22,6 +24,7 @@
 #include "absl/status/statusor.h"
 #include "accounting/common/common.h"
 #include "accounting/privacy_loss_distribution.h"
+#include "boost/math/special_functions/binomial.hpp"
 #include "base/testing/status_matchers.h"
 
 namespace differential_privacy {
@@ -81,6 +84,46 @@ TEST_P(AccountantTest, Basic) {
   EXPECT_NEAR(result.value(), param.expected_parameter, kMaxError);
 }
 
+std::unique_ptr<AdditiveNoisePrivacyLoss> GaussianNoiseFunction(
+    double parameter, double sensitivity) {
+  return GaussianPrivacyLoss::Create(parameter, sensitivity).value();
+}
+
+TEST(AccountantTest, ParallelSearchMatchesSequentialSearch) {
+  EpsilonDelta epsilon_delta = {.epsilon = 1, .delta = 1e-5};
+  for (NoiseFunction noise_function :
+       {NoiseFunction(LaplaceNoiseFunction),
+        NoiseFunction(GaussianNoiseFunction)}) {
+    absl::StatusOr<double> sequential = GetSmallestParameter(
+        epsilon_delta, /*num_queries=*/10, /*sensitivity=*/1, noise_function,
+        /*upper_bound=*/std::nullopt, /*tolerance=*/1e-3, /*num_threads=*/1);
+    ASSERT_OK(sequential);
+    absl::StatusOr<double> parallel = GetSmallestParameter(
+        epsilon_delta, /*num_queries=*/10, /*sensitivity=*/1, noise_function,
+        /*upper_bound=*/std::nullopt, /*tolerance=*/1e-3, /*num_threads=*/4);
+    ASSERT_OK(parallel);
+    EXPECT_NEAR(*parallel, *sequential, 2e-3);
+  }
+}
+
+TEST(AccountantTest, GaussianParameterIsBelowRdpParameter) {
+  // For 10 Gaussian queries with sensitivity 1, RDP calibration to
+  // (1, 1e-5)-DP needs a standard deviation of about 12.8.
+  absl::StatusOr<double> result = GetSmallestParameter(
+      {.epsilon = 1, .delta = 1e-5}, /*num_queries=*/10, /*sensitivity=*/1,
+      GaussianNoiseFunction, /*upper_bound=*/std::nullopt);
+  ASSERT_OK(result);
+  EXPECT_GT(*result, 10);
+  EXPECT_LT(*result, 12.8);
+}
+
+TEST(AccountantTest, SmallestParameterNotFound) {
+  EXPECT_THAT(GetSmallestParameter({.epsilon = 1, .delta = 1e-5},
+                                   /*num_queries=*/10, /*sensitivity=*/1,
+                                   GaussianNoiseFunction, /*upper_bound=*/1),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
 struct AdvancedCompositionParam {
   double epsilon;
   double delta;
@@ -131,6 +174,118 @@ TEST(AdvancedCompositionNotFoundTest, TotalDeltaTooSmall) {
                                     num_queries, total_delta);
   EXPECT_THAT(result, StatusIs(absl::StatusCode::kNotFound));
 }
+
+// The quadratic-time formula of Theorem 3.3 of
+// https://arxiv.org/pdf/1311.0776.pdf, for small epsilon * num_queries.
+std::optional<double> NaiveAdvancedComposition(EpsilonDelta privacy_parameters,
+                                               int k, double total_delta) {
+  const double epsilon = privacy_parameters.epsilon;
+  for (int i = k / 2; i >= 0; --i) {
+    double delta_i = 0;
+    for (int l = 0; l < i; l++) {
+      delta_i +=
+          boost::math::binomial_coefficient<double>(k, l) *
+          (std::exp(epsilon * (k - l)) - std::exp(epsilon * (k - 2 * i + l)));
+    }
+    delta_i /= std::pow(1 + std::exp(epsilon), k);
+    if (1 - std::pow(1 - privacy_parameters.delta, k) * (1 - delta_i) <=
+        total_delta) {
+      return epsilon * (k - 2 * i);
+    }
+  }
+  return std::nullopt;
+}
+
+TEST(AdvancedCompositionLogSpaceTest, MatchesQuadraticFormula) {
+  for (double epsilon : {0.0, 0.01, 0.3, 1.0, 2.5}) {
+    for (int num_queries : {1, 2, 7, 30, 101}) {
+      for (double total_delta : {1e-9, 1e-5, 0.01, 0.2}) {
+        const EpsilonDelta parameters{.epsilon = epsilon, .delta = 1e-7};
+        std::optional<double> expected =
+            NaiveAdvancedComposition(parameters, num_queries, total_delta);
+        absl::StatusOr<double> result =
+            AdvancedComposition(parameters, num_queries, total_delta);
+        if (expected.has_value()) {
+          ASSERT_OK(result);
+          EXPECT_DOUBLE_EQ(*result, *expected)
+              << epsilon << " " << num_queries << " " << total_delta;
+        } else {
+          EXPECT_THAT(result, StatusIs(absl::StatusCode::kNotFound));
+        }
+      }
+    }
+  }
+}
+
+TEST(AdvancedCompositionLogSpaceTest, HandlesManyQueries) {
+  // exp(epsilon * num_queries) overflows, the log-space sums do not.
+  absl::StatusOr<double> result = AdvancedComposition(
+      EpsilonDelta{.epsilon = 1, .delta = 0}, 100000, 1e-6);
+  ASSERT_OK(result);
+  EXPECT_LT(*result, 100000);
+  EXPECT_GT(*result, 0);
+
+  // For small epsilon, the total epsilon grows like sqrt(num_queries).
+  result = AdvancedComposition(EpsilonDelta{.epsilon = 0.001, .delta = 0},
+                               1000000, 1e-6);
+  ASSERT_OK(result);
+  EXPECT_LT(*result, 0.1 * 1000000 * 0.001);
+}
+
+TEST(BatchAdvancedCompositionTest, MatchesAdvancedComposition) {
+  const std::vector<EpsilonDelta> parameters = {
+      {.epsilon = 1, .delta = 0.001},
+      {.epsilon = 0.5, .delta = 1e-6},
+      {.epsilon = 0.1, .delta = 0.2},
+      {.epsilon = 0.05, .delta = 0}};
+  std::vector<absl::StatusOr<double>> results =
+      BatchAdvancedComposition(parameters, 30, 0.06);
+  ASSERT_EQ(results.size(), parameters.size());
+  for (int j = 0; j < parameters.size(); ++j) {
+    absl::StatusOr<double> expected =
+        AdvancedComposition(parameters[j], 30, 0.06);
+    EXPECT_EQ(results[j].status().code(), expected.status().code());
+    if (expected.ok()) {
+      EXPECT_EQ(*results[j], *expected);
+    }
+  }
+  EXPECT_THAT(results[2], StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(AmplifyBySubsamplingTest, AmplifiesEpsilonAndDelta) {
+  absl::StatusOr<EpsilonDelta> result =
+      AmplifyBySubsampling({.epsilon = 1, .delta = 1e-6}, 0.01);
+  ASSERT_OK(result);
+  EXPECT_NEAR(result->epsilon, std::log(1 + 0.01 * (std::exp(1) - 1)), 1e-12);
+  EXPECT_NEAR(result->delta, 1e-8, 1e-20);
+
+  // Sampling everything does not amplify.
+  result = AmplifyBySubsampling({.epsilon = 2, .delta = 1e-6}, 1);
+  ASSERT_OK(result);
+  EXPECT_NEAR(result->epsilon, 2, 1e-12);
+  EXPECT_NEAR(result->delta, 1e-6, 1e-18);
+}
+
+TEST(AmplifyBySubsamplingTest, InvertsAmplification) {
+  absl::StatusOr<EpsilonDelta> before =
+      ParametersBeforeSubsampling({.epsilon = 0.1, .delta = 1e-8}, 0.05);
+  ASSERT_OK(before);
+  EXPECT_GT(before->epsilon, 0.1);
+  absl::StatusOr<EpsilonDelta> amplified =
+      AmplifyBySubsampling(*before, 0.05);
+  ASSERT_OK(amplified);
+  EXPECT_NEAR(amplified->epsilon, 0.1, 1e-12);
+  EXPECT_NEAR(amplified->delta, 1e-8, 1e-20);
+}
+
+TEST(AmplifyBySubsamplingTest, RejectsInvalidSamplingProbability) {
+  EXPECT_THAT(AmplifyBySubsampling({.epsilon = 1, .delta = 0}, 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(AmplifyBySubsampling({.epsilon = 1, .delta = 0}, 1.5),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParametersBeforeSubsampling({.epsilon = 1, .delta = 0}, -1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
 }  // namespace
 }  // namespace accounting
 }  // namespace differential_privacy
@@ -0,0 +1,186 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks for creating, composing and querying privacy loss distributions,
+// to help choose discretization intervals based on their cost. Every
+// benchmark reports the size of the resulting PMF in the "pmf_bytes" counter
+// and the peak resident memory of the process in "max_rss_bytes". The latter
+// is a high-water mark over all benchmarks run so far, so run one benchmark
+// at a time with --benchmark_filter to attribute it.
+
+#include <sys/resource.h>
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "benchmark/benchmark.h"
+#include "accounting/accountant.h"
+#include "accounting/common/common.h"
+#include "accounting/privacy_loss_distribution.h"
+#include "accounting/privacy_loss_mechanism.h"
+
+namespace differential_privacy {
+namespace accounting {
+namespace {
+
+constexpr double kLaplaceParameter = 1;
+constexpr double kGaussianStandardDeviation = 1;
+constexpr double kEpsilon = 1;
+
+// Argument 0 of most benchmarks is k for a discretization interval of 10^-k.
+double DiscretizationInterval(const benchmark::State& state) {
+  return std::pow(10.0, -static_cast<double>(state.range(0)));
+}
+
+void DiscretizationIntervals(benchmark::internal::Benchmark* benchmark) {
+  benchmark->DenseRange(2, 4)->ArgName("interval_exp");
+}
+
+void DiscretizationIntervalsAndCompositions(
+    benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"interval_exp", "num_times"})
+      ->ArgsProduct({benchmark::CreateDenseRange(2, 4, /*step=*/1),
+                     benchmark::CreateRange(1, 1000, /*multi=*/10)});
+}
+
+void ReportMemory(benchmark::State& state,
+                  const PrivacyLossDistribution& pld) {
+  state.counters["pmf_bytes"] =
+      pld.UnpackedPmf().items.size() * sizeof(double);
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    // ru_maxrss is in kilobytes on Linux.
+    state.counters["max_rss_bytes"] = usage.ru_maxrss * int64_t{1024};
+  }
+}
+
+std::unique_ptr<PrivacyLossDistribution> CreateLaplacePld(
+    double discretization_interval) {
+  return PrivacyLossDistribution::CreateForLaplaceMechanism(
+             kLaplaceParameter, /*sensitivity=*/1, EstimateType::kPessimistic,
+             discretization_interval)
+      .value();
+}
+
+void BM_CreateForLaplaceMechanism(benchmark::State& state) {
+  const double discretization_interval = DiscretizationInterval(state);
+  std::unique_ptr<PrivacyLossDistribution> pld;
+  for (auto _ : state) {
+    pld = CreateLaplacePld(discretization_interval);
+    benchmark::DoNotOptimize(pld);
+  }
+  ReportMemory(state, *pld);
+}
+BENCHMARK(BM_CreateForLaplaceMechanism)
+    ->Apply(DiscretizationIntervals)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_CreateForGaussianMechanism(benchmark::State& state) {
+  const double discretization_interval = DiscretizationInterval(state);
+  std::unique_ptr<PrivacyLossDistribution> pld;
+  for (auto _ : state) {
+    pld = PrivacyLossDistribution::CreateForGaussianMechanism(
+              kGaussianStandardDeviation, /*sensitivity=*/1,
+              EstimateType::kPessimistic, discretization_interval)
+              .value();
+    benchmark::DoNotOptimize(pld);
+  }
+  ReportMemory(state, *pld);
+}
+BENCHMARK(BM_CreateForGaussianMechanism)
+    ->Apply(DiscretizationIntervals)
+    ->Unit(benchmark::kMillisecond);
+
+// Measures composing two distinct PLDs. Creating the PLDs is not timed.
+void BM_Compose(benchmark::State& state) {
+  const double discretization_interval = DiscretizationInterval(state);
+  const std::unique_ptr<PrivacyLossDistribution> other =
+      CreateLaplacePld(discretization_interval);
+  std::unique_ptr<PrivacyLossDistribution> pld;
+  for (auto _ : state) {
+    state.PauseTiming();
+    pld = CreateLaplacePld(discretization_interval);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(pld->Compose(*other));
+  }
+  ReportMemory(state, *pld);
+}
+BENCHMARK(BM_Compose)
+    ->Apply(DiscretizationIntervals)
+    ->Unit(benchmark::kMillisecond);
+
+// Measures composing a PLD with itself num_times times.
+void BM_ComposeNumTimes(benchmark::State& state) {
+  const double discretization_interval = DiscretizationInterval(state);
+  const int num_times = state.range(1);
+  std::unique_ptr<PrivacyLossDistribution> pld;
+  for (auto _ : state) {
+    state.PauseTiming();
+    pld = CreateLaplacePld(discretization_interval);
+    state.ResumeTiming();
+    pld->Compose(num_times);
+  }
+  ReportMemory(state, *pld);
+}
+BENCHMARK(BM_ComposeNumTimes)
+    ->Apply(DiscretizationIntervalsAndCompositions)
+    ->Unit(benchmark::kMillisecond);
+
+// Measures the delta query on a PLD composed num_times times, the typical
+// query of a service checking its privacy budget.
+void BM_GetDeltaForEpsilon(benchmark::State& state) {
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      CreateLaplacePld(DiscretizationInterval(state));
+  pld->Compose(state.range(1));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(pld->GetDeltaForEpsilon(kEpsilon));
+  }
+  ReportMemory(state, *pld);
+}
+BENCHMARK(BM_GetDeltaForEpsilon)
+    ->Apply(DiscretizationIntervalsAndCompositions)
+    ->Unit(benchmark::kMicrosecond);
+
+// Measures the search for the smallest Laplace (argument 1 = 0) or Gaussian
+// (argument 1 = 1) noise parameter for num_queries queries.
+void BM_GetSmallestParameter(benchmark::State& state) {
+  const int num_queries = state.range(0);
+  NoiseFunction noise_function;
+  if (state.range(1) == 0) {
+    noise_function = [](double parameter, double sensitivity) {
+      return LaplacePrivacyLoss::Create(parameter, sensitivity).value();
+    };
+    state.SetLabel("Laplace");
+  } else {
+    noise_function = [](double parameter, double sensitivity) {
+      return GaussianPrivacyLoss::Create(parameter, sensitivity).value();
+    };
+    state.SetLabel("Gaussian");
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(GetSmallestParameter(
+        {.epsilon = kEpsilon, .delta = 1e-5}, num_queries, /*sensitivity=*/1,
+        noise_function, /*upper_bound=*/std::nullopt));
+  }
+}
+BENCHMARK(BM_GetSmallestParameter)
+    ->ArgNames({"num_queries", "gaussian"})
+    ->ArgsProduct({benchmark::CreateRange(1, 100, /*multi=*/10), {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace accounting
+}  // namespace differential_privacy
@@ -14,6 +14,11 @@
 
 #include "accounting/common/common.h"
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <optional>
 #include <utility>
 
 #include "absl/status/status.h"
@@ -27,15 +32,31 @@ absl::StatusOr<double> InverseMonotoneFunction(
     const absl::FunctionRef<absl::StatusOr<double>(double x)> func,
     const double value, const BinarySearchParameters search_parameters,
     const bool increasing) {
+  MonotoneFunctionCache* cache = search_parameters.cache;
+  auto evaluate = [func, cache](const double x) -> absl::StatusOr<double> {
+    if (cache != nullptr) {
+      std::optional<double> cached_value = cache->Get(x);
+      if (cached_value.has_value()) return *cached_value;
+    }
+    ASSIGN_OR_RETURN(double func_value, func(x));
+    if (cache != nullptr) cache->Insert(x, func_value);
+    return func_value;
+  };
+
   double lower_x = search_parameters.lower_bound;
   double upper_x = search_parameters.upper_bound;
+  // Function values at lower_x and upper_x, when known.
+  std::optional<double> lower_value;
+  std::optional<double> upper_value;
 
   double min_value = -std::numeric_limits<double>::infinity();
   if (increasing && lower_x != -std::numeric_limits<double>::infinity()) {
-    ASSIGN_OR_RETURN(min_value, func(lower_x));
+    ASSIGN_OR_RETURN(min_value, evaluate(lower_x));
+    lower_value = min_value;
   } else if (!increasing &&
              upper_x != std::numeric_limits<double>::infinity()) {
-    ASSIGN_OR_RETURN(min_value, func(upper_x));
+    ASSIGN_OR_RETURN(min_value, evaluate(upper_x));
+    upper_value = min_value;
   }
   if (min_value > value) {
     return absl::NotFoundError(absl::StrFormat(
@@ -54,6 +75,21 @@ absl::StatusOr<double> InverseMonotoneFunction(
     };
   }
 
+  // Since func is monotone, every cached value bounds the solution from one
+  // side.
+  if (cache != nullptr) {
+    for (const auto& [x, func_value] : cache->values()) {
+      if (x <= lower_x || x >= upper_x) continue;
+      if (solution_above_current_x(func_value)) {
+        lower_x = x;
+        lower_value = func_value;
+      } else {
+        upper_x = x;
+        upper_value = func_value;
+      }
+    }
+  }
+
   if (search_parameters.initial_guess.has_value()) {
     // If |initial_guess| is specified, start from |initial_guess| and keep
     // doubling until the value of x becomes too large. This is done only for
@@ -63,27 +99,112 @@ absl::StatusOr<double> InverseMonotoneFunction(
     double initial_guess_x = search_parameters.initial_guess.value();
     while (initial_guess_x < upper_x) {
       double func_value;
-      ASSIGN_OR_RETURN(func_value, func(initial_guess_x));
-      if (!solution_above_current_x(func_value)) break;
-      lower_x = initial_guess_x;
+      ASSIGN_OR_RETURN(func_value, evaluate(initial_guess_x));
+      if (!solution_above_current_x(func_value)) {
+        upper_x = initial_guess_x;
+        upper_value = func_value;
+        break;
+      }
+      if (initial_guess_x > lower_x) {
+        lower_x = initial_guess_x;
+        lower_value = func_value;
+      }
       initial_guess_x *= 2;
     }
-    upper_x = std::min(upper_x, initial_guess_x);
   }
 
   double tolerance = search_parameters.tolerance;
   if (search_parameters.discrete) tolerance = 1;
+  const bool interpolate =
+      search_parameters.interpolate && !search_parameters.discrete;
+
+  // The secant is taken through the offsets of the function values from
+  // value. For a positive value, such as a delta, the offsets are taken on a
+  // log scale, on which tail bounds are much closer to linear; non-positive
+  // function values then have infinite offsets and lead to bisection steps.
+  auto offset = [value](const double func_value) {
+    return value > 0 ? std::log(func_value) - std::log(value)
+                     : func_value - value;
+  };
+  // Illinois modification of regula falsi: when the same end of the range is
+  // kept twice in a row, the offset at that end is halved, which stops the
+  // other end from converging slowly.
+  double lower_offset = offset(lower_value.value_or(value));
+  double upper_offset = offset(upper_value.value_or(value));
+  int last_moved_end = 0;  // -1 for lower_x, 1 for upper_x.
+  int num_same_end_moves = 0;
+  // The two most recently evaluated points of the search.
+  std::optional<std::pair<double, double>> previous_point;
+  std::optional<std::pair<double, double>> latest_point;
+  // Interpolation steps must halve the range every kMaxSlowSteps steps;
+  // otherwise, a bisection step follows.
+  constexpr int kMaxSlowSteps = 3;
+  double halving_width = upper_x - lower_x;
+  int num_slow_steps = 0;
 
   while (upper_x - lower_x > tolerance) {
-    double mid_x = (upper_x + lower_x) / 2;
-    if (search_parameters.discrete) mid_x = std::floor(mid_x);
+    double next_x = (upper_x + lower_x) / 2;
+    if (interpolate && num_slow_steps < kMaxSlowSteps) {
+      // Prefer the secant through the two latest points, which converges
+      // faster than regula falsi, but only if it stays inside the range.
+      std::optional<double> estimate;
+      if (previous_point.has_value() &&
+          std::isfinite(previous_point->second) &&
+          std::isfinite(latest_point->second) &&
+          previous_point->second != latest_point->second) {
+        const auto [x0, offset0] = *previous_point;
+        const auto [x1, offset1] = *latest_point;
+        const double secant_x = x1 - offset1 * (x1 - x0) / (offset1 - offset0);
+        if (secant_x > lower_x && secant_x < upper_x) estimate = secant_x;
+      }
+      if (!estimate.has_value() && lower_value.has_value() &&
+          upper_value.has_value() && std::isfinite(lower_offset) &&
+          std::isfinite(upper_offset) && lower_offset != upper_offset) {
+        estimate = lower_x + (upper_x - lower_x) * lower_offset /
+                                 (lower_offset - upper_offset);
+      }
+      if (estimate.has_value()) {
+        if (num_same_end_moves >= 2) {
+          // The estimates approach the solution from one side, so the other
+          // end of the range stays put. Stepping past the estimate by the
+          // last correction most likely lands beyond the solution and closes
+          // the range.
+          const double correction = std::abs(*estimate - latest_point->first);
+          *estimate += last_moved_end == -1 ? correction : -correction;
+        }
+        // Staying away from the ends by half the tolerance ensures progress
+        // and lets the range close from both sides once the estimate is
+        // accurate.
+        next_x = std::clamp(*estimate, lower_x + tolerance / 2,
+                            upper_x - tolerance / 2);
+      }
+    }
+    if (search_parameters.discrete) next_x = std::floor(next_x);
 
     double func_value;
-    ASSIGN_OR_RETURN(func_value, func(mid_x));
+    ASSIGN_OR_RETURN(func_value, evaluate(next_x));
+    previous_point = latest_point;
+    latest_point = {next_x, offset(func_value)};
     if (solution_above_current_x(func_value)) {
-      lower_x = mid_x;
+      lower_x = next_x;
+      lower_value = func_value;
+      lower_offset = latest_point->second;
+      if (last_moved_end == -1) upper_offset /= 2;
+      num_same_end_moves = last_moved_end == -1 ? num_same_end_moves + 1 : 1;
+      last_moved_end = -1;
+    } else {
+      upper_x = next_x;
+      upper_value = func_value;
+      upper_offset = latest_point->second;
+      if (last_moved_end == 1) lower_offset /= 2;
+      num_same_end_moves = last_moved_end == 1 ? num_same_end_moves + 1 : 1;
+      last_moved_end = 1;
+    }
+    if (upper_x - lower_x <= halving_width / 2) {
+      halving_width = upper_x - lower_x;
+      num_slow_steps = 0;
     } else {
-      upper_x = mid_x;
+      ++num_slow_steps;
     }
   }
 
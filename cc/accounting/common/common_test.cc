@@ -140,9 +140,92 @@ TEST_P(InverseMonotoneFunctionTest, InverseMonotoneFunctionBasic) {
   EXPECT_NEAR(x.value(), param.expected_x, kMaxError);
 }
 
+TEST_P(InverseMonotoneFunctionTest, InterpolationFindsTheSameSolution) {
+  const InverseMonotoneFunctionParam& param = GetParam();
+  BinarySearchParameters search_parameters = {
+      .lower_bound = param.lower_x,
+      .upper_bound = param.upper_x,
+      .initial_guess = param.initial_guess,
+      .tolerance = 1e-7,
+      .discrete = param.discrete,
+      .interpolate = true};
+
+  absl::StatusOr<double> x = InverseMonotoneFunction(
+      param.func, param.value, search_parameters, param.increasing);
+
+  ASSERT_OK(x);
+  EXPECT_NEAR(x.value(), param.expected_x, kMaxError);
+}
+
+TEST(InverseMonotoneFunctionTest, InterpolationNeedsFewerEvaluations) {
+  for (bool increasing : {false, true}) {
+    int num_evaluations = 0;
+    auto func = [&num_evaluations, increasing](double x) {
+      ++num_evaluations;
+      // Smooth, but far from linear on the search range.
+      const double delta = std::exp(-x * x / 8) / (1 + x);
+      return increasing ? 1 / delta : delta;
+    };
+    const double value = increasing ? 1e6 : 1e-6;
+    BinarySearchParameters search_parameters = {.lower_bound = 0,
+                                                .upper_bound = 100,
+                                                .initial_guess = std::nullopt,
+                                                .tolerance = 1e-9};
+
+    absl::StatusOr<double> bisection_x =
+        InverseMonotoneFunction(func, value, search_parameters, increasing);
+    ASSERT_OK(bisection_x);
+    const int bisection_evaluations = num_evaluations;
+
+    num_evaluations = 0;
+    search_parameters.interpolate = true;
+    absl::StatusOr<double> interpolation_x =
+        InverseMonotoneFunction(func, value, search_parameters, increasing);
+    ASSERT_OK(interpolation_x);
+
+    EXPECT_NEAR(*interpolation_x, *bisection_x, 2e-9);
+    EXPECT_LE(num_evaluations, bisection_evaluations / 2);
+  }
+}
+
+TEST(InverseMonotoneFunctionTest, CacheAvoidsRepeatedEvaluations) {
+  int num_evaluations = 0;
+  auto func = [&num_evaluations](double x) {
+    ++num_evaluations;
+    return -x;
+  };
+  MonotoneFunctionCache cache;
+  BinarySearchParameters search_parameters = {.lower_bound = 0,
+                                              .upper_bound = 10,
+                                              .initial_guess = std::nullopt,
+                                              .cache = &cache};
+
+  absl::StatusOr<double> x =
+      InverseMonotoneFunction(func, -4.5, search_parameters);
+  ASSERT_OK(x);
+  EXPECT_NEAR(*x, 4.5, kMaxError);
+  EXPECT_EQ(cache.values().size(), num_evaluations);
+
+  // The cached values already bracket the solution within the tolerance.
+  num_evaluations = 0;
+  x = InverseMonotoneFunction(func, -4.5, search_parameters);
+  ASSERT_OK(x);
+  EXPECT_NEAR(*x, 4.5, kMaxError);
+  EXPECT_EQ(num_evaluations, 0);
+
+  // A nearby value starts from the range that the cached values allow.
+  const int first_search_evaluations = cache.values().size();
+  num_evaluations = 0;
+  x = InverseMonotoneFunction(func, -4.6, search_parameters);
+  ASSERT_OK(x);
+  EXPECT_NEAR(*x, 4.6, kMaxError);
+  EXPECT_LT(num_evaluations, first_search_evaluations);
+}
+
 TEST(InverseMonotoneFunctionTest, InverseMonotoneFunctionNotFoundTooLarge) {
   BinarySearchParameters search_parameters = {.lower_bound = -5,
-                                              .upper_bound = 4};
+                                              .upper_bound = 4,
+                                              .initial_guess = std::nullopt};
 
   auto decreasing_func = [](double x) { return -x; };
   absl::StatusOr<double> x =
@@ -152,7 +235,8 @@ TEST(InverseMonotoneFunctionTest, InverseMonotoneFunctionNotFoundTooLarge) {
 
 TEST(InverseMonotoneFunctionTest, InverseMonotoneFunctionNotFoundTooSmall) {
   BinarySearchParameters search_parameters = {.lower_bound = -5,
-                                              .upper_bound = 4};
+                                              .upper_bound = 4,
+                                              .initial_guess = std::nullopt};
 
   // inverse is too small for increasing function
   auto increasing_func = [](double x) { return x; };
@@ -14,22 +14,33 @@
 
 #include "accounting/convolution.h"
 
+#include <algorithm>
 #include <cmath>
 #include <complex>
+#include <memory>
 #include <optional>
 #include <ostream>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
+#include "absl/numeric/bits.h"
+#include "absl/types/span.h"
 #include "accounting/common/common.h"
-#include "accounting/kiss_fft_wrapper.h"
+#include "accounting/fft_backend.h"
+#include "accounting/fft_plan_cache.h"
 
 namespace differential_privacy {
 namespace accounting {
 
-using ::kiss_fft_cpx;
-using ::kiss_fftr_cfg;
 using ::std::complex;
 
+namespace {
+// FFT size from which the forward transforms of the two inputs of a
+// convolution run on separate threads. Below it, starting a thread costs more
+// than a transform.
+constexpr int kMinRealSizeForParallelTransforms = 1 << 16;
+}  // namespace
+
 UnpackedProbabilityMassFunction UnpackProbabilityMassFunction(
     const ProbabilityMassFunction& input) {
   if (input.empty()) {
@@ -50,8 +61,37 @@ UnpackedProbabilityMassFunction UnpackProbabilityMassFunction(
   return unpacked_map;
 }
 
-ProbabilityMassFunction CreateProbabilityMassFunction(
+UnpackedProbabilityMassFunction CoarsenProbabilityMassFunction(
+    const UnpackedProbabilityMassFunction& input, int factor, bool round_up) {
+  auto coarse_key = [factor, round_up](int64_t key) {
+    // Integer division rounds toward zero, so adjust for the other direction.
+    int64_t quotient = key / factor;
+    const int64_t remainder = key % factor;
+    if (round_up && remainder > 0) ++quotient;
+    if (!round_up && remainder < 0) --quotient;
+    return quotient;
+  };
+  UnpackedProbabilityMassFunction output;
+  if (input.items.empty()) {
+    return output;
+  }
+  const int64_t min_key = coarse_key(input.min_key);
+  const int64_t max_key = coarse_key(input.min_key + input.items.size() - 1);
+  output.min_key = min_key;
+  output.items.assign(max_key - min_key + 1, 0);
+  for (int i = 0; i < input.items.size(); ++i) {
+    output.items[coarse_key(input.min_key + i) - min_key] += input.items[i];
+  }
+  return output;
+}
+
+UnpackedProbabilityMassFunction TruncateProbabilityMassFunction(
     const UnpackedProbabilityMassFunction& input, double tail_mass_truncation) {
+  UnpackedProbabilityMassFunction output;
+  if (input.items.empty()) {
+    return output;
+  }
+
   int lower_truncation_index = -1;
   double lower_truncation_mass = 0;
   do {
@@ -66,12 +106,38 @@ ProbabilityMassFunction CreateProbabilityMassFunction(
   } while (upper_truncation_mass <= tail_mass_truncation / 2 &&
            upper_truncation_index > 0);
 
-  ProbabilityMassFunction output;
+  // Drop non-positive masses at both ends of the remaining range.
+  while (lower_truncation_index <= upper_truncation_index &&
+         input.items[lower_truncation_index] <= 0) {
+    ++lower_truncation_index;
+  }
+  while (upper_truncation_index >= lower_truncation_index &&
+         input.items[upper_truncation_index] <= 0) {
+    --upper_truncation_index;
+  }
+  if (lower_truncation_index > upper_truncation_index) {
+    return output;
+  }
+
+  output.min_key = input.min_key + lower_truncation_index;
+  output.items.reserve(upper_truncation_index - lower_truncation_index + 1);
   for (int index = lower_truncation_index; index <= upper_truncation_index;
        index++) {
-    auto value = input.items.at(index);
+    output.items.push_back(std::max(input.items[index], 0.0));
+  }
+  return output;
+}
+
+ProbabilityMassFunction CreateProbabilityMassFunction(
+    const UnpackedProbabilityMassFunction& input, double tail_mass_truncation) {
+  UnpackedProbabilityMassFunction truncated =
+      TruncateProbabilityMassFunction(input, tail_mass_truncation);
+
+  ProbabilityMassFunction output;
+  for (int index = 0; index < truncated.items.size(); index++) {
+    auto value = truncated.items[index];
     if (value > 0) {
-      output[index + input.min_key] = value;
+      output[index + truncated.min_key] = value;
     }
   }
   return output;
@@ -80,25 +146,56 @@ ProbabilityMassFunction CreateProbabilityMassFunction(
 ProbabilityMassFunction Convolve(const ProbabilityMassFunction& x,
                                  const ProbabilityMassFunction& y,
                                  double tail_mass_truncation) {
-  UnpackedProbabilityMassFunction x_map = UnpackProbabilityMassFunction(x);
-  UnpackedProbabilityMassFunction y_map = UnpackProbabilityMassFunction(y);
+  return CreateProbabilityMassFunction(
+      Convolve(UnpackProbabilityMassFunction(x),
+               UnpackProbabilityMassFunction(y), tail_mass_truncation));
+}
+
+UnpackedProbabilityMassFunction Convolve(
+    const UnpackedProbabilityMassFunction& x_map,
+    const UnpackedProbabilityMassFunction& y_map,
+    double tail_mass_truncation) {
+  return Convolve(x_map.min_key, x_map.items, y_map.min_key, y_map.items,
+                  tail_mass_truncation);
+}
 
-  const int size_x = x_map.items.size();
-  const int size_y = y_map.items.size();
+UnpackedProbabilityMassFunction Convolve(int x_min_key,
+                                         absl::Span<const double> x_items,
+                                         int y_min_key,
+                                         absl::Span<const double> y_items,
+                                         double tail_mass_truncation) {
+  if (x_items.empty() || y_items.empty()) {
+    return UnpackedProbabilityMassFunction();
+  }
+
+  const int size_x = x_items.size();
+  const int size_y = y_items.size();
   const int output_size = size_x + size_y - 1;
-  KissFftWrapper wrapper(output_size);
-  const int real_size = wrapper.EfficientRealSize();
-  const int complex_size = wrapper.ComplexSize();
+  std::shared_ptr<const FftBackend> fft = GetCachedFftPlan(output_size);
+  const int real_size = fft->EfficientRealSize();
+  const int complex_size = fft->ComplexSize();
   std::vector<double> x_input(real_size, 0.0);
-  absl::c_copy(x_map.items, x_input.begin());
+  absl::c_copy(x_items, x_input.begin());
   std::vector<double> y_input(real_size, 0.0);
-  absl::c_copy(y_map.items, y_input.begin());
+  absl::c_copy(y_items, y_input.begin());
 
   std::vector<complex<double>> x_transformed(complex_size, 0.0);
   std::vector<complex<double>> y_transformed(complex_size, 0.0);
 
-  wrapper.ForwardTransform(x_input.data(), x_transformed.data());
-  wrapper.ForwardTransform(y_input.data(), y_transformed.data());
+  if (real_size >= kMinRealSizeForParallelTransforms) {
+    // The two forward transforms are independent. The second one runs on its
+    // own plan, since plans must not be shared between threads.
+    std::shared_ptr<const FftBackend> y_fft =
+        GetCachedFftPlan(output_size, /*slot=*/1);
+    std::thread y_thread([&y_fft, &y_input, &y_transformed]() {
+      y_fft->ForwardTransform(y_input.data(), y_transformed.data());
+    });
+    fft->ForwardTransform(x_input.data(), x_transformed.data());
+    y_thread.join();
+  } else {
+    fft->ForwardTransform(x_input.data(), x_transformed.data());
+    fft->ForwardTransform(y_input.data(), y_transformed.data());
+  }
 
   std::vector<complex<double>> convolution_transformed;
   convolution_transformed.reserve(x_transformed.size());
@@ -108,16 +205,57 @@ ProbabilityMassFunction Convolve(const ProbabilityMassFunction& x,
   }
 
   std::vector<double> result_vector(real_size, 0.0);
-  wrapper.InverseTransform(convolution_transformed.data(),
-                           result_vector.data());
+  fft->InverseTransform(convolution_transformed.data(), result_vector.data());
   for (int i = 0; i < result_vector.size(); ++i) {
     result_vector[i] /= real_size;
   }
   UnpackedProbabilityMassFunction result_map;
-  result_map.min_key = x_map.min_key + y_map.min_key;
+  result_map.min_key = x_min_key + y_min_key;
   result_map.items = std::vector<double>(result_vector.begin(),
                                          result_vector.begin() + output_size);
-  return CreateProbabilityMassFunction(result_map, tail_mass_truncation);
+  return TruncateProbabilityMassFunction(result_map, tail_mass_truncation);
+}
+
+UnpackedProbabilityMassFunction ConvolveAll(
+    absl::Span<const UnpackedProbabilityMassFunction* const> inputs,
+    double tail_mass_truncation) {
+  UnpackedProbabilityMassFunction result_map = {0, {1}};
+  if (inputs.empty()) {
+    return result_map;
+  }
+
+  int output_size = 1;
+  for (const UnpackedProbabilityMassFunction* input : inputs) {
+    if (input->items.empty()) {
+      return UnpackedProbabilityMassFunction();
+    }
+    output_size += input->items.size() - 1;
+    result_map.min_key += input->min_key;
+  }
+
+  std::shared_ptr<const FftBackend> fft = GetCachedFftPlan(output_size);
+  const int real_size = fft->EfficientRealSize();
+  const int complex_size = fft->ComplexSize();
+
+  std::vector<double> input_vector(real_size);
+  std::vector<complex<double>> input_transformed(complex_size);
+  std::vector<complex<double>> convolution_transformed(complex_size, 1.0);
+  for (const UnpackedProbabilityMassFunction* input : inputs) {
+    absl::c_fill(input_vector, 0.0);
+    absl::c_copy(input->items, input_vector.begin());
+    fft->ForwardTransform(input_vector.data(), input_transformed.data());
+    for (int i = 0; i < complex_size; ++i) {
+      convolution_transformed[i] *= input_transformed[i];
+    }
+  }
+
+  std::vector<double> result_vector(real_size, 0.0);
+  fft->InverseTransform(convolution_transformed.data(), result_vector.data());
+  result_map.items.resize(output_size);
+  for (int i = 0; i < output_size; ++i) {
+    result_map.items[i] = result_vector[i] / real_size;
+  }
+  return TruncateProbabilityMassFunction(result_map, tail_mass_truncation);
 }
 
 ConvolutionTruncationBounds ComputeConvolutionTruncationBounds(
@@ -169,22 +307,31 @@ ConvolutionTruncationBounds ComputeConvolutionTruncationBounds(
 
 ProbabilityMassFunction Convolve(const ProbabilityMassFunction& x,
                                  int num_times, double tail_mass_truncation) {
-  UnpackedProbabilityMassFunction x_map = UnpackProbabilityMassFunction(x);
+  return CreateProbabilityMassFunction(Convolve(
+      UnpackProbabilityMassFunction(x), num_times, tail_mass_truncation));
+}
+
+UnpackedProbabilityMassFunction Convolve(
+    const UnpackedProbabilityMassFunction& x_map, int num_times,
+    double tail_mass_truncation) {
+  if (x_map.items.empty()) {
+    return UnpackedProbabilityMassFunction();
+  }
 
   const ConvolutionTruncationBounds truncation_bounds =
       ComputeConvolutionTruncationBounds(x_map, num_times,
                                          tail_mass_truncation);
   const int output_size =
       truncation_bounds.upper_bound - truncation_bounds.lower_bound + 1;
-  KissFftWrapper wrapper(output_size);
-  const int real_size = wrapper.EfficientRealSize();
-  const int complex_size = wrapper.ComplexSize();
+  std::shared_ptr<const FftBackend> fft = GetCachedFftPlan(output_size);
+  const int real_size = fft->EfficientRealSize();
+  const int complex_size = fft->ComplexSize();
 
   std::vector<double> x_input(real_size, 0.0);
   absl::c_copy(x_map.items, x_input.begin());
 
   std::vector<complex<double>> x_transformed(complex_size, 0.0);
-  wrapper.ForwardTransform(x_input.data(), x_transformed.data());
+  fft->ForwardTransform(x_input.data(), x_transformed.data());
 
   std::vector<complex<double>> convolution_transformed;
   convolution_transformed.reserve(x_transformed.size());
@@ -193,8 +340,7 @@ ProbabilityMassFunction Convolve(const ProbabilityMassFunction& x,
   }
 
   std::vector<double> result_vector(real_size, 0.0);
-  wrapper.InverseTransform(convolution_transformed.data(),
-                           result_vector.data());
+  fft->InverseTransform(convolution_transformed.data(), result_vector.data());
 
   UnpackedProbabilityMassFunction result_map;
   result_map.min_key =
@@ -208,7 +354,36 @@ ProbabilityMassFunction Convolve(const ProbabilityMassFunction& x,
         real_size);
   }
 
-  return CreateProbabilityMassFunction(result_map);
+  return TruncateProbabilityMassFunction(result_map);
+}
+
+UnpackedProbabilityMassFunction ConvolveBySquaring(
+    const UnpackedProbabilityMassFunction& x, int num_times,
+    double tail_mass_truncation) {
+  if (num_times == 0) {
+    return UnpackedProbabilityMassFunction{0, {1}};
+  }
+
+  // Squarings for all bits below the highest one, and one multiplication for
+  // every other bit that is set.
+  const int num_steps = absl::bit_width(static_cast<unsigned>(num_times)) - 1 +
+                        absl::popcount(static_cast<unsigned>(num_times)) - 1;
+  const double step_tail_mass_truncation =
+      num_steps > 0 ? tail_mass_truncation / num_steps : tail_mass_truncation;
+
+  std::optional<UnpackedProbabilityMassFunction> result;
+  UnpackedProbabilityMassFunction power = x;
+  while (true) {
+    if (num_times & 1) {
+      result = result.has_value()
+                   ? Convolve(*result, power, step_tail_mass_truncation)
+                   : power;
+    }
+    num_times >>= 1;
+    if (num_times == 0) break;
+    power = Convolve(power, power, step_tail_mass_truncation);
+  }
+  return TruncateProbabilityMassFunction(*result);
 }
 }  // namespace accounting
 }  // namespace differential_privacy
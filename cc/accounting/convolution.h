@@ -18,6 +18,7 @@
 #include <vector>
 
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "accounting/common/common.h"
 
 namespace differential_privacy {
@@ -26,7 +27,7 @@ namespace accounting {
 // An "unpacked" representation of a probability distribution over integers.
 // items[i] = p means that the probability mass at min_key + i is equal to p.
 struct UnpackedProbabilityMassFunction {
-  int min_key;
+  int min_key = 0;
   std::vector<double> items;
 };
 
@@ -38,10 +39,28 @@ struct UnpackedProbabilityMassFunction {
 UnpackedProbabilityMassFunction UnpackProbabilityMassFunction(
     const ProbabilityMassFunction& input);
 
+// Truncates the tails of an unpacked probability mass function and sets
+// non-positive masses to zero. The items of the result start and end with a
+// positive mass, or are empty if no positive mass is left. Additional
+// parameter:
+//   |tail_mass_truncation|: an upper bound on the tails of the output
+//     probability mass that might be truncated.
+UnpackedProbabilityMassFunction TruncateProbabilityMassFunction(
+    const UnpackedProbabilityMassFunction& input,
+    double tail_mass_truncation = 0);
+
+// Re-bins an unpacked probability mass function to keys that are factor times
+// coarser: the mass of key k moves to key ceil(k / factor) if round_up is set
+// and to floor(k / factor) otherwise. The result has about 1 / factor as many
+// items. factor must be positive.
+UnpackedProbabilityMassFunction CoarsenProbabilityMassFunction(
+    const UnpackedProbabilityMassFunction& input, int factor, bool round_up);
+
 // Creates probability mass function from its unpacked form and an additional
 // parameter:
 //   |tail_mass_truncation|: an upper bound on the tails of the output
 //     probability mass that might be truncated.
+// Only keys with a positive mass are included in the output.
 ProbabilityMassFunction CreateProbabilityMassFunction(
     const UnpackedProbabilityMassFunction& input,
     double tail_mass_truncation = 0);
@@ -54,6 +73,34 @@ ProbabilityMassFunction Convolve(const ProbabilityMassFunction& x,
                                  const ProbabilityMassFunction& y,
                                  double tail_mass_truncation = 0);
 
+// Same as above for unpacked probability mass functions, which avoids
+// converting the inputs and the output from and to hash maps. The output is
+// truncated as by TruncateProbabilityMassFunction.
+UnpackedProbabilityMassFunction Convolve(
+    const UnpackedProbabilityMassFunction& x,
+    const UnpackedProbabilityMassFunction& y, double tail_mass_truncation = 0);
+
+// Same as above for masses at x_min_key + i and y_min_key + i given as spans,
+// so that masses held in other buffers, e.g., NumPy arrays, need not be copied
+// into an UnpackedProbabilityMassFunction first.
+UnpackedProbabilityMassFunction Convolve(int x_min_key,
+                                         absl::Span<const double> x_items,
+                                         int y_min_key,
+                                         absl::Span<const double> y_items,
+                                         double tail_mass_truncation = 0);
+
+// Returns the convolution of all given probability mass functions. Each input
+// is transformed once at the size of the full output and the spectra are
+// multiplied, so the cost is one forward transform per input plus a single
+// inverse transform, instead of one convolution per input. The tails are only
+// truncated once, on the final output, as by TruncateProbabilityMassFunction.
+// Returns the unit mass at 0 when there are no inputs. Additional parameter:
+//   |tail_mass_truncation|: an upper bound on the tails of the output
+//     probability mass that might be truncated.
+UnpackedProbabilityMassFunction ConvolveAll(
+    absl::Span<const UnpackedProbabilityMassFunction* const> inputs,
+    double tail_mass_truncation = 0);
+
 // Representation of bounds for truncation in convolution.
 struct ConvolutionTruncationBounds {
   int64_t lower_bound;
@@ -78,6 +125,22 @@ ConvolutionTruncationBounds ComputeConvolutionTruncationBounds(
 ProbabilityMassFunction Convolve(const ProbabilityMassFunction& x,
                                  int num_times,
                                  double tail_mass_truncation = 0);
+
+// Same as above for an unpacked probability mass function.
+UnpackedProbabilityMassFunction Convolve(
+    const UnpackedProbabilityMassFunction& x, int num_times,
+    double tail_mass_truncation = 0);
+
+// Returns convolution of probability mass function with itself num_times,
+// computed by repeated squaring. Unlike Convolve above, the tails are truncated
+// after every squaring and multiplication, so the FFT size is bounded by the
+// truncated support of the intermediate results instead of by the worst-case
+// support of the output. Each of the O(log(num_times)) steps may truncate an
+// equal share of |tail_mass_truncation|, so the total truncated mass is at
+// most |tail_mass_truncation|. Returns the unit mass at 0 if num_times is 0.
+UnpackedProbabilityMassFunction ConvolveBySquaring(
+    const UnpackedProbabilityMassFunction& x, int num_times,
+    double tail_mass_truncation = 0);
 }  // namespace accounting
 }  // namespace differential_privacy
 
@@ -21,6 +21,7 @@
 namespace differential_privacy {
 namespace accounting {
 namespace {
+using ::testing::DoubleEq;
 using ::testing::DoubleNear;
 using ::testing::Each;
 using ::testing::ElementsAre;
@@ -97,6 +98,148 @@ TEST(Convolution, CreateProbabilityMassFunctionTruncationAll) {
   EXPECT_THAT(result, IsEmpty());
 }
 
+TEST(Convolution, TruncateProbabilityMassFunction) {
+  UnpackedProbabilityMassFunction input = {1, {0, -1e-18, 0.2, 0, 0.8, 0}};
+
+  UnpackedProbabilityMassFunction result =
+      TruncateProbabilityMassFunction(input);
+
+  EXPECT_EQ(result.min_key, 3);
+  EXPECT_THAT(result.items, ElementsAre(0.2, 0, 0.8));
+}
+
+TEST(Convolution, TruncateProbabilityMassFunctionTruncationAll) {
+  UnpackedProbabilityMassFunction input = {1, {0.4, 0.5, 0.1}};
+
+  EXPECT_THAT(TruncateProbabilityMassFunction(input, 3).items, IsEmpty());
+  EXPECT_THAT(TruncateProbabilityMassFunction({}).items, IsEmpty());
+}
+
+TEST(Convolution, CoarsenProbabilityMassFunction) {
+  // Keys -3 to 2.
+  UnpackedProbabilityMassFunction input = {-3, {0.1, 0.1, 0.2, 0.2, 0.3, 0.1}};
+
+  UnpackedProbabilityMassFunction rounded_up =
+      CoarsenProbabilityMassFunction(input, 2, /*round_up=*/true);
+  EXPECT_EQ(rounded_up.min_key, -1);
+  EXPECT_THAT(rounded_up.items,
+              ElementsAre(DoubleEq(0.2), DoubleEq(0.4), DoubleEq(0.4)));
+
+  UnpackedProbabilityMassFunction rounded_down =
+      CoarsenProbabilityMassFunction(input, 2, /*round_up=*/false);
+  EXPECT_EQ(rounded_down.min_key, -2);
+  EXPECT_THAT(rounded_down.items, ElementsAre(DoubleEq(0.1), DoubleEq(0.3),
+                                              DoubleEq(0.5), DoubleEq(0.1)));
+
+  EXPECT_THAT(CoarsenProbabilityMassFunction({}, 3, true).items, IsEmpty());
+}
+
+TEST(Convolution, ConvolveUnpacked) {
+  UnpackedProbabilityMassFunction x = {1, {2, 0, 4}};
+  UnpackedProbabilityMassFunction y = {2, {3, 0, 6}};
+
+  UnpackedProbabilityMassFunction result = Convolve(x, y);
+
+  EXPECT_EQ(result.min_key, 3);
+  EXPECT_THAT(result.items,
+              ElementsAre(DoubleNear(6.0, kMaxError), DoubleNear(0, kMaxError),
+                          DoubleNear(24.0, kMaxError),
+                          DoubleNear(0, kMaxError),
+                          DoubleNear(24.0, kMaxError)));
+  EXPECT_THAT(Convolve(x, UnpackedProbabilityMassFunction()).items, IsEmpty());
+}
+
+TEST(Convolution, ConvolveMultipleUnpacked) {
+  UnpackedProbabilityMassFunction x = {-1, {0.5, 0.5}};
+
+  UnpackedProbabilityMassFunction result = Convolve(x, /*num_times=*/2);
+
+  EXPECT_EQ(result.min_key, -2);
+  EXPECT_THAT(result.items, ElementsAre(DoubleNear(0.25, kMaxError),
+                                        DoubleNear(0.5, kMaxError),
+                                        DoubleNear(0.25, kMaxError)));
+}
+
+TEST(Convolution, ConvolveAllMatchesPairwiseConvolutions) {
+  UnpackedProbabilityMassFunction x = {1, {0.2, 0, 0.8}};
+  UnpackedProbabilityMassFunction y = {-2, {0.5, 0.5}};
+  UnpackedProbabilityMassFunction z = {0, {0.1, 0.3, 0.6}};
+
+  UnpackedProbabilityMassFunction result = ConvolveAll({&x, &y, &z});
+  UnpackedProbabilityMassFunction expected = Convolve(Convolve(x, y), z);
+
+  EXPECT_EQ(result.min_key, expected.min_key);
+  ASSERT_EQ(result.items.size(), expected.items.size());
+  for (int i = 0; i < expected.items.size(); ++i) {
+    EXPECT_NEAR(result.items[i], expected.items[i], kMaxError);
+  }
+}
+
+TEST(Convolution, ConvolveAllEdgeCases) {
+  UnpackedProbabilityMassFunction x = {3, {0.4, 0.6}};
+  UnpackedProbabilityMassFunction empty;
+
+  UnpackedProbabilityMassFunction identity = ConvolveAll({});
+  EXPECT_EQ(identity.min_key, 0);
+  EXPECT_THAT(identity.items, ElementsAre(1));
+  UnpackedProbabilityMassFunction single = ConvolveAll({&x});
+  EXPECT_EQ(single.min_key, 3);
+  EXPECT_THAT(single.items, ElementsAre(DoubleNear(0.4, kMaxError),
+                                        DoubleNear(0.6, kMaxError)));
+  EXPECT_THAT(ConvolveAll({&x, &empty}).items, IsEmpty());
+}
+
+TEST(Convolution, ConvolveAllTruncation) {
+  UnpackedProbabilityMassFunction x = {0, {0.1, 0.8, 0.1}};
+
+  UnpackedProbabilityMassFunction result =
+      ConvolveAll({&x, &x}, /*tail_mass_truncation=*/0.03);
+
+  // The output is [0.01, 0.16, 0.66, 0.16, 0.01] before truncation.
+  EXPECT_EQ(result.min_key, 1);
+  EXPECT_THAT(result.items, ElementsAre(DoubleNear(0.16, kMaxError),
+                                        DoubleNear(0.66, kMaxError),
+                                        DoubleNear(0.16, kMaxError)));
+}
+
+TEST(Convolution, ConvolveBySquaringMatchesConvolve) {
+  UnpackedProbabilityMassFunction x = {-1, {0.2, 0.5, 0.3}};
+
+  for (int num_times : {1, 2, 7, 12}) {
+    UnpackedProbabilityMassFunction result = ConvolveBySquaring(x, num_times);
+    UnpackedProbabilityMassFunction expected = Convolve(x, num_times);
+
+    EXPECT_EQ(result.min_key, expected.min_key);
+    ASSERT_EQ(result.items.size(), expected.items.size());
+    for (int i = 0; i < expected.items.size(); ++i) {
+      EXPECT_NEAR(result.items[i], expected.items[i], kMaxError);
+    }
+  }
+  UnpackedProbabilityMassFunction identity = ConvolveBySquaring(x, 0);
+  EXPECT_EQ(identity.min_key, 0);
+  EXPECT_THAT(identity.items, ElementsAre(1));
+}
+
+TEST(Convolution, ConvolveBySquaringTruncation) {
+  UnpackedProbabilityMassFunction x = {0, {0.5, 0.5}};
+  constexpr int kNumTimes = 10000;
+  constexpr double kTailMassTruncation = 1e-10;
+
+  UnpackedProbabilityMassFunction result =
+      ConvolveBySquaring(x, kNumTimes, kTailMassTruncation);
+
+  // The result is binomial, which is concentrated within a few thousand keys
+  // around the mean instead of on all kNumTimes + 1 keys.
+  EXPECT_LT(result.items.size(), kNumTimes / 4);
+  EXPECT_LE(result.min_key, kNumTimes / 2);
+  EXPECT_GE(result.min_key + result.items.size(), kNumTimes / 2);
+  double total_mass = 0;
+  for (double mass : result.items) {
+    total_mass += mass;
+  }
+  EXPECT_NEAR(total_mass, 1, kTailMassTruncation + kMaxError);
+}
+
 TEST(Convolution, Convolve) {
   ProbabilityMassFunction pmf_x = {{1, 2}, {3, 4}};
   ProbabilityMassFunction pmf_y = {{2, 3}, {4, 6}};
@@ -126,6 +269,23 @@ TEST(Convolution, ConvolveOutputResize) {
   EXPECT_THAT(Convolve(pmf_x, pmf_y), Each(Key(Le(7051))));
 }
 
+TEST(Convolution, ConvolveLargeInputs) {
+  // Large enough for the forward transforms to run on separate threads.
+  constexpr int kSize = 40000;
+  UnpackedProbabilityMassFunction x = {0,
+                                       std::vector<double>(kSize, 1.0 / kSize)};
+  UnpackedProbabilityMassFunction y = {0, std::vector<double>(kSize, 0)};
+  y.items.front() = 0.5;
+  y.items.back() = 0.5;
+
+  UnpackedProbabilityMassFunction result = Convolve(x, y);
+
+  ASSERT_EQ(result.items.size(), 2 * kSize - 1);
+  EXPECT_NEAR(result.items[0], 0.5 / kSize, kMaxError);
+  EXPECT_NEAR(result.items[kSize - 1], 1.0 / kSize, kMaxError);
+  EXPECT_NEAR(result.items[2 * kSize - 2], 0.5 / kSize, kMaxError);
+}
+
 TEST(Convolution, ConvolveMultiple) {
   ProbabilityMassFunction pmf = {{1, 2}, {3, 5}, {4, 6}};
   EXPECT_THAT(Convolve(pmf, 3),
@@ -0,0 +1,49 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_FFT_BACKEND_H_
+#define DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_FFT_BACKEND_H_
+
+#include <complex>
+
+namespace differential_privacy {
+namespace accounting {
+
+// Interface for real(double)->complex FFTs of a fixed size, as used for
+// convolving probability mass functions. An instance is a plan for one size.
+// Implementations may use scratch memory owned by the plan, so a plan must
+// not be used by several threads at the same time.
+class FftBackend {
+ public:
+  virtual ~FftBackend() = default;
+
+  // Returns the FFT size, which is at least the size the plan was requested
+  // for. The caller should pad input up to this size.
+  virtual int EfficientRealSize() const = 0;
+
+  // Returns the number of complex values of a transformed input.
+  virtual int ComplexSize() const = 0;
+
+  // Forward real-to-complex FFT. The input has EfficientRealSize() values and
+  // the output has ComplexSize() values.
+  virtual void ForwardTransform(const double* input,
+                                std::complex<double>* output) const = 0;
+
+  // Inverse complex-to-real FFT without normalization. The input has
+  // ComplexSize() values and the output has EfficientRealSize() values.
+  virtual void InverseTransform(const std::complex<double>* input,
+                                double* output) const = 0;
+};
+}  // namespace accounting
+}  // namespace differential_privacy
+#endif  // DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_FFT_BACKEND_H_
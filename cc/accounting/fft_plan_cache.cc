@@ -0,0 +1,89 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "accounting/fft_plan_cache.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/check.h"
+#include "accounting/fft_backend.h"
+#include "accounting/kiss_fft_wrapper.h"
+
+namespace differential_privacy {
+namespace accounting {
+namespace {
+
+// Maximum number of plans cached per thread. Compositions use a handful of
+// sizes, and each plan holds twiddle factors linear in its size.
+constexpr int kMaxCachedPlans = 16;
+
+FftBackendFactory& Factory() {
+  static auto* factory = new FftBackendFactory();
+  return *factory;
+}
+
+// Incremented by SetFftBackendFactory() so that threads drop plans created by
+// a previous factory.
+std::atomic<int64_t>& FactoryGeneration() {
+  static auto* generation = new std::atomic<int64_t>(0);
+  return *generation;
+}
+
+struct PlanCache {
+  int64_t generation = 0;
+  absl::flat_hash_map<std::pair<int, int>, std::shared_ptr<const FftBackend>>
+      plans;
+};
+
+}  // namespace
+
+void SetFftBackendFactory(FftBackendFactory factory) {
+  Factory() = std::move(factory);
+  ++FactoryGeneration();
+}
+
+std::shared_ptr<const FftBackend> GetCachedFftPlan(int real_size, int slot) {
+  thread_local PlanCache cache;
+  const int64_t generation = FactoryGeneration().load();
+  if (cache.generation != generation) {
+    cache.plans.clear();
+    cache.generation = generation;
+  }
+
+  const std::pair<int, int> key = {real_size, slot};
+  auto it = cache.plans.find(key);
+  if (it != cache.plans.end()) {
+    return it->second;
+  }
+
+  std::shared_ptr<const FftBackend> plan;
+  const FftBackendFactory& factory = Factory();
+  if (factory) {
+    plan = factory(real_size);
+    CHECK(plan != nullptr) << "FFT backend factory returned null";
+  } else {
+    plan = std::make_shared<KissFftWrapper>(real_size);
+  }
+  if (cache.plans.size() >= kMaxCachedPlans) {
+    cache.plans.clear();
+  }
+  cache.plans.emplace(key, plan);
+  return plan;
+}
+}  // namespace accounting
+}  // namespace differential_privacy
@@ -0,0 +1,45 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_FFT_PLAN_CACHE_H_
+#define DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_FFT_PLAN_CACHE_H_
+
+#include <functional>
+#include <memory>
+
+#include "accounting/fft_backend.h"
+
+namespace differential_privacy {
+namespace accounting {
+
+// Creates an FFT plan for inputs of the given size.
+using FftBackendFactory =
+    std::function<std::unique_ptr<FftBackend>(int real_size)>;
+
+// Replaces the factory used by GetCachedFftPlan(), e.g., to plug in an FFT
+// library with SIMD support. Passing nullptr restores the default KISS FFT
+// backend. Plans created by the previous factory are not returned anymore.
+// Must not be called while convolutions are running on other threads.
+void SetFftBackendFactory(FftBackendFactory factory);
+
+// Returns a plan for inputs of the given size, creating it on first use.
+// Plans are cached per thread, so the returned plan is only used by the
+// calling thread unless the caller hands it over explicitly. Plans with
+// different slots are independent, which lets a caller run several transforms
+// of the same size concurrently. The cache holds a bounded number of plans;
+// a returned plan stays usable after it is evicted.
+std::shared_ptr<const FftBackend> GetCachedFftPlan(int real_size,
+                                                   int slot = 0);
+}  // namespace accounting
+}  // namespace differential_privacy
+#endif  // DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_FFT_PLAN_CACHE_H_
@@ -0,0 +1,67 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "accounting/fft_plan_cache.h"
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "accounting/fft_backend.h"
+#include "accounting/kiss_fft_wrapper.h"
+
+namespace differential_privacy {
+namespace accounting {
+namespace {
+
+TEST(FftPlanCache, ReusesPlansBySizeAndSlot) {
+  std::shared_ptr<const FftBackend> plan = GetCachedFftPlan(5);
+  EXPECT_EQ(plan->EfficientRealSize(), 6);
+  EXPECT_EQ(GetCachedFftPlan(5), plan);
+  EXPECT_NE(GetCachedFftPlan(5, /*slot=*/1), plan);
+  EXPECT_NE(GetCachedFftPlan(7), plan);
+}
+
+TEST(FftPlanCache, EvictedPlansStayUsable) {
+  std::shared_ptr<const FftBackend> plan = GetCachedFftPlan(4);
+  for (int size = 100; size < 200; ++size) {
+    GetCachedFftPlan(size);
+  }
+
+  std::vector<double> input = {2, 0, 4, 0};
+  std::vector<std::complex<double>> output(plan->ComplexSize());
+  plan->ForwardTransform(input.data(), output.data());
+  EXPECT_DOUBLE_EQ(output[0].real(), 6);
+}
+
+TEST(FftPlanCache, UsesBackendFactory) {
+  int num_plans_created = 0;
+  SetFftBackendFactory([&num_plans_created](int real_size) {
+    ++num_plans_created;
+    return std::make_unique<KissFftWrapper>(real_size);
+  });
+  std::shared_ptr<const FftBackend> plan = GetCachedFftPlan(10);
+  GetCachedFftPlan(10);
+  EXPECT_EQ(num_plans_created, 1);
+
+  SetFftBackendFactory(nullptr);
+  EXPECT_NE(GetCachedFftPlan(10), plan);
+  EXPECT_EQ(num_plans_created, 1);
+}
+
+}  // namespace
+}  // namespace accounting
+}  // namespace differential_privacy
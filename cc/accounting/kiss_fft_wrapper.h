@@ -19,6 +19,7 @@
 
 #include "absl/log/check.h"
 #include "absl/log/die_if_null.h"
+#include "accounting/fft_backend.h"
 #include "kissfft/kiss_fft.h"
 #include "kissfft/kiss_fftr.h"
 
@@ -28,8 +29,8 @@ namespace accounting {
 // Simple wrapper around KISS FFT library for real(double)->complex
 // transformations. Efficient FFT size is determined from the size of the input
 // and is available as EfficientRealSize member. The caller should pad input up
-// to that size.
-class KissFftWrapper {
+// to that size. This is the default FftBackend.
+class KissFftWrapper : public FftBackend {
  public:
   // Instantiates wrapper with the size of double vector to be transformed.
   explicit KissFftWrapper(int real_size)
@@ -39,21 +40,21 @@ class KissFftWrapper {
             real_size_, 0, nullptr, nullptr))),
         inverse_config_(ABSL_DIE_IF_NULL(::kiss_fftr_alloc(
             real_size_, 1, nullptr, nullptr))) {}
-  virtual ~KissFftWrapper() {
+  ~KissFftWrapper() override {
     ::kiss_fftr_free(forward_config_);
     ::kiss_fftr_free(inverse_config_);
   }
 
   // Returns efficient FFT size.
-  int EfficientRealSize() const { return real_size_; }
+  int EfficientRealSize() const override { return real_size_; }
 
   // Returns complex size.
-  int ComplexSize() const { return complex_size_; }
+  int ComplexSize() const override { return complex_size_; }
 
   // Forward real-to-complex FFT.
   // Caller should allocate buffer the size of EfficientRealSize().
   void ForwardTransform(const double* input,
-                        std::complex<double>* output) const {
+                        std::complex<double>* output) const override {
     CHECK(input);
     CHECK(output);
     kiss_fftr(forward_config_, reinterpret_cast<const kiss_fft_scalar*>(input),
@@ -63,7 +64,7 @@ class KissFftWrapper {
   // Inverse complex-to-real FFT.
   // Caller should allocate buffer the size of EfficientRealSize().
   void InverseTransform(const std::complex<double>* input,
-                        double* output) const {
+                        double* output) const override {
     CHECK(input);
     CHECK(output);
     kiss_fftri(inverse_config_,
@@ -0,0 +1,172 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "accounting/pld_disk_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "absl/functional/function_ref.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "accounting/privacy_loss_distribution.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+namespace accounting {
+
+namespace {
+
+absl::Status ErrnoError(int error_number, absl::string_view message) {
+  return absl::Status(absl::ErrnoToStatusCode(error_number),
+                      absl::StrCat(message, ": ", std::strerror(error_number)));
+}
+
+// Closes a file descriptor and unmaps a memory mapping on destruction.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() {
+    if (data_ != nullptr) munmap(data_, size_);
+    if (fd_ >= 0) close(fd_);
+  }
+
+  absl::Status Open(const std::string& path) {
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) return ErrnoError(errno, absl::StrCat("Cannot open ", path));
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) != 0) {
+      return ErrnoError(errno, absl::StrCat("Cannot stat ", path));
+    }
+    size_ = file_stat.st_size;
+    // mmap fails for empty files; DeserializeBinary rejects them anyway.
+    if (size_ == 0) return absl::OkStatus();
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data == MAP_FAILED) {
+      return ErrnoError(errno, absl::StrCat("Cannot map ", path));
+    }
+    data_ = data;
+    return absl::OkStatus();
+  }
+
+  absl::string_view contents() const {
+    return data_ == nullptr
+               ? absl::string_view()
+               : absl::string_view(static_cast<const char*>(data_), size_);
+  }
+
+ private:
+  int fd_ = -1;
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<PldDiskCache>> PldDiskCache::Create(
+    absl::string_view directory) {
+  std::string path(directory);
+  struct stat directory_stat;
+  if (stat(path.c_str(), &directory_stat) != 0) {
+    return ErrnoError(errno, absl::StrCat("Cannot access ", path));
+  }
+  if (!S_ISDIR(directory_stat.st_mode)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(path, " is not a directory."));
+  }
+  return absl::WrapUnique(new PldDiskCache(std::move(path)));
+}
+
+absl::StatusOr<std::string> PldDiskCache::Path(absl::string_view key) const {
+  if (key.empty() || key.front() == '.') {
+    return absl::InvalidArgumentError(
+        "Keys must not be empty or start with '.'.");
+  }
+  for (char c : key) {
+    if (!absl::ascii_isalnum(c) && c != '-' && c != '_' && c != '.') {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid character in key ", key));
+    }
+  }
+  return absl::StrCat(directory_, "/", key, ".pld");
+}
+
+absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> PldDiskCache::Load(
+    absl::string_view key) const {
+  ASSIGN_OR_RETURN(std::string path, Path(key));
+  MappedFile file;
+  RETURN_IF_ERROR(file.Open(path));
+  return PrivacyLossDistribution::DeserializeBinary(file.contents());
+}
+
+absl::Status PldDiskCache::Store(absl::string_view key,
+                                 const PrivacyLossDistribution& pld) const {
+  ASSIGN_OR_RETURN(std::string path, Path(key));
+  // Write to a file that is unique per process and call, then rename it, so
+  // that readers only ever see complete files.
+  static std::atomic<int> num_stores{0};
+  const std::string temporary_path =
+      absl::StrCat(path, ".tmp.", getpid(), ".", num_stores++);
+  const std::string data = pld.SerializeBinary();
+  {
+    std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+    output.write(data.data(), data.size());
+    output.close();
+    if (!output) {
+      std::remove(temporary_path.c_str());
+      return absl::InternalError(
+          absl::StrCat("Cannot write ", temporary_path));
+    }
+  }
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    const int error_number = errno;
+    std::remove(temporary_path.c_str());
+    return ErrnoError(error_number, absl::StrCat("Cannot rename to ", path));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>>
+PldDiskCache::GetOrCreate(
+    absl::string_view key,
+    absl::FunctionRef<
+        absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>>()>
+        create) const {
+  absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> pld = Load(key);
+  if (!absl::IsNotFound(pld.status())) {
+    return pld;
+  }
+  ASSIGN_OR_RETURN(std::unique_ptr<PrivacyLossDistribution> created,
+                   create());
+  RETURN_IF_ERROR(Store(key, *created));
+  return created;
+}
+
+}  // namespace accounting
+}  // namespace differential_privacy
@@ -0,0 +1,75 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_PLD_DISK_CACHE_H_
+#define DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_PLD_DISK_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "accounting/privacy_loss_distribution.h"
+
+namespace differential_privacy {
+namespace accounting {
+
+// On-disk cache of privacy loss distributions, so that services do not have to
+// recompute the PLDs of standard mechanism configurations on every start.
+//
+// Each PLD is stored under a caller-chosen key in its own file, in the format
+// of PrivacyLossDistribution::SerializeBinary. Files are memory-mapped for
+// loading and written atomically, so concurrent readers never observe a
+// partially written PLD. Keys must identify everything the PLD depends on
+// (mechanism, parameters, discretization, compositions); the cache does not
+// validate them against the stored PLD.
+class PldDiskCache {
+ public:
+  // Creates a cache in an existing directory.
+  static absl::StatusOr<std::unique_ptr<PldDiskCache>> Create(
+      absl::string_view directory);
+
+  // Loads the PLD stored under key. Returns NotFoundError if there is none.
+  absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> Load(
+      absl::string_view key) const;
+
+  // Stores the PLD under key, replacing any PLD stored under it before.
+  absl::Status Store(absl::string_view key,
+                     const PrivacyLossDistribution& pld) const;
+
+  // Loads the PLD stored under key, or creates it with create and stores it.
+  absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> GetOrCreate(
+      absl::string_view key,
+      absl::FunctionRef<
+          absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>>()>
+          create) const;
+
+  // Returns the file in which the PLD for key is stored. Keys may only
+  // contain ASCII letters, digits, '-', '_' and '.', and must not start with
+  // '.'.
+  absl::StatusOr<std::string> Path(absl::string_view key) const;
+
+ private:
+  explicit PldDiskCache(std::string directory)
+      : directory_(std::move(directory)) {}
+
+  const std::string directory_;
+};
+
+}  // namespace accounting
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_PLD_DISK_CACHE_H_
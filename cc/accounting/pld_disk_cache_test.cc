@@ -0,0 +1,133 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "accounting/pld_disk_cache.h"
+
+#include <stdlib.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "accounting/common/common.h"
+#include "accounting/common/test_util.h"
+#include "accounting/privacy_loss_distribution.h"
+#include "base/testing/status_matchers.h"
+
+namespace differential_privacy {
+namespace accounting {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+
+constexpr double kMaxError = 1e-12;
+
+std::unique_ptr<PrivacyLossDistribution> CreateTestPld() {
+  return PrivacyLossDistribution::CreateForRandomizedResponse(
+             /*noise_parameter=*/0.5, /*num_buckets=*/4,
+             EstimateType::kPessimistic, /*discretization_interval=*/0.1)
+      .value();
+}
+
+// Creates a cache in a fresh directory, so that tests do not see PLDs stored
+// by other tests or earlier runs.
+std::unique_ptr<PldDiskCache> CreateCache() {
+  std::string directory = ::testing::TempDir() + "/pld_disk_cache_XXXXXX";
+  EXPECT_NE(mkdtemp(directory.data()), nullptr);
+  absl::StatusOr<std::unique_ptr<PldDiskCache>> cache =
+      PldDiskCache::Create(directory);
+  EXPECT_OK(cache);
+  return std::move(cache).value();
+}
+
+TEST(PldDiskCacheTest, StoreAndLoad) {
+  std::unique_ptr<PldDiskCache> cache = CreateCache();
+  std::unique_ptr<PrivacyLossDistribution> pld = CreateTestPld();
+
+  ASSERT_OK(cache->Store("randomized_response-0.5", *pld));
+  absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> loaded =
+      cache->Load("randomized_response-0.5");
+  ASSERT_OK(loaded);
+
+  EXPECT_THAT((*loaded)->Pmf(), PMFIsNear(pld->Pmf(), kMaxError));
+  EXPECT_EQ((*loaded)->InfinityMass(), pld->InfinityMass());
+  EXPECT_EQ((*loaded)->DiscretizationInterval(),
+            pld->DiscretizationInterval());
+}
+
+TEST(PldDiskCacheTest, LoadMissingKey) {
+  std::unique_ptr<PldDiskCache> cache = CreateCache();
+
+  EXPECT_THAT(cache->Load("missing"), StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(PldDiskCacheTest, GetOrCreateCreatesOnce) {
+  std::unique_ptr<PldDiskCache> cache = CreateCache();
+  int num_creations = 0;
+  auto create =
+      [&]() -> absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> {
+    ++num_creations;
+    return CreateTestPld();
+  };
+
+  absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> created =
+      cache->GetOrCreate("get_or_create", create);
+  ASSERT_OK(created);
+  absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> loaded =
+      cache->GetOrCreate("get_or_create", create);
+  ASSERT_OK(loaded);
+
+  EXPECT_EQ(num_creations, 1);
+  EXPECT_THAT((*loaded)->Pmf(), PMFIsNear((*created)->Pmf(), kMaxError));
+}
+
+TEST(PldDiskCacheTest, GetOrCreatePropagatesError) {
+  std::unique_ptr<PldDiskCache> cache = CreateCache();
+
+  EXPECT_THAT(
+      cache->GetOrCreate(
+          "failed_creation",
+          []() -> absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> {
+            return absl::InternalError("creation failed");
+          }),
+      StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(cache->Load("failed_creation"),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(PldDiskCacheTest, InvalidKeys) {
+  std::unique_ptr<PldDiskCache> cache = CreateCache();
+  std::unique_ptr<PrivacyLossDistribution> pld = CreateTestPld();
+
+  for (const char* key :
+       {"", ".hidden", "a/b", "../escape", "key with space"}) {
+    EXPECT_THAT(cache->Store(key, *pld),
+                StatusIs(absl::StatusCode::kInvalidArgument));
+    EXPECT_THAT(cache->Load(key),
+                StatusIs(absl::StatusCode::kInvalidArgument));
+  }
+}
+
+TEST(PldDiskCacheTest, CreateMissingDirectory) {
+  EXPECT_THAT(
+      PldDiskCache::Create(::testing::TempDir() + "/does/not/exist"),
+      StatusIs(absl::StatusCode::kNotFound));
+}
+
+}  // namespace
+}  // namespace accounting
+}  // namespace differential_privacy
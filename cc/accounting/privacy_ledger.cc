@@ -0,0 +1,189 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "accounting/privacy_ledger.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "accounting/common/common.h"
+#include "accounting/privacy_loss_distribution.h"
+#include "accounting/privacy_loss_mechanism.h"
+#include "accounting/rdp_accountant.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+namespace accounting {
+
+namespace {
+
+// Returns the cached value for key, or computes, caches and returns it.
+template <typename Compute>
+double GetOrCompute(absl::Mutex& mutex,
+                    absl::flat_hash_map<double, double>& cache,
+                    int max_cached_values, double key, Compute compute) {
+  // NaN keys never compare equal, so they would only fill the cache.
+  if (std::isnan(key)) {
+    return compute();
+  }
+  {
+    absl::MutexLock lock(&mutex);
+    auto it = cache.find(key);
+    if (it != cache.end()) return it->second;
+  }
+  const double value = compute();
+  absl::MutexLock lock(&mutex);
+  if (cache.size() >= max_cached_values) {
+    cache.clear();
+  }
+  cache.emplace(key, value);
+  return value;
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<PrivacyLedger>> PrivacyLedger::Create() {
+  return Create(Options());
+}
+
+absl::StatusOr<std::unique_ptr<PrivacyLedger>> PrivacyLedger::Create(
+    Options options) {
+  if (!(options.discretization_interval > 0)) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("discretization_interval must be positive, but got %lf",
+                        options.discretization_interval));
+  }
+  if (!(options.tail_mass_truncation >= 0 &&
+        options.tail_mass_truncation < 1)) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("tail_mass_truncation must be in [0, 1), but got %lf",
+                        options.tail_mass_truncation));
+  }
+  ASSIGN_OR_RETURN(std::unique_ptr<RdpAccountant> rdp,
+                   RdpAccountant::Create());
+  return absl::WrapUnique(new PrivacyLedger(
+      options,
+      PrivacyLossDistribution::CreateIdentity(options.discretization_interval,
+                                              options.estimate_type),
+      std::move(rdp)));
+}
+
+std::unique_ptr<PrivacyLossDistribution> PrivacyLedger::CreatePld(
+    const AdditiveNoisePrivacyLoss& mechanism, int num_times) const {
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(
+          mechanism, options_.estimate_type, options_.discretization_interval);
+  if (num_times > 1) {
+    pld->Compose(num_times, options_.tail_mass_truncation);
+  }
+  return pld;
+}
+
+absl::Status PrivacyLedger::Append(const AdditiveNoisePrivacyLoss& mechanism,
+                                   int num_times) {
+  if (num_times < 0) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "num_times must be non-negative, but got %d", num_times));
+  }
+  if (num_times == 0) {
+    return absl::OkStatus();
+  }
+  // Discretizing the mechanism is the expensive part, so do it before locking.
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      CreatePld(mechanism, num_times);
+
+  absl::MutexLock lock(&mutex_);
+  RETURN_IF_ERROR(ComposeLocked(*pld, num_times));
+  if (rdp_ != nullptr && !rdp_->Compose(mechanism, num_times).ok()) {
+    rdp_.reset();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status PrivacyLedger::Append(const PrivacyLossDistribution& pld) {
+  absl::MutexLock lock(&mutex_);
+  RETURN_IF_ERROR(ComposeLocked(pld, 1));
+  rdp_.reset();
+  return absl::OkStatus();
+}
+
+absl::Status PrivacyLedger::ComposeLocked(const PrivacyLossDistribution& pld,
+                                          int num_mechanisms) {
+  RETURN_IF_ERROR(pld_->Compose(pld, options_.tail_mass_truncation));
+  num_mechanisms_ += num_mechanisms;
+
+  absl::MutexLock lock(&cache_mutex_);
+  epsilon_for_delta_cache_.clear();
+  delta_for_epsilon_cache_.clear();
+  return absl::OkStatus();
+}
+
+absl::StatusOr<bool> PrivacyLedger::Fits(
+    const AdditiveNoisePrivacyLoss& mechanism, EpsilonDelta budget) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  // The RDP bound is an upper bound of the PLD one, so a query that fits by
+  // RDP also fits by PLD.
+  if (rdp_ != nullptr) {
+    RdpAccountant rdp = *rdp_;
+    if (rdp.Compose(mechanism).ok()) {
+      absl::StatusOr<double> rdp_delta = rdp.GetDeltaForEpsilon(budget.epsilon);
+      if (rdp_delta.ok() && *rdp_delta <= budget.delta) {
+        return true;
+      }
+    }
+  }
+
+  std::unique_ptr<PrivacyLossDistribution> pld = CreatePld(mechanism, 1);
+  ASSIGN_OR_RETURN(double delta, pld_->GetDeltaForEpsilonForComposedPLD(
+                                     *pld, budget.epsilon));
+  if (options_.estimate_type == EstimateType::kPessimistic) {
+    // Appending the mechanism would treat the truncated tails as infinite
+    // privacy loss.
+    delta += options_.tail_mass_truncation;
+  }
+  return delta <= budget.delta;
+}
+
+double PrivacyLedger::GetEpsilonForDelta(double delta) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  return GetOrCompute(
+      cache_mutex_, epsilon_for_delta_cache_, kMaxCachedValues, delta,
+      [this, delta]() ABSL_NO_THREAD_SAFETY_ANALYSIS {
+        return pld_->GetEpsilonForDelta(delta);
+      });
+}
+
+double PrivacyLedger::GetDeltaForEpsilon(double epsilon) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  return GetOrCompute(
+      cache_mutex_, delta_for_epsilon_cache_, kMaxCachedValues, epsilon,
+      [this, epsilon]() ABSL_NO_THREAD_SAFETY_ANALYSIS {
+        return pld_->GetDeltaForEpsilon(epsilon);
+      });
+}
+
+int64_t PrivacyLedger::NumMechanisms() const {
+  absl::ReaderMutexLock lock(&mutex_);
+  return num_mechanisms_;
+}
+
+}  // namespace accounting
+}  // namespace differential_privacy
@@ -0,0 +1,127 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_PRIVACY_LEDGER_H_
+#define DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_PRIVACY_LEDGER_H_
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "accounting/common/common.h"
+#include "accounting/privacy_loss_distribution.h"
+#include "accounting/privacy_loss_mechanism.h"
+#include "accounting/rdp_accountant.h"
+
+namespace differential_privacy {
+namespace accounting {
+
+// Long-lived record of the mechanisms a service has run so far, for checking
+// the remaining privacy budget before answering each query.
+//
+// The ledger keeps the composed PrivacyLossDistribution, so appending a
+// mechanism costs one convolution instead of recomposing all mechanisms. It
+// also keeps the RDP of the appended mechanisms while all of them are
+// supported by RdpAccountant, which lets Fits() accept most queries that are
+// well within budget without touching the PLD. Results of
+// GetEpsilonForDelta() and GetDeltaForEpsilon() are cached until the next
+// append.
+//
+// All methods are thread-safe. Queries only take a reader lock, so concurrent
+// budget checks do not block each other.
+class PrivacyLedger {
+ public:
+  struct Options {
+    // Estimate type and discretization interval of the PLDs created for
+    // appended mechanisms. See PrivacyLossDistribution::CreateForAdditiveNoise.
+    EstimateType estimate_type = EstimateType::kPessimistic;
+    double discretization_interval = 1e-4;
+    // Tail mass truncated on every composition.
+    double tail_mass_truncation = 1e-15;
+  };
+
+  static absl::StatusOr<std::unique_ptr<PrivacyLedger>> Create();
+  static absl::StatusOr<std::unique_ptr<PrivacyLedger>> Create(
+      Options options);
+
+  PrivacyLedger(const PrivacyLedger&) = delete;
+  PrivacyLedger& operator=(const PrivacyLedger&) = delete;
+
+  // Appends the mechanism num_times.
+  absl::Status Append(const AdditiveNoisePrivacyLoss& mechanism,
+                      int num_times = 1) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Appends a mechanism given by its PLD, which must have been created with
+  // the estimate type and discretization interval of this ledger. Since the
+  // RDP of such a mechanism is unknown, Fits() only uses the PLD afterwards.
+  absl::Status Append(const PrivacyLossDistribution& pld)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns whether appending the mechanism would keep the ledger
+  // (budget.epsilon, budget.delta)-DP, without appending it.
+  absl::StatusOr<bool> Fits(const AdditiveNoisePrivacyLoss& mechanism,
+                            EpsilonDelta budget) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Same as the corresponding methods of PrivacyLossDistribution, for the
+  // composition of all appended mechanisms.
+  double GetEpsilonForDelta(double delta) const ABSL_LOCKS_EXCLUDED(mutex_);
+  double GetDeltaForEpsilon(double epsilon) const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the number of appended mechanisms, counting repetitions.
+  int64_t NumMechanisms() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // Maximum number of values per cache. The caches are cleared when they are
+  // full, which only happens if callers query many different parameters.
+  static constexpr int kMaxCachedValues = 64;
+
+  PrivacyLedger(Options options, std::unique_ptr<PrivacyLossDistribution> pld,
+                std::unique_ptr<RdpAccountant> rdp)
+      : options_(options), pld_(std::move(pld)), rdp_(std::move(rdp)) {}
+
+  // Creates the PLD of the mechanism composed num_times.
+  std::unique_ptr<PrivacyLossDistribution> CreatePld(
+      const AdditiveNoisePrivacyLoss& mechanism, int num_times) const;
+
+  // Composes the PLD into the ledger and invalidates the caches.
+  absl::Status ComposeLocked(const PrivacyLossDistribution& pld,
+                             int num_mechanisms)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const Options options_;
+
+  mutable absl::Mutex mutex_;
+  std::unique_ptr<PrivacyLossDistribution> pld_ ABSL_GUARDED_BY(mutex_);
+  // Null once a mechanism without an RDP formula has been appended.
+  std::unique_ptr<RdpAccountant> rdp_ ABSL_GUARDED_BY(mutex_);
+  int64_t num_mechanisms_ ABSL_GUARDED_BY(mutex_) = 0;
+
+  // Acquired after mutex_, so that readers holding a reader lock on mutex_ can
+  // fill the caches.
+  mutable absl::Mutex cache_mutex_ ABSL_ACQUIRED_AFTER(mutex_);
+  mutable absl::flat_hash_map<double, double> epsilon_for_delta_cache_
+      ABSL_GUARDED_BY(cache_mutex_);
+  mutable absl::flat_hash_map<double, double> delta_for_epsilon_cache_
+      ABSL_GUARDED_BY(cache_mutex_);
+};
+
+}  // namespace accounting
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_PRIVACY_LEDGER_H_
@@ -0,0 +1,165 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "accounting/privacy_ledger.h"
+
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "accounting/common/common.h"
+#include "accounting/privacy_loss_distribution.h"
+#include "accounting/privacy_loss_mechanism.h"
+#include "base/testing/status_matchers.h"
+
+namespace differential_privacy {
+namespace accounting {
+namespace {
+
+using ::differential_privacy::base::testing::IsOkAndHolds;
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::DoubleNear;
+
+constexpr double kDelta = 1e-5;
+
+std::unique_ptr<AdditiveNoisePrivacyLoss> Gaussian(double standard_deviation) {
+  return GaussianPrivacyLoss::Create(standard_deviation, /*sensitivity=*/1)
+      .value();
+}
+
+std::unique_ptr<AdditiveNoisePrivacyLoss> Laplace(double parameter) {
+  return LaplacePrivacyLoss::Create(parameter, /*sensitivity=*/1).value();
+}
+
+TEST(PrivacyLedgerTest, AppendMatchesComposedPld) {
+  std::unique_ptr<PrivacyLedger> ledger = PrivacyLedger::Create().value();
+  std::unique_ptr<AdditiveNoisePrivacyLoss> laplace = Laplace(5);
+  std::unique_ptr<AdditiveNoisePrivacyLoss> gaussian = Gaussian(3);
+  ASSERT_OK(ledger->Append(*laplace));
+  ASSERT_OK(ledger->Append(*gaussian, /*num_times=*/3));
+
+  std::unique_ptr<PrivacyLossDistribution> expected =
+      PrivacyLossDistribution::CreateForAdditiveNoise(*gaussian);
+  expected->Compose(3);
+  ASSERT_OK(expected->Compose(
+      *PrivacyLossDistribution::CreateForAdditiveNoise(*laplace)));
+
+  EXPECT_EQ(ledger->NumMechanisms(), 4);
+  EXPECT_THAT(ledger->GetEpsilonForDelta(kDelta),
+              DoubleNear(expected->GetEpsilonForDelta(kDelta), 1e-3));
+  EXPECT_THAT(ledger->GetDeltaForEpsilon(1),
+              DoubleNear(expected->GetDeltaForEpsilon(1), 1e-9));
+}
+
+TEST(PrivacyLedgerTest, CachedResultsUpdateOnAppend) {
+  std::unique_ptr<PrivacyLedger> ledger = PrivacyLedger::Create().value();
+  EXPECT_EQ(ledger->GetEpsilonForDelta(kDelta), 0);
+  EXPECT_EQ(ledger->GetDeltaForEpsilon(0), 0);
+
+  ASSERT_OK(ledger->Append(*Laplace(1)));
+  const double epsilon = ledger->GetEpsilonForDelta(kDelta);
+  EXPECT_THAT(epsilon, DoubleNear(1, 1e-3));
+  EXPECT_EQ(ledger->GetEpsilonForDelta(kDelta), epsilon);
+  const double delta = ledger->GetDeltaForEpsilon(0.5);
+  EXPECT_GT(delta, 0);
+
+  ASSERT_OK(ledger->Append(*Laplace(1)));
+  EXPECT_GT(ledger->GetEpsilonForDelta(kDelta), epsilon);
+  EXPECT_GT(ledger->GetDeltaForEpsilon(0.5), delta);
+}
+
+TEST(PrivacyLedgerTest, FitsMatchesAppending) {
+  std::unique_ptr<AdditiveNoisePrivacyLoss> gaussian = Gaussian(5);
+  std::unique_ptr<PrivacyLedger> ledger = PrivacyLedger::Create().value();
+  ASSERT_OK(ledger->Append(*gaussian, /*num_times=*/10));
+  std::unique_ptr<PrivacyLedger> appended = PrivacyLedger::Create().value();
+  ASSERT_OK(appended->Append(*gaussian, /*num_times=*/10));
+  ASSERT_OK(appended->Append(*gaussian));
+  const double epsilon = appended->GetEpsilonForDelta(kDelta);
+
+  // Budgets this close to the PLD epsilon are decided by the PLD, since the
+  // RDP bound is looser.
+  EXPECT_THAT(ledger->Fits(*gaussian, {1.01 * epsilon, kDelta}),
+              IsOkAndHolds(true));
+  EXPECT_THAT(ledger->Fits(*gaussian, {0.99 * epsilon, kDelta}),
+              IsOkAndHolds(false));
+  EXPECT_THAT(ledger->Fits(*gaussian, {10 * epsilon, kDelta}),
+              IsOkAndHolds(true));
+  EXPECT_EQ(ledger->NumMechanisms(), 10);
+}
+
+TEST(PrivacyLedgerTest, AppendPld) {
+  std::unique_ptr<PrivacyLedger> ledger = PrivacyLedger::Create().value();
+  ASSERT_OK(ledger->Append(*PrivacyLossDistribution::CreateForPrivacyParameters(
+      {/*epsilon=*/1, /*delta=*/0})));
+
+  EXPECT_THAT(ledger->GetEpsilonForDelta(kDelta), DoubleNear(1, 1e-3));
+  EXPECT_THAT(ledger->Fits(*Laplace(1), {2.1, kDelta}), IsOkAndHolds(true));
+  EXPECT_THAT(ledger->Fits(*Laplace(1), {1.9, kDelta}), IsOkAndHolds(false));
+  EXPECT_THAT(
+      ledger->Append(*PrivacyLossDistribution::CreateIdentity(
+          /*discretization_interval=*/1e-3)),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               ::testing::HasSubstr("discretization interval")));
+  EXPECT_EQ(ledger->NumMechanisms(), 1);
+}
+
+TEST(PrivacyLedgerTest, ConcurrentReadersAndWriter) {
+  std::unique_ptr<PrivacyLedger> ledger = PrivacyLedger::Create().value();
+  std::unique_ptr<AdditiveNoisePrivacyLoss> gaussian = Gaussian(20);
+  constexpr int kNumAppends = 20;
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&ledger, &gaussian]() {
+      for (int j = 0; j < 20; ++j) {
+        EXPECT_GE(ledger->GetEpsilonForDelta(kDelta), 0);
+        EXPECT_OK(ledger->Fits(*gaussian, {1, kDelta}));
+      }
+    });
+  }
+  for (int i = 0; i < kNumAppends; ++i) {
+    ASSERT_OK(ledger->Append(*gaussian));
+  }
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(ledger->NumMechanisms(), kNumAppends);
+}
+
+TEST(PrivacyLedgerTest, Errors) {
+  PrivacyLedger::Options options;
+  options.discretization_interval = 0;
+  EXPECT_THAT(PrivacyLedger::Create(options),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  options = PrivacyLedger::Options();
+  options.tail_mass_truncation = -1;
+  EXPECT_THAT(PrivacyLedger::Create(options),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  std::unique_ptr<PrivacyLedger> ledger = PrivacyLedger::Create().value();
+  EXPECT_THAT(ledger->Append(*Laplace(1), /*num_times=*/-1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_OK(ledger->Append(*Laplace(1), /*num_times=*/0));
+  EXPECT_EQ(ledger->NumMechanisms(), 0);
+}
+
+}  // namespace
+}  // namespace accounting
+}  // namespace differential_privacy
@@ -15,21 +15,86 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <optional>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "accounting/common/common.h"
 #include "accounting/convolution.h"
 #include "accounting/privacy_loss_mechanism.h"
 #include "proto/accounting/privacy-loss-distribution.pb.h"
+#include "base/instrumentation.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
 namespace accounting {
 
+namespace {
+
+// Initial and maximum number of interval boundaries evaluated per batch when
+// discretizing the privacy loss of continuous noise.
+constexpr int kMinDiscretizationBatchSize = 1 << 10;
+constexpr int kMaxDiscretizationBatchSize = 1 << 16;
+
+// Minimum number of points per thread. Smaller batches are not split up, since
+// starting a thread would cost more than evaluating them.
+constexpr int kMinPointsPerThread = 1 << 12;
+
+// Calls fn(begin, end) for consecutive chunks covering [0, size), on up to
+// num_threads threads.
+void ParallelForChunks(int size, int num_threads,
+                       absl::FunctionRef<void(int begin, int end)> fn) {
+  num_threads = std::clamp(size / kMinPointsPerThread, 1, num_threads);
+  if (num_threads <= 1) {
+    fn(0, size);
+    return;
+  }
+  const int chunk_size = (size + num_threads - 1) / num_threads;
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (int begin = chunk_size; begin < size; begin += chunk_size) {
+    threads.emplace_back(fn, begin, std::min(size, begin + chunk_size));
+  }
+  fn(0, chunk_size);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+constexpr char kBinaryMagic[4] = {'D', 'P', 'L', 'D'};
+constexpr uint32_t kBinaryByteOrderMark = 0x01020304;
+constexpr int32_t kBinaryVersion = 1;
+
+// Header of the binary serialization, followed by num_items doubles. All
+// fields are in host byte order; byte_order tells readers whether it matches
+// theirs.
+struct BinaryHeader {
+  char magic[4] = {kBinaryMagic[0], kBinaryMagic[1], kBinaryMagic[2],
+                   kBinaryMagic[3]};
+  uint32_t byte_order = kBinaryByteOrderMark;
+  int32_t version = kBinaryVersion;
+  int32_t estimate_type = 0;
+  double discretization_interval = 0;
+  double infinity_mass = 0;
+  int64_t min_key = 0;
+  int64_t num_items = 0;
+};
+static_assert(sizeof(BinaryHeader) == 48, "Binary PLD header must be packed");
+
+}  // namespace
+
 std::unique_ptr<PrivacyLossDistribution> PrivacyLossDistribution::Create(
     const ProbabilityMassFunction& pmf_lower,
     const ProbabilityMassFunction& pmf_upper, EstimateType estimate_type,
@@ -81,17 +146,22 @@ std::unique_ptr<PrivacyLossDistribution> PrivacyLossDistribution::Create(
 }
 
 std::unique_ptr<PrivacyLossDistribution>
-PrivacyLossDistribution::CreateIdentity(double discretization_interval) {
+PrivacyLossDistribution::CreateIdentity(double discretization_interval,
+                                        EstimateType estimate_type) {
   return absl::WrapUnique(
       new PrivacyLossDistribution(discretization_interval,
                                   /*infinity_mass=*/0,
-                                  /*probability_mass_function=*/{{0, 1}}));
+                                  /*probability_mass_function=*/
+                                  UnpackedProbabilityMassFunction{
+                                      /*min_key=*/0, /*items=*/{1}},
+                                  estimate_type));
 }
 
 std::unique_ptr<PrivacyLossDistribution>
 PrivacyLossDistribution::CreateForAdditiveNoise(
     const AdditiveNoisePrivacyLoss& mechanism_privacy_loss,
-    EstimateType estimate_type, double discretization_interval) {
+    EstimateType estimate_type, double discretization_interval,
+    int num_threads) {
   ProbabilityMassFunction pmf;
 
   auto round = [estimate_type](double x) {
@@ -112,33 +182,76 @@ PrivacyLossDistribution::CreateForAdditiveNoise(
   }
 
   if (mechanism_privacy_loss.Discrete() == NoiseType::kDiscrete) {
-    for (int x = std::ceil(tail.lower_x_truncation);
-         x <= std::floor(tail.upper_x_truncation); x++) {
-      double rounded_value = round(mechanism_privacy_loss.PrivacyLoss(x) /
-                                   discretization_interval);
-      double probability_mass = mechanism_privacy_loss.NoiseCdf(x) -
-                                mechanism_privacy_loss.NoiseCdf(x - 1);
-      pmf[rounded_value] += probability_mass;
+    const int min_x = std::ceil(tail.lower_x_truncation);
+    const int max_x = std::floor(tail.upper_x_truncation);
+    if (min_x <= max_x) {
+      // noise_x[i] = min_x + i; the CDF is also needed at min_x - 1.
+      std::vector<double> noise_x(max_x - min_x + 2);
+      for (int i = 0; i < noise_x.size(); ++i) {
+        noise_x[i] = min_x - 1 + i;
+      }
+      std::vector<double> cdf(noise_x.size());
+      std::vector<double> privacy_loss(noise_x.size());
+      ParallelForChunks(noise_x.size(), num_threads, [&](int begin, int end) {
+        const int size = end - begin;
+        mechanism_privacy_loss.BatchNoiseCdf(
+            absl::MakeConstSpan(noise_x).subspan(begin, size),
+            absl::MakeSpan(cdf).subspan(begin, size));
+        mechanism_privacy_loss.BatchPrivacyLoss(
+            absl::MakeConstSpan(noise_x).subspan(begin, size),
+            absl::MakeSpan(privacy_loss).subspan(begin, size));
+      });
+      for (int i = 1; i < noise_x.size(); ++i) {
+        double rounded_value = round(privacy_loss[i] / discretization_interval);
+        double probability_mass = cdf[i] - cdf[i - 1];
+        pmf[rounded_value] += probability_mass;
+      }
     }
   } else {
     double lower_x = tail.lower_x_truncation;
-    double upper_x;
+    double lower_cdf = mechanism_privacy_loss.NoiseCdf(lower_x);
     double rounded_down_value = std::floor(
         mechanism_privacy_loss.PrivacyLoss(lower_x) / discretization_interval);
+    // The interval boundaries only depend on their index, so they and their
+    // CDFs are evaluated in batches, which may extend beyond the last
+    // interval. The batches grow so that little work is wasted on small PLDs.
+    int batch_size = kMinDiscretizationBatchSize;
+    std::vector<double> privacy_loss;
+    std::vector<double> upper_x;
+    std::vector<double> upper_cdf;
     while (lower_x < tail.upper_x_truncation) {
-      upper_x = std::min(tail.upper_x_truncation,
-                         mechanism_privacy_loss.InversePrivacyLoss(
-                             discretization_interval * rounded_down_value));
-      // Each x in [lower_x, upper_x] results in privacy loss that lies in
-      // [discretization_interval * rounded_down_value,
-      // discretization_interval * (rounded_down_value + 1)]
-      double probability_mass = mechanism_privacy_loss.NoiseCdf(upper_x) -
-                                mechanism_privacy_loss.NoiseCdf(lower_x);
-      double rounded_value = round(rounded_down_value + 0.5);
-      pmf[rounded_value] += probability_mass;
-
-      lower_x = upper_x;
-      rounded_down_value -= 1;
+      privacy_loss.resize(batch_size);
+      upper_x.resize(batch_size);
+      upper_cdf.resize(batch_size);
+      for (int i = 0; i < batch_size; ++i) {
+        privacy_loss[i] = discretization_interval * (rounded_down_value - i);
+      }
+      ParallelForChunks(batch_size, num_threads, [&](int begin, int end) {
+        const int size = end - begin;
+        absl::Span<double> x = absl::MakeSpan(upper_x).subspan(begin, size);
+        mechanism_privacy_loss.BatchInversePrivacyLoss(
+            absl::MakeConstSpan(privacy_loss).subspan(begin, size), x);
+        for (double& value : x) {
+          value = std::min(tail.upper_x_truncation, value);
+        }
+        mechanism_privacy_loss.BatchNoiseCdf(
+            x, absl::MakeSpan(upper_cdf).subspan(begin, size));
+      });
+
+      for (int i = 0; i < batch_size && lower_x < tail.upper_x_truncation;
+           ++i) {
+        // Each x in [lower_x, upper_x[i]] results in privacy loss that lies in
+        // [discretization_interval * rounded_down_value,
+        // discretization_interval * (rounded_down_value + 1)]
+        double probability_mass = upper_cdf[i] - lower_cdf;
+        double rounded_value = round(rounded_down_value + 0.5);
+        pmf[rounded_value] += probability_mass;
+
+        lower_x = upper_x[i];
+        lower_cdf = upper_cdf[i];
+        rounded_down_value -= 1;
+      }
+      batch_size = std::min(2 * batch_size, kMaxDiscretizationBatchSize);
     }
   }
 
@@ -278,8 +391,28 @@ absl::Status PrivacyLossDistribution::ValidateComposition(
 }
 
 absl::Status PrivacyLossDistribution::Compose(
-    const PrivacyLossDistribution& other_pld, double tail_mass_truncation) {
-  RETURN_IF_ERROR(ValidateComposition(other_pld));
+    const PrivacyLossDistribution& other_pld, double tail_mass_truncation,
+    int max_support_size) {
+  if (max_support_size == 1 || max_support_size < 0) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "max_support_size must be 0 or at least 2: %d.", max_support_size));
+  }
+  // A finer other PLD is coarsened to the interval of this PLD, which must
+  // then be an integer multiple of the other interval.
+  std::optional<UnpackedProbabilityMassFunction> coarsened_other_pmf;
+  const double interval_ratio =
+      discretization_interval_ / other_pld.DiscretizationInterval();
+  const int other_factor = std::round(interval_ratio);
+  if (max_support_size > 0 && other_factor > 1 &&
+      std::abs(interval_ratio - other_factor) <= 1e-9 * other_factor &&
+      other_pld.GetEstimateType() == estimate_type_) {
+    coarsened_other_pmf = CoarsenProbabilityMassFunction(
+        *DoublePrecisionPmf(other_pld), other_factor,
+        /*round_up=*/estimate_type_ == EstimateType::kPessimistic);
+  } else {
+    RETURN_IF_ERROR(ValidateComposition(other_pld));
+  }
+  instrumentation::ScopedEvent event(instrumentation::Event::kPldCompose);
 
   double new_infinity_mass = infinity_mass_ + other_pld.InfinityMass() -
                              infinity_mass_ * other_pld.InfinityMass();
@@ -290,57 +423,170 @@ absl::Status PrivacyLossDistribution::Compose(
     new_infinity_mass += tail_mass_truncation;
   }
 
-  ProbabilityMassFunction new_pmf = Convolve(
-      probability_mass_function_, other_pld.Pmf(), tail_mass_truncation);
+  std::optional<DoublePrecisionPmf> widened_other_pmf;
+  if (!coarsened_other_pmf.has_value()) {
+    widened_other_pmf.emplace(other_pld);
+  }
+  const UnpackedProbabilityMassFunction& other_pmf =
+      coarsened_other_pmf.has_value() ? *coarsened_other_pmf
+                                      : **widened_other_pmf;
+  infinity_mass_ = new_infinity_mass;
+  SetProbabilityMassFunction(Convolve(*DoublePrecisionPmf(*this), other_pmf,
+                                      tail_mass_truncation));
+
+  const int support_size = SupportSize();
+  if (max_support_size > 0 && support_size > max_support_size) {
+    // Coarsening by factor turns n consecutive keys into at most
+    // ceil((n - 1) / factor) + 1 keys.
+    const int factor =
+        (support_size - 1 + max_support_size - 2) / (max_support_size - 1);
+    RETURN_IF_ERROR(Coarsen(factor));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status PrivacyLossDistribution::Coarsen(int factor) {
+  if (factor <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Coarsening factor must be positive: %d.", factor));
+  }
+  if (factor == 1) {
+    return absl::OkStatus();
+  }
+  discretization_interval_ *= factor;
+  SetProbabilityMassFunction(CoarsenProbabilityMassFunction(
+      *DoublePrecisionPmf(*this), factor,
+      /*round_up=*/estimate_type_ == EstimateType::kPessimistic));
+  return absl::OkStatus();
+}
+
+absl::Status PrivacyLossDistribution::ComposeAll(
+    absl::Span<const PrivacyLossDistribution* const> other_plds,
+    double tail_mass_truncation) {
+  if (other_plds.empty()) {
+    return absl::OkStatus();
+  }
+  instrumentation::ScopedEvent event(instrumentation::Event::kPldCompose,
+                                     other_plds.size());
+
+  // Single precision PMFs are widened for the convolution only.
+  std::vector<DoublePrecisionPmf> widened_pmfs;
+  widened_pmfs.reserve(other_plds.size() + 1);
+  widened_pmfs.emplace_back(*this);
+  double finite_mass = 1 - infinity_mass_;
+  for (const PrivacyLossDistribution* other_pld : other_plds) {
+    RETURN_IF_ERROR(ValidateComposition(*other_pld));
+    widened_pmfs.emplace_back(*other_pld);
+    finite_mass *= 1 - other_pld->InfinityMass();
+  }
+  std::vector<const UnpackedProbabilityMassFunction*> pmfs;
+  pmfs.reserve(widened_pmfs.size());
+  for (const DoublePrecisionPmf& pmf : widened_pmfs) {
+    pmfs.push_back(&*pmf);
+  }
+
+  double new_infinity_mass = 1 - finite_mass;
+  if (estimate_type_ == EstimateType::kPessimistic) {
+    // In the pessimistic case, the truncated probability mass needs to be
+    // treated as if they were infinity.
+    new_infinity_mass += tail_mass_truncation;
+  }
 
-  probability_mass_function_ = new_pmf;
   infinity_mass_ = new_infinity_mass;
+  SetProbabilityMassFunction(ConvolveAll(pmfs, tail_mass_truncation));
   return absl::OkStatus();
 }
 
 absl::StatusOr<double>
 PrivacyLossDistribution::GetDeltaForEpsilonForComposedPLD(
     const PrivacyLossDistribution& other_pld, double epsilon) const {
+  ASSIGN_OR_RETURN(std::vector<double> deltas,
+                   GetDeltaForEpsilonForComposedPLD(
+                       other_pld, absl::MakeConstSpan(&epsilon, 1)));
+  return deltas[0];
+}
+
+absl::StatusOr<std::vector<double>>
+PrivacyLossDistribution::GetDeltaForEpsilonForComposedPLD(
+    const PrivacyLossDistribution& other_pld,
+    absl::Span<const double> epsilons) const {
   RETURN_IF_ERROR(ValidateComposition(other_pld));
+  for (double epsilon : epsilons) {
+    if (std::isnan(epsilon)) {
+      return absl::InvalidArgumentError("Epsilon must not be NaN.");
+    }
+  }
 
-  UnpackedProbabilityMassFunction this_pmf =
-      UnpackProbabilityMassFunction(probability_mass_function_);
-  UnpackedProbabilityMassFunction other_pmf =
-      UnpackProbabilityMassFunction(other_pld.probability_mass_function_);
+  const DoublePrecisionPmf widened_this_pmf(*this);
+  const DoublePrecisionPmf widened_other_pmf(other_pld);
+  const UnpackedProbabilityMassFunction& this_pmf = *widened_this_pmf;
+  const UnpackedProbabilityMassFunction& other_pmf = *widened_other_pmf;
+  const int this_size = this_pmf.items.size();
+  const int other_size = other_pmf.items.size();
 
   // Compute the hockey stick divergence using equation (2) in the
-  // supplementary material. other_cumulative_upper_mass below represents the
-  // summation in equation (3) and other_cumulative_lower_mass represents the
-  // summation in equation (4).
-
-  double other_cumulative_upper_mass = 0;
-  double other_cumulative_lower_mass = 0;
-  int current_idx = other_pmf.items.size() - 1;
-  double delta = 0;
-
-  for (int this_idx = 0; this_idx < this_pmf.items.size(); ++this_idx) {
-    double this_privacy_loss =
-        discretization_interval_ * (this_idx + this_pmf.min_key);
-    double this_probability_mass = this_pmf.items[this_idx];
-    while (current_idx >= 0) {
-      double other_privacy_loss = other_pld.discretization_interval_ *
-                                  (current_idx + other_pmf.min_key);
-      if (other_privacy_loss + this_privacy_loss <= epsilon) break;
-      other_cumulative_upper_mass += other_pmf.items[current_idx];
-      other_cumulative_lower_mass +=
-          other_pmf.items[current_idx] / std::exp(other_privacy_loss);
-      --current_idx;
-    }
-    delta += this_probability_mass * (other_cumulative_upper_mass -
-                                      std::exp(epsilon - this_privacy_loss) *
-                                          other_cumulative_lower_mass);
+  // supplementary material: the sum over the pairs of outcomes whose privacy
+  // losses add up to more than epsilon of
+  //   this_mass * other_mass * (1 - e^{epsilon - this_loss - other_loss}).
+  // other_upper_mass and other_lower_mass are the suffix sums of equations (3)
+  // and (4), and this_mass_suffix and this_lower_mass_suffix the same sums of
+  // this PLD.
+  std::vector<double> other_upper_mass(other_size + 1, 0);
+  std::vector<double> other_lower_mass(other_size + 1, 0);
+  for (int j = other_size - 1; j >= 0; --j) {
+    const double privacy_loss =
+        discretization_interval_ * (j + other_pmf.min_key);
+    other_upper_mass[j] = other_upper_mass[j + 1] + other_pmf.items[j];
+    other_lower_mass[j] =
+        other_lower_mass[j + 1] + other_pmf.items[j] / std::exp(privacy_loss);
+  }
+  std::vector<double> this_lower_mass(this_size);
+  std::vector<double> this_mass_suffix(this_size + 1, 0);
+  std::vector<double> this_lower_mass_suffix(this_size + 1, 0);
+  for (int i = this_size - 1; i >= 0; --i) {
+    const double privacy_loss =
+        discretization_interval_ * (i + this_pmf.min_key);
+    this_lower_mass[i] = this_pmf.items[i] / std::exp(privacy_loss);
+    this_mass_suffix[i] = this_mass_suffix[i + 1] + this_pmf.items[i];
+    this_lower_mass_suffix[i] =
+        this_lower_mass_suffix[i + 1] + this_lower_mass[i];
   }
 
   // The probability that the composed privacy loss is infinite.
-  double composed_infinity_mass = infinity_mass_ + other_pld.InfinityMass() -
-                                  infinity_mass_ * other_pld.InfinityMass();
-
-  return delta + composed_infinity_mass;
+  const double composed_infinity_mass =
+      infinity_mass_ + other_pld.InfinityMass() -
+      infinity_mass_ * other_pld.InfinityMass();
+
+  std::vector<double> deltas;
+  deltas.reserve(epsilons.size());
+  for (double epsilon : epsilons) {
+    // Since both PLDs have the same discretization interval, the outcomes of
+    // the other PLD whose losses add up to more than epsilon with outcome i of
+    // this PLD are those from first_other - i on. Pairs whose losses add up
+    // to exactly epsilon do not contribute to the divergence.
+    const double first_key_sum =
+        std::floor(epsilon / discretization_interval_) + 1 - this_pmf.min_key -
+        other_pmf.min_key;
+    const int64_t first_other = static_cast<int64_t>(
+        std::clamp<double>(first_key_sum, -1, this_size + other_size + 1));
+    // Outcomes of this PLD below begin have no outcome of the other PLD to
+    // pair with, and those from end on pair with all of them.
+    const int64_t begin =
+        std::clamp<int64_t>(first_other - other_size + 1, 0, this_size);
+    const int64_t end = std::clamp<int64_t>(first_other, begin, this_size);
+
+    double upper = this_mass_suffix[end] * other_upper_mass[0];
+    double lower = this_lower_mass_suffix[end] * other_lower_mass[0];
+    for (int64_t i = begin; i < end; ++i) {
+      upper += this_pmf.items[i] * other_upper_mass[first_other - i];
+      lower += this_lower_mass[i] * other_lower_mass[first_other - i];
+    }
+    // Every pair contributes a non-negative amount, which the difference can
+    // undershoot by rounding.
+    deltas.push_back(std::max(0.0, upper - std::exp(epsilon) * lower) +
+                     composed_infinity_mass);
+  }
+  return deltas;
 }
 
 void PrivacyLossDistribution::Compose(int num_times,
@@ -350,57 +596,199 @@ void PrivacyLossDistribution::Compose(int num_times,
   // Currently support truncation only for pessimistic estimates.
   double effective_tail_mass_truncation =
       estimate_type_ == EstimateType::kPessimistic ? tail_mass_truncation : 0.0;
-  ProbabilityMassFunction new_pmf = Convolve(
-      probability_mass_function_, num_times, effective_tail_mass_truncation);
+  infinity_mass_ = new_infinity_mass + effective_tail_mass_truncation;
+  SetProbabilityMassFunction(Convolve(*DoublePrecisionPmf(*this), num_times,
+                                      effective_tail_mass_truncation));
+}
 
-  probability_mass_function_ = new_pmf;
+void PrivacyLossDistribution::ComposeBySquaring(int num_times,
+                                                double tail_mass_truncation) {
+  double new_infinity_mass = 1 - std::pow((1 - infinity_mass_), num_times);
+
+  double effective_tail_mass_truncation =
+      estimate_type_ == EstimateType::kPessimistic ? tail_mass_truncation : 0.0;
   infinity_mass_ = new_infinity_mass + effective_tail_mass_truncation;
+  SetProbabilityMassFunction(ConvolveBySquaring(
+      *DoublePrecisionPmf(*this), num_times, effective_tail_mass_truncation));
 }
 
-double PrivacyLossDistribution::GetDeltaForEpsilon(double epsilon) const {
-  double divergence = infinity_mass_;
-  for (auto [outcome, p] : probability_mass_function_) {
-    auto val = outcome * discretization_interval_;
-    if (val > epsilon && p > 0) {
-      divergence += (1 - std::exp(epsilon - val)) * p;
+const PrivacyLossDistribution::QueryIndex&
+PrivacyLossDistribution::GetQueryIndex() const {
+  absl::MutexLock lock(&query_index_mutex_);
+  if (query_index_ == nullptr) {
+    auto index = std::make_unique<QueryIndex>();
+    // Reads single precision masses directly, so that querying does not keep
+    // a widened copy of the distribution.
+    auto add_outcomes = [this, &index](const auto& items) {
+      double mass_upper = infinity_mass_;
+      double mass_lower = 0;
+      for (int i = items.size() - 1; i >= 0; --i) {
+        if (items[i] == 0) continue;
+        const double val =
+            (i + probability_mass_function_.min_key) * discretization_interval_;
+        mass_upper += items[i];
+        mass_lower += std::exp(-val) * items[i];
+        index->losses.push_back(val);
+        index->upper_masses.push_back(mass_upper);
+        index->lower_masses.push_back(mass_lower);
+      }
+    };
+    if (pmf_precision_ == PmfPrecision::kSingle) {
+      add_outcomes(single_precision_items_);
+    } else {
+      add_outcomes(probability_mass_function_.items);
     }
+    query_index_ = std::move(index);
   }
-  return divergence;
+  return *query_index_;
 }
 
-double PrivacyLossDistribution::GetEpsilonForDelta(double delta) const {
-  if (infinity_mass_ > delta) return std::numeric_limits<double>::infinity();
+void PrivacyLossDistribution::InvalidateQueryIndex() {
+  absl::MutexLock lock(&query_index_mutex_);
+  query_index_ = nullptr;
+}
 
-  double mass_upper = infinity_mass_;
-  double mass_lower = 0;
+const UnpackedProbabilityMassFunction& PrivacyLossDistribution::UnpackedPmf()
+    const {
+  if (pmf_precision_ == PmfPrecision::kDouble) {
+    return probability_mass_function_;
+  }
+  absl::MutexLock lock(&widened_pmf_mutex_);
+  if (widened_pmf_ == nullptr) {
+    auto widened = std::make_unique<UnpackedProbabilityMassFunction>();
+    widened->min_key = probability_mass_function_.min_key;
+    widened->items.assign(single_precision_items_.begin(),
+                          single_precision_items_.end());
+    widened_pmf_ = std::move(widened);
+  }
+  return *widened_pmf_;
+}
 
-  // Sort outcomes in reverse order.
-  std::vector<int> outcomes;
-  for (auto [outcome, p] : probability_mass_function_) {
-    outcomes.push_back(outcome);
+PrivacyLossDistribution::DoublePrecisionPmf::DoublePrecisionPmf(
+    const PrivacyLossDistribution& pld) {
+  if (pld.pmf_precision_ == PmfPrecision::kDouble) {
+    pmf_ = &pld.probability_mass_function_;
+    return;
   }
-  std::sort(outcomes.rbegin(), outcomes.rend());
+  auto widened = std::make_unique<UnpackedProbabilityMassFunction>();
+  widened->min_key = pld.probability_mass_function_.min_key;
+  widened->items.assign(pld.single_precision_items_.begin(),
+                        pld.single_precision_items_.end());
+  pmf_ = widened.get();
+  widened_ = std::move(widened);
+}
 
-  for (int outcome : outcomes) {
-    auto val = outcome * discretization_interval_;
+int PrivacyLossDistribution::SupportSize() const {
+  return pmf_precision_ == PmfPrecision::kSingle
+             ? single_precision_items_.size()
+             : probability_mass_function_.items.size();
+}
 
-    if (mass_upper > delta && mass_lower > 0 &&
-        mass_upper - std::exp(val) * mass_lower >= delta) {
-      // Epsilon is greater than or equal to val.
-      break;
+void PrivacyLossDistribution::SetPmfPrecision(PmfPrecision precision) {
+  if (precision == pmf_precision_) return;
+  UnpackedProbabilityMassFunction pmf = *DoublePrecisionPmf(*this);
+  pmf_precision_ = precision;
+  SetProbabilityMassFunction(std::move(pmf));
+}
+
+void PrivacyLossDistribution::SetProbabilityMassFunction(
+    UnpackedProbabilityMassFunction pmf) {
+  InvalidateQueryIndex();
+  {
+    absl::MutexLock lock(&widened_pmf_mutex_);
+    widened_pmf_ = nullptr;
+  }
+  if (pmf_precision_ == PmfPrecision::kDouble) {
+    probability_mass_function_ = std::move(pmf);
+    single_precision_items_ = std::vector<float>();
+    return;
+  }
+
+  // Every mass is rounded down, so that no outcome gains mass, and the mass
+  // lost to rounding is summed in double precision. A pessimistic estimate
+  // moves it to infinity, which can only increase delta; an optimistic one
+  // drops it, which can only decrease delta.
+  single_precision_items_.resize(pmf.items.size());
+  double lost_mass = 0;
+  for (int i = 0; i < pmf.items.size(); ++i) {
+    float mass = static_cast<float>(pmf.items[i]);
+    if (mass > pmf.items[i]) {
+      mass = std::nextafter(mass, 0.0f);
     }
+    single_precision_items_[i] = mass;
+    lost_mass += pmf.items[i] - mass;
+  }
+  if (estimate_type_ == EstimateType::kPessimistic) {
+    infinity_mass_ += lost_mass;
+  }
+  probability_mass_function_.min_key = pmf.min_key;
+  probability_mass_function_.items = std::vector<double>();
+}
 
-    double pmf_val = probability_mass_function_.at(outcome);
-    mass_upper += pmf_val;
-    mass_lower += std::exp(-val) * pmf_val;
+double PrivacyLossDistribution::GetDeltaForEpsilon(double epsilon) const {
+  // The divergence is the sum of (1 - e^{epsilon - loss}) * mass over the
+  // outcomes with loss greater than epsilon, plus the infinity mass.
+  const QueryIndex& index = GetQueryIndex();
+  const int num_greater =
+      std::partition_point(index.losses.begin(), index.losses.end(),
+                           [epsilon](double loss) { return loss > epsilon; }) -
+      index.losses.begin();
+  if (num_greater == 0) return infinity_mass_;
+  // The difference of the sums can be slightly smaller than the infinity mass
+  // due to rounding, while every term of the sum is non-negative.
+  return std::max(infinity_mass_,
+                  index.upper_masses[num_greater - 1] -
+                      std::exp(epsilon) * index.lower_masses[num_greater - 1]);
+}
 
-    if (mass_upper >= delta && mass_lower == 0) {
-      // This only occurs when val is very large, which results in exp(-val)
-      // being treated as zero.
-      return std::max(0.0, val);
+double PrivacyLossDistribution::GetEpsilonForDelta(double delta) const {
+  if (infinity_mass_ > delta) return std::numeric_limits<double>::infinity();
+
+  // Going over the outcomes in decreasing order of loss, epsilon is at least
+  // the loss of the first outcome for which the divergence at its loss,
+  // computed from the outcomes before it, is at least delta. The divergence
+  // only grows with every outcome, so the outcome is found by binary search.
+  const QueryIndex& index = GetQueryIndex();
+  const int n = index.losses.size();
+  auto mass_upper_before = [&](int k) {
+    return k == 0 ? infinity_mass_ : index.upper_masses[k - 1];
+  };
+  auto mass_lower_before = [&](int k) {
+    return k == 0 ? 0.0 : index.lower_masses[k - 1];
+  };
+  int lo = 0;
+  int hi = n;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    const double mass_upper = mass_upper_before(mid);
+    const double mass_lower = mass_lower_before(mid);
+    if (mass_upper > delta && mass_lower > 0 &&
+        mass_upper - std::exp(index.losses[mid]) * mass_lower >= delta) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
     }
   }
+  const int num_outcomes = lo;
+
+  // When the loss is very large, exp(-loss) is treated as zero, and the
+  // smallest such loss at which the mass reaches delta is the result.
+  const int num_zero_lower =
+      std::partition_point(index.lower_masses.begin(),
+                           index.lower_masses.begin() + num_outcomes,
+                           [](double mass) { return mass == 0; }) -
+      index.lower_masses.begin();
+  const int first_reaching_delta =
+      std::partition_point(index.upper_masses.begin(),
+                           index.upper_masses.begin() + num_zero_lower,
+                           [delta](double mass) { return mass < delta; }) -
+      index.upper_masses.begin();
+  if (first_reaching_delta < num_zero_lower) {
+    return std::max(0.0, index.losses[first_reaching_delta]);
+  }
 
+  const double mass_upper = mass_upper_before(num_outcomes);
+  const double mass_lower = mass_lower_before(num_outcomes);
   if (mass_upper <= mass_lower + delta) return 0;
 
   return std::log((mass_upper - delta) / mass_lower);
@@ -415,13 +803,12 @@ PrivacyLossDistribution::Serialize() const {
   serialization::PrivacyLossDistribution output;
   serialization::ProbabilityMassFunction* serialized_pmf =
       output.mutable_pessimistic_pmf();
-  UnpackedProbabilityMassFunction unpacked_pmf =
-      UnpackProbabilityMassFunction(probability_mass_function_);
+  const DoublePrecisionPmf unpacked_pmf(*this);
   serialized_pmf->set_infinity_mass(infinity_mass_);
   serialized_pmf->set_discretization_interval(discretization_interval_);
-  serialized_pmf->set_min_key(unpacked_pmf.min_key);
-  *serialized_pmf->mutable_values() = {unpacked_pmf.items.begin(),
-                                       unpacked_pmf.items.end()};
+  serialized_pmf->set_min_key(unpacked_pmf->min_key);
+  *serialized_pmf->mutable_values() = {unpacked_pmf->items.begin(),
+                                       unpacked_pmf->items.end()};
   return output;
 }
 
@@ -439,7 +826,80 @@ PrivacyLossDistribution::Deserialize(
   return absl::WrapUnique(new PrivacyLossDistribution(
       pmf.discretization_interval(), pmf.infinity_mass(),
       /*probability_mass_function=*/
-      CreateProbabilityMassFunction(unpacked_pmf)));
+      TruncateProbabilityMassFunction(unpacked_pmf)));
+}
+
+std::string PrivacyLossDistribution::SerializeBinary() const {
+  const DoublePrecisionPmf widened_pmf(*this);
+  const UnpackedProbabilityMassFunction& pmf = *widened_pmf;
+  BinaryHeader header;
+  header.estimate_type = static_cast<int32_t>(estimate_type_);
+  header.discretization_interval = discretization_interval_;
+  header.infinity_mass = infinity_mass_;
+  header.min_key = pmf.min_key;
+  header.num_items = pmf.items.size();
+
+  std::string output(sizeof(header) + pmf.items.size() * sizeof(double), '\0');
+  std::memcpy(output.data(), &header, sizeof(header));
+  if (!pmf.items.empty()) {
+    std::memcpy(output.data() + sizeof(header), pmf.items.data(),
+                pmf.items.size() * sizeof(double));
+  }
+  return output;
+}
+
+absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>>
+PrivacyLossDistribution::DeserializeBinary(absl::string_view data) {
+  BinaryHeader header;
+  if (data.size() < sizeof(header)) {
+    return absl::InvalidArgumentError(
+        "Binary PLD is shorter than its header.");
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (std::memcmp(header.magic, kBinaryMagic, sizeof(header.magic)) != 0) {
+    return absl::InvalidArgumentError("Data is not a binary PLD.");
+  }
+  if (header.byte_order != kBinaryByteOrderMark) {
+    return absl::InvalidArgumentError(
+        "Binary PLD was written with a different byte order.");
+  }
+  if (header.version != kBinaryVersion) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Unsupported binary PLD version %d.", header.version));
+  }
+  const int32_t optimistic = static_cast<int32_t>(EstimateType::kOptimistic);
+  const int32_t pessimistic =
+      static_cast<int32_t>(EstimateType::kPessimistic);
+  if (header.estimate_type != optimistic &&
+      header.estimate_type != pessimistic) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Invalid estimate type %d in binary PLD.", header.estimate_type));
+  }
+  if (!(header.discretization_interval > 0)) {
+    return absl::InvalidArgumentError(
+        "Discretization interval of binary PLD must be positive.");
+  }
+  if (header.num_items < 0 ||
+      header.num_items != (data.size() - sizeof(header)) / sizeof(double) ||
+      (data.size() - sizeof(header)) % sizeof(double) != 0) {
+    return absl::InvalidArgumentError(
+        "Size of binary PLD does not match its number of PMF entries.");
+  }
+  if (header.min_key < std::numeric_limits<int>::min() ||
+      header.min_key + header.num_items > std::numeric_limits<int>::max()) {
+    return absl::InvalidArgumentError("Keys of binary PLD are out of range.");
+  }
+
+  UnpackedProbabilityMassFunction pmf;
+  pmf.min_key = header.min_key;
+  pmf.items.resize(header.num_items);
+  if (!pmf.items.empty()) {
+    std::memcpy(pmf.items.data(), data.data() + sizeof(header),
+                pmf.items.size() * sizeof(double));
+  }
+  return absl::WrapUnique(new PrivacyLossDistribution(
+      header.discretization_interval, header.infinity_mass, std::move(pmf),
+      static_cast<EstimateType>(header.estimate_type)));
 }
 }  // namespace accounting
 }  // namespace differential_privacy
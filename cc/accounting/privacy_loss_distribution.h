@@ -20,15 +20,29 @@
 // material below for more details:
 // ../../common_docs Privacy_Loss_Distributions.pdf
 
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "accounting/common/common.h"
+#include "accounting/convolution.h"
 #include "accounting/privacy_loss_mechanism.h"
 #include "proto/accounting/privacy-loss-distribution.pb.h"
 
 namespace differential_privacy {
 namespace accounting {
+
+// Precision in which a PrivacyLossDistribution stores its PMF.
+enum class PmfPrecision { kDouble, kSingle };
+
 // Privacy loss distribution (PLD) of two discrete distributions,
 // the upper distribution mu_upper and the lower distribution mu_lower, is
 // defined as a distribution on real numbers generated by first picking o
@@ -79,7 +93,8 @@ class PrivacyLossDistribution {
   // Creates {@link PrivacyLossDistribution} corresponding to an algorithm that
   // does not leak privacy at all (i.e. output is independent of input).
   static std::unique_ptr<PrivacyLossDistribution> CreateIdentity(
-      double discretization_interval = 1e-4);
+      double discretization_interval = 1e-4,
+      EstimateType estimate_type = EstimateType::kPessimistic);
 
   // Creates {@link PrivacyLossDistribution} from
   // {@link AdditiveNoisePrivacyLoss} and some additional parameters:
@@ -89,10 +104,14 @@ class PrivacyLossDistribution {
   //   discretization_interval: the discretization interval for the privacy
   //     loss distribution. The values will be rounded up/down to be integer
   //     multiples of this number.
+  //   num_threads: the maximum number of threads used to evaluate the privacy
+  //     loss and the noise CDF over the discretization grid. The result does
+  //     not depend on it. The methods of mechanism_privacy_loss are called
+  //     concurrently when it is greater than 1.
   static std::unique_ptr<PrivacyLossDistribution> CreateForAdditiveNoise(
       const AdditiveNoisePrivacyLoss& mechanism_privacy_loss,
       EstimateType estimate_type = EstimateType::kPessimistic,
-      double discretization_interval = 1e-4);
+      double discretization_interval = 1e-4, int num_threads = 1);
 
   // Creates {@link PrivacyLossDistribution} for the Randomized Response with a
   // given number of buckets and a noise parameter.
@@ -218,6 +237,10 @@ class PrivacyLossDistribution {
   // epsilon-hockey stick divergence gives the value of delta for which the
   // mechanism is (epsilon, delta)-differentially private. (See Observation 1 in
   // the supplementary material.)
+  //
+  // This and GetEpsilonForDelta take O(log n) time for a PLD with n outcomes,
+  // except for the first call after the PLD was created or composed, which
+  // builds an index of the outcomes in O(n).
   double GetDeltaForEpsilon(double epsilon) const;
 
   // Computes the smallest non-negative epsilon for which hockey stick
@@ -236,11 +259,39 @@ class PrivacyLossDistribution {
   absl::Status ValidateComposition(
       const PrivacyLossDistribution& other_pld) const;
 
-  // Composes other PLD into itself. Additional parameter:
+  // Composes other PLD into itself. Additional parameters:
   //   tail_mass_truncation: an upper bound on the tails of the probability
   //     mass of the PLD that might be truncated.
+  //   max_support_size: if not 0, the composed PLD is coarsened (see
+  //     Coarsen) by the smallest factor that leaves it with at most this many
+  //     outcomes. This bounds the size of the FFTs of later compositions at
+  //     the cost of rounding the privacy losses to a coarser interval. Since
+  //     a coarsened PLD can then only be composed with PLDs whose
+  //     discretization interval is the same, other_pld may also have an
+  //     interval that divides the one of this PLD; it is then coarsened to
+  //     the interval of this PLD before composing. Must be 0 or at least 2.
   absl::Status Compose(const PrivacyLossDistribution& other_pld,
-                       double tail_mass_truncation = 1e-15);
+                       double tail_mass_truncation = 1e-15,
+                       int max_support_size = 0);
+
+  // Re-discretizes the PLD to a discretization interval that is factor times
+  // larger. Privacy losses are rounded up for pessimistic estimates and down
+  // for optimistic ones, so the estimate type is preserved: a pessimistic
+  // PLD still yields an upper bound on delta for every epsilon. Fails if
+  // factor is not positive.
+  absl::Status Coarsen(int factor);
+
+  // Composes all other PLDs into itself at once. This gives the same result as
+  // calling Compose for each of them, but transforms every PLD only once and
+  // truncates the tails only once, which is much faster for many PLDs. All
+  // PLDs are validated first; if any cannot be composed with this PLD, a
+  // failure status is returned and this PLD is left unchanged. Additional
+  // parameter:
+  //   tail_mass_truncation: an upper bound on the tails of the probability
+  //     mass of the PLD that might be truncated.
+  absl::Status ComposeAll(
+      absl::Span<const PrivacyLossDistribution* const> other_plds,
+      double tail_mass_truncation = 1e-15);
 
   // Computes delta for given epsilon for the result of composing this PLD and a
   // given PLD. Note that this function does not modify the current PLD.
@@ -251,12 +302,26 @@ class PrivacyLossDistribution {
   absl::StatusOr<double> GetDeltaForEpsilonForComposedPLD(
       const PrivacyLossDistribution& other_pld, double epsilon) const;
 
+  // Same as above for many epsilons, in the same order. The per-outcome
+  // exponentials are computed once for all epsilons, after which each epsilon
+  // takes two dot products over the outcomes.
+  absl::StatusOr<std::vector<double>> GetDeltaForEpsilonForComposedPLD(
+      const PrivacyLossDistribution& other_pld,
+      absl::Span<const double> epsilons) const;
+
   // Composes PLD into itself num_times. Additional parameter:
   //   tail_mass_truncation: an upper bound on the tails of the probability mass
   //     of the PLD that might be truncated. Currently only supports for
   //     pessimistic estimates.
   void Compose(int num_times, double tail_mass_truncation = 1e-15);
 
+  // Same as Compose(num_times) but composes by repeated squaring, truncating
+  // the tails after every step. This keeps the size of the FFTs bounded by the
+  // truncated support of the PLD, which matters when num_times is large, e.g.,
+  // in the tens of thousands. Truncation is only supported for pessimistic
+  // estimates.
+  void ComposeBySquaring(int num_times, double tail_mass_truncation = 1e-15);
+
   double DiscretizationInterval() const { return discretization_interval_; }
 
   EstimateType GetEstimateType() const { return estimate_type_; }
@@ -265,10 +330,34 @@ class PrivacyLossDistribution {
   //  can occur only in mu_upper but not in mu_lower. (These outcomes result in
   //  privacy loss ln(mu_upper(o) / mu_lower(o)) of infinity.)
   double InfinityMass() const { return infinity_mass_; }
-  const ProbabilityMassFunction& Pmf() const {
-    return probability_mass_function_;
+
+  // Returns the probability mass function of the privacy loss, keyed by
+  // multiples of the discretization interval, with outcomes of positive mass
+  // only. The distribution is stored unpacked, so this builds a hash map on
+  // every call; prefer UnpackedPmf() when iterating over the distribution.
+  ProbabilityMassFunction Pmf() const {
+    return CreateProbabilityMassFunction(*DoublePrecisionPmf(*this));
   }
 
+  // Returns the probability mass function of the privacy loss in the unpacked
+  // form that is used for composition. With single precision storage, this
+  // widens the masses into a copy that is kept until the PLD changes.
+  // Compositions and queries do not use this copy, so only call this when the
+  // masses are needed in double precision.
+  const UnpackedProbabilityMassFunction& UnpackedPmf() const;
+
+  // Selects how the masses of the PMF are stored between compositions. With
+  // PmfPrecision::kSingle, they take half the memory; compositions still
+  // convolve in double precision and only round their result. Every mass is
+  // rounded down to the next float, and the lost mass is added to the
+  // infinity mass of a pessimistic estimate and dropped from an optimistic
+  // one, so the estimate type is preserved. This adds up to about 1.2e-7 times
+  // the finite mass to delta for every rounding, so it is only suitable when
+  // the tolerance of the accounting is well above that.
+  void SetPmfPrecision(PmfPrecision precision);
+
+  PmfPrecision GetPmfPrecision() const { return pmf_precision_; }
+
   // Serializes the privacy loss distribution. Currently only supports
   // pessimistic estimates.
   absl::StatusOr<serialization::PrivacyLossDistribution> Serialize() const;
@@ -277,21 +366,94 @@ class PrivacyLossDistribution {
   static absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>> Deserialize(
       const serialization::PrivacyLossDistribution& proto);
 
+  // Serializes the privacy loss distribution into a compact binary format for
+  // storing PLDs that are expensive to recompute, e.g., in a PldDiskCache.
+  // Unlike Serialize, both estimate types are supported. The format is a
+  // fixed-size header followed by the dense PMF as raw doubles in host byte
+  // order, so a memory-mapped file can be deserialized with a single copy.
+  std::string SerializeBinary() const;
+
+  // Deserializes the output of SerializeBinary. Returns an error if the data
+  // is truncated, has an unknown version or was written with another byte
+  // order.
+  static absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>>
+  DeserializeBinary(absl::string_view data);
+
  private:
   PrivacyLossDistribution(
       double discretization_interval, double infinity_mass,
-      const ProbabilityMassFunction& probability_mass_function,
+      UnpackedProbabilityMassFunction probability_mass_function,
       EstimateType estimate_type = EstimateType::kPessimistic)
       : discretization_interval_(discretization_interval),
         infinity_mass_(infinity_mass),
-        probability_mass_function_(probability_mass_function),
+        probability_mass_function_(std::move(probability_mass_function)),
         estimate_type_(estimate_type) {}
 
-  const double discretization_interval_;
+  PrivacyLossDistribution(
+      double discretization_interval, double infinity_mass,
+      const ProbabilityMassFunction& probability_mass_function,
+      EstimateType estimate_type = EstimateType::kPessimistic)
+      : PrivacyLossDistribution(
+            discretization_interval, infinity_mass,
+            UnpackProbabilityMassFunction(probability_mass_function),
+            estimate_type) {}
+
+  // Outcomes of positive mass in decreasing order of privacy loss, with the
+  // prefix sums of their mass, starting from the infinity mass, and of their
+  // mass times e^{-loss}. Both sums are accumulated in the order in which the
+  // linear scan of GetEpsilonForDelta accumulated them.
+  struct QueryIndex {
+    std::vector<double> losses;
+    std::vector<double> upper_masses;
+    std::vector<double> lower_masses;
+  };
+
+  // The probability mass function in double precision: the stored one, or,
+  // with single precision storage, a widened copy that is owned by this object
+  // and freed with it, so that reading the PMF of a PLD does not keep a copy
+  // of it alive.
+  class DoublePrecisionPmf {
+   public:
+    explicit DoublePrecisionPmf(const PrivacyLossDistribution& pld);
+
+    const UnpackedProbabilityMassFunction& operator*() const { return *pmf_; }
+    const UnpackedProbabilityMassFunction* operator->() const { return pmf_; }
+
+   private:
+    std::unique_ptr<const UnpackedProbabilityMassFunction> widened_;
+    const UnpackedProbabilityMassFunction* pmf_;
+  };
+
+  // Returns the index of the current distribution, building it if needed.
+  // Safe to call concurrently, like the other const methods.
+  const QueryIndex& GetQueryIndex() const;
+
+  // Must be called whenever the distribution changes.
+  void InvalidateQueryIndex();
+
+  // Replaces the PMF, rounding it as described in SetPmfPrecision when it is
+  // stored in single precision. Must be called after the infinity mass has
+  // been updated.
+  void SetProbabilityMassFunction(UnpackedProbabilityMassFunction pmf);
+
+  int SupportSize() const;
+
+  double discretization_interval_;
   double infinity_mass_;
-  ProbabilityMassFunction probability_mass_function_;
+  // Only min_key is used when the masses are stored in single precision.
+  UnpackedProbabilityMassFunction probability_mass_function_;
+  std::vector<float> single_precision_items_;
+  PmfPrecision pmf_precision_ = PmfPrecision::kDouble;
   const EstimateType estimate_type_;
 
+  mutable absl::Mutex query_index_mutex_;
+  mutable std::unique_ptr<const QueryIndex> query_index_
+      ABSL_GUARDED_BY(query_index_mutex_);
+
+  mutable absl::Mutex widened_pmf_mutex_;
+  mutable std::unique_ptr<const UnpackedProbabilityMassFunction> widened_pmf_
+      ABSL_GUARDED_BY(widened_pmf_mutex_);
+
   friend class PrivacyLossDistributionTestPeer;
 };
 }  // namespace accounting
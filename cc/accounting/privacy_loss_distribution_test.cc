@@ -14,11 +14,16 @@
 
 #include "accounting/privacy_loss_distribution.h"
 
+#include <memory>
 #include <optional>
+#include <string>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "accounting/common/common.h"
 #include "accounting/common/test_util.h"
 #include "proto/accounting/privacy-loss-distribution.pb.h"
@@ -39,6 +44,11 @@ class PrivacyLossDistributionTestPeer {
         new PrivacyLossDistribution(discretization_interval, infinity_mass,
                                     probability_mass_function, estimate_type));
   }
+
+  static bool HasWidenedPmf(const PrivacyLossDistribution& pld) {
+    absl::MutexLock lock(&pld.widened_pmf_mutex_);
+    return pld.widened_pmf_ != nullptr;
+  }
 };
 
 namespace {
@@ -168,6 +178,222 @@ TEST(PrivacyLossDistributionTest, Compose) {
   EXPECT_FALSE(pld->Pmf().empty());
 }
 
+TEST(PrivacyLossDistributionTest, CoarsenIsPessimistic) {
+  absl::StatusOr<std::unique_ptr<AdditiveNoisePrivacyLoss>> noise_privacy_loss =
+      GaussianPrivacyLoss::Create(/*standard_deviation=*/2, /*sensitivity=*/1);
+  ASSERT_OK(noise_privacy_loss);
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(
+          **noise_privacy_loss, EstimateType::kPessimistic,
+          /*discretization_interval=*/1e-3);
+  std::unique_ptr<PrivacyLossDistribution> coarse_pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(
+          **noise_privacy_loss, EstimateType::kPessimistic,
+          /*discretization_interval=*/1e-3);
+
+  ASSERT_OK(coarse_pld->Coarsen(8));
+
+  EXPECT_DOUBLE_EQ(coarse_pld->DiscretizationInterval(), 8e-3);
+  EXPECT_LE(coarse_pld->UnpackedPmf().items.size(),
+            pld->UnpackedPmf().items.size() / 8 + 2);
+  for (double epsilon : {0.0, 0.1, 0.5, 1.0, 2.0}) {
+    EXPECT_GE(coarse_pld->GetDeltaForEpsilon(epsilon),
+              pld->GetDeltaForEpsilon(epsilon));
+    EXPECT_NEAR(coarse_pld->GetDeltaForEpsilon(epsilon),
+                pld->GetDeltaForEpsilon(epsilon), 1e-2);
+  }
+  EXPECT_THAT(coarse_pld->Coarsen(0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(PrivacyLossDistributionTest, ComposeBoundsSupportSize) {
+  absl::StatusOr<std::unique_ptr<AdditiveNoisePrivacyLoss>> noise_privacy_loss =
+      GaussianPrivacyLoss::Create(/*standard_deviation=*/5, /*sensitivity=*/1);
+  ASSERT_OK(noise_privacy_loss);
+  std::unique_ptr<PrivacyLossDistribution> step =
+      PrivacyLossDistribution::CreateForAdditiveNoise(
+          **noise_privacy_loss, EstimateType::kPessimistic,
+          /*discretization_interval=*/1e-3);
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(
+          **noise_privacy_loss, EstimateType::kPessimistic,
+          /*discretization_interval=*/1e-3);
+  std::unique_ptr<PrivacyLossDistribution> coarse_pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(
+          **noise_privacy_loss, EstimateType::kPessimistic,
+          /*discretization_interval=*/1e-3);
+
+  constexpr int kMaxSupportSize = 4000;
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_OK(pld->Compose(*step));
+    ASSERT_OK(coarse_pld->Compose(*step, /*tail_mass_truncation=*/1e-15,
+                                  kMaxSupportSize));
+    EXPECT_LE(coarse_pld->UnpackedPmf().items.size(), kMaxSupportSize);
+  }
+
+  EXPECT_GT(coarse_pld->DiscretizationInterval(), 1e-3);
+  EXPECT_GT(pld->UnpackedPmf().items.size(), kMaxSupportSize);
+  for (double epsilon : {0.0, 0.5, 1.0, 2.0}) {
+    EXPECT_GE(coarse_pld->GetDeltaForEpsilon(epsilon),
+              pld->GetDeltaForEpsilon(epsilon));
+    EXPECT_NEAR(coarse_pld->GetDeltaForEpsilon(epsilon),
+                pld->GetDeltaForEpsilon(epsilon), 2e-2);
+  }
+
+  EXPECT_THAT(coarse_pld->Compose(*step, 1e-15, /*max_support_size=*/1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // Without max_support_size, the intervals must still be the same.
+  EXPECT_THAT(coarse_pld->Compose(*step),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("discretization interval")));
+}
+
+TEST(PrivacyLossDistributionTest, SinglePrecisionStorageKeepsEstimateType) {
+  absl::StatusOr<std::unique_ptr<AdditiveNoisePrivacyLoss>> noise_privacy_loss =
+      GaussianPrivacyLoss::Create(/*standard_deviation=*/3, /*sensitivity=*/1);
+  ASSERT_OK(noise_privacy_loss);
+  for (EstimateType estimate_type :
+       {EstimateType::kPessimistic, EstimateType::kOptimistic}) {
+    std::unique_ptr<PrivacyLossDistribution> step =
+        PrivacyLossDistribution::CreateForAdditiveNoise(
+            **noise_privacy_loss, estimate_type,
+            /*discretization_interval=*/1e-3);
+    std::unique_ptr<PrivacyLossDistribution> pld =
+        PrivacyLossDistribution::CreateForAdditiveNoise(
+            **noise_privacy_loss, estimate_type,
+            /*discretization_interval=*/1e-3);
+    std::unique_ptr<PrivacyLossDistribution> single_pld =
+        PrivacyLossDistribution::CreateForAdditiveNoise(
+            **noise_privacy_loss, estimate_type,
+            /*discretization_interval=*/1e-3);
+    single_pld->SetPmfPrecision(PmfPrecision::kSingle);
+    EXPECT_EQ(single_pld->GetPmfPrecision(), PmfPrecision::kSingle);
+
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_OK(pld->Compose(*step));
+      ASSERT_OK(single_pld->Compose(*step));
+    }
+
+    // Masses that underflow in single precision can only shrink the support.
+    EXPECT_LE(single_pld->UnpackedPmf().items.size(),
+              pld->UnpackedPmf().items.size());
+    for (double epsilon : {0.0, 0.5, 1.0, 2.0}) {
+      const double delta = pld->GetDeltaForEpsilon(epsilon);
+      const double single_delta = single_pld->GetDeltaForEpsilon(epsilon);
+      if (estimate_type == EstimateType::kPessimistic) {
+        EXPECT_GE(single_delta, delta);
+      } else {
+        EXPECT_LE(single_delta, delta);
+      }
+      EXPECT_NEAR(single_delta, delta, 1e-6);
+    }
+
+    // Widening back to double precision is exact.
+    const UnpackedProbabilityMassFunction single_pmf =
+        single_pld->UnpackedPmf();
+    single_pld->SetPmfPrecision(PmfPrecision::kDouble);
+    EXPECT_EQ(single_pld->UnpackedPmf().items, single_pmf.items);
+  }
+}
+
+TEST(PrivacyLossDistributionTest, ComposeDoesNotKeepWidenedPmf) {
+  ProbabilityMassFunction pmf = {{0, 0.5}, {1, 0.25}, {2, 0.25}};
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistributionTestPeer::Create(pmf);
+  std::unique_ptr<PrivacyLossDistribution> other_pld =
+      PrivacyLossDistributionTestPeer::Create(pmf);
+  pld->SetPmfPrecision(PmfPrecision::kSingle);
+  other_pld->SetPmfPrecision(PmfPrecision::kSingle);
+
+  ASSERT_OK(pld->GetDeltaForEpsilonForComposedPLD(*other_pld, 0));
+  ASSERT_OK(pld->Compose(*other_pld));
+  ASSERT_OK(pld->ComposeAll({other_pld.get()}));
+  pld->Compose(2);
+
+  EXPECT_FALSE(PrivacyLossDistributionTestPeer::HasWidenedPmf(*pld));
+  EXPECT_FALSE(PrivacyLossDistributionTestPeer::HasWidenedPmf(*other_pld));
+}
+
+TEST(PrivacyLossDistributionTest, ComposeAllMatchesSequentialCompose) {
+  absl::StatusOr<std::unique_ptr<AdditiveNoisePrivacyLoss>> laplace =
+      LaplacePrivacyLoss::Create(/*parameter=*/1, /*sensitivity=*/1);
+  ASSERT_OK(laplace);
+  absl::StatusOr<std::unique_ptr<AdditiveNoisePrivacyLoss>> gaussian =
+      GaussianPrivacyLoss::Create(/*standard_deviation=*/2, /*sensitivity=*/1);
+  ASSERT_OK(gaussian);
+  std::unique_ptr<PrivacyLossDistribution> laplace_pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(**laplace);
+  std::unique_ptr<PrivacyLossDistribution> gaussian_pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(**gaussian);
+
+  std::unique_ptr<PrivacyLossDistribution> sequential =
+      PrivacyLossDistribution::CreateIdentity();
+  ASSERT_OK(sequential->Compose(*laplace_pld, /*tail_mass_truncation=*/0));
+  ASSERT_OK(sequential->Compose(*gaussian_pld, /*tail_mass_truncation=*/0));
+  ASSERT_OK(sequential->Compose(*laplace_pld, /*tail_mass_truncation=*/0));
+
+  std::unique_ptr<PrivacyLossDistribution> batched =
+      PrivacyLossDistribution::CreateIdentity();
+  ASSERT_OK(batched->ComposeAll(
+      {laplace_pld.get(), gaussian_pld.get(), laplace_pld.get()},
+      /*tail_mass_truncation=*/0));
+
+  EXPECT_THAT(batched->InfinityMass(),
+              DoubleNear(sequential->InfinityMass(), kMaxError));
+  for (double epsilon : {0.5, 1.0, 2.0}) {
+    EXPECT_THAT(batched->GetDeltaForEpsilon(epsilon),
+                DoubleNear(sequential->GetDeltaForEpsilon(epsilon), 1e-9));
+  }
+}
+
+TEST(PrivacyLossDistributionTest, ComposeAllInfinityMass) {
+  ProbabilityMassFunction pmf = {{0, 0.7}};
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistributionTestPeer::Create(pmf, /*infinity_mass=*/0.3,
+                                              /*discretization_interval=*/1e-4);
+  ProbabilityMassFunction pmf_other = {{1, 0.8}};
+  std::unique_ptr<PrivacyLossDistribution> pld_other =
+      PrivacyLossDistributionTestPeer::Create(pmf_other,
+                                              /*infinity_mass=*/0.2,
+                                              /*discretization_interval=*/1e-4);
+
+  EXPECT_OK(pld->ComposeAll({pld_other.get(), pld_other.get()}));
+  // 1 - 0.7 * 0.8 * 0.8, plus the default tail mass truncation.
+  EXPECT_THAT(pld->InfinityMass(), DoubleNear(0.552, kMaxError));
+  EXPECT_THAT(pld->Pmf(), UnorderedElementsAre(Pair(2, DoubleNear(0.448,
+                                                                  kMaxError))));
+}
+
+TEST(PrivacyLossDistributionTest, ComposeAllValidatesAllPlds) {
+  ProbabilityMassFunction pmf = {{0, 1}};
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistributionTestPeer::Create(pmf, 0.3, 1e-4);
+  std::unique_ptr<PrivacyLossDistribution> pld_same =
+      PrivacyLossDistributionTestPeer::Create(pmf, 0.3, 1e-4);
+  std::unique_ptr<PrivacyLossDistribution> pld_other =
+      PrivacyLossDistributionTestPeer::Create(pmf, 0.3, 2e-4);
+
+  EXPECT_THAT(pld->ComposeAll({pld_same.get(), pld_other.get()}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("discretization interval")));
+  EXPECT_THAT(pld->InfinityMass(), DoubleNear(0.3, kMaxError));
+}
+
+TEST(PrivacyLossDistributionTest, UnpackedPmfMatchesPmf) {
+  ProbabilityMassFunction pmf = {{-2, 0.25}, {1, 0.5}, {2, 0.25}};
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistributionTestPeer::Create(pmf);
+  pld->Compose(/*num_times=*/2, /*tail_mass_truncation=*/0);
+
+  const UnpackedProbabilityMassFunction& unpacked = pld->UnpackedPmf();
+  EXPECT_EQ(unpacked.min_key, -4);
+  EXPECT_EQ(unpacked.items.size(), 9);
+  ProbabilityMassFunction expected_pmf = {{-4, 0.0625}, {-1, 0.25},
+                                          {0, 0.125},    {2, 0.25},
+                                          {3, 0.25},     {4, 0.0625}};
+  EXPECT_THAT(pld->Pmf(), PMFIsNear(expected_pmf));
+}
+
 TEST(PrivacyLossDistributionTest, GetDeltaForEpsilonForComposedPLD) {
   ProbabilityMassFunction pmf = {{0, 0.1}, {1, 0.7}, {2, 0.1}};
   std::unique_ptr<PrivacyLossDistribution> pld =
@@ -187,6 +413,53 @@ TEST(PrivacyLossDistributionTest, GetDeltaForEpsilonForComposedPLD) {
   EXPECT_THAT(*delta, DoubleNear(0.2956, kMaxError));
 }
 
+TEST(PrivacyLossDistributionTest,
+     GetDeltaForEpsilonForComposedPLDMatchesComposition) {
+  ProbabilityMassFunction pmf = {{-2, 0.2}, {0, 0.1}, {1, 0.5}, {2, 0.1}};
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistributionTestPeer::Create(pmf,
+                                              /*infinity_mass=*/0.1,
+                                              /*discretization_interval=*/0.4);
+  ProbabilityMassFunction pmf_other = {{-1, 0.3}, {2, 0.4}, {3, 0.25}};
+  std::unique_ptr<PrivacyLossDistribution> pld_other =
+      PrivacyLossDistributionTestPeer::Create(pmf_other,
+                                              /*infinity_mass=*/0.05,
+                                              /*discretization_interval=*/0.4);
+  std::unique_ptr<PrivacyLossDistribution> composed =
+      PrivacyLossDistributionTestPeer::Create(pmf,
+                                              /*infinity_mass=*/0.1,
+                                              /*discretization_interval=*/0.4);
+  ASSERT_OK(composed->Compose(*pld_other, /*tail_mass_truncation=*/0));
+
+  const std::vector<double> epsilons = {
+      -std::numeric_limits<double>::infinity(),
+      -1,
+      0,
+      0.4,
+      0.5,
+      1.1,
+      2,
+      100,
+      std::numeric_limits<double>::infinity()};
+  absl::StatusOr<std::vector<double>> deltas =
+      pld->GetDeltaForEpsilonForComposedPLD(*pld_other, epsilons);
+  ASSERT_OK(deltas);
+  ASSERT_EQ(deltas->size(), epsilons.size());
+  for (int i = 0; i < epsilons.size(); ++i) {
+    EXPECT_THAT((*deltas)[i],
+                DoubleNear(composed->GetDeltaForEpsilon(epsilons[i]), 1e-12))
+        << "epsilon " << epsilons[i];
+    absl::StatusOr<double> delta =
+        pld->GetDeltaForEpsilonForComposedPLD(*pld_other, epsilons[i]);
+    ASSERT_OK(delta);
+    EXPECT_EQ(*delta, (*deltas)[i]);
+  }
+
+  EXPECT_THAT(pld->GetDeltaForEpsilonForComposedPLD(
+                  *pld_other, std::numeric_limits<double>::quiet_NaN()),
+              StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("NaN")));
+}
+
 TEST(PrivacyLossDistributionTest, ComposeTruncation) {
   ProbabilityMassFunction pmf = {{0, 0.1}, {1, 0.7}, {2, 0.1}};
   std::unique_ptr<PrivacyLossDistribution> pld =
@@ -272,6 +545,44 @@ TEST(PrivacyLossDistributionTest, ComposeNumTimesTruncation) {
   EXPECT_NEAR(0.00153, pld->GetDeltaForEpsilon(3), kMaxError);
 }
 
+TEST(PrivacyLossDistributionTest, ComposeBySquaringMatchesCompose) {
+  ProbabilityMassFunction pmf = {{-1, 0.2}, {1, 0.5}, {2, 0.2}};
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistributionTestPeer::Create(pmf,
+                                              /*infinity_mass=*/0.1,
+                                              /*discretization_interval=*/0.1);
+  std::unique_ptr<PrivacyLossDistribution> pld_by_squaring =
+      PrivacyLossDistributionTestPeer::Create(pmf,
+                                              /*infinity_mass=*/0.1,
+                                              /*discretization_interval=*/0.1);
+
+  constexpr int num_times = 13;
+  pld->Compose(num_times);
+  pld_by_squaring->ComposeBySquaring(num_times);
+
+  EXPECT_THAT(pld_by_squaring->InfinityMass(),
+              DoubleNear(pld->InfinityMass(), kMaxError));
+  ProbabilityMassFunction expected_pmf = pld->Pmf();
+  EXPECT_THAT(pld_by_squaring->Pmf(), PMFIsNear(expected_pmf));
+}
+
+TEST(PrivacyLossDistributionTest, ComposeBySquaringTruncation) {
+  // Same setting as ComposeNumTimesTruncation.
+  int standard_deviation = 20;
+  int num_composition = standard_deviation * standard_deviation;
+  absl::StatusOr<std::unique_ptr<AdditiveNoisePrivacyLoss>> noise_privacy_loss =
+      GaussianPrivacyLoss::Create(standard_deviation, /*sensitivity=*/1);
+  ASSERT_OK(noise_privacy_loss);
+
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(
+          *noise_privacy_loss.value(), EstimateType::kPessimistic,
+          /*discretization_interval=*/1e-5);
+
+  pld->ComposeBySquaring(num_composition, /*tail_mass_truncation=*/1e-7);
+  EXPECT_NEAR(0.00153, pld->GetDeltaForEpsilon(3), kMaxError);
+}
+
 TEST(PrivacyLossDistributionTest,
      ComposeNumTimesTruncationAccountForTruncatedMass) {
   int num_composition = 2;
@@ -417,6 +728,57 @@ TEST(GetEpsilonFromDeltaTest, EpsilonFromDeltaInfinity) {
             std::numeric_limits<double>::infinity());
 }
 
+TEST(PrivacyLossDistributionTest, RepeatedQueriesMatchHockeyStickDivergence) {
+  absl::StatusOr<std::unique_ptr<GaussianPrivacyLoss>> gaussian =
+      GaussianPrivacyLoss::Create(/*standard_deviation=*/2, /*sensitivity=*/1);
+  ASSERT_OK(gaussian);
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(**gaussian);
+  pld->Compose(/*num_times=*/5);
+
+  const UnpackedProbabilityMassFunction& pmf = pld->UnpackedPmf();
+  for (double epsilon : {0.0, 0.1, 0.5, 1.0, 2.0, 4.0, 100.0}) {
+    double expected_delta = pld->InfinityMass();
+    for (int i = 0; i < pmf.items.size(); ++i) {
+      const double loss = (i + pmf.min_key) * pld->DiscretizationInterval();
+      if (loss > epsilon) {
+        expected_delta += (1 - std::exp(epsilon - loss)) * pmf.items[i];
+      }
+    }
+    EXPECT_NEAR(pld->GetDeltaForEpsilon(epsilon), expected_delta, 1e-12)
+        << "epsilon " << epsilon;
+  }
+
+  for (double delta : {1e-10, 1e-6, 1e-3, 0.1}) {
+    const double epsilon = pld->GetEpsilonForDelta(delta);
+    EXPECT_GT(epsilon, 0);
+    EXPECT_LE(pld->GetDeltaForEpsilon(epsilon), delta * (1 + 1e-6));
+    EXPECT_GT(pld->GetDeltaForEpsilon(epsilon * 0.99), delta);
+  }
+}
+
+TEST(PrivacyLossDistributionTest, QueriesReflectComposition) {
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistributionTestPeer::Create({{1, 0.6}, {-1, 0.4}},
+                                              /*infinity_mass=*/0,
+                                              /*discretization_interval=*/1);
+  std::unique_ptr<PrivacyLossDistribution> expected =
+      PrivacyLossDistributionTestPeer::Create(
+          {{2, 0.36}, {0, 0.48}, {-2, 0.16}}, /*infinity_mass=*/0,
+          /*discretization_interval=*/1);
+  const double delta_before = pld->GetDeltaForEpsilon(0.5);
+  const double epsilon_before = pld->GetEpsilonForDelta(0.1);
+
+  ASSERT_OK(pld->Compose(*pld, /*tail_mass_truncation=*/0));
+
+  EXPECT_NE(pld->GetDeltaForEpsilon(0.5), delta_before);
+  EXPECT_NE(pld->GetEpsilonForDelta(0.1), epsilon_before);
+  EXPECT_NEAR(pld->GetDeltaForEpsilon(0.5), expected->GetDeltaForEpsilon(0.5),
+              kMaxError);
+  EXPECT_NEAR(pld->GetEpsilonForDelta(0.1), expected->GetEpsilonForDelta(0.1),
+              kMaxError);
+}
+
 struct CreateParam {
   double discretization_interval;
   ProbabilityMassFunction expected_pmf;
@@ -979,6 +1341,38 @@ TEST(PrivacyLossDistributionTest, AccurateComposition) {
   EXPECT_NEAR(delta, 3.33762759e-9, 1e-10);
 }
 
+TEST(PrivacyLossDistributionTest, CreateForAdditiveNoiseInParallel) {
+  std::vector<std::unique_ptr<AdditiveNoisePrivacyLoss>> mechanisms;
+  mechanisms.push_back(LaplacePrivacyLoss::Create(/*parameter=*/1,
+                                                  /*sensitivity=*/1)
+                           .value());
+  mechanisms.push_back(GaussianPrivacyLoss::Create(/*standard_deviation=*/1,
+                                                   /*sensitivity=*/1)
+                           .value());
+  mechanisms.push_back(DiscreteLaplacePrivacyLoss::Create(/*parameter=*/0.01,
+                                                          /*sensitivity=*/1)
+                           .value());
+  mechanisms.push_back(DiscreteGaussianPrivacyLoss::Create(/*sigma=*/3000,
+                                                           /*sensitivity=*/1)
+                           .value());
+
+  for (const std::unique_ptr<AdditiveNoisePrivacyLoss>& mechanism :
+       mechanisms) {
+    std::unique_ptr<PrivacyLossDistribution> serial =
+        PrivacyLossDistribution::CreateForAdditiveNoise(
+            *mechanism, EstimateType::kPessimistic,
+            /*discretization_interval=*/1e-5);
+    std::unique_ptr<PrivacyLossDistribution> parallel =
+        PrivacyLossDistribution::CreateForAdditiveNoise(
+            *mechanism, EstimateType::kPessimistic,
+            /*discretization_interval=*/1e-5, /*num_threads=*/4);
+
+    EXPECT_EQ(parallel->InfinityMass(), serial->InfinityMass());
+    EXPECT_EQ(parallel->UnpackedPmf().min_key, serial->UnpackedPmf().min_key);
+    EXPECT_EQ(parallel->UnpackedPmf().items, serial->UnpackedPmf().items);
+  }
+}
+
 TEST(PrivacyLossDistributionTest, Serialization) {
   ProbabilityMassFunction pmf = {{1, 0.6}, {5, 0.3}};
   double infinity_mass = 0.1;
@@ -1021,6 +1415,48 @@ TEST(PrivacyLossDistributionTest, DeserializationNoPMFError) {
   EXPECT_THAT(PrivacyLossDistribution::Deserialize(serialized_pld),
               StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("PMF")));
 }
+
+TEST(PrivacyLossDistributionTest, BinarySerialization) {
+  for (EstimateType estimate_type :
+       {EstimateType::kPessimistic, EstimateType::kOptimistic}) {
+    ProbabilityMassFunction pmf = {{-2, 0.1}, {1, 0.5}, {5, 0.3}};
+    std::unique_ptr<PrivacyLossDistribution> pld =
+        PrivacyLossDistributionTestPeer::Create(
+            pmf, /*infinity_mass=*/0.1, /*discretization_interval=*/1e-3,
+            estimate_type);
+
+    absl::StatusOr<std::unique_ptr<PrivacyLossDistribution>>
+        deserialized_result =
+            PrivacyLossDistribution::DeserializeBinary(pld->SerializeBinary());
+    ASSERT_OK(deserialized_result);
+
+    EXPECT_THAT((*deserialized_result)->Pmf(), PMFIsNear(pmf));
+    EXPECT_EQ((*deserialized_result)->InfinityMass(), pld->InfinityMass());
+    EXPECT_EQ((*deserialized_result)->DiscretizationInterval(),
+              pld->DiscretizationInterval());
+    EXPECT_EQ((*deserialized_result)->GetEstimateType(), estimate_type);
+  }
+}
+
+TEST(PrivacyLossDistributionTest, BinaryDeserializationCorruptDataError) {
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistributionTestPeer::Create(
+          /*probability_mass_function=*/{{1, 0.6}, {5, 0.4}},
+          /*infinity_mass=*/0, /*discretization_interval=*/1e-4,
+          EstimateType::kPessimistic);
+  std::string data = pld->SerializeBinary();
+
+  EXPECT_THAT(PrivacyLossDistribution::DeserializeBinary(""),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PrivacyLossDistribution::DeserializeBinary(
+                  absl::string_view(data).substr(0, data.size() - 1)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  std::string bad_magic = data;
+  bad_magic[0] = 'X';
+  EXPECT_THAT(PrivacyLossDistribution::DeserializeBinary(bad_magic),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
 }  // namespace
 }  // namespace accounting
 }  // namespace differential_privacy
@@ -13,13 +13,29 @@
 // limitations under the License.
 #include "accounting/privacy_loss_mechanism.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <memory>
 #include <optional>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "boost/math/constants/constants.hpp"
+#include "boost/math/special_functions/erf.hpp"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
 namespace accounting {
+namespace {
+
+// Number of cached discrete Gaussian noise distributions above which the
+// ones that are no longer used are dropped.
+constexpr int kMaxCachedNoiseDistributions = 64;
+
+}  // namespace
 
 absl::StatusOr<std::unique_ptr<LaplacePrivacyLoss>> LaplacePrivacyLoss::Create(
     double parameter, double sensitivity) {
@@ -119,9 +135,10 @@ GaussianPrivacyLoss::Create(const EpsilonDelta& epsilon_delta,
       epsilon_delta.epsilon;
 
   BinarySearchParameters search_parameters = {
-      /*lower_bound=*/0,
-      /*upper_bound=*/std::numeric_limits<double>::infinity(),
-      /*.initial_guess=*/initial_standard_deviation};
+      .lower_bound = 0,
+      .upper_bound = std::numeric_limits<double>::infinity(),
+      .initial_guess = initial_standard_deviation,
+      .interpolate = true};
 
   auto compute_delta = [estimate_type,
                         epsilon_delta](double standard_deviation) {
@@ -162,6 +179,37 @@ double GaussianPrivacyLoss::PrivacyLoss(double x) const {
          std::pow(standard_deviation_, 2);
 }
 
+void GaussianPrivacyLoss::BatchPrivacyLoss(
+    absl::Span<const double> x, absl::Span<double> privacy_loss) const {
+  // Same operations, in the same order, as PrivacyLoss.
+  const double half_sensitivity = 0.5 * sensitivity_;
+  const double variance = std::pow(standard_deviation_, 2);
+  for (int i = 0; i < x.size(); ++i) {
+    privacy_loss[i] = half_sensitivity * (sensitivity_ - 2 * x[i]) / variance;
+  }
+}
+
+void GaussianPrivacyLoss::BatchInversePrivacyLoss(
+    absl::Span<const double> privacy_loss, absl::Span<double> x) const {
+  // Same operations, in the same order, as InversePrivacyLoss.
+  const double half_sensitivity = 0.5 * sensitivity_;
+  const double slope = std::pow(standard_deviation_, 2) / sensitivity_;
+  for (int i = 0; i < privacy_loss.size(); ++i) {
+    x[i] = half_sensitivity - privacy_loss[i] * slope;
+  }
+}
+
+void GaussianPrivacyLoss::BatchNoiseCdf(absl::Span<const double> x,
+                                        absl::Span<double> cdf) const {
+  // Same operations, in the same order, as boost::math::cdf for a normal
+  // distribution with mean 0, which also maps +-infinity to 1 and 0.
+  const double denominator =
+      standard_deviation_ * boost::math::constants::root_two<double>();
+  for (int i = 0; i < x.size(); ++i) {
+    cdf[i] = boost::math::erfc(-x[i] / denominator) / 2;
+  }
+}
+
 PrivacyLossTail GaussianPrivacyLoss::PrivacyLossDistributionTail() const {
   // We set lower_x_truncation so that CDF(lower_x_truncation) =
   // 0.5 * exp(log_mass_truncation_bound), and then set upper_x_truncation
@@ -261,19 +309,84 @@ DiscreteGaussianPrivacyLoss::Create(double sigma, int sensitivity,
     return absl::InvalidArgumentError(
         "Truncation bound should be at least half of sensitivity");
   }
-  ProbabilityMassFunction noise_pmf;
-  CumulativeDensityFunction noise_cdf;
+  return absl::WrapUnique(new DiscreteGaussianPrivacyLoss(
+      sigma, sensitivity, truncation_bound_value,
+      GetNoiseDistribution(sigma, truncation_bound_value)));
+}
 
-  for (int x = -truncation_bound_value; x <= truncation_bound_value; ++x) {
-    noise_pmf[x] = std::exp(-0.5 * std::pow(x, 2) / std::pow(sigma, 2));
-    noise_cdf[x] = noise_cdf[x - 1] + noise_pmf[x];
+std::shared_ptr<const DiscreteGaussianPrivacyLoss::NoiseDistribution>
+DiscreteGaussianPrivacyLoss::GetNoiseDistribution(double sigma,
+                                                  int truncation_bound) {
+  // The binary search in Create(EpsilonDelta) creates privacy losses for many
+  // different sigmas, so only distributions that are still in use are kept.
+  static absl::Mutex* mutex = new absl::Mutex();
+  static auto* cache = new absl::flat_hash_map<
+      std::pair<double, int>, std::weak_ptr<const NoiseDistribution>>();
+  const std::pair<double, int> key = {sigma, truncation_bound};
+  {
+    absl::MutexLock lock(mutex);
+    auto it = cache->find(key);
+    if (it != cache->end()) {
+      if (std::shared_ptr<const NoiseDistribution> distribution =
+              it->second.lock()) {
+        return distribution;
+      }
+    }
   }
-  for (int x = -truncation_bound_value; x <= truncation_bound_value; ++x) {
-    noise_pmf[x] /= noise_cdf[truncation_bound_value];
-    noise_cdf[x] /= noise_cdf[truncation_bound_value];
+
+  auto distribution = std::make_shared<NoiseDistribution>();
+  std::vector<double>& half_pmf = distribution->half_pmf;
+  half_pmf.resize(truncation_bound + 1);
+  // Uses exp(-(x + 1)^2 / (2 sigma^2)) = exp(-x^2 / (2 sigma^2)) * ratio(x)
+  // with ratio(x) = exp(-(2x + 1) / (2 sigma^2)) = ratio(x - 1) *
+  // exp(-1 / sigma^2). Both are recomputed at the start of every block so that
+  // rounding errors do not accumulate over large supports.
+  constexpr int kBlockSize = 64;
+  const double scale = -0.5 / (sigma * sigma);
+  const double ratio_step = std::exp(2 * scale);
+  for (int block = 0; block <= truncation_bound; block += kBlockSize) {
+    const int end = std::min(block + kBlockSize, truncation_bound + 1);
+    double value = std::exp(scale * block * block);
+    double ratio = std::exp(scale * (2.0 * block + 1));
+    for (int x = block; x < end; ++x) {
+      half_pmf[x] = value;
+      value *= ratio;
+      ratio *= ratio_step;
+    }
   }
-  return absl::WrapUnique(new DiscreteGaussianPrivacyLoss(
-      sigma, sensitivity, truncation_bound_value, noise_pmf, noise_cdf));
+
+  std::vector<double>& cdf = distribution->cdf;
+  cdf.resize(2 * truncation_bound + 1);
+  double total = 0;
+  for (int i = 0; i <= 2 * truncation_bound; ++i) {
+    total += half_pmf[std::abs(i - truncation_bound)];
+    cdf[i] = total;
+  }
+  double variance = 0;
+  for (int x = 0; x <= truncation_bound; ++x) {
+    half_pmf[x] /= total;
+    variance += 2 * half_pmf[x] * x * x;
+  }
+  for (double& value : cdf) value /= total;
+  distribution->variance = variance;
+
+  absl::MutexLock lock(mutex);
+  if (cache->size() >= kMaxCachedNoiseDistributions) {
+    for (auto it = cache->begin(); it != cache->end();) {
+      if (it->second.expired()) {
+        cache->erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+  std::weak_ptr<const NoiseDistribution>& cached = (*cache)[key];
+  if (std::shared_ptr<const NoiseDistribution> other = cached.lock()) {
+    // Another thread computed the same distribution in the meantime.
+    return other;
+  }
+  cached = distribution;
+  return distribution;
 }
 
 absl::StatusOr<std::unique_ptr<DiscreteGaussianPrivacyLoss>>
@@ -303,7 +416,8 @@ DiscreteGaussianPrivacyLoss::Create(const EpsilonDelta& epsilon_delta,
   BinarySearchParameters search_parameters = {
       .lower_bound = 0,
       .upper_bound = std::numeric_limits<double>::infinity(),
-      .initial_guess = initial_sigma};
+      .initial_guess = initial_sigma,
+      .interpolate = true};
 
   auto compute_delta = [sensitivity,
                         epsilon_delta](double sigma) -> absl::StatusOr<double> {
@@ -328,7 +442,13 @@ double DiscreteGaussianPrivacyLoss::InversePrivacyLoss(
 double DiscreteGaussianPrivacyLoss::NoiseCdf(double x) const {
   if (x >= truncation_bound_) return 1;
   if (x < -truncation_bound_) return 0;
-  return noise_cdf_.at(std::floor(x));
+  return noise_distribution_
+      ->cdf[static_cast<int>(std::floor(x)) + truncation_bound_];
+}
+
+double DiscreteGaussianPrivacyLoss::NoisePmf(int x) const {
+  if (x > truncation_bound_ || x < -truncation_bound_) return 0;
+  return noise_distribution_->half_pmf[std::abs(x)];
 }
 
 double DiscreteGaussianPrivacyLoss::PrivacyLoss(double x) const {
@@ -348,9 +468,7 @@ PrivacyLossTail DiscreteGaussianPrivacyLoss::PrivacyLossDistributionTail()
 }
 
 double DiscreteGaussianPrivacyLoss::StandardDeviation() const {
-  double variance = 0;
-  for (auto [x, p] : noise_pmf_) variance += (p * std::pow(x, 2));
-  return std::sqrt(variance);
+  return std::sqrt(noise_distribution_->variance);
 }
 
 }  // namespace accounting
@@ -15,9 +15,14 @@
 #ifndef DIFFERENTIAL_PRIVACY_ACCOUNTING_PRIVACY_LOSS_MECHANISM_H_
 #define DIFFERENTIAL_PRIVACY_ACCOUNTING_PRIVACY_LOSS_MECHANISM_H_
 
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "boost/math/distributions/laplace.hpp"
 #include "boost/math/distributions/normal.hpp"
 #include "accounting/common/common.h"
@@ -85,6 +90,30 @@ class AdditiveNoisePrivacyLoss {
   // that mu is less than or equal to x.
   virtual double NoiseCdf(double x) const = 0;
 
+  // Batched versions of PrivacyLoss, InversePrivacyLoss and NoiseCdf, which
+  // write the value for each input to the output at the same index. Both spans
+  // must have the same size. The results are the same as the ones of the
+  // scalar versions; subclasses may override these to evaluate the batch more
+  // efficiently. Used when discretizing the privacy loss distribution.
+  virtual void BatchPrivacyLoss(absl::Span<const double> x,
+                                absl::Span<double> privacy_loss) const {
+    for (int i = 0; i < x.size(); ++i) {
+      privacy_loss[i] = PrivacyLoss(x[i]);
+    }
+  }
+  virtual void BatchInversePrivacyLoss(absl::Span<const double> privacy_loss,
+                                       absl::Span<double> x) const {
+    for (int i = 0; i < privacy_loss.size(); ++i) {
+      x[i] = InversePrivacyLoss(privacy_loss[i]);
+    }
+  }
+  virtual void BatchNoiseCdf(absl::Span<const double> x,
+                             absl::Span<double> cdf) const {
+    for (int i = 0; i < x.size(); ++i) {
+      cdf[i] = NoiseCdf(x[i]);
+    }
+  }
+
   // Computes the epsilon-hockey stick divergence of the mechanism.
   // That is for a given epsilon returns delta such that the mechanism is
   // (epsilon, delta)-DP.
@@ -204,6 +233,18 @@ class GaussianPrivacyLoss : public AdditiveNoisePrivacyLoss {
 
   double PrivacyLoss(double x) const override;
 
+  // The privacy loss and its inverse are affine, so the batched versions
+  // hoist the coefficients out of the loop, which lets it vectorize.
+  void BatchPrivacyLoss(absl::Span<const double> x,
+                        absl::Span<double> privacy_loss) const override;
+  void BatchInversePrivacyLoss(absl::Span<const double> privacy_loss,
+                               absl::Span<double> x) const override;
+
+  // Evaluates the same erfc expression as NoiseCdf, but skips the parameter
+  // checks of boost::math::cdf and computes the scale once for all points.
+  void BatchNoiseCdf(absl::Span<const double> x,
+                     absl::Span<double> cdf) const override;
+
   PrivacyLossTail PrivacyLossDistributionTail() const override;
 
   double StandardDeviation() const { return standard_deviation_; }
@@ -333,20 +374,37 @@ class DiscreteGaussianPrivacyLoss : public AdditiveNoisePrivacyLoss {
 
   int TruncationBound() const { return truncation_bound_; }
 
+  // Returns the probability that the (truncated) noise is equal to x.
+  double NoisePmf(int x) const;
+
+  // Normalized distribution of the truncated noise. It only depends on sigma
+  // and the truncation bound, and is shared between all privacy losses with
+  // the same parameters.
+  struct NoiseDistribution {
+    // half_pmf[i] = PMF(i) = PMF(-i) for i in [0, truncation_bound].
+    std::vector<double> half_pmf;
+    // cdf[i] = CDF(i - truncation_bound) for i in [0, 2 * truncation_bound].
+    std::vector<double> cdf;
+    double variance;
+  };
+
  private:
-  DiscreteGaussianPrivacyLoss(double sigma, int sensitivity,
-                              int truncation_bound,
-                              ProbabilityMassFunction noise_pmf,
-                              CumulativeDensityFunction noise_cdf)
+  DiscreteGaussianPrivacyLoss(
+      double sigma, int sensitivity, int truncation_bound,
+      std::shared_ptr<const NoiseDistribution> noise_distribution)
       : AdditiveNoisePrivacyLoss(sensitivity),
         sigma_(sigma),
         truncation_bound_(truncation_bound),
-        noise_pmf_(noise_pmf),
-        noise_cdf_(noise_cdf) {}
+        noise_distribution_(std::move(noise_distribution)) {}
+
+  // Returns the noise distribution for the given parameters, computing it only
+  // if no other privacy loss currently holds it.
+  static std::shared_ptr<const NoiseDistribution> GetNoiseDistribution(
+      double sigma, int truncation_bound);
+
   const double sigma_;
   const int truncation_bound_;
-  const ProbabilityMassFunction noise_pmf_;
-  const CumulativeDensityFunction noise_cdf_;
+  const std::shared_ptr<const NoiseDistribution> noise_distribution_;
 };
 }  // namespace accounting
 }  // namespace differential_privacy
@@ -14,11 +14,16 @@
 
 #include "accounting/privacy_loss_mechanism.h"
 
+#include <cmath>
+#include <memory>
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "base/testing/status_matchers.h"
 
 namespace differential_privacy {
@@ -141,6 +146,29 @@ TEST(GaussianPrivacyLoss, InversePrivacyLoss) {
   EXPECT_DOUBLE_EQ(mechanism.value()->InversePrivacyLoss(-4), 21);
 }
 
+TEST(GaussianPrivacyLoss, BatchMethodsMatchScalarMethods) {
+  absl::StatusOr<std::unique_ptr<GaussianPrivacyLoss>> mechanism =
+      GaussianPrivacyLoss::Create(/*standard_deviation=*/1.3,
+                                  /*sensitivity=*/0.7);
+  ASSERT_OK(mechanism);
+  const std::vector<double> input = {-40, -3.1, -0.2, 0, 0.35, 1, 7.5, 40};
+  std::vector<double> privacy_loss(input.size());
+  std::vector<double> inverse_privacy_loss(input.size());
+  std::vector<double> cdf(input.size());
+
+  (*mechanism)->BatchPrivacyLoss(input, absl::MakeSpan(privacy_loss));
+  (*mechanism)->BatchInversePrivacyLoss(input,
+                                        absl::MakeSpan(inverse_privacy_loss));
+  (*mechanism)->BatchNoiseCdf(input, absl::MakeSpan(cdf));
+
+  for (int i = 0; i < input.size(); ++i) {
+    EXPECT_EQ(privacy_loss[i], (*mechanism)->PrivacyLoss(input[i]));
+    EXPECT_EQ(inverse_privacy_loss[i],
+              (*mechanism)->InversePrivacyLoss(input[i]));
+    EXPECT_EQ(cdf[i], (*mechanism)->NoiseCdf(input[i]));
+  }
+}
+
 TEST(GaussianPrivacyLoss, PrivacyLossTailPessimistic) {
   absl::StatusOr<std::unique_ptr<GaussianPrivacyLoss>> mechanism =
       GaussianPrivacyLoss::Create(
@@ -618,6 +646,42 @@ TEST(DiscreteGaussianPrivacyLossTest, StandardDeviation) {
   EXPECT_THAT(std, DoubleNear(1.3589226, kMaxError));
 }
 
+TEST(DiscreteGaussianPrivacyLossTest, NoisePmfMatchesDirectFormula) {
+  const double sigma = 150;
+  absl::StatusOr<std::unique_ptr<DiscreteGaussianPrivacyLoss>> mechanism =
+      DiscreteGaussianPrivacyLoss::Create(sigma, /*sensitivity=*/1);
+  ASSERT_OK(mechanism);
+  const int truncation_bound = (*mechanism)->TruncationBound();
+
+  double normalizer = 0;
+  for (int x = -truncation_bound; x <= truncation_bound; ++x) {
+    normalizer += std::exp(-0.5 * x * x / (sigma * sigma));
+  }
+  double cdf = 0;
+  for (int x = -truncation_bound; x <= truncation_bound; ++x) {
+    const double pmf = std::exp(-0.5 * x * x / (sigma * sigma)) / normalizer;
+    cdf += pmf;
+    EXPECT_NEAR((*mechanism)->NoisePmf(x), pmf, 1e-12 * pmf);
+    EXPECT_NEAR((*mechanism)->NoiseCdf(x), cdf, 1e-12);
+  }
+  EXPECT_EQ((*mechanism)->NoisePmf(truncation_bound + 1), 0);
+  EXPECT_EQ((*mechanism)->NoisePmf(-truncation_bound - 1), 0);
+  EXPECT_NEAR((*mechanism)->StandardDeviation(), sigma, 1e-6 * sigma);
+}
+
+TEST(DiscreteGaussianPrivacyLossTest, SameParametersGiveSameNoise) {
+  absl::StatusOr<std::unique_ptr<DiscreteGaussianPrivacyLoss>> first =
+      DiscreteGaussianPrivacyLoss::Create(/*sigma=*/2.5, /*sensitivity=*/1);
+  ASSERT_OK(first);
+  absl::StatusOr<std::unique_ptr<DiscreteGaussianPrivacyLoss>> second =
+      DiscreteGaussianPrivacyLoss::Create(/*sigma=*/2.5, /*sensitivity=*/3);
+  ASSERT_OK(second);
+  for (int x = -40; x <= 40; ++x) {
+    EXPECT_EQ((*first)->NoiseCdf(x), (*second)->NoiseCdf(x));
+  }
+  EXPECT_EQ((*first)->StandardDeviation(), (*second)->StandardDeviation());
+}
+
 TEST(DiscreteGaussianPrivacyLoss, InvalidDelta) {
   EpsilonDelta epsilon_delta = {/*epsilon=*/1, /*delta=*/0};
   absl::StatusOr<std::unique_ptr<DiscreteGaussianPrivacyLoss>> mechanism =
@@ -0,0 +1,446 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Python bindings for the privacy loss distribution accountant.
+//
+// Probability mass functions are exchanged as one-dimensional float64 NumPy
+// arrays of the masses at min_key, min_key + 1, ..., the unpacked form used
+// for composition. C-contiguous float64 inputs of convolve and of the array
+// methods of the privacy losses are read in place, and results that are
+// computed for the caller are handed over to NumPy without a copy. Other
+// inputs are converted by NumPy first.
+
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "pybind11/numpy.h"
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+#include "accounting/common/common.h"
+#include "accounting/convolution.h"
+#include "accounting/privacy_loss_distribution.h"
+#include "accounting/privacy_loss_mechanism.h"
+
+namespace differential_privacy {
+namespace accounting {
+namespace {
+
+namespace py = ::pybind11;
+
+using DoubleArray =
+    py::array_t<double, py::array::c_style | py::array::forcecast>;
+
+// Raises ValueError for failed statuses; pybind11 translates the exception.
+void ThrowIfError(const absl::Status& status) {
+  if (!status.ok()) {
+    throw std::invalid_argument(std::string(status.message()));
+  }
+}
+
+template <typename T>
+T ValueOrThrow(absl::StatusOr<T> status_or) {
+  ThrowIfError(status_or.status());
+  return *std::move(status_or);
+}
+
+absl::Span<const double> AsSpan(const DoubleArray& array) {
+  if (array.ndim() != 1) {
+    throw std::invalid_argument("Expected a one-dimensional array.");
+  }
+  return absl::MakeConstSpan(array.data(), array.size());
+}
+
+// Moves values into a NumPy array that owns them, without copying.
+DoubleArray ToArray(std::vector<double> values) {
+  auto* owned = new std::vector<double>(std::move(values));
+  py::capsule owner(owned, [](void* ptr) {
+    delete static_cast<std::vector<double>*>(ptr);
+  });
+  return DoubleArray(owned->size(), owned->data(), owner);
+}
+
+// Evaluates a batch method of a privacy loss on an array of points.
+template <void (AdditiveNoisePrivacyLoss::*method)(absl::Span<const double>,
+                                                    absl::Span<double>) const>
+DoubleArray Batch(const AdditiveNoisePrivacyLoss& privacy_loss,
+                  const DoubleArray& x) {
+  absl::Span<const double> input = AsSpan(x);
+  std::vector<double> output(input.size());
+  {
+    py::gil_scoped_release release;
+    (privacy_loss.*method)(input, absl::MakeSpan(output));
+  }
+  return ToArray(std::move(output));
+}
+
+// Returns the masses and min_key of the PLD. The masses are copied, since the
+// PLD replaces its buffer when it is composed.
+py::tuple PldPmf(const PrivacyLossDistribution& pld) {
+  const UnpackedProbabilityMassFunction& pmf = pld.UnpackedPmf();
+  return py::make_tuple(pmf.min_key, ToArray(pmf.items));
+}
+
+}  // namespace
+
+PYBIND11_MODULE(pld_bindings, m) {
+  m.doc() = "Privacy loss distribution accountant.";
+
+  py::enum_<EstimateType>(m, "EstimateType")
+      .value("OPTIMISTIC", EstimateType::kOptimistic)
+      .value("PESSIMISTIC", EstimateType::kPessimistic);
+
+  py::enum_<NoiseType>(m, "NoiseType")
+      .value("DISCRETE", NoiseType::kDiscrete)
+      .value("CONTINUOUS", NoiseType::kContinuous);
+
+  py::enum_<PmfPrecision>(m, "PmfPrecision")
+      .value("DOUBLE", PmfPrecision::kDouble)
+      .value("SINGLE", PmfPrecision::kSingle);
+
+  py::class_<EpsilonDelta>(m, "EpsilonDelta")
+      .def(py::init([](double epsilon, double delta) {
+             return EpsilonDelta{epsilon, delta};
+           }),
+           py::arg("epsilon"), py::arg("delta"))
+      .def_readwrite("epsilon", &EpsilonDelta::epsilon)
+      .def_readwrite("delta", &EpsilonDelta::delta);
+
+  // Privacy losses of additive noise mechanisms. The array versions of the
+  // per-point methods evaluate the batch methods with the GIL released.
+  py::class_<AdditiveNoisePrivacyLoss>(m, "AdditiveNoisePrivacyLoss")
+      .def("discrete", &AdditiveNoisePrivacyLoss::Discrete)
+      .def("privacy_loss", &AdditiveNoisePrivacyLoss::PrivacyLoss,
+           py::arg("x"))
+      .def("privacy_loss",
+           &Batch<&AdditiveNoisePrivacyLoss::BatchPrivacyLoss>, py::arg("x"))
+      .def("inverse_privacy_loss",
+           &AdditiveNoisePrivacyLoss::InversePrivacyLoss,
+           py::arg("privacy_loss"))
+      .def("inverse_privacy_loss",
+           &Batch<&AdditiveNoisePrivacyLoss::BatchInversePrivacyLoss>,
+           py::arg("privacy_loss"))
+      .def("noise_cdf", &AdditiveNoisePrivacyLoss::NoiseCdf, py::arg("x"))
+      .def("noise_cdf", &Batch<&AdditiveNoisePrivacyLoss::BatchNoiseCdf>,
+           py::arg("x"))
+      .def("get_delta_for_epsilon",
+           &AdditiveNoisePrivacyLoss::GetDeltaForEpsilon, py::arg("epsilon"))
+      .def_property_readonly("sensitivity",
+                             &AdditiveNoisePrivacyLoss::Sensitivity);
+
+  py::class_<LaplacePrivacyLoss, AdditiveNoisePrivacyLoss>(
+      m, "LaplacePrivacyLoss")
+      .def_static(
+          "create",
+          [](double parameter, double sensitivity) {
+            return ValueOrThrow(
+                LaplacePrivacyLoss::Create(parameter, sensitivity));
+          },
+          py::arg("parameter"), py::arg("sensitivity") = 1)
+      .def_static(
+          "from_epsilon_delta",
+          [](const EpsilonDelta& epsilon_delta) {
+            return ValueOrThrow(LaplacePrivacyLoss::Create(epsilon_delta));
+          },
+          py::arg("epsilon_delta"))
+      .def_property_readonly("parameter", &LaplacePrivacyLoss::Parameter);
+
+  py::class_<GaussianPrivacyLoss, AdditiveNoisePrivacyLoss>(
+      m, "GaussianPrivacyLoss")
+      .def_static(
+          "create",
+          [](double standard_deviation, double sensitivity,
+             EstimateType estimate_type, double log_mass_truncation_bound) {
+            return ValueOrThrow(GaussianPrivacyLoss::Create(
+                standard_deviation, sensitivity, estimate_type,
+                log_mass_truncation_bound));
+          },
+          py::arg("standard_deviation"), py::arg("sensitivity") = 1,
+          py::arg("estimate_type") = EstimateType::kPessimistic,
+          py::arg("log_mass_truncation_bound") = -50)
+      .def_static(
+          "from_epsilon_delta",
+          [](const EpsilonDelta& epsilon_delta, EstimateType estimate_type,
+             double log_mass_truncation_bound) {
+            return ValueOrThrow(GaussianPrivacyLoss::Create(
+                epsilon_delta, estimate_type, log_mass_truncation_bound));
+          },
+          py::arg("epsilon_delta"),
+          py::arg("estimate_type") = EstimateType::kPessimistic,
+          py::arg("log_mass_truncation_bound") = -50)
+      .def_property_readonly("standard_deviation",
+                             &GaussianPrivacyLoss::StandardDeviation);
+
+  py::class_<DiscreteLaplacePrivacyLoss, AdditiveNoisePrivacyLoss>(
+      m, "DiscreteLaplacePrivacyLoss")
+      .def_static(
+          "create",
+          [](double parameter, int sensitivity) {
+            return ValueOrThrow(
+                DiscreteLaplacePrivacyLoss::Create(parameter, sensitivity));
+          },
+          py::arg("parameter"), py::arg("sensitivity") = 1)
+      .def_static(
+          "from_epsilon_delta",
+          [](const EpsilonDelta& epsilon_delta, int sensitivity) {
+            return ValueOrThrow(
+                DiscreteLaplacePrivacyLoss::Create(epsilon_delta, sensitivity));
+          },
+          py::arg("epsilon_delta"), py::arg("sensitivity") = 1)
+      .def_property_readonly("parameter",
+                             &DiscreteLaplacePrivacyLoss::Parameter);
+
+  py::class_<DiscreteGaussianPrivacyLoss, AdditiveNoisePrivacyLoss>(
+      m, "DiscreteGaussianPrivacyLoss")
+      .def_static(
+          "create",
+          [](double sigma, int sensitivity,
+             std::optional<int> truncation_bound) {
+            return ValueOrThrow(DiscreteGaussianPrivacyLoss::Create(
+                sigma, sensitivity, truncation_bound));
+          },
+          py::arg("sigma"), py::arg("sensitivity") = 1,
+          py::arg("truncation_bound") = std::nullopt)
+      .def_static(
+          "from_epsilon_delta",
+          [](const EpsilonDelta& epsilon_delta, int sensitivity) {
+            return ValueOrThrow(DiscreteGaussianPrivacyLoss::Create(
+                epsilon_delta, sensitivity));
+          },
+          py::arg("epsilon_delta"), py::arg("sensitivity") = 1)
+      .def_property_readonly("sigma", &DiscreteGaussianPrivacyLoss::Sigma)
+      .def_property_readonly("standard_deviation",
+                             &DiscreteGaussianPrivacyLoss::StandardDeviation)
+      .def_property_readonly("truncation_bound",
+                             &DiscreteGaussianPrivacyLoss::TruncationBound);
+
+  py::class_<PrivacyLossDistribution>(m, "PrivacyLossDistribution")
+      .def_static("create_identity", &PrivacyLossDistribution::CreateIdentity,
+                  py::arg("discretization_interval") = 1e-4,
+                  py::arg("estimate_type") = EstimateType::kPessimistic)
+      .def_static(
+          "create_for_additive_noise",
+          [](const AdditiveNoisePrivacyLoss& privacy_loss,
+             EstimateType estimate_type, double discretization_interval,
+             int num_threads) {
+            py::gil_scoped_release release;
+            return PrivacyLossDistribution::CreateForAdditiveNoise(
+                privacy_loss, estimate_type, discretization_interval,
+                num_threads);
+          },
+          py::arg("privacy_loss"),
+          py::arg("estimate_type") = EstimateType::kPessimistic,
+          py::arg("discretization_interval") = 1e-4,
+          py::arg("num_threads") = 1)
+      .def_static(
+          "create_for_randomized_response",
+          [](double noise_parameter, int num_buckets,
+             EstimateType estimate_type, double discretization_interval) {
+            return ValueOrThrow(
+                PrivacyLossDistribution::CreateForRandomizedResponse(
+                    noise_parameter, num_buckets, estimate_type,
+                    discretization_interval));
+          },
+          py::arg("noise_parameter"), py::arg("num_buckets"),
+          py::arg("estimate_type") = EstimateType::kPessimistic,
+          py::arg("discretization_interval") = 1e-4)
+      .def_static(
+          "create_for_laplace_mechanism",
+          [](double parameter, double sensitivity, EstimateType estimate_type,
+             double discretization_interval) {
+            return ValueOrThrow(
+                PrivacyLossDistribution::CreateForLaplaceMechanism(
+                    parameter, sensitivity, estimate_type,
+                    discretization_interval));
+          },
+          py::arg("parameter"), py::arg("sensitivity") = 1,
+          py::arg("estimate_type") = EstimateType::kPessimistic,
+          py::arg("discretization_interval") = 1e-4)
+      .def_static(
+          "create_for_discrete_laplace_mechanism",
+          [](double parameter, int sensitivity, EstimateType estimate_type,
+             double discretization_interval) {
+            return ValueOrThrow(
+                PrivacyLossDistribution::CreateForDiscreteLaplaceMechanism(
+                    parameter, sensitivity, estimate_type,
+                    discretization_interval));
+          },
+          py::arg("parameter"), py::arg("sensitivity") = 1,
+          py::arg("estimate_type") = EstimateType::kPessimistic,
+          py::arg("discretization_interval") = 1e-4)
+      .def_static(
+          "create_for_gaussian_mechanism",
+          [](double standard_deviation, double sensitivity,
+             EstimateType estimate_type, double discretization_interval,
+             double mass_truncation_bound) {
+            return ValueOrThrow(
+                PrivacyLossDistribution::CreateForGaussianMechanism(
+                    standard_deviation, sensitivity, estimate_type,
+                    discretization_interval, mass_truncation_bound));
+          },
+          py::arg("standard_deviation"), py::arg("sensitivity") = 1,
+          py::arg("estimate_type") = EstimateType::kPessimistic,
+          py::arg("discretization_interval") = 1e-4,
+          py::arg("mass_truncation_bound") = -50)
+      .def_static(
+          "create_for_discrete_gaussian_mechanism",
+          [](double sigma, int sensitivity, EstimateType estimate_type,
+             double discretization_interval,
+             std::optional<int> truncation_bound) {
+            return ValueOrThrow(
+                PrivacyLossDistribution::CreateForDiscreteGaussianMechanism(
+                    sigma, sensitivity, estimate_type, discretization_interval,
+                    truncation_bound));
+          },
+          py::arg("sigma"), py::arg("sensitivity") = 1,
+          py::arg("estimate_type") = EstimateType::kPessimistic,
+          py::arg("discretization_interval") = 1e-4,
+          py::arg("truncation_bound") = std::nullopt)
+      .def_static("create_for_privacy_parameters",
+                  &PrivacyLossDistribution::CreateForPrivacyParameters,
+                  py::arg("epsilon_delta"),
+                  py::arg("discretization_interval") = 1e-4)
+      .def("get_delta_for_epsilon",
+           &PrivacyLossDistribution::GetDeltaForEpsilon, py::arg("epsilon"))
+      .def(
+          "get_delta_for_epsilon",
+          [](const PrivacyLossDistribution& pld, const DoubleArray& epsilons) {
+            absl::Span<const double> input = AsSpan(epsilons);
+            std::vector<double> deltas(input.size());
+            {
+              py::gil_scoped_release release;
+              for (int i = 0; i < input.size(); ++i) {
+                deltas[i] = pld.GetDeltaForEpsilon(input[i]);
+              }
+            }
+            return ToArray(std::move(deltas));
+          },
+          py::arg("epsilons"))
+      .def("get_epsilon_for_delta",
+           &PrivacyLossDistribution::GetEpsilonForDelta, py::arg("delta"))
+      .def(
+          "compose",
+          [](PrivacyLossDistribution& pld,
+             const PrivacyLossDistribution& other_pld,
+             double tail_mass_truncation, int max_support_size) {
+            absl::Status status;
+            {
+              py::gil_scoped_release release;
+              status = pld.Compose(other_pld, tail_mass_truncation,
+                                   max_support_size);
+            }
+            ThrowIfError(status);
+          },
+          py::arg("other_pld"), py::arg("tail_mass_truncation") = 1e-15,
+          py::arg("max_support_size") = 0)
+      .def(
+          "self_compose",
+          [](PrivacyLossDistribution& pld, int num_times,
+             double tail_mass_truncation) {
+            py::gil_scoped_release release;
+            pld.ComposeBySquaring(num_times, tail_mass_truncation);
+          },
+          py::arg("num_times"), py::arg("tail_mass_truncation") = 1e-15)
+      .def(
+          "get_delta_for_epsilon_for_composed_pld",
+          [](const PrivacyLossDistribution& pld,
+             const PrivacyLossDistribution& other_pld, double epsilon) {
+            return ValueOrThrow(
+                pld.GetDeltaForEpsilonForComposedPLD(other_pld, epsilon));
+          },
+          py::arg("other_pld"), py::arg("epsilon"))
+      .def(
+          "coarsen",
+          [](PrivacyLossDistribution& pld, int factor) {
+            ThrowIfError(pld.Coarsen(factor));
+          },
+          py::arg("factor"))
+      .def_property("pmf_precision", &PrivacyLossDistribution::GetPmfPrecision,
+                    &PrivacyLossDistribution::SetPmfPrecision)
+      .def_property_readonly("discretization_interval",
+                             &PrivacyLossDistribution::DiscretizationInterval)
+      .def_property_readonly("estimate_type",
+                             &PrivacyLossDistribution::GetEstimateType)
+      .def_property_readonly("infinity_mass",
+                             &PrivacyLossDistribution::InfinityMass)
+      .def("pmf", &PldPmf,
+           "Returns (min_key, masses), the masses of the privacy losses "
+           "(min_key + i) * discretization_interval.")
+      .def(
+          "serialize",
+          [](const PrivacyLossDistribution& pld) {
+            return py::bytes(pld.SerializeBinary());
+          },
+          "Serializes the PLD into the compact binary format.")
+      .def_static(
+          "deserialize",
+          [](const py::bytes& data) {
+            return ValueOrThrow(PrivacyLossDistribution::DeserializeBinary(
+                std::string_view(data)));
+          },
+          py::arg("data"));
+
+  m.def(
+      "convolve",
+      [](int x_min_key, const DoubleArray& x, int y_min_key,
+         const DoubleArray& y, double tail_mass_truncation) {
+        absl::Span<const double> x_items = AsSpan(x);
+        absl::Span<const double> y_items = AsSpan(y);
+        UnpackedProbabilityMassFunction result;
+        {
+          py::gil_scoped_release release;
+          result = Convolve(x_min_key, x_items, y_min_key, y_items,
+                            tail_mass_truncation);
+        }
+        return py::make_tuple(result.min_key,
+                              ToArray(std::move(result.items)));
+      },
+      py::arg("x_min_key"), py::arg("x"), py::arg("y_min_key"), py::arg("y"),
+      py::arg("tail_mass_truncation") = 0,
+      "Convolves the PMFs with masses x and y at x_min_key + i and "
+      "y_min_key + i. Returns (min_key, masses) of the result.");
+
+  m.def(
+      "self_convolve",
+      [](int min_key, const DoubleArray& x, int num_times,
+         double tail_mass_truncation) {
+        absl::Span<const double> items = AsSpan(x);
+        UnpackedProbabilityMassFunction input;
+        input.min_key = min_key;
+        input.items.assign(items.begin(), items.end());
+        UnpackedProbabilityMassFunction result;
+        {
+          py::gil_scoped_release release;
+          result = ConvolveBySquaring(input, num_times, tail_mass_truncation);
+        }
+        return py::make_tuple(result.min_key,
+                              ToArray(std::move(result.items)));
+      },
+      py::arg("min_key"), py::arg("x"), py::arg("num_times"),
+      py::arg("tail_mass_truncation") = 0,
+      "Convolves the PMF with masses x at min_key + i with itself num_times. "
+      "Returns (min_key, masses) of the result.");
+}
+
+}  // namespace accounting
+}  // namespace differential_privacy
@@ -0,0 +1,96 @@
+#
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Tests for the Python bindings of the PLD accountant."""
+
+import unittest
+
+import numpy as np
+
+from accounting.python import pld_bindings
+
+PrivacyLossDistribution = pld_bindings.PrivacyLossDistribution
+
+
+class PrivacyLossMechanismTest(unittest.TestCase):
+
+  def test_array_methods_match_scalar_methods(self):
+    privacy_loss = pld_bindings.GaussianPrivacyLoss.create(
+        standard_deviation=2.0, sensitivity=1.0)
+    x = np.linspace(-5, 5, 11)
+    np.testing.assert_array_equal(
+        privacy_loss.privacy_loss(x),
+        [privacy_loss.privacy_loss(value) for value in x])
+    np.testing.assert_array_equal(
+        privacy_loss.noise_cdf(x),
+        [privacy_loss.noise_cdf(value) for value in x])
+
+  def test_invalid_parameters_raise_value_error(self):
+    with self.assertRaises(ValueError):
+      pld_bindings.LaplacePrivacyLoss.create(parameter=-1.0)
+
+
+class PrivacyLossDistributionTest(unittest.TestCase):
+
+  def test_compose_matches_self_compose(self):
+    pld = PrivacyLossDistribution.create_for_laplace_mechanism(
+        parameter=1.0, discretization_interval=1e-3)
+    step = PrivacyLossDistribution.create_for_laplace_mechanism(
+        parameter=1.0, discretization_interval=1e-3)
+    squared = PrivacyLossDistribution.create_for_laplace_mechanism(
+        parameter=1.0, discretization_interval=1e-3)
+    pld.compose(step)
+    squared.self_compose(2)
+    self.assertAlmostEqual(
+        pld.get_delta_for_epsilon(1.0), squared.get_delta_for_epsilon(1.0))
+    epsilons = np.array([0.0, 0.5, 1.0])
+    np.testing.assert_array_equal(
+        pld.get_delta_for_epsilon(epsilons),
+        [pld.get_delta_for_epsilon(epsilon) for epsilon in epsilons])
+
+  def test_pmf_sums_to_finite_mass(self):
+    pld = PrivacyLossDistribution.create_for_gaussian_mechanism(
+        standard_deviation=1.0, discretization_interval=1e-2)
+    min_key, masses = pld.pmf()
+    self.assertIsInstance(min_key, int)
+    self.assertEqual(masses.dtype, np.float64)
+    self.assertAlmostEqual(np.sum(masses) + pld.infinity_mass, 1.0)
+
+  def test_serialize_round_trip(self):
+    pld = PrivacyLossDistribution.create_for_laplace_mechanism(
+        parameter=2.0, discretization_interval=1e-3)
+    restored = PrivacyLossDistribution.deserialize(pld.serialize())
+    self.assertEqual(
+        restored.get_delta_for_epsilon(0.1), pld.get_delta_for_epsilon(0.1))
+
+
+class ConvolveTest(unittest.TestCase):
+
+  def test_convolve(self):
+    min_key, masses = pld_bindings.convolve(
+        x_min_key=1, x=np.array([0.5, 0.5]), y_min_key=-1,
+        y=np.array([0.25, 0.75]))
+    self.assertEqual(min_key, 0)
+    np.testing.assert_allclose(masses, [0.125, 0.5, 0.375], atol=1e-12)
+
+  def test_self_convolve_matches_convolve(self):
+    x = np.array([0.2, 0.3, 0.5])
+    min_key, masses = pld_bindings.convolve(0, x, 0, x)
+    self_min_key, self_masses = pld_bindings.self_convolve(0, x, num_times=2)
+    self.assertEqual(self_min_key, min_key)
+    np.testing.assert_allclose(self_masses, masses, atol=1e-12)
+
+
+if __name__ == '__main__':
+  unittest.main()
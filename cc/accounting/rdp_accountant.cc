@@ -0,0 +1,197 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "accounting/rdp_accountant.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "accounting/privacy_loss_mechanism.h"
+
+namespace differential_privacy {
+namespace accounting {
+
+namespace {
+
+// Returns log(exp(a) + exp(b)) without overflowing for large a or b.
+double LogAddExp(double a, double b) {
+  if (a == -std::numeric_limits<double>::infinity()) return b;
+  if (b == -std::numeric_limits<double>::infinity()) return a;
+  const double max = std::max(a, b);
+  return max + std::log1p(std::exp(-std::abs(a - b)));
+}
+
+// RDP of the Gaussian mechanism, see Proposition 7 in the RDP paper. By
+// Proposition 5 of the discrete Gaussian paper, the same bound holds for the
+// discrete Gaussian with parameter sigma.
+double GaussianRdp(double sigma, double sensitivity, double order) {
+  return order * sensitivity * sensitivity / (2 * sigma * sigma);
+}
+
+// RDP of the Laplace mechanism, see the table in Section VI of the RDP paper.
+double LaplaceRdp(double parameter, double sensitivity, double order) {
+  const double epsilon = sensitivity / parameter;
+  const double log_sum = LogAddExp(
+      std::log(order / (2 * order - 1)) + (order - 1) * epsilon,
+      std::log((order - 1) / (2 * order - 1)) - order * epsilon);
+  return log_sum / (order - 1);
+}
+
+// RDP of the discrete Laplace mechanism with integer sensitivity k, i.e., the
+// Renyi divergence between the discrete Laplace distribution P and the same
+// distribution shifted by k. The sum of P(x)^order * P(x - k)^(1 - order) over
+// all integers x is a geometric series on each of x <= 0, 0 < x < k and x >= k.
+double DiscreteLaplaceRdp(double parameter, double sensitivity, double order) {
+  const double a = parameter;
+  const double k = sensitivity;
+  const double log_normalizer =
+      std::log(-std::expm1(-a)) - std::log1p(std::exp(-a));
+  const double log_geometric = -std::log(-std::expm1(-a));
+  double log_sum = LogAddExp(a * (order - 1) * k + log_geometric,
+                             -a * (order - 1) * k - a * k + log_geometric);
+  if (k > 1) {
+    const double log_ratio = -a * (2 * order - 1);
+    const double log_middle_sum = a * (order - 1) * k + log_ratio +
+                                  std::log(-std::expm1(log_ratio * (k - 1))) -
+                                  std::log(-std::expm1(log_ratio));
+    log_sum = LogAddExp(log_sum, log_middle_sum);
+  }
+  return (log_normalizer + log_sum) / (order - 1);
+}
+
+}  // namespace
+
+std::vector<double> RdpAccountant::DefaultOrders() {
+  std::vector<double> orders;
+  for (int i = 1; i < 100; ++i) {
+    orders.push_back(1 + i / 10.0);
+  }
+  for (int i = 12; i < 64; ++i) {
+    orders.push_back(i);
+  }
+  for (double order : {128, 256, 512, 1024}) {
+    orders.push_back(order);
+  }
+  return orders;
+}
+
+absl::StatusOr<std::unique_ptr<RdpAccountant>> RdpAccountant::Create(
+    std::vector<double> orders) {
+  if (orders.empty()) {
+    return absl::InvalidArgumentError("At least one order must be given.");
+  }
+  for (double order : orders) {
+    if (!std::isfinite(order) || order <= 1) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Orders must be finite and greater than 1, but got %lf.", order));
+    }
+  }
+  return absl::WrapUnique(new RdpAccountant(std::move(orders)));
+}
+
+absl::StatusOr<double> RdpAccountant::MechanismRdp(
+    const AdditiveNoisePrivacyLoss& mechanism, double order) {
+  const double sensitivity = mechanism.Sensitivity();
+  if (const auto* gaussian =
+          dynamic_cast<const GaussianPrivacyLoss*>(&mechanism)) {
+    return GaussianRdp(gaussian->StandardDeviation(), sensitivity, order);
+  }
+  if (const auto* discrete_gaussian =
+          dynamic_cast<const DiscreteGaussianPrivacyLoss*>(&mechanism)) {
+    return GaussianRdp(discrete_gaussian->Sigma(), sensitivity, order);
+  }
+  if (const auto* laplace =
+          dynamic_cast<const LaplacePrivacyLoss*>(&mechanism)) {
+    return LaplaceRdp(laplace->Parameter(), sensitivity, order);
+  }
+  if (const auto* discrete_laplace =
+          dynamic_cast<const DiscreteLaplacePrivacyLoss*>(&mechanism)) {
+    return DiscreteLaplaceRdp(discrete_laplace->Parameter(), sensitivity,
+                              order);
+  }
+  return absl::UnimplementedError(
+      "RDP accounting is only supported for Laplace, Gaussian, discrete "
+      "Laplace and discrete Gaussian mechanisms.");
+}
+
+absl::Status RdpAccountant::Compose(const AdditiveNoisePrivacyLoss& mechanism,
+                                    int num_times) {
+  if (num_times < 0) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "num_times must be non-negative, but got %d.", num_times));
+  }
+  std::vector<double> mechanism_rdp;
+  mechanism_rdp.reserve(orders_.size());
+  for (double order : orders_) {
+    absl::StatusOr<double> rdp = MechanismRdp(mechanism, order);
+    if (!rdp.ok()) return rdp.status();
+    mechanism_rdp.push_back(*rdp);
+  }
+  for (int i = 0; i < orders_.size(); ++i) {
+    rdp_[i] += num_times * mechanism_rdp[i];
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<double> RdpAccountant::GetEpsilonForDelta(double delta) const {
+  if (!(delta > 0 && delta <= 1)) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("delta must be in (0, 1], but got %lf.", delta));
+  }
+  double epsilon = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < orders_.size(); ++i) {
+    const double order = orders_[i];
+    epsilon = std::min(epsilon, rdp_[i] -
+                                    (std::log(delta) + std::log(order)) /
+                                        (order - 1) +
+                                    std::log1p(-1 / order));
+  }
+  return std::max(epsilon, 0.0);
+}
+
+absl::StatusOr<double> RdpAccountant::GetDeltaForEpsilon(
+    double epsilon) const {
+  if (!(epsilon >= 0)) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "epsilon must be non-negative, but got %lf.", epsilon));
+  }
+  double log_delta = 0;
+  for (int i = 0; i < orders_.size(); ++i) {
+    const double order = orders_[i];
+    const double rdp = rdp_[i];
+    // The Kullback-Leibler divergence is at most the RDP at any order above 1,
+    // and delta <= sqrt(1 - exp(-KL)) by Pinsker-type bounds.
+    log_delta = std::min(log_delta,
+                         rdp == 0 ? -std::numeric_limits<double>::infinity()
+                                  : 0.5 * std::log1p(-std::exp(-rdp)));
+    // The conversion below is numerically unstable for orders close to 1,
+    // where it is not useful anyway.
+    if (order > 1.01) {
+      log_delta = std::min(log_delta, (order - 1) * (rdp - epsilon +
+                                                     std::log1p(-1 / order)) -
+                                          std::log(order));
+    }
+  }
+  return std::min(std::exp(log_delta), 1.0);
+}
+
+}  // namespace accounting
+}  // namespace differential_privacy
@@ -0,0 +1,91 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_RDP_ACCOUNTANT_H_
+#define DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_RDP_ACCOUNTANT_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "accounting/privacy_loss_mechanism.h"
+
+namespace differential_privacy {
+namespace accounting {
+
+// Accountant based on Renyi differential privacy (RDP), see
+// Mironov. "Renyi Differential Privacy". In CSF 2017.
+//
+// The accountant keeps the RDP of the composed mechanisms at a fixed set of
+// orders. Composing a mechanism adds its RDP at every order, so it costs
+// O(#orders) independent of the number of mechanisms composed so far, and
+// converting to (epsilon, delta) is O(#orders) as well. The resulting epsilon
+// is an upper bound that is usually somewhat looser than the one computed with
+// a PrivacyLossDistribution, which makes the accountant suited for fast budget
+// checks rather than for tight final accounting.
+class RdpAccountant {
+ public:
+  // Returns the default orders, which are the same as the ones used by the
+  // RDP accountant of the Python dp_accounting library.
+  static std::vector<double> DefaultOrders();
+
+  // Creates an accountant for the given RDP orders, which must all be finite
+  // and greater than 1.
+  static absl::StatusOr<std::unique_ptr<RdpAccountant>> Create(
+      std::vector<double> orders = DefaultOrders());
+
+  // Composes the mechanism num_times into the accounted RDP. Supported
+  // mechanisms are LaplacePrivacyLoss, GaussianPrivacyLoss,
+  // DiscreteLaplacePrivacyLoss and DiscreteGaussianPrivacyLoss. For the
+  // discrete Gaussian, the RDP of the untruncated distribution is used, i.e.,
+  // the mass outside of its truncation bound is not accounted for. Returns an
+  // error, without modifying the accounted RDP, for other mechanisms or a
+  // negative num_times.
+  absl::Status Compose(const AdditiveNoisePrivacyLoss& mechanism,
+                       int num_times = 1);
+
+  // Returns the smallest epsilon such that the composed mechanisms are
+  // (epsilon, delta)-DP according to the conversion of
+  // Canonne, Kamath, Steinke. "The Discrete Gaussian for Differential Privacy".
+  // In NeurIPS 2020.
+  absl::StatusOr<double> GetEpsilonForDelta(double delta) const;
+
+  // Returns the smallest delta such that the composed mechanisms are
+  // (epsilon, delta)-DP. In addition to the RDP conversion, the bound
+  // delta <= sqrt(1 - exp(-RDP)) is used, which is tighter for small orders.
+  absl::StatusOr<double> GetDeltaForEpsilon(double epsilon) const;
+
+  // Returns the RDP of a single application of the mechanism at the given
+  // order, or an error if the mechanism is not supported.
+  static absl::StatusOr<double> MechanismRdp(
+      const AdditiveNoisePrivacyLoss& mechanism, double order);
+
+  const std::vector<double>& Orders() const { return orders_; }
+
+  // The accounted RDP at each of the orders.
+  const std::vector<double>& Rdp() const { return rdp_; }
+
+ private:
+  explicit RdpAccountant(std::vector<double> orders)
+      : orders_(std::move(orders)), rdp_(orders_.size(), 0) {}
+
+  const std::vector<double> orders_;
+  std::vector<double> rdp_;
+};
+
+}  // namespace accounting
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ACCOUNTING_CPP_RDP_ACCOUNTANT_H_
@@ -0,0 +1,188 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "accounting/rdp_accountant.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "accounting/common/common.h"
+#include "accounting/privacy_loss_distribution.h"
+#include "accounting/privacy_loss_mechanism.h"
+#include "base/testing/status_matchers.h"
+
+namespace differential_privacy {
+namespace accounting {
+namespace {
+
+using ::differential_privacy::base::testing::IsOkAndHolds;
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::DoubleNear;
+using ::testing::Each;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+constexpr double kMaxError = 1e-9;
+
+// A mechanism for which the accountant has no RDP formula.
+class UnsupportedPrivacyLoss : public AdditiveNoisePrivacyLoss {
+ public:
+  NoiseType Discrete() const override { return NoiseType::kContinuous; }
+  PrivacyLossTail PrivacyLossDistributionTail() const override { return {}; }
+  double PrivacyLoss(double x) const override { return 0; }
+  double InversePrivacyLoss(double privacy_loss) const override { return 0; }
+  double NoiseCdf(double x) const override { return 0; }
+};
+
+TEST(RdpAccountantTest, GaussianRdpComposesLinearly) {
+  absl::StatusOr<std::unique_ptr<RdpAccountant>> accountant =
+      RdpAccountant::Create({2, 10});
+  ASSERT_OK(accountant);
+  absl::StatusOr<std::unique_ptr<GaussianPrivacyLoss>> gaussian =
+      GaussianPrivacyLoss::Create(/*standard_deviation=*/2, /*sensitivity=*/1);
+  ASSERT_OK(gaussian);
+
+  ASSERT_OK((*accountant)->Compose(**gaussian, /*num_times=*/3));
+  ASSERT_OK((*accountant)->Compose(**gaussian));
+
+  EXPECT_THAT((*accountant)->Rdp(),
+              ElementsAre(DoubleNear(4 * 2 / 8.0, kMaxError),
+                          DoubleNear(4 * 10 / 8.0, kMaxError)));
+}
+
+TEST(RdpAccountantTest, LaplaceRdp) {
+  absl::StatusOr<std::unique_ptr<LaplacePrivacyLoss>> laplace =
+      LaplacePrivacyLoss::Create(/*parameter=*/1, /*sensitivity=*/1);
+  ASSERT_OK(laplace);
+  absl::StatusOr<std::unique_ptr<LaplacePrivacyLoss>> laplace_scaled =
+      LaplacePrivacyLoss::Create(/*parameter=*/2, /*sensitivity=*/6);
+  ASSERT_OK(laplace_scaled);
+
+  EXPECT_THAT(RdpAccountant::MechanismRdp(**laplace, 2),
+              IsOkAndHolds(DoubleNear(0.61912363, 1e-8)));
+  EXPECT_THAT(RdpAccountant::MechanismRdp(**laplace_scaled, 3),
+              IsOkAndHolds(DoubleNear(2.74458729, 1e-8)));
+  // For large orders, the RDP approaches the pure DP epsilon.
+  absl::StatusOr<double> large_order_rdp =
+      RdpAccountant::MechanismRdp(**laplace, 1e6);
+  ASSERT_OK(large_order_rdp);
+  EXPECT_THAT(*large_order_rdp, DoubleNear(1, 1e-5));
+}
+
+TEST(RdpAccountantTest, DiscreteLaplaceRdpMatchesDirectSum) {
+  constexpr double kParameter = 0.7;
+  for (int sensitivity : {1, 3}) {
+    absl::StatusOr<std::unique_ptr<DiscreteLaplacePrivacyLoss>>
+        discrete_laplace =
+            DiscreteLaplacePrivacyLoss::Create(kParameter, sensitivity);
+    ASSERT_OK(discrete_laplace);
+    for (double order : {1.5, 4.0, 20.0}) {
+      const double normalizer =
+          (std::exp(kParameter) - 1) / (std::exp(kParameter) + 1);
+      double sum = 0;
+      for (int x = -500; x <= 500; ++x) {
+        const double exponent =
+            order * std::abs(x) + (1 - order) * std::abs(x - sensitivity);
+        sum += normalizer * std::exp(-kParameter * exponent);
+      }
+
+      EXPECT_THAT(RdpAccountant::MechanismRdp(**discrete_laplace, order),
+                  IsOkAndHolds(DoubleNear(std::log(sum) / (order - 1), 1e-8)))
+          << "sensitivity " << sensitivity << ", order " << order;
+    }
+  }
+}
+
+TEST(RdpAccountantTest, DiscreteGaussianUsesGaussianBound) {
+  absl::StatusOr<std::unique_ptr<DiscreteGaussianPrivacyLoss>>
+      discrete_gaussian =
+          DiscreteGaussianPrivacyLoss::Create(/*sigma=*/3, /*sensitivity=*/2);
+  ASSERT_OK(discrete_gaussian);
+
+  EXPECT_THAT(RdpAccountant::MechanismRdp(**discrete_gaussian, 5),
+              IsOkAndHolds(DoubleNear(5 * 4 / 18.0, kMaxError)));
+}
+
+TEST(RdpAccountantTest, EpsilonUpperBoundsPldEpsilon) {
+  constexpr int kNumTimes = 10;
+  constexpr double kDelta = 1e-5;
+  absl::StatusOr<std::unique_ptr<GaussianPrivacyLoss>> gaussian =
+      GaussianPrivacyLoss::Create(/*standard_deviation=*/5, /*sensitivity=*/1);
+  ASSERT_OK(gaussian);
+  absl::StatusOr<std::unique_ptr<LaplacePrivacyLoss>> laplace =
+      LaplacePrivacyLoss::Create(/*parameter=*/10, /*sensitivity=*/1);
+  ASSERT_OK(laplace);
+
+  std::unique_ptr<RdpAccountant> accountant = RdpAccountant::Create().value();
+  ASSERT_OK(accountant->Compose(**gaussian, kNumTimes));
+  ASSERT_OK(accountant->Compose(**laplace, kNumTimes));
+  std::unique_ptr<PrivacyLossDistribution> pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(**gaussian);
+  std::unique_ptr<PrivacyLossDistribution> laplace_pld =
+      PrivacyLossDistribution::CreateForAdditiveNoise(**laplace);
+  ASSERT_OK(pld->Compose(*laplace_pld));
+  pld->Compose(kNumTimes);
+
+  absl::StatusOr<double> epsilon = accountant->GetEpsilonForDelta(kDelta);
+  ASSERT_OK(epsilon);
+  const double pld_epsilon = pld->GetEpsilonForDelta(kDelta);
+  EXPECT_GE(*epsilon, pld_epsilon);
+  EXPECT_LE(*epsilon, 1.3 * pld_epsilon);
+
+  absl::StatusOr<double> delta = accountant->GetDeltaForEpsilon(*epsilon);
+  ASSERT_OK(delta);
+  EXPECT_LE(*delta, kDelta * (1 + 1e-6));
+  EXPECT_GE(*delta, pld->GetDeltaForEpsilon(*epsilon));
+}
+
+TEST(RdpAccountantTest, NoCompositionHasNoPrivacyLoss) {
+  std::unique_ptr<RdpAccountant> accountant = RdpAccountant::Create().value();
+
+  EXPECT_THAT(accountant->GetDeltaForEpsilon(0), IsOkAndHolds(0));
+  absl::StatusOr<double> epsilon = accountant->GetEpsilonForDelta(1e-5);
+  ASSERT_OK(epsilon);
+  EXPECT_LT(*epsilon, 0.01);
+}
+
+TEST(RdpAccountantTest, Errors) {
+  EXPECT_THAT(RdpAccountant::Create({2, 1}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("greater than 1")));
+  EXPECT_THAT(RdpAccountant::Create({}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  std::unique_ptr<RdpAccountant> accountant = RdpAccountant::Create().value();
+  EXPECT_THAT(accountant->Compose(UnsupportedPrivacyLoss()),
+              StatusIs(absl::StatusCode::kUnimplemented));
+  absl::StatusOr<std::unique_ptr<GaussianPrivacyLoss>> gaussian =
+      GaussianPrivacyLoss::Create(/*standard_deviation=*/1, /*sensitivity=*/1);
+  ASSERT_OK(gaussian);
+  EXPECT_THAT(accountant->Compose(**gaussian, /*num_times=*/-1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(accountant->GetEpsilonForDelta(0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(accountant->GetDeltaForEpsilon(-1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(accountant->Rdp(), Each(0));
+}
+
+}  // namespace
+}  // namespace accounting
+}  // namespace differential_privacy
@@ -0,0 +1,219 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_ABOVE_THRESHOLD_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_ABOVE_THRESHOLD_H_
+
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/util.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Sparse vector technique: answers a stream of queries with whether each is
+// above a threshold, spending budget only on the queries that are (Dwork and
+// Roth, "The Algorithmic Foundations of Differential Privacy", Section 3.6;
+// Lyu, Su and Li, "Understanding the Sparse Vector Technique for Differential
+// Privacy", Algorithm 1).
+//
+// The threshold is noised once with half of epsilon. Every query value is
+// noised with the other half and compared to the noisy threshold, one noise
+// draw per query. After max_positives queries were above the threshold, the
+// stream is exhausted. The whole stream satisfies epsilon-DP, regardless of
+// its length, and the memory is constant.
+//
+// The L-infinity sensitivity is the largest change of any query value when
+// one privacy unit is added or removed. If adding a privacy unit never
+// decreases any query value, as for counts, the queries are monotonic and half
+// the query noise suffices.
+//
+// AboveThreshold is not thread safe.
+class AboveThreshold {
+ public:
+  class Builder;
+
+  AboveThreshold(const AboveThreshold&) = delete;
+  AboveThreshold& operator=(const AboveThreshold&) = delete;
+
+  // Returns whether the noisy query value is above the noisy threshold.
+  // Returns an error once max_positives queries were above the threshold, and
+  // for NaN values.
+  absl::StatusOr<bool> Process(double query_value) {
+    if (num_positives_ >= max_positives_) {
+      return absl::FailedPreconditionError(absl::StrCat(
+          "All ", max_positives_,
+          " queries above the threshold were answered."));
+    }
+    if (std::isnan(query_value)) {
+      return absl::InvalidArgumentError("Query value must not be NaN.");
+    }
+    if (query_mechanism_->AddNoise(query_value) < noisy_threshold_) {
+      return false;
+    }
+    ++num_positives_;
+    return true;
+  }
+
+  // Returns whether max_positives queries were above the threshold, after
+  // which Process only returns errors.
+  bool exhausted() const { return num_positives_ >= max_positives_; }
+
+  int num_positives() const { return num_positives_; }
+
+  int max_positives() const { return max_positives_; }
+
+  // Returns the confidence intervals of the noise of the threshold and of
+  // every query value.
+  absl::StatusOr<ConfidenceInterval> ThresholdNoiseConfidenceInterval(
+      double confidence_level) {
+    return threshold_mechanism_->NoiseConfidenceInterval(confidence_level);
+  }
+  absl::StatusOr<ConfidenceInterval> QueryNoiseConfidenceInterval(
+      double confidence_level) {
+    return query_mechanism_->NoiseConfidenceInterval(confidence_level);
+  }
+
+  // Starts a new stream with a freshly noised threshold. The new stream
+  // spends the budget again.
+  void Reset() {
+    num_positives_ = 0;
+    noisy_threshold_ = threshold_mechanism_->AddNoise(threshold_);
+  }
+
+  int64_t MemoryUsed() const {
+    return sizeof(AboveThreshold) + threshold_mechanism_->MemoryUsed() +
+           query_mechanism_->MemoryUsed();
+  }
+
+  double GetEpsilon() const { return epsilon_; }
+
+ private:
+  AboveThreshold(double epsilon, double threshold, int max_positives,
+                 std::unique_ptr<NumericalMechanism> threshold_mechanism,
+                 std::unique_ptr<NumericalMechanism> query_mechanism)
+      : epsilon_(epsilon),
+        threshold_(threshold),
+        max_positives_(max_positives),
+        threshold_mechanism_(std::move(threshold_mechanism)),
+        query_mechanism_(std::move(query_mechanism)) {
+    Reset();
+  }
+
+  const double epsilon_;
+  const double threshold_;
+  const int max_positives_;
+  std::unique_ptr<NumericalMechanism> threshold_mechanism_;
+  std::unique_ptr<NumericalMechanism> query_mechanism_;
+
+  double noisy_threshold_ = 0;
+  int num_positives_ = 0;
+};
+
+class AboveThreshold::Builder {
+ public:
+  Builder& SetEpsilon(double epsilon) {
+    epsilon_ = epsilon;
+    return *this;
+  }
+
+  // Threshold the query values are compared to. Required.
+  Builder& SetThreshold(double threshold) {
+    threshold_ = threshold;
+    return *this;
+  }
+
+  // Number of queries above the threshold after which the stream is
+  // exhausted. Defaults to 1.
+  Builder& SetMaxPositives(int max_positives) {
+    max_positives_ = max_positives;
+    return *this;
+  }
+
+  // Largest change of any query value by one privacy unit. Defaults to 1.
+  Builder& SetLInfSensitivity(double l_inf_sensitivity) {
+    l_inf_sensitivity_ = l_inf_sensitivity;
+    return *this;
+  }
+
+  // Whether adding a privacy unit changes all query values in the same
+  // direction, e.g., for counts. Defaults to false.
+  Builder& SetMonotonicQueries(bool monotonic_queries) {
+    monotonic_queries_ = monotonic_queries;
+    return *this;
+  }
+
+  // Laplace mechanism used to add noise to the threshold and the query
+  // values. Only Laplace builders are accepted, since the privacy analysis is
+  // for Laplace noise.
+  Builder& SetLaplaceMechanism(
+      std::unique_ptr<LaplaceMechanism::Builder> mechanism_builder) {
+    mechanism_builder_ = std::move(mechanism_builder);
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<AboveThreshold>> Build() {
+    RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
+    RETURN_IF_ERROR(ValidateIsFinite(threshold_, "Threshold"));
+    if (max_positives_ <= 0) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Maximum number of positives must be positive, but is ",
+                       max_positives_, "."));
+    }
+    RETURN_IF_ERROR(ValidateIsFiniteAndPositive(l_inf_sensitivity_,
+                                                "L-infinity sensitivity"));
+    const double epsilon = epsilon_.value() / 2;
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> threshold_mechanism,
+                     mechanism_builder_->Clone()
+                         ->SetEpsilon(epsilon)
+                         .SetL0Sensitivity(1)
+                         .SetLInfSensitivity(l_inf_sensitivity_)
+                         .Build());
+    // Every positive answer may reveal the noise of its query, so the query
+    // noise scales with the number of positives.
+    const double query_sensitivity =
+        (monotonic_queries_ ? 1 : 2) * max_positives_ * l_inf_sensitivity_;
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> query_mechanism,
+                     mechanism_builder_->SetEpsilon(epsilon)
+                         .SetL0Sensitivity(1)
+                         .SetLInfSensitivity(query_sensitivity)
+                         .Build());
+    return absl::WrapUnique(new AboveThreshold(
+        epsilon_.value(), threshold_.value(), max_positives_,
+        std::move(threshold_mechanism), std::move(query_mechanism)));
+  }
+
+ private:
+  std::optional<double> epsilon_;
+  std::optional<double> threshold_;
+  int max_positives_ = 1;
+  double l_inf_sensitivity_ = 1;
+  bool monotonic_queries_ = false;
+  std::unique_ptr<LaplaceMechanism::Builder> mechanism_builder_ =
+      std::make_unique<LaplaceMechanism::Builder>();
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_ABOVE_THRESHOLD_H_
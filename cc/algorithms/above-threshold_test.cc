@@ -0,0 +1,144 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/above-threshold.h"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "base/instrumentation.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::IsOkAndHolds;
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::DoubleNear;
+using ::testing::HasSubstr;
+
+AboveThreshold::Builder ZeroNoiseBuilder(double threshold) {
+  AboveThreshold::Builder builder;
+  builder.SetEpsilon(1).SetThreshold(threshold).SetLaplaceMechanism(
+      std::make_unique<ZeroNoiseMechanism::Builder>());
+  return builder;
+}
+
+TEST(AboveThresholdTest, AnswersUntilMaxPositives) {
+  std::unique_ptr<AboveThreshold> above =
+      ZeroNoiseBuilder(10).SetMaxPositives(2).Build().value();
+  EXPECT_THAT(above->Process(3), IsOkAndHolds(false));
+  EXPECT_THAT(above->Process(12), IsOkAndHolds(true));
+  EXPECT_THAT(above->Process(9.5), IsOkAndHolds(false));
+  EXPECT_FALSE(above->exhausted());
+  EXPECT_THAT(above->Process(10), IsOkAndHolds(true));
+  EXPECT_TRUE(above->exhausted());
+  EXPECT_EQ(above->num_positives(), 2);
+  EXPECT_THAT(above->Process(100),
+              StatusIs(absl::StatusCode::kFailedPrecondition,
+                       HasSubstr("All 2 queries")));
+
+  above->Reset();
+  EXPECT_FALSE(above->exhausted());
+  EXPECT_THAT(above->Process(11), IsOkAndHolds(true));
+}
+
+TEST(AboveThresholdTest, DrawsOneNoisePerQuery) {
+  std::unique_ptr<AboveThreshold> above =
+      ZeroNoiseBuilder(10).Build().value();
+  instrumentation::AggregatingSink sink;
+  instrumentation::SetSink(&sink);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_OK(above->Process(i % 10));
+  }
+  instrumentation::SetSink(nullptr);
+
+  EXPECT_EQ(sink.Get(instrumentation::Event::kMechanismAddNoise).calls, 100);
+}
+
+TEST(AboveThresholdTest, RejectsNan) {
+  std::unique_ptr<AboveThreshold> above = ZeroNoiseBuilder(0).Build().value();
+  EXPECT_THAT(above->Process(std::numeric_limits<double>::quiet_NaN()),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_EQ(above->num_positives(), 0);
+}
+
+TEST(AboveThresholdTest, CalibratesLaplaceNoise) {
+  std::unique_ptr<AboveThreshold> above = AboveThreshold::Builder()
+                                              .SetEpsilon(1)
+                                              .SetThreshold(0)
+                                              .SetMaxPositives(3)
+                                              .SetLInfSensitivity(2)
+                                              .Build()
+                                              .value();
+  std::unique_ptr<AboveThreshold> monotonic = AboveThreshold::Builder()
+                                                  .SetEpsilon(1)
+                                                  .SetThreshold(0)
+                                                  .SetMaxPositives(3)
+                                                  .SetLInfSensitivity(2)
+                                                  .SetMonotonicQueries(true)
+                                                  .Build()
+                                                  .value();
+  // Laplace scales of 2 / 0.5 for the threshold, 2 * 3 * 2 / 0.5 for
+  // queries, and 3 * 2 / 0.5 for monotonic queries.
+  const double level = 0.9;
+  const double unit = -std::log(1 - level);
+  absl::StatusOr<ConfidenceInterval> threshold =
+      above->ThresholdNoiseConfidenceInterval(level);
+  ASSERT_OK(threshold);
+  EXPECT_THAT(threshold->upper_bound(), DoubleNear(4 * unit, 1e-6));
+  absl::StatusOr<ConfidenceInterval> query =
+      above->QueryNoiseConfidenceInterval(level);
+  ASSERT_OK(query);
+  EXPECT_THAT(query->upper_bound(), DoubleNear(24 * unit, 1e-6));
+  query = monotonic->QueryNoiseConfidenceInterval(level);
+  ASSERT_OK(query);
+  EXPECT_THAT(query->upper_bound(), DoubleNear(12 * unit, 1e-6));
+}
+
+TEST(AboveThresholdTest, ValidatesParameters) {
+  EXPECT_THAT(AboveThreshold::Builder().SetThreshold(1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Epsilon")));
+  EXPECT_THAT(AboveThreshold::Builder().SetEpsilon(1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Threshold")));
+  EXPECT_THAT(AboveThreshold::Builder()
+                  .SetEpsilon(1)
+                  .SetThreshold(0)
+                  .SetMaxPositives(0)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("positives")));
+  EXPECT_THAT(AboveThreshold::Builder()
+                  .SetEpsilon(1)
+                  .SetThreshold(0)
+                  .SetLInfSensitivity(-1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("sensitivity")));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -17,22 +17,31 @@
 #ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_ALGORITHM_H_
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_ALGORITHM_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <limits>
 #include <memory>
+#include <iterator>
 #include <optional>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <variant>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "algorithms/util.h"
 #include "proto/util.h"
 #include "proto/confidence-interval.pb.h"
 #include "proto/data.pb.h"
 #include "proto/summary.pb.h"
+#include "base/instrumentation.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
@@ -40,15 +49,73 @@ namespace differential_privacy {
 constexpr double kDefaultDelta = 0.0;
 constexpr double kDefaultConfidenceLevel = .95;
 
+// Result of an algorithm whose output is a single value, without the Output
+// proto; see Algorithm::PartialScalarResult.
+struct ScalarResult {
+  // Integral for algorithms with integral outputs, e.g., Count or the
+  // BoundedSum of integers.
+  std::variant<int64_t, double> value;
+  std::optional<ConfidenceInterval> noise_confidence_interval;
+};
+
+// Returns the Output proto of the result, as PartialResult returns it.
+inline Output ToOutput(const ScalarResult& result) {
+  Output output;
+  std::visit(
+      [&](auto value) {
+        if (result.noise_confidence_interval.has_value()) {
+          AddToOutput(&output, value, *result.noise_confidence_interval);
+        } else {
+          AddToOutput(&output, value);
+        }
+      },
+      result.value);
+  return output;
+}
+
 // Abstract superclass for differentially private algorithms.
 //
 // Algorithm instances are typically *not* thread safe.  Entries must be added
 // from a single thread only.  In case you want to use multiple threads, you can
-// use per-thread instances of the Algorithm child class, serialize them, and
-// then merge them together in a single thread.
+// use per-thread instances of the Algorithm child class and merge them together
+// in a single thread with MergeFrom, or serialize them and Merge the summaries.
 template <typename T>
 class Algorithm {
+ protected:
+  // Raw aggregate that FinalizeResults adds noise to; see GetDeferredValue.
+  struct DeferredValue {
+    // Owned by the algorithm.
+    NumericalMechanism* mechanism = nullptr;
+    // Whether the value is noised as an integer (int_value) or as a double
+    // (double_value).
+    bool integral = false;
+    int64_t int_value = 0;
+    double double_value = 0;
+  };
+
  public:
+  // Result of PrepareResult: either the final output, or the raw aggregate
+  // that FinalizeResults adds noise to. The raw aggregate is not
+  // differentially private and cannot be accessed. The algorithm that
+  // prepared the result must outlive it.
+  class PreparedResult {
+   public:
+    PreparedResult(PreparedResult&&) = default;
+    PreparedResult& operator=(PreparedResult&&) = default;
+
+   private:
+    friend class Algorithm;
+
+    PreparedResult() = default;
+
+    Algorithm* algorithm_ = nullptr;
+    double noise_interval_level_ = kDefaultConfidenceLevel;
+    // Set if the algorithm does not defer its noise.
+    std::optional<Output> output_;
+    DeferredValue value_;
+    bool finalized_ = false;
+  };
+
   //
   // Epsilon, delta are standard parameters of differentially private
   // algorithms. See "The Algorithmic Foundations of Differential Privacy" p17.
@@ -67,11 +134,39 @@ class Algorithm {
   // Adds one input to the algorithm.
   virtual void AddEntry(const T& t) = 0;
 
-  // Adds multiple inputs to the algorithm.
+  // Adds multiple inputs to the algorithm. Ranges of pointers or vector
+  // iterators are passed to the batch AddEntries below.
   template <typename Iterator>
   void AddEntries(Iterator begin, Iterator end) {
-    for (auto it = begin; it != end; ++it) {
-      AddEntry(*it);
+    if constexpr (std::is_same_v<Iterator, T*> ||
+                  std::is_same_v<Iterator, const T*> ||
+                  std::is_same_v<Iterator, typename std::vector<T>::iterator> ||
+                  std::is_same_v<Iterator,
+                                 typename std::vector<T>::const_iterator>) {
+      if (begin != end) {
+        const auto size = std::distance(begin, end);
+        instrumentation::ScopedEvent event(
+            instrumentation::Event::kAlgorithmAddEntries, size);
+        AddEntries(absl::Span<const T>(&*begin, size));
+      }
+    } else {
+      instrumentation::ScopedEvent event(
+          instrumentation::Event::kAlgorithmAddEntries);
+      int64_t count = 0;
+      for (auto it = begin; it != end; ++it) {
+        AddEntry(*it);
+        ++count;
+      }
+      event.set_count(count);
+    }
+  }
+
+  // Adds all entries. Equivalent to calling AddEntry on each entry, which is
+  // what the default implementation does. Algorithms override it with loops
+  // that avoid a virtual call per entry.
+  virtual void AddEntries(absl::Span<const T> entries) {
+    for (const T& entry : entries) {
+      AddEntry(entry);
     }
   }
 
@@ -107,9 +202,136 @@ class Algorithm {
     }
     result_returned_ = true;
 
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmPartialResult);
     return GenerateResult(noise_interval_level);
   }
 
+  // Same as PartialResult, but for algorithms whose output is a single value,
+  // returns it as a plain struct instead of an Output proto, which is cheaper
+  // when releasing many partitions. Count, BoundedSum and BoundedMean with
+  // fixed bounds generate the struct directly; other algorithms convert their
+  // Output and drop its error report. Consumes the budget like PartialResult,
+  // also when returning an error because the output is not a single number.
+  absl::StatusOr<ScalarResult> PartialScalarResult() {
+    return PartialScalarResult(kDefaultConfidenceLevel);
+  }
+
+  absl::StatusOr<ScalarResult> PartialScalarResult(
+      double noise_interval_level) {
+    if (result_returned_) {
+      return absl::InvalidArgumentError(
+          "The algorithm can only produce results once for a given epsilon, "
+          "delta budget.");
+    }
+    result_returned_ = true;
+
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmPartialResult);
+    return GenerateScalarResult(noise_interval_level);
+  }
+
+  // First phase of a two-phase alternative to PartialResult for releasing
+  // many partitions with one algorithm each. PrepareResult computes the raw
+  // aggregate of an algorithm, e.g., on the thread that owns it, and
+  // FinalizeResults then adds the noise to the prepared results of all
+  // partitions with one batched AddNoise call per mechanism. Algorithms built
+  // with the same SharedMechanismBuilder share their mechanism.
+  //
+  // Consumes the budget like PartialResult. Algorithms whose result is not a
+  // single noised value generate their final output here.
+  absl::StatusOr<PreparedResult> PrepareResult() {
+    return PrepareResult(kDefaultConfidenceLevel);
+  }
+
+  absl::StatusOr<PreparedResult> PrepareResult(double noise_interval_level) {
+    PreparedResult prepared;
+    prepared.algorithm_ = this;
+    prepared.noise_interval_level_ = noise_interval_level;
+    std::optional<DeferredValue> value = GetDeferredValue();
+    if (!value.has_value()) {
+      ASSIGN_OR_RETURN(prepared.output_, PartialResult(noise_interval_level));
+      return prepared;
+    }
+    if (result_returned_) {
+      return absl::InvalidArgumentError(
+          "The algorithm can only produce results once for a given epsilon, "
+          "delta budget.");
+    }
+    result_returned_ = true;
+    prepared.value_ = *value;
+    return prepared;
+  }
+
+  // Second phase of PrepareResult. Returns the outputs of the prepared
+  // results, in the same order. Every prepared result can only be finalized
+  // once.
+  static absl::StatusOr<std::vector<Output>> FinalizeResults(
+      absl::Span<PreparedResult> results) {
+    std::vector<int> deferred;
+    for (int i = 0; i < results.size(); ++i) {
+      if (results[i].finalized_ || results[i].algorithm_ == nullptr) {
+        return absl::InvalidArgumentError(
+            "Prepared results can only be finalized once.");
+      }
+      if (!results[i].output_.has_value()) {
+        deferred.push_back(i);
+      }
+    }
+
+    // Noise the values of every mechanism and type in a single batch.
+    auto batch_key = [&results](int i) {
+      const DeferredValue& value = results[i].value_;
+      return std::make_tuple(value.mechanism->NoiseSource(), value.integral);
+    };
+    std::sort(deferred.begin(), deferred.end(), [&batch_key](int a, int b) {
+      return batch_key(a) < batch_key(b);
+    });
+    std::vector<int64_t> int_values;
+    std::vector<double> double_values;
+    for (auto begin = deferred.begin(); begin != deferred.end();) {
+      auto end = std::find_if(begin, deferred.end(), [&](int i) {
+        return batch_key(i) != batch_key(*begin);
+      });
+      NumericalMechanism* mechanism = std::get<0>(batch_key(*begin));
+      if (std::get<1>(batch_key(*begin))) {
+        int_values.clear();
+        for (auto it = begin; it != end; ++it) {
+          int_values.push_back(results[*it].value_.int_value);
+        }
+        RETURN_IF_ERROR(mechanism->AddNoise(absl::MakeConstSpan(int_values),
+                                            absl::MakeSpan(int_values)));
+        for (auto it = begin; it != end; ++it) {
+          results[*it].value_.int_value = int_values[it - begin];
+        }
+      } else {
+        double_values.clear();
+        for (auto it = begin; it != end; ++it) {
+          double_values.push_back(results[*it].value_.double_value);
+        }
+        RETURN_IF_ERROR(mechanism->AddNoise(absl::MakeConstSpan(double_values),
+                                            absl::MakeSpan(double_values)));
+        for (auto it = begin; it != end; ++it) {
+          results[*it].value_.double_value = double_values[it - begin];
+        }
+      }
+      begin = end;
+    }
+
+    std::vector<Output> outputs;
+    outputs.reserve(results.size());
+    for (PreparedResult& result : results) {
+      result.finalized_ = true;
+      if (result.output_.has_value()) {
+        outputs.push_back(*std::move(result.output_));
+      } else {
+        outputs.push_back(result.algorithm_->MakeDeferredOutput(
+            result.value_, result.noise_interval_level_));
+      }
+    }
+    return outputs;
+  }
+
   // Resets the algorithm to a state in which it has received no input. After
   // Reset is called, the algorithm should only consider input added after the
   // last Reset call when providing output.
@@ -129,6 +351,30 @@ class Algorithm {
   // algorithm used. The summary proto cannot be empty.
   virtual absl::Status Merge(const Summary& summary) = 0;
 
+  // Merges a serialized Summary, e.g., as received from another worker.
+  // Equivalent to parsing the Summary and calling Merge, which is what the
+  // default implementation does; algorithms override it to decode the summary
+  // in place and add it directly to their state.
+  virtual absl::Status MergeFromBytes(absl::string_view summary_bytes) {
+    Summary summary;
+    if (!summary.ParseFromArray(summary_bytes.data(), summary_bytes.size())) {
+      return absl::InternalError("Summary unable to be parsed.");
+    }
+    return Merge(summary);
+  }
+
+  // Merges the accumulated data of another live instance of the same
+  // algorithm type with identical parameters into this algorithm, e.g., to
+  // fold per-thread instances into a single one. Equivalent to
+  // Merge(other.Serialize()), which is what the default implementation does;
+  // algorithms override it to add their internal state directly. `other` is
+  // not modified.
+  virtual absl::Status MergeFrom(const Algorithm<T>& other) {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    return Merge(other.Serialize());
+  }
+
   // Returns an estimate for the current memory consumption of the algorithm in
   // bytes. Intended to be used for distribution frameworks to prevent
   // out-of-memory errors.
@@ -165,9 +411,48 @@ class Algorithm {
   virtual absl::StatusOr<Output> GenerateResult(
       double noise_interval_level) = 0;
 
+  // Returns the result of PartialScalarResult. Algorithms whose output is a
+  // single value override this to skip the Output proto; by default, the
+  // Output of GenerateResult is converted.
+  virtual absl::StatusOr<ScalarResult> GenerateScalarResult(
+      double noise_interval_level) {
+    ASSIGN_OR_RETURN(Output output, GenerateResult(noise_interval_level));
+    if (output.elements_size() != 1 ||
+        output.elements(0).value().has_string_value()) {
+      return absl::InvalidArgumentError(
+          "Only algorithms whose output is a single number have a scalar "
+          "result.");
+    }
+    const Output_Element& element = output.elements(0);
+    ScalarResult result;
+    if (element.value().has_int_value()) {
+      result.value = element.value().int_value();
+    } else {
+      result.value = element.value().float_value();
+    }
+    if (element.has_noise_confidence_interval()) {
+      result.noise_confidence_interval = element.noise_confidence_interval();
+    }
+    return result;
+  }
+
   // Allows child classes to reset their state as part of a global reset.
   virtual void ResetState() = 0;
 
+  // Algorithms whose result is a single noised value return the raw value
+  // and the mechanism to noise it with, which lets PrepareResult defer the
+  // noise to FinalizeResults. By default, PrepareResult generates the result.
+  virtual std::optional<DeferredValue> GetDeferredValue() {
+    return std::nullopt;
+  }
+
+  // Returns the output for the value returned by GetDeferredValue, after
+  // FinalizeResults added the noise to it.
+  virtual Output MakeDeferredOutput(const DeferredValue& noised_value,
+                                    double noise_interval_level) {
+    return Output();
+  }
+
  private:
   bool result_returned_ = false;
   const double epsilon_;
@@ -180,6 +465,8 @@ class AlgorithmBuilder {
   virtual ~AlgorithmBuilder() = default;
 
   absl::StatusOr<std::unique_ptr<Algorithm>> Build() {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmBuild);
     RETURN_IF_ERROR(ValidateIsFiniteAndPositive(epsilon_, "Epsilon"));
 
     if (delta_.has_value()) {
@@ -0,0 +1,220 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for the algorithms in this directory. Every benchmark that takes
+// an input size uses range(0) as the number of entries. Multi-threaded runs
+// use one algorithm instance per thread, which is how the algorithms are meant
+// to be used concurrently, so they measure how throughput scales with cores.
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "absl/status/statusor.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/approx-bounds.h"
+#include "algorithms/benchmark-fixtures.h"
+#include "algorithms/bounded-mean.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/bounded-variance.h"
+#include "algorithms/partition-selection.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using benchmark_fixtures::AlgorithmFactory;
+using benchmark_fixtures::kEpsilon;
+using benchmark_fixtures::kLower;
+using benchmark_fixtures::kUpper;
+using benchmark_fixtures::MakeBoundedMean;
+using benchmark_fixtures::MakeBoundedSum;
+using benchmark_fixtures::MakeCount;
+using benchmark_fixtures::MakeEntries;
+using benchmark_fixtures::MakeQuantiles;
+
+std::unique_ptr<Algorithm<double>> MakeBoundedSumWithApproxBounds() {
+  return BoundedSum<double>::Builder().SetEpsilon(kEpsilon).Build().value();
+}
+
+std::unique_ptr<Algorithm<double>> MakeBoundedMeanWithApproxBounds() {
+  return BoundedMean<double>::Builder().SetEpsilon(kEpsilon).Build().value();
+}
+
+std::unique_ptr<Algorithm<double>> MakeBoundedVariance() {
+  return BoundedVariance<double>::Builder()
+      .SetEpsilon(kEpsilon)
+      .SetLower(kLower)
+      .SetUpper(kUpper)
+      .Build()
+      .value();
+}
+
+std::unique_ptr<Algorithm<double>> MakeApproxBounds() {
+  return ApproxBounds<double>::Builder().SetEpsilon(kEpsilon).Build().value();
+}
+
+void InputSizes(benchmark::internal::Benchmark* benchmark) {
+  benchmark->Range(1 << 10, 1 << 20);
+}
+
+void InputSizesAndThreads(benchmark::internal::Benchmark* benchmark) {
+  InputSizes(benchmark);
+  benchmark->ThreadRange(1, 8);
+}
+
+// Registers benchmark_fn for every algorithm, with arguments set by apply_fn.
+#define BENCHMARK_ALGORITHMS(benchmark_fn, apply_fn)                     \
+  BENCHMARK_TEMPLATE(benchmark_fn, MakeBoundedSum)->Apply(apply_fn);     \
+  BENCHMARK_TEMPLATE(benchmark_fn, MakeBoundedSumWithApproxBounds)       \
+      ->Apply(apply_fn);                                                 \
+  BENCHMARK_TEMPLATE(benchmark_fn, MakeBoundedMean)->Apply(apply_fn);    \
+  BENCHMARK_TEMPLATE(benchmark_fn, MakeBoundedMeanWithApproxBounds)      \
+      ->Apply(apply_fn);                                                 \
+  BENCHMARK_TEMPLATE(benchmark_fn, MakeBoundedVariance)->Apply(apply_fn); \
+  BENCHMARK_TEMPLATE(benchmark_fn, MakeQuantiles)->Apply(apply_fn);      \
+  BENCHMARK_TEMPLATE(benchmark_fn, MakeApproxBounds)->Apply(apply_fn);   \
+  BENCHMARK_TEMPLATE(benchmark_fn, MakeCount)->Apply(apply_fn)
+
+// Measures entries added per second, for one to eight threads.
+template <AlgorithmFactory make_algorithm>
+void BM_AddEntry(benchmark::State& state) {
+  const std::vector<double> entries = MakeEntries(state.range(0));
+  std::unique_ptr<Algorithm<double>> algorithm = make_algorithm();
+  for (auto _ : state) {
+    algorithm->Reset();
+    algorithm->AddEntries(entries.begin(), entries.end());
+  }
+  state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK_ALGORITHMS(BM_AddEntry, InputSizesAndThreads);
+
+// Measures the latency of computing a result from the accumulated entries.
+// Building the algorithm and restoring its state are not timed.
+template <AlgorithmFactory make_algorithm>
+void BM_PartialResult(benchmark::State& state) {
+  const std::vector<double> entries = MakeEntries(state.range(0));
+  std::unique_ptr<Algorithm<double>> algorithm = make_algorithm();
+  algorithm->AddEntries(entries.begin(), entries.end());
+  const Summary summary = algorithm->Serialize();
+  for (auto _ : state) {
+    state.PauseTiming();
+    algorithm = make_algorithm();
+    benchmark::DoNotOptimize(algorithm->Merge(summary));
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(algorithm->PartialResult());
+  }
+}
+BENCHMARK_ALGORITHMS(BM_PartialResult, InputSizes);
+
+// Measures the cost of serializing the accumulated entries. The bytes
+// processed are the size of the serialized summary.
+template <AlgorithmFactory make_algorithm>
+void BM_Serialize(benchmark::State& state) {
+  const std::vector<double> entries = MakeEntries(state.range(0));
+  std::unique_ptr<Algorithm<double>> algorithm = make_algorithm();
+  algorithm->AddEntries(entries.begin(), entries.end());
+  int64_t summary_size = 0;
+  for (auto _ : state) {
+    Summary summary = algorithm->Serialize();
+    summary_size = summary.ByteSizeLong();
+    benchmark::DoNotOptimize(summary);
+  }
+  state.SetBytesProcessed(state.iterations() * summary_size);
+}
+BENCHMARK_ALGORITHMS(BM_Serialize, InputSizes);
+
+// Measures the cost of merging a serialized summary.
+template <AlgorithmFactory make_algorithm>
+void BM_Merge(benchmark::State& state) {
+  const std::vector<double> entries = MakeEntries(state.range(0));
+  std::unique_ptr<Algorithm<double>> source = make_algorithm();
+  source->AddEntries(entries.begin(), entries.end());
+  const Summary summary = source->Serialize();
+  std::unique_ptr<Algorithm<double>> algorithm = make_algorithm();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(algorithm->Merge(summary));
+  }
+  state.SetBytesProcessed(state.iterations() * summary.ByteSizeLong());
+}
+BENCHMARK_ALGORITHMS(BM_Merge, InputSizes);
+
+// Measures the cost of merging a live instance without serialization.
+template <AlgorithmFactory make_algorithm>
+void BM_MergeFrom(benchmark::State& state) {
+  const std::vector<double> entries = MakeEntries(state.range(0));
+  std::unique_ptr<Algorithm<double>> source = make_algorithm();
+  source->AddEntries(entries.begin(), entries.end());
+  std::unique_ptr<Algorithm<double>> algorithm = make_algorithm();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(algorithm->MergeFrom(*source));
+  }
+}
+BENCHMARK_ALGORITHMS(BM_MergeFrom, InputSizes);
+
+// Reports MemoryUsed() after adding the entries in the "memory_used" counter,
+// for sizing workers by the number of partitions they hold.
+template <AlgorithmFactory make_algorithm>
+void BM_MemoryUsed(benchmark::State& state) {
+  const std::vector<double> entries = MakeEntries(state.range(0));
+  std::unique_ptr<Algorithm<double>> algorithm = make_algorithm();
+  algorithm->AddEntries(entries.begin(), entries.end());
+  int64_t memory_used = 0;
+  for (auto _ : state) {
+    memory_used = algorithm->MemoryUsed();
+    benchmark::DoNotOptimize(memory_used);
+  }
+  state.counters["memory_used"] = memory_used;
+}
+BENCHMARK_ALGORITHMS(BM_MemoryUsed, InputSizes);
+
+// Measures partition selection decisions per second. Argument 0 selects
+// near-truncated geometric, 1 Laplace and 2 Gaussian partition selection.
+void BM_ShouldKeep(benchmark::State& state) {
+  std::unique_ptr<PartitionSelectionStrategyBuilder> builder;
+  switch (state.range(0)) {
+    case 0:
+      builder =
+          std::make_unique<NearTruncatedGeometricPartitionSelection::Builder>();
+      state.SetLabel("near-truncated geometric");
+      break;
+    case 1:
+      builder = std::make_unique<LaplacePartitionSelection::Builder>();
+      state.SetLabel("Laplace");
+      break;
+    default:
+      builder = std::make_unique<GaussianPartitionSelection::Builder>();
+      state.SetLabel("Gaussian");
+      break;
+  }
+  std::unique_ptr<PartitionSelectionStrategy> strategy =
+      builder->SetEpsilon(kEpsilon)
+          .SetDelta(1e-5)
+          .SetMaxPartitionsContributed(1)
+          .Build()
+          .value();
+  double num_users = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(strategy->ShouldKeep(num_users));
+    num_users = num_users < 100 ? num_users + 1 : 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShouldKeep)->DenseRange(0, 2)->ThreadRange(1, 8);
+
+}  // namespace
+}  // namespace differential_privacy
@@ -24,6 +24,7 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/statusor.h"
+#include "base/instrumentation.h"
 
 namespace differential_privacy {
 namespace {
@@ -192,5 +193,63 @@ TEST(AlgorithmBuilderTest, InvalidMaxContributionsPerPartitionFailsBuild) {
                                  "partition must be positive")));
 }
 
+TEST(AlgorithmTest, PrepareResultGeneratesResultOfOtherAlgorithms) {
+  TestAlgorithm<double> alg;
+  absl::StatusOr<TestAlgorithm<double>::PreparedResult> prepared =
+      alg.PrepareResult();
+  ASSERT_OK(prepared);
+  EXPECT_THAT(alg.PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  absl::StatusOr<std::vector<Output>> outputs =
+      TestAlgorithm<double>::FinalizeResults({&*prepared, 1});
+  ASSERT_OK(outputs);
+  EXPECT_EQ(outputs->size(), 1);
+}
+
+TEST(AlgorithmTest, ReportsInstrumentationEvents) {
+  instrumentation::AggregatingSink sink;
+  instrumentation::SetSink(&sink);
+  TestAlgorithm<double> alg;
+  std::vector<double> entries = {1, 2, 3};
+  std::list<double> list_entries = {4, 5};
+
+  alg.AddEntries(entries.begin(), entries.end());
+  alg.AddEntries(list_entries.begin(), list_entries.end());
+  EXPECT_OK(alg.PartialResult());
+  instrumentation::SetSink(nullptr);
+
+  instrumentation::AggregatingSink::Totals add_entries =
+      sink.Get(instrumentation::Event::kAlgorithmAddEntries);
+  EXPECT_EQ(add_entries.calls, 2);
+  EXPECT_EQ(add_entries.count, 5);
+  EXPECT_EQ(sink.Get(instrumentation::Event::kAlgorithmPartialResult).calls,
+            1);
+}
+
+TEST(AlgorithmTest, PartialScalarResultRequiresNumericOutput) {
+  TestAlgorithm<double> alg;
+  EXPECT_THAT(alg.PartialScalarResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("single number")));
+  EXPECT_THAT(alg.PartialScalarResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("can only produce results once")));
+}
+
+TEST(AlgorithmTest, ToOutputOfScalarResult) {
+  ScalarResult result;
+  result.value = 1.5;
+  EXPECT_EQ(GetValue<double>(ToOutput(result)), 1.5);
+  EXPECT_FALSE(ToOutput(result).elements(0).has_noise_confidence_interval());
+
+  result.value = int64_t{3};
+  result.noise_confidence_interval.emplace();
+  result.noise_confidence_interval->set_confidence_level(0.5);
+  Output output = ToOutput(result);
+  EXPECT_EQ(GetValue<int64_t>(output), 3);
+  EXPECT_EQ(GetNoiseConfidenceInterval(output).confidence_level(), 0.5);
+}
+
 }  // namespace
 }  // namespace differential_privacy
@@ -26,24 +26,35 @@
 #include <functional>
 #include <limits>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "google/protobuf/any.pb.h"
+#include "google/protobuf/repeated_field.h"
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
+#include "absl/numeric/bits.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "algorithms/algorithm.h"
+#include "algorithms/internal/binary-summary.h"
+#include "algorithms/internal/compact-counters.h"
+#include "algorithms/internal/wire-reader.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "algorithms/util.h"
 #include "proto/util.h"
 #include "proto/data.pb.h"
+#include "base/instrumentation.h"
+#include "base/memory_budget.h"
+#include "base/tracking_memory_resource.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
@@ -114,20 +125,51 @@ class ApproxBounds : public Algorithm<T> {
 
   virtual ~ApproxBounds() {}
 
+  using Algorithm<T>::AddEntries;
+
   void AddEntry(const T& input) override { AddMultipleEntries(input, 1); }
 
+  // Adds all inputs to the bins. Equivalent to calling AddEntry on each input,
+  // but the bin indices are computed without branching on the input, see
+  // BinIndex().
+  void AddEntries(absl::Span<const T> inputs) override {
+    for (const T& input : inputs) {
+      if (!std::isnan(static_cast<double>(input))) {
+        AddMultipleEntriesToBin(input, BinIndex(input), 1);
+      }
+    }
+  }
+
   // Serialize the positive and negative bin counts.
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     ApproxBoundsSummary am_summary;
-    *am_summary.mutable_pos_bin_count() = {pos_bins_.begin(), pos_bins_.end()};
-    *am_summary.mutable_neg_bin_count() = {neg_bins_.begin(), neg_bins_.end()};
+    const std::vector<int64_t> pos_bins = pos_bins_.ToVector();
+    const std::vector<int64_t> neg_bins = neg_bins_.ToVector();
+    *am_summary.mutable_pos_bin_count() = {pos_bins.begin(), pos_bins.end()};
+    *am_summary.mutable_neg_bin_count() = {neg_bins.begin(), neg_bins.end()};
     Summary summary;
     summary.mutable_data()->PackFrom(am_summary);
     return summary;
   }
 
+  // Serialize the bin counts like Serialize(), but in the sparse encoding of
+  // ApproxBoundsSummary, which only lists the non-empty bins. Much smaller
+  // when most bins are empty, e.g., for the 1075 bins of a double, which makes
+  // it cheaper to send over the network. Merge() accepts both encodings.
+  Summary SerializeCompact() const {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
+    Summary summary;
+    summary.mutable_data()->PackFrom(CompactApproxBoundsSummary());
+    return summary;
+  }
+
   // Retrieve positive and negative bin counts from summary and add them.
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError(
           "Cannot merge summary with no histogram data.");
@@ -138,27 +180,78 @@ class ApproxBounds : public Algorithm<T> {
           "Approximate bounds summary unable to be unpacked.");
     }
 
-    if (pos_bins_.size() != am_summary.pos_bin_count_size() ||
-        neg_bins_.size() != am_summary.neg_bin_count_size()) {
+    return MergeApproxBoundsSummary(am_summary);
+  }
+
+  // Add the bin counts of another ApproxBounds directly.
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_bounds = dynamic_cast<const ApproxBounds<T>*>(&other);
+    if (other_bounds == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    if (pos_bins_.size() != other_bounds->pos_bins_.size() ||
+        neg_bins_.size() != other_bounds->neg_bins_.size()) {
       return absl::InternalError(
           "Merged approximate max summary must have the same number of "
           "bin counts as this histogram.");
     }
+    pos_bins_.AddAll(other_bounds->pos_bins_);
+    neg_bins_.AddAll(other_bounds->neg_bins_);
+    return absl::OkStatus();
+  }
+
+  // Adds the bin counts straight from the serialized ApproxBoundsSummary.
+  // Summaries that cannot be decoded this way go through Merge, which reports
+  // the error.
+  absl::Status MergeFromBytes(absl::string_view summary_bytes) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    absl::string_view payload;
+    if (internal::SummaryPayload<ApproxBoundsSummary>(summary_bytes,
+                                                      &payload) &&
+        MergeApproxBoundsBytes(payload)) {
+      return absl::OkStatus();
+    }
+    return Algorithm<T>::MergeFromBytes(summary_bytes);
+  }
+
+  // Serialize the bin counts in the compact binary summary format. See
+  // internal/binary-summary.h for the layout.
+  std::string SerializeToBinary() const {
+    internal::BinarySummaryWriter writer =
+        internal::MakeBinarySummaryWriter<T>(
+            internal::BinarySummaryType::kApproxBounds);
+    writer.AppendArray<int64_t>(pos_bins_.ToVector());
+    writer.AppendArray<int64_t>(neg_bins_.ToVector());
+    return std::move(writer).Finish();
+  }
+
+  // Add the bin counts of a summary returned by SerializeToBinary. The state
+  // is left unchanged if the summary is invalid.
+  absl::Status MergeFromBinary(absl::string_view binary_summary) {
+    absl::StatusOr<internal::BinarySummaryReader> reader =
+        internal::MakeBinarySummaryReader<T>(
+            binary_summary, internal::BinarySummaryType::kApproxBounds);
+    RETURN_IF_ERROR(reader.status());
+    absl::StatusOr<internal::BinarySummaryArray<int64_t>> pos_bins =
+        reader->ReadArray<int64_t>(pos_bins_.size());
+    RETURN_IF_ERROR(pos_bins.status());
+    absl::StatusOr<internal::BinarySummaryArray<int64_t>> neg_bins =
+        reader->ReadArray<int64_t>(neg_bins_.size());
+    RETURN_IF_ERROR(neg_bins.status());
+    RETURN_IF_ERROR(reader->Finish());
 
-    // Add bin count from summary to each bin.
     for (int i = 0; i < pos_bins_.size(); ++i) {
-      pos_bins_[i] += am_summary.pos_bin_count(i);
-      neg_bins_[i] += am_summary.neg_bin_count(i);
+      pos_bins_.Add(i, (*pos_bins)[i]);
+      neg_bins_.Add(i, (*neg_bins)[i]);
     }
     return absl::OkStatus();
   }
 
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(ApproxBounds<T>) +
-                     sizeof(int64_t) * neg_bins_.capacity() +
-                     sizeof(int64_t) * pos_bins_.capacity() +
-                     sizeof(T) * noisy_neg_bins_.capacity() +
-                     sizeof(T) * noisy_pos_bins_.capacity();
+    int64_t memory = sizeof(ApproxBounds<T>) + memory_.bytes_allocated();
     if (mechanism_) {
       memory += mechanism_->MemoryUsed();
     }
@@ -192,6 +285,10 @@ class ApproxBounds : public Algorithm<T> {
       abs = std::abs(value);
     }
 
+    if (scale_exponent_.has_value()) {
+      return PowerOfTwoBinIndex(abs);
+    }
+
     // Calculate the most significant bit and clamp to a valid bin index.
     int msb = std::ceil((std::log(abs) - std::log(scale_)) / std::log(base_));
     int bin_index =
@@ -225,14 +322,14 @@ class ApproxBounds : public Algorithm<T> {
   // that lie in bins that are included in the bounds. In our case it is bins
   // (0, 1], (1, 2], (2, 4]. So 1 + 1 + 2 = 4. This is the same result if our
   // value 7 was initially clamped between [0, 4].
-  template <typename T2>
-  void AddToPartials(std::vector<T2>* partials, T value,
+  template <typename T2, typename Allocator>
+  void AddToPartials(std::vector<T2, Allocator>* partials, T value,
                      std::function<T2(T, T)> make_partial) {
     AddMultipleEntriesToPartials<T2>(partials, value, 1, make_partial);
   }
 
-  template <typename T2>
-  void AddToPartialSums(std::vector<T2>* sums, T value) {
+  template <typename T2, typename Allocator>
+  void AddToPartialSums(std::vector<T2, Allocator>* sums, T value) {
     AddMultipleEntriesToPartialSums<T2>(sums, value, 1);
   }
 
@@ -240,9 +337,10 @@ class ApproxBounds : public Algorithm<T> {
   // the boundaries corresponding to lower and upper to get the clamped value.
   // The value_transform and count parameters are used to calculate the
   // contribution of values clamped below lower or above upper, if applicable.
-  template <typename T2>
-  absl::StatusOr<T2> ComputeFromPartials(const std::vector<T2>& pos_partials,
-                                         const std::vector<T2>& neg_partials,
+  template <typename T2, typename Allocator>
+  absl::StatusOr<T2> ComputeFromPartials(
+      const std::vector<T2, Allocator>& pos_partials,
+      const std::vector<T2, Allocator>& neg_partials,
                                          std::function<T2(T)> value_transform,
                                          T lower, T upper, int64_t count) {
     RETURN_IF_ERROR(ValidateIsNonNegative(count, "Count"));
@@ -315,11 +413,17 @@ class ApproxBounds : public Algorithm<T> {
  protected:
   ApproxBounds(double epsilon, int64_t num_bins, double scale, double base,
                double success_probability, bool has_user_set_threshold,
-               std::unique_ptr<NumericalMechanism> mechanism)
+               std::unique_ptr<NumericalMechanism> mechanism,
+               std::pmr::memory_resource* memory_resource =
+                   std::pmr::get_default_resource())
       : Algorithm<T>(epsilon),
-        pos_bins_(num_bins, 0),
-        neg_bins_(num_bins, 0),
-        bin_boundaries_(num_bins, 0),
+        memory_(memory_resource),
+        pos_bins_(num_bins, &memory_),
+        neg_bins_(num_bins, &memory_),
+        noisy_pos_bins_(&memory_),
+        noisy_neg_bins_(&memory_),
+        noisy_counts_(&memory_),
+        bin_boundaries_(num_bins, 0, &memory_),
         scale_(scale),
         base_(base),
         success_probability_(success_probability),
@@ -336,6 +440,20 @@ class ApproxBounds : public Algorithm<T> {
       return static_cast<T>(this_boundary);
     };
     std::generate(bin_boundaries_.begin(), bin_boundaries_.end(), get_boundary);
+
+    // With base 2 and a power-of-two scale, every boundary that is not
+    // saturated at the numeric limit is exactly scale * 2^i, so the bin index
+    // can be read from the exponent of the value. For integral types, scales
+    // below 1 are excluded because their boundaries are truncated.
+    int exponent;
+    if (base_ == 2 && std::frexp(scale_, &exponent) == 0.5 &&
+        (!std::is_integral<T>::value || exponent >= 1)) {
+      scale_exponent_ = exponent - 1;
+      max_bin_index_ =
+          std::find(bin_boundaries_.begin(), bin_boundaries_.end() - 1,
+                    std::numeric_limits<T>::max()) -
+          bin_boundaries_.begin();
+    }
   }
 
   // Returns an output containing approximate min as the first element and
@@ -347,32 +465,16 @@ class ApproxBounds : public Algorithm<T> {
   // kApproxBoundsNotEnoughDataUrl.
   absl::StatusOr<Output> GenerateResult(double noise_interval_level) override {
     // Populate noisy versions of the histogram bins.
-    noisy_pos_bins_ = AddNoise(pos_bins_);
-    noisy_neg_bins_ = AddNoise(neg_bins_);
-
-    double success_probability = success_probability_;
+    AddNoise(pos_bins_, &noisy_pos_bins_);
+    AddNoise(neg_bins_, &noisy_neg_bins_);
 
     std::optional<Output> output;
-    int bounding_attempts = 0;
-    int max_bounding_attempts = 30;
-    do {
-      double threshold = mechanism_->Quantile(
-          std::pow(success_probability, 1.0 / (2 * pos_bins_.size())));
-
+    for (double threshold : BoundingThresholds()) {
       output = findBounds(threshold);
-
-      if (has_user_set_threshold_) {
-        // The user asked for a specific threshold, so don't try again with a
-        // looser threshold.
+      if (output.has_value()) {
         break;
       }
-
-      double failure_probability = 1 - success_probability;
-      success_probability = 1 - 10 * failure_probability;
-      bounding_attempts++;
-    } while (!output.has_value() &&
-             success_probability > kMinSuccessProbability &&
-             bounding_attempts < max_bounding_attempts);
+    }
 
     // Record error status if approx min or max was not found.
     if (!output.has_value() || output->elements_size() < 2) {
@@ -387,17 +489,44 @@ class ApproxBounds : public Algorithm<T> {
     return *output;
   }
 
+  // Returns the thresholds that noised bin counts are compared to, in the
+  // order in which they are tried. After the threshold of success_probability_
+  // the success probability is relaxed until bounds are found or it becomes
+  // too small, unless the user set a specific threshold.
+  std::vector<double> BoundingThresholds() {
+    constexpr int kMaxBoundingAttempts = 30;
+    std::vector<double> thresholds;
+    double success_probability = success_probability_;
+    do {
+      thresholds.push_back(mechanism_->Quantile(
+          std::pow(success_probability, 1.0 / (2 * pos_bins_.size()))));
+      if (has_user_set_threshold_) {
+        // The user asked for a specific threshold, so don't try again with a
+        // looser threshold.
+        break;
+      }
+      double failure_probability = 1 - success_probability;
+      success_probability = 1 - 10 * failure_probability;
+    } while (success_probability > kMinSuccessProbability &&
+             thresholds.size() < kMaxBoundingAttempts);
+    return thresholds;
+  }
+
   // Finds approximate bounds by comparing noised bin counts to a threshold.
   // This method does not add any noise (it assumes that noisy_pos_bins_ and
   // noisy_neg_bins_ have been initialised) so calling this method multiple
   // times with different thresholds is DP: the noised histogram is itself DP.
   std::optional<Output> findBounds(double threshold) {
-    std::optional<T> lowerBound = findLowerBound(threshold);
+    std::optional<T> lowerBound = findLowerBound(
+        absl::MakeConstSpan(noisy_pos_bins_),
+        absl::MakeConstSpan(noisy_neg_bins_), threshold);
     if (!lowerBound.has_value()) {
       return std::nullopt;
     }
 
-    std::optional<T> upperBound = findUpperBound(threshold);
+    std::optional<T> upperBound = findUpperBound(
+        absl::MakeConstSpan(noisy_pos_bins_),
+        absl::MakeConstSpan(noisy_neg_bins_), threshold);
     if (!upperBound.has_value()) {
       return std::nullopt;
     }
@@ -409,8 +538,8 @@ class ApproxBounds : public Algorithm<T> {
   }
 
   void ResetState() override {
-    std::fill(pos_bins_.begin(), pos_bins_.end(), 0);
-    std::fill(neg_bins_.begin(), neg_bins_.end(), 0);
+    pos_bins_.Clear();
+    neg_bins_.Clear();
   }
 
   // Given a bin index, finds the larger-magnitude boundary of the corresponding
@@ -440,19 +569,95 @@ class ApproxBounds : public Algorithm<T> {
 
     // Place into correct bin according to most significant bit and sign. Note
     // that MostSignificantBit returns 0 for 0.
-    int index = MostSignificantBit(input);
+    AddMultipleEntriesToBin(input, MostSignificantBit(input), num_of_entries);
+  }
+
+  // Computes the same bin index as MostSignificantBit() for a non-NaN value.
+  // Power-of-two bins are handled by PowerOfTwoBinIndex(). Otherwise, instead
+  // of taking logarithms, this counts the bin boundaries, except for the last
+  // one, that are below the magnitude of the value. The loop has a fixed trip
+  // count and no branches, which lets the compiler vectorize it.
+  int BinIndex(T value) const {
+    const T magnitude = value <= -std::numeric_limits<T>::max()
+                            ? std::numeric_limits<T>::max()
+                            : std::abs(value);
+    if (scale_exponent_.has_value()) {
+      return PowerOfTwoBinIndex(std::min(magnitude,
+                                         std::numeric_limits<T>::max()));
+    }
+    const int num_boundaries = static_cast<int>(bin_boundaries_.size()) - 1;
+    int bin_index = 0;
+    for (int i = 0; i < num_boundaries; ++i) {
+      bin_index += magnitude > bin_boundaries_[i];
+    }
+    return bin_index;
+  }
+
+  // Bin index of a finite, non-negative magnitude when the bins are powers of
+  // two, see scale_exponent_. The index is the base-2 logarithm of the
+  // magnitude, rounded up, minus the exponent of the scale.
+  int PowerOfTwoBinIndex(T magnitude) const {
+    if (magnitude == 0) {
+      return 0;
+    }
+    int log2_ceil;
+    if constexpr (std::is_integral<T>::value) {
+      log2_ceil = absl::bit_width(
+          static_cast<std::make_unsigned_t<T>>(magnitude - 1));
+    } else {
+      int exponent;
+      log2_ceil = std::frexp(magnitude, &exponent) == 0.5 ? exponent - 1
+                                                          : exponent;
+    }
+    return std::clamp(log2_ceil - *scale_exponent_, 0, max_bin_index_);
+  }
+
+  // Adds all inputs to the bins, and their partial sums to pos_sums and
+  // neg_sums, in a single pass. Equivalent to calling AddEntry and
+  // AddToPartialSums on each input, up to floating-point rounding. Returns the
+  // number of inputs that are not NaN. The partials may be of a wider type T2
+  // than the inputs, e.g., int64_t for int32_t inputs.
+  template <typename T2, typename Allocator>
+  int64_t AddEntriesWithPartialSums(absl::Span<const T> inputs,
+                                    std::vector<T2, Allocator>* pos_sums,
+                                    std::vector<T2, Allocator>* neg_sums) {
+    return AddEntriesToBinsAndPartials<std::vector<double>>(
+        inputs, pos_sums, neg_sums, /*pos_squares=*/nullptr,
+        /*neg_squares=*/nullptr);
+  }
+
+  // Same as AddEntriesWithPartialSums, and also adds the partials of the
+  // squares of the inputs to pos_squares and neg_squares in the same pass,
+  // like AddMultipleEntriesToPartials with the difference of squares as
+  // make_partial. Returns the number of inputs that are not NaN.
+  template <typename Allocator, typename SquaresAllocator>
+  int64_t AddEntriesWithPartialSumsAndSquares(
+      absl::Span<const T> inputs, std::vector<T, Allocator>* pos_sums,
+      std::vector<T, Allocator>* neg_sums,
+      std::vector<double, SquaresAllocator>* pos_squares,
+      std::vector<double, SquaresAllocator>* neg_squares) {
+    return AddEntriesToBinsAndPartials(inputs, pos_sums, neg_sums, pos_squares,
+                                       neg_squares);
+  }
+
+  // Adds a valid input num_of_entries times to the bin with the given index,
+  // which must be MostSignificantBit(input). Lets callers that also keep
+  // partials compute the bin index only once per input.
+  void AddMultipleEntriesToBin(const T& input, int bin_index,
+                               int64_t num_of_entries) {
     if (input >= 0) {
-      pos_bins_[index] += num_of_entries;
+      pos_bins_.Add(bin_index, num_of_entries);
     } else {  // value < 0
-      neg_bins_[index] += num_of_entries;
+      neg_bins_.Add(bin_index, num_of_entries);
     }
   }
 
   // Adds value to partials (as described in comment for AddToPartials())
   // num_of_entries times. This function more efficiently adds multiple entries
   // at once, instead of using AddToPartials() in a for-loop.
-  template <typename T2>
-  void AddMultipleEntriesToPartials(std::vector<T2>* partials, T value,
+  template <typename T2, typename Allocator>
+  void AddMultipleEntriesToPartials(std::vector<T2, Allocator>* partials,
+                                    T value,
                                     int64_t num_of_entries,
                                     std::function<T2(T, T)> make_partial) {
     // REF:
@@ -463,8 +668,17 @@ class ApproxBounds : public Algorithm<T> {
       return;
     }
 
-    int msb = MostSignificantBit(value);
+    AddMultipleEntriesToPartialsOfBin<T2>(partials, value,
+                                          MostSignificantBit(value),
+                                          num_of_entries, make_partial);
+  }
 
+  // Same as AddMultipleEntriesToPartials() for a valid value whose bin index
+  // msb = MostSignificantBit(value) is already known.
+  template <typename T2, typename Allocator>
+  void AddMultipleEntriesToPartialsOfBin(
+      std::vector<T2, Allocator>* partials, T value, int msb,
+      int64_t num_of_entries, std::function<T2(T, T)> make_partial) {
     // Each bin of the logarithmic histograms in ApproxBounds can be a candidate
     // for auto-determined upper and lower bounds. Thus, we store a contribution
     // of the value from the value for each bin.
@@ -504,21 +718,356 @@ class ApproxBounds : public Algorithm<T> {
 
   // Break value into its partial sums and store it into the sums vector. A
   // specific use case of AddToPartials used in some algorithms.
-  template <typename T2>
-  void AddMultipleEntriesToPartialSums(std::vector<T2>* sums, T value,
+  template <typename T2, typename Allocator>
+  void AddMultipleEntriesToPartialSums(std::vector<T2, Allocator>* sums,
+                                       T value,
                                        int64_t num_of_entries) {
     AddMultipleEntriesToPartials<T2>(
         sums, value, num_of_entries,
         [](T val1, T val2) { return val1 - val2; });
   }
 
-  // Add noise to each member of bins and return noisy vector.
-  std::vector<T> AddNoise(const std::vector<int64_t>& bins) {
-    std::vector<T> noisy_bins(bins.size());
+  // Adds noise to each member of bins with a single batched call of the
+  // mechanism and stores the result in noisy_bins, which keeps its capacity
+  // across results.
+  void AddNoise(const internal::CompactCounters& bins,
+                std::pmr::vector<T>* noisy_bins) {
+    const std::vector<int64_t> counts = bins.ToVector();
+    // The batch sizes always match, so AddNoise does not fail.
+    noisy_bins->resize(counts.size());
+    if constexpr (std::is_same_v<T, int64_t>) {
+      mechanism_->AddNoise(counts, absl::MakeSpan(*noisy_bins)).IgnoreError();
+    } else {
+      noisy_counts_.resize(counts.size());
+      mechanism_->AddNoise(counts, absl::MakeSpan(noisy_counts_))
+          .IgnoreError();
+      std::copy(noisy_counts_.begin(), noisy_counts_.end(),
+                noisy_bins->begin());
+    }
+  }
+
+  // ApproxBoundsSummary of SerializeCompact().
+  ApproxBoundsSummary CompactApproxBoundsSummary() const {
+    ApproxBoundsSummary summary;
+    summary.set_num_bins(pos_bins_.size());
+    AppendSparseBins(pos_bins_, summary.mutable_sparse_pos_bin_index_deltas(),
+                     summary.mutable_sparse_pos_bin_counts());
+    AppendSparseBins(neg_bins_, summary.mutable_sparse_neg_bin_index_deltas(),
+                     summary.mutable_sparse_neg_bin_counts());
+    return summary;
+  }
+
+  // Adds the bin counts of a summary in either encoding. The state is left
+  // unchanged if the summary is invalid.
+  absl::Status MergeApproxBoundsSummary(const ApproxBoundsSummary& summary) {
+    const int num_bins = pos_bins_.size();
+    const bool has_dense_bins =
+        summary.pos_bin_count_size() > 0 || summary.neg_bin_count_size() > 0;
+    if ((has_dense_bins && (summary.pos_bin_count_size() != num_bins ||
+                            summary.neg_bin_count_size() != num_bins)) ||
+        (!has_dense_bins && !summary.has_num_bins()) ||
+        (summary.has_num_bins() && summary.num_bins() != num_bins)) {
+      return absl::InternalError(
+          "Merged approximate max summary must have the same number of "
+          "bin counts as this histogram.");
+    }
+    RETURN_IF_ERROR(CheckSparseBins(summary.sparse_pos_bin_index_deltas(),
+                                    summary.sparse_pos_bin_counts()));
+    RETURN_IF_ERROR(CheckSparseBins(summary.sparse_neg_bin_index_deltas(),
+                                    summary.sparse_neg_bin_counts()));
+
+    // Add bin count from summary to each bin.
+    for (int i = 0; i < summary.pos_bin_count_size(); ++i) {
+      pos_bins_.Add(i, summary.pos_bin_count(i));
+      neg_bins_.Add(i, summary.neg_bin_count(i));
+    }
+    AddSparseBins(summary.sparse_pos_bin_index_deltas(),
+                  summary.sparse_pos_bin_counts(), &pos_bins_);
+    AddSparseBins(summary.sparse_neg_bin_index_deltas(),
+                  summary.sparse_neg_bin_counts(), &neg_bins_);
+    return absl::OkStatus();
+  }
+
+  // Same as MergeApproxBoundsSummary for a serialized ApproxBoundsSummary,
+  // which is validated in a first pass and added in a second one. Returns
+  // false and leaves the state unchanged if the summary is malformed or
+  // invalid, or if a sparse bin array is split into several packed chunks,
+  // which this does not pair up; callers then parse the summary instead.
+  bool MergeApproxBoundsBytes(absl::string_view payload) {
+    const int num_bins = pos_bins_.size();
+    int dense_sizes[2] = {0, 0};
+    std::optional<int32_t> summary_num_bins;
+    // Packed index deltas and counts of the sparse positive and negative bins,
+    // i.e., fields 3 to 6.
+    absl::string_view sparse[4];
+    bool has_sparse[4] = {false, false, false, false};
+    internal::WireReader reader(payload);
+    while (!reader.empty()) {
+      int field;
+      internal::WireType wire_type;
+      if (!reader.ReadTag(&field, &wire_type)) return false;
+      if (field == 1 || field == 2) {
+        int& size = dense_sizes[field - 1];
+        if (!internal::ForEachVarint(reader, wire_type,
+                                     [&size](uint64_t) { ++size; })) {
+          return false;
+        }
+      } else if (field >= 3 && field <= 6) {
+        if (has_sparse[field - 3] ||
+            wire_type != internal::WireType::kLengthDelimited ||
+            !reader.ReadLengthDelimited(&sparse[field - 3])) {
+          return false;
+        }
+        has_sparse[field - 3] = true;
+      } else if (field == 7 && wire_type == internal::WireType::kVarint) {
+        uint64_t value;
+        if (!reader.ReadVarint(&value)) return false;
+        summary_num_bins = static_cast<int32_t>(value);
+      } else if (!reader.SkipField(wire_type)) {
+        return false;
+      }
+    }
+    const bool has_dense_bins = dense_sizes[0] > 0 || dense_sizes[1] > 0;
+    if ((has_dense_bins &&
+         (dense_sizes[0] != num_bins || dense_sizes[1] != num_bins)) ||
+        (!has_dense_bins && !summary_num_bins.has_value()) ||
+        (summary_num_bins.has_value() && *summary_num_bins != num_bins)) {
+      return false;
+    }
+    auto ignore = [](int, int64_t) {};
+    if (!ForEachSparseBin(sparse[0], sparse[1], ignore) ||
+        !ForEachSparseBin(sparse[2], sparse[3], ignore)) {
+      return false;
+    }
+
+    // The summary is valid, so the second pass cannot fail.
+    int dense_indices[2] = {0, 0};
+    internal::WireReader adder(payload);
+    while (!adder.empty()) {
+      int field;
+      internal::WireType wire_type;
+      adder.ReadTag(&field, &wire_type);
+      if (field == 1 || field == 2) {
+        internal::CompactCounters& bins = field == 1 ? pos_bins_ : neg_bins_;
+        int& i = dense_indices[field - 1];
+        internal::ForEachVarint(adder, wire_type, [&bins, &i](uint64_t count) {
+          bins.Add(i++, static_cast<int64_t>(count));
+        });
+      } else {
+        adder.SkipField(wire_type);
+      }
+    }
+    ForEachSparseBin(sparse[0], sparse[1], [this](int bin, int64_t count) {
+      pos_bins_.Add(bin, count);
+    });
+    ForEachSparseBin(sparse[2], sparse[3], [this](int bin, int64_t count) {
+      neg_bins_.Add(bin, count);
+    });
+    return true;
+  }
+
+  // Calls f with the bin and count of every sparse bin in the packed arrays.
+  // Returns false if the arrays are malformed or differ in size, or if the
+  // bins are not increasing or outside of this histogram.
+  template <typename F>
+  bool ForEachSparseBin(absl::string_view index_deltas,
+                        absl::string_view counts, F f) const {
+    internal::WireReader deltas_reader(index_deltas);
+    internal::WireReader counts_reader(counts);
+    int64_t bin = 0;
+    bool first = true;
+    while (!deltas_reader.empty()) {
+      uint64_t delta;
+      uint64_t count;
+      if (!deltas_reader.ReadVarint(&delta) || counts_reader.empty() ||
+          !counts_reader.ReadVarint(&count)) {
+        return false;
+      }
+      const int32_t index_delta = static_cast<int32_t>(delta);
+      if (index_delta < 0 || (!first && index_delta == 0)) return false;
+      bin += index_delta;
+      if (bin >= pos_bins_.size()) return false;
+      f(static_cast<int>(bin), static_cast<int64_t>(count));
+      first = false;
+    }
+    return counts_reader.empty();
+  }
+
+  static void AppendSparseBins(
+      const internal::CompactCounters& bins,
+      google::protobuf::RepeatedField<int32_t>* index_deltas,
+      google::protobuf::RepeatedField<int64_t>* counts) {
+    int previous = 0;
     for (int i = 0; i < bins.size(); ++i) {
-      noisy_bins[i] = mechanism_->AddNoise(bins[i]);
+      const int64_t count = bins.Get(i);
+      if (count != 0) {
+        index_deltas->Add(i - previous);
+        counts->Add(count);
+        previous = i;
+      }
+    }
+  }
+
+  // Checks that the sparse bins are in increasing order and exist in this
+  // histogram.
+  absl::Status CheckSparseBins(
+      const google::protobuf::RepeatedField<int32_t>& index_deltas,
+      const google::protobuf::RepeatedField<int64_t>& counts) const {
+    if (index_deltas.size() != counts.size()) {
+      return absl::InternalError(absl::StrCat(
+          "Summary contains ", index_deltas.size(), " sparse bin indices but ",
+          counts.size(), " sparse bin counts."));
+    }
+    int64_t bin = 0;
+    for (int i = 0; i < index_deltas.size(); ++i) {
+      if (index_deltas[i] < 0 || (i > 0 && index_deltas[i] == 0)) {
+        return absl::InternalError(
+            "Summary contains sparse bins that are not in increasing order.");
+      }
+      bin += index_deltas[i];
+      if (bin >= pos_bins_.size()) {
+        return absl::InternalError(
+            absl::StrCat("Summary contains bin ", bin,
+                         " which is outside of the histogram with ",
+                         pos_bins_.size(), " bins."));
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  static void AddSparseBins(
+      const google::protobuf::RepeatedField<int32_t>& index_deltas,
+      const google::protobuf::RepeatedField<int64_t>& counts,
+      internal::CompactCounters* bins) {
+    int bin = 0;
+    for (int i = 0; i < index_deltas.size(); ++i) {
+      bin += index_deltas[i];
+      bins->Add(bin, counts[i]);
     }
-    return noisy_bins;
+  }
+
+  // Implements AddEntriesWithPartialSums and, if pos_squares and
+  // neg_squares are not null, AddEntriesWithPartialSumsAndSquares. Every input
+  // contributes the full partial of each bin below its own bin, so only the
+  // number of inputs and the sums of remainders per bin are accumulated, and
+  // the partials are updated once per bin at the end. Remainders of floating
+  // point inputs and of squares are summed with CompensatedSum in double, so
+  // that float inputs do not lose precision over long batches. Returns the
+  // number of inputs that are not NaN.
+  template <typename SquaresVector, typename T2, typename Allocator>
+  int64_t AddEntriesToBinsAndPartials(absl::Span<const T> inputs,
+                                   std::vector<T2, Allocator>* pos_sums,
+                                   std::vector<T2, Allocator>* neg_sums,
+                                   SquaresVector* pos_squares,
+                                   SquaresVector* neg_squares) {
+    using RemainderSum =
+        std::conditional_t<std::is_integral_v<T>, T2, CompensatedSum>;
+    const bool with_squares = pos_squares != nullptr;
+    const int num_bins = pos_bins_.size();
+    std::vector<int64_t> pos_counts(num_bins, 0);
+    std::vector<int64_t> neg_counts(num_bins, 0);
+    std::vector<RemainderSum> pos_remainders(num_bins);
+    std::vector<RemainderSum> neg_remainders(num_bins);
+    std::vector<CompensatedSum> pos_square_remainders(
+        with_squares ? num_bins : 0);
+    std::vector<CompensatedSum> neg_square_remainders(
+        with_squares ? num_bins : 0);
+    std::vector<T> pos_lefts(num_bins);
+    std::vector<T> neg_lefts(num_bins);
+    std::vector<T> pos_widths(num_bins);
+    std::vector<T> neg_widths(num_bins);
+    std::vector<double> pos_square_widths(num_bins);
+    std::vector<double> neg_square_widths(num_bins);
+    for (int i = 0; i < num_bins; ++i) {
+      pos_lefts[i] = PosLeftBinBoundary(i);
+      neg_lefts[i] = NegLeftBinBoundary(i);
+      pos_widths[i] = PosRightBinBoundary(i) - pos_lefts[i];
+      neg_widths[i] = NegRightBinBoundary(i) - neg_lefts[i];
+      pos_square_widths[i] =
+          DifferenceOfSquares(PosRightBinBoundary(i), pos_lefts[i]);
+      neg_square_widths[i] =
+          DifferenceOfSquares(NegRightBinBoundary(i), neg_lefts[i]);
+    }
+
+    for (const T& input : inputs) {
+      if (std::isnan(static_cast<double>(input))) {
+        continue;
+      }
+      const int bin_index = BinIndex(input);
+      if (input >= 0) {
+        const T remainder = input - pos_lefts[bin_index];
+        const T width = pos_widths[bin_index];
+        ++pos_counts[bin_index];
+        AddRemainder(remainder < width ? remainder : width,
+                     &pos_remainders[bin_index]);
+        if (with_squares) {
+          const double square_remainder =
+              DifferenceOfSquares(input, pos_lefts[bin_index]);
+          const double square_width = pos_square_widths[bin_index];
+          pos_square_remainders[bin_index].Add(
+              std::abs(square_width) < std::abs(square_remainder)
+                  ? square_width
+                  : square_remainder);
+        }
+      } else {
+        const T remainder = input - neg_lefts[bin_index];
+        const T width = neg_widths[bin_index];
+        ++neg_counts[bin_index];
+        AddRemainder(remainder > width ? remainder : width,
+                     &neg_remainders[bin_index]);
+        if (with_squares) {
+          const double square_remainder =
+              DifferenceOfSquares(input, neg_lefts[bin_index]);
+          const double square_width = neg_square_widths[bin_index];
+          neg_square_remainders[bin_index].Add(
+              std::abs(square_width) < std::abs(square_remainder)
+                  ? square_width
+                  : square_remainder);
+        }
+      }
+    }
+
+    int64_t pos_above = 0;
+    int64_t neg_above = 0;
+    for (int i = num_bins - 1; i >= 0; --i) {
+      pos_bins_.Add(i, pos_counts[i]);
+      neg_bins_.Add(i, neg_counts[i]);
+      (*pos_sums)[i] += static_cast<T2>(pos_widths[i]) * pos_above +
+                        RemainderValue(pos_remainders[i]);
+      (*neg_sums)[i] += static_cast<T2>(neg_widths[i]) * neg_above +
+                        RemainderValue(neg_remainders[i]);
+      if (with_squares) {
+        (*pos_squares)[i] += pos_square_widths[i] * pos_above +
+                             pos_square_remainders[i].Value();
+        (*neg_squares)[i] += neg_square_widths[i] * neg_above +
+                             neg_square_remainders[i].Value();
+      }
+      pos_above += pos_counts[i];
+      neg_above += neg_counts[i];
+    }
+    return pos_above + neg_above;
+  }
+
+  // Same difference of squares as the partials of BoundedVariance, computed
+  // so that it is less likely to overflow to infinity.
+  static double DifferenceOfSquares(T val1, T val2) {
+    return (static_cast<double>(val1) + val2) *
+           (static_cast<double>(val1) - val2);
+  }
+
+  template <typename T2>
+  static void AddRemainder(T remainder, T2* sum) {
+    *sum += remainder;
+  }
+  static void AddRemainder(T remainder, CompensatedSum* sum) {
+    sum->Add(remainder);
+  }
+  template <typename T2>
+  static T2 RemainderValue(T2 sum) {
+    return sum;
+  }
+  static double RemainderValue(const CompensatedSum& sum) {
+    return sum.Value();
   }
 
   // Given a bin index, finds the smaller-magnitude boundary of the
@@ -601,37 +1150,51 @@ class ApproxBounds : public Algorithm<T> {
   friend class ApproxBoundsTestPeer;
 
   // Needed for classes that rely on ApproxBounds::AddMultipleEntries()
+  template <typename T2, typename Accumulator>
+  friend class BoundedSumWithApproxBounds;
   template <typename T2>
   friend class BoundedMeanWithApproxBounds;
   template <typename T2>
   friend class BoundedVarianceWithApproxBounds;
+  template <typename T2>
+  friend class BoundedStatistics;
+  template <typename T2>
+  friend class ColumnarPartitionStore;
 
  private:
-  std::optional<T> findLowerBound(double threshold) {
+  // The noisy bins may be those of this ApproxBounds or, for callers that
+  // keep the bins of many partitions, the noisy bins of one partition.
+  template <typename Bin>
+  std::optional<T> findLowerBound(absl::Span<const Bin> noisy_pos_bins,
+                                  absl::Span<const Bin> noisy_neg_bins,
+                                  double threshold) {
     // Find first bin above threshold for minimum.
-    for (int i = neg_bins_.size() - 1; i >= 0; --i) {
-      if (noisy_neg_bins_[i] >= threshold) {
+    for (int i = noisy_neg_bins.size() - 1; i >= 0; --i) {
+      if (noisy_neg_bins[i] >= threshold) {
         return NegRightBinBoundary(i);
       }
     }
-    for (int i = 0; i < pos_bins_.size(); ++i) {
-      if (noisy_pos_bins_[i] >= threshold) {
+    for (int i = 0; i < noisy_pos_bins.size(); ++i) {
+      if (noisy_pos_bins[i] >= threshold) {
         return PosLeftBinBoundary(i);
       }
     }
     return std::nullopt;
   }
 
-  std::optional<T> findUpperBound(double threshold) {
+  template <typename Bin>
+  std::optional<T> findUpperBound(absl::Span<const Bin> noisy_pos_bins,
+                                  absl::Span<const Bin> noisy_neg_bins,
+                                  double threshold) {
     // Find first bin above threshold for maximum.
-    for (int i = pos_bins_.size() - 1; i >= 0; --i) {
-      if (noisy_pos_bins_[i] >= threshold) {
+    for (int i = noisy_pos_bins.size() - 1; i >= 0; --i) {
+      if (noisy_pos_bins[i] >= threshold) {
         return PosRightBinBoundary(i);
       }
     }
 
-    for (int i = 0; i < neg_bins_.size(); ++i) {
-      if (noisy_neg_bins_[i] >= threshold) {
+    for (int i = 0; i < noisy_neg_bins.size(); ++i) {
+      if (noisy_neg_bins[i] >= threshold) {
         return NegLeftBinBoundary(i);
       }
     }
@@ -639,17 +1202,23 @@ class ApproxBounds : public Algorithm<T> {
     return std::nullopt;
   }
 
-  // Count the values in each logarithmic bin for positives and negatives.
-  std::vector<int64_t> pos_bins_;
-  std::vector<int64_t> neg_bins_;
+  // Tracks the allocations of the vectors below for MemoryUsed.
+  base::TrackingMemoryResource memory_;
+
+  // Count the values in each logarithmic bin for positives and negatives. The
+  // counts are stored compactly since most partitions only have a few inputs.
+  internal::CompactCounters pos_bins_;
+  internal::CompactCounters neg_bins_;
 
   // Noisy DP counts of the positive and negative bins. Populated upon
   // generating the result.
-  std::vector<T> noisy_pos_bins_;
-  std::vector<T> noisy_neg_bins_;
+  std::pmr::vector<T> noisy_pos_bins_;
+  std::pmr::vector<T> noisy_neg_bins_;
+  // Noisy counts before the conversion to T, if T is not int64_t.
+  std::pmr::vector<int64_t> noisy_counts_;
 
   // The bin boundary magnitudes, starting from lowest positive magnitude.
-  std::vector<T> bin_boundaries_;
+  std::pmr::vector<T> bin_boundaries_;
 
   // Multiplicative factor for inputs
   double scale_;
@@ -657,6 +1226,15 @@ class ApproxBounds : public Algorithm<T> {
   // Base of the logarithm.
   double base_;
 
+  // Set to log2(scale_) when base_ is 2 and scale_ is a power of two, in which
+  // case bin indices are computed from the binary exponent of the input
+  // instead of from logarithms.
+  std::optional<int> scale_exponent_;
+
+  // Highest bin index that PowerOfTwoBinIndex() may return. Bins above the
+  // first boundary saturated at the numeric limit can never be reached.
+  int max_bin_index_ = 0;
+
   // The desired probability that, when the dataset is empty, no bin counts are
   // above the threshold for determining whether a bin is empty.
   double success_probability_;
@@ -708,6 +1286,23 @@ class ApproxBounds<T>::Builder {
     return *this;
   }
 
+  // Allocates the histogram bins from `memory_resource` instead of the
+  // default resource. The resource must outlive the built ApproxBounds.
+  ApproxBounds<T>::Builder& SetMemoryResource(
+      std::pmr::memory_resource* memory_resource) {
+    memory_resource_ = memory_resource;
+    return *this;
+  }
+
+  // Accounts the histogram bins to a memory budget shared with other
+  // algorithms, by allocating them from it. The bins are already stored
+  // compactly, with 16-bit counters for small counts, so they do not change
+  // with the budget; they count towards it so that other algorithms degrade
+  // in time. The budget must outlive the built ApproxBounds.
+  ApproxBounds<T>::Builder& SetMemoryBudget(base::MemoryBudget* memory_budget) {
+    return SetMemoryResource(memory_budget);
+  }
+
   ApproxBounds<T>::Builder& SetNumBins(int64_t num_bins) {
     num_bins_ = num_bins;
     return *this;
@@ -798,7 +1393,7 @@ class ApproxBounds<T>::Builder {
     // Create ApproxBounds.
     return absl::WrapUnique(new ApproxBounds(
         epsilon_.value(), num_bins_, scale_, base_, success_probability_,
-        threshold_.has_value(), std::move(mechanism)));
+        threshold_.has_value(), std::move(mechanism), memory_resource_));
   }
 
  private:
@@ -816,6 +1411,8 @@ class ApproxBounds<T>::Builder {
   int max_contributions_per_partition_ = 1;
   std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
       absl::make_unique<LaplaceMechanism::Builder>();
+  std::pmr::memory_resource* memory_resource_ =
+      std::pmr::get_default_resource();
 
   std::optional<double> threshold_;
   double scale_ = DefaultScaleForT();
@@ -829,6 +1426,11 @@ class ApproxBounds<T>::Builder {
       1;
 };
 
+// Instantiated once in approx-bounds.cc for the most common entry types,
+// instead of in every translation unit that uses them.
+extern template class ApproxBounds<int64_t>;
+extern template class ApproxBounds<double>;
+
 }  // namespace differential_privacy
 
 #endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_APPROX_BOUNDS_H_
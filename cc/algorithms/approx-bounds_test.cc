@@ -16,9 +16,11 @@
 
 #include "algorithms/approx-bounds.h"
 
+#include <cmath>
 #include <limits>
 #include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "base/testing/proto_matchers.h"
@@ -31,6 +33,7 @@
 #include "absl/strings/cord.h"
 #include "algorithms/numerical-mechanisms-testing.h"
 #include "algorithms/numerical-mechanisms.h"
+#include "base/instrumentation.h"
 #include "proto/data.pb.h"
 
 namespace differential_privacy {
@@ -65,6 +68,7 @@ class ApproxBoundsTestPeer {
 namespace {
 
 using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::differential_privacy::base::testing::EqualsProto;
 using ::testing::HasSubstr;
@@ -96,6 +100,36 @@ TEST(ApproxBoundsTest, BasicTest) {
   EXPECT_EQ(result->elements(1).value().int_value(), 8);
 }
 
+TYPED_TEST(ApproxBoundsTest, NoisesBinsInOneBatchPerSign) {
+  std::vector<TypeParam> a = {1, 1, 2, 4, 4, 4};
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds =
+      typename ApproxBounds<TypeParam>::Builder()
+          .SetNumBins(8)
+          .SetBase(2)
+          .SetThresholdForTest(1.5)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(bounds);
+  (*bounds)->AddEntries(a.begin(), a.end());
+
+  instrumentation::AggregatingSink sink;
+  instrumentation::SetSink(&sink);
+  absl::StatusOr<Output> result = (*bounds)->PartialResult();
+  instrumentation::SetSink(nullptr);
+  ASSERT_OK(result);
+  instrumentation::AggregatingSink::Totals add_noise =
+      sink.Get(instrumentation::Event::kMechanismAddNoise);
+  EXPECT_EQ(add_noise.calls, 2);
+  EXPECT_EQ(add_noise.count, 16);
+
+  // The noisy bins of the next result reuse the allocations.
+  const int64_t memory = (*bounds)->MemoryUsed();
+  (*bounds)->Reset();
+  (*bounds)->AddEntries(a.begin(), a.end());
+  ASSERT_OK((*bounds)->PartialResult());
+  EXPECT_EQ((*bounds)->MemoryUsed(), memory);
+}
+
 TEST(ApproxBoundsTest, BasicMultipleEntriesTest) {
   std::vector<int64_t> a = {1, 2, 3, 5, 8, 13};
 
@@ -557,6 +591,233 @@ TYPED_TEST(ApproxBoundsTest, SerializeAndMergeTest) {
                   result2->elements(1).value().float_value());
 }
 
+TYPED_TEST(ApproxBoundsTest, SerializeToBinaryAndMergeTest) {
+  std::vector<TypeParam> a = {-1, -11, 6};
+  std::vector<TypeParam> b = {3, 5, 15, 56};
+  typename ApproxBounds<TypeParam>::Builder builder;
+
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds1 =
+      builder.SetNumBins(3)
+          .SetBase(10)
+          .SetScale(1)
+          .SetThresholdForTest(2)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(bounds1);
+  (*bounds1)->AddEntries(a.begin(), a.end());
+  std::string binary_summary = (*bounds1)->SerializeToBinary();
+  (*bounds1)->AddEntries(b.begin(), b.end());
+
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds2 =
+      builder.Build();
+  ASSERT_OK(bounds2);
+  EXPECT_OK((*bounds2)->MergeFromBinary(binary_summary));
+  (*bounds2)->AddEntries(b.begin(), b.end());
+
+  EXPECT_THAT((*bounds2)->Serialize(), EqualsProto((*bounds1)->Serialize()));
+}
+
+TYPED_TEST(ApproxBoundsTest, SerializeCompactAndMergeTest) {
+  std::vector<TypeParam> a = {-1, -11, 6, 0};
+  std::vector<TypeParam> b = {3, 5, 15, 56};
+  typename ApproxBounds<TypeParam>::Builder builder;
+  builder.SetNumBins(3).SetBase(10).SetScale(1);
+
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds1 =
+      builder.Build();
+  ASSERT_OK(bounds1);
+  (*bounds1)->AddEntries(a.begin(), a.end());
+  const Summary compact = (*bounds1)->SerializeCompact();
+  const Summary dense = (*bounds1)->Serialize();
+  (*bounds1)->AddEntries(b.begin(), b.end());
+
+  // Compact and dense summaries can be merged in any combination.
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds2 =
+      builder.Build();
+  ASSERT_OK(bounds2);
+  (*bounds2)->AddEntries(b.begin(), b.end());
+  EXPECT_OK((*bounds2)->Merge(compact));
+  EXPECT_THAT((*bounds2)->Serialize(), EqualsProto((*bounds1)->Serialize()));
+  EXPECT_OK((*bounds2)->Merge(dense));
+  EXPECT_OK((*bounds1)->Merge(compact));
+  EXPECT_THAT((*bounds2)->Serialize(), EqualsProto((*bounds1)->Serialize()));
+}
+
+TEST(ApproxBoundsTest, SerializeCompactOnlyListsNonEmptyBins) {
+  absl::StatusOr<std::unique_ptr<ApproxBounds<double>>> bounds =
+      ApproxBounds<double>::Builder().Build();
+  ASSERT_OK(bounds);
+  (*bounds)->AddEntry(1);
+  (*bounds)->AddEntry(1);
+  (*bounds)->AddEntry(-1000);
+
+  ApproxBoundsSummary summary;
+  ASSERT_TRUE((*bounds)->SerializeCompact().data().UnpackTo(&summary));
+  EXPECT_EQ(summary.pos_bin_count_size(), 0);
+  EXPECT_EQ(summary.num_bins(), (*bounds)->GetNumPosBinsForTesting());
+  EXPECT_THAT(summary.sparse_pos_bin_counts(), ElementsAre(2));
+  EXPECT_THAT(summary.sparse_neg_bin_counts(), ElementsAre(1));
+  EXPECT_LT((*bounds)->SerializeCompact().ByteSizeLong() * 50,
+            (*bounds)->Serialize().ByteSizeLong());
+}
+
+TYPED_TEST(ApproxBoundsTest, MergeInvalidCompactSummaryFails) {
+  typename ApproxBounds<TypeParam>::Builder builder;
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds =
+      builder.SetNumBins(3).Build();
+  ASSERT_OK(bounds);
+  (*bounds)->AddEntry(1);
+  const Summary before = (*bounds)->Serialize();
+
+  auto merge = [&bounds](const ApproxBoundsSummary& am_summary) {
+    Summary summary;
+    summary.mutable_data()->PackFrom(am_summary);
+    return (*bounds)->Merge(summary);
+  };
+  ApproxBoundsSummary wrong_num_bins;
+  wrong_num_bins.set_num_bins(4);
+  EXPECT_THAT(merge(wrong_num_bins),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("same number of bin counts")));
+  ApproxBoundsSummary outside;
+  outside.set_num_bins(3);
+  outside.add_sparse_pos_bin_index_deltas(1);
+  outside.add_sparse_pos_bin_counts(1);
+  outside.add_sparse_pos_bin_index_deltas(2);
+  outside.add_sparse_pos_bin_counts(1);
+  EXPECT_THAT(merge(outside), StatusIs(absl::StatusCode::kInternal,
+                                       HasSubstr("outside of the histogram")));
+  ApproxBoundsSummary unordered;
+  unordered.set_num_bins(3);
+  unordered.add_sparse_neg_bin_index_deltas(1);
+  unordered.add_sparse_neg_bin_counts(1);
+  unordered.add_sparse_neg_bin_index_deltas(0);
+  unordered.add_sparse_neg_bin_counts(1);
+  EXPECT_THAT(merge(unordered), StatusIs(absl::StatusCode::kInternal,
+                                         HasSubstr("increasing order")));
+  ApproxBoundsSummary missing_counts;
+  missing_counts.set_num_bins(3);
+  missing_counts.add_sparse_pos_bin_index_deltas(1);
+  EXPECT_THAT(merge(missing_counts),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("sparse bin counts")));
+  EXPECT_THAT((*bounds)->Serialize(), EqualsProto(before));
+}
+
+TYPED_TEST(ApproxBoundsTest, MergeFromBytesMatchesMerge) {
+  std::vector<TypeParam> a = {-1, -11, 6, 0, 56};
+  typename ApproxBounds<TypeParam>::Builder builder;
+  builder.SetNumBins(3).SetBase(10).SetScale(1);
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> source =
+      builder.Build();
+  ASSERT_OK(source);
+  (*source)->AddEntries(a.begin(), a.end());
+
+  for (const Summary& summary :
+       {(*source)->Serialize(), (*source)->SerializeCompact()}) {
+    absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> merged =
+        builder.Build();
+    ASSERT_OK(merged);
+    (*merged)->AddEntry(5);
+    absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> parsed =
+        builder.Build();
+    ASSERT_OK(parsed);
+    (*parsed)->AddEntry(5);
+    EXPECT_OK((*merged)->MergeFromBytes(summary.SerializeAsString()));
+    EXPECT_OK((*parsed)->Merge(summary));
+    EXPECT_THAT((*merged)->Serialize(), EqualsProto((*parsed)->Serialize()));
+  }
+}
+
+TYPED_TEST(ApproxBoundsTest, MergeFromBytesRejectsInvalidSummaries) {
+  typename ApproxBounds<TypeParam>::Builder builder;
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds =
+      builder.SetNumBins(3).Build();
+  ASSERT_OK(bounds);
+  (*bounds)->AddEntry(1);
+  const Summary before = (*bounds)->Serialize();
+
+  auto merge = [&bounds](const ApproxBoundsSummary& am_summary) {
+    Summary summary;
+    summary.mutable_data()->PackFrom(am_summary);
+    return (*bounds)->MergeFromBytes(summary.SerializeAsString());
+  };
+  ApproxBoundsSummary too_few_bins;
+  too_few_bins.add_pos_bin_count(1);
+  too_few_bins.add_neg_bin_count(1);
+  EXPECT_THAT(merge(too_few_bins),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("same number of bin counts")));
+  ApproxBoundsSummary outside;
+  outside.set_num_bins(3);
+  outside.add_sparse_pos_bin_index_deltas(3);
+  outside.add_sparse_pos_bin_counts(1);
+  EXPECT_THAT(merge(outside), StatusIs(absl::StatusCode::kInternal,
+                                       HasSubstr("outside of the histogram")));
+  ApproxBoundsSummary missing_counts;
+  missing_counts.set_num_bins(3);
+  missing_counts.add_sparse_neg_bin_index_deltas(1);
+  EXPECT_THAT(merge(missing_counts),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("sparse bin counts")));
+  EXPECT_THAT((*bounds)->Serialize(), EqualsProto(before));
+}
+
+TYPED_TEST(ApproxBoundsTest, MergeFromBinaryWithDifferentNumBinsFails) {
+  typename ApproxBounds<TypeParam>::Builder builder;
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds1 =
+      builder.SetNumBins(3).Build();
+  ASSERT_OK(bounds1);
+  (*bounds1)->AddEntry(1);
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds2 =
+      builder.SetNumBins(4).Build();
+  ASSERT_OK(bounds2);
+  const Summary summary = (*bounds2)->Serialize();
+
+  EXPECT_THAT((*bounds2)->MergeFromBinary((*bounds1)->SerializeToBinary()),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("same number of values")));
+  EXPECT_THAT((*bounds2)->Serialize(), EqualsProto(summary));
+}
+
+TYPED_TEST(ApproxBoundsTest, MergeFromMatchesMerge) {
+  std::vector<TypeParam> a = {-1, -11, 6, 0};
+  std::vector<TypeParam> b = {3, 5, 15, 56};
+  typename ApproxBounds<TypeParam>::Builder builder;
+  builder.SetNumBins(3).SetBase(10).SetScale(1);
+
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds1 =
+      builder.Build();
+  ASSERT_OK(bounds1);
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds2 =
+      builder.Build();
+  ASSERT_OK(bounds2);
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds3 =
+      builder.Build();
+  ASSERT_OK(bounds3);
+  (*bounds1)->AddEntries(a.begin(), a.end());
+  (*bounds2)->AddEntries(b.begin(), b.end());
+  (*bounds3)->AddEntries(b.begin(), b.end());
+
+  EXPECT_OK((*bounds2)->MergeFrom(**bounds1));
+  EXPECT_OK((*bounds3)->Merge((*bounds1)->Serialize()));
+  EXPECT_THAT((*bounds2)->Serialize(), EqualsProto((*bounds3)->Serialize()));
+}
+
+TYPED_TEST(ApproxBoundsTest, MergeFromWithDifferentNumBinsFails) {
+  typename ApproxBounds<TypeParam>::Builder builder;
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds1 =
+      builder.SetNumBins(3).Build();
+  ASSERT_OK(bounds1);
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> bounds2 =
+      builder.SetNumBins(4).Build();
+  ASSERT_OK(bounds2);
+
+  EXPECT_THAT((*bounds2)->MergeFrom(**bounds1),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("same number of bin counts")));
+}
+
 TYPED_TEST(ApproxBoundsTest, SerializeAndMergeOverflowPosBinsTest) {
   typename ApproxBounds<int64_t>::Builder builder;
 
@@ -740,6 +1001,35 @@ TEST(ApproxBoundsTest, HandleInfinityEntries) {
   EXPECT_FLOAT_EQ(result->elements(1).value().float_value(), max_result);
 }
 
+TEST(ApproxBoundsTest, BinCountsBeyond16BitsSurviveMerge) {
+  ApproxBounds<int64_t>::Builder builder;
+  builder.SetNumBins(10)
+      .SetScale(1)
+      .SetBase(2)
+      .SetThresholdForTest(10)
+      .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<ApproxBounds<int64_t>>> bounds1 =
+      builder.Build();
+  ASSERT_OK(bounds1);
+  ApproxBoundsTestPeer::AddMultipleEntries<int64_t>(3, 20000,
+                                                    bounds1.value().get());
+  ApproxBoundsTestPeer::AddMultipleEntries<int64_t>(1, 5,
+                                                    bounds1.value().get());
+
+  absl::StatusOr<std::unique_ptr<ApproxBounds<int64_t>>> bounds2 =
+      builder.Build();
+  ASSERT_OK(bounds2);
+  ApproxBoundsTestPeer::AddMultipleEntries<int64_t>(3, 20000,
+                                                    bounds2.value().get());
+  EXPECT_OK((*bounds2)->Merge((*bounds1)->Serialize()));
+
+  // The merged count of the bin of 3 does not fit 16 bits.
+  absl::StatusOr<Output> result = (*bounds2)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(result->elements(0).value().int_value(), 2);
+  EXPECT_EQ(result->elements(1).value().int_value(), 4);
+}
+
 TEST(ApproxBoundsTest, NumPositiveBins) {
   absl::StatusOr<std::unique_ptr<ApproxBounds<double>>> bounds =
       ApproxBounds<double>::Builder()
@@ -1162,6 +1452,84 @@ TYPED_TEST(ApproxBoundsTest, Memory) {
   EXPECT_GE((*bounds_big)->MemoryUsed(), (*bounds_small)->MemoryUsed());
 }
 
+TYPED_TEST(ApproxBoundsTest, AddEntriesMatchesAddEntry) {
+  // Bin boundaries 0.7 * 3^i are not integers, which exercises the rounding of
+  // the boundaries for integral types.
+  typename ApproxBounds<TypeParam>::Builder builder;
+  builder.SetEpsilon(1).SetNumBins(10).SetScale(0.7).SetBase(3);
+  std::vector<TypeParam> inputs = {0, std::numeric_limits<TypeParam>::max(),
+                                   std::numeric_limits<TypeParam>::lowest(),
+                                   std::numeric_limits<TypeParam>::infinity(),
+                                   -std::numeric_limits<TypeParam>::infinity(),
+                                   std::numeric_limits<TypeParam>::quiet_NaN()};
+  for (double boundary = 0.7; boundary < 1e5; boundary *= 3) {
+    for (double offset : {-1.0, -1e-9, 0.0, 1e-9, 1.0}) {
+      inputs.push_back(static_cast<TypeParam>(boundary + offset));
+      inputs.push_back(static_cast<TypeParam>(-boundary - offset));
+    }
+  }
+  for (int i = -100; i <= 100; ++i) {
+    inputs.push_back(i);
+  }
+
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> batched =
+      builder.Build();
+  ASSERT_OK(batched);
+  absl::StatusOr<std::unique_ptr<ApproxBounds<TypeParam>>> sequential =
+      builder.Build();
+  ASSERT_OK(sequential);
+  (*batched)->AddEntries(inputs);
+  for (const TypeParam& input : inputs) {
+    (*sequential)->AddEntry(input);
+  }
+
+  EXPECT_THAT((*batched)->Serialize(),
+              EqualsProto((*sequential)->Serialize()));
+}
+
+TEST(ApproxBoundsTest, PowerOfTwoBinsForInt64) {
+  absl::StatusOr<std::unique_ptr<ApproxBounds<int64_t>>> bounds =
+      ApproxBounds<int64_t>::Builder().SetEpsilon(1).SetScale(4).Build();
+  ASSERT_OK(bounds);
+  EXPECT_EQ((*bounds)->MostSignificantBit(0), 0);
+  EXPECT_EQ((*bounds)->MostSignificantBit(4), 0);
+  EXPECT_EQ((*bounds)->MostSignificantBit(-5), 1);
+  for (int i = 3; i < 62; ++i) {
+    const int64_t power = int64_t{1} << i;
+    EXPECT_EQ((*bounds)->MostSignificantBit(power), i - 2);
+    EXPECT_EQ((*bounds)->MostSignificantBit(power + 1), i - 1);
+    EXPECT_EQ((*bounds)->MostSignificantBit(-power - 1), i - 1);
+  }
+  // Boundaries from 2^62 on are saturated at the numeric limit.
+  EXPECT_EQ((*bounds)->MostSignificantBit(std::numeric_limits<int64_t>::max()),
+            60);
+  EXPECT_EQ(
+      (*bounds)->MostSignificantBit(std::numeric_limits<int64_t>::lowest()),
+      60);
+}
+
+TEST(ApproxBoundsTest, PowerOfTwoBinsForDouble) {
+  absl::StatusOr<std::unique_ptr<ApproxBounds<double>>> bounds =
+      ApproxBounds<double>::Builder().SetEpsilon(1).Build();
+  ASSERT_OK(bounds);
+  // The default scale is the smallest positive normal double, 2^-1022.
+  EXPECT_EQ((*bounds)->MostSignificantBit(0), 0);
+  EXPECT_EQ((*bounds)->MostSignificantBit(
+                std::numeric_limits<double>::denorm_min()),
+            0);
+  for (int i = -1021; i < 1023; ++i) {
+    const double power = std::ldexp(1.0, i);
+    EXPECT_EQ((*bounds)->MostSignificantBit(power), i + 1022);
+    EXPECT_EQ((*bounds)->MostSignificantBit(std::nextafter(power, 0.0)),
+              i + 1022);
+    EXPECT_EQ((*bounds)->MostSignificantBit(-std::nextafter(power, 4.0 * power)),
+              i + 1023);
+  }
+  EXPECT_EQ(
+      (*bounds)->MostSignificantBit(std::numeric_limits<double>::infinity()),
+      (*bounds)->MostSignificantBit(std::numeric_limits<double>::max()));
+}
+
 TEST(ApproxBoundsTest, DefaultNumBinsForInt64Is64) {
   absl::StatusOr<std::unique_ptr<ApproxBounds<int64_t>>> bounds =
       ApproxBounds<int64_t>::Builder().SetEpsilon(1.1).SetScale(1.0).Build();
@@ -0,0 +1,100 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_BENCHMARK_FIXTURES_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_BENCHMARK_FIXTURES_H_
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "algorithms/algorithm.h"
+#include "algorithms/bounded-mean.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "algorithms/quantiles.h"
+
+namespace differential_privacy {
+namespace benchmark_fixtures {
+
+// Inputs and algorithms shared by the benchmarks. Every privacy unit
+// contributes one entry to a single partition, which is what the
+// cross-language workloads in benchmarks/README.md use.
+
+constexpr double kEpsilon = 1.0;
+constexpr double kLower = -100.0;
+constexpr double kUpper = 100.0;
+
+using AlgorithmFactory = std::unique_ptr<Algorithm<double>> (*)();
+
+// Returns num_entries normally distributed entries. Some of them fall outside
+// of [kLower, kUpper], so that clamping is part of the measured work.
+inline std::vector<double> MakeEntries(int64_t num_entries) {
+  std::mt19937_64 generator(42);
+  std::normal_distribution<double> distribution(0, kUpper / 2);
+  std::vector<double> entries(num_entries);
+  for (double& entry : entries) {
+    entry = distribution(generator);
+  }
+  return entries;
+}
+
+inline std::unique_ptr<Algorithm<double>> MakeCount() {
+  return Count<double>::Builder()
+      .SetEpsilon(kEpsilon)
+      .SetMaxPartitionsContributed(1)
+      .Build()
+      .value();
+}
+
+inline std::unique_ptr<Algorithm<double>> MakeBoundedSum() {
+  return BoundedSum<double>::Builder()
+      .SetEpsilon(kEpsilon)
+      .SetMaxPartitionsContributed(1)
+      .SetLower(kLower)
+      .SetUpper(kUpper)
+      .Build()
+      .value();
+}
+
+inline std::unique_ptr<Algorithm<double>> MakeBoundedMean() {
+  return BoundedMean<double>::Builder()
+      .SetEpsilon(kEpsilon)
+      .SetMaxPartitionsContributed(1)
+      .SetMaxContributionsPerPartition(1)
+      .SetLower(kLower)
+      .SetUpper(kUpper)
+      .Build()
+      .value();
+}
+
+inline std::unique_ptr<Algorithm<double>> MakeQuantiles() {
+  return Quantiles<double>::Builder()
+      .SetEpsilon(kEpsilon)
+      .SetMaxPartitionsContributed(1)
+      .SetMaxContributionsPerPartition(1)
+      .SetLower(kLower)
+      .SetUpper(kUpper)
+      .SetQuantiles({0.1, 0.5, 0.9})
+      .Build()
+      .value();
+}
+
+}  // namespace benchmark_fixtures
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_BENCHMARK_FIXTURES_H_
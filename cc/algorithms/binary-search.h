@@ -26,8 +26,10 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "algorithms/algorithm.h"
+#include "algorithms/internal/count-tree-percentile.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "proto/util.h"
+#include "base/instrumentation.h"
 #include "base/status_macros.h"
 
 // Differentially private binary search.
@@ -80,7 +82,7 @@ const double kProbabilityTooUncertain = .4;
 const double kProbabilityTooCertain = .49;
 
 // Distance from a singularity for which to use the value at the singularity.
-const double kSingularityTolerance = std::pow(10, -6);
+constexpr double kSingularityTolerance = 1e-6;
 
 template <typename T>
 class BinarySearch : public Algorithm<T> {
@@ -88,20 +90,33 @@ class BinarySearch : public Algorithm<T> {
   void AddEntry(const T& t) override {
     // REF:
     // https://stackoverflow.com/questions/61646166/how-to-resolve-fpclassify-ambiguous-call-to-overloaded-function
-    if (!std::isnan(static_cast<double>(t))) {
+    if (std::isnan(static_cast<double>(t))) {
+      return;
+    }
+    if (count_tree_) {
+      count_tree_->Add(t);
+    } else {
       quantiles_->Add(t);
     }
   }
 
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     BinarySearchSummary bs_summary;
-    quantiles_->SerializeToProto(bs_summary.mutable_input());
+    if (count_tree_) {
+      count_tree_->SerializeToProto(&bs_summary);
+    } else {
+      quantiles_->SerializeToProto(&bs_summary);
+    }
     Summary summary;
     summary.mutable_data()->PackFrom(bs_summary);
     return summary;
   }
 
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError(
           "Cannot merge summary with no binary search data.");
@@ -111,9 +126,15 @@ class BinarySearch : public Algorithm<T> {
       return absl::InternalError(
           "Binary search summary unable to be unpacked.");
     }
-    quantiles_->MergeFromProto(bs_summary.input());
-
-    return absl::OkStatus();
+    if (count_tree_) {
+      return count_tree_->MergeFromProto(bs_summary);
+    }
+    if (bs_summary.has_count_tree()) {
+      return absl::InvalidArgumentError(
+          "Cannot merge a count tree summary into a binary search that does "
+          "not count its inputs in a tree.");
+    }
+    return quantiles_->MergeFromProto(bs_summary);
   }
 
   int64_t MemoryUsed() override {
@@ -124,6 +145,9 @@ class BinarySearch : public Algorithm<T> {
     if (quantiles_) {
       memory += quantiles_->Memory();
     }
+    if (count_tree_) {
+      memory += count_tree_->Memory();
+    }
     return memory;
   }
 
@@ -132,7 +156,8 @@ class BinarySearch : public Algorithm<T> {
       double epsilon, T lower, T upper, int64_t max_partitions_contributed,
       int64_t max_contributions_per_partition, double quantile,
       std::unique_ptr<LaplaceMechanism::Builder> mechanism_builder,
-      std::unique_ptr<base::Percentile<T>> input_sketch)
+      std::unique_ptr<base::Percentile<T>> input_sketch,
+      std::unique_ptr<internal::CountTreePercentile<T>> count_tree = nullptr)
       : Algorithm<T>(epsilon),
         quantile_(quantile),
         upper_(upper),
@@ -140,13 +165,20 @@ class BinarySearch : public Algorithm<T> {
         max_partitions_contributed_(max_partitions_contributed),
         max_contributions_per_partition_(max_contributions_per_partition),
         mechanism_builder_(std::move(mechanism_builder)),
-        quantiles_(std::move(input_sketch)) {
+        quantiles_(std::move(input_sketch)),
+        count_tree_(std::move(count_tree)) {
     // TODO: Replace with Builder class & parameter validation
     DCHECK_GE(quantile, 0);
     DCHECK_LE(quantile, 1);
   }
 
-  void ResetState() override { quantiles_->Reset(); }
+  void ResetState() override {
+    if (count_tree_) {
+      count_tree_->Reset();
+    } else {
+      quantiles_->Reset();
+    }
+  }
 
   absl::StatusOr<Output> GenerateResult(double noise_interval_level) override {
     return BayesianSearch(noise_interval_level);
@@ -183,6 +215,10 @@ class BinarySearch : public Algorithm<T> {
     weight[lower_] = .5;
     weight[m] = .5;
 
+    // The probes converge to the result, so every rank query starts searching
+    // from where the previous one ended.
+    typename base::Percentile<T>::RankCursor cursor;
+
     // Keep doing search iterations while we have enough budget left.
     int iterations = 0;
     while (remaining_budget - local_budget > 0 &&
@@ -206,11 +242,11 @@ class BinarySearch : public Algorithm<T> {
 
       // Find noisy counts for number of values above and below m. A single
       // input only contributes to one of the two counts.
-      ASSIGN_OR_RETURN(const double percentile, Percentile(m));
+      ASSIGN_OR_RETURN(const double percentile, Percentile(m, &cursor));
       double noisy_less =
-          mechanism->AddNoise(percentile * quantiles_->num_values());
+          mechanism->AddNoise(percentile * NumValues());
       double noisy_more =
-          mechanism->AddNoise((1 - percentile) * quantiles_->num_values());
+          mechanism->AddNoise((1 - percentile) * NumValues());
 
       double noised_size = noisy_less + noisy_more;
       // For extreme percentiles, we want to push the result toward the range of
@@ -370,15 +406,17 @@ class BinarySearch : public Algorithm<T> {
     }
   }
 
-  absl::StatusOr<double> Percentile(double m) {
+  absl::StatusOr<double> Percentile(
+      double m, typename base::Percentile<T>::RankCursor* cursor) {
     // If there are no inputs, getting the relative rank will return an error.
     // Arbitrarilty say the percentile is 1/2.
-    if (quantiles_->num_values() == 0) {
+    if (NumValues() == 0) {
       return .5;
     }
 
     std::pair<double, double> percent_pair;
-    percent_pair = quantiles_->GetRelativeRank(m);
+    percent_pair = count_tree_ ? count_tree_->GetRelativeRank(m)
+                               : quantiles_->GetRelativeRank(m, cursor);
 
     // If T is integral, then m is a double between two integers. Take the upper
     // percentile of the nearest lesser integer.
@@ -441,7 +479,15 @@ class BinarySearch : public Algorithm<T> {
   int64_t max_partitions_contributed_;
 
   std::unique_ptr<LaplaceMechanism::Builder> mechanism_builder_;
+  // Holds the inputs, unless they are counted in count_tree_.
   std::unique_ptr<base::Percentile<T>> quantiles_;
+  // Counts the inputs in a tree of buckets, if set.
+  std::unique_ptr<internal::CountTreePercentile<T>> count_tree_;
+
+ private:
+  int64_t NumValues() const {
+    return count_tree_ ? count_tree_->num_values() : quantiles_->num_values();
+  }
 };
 }  // namespace differential_privacy
 
@@ -0,0 +1,31 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "algorithms/bounded-mean.h"
+
+#include <cstdint>
+
+namespace differential_privacy {
+
+template class BoundedMean<int64_t>;
+template class BoundedMean<double>;
+template class BoundedMeanWithFixedBounds<int64_t>;
+template class BoundedMeanWithFixedBounds<double>;
+template class BoundedMeanWithApproxBounds<int64_t>;
+template class BoundedMeanWithApproxBounds<double>;
+
+}  // namespace differential_privacy
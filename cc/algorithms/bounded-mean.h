@@ -23,6 +23,7 @@
 #include <cmath>
 #include <cstdint>
 #include <memory>
+#include <memory_resource>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -34,15 +35,19 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "algorithms/algorithm.h"
 #include "algorithms/approx-bounds.h"
 #include "algorithms/internal/bounded-mean-ci.h"
+#include "algorithms/internal/clamped-sum.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "algorithms/util.h"
 #include "proto/util.h"
 #include "proto/confidence-interval.pb.h"
 #include "proto/data.pb.h"
 #include "proto/summary.pb.h"
+#include "base/instrumentation.h"
+#include "base/tracking_memory_resource.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
@@ -126,7 +131,36 @@ class BoundedMeanWithFixedBounds : public BoundedMean<T> {
 
   void AddEntry(const T& input) override { AddMultipleEntries(input, 1); }
 
+  using BoundedMean<T>::AddEntries;
+
+  // Same as AddEntry for every entry, without per-entry validation. Entries
+  // of double, float and int64_t are clamped and summed with the vectorized
+  // internal::ClampedSum.
+  void AddEntries(absl::Span<const T> entries) override {
+    if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+      // Normalized as in AddMultipleEntries.
+      const internal::ClampedSumResult result =
+          internal::ClampedSum(entries, lower_, upper_, GetMidPoint());
+      partial_sum_ += result.sum;
+      partial_count_ += result.count;
+    } else if constexpr (std::is_same_v<T, int64_t>) {
+      partial_sum_ += internal::ClampedSum(entries, lower_, upper_);
+      partial_count_ += entries.size();
+    } else if constexpr (std::is_integral_v<T>) {
+      T sum = partial_sum_;
+      for (const T& entry : entries) {
+        sum += Clamp<T>(lower_, upper_, entry);
+      }
+      partial_sum_ = sum;
+      partial_count_ += entries.size();
+    } else {
+      Algorithm<T>::AddEntries(entries);
+    }
+  }
+
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     BoundedMeanSummary mean_summary;
     mean_summary.set_count(partial_count_);
     SetValue(mean_summary.add_pos_sum(), partial_sum_);
@@ -137,6 +171,8 @@ class BoundedMeanWithFixedBounds : public BoundedMean<T> {
   }
 
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError(
           "Cannot merge summary with no bounded mean data.");
@@ -159,11 +195,27 @@ class BoundedMeanWithFixedBounds : public BoundedMean<T> {
     return absl::OkStatus();
   }
 
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_mean =
+        dynamic_cast<const BoundedMeanWithFixedBounds<T>*>(&other);
+    if (other_mean == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    partial_sum_ += other_mean->partial_sum_;
+    partial_count_ += other_mean->partial_count_;
+    return absl::OkStatus();
+  }
+
   int64_t MemoryUsed() override {
     return sizeof(BoundedMeanWithFixedBounds) + sum_mechanism_->MemoryUsed() +
            count_mechanism_->MemoryUsed();
   }
 
+  T lower() const { return lower_; }
+  T upper() const { return upper_; }
+
   absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
       double confidence_level) override {
     return NoiseConfidenceInterval(confidence_level, 0, 0);
@@ -221,6 +273,19 @@ class BoundedMeanWithFixedBounds : public BoundedMean<T> {
     return output;
   }
 
+  absl::StatusOr<ScalarResult> GenerateScalarResult(
+      double noise_interval_level) override {
+    const BoundedMeanResult mean = GenerateBoundedMeanResult();
+    absl::StatusOr<ConfidenceInterval> ci = NoiseConfidenceInterval(
+        noise_interval_level, mean.noised_sum, mean.noised_count);
+    ScalarResult result;
+    result.value = Clamp<double>(lower_, upper_, mean.noised_mean);
+    if (ci.ok()) {
+      result.noise_confidence_interval = *std::move(ci);
+    }
+    return result;
+  }
+
   void ResetState() override {
     partial_sum_ = 0;
     partial_count_ = 0;
@@ -264,8 +329,13 @@ class BoundedMeanWithApproxBounds : public BoundedMean<T> {
       const double max_contributions_per_partition,
       std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
       std::unique_ptr<NumericalMechanism> count_mechanism,
-      std::unique_ptr<ApproxBounds<T>> approx_bounds)
+      std::unique_ptr<ApproxBounds<T>> approx_bounds,
+      std::pmr::memory_resource* memory_resource =
+          std::pmr::get_default_resource())
       : BoundedMean<T>(epsilon, delta),
+        memory_(memory_resource),
+        pos_sum_(&memory_),
+        neg_sum_(&memory_),
         epsilon_for_sum_(epsilon_for_sum),
         delta_for_sum_(delta_for_sum),
         count_mechanism_(std::move(count_mechanism)),
@@ -281,7 +351,18 @@ class BoundedMeanWithApproxBounds : public BoundedMean<T> {
 
   void AddEntry(const T& input) override { AddMultipleEntries(input, 1); }
 
+  using BoundedMean<T>::AddEntries;
+
+  // Fills the histogram of the ApproxBounds and the partial sums in a single
+  // pass over the entries, see ApproxBounds::AddEntriesWithPartialSums.
+  void AddEntries(absl::Span<const T> entries) override {
+    partial_count_ += approx_bounds_->AddEntriesWithPartialSums(
+        entries, &pos_sum_, &neg_sum_);
+  }
+
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     // Create BoundedMeanSummary.
     BoundedMeanSummary bm_summary;
     bm_summary.set_count(partial_count_);
@@ -303,6 +384,8 @@ class BoundedMeanWithApproxBounds : public BoundedMean<T> {
   }
 
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError(
           "Cannot merge summary with no bounded mean data.");
@@ -337,9 +420,36 @@ class BoundedMeanWithApproxBounds : public BoundedMean<T> {
     return absl::OkStatus();
   }
 
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_mean =
+        dynamic_cast<const BoundedMeanWithApproxBounds<T>*>(&other);
+    if (other_mean == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    if (pos_sum_.size() != other_mean->pos_sum_.size() ||
+        neg_sum_.size() != other_mean->neg_sum_.size()) {
+      return absl::InternalError(
+          "Merged BoundedMeans must have equal number of partial sums.");
+    }
+
+    // Merging the approx bounds is the first operation that modifies the
+    // internal state.
+    RETURN_IF_ERROR(approx_bounds_->MergeFrom(*other_mean->approx_bounds_));
+    partial_count_ += other_mean->partial_count_;
+    for (int i = 0; i < pos_sum_.size(); ++i) {
+      pos_sum_[i] += other_mean->pos_sum_[i];
+    }
+    for (int i = 0; i < neg_sum_.size(); ++i) {
+      neg_sum_[i] += other_mean->neg_sum_[i];
+    }
+    return absl::OkStatus();
+  }
+
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(BoundedMean<T>);
-    memory += sizeof(T) * (pos_sum_.capacity() + neg_sum_.capacity());
+    int64_t memory =
+        sizeof(BoundedMeanWithApproxBounds<T>) + memory_.bytes_allocated();
     memory += approx_bounds_->MemoryUsed();
     memory += sizeof(*mechanism_builder_);
     return memory;
@@ -442,8 +552,11 @@ class BoundedMeanWithApproxBounds : public BoundedMean<T> {
   }
 
  private:
+  // Tracks the allocations of the vectors below for MemoryUsed.
+  base::TrackingMemoryResource memory_;
+
   // Vectors of partial values stored for automatic clamping.
-  std::vector<T> pos_sum_, neg_sum_;
+  std::pmr::vector<T> pos_sum_, neg_sum_;
 
   // Raw count of the number of entries added.
   int64_t partial_count_ = 0;
@@ -512,6 +625,15 @@ class BoundedMean<T>::Builder {
     return *this;
   }
 
+  // Allocates the buffers used for automatic bounding from `memory_resource`,
+  // which must outlive the built algorithm. See
+  // BoundedSum<T>::Builder::SetMemoryResource.
+  BoundedMean<T>::Builder& SetMemoryResource(
+      std::pmr::memory_resource* memory_resource) {
+    memory_resource_ = memory_resource;
+    return *this;
+  }
+
   absl::StatusOr<std::unique_ptr<BoundedMean<T>>> Build() {
     if (!epsilon_.has_value()) {
       epsilon_ = DefaultEpsilon();
@@ -542,6 +664,8 @@ class BoundedMean<T>::Builder {
   std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
       absl::make_unique<LaplaceMechanism::Builder>();
   std::unique_ptr<ApproxBounds<T>> approx_bounds_;
+  std::pmr::memory_resource* memory_resource_ =
+      std::pmr::get_default_resource();
 
   absl::StatusOr<std::unique_ptr<BoundedMean<T>>> BuildMeanWithFixedBounds() {
     RETURN_IF_ERROR(
@@ -575,6 +699,7 @@ class BoundedMean<T>::Builder {
               .SetLaplaceMechanism(mechanism_builder_->Clone())
               .SetMaxContributionsPerPartition(max_contributions_per_partition_)
               .SetMaxPartitionsContributed(max_partitions_contributed_)
+              .SetMemoryResource(memory_resource_)
               .Build());
     }
 
@@ -608,10 +733,19 @@ class BoundedMean<T>::Builder {
             epsilon_.value(), delta_, epsilon_for_sum, delta_for_sum,
             max_partitions_contributed_, max_contributions_per_partition_,
             mechanism_builder_->Clone(), std::move(count_mechanism),
-            std::move(approx_bounds_)));
+            std::move(approx_bounds_), memory_resource_));
   }
 };
 
+// Instantiated once in bounded-mean.cc for the most common entry types,
+// instead of in every translation unit that uses them.
+extern template class BoundedMean<int64_t>;
+extern template class BoundedMean<double>;
+extern template class BoundedMeanWithFixedBounds<int64_t>;
+extern template class BoundedMeanWithFixedBounds<double>;
+extern template class BoundedMeanWithApproxBounds<int64_t>;
+extern template class BoundedMeanWithApproxBounds<double>;
+
 }  // namespace differential_privacy
 
 #endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_BOUNDED_MEAN_H_
@@ -23,8 +23,10 @@
 #include <functional>
 #include <limits>
 #include <memory>
+#include <memory_resource>
 #include <string>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "base/testing/proto_matchers.h"
@@ -34,6 +36,7 @@
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "algorithms/approx-bounds.h"
 #include "algorithms/numerical-mechanisms-testing.h"
 #include "algorithms/numerical-mechanisms.h"
@@ -308,6 +311,74 @@ TYPED_TEST(BoundedMeanTest, LowClampTest) {
   }
 }
 
+TYPED_TEST(BoundedMeanTest, AddEntriesMatchesAddEntryWithFixedBounds) {
+  typename BoundedMean<TypeParam>::Builder builder;
+  builder.SetEpsilon(kSmallEpsilon)
+      .SetLower(-10)
+      .SetUpper(100)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<BoundedMean<TypeParam>>> batched =
+      builder.Build();
+  ASSERT_OK(batched);
+  absl::StatusOr<std::unique_ptr<BoundedMean<TypeParam>>> sequential =
+      builder.Build();
+  ASSERT_OK(sequential);
+  std::vector<TypeParam> inputs;
+  for (int i = -20; i <= 20; ++i) {
+    inputs.push_back(static_cast<TypeParam>(i * i * i) / 3);
+  }
+
+  (*batched)->AddEntries(absl::MakeConstSpan(inputs));
+  for (const TypeParam& input : inputs) {
+    (*sequential)->AddEntry(input);
+  }
+
+  absl::StatusOr<Output> batched_result = (*batched)->PartialResult();
+  ASSERT_OK(batched_result);
+  absl::StatusOr<Output> sequential_result = (*sequential)->PartialResult();
+  ASSERT_OK(sequential_result);
+  // Floating point sums are vectorized and may differ by rounding.
+  EXPECT_NEAR(GetValue<double>(*batched_result),
+              GetValue<double>(*sequential_result), 1e-9);
+}
+
+template <typename T>
+std::unique_ptr<BoundedMean<T>> CreateMeanWithApproxBounds() {
+  std::unique_ptr<ApproxBounds<T>> bounds =
+      typename ApproxBounds<T>::Builder()
+          .SetThresholdForTest(0.5)
+          .SetNumBins(10)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetEpsilon(kDefaultEpsilon / 2)
+          .Build()
+          .value();
+  return typename BoundedMean<T>::Builder()
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .SetApproxBounds(std::move(bounds))
+      .SetEpsilon(kDefaultEpsilon)
+      .Build()
+      .value();
+}
+
+TYPED_TEST(BoundedMeanTest, AddEntriesMatchesAddEntryWithApproxBounds) {
+  std::unique_ptr<BoundedMean<TypeParam>> batched =
+      CreateMeanWithApproxBounds<TypeParam>();
+  std::unique_ptr<BoundedMean<TypeParam>> sequential =
+      CreateMeanWithApproxBounds<TypeParam>();
+  std::vector<TypeParam> inputs = {0, 1, -1, 7, -7, 5000, -5000, 64};
+  for (int i = -30; i <= 30; ++i) {
+    inputs.push_back(i * i * i);
+  }
+
+  batched->AddEntries(absl::MakeConstSpan(inputs));
+  for (const TypeParam& input : inputs) {
+    sequential->AddEntry(input);
+  }
+
+  // All partial sums are integral and exact, so the summaries are equal.
+  EXPECT_THAT(batched->Serialize(), EqualsProto(sequential->Serialize()));
+}
+
 TYPED_TEST(BoundedMeanTest, HighClampTest) {
   std::vector<TypeParam> a = {10, 10, 10, 10};
 
@@ -695,6 +766,31 @@ TYPED_TEST(BoundedMeanTest, SerializeMergePartialSumsTest) {
   EXPECT_DOUBLE_EQ(GetValue<double>(*result1), GetValue<double>(*result2));
 }
 
+TYPED_TEST(BoundedMeanTest, MergeFromMatchesMerge) {
+  for (const bool automatic_bounds : {false, true}) {
+    typename BoundedMean<TypeParam>::Builder builder;
+    builder.SetEpsilon(kDefaultEpsilon);
+    if (!automatic_bounds) {
+      builder.SetLower(-5).SetUpper(5);
+    }
+    auto bm1 = builder.Build();
+    ASSERT_OK(bm1);
+    auto bm2 = builder.Build();
+    ASSERT_OK(bm2);
+    auto bm3 = builder.Build();
+    ASSERT_OK(bm3);
+    for (TypeParam entry : {-10, -1, 0, 3, 20}) {
+      (*bm1)->AddEntry(entry);
+    }
+    (*bm2)->AddEntry(4);
+    (*bm3)->AddEntry(4);
+
+    EXPECT_OK((*bm2)->MergeFrom(**bm1));
+    EXPECT_OK((*bm3)->Merge((*bm1)->Serialize()));
+    EXPECT_THAT((*bm2)->Serialize(), EqualsProto((*bm3)->Serialize()));
+  }
+}
+
 TYPED_TEST(BoundedMeanTest, AutomaticBoundsNegative) {
   std::vector<TypeParam> a = {9, -2, -2, -1, -6, -6};
   auto bounds =
@@ -786,6 +882,39 @@ TEST(BoundedMeanTest, DropNanEntries) {
   EXPECT_LE(GetValue<double>(*result), 9);
 }
 
+TEST(BoundedMeanTest, AllocatesBuffersFromMemoryResource) {
+  // All buffers come from this block; the null upstream rejects any
+  // allocation that would not fit.
+  char buffer[4096];
+  std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer),
+                                               std::pmr::null_memory_resource());
+  auto bounds =
+      ApproxBounds<double>::Builder()
+          .SetEpsilon(0.5)
+          .SetNumBins(4)
+          .SetBase(2)
+          .SetScale(1)
+          .SetThresholdForTest(0.5)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetMemoryResource(&resource)
+          .Build();
+  ASSERT_OK(bounds);
+  auto bm =
+      BoundedMean<double>::Builder()
+          .SetEpsilon(1)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetApproxBounds(std::move(bounds).value())
+          .SetMemoryResource(&resource)
+          .Build();
+  ASSERT_OK(bm);
+
+  // Bounds are set to [-1, 2].
+  std::vector<double> a = {1, -1, 2};
+  absl::StatusOr<Output> result = (*bm)->Result(a.begin(), a.end());
+  ASSERT_OK(result);
+  EXPECT_NEAR(GetValue<double>(*result), 2.0 / 3, 1e-10);
+}
+
 TEST(BoundedMeanTest, SensitivityOverflow) {
   // Check for error when upper - lower causes integer overflow.
   EXPECT_EQ(BoundedMean<int>::Builder()
@@ -1274,5 +1403,22 @@ TEST(BoundedMeanTest, ApproxBoundsMeanOutputHasConfidenceInterval) {
                      Le(upper_bound))));
 }
 
+TYPED_TEST(BoundedMeanTest, PartialScalarResult) {
+  std::vector<TypeParam> a = {2, 4, 6, 8, 20};
+  std::unique_ptr<BoundedMean<TypeParam>> mean =
+      typename BoundedMean<TypeParam>::Builder()
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetEpsilon(1.0)
+          .SetLower(1)
+          .SetUpper(9)
+          .Build()
+          .value();
+  mean->AddEntries(a.begin(), a.end());
+
+  absl::StatusOr<ScalarResult> result = mean->PartialScalarResult();
+  ASSERT_OK(result);
+  EXPECT_DOUBLE_EQ(std::get<double>(result->value), 29.0 / 5);
+}
+
 }  //  namespace
 }  // namespace differential_privacy
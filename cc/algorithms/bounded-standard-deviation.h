@@ -26,6 +26,7 @@
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "algorithms/algorithm.h"
 #include "algorithms/approx-bounds.h"
 #include "algorithms/bounded-algorithm.h"
@@ -35,6 +36,7 @@
 #include "proto/util.h"
 #include "proto/data.pb.h"
 #include "proto/summary.pb.h"
+#include "base/instrumentation.h"
 #include "base/status_macros.h"
 
 // Bounded Stddev is deprecated in favor of using variance and taking the sqrt
@@ -66,11 +68,23 @@ class ABSL_DEPRECATED(
 
   void AddEntry(const T& t) override { variance_->AddEntry(t); }
 
+  using Algorithm<T>::AddEntries;
+
+  void AddEntries(absl::Span<const T> entries) override {
+    variance_->AddEntries(entries);
+  }
+
   // Returns a BoundedVarianceSummary.
-  Summary Serialize() const override { return variance_->Serialize(); }
+  Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
+    return variance_->Serialize();
+  }
 
   // Merges from BoundedVarianceSummary.
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     return variance_->Merge(summary);
   }
 
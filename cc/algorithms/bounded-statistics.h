@@ -0,0 +1,487 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_BOUNDED_STATISTICS_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_BOUNDED_STATISTICS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/approx-bounds.h"
+#include "algorithms/bounded-variance.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/util.h"
+#include "proto/util.h"
+#include "proto/data.pb.h"
+#include "proto/summary.pb.h"
+#include "base/instrumentation.h"
+#include "base/tracking_memory_resource.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Computes the sum, mean and variance of the same input with automatically
+// determined bounds. Using BoundedSum, BoundedMean and BoundedVariance
+// separately runs one ApproxBounds per algorithm, so every input is binned
+// three times and the bounding epsilon is spent three times. BoundedStatistics
+// runs a single ApproxBounds and computes the bin index of each input once for
+// the histogram and for all partial values.
+//
+// The privacy budget is split explicitly:
+//   - ApproxBounds uses its own epsilon, which defaults to half the total
+//     epsilon.
+//   - The remaining epsilon and the delta are split equally between the noisy
+//     count, the noisy normalized sum and the noisy normalized sum of squares,
+//     the same quantities that BoundedVariance noises.
+// Sum, mean and variance are all post-processed from these noisy values, so
+// releasing them together costs no more than the total epsilon. The sum is
+// derived as the noisy normalized sum plus the noisy count times the midpoint
+// of the bounds, so its noise grows with the distance of the bounds from 0.
+//
+// The output has three elements, at kSumIndex, kMeanIndex and kVarianceIndex.
+// The summary has the same format as that of BoundedVariance with approximate
+// bounds.
+template <typename T>
+class BoundedStatistics : public Algorithm<T> {
+  static_assert(std::is_arithmetic<T>::value,
+                "BoundedStatistics can only be used for arithmetic types");
+
+ public:
+  // Builder for BoundedStatistics algorithm.
+  class Builder;
+
+  static constexpr int kSumIndex = 0;
+  static constexpr int kMeanIndex = 1;
+  static constexpr int kVarianceIndex = 2;
+
+  void AddEntry(const T& t) override { AddMultipleEntries(t, 1); }
+
+  Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
+    BoundedVarianceSummary bv_summary;
+    bv_summary.set_count(partial_count_);
+    for (T x : pos_sum_) {
+      SetValue(bv_summary.add_pos_sum(), x);
+    }
+    for (T x : neg_sum_) {
+      SetValue(bv_summary.add_neg_sum(), x);
+    }
+    for (double x : pos_sum_of_squares_) {
+      bv_summary.add_pos_sum_of_squares(x);
+    }
+    for (double x : neg_sum_of_squares_) {
+      bv_summary.add_neg_sum_of_squares(x);
+    }
+    Summary approx_bounds_summary = approx_bounds_->Serialize();
+    approx_bounds_summary.data().UnpackTo(bv_summary.mutable_bounds_summary());
+
+    Summary summary;
+    summary.mutable_data()->PackFrom(bv_summary);
+    return summary;
+  }
+
+  absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    if (!summary.has_data()) {
+      return absl::InternalError(
+          "Cannot merge summary with no bounded statistics data.");
+    }
+    BoundedVarianceSummary bv_summary;
+    if (!summary.data().UnpackTo(&bv_summary)) {
+      return absl::InternalError(
+          "Bounded statistics summary unable to be unpacked.");
+    }
+    if (!bv_summary.has_bounds_summary()) {
+      return absl::InternalError(
+          "Merged BoundedStatistics must use approximate bounds.");
+    }
+    if (pos_sum_.size() != bv_summary.pos_sum_size() ||
+        neg_sum_.size() != bv_summary.neg_sum_size() ||
+        pos_sum_of_squares_.size() != bv_summary.pos_sum_of_squares_size() ||
+        neg_sum_of_squares_.size() != bv_summary.neg_sum_of_squares_size()) {
+      return absl::InternalError(
+          "Merged BoundedStatistics must have the same amount of partial "
+          "sum or sum of squares values as this BoundedStatistics.");
+    }
+
+    Summary approx_bounds_summary;
+    approx_bounds_summary.mutable_data()->PackFrom(bv_summary.bounds_summary());
+    RETURN_IF_ERROR(approx_bounds_->Merge(approx_bounds_summary));
+
+    partial_count_ += bv_summary.count();
+    for (int i = 0; i < pos_sum_.size(); ++i) {
+      pos_sum_[i] += GetValue<T>(bv_summary.pos_sum(i));
+      pos_sum_of_squares_[i] += bv_summary.pos_sum_of_squares(i);
+    }
+    for (int i = 0; i < neg_sum_.size(); ++i) {
+      neg_sum_[i] += GetValue<T>(bv_summary.neg_sum(i));
+      neg_sum_of_squares_[i] += bv_summary.neg_sum_of_squares(i);
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_statistics =
+        dynamic_cast<const BoundedStatistics<T>*>(&other);
+    if (other_statistics == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    if (pos_sum_.size() != other_statistics->pos_sum_.size() ||
+        neg_sum_.size() != other_statistics->neg_sum_.size()) {
+      return absl::InternalError(
+          "Merged BoundedStatistics must have the same amount of partial "
+          "sum or sum of squares values as this BoundedStatistics.");
+    }
+
+    RETURN_IF_ERROR(
+        approx_bounds_->MergeFrom(*other_statistics->approx_bounds_));
+    partial_count_ += other_statistics->partial_count_;
+    for (int i = 0; i < pos_sum_.size(); ++i) {
+      pos_sum_[i] += other_statistics->pos_sum_[i];
+      pos_sum_of_squares_[i] += other_statistics->pos_sum_of_squares_[i];
+    }
+    for (int i = 0; i < neg_sum_.size(); ++i) {
+      neg_sum_[i] += other_statistics->neg_sum_[i];
+      neg_sum_of_squares_[i] += other_statistics->neg_sum_of_squares_[i];
+    }
+    return absl::OkStatus();
+  }
+
+  int64_t MemoryUsed() override {
+    int64_t memory = sizeof(BoundedStatistics<T>) + memory_.bytes_allocated();
+    memory += sizeof(*mechanism_builder_);
+    memory += count_mechanism_->MemoryUsed();
+    memory += approx_bounds_->MemoryUsed();
+    return memory;
+  }
+
+  // Returns the epsilon used to calculate approximate bounds.
+  double GetBoundingEpsilon() const { return approx_bounds_->GetEpsilon(); }
+
+  // Returns the epsilon shared by the noisy count, sum and sum of squares.
+  double GetAggregationEpsilon() const {
+    return Algorithm<T>::GetEpsilon() - GetBoundingEpsilon();
+  }
+
+ protected:
+  BoundedStatistics(double epsilon, double delta, double epsilon_for_sum,
+                    double delta_for_sum, double epsilon_for_squares,
+                    double delta_for_squares, int l0_sensitivity,
+                    int max_contributions_per_partition,
+                    std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
+                    std::unique_ptr<NumericalMechanism> count_mechanism,
+                    std::unique_ptr<ApproxBounds<T>> approx_bounds,
+                    std::pmr::memory_resource* memory_resource)
+      : Algorithm<T>(epsilon, delta),
+        memory_(memory_resource),
+        pos_sum_(approx_bounds->NumPositiveBins(), 0, &memory_),
+        neg_sum_(approx_bounds->NumPositiveBins(), 0, &memory_),
+        pos_sum_of_squares_(approx_bounds->NumPositiveBins(), 0, &memory_),
+        neg_sum_of_squares_(approx_bounds->NumPositiveBins(), 0, &memory_),
+        epsilon_for_sum_(epsilon_for_sum),
+        delta_for_sum_(delta_for_sum),
+        epsilon_for_squares_(epsilon_for_squares),
+        delta_for_squares_(delta_for_squares),
+        l0_sensitivity_(l0_sensitivity),
+        max_contributions_per_partition_(max_contributions_per_partition),
+        mechanism_builder_(std::move(mechanism_builder)),
+        count_mechanism_(std::move(count_mechanism)),
+        approx_bounds_(std::move(approx_bounds)) {}
+
+  absl::StatusOr<Output> GenerateResult(double noise_interval_level) override {
+    ASSIGN_OR_RETURN(Output bounds,
+                     approx_bounds_->PartialResult(noise_interval_level));
+    const T lower = GetValue<T>(bounds.elements(0).value());
+    const T upper = GetValue<T>(bounds.elements(1).value());
+    RETURN_IF_ERROR(BoundedVariance<T>::CheckBounds(lower, upper));
+
+    ASSIGN_OR_RETURN(const double sum,
+                     approx_bounds_->template ComputeFromPartials<T>(
+                         pos_sum_, neg_sum_, [](T x) { return x; }, lower,
+                         upper, partial_count_));
+    ASSIGN_OR_RETURN(
+        const double sum_of_squares,
+        approx_bounds_->template ComputeFromPartials<double>(
+            pos_sum_of_squares_, neg_sum_of_squares_, [](T x) { return x * x; },
+            lower, upper, partial_count_));
+
+    const double noised_count = count_mechanism_->AddNoise(partial_count_);
+
+    const double sum_midpoint = lower + ((upper - lower) / 2);
+    std::unique_ptr<NumericalMechanismBuilder> sum_builder =
+        mechanism_builder_->Clone();
+    sum_builder->SetDelta(delta_for_sum_);
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> sum_mechanism,
+                     BoundedVariance<T>::BuildSumMechanism(
+                         std::move(sum_builder), epsilon_for_sum_,
+                         l0_sensitivity_, max_contributions_per_partition_,
+                         lower, upper));
+    const double noised_normalized_sum =
+        sum_mechanism->AddNoise(sum - (partial_count_ * sum_midpoint));
+
+    const double sum_of_squares_midpoint =
+        BoundedVariance<T>::MidpointOfSquares(lower, upper);
+    std::unique_ptr<NumericalMechanismBuilder> sum_of_squares_builder =
+        mechanism_builder_->Clone();
+    sum_of_squares_builder->SetDelta(delta_for_squares_);
+    ASSIGN_OR_RETURN(
+        std::unique_ptr<NumericalMechanism> sum_of_squares_mechanism,
+        BoundedVariance<T>::BuildSumOfSquaresMechanism(
+            std::move(sum_of_squares_builder), epsilon_for_squares_,
+            l0_sensitivity_, max_contributions_per_partition_, lower, upper));
+    const double noised_normalized_sum_of_squares =
+        sum_of_squares_mechanism->AddNoise(
+            sum_of_squares - (partial_count_ * sum_of_squares_midpoint));
+
+    // From this point everything is post-processing of the noised values.
+    const double noised_sum =
+        noised_normalized_sum + std::max(0.0, noised_count) * sum_midpoint;
+    double mean = sum_midpoint;
+    double mean_of_square = sum_of_squares_midpoint;
+    if (noised_count > 1) {
+      mean = noised_normalized_sum / noised_count + sum_midpoint;
+      mean_of_square = noised_normalized_sum_of_squares / noised_count +
+                       sum_of_squares_midpoint;
+    }
+    const double variance = mean_of_square - std::pow(mean, 2);
+
+    Output output;
+    if (std::is_integral<T>::value) {
+      AddToOutput<T>(&output,
+                     SafeCastFromDouble<T>(std::round(noised_sum)).value);
+    } else {
+      AddToOutput<T>(&output, noised_sum);
+    }
+    AddToOutput<double>(&output, Clamp<double>(lower, upper, mean));
+    AddToOutput<double>(
+        &output,
+        Clamp<double>(
+            0.0, BoundedVariance<T>::IntervalLengthSquared(lower, upper) / 4,
+            variance));
+    *(output.mutable_error_report()->mutable_bounding_report()) =
+        approx_bounds_->GetBoundingReport(lower, upper);
+    return output;
+  }
+
+  void ResetState() override {
+    std::fill(pos_sum_.begin(), pos_sum_.end(), 0);
+    std::fill(neg_sum_.begin(), neg_sum_.end(), 0);
+    std::fill(pos_sum_of_squares_.begin(), pos_sum_of_squares_.end(), 0);
+    std::fill(neg_sum_of_squares_.begin(), neg_sum_of_squares_.end(), 0);
+    partial_count_ = 0;
+    approx_bounds_->Reset();
+  }
+
+ private:
+  void AddMultipleEntries(const T& input, int64_t num_of_entries) {
+    // REF:
+    // https://stackoverflow.com/questions/61646166/how-to-resolve-fpclassify-ambiguous-call-to-overloaded-function
+    absl::Status status =
+        ValidateIsPositive(num_of_entries, "Number of entries");
+    if (std::isnan(static_cast<double>(input)) || !status.ok()) {
+      return;
+    }
+
+    partial_count_ += num_of_entries;
+
+    // The same bin index is used for the histogram and all partials.
+    const int bin_index = approx_bounds_->MostSignificantBit(input);
+    approx_bounds_->AddMultipleEntriesToBin(input, bin_index, num_of_entries);
+
+    auto difference = [](T val1, T val2) { return val1 - val2; };
+    auto difference_of_squares = [](T val1, T val2) {
+      // Lessen the chance of becoming inf/-inf by calculating it like this.
+      return (static_cast<double>(val1) + val2) *
+             (static_cast<double>(val1) - val2);
+    };
+    if (input >= 0) {
+      approx_bounds_->template AddMultipleEntriesToPartialsOfBin<T>(
+          &pos_sum_, input, bin_index, num_of_entries, difference);
+      approx_bounds_->template AddMultipleEntriesToPartialsOfBin<double>(
+          &pos_sum_of_squares_, input, bin_index, num_of_entries,
+          difference_of_squares);
+    } else {
+      approx_bounds_->template AddMultipleEntriesToPartialsOfBin<T>(
+          &neg_sum_, input, bin_index, num_of_entries, difference);
+      approx_bounds_->template AddMultipleEntriesToPartialsOfBin<double>(
+          &neg_sum_of_squares_, input, bin_index, num_of_entries,
+          difference_of_squares);
+    }
+  }
+
+  // Tracks the allocations of the vectors below for MemoryUsed.
+  base::TrackingMemoryResource memory_;
+
+  // Vectors of partial values stored for automatic clamping.
+  std::pmr::vector<T> pos_sum_, neg_sum_;
+  std::pmr::vector<double> pos_sum_of_squares_, neg_sum_of_squares_;
+  int64_t partial_count_ = 0;
+
+  // Used to construct the sum mechanisms once bounds are obtained.
+  const double epsilon_for_sum_;
+  const double delta_for_sum_;
+  const double epsilon_for_squares_;
+  const double delta_for_squares_;
+  const int l0_sensitivity_;
+  const int max_contributions_per_partition_;
+  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_;
+
+  std::unique_ptr<NumericalMechanism> count_mechanism_;
+
+  // Shared by all statistics.
+  std::unique_ptr<ApproxBounds<T>> approx_bounds_;
+};
+
+template <typename T>
+class BoundedStatistics<T>::Builder {
+ public:
+  BoundedStatistics<T>::Builder& SetEpsilon(double epsilon) {
+    epsilon_ = epsilon;
+    return *this;
+  }
+
+  BoundedStatistics<T>::Builder& SetDelta(double delta) {
+    delta_ = delta;
+    return *this;
+  }
+
+  BoundedStatistics<T>::Builder& SetMaxPartitionsContributed(
+      int max_partitions_contributed) {
+    max_partitions_contributed_ = max_partitions_contributed;
+    return *this;
+  }
+
+  BoundedStatistics<T>::Builder& SetMaxContributionsPerPartition(
+      int max_contributions_per_partition) {
+    max_contributions_per_partition_ = max_contributions_per_partition;
+    return *this;
+  }
+
+  // Sets the ApproxBounds shared by all statistics. Its epsilon is the
+  // bounding epsilon and must be less than the total epsilon. If not set, an
+  // ApproxBounds with half the total epsilon is created.
+  BoundedStatistics<T>::Builder& SetApproxBounds(
+      std::unique_ptr<ApproxBounds<T>> approx_bounds) {
+    approx_bounds_ = std::move(approx_bounds);
+    return *this;
+  }
+
+  BoundedStatistics<T>::Builder& SetLaplaceMechanism(
+      std::unique_ptr<NumericalMechanismBuilder> builder) {
+    mechanism_builder_ = std::move(builder);
+    return *this;
+  }
+
+  // Allocates the partial values and, unless an ApproxBounds is set, the
+  // histogram bins from `memory_resource`, which must outlive the algorithm.
+  BoundedStatistics<T>::Builder& SetMemoryResource(
+      std::pmr::memory_resource* memory_resource) {
+    memory_resource_ = memory_resource;
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<BoundedStatistics<T>>> Build() {
+    if (!epsilon_.has_value()) {
+      epsilon_ = DefaultEpsilon();
+      LOG(WARNING) << "Default epsilon of " << epsilon_.value()
+                   << " is being used. Consider setting your own epsilon based "
+                      "on privacy considerations.";
+    }
+    RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
+    RETURN_IF_ERROR(ValidateDelta(delta_));
+    RETURN_IF_ERROR(
+        ValidateMaxPartitionsContributed(max_partitions_contributed_));
+    RETURN_IF_ERROR(
+        ValidateMaxContributionsPerPartition(max_contributions_per_partition_));
+
+    if (!approx_bounds_) {
+      ASSIGN_OR_RETURN(
+          approx_bounds_,
+          typename ApproxBounds<T>::Builder()
+              .SetEpsilon(epsilon_.value() / 2)
+              .SetLaplaceMechanism(mechanism_builder_->Clone())
+              .SetMaxContributionsPerPartition(max_contributions_per_partition_)
+              .SetMaxPartitionsContributed(max_partitions_contributed_)
+              .SetMemoryResource(memory_resource_)
+              .Build());
+    }
+    if (epsilon_.value() <= approx_bounds_->GetEpsilon()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Approx Bounds consumes more epsilon budget than available. Total "
+          "Epsilon: ",
+          epsilon_.value(),
+          " Approx Bounds Epsilon: ", approx_bounds_->GetEpsilon()));
+    }
+
+    // Budget calculation.
+    const double remaining_epsilon =
+        epsilon_.value() - approx_bounds_->GetEpsilon();
+    const double epsilon_for_count = remaining_epsilon / 3;
+    const double epsilon_for_sum = remaining_epsilon / 3;
+    const double epsilon_for_squares =
+        remaining_epsilon - epsilon_for_count - epsilon_for_sum;
+    const double delta_for_count = delta_ / 3;
+    const double delta_for_sum = delta_ / 3;
+    const double delta_for_squares = delta_ - delta_for_count - delta_for_sum;
+
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> count_mechanism,
+                     mechanism_builder_->Clone()
+                         ->SetEpsilon(epsilon_for_count)
+                         .SetDelta(delta_for_count)
+                         .SetL0Sensitivity(max_partitions_contributed_)
+                         .SetLInfSensitivity(max_contributions_per_partition_)
+                         .Build());
+
+    return absl::WrapUnique(new BoundedStatistics<T>(
+        epsilon_.value(), delta_, epsilon_for_sum, delta_for_sum,
+        epsilon_for_squares, delta_for_squares, max_partitions_contributed_,
+        max_contributions_per_partition_, mechanism_builder_->Clone(),
+        std::move(count_mechanism), std::move(approx_bounds_),
+        memory_resource_));
+  }
+
+ private:
+  std::optional<double> epsilon_;
+  double delta_ = 0;
+  int max_partitions_contributed_ = 1;
+  int max_contributions_per_partition_ = 1;
+  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
+      absl::make_unique<LaplaceMechanism::Builder>();
+  std::unique_ptr<ApproxBounds<T>> approx_bounds_;
+  std::pmr::memory_resource* memory_resource_ =
+      std::pmr::get_default_resource();
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_BOUNDED_STATISTICS_H_
@@ -0,0 +1,187 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/bounded-statistics.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/testing/proto_matchers.h"
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/approx-bounds.h"
+#include "algorithms/bounded-variance.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "proto/util.h"
+#include "proto/data.pb.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::EqualsProto;
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::DoubleNear;
+using ::testing::HasSubstr;
+
+template <typename T>
+std::unique_ptr<ApproxBounds<T>> ZeroNoiseApproxBounds() {
+  return typename ApproxBounds<T>::Builder()
+      .SetEpsilon(0.5)
+      .SetNumBins(4)
+      .SetBase(2)
+      .SetScale(1)
+      .SetThresholdForTest(0.5)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .Build()
+      .value();
+}
+
+template <typename T>
+std::unique_ptr<BoundedStatistics<T>> ZeroNoiseStatistics() {
+  return typename BoundedStatistics<T>::Builder()
+      .SetEpsilon(1)
+      .SetApproxBounds(ZeroNoiseApproxBounds<T>())
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .Build()
+      .value();
+}
+
+template <typename T>
+class BoundedStatisticsTest : public ::testing::Test {};
+
+typedef ::testing::Types<int64_t, double> NumericTypes;
+TYPED_TEST_SUITE(BoundedStatisticsTest, NumericTypes);
+
+TYPED_TEST(BoundedStatisticsTest, ComputesSumMeanAndVariance) {
+  std::unique_ptr<BoundedStatistics<TypeParam>> statistics =
+      ZeroNoiseStatistics<TypeParam>();
+  // Bounds are set to [-1, 2].
+  std::vector<TypeParam> a = {1, -1, 2};
+
+  absl::StatusOr<Output> result = statistics->Result(a.begin(), a.end());
+  ASSERT_OK(result);
+  ASSERT_EQ(result->elements_size(), 3);
+  EXPECT_EQ(GetValue<TypeParam>(
+                result->elements(BoundedStatistics<TypeParam>::kSumIndex)
+                    .value()),
+            2);
+  EXPECT_THAT(GetValue<double>(
+                  result->elements(BoundedStatistics<TypeParam>::kMeanIndex)
+                      .value()),
+              DoubleNear(2.0 / 3, 1e-10));
+  EXPECT_THAT(
+      GetValue<double>(
+          result->elements(BoundedStatistics<TypeParam>::kVarianceIndex)
+              .value()),
+      DoubleNear(14.0 / 9, 1e-10));
+  EXPECT_EQ(GetValue<TypeParam>(
+                result->error_report().bounding_report().lower_bound()),
+            -1);
+  EXPECT_EQ(GetValue<TypeParam>(
+                result->error_report().bounding_report().upper_bound()),
+            2);
+}
+
+TYPED_TEST(BoundedStatisticsTest, BinsEachInputOnce) {
+  std::unique_ptr<BoundedStatistics<TypeParam>> statistics =
+      ZeroNoiseStatistics<TypeParam>();
+  for (TypeParam x : {1, -1, 2, 3, 0}) {
+    statistics->AddEntry(x);
+  }
+
+  BoundedVarianceSummary summary;
+  ASSERT_TRUE(statistics->Serialize().data().UnpackTo(&summary));
+  int64_t num_binned = 0;
+  for (int64_t count : summary.bounds_summary().pos_bin_count()) {
+    num_binned += count;
+  }
+  for (int64_t count : summary.bounds_summary().neg_bin_count()) {
+    num_binned += count;
+  }
+  EXPECT_EQ(summary.count(), 5);
+  EXPECT_EQ(num_binned, 5);
+}
+
+TEST(BoundedStatisticsTest, SplitsEpsilonBetweenBoundsAndAggregation) {
+  absl::StatusOr<std::unique_ptr<BoundedStatistics<double>>> statistics =
+      BoundedStatistics<double>::Builder().SetEpsilon(1).Build();
+  ASSERT_OK(statistics);
+  EXPECT_DOUBLE_EQ((*statistics)->GetEpsilon(), 1);
+  EXPECT_DOUBLE_EQ((*statistics)->GetBoundingEpsilon(), 0.5);
+  EXPECT_DOUBLE_EQ((*statistics)->GetAggregationEpsilon(), 0.5);
+
+  statistics = BoundedStatistics<double>::Builder()
+                   .SetEpsilon(0.5)
+                   .SetApproxBounds(ZeroNoiseApproxBounds<double>())
+                   .Build();
+  EXPECT_THAT(statistics, StatusIs(absl::StatusCode::kInvalidArgument,
+                                   HasSubstr("more epsilon budget")));
+}
+
+TYPED_TEST(BoundedStatisticsTest, MergeMatchesAddingAllEntries) {
+  std::unique_ptr<BoundedStatistics<TypeParam>> all =
+      ZeroNoiseStatistics<TypeParam>();
+  std::unique_ptr<BoundedStatistics<TypeParam>> first =
+      ZeroNoiseStatistics<TypeParam>();
+  std::unique_ptr<BoundedStatistics<TypeParam>> second =
+      ZeroNoiseStatistics<TypeParam>();
+  for (TypeParam x : {1, -1, 2}) {
+    all->AddEntry(x);
+    first->AddEntry(x);
+  }
+  for (TypeParam x : {3, -2}) {
+    all->AddEntry(x);
+    second->AddEntry(x);
+  }
+
+  std::unique_ptr<BoundedStatistics<TypeParam>> merged =
+      ZeroNoiseStatistics<TypeParam>();
+  ASSERT_OK(merged->Merge(first->Serialize()));
+  ASSERT_OK(merged->MergeFrom(*second));
+  EXPECT_THAT(merged->Serialize(), EqualsProto(all->Serialize()));
+
+  EXPECT_THAT(merged->Merge(Summary()),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("no bounded")));
+}
+
+TEST(BoundedStatisticsTest, SummaryMergesIntoBoundedVariance) {
+  std::unique_ptr<BoundedStatistics<double>> statistics =
+      ZeroNoiseStatistics<double>();
+  for (double x : {1, -1, 2}) {
+    statistics->AddEntry(x);
+  }
+  absl::StatusOr<std::unique_ptr<BoundedVariance<double>>> variance =
+      BoundedVariance<double>::Builder()
+          .SetEpsilon(1)
+          .SetApproxBounds(ZeroNoiseApproxBounds<double>())
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(variance);
+
+  ASSERT_OK((*variance)->Merge(statistics->Serialize()));
+  absl::StatusOr<Output> result = (*variance)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(GetValue<double>(*result), DoubleNear(14.0 / 9, 1e-10));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,31 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "algorithms/bounded-sum.h"
+
+#include <cstdint>
+
+namespace differential_privacy {
+
+template class BoundedSum<int64_t>;
+template class BoundedSum<double>;
+template class BoundedSumWithFixedBounds<int64_t>;
+template class BoundedSumWithFixedBounds<double>;
+template class BoundedSumWithApproxBounds<int64_t>;
+template class BoundedSumWithApproxBounds<double>;
+
+}  // namespace differential_privacy
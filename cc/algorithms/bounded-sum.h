@@ -24,41 +24,69 @@
 #include <cstdint>
 #include <limits>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "google/protobuf/any.pb.h"
+#include "google/protobuf/repeated_field.h"
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
+#include "absl/numeric/int128.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "algorithms/algorithm.h"
 #include "algorithms/approx-bounds.h"
 #include "algorithms/bounded-algorithm.h"
+#include "algorithms/internal/binary-summary.h"
+#include "algorithms/internal/clamped-sum.h"
+#include "algorithms/internal/wire-reader.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "algorithms/util.h"
 #include "proto/util.h"
 #include "proto/confidence-interval.pb.h"
 #include "proto/data.pb.h"
 #include "proto/summary.pb.h"
+#include "base/instrumentation.h"
+#include "base/tracking_memory_resource.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
 
-template <typename T>
+// Differentially private sum of the entries clamped to [lower, upper].
+//
+// The sum is accumulated in Accumulator, which is T by default. Narrow inputs
+// can be summed in a wider type without converting them first, i.e.,
+// BoundedSum<float, double> for float and BoundedSum<int32_t, int64_t> for
+// int32_t inputs. The result and the summaries are of type Accumulator.
+template <typename T, typename Accumulator = T>
 class BoundedSum : public Algorithm<T> {
   static_assert(std::is_arithmetic<T>::value,
                 "BoundedSum can only be used for arithmetic types");
   static_assert(std::numeric_limits<T>::lowest() < 0,
                 "BoundedSum can only be used for signed types");
+  static_assert(std::is_same_v<Accumulator, T> ||
+                    (std::is_floating_point_v<T> &&
+                     std::is_same_v<Accumulator, double>) ||
+                    (std::is_integral_v<T> &&
+                     std::is_same_v<Accumulator, int64_t>),
+                "BoundedSum can only accumulate in T, or in double for "
+                "floating point and int64_t for integral types");
 
  public:
   // Builder class that should be used to construct BoundedSum algorithms.
   class Builder;
 
+  // Validated and calibrated BoundedSum with fixed bounds from which many
+  // instances are created, e.g., one per partition.
+  class Prototype;
+
   BoundedSum(double epsilon, double delta) : Algorithm<T>(epsilon, delta) {}
 
   virtual ~BoundedSum() = default;
@@ -69,6 +97,22 @@ class BoundedSum : public Algorithm<T> {
   // Returns the upper bound when it has been set.
   virtual std::optional<T> upper() const = 0;
 
+  // Serializes the partial state in the compact binary summary format, which
+  // is cheaper to produce and to merge than the proto returned by Serialize().
+  // The result can only be merged into a BoundedSum built with the same
+  // options.
+  virtual std::string SerializeToBinary() const = 0;
+
+  // Merges a summary returned by SerializeToBinary(). The state is left
+  // unchanged if the summary is invalid.
+  virtual absl::Status MergeFromBinary(absl::string_view binary_summary) = 0;
+
+  // Same summary as Serialize(), in the compact encoding of BoundedSumSummary
+  // and ApproxBoundsSummary, which is much smaller with automatic bounds.
+  // Merge() accepts both encodings. With fixed bounds, the summary has a
+  // single sum and is the same as Serialize().
+  virtual Summary SerializeCompact() const = 0;
+
  protected:
   // Check that bounds are appropriate.
   static absl::Status CheckLowerBound(T lower) {
@@ -99,28 +143,92 @@ class BoundedSum : public Algorithm<T> {
 };
 
 // Bounded sum implementation that uses fixed bounds.
-template <typename T>
-class BoundedSumWithFixedBounds : public BoundedSum<T> {
+template <typename T, typename Accumulator = T>
+class BoundedSumWithFixedBounds : public BoundedSum<T, Accumulator> {
  public:
+  // A positive `granularity` enables fixed point accumulation, see
+  // Builder::SetFixedPointGranularity. It must have been validated by the
+  // builder.
   BoundedSumWithFixedBounds(const double epsilon, const double delta,
                             const T lower, const T upper,
-                            std::unique_ptr<NumericalMechanism> mechanism)
-      : BoundedSum<T>(epsilon, delta),
+                            std::shared_ptr<NumericalMechanism> mechanism,
+                            const double granularity = 0)
+      : BoundedSum<T, Accumulator>(epsilon, delta),
         lower_(lower),
         upper_(upper),
-        mechanism_(std::move(mechanism)) {}
+        granularity_(granularity),
+        mechanism_(std::move(mechanism)) {
+    if (granularity_ > 0) {
+      // Clamping to multiples of the granularity keeps the rounded entries
+      // within the bounds that the mechanism was calibrated for.
+      fixed_point_lower_ = std::ceil(lower / granularity_) * granularity_;
+      fixed_point_upper_ = std::floor(upper / granularity_) * granularity_;
+    }
+  }
 
   void AddEntry(const T& t) override {
     if (std::isnan(static_cast<double>(t))) {
       return;
     }
+    if constexpr (std::is_floating_point_v<T>) {
+      if (granularity_ > 0) {
+        // Same rounding as internal::ClampedFixedPointSum.
+        fixed_point_sum_ += static_cast<int64_t>(std::nearbyint(
+            std::min(std::max<double>(t, fixed_point_lower_),
+                     fixed_point_upper_) /
+            granularity_));
+        return;
+      }
+    }
     partial_sum_ += Clamp<T>(lower_, upper_, t);
   }
 
+  using BoundedSum<T, Accumulator>::AddEntries;
+
+  // Same as AddEntry for every entry. Entries of double, float and int64_t,
+  // and int32_t entries summed in int64_t, are clamped and summed with the
+  // vectorized internal::ClampedSum, so floating point sums may differ from
+  // sequential sums by rounding.
+  void AddEntries(absl::Span<const T> entries) override {
+    if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+      if (granularity_ > 0) {
+        fixed_point_sum_ +=
+            internal::ClampedFixedPointSum(entries, fixed_point_lower_,
+                                           fixed_point_upper_,
+                                           1 / granularity_)
+                .sum;
+        return;
+      }
+      partial_sum_ += internal::ClampedSum(entries, lower_, upper_).sum;
+    } else if constexpr (std::is_same_v<T, int64_t> ||
+                         (std::is_same_v<T, int32_t> &&
+                          std::is_same_v<Accumulator, int64_t>)) {
+      partial_sum_ += internal::ClampedSum(entries, lower_, upper_);
+    } else if constexpr (std::is_integral_v<T>) {
+      Accumulator sum = partial_sum_;
+      for (const T& entry : entries) {
+        sum += Clamp<T>(lower_, upper_, entry);
+      }
+      partial_sum_ = sum;
+    } else {
+      Algorithm<T>::AddEntries(entries);
+    }
+  }
+
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     BoundedSumSummary sum_summary;
-    // TODO: Use the partial_sum field of the proto.
-    SetValue(sum_summary.add_pos_sum(), partial_sum_);
+    if (granularity_ > 0) {
+      // The exact sum in multiples of the granularity, as its low and high 64
+      // bits.
+      SetValue(sum_summary.add_pos_sum(),
+               static_cast<int64_t>(absl::Int128Low64(fixed_point_sum_)));
+      SetValue(sum_summary.add_pos_sum(), absl::Int128High64(fixed_point_sum_));
+    } else {
+      // TODO: Use the partial_sum field of the proto.
+      SetValue(sum_summary.add_pos_sum(), partial_sum_);
+    }
 
     Summary result;
     result.mutable_data()->PackFrom(sum_summary);
@@ -128,6 +236,8 @@ class BoundedSumWithFixedBounds : public BoundedSum<T> {
   }
 
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError("Cannot merge summary with no data.");
     }
@@ -138,6 +248,20 @@ class BoundedSumWithFixedBounds : public BoundedSum<T> {
       return absl::InternalError("Bounded sum summary unable to be unpacked.");
     }
 
+    if (granularity_ > 0) {
+      if (sum_summary.pos_sum_size() != 2 ||
+          !sum_summary.pos_sum(0).has_int_value() ||
+          !sum_summary.pos_sum(1).has_int_value()) {
+        return absl::InternalError(
+            "Bounded sum summary with fixed point accumulation must have "
+            "exactly two integer pos_sum.");
+      }
+      fixed_point_sum_ += absl::MakeInt128(
+          sum_summary.pos_sum(1).int_value(),
+          static_cast<uint64_t>(sum_summary.pos_sum(0).int_value()));
+      return absl::OkStatus();
+    }
+
     // Get required partial sum
     // TODO: Use the partial_sum field of the proto.
     if (sum_summary.pos_sum_size() != 1) {
@@ -145,11 +269,113 @@ class BoundedSumWithFixedBounds : public BoundedSum<T> {
           "Bounded sum summary must have exactly one pos_sum but got ",
           sum_summary.pos_sum_size()));
     }
-    partial_sum_ += GetValue<T>(sum_summary.pos_sum(0));
+    partial_sum_ += GetValue<Accumulator>(sum_summary.pos_sum(0));
 
     return absl::Status();
   }
 
+  // Reads the partial sum straight from the serialized BoundedSumSummary.
+  // Summaries that cannot be decoded this way, and those of fixed point sums,
+  // go through Merge, which reports the error.
+  absl::Status MergeFromBytes(absl::string_view summary_bytes) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    absl::string_view payload;
+    if (granularity_ > 0 ||
+        !internal::SummaryPayload<BoundedSumSummary>(summary_bytes,
+                                                     &payload)) {
+      return Algorithm<T>::MergeFromBytes(summary_bytes);
+    }
+    internal::WireReader reader(payload);
+    int num_pos_sums = 0;
+    Accumulator partial_sum = 0;
+    while (!reader.empty()) {
+      int field;
+      internal::WireType wire_type;
+      absl::string_view value;
+      if (!reader.ReadTag(&field, &wire_type)) {
+        return Algorithm<T>::MergeFromBytes(summary_bytes);
+      }
+      if (field == 1 && wire_type == internal::WireType::kLengthDelimited) {
+        if (!reader.ReadLengthDelimited(&value) ||
+            !internal::ReadValueType(value, &partial_sum)) {
+          return Algorithm<T>::MergeFromBytes(summary_bytes);
+        }
+        ++num_pos_sums;
+      } else if (!reader.SkipField(wire_type)) {
+        return Algorithm<T>::MergeFromBytes(summary_bytes);
+      }
+    }
+    if (num_pos_sums != 1) {
+      return Algorithm<T>::MergeFromBytes(summary_bytes);
+    }
+    partial_sum_ += partial_sum;
+    return absl::OkStatus();
+  }
+
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_sum =
+        dynamic_cast<const BoundedSumWithFixedBounds<T, Accumulator>*>(&other);
+    // Summaries of sums with different accumulation do not merge; Merge
+    // reports the error.
+    if (other_sum == nullptr || other_sum->granularity_ != granularity_) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    partial_sum_ += other_sum->partial_sum_;
+    fixed_point_sum_ += other_sum->fixed_point_sum_;
+    return absl::OkStatus();
+  }
+
+  Summary SerializeCompact() const override { return Serialize(); }
+
+  std::string SerializeToBinary() const override {
+    if (granularity_ > 0) {
+      internal::BinarySummaryWriter writer =
+          internal::MakeBinarySummaryWriter<Accumulator>(
+              internal::BinarySummaryType::kBoundedSumWithFixedPoint);
+      const int64_t halves[2] = {
+          static_cast<int64_t>(absl::Int128Low64(fixed_point_sum_)),
+          absl::Int128High64(fixed_point_sum_)};
+      writer.AppendArray<int64_t>(halves);
+      return std::move(writer).Finish();
+    }
+    internal::BinarySummaryWriter writer =
+        internal::MakeBinarySummaryWriter<Accumulator>(
+            internal::BinarySummaryType::kBoundedSumWithFixedBounds);
+    writer.AppendArray<Accumulator>({&partial_sum_, 1});
+    return std::move(writer).Finish();
+  }
+
+  absl::Status MergeFromBinary(absl::string_view binary_summary) override {
+    if (granularity_ > 0) {
+      absl::StatusOr<internal::BinarySummaryReader> reader =
+          internal::MakeBinarySummaryReader<Accumulator>(
+              binary_summary,
+              internal::BinarySummaryType::kBoundedSumWithFixedPoint);
+      RETURN_IF_ERROR(reader.status());
+      absl::StatusOr<internal::BinarySummaryArray<int64_t>> halves =
+          reader->ReadArray<int64_t>(2);
+      RETURN_IF_ERROR(halves.status());
+      RETURN_IF_ERROR(reader->Finish());
+      fixed_point_sum_ +=
+          absl::MakeInt128((*halves)[1], static_cast<uint64_t>((*halves)[0]));
+      return absl::OkStatus();
+    }
+    absl::StatusOr<internal::BinarySummaryReader> reader =
+        internal::MakeBinarySummaryReader<Accumulator>(
+            binary_summary,
+            internal::BinarySummaryType::kBoundedSumWithFixedBounds);
+    RETURN_IF_ERROR(reader.status());
+    absl::StatusOr<internal::BinarySummaryArray<Accumulator>> partial_sum =
+        reader->ReadArray<Accumulator>(1);
+    RETURN_IF_ERROR(partial_sum.status());
+    RETURN_IF_ERROR(reader->Finish());
+    partial_sum_ += (*partial_sum)[0];
+    return absl::OkStatus();
+  }
+
   int64_t MemoryUsed() override {
     return sizeof(BoundedSumWithFixedBounds) + mechanism_->MemoryUsed();
   }
@@ -164,59 +390,129 @@ class BoundedSumWithFixedBounds : public BoundedSum<T> {
   }
 
  protected:
-  absl::StatusOr<Output> GenerateResult(double noise_interval_level) override {
-    Output output;
+  using DeferredValue = typename Algorithm<T>::DeferredValue;
 
+  absl::StatusOr<Output> GenerateResult(double noise_interval_level) override {
     // Add noise to the sum.
-    double noisy_sum = mechanism_->AddNoise(partial_sum_);
+    DeferredValue noised_value;
+    if (std::is_integral<T>::value) {
+      noised_value.int_value = mechanism_->AddNoise(partial_sum_);
+    } else {
+      noised_value.double_value = mechanism_->AddNoise(PartialSum());
+    }
+    return MakeDeferredOutput(noised_value, noise_interval_level);
+  }
+
+  absl::StatusOr<ScalarResult> GenerateScalarResult(
+      double noise_interval_level) override {
+    ScalarResult result;
+    if constexpr (std::is_integral<T>::value) {
+      // Same rounding and saturation as MakeDeferredOutput.
+      const double noisy_sum = mechanism_->AddNoise(partial_sum_);
+      result.value = static_cast<int64_t>(
+          SafeCastFromDouble<Accumulator>(std::round(noisy_sum)).value);
+    } else {
+      result.value = mechanism_->AddNoise(PartialSum());
+    }
+    absl::StatusOr<ConfidenceInterval> interval =
+        NoiseConfidenceInterval(noise_interval_level);
+    if (interval.ok()) {
+      result.noise_confidence_interval = *std::move(interval);
+    }
+    return result;
+  }
+
+  std::optional<DeferredValue> GetDeferredValue() override {
+    DeferredValue value;
+    value.mechanism = mechanism_.get();
+    value.integral = std::is_integral<T>::value;
+    if (std::is_integral<T>::value) {
+      value.int_value = static_cast<int64_t>(partial_sum_);
+    } else {
+      value.double_value = static_cast<double>(PartialSum());
+    }
+    return value;
+  }
+
+  Output MakeDeferredOutput(const DeferredValue& noised_value,
+                            double noise_interval_level) override {
+    Output output;
+    const double noisy_sum = std::is_integral<T>::value
+                                 ? noised_value.int_value
+                                 : noised_value.double_value;
     // Add noise confidence interval.
     absl::StatusOr<ConfidenceInterval> interval =
         NoiseConfidenceInterval(noise_interval_level);
 
     if (std::is_integral<T>::value) {
-      SafeOpResult<T> cast_result =
-          SafeCastFromDouble<T>(std::round(noisy_sum));
+      SafeOpResult<Accumulator> cast_result =
+          SafeCastFromDouble<Accumulator>(std::round(noisy_sum));
       if (interval.ok()) {
-        output = MakeOutput<T>(cast_result.value, interval.value());
+        output = MakeOutput<Accumulator>(cast_result.value, interval.value());
       } else {
-        output = MakeOutput<T>(cast_result.value);
+        output = MakeOutput<Accumulator>(cast_result.value);
       }
     } else {
       if (interval.ok()) {
-        output = MakeOutput<T>(noisy_sum, interval.value());
+        output = MakeOutput<Accumulator>(noisy_sum, interval.value());
       } else {
-        output = MakeOutput<T>(noisy_sum);
+        output = MakeOutput<Accumulator>(noisy_sum);
       }
     }
 
     return output;
   }
 
-  void ResetState() override { partial_sum_ = 0; }
+  void ResetState() override {
+    partial_sum_ = 0;
+    fixed_point_sum_ = 0;
+  }
 
  private:
+  // Returns the sum of the entries so far.
+  Accumulator PartialSum() const {
+    if (granularity_ > 0) {
+      return static_cast<Accumulator>(static_cast<double>(fixed_point_sum_) *
+                                      granularity_);
+    }
+    return partial_sum_;
+  }
+
   // Bounds
   const T lower_;
   const T upper_;
 
   // (Partially) aggregated sum
-  T partial_sum_ = 0;
-
-  // Mechanism to add noise.
-  std::unique_ptr<NumericalMechanism> mechanism_;
+  Accumulator partial_sum_ = 0;
+
+  // Fixed point accumulation, if the granularity is positive. The sum is in
+  // multiples of the granularity, and entries are clamped to the multiples
+  // of the granularity within the bounds.
+  const double granularity_;
+  double fixed_point_lower_ = 0;
+  double fixed_point_upper_ = 0;
+  absl::int128 fixed_point_sum_ = 0;
+
+  // Mechanism to add noise. Shared by the instances of a Prototype.
+  std::shared_ptr<NumericalMechanism> mechanism_;
 };
 
 // Bounded sum implementation using privately inferred bounds as a single-pass
 // algorithm using ApproxBounds.
-template <typename T>
-class BoundedSumWithApproxBounds : public BoundedSum<T> {
+template <typename T, typename Accumulator = T>
+class BoundedSumWithApproxBounds : public BoundedSum<T, Accumulator> {
  public:
   BoundedSumWithApproxBounds(
       const double epsilon, const double delta, const double l0_sensitivity,
       const double max_contributions_per_partition,
       std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
-      std::unique_ptr<ApproxBounds<T>> approx_bounds)
-      : BoundedSum<T>(epsilon, delta),
+      std::unique_ptr<ApproxBounds<T>> approx_bounds,
+      std::pmr::memory_resource* memory_resource =
+          std::pmr::get_default_resource())
+      : BoundedSum<T, Accumulator>(epsilon, delta),
+        memory_(memory_resource),
+        pos_sum_(&memory_),
+        neg_sum_(&memory_),
         mechanism_builder_(std::move(mechanism_builder)),
         l0_sensitivity_(l0_sensitivity),
         max_contributions_per_partition_(max_contributions_per_partition),
@@ -234,14 +530,20 @@ class BoundedSumWithApproxBounds : public BoundedSum<T> {
       return;
     }
 
-    approx_bounds_->AddEntry(t);
+    // Find the bin once for both the histogram and the partial sums.
+    const int bin_index = approx_bounds_->MostSignificantBit(t);
+    approx_bounds_->AddMultipleEntriesToBin(t, bin_index, 1);
+    approx_bounds_->template AddMultipleEntriesToPartialsOfBin<Accumulator>(
+        t >= 0 ? &pos_sum_ : &neg_sum_, t, bin_index, 1,
+        [](T val1, T val2) { return static_cast<Accumulator>(val1) - val2; });
+  }
 
-    // Find partial sums.
-    if (t >= 0) {
-      approx_bounds_->template AddToPartialSums<T>(&pos_sum_, t);
-    } else {
-      approx_bounds_->template AddToPartialSums<T>(&neg_sum_, t);
-    }
+  using BoundedSum<T, Accumulator>::AddEntries;
+
+  // Fills the histogram of the ApproxBounds and the partial sums in a single
+  // pass over the entries, see ApproxBounds::AddEntriesWithPartialSums.
+  void AddEntries(absl::Span<const T> entries) override {
+    approx_bounds_->AddEntriesWithPartialSums(entries, &pos_sum_, &neg_sum_);
   }
 
   // Noise confidence interval is not known before finalizing the algorithm as
@@ -257,12 +559,14 @@ class BoundedSumWithApproxBounds : public BoundedSum<T> {
   std::optional<T> upper() const override { return std::nullopt; }
 
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     // Create BoundedSumSummary.
     BoundedSumSummary bs_summary;
-    for (T x : pos_sum_) {
+    for (Accumulator x : pos_sum_) {
       SetValue(bs_summary.add_pos_sum(), x);
     }
-    for (T x : neg_sum_) {
+    for (Accumulator x : neg_sum_) {
       SetValue(bs_summary.add_neg_sum(), x);
     }
     Summary approx_bounds_summary = approx_bounds_->Serialize();
@@ -275,6 +579,8 @@ class BoundedSumWithApproxBounds : public BoundedSum<T> {
   }
 
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError(
           "Cannot merge summary with no bounded sum data.");
@@ -285,24 +591,142 @@ class BoundedSumWithApproxBounds : public BoundedSum<T> {
     if (!summary.data().UnpackTo(&bs_summary)) {
       return absl::InternalError("Bounded sum summary unable to be unpacked.");
     }
-    if (pos_sum_.size() != bs_summary.pos_sum_size() ||
-        neg_sum_.size() != bs_summary.neg_sum_size()) {
+    // Summaries from SerializeCompact() have no dense partial sums, see
+    // SerializeCompact().
+    const bool compact =
+        bs_summary.pos_sum_size() == 0 && bs_summary.neg_sum_size() == 0;
+    if (compact) {
+      RETURN_IF_ERROR(CheckCompactSums(bs_summary));
+    } else if (pos_sum_.size() != bs_summary.pos_sum_size() ||
+               neg_sum_.size() != bs_summary.neg_sum_size()) {
       return absl::InternalError(
           "Merged BoundedSum must have the same amount of partial sum "
           "values as this BoundedSum.");
     }
+
+    // Merging the approx bounds validates its summary before changing any
+    // state, so the partial sums are only added once it succeeded.
+    RETURN_IF_ERROR(
+        approx_bounds_->MergeApproxBoundsSummary(bs_summary.bounds_summary()));
+    if (compact) {
+      if constexpr (std::is_integral_v<Accumulator>) {
+        AddCompactSums(bs_summary.compact_pos_int_sum(), &pos_sum_);
+        AddCompactSums(bs_summary.compact_neg_int_sum(), &neg_sum_);
+      } else {
+        AddCompactSums(bs_summary.compact_pos_float_sum(), &pos_sum_);
+        AddCompactSums(bs_summary.compact_neg_float_sum(), &neg_sum_);
+      }
+      return absl::OkStatus();
+    }
     for (int i = 0; i < pos_sum_.size(); ++i) {
-      pos_sum_[i] += GetValue<T>(bs_summary.pos_sum(i));
+      pos_sum_[i] += GetValue<Accumulator>(bs_summary.pos_sum(i));
     }
     for (int i = 0; i < neg_sum_.size(); ++i) {
-      neg_sum_[i] += GetValue<T>(bs_summary.neg_sum(i));
+      neg_sum_[i] += GetValue<Accumulator>(bs_summary.neg_sum(i));
     }
+    return absl::OkStatus();
+  }
 
-    // Merge approx bounds summary.
-    Summary approx_bounds_summary;
-    approx_bounds_summary.mutable_data()->PackFrom(bs_summary.bounds_summary());
-    RETURN_IF_ERROR(approx_bounds_->Merge(approx_bounds_summary));
+  // Adds the partial sums and the approx bounds straight from the serialized
+  // BoundedSumSummary, in either the dense or the compact encoding. Summaries
+  // that cannot be decoded this way go through Merge, which reports the
+  // error.
+  absl::Status MergeFromBytes(absl::string_view summary_bytes) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    absl::string_view payload;
+    if (!internal::SummaryPayload<BoundedSumSummary>(summary_bytes, &payload) ||
+        !MergeBoundedSumBytes(payload)) {
+      return Algorithm<T>::MergeFromBytes(summary_bytes);
+    }
+    return absl::OkStatus();
+  }
 
+  // Writes the partial sums up to the last non-zero one into packed arrays of
+  // the type of the accumulator, and the approx bounds in their sparse
+  // encoding. Partial sums are zero above the bin of the largest entry of each
+  // sign, and most bins are empty, so the summary is usually a small fraction
+  // of that of Serialize().
+  Summary SerializeCompact() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
+    BoundedSumSummary bs_summary;
+    if constexpr (std::is_integral_v<Accumulator>) {
+      AppendCompactSums(pos_sum_, bs_summary.mutable_compact_pos_int_sum());
+      AppendCompactSums(neg_sum_, bs_summary.mutable_compact_neg_int_sum());
+    } else {
+      AppendCompactSums(pos_sum_, bs_summary.mutable_compact_pos_float_sum());
+      AppendCompactSums(neg_sum_, bs_summary.mutable_compact_neg_float_sum());
+    }
+    *bs_summary.mutable_bounds_summary() =
+        approx_bounds_->CompactApproxBoundsSummary();
+    Summary summary;
+    summary.mutable_data()->PackFrom(bs_summary);
+    return summary;
+  }
+
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_sum =
+        dynamic_cast<const BoundedSumWithApproxBounds<T, Accumulator>*>(&other);
+    if (other_sum == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    if (pos_sum_.size() != other_sum->pos_sum_.size() ||
+        neg_sum_.size() != other_sum->neg_sum_.size()) {
+      return absl::InternalError(
+          "Merged BoundedSum must have the same amount of partial sum "
+          "values as this BoundedSum.");
+    }
+    RETURN_IF_ERROR(approx_bounds_->MergeFrom(*other_sum->approx_bounds_));
+    for (int i = 0; i < pos_sum_.size(); ++i) {
+      pos_sum_[i] += other_sum->pos_sum_[i];
+    }
+    for (int i = 0; i < neg_sum_.size(); ++i) {
+      neg_sum_[i] += other_sum->neg_sum_[i];
+    }
+    return absl::OkStatus();
+  }
+
+  // The binary summary contains the positive and negative partial sums
+  // followed by the nested binary summary of the approx bounds.
+  std::string SerializeToBinary() const override {
+    internal::BinarySummaryWriter writer =
+        internal::MakeBinarySummaryWriter<Accumulator>(
+            internal::BinarySummaryType::kBoundedSumWithApproxBounds);
+    writer.AppendArray<Accumulator>(pos_sum_);
+    writer.AppendArray<Accumulator>(neg_sum_);
+    writer.AppendBytes(approx_bounds_->SerializeToBinary());
+    return std::move(writer).Finish();
+  }
+
+  absl::Status MergeFromBinary(absl::string_view binary_summary) override {
+    absl::StatusOr<internal::BinarySummaryReader> reader =
+        internal::MakeBinarySummaryReader<Accumulator>(
+            binary_summary,
+            internal::BinarySummaryType::kBoundedSumWithApproxBounds);
+    RETURN_IF_ERROR(reader.status());
+    absl::StatusOr<internal::BinarySummaryArray<Accumulator>> pos_sum =
+        reader->ReadArray<Accumulator>(pos_sum_.size());
+    RETURN_IF_ERROR(pos_sum.status());
+    absl::StatusOr<internal::BinarySummaryArray<Accumulator>> neg_sum =
+        reader->ReadArray<Accumulator>(neg_sum_.size());
+    RETURN_IF_ERROR(neg_sum.status());
+    absl::StatusOr<absl::string_view> approx_bounds_summary =
+        reader->ReadBytes();
+    RETURN_IF_ERROR(approx_bounds_summary.status());
+    RETURN_IF_ERROR(reader->Finish());
+
+    // Merging the approx bounds validates its summary before changing any
+    // state, so the partial sums are only added once it succeeded.
+    RETURN_IF_ERROR(approx_bounds_->MergeFromBinary(*approx_bounds_summary));
+    for (int i = 0; i < pos_sum_.size(); ++i) {
+      pos_sum_[i] += (*pos_sum)[i];
+    }
+    for (int i = 0; i < neg_sum_.size(); ++i) {
+      neg_sum_[i] += (*neg_sum)[i];
+    }
     return absl::OkStatus();
   }
 
@@ -316,8 +740,9 @@ class BoundedSumWithApproxBounds : public BoundedSum<T> {
   }
 
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(BoundedSum<T>);
-    memory += sizeof(T) * (pos_sum_.capacity() + neg_sum_.capacity());
+    int64_t memory =
+        sizeof(BoundedSumWithApproxBounds<T, Accumulator>) +
+        memory_.bytes_allocated();
     memory += approx_bounds_->MemoryUsed();
     memory += sizeof(*mechanism_builder_);
     return memory;
@@ -355,29 +780,31 @@ class BoundedSumWithApproxBounds : public BoundedSum<T> {
 
     // Construct NumericalMechanism.
     ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mechanism,
-                     BoundedSum<T>::BuildMechanism(
+                     (BoundedSum<T, Accumulator>::BuildMechanism(
                          mechanism_builder_->Clone(), GetAggregationEpsilon(),
                          Algorithm<T>::GetDelta(), l0_sensitivity_,
-                         max_contributions_per_partition_, lower, upper));
+                         max_contributions_per_partition_, lower, upper)));
 
     // To find the sum, pass the identity function as the transform. We pass
     // count = 0 because the count should never be used.
     ASSIGN_OR_RETURN(
-        T sum, approx_bounds_->template ComputeFromPartials<T>(
-                   pos_sum_, neg_sum_, [](T x) { return x; }, lower, upper, 0));
+        Accumulator sum,
+        approx_bounds_->template ComputeFromPartials<Accumulator>(
+            pos_sum_, neg_sum_, [](T x) -> Accumulator { return x; }, lower,
+            upper, 0));
 
     // Add noise and confidence interval to the sum output. Use the remaining
     // privacy budget.
-    T noisy_sum = mechanism->AddNoise(sum);
+    Accumulator noisy_sum = mechanism->AddNoise(sum);
     absl::StatusOr<ConfidenceInterval> interval =
         mechanism->NoiseConfidenceInterval(noise_interval_level);
 
     Output output;
 
     if (interval.ok()) {
-      output = MakeOutput<T>(noisy_sum, interval.value());
+      output = MakeOutput<Accumulator>(noisy_sum, interval.value());
     } else {
-      output = MakeOutput<T>(noisy_sum);
+      output = MakeOutput<Accumulator>(noisy_sum);
     }
 
     // Populate the bounding report with ApproxBounds information.
@@ -394,8 +821,142 @@ class BoundedSumWithApproxBounds : public BoundedSum<T> {
   }
 
  private:
+  // Packed field of the compact partial sums of the accumulator type.
+  using CompactSums = google::protobuf::RepeatedField<
+      std::conditional_t<std::is_integral_v<Accumulator>, int64_t, double>>;
+
+  template <typename Allocator>
+  static void AppendCompactSums(
+      const std::vector<Accumulator, Allocator>& partial_sums,
+      CompactSums* compact_sums) {
+    size_t size = partial_sums.size();
+    while (size > 0 && partial_sums[size - 1] == 0) {
+      --size;
+    }
+    compact_sums->Reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      compact_sums->Add(partial_sums[i]);
+    }
+  }
+
+  template <typename Allocator>
+  static void AddCompactSums(const CompactSums& compact_sums,
+                             std::vector<Accumulator, Allocator>* partial_sums) {
+    for (int i = 0; i < compact_sums.size(); ++i) {
+      (*partial_sums)[i] += static_cast<Accumulator>(compact_sums[i]);
+    }
+  }
+
+  // Same as Merge for a serialized BoundedSumSummary, which is validated in a
+  // first pass and added in a second one. Returns false and leaves the state
+  // unchanged if the summary is malformed or invalid, or if the approx bounds
+  // summary cannot be merged from its bytes.
+  bool MergeBoundedSumBytes(absl::string_view payload) {
+    // Number of dense partial sums (fields 1 and 2) and of compact partial
+    // sums (fields 12 to 15).
+    int dense_sizes[2] = {0, 0};
+    int compact_sizes[4] = {0, 0, 0, 0};
+    bool has_bounds = false;
+    absl::string_view bounds;
+    internal::WireReader reader(payload);
+    while (!reader.empty()) {
+      int field;
+      internal::WireType wire_type;
+      if (!reader.ReadTag(&field, &wire_type)) return false;
+      if ((field == 1 || field == 2) &&
+          wire_type == internal::WireType::kLengthDelimited) {
+        absl::string_view value;
+        Accumulator ignored;
+        if (!reader.ReadLengthDelimited(&value) ||
+            !internal::ReadValueType(value, &ignored)) {
+          return false;
+        }
+        ++dense_sizes[field - 1];
+      } else if (field == 3 &&
+                 wire_type == internal::WireType::kLengthDelimited) {
+        if (has_bounds || !reader.ReadLengthDelimited(&bounds)) return false;
+        has_bounds = true;
+      } else if (field >= 12 && field <= 15) {
+        int& size = compact_sizes[field - 12];
+        auto count = [&size](auto) { ++size; };
+        if (!(field <= 13
+                  ? internal::ForEachVarint(reader, wire_type, count)
+                  : internal::ForEachDouble(reader, wire_type, count))) {
+          return false;
+        }
+      } else if (!reader.SkipField(wire_type)) {
+        return false;
+      }
+    }
+    const int max_size = pos_sum_.size();
+    const bool integral = std::is_integral_v<Accumulator>;
+    const bool compact = dense_sizes[0] == 0 && dense_sizes[1] == 0;
+    if (!has_bounds ||
+        (compact && (compact_sizes[0] > (integral ? max_size : 0) ||
+                     compact_sizes[1] > (integral ? max_size : 0) ||
+                     compact_sizes[2] > (integral ? 0 : max_size) ||
+                     compact_sizes[3] > (integral ? 0 : max_size))) ||
+        (!compact && (dense_sizes[0] != pos_sum_.size() ||
+                      dense_sizes[1] != neg_sum_.size()))) {
+      return false;
+    }
+    // Like in Merge, the partial sums are only added once the approx bounds
+    // were merged.
+    if (!approx_bounds_->MergeApproxBoundsBytes(bounds)) return false;
+
+    // The summary is valid, so the second pass cannot fail.
+    int indices[2] = {0, 0};
+    internal::WireReader adder(payload);
+    while (!adder.empty()) {
+      int field;
+      internal::WireType wire_type;
+      adder.ReadTag(&field, &wire_type);
+      const int sign = field == 1 || field == 12 || field == 14 ? 0 : 1;
+      auto& sums = sign == 0 ? pos_sum_ : neg_sum_;
+      int& i = indices[sign];
+      if (!compact && (field == 1 || field == 2) &&
+          wire_type == internal::WireType::kLengthDelimited) {
+        absl::string_view value;
+        Accumulator sum;
+        adder.ReadLengthDelimited(&value);
+        internal::ReadValueType(value, &sum);
+        sums[i++] += sum;
+      } else if (compact && integral && (field == 12 || field == 13)) {
+        internal::ForEachVarint(adder, wire_type, [&sums, &i](uint64_t sum) {
+          sums[i++] += static_cast<Accumulator>(internal::ZigZagDecode64(sum));
+        });
+      } else if (compact && !integral && (field == 14 || field == 15)) {
+        internal::ForEachDouble(adder, wire_type, [&sums, &i](double sum) {
+          sums[i++] += static_cast<Accumulator>(sum);
+        });
+      } else {
+        adder.SkipField(wire_type);
+      }
+    }
+    return true;
+  }
+
+  // Checks that the compact partial sums fit into the partial sums of this
+  // BoundedSum and are of the type of its accumulator.
+  absl::Status CheckCompactSums(const BoundedSumSummary& bs_summary) const {
+    const int max_size = pos_sum_.size();
+    const bool integral = std::is_integral_v<Accumulator>;
+    if (bs_summary.compact_pos_int_sum_size() > (integral ? max_size : 0) ||
+        bs_summary.compact_neg_int_sum_size() > (integral ? max_size : 0) ||
+        bs_summary.compact_pos_float_sum_size() > (integral ? 0 : max_size) ||
+        bs_summary.compact_neg_float_sum_size() > (integral ? 0 : max_size)) {
+      return absl::InternalError(
+          "Merged BoundedSum must have the same amount and type of partial "
+          "sum values as this BoundedSum.");
+    }
+    return absl::OkStatus();
+  }
+
+  // Tracks the allocations of the vectors below for MemoryUsed.
+  base::TrackingMemoryResource memory_;
+
   // Vectors of partial values stored for automatic clamping.
-  std::vector<T> pos_sum_, neg_sum_;
+  std::pmr::vector<Accumulator> pos_sum_, neg_sum_;
 
   // Used to construct the numerical mechanism once bounds are obtained.
   std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_;
@@ -406,54 +967,152 @@ class BoundedSumWithApproxBounds : public BoundedSum<T> {
   std::unique_ptr<ApproxBounds<T>> approx_bounds_;
 };
 
-template <typename T>
-class BoundedSum<T>::Builder {
+// Created by Builder::BuildPrototype. New() returns a new BoundedSum for the
+// parameters of the builder without validating them or building a mechanism
+// again, which makes creating an instance as cheap as a single allocation.
+//
+// All instances share the mechanism of the prototype. Instances can be used
+// on different threads as long as the mechanism supports concurrent use, which
+// is the case for the Laplace and Gaussian mechanisms. Every instance spends
+// the budget of the builder on its own data, like built instances.
+template <typename T, typename Accumulator>
+class BoundedSum<T, Accumulator>::Prototype {
  public:
-  BoundedSum<T>::Builder& SetEpsilon(double epsilon) {
+  // Returns a new instance without entries.
+  std::unique_ptr<BoundedSum<T, Accumulator>> New() const {
+    return std::make_unique<BoundedSumWithFixedBounds<T, Accumulator>>(
+        epsilon_, delta_, lower_, upper_, mechanism_, granularity_);
+  }
+
+  double GetEpsilon() const { return epsilon_; }
+  double GetDelta() const { return delta_; }
+  T lower() const { return lower_; }
+  T upper() const { return upper_; }
+
+ private:
+  friend class Builder;
+
+  Prototype(double epsilon, double delta, T lower, T upper,
+            std::shared_ptr<NumericalMechanism> mechanism, double granularity)
+      : epsilon_(epsilon),
+        delta_(delta),
+        lower_(lower),
+        upper_(upper),
+        mechanism_(std::move(mechanism)),
+        granularity_(granularity) {}
+
+  double epsilon_;
+  double delta_;
+  T lower_;
+  T upper_;
+  std::shared_ptr<NumericalMechanism> mechanism_;
+  double granularity_;
+};
+
+template <typename T, typename Accumulator>
+class BoundedSum<T, Accumulator>::Builder {
+ public:
+  BoundedSum<T, Accumulator>::Builder& SetEpsilon(double epsilon) {
     epsilon_ = epsilon;
     return *this;
   }
 
-  BoundedSum<T>::Builder& SetDelta(double delta) {
+  BoundedSum<T, Accumulator>::Builder& SetDelta(double delta) {
     delta_ = delta;
     return *this;
   }
 
-  BoundedSum<T>::Builder& SetMaxPartitionsContributed(
+  BoundedSum<T, Accumulator>::Builder& SetMaxPartitionsContributed(
       int max_partitions_contributed) {
     max_partitions_contributed_ = max_partitions_contributed;
     return *this;
   }
 
-  BoundedSum<T>::Builder& SetMaxContributionsPerPartition(
+  BoundedSum<T, Accumulator>::Builder& SetMaxContributionsPerPartition(
       int max_contributions_per_partition) {
     max_contributions_per_partition_ = max_contributions_per_partition;
     return *this;
   }
 
-  BoundedSum<T>::Builder& SetUpper(T upper) {
+  BoundedSum<T, Accumulator>::Builder& SetUpper(T upper) {
     upper_ = upper;
     return *this;
   }
 
-  BoundedSum<T>::Builder& SetLower(T lower) {
+  BoundedSum<T, Accumulator>::Builder& SetLower(T lower) {
     lower_ = lower;
     return *this;
   }
 
-  BoundedSum<T>::Builder& SetApproxBounds(
+  BoundedSum<T, Accumulator>::Builder& SetApproxBounds(
       std::unique_ptr<ApproxBounds<T>> approx_bounds) {
     approx_bounds_ = std::move(approx_bounds);
     return *this;
   }
 
-  BoundedSum<T>::Builder& SetLaplaceMechanism(
+  BoundedSum<T, Accumulator>::Builder& SetLaplaceMechanism(
       std::unique_ptr<NumericalMechanismBuilder> builder) {
     mechanism_builder_ = std::move(builder);
     return *this;
   }
 
-  absl::StatusOr<std::unique_ptr<BoundedSum<T>>> Build() {
+  // Rounds the clamped entries of floating point sums to multiples of
+  // `granularity` and sums them exactly in 128-bit integers. The sum then
+  // does not depend on the order of the entries or on how partial sums were
+  // merged, and batches are summed in vectorized integer arithmetic. Entries
+  // are clamped to the multiples of the granularity within the bounds, so
+  // that the sensitivity is unchanged.
+  //
+  // The granularity must be a power of two, so that scaling by it is exact,
+  // and the bounds must not exceed 2^50 times the granularity. Requires fixed
+  // bounds. Summaries only merge into sums with the same granularity.
+  BoundedSum<T, Accumulator>::Builder& SetFixedPointGranularity(
+      double granularity) {
+    granularity_ = granularity;
+    return *this;
+  }
+
+  // Allocates the partial sums and, unless an ApproxBounds is set, the
+  // histogram bins of automatic bounding from `memory_resource`. With many
+  // partitions, pass e.g. one std::pmr::monotonic_buffer_resource per batch of
+  // partitions to keep their buffers contiguous and release them at once. The
+  // resource must outlive the built algorithm. Has no effect for fixed bounds,
+  // which do not allocate buffers.
+  BoundedSum<T, Accumulator>::Builder& SetMemoryResource(
+      std::pmr::memory_resource* memory_resource) {
+    memory_resource_ = memory_resource;
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<BoundedSum<T, Accumulator>>> Build() {
+    RETURN_IF_ERROR(Validate());
+    if (upper_.has_value() && lower_.has_value()) {
+      return BuildSumWithFixedBounds();
+    }
+    return BuildSumWithApproxBounds();
+  }
+
+  // Validates the parameters and builds the mechanism once for a Prototype.
+  // Requires fixed bounds, since automatic bounds are inferred per instance.
+  absl::StatusOr<Prototype> BuildPrototype() {
+    RETURN_IF_ERROR(Validate());
+    if (!upper_.has_value() || !lower_.has_value()) {
+      return absl::InvalidArgumentError(
+          "A BoundedSum prototype requires both the lower and the upper bound "
+          "to be set.");
+    }
+    ASSIGN_OR_RETURN(
+        std::unique_ptr<NumericalMechanism> mechanism,
+        BuildMechanism(mechanism_builder_->Clone(), epsilon_.value(), delta_,
+                       max_partitions_contributed_,
+                       max_contributions_per_partition_, lower_.value(),
+                       upper_.value()));
+    return Prototype(epsilon_.value(), delta_, lower_.value(), upper_.value(),
+                     std::move(mechanism), granularity_.value_or(0));
+  }
+
+ private:
+  absl::Status Validate() {
     if (!epsilon_.has_value()) {
       epsilon_ = DefaultEpsilon();
       LOG(WARNING) << "Default epsilon of " << epsilon_.value()
@@ -470,24 +1129,62 @@ class BoundedSum<T>::Builder {
         ValidateMaxPartitionsContributed(max_partitions_contributed_));
     RETURN_IF_ERROR(
         ValidateMaxContributionsPerPartition(max_contributions_per_partition_));
-    if (upper_.has_value() && lower_.has_value()) {
-      return BuildSumWithFixedBounds();
+    if (granularity_.has_value()) {
+      RETURN_IF_ERROR(ValidateFixedPointGranularity());
     }
-    return BuildSumWithApproxBounds();
+    return absl::OkStatus();
+  }
+
+  absl::Status ValidateFixedPointGranularity() const {
+    if (!std::is_floating_point_v<T>) {
+      return absl::InvalidArgumentError(
+          "Fixed point accumulation is only supported for floating point "
+          "entries.");
+    }
+    const double granularity = granularity_.value();
+    int exponent;
+    if (!std::isfinite(granularity) || granularity <= 0 ||
+        std::frexp(granularity, &exponent) != 0.5 ||
+        !std::isfinite(1 / granularity)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Fixed point granularity must be a positive power of two, but is ",
+          granularity, "."));
+    }
+    if (!upper_.has_value() || !lower_.has_value()) {
+      return absl::InvalidArgumentError(
+          "Fixed point accumulation requires both the lower and the upper "
+          "bound to be set.");
+    }
+    const double lower = static_cast<double>(lower_.value());
+    const double upper = static_cast<double>(upper_.value());
+    if (std::max(std::abs(lower), std::abs(upper)) / granularity > 0x1p50) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Bounds must not exceed 2^50 times the fixed point granularity of ",
+          granularity, "."));
+    }
+    if (std::ceil(lower / granularity) > std::floor(upper / granularity)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Bounds must contain a multiple of the fixed point granularity of ",
+          granularity, "."));
+    }
+    return absl::OkStatus();
   }
 
- private:
   std::optional<double> epsilon_;
   double delta_ = 0;
   std::optional<T> upper_;
   std::optional<T> lower_;
+  std::optional<double> granularity_;
   int max_partitions_contributed_ = 1;
   int max_contributions_per_partition_ = 1;
   std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
       std::make_unique<LaplaceMechanism::Builder>();
   std::unique_ptr<ApproxBounds<T>> approx_bounds_;
+  std::pmr::memory_resource* memory_resource_ =
+      std::pmr::get_default_resource();
 
-  absl::StatusOr<std::unique_ptr<BoundedSum<T>>> BuildSumWithFixedBounds() {
+  absl::StatusOr<std::unique_ptr<BoundedSum<T, Accumulator>>>
+  BuildSumWithFixedBounds() {
     ASSIGN_OR_RETURN(
         std::unique_ptr<NumericalMechanism> mechanism,
         BuildMechanism(mechanism_builder_->Clone(), epsilon_.value(), delta_,
@@ -495,13 +1192,14 @@ class BoundedSum<T>::Builder {
                        max_contributions_per_partition_, lower_.value(),
                        upper_.value()));
 
-    return absl::StatusOr<std::unique_ptr<BoundedSum<T>>>(
-        std::make_unique<BoundedSumWithFixedBounds<T>>(
+    return absl::StatusOr<std::unique_ptr<BoundedSum<T, Accumulator>>>(
+        std::make_unique<BoundedSumWithFixedBounds<T, Accumulator>>(
             epsilon_.value(), delta_, lower_.value(), upper_.value(),
-            std::move(mechanism)));
+            std::move(mechanism), granularity_.value_or(0)));
   }
 
-  absl::StatusOr<std::unique_ptr<BoundedSum<T>>> BuildSumWithApproxBounds() {
+  absl::StatusOr<std::unique_ptr<BoundedSum<T, Accumulator>>>
+  BuildSumWithApproxBounds() {
     if (!approx_bounds_) {
       ASSIGN_OR_RETURN(
           approx_bounds_,
@@ -510,6 +1208,7 @@ class BoundedSum<T>::Builder {
               .SetLaplaceMechanism(mechanism_builder_->Clone())
               .SetMaxContributionsPerPartition(max_contributions_per_partition_)
               .SetMaxPartitionsContributed(max_partitions_contributed_)
+              .SetMemoryResource(memory_resource_)
               .Build());
     }
     if (epsilon_.value() <= approx_bounds_->GetEpsilon()) {
@@ -520,14 +1219,23 @@ class BoundedSum<T>::Builder {
           " Approx Bounds Epsilon: ", approx_bounds_->GetEpsilon()));
     }
 
-    return absl::StatusOr<std::unique_ptr<BoundedSum<T>>>(
-        std::make_unique<BoundedSumWithApproxBounds<T>>(
+    return absl::StatusOr<std::unique_ptr<BoundedSum<T, Accumulator>>>(
+        std::make_unique<BoundedSumWithApproxBounds<T, Accumulator>>(
             epsilon_.value(), delta_, max_partitions_contributed_,
             max_contributions_per_partition_, mechanism_builder_->Clone(),
-            std::move(approx_bounds_)));
+            std::move(approx_bounds_), memory_resource_));
   }
 };
 
+// Instantiated once in bounded-sum.cc for the most common entry types,
+// instead of in every translation unit that uses them.
+extern template class BoundedSum<int64_t>;
+extern template class BoundedSum<double>;
+extern template class BoundedSumWithFixedBounds<int64_t>;
+extern template class BoundedSumWithFixedBounds<double>;
+extern template class BoundedSumWithApproxBounds<int64_t>;
+extern template class BoundedSumWithApproxBounds<double>;
+
 }  // namespace differential_privacy
 
 #endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_BOUNDED_SUM_H_
@@ -20,6 +20,9 @@
 #include <cstdlib>
 #include <limits>
 #include <memory>
+#include <memory_resource>
+#include <string>
+#include <variant>
 #include <vector>
 
 #include "base/testing/proto_matchers.h"
@@ -50,6 +53,30 @@ using ::differential_privacy::base::testing::StatusIs;
 constexpr double kNumSamples = 10000;
 constexpr double kDefaultEpsilon = 1.1;
 
+// Forwards to the new/delete resource and tracks the bytes currently allocated.
+class CountingMemoryResource : public std::pmr::memory_resource {
+ public:
+  int64_t bytes_in_use() const { return bytes_in_use_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    bytes_in_use_ += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    bytes_in_use_ -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  int64_t bytes_in_use_ = 0;
+};
+
 template <typename T>
 class BoundedSumTest : public ::testing::Test {
  protected:
@@ -432,6 +459,293 @@ TYPED_TEST(BoundedSumTest, SerializeMergePartialSumsTest) {
   EXPECT_EQ(GetValue<TypeParam>(*output1), GetValue<TypeParam>(*output2));
 }
 
+TYPED_TEST(BoundedSumTest, SerializeToBinaryMergeTest) {
+  typename BoundedSum<TypeParam>::Builder builder;
+
+  auto bs1 =
+      builder.SetLower(0)
+          .SetUpper(3)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(bs1);
+  (*bs1)->AddEntry(2);
+  std::string binary_summary = (*bs1)->SerializeToBinary();
+  (*bs1)->AddEntry(6);
+
+  auto bs2 = builder.Build();
+  ASSERT_OK(bs2);
+  (*bs2)->AddEntry(6);
+  EXPECT_OK((*bs2)->MergeFromBinary(binary_summary));
+
+  auto output1 = (*bs1)->PartialResult();
+  ASSERT_OK(output1);
+  auto output2 = (*bs2)->PartialResult();
+  ASSERT_OK(output2);
+  EXPECT_EQ(GetValue<TypeParam>(*output1), GetValue<TypeParam>(*output2));
+}
+
+TYPED_TEST(BoundedSumTest, SerializeToBinaryMergePartialSumsTest) {
+  typename ApproxBounds<TypeParam>::Builder bounds_builder;
+  typename BoundedSum<TypeParam>::Builder builder;
+
+  auto bounds1 =
+      bounds_builder.SetThresholdForTest(0.5)
+          .SetEpsilon(kDefaultEpsilon / 2)
+          .SetNumBins(50)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(bounds1);
+  auto bs1 =
+      builder.SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetApproxBounds(std::move(*bounds1))
+          .Build();
+  ASSERT_OK(bs1);
+  (*bs1)->AddEntry(-10);
+  (*bs1)->AddEntry(4);
+  std::string binary_summary = (*bs1)->SerializeToBinary();
+  (*bs1)->AddEntry(6);
+
+  auto bounds2 = bounds_builder.Build();
+  ASSERT_OK(bounds2);
+  auto bs2 = builder.SetApproxBounds(std::move(*bounds2)).Build();
+  ASSERT_OK(bs2);
+  (*bs2)->AddEntry(6);
+  EXPECT_OK((*bs2)->MergeFromBinary(binary_summary));
+
+  // The binary summary must produce the same state as the proto summary.
+  EXPECT_THAT((*bs2)->Serialize(), EqualsProto((*bs1)->Serialize()));
+  auto output1 = (*bs1)->PartialResult();
+  ASSERT_OK(output1);
+  auto output2 = (*bs2)->PartialResult();
+  ASSERT_OK(output2);
+  EXPECT_EQ(GetValue<TypeParam>(*output1), GetValue<TypeParam>(*output2));
+}
+
+TYPED_TEST(BoundedSumTest, SerializeCompactMergePartialSumsTest) {
+  typename ApproxBounds<TypeParam>::Builder bounds_builder;
+  typename BoundedSum<TypeParam>::Builder builder;
+
+  auto bounds1 =
+      bounds_builder.SetThresholdForTest(0.5)
+          .SetEpsilon(kDefaultEpsilon / 2)
+          .SetNumBins(50)
+          .SetScale(1)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(bounds1);
+  auto bs1 =
+      builder.SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetApproxBounds(std::move(*bounds1))
+          .Build();
+  ASSERT_OK(bs1);
+  (*bs1)->AddEntry(-10);
+  (*bs1)->AddEntry(4);
+  const Summary compact = (*bs1)->SerializeCompact();
+  (*bs1)->AddEntry(6);
+
+  auto bounds2 = bounds_builder.Build();
+  ASSERT_OK(bounds2);
+  auto bs2 = builder.SetApproxBounds(std::move(*bounds2)).Build();
+  ASSERT_OK(bs2);
+  (*bs2)->AddEntry(6);
+  EXPECT_OK((*bs2)->Merge(compact));
+
+  // The compact summary must produce the same state as the proto summary, and
+  // be smaller.
+  EXPECT_THAT((*bs2)->Serialize(), EqualsProto((*bs1)->Serialize()));
+  EXPECT_LT(compact.ByteSizeLong() * 5, (*bs1)->Serialize().ByteSizeLong());
+  auto output1 = (*bs1)->PartialResult();
+  ASSERT_OK(output1);
+  auto output2 = (*bs2)->PartialResult();
+  ASSERT_OK(output2);
+  EXPECT_EQ(GetValue<TypeParam>(*output1), GetValue<TypeParam>(*output2));
+}
+
+TYPED_TEST(BoundedSumTest, MergeFromBytesMatchesMerge) {
+  typename ApproxBounds<TypeParam>::Builder bounds_builder;
+  bounds_builder.SetThresholdForTest(0.5)
+      .SetEpsilon(kDefaultEpsilon / 2)
+      .SetNumBins(50)
+      .SetScale(1)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>());
+  typename BoundedSum<TypeParam>::Builder builder;
+  builder.SetEpsilon(kDefaultEpsilon)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>());
+  auto make_sum = [&]() {
+    auto bounds = bounds_builder.Build();
+    EXPECT_OK(bounds);
+    return builder.SetApproxBounds(std::move(*bounds)).Build();
+  };
+  auto source = make_sum();
+  ASSERT_OK(source);
+  (*source)->AddEntry(-10);
+  (*source)->AddEntry(4);
+  (*source)->AddEntry(7);
+
+  for (const Summary& summary :
+       {(*source)->Serialize(), (*source)->SerializeCompact()}) {
+    auto merged = make_sum();
+    ASSERT_OK(merged);
+    auto parsed = make_sum();
+    ASSERT_OK(parsed);
+    (*merged)->AddEntry(3);
+    (*parsed)->AddEntry(3);
+    EXPECT_OK((*merged)->MergeFromBytes(summary.SerializeAsString()));
+    EXPECT_OK((*parsed)->Merge(summary));
+    EXPECT_THAT((*merged)->Serialize(), EqualsProto((*parsed)->Serialize()));
+  }
+
+  auto fixed = typename BoundedSum<TypeParam>::Builder()
+                   .SetEpsilon(kDefaultEpsilon)
+                   .SetLower(0)
+                   .SetUpper(10)
+                   .SetLaplaceMechanism(
+                       std::make_unique<ZeroNoiseMechanism::Builder>())
+                   .Build();
+  ASSERT_OK(fixed);
+  (*fixed)->AddEntry(2);
+  const std::string fixed_bytes = (*fixed)->Serialize().SerializeAsString();
+  EXPECT_OK((*fixed)->MergeFromBytes(fixed_bytes));
+  absl::StatusOr<Output> result = (*fixed)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<TypeParam>(*result), 4);
+}
+
+TEST(BoundedSumTest, MergeFromBytesRejectsInvalidSummaries) {
+  auto bs = BoundedSum<int64_t>::Builder().SetEpsilon(1).Build();
+  ASSERT_OK(bs);
+  (*bs)->AddEntry(5);
+  const Summary before = (*bs)->Serialize();
+
+  BoundedSumSummary too_few_sums;
+  (*bs)->Serialize().data().UnpackTo(&too_few_sums);
+  too_few_sums.mutable_pos_sum()->RemoveLast();
+  Summary summary;
+  summary.mutable_data()->PackFrom(too_few_sums);
+  EXPECT_THAT((*bs)->MergeFromBytes(summary.SerializeAsString()),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("same amount of partial sum")));
+
+  BoundedSumSummary bad_bounds;
+  (*bs)->SerializeCompact().data().UnpackTo(&bad_bounds);
+  bad_bounds.mutable_bounds_summary()->set_num_bins(3);
+  summary.mutable_data()->PackFrom(bad_bounds);
+  EXPECT_THAT((*bs)->MergeFromBytes(summary.SerializeAsString()),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("same number of bin counts")));
+
+  const std::string truncated = before.SerializeAsString().substr(0, 20);
+  EXPECT_THAT((*bs)->MergeFromBytes(truncated),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT((*bs)->Serialize(), EqualsProto(before));
+}
+
+TEST(BoundedSumTest, MergeCompactSummaryOfOtherTypeFails) {
+  auto double_sum = BoundedSum<double>::Builder().SetEpsilon(1).Build();
+  ASSERT_OK(double_sum);
+  (*double_sum)->AddEntry(5);
+  auto int_sum = BoundedSum<int64_t>::Builder().SetEpsilon(1).Build();
+  ASSERT_OK(int_sum);
+  const Summary before = (*int_sum)->Serialize();
+
+  EXPECT_THAT((*int_sum)->Merge((*double_sum)->SerializeCompact()),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("type of partial sum")));
+  EXPECT_THAT((*int_sum)->Serialize(), EqualsProto(before));
+}
+
+TYPED_TEST(BoundedSumTest, SerializeCompactWithFixedBoundsIsSerialize) {
+  auto bs = typename BoundedSum<TypeParam>::Builder()
+                .SetEpsilon(kDefaultEpsilon)
+                .SetLower(0)
+                .SetUpper(3)
+                .Build();
+  ASSERT_OK(bs);
+  (*bs)->AddEntry(2);
+  EXPECT_THAT((*bs)->SerializeCompact(), EqualsProto((*bs)->Serialize()));
+}
+
+TEST(BoundedSumTest, MergeFromBinaryRejectsIncompatibleSummaries) {
+  auto fixed = BoundedSum<int64_t>::Builder()
+                   .SetEpsilon(kDefaultEpsilon)
+                   .SetLower(0)
+                   .SetUpper(3)
+                   .Build();
+  ASSERT_OK(fixed);
+  auto automatic =
+      BoundedSum<int64_t>::Builder().SetEpsilon(kDefaultEpsilon).Build();
+  ASSERT_OK(automatic);
+  auto fixed_double = BoundedSum<double>::Builder()
+                          .SetEpsilon(kDefaultEpsilon)
+                          .SetLower(0)
+                          .SetUpper(3)
+                          .Build();
+  ASSERT_OK(fixed_double);
+  (*automatic)->AddEntry(2);
+  const Summary automatic_summary = (*automatic)->Serialize();
+
+  EXPECT_THAT((*fixed)->MergeFromBinary("not a summary"),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("not a binary summary")));
+  EXPECT_THAT(
+      (*automatic)->MergeFromBinary((*fixed)->SerializeToBinary()),
+      StatusIs(absl::StatusCode::kInternal, HasSubstr("different algorithm")));
+  EXPECT_THAT(
+      (*fixed)->MergeFromBinary((*fixed_double)->SerializeToBinary()),
+      StatusIs(absl::StatusCode::kInternal, HasSubstr("different input type")));
+
+  // A truncated summary must not change any state.
+  std::string truncated = (*automatic)->SerializeToBinary();
+  truncated.resize(truncated.size() - 1);
+  EXPECT_THAT((*automatic)->MergeFromBinary(truncated),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("truncated")));
+  EXPECT_THAT((*automatic)->Serialize(), EqualsProto(automatic_summary));
+}
+
+TYPED_TEST(BoundedSumTest, MergeFromMatchesMerge) {
+  for (const bool automatic_bounds : {false, true}) {
+    typename BoundedSum<TypeParam>::Builder builder;
+    builder.SetEpsilon(kDefaultEpsilon);
+    if (!automatic_bounds) {
+      builder.SetLower(-5).SetUpper(5);
+    }
+    auto bs1 = builder.Build();
+    ASSERT_OK(bs1);
+    auto bs2 = builder.Build();
+    ASSERT_OK(bs2);
+    auto bs3 = builder.Build();
+    ASSERT_OK(bs3);
+    for (TypeParam entry : {-10, -1, 0, 3, 20}) {
+      (*bs1)->AddEntry(entry);
+    }
+    (*bs2)->AddEntry(4);
+    (*bs3)->AddEntry(4);
+
+    EXPECT_OK((*bs2)->MergeFrom(**bs1));
+    EXPECT_OK((*bs3)->Merge((*bs1)->Serialize()));
+    EXPECT_THAT((*bs2)->Serialize(), EqualsProto((*bs3)->Serialize()));
+  }
+}
+
+TEST(BoundedSumTest, MergeFromDifferentBoundingStrategyFails) {
+  auto fixed = BoundedSum<int64_t>::Builder()
+                   .SetEpsilon(kDefaultEpsilon)
+                   .SetLower(0)
+                   .SetUpper(3)
+                   .Build();
+  ASSERT_OK(fixed);
+  auto automatic =
+      BoundedSum<int64_t>::Builder().SetEpsilon(kDefaultEpsilon).Build();
+  ASSERT_OK(automatic);
+
+  EXPECT_THAT((*fixed)->MergeFrom(**automatic),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT((*automatic)->MergeFrom(**fixed),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
 TEST(BoundedSumTest, OverflowFromAddNoiseTypeCast) {
   // Overflowing should result in the sum + noise eventually wrapping around and
   // become negative.
@@ -477,6 +791,24 @@ TEST(BoundedSumTest, OverflowAddEntryManualBounds) {
   EXPECT_EQ(GetValue<int64_t>(result.value()), 0);
 }
 
+TEST(BoundedSumTest, OverflowAddEntriesManualBounds) {
+  absl::StatusOr<std::unique_ptr<BoundedSum<int64_t>>> bs =
+      BoundedSum<int64_t>::Builder()
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetLower(0)
+          .SetUpper(std::numeric_limits<int64_t>::max())
+          .Build();
+  ASSERT_OK(bs);
+  const std::vector<int64_t> entries = {std::numeric_limits<int64_t>::max(), 1,
+                                        1, std::numeric_limits<int64_t>::max()};
+  (*bs)->AddEntries(entries);
+
+  absl::StatusOr<Output> result = (*bs)->PartialResult();
+  ASSERT_OK(result);
+  // Same wrap around as with AddEntry.
+  EXPECT_EQ(GetValue<int64_t>(result.value()), 0);
+}
+
 TEST(BoundedSumTest, UnderflowAddEntryManualBounds) {
   typename BoundedSum<int64_t>::Builder builder;
 
@@ -608,6 +940,127 @@ TEST(BoundedSumTest, DropNanEntriesApproxBounds) {
   EXPECT_DOUBLE_EQ(GetValue<double>(*output), 1.0);
 }
 
+TYPED_TEST(BoundedSumTest, AddEntriesMatchesAddEntryWithApproxBounds) {
+  typename BoundedSum<TypeParam>::Builder builder;
+  builder.SetEpsilon(kDefaultEpsilon)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<BoundedSum<TypeParam>>> batched =
+      builder.Build();
+  ASSERT_OK(batched);
+  absl::StatusOr<std::unique_ptr<BoundedSum<TypeParam>>> sequential =
+      builder.Build();
+  ASSERT_OK(sequential);
+  std::vector<TypeParam> inputs = {0, 1, -1, 7, -7, 1000, -3, 123456, 64};
+  for (int i = -50; i <= 50; ++i) {
+    inputs.push_back(i * i * i);
+  }
+
+  (*batched)->AddEntries(inputs);
+  for (const TypeParam& input : inputs) {
+    (*sequential)->AddEntry(input);
+  }
+
+  // All partial sums are integral and exact, so the summaries are equal.
+  EXPECT_THAT((*batched)->Serialize(),
+              EqualsProto((*sequential)->Serialize()));
+}
+
+TYPED_TEST(BoundedSumTest, AddEntriesMatchesAddEntryWithFixedBounds) {
+  typename BoundedSum<TypeParam>::Builder builder;
+  builder.SetEpsilon(kDefaultEpsilon)
+      .SetLower(-100)
+      .SetUpper(1000)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<BoundedSum<TypeParam>>> batched =
+      builder.Build();
+  ASSERT_OK(batched);
+  absl::StatusOr<std::unique_ptr<BoundedSum<TypeParam>>> sequential =
+      builder.Build();
+  ASSERT_OK(sequential);
+  std::vector<TypeParam> inputs;
+  for (int i = -50; i <= 50; ++i) {
+    inputs.push_back(static_cast<TypeParam>(i * i * i) / 7);
+  }
+
+  (*batched)->AddEntries(inputs.begin(), inputs.end());
+  for (const TypeParam& input : inputs) {
+    (*sequential)->AddEntry(input);
+  }
+
+  absl::StatusOr<Output> batched_result = (*batched)->PartialResult();
+  ASSERT_OK(batched_result);
+  absl::StatusOr<Output> sequential_result = (*sequential)->PartialResult();
+  ASSERT_OK(sequential_result);
+  // Floating point sums are vectorized and may differ by rounding.
+  EXPECT_NEAR(GetValue<TypeParam>(*batched_result),
+              GetValue<TypeParam>(*sequential_result), 1e-9);
+}
+
+TEST(BoundedSumTest, AddEntriesWithFixedBoundsClampsEntries) {
+  absl::StatusOr<std::unique_ptr<BoundedSum<double>>> bs =
+      BoundedSum<double>::Builder()
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLower(-1)
+          .SetUpper(2)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(bs);
+  std::vector<double> inputs = {-5, 1, 5, std::nan("")};
+  (*bs)->AddEntries(inputs);
+  absl::StatusOr<Output> result = (*bs)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_DOUBLE_EQ(GetValue<double>(*result), 2.0);
+}
+
+TEST(BoundedSumTest, AllocatesBuffersFromMemoryResource) {
+  CountingMemoryResource resource;
+  {
+    auto bounds =
+        ApproxBounds<double>::Builder()
+            .SetEpsilon(kDefaultEpsilon / 2)
+            .SetNumBins(4)
+            .SetBase(2)
+            .SetScale(1)
+            .SetThresholdForTest(0.5)
+            .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+            .SetMemoryResource(&resource)
+            .Build();
+    ASSERT_OK(bounds);
+    auto bs =
+        BoundedSum<double>::Builder()
+            .SetEpsilon(kDefaultEpsilon)
+            .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+            .SetApproxBounds(std::move(*bounds))
+            .SetMemoryResource(&resource)
+            .Build();
+    ASSERT_OK(bs);
+    // Two histograms of 16-bit counts, the bin boundaries and two partial sums
+    // with 4 bins each.
+    EXPECT_GE(resource.bytes_in_use(),
+              2 * 4 * sizeof(int16_t) + 3 * 4 * sizeof(double));
+
+    // Bounds are set to [-1, 2].
+    std::vector<double> a = {1, -1, 2};
+    auto output = (*bs)->Result(a.begin(), a.end());
+    ASSERT_OK(output);
+    EXPECT_DOUBLE_EQ(GetValue<double>(*output), 2.0);
+  }
+  EXPECT_EQ(resource.bytes_in_use(), 0);
+
+  // The default ApproxBounds uses the memory resource of the sum.
+  auto bs = BoundedSum<int64_t>::Builder()
+                .SetEpsilon(kDefaultEpsilon)
+                .SetMemoryResource(&resource)
+                .Build();
+  ASSERT_OK(bs);
+  const int64_t bytes_for_sum = resource.bytes_in_use();
+  EXPECT_GT(bytes_for_sum, 0);
+  auto bs_without_resource =
+      BoundedSum<int64_t>::Builder().SetEpsilon(kDefaultEpsilon).Build();
+  ASSERT_OK(bs_without_resource);
+  EXPECT_EQ(resource.bytes_in_use(), bytes_for_sum);
+}
+
 TYPED_TEST(BoundedSumTest, PropagateApproxBoundsError) {
   auto bs =
       typename BoundedSum<TypeParam>::Builder()
@@ -925,5 +1378,358 @@ TEST(BoundedSumTest, ApproxBoundsOnInt64LowestUsesFullRangeBounds) {
       std::numeric_limits<int64_t>::max());
 }
 
+TEST(BoundedSumTest, FinalizeResultsMixesDeferredAndApproxBoundsResults) {
+  std::unique_ptr<BoundedSum<double>> fixed_bounds =
+      BoundedSum<double>::Builder()
+          .SetEpsilon(1.0)
+          .SetLower(0)
+          .SetUpper(10)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  std::unique_ptr<BoundedSum<double>> approx_bounds =
+      BoundedSum<double>::Builder()
+          .SetEpsilon(1.0)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetApproxBounds(
+              ApproxBounds<double>::Builder()
+                  .SetEpsilon(0.5)
+                  .SetNumBins(8)
+                  .SetThresholdForTest(0.5)
+                  .SetLaplaceMechanism(
+                      std::make_unique<ZeroNoiseMechanism::Builder>())
+                  .Build()
+                  .value())
+          .Build()
+          .value();
+  std::vector<double> entries = {1.5, 2.5, 20};
+  fixed_bounds->AddEntries(entries.begin(), entries.end());
+  approx_bounds->AddEntries(entries.begin(), entries.end());
+
+  std::vector<BoundedSum<double>::PreparedResult> prepared;
+  prepared.push_back(fixed_bounds->PrepareResult().value());
+  prepared.push_back(approx_bounds->PrepareResult().value());
+  absl::StatusOr<std::vector<Output>> outputs =
+      BoundedSum<double>::FinalizeResults(absl::MakeSpan(prepared));
+  ASSERT_OK(outputs);
+
+  ASSERT_EQ(outputs->size(), 2);
+  EXPECT_DOUBLE_EQ(GetValue<double>((*outputs)[0]), 14);
+  EXPECT_TRUE((*outputs)[1].error_report().has_bounding_report());
+  EXPECT_THAT(fixed_bounds->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(approx_bounds->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TYPED_TEST(BoundedSumTest, PartialScalarResult) {
+  std::vector<TypeParam> a = {1, 2, 3, 4, 20};
+  std::unique_ptr<BoundedSum<TypeParam>> bs =
+      typename BoundedSum<TypeParam>::Builder()
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLower(0)
+          .SetUpper(10)
+          .Build()
+          .value();
+  bs->AddEntries(a.begin(), a.end());
+
+  absl::StatusOr<ScalarResult> result = bs->PartialScalarResult();
+  ASSERT_OK(result);
+  if constexpr (std::is_integral<TypeParam>::value) {
+    EXPECT_EQ(std::get<int64_t>(result->value), 20);
+  } else {
+    EXPECT_DOUBLE_EQ(std::get<double>(result->value), 20);
+  }
+  EXPECT_TRUE(result->noise_confidence_interval.has_value());
+}
+
+// Counts the mechanisms built by it and its clones.
+class CountingMechanismBuilder : public ZeroNoiseMechanism::Builder {
+ public:
+  explicit CountingMechanismBuilder(int* num_builds)
+      : num_builds_(num_builds) {}
+
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override {
+    ++*num_builds_;
+    return ZeroNoiseMechanism::Builder::Build();
+  }
+
+  std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
+    return std::make_unique<CountingMechanismBuilder>(*this);
+  }
+
+ private:
+  int* num_builds_;
+};
+
+TYPED_TEST(BoundedSumTest, PrototypeBuildsMechanismOnce) {
+  int num_builds = 0;
+  absl::StatusOr<typename BoundedSum<TypeParam>::Prototype> prototype =
+      typename BoundedSum<TypeParam>::Builder()
+          .SetLaplaceMechanism(
+              std::make_unique<CountingMechanismBuilder>(&num_builds))
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLower(0)
+          .SetUpper(10)
+          .BuildPrototype();
+  ASSERT_OK(prototype);
+  EXPECT_EQ(prototype->GetEpsilon(), kDefaultEpsilon);
+  EXPECT_EQ(prototype->lower(), 0);
+  EXPECT_EQ(prototype->upper(), 10);
+
+  for (int i = 0; i < 10; ++i) {
+    std::unique_ptr<BoundedSum<TypeParam>> sum = prototype->New();
+    for (int j = 0; j <= i; ++j) {
+      sum->AddEntry(20);
+    }
+    absl::StatusOr<Output> output = sum->PartialResult();
+    ASSERT_OK(output);
+    EXPECT_EQ(GetValue<TypeParam>(*output), 10 * (i + 1));
+    EXPECT_THAT(sum->PartialResult(),
+                StatusIs(absl::StatusCode::kInvalidArgument));
+  }
+  EXPECT_EQ(num_builds, 1);
+}
+
+TYPED_TEST(BoundedSumTest, PrototypeRequiresFixedBounds) {
+  EXPECT_THAT(typename BoundedSum<TypeParam>::Builder()
+                  .SetEpsilon(kDefaultEpsilon)
+                  .BuildPrototype(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("requires both the lower and the upper")));
+  EXPECT_THAT(typename BoundedSum<TypeParam>::Builder()
+                  .SetEpsilon(-1)
+                  .SetLower(0)
+                  .SetUpper(10)
+                  .BuildPrototype(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Epsilon")));
+}
+
+TEST(BoundedSumTest, Int32SummedInInt64DoesNotOverflow) {
+  constexpr int32_t kMax = std::numeric_limits<int32_t>::max();
+  absl::StatusOr<std::unique_ptr<BoundedSum<int32_t, int64_t>>> bs =
+      BoundedSum<int32_t, int64_t>::Builder()
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetLower(0)
+          .SetUpper(kMax)
+          .Build();
+  ASSERT_OK(bs);
+  const std::vector<int32_t> entries(20, kMax);
+  (*bs)->AddEntries(entries);
+  (*bs)->AddEntry(kMax);
+
+  absl::StatusOr<std::unique_ptr<BoundedSum<int32_t, int64_t>>> merged =
+      BoundedSum<int32_t, int64_t>::Builder()
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetLower(0)
+          .SetUpper(kMax)
+          .Build();
+  ASSERT_OK(merged);
+  ASSERT_OK((*merged)->MergeFromBinary((*bs)->SerializeToBinary()));
+  ASSERT_OK((*merged)->Merge((*bs)->Serialize()));
+
+  absl::StatusOr<Output> result = (*merged)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), int64_t{42} * kMax);
+}
+
+TEST(BoundedSumTest, Int32SummedInInt64WithApproxBounds) {
+  absl::StatusOr<std::unique_ptr<ApproxBounds<int32_t>>> bounds =
+      ApproxBounds<int32_t>::Builder()
+          .SetEpsilon(kDefaultEpsilon / 2)
+          .SetThresholdForTest(0.5)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(bounds);
+  absl::StatusOr<std::unique_ptr<BoundedSum<int32_t, int64_t>>> bs =
+      BoundedSum<int32_t, int64_t>::Builder()
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetApproxBounds(*std::move(bounds))
+          .Build();
+  ASSERT_OK(bs);
+  const std::vector<int32_t> entries(10, 1000000000);
+  (*bs)->AddEntries(entries);
+  (*bs)->AddEntry(-1000000000);
+
+  absl::StatusOr<Output> result = (*bs)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), int64_t{9000000000});
+}
+
+TEST(BoundedSumTest, FloatSummedInDouble) {
+  // 2^24 + 1 is not representable as float.
+  constexpr float kLarge = 16777216.0f;
+  absl::StatusOr<std::unique_ptr<BoundedSum<float, double>>> bs =
+      BoundedSum<float, double>::Builder()
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetLower(0)
+          .SetUpper(kLarge)
+          .Build();
+  ASSERT_OK(bs);
+  (*bs)->AddEntry(kLarge);
+  for (int i = 0; i < 4; ++i) {
+    (*bs)->AddEntry(1.0f);
+  }
+  (*bs)->AddEntries(std::vector<float>(4, 1.0f));
+
+  absl::StatusOr<Output> result = (*bs)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<double>(*result), kLarge + 8.0);
+}
+
+// Returns a sum of entries clamped to [-1, 1.9] without noise.
+std::unique_ptr<BoundedSum<double>> BuildFixedPointSum(double granularity) {
+  return BoundedSum<double>::Builder()
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .SetLower(-1)
+      .SetUpper(1.9)
+      .SetFixedPointGranularity(granularity)
+      .Build()
+      .value();
+}
+
+TEST(BoundedSumTest, FixedPointRoundsEntriesToGranularity) {
+  std::unique_ptr<BoundedSum<double>> bs = BuildFixedPointSum(0.25);
+  // Entries are clamped to [-1, 1.75], the multiples of 0.25 within the
+  // bounds, and rounded to the nearest multiple.
+  bs->AddEntry(0.3);
+  bs->AddEntry(0.4);
+  bs->AddEntry(5);
+  bs->AddEntries(std::vector<double>{-5, std::nan(""), 0.125});
+
+  absl::StatusOr<Output> result = bs->PartialResult();
+  ASSERT_OK(result);
+  // 0.25 + 0.5 + 1.75 - 1 + 0, with 0.125 rounded to even.
+  EXPECT_EQ(GetValue<double>(*result), 1.5);
+}
+
+TEST(BoundedSumTest, FixedPointSumDoesNotDependOnOrder) {
+  std::vector<double> entries;
+  for (int i = 0; i < 1000; ++i) {
+    entries.push_back(std::sin(i) * 1e-3 + (i % 7) * 0.1);
+  }
+  std::vector<double> reversed(entries.rbegin(), entries.rend());
+
+  std::unique_ptr<BoundedSum<double>> forward = BuildFixedPointSum(0x1p-30);
+  forward->AddEntries(entries);
+  std::unique_ptr<BoundedSum<double>> backward = BuildFixedPointSum(0x1p-30);
+  for (double entry : reversed) {
+    backward->AddEntry(entry);
+  }
+
+  absl::StatusOr<Output> forward_result = forward->PartialResult();
+  ASSERT_OK(forward_result);
+  absl::StatusOr<Output> backward_result = backward->PartialResult();
+  ASSERT_OK(backward_result);
+  EXPECT_EQ(GetValue<double>(*forward_result),
+            GetValue<double>(*backward_result));
+}
+
+TEST(BoundedSumTest, FixedPointSumMergesExactly) {
+  std::vector<double> entries;
+  for (int i = 0; i < 100; ++i) {
+    entries.push_back(std::cos(i) * 1.5);
+  }
+  std::unique_ptr<BoundedSum<double>> expected = BuildFixedPointSum(0x1p-20);
+  expected->AddEntries(entries);
+  absl::StatusOr<Output> expected_result = expected->PartialResult();
+  ASSERT_OK(expected_result);
+
+  // Every partial sum holds every fourth entry.
+  std::vector<std::unique_ptr<BoundedSum<double>>> parts;
+  for (int i = 0; i < 4; ++i) {
+    parts.push_back(BuildFixedPointSum(0x1p-20));
+    for (int j = i; j < entries.size(); j += 4) {
+      parts.back()->AddEntry(entries[j]);
+    }
+  }
+  std::unique_ptr<BoundedSum<double>> merged = BuildFixedPointSum(0x1p-20);
+  EXPECT_OK(merged->Merge(parts[0]->Serialize()));
+  EXPECT_OK(merged->MergeFromBytes(parts[1]->Serialize().SerializeAsString()));
+  EXPECT_OK(merged->MergeFromBinary(parts[2]->SerializeToBinary()));
+  EXPECT_OK(merged->MergeFrom(*parts[3]));
+
+  absl::StatusOr<Output> merged_result = merged->PartialResult();
+  ASSERT_OK(merged_result);
+  EXPECT_EQ(GetValue<double>(*merged_result),
+            GetValue<double>(*expected_result));
+}
+
+TEST(BoundedSumTest, FixedPointAndFloatingPointSummariesDoNotMerge) {
+  std::unique_ptr<BoundedSum<double>> fixed_point = BuildFixedPointSum(0.5);
+  absl::StatusOr<std::unique_ptr<BoundedSum<double>>> floating_point =
+      BoundedSum<double>::Builder().SetLower(-1).SetUpper(1.9).Build();
+  ASSERT_OK(floating_point);
+
+  EXPECT_THAT(fixed_point->Merge((*floating_point)->Serialize()),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("fixed point accumulation")));
+  EXPECT_THAT((*floating_point)->Merge(fixed_point->Serialize()),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("exactly one pos_sum")));
+  EXPECT_FALSE(
+      fixed_point->MergeFromBinary((*floating_point)->SerializeToBinary())
+          .ok());
+  EXPECT_FALSE(fixed_point->MergeFrom(**floating_point).ok());
+}
+
+TEST(BoundedSumTest, FixedPointGranularityIsValidated) {
+  EXPECT_THAT(BoundedSum<int64_t>::Builder()
+                  .SetLower(0)
+                  .SetUpper(10)
+                  .SetFixedPointGranularity(1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("only supported for floating point")));
+  for (double granularity :
+       {0.0, -0.5, 0.1, 3.0, std::numeric_limits<double>::infinity()}) {
+    EXPECT_THAT(BoundedSum<double>::Builder()
+                    .SetLower(0)
+                    .SetUpper(10)
+                    .SetFixedPointGranularity(granularity)
+                    .Build(),
+                StatusIs(absl::StatusCode::kInvalidArgument,
+                         HasSubstr("positive power of two")))
+        << granularity;
+  }
+  EXPECT_THAT(BoundedSum<double>::Builder().SetFixedPointGranularity(1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("requires both the lower and the upper")));
+  EXPECT_THAT(BoundedSum<double>::Builder()
+                  .SetLower(-1)
+                  .SetUpper(1)
+                  .SetFixedPointGranularity(0x1p-60)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("must not exceed 2^50")));
+  EXPECT_THAT(BoundedSum<double>::Builder()
+                  .SetLower(0.1)
+                  .SetUpper(0.2)
+                  .SetFixedPointGranularity(0.5)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("must contain a multiple")));
+}
+
+TEST(BoundedSumTest, PrototypeKeepsFixedPointGranularity) {
+  absl::StatusOr<BoundedSum<float, double>::Prototype> prototype =
+      BoundedSum<float, double>::Builder()
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetLower(-2)
+          .SetUpper(2)
+          .SetFixedPointGranularity(0.5)
+          .BuildPrototype();
+  ASSERT_OK(prototype);
+  std::unique_ptr<BoundedSum<float, double>> bs = prototype->New();
+  bs->AddEntries(std::vector<float>{0.3f, 0.9f, 1.6f});
+
+  absl::StatusOr<Output> result = bs->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<double>(*result), 3.0);
+}
+
 }  //  namespace
 }  // namespace differential_privacy
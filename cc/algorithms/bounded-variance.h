@@ -23,6 +23,7 @@
 #include <cstdlib>
 #include <limits>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <type_traits>
 #include <utility>
@@ -35,6 +36,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 #include "algorithms/algorithm.h"
 #include "algorithms/approx-bounds.h"
 #include "algorithms/bounded-algorithm.h"
@@ -43,6 +45,8 @@
 #include "proto/util.h"
 #include "proto/data.pb.h"
 #include "proto/summary.pb.h"
+#include "base/instrumentation.h"
+#include "base/tracking_memory_resource.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
@@ -164,6 +168,12 @@ class BoundedVariance : public Algorithm<T> {
 
   // Friend class for testing only
   friend class BoundedVarianceTestPeer;
+
+  // Uses the mechanism and bound helpers for the same internal state.
+  template <typename T2>
+  friend class BoundedStatistics;
+  template <typename T2>
+  friend class ColumnProfile;
 };
 
 // Bounded variance implementation that uses fixed bounds.
@@ -185,6 +195,8 @@ class BoundedVarianceWithFixedBounds : public BoundedVariance<T> {
   void AddEntry(const T& t) override { AddMultipleEntries(t, 1); }
 
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     BoundedVarianceSummary variance_summary;
     variance_summary.set_count(partial_count_);
     SetValue(variance_summary.add_pos_sum(), partial_sum_);
@@ -197,6 +209,8 @@ class BoundedVarianceWithFixedBounds : public BoundedVariance<T> {
   }
 
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError(
           "Cannot merge summary with no bounded variance data.");
@@ -229,6 +243,20 @@ class BoundedVarianceWithFixedBounds : public BoundedVariance<T> {
     return absl::OkStatus();
   }
 
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_variance =
+        dynamic_cast<const BoundedVarianceWithFixedBounds<T>*>(&other);
+    if (other_variance == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    partial_count_ += other_variance->partial_count_;
+    partial_sum_ += other_variance->partial_sum_;
+    partial_sum_of_squares_ += other_variance->partial_sum_of_squares_;
+    return absl::OkStatus();
+  }
+
   int64_t MemoryUsed() override {
     return sizeof(BoundedVarianceWithFixedBounds) +
            count_mechanism_->MemoryUsed() + sum_mechanism_->MemoryUsed() +
@@ -317,8 +345,15 @@ class BoundedVarianceWithApproxBounds : public BoundedVariance<T> {
       const int max_contributions_per_partition,
       std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
       std::unique_ptr<NumericalMechanism> count_mechanism,
-      std::unique_ptr<ApproxBounds<T>> approx_bounds)
+      std::unique_ptr<ApproxBounds<T>> approx_bounds,
+      std::pmr::memory_resource* memory_resource =
+          std::pmr::get_default_resource())
       : BoundedVariance<T>(epsilon),
+        memory_(memory_resource),
+        pos_sum_(&memory_),
+        neg_sum_(&memory_),
+        pos_sum_of_squares_(&memory_),
+        neg_sum_of_squares_(&memory_),
         epsilon_for_sum_(epsilon_for_sum),
         epsilon_for_squares_(epsilon_for_squares),
         mechanism_builder_(std::move(mechanism_builder)),
@@ -336,7 +371,20 @@ class BoundedVarianceWithApproxBounds : public BoundedVariance<T> {
 
   void AddEntry(const T& t) override { AddMultipleEntries(t, 1); }
 
+  using BoundedVariance<T>::AddEntries;
+
+  // Fills the histogram of the ApproxBounds, the partial sums and the partial
+  // sums of squares in a single pass over the entries, see
+  // ApproxBounds::AddEntriesWithPartialSumsAndSquares.
+  void AddEntries(absl::Span<const T> entries) override {
+    partial_count_ += approx_bounds_->AddEntriesWithPartialSumsAndSquares(
+        entries, &pos_sum_, &neg_sum_, &pos_sum_of_squares_,
+        &neg_sum_of_squares_);
+  }
+
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     // Create BoundedVarianceSummary.
     BoundedVarianceSummary bv_summary;
     bv_summary.set_count(partial_count_);
@@ -364,6 +412,8 @@ class BoundedVarianceWithApproxBounds : public BoundedVariance<T> {
   }
 
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError(
           "Cannot merge summary with no bounded variance data.");
@@ -407,11 +457,42 @@ class BoundedVarianceWithApproxBounds : public BoundedVariance<T> {
     return absl::OkStatus();
   }
 
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_variance =
+        dynamic_cast<const BoundedVarianceWithApproxBounds<T>*>(&other);
+    if (other_variance == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    if (pos_sum_.size() != other_variance->pos_sum_.size() ||
+        neg_sum_.size() != other_variance->neg_sum_.size() ||
+        pos_sum_of_squares_.size() !=
+            other_variance->pos_sum_of_squares_.size() ||
+        neg_sum_of_squares_.size() !=
+            other_variance->neg_sum_of_squares_.size()) {
+      return absl::InternalError(
+          "Merged BoundedVariance must have the same amount of partial "
+          "sum or sum of squares values as this BoundedVariance.");
+    }
+
+    RETURN_IF_ERROR(
+        approx_bounds_->MergeFrom(*other_variance->approx_bounds_));
+    partial_count_ += other_variance->partial_count_;
+    for (int i = 0; i < pos_sum_.size(); ++i) {
+      pos_sum_[i] += other_variance->pos_sum_[i];
+      pos_sum_of_squares_[i] += other_variance->pos_sum_of_squares_[i];
+    }
+    for (int i = 0; i < neg_sum_.size(); ++i) {
+      neg_sum_[i] += other_variance->neg_sum_[i];
+      neg_sum_of_squares_[i] += other_variance->neg_sum_of_squares_[i];
+    }
+    return absl::OkStatus();
+  }
+
   int64_t MemoryUsed() override {
-    int64_t memory = sizeof(BoundedVarianceWithApproxBounds<T>);
-    memory += sizeof(T) * (pos_sum_.capacity() + neg_sum_.capacity());
-    memory += sizeof(double) *
-              (pos_sum_of_squares_.capacity() + neg_sum_of_squares_.capacity());
+    int64_t memory =
+        sizeof(BoundedVarianceWithApproxBounds<T>) + memory_.bytes_allocated();
     memory += sizeof(*mechanism_builder_);
     memory += approx_bounds_->MemoryUsed();
     return memory;
@@ -547,9 +628,12 @@ class BoundedVarianceWithApproxBounds : public BoundedVariance<T> {
     }
   }
 
+  // Tracks the allocations of the vectors below for MemoryUsed.
+  base::TrackingMemoryResource memory_;
+
   // Vectors of partial values stored for automatic clamping.
-  std::vector<T> pos_sum_, neg_sum_;
-  std::vector<double> pos_sum_of_squares_, neg_sum_of_squares_;
+  std::pmr::vector<T> pos_sum_, neg_sum_;
+  std::pmr::vector<double> pos_sum_of_squares_, neg_sum_of_squares_;
   int64_t partial_count_ = 0;
 
   // Used to construct mechanism once bounds are obtained.
@@ -613,6 +697,14 @@ class BoundedVariance<T>::Builder {
     return *this;
   }
 
+  // Allocates the partial sums and sums of squares kept for automatic bounding
+  // from `memory_resource`. The resource must outlive the built algorithm.
+  BoundedVariance<T>::Builder& SetMemoryResource(
+      std::pmr::memory_resource* memory_resource) {
+    memory_resource_ = memory_resource;
+    return *this;
+  }
+
   absl::StatusOr<std::unique_ptr<BoundedVariance<T>>> Build() {
     if (!epsilon_.has_value()) {
       epsilon_ = DefaultEpsilon();
@@ -643,6 +735,8 @@ class BoundedVariance<T>::Builder {
   std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
       absl::make_unique<LaplaceMechanism::Builder>();
   std::unique_ptr<ApproxBounds<T>> approx_bounds_;
+  std::pmr::memory_resource* memory_resource_ =
+      std::pmr::get_default_resource();
 
   absl::StatusOr<std::unique_ptr<BoundedVariance<T>>>
   BuildVarianceWithFixedBounds() {
@@ -684,6 +778,7 @@ class BoundedVariance<T>::Builder {
               .SetLaplaceMechanism(mechanism_builder_->Clone())
               .SetMaxContributionsPerPartition(max_contributions_per_partition_)
               .SetMaxPartitionsContributed(max_partitions_contributed_)
+              .SetMemoryResource(memory_resource_)
               .Build());
     }
 
@@ -716,7 +811,7 @@ class BoundedVariance<T>::Builder {
             epsilon_.value(), epsilon_for_sum, epsilon_for_squares,
             max_partitions_contributed_, max_contributions_per_partition_,
             mechanism_builder_->Clone(), std::move(count_mechanism),
-            std::move(approx_bounds_)));
+            std::move(approx_bounds_), memory_resource_));
   }
 };
 
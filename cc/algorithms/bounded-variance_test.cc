@@ -21,6 +21,7 @@
 #include <functional>
 #include <limits>
 #include <memory>
+#include <memory_resource>
 #include <numeric>
 #include <random>
 #include <type_traits>
@@ -36,6 +37,7 @@
 #include "absl/random/distributions.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "algorithms/approx-bounds.h"
 #include "algorithms/numerical-mechanisms-testing.h"
 #include "algorithms/numerical-mechanisms.h"
@@ -387,6 +389,26 @@ TYPED_TEST(BoundedVarianceTest, MergeDifferentBoundingStrategy) {
               "Merged BoundedVariance must have the same bounding strategy.")));
 }
 
+TYPED_TEST(BoundedVarianceTest, MergeFromDifferentBoundingStrategy) {
+  absl::StatusOr<std::unique_ptr<BoundedVariance<TypeParam>>> bv1 =
+      typename BoundedVariance<TypeParam>::Builder()
+          .SetLower(0)
+          .SetUpper(3)
+          .Build();
+  ASSERT_OK(bv1);
+  absl::StatusOr<std::unique_ptr<BoundedVariance<TypeParam>>> bv2 =
+      typename BoundedVariance<TypeParam>::Builder().Build();
+  ASSERT_OK(bv2);
+
+  // Instances of different types are merged through their summaries.
+  EXPECT_THAT(
+      (*bv2)->MergeFrom(**bv1),
+      StatusIs(
+          absl::StatusCode::kInternal,
+          HasSubstr(
+              "Merged BoundedVariance must have the same bounding strategy.")));
+}
+
 TYPED_TEST(BoundedVarianceTest, SerializeMergeTest) {
   // Get summary of first BoundedVariance between entries.
   absl::StatusOr<std::unique_ptr<BoundedVariance<TypeParam>>> bv1 =
@@ -473,6 +495,31 @@ TYPED_TEST(BoundedVarianceTest, SerializeMergePartialValuesTest) {
   EXPECT_DOUBLE_EQ(GetValue<double>(*result1), GetValue<double>(*result2));
 }
 
+TYPED_TEST(BoundedVarianceTest, MergeFromMatchesMerge) {
+  for (const bool automatic_bounds : {false, true}) {
+    typename BoundedVariance<TypeParam>::Builder builder;
+    builder.SetEpsilon(kDefaultEpsilon);
+    if (!automatic_bounds) {
+      builder.SetLower(-5).SetUpper(5);
+    }
+    auto bv1 = builder.Build();
+    ASSERT_OK(bv1);
+    auto bv2 = builder.Build();
+    ASSERT_OK(bv2);
+    auto bv3 = builder.Build();
+    ASSERT_OK(bv3);
+    for (TypeParam entry : {-10, -1, 0, 3, 20}) {
+      (*bv1)->AddEntry(entry);
+    }
+    (*bv2)->AddEntry(4);
+    (*bv3)->AddEntry(4);
+
+    EXPECT_OK((*bv2)->MergeFrom(**bv1));
+    EXPECT_OK((*bv3)->Merge((*bv1)->Serialize()));
+    EXPECT_THAT((*bv2)->Serialize(), EqualsProto((*bv3)->Serialize()));
+  }
+}
+
 TEST(BoundedVarianceTest, OverflowRawCountTest) {
   typename BoundedVariance<double>::Builder builder;
 
@@ -665,6 +712,37 @@ TEST(BoundedVarianceTest, DropNanEntries) {
   EXPECT_DOUBLE_EQ(GetValue<double>(*result), 2.0);
 }
 
+TEST(BoundedVarianceTest, AllocatesBuffersFromMemoryResource) {
+  char buffer[4096];
+  std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer),
+                                               std::pmr::null_memory_resource());
+  absl::StatusOr<std::unique_ptr<ApproxBounds<double>>> bounds =
+      ApproxBounds<double>::Builder()
+          .SetEpsilon(0.5)
+          .SetNumBins(4)
+          .SetBase(2)
+          .SetScale(1)
+          .SetThresholdForTest(0.5)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetMemoryResource(&resource)
+          .Build();
+  ASSERT_OK(bounds);
+  absl::StatusOr<std::unique_ptr<BoundedVariance<double>>> bv =
+      BoundedVariance<double>::Builder()
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetEpsilon(1)
+          .SetApproxBounds(std::move(bounds).value())
+          .SetMemoryResource(&resource)
+          .Build();
+  ASSERT_OK(bv);
+
+  // Bounds are set to [-1, 2].
+  std::vector<double> a = {1, -1, 2};
+  absl::StatusOr<Output> result = (*bv)->Result(a.begin(), a.end());
+  ASSERT_OK(result);
+  EXPECT_NEAR(GetValue<double>(*result), 14.0 / 9, 1e-10);
+}
+
 TYPED_TEST(BoundedVarianceTest, PropagateApproxBoundsError) {
   absl::StatusOr<std::unique_ptr<BoundedVariance<TypeParam>>> bv =
       typename BoundedVariance<TypeParam>::Builder().SetEpsilon(1).Build();
@@ -888,6 +966,68 @@ TYPED_TEST(BoundedVarianceTest, Reset) {
   EXPECT_DOUBLE_EQ(GetValue<double>(result->elements(0).value()), 10000);
 }
 
+template <typename T>
+std::unique_ptr<BoundedVariance<T>> CreateVarianceWithApproxBounds() {
+  std::unique_ptr<ApproxBounds<T>> bounds =
+      typename ApproxBounds<T>::Builder()
+          .SetNumBins(10)
+          .SetBase(2)
+          .SetScale(1)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetEpsilon(kDefaultEpsilon / 2)
+          .SetThresholdForTest(0.5)
+          .Build()
+          .value();
+  return typename BoundedVariance<T>::Builder()
+      .SetEpsilon(kDefaultEpsilon)
+      .SetApproxBounds(std::move(bounds))
+      .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+      .Build()
+      .value();
+}
+
+TYPED_TEST(BoundedVarianceTest, AddEntriesMatchesAddEntryWithApproxBounds) {
+  std::unique_ptr<BoundedVariance<TypeParam>> batched =
+      CreateVarianceWithApproxBounds<TypeParam>();
+  std::unique_ptr<BoundedVariance<TypeParam>> sequential =
+      CreateVarianceWithApproxBounds<TypeParam>();
+  std::vector<TypeParam> inputs = {0, 1, -1, 7, -7, 3000, -3000, 64, -512};
+  for (int i = -40; i <= 40; ++i) {
+    inputs.push_back(i * i * i);
+  }
+
+  batched->AddEntries(absl::MakeConstSpan(inputs));
+  for (const TypeParam& input : inputs) {
+    sequential->AddEntry(input);
+  }
+
+  // All partials are integral and exact, so the summaries are equal.
+  EXPECT_THAT(batched->Serialize(), EqualsProto(sequential->Serialize()));
+}
+
+TEST(BoundedVarianceTest, AddEntriesKeepsPrecisionOfFloatPartials) {
+  std::unique_ptr<BoundedVariance<float>> bv =
+      CreateVarianceWithApproxBounds<float>();
+  constexpr int kNumEntries = 1 << 20;
+  const std::vector<float> inputs(kNumEntries, 0.1f);
+
+  bv->AddEntries(absl::MakeConstSpan(inputs));
+
+  BoundedVarianceSummary summary;
+  ASSERT_TRUE(bv->Serialize().data().UnpackTo(&summary));
+  double sum = 0;
+  double sum_of_squares = 0;
+  for (int i = 0; i < summary.pos_sum_size(); ++i) {
+    sum += GetValue<float>(summary.pos_sum(i));
+    sum_of_squares += summary.pos_sum_of_squares(i);
+  }
+  // Accumulating the partials in float would be off by about 1%.
+  const double input = 0.1f;
+  EXPECT_NEAR(sum, kNumEntries * input, 1e-5 * kNumEntries * input);
+  EXPECT_NEAR(sum_of_squares, kNumEntries * input * input,
+              1e-9 * kNumEntries * input * input);
+}
+
 TYPED_TEST(BoundedVarianceTest, MemoryUsed) {
   absl::StatusOr<std::unique_ptr<BoundedVariance<TypeParam>>> bv =
       typename BoundedVariance<TypeParam>::Builder().Build();
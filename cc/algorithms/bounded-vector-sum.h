@@ -0,0 +1,324 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_BOUNDED_VECTOR_SUM_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_BOUNDED_VECTOR_SUM_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/util.h"
+#include "proto/data.pb.h"
+#include "proto/util.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Differentially private sum of fixed-length vectors, e.g., embeddings or the
+// columns of a row, released with a single batched draw of Gaussian noise
+// instead of one BoundedSum per coordinate.
+//
+// Every contribution is clipped: first each coordinate to
+// [-max_linf_norm, max_linf_norm], if set, and then the whole vector is scaled
+// down to an L2 norm of at most max_l2_norm, if set. The L2 sensitivity of the
+// sum is max_contributions times the smaller of max_l2_norm and
+// sqrt(dimension) * max_linf_norm, and the Gaussian noise is calibrated to it
+// like for GaussianMechanism. Contributions that contain NaN or an infinite
+// coordinate are ignored, since an infinite norm would scale them to NaN.
+//
+// The sums are kept in one contiguous accumulator, and the clipping and
+// accumulation loops are written so that compilers vectorize them.
+//
+// BoundedVectorSum is not thread safe.
+class BoundedVectorSum {
+ public:
+  class Builder;
+
+  BoundedVectorSum(const BoundedVectorSum&) = delete;
+  BoundedVectorSum& operator=(const BoundedVectorSum&) = delete;
+
+  // Clips and adds one contribution, which must have dimension() elements.
+  absl::Status AddEntry(absl::Span<const double> entry) {
+    RETURN_IF_ERROR(CheckDimension(entry.size()));
+    AddClipped(entry);
+    return absl::OkStatus();
+  }
+
+  // Clips and adds the contributions stored one after the other in entries,
+  // whose size must be a multiple of dimension().
+  absl::Status AddEntries(absl::Span<const double> entries) {
+    if (entries.size() % sum_.size() != 0) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The number of values must be a multiple of the dimension ",
+          sum_.size(), ", but is ", entries.size(), "."));
+    }
+    for (size_t i = 0; i < entries.size(); i += sum_.size()) {
+      AddClipped(entries.subspan(i, sum_.size()));
+    }
+    return absl::OkStatus();
+  }
+
+  // Adds the contributions of another BoundedVectorSum with the same
+  // dimension.
+  absl::Status Merge(const BoundedVectorSum& other) {
+    RETURN_IF_ERROR(CheckDimension(other.sum_.size()));
+    for (size_t i = 0; i < sum_.size(); ++i) {
+      sum_[i] += other.sum_[i];
+    }
+    return absl::OkStatus();
+  }
+
+  // Returns the noisy sums, one element per coordinate. Can only be called
+  // once until Reset.
+  absl::StatusOr<Output> PartialResult() {
+    if (result_returned_) {
+      return absl::InvalidArgumentError(
+          "The algorithm can only produce results once for a given epsilon, "
+          "delta budget.");
+    }
+    result_returned_ = true;
+    std::vector<double> noised(sum_.size());
+    RETURN_IF_ERROR(mechanism_->AddNoise(sum_, absl::MakeSpan(noised)));
+    Output output;
+    for (double value : noised) {
+      AddToOutput(&output, value);
+    }
+    return output;
+  }
+
+  // Returns the confidence interval of the noise of every coordinate.
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level) {
+    return mechanism_->NoiseConfidenceInterval(confidence_level);
+  }
+
+  // Discards all contributions and allows a new result, which spends the
+  // budget again.
+  void Reset() {
+    std::fill(sum_.begin(), sum_.end(), 0);
+    result_returned_ = false;
+  }
+
+  int64_t MemoryUsed() const {
+    return sizeof(BoundedVectorSum) +
+           sizeof(double) * (sum_.capacity() + clipped_.capacity()) +
+           mechanism_->MemoryUsed();
+  }
+
+  int dimension() const { return sum_.size(); }
+
+  // Returns the L2 sensitivity of the sum that the noise is calibrated to.
+  double GetL2Sensitivity() const { return l2_sensitivity_; }
+
+  double GetEpsilon() const { return epsilon_; }
+  double GetDelta() const { return delta_; }
+
+ private:
+  BoundedVectorSum(double epsilon, double delta, int dimension,
+                   std::optional<double> max_l2_norm,
+                   std::optional<double> max_linf_norm, double l2_sensitivity,
+                   std::unique_ptr<NumericalMechanism> mechanism)
+      : epsilon_(epsilon),
+        delta_(delta),
+        max_l2_norm_(max_l2_norm),
+        max_linf_norm_(max_linf_norm),
+        l2_sensitivity_(l2_sensitivity),
+        mechanism_(std::move(mechanism)),
+        sum_(dimension, 0),
+        clipped_(dimension, 0) {}
+
+  absl::Status CheckDimension(size_t size) const {
+    if (size != sum_.size()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Expected ", sum_.size(), " values, but got ", size,
+                       "."));
+    }
+    return absl::OkStatus();
+  }
+
+  void AddClipped(absl::Span<const double> entry) {
+    const size_t n = sum_.size();
+    double* clipped = clipped_.data();
+    // The comparison is false for NaN and infinities; counting instead of
+    // breaking out of the loop keeps it vectorizable.
+    constexpr double kMaxFinite = std::numeric_limits<double>::max();
+    int num_non_finite = 0;
+    if (max_linf_norm_.has_value()) {
+      const double bound = *max_linf_norm_;
+      for (size_t i = 0; i < n; ++i) {
+        num_non_finite += !(std::abs(entry[i]) <= kMaxFinite);
+        clipped[i] = std::clamp(entry[i], -bound, bound);
+      }
+    } else {
+      for (size_t i = 0; i < n; ++i) {
+        num_non_finite += !(std::abs(entry[i]) <= kMaxFinite);
+        clipped[i] = entry[i];
+      }
+    }
+    if (num_non_finite > 0) {
+      return;
+    }
+
+    double factor = 1;
+    if (max_l2_norm_.has_value()) {
+      // Four independent partial sums let the reduction vectorize without
+      // reassociating floating point additions.
+      double partial[4] = {0, 0, 0, 0};
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+        partial[0] += clipped[i] * clipped[i];
+        partial[1] += clipped[i + 1] * clipped[i + 1];
+        partial[2] += clipped[i + 2] * clipped[i + 2];
+        partial[3] += clipped[i + 3] * clipped[i + 3];
+      }
+      for (; i < n; ++i) {
+        partial[0] += clipped[i] * clipped[i];
+      }
+      const double norm =
+          std::sqrt((partial[0] + partial[1]) + (partial[2] + partial[3]));
+      if (norm > *max_l2_norm_) {
+        factor = *max_l2_norm_ / norm;
+      }
+    }
+    double* sum = sum_.data();
+    for (size_t i = 0; i < n; ++i) {
+      sum[i] += factor * clipped[i];
+    }
+  }
+
+  const double epsilon_;
+  const double delta_;
+  const std::optional<double> max_l2_norm_;
+  const std::optional<double> max_linf_norm_;
+  const double l2_sensitivity_;
+  std::unique_ptr<NumericalMechanism> mechanism_;
+
+  bool result_returned_ = false;
+  std::vector<double> sum_;
+  // Scratch space for the clipped contribution.
+  std::vector<double> clipped_;
+};
+
+class BoundedVectorSum::Builder {
+ public:
+  Builder& SetEpsilon(double epsilon) {
+    epsilon_ = epsilon;
+    return *this;
+  }
+
+  Builder& SetDelta(double delta) {
+    delta_ = delta;
+    return *this;
+  }
+
+  // Number of coordinates of every contribution. Required.
+  Builder& SetDimension(int dimension) {
+    dimension_ = dimension;
+    return *this;
+  }
+
+  // Bound on the L2 norm of a contribution. At least one of the L2 and LInf
+  // norm bounds is required.
+  Builder& SetMaxL2Norm(double max_l2_norm) {
+    max_l2_norm_ = max_l2_norm;
+    return *this;
+  }
+
+  // Bound on the absolute value of every coordinate of a contribution.
+  Builder& SetMaxLInfNorm(double max_linf_norm) {
+    max_linf_norm_ = max_linf_norm;
+    return *this;
+  }
+
+  // Maximum number of contributions of a privacy unit. Defaults to 1.
+  Builder& SetMaxContributions(int max_contributions) {
+    max_contributions_ = max_contributions;
+    return *this;
+  }
+
+  // Mechanism used to add noise to the sums. Defaults to Gaussian. The
+  // builder gets an L0 sensitivity of 1 and the L2 sensitivity of the sum as
+  // LInf sensitivity, which the Gaussian mechanism combines into the L2
+  // sensitivity. Only Gaussian builders are accepted, since a mechanism
+  // calibrated to the L1 sensitivity would take it to be the L2 sensitivity,
+  // which can be sqrt(dimension) times too small.
+  Builder& SetGaussianMechanism(
+      std::unique_ptr<GaussianMechanism::Builder> mechanism_builder) {
+    mechanism_builder_ = std::move(mechanism_builder);
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<BoundedVectorSum>> Build() {
+    RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
+    RETURN_IF_ERROR(ValidateDelta(delta_));
+    RETURN_IF_ERROR(ValidateMaxContributions(max_contributions_));
+    if (!dimension_.has_value() || *dimension_ <= 0) {
+      return absl::InvalidArgumentError(
+          "Dimension must be set and positive.");
+    }
+    if (!max_l2_norm_.has_value() && !max_linf_norm_.has_value()) {
+      return absl::InvalidArgumentError(
+          "At least one of the maximum L2 and LInf norms must be set.");
+    }
+    double norm = std::numeric_limits<double>::infinity();
+    if (max_l2_norm_.has_value()) {
+      RETURN_IF_ERROR(
+          ValidateIsFiniteAndPositive(max_l2_norm_, "Maximum L2 norm"));
+      norm = *max_l2_norm_;
+    }
+    if (max_linf_norm_.has_value()) {
+      RETURN_IF_ERROR(
+          ValidateIsFiniteAndPositive(max_linf_norm_, "Maximum LInf norm"));
+      norm = std::min(norm, std::sqrt(*dimension_) * *max_linf_norm_);
+    }
+    const double l2_sensitivity = max_contributions_ * norm;
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mechanism,
+                     mechanism_builder_->SetEpsilon(epsilon_.value())
+                         .SetDelta(delta_.value())
+                         .SetL0Sensitivity(1)
+                         .SetLInfSensitivity(l2_sensitivity)
+                         .Build());
+    return absl::WrapUnique(new BoundedVectorSum(
+        epsilon_.value(), delta_.value(), *dimension_, max_l2_norm_,
+        max_linf_norm_, l2_sensitivity, std::move(mechanism)));
+  }
+
+ private:
+  std::optional<double> epsilon_;
+  std::optional<double> delta_;
+  std::optional<int> dimension_;
+  std::optional<double> max_l2_norm_;
+  std::optional<double> max_linf_norm_;
+  int max_contributions_ = 1;
+  std::unique_ptr<GaussianMechanism::Builder> mechanism_builder_ =
+      std::make_unique<GaussianMechanism::Builder>();
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_BOUNDED_VECTOR_SUM_H_
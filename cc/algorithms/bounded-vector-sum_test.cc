@@ -0,0 +1,251 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/bounded-vector-sum.h"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "base/instrumentation.h"
+#include "proto/util.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+// Gaussian mechanism builder that builds a ZeroNoiseMechanism.
+class ZeroNoiseGaussianBuilder : public GaussianMechanism::Builder {
+ public:
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override {
+    return ZeroNoiseMechanism::Builder().Build();
+  }
+
+  std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
+    return std::make_unique<ZeroNoiseGaussianBuilder>(*this);
+  }
+};
+
+BoundedVectorSum::Builder ZeroNoiseBuilder(int dimension) {
+  BoundedVectorSum::Builder builder;
+  builder.SetEpsilon(1).SetDelta(1e-5).SetDimension(dimension);
+  builder.SetGaussianMechanism(std::make_unique<ZeroNoiseGaussianBuilder>());
+  return builder;
+}
+
+std::vector<double> Values(const Output& output) {
+  std::vector<double> values;
+  for (int i = 0; i < output.elements_size(); ++i) {
+    values.push_back(GetValue<double>(output, i));
+  }
+  return values;
+}
+
+TEST(BoundedVectorSumTest, SumsWithinBounds) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(3).SetMaxLInfNorm(10).Build().value();
+  EXPECT_OK(sum->AddEntry({1, -2, 3}));
+  EXPECT_OK(sum->AddEntries({4, 5, 6, -1, 0, 1}));
+
+  absl::StatusOr<Output> result = sum->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(Values(*result), ElementsAre(4, 3, 10));
+}
+
+TEST(BoundedVectorSumTest, ClipsCoordinatesToLInfNorm) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(3).SetMaxLInfNorm(2).Build().value();
+  EXPECT_OK(sum->AddEntry({5, -5, 1}));
+
+  absl::StatusOr<Output> result = sum->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(Values(*result), ElementsAre(2, -2, 1));
+}
+
+TEST(BoundedVectorSumTest, ScalesToL2Norm) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(5).SetMaxL2Norm(1).Build().value();
+  EXPECT_OK(sum->AddEntry({3, 0, 0, 0, -4}));
+  EXPECT_OK(sum->AddEntry({0, 0.5, 0, 0, 0}));
+
+  absl::StatusOr<Output> result = sum->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(Values(*result),
+              ElementsAre(DoubleNear(0.6, 1e-12), DoubleNear(0.5, 1e-12), 0, 0,
+                          DoubleNear(-0.8, 1e-12)));
+}
+
+TEST(BoundedVectorSumTest, ClipsToLInfNormBeforeL2Norm) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(2).SetMaxLInfNorm(3).SetMaxL2Norm(5).Build().value();
+  // Clipped to (3, 3) first, whose norm 4.24 is within the L2 bound.
+  EXPECT_OK(sum->AddEntry({10, 10}));
+
+  absl::StatusOr<Output> result = sum->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(Values(*result), ElementsAre(3, 3));
+}
+
+TEST(BoundedVectorSumTest, IgnoresEntriesWithNan) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(2).SetMaxL2Norm(10).Build().value();
+  EXPECT_OK(sum->AddEntry({1, 2}));
+  EXPECT_OK(sum->AddEntry({std::numeric_limits<double>::quiet_NaN(), 2}));
+
+  absl::StatusOr<Output> result = sum->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(Values(*result), ElementsAre(1, 2));
+}
+
+TEST(BoundedVectorSumTest, IgnoresEntriesWithInfinityUnderL2Clipping) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(2).SetMaxL2Norm(1).Build().value();
+  EXPECT_OK(sum->AddEntry({0.5, 0.5}));
+  EXPECT_OK(sum->AddEntry({std::numeric_limits<double>::infinity(), 0}));
+  EXPECT_OK(sum->AddEntry({0, -std::numeric_limits<double>::infinity()}));
+
+  absl::StatusOr<Output> result = sum->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(Values(*result), ElementsAre(0.5, 0.5));
+}
+
+TEST(BoundedVectorSumTest, RejectsWrongDimension) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(3).SetMaxL2Norm(1).Build().value();
+  EXPECT_THAT(sum->AddEntry({1, 2}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Expected 3 values")));
+  EXPECT_THAT(sum->AddEntries({1, 2, 3, 4}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("multiple of the dimension")));
+}
+
+TEST(BoundedVectorSumTest, MergesSums) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(2).SetMaxLInfNorm(10).Build().value();
+  std::unique_ptr<BoundedVectorSum> other =
+      ZeroNoiseBuilder(2).SetMaxLInfNorm(10).Build().value();
+  std::unique_ptr<BoundedVectorSum> wrong =
+      ZeroNoiseBuilder(3).SetMaxLInfNorm(10).Build().value();
+  EXPECT_OK(sum->AddEntry({1, 2}));
+  EXPECT_OK(other->AddEntry({3, 4}));
+  EXPECT_OK(sum->Merge(*other));
+  EXPECT_THAT(sum->Merge(*wrong),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  absl::StatusOr<Output> result = sum->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(Values(*result), ElementsAre(4, 6));
+}
+
+TEST(BoundedVectorSumTest, NoisesAllCoordinatesInOneBatch) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(64).SetMaxL2Norm(1).Build().value();
+  instrumentation::AggregatingSink sink;
+  instrumentation::SetSink(&sink);
+  absl::StatusOr<Output> result = sum->PartialResult();
+  instrumentation::SetSink(nullptr);
+
+  ASSERT_OK(result);
+  EXPECT_EQ(result->elements_size(), 64);
+  EXPECT_EQ(sink.Get(instrumentation::Event::kMechanismAddNoise).calls, 1);
+  EXPECT_EQ(sink.Get(instrumentation::Event::kMechanismAddNoise).count, 64);
+}
+
+TEST(BoundedVectorSumTest, ProducesResultOnceUntilReset) {
+  std::unique_ptr<BoundedVectorSum> sum =
+      ZeroNoiseBuilder(2).SetMaxL2Norm(10).Build().value();
+  EXPECT_OK(sum->AddEntry({1, 2}));
+  EXPECT_OK(sum->PartialResult());
+  EXPECT_THAT(sum->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("only produce results once")));
+
+  sum->Reset();
+  absl::StatusOr<Output> result = sum->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(Values(*result), ElementsAre(0, 0));
+}
+
+TEST(BoundedVectorSumTest, CalibratesGaussianNoiseToL2Sensitivity) {
+  const double epsilon = 1;
+  const double delta = 1e-6;
+  const int dimension = 16;
+  std::unique_ptr<BoundedVectorSum> sum = BoundedVectorSum::Builder()
+                                              .SetEpsilon(epsilon)
+                                              .SetDelta(delta)
+                                              .SetDimension(dimension)
+                                              .SetMaxLInfNorm(0.5)
+                                              .SetMaxL2Norm(3)
+                                              .SetMaxContributions(2)
+                                              .Build()
+                                              .value();
+  // sqrt(16) * 0.5 = 2 is tighter than the L2 norm bound.
+  EXPECT_DOUBLE_EQ(sum->GetL2Sensitivity(), 4);
+
+  absl::StatusOr<ConfidenceInterval> interval =
+      sum->NoiseConfidenceInterval(0.95);
+  ASSERT_OK(interval);
+  const double stddev =
+      GaussianMechanism::CalculateStddev(epsilon, delta, /*l2_sensitivity=*/4);
+  EXPECT_NEAR(interval->upper_bound(), 1.959964 * stddev, 1e-3 * stddev);
+}
+
+TEST(BoundedVectorSumTest, ValidatesParameters) {
+  EXPECT_THAT(BoundedVectorSum::Builder()
+                  .SetEpsilon(1)
+                  .SetDelta(1e-5)
+                  .SetMaxL2Norm(1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Dimension")));
+  EXPECT_THAT(BoundedVectorSum::Builder()
+                  .SetEpsilon(1)
+                  .SetDelta(1e-5)
+                  .SetDimension(2)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("L2 and LInf")));
+  EXPECT_THAT(BoundedVectorSum::Builder()
+                  .SetEpsilon(1)
+                  .SetDelta(1e-5)
+                  .SetDimension(2)
+                  .SetMaxL2Norm(-1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(BoundedVectorSum::Builder()
+                  .SetEpsilon(1)
+                  .SetDimension(2)
+                  .SetMaxL2Norm(1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace differential_privacy
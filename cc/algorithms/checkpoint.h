@@ -0,0 +1,71 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_CHECKPOINT_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_CHECKPOINT_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/internal/mapped-file.h"
+#include "proto/summary.pb.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Checkpoints of the state of a long-running aggregation, so that a restarted
+// process can continue where it stopped instead of reprocessing its input.
+//
+// A checkpoint is the serialized Summary of the algorithm. It is restored by
+// mapping the file into memory and merging it with MergeFromBytes, which
+// decodes the summaries of Count, BoundedSum and ApproxBounds in place. See
+// KeyedAggregator::Checkpoint for the multi-partition aggregator.
+//
+// Checkpoints hold raw, unnoised state and must be protected like the input
+// data. Restoring a checkpoint into an algorithm that has already returned a
+// result, or into several algorithms whose results are all released, spends
+// the privacy budget more than once.
+
+// Writes the state of algorithm to a checkpoint at path, replacing any
+// previous checkpoint atomically.
+template <typename T>
+absl::Status WriteCheckpoint(const Algorithm<T>& algorithm,
+                             const std::string& path) {
+  const std::string summary = algorithm.Serialize().SerializeAsString();
+  return internal::WriteFileAtomically(path, [&summary](std::ostream& output) {
+    output.write(summary.data(), summary.size());
+    return absl::OkStatus();
+  });
+}
+
+// Merges the state in the checkpoint at path into algorithm, which must have
+// been built with the same parameters as the checkpointed one, e.g., a new
+// instance after a restart. Returns NotFoundError if there is no checkpoint.
+template <typename T>
+absl::Status RestoreCheckpoint(const std::string& path,
+                               Algorithm<T>* algorithm) {
+  ASSIGN_OR_RETURN(std::unique_ptr<internal::MappedFile> file,
+                   internal::MappedFile::Open(path));
+  return algorithm->MergeFromBytes(file->contents());
+}
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_CHECKPOINT_H_
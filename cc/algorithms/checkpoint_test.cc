@@ -0,0 +1,115 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/checkpoint.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "base/testing/proto_matchers.h"
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::EqualsProto;
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+
+std::string CheckpointPath(absl::string_view name) {
+  const char* tmpdir = std::getenv("TEST_TMPDIR");
+  return absl::StrCat(tmpdir != nullptr ? tmpdir : "/tmp", "/", name,
+                      ".checkpoint");
+}
+
+TEST(CheckpointTest, RestoresCount) {
+  const std::string path = CheckpointPath("count");
+  Count<int64_t>::Builder builder;
+  builder.SetEpsilon(1).SetLaplaceMechanism(
+      std::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<Count<int64_t>>> count = builder.Build();
+  ASSERT_OK(count);
+  for (int i = 0; i < 5; ++i) (*count)->AddEntry(i);
+  ASSERT_OK(WriteCheckpoint(**count, path));
+  // Entries after the checkpoint are lost on restart.
+  (*count)->AddEntry(5);
+
+  absl::StatusOr<std::unique_ptr<Count<int64_t>>> restored = builder.Build();
+  ASSERT_OK(restored);
+  ASSERT_OK(RestoreCheckpoint(path, restored->get()));
+  (*restored)->AddEntry(6);
+
+  absl::StatusOr<Output> result = (*restored)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 6);
+  std::remove(path.c_str());
+}
+
+TEST(CheckpointTest, RestoresBoundedSumWithApproxBounds) {
+  const std::string path = CheckpointPath("bounded-sum");
+  absl::StatusOr<std::unique_ptr<BoundedSum<double>>> sum =
+      BoundedSum<double>::Builder().SetEpsilon(1).Build();
+  ASSERT_OK(sum);
+  for (int i = -50; i < 100; ++i) (*sum)->AddEntry(i * 1.5);
+  ASSERT_OK(WriteCheckpoint(**sum, path));
+
+  absl::StatusOr<std::unique_ptr<BoundedSum<double>>> restored =
+      BoundedSum<double>::Builder().SetEpsilon(1).Build();
+  ASSERT_OK(restored);
+  ASSERT_OK(RestoreCheckpoint(path, restored->get()));
+  EXPECT_THAT((*restored)->Serialize(), EqualsProto((*sum)->Serialize()));
+  std::remove(path.c_str());
+}
+
+TEST(CheckpointTest, MissingCheckpointIsNotFound) {
+  absl::StatusOr<std::unique_ptr<Count<int64_t>>> count =
+      Count<int64_t>::Builder().SetEpsilon(1).Build();
+  ASSERT_OK(count);
+  EXPECT_THAT(RestoreCheckpoint(CheckpointPath("missing"), count->get()),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(CheckpointTest, CheckpointOfOtherAlgorithmFails) {
+  const std::string path = CheckpointPath("other");
+  absl::StatusOr<std::unique_ptr<Count<double>>> count =
+      Count<double>::Builder().SetEpsilon(1).Build();
+  ASSERT_OK(count);
+  ASSERT_OK(WriteCheckpoint(**count, path));
+
+  absl::StatusOr<std::unique_ptr<BoundedSum<double>>> sum =
+      BoundedSum<double>::Builder()
+          .SetEpsilon(1)
+          .SetLower(0)
+          .SetUpper(1)
+          .Build();
+  ASSERT_OK(sum);
+  EXPECT_THAT(RestoreCheckpoint(path, sum->get()),
+              StatusIs(absl::StatusCode::kInternal));
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace differential_privacy
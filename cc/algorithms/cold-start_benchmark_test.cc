@@ -0,0 +1,72 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures the time to the first noised result of a thread, which dominates
+// the latency of the first request of a server that was just started.
+//
+// Every iteration starts a new thread, so that the per-thread random cache of
+// SecureURBG is empty, and times building a Count, adding an entry and
+// computing its result on it. The process-wide initialization of OpenSSL is
+// only paid by the first iteration of the first benchmark; run a single
+// benchmark with --benchmark_filter and --benchmark_min_iters=1 to observe it.
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "benchmark/benchmark.h"
+#include "algorithms/count.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/rand.h"
+
+namespace differential_privacy {
+namespace {
+
+// Returns the seconds to the first noised result on a new thread, after
+// warming the thread up with warm_up if it is not null.
+double SecondsToFirstResultOnNewThread(void (*warm_up)()) {
+  double seconds = 0;
+  std::thread([warm_up, &seconds]() {
+    if (warm_up != nullptr) {
+      warm_up();
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<Count<int64_t>> count =
+        Count<int64_t>::Builder().SetEpsilon(1).Build().value();
+    count->AddEntry(1);
+    benchmark::DoNotOptimize(count->PartialResult());
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            start)
+                  .count();
+  }).join();
+  return seconds;
+}
+
+void BM_FirstNoisedResult(benchmark::State& state, void (*warm_up)()) {
+  for (auto _ : state) {
+    state.SetIterationTime(SecondsToFirstResultOnNewThread(warm_up));
+  }
+}
+BENCHMARK_CAPTURE(BM_FirstNoisedResult, Cold, nullptr)->UseManualTime();
+BENCHMARK_CAPTURE(BM_FirstNoisedResult, SecureURBGWarmedUp, &SecureURBG::WarmUp)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_FirstNoisedResult, MechanismsWarmedUp,
+                  +[]() { WarmUpNoiseMechanisms().IgnoreError(); })
+    ->UseManualTime();
+
+}  // namespace
+}  // namespace differential_privacy
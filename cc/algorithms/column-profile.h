@@ -0,0 +1,481 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COLUMN_PROFILE_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COLUMN_PROFILE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/bounded-variance.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/quantile-tree.h"
+#include "algorithms/util.h"
+#include "proto/util.h"
+#include "proto/data.pb.h"
+#include "proto/summary.pb.h"
+#include "base/instrumentation.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Computes the count, sum, mean, variance, standard deviation and a set of
+// quantiles of the same input in a single pass, instead of feeding every entry
+// to Count, BoundedSum, BoundedMean, BoundedVariance, BoundedStandardDeviation
+// and Quantiles separately. Inputs are clamped to manually set bounds.
+//
+// Four values are noised, each with its share of epsilon and delta as declared
+// by BudgetSplit:
+//   - the count,
+//   - the sum, normalized around the midpoint of the bounds,
+//   - the sum of squares, normalized around the midpoint of the squares,
+//   - the quantile tree, if quantiles are requested.
+// All statistics are post-processed from these values:
+//   - count uses the noisy count,
+//   - sum and mean use the noisy count and sum,
+//   - variance and standard deviation use the noisy count, sum and sum of
+//     squares, like BoundedVariance,
+//   - quantiles use the noisy quantile tree, like Quantiles.
+//
+// The output contains count, sum, mean, variance and standard deviation at
+// kCountIndex, ..., kStandardDeviationIndex, followed by one element for each
+// requested quantile, in order, starting at kFirstQuantileIndex.
+template <typename T>
+class ColumnProfile : public Algorithm<T> {
+  static_assert(std::is_arithmetic<T>::value,
+                "ColumnProfile can only be used for arithmetic types");
+
+ public:
+  class Builder;
+
+  // Shares of the privacy budget of the noised values. Only the ratios
+  // matter. The quantiles share is ignored if no quantiles are requested.
+  struct BudgetSplit {
+    double count = 1;
+    double sum = 1;
+    double sum_of_squares = 1;
+    double quantiles = 1;
+  };
+
+  static constexpr int kCountIndex = 0;
+  static constexpr int kSumIndex = 1;
+  static constexpr int kMeanIndex = 2;
+  static constexpr int kVarianceIndex = 3;
+  static constexpr int kStandardDeviationIndex = 4;
+  static constexpr int kFirstQuantileIndex = 5;
+
+  void AddEntry(const T& input) override {
+    if (std::isnan(static_cast<double>(input))) {
+      return;
+    }
+    AddToMoments(input);
+    if (tree_) {
+      tree_->AddEntry(input);
+    }
+  }
+
+  using Algorithm<T>::AddEntries;
+
+  // Adds all entries. The quantile tree is updated as a batch, see
+  // QuantileTree::AddEntries.
+  void AddEntries(absl::Span<const T> entries) override {
+    for (const T& entry : entries) {
+      if (!std::isnan(static_cast<double>(entry))) {
+        AddToMoments(entry);
+      }
+    }
+    if (tree_) {
+      tree_->AddEntries(entries);
+    }
+  }
+
+  Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
+    ColumnProfileSummary profile_summary;
+    profile_summary.set_count(partial_count_);
+    SetValue(profile_summary.mutable_sum(), partial_sum_);
+    profile_summary.set_sum_of_squares(partial_sum_of_squares_);
+    if (tree_) {
+      *profile_summary.mutable_quantiles_summary() = tree_->Serialize();
+    }
+
+    Summary summary;
+    summary.mutable_data()->PackFrom(profile_summary);
+    return summary;
+  }
+
+  absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    if (!summary.has_data()) {
+      return absl::InternalError(
+          "Cannot merge summary with no column profile data.");
+    }
+    ColumnProfileSummary profile_summary;
+    if (!summary.data().UnpackTo(&profile_summary)) {
+      return absl::InternalError(
+          "Column profile summary unable to be unpacked.");
+    }
+    if ((tree_ != nullptr) != profile_summary.has_quantiles_summary()) {
+      return absl::InternalError(
+          "Merged ColumnProfile must compute quantiles if and only if this "
+          "ColumnProfile does.");
+    }
+    if (tree_) {
+      RETURN_IF_ERROR(tree_->Merge(profile_summary.quantiles_summary()));
+    }
+    partial_count_ += profile_summary.count();
+    partial_sum_ += GetValue<T>(profile_summary.sum());
+    partial_sum_of_squares_ += profile_summary.sum_of_squares();
+    return absl::OkStatus();
+  }
+
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_profile = dynamic_cast<const ColumnProfile<T>*>(&other);
+    if (other_profile == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    if ((tree_ != nullptr) != (other_profile->tree_ != nullptr)) {
+      return absl::InternalError(
+          "Merged ColumnProfile must compute quantiles if and only if this "
+          "ColumnProfile does.");
+    }
+    if (tree_) {
+      RETURN_IF_ERROR(tree_->MergeFrom(*other_profile->tree_));
+    }
+    partial_count_ += other_profile->partial_count_;
+    partial_sum_ += other_profile->partial_sum_;
+    partial_sum_of_squares_ += other_profile->partial_sum_of_squares_;
+    return absl::OkStatus();
+  }
+
+  int64_t MemoryUsed() override {
+    int64_t memory = sizeof(ColumnProfile<T>) +
+                     count_mechanism_->MemoryUsed() +
+                     sum_mechanism_->MemoryUsed() +
+                     sum_of_squares_mechanism_->MemoryUsed() +
+                     sizeof(double) * quantiles_.capacity();
+    if (tree_) {
+      memory += tree_->MemoryUsed() + sizeof(*mechanism_builder_);
+    }
+    return memory;
+  }
+
+  std::vector<double> GetQuantiles() const { return quantiles_; }
+
+  // Returns the epsilon of each noised value.
+  double GetCountEpsilon() const { return count_mechanism_->GetEpsilon(); }
+  double GetSumEpsilon() const { return sum_mechanism_->GetEpsilon(); }
+  double GetSumOfSquaresEpsilon() const {
+    return sum_of_squares_mechanism_->GetEpsilon();
+  }
+  double GetQuantilesEpsilon() const { return epsilon_for_quantiles_; }
+
+ protected:
+  absl::StatusOr<Output> GenerateResult(double noise_interval_level) override {
+    const double sum_midpoint = lower_ + ((upper_ - lower_) / 2);
+    const double sum_of_squares_midpoint =
+        BoundedVariance<T>::MidpointOfSquares(lower_, upper_);
+
+    const double noised_count = count_mechanism_->AddNoise(partial_count_);
+    const double noised_normalized_sum = sum_mechanism_->AddNoise(
+        partial_sum_ - (partial_count_ * sum_midpoint));
+    const double noised_normalized_sum_of_squares =
+        sum_of_squares_mechanism_->AddNoise(
+            partial_sum_of_squares_ -
+            (partial_count_ * sum_of_squares_midpoint));
+
+    // From this point everything is post-processing of the noised values.
+    const double sum =
+        noised_normalized_sum + std::max(0.0, noised_count) * sum_midpoint;
+    double mean = sum_midpoint;
+    double mean_of_squares = sum_of_squares_midpoint;
+    if (noised_count > 1) {
+      mean = (noised_normalized_sum / noised_count) + sum_midpoint;
+      mean_of_squares = (noised_normalized_sum_of_squares / noised_count) +
+                        sum_of_squares_midpoint;
+    }
+    const double variance = Clamp<double>(
+        0, BoundedVariance<T>::IntervalLengthSquared(lower_, upper_) / 4,
+        mean_of_squares - (mean * mean));
+
+    Output output;
+    AddToOutput<int64_t>(
+        &output, static_cast<int64_t>(std::max(0.0, std::round(noised_count))));
+    if (std::is_integral<T>::value) {
+      AddToOutput<T>(&output, SafeCastFromDouble<T>(std::round(sum)).value);
+    } else {
+      AddToOutput<T>(&output, sum);
+    }
+    AddToOutput<double>(&output, Clamp<double>(lower_, upper_, mean));
+    AddToOutput<double>(&output, variance);
+    AddToOutput<double>(&output, std::sqrt(variance));
+
+    if (tree_) {
+      typename QuantileTree<T>::DPParams dp_params;
+      dp_params.epsilon = epsilon_for_quantiles_;
+      dp_params.delta = delta_for_quantiles_;
+      dp_params.max_contributions_per_partition =
+          max_contributions_per_partition_;
+      dp_params.max_partitions_contributed_to = max_partitions_contributed_;
+      dp_params.mechanism_builder = mechanism_builder_->Clone();
+      ASSIGN_OR_RETURN(typename QuantileTree<T>::Privatized privatized_tree,
+                       tree_->MakePrivate(dp_params));
+      for (double quantile : quantiles_) {
+        ASSIGN_OR_RETURN(const double result,
+                         privatized_tree.GetQuantile(quantile));
+        AddToOutput<double>(&output, result);
+      }
+    }
+    return output;
+  }
+
+  void ResetState() override {
+    partial_count_ = 0;
+    partial_sum_ = 0;
+    partial_sum_of_squares_ = 0;
+    if (tree_) {
+      tree_->Reset();
+    }
+  }
+
+ private:
+  ColumnProfile(double epsilon, double delta, T lower, T upper,
+                int max_partitions_contributed,
+                int max_contributions_per_partition,
+                std::unique_ptr<NumericalMechanism> count_mechanism,
+                std::unique_ptr<NumericalMechanism> sum_mechanism,
+                std::unique_ptr<NumericalMechanism> sum_of_squares_mechanism,
+                std::unique_ptr<QuantileTree<T>> tree,
+                std::vector<double> quantiles, double epsilon_for_quantiles,
+                double delta_for_quantiles,
+                std::unique_ptr<NumericalMechanismBuilder> mechanism_builder)
+      : Algorithm<T>(epsilon, delta),
+        lower_(lower),
+        upper_(upper),
+        max_partitions_contributed_(max_partitions_contributed),
+        max_contributions_per_partition_(max_contributions_per_partition),
+        count_mechanism_(std::move(count_mechanism)),
+        sum_mechanism_(std::move(sum_mechanism)),
+        sum_of_squares_mechanism_(std::move(sum_of_squares_mechanism)),
+        tree_(std::move(tree)),
+        quantiles_(std::move(quantiles)),
+        epsilon_for_quantiles_(epsilon_for_quantiles),
+        delta_for_quantiles_(delta_for_quantiles),
+        mechanism_builder_(std::move(mechanism_builder)) {}
+
+  void AddToMoments(const T& input) {
+    ++partial_count_;
+    const T clamped_input = Clamp<T>(lower_, upper_, input);
+    partial_sum_ += clamped_input;
+    partial_sum_of_squares_ += std::pow(clamped_input, 2);
+  }
+
+  // Builds the mechanisms for the moments. Lives here rather than in the
+  // builder because it uses protected helpers of BoundedVariance.
+  static absl::StatusOr<std::unique_ptr<ColumnProfile<T>>> Create(
+      double epsilon, double delta, T lower, T upper,
+      int max_partitions_contributed, int max_contributions_per_partition,
+      const BudgetSplit& split, std::vector<double> quantiles,
+      const NumericalMechanismBuilder& mechanism_builder) {
+    RETURN_IF_ERROR(BoundedVariance<T>::CheckBounds(lower, upper));
+
+    const double quantiles_share = quantiles.empty() ? 0 : split.quantiles;
+    const double total_share =
+        split.count + split.sum + split.sum_of_squares + quantiles_share;
+    auto build_mechanism = [&](double share, double l_inf_sensitivity) {
+      return mechanism_builder.Clone()
+          ->SetEpsilon(epsilon * share / total_share)
+          .SetDelta(delta * share / total_share)
+          .SetL0Sensitivity(max_partitions_contributed)
+          .SetLInfSensitivity(l_inf_sensitivity)
+          .Build();
+    };
+    ASSIGN_OR_RETURN(
+        std::unique_ptr<NumericalMechanism> count_mechanism,
+        build_mechanism(split.count, max_contributions_per_partition));
+    ASSIGN_OR_RETURN(
+        std::unique_ptr<NumericalMechanism> sum_mechanism,
+        build_mechanism(split.sum, max_contributions_per_partition *
+                                       static_cast<double>(upper - lower) /
+                                       2.0));
+    ASSIGN_OR_RETURN(
+        std::unique_ptr<NumericalMechanism> sum_of_squares_mechanism,
+        build_mechanism(
+            split.sum_of_squares,
+            max_contributions_per_partition *
+                (BoundedVariance<T>::RangeOfSquares(lower, upper) / 2)));
+
+    std::unique_ptr<QuantileTree<T>> tree;
+    if (!quantiles.empty()) {
+      ASSIGN_OR_RETURN(tree, typename QuantileTree<T>::Builder()
+                                 .SetLower(lower)
+                                 .SetUpper(upper)
+                                 .Build());
+    }
+
+    return absl::WrapUnique(new ColumnProfile<T>(
+        epsilon, delta, lower, upper, max_partitions_contributed,
+        max_contributions_per_partition, std::move(count_mechanism),
+        std::move(sum_mechanism), std::move(sum_of_squares_mechanism),
+        std::move(tree), std::move(quantiles),
+        epsilon * quantiles_share / total_share,
+        delta * quantiles_share / total_share, mechanism_builder.Clone()));
+  }
+
+  const T lower_;
+  const T upper_;
+  const int max_partitions_contributed_;
+  const int max_contributions_per_partition_;
+
+  std::unique_ptr<NumericalMechanism> count_mechanism_;
+  std::unique_ptr<NumericalMechanism> sum_mechanism_;
+  std::unique_ptr<NumericalMechanism> sum_of_squares_mechanism_;
+
+  int64_t partial_count_ = 0;
+  T partial_sum_ = 0;
+  double partial_sum_of_squares_ = 0;
+
+  // Null if no quantiles are requested.
+  std::unique_ptr<QuantileTree<T>> tree_;
+  const std::vector<double> quantiles_;
+  const double epsilon_for_quantiles_;
+  const double delta_for_quantiles_;
+  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_;
+};
+
+template <typename T>
+class ColumnProfile<T>::Builder {
+ public:
+  ColumnProfile<T>::Builder& SetEpsilon(double epsilon) {
+    epsilon_ = epsilon;
+    return *this;
+  }
+
+  ColumnProfile<T>::Builder& SetDelta(double delta) {
+    delta_ = delta;
+    return *this;
+  }
+
+  ColumnProfile<T>::Builder& SetMaxPartitionsContributed(
+      int max_partitions_contributed) {
+    max_partitions_contributed_ = max_partitions_contributed;
+    return *this;
+  }
+
+  ColumnProfile<T>::Builder& SetMaxContributionsPerPartition(
+      int max_contributions_per_partition) {
+    max_contributions_per_partition_ = max_contributions_per_partition;
+    return *this;
+  }
+
+  ColumnProfile<T>::Builder& SetLower(T lower) {
+    lower_ = lower;
+    return *this;
+  }
+
+  ColumnProfile<T>::Builder& SetUpper(T upper) {
+    upper_ = upper;
+    return *this;
+  }
+
+  // Quantiles to compute, each in [0, 1]. Defaults to none.
+  ColumnProfile<T>::Builder& SetQuantiles(const std::vector<double>& quantiles) {
+    quantiles_ = quantiles;
+    return *this;
+  }
+
+  // Defaults to equal shares for all noised values.
+  ColumnProfile<T>::Builder& SetBudgetSplit(const BudgetSplit& split) {
+    split_ = split;
+    return *this;
+  }
+
+  ColumnProfile<T>::Builder& SetLaplaceMechanism(
+      std::unique_ptr<NumericalMechanismBuilder> builder) {
+    mechanism_builder_ = std::move(builder);
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<ColumnProfile<T>>> Build() {
+    if (!epsilon_.has_value()) {
+      epsilon_ = DefaultEpsilon();
+      LOG(WARNING) << "Default epsilon of " << epsilon_.value()
+                   << " is being used. Consider setting your own epsilon based "
+                      "on privacy considerations.";
+    }
+    RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
+    RETURN_IF_ERROR(ValidateDelta(delta_));
+    if (!lower_.has_value() || !upper_.has_value()) {
+      return absl::InvalidArgumentError(
+          "Lower and upper bounds must be set for ColumnProfile.");
+    }
+    RETURN_IF_ERROR(ValidateBounds(lower_, upper_));
+    RETURN_IF_ERROR(
+        ValidateMaxPartitionsContributed(max_partitions_contributed_));
+    RETURN_IF_ERROR(
+        ValidateMaxContributionsPerPartition(max_contributions_per_partition_));
+    for (double quantile : quantiles_) {
+      RETURN_IF_ERROR(ValidateIsInInclusiveInterval(quantile, 0, 1, "Quantile"));
+    }
+    RETURN_IF_ERROR(
+        ValidateIsFiniteAndPositive(split_.count, "Count budget share"));
+    RETURN_IF_ERROR(ValidateIsFiniteAndPositive(split_.sum, "Sum budget share"));
+    RETURN_IF_ERROR(ValidateIsFiniteAndPositive(split_.sum_of_squares,
+                                                "Sum of squares budget share"));
+    if (!quantiles_.empty()) {
+      RETURN_IF_ERROR(ValidateIsFiniteAndPositive(split_.quantiles,
+                                                  "Quantiles budget share"));
+    }
+
+    return ColumnProfile<T>::Create(
+        epsilon_.value(), delta_, lower_.value(), upper_.value(),
+        max_partitions_contributed_, max_contributions_per_partition_, split_,
+        quantiles_, *mechanism_builder_);
+  }
+
+ private:
+  std::optional<double> epsilon_;
+  double delta_ = 0;
+  std::optional<T> lower_;
+  std::optional<T> upper_;
+  int max_partitions_contributed_ = 1;
+  int max_contributions_per_partition_ = 1;
+  std::vector<double> quantiles_;
+  BudgetSplit split_;
+  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
+      absl::make_unique<LaplaceMechanism::Builder>();
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COLUMN_PROFILE_H_
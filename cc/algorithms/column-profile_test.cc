@@ -0,0 +1,195 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/column-profile.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "base/testing/proto_matchers.h"
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "proto/util.h"
+#include "proto/data.pb.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::EqualsProto;
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::DoubleNear;
+using ::testing::HasSubstr;
+
+template <typename T>
+typename ColumnProfile<T>::Builder ZeroNoiseBuilder() {
+  typename ColumnProfile<T>::Builder builder;
+  builder.SetEpsilon(1)
+      .SetLower(0)
+      .SetUpper(100)
+      .SetQuantiles({0.5, 0.9})
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>());
+  return builder;
+}
+
+template <typename T>
+double GetElement(const Output& output, int index) {
+  return GetValue<T>(output.elements(index).value());
+}
+
+template <typename T>
+class ColumnProfileTest : public ::testing::Test {};
+
+typedef ::testing::Types<int64_t, double> NumericTypes;
+TYPED_TEST_SUITE(ColumnProfileTest, NumericTypes);
+
+TYPED_TEST(ColumnProfileTest, ComputesAllStatistics) {
+  absl::StatusOr<std::unique_ptr<ColumnProfile<TypeParam>>> profile =
+      ZeroNoiseBuilder<TypeParam>().Build();
+  ASSERT_OK(profile);
+  std::vector<TypeParam> inputs;
+  for (int i = 1; i <= 100; ++i) {
+    inputs.push_back(i);
+  }
+
+  absl::StatusOr<Output> result =
+      (*profile)->Result(inputs.begin(), inputs.end());
+  ASSERT_OK(result);
+  using Profile = ColumnProfile<TypeParam>;
+  ASSERT_EQ(result->elements_size(), Profile::kFirstQuantileIndex + 2);
+  EXPECT_EQ(GetElement<int64_t>(*result, Profile::kCountIndex), 100);
+  EXPECT_EQ(GetElement<TypeParam>(*result, Profile::kSumIndex), 5050);
+  EXPECT_THAT(GetElement<double>(*result, Profile::kMeanIndex),
+              DoubleNear(50.5, 1e-9));
+  // The variance of 1, ..., n is (n^2 - 1) / 12.
+  EXPECT_THAT(GetElement<double>(*result, Profile::kVarianceIndex),
+              DoubleNear(833.25, 1e-9));
+  EXPECT_THAT(GetElement<double>(*result, Profile::kStandardDeviationIndex),
+              DoubleNear(std::sqrt(833.25), 1e-9));
+  EXPECT_THAT(GetElement<double>(*result, Profile::kFirstQuantileIndex),
+              DoubleNear(50.5, 1));
+  EXPECT_THAT(GetElement<double>(*result, Profile::kFirstQuantileIndex + 1),
+              DoubleNear(90, 1));
+}
+
+TYPED_TEST(ColumnProfileTest, ClampsInputs) {
+  absl::StatusOr<std::unique_ptr<ColumnProfile<TypeParam>>> profile =
+      ZeroNoiseBuilder<TypeParam>().SetQuantiles({}).Build();
+  ASSERT_OK(profile);
+  std::vector<TypeParam> inputs = {-50, 150};
+
+  absl::StatusOr<Output> result =
+      (*profile)->Result(inputs.begin(), inputs.end());
+  ASSERT_OK(result);
+  using Profile = ColumnProfile<TypeParam>;
+  EXPECT_EQ(result->elements_size(), Profile::kFirstQuantileIndex);
+  EXPECT_EQ(GetElement<TypeParam>(*result, Profile::kSumIndex), 100);
+  EXPECT_THAT(GetElement<double>(*result, Profile::kVarianceIndex),
+              DoubleNear(2500, 1e-9));
+}
+
+TEST(ColumnProfileTest, IgnoresNaN) {
+  absl::StatusOr<std::unique_ptr<ColumnProfile<double>>> profile =
+      ZeroNoiseBuilder<double>().Build();
+  ASSERT_OK(profile);
+  std::vector<double> inputs = {std::numeric_limits<double>::quiet_NaN(), 10};
+  (*profile)->AddEntries(inputs);
+  (*profile)->AddEntry(std::numeric_limits<double>::quiet_NaN());
+
+  absl::StatusOr<Output> result = (*profile)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(
+      GetElement<int64_t>(*result, ColumnProfile<double>::kCountIndex), 1);
+  EXPECT_DOUBLE_EQ(
+      GetElement<double>(*result, ColumnProfile<double>::kSumIndex), 10);
+}
+
+TEST(ColumnProfileTest, SplitsBudgetAsDeclared) {
+  absl::StatusOr<std::unique_ptr<ColumnProfile<double>>> profile =
+      ZeroNoiseBuilder<double>().SetEpsilon(2).Build();
+  ASSERT_OK(profile);
+  EXPECT_DOUBLE_EQ((*profile)->GetCountEpsilon(), 0.5);
+  EXPECT_DOUBLE_EQ((*profile)->GetSumEpsilon(), 0.5);
+  EXPECT_DOUBLE_EQ((*profile)->GetSumOfSquaresEpsilon(), 0.5);
+  EXPECT_DOUBLE_EQ((*profile)->GetQuantilesEpsilon(), 0.5);
+
+  ColumnProfile<double>::BudgetSplit split;
+  split.sum_of_squares = 2;
+  profile =
+      ZeroNoiseBuilder<double>().SetQuantiles({}).SetBudgetSplit(split).Build();
+  ASSERT_OK(profile);
+  EXPECT_DOUBLE_EQ((*profile)->GetCountEpsilon(), 0.25);
+  EXPECT_DOUBLE_EQ((*profile)->GetSumEpsilon(), 0.25);
+  EXPECT_DOUBLE_EQ((*profile)->GetSumOfSquaresEpsilon(), 0.5);
+  EXPECT_DOUBLE_EQ((*profile)->GetQuantilesEpsilon(), 0);
+}
+
+TEST(ColumnProfileTest, BuildValidatesParameters) {
+  EXPECT_THAT(ColumnProfile<double>::Builder().SetEpsilon(1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("bounds must be set")));
+  EXPECT_THAT(ZeroNoiseBuilder<double>().SetQuantiles({0.5, 2}).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Quantile")));
+  ColumnProfile<double>::BudgetSplit split;
+  split.sum = 0;
+  EXPECT_THAT(ZeroNoiseBuilder<double>().SetBudgetSplit(split).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Sum budget share")));
+}
+
+TYPED_TEST(ColumnProfileTest, MergeMatchesAddingAllEntries) {
+  std::unique_ptr<ColumnProfile<TypeParam>> all =
+      ZeroNoiseBuilder<TypeParam>().Build().value();
+  std::unique_ptr<ColumnProfile<TypeParam>> first =
+      ZeroNoiseBuilder<TypeParam>().Build().value();
+  std::unique_ptr<ColumnProfile<TypeParam>> second =
+      ZeroNoiseBuilder<TypeParam>().Build().value();
+  for (TypeParam x : {1, 20, 30}) {
+    all->AddEntry(x);
+    first->AddEntry(x);
+  }
+  for (TypeParam x : {45, 99}) {
+    all->AddEntry(x);
+    second->AddEntry(x);
+  }
+
+  std::unique_ptr<ColumnProfile<TypeParam>> merged =
+      ZeroNoiseBuilder<TypeParam>().Build().value();
+  ASSERT_OK(merged->Merge(first->Serialize()));
+  ASSERT_OK(merged->MergeFrom(*second));
+  EXPECT_THAT(merged->Serialize(), EqualsProto(all->Serialize()));
+
+  std::unique_ptr<ColumnProfile<TypeParam>> without_quantiles =
+      ZeroNoiseBuilder<TypeParam>().SetQuantiles({}).Build().value();
+  EXPECT_THAT(without_quantiles->Merge(all->Serialize()),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("if and only if")));
+  EXPECT_THAT(without_quantiles->MergeFrom(*all),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("if and only if")));
+}
+
+}  // namespace
+}  // namespace differential_privacy
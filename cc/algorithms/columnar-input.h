@@ -0,0 +1,89 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COLUMNAR_INPUT_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COLUMNAR_INPUT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "base/instrumentation.h"
+
+namespace differential_privacy {
+
+// Ingestion of columns in the memory layout of Apache Arrow primitive arrays:
+// a contiguous buffer of values and an optional validity bitmap, in which bit
+// i, counted from the least significant bit of byte 0, is set iff value i is
+// not null. For an arrow::NumericArray<ArrowType> `array`, pass
+// `absl::MakeConstSpan(array.raw_values(), array.length())`,
+// `array.null_bitmap_data()` and `array.offset()`.
+
+// Adds the non-null values of the column to the algorithm, skipping nulls like
+// NaN entries. Values are not copied: every run of consecutive non-null values
+// is passed to the batched Algorithm::AddEntries, so algorithms with
+// vectorized batch paths use them. validity_bitmap may be null if the column
+// has no nulls. bitmap_offset is the index of the bit of the first value.
+template <typename T>
+void AddColumn(absl::Span<const T> values, const uint8_t* validity_bitmap,
+               int64_t bitmap_offset, Algorithm<T>& algorithm) {
+  instrumentation::ScopedEvent event(
+      instrumentation::Event::kAlgorithmAddEntries, values.size());
+  if (validity_bitmap == nullptr) {
+    algorithm.AddEntries(values);
+    return;
+  }
+  const size_t size = values.size();
+  size_t run_begin = 0;
+  size_t i = 0;
+  while (i < size) {
+    const uint64_t bit = bitmap_offset + i;
+    const uint8_t byte = validity_bitmap[bit / 8];
+    // Whole bytes of non-null or null values extend or skip runs at once.
+    if (bit % 8 == 0 && i + 8 <= size && (byte == 0xFF || byte == 0)) {
+      if (byte == 0) {
+        if (run_begin < i) {
+          algorithm.AddEntries(values.subspan(run_begin, i - run_begin));
+        }
+        run_begin = i + 8;
+      }
+      i += 8;
+      continue;
+    }
+    if (((byte >> (bit % 8)) & 1) == 0) {
+      if (run_begin < i) {
+        algorithm.AddEntries(values.subspan(run_begin, i - run_begin));
+      }
+      run_begin = i + 1;
+    }
+    ++i;
+  }
+  if (run_begin < size) {
+    algorithm.AddEntries(values.subspan(run_begin));
+  }
+}
+
+// Same as above for a column without nulls.
+template <typename T>
+void AddColumn(absl::Span<const T> values, Algorithm<T>& algorithm) {
+  AddColumn<T>(values, /*validity_bitmap=*/nullptr, /*bitmap_offset=*/0,
+               algorithm);
+}
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COLUMNAR_INPUT_H_
@@ -0,0 +1,130 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/columnar-input.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "proto/util.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+
+std::unique_ptr<BoundedSum<int64_t>> CreateSum() {
+  return BoundedSum<int64_t>::Builder()
+      .SetEpsilon(1)
+      .SetLower(0)
+      .SetUpper(1000)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .Build()
+      .value();
+}
+
+int64_t SumResult(BoundedSum<int64_t>& sum) {
+  absl::StatusOr<Output> result = sum.PartialResult();
+  EXPECT_OK(result);
+  return GetValue<int64_t>(*result);
+}
+
+// Returns a validity bitmap in the Arrow layout with bit i set iff valid[i].
+std::vector<uint8_t> Bitmap(const std::vector<bool>& valid) {
+  std::vector<uint8_t> bitmap((valid.size() + 7) / 8, 0);
+  for (size_t i = 0; i < valid.size(); ++i) {
+    if (valid[i]) bitmap[i / 8] |= 1 << (i % 8);
+  }
+  return bitmap;
+}
+
+TEST(ColumnarInputTest, AddsColumnWithoutNulls) {
+  const std::vector<int64_t> values = {1, 2, 3, 4000};
+  std::unique_ptr<BoundedSum<int64_t>> sum = CreateSum();
+
+  AddColumn<int64_t>(values, *sum);
+
+  EXPECT_EQ(SumResult(*sum), 1006);
+}
+
+TEST(ColumnarInputTest, SkipsNulls) {
+  // Mixes whole bytes of valid and null values with partial bytes.
+  std::vector<int64_t> values;
+  std::vector<bool> valid;
+  int64_t expected = 0;
+  for (int i = 0; i < 100; ++i) {
+    values.push_back(i);
+    valid.push_back((i >= 8 && i < 24) || (i >= 40 && i % 3 == 0));
+    if (valid.back()) expected += i;
+  }
+  const std::vector<uint8_t> bitmap = Bitmap(valid);
+  std::unique_ptr<BoundedSum<int64_t>> sum = CreateSum();
+
+  AddColumn<int64_t>(values, bitmap.data(), /*bitmap_offset=*/0, *sum);
+
+  EXPECT_EQ(SumResult(*sum), expected);
+}
+
+TEST(ColumnarInputTest, HonorsBitmapOffset) {
+  // A slice of the column that starts at value 5 of the bitmap.
+  std::vector<int64_t> values;
+  std::vector<bool> valid;
+  int64_t expected = 0;
+  for (int i = 0; i < 40; ++i) {
+    valid.push_back(i % 4 != 1);
+    if (i >= 5) {
+      values.push_back(i);
+      if (valid.back()) expected += i;
+    }
+  }
+  const std::vector<uint8_t> bitmap = Bitmap(valid);
+  std::unique_ptr<BoundedSum<int64_t>> sum = CreateSum();
+
+  AddColumn<int64_t>(values, bitmap.data(), /*bitmap_offset=*/5, *sum);
+
+  EXPECT_EQ(SumResult(*sum), expected);
+}
+
+TEST(ColumnarInputTest, CountsNonNullValues) {
+  const std::vector<double> values(20, 1.5);
+  std::vector<bool> valid(20, false);
+  valid[0] = valid[7] = valid[8] = valid[19] = true;
+  const std::vector<uint8_t> bitmap = Bitmap(valid);
+  std::unique_ptr<Count<double>> count =
+      Count<double>::Builder()
+          .SetEpsilon(1)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+
+  AddColumn<double>(values, bitmap.data(), /*bitmap_offset=*/0, *count);
+
+  absl::StatusOr<Output> result = count->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 4);
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,793 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COLUMNAR_PARTITION_STORE_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COLUMNAR_PARTITION_STORE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/approx-bounds.h"
+#include "algorithms/internal/shared-memory.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/util.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Differentially private count and bounded sum of a metric for each of a fixed
+// number of partitions, identified by their index in [0, NumPartitions()).
+//
+// The state of all partitions is stored in a few contiguous arrays instead of
+// one Count and one BoundedSum object per partition: an int64_t count array, a
+// sum array and, with automatic bounds, a matrix of ApproxBounds bin counts
+// with one row per partition. AddEntries scatters a batch of entries into the
+// arrays by their partition index, and PartialResults computes the results of
+// all partitions at once, adding noise with one batched AddNoise call per
+// mechanism.
+//
+// The results are those of a Count and a BoundedSum per partition, each built
+// with half of epsilon and delta. With fixed bounds, entries are clamped as in
+// BoundedSumWithFixedBounds. Without bounds, the sum of every partition uses
+// its own bounds from its row of bin counts, as in BoundedSumWithApproxBounds:
+// the ApproxBounds of the builder provides the bins, thresholds and partials,
+// and by default gets half of the budget of the sum. Per-partition sums are
+// then noised in one batch per distinct pair of bounds, since the noise scale
+// depends on the bounds.
+//
+// With Builder::SetSharedMemoryName, the arrays of counts, sums and bins are
+// placed in a POSIX shared memory object instead, so that worker processes on
+// the same host that build stores with the same name and parameters add into
+// the same arrays, without merging summaries. Entries are then added with
+// relaxed atomic operations, so AddEntries may be called concurrently from
+// any process and thread. Only one process should call PartialResults, which
+// reads the entries of all processes and consumes the budget for all of them.
+// Reset clears the shared arrays for all processes.
+//
+// NaN entries are ignored. Without shared memory, ColumnarPartitionStore is
+// not thread safe.
+template <typename T>
+class ColumnarPartitionStore {
+  static_assert(std::is_arithmetic<T>::value,
+                "ColumnarPartitionStore can only be used for arithmetic types");
+  static_assert(std::numeric_limits<T>::lowest() < 0,
+                "ColumnarPartitionStore can only be used for signed types");
+
+ public:
+  class Builder;
+
+  // Type in which sums are accumulated and noised, like the Accumulator of a
+  // BoundedSum of wide type.
+  using Sum = std::conditional_t<std::is_integral<T>::value, int64_t, double>;
+
+  // Noisy results of all partitions, indexed by partition.
+  struct Results {
+    std::vector<int64_t> counts;
+    std::vector<Sum> sums;
+    // Whether automatic bounds were found for the sum of each partition, with
+    // the error BoundedSum would return otherwise. The sum of a partition
+    // without bounds is 0. Always OK with fixed bounds.
+    std::vector<absl::Status> sum_statuses;
+  };
+
+  ColumnarPartitionStore(const ColumnarPartitionStore&) = delete;
+  ColumnarPartitionStore& operator=(const ColumnarPartitionStore&) = delete;
+
+  int64_t NumPartitions() const { return num_partitions_; }
+
+  // Adds values[i] to partition partitions[i] for all i. The spans must have
+  // the same size. Fails without adding any entry if a partition index is out
+  // of range.
+  absl::Status AddEntries(absl::Span<const int64_t> partitions,
+                          absl::Span<const T> values) {
+    if (partitions.size() != values.size()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Partitions and values must have the same size, but have sizes ",
+          partitions.size(), " and ", values.size(), "."));
+    }
+    // A single pass without early exit, which the compiler can vectorize,
+    // so that the scatter below does not check every index.
+    bool out_of_range = false;
+    for (const int64_t partition : partitions) {
+      out_of_range |= static_cast<uint64_t>(partition) >=
+                      static_cast<uint64_t>(num_partitions_);
+    }
+    if (out_of_range) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Partition indices must be in [0, ", num_partitions_, ")."));
+    }
+    if (shared_region_ != nullptr) {
+      AddEntriesToSharedMemory(partitions, values);
+      return absl::OkStatus();
+    }
+    if (approx_bounds_ == nullptr) {
+      for (size_t i = 0; i < values.size(); ++i) {
+        if (std::isnan(static_cast<double>(values[i]))) {
+          continue;
+        }
+        ++counts_[partitions[i]];
+        sums_[partitions[i]] += Clamp<T>(lower_, upper_, values[i]);
+      }
+    } else {
+      for (size_t i = 0; i < values.size(); ++i) {
+        if (std::isnan(static_cast<double>(values[i]))) {
+          continue;
+        }
+        ++counts_[partitions[i]];
+        AddToBins(partitions[i], values[i]);
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status AddEntry(int64_t partition, T value) {
+    return AddEntries(absl::MakeConstSpan(&partition, 1),
+                      absl::MakeConstSpan(&value, 1));
+  }
+
+  // Returns the noisy count and sum of every partition. Can only be called
+  // once; the budget is consumed by the first call.
+  absl::StatusOr<Results> PartialResults() {
+    if (result_returned_) {
+      return absl::InvalidArgumentError(
+          "The algorithm can only produce results once for a given epsilon, "
+          "delta budget.");
+    }
+    result_returned_ = true;
+    if (shared_region_ != nullptr) {
+      CopyFromSharedMemory();
+    }
+
+    Results results;
+    results.counts = counts_;
+    RETURN_IF_ERROR(count_mechanism_->AddNoise(
+        absl::MakeConstSpan(results.counts), absl::MakeSpan(results.counts)));
+    results.sum_statuses.resize(num_partitions_);
+    if (approx_bounds_ == nullptr) {
+      results.sums.resize(num_partitions_);
+      RETURN_IF_ERROR(sum_mechanism_->AddNoise(absl::MakeConstSpan(sums_),
+                                               absl::MakeSpan(results.sums)));
+    } else {
+      RETURN_IF_ERROR(SumsWithApproxBounds(&results));
+    }
+    return results;
+  }
+
+  // Discards all entries and allows PartialResults() to be called again. With
+  // shared memory, also discards the entries of all other processes.
+  void Reset() {
+    result_returned_ = false;
+    std::fill(counts_.begin(), counts_.end(), 0);
+    std::fill(sums_.begin(), sums_.end(), 0);
+    std::fill(pos_bins_.begin(), pos_bins_.end(), 0);
+    std::fill(neg_bins_.begin(), neg_bins_.end(), 0);
+    std::fill(pos_remainders_.begin(), pos_remainders_.end(), 0);
+    std::fill(neg_remainders_.begin(), neg_remainders_.end(), 0);
+    if (shared_region_ != nullptr) {
+      ClearShared(shared_.counts, counts_.size());
+      ClearShared(shared_.sums, sums_.size());
+      ClearShared(shared_.pos_bins, pos_bins_.size());
+      ClearShared(shared_.neg_bins, neg_bins_.size());
+      ClearShared(shared_.pos_remainders, pos_remainders_.size());
+      ClearShared(shared_.neg_remainders, neg_remainders_.size());
+    }
+  }
+
+  // Removes the shared memory object with the given name, e.g., once all
+  // worker processes are done. Stores that use it already keep working, but
+  // stores built later start from new, empty arrays.
+  static absl::Status RemoveSharedMemory(const std::string& name) {
+    return internal::SharedMemoryRegion::Remove(name);
+  }
+
+  int64_t MemoryUsed() const {
+    int64_t memory = sizeof(ColumnarPartitionStore) +
+                     sizeof(int64_t) * counts_.capacity() +
+                     sizeof(Sum) * sums_.capacity() +
+                     sizeof(int64_t) *
+                         (pos_bins_.capacity() + neg_bins_.capacity()) +
+                     sizeof(Sum) * (pos_remainders_.capacity() +
+                                    neg_remainders_.capacity()) +
+                     count_mechanism_->MemoryUsed();
+    if (sum_mechanism_ != nullptr) {
+      memory += sum_mechanism_->MemoryUsed();
+    }
+    if (approx_bounds_ != nullptr) {
+      memory += approx_bounds_->MemoryUsed();
+    }
+    return memory;
+  }
+
+  double GetEpsilon() const { return epsilon_; }
+  double GetDelta() const { return delta_; }
+
+ private:
+  ColumnarPartitionStore(
+      double epsilon, double delta, int64_t num_partitions,
+      int max_partitions_contributed, int max_contributions_per_partition,
+      std::optional<T> lower, std::optional<T> upper,
+      std::unique_ptr<NumericalMechanism> count_mechanism,
+      std::unique_ptr<NumericalMechanism> sum_mechanism,
+      std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
+      std::unique_ptr<ApproxBounds<T>> approx_bounds)
+      : epsilon_(epsilon),
+        delta_(delta),
+        num_partitions_(num_partitions),
+        max_partitions_contributed_(max_partitions_contributed),
+        max_contributions_per_partition_(max_contributions_per_partition),
+        lower_(lower.value_or(0)),
+        upper_(upper.value_or(0)),
+        count_mechanism_(std::move(count_mechanism)),
+        sum_mechanism_(std::move(sum_mechanism)),
+        mechanism_builder_(std::move(mechanism_builder)),
+        approx_bounds_(std::move(approx_bounds)),
+        counts_(num_partitions, 0) {
+    if (approx_bounds_ == nullptr) {
+      sums_.assign(num_partitions, 0);
+      return;
+    }
+    num_bins_ = approx_bounds_->NumPositiveBins();
+    const size_t matrix_size = static_cast<size_t>(num_partitions) * num_bins_;
+    pos_bins_.assign(matrix_size, 0);
+    neg_bins_.assign(matrix_size, 0);
+    pos_remainders_.assign(matrix_size, 0);
+    neg_remainders_.assign(matrix_size, 0);
+    for (int i = 0; i < num_bins_; ++i) {
+      pos_lefts_.push_back(approx_bounds_->PosLeftBinBoundary(i));
+      neg_lefts_.push_back(approx_bounds_->NegLeftBinBoundary(i));
+      pos_widths_.push_back(approx_bounds_->PosRightBinBoundary(i) -
+                            pos_lefts_[i]);
+      neg_widths_.push_back(approx_bounds_->NegRightBinBoundary(i) -
+                            neg_lefts_[i]);
+    }
+  }
+
+  // Adds a non-NaN value to the bins of its partition. Like
+  // ApproxBounds::AddEntriesWithPartialSums, only the number of values and the
+  // sum of their remainders in their own bin are stored per bin; the partial
+  // sums are derived from them in PartialResults.
+  void AddToBins(int64_t partition, T value) {
+    size_t cell;
+    T remainder;
+    if (FindBin(partition, value, &cell, &remainder)) {
+      ++pos_bins_[cell];
+      pos_remainders_[cell] += remainder;
+    } else {
+      ++neg_bins_[cell];
+      neg_remainders_[cell] += remainder;
+    }
+  }
+
+  // Finds the cell of a non-NaN value in the bins of its partition and its
+  // remainder in the bin, capped at the width of the bin. Returns whether the
+  // cell is in the positive bins.
+  bool FindBin(int64_t partition, T value, size_t* cell, T* remainder) const {
+    const int bin_index = approx_bounds_->BinIndex(value);
+    *cell = static_cast<size_t>(partition) * num_bins_ + bin_index;
+    if (value >= 0) {
+      const T width = pos_widths_[bin_index];
+      *remainder = std::min<T>(value - pos_lefts_[bin_index], width);
+      return true;
+    }
+    const T width = neg_widths_[bin_index];
+    *remainder = std::max<T>(value - neg_lefts_[bin_index], width);
+    return false;
+  }
+
+  // Parameters that determine the layout of the arrays in shared memory.
+  // Stores only share an object if they agree on all of them. All fields have
+  // eight bytes, so that the struct has no padding and can be compared with
+  // memcmp.
+  struct SharedLayout {
+    int64_t value_type;
+    int64_t num_partitions;
+    int64_t num_bins;
+    double lower;
+    double upper;
+    double first_bin_width;
+    double last_bin_left;
+  };
+
+  // Start of the shared memory object. The first store to map a new object
+  // writes the layout; all others wait until it is written.
+  struct alignas(64) SharedHeader {
+    static constexpr uint32_t kNew = 0;
+    static constexpr uint32_t kInitializing = 1;
+    static constexpr uint32_t kReady = 2;
+
+    std::atomic<uint32_t> state;
+    SharedLayout layout;
+  };
+
+  // Arrays in shared memory, with the same sizes as the corresponding
+  // vectors. Unused arrays are null.
+  struct SharedColumns {
+    std::atomic<int64_t>* counts = nullptr;
+    std::atomic<Sum>* sums = nullptr;
+    std::atomic<int64_t>* pos_bins = nullptr;
+    std::atomic<int64_t>* neg_bins = nullptr;
+    std::atomic<Sum>* pos_remainders = nullptr;
+    std::atomic<Sum>* neg_remainders = nullptr;
+  };
+
+  // Maps the shared memory object with the given name, creating it if
+  // needed, and places the arrays of counts, sums and bins in it.
+  absl::Status AttachSharedMemory(const std::string& name) {
+    static_assert(std::atomic<int64_t>::is_always_lock_free &&
+                      std::atomic<Sum>::is_always_lock_free,
+                  "Shared memory requires address-free atomics");
+    static_assert(sizeof(std::atomic<Sum>) == sizeof(Sum) &&
+                      sizeof(std::atomic<int64_t>) == sizeof(int64_t),
+                  "Atomics must have the size of their values");
+
+    SharedLayout layout = {};
+    layout.value_type = (std::is_integral<T>::value ? 16 : 32) +
+                        static_cast<int64_t>(sizeof(T));
+    layout.num_partitions = num_partitions_;
+    layout.num_bins = num_bins_;
+    if (approx_bounds_ == nullptr) {
+      layout.lower = lower_;
+      layout.upper = upper_;
+    } else {
+      layout.first_bin_width = pos_widths_.front();
+      layout.last_bin_left = pos_lefts_.back();
+    }
+    const size_t size = sizeof(SharedHeader) +
+                        sizeof(int64_t) * (counts_.size() + pos_bins_.size() +
+                                           neg_bins_.size()) +
+                        sizeof(Sum) * (sums_.size() + pos_remainders_.size() +
+                                       neg_remainders_.size());
+    ASSIGN_OR_RETURN(shared_region_,
+                     internal::SharedMemoryRegion::OpenOrCreate(name, size));
+
+    // The object is filled with zeros when it is created, which is both the
+    // kNew state of the header and the initial value of every cell.
+    SharedHeader* header = static_cast<SharedHeader*>(shared_region_->data());
+    uint32_t state = SharedHeader::kNew;
+    if (header->state.compare_exchange_strong(state,
+                                              SharedHeader::kInitializing)) {
+      header->layout = layout;
+      header->state.store(SharedHeader::kReady, std::memory_order_release);
+    } else {
+      while (header->state.load(std::memory_order_acquire) !=
+             SharedHeader::kReady) {
+        std::this_thread::yield();
+      }
+    }
+    if (std::memcmp(&header->layout, &layout, sizeof(layout)) != 0) {
+      shared_region_.reset();
+      return absl::FailedPreconditionError(
+          absl::StrCat("Shared memory ", name,
+                       " holds a store with other parameters."));
+    }
+
+    char* next = static_cast<char*>(shared_region_->data()) +
+                 sizeof(SharedHeader);
+    shared_.counts = NextShared<int64_t>(&next, counts_.size());
+    shared_.sums = NextShared<Sum>(&next, sums_.size());
+    shared_.pos_bins = NextShared<int64_t>(&next, pos_bins_.size());
+    shared_.neg_bins = NextShared<int64_t>(&next, neg_bins_.size());
+    shared_.pos_remainders = NextShared<Sum>(&next, pos_remainders_.size());
+    shared_.neg_remainders = NextShared<Sum>(&next, neg_remainders_.size());
+    return absl::OkStatus();
+  }
+
+  template <typename V>
+  static std::atomic<V>* NextShared(char** next, size_t size) {
+    if (size == 0) return nullptr;
+    std::atomic<V>* cells = reinterpret_cast<std::atomic<V>*>(*next);
+    *next += sizeof(V) * size;
+    return cells;
+  }
+
+  // Same as the scatter of AddEntries, with atomic additions to the arrays in
+  // shared memory. Relaxed order suffices, since entries are only read once
+  // all processes are done adding.
+  void AddEntriesToSharedMemory(absl::Span<const int64_t> partitions,
+                                absl::Span<const T> values) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (std::isnan(static_cast<double>(values[i]))) {
+        continue;
+      }
+      shared_.counts[partitions[i]].fetch_add(1, std::memory_order_relaxed);
+      if (approx_bounds_ == nullptr) {
+        AddToShared(shared_.sums[partitions[i]],
+                    static_cast<Sum>(Clamp<T>(lower_, upper_, values[i])));
+        continue;
+      }
+      size_t cell;
+      T remainder;
+      if (FindBin(partitions[i], values[i], &cell, &remainder)) {
+        shared_.pos_bins[cell].fetch_add(1, std::memory_order_relaxed);
+        AddToShared(shared_.pos_remainders[cell], static_cast<Sum>(remainder));
+      } else {
+        shared_.neg_bins[cell].fetch_add(1, std::memory_order_relaxed);
+        AddToShared(shared_.neg_remainders[cell], static_cast<Sum>(remainder));
+      }
+    }
+  }
+
+  template <typename V>
+  static void AddToShared(std::atomic<V>& cell, V value) {
+    if constexpr (std::is_integral_v<V>) {
+      cell.fetch_add(value, std::memory_order_relaxed);
+    } else {
+      // std::atomic<double>::fetch_add requires C++20.
+      V expected = cell.load(std::memory_order_relaxed);
+      while (!cell.compare_exchange_weak(expected, expected + value,
+                                         std::memory_order_relaxed)) {
+      }
+    }
+  }
+
+  // Copies the arrays in shared memory into the vectors, from which
+  // PartialResults computes the results.
+  void CopyFromSharedMemory() {
+    CopyShared(shared_.counts, counts_);
+    CopyShared(shared_.sums, sums_);
+    CopyShared(shared_.pos_bins, pos_bins_);
+    CopyShared(shared_.neg_bins, neg_bins_);
+    CopyShared(shared_.pos_remainders, pos_remainders_);
+    CopyShared(shared_.neg_remainders, neg_remainders_);
+  }
+
+  template <typename V>
+  static void CopyShared(const std::atomic<V>* cells, std::vector<V>& values) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i] = cells[i].load();
+    }
+  }
+
+  template <typename V>
+  static void ClearShared(std::atomic<V>* cells, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      cells[i].store(0);
+    }
+  }
+
+  // Sums of the partitions that share the same bounds, and therefore the same
+  // mechanism.
+  struct SumGroup {
+    T lower;
+    T upper;
+    std::vector<int64_t> partitions;
+    std::vector<Sum> sums;
+  };
+
+  // Finds the bounds of every partition in its noisy bins, clamps its sum to
+  // them, and noises the sums in one batch per pair of bounds.
+  absl::Status SumsWithApproxBounds(Results* results) {
+    // Noise the bins of all partitions in one batch per sign.
+    NumericalMechanism* bins_mechanism = approx_bounds_->mechanism_.get();
+    std::vector<int64_t> noisy_pos_bins(pos_bins_.size());
+    std::vector<int64_t> noisy_neg_bins(neg_bins_.size());
+    RETURN_IF_ERROR(bins_mechanism->AddNoise(absl::MakeConstSpan(pos_bins_),
+                                             absl::MakeSpan(noisy_pos_bins)));
+    RETURN_IF_ERROR(bins_mechanism->AddNoise(absl::MakeConstSpan(neg_bins_),
+                                             absl::MakeSpan(noisy_neg_bins)));
+    const std::vector<double> thresholds =
+        approx_bounds_->BoundingThresholds();
+
+    results->sums.assign(num_partitions_, 0);
+    std::vector<SumGroup> groups;
+    absl::flat_hash_map<std::pair<T, T>, size_t> group_index;
+    std::vector<Sum> pos_partials(num_bins_);
+    std::vector<Sum> neg_partials(num_bins_);
+    for (int64_t partition = 0; partition < num_partitions_; ++partition) {
+      const size_t row = static_cast<size_t>(partition) * num_bins_;
+      const auto pos_row =
+          absl::MakeConstSpan(noisy_pos_bins).subspan(row, num_bins_);
+      const auto neg_row =
+          absl::MakeConstSpan(noisy_neg_bins).subspan(row, num_bins_);
+      std::optional<T> approx_lower;
+      std::optional<T> approx_upper;
+      for (double threshold : thresholds) {
+        approx_lower =
+            approx_bounds_->findLowerBound(pos_row, neg_row, threshold);
+        approx_upper =
+            approx_bounds_->findUpperBound(pos_row, neg_row, threshold);
+        if (approx_lower.has_value() && approx_upper.has_value()) {
+          break;
+        }
+      }
+      if (!approx_lower.has_value() || !approx_upper.has_value()) {
+        absl::Status status = absl::FailedPreconditionError(
+            "Bin count threshold was too large to find approximate "
+            "bounds. Either run over a larger dataset or decrease "
+            "success_probability and try again.");
+        status.SetPayload(kApproxBoundsNotEnoughDataUrl, absl::Cord());
+        results->sum_statuses[partition] = std::move(status);
+        continue;
+      }
+
+      // Same symmetric bounds as BoundedSumWithApproxBounds.
+      T lower = *approx_lower;
+      T upper = *approx_upper;
+      if (*approx_lower == std::numeric_limits<T>::lowest()) {
+        upper = std::numeric_limits<T>::max();
+      } else {
+        lower = std::min(*approx_lower, -1 * *approx_upper);
+        upper = std::max(*approx_upper, -1 * *approx_lower);
+      }
+
+      // The partial sum of a bin is its full width for every value in a
+      // higher bin, plus the remainders of the values in the bin.
+      int64_t pos_above = 0;
+      int64_t neg_above = 0;
+      for (int i = num_bins_ - 1; i >= 0; --i) {
+        pos_partials[i] = static_cast<Sum>(pos_widths_[i]) * pos_above +
+                          pos_remainders_[row + i];
+        neg_partials[i] = static_cast<Sum>(neg_widths_[i]) * neg_above +
+                          neg_remainders_[row + i];
+        pos_above += pos_bins_[row + i];
+        neg_above += neg_bins_[row + i];
+      }
+      ASSIGN_OR_RETURN(
+          Sum sum,
+          approx_bounds_->template ComputeFromPartials<Sum>(
+              pos_partials, neg_partials, [](T x) -> Sum { return x; }, lower,
+              upper, 0));
+
+      auto [it, inserted] =
+          group_index.try_emplace(std::make_pair(lower, upper), groups.size());
+      if (inserted) {
+        groups.push_back({lower, upper, {}, {}});
+      }
+      groups[it->second].partitions.push_back(partition);
+      groups[it->second].sums.push_back(sum);
+    }
+
+    const double aggregation_epsilon =
+        epsilon_ / 2 - approx_bounds_->GetEpsilon();
+    for (SumGroup& group : groups) {
+      ASSIGN_OR_RETURN(
+          std::unique_ptr<NumericalMechanism> mechanism,
+          mechanism_builder_->Clone()
+              ->SetEpsilon(aggregation_epsilon)
+              .SetDelta(delta_ / 2)
+              .SetL0Sensitivity(max_partitions_contributed_)
+              .SetLInfSensitivity(
+                  max_contributions_per_partition_ *
+                  std::max(std::abs(static_cast<double>(group.lower)),
+                           std::abs(static_cast<double>(group.upper))))
+              .Build());
+      RETURN_IF_ERROR(mechanism->AddNoise(absl::MakeConstSpan(group.sums),
+                                          absl::MakeSpan(group.sums)));
+      for (size_t i = 0; i < group.partitions.size(); ++i) {
+        results->sums[group.partitions[i]] = group.sums[i];
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  const double epsilon_;
+  const double delta_;
+  const int64_t num_partitions_;
+  const int max_partitions_contributed_;
+  const int max_contributions_per_partition_;
+  // Fixed bounds. Unused with automatic bounds.
+  const T lower_;
+  const T upper_;
+
+  std::unique_ptr<NumericalMechanism> count_mechanism_;
+  // Mechanism of the sums with fixed bounds, null with automatic bounds.
+  std::unique_ptr<NumericalMechanism> sum_mechanism_;
+  // Builds the mechanisms of the sums with automatic bounds.
+  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_;
+  // Bins, thresholds and mechanism of automatic bounds, null with fixed
+  // bounds. Its own bins are not used.
+  std::unique_ptr<ApproxBounds<T>> approx_bounds_;
+
+  // Number of non-NaN entries of every partition.
+  std::vector<int64_t> counts_;
+  // Clamped sum of every partition, with fixed bounds only.
+  std::vector<Sum> sums_;
+
+  // With automatic bounds, the row of partition p holds the bins of its
+  // ApproxBounds at [p * num_bins_, (p + 1) * num_bins_), with the number of
+  // values in each bin and the sum of their remainders in the bin.
+  int num_bins_ = 0;
+  std::vector<int64_t> pos_bins_;
+  std::vector<int64_t> neg_bins_;
+  std::vector<Sum> pos_remainders_;
+  std::vector<Sum> neg_remainders_;
+  // Lower boundaries and widths of the positive and negative bins.
+  std::vector<T> pos_lefts_;
+  std::vector<T> neg_lefts_;
+  std::vector<T> pos_widths_;
+  std::vector<T> neg_widths_;
+
+  // Shared memory object holding the arrays that all processes add to, or
+  // null if entries are only added to the vectors above. With shared memory,
+  // the vectors hold a copy of the arrays taken by PartialResults.
+  std::unique_ptr<internal::SharedMemoryRegion> shared_region_;
+  SharedColumns shared_;
+
+  bool result_returned_ = false;
+};
+
+template <typename T>
+class ColumnarPartitionStore<T>::Builder {
+ public:
+  ColumnarPartitionStore<T>::Builder& SetEpsilon(double epsilon) {
+    epsilon_ = epsilon;
+    return *this;
+  }
+
+  ColumnarPartitionStore<T>::Builder& SetDelta(double delta) {
+    delta_ = delta;
+    return *this;
+  }
+
+  ColumnarPartitionStore<T>::Builder& SetNumPartitions(int64_t num_partitions) {
+    num_partitions_ = num_partitions;
+    return *this;
+  }
+
+  ColumnarPartitionStore<T>::Builder& SetMaxPartitionsContributed(
+      int max_partitions_contributed) {
+    max_partitions_contributed_ = max_partitions_contributed;
+    return *this;
+  }
+
+  ColumnarPartitionStore<T>::Builder& SetMaxContributionsPerPartition(
+      int max_contributions_per_partition) {
+    max_contributions_per_partition_ = max_contributions_per_partition;
+    return *this;
+  }
+
+  ColumnarPartitionStore<T>::Builder& SetLower(T lower) {
+    lower_ = lower;
+    return *this;
+  }
+
+  ColumnarPartitionStore<T>::Builder& SetUpper(T upper) {
+    upper_ = upper;
+    return *this;
+  }
+
+  // ApproxBounds whose bins and budget are used for the automatic bounds of
+  // every partition. Its epsilon is part of the half of epsilon of the sum.
+  ColumnarPartitionStore<T>::Builder& SetApproxBounds(
+      std::unique_ptr<ApproxBounds<T>> approx_bounds) {
+    approx_bounds_ = std::move(approx_bounds);
+    return *this;
+  }
+
+  // Places the per-partition state in the POSIX shared memory object with the
+  // given name, which must start with a slash. Stores built with the same
+  // name on the same host share their entries; their parameters must match.
+  // The object persists until RemoveSharedMemory is called.
+  ColumnarPartitionStore<T>::Builder& SetSharedMemoryName(std::string name) {
+    shared_memory_name_ = std::move(name);
+    return *this;
+  }
+
+  ColumnarPartitionStore<T>::Builder& SetLaplaceMechanism(
+      std::unique_ptr<NumericalMechanismBuilder> mechanism_builder) {
+    mechanism_builder_ = std::move(mechanism_builder);
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<ColumnarPartitionStore<T>>> Build() {
+    RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
+    RETURN_IF_ERROR(ValidateDelta(delta_));
+    RETURN_IF_ERROR(ValidateIsNonNegative(num_partitions_,
+                                          "Number of partitions"));
+    RETURN_IF_ERROR(ValidateBounds(lower_, upper_));
+    if (lower_.has_value() &&
+        lower_.value() < -1 * std::numeric_limits<T>::max()) {
+      return absl::InvalidArgumentError(
+          "Lower bound cannot be higher in magnitude than the max numeric "
+          "limit.");
+    }
+    RETURN_IF_ERROR(
+        ValidateMaxPartitionsContributed(max_partitions_contributed_));
+    RETURN_IF_ERROR(
+        ValidateMaxContributionsPerPartition(max_contributions_per_partition_));
+
+    const double epsilon = epsilon_.value() / 2;
+    const double delta = delta_ / 2;
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> count_mechanism,
+                     mechanism_builder_->Clone()
+                         ->SetEpsilon(epsilon)
+                         .SetDelta(delta)
+                         .SetL0Sensitivity(max_partitions_contributed_)
+                         .SetLInfSensitivity(max_contributions_per_partition_)
+                         .Build());
+    std::unique_ptr<NumericalMechanism> sum_mechanism;
+    if (lower_.has_value()) {
+      ASSIGN_OR_RETURN(
+          sum_mechanism,
+          mechanism_builder_->Clone()
+              ->SetEpsilon(epsilon)
+              .SetDelta(delta)
+              .SetL0Sensitivity(max_partitions_contributed_)
+              .SetLInfSensitivity(
+                  max_contributions_per_partition_ *
+                  std::max(std::abs(static_cast<double>(lower_.value())),
+                           std::abs(static_cast<double>(upper_.value()))))
+              .Build());
+      approx_bounds_.reset();
+    } else {
+      if (approx_bounds_ == nullptr) {
+        ASSIGN_OR_RETURN(
+            approx_bounds_,
+            typename ApproxBounds<T>::Builder()
+                .SetEpsilon(epsilon / 2)
+                .SetLaplaceMechanism(mechanism_builder_->Clone())
+                .SetMaxContributionsPerPartition(
+                    max_contributions_per_partition_)
+                .SetMaxPartitionsContributed(max_partitions_contributed_)
+                .Build());
+      }
+      if (epsilon <= approx_bounds_->GetEpsilon()) {
+        return absl::InvalidArgumentError(absl::StrCat(
+            "Approx Bounds consumes more epsilon budget than available. Sum "
+            "Epsilon: ",
+            epsilon, " Approx Bounds Epsilon: ", approx_bounds_->GetEpsilon()));
+      }
+    }
+
+    std::unique_ptr<ColumnarPartitionStore<T>> store =
+        absl::WrapUnique(new ColumnarPartitionStore<T>(
+            epsilon_.value(), delta_, num_partitions_,
+            max_partitions_contributed_, max_contributions_per_partition_,
+            lower_, upper_, std::move(count_mechanism),
+            std::move(sum_mechanism), mechanism_builder_->Clone(),
+            std::move(approx_bounds_)));
+    if (shared_memory_name_.has_value()) {
+      RETURN_IF_ERROR(store->AttachSharedMemory(*shared_memory_name_));
+    }
+    return store;
+  }
+
+ private:
+  std::optional<double> epsilon_;
+  double delta_ = 0;
+  int64_t num_partitions_ = 0;
+  std::optional<T> lower_;
+  std::optional<T> upper_;
+  int max_partitions_contributed_ = 1;
+  int max_contributions_per_partition_ = 1;
+  std::unique_ptr<ApproxBounds<T>> approx_bounds_;
+  std::optional<std::string> shared_memory_name_;
+  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
+      std::make_unique<LaplaceMechanism::Builder>();
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COLUMNAR_PARTITION_STORE_H_
@@ -0,0 +1,419 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/columnar-partition-store.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/approx-bounds.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+template <typename T>
+std::unique_ptr<ApproxBounds<T>> MakeApproxBoundsWithoutNoise() {
+  return typename ApproxBounds<T>::Builder()
+      .SetEpsilon(0.25)
+      // Few bins, so that the success probability of the threshold does not
+      // underflow.
+      .SetNumBins(16)
+      .SetScale(1)
+      .SetThresholdForTest(2)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .Build()
+      .value();
+}
+
+// Name that is unique per test process, since shared memory is host-wide.
+std::string SharedMemoryName(absl::string_view name) {
+  return absl::StrCat("/", name, "-", getpid());
+}
+
+template <typename T>
+std::unique_ptr<ColumnarPartitionStore<T>> MakeSharedStore(
+    const std::string& name) {
+  return typename ColumnarPartitionStore<T>::Builder()
+      .SetEpsilon(1)
+      .SetNumPartitions(2)
+      .SetApproxBounds(MakeApproxBoundsWithoutNoise<T>())
+      .SetSharedMemoryName(name)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .Build()
+      .value();
+}
+
+template <typename T>
+class ColumnarPartitionStoreTest : public testing::Test {};
+
+typedef ::testing::Types<int64_t, double> NumericTypes;
+TYPED_TEST_SUITE(ColumnarPartitionStoreTest, NumericTypes);
+
+TYPED_TEST(ColumnarPartitionStoreTest, FixedBoundsCountAndClampPerPartition) {
+  std::unique_ptr<ColumnarPartitionStore<TypeParam>> store =
+      typename ColumnarPartitionStore<TypeParam>::Builder()
+          .SetEpsilon(1)
+          .SetNumPartitions(3)
+          .SetLower(-5)
+          .SetUpper(10)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  ASSERT_OK(store->AddEntries({0, 2, 0, 2, 2}, {1, 100, 2, -100, 3}));
+  ASSERT_OK(store->AddEntry(0, 4));
+
+  absl::StatusOr<typename ColumnarPartitionStore<TypeParam>::Results> results =
+      store->PartialResults();
+  ASSERT_OK(results);
+  EXPECT_THAT(results->counts, ElementsAre(3, 0, 3));
+  EXPECT_THAT(results->sums, ElementsAre(7, 0, 8));
+  for (const absl::Status& status : results->sum_statuses) {
+    EXPECT_OK(status);
+  }
+}
+
+TYPED_TEST(ColumnarPartitionStoreTest, ApproxBoundsMatchBoundedSum) {
+  std::unique_ptr<ColumnarPartitionStore<TypeParam>> store =
+      typename ColumnarPartitionStore<TypeParam>::Builder()
+          .SetEpsilon(1)
+          .SetNumPartitions(3)
+          .SetApproxBounds(MakeApproxBoundsWithoutNoise<TypeParam>())
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  // Partitions with different bounds, and a large value that is clamped.
+  const std::vector<std::vector<TypeParam>> entries = {
+      {1, 2, 2, 3, 3, 1000},
+      {-7, -6, -6, 5, 5, 12, 12},
+      {40, 50, 60, 60, -1, -1, -1}};
+  std::vector<int64_t> partitions;
+  std::vector<TypeParam> values;
+  for (int partition = 0; partition < entries.size(); ++partition) {
+    for (TypeParam value : entries[partition]) {
+      partitions.push_back(partition);
+      values.push_back(value);
+    }
+  }
+  ASSERT_OK(store->AddEntries(partitions, values));
+  absl::StatusOr<typename ColumnarPartitionStore<TypeParam>::Results> results =
+      store->PartialResults();
+  ASSERT_OK(results);
+
+  for (int partition = 0; partition < entries.size(); ++partition) {
+    std::unique_ptr<BoundedSum<TypeParam>> bounded_sum =
+        typename BoundedSum<TypeParam>::Builder()
+            .SetEpsilon(0.5)
+            .SetApproxBounds(MakeApproxBoundsWithoutNoise<TypeParam>())
+            .SetLaplaceMechanism(
+                std::make_unique<ZeroNoiseMechanism::Builder>())
+            .Build()
+            .value();
+    bounded_sum->AddEntries(entries[partition]);
+    absl::StatusOr<Output> expected = bounded_sum->PartialResult();
+    ASSERT_OK(expected);
+    EXPECT_OK(results->sum_statuses[partition]);
+    EXPECT_NEAR(results->sums[partition], GetValue<TypeParam>(*expected),
+                1e-9)
+        << "partition " << partition;
+    EXPECT_EQ(results->counts[partition], entries[partition].size());
+  }
+}
+
+TYPED_TEST(ColumnarPartitionStoreTest, SharedMemoryStoresShareEntries) {
+  const std::string name = SharedMemoryName("columnar-shared-test");
+  auto make_store = [&name]() {
+    return typename ColumnarPartitionStore<TypeParam>::Builder()
+        .SetEpsilon(1)
+        .SetNumPartitions(3)
+        .SetLower(-5)
+        .SetUpper(10)
+        .SetSharedMemoryName(name)
+        .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+        .Build()
+        .value();
+  };
+  std::unique_ptr<ColumnarPartitionStore<TypeParam>> first = make_store();
+  std::unique_ptr<ColumnarPartitionStore<TypeParam>> second = make_store();
+  ASSERT_OK(first->AddEntries({0, 2, 0}, {1, 100, 2}));
+  ASSERT_OK(second->AddEntries({2, 2, 0}, {-100, 3, 4}));
+
+  absl::StatusOr<typename ColumnarPartitionStore<TypeParam>::Results> results =
+      first->PartialResults();
+  ASSERT_OK(results);
+  EXPECT_THAT(results->counts, ElementsAre(3, 0, 3));
+  EXPECT_THAT(results->sums, ElementsAre(7, 0, 8));
+
+  // Resetting one store clears the entries of both.
+  first->Reset();
+  ASSERT_OK(first->AddEntry(1, 1));
+  results = second->PartialResults();
+  ASSERT_OK(results);
+  EXPECT_THAT(results->counts, ElementsAre(0, 1, 0));
+  EXPECT_THAT(results->sums, ElementsAre(0, 1, 0));
+  EXPECT_OK(ColumnarPartitionStore<TypeParam>::RemoveSharedMemory(name));
+}
+
+TYPED_TEST(ColumnarPartitionStoreTest, SharedMemoryAcrossProcesses) {
+  const std::string name = SharedMemoryName("columnar-process-test");
+  std::unique_ptr<ColumnarPartitionStore<TypeParam>> store =
+      MakeSharedStore<TypeParam>(name);
+  ASSERT_OK(store->AddEntries({0, 0, 1}, {1, 1, 1}));
+
+  // Each worker builds its own store on the same shared memory.
+  std::vector<pid_t> workers;
+  for (int worker = 0; worker < 4; ++worker) {
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      std::unique_ptr<ColumnarPartitionStore<TypeParam>> worker_store =
+          MakeSharedStore<TypeParam>(name);
+      bool ok = true;
+      for (int i = 0; i < 1000; ++i) {
+        ok &= worker_store->AddEntries({0, 1}, {2, -1}).ok();
+      }
+      _exit(ok ? 0 : 1);
+    }
+    workers.push_back(pid);
+  }
+  for (const pid_t pid : workers) {
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  absl::StatusOr<typename ColumnarPartitionStore<TypeParam>::Results> results =
+      store->PartialResults();
+  ASSERT_OK(results);
+  EXPECT_THAT(results->counts, ElementsAre(4002, 4001));
+  ASSERT_OK(results->sum_statuses[0]);
+  ASSERT_OK(results->sum_statuses[1]);
+  EXPECT_EQ(results->sums[0], 8002);
+  EXPECT_EQ(results->sums[1], -3999);
+  EXPECT_OK(ColumnarPartitionStore<TypeParam>::RemoveSharedMemory(name));
+}
+
+TEST(ColumnarPartitionStoreTest, SharedMemoryRequiresSameParameters) {
+  const std::string name = SharedMemoryName("columnar-parameters-test");
+  std::unique_ptr<ColumnarPartitionStore<int64_t>> store =
+      MakeSharedStore<int64_t>(name);
+  // Another number of partitions changes the size of the shared memory.
+  EXPECT_THAT(ColumnarPartitionStore<int64_t>::Builder()
+                  .SetEpsilon(1)
+                  .SetNumPartitions(3)
+                  .SetApproxBounds(MakeApproxBoundsWithoutNoise<int64_t>())
+                  .SetSharedMemoryName(name)
+                  .Build(),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  // Another value type has the same size, but other parameters.
+  EXPECT_THAT(ColumnarPartitionStore<double>::Builder()
+                  .SetEpsilon(1)
+                  .SetNumPartitions(2)
+                  .SetApproxBounds(MakeApproxBoundsWithoutNoise<double>())
+                  .SetSharedMemoryName(name)
+                  .Build(),
+              StatusIs(absl::StatusCode::kFailedPrecondition,
+                       HasSubstr("other parameters")));
+  EXPECT_OK(ColumnarPartitionStore<int64_t>::RemoveSharedMemory(name));
+  EXPECT_THAT(ColumnarPartitionStore<int64_t>::RemoveSharedMemory(name),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(ColumnarPartitionStoreTest, PartitionWithoutBoundsHasError) {
+  std::unique_ptr<ColumnarPartitionStore<double>> store =
+      ColumnarPartitionStore<double>::Builder()
+          .SetEpsilon(1)
+          .SetNumPartitions(2)
+          .SetApproxBounds(MakeApproxBoundsWithoutNoise<double>())
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  // Partition 1 has a single entry, below the bin count threshold.
+  ASSERT_OK(store->AddEntries({0, 0, 0, 1}, {1, 1, 1, 1}));
+  absl::StatusOr<ColumnarPartitionStore<double>::Results> results =
+      store->PartialResults();
+  ASSERT_OK(results);
+  EXPECT_OK(results->sum_statuses[0]);
+  EXPECT_EQ(results->sums[0], 3);
+  EXPECT_THAT(results->sum_statuses[1],
+              StatusIs(absl::StatusCode::kFailedPrecondition,
+                       HasSubstr("approximate bounds")));
+  EXPECT_TRUE(results->sum_statuses[1]
+                  .GetPayload(kApproxBoundsNotEnoughDataUrl)
+                  .has_value());
+  EXPECT_EQ(results->sums[1], 0);
+  EXPECT_THAT(results->counts, ElementsAre(3, 1));
+}
+
+TEST(ColumnarPartitionStoreTest, IgnoresNan) {
+  std::unique_ptr<ColumnarPartitionStore<double>> store =
+      ColumnarPartitionStore<double>::Builder()
+          .SetEpsilon(1)
+          .SetNumPartitions(1)
+          .SetLower(0)
+          .SetUpper(10)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  ASSERT_OK(store->AddEntries(
+      {0, 0, 0}, {1, std::numeric_limits<double>::quiet_NaN(), 2}));
+  absl::StatusOr<ColumnarPartitionStore<double>::Results> results =
+      store->PartialResults();
+  ASSERT_OK(results);
+  EXPECT_THAT(results->counts, ElementsAre(2));
+  EXPECT_THAT(results->sums, ElementsAre(3));
+}
+
+TEST(ColumnarPartitionStoreTest, InvalidEntriesAreNotAdded) {
+  std::unique_ptr<ColumnarPartitionStore<int64_t>> store =
+      ColumnarPartitionStore<int64_t>::Builder()
+          .SetEpsilon(1)
+          .SetNumPartitions(2)
+          .SetLower(0)
+          .SetUpper(10)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  EXPECT_THAT(store->AddEntries({0, 2}, {1, 1}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Partition indices")));
+  EXPECT_THAT(store->AddEntry(-1, 1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(store->AddEntries({0, 1}, {1}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("same size")));
+  absl::StatusOr<ColumnarPartitionStore<int64_t>::Results> results =
+      store->PartialResults();
+  ASSERT_OK(results);
+  EXPECT_THAT(results->counts, ElementsAre(0, 0));
+  EXPECT_THAT(results->sums, ElementsAre(0, 0));
+}
+
+TEST(ColumnarPartitionStoreTest, ResultsOnlyOnceUntilReset) {
+  std::unique_ptr<ColumnarPartitionStore<int64_t>> store =
+      ColumnarPartitionStore<int64_t>::Builder()
+          .SetEpsilon(1)
+          .SetNumPartitions(1)
+          .SetLower(0)
+          .SetUpper(10)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  ASSERT_OK(store->AddEntry(0, 5));
+  ASSERT_OK(store->PartialResults());
+  EXPECT_THAT(store->PartialResults(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  store->Reset();
+  ASSERT_OK(store->AddEntry(0, 3));
+  absl::StatusOr<ColumnarPartitionStore<int64_t>::Results> results =
+      store->PartialResults();
+  ASSERT_OK(results);
+  EXPECT_THAT(results->counts, ElementsAre(1));
+  EXPECT_THAT(results->sums, ElementsAre(3));
+}
+
+TEST(ColumnarPartitionStoreTest, NoisyResultsAreClose) {
+  std::unique_ptr<ColumnarPartitionStore<double>> store =
+      ColumnarPartitionStore<double>::Builder()
+          .SetEpsilon(10)
+          .SetNumPartitions(100)
+          .Build()
+          .value();
+  std::vector<int64_t> partitions;
+  std::vector<double> values;
+  for (int partition = 0; partition < 100; ++partition) {
+    for (int i = 0; i < 1000; ++i) {
+      partitions.push_back(partition);
+      values.push_back(i % 2 == 0 ? 1 : 3);
+    }
+  }
+  ASSERT_OK(store->AddEntries(partitions, values));
+  absl::StatusOr<ColumnarPartitionStore<double>::Results> results =
+      store->PartialResults();
+  ASSERT_OK(results);
+  for (int partition = 0; partition < 100; ++partition) {
+    EXPECT_NEAR(results->counts[partition], 1000, 20);
+    ASSERT_OK(results->sum_statuses[partition]);
+    // Automatic bounds are [-4, 4].
+    EXPECT_NEAR(results->sums[partition], 2000, 100);
+  }
+}
+
+TEST(ColumnarPartitionStoreTest, MemoryDoesNotGrowWithEntries) {
+  std::unique_ptr<ColumnarPartitionStore<int64_t>> store =
+      ColumnarPartitionStore<int64_t>::Builder()
+          .SetEpsilon(1)
+          .SetNumPartitions(10)
+          .Build()
+          .value();
+  const int64_t memory = store->MemoryUsed();
+  std::vector<int64_t> partitions(10000);
+  std::vector<int64_t> values(10000);
+  for (int i = 0; i < 10000; ++i) {
+    partitions[i] = i % 10;
+    values[i] = i;
+  }
+  ASSERT_OK(store->AddEntries(partitions, values));
+  EXPECT_EQ(store->MemoryUsed(), memory);
+}
+
+TEST(ColumnarPartitionStoreTest, InvalidParametersFail) {
+  EXPECT_THAT(ColumnarPartitionStore<double>::Builder().Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Epsilon must be set")));
+  EXPECT_THAT(ColumnarPartitionStore<double>::Builder()
+                  .SetEpsilon(1)
+                  .SetNumPartitions(-1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Number of partitions")));
+  EXPECT_THAT(ColumnarPartitionStore<double>::Builder()
+                  .SetEpsilon(1)
+                  .SetLower(1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ColumnarPartitionStore<double>::Builder()
+                  .SetEpsilon(1)
+                  .SetApproxBounds(ApproxBounds<double>::Builder()
+                                       .SetEpsilon(0.5)
+                                       .Build()
+                                       .value())
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Approx Bounds consumes")));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,349 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_CONCURRENT_ACCUMULATORS_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_CONCURRENT_ACCUMULATORS_H_
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "google/protobuf/any.pb.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/bounded-mean.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "algorithms/internal/sharded-accumulator.h"
+#include "algorithms/util.h"
+#include "proto/util.h"
+#include "proto/confidence-interval.pb.h"
+#include "proto/data.pb.h"
+#include "proto/summary.pb.h"
+#include "base/instrumentation.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Variants of Count, and of BoundedSum and BoundedMean with fixed bounds, to
+// which many threads add entries at the same time, e.g., a metric recorded
+// by every request of a server. AddEntry, AddEntries, Serialize and Merge are
+// thread safe and do not take a lock: the state is an
+// internal::ShardedAccumulator with one cache line per shard. All other
+// methods, in particular PartialResult and Reset, must not run concurrently
+// with each other.
+//
+// The result is computed from a snapshot of the shards in which every entry
+// is either fully included or not at all; entries that are added while the
+// result is generated may be left out. The snapshot is merged into an
+// instance of the wrapped algorithm, which adds the noise, so outputs,
+// confidence intervals and summaries are the same as the ones of the wrapped
+// algorithm. Summaries can be merged in both directions.
+template <typename T, typename S>
+class ConcurrentAccumulator : public Algorithm<T> {
+ public:
+  using Snapshot = typename internal::ShardedAccumulator<S>::Snapshot;
+
+  Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
+    return ToSummary(shards_.Read());
+  }
+
+  absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    ASSIGN_OR_RETURN(Snapshot snapshot, FromSummary(summary));
+    shards_.Add(snapshot.sum, snapshot.count);
+    return absl::OkStatus();
+  }
+
+  int64_t MemoryUsed() override {
+    return sizeof(ConcurrentAccumulator<T, S>) + shards_.MemoryUsed() +
+           algorithm_->MemoryUsed();
+  }
+
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level) override {
+    return algorithm_->NoiseConfidenceInterval(confidence_level);
+  }
+
+ protected:
+  // num_shards is passed to internal::ShardedAccumulator.
+  ConcurrentAccumulator(std::unique_ptr<Algorithm<T>> algorithm,
+                        int num_shards)
+      : Algorithm<T>(algorithm->GetEpsilon(), algorithm->GetDelta()),
+        algorithm_(std::move(algorithm)),
+        shards_(num_shards) {}
+
+  // Converts between the summary of the wrapped algorithm and the sum and
+  // count of the shards.
+  virtual Summary ToSummary(const Snapshot& snapshot) const = 0;
+  virtual absl::StatusOr<Snapshot> FromSummary(
+      const Summary& summary) const = 0;
+
+  void AddToShards(S sum, int64_t count) { shards_.Add(sum, count); }
+
+  absl::StatusOr<Output> GenerateResult(double noise_interval_level) override {
+    algorithm_->Reset();
+    RETURN_IF_ERROR(algorithm_->Merge(Serialize()));
+    return algorithm_->PartialResult(noise_interval_level);
+  }
+
+  void ResetState() override { shards_.Clear(); }
+
+ private:
+  // Adds the noise; only holds entries while a result is generated.
+  std::unique_ptr<Algorithm<T>> algorithm_;
+  internal::ShardedAccumulator<S> shards_;
+};
+
+// Count to which entries can be added concurrently. See
+// ConcurrentAccumulator.
+template <typename T>
+class ConcurrentCount : public ConcurrentAccumulator<T, int64_t> {
+ public:
+  // Builds the wrapped Count with builder. A num_shards of 0 picks a number
+  // of shards for the hardware.
+  static absl::StatusOr<std::unique_ptr<ConcurrentCount<T>>> Create(
+      typename Count<T>::Builder& builder, int num_shards = 0) {
+    ASSIGN_OR_RETURN(std::unique_ptr<Count<T>> count, builder.Build());
+    return absl::WrapUnique(
+        new ConcurrentCount<T>(std::move(count), num_shards));
+  }
+
+  void AddEntry(const T& t) override { this->AddToShards(0, 1); }
+
+  void AddEntries(absl::Span<const T> entries) override {
+    this->AddToShards(0, entries.size());
+  }
+
+  // Negative numbers of entries are ignored, like in Count.
+  void AddMultipleEntries(int64_t num_of_entries) {
+    if (num_of_entries > 0) {
+      this->AddToShards(0, num_of_entries);
+    }
+  }
+
+ protected:
+  using Snapshot = typename ConcurrentAccumulator<T, int64_t>::Snapshot;
+
+  Summary ToSummary(const Snapshot& snapshot) const override {
+    CountSummary count_summary;
+    count_summary.set_count(snapshot.count);
+    Summary summary;
+    summary.mutable_data()->PackFrom(count_summary);
+    return summary;
+  }
+
+  absl::StatusOr<Snapshot> FromSummary(const Summary& summary) const override {
+    CountSummary count_summary;
+    if (!summary.has_data() || !summary.data().UnpackTo(&count_summary)) {
+      return absl::InternalError("Count summary unable to be unpacked.");
+    }
+    Snapshot snapshot;
+    snapshot.count = count_summary.count();
+    return snapshot;
+  }
+
+ private:
+  ConcurrentCount(std::unique_ptr<Count<T>> count, int num_shards)
+      : ConcurrentAccumulator<T, int64_t>(std::move(count), num_shards) {}
+};
+
+// BoundedSum with fixed bounds to which entries can be added concurrently.
+// See ConcurrentAccumulator.
+template <typename T, typename Accumulator = T>
+class ConcurrentBoundedSum : public ConcurrentAccumulator<T, Accumulator> {
+ public:
+  // Builds the wrapped BoundedSum with builder, which must set both bounds. A
+  // num_shards of 0 picks a number of shards for the hardware.
+  static absl::StatusOr<std::unique_ptr<ConcurrentBoundedSum<T, Accumulator>>>
+  Create(typename BoundedSum<T, Accumulator>::Builder& builder,
+         int num_shards = 0) {
+    using Sum = BoundedSum<T, Accumulator>;
+    ASSIGN_OR_RETURN(std::unique_ptr<Sum> sum, builder.Build());
+    if (!sum->lower().has_value() || !sum->upper().has_value()) {
+      return absl::InvalidArgumentError(
+          "A concurrent BoundedSum requires both the lower and the upper "
+          "bound to be set.");
+    }
+    const T lower = *sum->lower();
+    const T upper = *sum->upper();
+    return absl::WrapUnique(new ConcurrentBoundedSum<T, Accumulator>(
+        std::move(sum), lower, upper, num_shards));
+  }
+
+  void AddEntry(const T& t) override {
+    if (!std::isnan(static_cast<double>(t))) {
+      this->AddToShards(Clamp<T>(lower_, upper_, t), 0);
+    }
+  }
+
+  // Sums the entries locally and adds them to the shards at once.
+  void AddEntries(absl::Span<const T> entries) override {
+    Accumulator sum = 0;
+    for (const T& entry : entries) {
+      if (!std::isnan(static_cast<double>(entry))) {
+        sum += Clamp<T>(lower_, upper_, entry);
+      }
+    }
+    this->AddToShards(sum, 0);
+  }
+
+  T lower() const { return lower_; }
+  T upper() const { return upper_; }
+
+ protected:
+  using Snapshot = typename ConcurrentAccumulator<T, Accumulator>::Snapshot;
+
+  Summary ToSummary(const Snapshot& snapshot) const override {
+    BoundedSumSummary sum_summary;
+    SetValue(sum_summary.add_pos_sum(), snapshot.sum);
+    Summary summary;
+    summary.mutable_data()->PackFrom(sum_summary);
+    return summary;
+  }
+
+  absl::StatusOr<Snapshot> FromSummary(const Summary& summary) const override {
+    BoundedSumSummary sum_summary;
+    if (!summary.has_data() || !summary.data().UnpackTo(&sum_summary)) {
+      return absl::InternalError("Bounded sum summary unable to be unpacked.");
+    }
+    if (sum_summary.pos_sum_size() != 1) {
+      return absl::InternalError(absl::StrCat(
+          "Bounded sum summary must have exactly one pos_sum but got ",
+          sum_summary.pos_sum_size()));
+    }
+    Snapshot snapshot;
+    snapshot.sum = GetValue<Accumulator>(sum_summary.pos_sum(0));
+    return snapshot;
+  }
+
+ private:
+  ConcurrentBoundedSum(std::unique_ptr<BoundedSum<T, Accumulator>> sum,
+                       T lower, T upper, int num_shards)
+      : ConcurrentAccumulator<T, Accumulator>(std::move(sum), num_shards),
+        lower_(lower),
+        upper_(upper) {}
+
+  const T lower_;
+  const T upper_;
+};
+
+// BoundedMean with fixed bounds to which entries can be added concurrently.
+// See ConcurrentAccumulator.
+template <typename T>
+class ConcurrentBoundedMean : public ConcurrentAccumulator<T, T> {
+ public:
+  // Builds the wrapped BoundedMean with builder, which must set both bounds.
+  // A num_shards of 0 picks a number of shards for the hardware.
+  static absl::StatusOr<std::unique_ptr<ConcurrentBoundedMean<T>>> Create(
+      typename BoundedMean<T>::Builder& builder, int num_shards = 0) {
+    ASSIGN_OR_RETURN(std::unique_ptr<BoundedMean<T>> mean, builder.Build());
+    const auto* fixed_bounds =
+        dynamic_cast<const BoundedMeanWithFixedBounds<T>*>(mean.get());
+    if (fixed_bounds == nullptr) {
+      return absl::InvalidArgumentError(
+          "A concurrent BoundedMean requires both the lower and the upper "
+          "bound to be set.");
+    }
+    const T lower = fixed_bounds->lower();
+    const T upper = fixed_bounds->upper();
+    return absl::WrapUnique(new ConcurrentBoundedMean<T>(
+        std::move(mean), lower, upper, num_shards));
+  }
+
+  void AddEntry(const T& t) override {
+    if (!std::isnan(static_cast<double>(t))) {
+      this->AddToShards(Normalize(t), 1);
+    }
+  }
+
+  // Sums the entries locally and adds them to the shards at once.
+  void AddEntries(absl::Span<const T> entries) override {
+    T sum = 0;
+    int64_t count = 0;
+    for (const T& entry : entries) {
+      if (!std::isnan(static_cast<double>(entry))) {
+        sum += Normalize(entry);
+        ++count;
+      }
+    }
+    this->AddToShards(sum, count);
+  }
+
+  T lower() const { return lower_; }
+  T upper() const { return upper_; }
+
+ protected:
+  using Snapshot = typename ConcurrentAccumulator<T, T>::Snapshot;
+
+  Summary ToSummary(const Snapshot& snapshot) const override {
+    BoundedMeanSummary mean_summary;
+    mean_summary.set_count(snapshot.count);
+    SetValue(mean_summary.add_pos_sum(), snapshot.sum);
+    Summary summary;
+    summary.mutable_data()->PackFrom(mean_summary);
+    return summary;
+  }
+
+  absl::StatusOr<Snapshot> FromSummary(const Summary& summary) const override {
+    BoundedMeanSummary mean_summary;
+    if (!summary.has_data() || !summary.data().UnpackTo(&mean_summary)) {
+      return absl::InternalError("Bounded mean summary unable to be unpacked.");
+    }
+    if (mean_summary.pos_sum_size() != 1) {
+      return absl::InternalError(absl::StrCat(
+          "Bounded mean summary must have exactly one pos_sum but got ",
+          mean_summary.pos_sum_size()));
+    }
+    Snapshot snapshot;
+    snapshot.sum = GetValue<T>(mean_summary.pos_sum(0));
+    snapshot.count = mean_summary.count();
+    return snapshot;
+  }
+
+ private:
+  ConcurrentBoundedMean(std::unique_ptr<BoundedMean<T>> mean, T lower, T upper,
+                        int num_shards)
+      : ConcurrentAccumulator<T, T>(std::move(mean), num_shards),
+        lower_(lower),
+        upper_(upper) {}
+
+  // Same as BoundedMeanWithFixedBounds: inputs are clamped, and floating point
+  // inputs are shifted by the midpoint of the bounds.
+  T Normalize(const T& t) const {
+    T processed_input = Clamp<T>(lower_, upper_, t);
+    if constexpr (std::is_floating_point<T>::value) {
+      processed_input -= lower_ + ((upper_ - lower_) / 2.0);
+    }
+    return processed_input;
+  }
+
+  const T lower_;
+  const T upper_;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_CONCURRENT_ACCUMULATORS_H_
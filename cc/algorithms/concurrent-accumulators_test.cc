@@ -0,0 +1,193 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/concurrent-accumulators.h"
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/bounded-mean.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "proto/util.h"
+#include "proto/data.pb.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::HasSubstr;
+
+// Runs add on 8 threads at once.
+template <typename Function>
+void OnManyThreads(Function add) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back(add);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(ConcurrentAccumulatorsTest, CountAddsFromManyThreads) {
+  Count<int>::Builder builder;
+  builder.SetEpsilon(1.0).SetLaplaceMechanism(
+      absl::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<ConcurrentCount<int>>> count =
+      ConcurrentCount<int>::Create(builder);
+  ASSERT_OK(count);
+
+  OnManyThreads([&count]() {
+    for (int i = 0; i < 1000; ++i) {
+      (*count)->AddEntry(i);
+    }
+    (*count)->AddEntries({1, 2, 3});
+    (*count)->AddMultipleEntries(7);
+  });
+
+  absl::StatusOr<Output> result = (*count)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 8 * 1010);
+  EXPECT_THAT((*count)->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("can only produce results once")));
+
+  (*count)->Reset();
+  (*count)->AddEntry(1);
+  result = (*count)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 1);
+}
+
+TEST(ConcurrentAccumulatorsTest, BoundedSumClampsLikeBoundedSum) {
+  BoundedSum<double>::Builder builder;
+  builder.SetEpsilon(1.0).SetLower(-1).SetUpper(2).SetLaplaceMechanism(
+      absl::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<ConcurrentBoundedSum<double>>> sum =
+      ConcurrentBoundedSum<double>::Create(builder);
+  ASSERT_OK(sum);
+  EXPECT_EQ((*sum)->lower(), -1);
+  EXPECT_EQ((*sum)->upper(), 2);
+
+  OnManyThreads([&sum]() {
+    for (int i = 0; i < 100; ++i) {
+      (*sum)->AddEntry(10);
+      (*sum)->AddEntry(-0.5);
+      (*sum)->AddEntry(std::nan(""));
+    }
+    (*sum)->AddEntries({-5, 1});
+  });
+
+  absl::StatusOr<Output> result = (*sum)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_DOUBLE_EQ(GetValue<double>(*result), 8 * (100 * 1.5 + 0));
+}
+
+TEST(ConcurrentAccumulatorsTest, BoundedMeanMatchesBoundedMean) {
+  BoundedMean<double>::Builder builder;
+  builder.SetEpsilon(1.0).SetLower(0).SetUpper(10).SetLaplaceMechanism(
+      absl::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<ConcurrentBoundedMean<double>>> mean =
+      ConcurrentBoundedMean<double>::Create(builder);
+  ASSERT_OK(mean);
+  absl::StatusOr<std::unique_ptr<BoundedMean<double>>> expected =
+      builder.Build();
+  ASSERT_OK(expected);
+
+  const std::vector<double> entries = {1, 2, 4, 20, -3};
+  OnManyThreads([&mean, &entries]() {
+    for (double entry : entries) {
+      (*mean)->AddEntry(entry);
+    }
+    (*mean)->AddEntries(entries);
+  });
+  for (int i = 0; i < 16; ++i) {
+    (*expected)->AddEntries(entries.begin(), entries.end());
+  }
+
+  absl::StatusOr<Output> result = (*mean)->PartialResult();
+  ASSERT_OK(result);
+  absl::StatusOr<Output> expected_result = (*expected)->PartialResult();
+  ASSERT_OK(expected_result);
+  EXPECT_DOUBLE_EQ(GetValue<double>(*result),
+                   GetValue<double>(*expected_result));
+}
+
+TEST(ConcurrentAccumulatorsTest, SummariesMergeWithTheWrappedAlgorithm) {
+  BoundedMean<int64_t>::Builder builder;
+  builder.SetEpsilon(1.0).SetLower(0).SetUpper(10).SetLaplaceMechanism(
+      absl::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<ConcurrentBoundedMean<int64_t>>> mean =
+      ConcurrentBoundedMean<int64_t>::Create(builder);
+  ASSERT_OK(mean);
+  absl::StatusOr<std::unique_ptr<BoundedMean<int64_t>>> other =
+      builder.Build();
+  ASSERT_OK(other);
+
+  (*mean)->AddEntry(2);
+  (*other)->AddEntry(6);
+  ASSERT_OK((*other)->Merge((*mean)->Serialize()));
+  ASSERT_OK((*mean)->Merge((*other)->Serialize()));
+
+  // mean has 2, 2 and 6; other has 2 and 6.
+  absl::StatusOr<Output> result = (*mean)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_DOUBLE_EQ(GetValue<double>(*result), 10.0 / 3);
+  result = (*other)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_DOUBLE_EQ(GetValue<double>(*result), 4);
+
+  Summary count_summary;
+  count_summary.mutable_data()->PackFrom(CountSummary());
+  EXPECT_THAT((*mean)->Merge(count_summary),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(ConcurrentAccumulatorsTest, RequiresFixedBounds) {
+  BoundedSum<double>::Builder sum_builder;
+  sum_builder.SetEpsilon(1.0);
+  EXPECT_THAT(ConcurrentBoundedSum<double>::Create(sum_builder),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("requires both the lower and the upper")));
+
+  BoundedMean<double>::Builder mean_builder;
+  mean_builder.SetEpsilon(1.0);
+  EXPECT_THAT(ConcurrentBoundedMean<double>::Create(mean_builder),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("requires both the lower and the upper")));
+}
+
+TEST(ConcurrentAccumulatorsTest, CreatePropagatesBuilderErrors) {
+  Count<int>::Builder builder;
+  builder.SetEpsilon(-1);
+  EXPECT_THAT(ConcurrentCount<int>::Create(builder),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace differential_privacy
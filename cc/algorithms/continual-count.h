@@ -0,0 +1,227 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_CONTINUAL_COUNT_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_CONTINUAL_COUNT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/numeric/bits.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/util.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Differentially private running count under continual observation, using the
+// binary tree mechanism (Chan, Shi and Song, "Private and Continual Release of
+// Statistics"; Dwork, Naor, Pitassi and Rothblum, "Differential Privacy Under
+// Continual Observation").
+//
+// The stream is divided into at most max_steps steps, e.g., one per minute.
+// Events are added to the current step with Increment; Release closes the
+// step and returns a noisy count of all events since the start of the stream.
+// The whole sequence of releases satisfies (epsilon, delta)-DP, so the budget
+// is spent once for the stream instead of once per release.
+//
+// The count of every step is a leaf of a binary tree over the steps. Every
+// node holds the noisy count of the steps below it, and the count up to step t
+// is the sum of the nodes of the dyadic decomposition of [1, t], i.e., one node
+// per set bit of t. Only the nodes that can still be part of a decomposition
+// are kept, so Increment takes constant time, and Release and the memory take
+// O(log max_steps). Every event is part of at most log2(max_steps) + 1 nodes,
+// which is the L0 sensitivity of the noise; the error of a release grows with
+// log(max_steps)^1.5 for Laplace noise.
+//
+// ContinualCount is not thread safe.
+class ContinualCount {
+ public:
+  class Builder;
+
+  ContinualCount(const ContinualCount&) = delete;
+  ContinualCount& operator=(const ContinualCount&) = delete;
+
+  // Adds count events to the current step. The total number of events of a
+  // privacy unit over the whole stream must not exceed max_contributions.
+  void Increment(int64_t count = 1) { current_ += count; }
+
+  // Closes the current step and returns the noisy number of events of all
+  // steps so far. Returns an error once max_steps steps were released.
+  absl::StatusOr<int64_t> Release() {
+    if (num_steps_ >= max_steps_) {
+      return absl::FailedPreconditionError(absl::StrCat(
+          "All ", max_steps_, " steps of the ContinualCount were released."));
+    }
+    ++num_steps_;
+    // The new node covers the steps of all nodes of lower levels, which are
+    // not part of any later decomposition and are dropped.
+    const int level = absl::countr_zero(static_cast<uint64_t>(num_steps_));
+    int64_t sum = current_;
+    for (int i = 0; i < level; ++i) {
+      sum += exact_[i];
+      exact_[i] = 0;
+      noisy_[i] = 0;
+    }
+    exact_[level] = sum;
+    noisy_[level] = mechanism_->AddNoise(sum);
+    current_ = 0;
+
+    int64_t result = 0;
+    for (int i = 0; i < num_levels_; ++i) {
+      if ((static_cast<uint64_t>(num_steps_) >> i) & 1) {
+        result += noisy_[i];
+      }
+    }
+    return result;
+  }
+
+  // Returns the number of released steps.
+  int64_t num_steps() const { return num_steps_; }
+
+  int64_t max_steps() const { return max_steps_; }
+
+  // Returns the number of noisy node counts that make up a release, which is
+  // also the number of nodes every event is part of.
+  int num_levels() const { return num_levels_; }
+
+  // Returns the confidence interval of the noise of the node counts.
+  absl::StatusOr<ConfidenceInterval> NodeNoiseConfidenceInterval(
+      double confidence_level) {
+    return mechanism_->NoiseConfidenceInterval(confidence_level);
+  }
+
+  // Discards all events and starts a new stream. The new stream spends the
+  // budget again.
+  void Reset() {
+    num_steps_ = 0;
+    current_ = 0;
+    std::fill(exact_.begin(), exact_.end(), 0);
+    std::fill(noisy_.begin(), noisy_.end(), 0);
+  }
+
+  int64_t MemoryUsed() const {
+    return sizeof(ContinualCount) + sizeof(int64_t) * exact_.capacity() +
+           sizeof(int64_t) * noisy_.capacity() + mechanism_->MemoryUsed();
+  }
+
+  double GetEpsilon() const { return epsilon_; }
+  double GetDelta() const { return delta_; }
+
+ private:
+  ContinualCount(double epsilon, double delta, int64_t max_steps,
+                 int num_levels, std::unique_ptr<NumericalMechanism> mechanism)
+      : epsilon_(epsilon),
+        delta_(delta),
+        max_steps_(max_steps),
+        num_levels_(num_levels),
+        mechanism_(std::move(mechanism)),
+        exact_(num_levels, 0),
+        noisy_(num_levels, 0) {}
+
+  const double epsilon_;
+  const double delta_;
+  const int64_t max_steps_;
+  const int num_levels_;
+  std::unique_ptr<NumericalMechanism> mechanism_;
+
+  int64_t num_steps_ = 0;
+  // Events of the current step.
+  int64_t current_ = 0;
+  // Exact and noisy counts of the node of every level that can still be part
+  // of a decomposition, or 0 if there is none.
+  std::vector<int64_t> exact_;
+  std::vector<int64_t> noisy_;
+};
+
+class ContinualCount::Builder {
+ public:
+  Builder& SetEpsilon(double epsilon) {
+    epsilon_ = epsilon;
+    return *this;
+  }
+
+  Builder& SetDelta(double delta) {
+    delta_ = delta;
+    return *this;
+  }
+
+  // Maximum number of steps of the stream. Required.
+  Builder& SetMaxSteps(int64_t max_steps) {
+    max_steps_ = max_steps;
+    return *this;
+  }
+
+  // Maximum number of events of a privacy unit over the whole stream.
+  // Defaults to 1.
+  Builder& SetMaxContributions(int max_contributions) {
+    max_contributions_ = max_contributions;
+    return *this;
+  }
+
+  // Mechanism used to add noise to the node counts. Defaults to Laplace.
+  Builder& SetLaplaceMechanism(
+      std::unique_ptr<NumericalMechanismBuilder> mechanism_builder) {
+    mechanism_builder_ = std::move(mechanism_builder);
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<ContinualCount>> Build() {
+    RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
+    RETURN_IF_ERROR(ValidateDelta(delta_));
+    RETURN_IF_ERROR(ValidateMaxContributions(max_contributions_));
+    if (!max_steps_.has_value() || *max_steps_ <= 0 ||
+        *max_steps_ > kMaxSteps) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Maximum number of steps must be set and in [1, ",
+                       kMaxSteps, "]."));
+    }
+    const int num_levels =
+        64 - absl::countl_zero(static_cast<uint64_t>(*max_steps_));
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mechanism,
+                     mechanism_builder_->SetEpsilon(epsilon_.value())
+                         .SetDelta(delta_)
+                         .SetL0Sensitivity(num_levels)
+                         .SetLInfSensitivity(max_contributions_)
+                         .Build());
+    return absl::WrapUnique(new ContinualCount(epsilon_.value(), delta_,
+                                               *max_steps_, num_levels,
+                                               std::move(mechanism)));
+  }
+
+ private:
+  // Bounds the height of the tree, so that step numbers fit into int64_t.
+  static constexpr int64_t kMaxSteps = int64_t{1} << 62;
+
+  std::optional<double> epsilon_;
+  double delta_ = 0;
+  std::optional<int64_t> max_steps_;
+  int max_contributions_ = 1;
+  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
+      std::make_unique<LaplaceMechanism::Builder>();
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_CONTINUAL_COUNT_H_
@@ -0,0 +1,134 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/continual-count.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/numerical-mechanisms.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::HasSubstr;
+
+std::unique_ptr<ContinualCount> ZeroNoiseCount(int64_t max_steps) {
+  return ContinualCount::Builder()
+      .SetEpsilon(1)
+      .SetMaxSteps(max_steps)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .Build()
+      .value();
+}
+
+TEST(ContinualCountTest, ReleasesRunningCounts) {
+  std::unique_ptr<ContinualCount> count = ZeroNoiseCount(100);
+  int64_t expected = 0;
+  for (int step = 1; step <= 100; ++step) {
+    count->Increment(step % 7);
+    expected += step % 7;
+    absl::StatusOr<int64_t> released = count->Release();
+    ASSERT_OK(released);
+    EXPECT_EQ(*released, expected) << "step " << step;
+  }
+  EXPECT_EQ(count->num_steps(), 100);
+}
+
+TEST(ContinualCountTest, FailsAfterMaxSteps) {
+  std::unique_ptr<ContinualCount> count = ZeroNoiseCount(3);
+  for (int step = 0; step < 3; ++step) {
+    ASSERT_OK(count->Release());
+  }
+
+  EXPECT_THAT(count->Release(),
+              StatusIs(absl::StatusCode::kFailedPrecondition,
+                       HasSubstr("were released")));
+  count->Reset();
+  EXPECT_OK(count->Release());
+}
+
+TEST(ContinualCountTest, NumLevelsIsBitLengthOfMaxSteps) {
+  EXPECT_EQ(ZeroNoiseCount(1)->num_levels(), 1);
+  EXPECT_EQ(ZeroNoiseCount(7)->num_levels(), 3);
+  EXPECT_EQ(ZeroNoiseCount(8)->num_levels(), 4);
+  EXPECT_EQ(ZeroNoiseCount(1 << 20)->num_levels(), 21);
+}
+
+TEST(ContinualCountTest, NoiseIsScaledToNumberOfLevels) {
+  std::unique_ptr<ContinualCount> count = ContinualCount::Builder()
+                                              .SetEpsilon(1)
+                                              .SetMaxSteps(1023)
+                                              .SetMaxContributions(2)
+                                              .Build()
+                                              .value();
+  absl::StatusOr<ConfidenceInterval> interval =
+      count->NodeNoiseConfidenceInterval(0.5);
+  ASSERT_OK(interval);
+
+  // Laplace noise with scale 10 * 2 / epsilon.
+  EXPECT_NEAR(interval->upper_bound(), 20 * std::log(2), 1e-6);
+}
+
+TEST(ContinualCountTest, ErrorOfReleasesIsBounded) {
+  std::unique_ptr<ContinualCount> count = ContinualCount::Builder()
+                                              .SetEpsilon(1)
+                                              .SetMaxSteps(1 << 12)
+                                              .Build()
+                                              .value();
+  // A release is the sum of at most 13 Laplace noises of scale 13, so its
+  // standard deviation is below sqrt(13 * 2) * 13 < 70.
+  double squared_error = 0;
+  for (int step = 1; step <= (1 << 12); ++step) {
+    count->Increment(3);
+    absl::StatusOr<int64_t> released = count->Release();
+    ASSERT_OK(released);
+    squared_error += std::pow(*released - 3.0 * step, 2);
+  }
+  EXPECT_LT(std::sqrt(squared_error / (1 << 12)), 70);
+}
+
+TEST(ContinualCountTest, BuildValidatesParameters) {
+  EXPECT_THAT(ContinualCount::Builder().SetMaxSteps(10).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Epsilon")));
+  EXPECT_THAT(ContinualCount::Builder().SetEpsilon(1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Maximum number of steps")));
+  EXPECT_THAT(ContinualCount::Builder().SetEpsilon(1).SetMaxSteps(0).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Maximum number of steps")));
+  EXPECT_THAT(ContinualCount::Builder()
+                  .SetEpsilon(1)
+                  .SetMaxSteps(10)
+                  .SetMaxContributions(0)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Maximum number of contributions")));
+}
+
+}  // namespace
+}  // namespace differential_privacy
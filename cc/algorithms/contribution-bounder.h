@@ -0,0 +1,231 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_CONTRIBUTION_BOUNDER_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_CONTRIBUTION_BOUNDER_H_
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/hash/hash.h"
+#include "absl/memory/memory.h"
+#include "absl/random/distributions.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "algorithms/keyed-aggregator.h"
+#include "algorithms/rand.h"
+#include "algorithms/util.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Bounds the contributions of every privacy unit in a stream of records in
+// arbitrary order, e.g., rows of a table that are not grouped by user, and
+// passes them on to a KeyedAggregator one privacy unit at a time.
+//
+// For every privacy unit, at most max_partitions_contributed distinct
+// partitions are kept, chosen uniformly at random, and for each of them a
+// reservoir sample of at most max_contributions_per_partition values. So the
+// memory per privacy unit is bounded no matter how many records it has, and
+// no record is kept that bounding would drop anyway.
+//
+// Partitions are sampled by giving every pair of privacy unit and partition a
+// priority from a hash salted with a random seed and keeping the partitions
+// with the smallest priorities. The priority of a pair is the same for all its
+// records, so a partition that was dropped stays dropped. The states of the
+// privacy units are stored in an open-addressing hash table keyed by privacy
+// id, and the sampled partitions of a privacy unit are stored contiguously.
+//
+// Use the same limits as for the KeyedAggregator, so that its own bounding
+// does not drop anything.
+//
+// ContributionBounder is not thread safe.
+template <typename T>
+class ContributionBounder {
+  static_assert(std::is_arithmetic<T>::value,
+                "ContributionBounder can only be used for arithmetic types");
+
+ public:
+  class Builder;
+
+  using Contribution = typename KeyedAggregator<T>::Contribution;
+
+  ContributionBounder(const ContributionBounder&) = delete;
+  ContributionBounder& operator=(const ContributionBounder&) = delete;
+
+  // Adds a record of a privacy unit for a partition. NaN values are ignored.
+  void AddContribution(absl::string_view privacy_id,
+                       absl::string_view partition_key, T value) {
+    if (std::isnan(static_cast<double>(value))) {
+      return;
+    }
+    std::vector<PartitionSample>& partitions =
+        units_.try_emplace(privacy_id).first->second;
+    for (PartitionSample& partition : partitions) {
+      if (partition.partition_key == partition_key) {
+        AddValue(value, partition);
+        return;
+      }
+    }
+
+    const uint64_t priority = absl::HashOf(salt_, privacy_id, partition_key);
+    PartitionSample* sample;
+    if (partitions.size() < static_cast<size_t>(max_partitions_contributed_)) {
+      sample = &partitions.emplace_back();
+    } else {
+      sample = &partitions.front();
+      for (PartitionSample& partition : partitions) {
+        if (partition.priority > sample->priority) {
+          sample = &partition;
+        }
+      }
+      if (priority >= sample->priority) {
+        return;
+      }
+      sample->values.clear();
+      sample->num_values = 0;
+    }
+    sample->priority = priority;
+    sample->partition_key.assign(partition_key.data(), partition_key.size());
+    AddValue(value, *sample);
+  }
+
+  // Returns the number of privacy units with contributions since the last
+  // flush.
+  int64_t NumPrivacyUnits() const { return units_.size(); }
+
+  // Passes the bounded contributions of every privacy unit to the aggregator,
+  // one call of AddPrivacyUnitContributions per privacy unit, and discards
+  // them.
+  void Flush(KeyedAggregator<T>& aggregator) {
+    Flush([&aggregator](absl::Span<const Contribution> contributions) {
+      aggregator.AddPrivacyUnitContributions(contributions);
+    });
+  }
+
+  // Same as above, but passes the bounded contributions of every privacy unit
+  // to consume, e.g., to add them to per-partition algorithms. The
+  // contributions of a partition are adjacent.
+  void Flush(
+      absl::FunctionRef<void(absl::Span<const Contribution>)> consume) {
+    std::vector<Contribution> contributions;
+    for (const auto& [privacy_id, partitions] : units_) {
+      contributions.clear();
+      for (const PartitionSample& partition : partitions) {
+        for (T value : partition.values) {
+          contributions.push_back({partition.partition_key, value});
+        }
+      }
+      consume(contributions);
+    }
+    units_.clear();
+  }
+
+  int64_t MemoryUsed() const {
+    int64_t memory =
+        sizeof(ContributionBounder) +
+        // https://abseil.io/docs/cpp/guides/container#memory-usage
+        (sizeof(std::pair<std::string, std::vector<PartitionSample>>) + 1) *
+            units_.bucket_count();
+    for (const auto& [privacy_id, partitions] : units_) {
+      memory += privacy_id.capacity() +
+                sizeof(PartitionSample) * partitions.capacity();
+      for (const PartitionSample& partition : partitions) {
+        memory += partition.partition_key.capacity() +
+                  sizeof(T) * partition.values.capacity();
+      }
+    }
+    return memory;
+  }
+
+ private:
+  struct PartitionSample {
+    uint64_t priority = 0;
+    std::string partition_key;
+    // Number of values added for the partition, including the ones that are
+    // not in the sample.
+    int64_t num_values = 0;
+    std::vector<T> values;
+  };
+
+  ContributionBounder(int max_partitions_contributed,
+                      int max_contributions_per_partition)
+      : max_partitions_contributed_(max_partitions_contributed),
+        max_contributions_per_partition_(max_contributions_per_partition),
+        salt_(SecureURBG::GetInstance()()) {}
+
+  // Reservoir sampling: the n-th value replaces a random value of a full
+  // sample with probability max_contributions_per_partition / n.
+  void AddValue(T value, PartitionSample& partition) {
+    ++partition.num_values;
+    if (partition.values.size() <
+        static_cast<size_t>(max_contributions_per_partition_)) {
+      partition.values.push_back(value);
+      return;
+    }
+    const int64_t index = absl::Uniform<int64_t>(
+        SecureURBG::GetInstance(), 0, partition.num_values);
+    if (index < max_contributions_per_partition_) {
+      partition.values[index] = value;
+    }
+  }
+
+  const int max_partitions_contributed_;
+  const int max_contributions_per_partition_;
+  const uint64_t salt_;
+  absl::flat_hash_map<std::string, std::vector<PartitionSample>> units_;
+};
+
+template <typename T>
+class ContributionBounder<T>::Builder {
+ public:
+  ContributionBounder<T>::Builder& SetMaxPartitionsContributed(
+      int max_partitions_contributed) {
+    max_partitions_contributed_ = max_partitions_contributed;
+    return *this;
+  }
+
+  ContributionBounder<T>::Builder& SetMaxContributionsPerPartition(
+      int max_contributions_per_partition) {
+    max_contributions_per_partition_ = max_contributions_per_partition;
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<ContributionBounder<T>>> Build() {
+    RETURN_IF_ERROR(
+        ValidateMaxPartitionsContributed(max_partitions_contributed_));
+    RETURN_IF_ERROR(
+        ValidateMaxContributionsPerPartition(max_contributions_per_partition_));
+    return absl::WrapUnique(new ContributionBounder<T>(
+        max_partitions_contributed_, max_contributions_per_partition_));
+  }
+
+ private:
+  int max_partitions_contributed_ = 1;
+  int max_contributions_per_partition_ = 1;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_CONTRIBUTION_BOUNDER_H_
@@ -0,0 +1,252 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/contribution-bounder.h"
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/keyed-aggregator.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/partition-selection.h"
+#include "proto/util.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::ElementsAre;
+using ::testing::Pair;
+using ::testing::SizeIs;
+using ::testing::UnorderedElementsAre;
+
+// Keeps all partitions.
+class KeepAllPartitionSelection : public PartitionSelectionStrategy {
+ public:
+  class Builder : public PartitionSelectionStrategyBuilder {
+   public:
+    absl::StatusOr<std::unique_ptr<PartitionSelectionStrategy>> Build()
+        override {
+      return absl::WrapUnique(new KeepAllPartitionSelection(
+          GetEpsilon().value(), GetDelta().value(),
+          GetMaxPartitionsContributed().value()));
+    }
+  };
+
+  bool ShouldKeep(double num_users) override { return true; }
+
+  double ProbabilityOfKeep(double num_users) const override { return 1; }
+
+ private:
+  KeepAllPartitionSelection(double epsilon, double delta,
+                            int64_t max_partitions_contributed)
+      : PartitionSelectionStrategy(epsilon, delta, max_partitions_contributed,
+                                   /*adjusted_delta=*/0) {}
+};
+
+// Flushes the bounder into an aggregator without noise and bounds of at least
+// the ones of the bounder, and returns partition key -> (count, sum).
+std::map<std::string, std::pair<int64_t, int64_t>> FlushAndAggregate(
+    ContributionBounder<int64_t>& bounder) {
+  std::unique_ptr<KeyedAggregator<int64_t>> aggregator =
+      KeyedAggregator<int64_t>::Builder()
+          .SetEpsilon(1)
+          .SetLower(-100)
+          .SetUpper(100)
+          .SetMaxPartitionsContributed(100)
+          .SetMaxContributionsPerPartition(100)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .SetPartitionSelectionStrategy(
+              std::make_unique<KeepAllPartitionSelection::Builder>())
+          .Build()
+          .value();
+  bounder.Flush(*aggregator);
+  std::map<std::string, std::pair<int64_t, int64_t>> results;
+  absl::StatusOr<std::vector<KeyedAggregator<int64_t>::PartitionResult>>
+      partitions = aggregator->PartialResult();
+  EXPECT_OK(partitions);
+  if (!partitions.ok()) return results;
+  for (const auto& partition : *partitions) {
+    results[partition.partition_key] = {
+        GetValue<int64_t>(partition.output,
+                          KeyedAggregator<int64_t>::kCountIndex),
+        GetValue<int64_t>(partition.output,
+                          KeyedAggregator<int64_t>::kSumIndex)};
+  }
+  return results;
+}
+
+std::unique_ptr<ContributionBounder<int64_t>> MakeBounder(
+    int max_partitions_contributed, int max_contributions_per_partition) {
+  return ContributionBounder<int64_t>::Builder()
+      .SetMaxPartitionsContributed(max_partitions_contributed)
+      .SetMaxContributionsPerPartition(max_contributions_per_partition)
+      .Build()
+      .value();
+}
+
+TEST(ContributionBounderTest, BoundsPartitionsAndContributions) {
+  std::unique_ptr<ContributionBounder<int64_t>> bounder = MakeBounder(3, 2);
+  for (int value = 0; value < 5; ++value) {
+    for (int partition = 0; partition < 10; ++partition) {
+      bounder->AddContribution("user", absl::StrCat(partition), 1);
+    }
+  }
+  EXPECT_EQ(bounder->NumPrivacyUnits(), 1);
+
+  std::map<std::string, std::pair<int64_t, int64_t>> results =
+      FlushAndAggregate(*bounder);
+  EXPECT_THAT(results, SizeIs(3));
+  for (const auto& [key, count_and_sum] : results) {
+    EXPECT_THAT(count_and_sum, Pair(2, 2)) << key;
+  }
+  EXPECT_EQ(bounder->NumPrivacyUnits(), 0);
+}
+
+TEST(ContributionBounderTest, BoundsEveryPrivacyUnitSeparately) {
+  std::unique_ptr<ContributionBounder<int64_t>> bounder = MakeBounder(1, 1);
+  // Interleaved records of 100 privacy units.
+  for (int repetition = 0; repetition < 3; ++repetition) {
+    for (int user = 0; user < 100; ++user) {
+      bounder->AddContribution(absl::StrCat("user", user), "partition", 2);
+    }
+  }
+  EXPECT_EQ(bounder->NumPrivacyUnits(), 100);
+
+  EXPECT_THAT(FlushAndAggregate(*bounder),
+              ElementsAre(Pair("partition", Pair(100, 200))));
+}
+
+TEST(ContributionBounderTest, FlushesToCallbackPerPrivacyUnit) {
+  std::unique_ptr<ContributionBounder<int64_t>> bounder = MakeBounder(2, 2);
+  for (int value = 0; value < 3; ++value) {
+    bounder->AddContribution("user1", "a", 1);
+    bounder->AddContribution("user1", "b", 1);
+    bounder->AddContribution("user2", "a", 1);
+  }
+
+  std::vector<std::vector<std::string>> units;
+  bounder->Flush(
+      [&units](absl::Span<const ContributionBounder<int64_t>::Contribution>
+                   contributions) {
+        std::vector<std::string>& keys = units.emplace_back();
+        for (const auto& contribution : contributions) {
+          keys.emplace_back(contribution.partition_key);
+        }
+      });
+
+  EXPECT_THAT(units, UnorderedElementsAre(
+                         UnorderedElementsAre("a", "a", "b", "b"),
+                         ElementsAre("a", "a")));
+  EXPECT_EQ(bounder->NumPrivacyUnits(), 0);
+}
+
+TEST(ContributionBounderTest, DroppedPartitionsStayDropped) {
+  std::unique_ptr<ContributionBounder<int64_t>> bounder = MakeBounder(1, 10);
+  for (int i = 0; i < 3; ++i) {
+    bounder->AddContribution("user", "a", 1);
+    bounder->AddContribution("user", "b", 1);
+  }
+
+  std::map<std::string, std::pair<int64_t, int64_t>> results =
+      FlushAndAggregate(*bounder);
+  ASSERT_THAT(results, SizeIs(1));
+  EXPECT_THAT(results.begin()->second, Pair(3, 3));
+}
+
+TEST(ContributionBounderTest, SamplesPartitionsUniformly) {
+  const int num_trials = 2000;
+  std::map<std::string, int> num_kept;
+  for (int i = 0; i < num_trials; ++i) {
+    std::unique_ptr<ContributionBounder<int64_t>> bounder = MakeBounder(1, 1);
+    for (const char* partition : {"a", "b", "c", "d"}) {
+      bounder->AddContribution("user", partition, 1);
+    }
+    for (const auto& [key, count_and_sum] : FlushAndAggregate(*bounder)) {
+      ++num_kept[key];
+    }
+  }
+  ASSERT_THAT(num_kept, SizeIs(4));
+  for (const auto& [key, count] : num_kept) {
+    // About 5 standard deviations.
+    EXPECT_NEAR(static_cast<double>(count) / num_trials, 0.25, 0.05) << key;
+  }
+}
+
+TEST(ContributionBounderTest, SamplesValuesUniformly) {
+  const int num_trials = 2000;
+  std::map<int64_t, int> num_kept;
+  for (int i = 0; i < num_trials; ++i) {
+    std::unique_ptr<ContributionBounder<int64_t>> bounder = MakeBounder(1, 1);
+    for (int64_t value = 1; value <= 4; ++value) {
+      bounder->AddContribution("user", "partition", value);
+    }
+    ++num_kept[FlushAndAggregate(*bounder)["partition"].second];
+  }
+  ASSERT_THAT(num_kept, SizeIs(4));
+  for (const auto& [value, count] : num_kept) {
+    EXPECT_NEAR(static_cast<double>(count) / num_trials, 0.25, 0.05)
+        << value;
+  }
+}
+
+TEST(ContributionBounderTest, IgnoresNan) {
+  std::unique_ptr<ContributionBounder<double>> bounder =
+      ContributionBounder<double>::Builder().Build().value();
+  bounder->AddContribution("user", "partition",
+                           std::numeric_limits<double>::quiet_NaN());
+  EXPECT_EQ(bounder->NumPrivacyUnits(), 0);
+}
+
+TEST(ContributionBounderTest, ValidatesParameters) {
+  EXPECT_THAT(ContributionBounder<int64_t>::Builder()
+                  .SetMaxPartitionsContributed(0)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ContributionBounder<int64_t>::Builder()
+                  .SetMaxContributionsPerPartition(-1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(ContributionBounderTest, MemoryIsBoundedPerPrivacyUnit) {
+  std::unique_ptr<ContributionBounder<int64_t>> bounder = MakeBounder(2, 2);
+  for (int i = 0; i < 10; ++i) {
+    bounder->AddContribution("user", absl::StrCat(i % 4), i);
+  }
+  const int64_t memory = bounder->MemoryUsed();
+  for (int i = 0; i < 10000; ++i) {
+    bounder->AddContribution("user", absl::StrCat(i % 4), i);
+  }
+  EXPECT_EQ(bounder->MemoryUsed(), memory);
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -18,6 +18,7 @@
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_COUNT_H_
 
 #include <cstdint>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <utility>
@@ -26,13 +27,17 @@
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "algorithms/algorithm.h"
+#include "algorithms/internal/wire-reader.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "algorithms/util.h"
 #include "proto/util.h"
 #include "proto/confidence-interval.pb.h"
 #include "proto/data.pb.h"
 #include "proto/summary.pb.h"
+#include "base/instrumentation.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
@@ -43,7 +48,43 @@ class Count : public Algorithm<T> {
  public:
   class Builder;
 
-  void AddEntry(const T& v) override { AddMultipleEntries(v, 1); }
+  void AddEntry(const T& v) override { AddMultipleEntries(1); }
+
+  // Adds num_of_entries entries at once. Count only depends on the number of
+  // entries, so this is equivalent to calling AddEntry num_of_entries times.
+  // Negative numbers of entries are ignored.
+  void AddMultipleEntries(int64_t num_of_entries) {
+    absl::Status status =
+        ValidateIsNonNegative(num_of_entries, "Number of entries");
+    if (!status.ok()) {
+      return;
+    }
+
+    count_ += num_of_entries;
+  }
+
+  // Hides Algorithm::AddEntries, which calls the virtual AddEntry for every
+  // element. Adds std::distance(begin, end) entries without reading them,
+  // which takes constant time for random-access iterators.
+  template <typename Iterator>
+  void AddEntries(Iterator begin, Iterator end) {
+    const auto size = std::distance(begin, end);
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmAddEntries, size);
+    AddMultipleEntries(size);
+  }
+
+  void AddEntries(absl::Span<const T> entries) override {
+    AddMultipleEntries(entries.size());
+  }
+
+  // Hides Algorithm::Result to use the AddEntries above.
+  template <typename Iterator>
+  absl::StatusOr<Output> Result(Iterator begin, Iterator end) {
+    Algorithm<T>::Reset();
+    AddEntries(begin, end);
+    return Algorithm<T>::PartialResult();
+  }
 
   absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
       double confidence_level) override {
@@ -52,6 +93,8 @@ class Count : public Algorithm<T> {
 
   // Create and return summary containing the count.
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     // Create CountSummary.
     CountSummary count_summ;
     count_summ.set_count(count_);
@@ -64,6 +107,8 @@ class Count : public Algorithm<T> {
 
   // Add count from serialized data.
   absl::Status Merge(const Summary& summary) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError("Cannot merge summary with no count data.");
     }
@@ -78,6 +123,48 @@ class Count : public Algorithm<T> {
     return absl::OkStatus();
   }
 
+  // Reads the count straight from the serialized CountSummary. Summaries that
+  // cannot be decoded this way go through Merge, which reports the error.
+  absl::Status MergeFromBytes(absl::string_view summary_bytes) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    absl::string_view payload;
+    if (!internal::SummaryPayload<CountSummary>(summary_bytes, &payload)) {
+      return Algorithm<T>::MergeFromBytes(summary_bytes);
+    }
+    internal::WireReader reader(payload);
+    int64_t count = 0;
+    while (!reader.empty()) {
+      int field;
+      internal::WireType wire_type;
+      uint64_t value;
+      if (!reader.ReadTag(&field, &wire_type)) {
+        return Algorithm<T>::MergeFromBytes(summary_bytes);
+      }
+      if (field == 1 && wire_type == internal::WireType::kVarint) {
+        if (!reader.ReadVarint(&value)) {
+          return Algorithm<T>::MergeFromBytes(summary_bytes);
+        }
+        count = static_cast<int64_t>(value);
+      } else if (!reader.SkipField(wire_type)) {
+        return Algorithm<T>::MergeFromBytes(summary_bytes);
+      }
+    }
+    count_ += count;
+    return absl::OkStatus();
+  }
+
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_count = dynamic_cast<const Count<T>*>(&other);
+    if (other_count == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    count_ += other_count->count_;
+    return absl::OkStatus();
+  }
+
   int64_t MemoryUsed() override {
     int64_t memory = sizeof(Count<T>);
     if (mechanism_) {
@@ -87,18 +174,42 @@ class Count : public Algorithm<T> {
   }
 
  protected:
+  using DeferredValue = typename Algorithm<T>::DeferredValue;
+
   absl::StatusOr<Output> GenerateResult(double noise_interval_level) override {
-    Output output;
-    int64_t countWithNoise = mechanism_->AddNoise(count_);
+    DeferredValue noised_value;
+    noised_value.int_value = mechanism_->AddNoise(count_);
+    return MakeDeferredOutput(noised_value, noise_interval_level);
+  }
+
+  absl::StatusOr<ScalarResult> GenerateScalarResult(
+      double noise_interval_level) override {
+    ScalarResult result;
+    result.value = mechanism_->AddNoise(count_);
     absl::StatusOr<ConfidenceInterval> interval =
         NoiseConfidenceInterval(noise_interval_level);
+    if (interval.ok()) {
+      result.noise_confidence_interval = *std::move(interval);
+    }
+    return result;
+  }
+
+  std::optional<DeferredValue> GetDeferredValue() override {
+    DeferredValue value;
+    value.mechanism = mechanism_.get();
+    value.integral = true;
+    value.int_value = count_;
+    return value;
+  }
 
+  Output MakeDeferredOutput(const DeferredValue& noised_value,
+                            double noise_interval_level) override {
+    absl::StatusOr<ConfidenceInterval> interval =
+        NoiseConfidenceInterval(noise_interval_level);
     if (interval.ok()) {
-      output = MakeOutput<int64_t>(countWithNoise, interval.value());
-    } else {
-      output = MakeOutput<int64_t>(countWithNoise);
+      return MakeOutput<int64_t>(noised_value.int_value, interval.value());
     }
-    return output;
+    return MakeOutput<int64_t>(noised_value.int_value);
   }
 
   void ResetState() override { count_ = 0; }
@@ -114,13 +225,7 @@ class Count : public Algorithm<T> {
 
  private:
   void AddMultipleEntries(const T& v, int64_t num_of_entries) {
-    absl::Status status =
-        ValidateIsNonNegative(num_of_entries, "Number of entries");
-    if (!status.ok()) {
-      return;
-    }
-
-    count_ += num_of_entries;
+    AddMultipleEntries(num_of_entries);
   }
 
   // Friend class for testing only
@@ -20,7 +20,10 @@
 
 #include <cmath>
 #include <limits>
+#include <list>
 #include <memory>
+#include <string>
+#include <variant>
 #include <vector>
 
 #include "google/protobuf/any.pb.h"
@@ -31,8 +34,11 @@
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
 #include "algorithms/numerical-mechanisms-testing.h"
 #include "algorithms/numerical-mechanisms.h"
+#include "base/instrumentation.h"
 #include "proto/util.h"
 #include "proto/confidence-interval.pb.h"
 #include "proto/data.pb.h"
@@ -128,6 +134,74 @@ TYPED_TEST(CountTest, AddMultipleEntriesInvalidNumberOfEntriesTest) {
   EXPECT_EQ(GetValue<int64_t>(*result), 0);
 }
 
+TYPED_TEST(CountTest, AddMultipleEntries) {
+  absl::StatusOr<std::unique_ptr<Count<TypeParam>>> count =
+      typename Count<TypeParam>::Builder()
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(count);
+
+  (*count)->AddMultipleEntries(1000000);
+  (*count)->AddMultipleEntries(-5);
+  (*count)->AddEntry(1);
+
+  auto result = (*count)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 1000001);
+}
+
+TYPED_TEST(CountTest, AddEntriesCountsAnyRange) {
+  absl::StatusOr<std::unique_ptr<Count<TypeParam>>> count =
+      typename Count<TypeParam>::Builder()
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(count);
+  const std::vector<TypeParam> batch(1000000, 1);
+  const std::list<TypeParam> list = {1, 2, 3};
+
+  (*count)->AddEntries(batch.begin(), batch.end());
+  (*count)->AddEntries(list.begin(), list.end());
+
+  auto result = (*count)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 1000003);
+}
+
+TYPED_TEST(CountTest, AddEntriesThroughAlgorithmCountsSpan) {
+  absl::StatusOr<std::unique_ptr<Count<TypeParam>>> count =
+      typename Count<TypeParam>::Builder()
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(count);
+  const std::vector<TypeParam> batch(1000, 1);
+  Algorithm<TypeParam>& algorithm = **count;
+
+  algorithm.AddEntries(absl::MakeConstSpan(batch));
+  algorithm.AddEntries(batch.begin(), batch.end());
+
+  auto result = algorithm.PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 2000);
+}
+
+TYPED_TEST(CountTest, ResultIgnoresPreviousEntries) {
+  absl::StatusOr<std::unique_ptr<Count<TypeParam>>> count =
+      typename Count<TypeParam>::Builder()
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(count);
+  const std::vector<TypeParam> c = {1, 2, 3, 4};
+  (*count)->AddMultipleEntries(10);
+
+  auto result = (*count)->Result(c.begin(), c.end());
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 4);
+}
+
 TYPED_TEST(CountTest, InsufficientPrivacyBudgetTest) {
   std::vector<TypeParam> c = {1, 2, 3, 4, 2, 3};
   absl::StatusOr<std::unique_ptr<Count<TypeParam>>> count =
@@ -275,6 +349,128 @@ TEST(CountTest, SerializeAndMergeOverflowTest) {
                    std::numeric_limits<int64_t>::lowest());
 }
 
+TEST(CountTest, MergeFromAddsCountOfOtherInstance) {
+  Count<int64_t>::Builder builder;
+  builder.SetEpsilon(kDefaultEpsilon)
+      .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<Count<int64_t>>> count1 = builder.Build();
+  ASSERT_OK(count1);
+  absl::StatusOr<std::unique_ptr<Count<int64_t>>> count2 = builder.Build();
+  ASSERT_OK(count2);
+  (*count1)->AddEntry(1);
+  (*count1)->AddEntry(2);
+  (*count2)->AddEntry(3);
+  const Summary summary2 = (*count2)->Serialize();
+
+  EXPECT_OK((*count1)->MergeFrom(**count2));
+
+  // The merged instance is not modified.
+  EXPECT_THAT((*count2)->Serialize(), EqualsProto(summary2));
+  absl::StatusOr<Output> result = (*count1)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 3);
+}
+
+// Algorithm that only exposes its state through Serialize, to check that
+// MergeFrom falls back to merging a summary for other algorithm types.
+class CountSummaryAlgorithm : public Algorithm<int64_t> {
+ public:
+  explicit CountSummaryAlgorithm(int64_t count)
+      : Algorithm<int64_t>(kDefaultEpsilon), count_(count) {}
+
+  void AddEntry(const int64_t& t) override {}
+
+  Summary Serialize() const override {
+    CountSummary count_summary;
+    count_summary.set_count(count_);
+    Summary summary;
+    summary.mutable_data()->PackFrom(count_summary);
+    return summary;
+  }
+
+  absl::Status Merge(const Summary& summary) override {
+    return absl::UnimplementedError("Merge is not supported.");
+  }
+
+  int64_t MemoryUsed() override { return sizeof(CountSummaryAlgorithm); }
+
+ protected:
+  absl::StatusOr<Output> GenerateResult(double noise_interval_level) override {
+    return absl::UnimplementedError("GenerateResult is not supported.");
+  }
+
+  void ResetState() override {}
+
+ private:
+  int64_t count_;
+};
+
+TEST(CountTest, MergeFromOtherAlgorithmMergesItsSummary) {
+  absl::StatusOr<std::unique_ptr<Count<int64_t>>> count =
+      Count<int64_t>::Builder()
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(count);
+  (*count)->AddEntry(1);
+
+  EXPECT_OK((*count)->MergeFrom(CountSummaryAlgorithm(5)));
+
+  absl::StatusOr<Output> result = (*count)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 6);
+}
+
+TEST(CountTest, MergeFromBytesAddsCount) {
+  CountSummary count_summary;
+  count_summary.set_count(2);
+  // Fields the merge does not use are skipped.
+  count_summary.set_epsilon(1.5);
+  count_summary.set_max_partitions_contributed(3);
+  Summary summary;
+  summary.mutable_data()->PackFrom(count_summary);
+  absl::StatusOr<std::unique_ptr<Count<double>>> count =
+      Count<double>::Builder()
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(count);
+  (*count)->AddEntry(0);
+
+  EXPECT_OK((*count)->MergeFromBytes(summary.SerializeAsString()));
+
+  absl::StatusOr<Output> result = (*count)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 3);
+}
+
+TEST(CountTest, MergeFromBytesRejectsInvalidSummaries) {
+  absl::StatusOr<std::unique_ptr<Count<int64_t>>> count =
+      Count<int64_t>::Builder().SetEpsilon(kDefaultEpsilon).Build();
+  ASSERT_OK(count);
+  (*count)->AddEntry(1);
+  const Summary before = (*count)->Serialize();
+
+  EXPECT_THAT((*count)->MergeFromBytes(Summary().SerializeAsString()),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("no count")));
+  EXPECT_THAT((*count)->MergeFromBytes("\xff\xff"),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("unable to be parsed")));
+  Summary other_type;
+  other_type.mutable_data()->PackFrom(BoundedSumSummary());
+  EXPECT_THAT((*count)->MergeFromBytes(other_type.SerializeAsString()),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("unable to be unpacked")));
+  EXPECT_THAT((*count)->Serialize(), EqualsProto(before));
+}
+
+TEST(CountTest, MergeFromBytesDefaultsToMerge) {
+  CountSummaryAlgorithm algorithm(1);
+  const std::string summary = algorithm.Serialize().SerializeAsString();
+  EXPECT_THAT(algorithm.MergeFromBytes(summary),
+              StatusIs(absl::StatusCode::kUnimplemented));
+}
+
 TEST(CountTest, MemoryUsed) {
   absl::StatusOr<std::unique_ptr<Count<double>>> count =
       Count<double>::Builder().SetEpsilon(kDefaultEpsilon).Build();
@@ -310,5 +506,113 @@ TEST(CountTest, BasicGaussian) {
   EXPECT_EQ(GetValue<int64_t>(*result), 6);
 }
 
+TEST(CountTest, SharedMechanismIsReusedAcrossPartitions) {
+  auto shared_builder = absl::make_unique<SharedMechanismBuilder>(
+      absl::make_unique<LaplaceMechanism::Builder>());
+  SharedMechanismBuilder* shared_builder_ptr = shared_builder.get();
+  Count<int>::Builder builder;
+  builder.SetEpsilon(1.0).SetLaplaceMechanism(std::move(shared_builder));
+
+  for (int partition = 0; partition < 10; ++partition) {
+    absl::StatusOr<std::unique_ptr<Count<int>>> count = builder.Build();
+    ASSERT_OK(count);
+    EXPECT_THAT((*count)->NoiseConfidenceInterval(0.95),
+                IsOkAndHolds(EqualsProto(Count<int>::Builder()
+                                             .SetEpsilon(1.0)
+                                             .Build()
+                                             .value()
+                                             ->NoiseConfidenceInterval(0.95)
+                                             .value())));
+    std::vector<int> c(partition, 1);
+    ASSERT_OK((*count)->Result(c.begin(), c.end()));
+  }
+  EXPECT_EQ(shared_builder_ptr->NumSharedMechanisms(), 1);
+}
+
+TEST(CountTest, FinalizeResultsNoisesSharedMechanismInOneBatch) {
+  Count<int>::Builder builder;
+  builder.SetEpsilon(1.0).SetLaplaceMechanism(
+      absl::make_unique<SharedMechanismBuilder>(
+          absl::make_unique<ZeroNoiseMechanism::Builder>()));
+  std::vector<std::unique_ptr<Count<int>>> counts;
+  std::vector<Count<int>::PreparedResult> prepared;
+  for (int partition = 0; partition < 10; ++partition) {
+    counts.push_back(builder.Build().value());
+    std::vector<int> c(partition, 1);
+    counts.back()->AddEntries(c.begin(), c.end());
+    absl::StatusOr<Count<int>::PreparedResult> result =
+        counts.back()->PrepareResult();
+    ASSERT_OK(result);
+    prepared.push_back(*std::move(result));
+  }
+
+  instrumentation::AggregatingSink sink;
+  instrumentation::SetSink(&sink);
+  absl::StatusOr<std::vector<Output>> outputs =
+      Count<int>::FinalizeResults(absl::MakeSpan(prepared));
+  instrumentation::SetSink(nullptr);
+  ASSERT_OK(outputs);
+
+  ASSERT_EQ(outputs->size(), 10);
+  for (int partition = 0; partition < 10; ++partition) {
+    EXPECT_EQ(GetValue<int64_t>((*outputs)[partition]), partition);
+    EXPECT_EQ(GetNoiseConfidenceInterval((*outputs)[partition])
+                  .confidence_level(),
+              kDefaultConfidenceLevel);
+  }
+  instrumentation::AggregatingSink::Totals add_noise =
+      sink.Get(instrumentation::Event::kMechanismAddNoise);
+  EXPECT_EQ(add_noise.calls, 1);
+  EXPECT_EQ(add_noise.count, 10);
+}
+
+TEST(CountTest, PrepareResultConsumesBudget) {
+  std::unique_ptr<Count<int>> count =
+      Count<int>::Builder().SetEpsilon(1.0).Build().value();
+  absl::StatusOr<Count<int>::PreparedResult> prepared = count->PrepareResult();
+  ASSERT_OK(prepared);
+
+  EXPECT_THAT(count->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("can only produce results once")));
+  EXPECT_THAT(count->PrepareResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("can only produce results once")));
+  EXPECT_OK(Count<int>::FinalizeResults({&*prepared, 1}));
+  EXPECT_THAT(Count<int>::FinalizeResults({&*prepared, 1}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("finalized once")));
+}
+
+TYPED_TEST(CountTest, PartialScalarResult) {
+  std::unique_ptr<Count<TypeParam>> count =
+      typename Count<TypeParam>::Builder()
+          .SetEpsilon(kDefaultEpsilon)
+          .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  for (int i = 0; i < 6; ++i) {
+    count->AddEntry(i);
+  }
+
+  absl::StatusOr<ScalarResult> result = count->PartialScalarResult(0.9);
+  ASSERT_OK(result);
+  EXPECT_EQ(std::get<int64_t>(result->value), 6);
+  ASSERT_TRUE(result->noise_confidence_interval.has_value());
+  EXPECT_EQ(result->noise_confidence_interval->confidence_level(), 0.9);
+
+  Output output = ToOutput(*result);
+  EXPECT_EQ(GetValue<int64_t>(output), 6);
+  EXPECT_THAT(GetNoiseConfidenceInterval(output),
+              EqualsProto(*result->noise_confidence_interval));
+
+  EXPECT_THAT(count->PartialScalarResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("can only produce results once")));
+  EXPECT_THAT(count->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("can only produce results once")));
+}
+
 }  // namespace
 }  // namespace differential_privacy
@@ -0,0 +1,265 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/distinct-count.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/testing/proto_matchers.h"
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "proto/util.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::EqualsProto;
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+// Records the L-infinity sensitivity of every mechanism it builds.
+class RecordingMechanismBuilder : public ZeroNoiseMechanism::Builder {
+ public:
+  explicit RecordingMechanismBuilder(
+      std::shared_ptr<std::vector<double>> linf_sensitivities)
+      : linf_sensitivities_(std::move(linf_sensitivities)) {}
+
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override {
+    linf_sensitivities_->push_back(GetLInfSensitivity().value_or(0));
+    return ZeroNoiseMechanism::Builder::Build();
+  }
+
+  std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
+    return std::make_unique<RecordingMechanismBuilder>(*this);
+  }
+
+ private:
+  std::shared_ptr<std::vector<double>> linf_sensitivities_;
+};
+
+template <typename T>
+T MakeEntry(int64_t i);
+
+template <>
+int64_t MakeEntry<int64_t>(int64_t i) {
+  return i;
+}
+
+template <>
+double MakeEntry<double>(int64_t i) {
+  return i * 0.5;
+}
+
+template <>
+std::string MakeEntry<std::string>(int64_t i) {
+  return absl::StrCat("user", i);
+}
+
+template <typename T>
+std::unique_ptr<DistinctCount<T>> MakeDistinctCountWithoutNoise(
+    int precision = DistinctCount<T>::kDefaultPrecision) {
+  return typename DistinctCount<T>::Builder()
+      .SetEpsilon(1)
+      .SetPrecision(precision)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .Build()
+      .value();
+}
+
+template <typename T>
+class DistinctCountTest : public testing::Test {};
+
+typedef ::testing::Types<int64_t, double, std::string> EntryTypes;
+TYPED_TEST_SUITE(DistinctCountTest, EntryTypes);
+
+TYPED_TEST(DistinctCountTest, SmallCountIsAccurate) {
+  std::unique_ptr<DistinctCount<TypeParam>> distinct_count =
+      MakeDistinctCountWithoutNoise<TypeParam>();
+  for (int repetition = 0; repetition < 3; ++repetition) {
+    for (int64_t i = 0; i < 100; ++i) {
+      distinct_count->AddEntry(MakeEntry<TypeParam>(i));
+    }
+  }
+  absl::StatusOr<Output> result = distinct_count->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_NEAR(GetValue<int64_t>(*result), 100, 1);
+}
+
+TYPED_TEST(DistinctCountTest, LargeCountIsAccurate) {
+  std::unique_ptr<DistinctCount<TypeParam>> distinct_count =
+      MakeDistinctCountWithoutNoise<TypeParam>();
+  for (int64_t i = 0; i < 200000; ++i) {
+    distinct_count->AddEntry(MakeEntry<TypeParam>(i));
+  }
+  absl::StatusOr<Output> result = distinct_count->PartialResult();
+  ASSERT_OK(result);
+  // About four times the relative standard error of the sketch.
+  EXPECT_NEAR(GetValue<int64_t>(*result), 200000, 200000 * 0.03);
+}
+
+TEST(DistinctCountTest, EmptyCountIsZero) {
+  std::unique_ptr<DistinctCount<int64_t>> distinct_count =
+      MakeDistinctCountWithoutNoise<int64_t>();
+  absl::StatusOr<Output> result = distinct_count->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 0);
+}
+
+TEST(DistinctCountTest, DuplicatesDoNotChangeSketch) {
+  std::unique_ptr<DistinctCount<std::string>> once =
+      MakeDistinctCountWithoutNoise<std::string>();
+  std::unique_ptr<DistinctCount<std::string>> many_times =
+      MakeDistinctCountWithoutNoise<std::string>();
+  for (int64_t i = 0; i < 1000; ++i) {
+    once->AddEntry(MakeEntry<std::string>(i));
+    for (int repetition = 0; repetition < 5; ++repetition) {
+      many_times->AddEntry(MakeEntry<std::string>(i));
+    }
+  }
+  EXPECT_THAT(many_times->Serialize(), EqualsProto(once->Serialize()));
+}
+
+TEST(DistinctCountTest, SummarySizeDoesNotDependOnEntries) {
+  std::unique_ptr<DistinctCount<int64_t>> distinct_count =
+      MakeDistinctCountWithoutNoise<int64_t>(/*precision=*/10);
+  const int64_t memory = distinct_count->MemoryUsed();
+  for (int64_t i = 0; i < 100000; ++i) {
+    distinct_count->AddEntry(i);
+  }
+  DistinctCountSummary summary;
+  ASSERT_TRUE(distinct_count->Serialize().data().UnpackTo(&summary));
+  EXPECT_EQ(summary.precision(), 10);
+  EXPECT_EQ(summary.registers().size(), 1024);
+  EXPECT_EQ(distinct_count->MemoryUsed(), memory);
+}
+
+TEST(DistinctCountTest, MergeMatchesAddingAllEntries) {
+  std::unique_ptr<DistinctCount<std::string>> all =
+      MakeDistinctCountWithoutNoise<std::string>();
+  std::unique_ptr<DistinctCount<std::string>> first =
+      MakeDistinctCountWithoutNoise<std::string>();
+  std::unique_ptr<DistinctCount<std::string>> second =
+      MakeDistinctCountWithoutNoise<std::string>();
+  std::unique_ptr<DistinctCount<std::string>> third =
+      MakeDistinctCountWithoutNoise<std::string>();
+  for (int64_t i = 0; i < 3000; ++i) {
+    all->AddEntry(MakeEntry<std::string>(i));
+    // The entries of first and second overlap.
+    if (i < 2000) first->AddEntry(MakeEntry<std::string>(i));
+    if (i >= 1000) second->AddEntry(MakeEntry<std::string>(i));
+    third->AddEntry(MakeEntry<std::string>(i % 10));
+  }
+
+  EXPECT_OK(first->Merge(second->Serialize()));
+  EXPECT_THAT(first->Serialize(), EqualsProto(all->Serialize()));
+  EXPECT_OK(first->MergeFrom(*third));
+  EXPECT_THAT(first->Serialize(), EqualsProto(all->Serialize()));
+}
+
+TEST(DistinctCountTest, MergeWithDifferentPrecisionFails) {
+  std::unique_ptr<DistinctCount<int64_t>> distinct_count =
+      MakeDistinctCountWithoutNoise<int64_t>(/*precision=*/10);
+  std::unique_ptr<DistinctCount<int64_t>> other =
+      MakeDistinctCountWithoutNoise<int64_t>(/*precision=*/12);
+  EXPECT_THAT(distinct_count->Merge(other->Serialize()),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("different precision")));
+  EXPECT_THAT(distinct_count->MergeFrom(*other),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("different precision")));
+}
+
+TEST(DistinctCountTest, MergeWithWrongSummaryFails) {
+  std::unique_ptr<DistinctCount<int64_t>> distinct_count =
+      MakeDistinctCountWithoutNoise<int64_t>();
+  Summary summary;
+  EXPECT_THAT(distinct_count->Merge(summary),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("no distinct")));
+  summary.mutable_data()->PackFrom(CountSummary());
+  EXPECT_THAT(distinct_count->Merge(summary),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("unpacked")));
+}
+
+TEST(DistinctCountTest, InvalidPrecisionFails) {
+  for (int precision : {DistinctCount<int64_t>::kMinPrecision - 1,
+                        DistinctCount<int64_t>::kMaxPrecision + 1}) {
+    EXPECT_THAT(DistinctCount<int64_t>::Builder()
+                    .SetEpsilon(1)
+                    .SetPrecision(precision)
+                    .Build(),
+                StatusIs(absl::StatusCode::kInvalidArgument,
+                         HasSubstr("Precision")));
+  }
+}
+
+TEST(DistinctCountTest, InvalidMaxContributionsPerPartitionFails) {
+  EXPECT_THAT(DistinctCount<int64_t>::Builder()
+                  .SetEpsilon(1)
+                  .SetMaxContributionsPerPartition(0)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Maximum number of contributions per "
+                                 "partition")));
+}
+
+TEST(DistinctCountTest, SensitivityScalesWithContributionsPerPartition) {
+  auto linf_sensitivities = std::make_shared<std::vector<double>>();
+  ASSERT_OK(DistinctCount<int64_t>::Builder()
+                .SetEpsilon(1)
+                .SetMaxContributionsPerPartition(3)
+                .SetLaplaceMechanism(
+                    std::make_unique<RecordingMechanismBuilder>(
+                        linf_sensitivities))
+                .Build());
+  // Removing an entry can take a register from any rank back to 0, which
+  // changes both the number of zero registers and the sum of 2^-register by
+  // up to 1.
+  EXPECT_THAT(*linf_sensitivities, ElementsAre(3, 3));
+}
+
+TEST(DistinctCountTest, InvalidEpsilonFails) {
+  EXPECT_THAT(DistinctCount<int64_t>::Builder().Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Epsilon must be set")));
+}
+
+TEST(DistinctCountTest, NoisyResultIsClose) {
+  std::unique_ptr<DistinctCount<int64_t>> distinct_count =
+      DistinctCount<int64_t>::Builder().SetEpsilon(10).Build().value();
+  for (int64_t i = 0; i < 1000; ++i) {
+    distinct_count->AddEntry(i);
+  }
+  absl::StatusOr<Output> result = distinct_count->PartialResult();
+  ASSERT_OK(result);
+  // The noise of the number of zero registers has a scale of 0.2, which
+  // changes the linear counting estimate by a few entries at most.
+  EXPECT_NEAR(GetValue<int64_t>(*result), 1000, 50);
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -15,14 +15,21 @@
 //
 #include "algorithms/distributions.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <limits>
+#include <optional>
 
 #include "absl/memory/memory.h"
+#include "absl/numeric/bits.h"
+#include "absl/numeric/int128.h"
 #include "absl/random/random.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "algorithms/rand.h"
 #include "algorithms/util.h"
 #include "third_party/cephes/inverse_gaussian_cdf.h"
@@ -64,20 +71,38 @@ GaussianDistribution::Builder& GaussianDistribution::Builder::SetStddev(
   return *this;
 }
 
+GaussianDistribution::Builder&
+GaussianDistribution::Builder::SetUseFastBinomialSampling(
+    bool use_fast_binomial_sampling) {
+  use_fast_binomial_sampling_ = use_fast_binomial_sampling;
+  return *this;
+}
+
+GaussianDistribution::Builder& GaussianDistribution::Builder::SetRandomSource(
+    RandomSource* random_source) {
+  random_source_ = random_source;
+  return *this;
+}
+
 absl::StatusOr<std::unique_ptr<GaussianDistribution>>
 GaussianDistribution::Builder::Build() {
   RETURN_IF_ERROR(
       ValidateIsFiniteAndNonNegative(stddev_, "Standard deviation"));
-  return absl::WrapUnique<GaussianDistribution>(
-      new GaussianDistribution(stddev_));
+  auto distribution = absl::WrapUnique<GaussianDistribution>(
+      new GaussianDistribution(stddev_, use_fast_binomial_sampling_));
+  distribution->random_source_ = random_source_;
+  return distribution;
 }
 
-GaussianDistribution::GaussianDistribution(double stddev) : stddev_(stddev) {
+GaussianDistribution::GaussianDistribution(double stddev,
+                                           bool use_fast_binomial_sampling)
+    : stddev_(stddev), use_fast_binomial_sampling_(use_fast_binomial_sampling) {
   DCHECK_GE(stddev, 0.0);
 }
 
 double GaussianDistribution::Sample(double scale) {
   DCHECK_GT(scale, 0);
+  ScopedRandomSource scoped_random_source(random_source_);
   // TODO: make graceful behaviour when sigma is too big.
   double sigma = scale * stddev_;
   // Use at least the lowest positive floating point number as granularity when
@@ -90,9 +115,27 @@ double GaussianDistribution::Sample(double scale) {
   // The sqrt(n) is taken instead of n, to ensure that all results of arithmetic
   // operations fit in 64 bit integer range.
   double sqrt_n = 2.0 * sigma / granularity;
+  if (use_fast_binomial_sampling_) {
+    return FastSampleBinomial(sqrt_n) * granularity;
+  }
   return SampleBinomial(sqrt_n) * granularity;
 }
 
+void GaussianDistribution::SampleBatch(double scale,
+                                       absl::Span<double> samples) {
+  DCHECK_GT(scale, 0);
+  ScopedRandomSource scoped_random_source(random_source_);
+  double sigma = scale * stddev_;
+  double granularity =
+      std::max(GetGranularity(scale), std::numeric_limits<double>::min());
+  double sqrt_n = 2.0 * sigma / granularity;
+  for (double& sample : samples) {
+    sample = use_fast_binomial_sampling_
+                 ? FastSampleBinomial(sqrt_n) * granularity
+                 : SampleBinomial(sqrt_n) * granularity;
+  }
+}
+
 double GaussianDistribution::Sample() { return Sample(1.0); }
 
 double GaussianDistribution::Stddev() const { return stddev_; }
@@ -107,29 +150,86 @@ double GaussianDistribution::cdf(double stddev, double x) {
   return (std::erfc(-x / (stddev * std::sqrt(2)))) / 2;
 }
 
+void GaussianDistribution::cdf(double stddev, absl::Span<const double> x,
+                               absl::Span<double> cdf) {
+  DCHECK_GT(stddev, 0);
+  DCHECK_EQ(x.size(), cdf.size());
+  // Divide by the same denominator as the scalar version rather than multiply
+  // by its reciprocal, which would change the results in the last bit.
+  const double denominator = stddev * std::sqrt(2);
+  for (size_t i = 0; i < x.size(); ++i) {
+    cdf[i] = std::erfc(-x[i] / denominator) / 2;
+  }
+}
+
 double GaussianDistribution::Quantile(double stddev, double x) {
   DCHECK_GT(stddev, 0);
   return stddev * third_party::cephes::InverseCdfStandardGaussian(x);
 }
 
+void GaussianDistribution::Quantile(double stddev, absl::Span<const double> p,
+                                    absl::Span<double> quantiles) {
+  DCHECK_GT(stddev, 0);
+  DCHECK_EQ(p.size(), quantiles.size());
+  for (size_t i = 0; i < p.size(); ++i) {
+    quantiles[i] =
+        stddev * third_party::cephes::InverseCdfStandardGaussian(p[i]);
+  }
+}
+
 GeometricDistribution::Builder& GeometricDistribution::Builder::SetLambda(
     double lambda) {
   lambda_ = lambda;
   return *this;
 }
 
+GeometricDistribution::Builder&
+GeometricDistribution::Builder::SetRandomSource(RandomSource* random_source) {
+  random_source_ = random_source;
+  return *this;
+}
+
 absl::StatusOr<std::unique_ptr<GeometricDistribution>>
 GeometricDistribution::Builder::Build() {
   RETURN_IF_ERROR(ValidateIsFiniteAndNonNegative(lambda_, "Lambda"));
 
-  return absl::WrapUnique<GeometricDistribution>(
+  auto distribution = absl::WrapUnique<GeometricDistribution>(
       new GeometricDistribution(lambda_));
+  distribution->random_source_ = random_source_;
+  return distribution;
 }
 
-GeometricDistribution::GeometricDistribution(double lambda) : lambda_(lambda) {
+GeometricDistribution::GeometricDistribution(double lambda)
+    : lambda_(lambda), params_(lambda) {
   DCHECK_GE(lambda, 0);
 }
 
+namespace {
+
+// exp(x) underflows to 0 for all x <= -kExpUnderflow.
+constexpr double kExpUnderflow = 746;
+
+}  // namespace
+
+GeometricDistribution::SearchParameters::SearchParameters(double lambda)
+    : lambda(lambda),
+      in_range_probability(
+          -1.0 * std::expm1(-1.0 * lambda *
+                            std::numeric_limits<int64_t>::max())),
+      log_half(std::log(0.5)),
+      has_wide_range(lambda * std::numeric_limits<int64_t>::max() >=
+                     kExpUnderflow),
+      wide_step(0),
+      wide_numerator(0) {
+  if (has_wide_range) {
+    // The split point of the search while log1p(exp(lambda * (lo - hi))) is
+    // 0, see Search.
+    wide_step = std::max<int64_t>(
+        -static_cast<int64_t>(std::floor(log_half / lambda)), 1);
+    wide_numerator = std::expm1(lambda * -wide_step);
+  }
+}
+
 double GaussianDistribution::SampleGeometric() {
   int geom_sample = 0;
   while (absl::Bernoulli(SecureURBG::GetInstance(), 0.5)) ++geom_sample;
@@ -167,18 +267,121 @@ double GaussianDistribution::SampleBinomial(double sqrt_n) {
   }
 }
 
-double GeometricDistribution::GetUniformDouble() { return UniformDouble(); }
+// The expressions below are evaluated in the same order as in
+// ApproximateBinomialProbability, so that the acceptance probabilities of the
+// fast path are bit-identical to the ones of SampleBinomial.
+GaussianDistribution::BinomialParameters::BinomialParameters(double sqrt_n)
+    : sqrt_n(sqrt_n),
+      n(sqrt_n * sqrt_n),
+      step_size(
+          static_cast<long long>(std::round(std::sqrt(2.0) * sqrt_n + 1))),
+      max_abs_m(sqrt_n * std::sqrt(std::log(n)) / 2),
+      scale(std::sqrt(2 / kPi) / sqrt_n),
+      correction(1 - (0.4 * std::pow(std::log(n), 1.5) / sqrt_n)) {}
+
+const GaussianDistribution::BinomialParameters&
+GaussianDistribution::GetBinomialParameters(double sqrt_n) {
+  thread_local std::optional<BinomialParameters> binomial_parameters;
+  if (!binomial_parameters.has_value() ||
+      binomial_parameters->sqrt_n != sqrt_n) {
+    binomial_parameters.emplace(sqrt_n);
+  }
+  return *binomial_parameters;
+}
+
+// Counts the number of leading one bits of random words, i.e., the number of
+// successful fair coin flips before the first failure.
+int GaussianDistribution::FastSampleGeometric() {
+  SecureURBG& random = SecureURBG::GetInstance();
+  int geom_sample = 0;
+  while (true) {
+    int ones = absl::countl_one(random());
+    geom_sample += ones;
+    if (ones < 64) return geom_sample;
+  }
+}
+
+// Same rejection sampler as SampleBinomial, but with the parameters that only
+// depend on sqrt_n taken from a thread-local cache, so that each attempt costs
+// a single exp() instead of several calls to exp, log, pow and sqrt.
+double GaussianDistribution::FastSampleBinomial(double sqrt_n) {
+  const BinomialParameters& params = GetBinomialParameters(sqrt_n);
+  const long long step_size = params.step_size;
+
+  SecureURBG& random = SecureURBG::GetInstance();
+  while (true) {
+    int geom_sample = FastSampleGeometric();
+    int two_sided_geom =
+        absl::Bernoulli(random, 0.5) ? geom_sample : (-geom_sample - 1);
+    int64_t uniform_sample = absl::Uniform(random, 0u, step_size);
+    int64_t result = step_size * two_sided_geom + uniform_sample;
+
+    if (std::abs(result) > params.max_abs_m) continue;
+    double result_prob =
+        params.scale * std::exp(-2.0 * result * result / params.n) *
+        params.correction;
+    double reject_prob = UniformDouble();
+
+    if (result_prob > 0 && reject_prob > 0 &&
+        reject_prob <
+            result_prob * step_size * std::ldexp(1.0, geom_sample - 2)) {
+      return result;
+    }
+  }
+}
+
+double GeometricDistribution::GetUniformDouble() {
+  ScopedRandomSource scoped_random_source(random_source_);
+  return UniformDouble();
+}
 
 int64_t GeometricDistribution::Sample() { return Sample(1.0); }
 
 int64_t GeometricDistribution::Sample(double scale) {
+  ScopedRandomSource scoped_random_source(random_source_);
   if (lambda_ == std::numeric_limits<double>::infinity()) {
     return 0;
   }
-  double lambda = lambda_ / scale;
+  if (scale == 1.0) {
+    return Search(params_);
+  }
+  return Search(SearchParameters(lambda_ / scale));
+}
+
+void GeometricDistribution::SampleBatch(absl::Span<int64_t> samples) {
+  ScopedRandomSource scoped_random_source(random_source_);
+  if (lambda_ == std::numeric_limits<double>::infinity()) {
+    std::fill(samples.begin(), samples.end(), 0);
+    return;
+  }
+  absl::call_once(bit_probabilities_once_, [this]() {
+    bit_probabilities_ =
+        std::make_unique<std::array<double, kNumSampleBits>>();
+    for (int i = 0; i < kNumSampleBits; ++i) {
+      (*bit_probabilities_)[i] =
+          1 / (1 + std::exp(std::ldexp(lambda_, i)));
+    }
+  });
+  RandomWords& random = ThreadRandomWords();
+  for (int64_t& sample : samples) {
+    // Samples that do not fit into 63 bits saturate, as in Sample().
+    if (!random.Bernoulli(params_.in_range_probability)) {
+      sample = std::numeric_limits<int64_t>::max();
+      continue;
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < kNumSampleBits; ++i) {
+      if (random.Bernoulli((*bit_probabilities_)[i])) {
+        bits |= uint64_t{1} << i;
+      }
+    }
+    sample = static_cast<int64_t>(bits);
+  }
+}
 
-  if (GetUniformDouble() >
-      -1.0 * std::expm1(-1.0 * lambda * std::numeric_limits<int64_t>::max())) {
+int64_t GeometricDistribution::Search(const SearchParameters& params) {
+  const double lambda = params.lambda;
+  if (GetUniformDouble() > params.in_range_probability) {
     return std::numeric_limits<int64_t>::max();
   }
 
@@ -186,20 +389,41 @@ int64_t GeometricDistribution::Sample(double scale) {
   // values. At each step we split the remaining range in two and pick the left
   // or right side proportional to the probability that the output falls within
   // that range, ending when we have only a single possible sample remaining.
+  //
+  // The split point and the probability of the left side only depend on the
+  // width of the range. While the range is wide, they are taken from params.
+  // The denominator of the probability is the numerator of the previous step
+  // after picking the left side. Either way, the results are bit-identical to
+  // computing them from scratch.
   int64_t lo = 0;
   int64_t hi = std::numeric_limits<int64_t>::max();
+  // expm1(lambda * (lo - hi)), if known.
+  std::optional<double> denominator;
   while (hi - lo > 1) {
-    int64_t mid =
-        lo - static_cast<int64_t>(std::floor(
-                 (std::log(0.5) + std::log1p(std::exp(lambda * (lo - hi)))) /
-                 lambda));
-    mid = std::min(std::max(mid, lo + 1), hi - 1);
-
-    double q = std::expm1(lambda * (lo - mid)) / std::expm1(lambda * (lo - hi));
-    if (GetUniformDouble() <= q) {
+    int64_t mid;
+    double numerator;
+    if (params.has_wide_range && lambda * (hi - lo) >= kExpUnderflow) {
+      mid = lo + params.wide_step;
+      numerator = params.wide_numerator;
+      denominator = -1.0;
+    } else {
+      mid = lo - static_cast<int64_t>(std::floor(
+                     (params.log_half +
+                      std::log1p(std::exp(lambda * (lo - hi)))) /
+                     lambda));
+      mid = std::min(std::max(mid, lo + 1), hi - 1);
+      numerator = std::expm1(lambda * (lo - mid));
+      if (!denominator.has_value()) {
+        denominator = std::expm1(lambda * (lo - hi));
+      }
+    }
+
+    if (GetUniformDouble() <= numerator / *denominator) {
       hi = mid;
+      denominator = numerator;
     } else {
       lo = mid;
+      denominator.reset();
     }
   }
   return hi - 1;
@@ -252,6 +476,12 @@ LaplaceDistribution::Builder& LaplaceDistribution::Builder::SetSensitivity(
   return *this;
 }
 
+LaplaceDistribution::Builder& LaplaceDistribution::Builder::SetRandomSource(
+    RandomSource* random_source) {
+  random_source_ = random_source;
+  return *this;
+}
+
 absl::StatusOr<std::unique_ptr<LaplaceDistribution>>
 LaplaceDistribution::Builder::Build() {
   RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
@@ -262,9 +492,13 @@ LaplaceDistribution::Builder::Build() {
       std::unique_ptr<GeometricDistribution> geometric_distro,
       GeometricDistribution::Builder()
           .SetLambda(granularity * epsilon_ / (sensitivity_ + granularity))
+          .SetRandomSource(random_source_)
           .Build());
-  return absl::WrapUnique<LaplaceDistribution>(new LaplaceDistribution(
-      epsilon_, sensitivity_, granularity, std::move(geometric_distro)));
+  auto distribution = absl::WrapUnique<LaplaceDistribution>(
+      new LaplaceDistribution(epsilon_, sensitivity_, granularity,
+                              std::move(geometric_distro)));
+  distribution->random_source_ = random_source_;
+  return distribution;
 }
 
 LaplaceDistribution::LaplaceDistribution(
@@ -294,13 +528,18 @@ LaplaceDistribution::LaplaceDistribution(double epsilon, double sensitivity)
   geometric_distro_ = builder.SetLambda(lambda).Build().value();
 }
 
-double LaplaceDistribution::GetUniformDouble() { return UniformDouble(); }
+double LaplaceDistribution::GetUniformDouble() {
+  ScopedRandomSource scoped_random_source(random_source_);
+  return UniformDouble();
+}
 
 bool LaplaceDistribution::GetBoolean() {
+  ScopedRandomSource scoped_random_source(random_source_);
   return absl::Bernoulli(SecureURBG::GetInstance(), 0.5);
 }
 
 double LaplaceDistribution::Sample() {
+  ScopedRandomSource scoped_random_source(random_source_);
   int64_t sample;
   bool sign;
   do {
@@ -339,6 +578,366 @@ double LaplaceDistribution::Quantile(double b, double p) {
   return b * std::log(2 * p);
 }
 
+uint64_t RandomWords::NextWord() {
+  if (next_word_ == kNumWords || IsStale()) {
+    if (source_ != nullptr) {
+      source_->Fill(absl::MakeSpan(words_));
+    } else {
+      SecureURBG::GetInstance().Fill(absl::MakeSpan(words_));
+    }
+    next_word_ = 0;
+    num_bits_ = 0;
+    generation_ = internal::random_source_generation;
+  }
+  return words_[next_word_++];
+}
+
+bool RandomWords::Bit() {
+  if (num_bits_ == 0 || IsStale()) {
+    bits_ = NextWord();
+    num_bits_ = 64;
+  }
+  const bool bit = bits_ & 1;
+  bits_ >>= 1;
+  --num_bits_;
+  return bit;
+}
+
+uint64_t RandomWords::Uniform(uint64_t n) {
+  DCHECK_GT(n, 0);
+  if ((n & (n - 1)) == 0) {
+    return NextWord() & (n - 1);
+  }
+  // Lemire's multiply-and-shift method, rejecting the low products that would
+  // make some results more likely than others.
+  absl::uint128 product = absl::uint128(NextWord()) * n;
+  if (absl::Uint128Low64(product) < n) {
+    const uint64_t threshold = (0 - n) % n;
+    while (absl::Uint128Low64(product) < threshold) {
+      product = absl::uint128(NextWord()) * n;
+    }
+  }
+  return absl::Uint128High64(product);
+}
+
+bool RandomWords::Bernoulli(double p) {
+  if (!(p > 0)) return false;
+  if (p >= 1) return true;
+  // A uniform U in [0, 1) is below p iff the first bit in which their binary
+  // expansions differ is set in p. Doubling and subtracting 1 are exact.
+  while (p > 0) {
+    p *= 2;
+    const bool p_bit = p >= 1;
+    if (p_bit) p -= 1;
+    if (Bit() != p_bit) {
+      return p_bit;
+    }
+  }
+  return false;
+}
+
+bool RandomWords::Bernoulli(uint64_t numerator, uint64_t denominator) {
+  DCHECK_LE(numerator, denominator);
+  if (numerator == 0) return false;
+  if (numerator == denominator) return true;
+  return Uniform(denominator) < numerator;
+}
+
+namespace {
+
+// Returns true with probability exp(-gamma) for gamma = numerator /
+// denominator in [0, 1]. Draws K, the index of the first failure among
+// independent Bernoulli(gamma / k) trials for k = 1, 2, ..., and returns
+// whether K is odd, which has probability sum_k (-gamma)^k / k! = exp(-gamma).
+bool BernoulliExpAtMostOne(RandomWords& random, uint64_t numerator,
+                           uint64_t denominator) {
+  uint64_t k = 1;
+  // Bernoulli(gamma / k) is the conjunction of Bernoulli(gamma) and
+  // Bernoulli(1 / k).
+  while (random.Bernoulli(numerator, denominator) &&
+         (k == 1 || random.Uniform(k) == 0)) {
+    ++k;
+  }
+  return k % 2 == 1;
+}
+
+// Samples the discrete Laplace distribution with P(x) proportional to
+// exp(-|x| * numerator / denominator), following Algorithm 2 of Canonne,
+// Kamath and Steinke.
+int64_t SampleDiscreteLaplace(RandomWords& random, uint64_t numerator,
+                              uint64_t denominator) {
+  while (true) {
+    // denominator * v + u is geometric with parameter
+    // 1 - exp(-1 / denominator), split into u and v.
+    const uint64_t u = random.Uniform(denominator);
+    if (!random.BernoulliExp(u, denominator)) {
+      continue;
+    }
+    uint64_t v = 0;
+    while (random.BernoulliExp(1, 1)) {
+      ++v;
+    }
+    const absl::uint128 magnitude =
+        (absl::uint128(denominator) * v + u) / numerator;
+    const bool negative = random.Bit();
+    // Zero would be twice as likely as it should be if both signs kept it.
+    if (negative && magnitude == 0) {
+      continue;
+    }
+    const int64_t result =
+        magnitude > std::numeric_limits<int64_t>::max()
+            ? std::numeric_limits<int64_t>::max()
+            : static_cast<int64_t>(absl::Uint128Low64(magnitude));
+    return negative ? -result : result;
+  }
+}
+
+// Rounds x up to a fraction numerator / 2^shift with a numerator of
+// precision_bits bits, or to an integer if x is too large for that. The
+// result is never smaller than x, also in the presence of rounding errors of
+// the computation of x.
+void RoundUpToBinaryFraction(double x, int precision_bits, uint64_t* numerator,
+                             int* shift) {
+  int exponent;
+  std::frexp(x, &exponent);
+  *shift = std::max(0, precision_bits - exponent);
+  *numerator = static_cast<uint64_t>(
+                   std::floor(std::ldexp(x, *shift) * (1 + 0x1p-40))) +
+               1;
+}
+
+}  // namespace
+
+bool RandomWords::BernoulliExp(absl::uint128 numerator, uint64_t denominator) {
+  DCHECK_GT(denominator, 0);
+  // exp(-gamma) = exp(-1)^floor(gamma) * exp(-(gamma - floor(gamma))).
+  while (numerator > denominator) {
+    if (!BernoulliExpAtMostOne(*this, 1, 1)) {
+      return false;
+    }
+    numerator -= denominator;
+  }
+  return BernoulliExpAtMostOne(*this, absl::Uint128Low64(numerator),
+                               denominator);
+}
+
+RandomWords& ThreadRandomWords() {
+  thread_local RandomWords random;
+  return random;
+}
+
+DiscreteLaplaceDistribution::Builder&
+DiscreteLaplaceDistribution::Builder::SetEpsilon(double epsilon) {
+  epsilon_ = epsilon;
+  return *this;
+}
+
+DiscreteLaplaceDistribution::Builder&
+DiscreteLaplaceDistribution::Builder::SetSensitivity(double sensitivity) {
+  sensitivity_ = sensitivity;
+  return *this;
+}
+
+DiscreteLaplaceDistribution::Builder&
+DiscreteLaplaceDistribution::Builder::SetRandomSource(
+    RandomSource* random_source) {
+  random_source_ = random_source;
+  return *this;
+}
+
+absl::StatusOr<std::unique_ptr<DiscreteLaplaceDistribution>>
+DiscreteLaplaceDistribution::Builder::Build() {
+  RETURN_IF_ERROR(ValidateIsFiniteAndPositive(epsilon_, "Epsilon"));
+  RETURN_IF_ERROR(ValidateIsFiniteAndPositive(sensitivity_, "Sensitivity"));
+  const double rate = epsilon_ / sensitivity_;
+  if (!(rate >= GetMinRate())) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Epsilon / sensitivity must be at least ", GetMinRate(), ", but is ",
+        rate, "."));
+  }
+  // Round the rate down to numerator / 2^shift.
+  int exponent;
+  std::frexp(rate, &exponent);
+  const int shift = kRatePrecisionBits - exponent;
+  if (shift <= 0) {
+    const double numerator =
+        std::min(std::floor(rate), static_cast<double>(uint64_t{1} << 62));
+    auto distribution = absl::WrapUnique(
+        new DiscreteLaplaceDistribution(static_cast<uint64_t>(numerator), 1));
+    if (random_source_ != nullptr) {
+      distribution->random_words_ =
+          std::make_unique<RandomWords>(random_source_);
+    }
+    return distribution;
+  }
+  auto distribution = absl::WrapUnique(new DiscreteLaplaceDistribution(
+      static_cast<uint64_t>(std::floor(std::ldexp(rate, shift))),
+      uint64_t{1} << shift));
+  if (random_source_ != nullptr) {
+    distribution->random_words_ = std::make_unique<RandomWords>(random_source_);
+  }
+  return distribution;
+}
+
+int64_t DiscreteLaplaceDistribution::Sample() {
+  return SampleDiscreteLaplace(
+      random_words_ != nullptr ? *random_words_ : ThreadRandomWords(),
+      numerator_, denominator_);
+}
+
+void DiscreteLaplaceDistribution::SampleBatch(absl::Span<int64_t> samples) {
+  RandomWords& random =
+      random_words_ != nullptr ? *random_words_ : ThreadRandomWords();
+  for (int64_t& sample : samples) {
+    sample = SampleDiscreteLaplace(random, numerator_, denominator_);
+  }
+}
+
+double DiscreteLaplaceDistribution::GetRate() const {
+  return static_cast<double>(numerator_) / static_cast<double>(denominator_);
+}
+
+double DiscreteLaplaceDistribution::GetVariance() const {
+  const double rate = GetRate();
+  return 2 * std::exp(-rate) / std::pow(std::expm1(-rate), 2);
+}
+
+double DiscreteLaplaceDistribution::GetMinRate() {
+  // Allows denominators of up to 2^62.
+  return std::ldexp(1, kRatePrecisionBits - 63);
+}
+
+double DiscreteLaplaceDistribution::Cdf(double rate, double x) {
+  const double k = std::floor(x);
+  const double p = std::exp(-rate);
+  if (k < 0) {
+    return std::exp(rate * k) / (1 + p);
+  }
+  return 1 - std::exp(-rate * (k + 1)) / (1 + p);
+}
+
+double DiscreteLaplaceDistribution::Quantile(double rate, double p) {
+  const double e = std::exp(-rate);
+  if (p <= e / (1 + e)) {
+    return std::ceil(std::log(p * (1 + e)) / rate);
+  }
+  return std::max(0.0, std::ceil(-std::log((1 - p) * (1 + e)) / rate) - 1);
+}
+
+DiscreteGaussianDistribution::Builder&
+DiscreteGaussianDistribution::Builder::SetStddev(double stddev) {
+  stddev_ = stddev;
+  return *this;
+}
+
+DiscreteGaussianDistribution::Builder&
+DiscreteGaussianDistribution::Builder::SetRandomSource(
+    RandomSource* random_source) {
+  random_source_ = random_source;
+  return *this;
+}
+
+absl::StatusOr<std::unique_ptr<DiscreteGaussianDistribution>>
+DiscreteGaussianDistribution::Builder::Build() {
+  RETURN_IF_ERROR(
+      ValidateIsInInclusiveInterval(stddev_, GetMinStddev(), GetMaxStddev(),
+                                    "Standard deviation"));
+  const uint64_t laplace_scale = static_cast<uint64_t>(std::floor(stddev_)) + 1;
+  uint64_t numerator;
+  int shift;
+  RoundUpToBinaryFraction(stddev_ * stddev_ / laplace_scale,
+                          kVariancePrecisionBits, &numerator, &shift);
+  const absl::uint128 denominator =
+      (absl::uint128(numerator) * laplace_scale) << (shift + 1);
+  if (denominator > (uint64_t{1} << 62)) {
+    return absl::InternalError(absl::StrCat(
+        "Standard deviation ", stddev_, " cannot be represented exactly."));
+  }
+  auto distribution = absl::WrapUnique(new DiscreteGaussianDistribution(
+      laplace_scale, numerator, shift, absl::Uint128Low64(denominator)));
+  if (random_source_ != nullptr) {
+    distribution->random_words_ = std::make_unique<RandomWords>(random_source_);
+  }
+  return distribution;
+}
+
+int64_t DiscreteGaussianDistribution::Sample() {
+  int64_t sample;
+  SampleBatch(absl::MakeSpan(&sample, 1));
+  return sample;
+}
+
+void DiscreteGaussianDistribution::SampleBatch(absl::Span<int64_t> samples) {
+  RandomWords& random =
+      random_words_ != nullptr ? *random_words_ : ThreadRandomWords();
+  for (int64_t& sample : samples) {
+    // Algorithm 3 of Canonne, Kamath and Steinke.
+    while (true) {
+      sample = SampleDiscreteLaplace(random, 1, laplace_scale_);
+      const absl::uint128 scaled =
+          absl::uint128(sample < 0 ? -static_cast<uint64_t>(sample)
+                                   : static_cast<uint64_t>(sample))
+          << shift_;
+      const absl::uint128 difference =
+          scaled > numerator_ ? scaled - numerator_ : numerator_ - scaled;
+      // Beyond 2^64, the acceptance probability is below exp(-2^66).
+      if (absl::Uint128High64(difference) != 0) {
+        continue;
+      }
+      if (random.BernoulliExp(difference * difference, denominator_)) {
+        break;
+      }
+    }
+  }
+}
+
+double DiscreteGaussianDistribution::Stddev() const {
+  return std::sqrt(std::ldexp(static_cast<double>(numerator_), -shift_) *
+                   static_cast<double>(laplace_scale_));
+}
+
+double DiscreteGaussianDistribution::GetMinStddev() {
+  return std::ldexp(1, -9);
+}
+
+double DiscreteGaussianDistribution::GetMaxStddev() {
+  return std::ldexp(1, 30);
+}
+
+double DiscreteGaussianDistribution::Cdf(double stddev, double x) {
+  const double k = std::floor(x);
+  if (stddev >= 1) {
+    // The continuity-corrected Gaussian cdf is within exp(-2 pi^2 stddev^2)
+    // of the exact value.
+    return GaussianDistribution::cdf(stddev, k + 0.5);
+  }
+  // Terms of magnitude beyond 40 are below exp(-800).
+  constexpr int kMaxMagnitude = 40;
+  double total = 0;
+  double below = 0;
+  for (int z = -kMaxMagnitude; z <= kMaxMagnitude; ++z) {
+    const double weight = std::exp(-z * z / (2 * stddev * stddev));
+    total += weight;
+    if (z <= k) {
+      below += weight;
+    }
+  }
+  return below / total;
+}
+
+double DiscreteGaussianDistribution::Quantile(double stddev, double p) {
+  if (p <= 0) return -std::numeric_limits<double>::infinity();
+  if (p >= 1) return std::numeric_limits<double>::infinity();
+  double k = std::round(GaussianDistribution::Quantile(stddev, p));
+  while (Cdf(stddev, k - 1) >= p) {
+    --k;
+  }
+  while (Cdf(stddev, k) < p) {
+    ++k;
+  }
+  return k;
+}
+
 int64_t LaplaceDistribution::MemoryUsed() {
   int64_t memory = sizeof(LaplaceDistribution);
   if (geometric_distro_ != nullptr) {
@@ -17,11 +17,16 @@
 #ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_DISTRIBUTIONS_H_
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_DISTRIBUTIONS_H_
 
+#include <array>
 #include <cstdint>
 #include <memory>
 
+#include "absl/base/call_once.h"
+#include "absl/numeric/int128.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "algorithms/rand.h"
 
 namespace differential_privacy {
 namespace internal {
@@ -40,10 +45,25 @@ class GaussianDistribution {
    public:
     Builder& SetStddev(double stddev);
 
+    // Enables the fast path of the binomial rejection sampler (enabled by
+    // default). The fast path precomputes and caches (per thread) the
+    // parameters of the acceptance test that only depend on the size of the
+    // binomial, and draws the geometric samples of the proposal from whole
+    // random words. Both paths sample from the same distribution; disabling
+    // the fast path is mainly useful for benchmarking and testing.
+    Builder& SetUseFastBinomialSampling(bool use_fast_binomial_sampling);
+
+    // Draws the randomness from random_source instead of SecureURBG. The
+    // source must outlive the distribution, which is then only safe to use
+    // from one thread at a time (see RandomSource).
+    Builder& SetRandomSource(RandomSource* random_source);
+
     absl::StatusOr<std::unique_ptr<GaussianDistribution>> Build();
 
    private:
     double stddev_;
+    bool use_fast_binomial_sampling_ = true;
+    RandomSource* random_source_ = nullptr;
   };
 
   virtual ~GaussianDistribution() {}
@@ -53,6 +73,11 @@ class GaussianDistribution {
   // Samples the Gaussian with distribution Gauss(scale*stddev).
   virtual double Sample(double scale);
 
+  // Fills samples with independent draws from Gauss(scale*stddev). Equivalent
+  // to calling Sample(scale) for every element, but computes the granularity
+  // and binomial parameters only once.
+  void SampleBatch(double scale, absl::Span<double> samples);
+
   // Returns the standard deviation of this distribution.
   double Stddev() const;
 
@@ -65,20 +90,57 @@ class GaussianDistribution {
   // at point x.
   static double cdf(double stddev, double x);
 
+  // Writes cdf(stddev, x[i]) to cdf[i]. The scale is computed once for all
+  // points and the results are identical to those of the scalar version. Both
+  // spans must have the same size.
+  static void cdf(double stddev, absl::Span<const double> x,
+                  absl::Span<double> cdf);
+
   // Returns the quantile (inverse cdf) of the Gaussian distribution with
   // standard deviation stddev at point x.
   static double Quantile(double stddev, double x);
 
+  // Writes Quantile(stddev, p[i]) to quantiles[i], with results identical to
+  // those of the scalar version. Both spans must have the same size.
+  static void Quantile(double stddev, absl::Span<const double> p,
+                       absl::Span<double> quantiles);
+
  private:
+  // Parameters of the binomial rejection sampler that only depend on sqrt(n).
+  struct BinomialParameters {
+    explicit BinomialParameters(double sqrt_n);
+
+    double sqrt_n;
+    double n;
+    long long step_size;
+    // Proposals m with |m| above this bound have an approximate probability
+    // of 0.
+    double max_abs_m;
+    // Factors of the approximate binomial probability that do not depend on m.
+    double scale;
+    double correction;
+  };
+
   // Constructor for Gaussian with specified stddev.
-  explicit GaussianDistribution(double stddev);
+  GaussianDistribution(double stddev, bool use_fast_binomial_sampling);
 
   // Sample from geometric distribution with probability 0.5. It is much faster
   // then using GeometricDistribution which is suitable for any probability.
   double SampleGeometric();
   double SampleBinomial(double sqrt_n);
 
+  // Fast path versions of the above.
+  int FastSampleGeometric();
+  double FastSampleBinomial(double sqrt_n);
+
+  // Returns the cached binomial parameters for sqrt_n, recomputing them if
+  // sqrt_n differs from the cached value. The cache is thread local so that a
+  // distribution can be used from several threads at once.
+  static const BinomialParameters& GetBinomialParameters(double sqrt_n);
+
   double stddev_;
+  bool use_fast_binomial_sampling_;
+  RandomSource* random_source_ = nullptr;
 };
 
 // Returns a sample drawn from the geometric distribution of probability
@@ -94,10 +156,14 @@ class GeometricDistribution {
    public:
     Builder& SetLambda(double lambda);
 
+    // See GaussianDistribution::Builder::SetRandomSource.
+    Builder& SetRandomSource(RandomSource* random_source);
+
     absl::StatusOr<std::unique_ptr<GeometricDistribution>> Build();
 
    private:
     double lambda_;
+    RandomSource* random_source_ = nullptr;
   };
 
   virtual ~GeometricDistribution() {}
@@ -108,13 +174,50 @@ class GeometricDistribution {
 
   virtual int64_t Sample(double scale);
 
+  // Fills samples with independent draws of Sample(). Restricted to
+  // [0, 2^63), the bits of a geometric sample are independent, and bit i is
+  // set with probability 1 / (1 + exp(lambda * 2^i)). The batch draws the bits
+  // directly with these probabilities, which are computed once per instance,
+  // instead of running the binary search with its transcendental functions
+  // for every sample. Does not use GetUniformDouble().
+  void SampleBatch(absl::Span<int64_t> samples);
+
   double Lambda();
 
  protected:
   explicit GeometricDistribution(double lambda);
 
  private:
+  // Quantities of the binary search of Sample that only depend on lambda.
+  struct SearchParameters {
+    explicit SearchParameters(double lambda);
+
+    double lambda;
+    // Probability that the sample is below the maximum int64_t.
+    double in_range_probability;
+    double log_half;
+    // Whether the range of the search is wide enough for
+    // exp(lambda * (lo - hi)) to underflow to 0 at the start. While it is,
+    // the split point is wide_step above lo and the probability of the lower
+    // half is -wide_numerator.
+    bool has_wide_range;
+    int64_t wide_step;
+    double wide_numerator;
+  };
+
+  static constexpr int kNumSampleBits = 63;
+
+  // Runs the binary search of Sample.
+  int64_t Search(const SearchParameters& params);
+
   double lambda_;
+  // Parameters for scale 1, precomputed since Sample() uses them.
+  SearchParameters params_;
+  // Probabilities of the bits of a sample for SampleBatch, computed on first
+  // use.
+  absl::once_flag bit_probabilities_once_;
+  std::unique_ptr<std::array<double, kNumSampleBits>> bit_probabilities_;
+  RandomSource* random_source_ = nullptr;
 };
 
 // DO NOT USE. Use LaplaceMechanism instead. LaplaceMechanism has an interface
@@ -135,11 +238,15 @@ class LaplaceDistribution {
 
     Builder& SetSensitivity(double sensitivity);
 
+    // See GaussianDistribution::Builder::SetRandomSource.
+    Builder& SetRandomSource(RandomSource* random_source);
+
     absl::StatusOr<std::unique_ptr<LaplaceDistribution>> Build();
 
    private:
     double epsilon_;
     double sensitivity_;
+    RandomSource* random_source_ = nullptr;
   };
 
   virtual ~LaplaceDistribution() = default;
@@ -189,6 +296,7 @@ class LaplaceDistribution {
   double epsilon_;
   double sensitivity_;
   double granularity_;
+  RandomSource* random_source_ = nullptr;
 
   // Inclusive lower bound for epsilon when calculating granularity.
   static constexpr double kMinEpsilon = 1.0 / (int64_t{1} << 50);
@@ -197,6 +305,192 @@ class LaplaceDistribution {
   std::unique_ptr<GeometricDistribution> geometric_distro_;
 };
 
+// Source of random integers for the exact samplers of the discrete
+// distributions below. Draws 64-bit words from SecureURBG in blocks and hands
+// out single bits of them, so that a fair coin costs a 64th of a word. Not
+// thread safe.
+class RandomWords {
+ public:
+  // Draws from SecureURBG. Cached words and bits are dropped when the random
+  // source of the thread changes (see ScopedRandomSource), so that they are
+  // never used under another source.
+  RandomWords() = default;
+
+  // Draws from source, which must outlive this object.
+  explicit RandomWords(RandomSource* source) : source_(source) {}
+
+  // Returns a uniformly random bit.
+  bool Bit();
+
+  // Returns a uniformly random integer in [0, n). n must be positive.
+  uint64_t Uniform(uint64_t n);
+
+  // Returns true with probability numerator / denominator. Requires
+  // numerator <= denominator and a positive denominator.
+  bool Bernoulli(uint64_t numerator, uint64_t denominator);
+
+  // Returns true with probability p, exactly, by comparing random bits with
+  // the binary expansion of p. Takes two bits on average.
+  bool Bernoulli(double p);
+
+  // Returns true with probability exp(-numerator / denominator), using
+  // integer arithmetic only (Algorithm 1 of Canonne, Kamath and Steinke).
+  // denominator must be positive.
+  bool BernoulliExp(absl::uint128 numerator, uint64_t denominator);
+
+ private:
+  static constexpr int kNumWords = 16;
+
+  uint64_t NextWord();
+
+  // Whether the cached words were drawn under another source of the thread.
+  bool IsStale() const {
+    return source_ == nullptr &&
+           generation_ != internal::random_source_generation;
+  }
+
+  std::array<uint64_t, kNumWords> words_;
+  int next_word_ = kNumWords;
+  uint64_t bits_ = 0;
+  int num_bits_ = 0;
+  RandomSource* source_ = nullptr;
+  // Value of random_source_generation when words_ was filled.
+  uint64_t generation_ = 0;
+};
+
+// Returns the RandomWords of the calling thread.
+RandomWords& ThreadRandomWords();
+
+// Samples the discrete Laplace distribution over the integers, with
+// P(x) proportional to exp(-|x| * rate) for rate = epsilon / sensitivity.
+//
+// Samples are drawn with the exact sampler of Canonne, Kamath and Steinke,
+// "The Discrete Gaussian for Differential Privacy"
+// (https://arxiv.org/abs/2004.00010), which only uses integer arithmetic. To
+// that end, the rate is rounded down to a fraction with a power-of-two
+// denominator and a numerator of kRatePrecisionBits bits, which slightly
+// increases the noise.
+class DiscreteLaplaceDistribution {
+ public:
+  static constexpr int kRatePrecisionBits = 25;
+
+  class Builder {
+   public:
+    Builder& SetEpsilon(double epsilon);
+
+    Builder& SetSensitivity(double sensitivity);
+
+    // See GaussianDistribution::Builder::SetRandomSource.
+    Builder& SetRandomSource(RandomSource* random_source);
+
+    // Fails unless epsilon / sensitivity is at least GetMinRate().
+    absl::StatusOr<std::unique_ptr<DiscreteLaplaceDistribution>> Build();
+
+   private:
+    double epsilon_;
+    double sensitivity_;
+    RandomSource* random_source_ = nullptr;
+  };
+
+  int64_t Sample();
+
+  // Fills samples with independent draws. Equivalent to calling Sample() for
+  // every element.
+  void SampleBatch(absl::Span<int64_t> samples);
+
+  // Returns the rate of the distribution after rounding.
+  double GetRate() const;
+
+  double GetVariance() const;
+
+  // Returns the smallest supported rate.
+  static double GetMinRate();
+
+  // Returns the cdf of the discrete Laplace distribution with the given rate
+  // at point x.
+  static double Cdf(double rate, double x);
+
+  // Returns the smallest integer x such that Cdf(rate, x) >= p.
+  static double Quantile(double rate, double p);
+
+ private:
+  DiscreteLaplaceDistribution(uint64_t numerator, uint64_t denominator)
+      : numerator_(numerator), denominator_(denominator) {}
+
+  // The rate is numerator_ / denominator_.
+  const uint64_t numerator_;
+  const uint64_t denominator_;
+  // Set when the distribution is built with a random source.
+  std::unique_ptr<RandomWords> random_words_;
+};
+
+// Samples the discrete Gaussian distribution over the integers, with
+// P(x) proportional to exp(-x^2 / (2 * stddev^2)), with the exact integer
+// sampler of Canonne, Kamath and Steinke. The variance parameter stddev^2 is
+// rounded up to kVariancePrecisionBits bits, which slightly increases the
+// noise. The actual variance of the distribution is slightly smaller than
+// stddev^2.
+class DiscreteGaussianDistribution {
+ public:
+  static constexpr int kVariancePrecisionBits = 20;
+
+  class Builder {
+   public:
+    Builder& SetStddev(double stddev);
+
+    // See GaussianDistribution::Builder::SetRandomSource.
+    Builder& SetRandomSource(RandomSource* random_source);
+
+    // Fails unless the standard deviation is in [GetMinStddev(),
+    // GetMaxStddev()].
+    absl::StatusOr<std::unique_ptr<DiscreteGaussianDistribution>> Build();
+
+   private:
+    double stddev_;
+    RandomSource* random_source_ = nullptr;
+  };
+
+  int64_t Sample();
+
+  // Fills samples with independent draws. Equivalent to calling Sample() for
+  // every element.
+  void SampleBatch(absl::Span<int64_t> samples);
+
+  // Returns the standard deviation parameter after rounding.
+  double Stddev() const;
+
+  static double GetMinStddev();
+  static double GetMaxStddev();
+
+  // Returns the cdf of the discrete Gaussian distribution with the given
+  // standard deviation parameter at point x.
+  static double Cdf(double stddev, double x);
+
+  // Returns the smallest integer x such that Cdf(stddev, x) >= p.
+  static double Quantile(double stddev, double p);
+
+ private:
+  DiscreteGaussianDistribution(uint64_t laplace_scale, uint64_t numerator,
+                               int shift, uint64_t denominator)
+      : laplace_scale_(laplace_scale),
+        numerator_(numerator),
+        shift_(shift),
+        denominator_(denominator) {}
+
+  // Candidates are drawn from the discrete Laplace distribution of scale
+  // laplace_scale_, which is floor(stddev) + 1, and accepted with probability
+  // exp(-(|x| - tau)^2 / (2 * tau * laplace_scale_)), where
+  // tau = numerator_ / 2^shift_ and stddev^2 = tau * laplace_scale_.
+  // denominator_ is 2^(shift_ + 1) * numerator_ * laplace_scale_, so that the
+  // exponent is (|x| * 2^shift_ - numerator_)^2 / denominator_.
+  const uint64_t laplace_scale_;
+  const uint64_t numerator_;
+  const int shift_;
+  const uint64_t denominator_;
+  // Set when the distribution is built with a random source.
+  std::unique_ptr<RandomWords> random_words_;
+};
+
 }  // namespace internal
 }  // namespace differential_privacy
 #endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_DISTRIBUTIONS_H_
@@ -14,7 +14,13 @@
 // limitations under the License.
 //
 
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include "absl/strings/str_format.h"
+#include "absl/types/span.h"
 #include "benchmark/benchmark.h"
 #include "algorithms/distributions.h"
 
@@ -89,6 +95,50 @@ void BM_laplace_chi_squared(benchmark::State& state) {
 }
 BENCHMARK(BM_laplace_chi_squared);
 
+// Measures Gaussian samples per second with (argument 1) and without
+// (argument 0) the fast path of the binomial rejection sampler.
+void BM_gaussian_sample(benchmark::State& state) {
+  std::unique_ptr<GaussianDistribution> dist =
+      GaussianDistribution::Builder()
+          .SetStddev(1.0)
+          .SetUseFastBinomialSampling(state.range(0) == 1)
+          .Build()
+          .value();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dist->Sample());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(state.range(0) == 1 ? "fast path" : "reference path");
+}
+BENCHMARK(BM_gaussian_sample)->Arg(0)->Arg(1);
+
+// Measures geometric samples per second with the lambda of the Laplace noise
+// for epsilon = sensitivity = 1, drawn one at a time (argument 0) or in batches
+// of kBatchSize (argument 1).
+void BM_geometric_sample(benchmark::State& state) {
+  constexpr int kBatchSize = 1024;
+  const double granularity = std::ldexp(1.0, -40);
+  std::unique_ptr<GeometricDistribution> dist =
+      GeometricDistribution::Builder()
+          .SetLambda(granularity / (1 + granularity))
+          .Build()
+          .value();
+  std::vector<int64_t> samples(kBatchSize);
+  for (auto _ : state) {
+    if (state.range(0) == 1) {
+      dist->SampleBatch(absl::MakeSpan(samples));
+    } else {
+      for (int64_t& sample : samples) {
+        sample = dist->Sample();
+      }
+    }
+    benchmark::DoNotOptimize(samples.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+  state.SetLabel(state.range(0) == 1 ? "batch" : "one at a time");
+}
+BENCHMARK(BM_geometric_sample)->Arg(0)->Arg(1);
+
 }  // namespace
 }  // namespace internal
 }  // namespace differential_privacy
@@ -20,13 +20,18 @@
 #include <cstdlib>
 #include <limits>
 #include <memory>
+#include <random>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "base/testing/status_matchers.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/memory/memory.h"
+#include "absl/random/random.h"
 #include "absl/strings/str_replace.h"
+#include "absl/types/span.h"
 #include "algorithms/numerical-mechanisms-testing.h"
 #include "algorithms/util.h"
 
@@ -262,6 +267,43 @@ TEST(GaussDistributionTest, CheckStatisticsForSpecificScaledDistribution) {
   EXPECT_NEAR(stddev * stddev * scale * scale, Variance(samples), 0.1 * scale);
 }
 
+TEST(GaussDistributionTest, FastAndReferenceBinomialSamplingAgree) {
+  for (bool use_fast_path : {false, true}) {
+    std::unique_ptr<GaussianDistribution> dist =
+        GaussianDistribution::Builder()
+            .SetStddev(kOneOverLog2)
+            .SetUseFastBinomialSampling(use_fast_path)
+            .Build()
+            .value();
+    std::vector<double> samples(kGaussianSamples);
+    std::generate(samples.begin(), samples.end(),
+                  [&dist]() { return dist->Sample(); });
+    double mean = Mean(samples);
+    double variance = Variance(samples);
+    EXPECT_NEAR(0.0, mean, 0.01) << "fast path: " << use_fast_path;
+    EXPECT_NEAR(kOneOverLog2 * kOneOverLog2, variance, 0.1)
+        << "fast path: " << use_fast_path;
+    EXPECT_NEAR(0.0, Skew(samples, mean, std::sqrt(variance)), 0.1)
+        << "fast path: " << use_fast_path;
+    EXPECT_NEAR(0.0, Kurtosis(samples, mean, variance), 0.1)
+        << "fast path: " << use_fast_path;
+  }
+}
+
+TEST(GaussDistributionTest, FastBinomialSamplingHandlesChangingScale) {
+  std::unique_ptr<GaussianDistribution> dist =
+      GaussianDistribution::Builder().SetStddev(1.0).Build().value();
+  std::vector<double> small_scale(kGaussianSamples / 2);
+  std::vector<double> large_scale(kGaussianSamples / 2);
+  // Alternate the scale so that the cached parameters are recomputed often.
+  for (int i = 0; i < kGaussianSamples / 2; ++i) {
+    small_scale[i] = dist->Sample(1.0);
+    large_scale[i] = dist->Sample(10.0);
+  }
+  EXPECT_NEAR(1.0, Variance(small_scale), 0.1);
+  EXPECT_NEAR(100.0, Variance(large_scale), 10);
+}
+
 TEST(GaussDistributionTest, StandardDeviationGetter) {
   double stddev = kOneOverLog2;
   GaussianDistribution::Builder builder;
@@ -298,6 +340,26 @@ TEST(GaussDistributionTest, Quantile) {
   EXPECT_DEATH(GaussianDistribution::Quantile(-1, 1), "");
 }
 
+TEST(GaussDistributionTest, BatchCdfAndQuantileMatchScalarVersions) {
+  std::vector<double> x = {-std::numeric_limits<double>::infinity(),
+                           -40, -9, -1, -0.1, 0, 0.3, 2, 8.5, 40,
+                           std::numeric_limits<double>::infinity()};
+  std::vector<double> p = {0, 1e-300, 2.8665157e-7, 0.1, 0.5, 0.9,
+                           1 - 1e-12, 1};
+  for (double stddev : {0.1, 1.0, 7.0}) {
+    std::vector<double> cdf(x.size());
+    GaussianDistribution::cdf(stddev, x, absl::MakeSpan(cdf));
+    for (int i = 0; i < x.size(); ++i) {
+      EXPECT_EQ(cdf[i], GaussianDistribution::cdf(stddev, x[i]));
+    }
+    std::vector<double> quantiles(p.size());
+    GaussianDistribution::Quantile(stddev, p, absl::MakeSpan(quantiles));
+    for (int i = 0; i < p.size(); ++i) {
+      EXPECT_EQ(quantiles[i], GaussianDistribution::Quantile(stddev, p[i]));
+    }
+  }
+}
+
 TEST(GeometricDistributionTest, ParameterValidation) {
   GeometricDistribution::Builder builder;
 
@@ -359,6 +421,65 @@ TEST(GeometricDistributionTest, Ratios) {
   EXPECT_NEAR(p, Mean(ratios), p / 1e-2);
 }
 
+TEST(GeometricDistributionTest, SampleBatchStats) {
+  for (double p : {0.5, 1e-6}) {
+    std::unique_ptr<GeometricDistribution> dist =
+        GeometricDistribution::Builder()
+            .SetLambda(-1.0 * std::log(1.0 - p))
+            .Build()
+            .value();
+    std::vector<int64_t> samples(kNumGeometricSamples);
+    dist->SampleBatch(absl::MakeSpan(samples));
+    for (int64_t& sample : samples) {
+      ++sample;
+    }
+    EXPECT_NEAR(1 / p, Mean(samples), 0.01 / p);
+    EXPECT_NEAR(std::sqrt(1 - p) / p, std::sqrt(Variance(samples)), 0.03 / p);
+  }
+}
+
+// The binary search of GeometricDistribution before the search parameters were
+// precomputed.
+int64_t ReferenceGeometricSample(double lambda, std::mt19937& rand_gen) {
+  auto uniform = [&rand_gen]() { return absl::Uniform(rand_gen, 0, 1.0); };
+  if (uniform() >
+      -1.0 * std::expm1(-1.0 * lambda * std::numeric_limits<int64_t>::max())) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  int64_t lo = 0;
+  int64_t hi = std::numeric_limits<int64_t>::max();
+  while (hi - lo > 1) {
+    int64_t mid =
+        lo - static_cast<int64_t>(std::floor(
+                 (std::log(0.5) + std::log1p(std::exp(lambda * (lo - hi)))) /
+                 lambda));
+    mid = std::min(std::max(mid, lo + 1), hi - 1);
+    double q = std::expm1(lambda * (lo - mid)) / std::expm1(lambda * (lo - hi));
+    if (uniform() <= q) {
+      hi = mid;
+    } else {
+      lo = mid;
+    }
+  }
+  return hi - 1;
+}
+
+TEST(GeometricDistributionTest, SampleMatchesReferenceSearch) {
+  for (double lambda : {1e-12, 1e-3, 0.7, 20.0}) {
+    std::mt19937 rand_gen(17);
+    std::mt19937 reference_rand_gen(17);
+    test_utils::SeededGeometricDistribution dist(lambda, &rand_gen);
+    for (int i = 0; i < 1000; ++i) {
+      ASSERT_EQ(dist.Sample(), ReferenceGeometricSample(lambda,
+                                                        reference_rand_gen));
+    }
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_EQ(dist.Sample(2.0), ReferenceGeometricSample(lambda / 2.0,
+                                                           reference_rand_gen));
+    }
+  }
+}
+
 // For Binomial/Poisson RVs this is mult standard deviations since var= mean.
 // Probability of failure with mult = 7 ~1e-23 if Gaussian approx holds, but it
 // does not for low values of x, so we have to  add another fudge factor.
@@ -508,6 +629,170 @@ TEST(GeometricDistribution, ImpossibleDoubles) {
   EXPECT_GT(count, 0);
 }
 
+TEST(RandomWordsTest, UniformCoversRange) {
+  RandomWords& random = ThreadRandomWords();
+  std::vector<int> counts(6, 0);
+  constexpr int kNumSamples = 60000;
+  for (int i = 0; i < kNumSamples; ++i) {
+    const uint64_t sample = random.Uniform(6);
+    ASSERT_LT(sample, 6);
+    ++counts[sample];
+  }
+  for (int count : counts) {
+    EXPECT_NEAR(count, kNumSamples / 6, 500);
+  }
+}
+
+TEST(RandomWordsTest, BernoulliHasExpectedMean) {
+  RandomWords& random = ThreadRandomWords();
+  constexpr int kNumSamples = 100000;
+  for (double p : {0.0, 0.1, 1.0 / 3, 0.75, 1.0}) {
+    int successes = 0;
+    for (int i = 0; i < kNumSamples; ++i) {
+      successes += random.Bernoulli(p);
+    }
+    EXPECT_NEAR(static_cast<double>(successes) / kNumSamples, p, 0.01);
+  }
+}
+
+TEST(RandomWordsTest, BernoulliExpHasExpectedMean) {
+  RandomWords& random = ThreadRandomWords();
+  constexpr int kNumSamples = 100000;
+  for (const auto& [numerator, denominator] :
+       std::vector<std::pair<uint64_t, uint64_t>>{{0, 1}, {1, 3}, {5, 2}}) {
+    int successes = 0;
+    for (int i = 0; i < kNumSamples; ++i) {
+      successes += random.BernoulliExp(numerator, denominator);
+    }
+    EXPECT_NEAR(static_cast<double>(successes) / kNumSamples,
+                std::exp(-static_cast<double>(numerator) / denominator), 0.01);
+  }
+}
+
+TEST(DiscreteLaplaceDistributionTest, SampleStatistics) {
+  std::unique_ptr<DiscreteLaplaceDistribution> distro =
+      DiscreteLaplaceDistribution::Builder()
+          .SetEpsilon(0.5)
+          .SetSensitivity(1)
+          .Build()
+          .value();
+  EXPECT_DOUBLE_EQ(distro->GetRate(), 0.5);
+  std::vector<int64_t> samples(100000);
+  distro->SampleBatch(absl::MakeSpan(samples));
+  double sum = 0;
+  double sum_of_squares = 0;
+  for (int64_t sample : samples) {
+    sum += sample;
+    sum_of_squares += static_cast<double>(sample) * sample;
+  }
+  EXPECT_NEAR(sum / samples.size(), 0, 0.1);
+  EXPECT_NEAR(sum_of_squares / samples.size(), distro->GetVariance(),
+              0.05 * distro->GetVariance());
+}
+
+TEST(DiscreteLaplaceDistributionTest, RoundsRateDown) {
+  std::unique_ptr<DiscreteLaplaceDistribution> distro =
+      DiscreteLaplaceDistribution::Builder()
+          .SetEpsilon(1)
+          .SetSensitivity(3)
+          .Build()
+          .value();
+  EXPECT_LE(distro->GetRate(), 1.0 / 3);
+  EXPECT_NEAR(distro->GetRate(), 1.0 / 3, 1e-7);
+}
+
+TEST(DiscreteLaplaceDistributionTest, CdfAndQuantile) {
+  const double rate = 0.3;
+  double probability_at_zero = std::tanh(rate / 2);
+  EXPECT_NEAR(DiscreteLaplaceDistribution::Cdf(rate, 0) -
+                  DiscreteLaplaceDistribution::Cdf(rate, -1),
+              probability_at_zero, 1e-12);
+  EXPECT_NEAR(DiscreteLaplaceDistribution::Cdf(rate, -1),
+              1 - DiscreteLaplaceDistribution::Cdf(rate, 0), 1e-12);
+  for (double p : {0.01, 0.3, 0.5, 0.7, 0.99}) {
+    const double x = DiscreteLaplaceDistribution::Quantile(rate, p);
+    EXPECT_EQ(x, std::round(x));
+    EXPECT_GE(DiscreteLaplaceDistribution::Cdf(rate, x), p - 1e-12);
+    EXPECT_LT(DiscreteLaplaceDistribution::Cdf(rate, x - 1), p);
+  }
+}
+
+TEST(DiscreteLaplaceDistributionTest, BuilderFailsForInvalidParameters) {
+  EXPECT_THAT(DiscreteLaplaceDistribution::Builder()
+                  .SetEpsilon(-1)
+                  .SetSensitivity(1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(DiscreteLaplaceDistribution::Builder()
+                  .SetEpsilon(1e-12)
+                  .SetSensitivity(1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("at least")));
+}
+
+TEST(DiscreteGaussianDistributionTest, SampleStatistics) {
+  for (double stddev : {0.5, 3.0, 1000.0}) {
+    std::unique_ptr<DiscreteGaussianDistribution> distro =
+        DiscreteGaussianDistribution::Builder()
+            .SetStddev(stddev)
+            .Build()
+            .value();
+    EXPECT_GE(distro->Stddev(), stddev);
+    EXPECT_NEAR(distro->Stddev(), stddev, 1e-5 * stddev);
+    std::vector<int64_t> samples(100000);
+    distro->SampleBatch(absl::MakeSpan(samples));
+    double sum = 0;
+    double sum_of_squares = 0;
+    for (int64_t sample : samples) {
+      sum += sample;
+      sum_of_squares += static_cast<double>(sample) * sample;
+    }
+    const double variance = sum_of_squares / samples.size();
+    EXPECT_NEAR(sum / samples.size(), 0, 0.02 * stddev);
+    if (stddev >= 1) {
+      EXPECT_NEAR(variance, stddev * stddev, 0.03 * stddev * stddev);
+    } else {
+      // The variance is far below stddev^2 for small stddev.
+      EXPECT_LT(variance, stddev * stddev);
+    }
+  }
+}
+
+TEST(DiscreteGaussianDistributionTest, SmallStddevMatchesCdf) {
+  const double stddev = 0.5;
+  std::unique_ptr<DiscreteGaussianDistribution> distro =
+      DiscreteGaussianDistribution::Builder().SetStddev(stddev).Build().value();
+  constexpr int kNumSamples = 100000;
+  int num_zeros = 0;
+  for (int i = 0; i < kNumSamples; ++i) {
+    num_zeros += distro->Sample() == 0;
+  }
+  EXPECT_NEAR(static_cast<double>(num_zeros) / kNumSamples,
+              DiscreteGaussianDistribution::Cdf(stddev, 0) -
+                  DiscreteGaussianDistribution::Cdf(stddev, -1),
+              0.01);
+}
+
+TEST(DiscreteGaussianDistributionTest, CdfAndQuantile) {
+  for (double stddev : {0.4, 5.0}) {
+    EXPECT_NEAR(DiscreteGaussianDistribution::Cdf(stddev, -1),
+                1 - DiscreteGaussianDistribution::Cdf(stddev, 0), 1e-9);
+    for (double p : {0.01, 0.3, 0.5, 0.7, 0.99}) {
+      const double x = DiscreteGaussianDistribution::Quantile(stddev, p);
+      EXPECT_GE(DiscreteGaussianDistribution::Cdf(stddev, x), p);
+      EXPECT_LT(DiscreteGaussianDistribution::Cdf(stddev, x - 1), p);
+    }
+  }
+}
+
+TEST(DiscreteGaussianDistributionTest, BuilderFailsForInvalidStddev) {
+  EXPECT_THAT(DiscreteGaussianDistribution::Builder().SetStddev(0).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(DiscreteGaussianDistribution::Builder().SetStddev(1e10).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 }  // namespace
 }  // namespace internal
 }  // namespace differential_privacy
@@ -0,0 +1,305 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_HISTOGRAM_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_HISTOGRAM_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/partition-selection.h"
+#include "algorithms/util.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Differentially private histogram, i.e., a count per bucket, for a single
+// aggregation over integer bucket ids instead of one Count and one partition
+// selection per bucket.
+//
+// Like for Count, contributions must already be bounded by the caller: every
+// privacy unit adds entries to at most max_partitions_contributed buckets and
+// at most max_contributions_per_partition entries per bucket.
+//
+// There are two kinds of bucket domains:
+//   - With SetNumBuckets(n), the buckets [0, n) are public, e.g., the ranges
+//     of a value. The counts are kept in a dense array, all n buckets are
+//     released, and the whole budget is spent on noise. Entries outside the
+//     domain are ignored.
+//   - Otherwise, bucket ids are arbitrary and may reveal data, e.g., hashes of
+//     keys of a huge domain. The counts of the buckets with entries are kept in
+//     a hash map, and buckets are released according to a
+//     PartitionSelectionStrategy. Half of epsilon and delta is spent on
+//     partition selection and half on noise. Selection is applied to
+//     ceil(count / max_contributions_per_partition), which a privacy unit
+//     changes by at most 1 like the number of privacy units.
+//
+// The selection decisions are made by the batched ShouldKeep and the counts of
+// all released buckets are noised with one batched AddNoise.
+//
+// Histogram is not thread safe.
+class Histogram {
+ public:
+  class Builder;
+
+  // The released buckets in increasing order and their noisy counts, as two
+  // columns of the same length.
+  struct Result {
+    std::vector<int64_t> buckets;
+    std::vector<int64_t> counts;
+  };
+
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  // Adds one entry to the bucket.
+  void AddEntry(int64_t bucket) {
+    if (num_buckets_.has_value()) {
+      if (bucket >= 0 && bucket < *num_buckets_) {
+        ++dense_counts_[bucket];
+      }
+    } else {
+      ++sparse_counts_[bucket];
+    }
+  }
+
+  // Adds one entry per element of buckets.
+  void AddEntries(absl::Span<const int64_t> buckets) {
+    for (int64_t bucket : buckets) {
+      AddEntry(bucket);
+    }
+  }
+
+  // Returns the released buckets with their noisy counts. Can only be called
+  // once until Reset; the budget is consumed by the first call.
+  absl::StatusOr<Result> PartialResult() {
+    if (result_returned_) {
+      return absl::InvalidArgumentError(
+          "The algorithm can only produce results once for a given epsilon, "
+          "delta budget.");
+    }
+    result_returned_ = true;
+
+    Result result;
+    if (num_buckets_.has_value()) {
+      result.buckets.resize(*num_buckets_);
+      for (int64_t i = 0; i < *num_buckets_; ++i) {
+        result.buckets[i] = i;
+      }
+      result.counts.resize(*num_buckets_);
+      RETURN_IF_ERROR(mechanism_->AddNoise(absl::MakeConstSpan(dense_counts_),
+                                           absl::MakeSpan(result.counts)));
+      return result;
+    }
+
+    std::vector<std::pair<int64_t, int64_t>> entries(sparse_counts_.begin(),
+                                                     sparse_counts_.end());
+    std::sort(entries.begin(), entries.end());
+    const int64_t c = max_contributions_per_partition_;
+    std::vector<int64_t> num_units(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+      num_units[i] = (entries[i].second + c - 1) / c;
+    }
+    std::vector<bool> keep;
+    partition_selection_->ShouldKeep(num_units, &keep);
+    std::vector<int64_t> exact_counts;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (keep[i]) {
+        result.buckets.push_back(entries[i].first);
+        exact_counts.push_back(entries[i].second);
+      }
+    }
+    result.counts.resize(exact_counts.size());
+    RETURN_IF_ERROR(mechanism_->AddNoise(absl::MakeConstSpan(exact_counts),
+                                         absl::MakeSpan(result.counts)));
+    return result;
+  }
+
+  // Returns the confidence interval of the noise of every released count.
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level) {
+    return mechanism_->NoiseConfidenceInterval(confidence_level);
+  }
+
+  // Discards all entries and allows a new result, which spends the budget
+  // again.
+  void Reset() {
+    std::fill(dense_counts_.begin(), dense_counts_.end(), 0);
+    sparse_counts_.clear();
+    result_returned_ = false;
+  }
+
+  int64_t MemoryUsed() const {
+    return sizeof(Histogram) + sizeof(int64_t) * dense_counts_.capacity() +
+           // https://abseil.io/docs/cpp/guides/container#memory-usage
+           (sizeof(std::pair<int64_t, int64_t>) + 1) *
+               sparse_counts_.bucket_count() +
+           mechanism_->MemoryUsed();
+  }
+
+  // Returns the number of buckets of a public domain, or nullopt if buckets
+  // are selected.
+  std::optional<int64_t> num_buckets() const { return num_buckets_; }
+
+  double GetEpsilon() const { return epsilon_; }
+  double GetDelta() const { return delta_; }
+
+ private:
+  Histogram(double epsilon, double delta, std::optional<int64_t> num_buckets,
+            int max_contributions_per_partition,
+            std::unique_ptr<NumericalMechanism> mechanism,
+            std::unique_ptr<PartitionSelectionStrategy> partition_selection)
+      : epsilon_(epsilon),
+        delta_(delta),
+        num_buckets_(num_buckets),
+        max_contributions_per_partition_(max_contributions_per_partition),
+        mechanism_(std::move(mechanism)),
+        partition_selection_(std::move(partition_selection)),
+        dense_counts_(num_buckets.value_or(0), 0) {}
+
+  const double epsilon_;
+  const double delta_;
+  const std::optional<int64_t> num_buckets_;
+  const int max_contributions_per_partition_;
+  std::unique_ptr<NumericalMechanism> mechanism_;
+  // Null for a public domain.
+  std::unique_ptr<PartitionSelectionStrategy> partition_selection_;
+
+  bool result_returned_ = false;
+  // Counts per bucket of a public domain.
+  std::vector<int64_t> dense_counts_;
+  // Counts of the buckets with entries if buckets are selected.
+  absl::flat_hash_map<int64_t, int64_t> sparse_counts_;
+};
+
+class Histogram::Builder {
+ public:
+  Builder& SetEpsilon(double epsilon) {
+    epsilon_ = epsilon;
+    return *this;
+  }
+
+  Builder& SetDelta(double delta) {
+    delta_ = delta;
+    return *this;
+  }
+
+  // Number of buckets of a public domain [0, num_buckets). Without it, buckets
+  // are selected with partition selection.
+  Builder& SetNumBuckets(int64_t num_buckets) {
+    num_buckets_ = num_buckets;
+    return *this;
+  }
+
+  // Maximum number of buckets a privacy unit adds entries to. Defaults to 1.
+  Builder& SetMaxPartitionsContributed(int max_partitions_contributed) {
+    max_partitions_contributed_ = max_partitions_contributed;
+    return *this;
+  }
+
+  // Maximum number of entries a privacy unit adds to a bucket. Defaults to 1.
+  Builder& SetMaxContributionsPerPartition(
+      int max_contributions_per_partition) {
+    max_contributions_per_partition_ = max_contributions_per_partition;
+    return *this;
+  }
+
+  // Mechanism used to add noise to the counts. Defaults to Laplace.
+  Builder& SetLaplaceMechanism(
+      std::unique_ptr<NumericalMechanismBuilder> mechanism_builder) {
+    mechanism_builder_ = std::move(mechanism_builder);
+    return *this;
+  }
+
+  // Strategy used to decide which buckets are released if there is no public
+  // domain. Epsilon, delta and max partitions contributed are set by this
+  // builder. Defaults to NearTruncatedGeometricPartitionSelection.
+  Builder& SetPartitionSelectionStrategy(
+      std::unique_ptr<PartitionSelectionStrategyBuilder>
+          partition_selection_builder) {
+    partition_selection_builder_ = std::move(partition_selection_builder);
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<Histogram>> Build() {
+    RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
+    RETURN_IF_ERROR(ValidateDelta(delta_));
+    RETURN_IF_ERROR(
+        ValidateMaxPartitionsContributed(max_partitions_contributed_));
+    RETURN_IF_ERROR(
+        ValidateMaxContributionsPerPartition(max_contributions_per_partition_));
+    if (num_buckets_.has_value() &&
+        (*num_buckets_ <= 0 || *num_buckets_ > kMaxNumBuckets)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Number of buckets must be in [1, ", kMaxNumBuckets, "], but is ",
+          *num_buckets_, "."));
+    }
+
+    double epsilon = epsilon_.value();
+    double delta = delta_;
+    std::unique_ptr<PartitionSelectionStrategy> partition_selection;
+    if (!num_buckets_.has_value()) {
+      epsilon /= 2;
+      delta /= 2;
+      ASSIGN_OR_RETURN(partition_selection,
+                       partition_selection_builder_->SetEpsilon(epsilon)
+                           .SetDelta(delta)
+                           .SetMaxPartitionsContributed(
+                               max_partitions_contributed_)
+                           .Build());
+    }
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mechanism,
+                     mechanism_builder_->SetEpsilon(epsilon)
+                         .SetDelta(delta)
+                         .SetL0Sensitivity(max_partitions_contributed_)
+                         .SetLInfSensitivity(max_contributions_per_partition_)
+                         .Build());
+    return absl::WrapUnique(new Histogram(
+        epsilon_.value(), delta_, num_buckets_,
+        max_contributions_per_partition_, std::move(mechanism),
+        std::move(partition_selection)));
+  }
+
+ private:
+  // Bounds the memory of the dense counts to 1 GiB.
+  static constexpr int64_t kMaxNumBuckets = int64_t{1} << 27;
+
+  std::optional<double> epsilon_;
+  double delta_ = 0;
+  std::optional<int64_t> num_buckets_;
+  int max_partitions_contributed_ = 1;
+  int max_contributions_per_partition_ = 1;
+  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
+      std::make_unique<LaplaceMechanism::Builder>();
+  std::unique_ptr<PartitionSelectionStrategyBuilder>
+      partition_selection_builder_ =
+          std::make_unique<NearTruncatedGeometricPartitionSelection::Builder>();
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_HISTOGRAM_H_
@@ -0,0 +1,196 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/histogram.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/partition-selection.h"
+#include "base/instrumentation.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::DoubleEq;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+
+// Keeps exactly the partitions with at least `min_users` privacy units and
+// records the epsilon it was built with.
+class ThresholdPartitionSelection : public PartitionSelectionStrategy {
+ public:
+  class Builder : public PartitionSelectionStrategyBuilder {
+   public:
+    explicit Builder(int min_users, double* epsilon = nullptr)
+        : min_users_(min_users), epsilon_(epsilon) {}
+
+    absl::StatusOr<std::unique_ptr<PartitionSelectionStrategy>> Build()
+        override {
+      if (epsilon_ != nullptr) {
+        *epsilon_ = GetEpsilon().value();
+      }
+      return absl::WrapUnique(new ThresholdPartitionSelection(
+          GetEpsilon().value(), GetDelta().value(),
+          GetMaxPartitionsContributed().value(), min_users_));
+    }
+
+   private:
+    int min_users_;
+    double* epsilon_;
+  };
+
+  bool ShouldKeep(double num_users) override {
+    return num_users >= GetPreThreshold();
+  }
+
+  double ProbabilityOfKeep(double num_users) const override {
+    return num_users >= GetPreThreshold() ? 1 : 0;
+  }
+
+ private:
+  ThresholdPartitionSelection(double epsilon, double delta,
+                              int64_t max_partitions_contributed,
+                              int min_users)
+      : PartitionSelectionStrategy(epsilon, delta, max_partitions_contributed,
+                                   /*adjusted_delta=*/0, min_users) {}
+};
+
+Histogram::Builder ZeroNoiseBuilder() {
+  Histogram::Builder builder;
+  builder.SetEpsilon(1).SetLaplaceMechanism(
+      std::make_unique<ZeroNoiseMechanism::Builder>());
+  return builder;
+}
+
+TEST(HistogramTest, ReleasesAllBucketsOfPublicDomain) {
+  std::unique_ptr<Histogram> histogram =
+      ZeroNoiseBuilder().SetNumBuckets(4).Build().value();
+  histogram->AddEntries({0, 2, 2, 3, 3, 3});
+  // Outside of the domain.
+  histogram->AddEntry(-1);
+  histogram->AddEntry(4);
+
+  absl::StatusOr<Histogram::Result> result = histogram->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(result->buckets, ElementsAre(0, 1, 2, 3));
+  EXPECT_THAT(result->counts, ElementsAre(1, 0, 2, 3));
+}
+
+TEST(HistogramTest, SelectsBucketsOfPrivateDomain) {
+  double selection_epsilon = 0;
+  std::unique_ptr<Histogram> histogram =
+      ZeroNoiseBuilder()
+          .SetDelta(1e-5)
+          .SetPartitionSelectionStrategy(
+              std::make_unique<ThresholdPartitionSelection::Builder>(
+                  3, &selection_epsilon))
+          .Build()
+          .value();
+  histogram->AddEntries({int64_t{1} << 40, 7, 7, 7, -5, -5, -5, -5, 9, 9});
+
+  absl::StatusOr<Histogram::Result> result = histogram->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(result->buckets, ElementsAre(-5, 7));
+  EXPECT_THAT(result->counts, ElementsAre(4, 3));
+  EXPECT_THAT(selection_epsilon, DoubleEq(0.5));
+  EXPECT_EQ(histogram->num_buckets(), std::nullopt);
+}
+
+TEST(HistogramTest, SelectsOnBoundOfPrivacyUnits) {
+  std::unique_ptr<Histogram> histogram =
+      ZeroNoiseBuilder()
+          .SetDelta(1e-5)
+          .SetMaxContributionsPerPartition(3)
+          .SetPartitionSelectionStrategy(
+              std::make_unique<ThresholdPartitionSelection::Builder>(2))
+          .Build()
+          .value();
+  // 3 entries can come from a single privacy unit, 4 need at least 2.
+  histogram->AddEntries({1, 1, 1, 2, 2, 2, 2});
+
+  absl::StatusOr<Histogram::Result> result = histogram->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(result->buckets, ElementsAre(2));
+  EXPECT_THAT(result->counts, ElementsAre(4));
+}
+
+TEST(HistogramTest, NoisesCountsInOneBatch) {
+  std::unique_ptr<Histogram> histogram =
+      ZeroNoiseBuilder().SetNumBuckets(100).Build().value();
+  instrumentation::AggregatingSink sink;
+  instrumentation::SetSink(&sink);
+  absl::StatusOr<Histogram::Result> result = histogram->PartialResult();
+  instrumentation::SetSink(nullptr);
+
+  ASSERT_OK(result);
+  EXPECT_EQ(sink.Get(instrumentation::Event::kMechanismAddNoise).calls, 1);
+  EXPECT_EQ(sink.Get(instrumentation::Event::kMechanismAddNoise).count, 100);
+}
+
+TEST(HistogramTest, ProducesResultOnceUntilReset) {
+  std::unique_ptr<Histogram> histogram =
+      ZeroNoiseBuilder()
+          .SetDelta(1e-5)
+          .SetPartitionSelectionStrategy(
+              std::make_unique<ThresholdPartitionSelection::Builder>(1))
+          .Build()
+          .value();
+  histogram->AddEntry(3);
+  EXPECT_OK(histogram->PartialResult());
+  EXPECT_THAT(histogram->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("only produce results once")));
+
+  histogram->Reset();
+  absl::StatusOr<Histogram::Result> result = histogram->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_THAT(result->buckets, IsEmpty());
+}
+
+TEST(HistogramTest, ValidatesParameters) {
+  EXPECT_THAT(Histogram::Builder().SetNumBuckets(10).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Epsilon")));
+  EXPECT_THAT(Histogram::Builder().SetEpsilon(1).SetNumBuckets(0).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Number of buckets")));
+  EXPECT_THAT(Histogram::Builder()
+                  .SetEpsilon(1)
+                  .SetNumBuckets(10)
+                  .SetMaxPartitionsContributed(0)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(Histogram::Builder().SetEpsilon(1).SetDelta(-1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Delta")));
+  EXPECT_OK(Histogram::Builder().SetEpsilon(1).SetDelta(1e-5).Build());
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,35 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/insecure-rand.h"
+
+#include <cstdint>
+
+namespace differential_privacy {
+
+InsecureURBG::InsecureURBG(uint64_t seed) {
+  // Expand the seed with SplitMix64, as recommended for xoshiro. The state is
+  // never all zero.
+  for (uint64_t& word : state_) {
+    seed += uint64_t{0x9e3779b97f4a7c15};
+    uint64_t z = seed;
+    z = (z ^ (z >> 30)) * uint64_t{0xbf58476d1ce4e5b9};
+    z = (z ^ (z >> 27)) * uint64_t{0x94d049bb133111eb};
+    word = z ^ (z >> 31);
+  }
+}
+
+}  // namespace differential_privacy
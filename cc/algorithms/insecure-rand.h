@@ -0,0 +1,118 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_INSECURE_RAND_H_
+#define DIFFERENTIAL_PRIVACY_ALGORITHMS_INSECURE_RAND_H_
+
+// Seeded, non-cryptographic randomness for simulations and benchmarks. This
+// library is testonly, so that production binaries cannot replace the noise of
+// the algorithms with predictable noise.
+
+#include <cstdint>
+#include <limits>
+
+#include "absl/types/span.h"
+#include "algorithms/rand.h"
+
+namespace differential_privacy {
+
+// Non-cryptographic uniform random bit generator (xoshiro256**) with an
+// explicit seed, for simulations and benchmarks that run the algorithms many
+// times, e.g., to tune their parameters.
+//
+// INSECURE: the output is predictable from the seed. Noise drawn from this
+// generator does NOT make results differentially private. Never use it for
+// results that are released.
+class InsecureURBG {
+ public:
+  using result_type = uint64_t;
+
+  explicit InsecureURBG(uint64_t seed);
+
+  static constexpr result_type(min)() {
+    return (std::numeric_limits<result_type>::min)();
+  }
+  static constexpr result_type(max)() {
+    return (std::numeric_limits<result_type>::max)();
+  }
+
+  result_type operator()() {
+    const uint64_t result = RotateLeft(state_[1] * 5, 7) * 9;
+    const uint64_t t = state_[1] << 17;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = RotateLeft(state_[3], 45);
+    return result;
+  }
+
+  void Fill(absl::Span<result_type> out) {
+    for (result_type& word : out) {
+      word = (*this)();
+    }
+  }
+
+ private:
+  static uint64_t RotateLeft(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t state_[4];
+};
+
+// RandomSource backed by an InsecureURBG.
+//
+// INSECURE: for simulations and benchmarks only, see InsecureURBG.
+class InsecureRandomSource : public RandomSource {
+ public:
+  explicit InsecureRandomSource(uint64_t seed) : urbg_(seed) {}
+
+  uint64_t Next() override { return urbg_(); }
+
+  void Fill(absl::Span<uint64_t> out) override { urbg_.Fill(out); }
+
+ private:
+  InsecureURBG urbg_;
+};
+
+// While an instance is alive, every draw from SecureURBG on the calling thread
+// comes from an InsecureURBG with the given seed instead of OpenSSL. This
+// applies to UniformDouble(), FillUniformDoubles(), Geometric() and all the
+// distributions, mechanisms and algorithms that use them, without changing how
+// they are built. Instances may be nested; the destructor restores the
+// previous source of the thread. Other threads are not affected.
+//
+// INSECURE: for simulations and benchmarks only, see InsecureURBG.
+class ScopedInsecureRandomnessForSimulation {
+ public:
+  explicit ScopedInsecureRandomnessForSimulation(uint64_t seed)
+      : source_(seed), scope_(&source_) {}
+
+  ScopedInsecureRandomnessForSimulation(
+      const ScopedInsecureRandomnessForSimulation&) = delete;
+  ScopedInsecureRandomnessForSimulation& operator=(
+      const ScopedInsecureRandomnessForSimulation&) = delete;
+
+ private:
+  InsecureRandomSource source_;
+  ScopedRandomSource scope_;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_INSECURE_RAND_H_
@@ -0,0 +1,141 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/binary-summary.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+// "DPBS" when read as bytes on a little-endian machine.
+constexpr uint32_t kMagic = 0x53425044;
+constexpr uint8_t kVersion = 1;
+
+struct Header {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint8_t value_size;
+  uint8_t value_kind;
+};
+static_assert(sizeof(Header) == 8, "Binary summary header must be 8 bytes");
+
+Header MakeHeader(BinarySummaryType type, size_t value_size,
+                  bool value_is_integral) {
+  return Header{kMagic, kVersion, static_cast<uint8_t>(type),
+                static_cast<uint8_t>(value_size),
+                static_cast<uint8_t>(value_is_integral ? 0 : 1)};
+}
+
+}  // namespace
+
+BinarySummaryWriter::BinarySummaryWriter(BinarySummaryType type,
+                                         size_t value_size,
+                                         bool value_is_integral) {
+  const Header header = MakeHeader(type, value_size, value_is_integral);
+  buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void BinarySummaryWriter::AppendSection(const char* data, size_t count,
+                                        size_t element_size) {
+  CHECK_LE(count, std::numeric_limits<uint32_t>::max());
+  const uint32_t count32 = static_cast<uint32_t>(count);
+  buffer_.append(reinterpret_cast<const char*>(&count32), sizeof(count32));
+  buffer_.append(data, count * element_size);
+}
+
+absl::StatusOr<BinarySummaryReader> BinarySummaryReader::Create(
+    absl::string_view data, BinarySummaryType type, size_t value_size,
+    bool value_is_integral) {
+  if (data.size() < sizeof(Header)) {
+    return absl::InternalError(
+        "Binary summary is too short to contain a header.");
+  }
+  Header header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != kMagic) {
+    return absl::InternalError("Data is not a binary summary.");
+  }
+  if (header.version != kVersion) {
+    return absl::InternalError(absl::StrCat(
+        "Unsupported binary summary version ", header.version, "."));
+  }
+  const Header expected = MakeHeader(type, value_size, value_is_integral);
+  if (header.type != expected.type) {
+    return absl::InternalError(absl::StrCat(
+        "Binary summary was written by a different algorithm (type ",
+        header.type, " instead of ", expected.type, ")."));
+  }
+  if (header.value_size != expected.value_size ||
+      header.value_kind != expected.value_kind) {
+    return absl::InternalError(
+        "Binary summary was written for a different input type.");
+  }
+  data.remove_prefix(sizeof(Header));
+  return BinarySummaryReader(data);
+}
+
+absl::StatusOr<absl::string_view> BinarySummaryReader::ReadBytes() {
+  return ReadSection(1);
+}
+
+absl::Status BinarySummaryReader::Finish() const {
+  if (!remaining_.empty()) {
+    return absl::InternalError(absl::StrCat(
+        "Binary summary has ", remaining_.size(), " unexpected trailing bytes."));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<absl::string_view> BinarySummaryReader::ReadSection(
+    size_t element_size) {
+  uint32_t count;
+  if (remaining_.size() < sizeof(count)) {
+    return absl::InternalError("Binary summary is truncated.");
+  }
+  std::memcpy(&count, remaining_.data(), sizeof(count));
+  remaining_.remove_prefix(sizeof(count));
+  const size_t num_bytes = static_cast<size_t>(count) * element_size;
+  if (remaining_.size() < num_bytes) {
+    return absl::InternalError("Binary summary is truncated.");
+  }
+  absl::string_view section = remaining_.substr(0, num_bytes);
+  remaining_.remove_prefix(num_bytes);
+  return section;
+}
+
+absl::Status BinarySummaryReader::SizeMismatchError(size_t actual,
+                                                    size_t expected) {
+  return absl::InternalError(
+      absl::StrCat("Merged binary summary must have the same number of values "
+                   "as this algorithm, but got ",
+                   actual, " instead of ", expected, "."));
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
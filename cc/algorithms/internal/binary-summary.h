@@ -0,0 +1,173 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_BINARY_SUMMARY_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_BINARY_SUMMARY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// Compact, fixed-layout binary encoding of the partial state of an algorithm.
+// It is an alternative to the protobuf Summary for merge-heavy pipelines: a
+// binary summary is a small header followed by length-prefixed flat arrays of
+// raw values, so merging it only requires bounds checks and memcpy instead of
+// parsing an Any-packed proto with one ValueType per value.
+//
+// Layout (all fields in host byte order):
+//   uint32 magic | uint8 version | uint8 type | uint8 value size | uint8 kind
+//   followed by any number of sections, each
+//   uint32 element count | count * element size raw bytes.
+//
+// The encoding is meant for exchanging summaries between processes of the
+// same pipeline, which run on the same architecture. Summaries written on a
+// machine with a different byte order are rejected because the magic does not
+// match.
+
+// Identifies the algorithm that wrote a binary summary.
+enum class BinarySummaryType : uint8_t {
+  kApproxBounds = 1,
+  kBoundedSumWithFixedBounds = 2,
+  kBoundedSumWithApproxBounds = 3,
+  kKeyedAggregatorRun = 4,
+  kKeyedAggregatorCheckpoint = 5,
+  kBoundedSumWithFixedPoint = 6,
+};
+
+// Read-only view over a section of raw values inside a binary summary. The
+// view does not own the data, which might not be aligned for V, so elements
+// are copied out on access.
+template <typename V>
+class BinarySummaryArray {
+ public:
+  BinarySummaryArray(const char* data, size_t size)
+      : data_(data), size_(size) {}
+
+  size_t size() const { return size_; }
+
+  V operator[](size_t i) const {
+    V value;
+    std::memcpy(&value, data_ + i * sizeof(V), sizeof(V));
+    return value;
+  }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+// Builds a binary summary section by section.
+class BinarySummaryWriter {
+ public:
+  // `value_size` and `value_is_integral` describe the input type T of the
+  // algorithm so that summaries of algorithms with different T are not mixed.
+  BinarySummaryWriter(BinarySummaryType type, size_t value_size,
+                      bool value_is_integral);
+
+  template <typename V>
+  void AppendArray(absl::Span<const V> values) {
+    static_assert(std::is_trivially_copyable<V>::value,
+                  "Binary summaries can only contain trivially copyable "
+                  "values");
+    AppendSection(reinterpret_cast<const char*>(values.data()), values.size(),
+                  sizeof(V));
+  }
+
+  // Appends a nested binary summary as a section of bytes.
+  void AppendBytes(absl::string_view bytes) {
+    AppendSection(bytes.data(), bytes.size(), 1);
+  }
+
+  // Returns the encoded summary. The writer must not be used afterwards.
+  std::string Finish() && { return std::move(buffer_); }
+
+ private:
+  void AppendSection(const char* data, size_t count, size_t element_size);
+
+  std::string buffer_;
+};
+
+// Reads the sections of a binary summary in the order they were written. The
+// reader does not copy the summary; `data` must outlive the reader and all
+// arrays returned from it.
+class BinarySummaryReader {
+ public:
+  // Validates the header of `data` against the expected type and value type.
+  static absl::StatusOr<BinarySummaryReader> Create(absl::string_view data,
+                                                    BinarySummaryType type,
+                                                    size_t value_size,
+                                                    bool value_is_integral);
+
+  // Returns the next section, which must contain exactly `expected_size`
+  // elements of V.
+  template <typename V>
+  absl::StatusOr<BinarySummaryArray<V>> ReadArray(size_t expected_size) {
+    absl::StatusOr<absl::string_view> section = ReadSection(sizeof(V));
+    if (!section.ok()) {
+      return section.status();
+    }
+    if (section->size() != expected_size * sizeof(V)) {
+      return SizeMismatchError(section->size() / sizeof(V), expected_size);
+    }
+    return BinarySummaryArray<V>(section->data(), expected_size);
+  }
+
+  // Returns the next section as a nested binary summary.
+  absl::StatusOr<absl::string_view> ReadBytes();
+
+  // Returns an error if there is unread data left in the summary.
+  absl::Status Finish() const;
+
+ private:
+  explicit BinarySummaryReader(absl::string_view remaining)
+      : remaining_(remaining) {}
+
+  // Returns the raw bytes of the next section of elements of `element_size`.
+  absl::StatusOr<absl::string_view> ReadSection(size_t element_size);
+
+  static absl::Status SizeMismatchError(size_t actual, size_t expected);
+
+  absl::string_view remaining_;
+};
+
+// Convenience overloads deriving the value type description from T.
+template <typename T>
+BinarySummaryWriter MakeBinarySummaryWriter(BinarySummaryType type) {
+  return BinarySummaryWriter(type, sizeof(T), std::is_integral<T>::value);
+}
+
+template <typename T>
+absl::StatusOr<BinarySummaryReader> MakeBinarySummaryReader(
+    absl::string_view data, BinarySummaryType type) {
+  return BinarySummaryReader::Create(data, type, sizeof(T),
+                                     std::is_integral<T>::value);
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_BINARY_SUMMARY_H_
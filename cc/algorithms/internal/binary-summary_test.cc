@@ -0,0 +1,140 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/binary-summary.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using ::differential_privacy::base::testing::IsOkAndHolds;
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::HasSubstr;
+
+constexpr BinarySummaryType kType = BinarySummaryType::kApproxBounds;
+
+TEST(BinarySummaryTest, RoundTripsSections) {
+  const std::vector<double> doubles = {1.5, -2.25, 1e300};
+  const std::vector<int64_t> ints = {7, -9};
+  BinarySummaryWriter writer = MakeBinarySummaryWriter<double>(kType);
+  writer.AppendArray<double>(doubles);
+  writer.AppendArray<int64_t>(ints);
+  writer.AppendBytes("nested");
+  const std::string summary = std::move(writer).Finish();
+
+  absl::StatusOr<BinarySummaryReader> reader =
+      MakeBinarySummaryReader<double>(summary, kType);
+  ASSERT_OK(reader);
+  absl::StatusOr<BinarySummaryArray<double>> read_doubles =
+      reader->ReadArray<double>(doubles.size());
+  ASSERT_OK(read_doubles);
+  for (int i = 0; i < doubles.size(); ++i) {
+    EXPECT_EQ((*read_doubles)[i], doubles[i]);
+  }
+  absl::StatusOr<BinarySummaryArray<int64_t>> read_ints =
+      reader->ReadArray<int64_t>(ints.size());
+  ASSERT_OK(read_ints);
+  EXPECT_EQ((*read_ints)[0], 7);
+  EXPECT_EQ((*read_ints)[1], -9);
+  EXPECT_THAT(reader->ReadBytes(), IsOkAndHolds("nested"));
+  EXPECT_OK(reader->Finish());
+}
+
+TEST(BinarySummaryTest, EmptyArrayRoundTrips) {
+  BinarySummaryWriter writer = MakeBinarySummaryWriter<int64_t>(kType);
+  writer.AppendArray<int64_t>({});
+  const std::string summary = std::move(writer).Finish();
+
+  absl::StatusOr<BinarySummaryReader> reader =
+      MakeBinarySummaryReader<int64_t>(summary, kType);
+  ASSERT_OK(reader);
+  absl::StatusOr<BinarySummaryArray<int64_t>> values =
+      reader->ReadArray<int64_t>(0);
+  ASSERT_OK(values);
+  EXPECT_EQ(values->size(), 0);
+  EXPECT_OK(reader->Finish());
+}
+
+TEST(BinarySummaryTest, RejectsInvalidHeaders) {
+  const std::string summary =
+      MakeBinarySummaryWriter<int64_t>(kType).Finish();
+
+  EXPECT_THAT(MakeBinarySummaryReader<int64_t>("", kType).status(),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("too short")));
+  EXPECT_THAT(MakeBinarySummaryReader<int64_t>("12345678", kType).status(),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("not a binary summary")));
+  EXPECT_THAT(MakeBinarySummaryReader<int64_t>(
+                  summary, BinarySummaryType::kBoundedSumWithFixedBounds)
+                  .status(),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("different algorithm")));
+  EXPECT_THAT(MakeBinarySummaryReader<double>(summary, kType).status(),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("different input type")));
+  EXPECT_THAT(MakeBinarySummaryReader<int32_t>(summary, kType).status(),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("different input type")));
+
+  std::string wrong_version = summary;
+  wrong_version[4] = 2;
+  EXPECT_THAT(MakeBinarySummaryReader<int64_t>(wrong_version, kType).status(),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("Unsupported binary summary version")));
+}
+
+TEST(BinarySummaryTest, RejectsMalformedSections) {
+  BinarySummaryWriter writer = MakeBinarySummaryWriter<int64_t>(kType);
+  writer.AppendArray<int64_t>({1, 2, 3});
+  const std::string summary = std::move(writer).Finish();
+
+  absl::StatusOr<BinarySummaryReader> reader =
+      MakeBinarySummaryReader<int64_t>(summary, kType);
+  ASSERT_OK(reader);
+  EXPECT_THAT(reader->ReadArray<int64_t>(2).status(),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("same number of values")));
+
+  const std::string truncated = summary.substr(0, summary.size() - 1);
+  reader = MakeBinarySummaryReader<int64_t>(truncated, kType);
+  ASSERT_OK(reader);
+  EXPECT_THAT(reader->ReadArray<int64_t>(3).status(),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("truncated")));
+
+  const std::string trailing = summary + "x";
+  reader = MakeBinarySummaryReader<int64_t>(trailing, kType);
+  ASSERT_OK(reader);
+  ASSERT_OK(reader->ReadArray<int64_t>(3));
+  EXPECT_THAT(reader->Finish(),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("trailing")));
+  EXPECT_THAT(reader->ReadBytes().status(),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("truncated")));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <vector>
 
 #include "algorithms/numerical-mechanisms.h"
 #include "algorithms/util.h"
@@ -30,19 +31,24 @@ namespace {
 
 constexpr int kNumStepsOptMeanConfidenceInterval = 1000;
 
-// Given a valid split of the confidence levels, this function returns a
-// confidence interval for the mean aggregation.
-NumericalMechanism::NoiseConfidenceIntervalResult
-NoiseConfidenceIntervalForFixedNumAndDenom(
-    const BoundedMeanConfidenceIntervalParams &params, double num_conf_level,
-    double denom_conf_level) {
-  const NumericalMechanism::NoiseConfidenceIntervalResult sum_ci =
-      params.sum_mechanism->UncheckedNoiseConfidenceInterval(num_conf_level,
-                                                             params.noised_sum);
-  NumericalMechanism::NoiseConfidenceIntervalResult count_ci =
-      params.count_mechanism->UncheckedNoiseConfidenceInterval(
-          denom_conf_level, params.noised_count);
+// Returns the confidence level of the numerator for the i-th step of the
+// brute force search.  The confidence level of the denominator is then
+// confidence_level / num_conf_level.
+double NumConfLevel(double confidence_level, int i) {
+  // num_conf_level has to be between confidence_level and 1.  We are dividing
+  // this interval into kNumStepsOptMeanConfidenceInterval steps for the brute
+  // force search.
+  return confidence_level + (i / (double)kNumStepsOptMeanConfidenceInterval) *
+                                (1.0 - confidence_level);
+}
 
+// Given the confidence intervals of the numerator and denominator, this
+// function returns a confidence interval for the mean aggregation.
+NumericalMechanism::NoiseConfidenceIntervalResult
+NoiseConfidenceIntervalForNumAndDenomIntervals(
+    NumericalMechanism::NoiseConfidenceIntervalResult sum_ci,
+    NumericalMechanism::NoiseConfidenceIntervalResult count_ci,
+    double lower_bound, double upper_bound) {
   // Lower and upper CI for count must be at least 1.
   count_ci.lower = std::max<double>(1, count_ci.lower);
   count_ci.upper = std::max<double>(1, count_ci.upper);
@@ -62,12 +68,48 @@ NoiseConfidenceIntervalForFixedNumAndDenom(
   }
 
   NumericalMechanism::NoiseConfidenceIntervalResult result;
-  const double midpoint =
-      params.lower_bound + ((params.upper_bound - params.lower_bound) / 2.0);
-  result.lower = Clamp<double>(params.lower_bound, params.upper_bound,
-                               midpoint + mean_lower);
-  result.upper = Clamp<double>(params.lower_bound, params.upper_bound,
-                               midpoint + mean_upper);
+  const double midpoint = lower_bound + ((upper_bound - lower_bound) / 2.0);
+  result.lower =
+      Clamp<double>(lower_bound, upper_bound, midpoint + mean_lower);
+  result.upper =
+      Clamp<double>(lower_bound, upper_bound, midpoint + mean_upper);
+  return result;
+}
+
+// Given a valid split of the confidence levels, this function returns a
+// confidence interval for the mean aggregation.
+NumericalMechanism::NoiseConfidenceIntervalResult
+NoiseConfidenceIntervalForFixedNumAndDenom(
+    const BoundedMeanConfidenceIntervalParams &params, double num_conf_level,
+    double denom_conf_level) {
+  return NoiseConfidenceIntervalForNumAndDenomIntervals(
+      params.sum_mechanism->UncheckedNoiseConfidenceInterval(num_conf_level,
+                                                             params.noised_sum),
+      params.count_mechanism->UncheckedNoiseConfidenceInterval(
+          denom_conf_level, params.noised_count),
+      params.lower_bound, params.upper_bound);
+}
+
+// Returns the tightest of the confidence intervals, where ci(i) returns the
+// confidence interval for the i-th split of the confidence level.
+template <typename IntervalForSplit>
+ConfidenceInterval TightestConfidenceInterval(double confidence_level,
+                                              IntervalForSplit ci) {
+  NumericalMechanism::NoiseConfidenceIntervalResult tightest_ci;
+  double tightest_ci_size = std::numeric_limits<double>::max();
+  for (int i = 1; i < kNumStepsOptMeanConfidenceInterval; ++i) {
+    const NumericalMechanism::NoiseConfidenceIntervalResult split_ci = ci(i);
+    const double ci_size = split_ci.upper - split_ci.lower;
+    if (ci_size < tightest_ci_size) {
+      tightest_ci = split_ci;
+      tightest_ci_size = ci_size;
+    }
+  }
+
+  ConfidenceInterval result;
+  result.set_lower_bound(tightest_ci.lower);
+  result.set_upper_bound(tightest_ci.upper);
+  result.set_confidence_level(confidence_level);
   return result;
 }
 
@@ -112,36 +154,59 @@ ConfidenceInterval BoundedMeanConfidenceInterval(
       !std::isfinite(params.noised_count)) {
     return ConfidenceInterval();
   }
-  NumericalMechanism::NoiseConfidenceIntervalResult tightest_ci;
-  double tightest_ci_size = std::numeric_limits<double>::max();
-  for (int i = 1; i < kNumStepsOptMeanConfidenceInterval; ++i) {
-    // Setting the confidence level of the numerator and denominator such that
-    // overall_conf_level = num_conf_level * denom_conf_level
-    // and all confidence levels are between 0 and 1.
-    //
-    // num_conf_level has to be between confidence_level and 1.  We are
-    // dividing this interval into kNumStepsOptMeanConfidenceInterval steps
-    // for the brute force search.
-    const double num_conf_level =
-        params.confidence_level +
-        (i / (double)kNumStepsOptMeanConfidenceInterval) *
-            (1.0 - params.confidence_level);
+  // Setting the confidence level of the numerator and denominator such that
+  // overall_conf_level = num_conf_level * denom_conf_level
+  // and all confidence levels are between 0 and 1.
+  return TightestConfidenceInterval(params.confidence_level, [&params](int i) {
+    const double num_conf_level = NumConfLevel(params.confidence_level, i);
     const double denom_conf_level = params.confidence_level / num_conf_level;
-    const NumericalMechanism::NoiseConfidenceIntervalResult ci =
-        NoiseConfidenceIntervalForFixedNumAndDenom(params, num_conf_level,
-                                                   denom_conf_level);
-    const double ci_size = ci.upper - ci.lower;
-    if (ci_size < tightest_ci_size) {
-      tightest_ci = ci;
-      tightest_ci_size = ci_size;
-    }
+    return NoiseConfidenceIntervalForFixedNumAndDenom(params, num_conf_level,
+                                                      denom_conf_level);
+  });
+}
+
+BoundedMeanConfidenceIntervalContext::BoundedMeanConfidenceIntervalContext(
+    double confidence_level, double lower_bound, double upper_bound,
+    const NumericalMechanism &sum_mechanism,
+    const NumericalMechanism &count_mechanism)
+    : confidence_level_(confidence_level),
+      lower_bound_(lower_bound),
+      upper_bound_(upper_bound) {
+  if (!std::isfinite(confidence_level) || !std::isfinite(lower_bound) ||
+      !std::isfinite(upper_bound)) {
+    return;
   }
+  splits_.reserve(kNumStepsOptMeanConfidenceInterval - 1);
+  for (int i = 1; i < kNumStepsOptMeanConfidenceInterval; ++i) {
+    const double num_conf_level = NumConfLevel(confidence_level, i);
+    const double denom_conf_level = confidence_level / num_conf_level;
+    splits_.push_back(
+        {sum_mechanism.UncheckedNoiseConfidenceInterval(num_conf_level, 0),
+         count_mechanism.UncheckedNoiseConfidenceInterval(denom_conf_level,
+                                                          0)});
+  }
+}
 
-  ConfidenceInterval ci;
-  ci.set_lower_bound(tightest_ci.lower);
-  ci.set_upper_bound(tightest_ci.upper);
-  ci.set_confidence_level(params.confidence_level);
-  return ci;
+ConfidenceInterval BoundedMeanConfidenceIntervalContext::Compute(
+    double noised_sum, double noised_count) const {
+  if (splits_.empty() || !std::isfinite(noised_sum) ||
+      !std::isfinite(noised_count)) {
+    return ConfidenceInterval();
+  }
+  // Shifting the intervals for a noised result of 0 gives the same bounds as
+  // computing the intervals for the noised results, since the mechanisms
+  // compute them as the noised result plus the same offsets.
+  return TightestConfidenceInterval(confidence_level_, [&](int i) {
+    const SplitIntervals &split = splits_[i - 1];
+    NumericalMechanism::NoiseConfidenceIntervalResult sum_ci;
+    sum_ci.lower = noised_sum + split.sum.lower;
+    sum_ci.upper = noised_sum + split.sum.upper;
+    NumericalMechanism::NoiseConfidenceIntervalResult count_ci;
+    count_ci.lower = noised_count + split.count.lower;
+    count_ci.upper = noised_count + split.count.upper;
+    return NoiseConfidenceIntervalForNumAndDenomIntervals(
+        sum_ci, count_ci, lower_bound_, upper_bound_);
+  });
 }
 
 }  // namespace internal
@@ -17,6 +17,8 @@
 #ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_BOUNDED_MEAN_CI_H_
 #define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_BOUNDED_MEAN_CI_H_
 
+#include <vector>
+
 #include "algorithms/numerical-mechanisms.h"
 #include "proto/confidence-interval.pb.h"
 
@@ -47,6 +49,40 @@ struct BoundedMeanConfidenceIntervalParams {
 ConfidenceInterval BoundedMeanConfidenceInterval(
     const BoundedMeanConfidenceIntervalParams& params);
 
+// Computes the same confidence intervals as BoundedMeanConfidenceInterval for
+// many noised sums and counts, e.g., of the partitions of a release, at a
+// fixed confidence level and with fixed bounds and mechanisms.  The noise
+// confidence intervals of both mechanisms are computed once per split of the
+// confidence level on construction, so that Compute only does arithmetic.
+// This assumes that the noise confidence intervals are centered on the noised
+// result, as they are for all mechanisms of the library.
+class BoundedMeanConfidenceIntervalContext {
+ public:
+  // The mechanisms are only used during construction.  In case the
+  // confidence_level is not between 0 and 1, the behavior is undefined.
+  BoundedMeanConfidenceIntervalContext(
+      double confidence_level, double lower_bound, double upper_bound,
+      const NumericalMechanism& sum_mechanism,
+      const NumericalMechanism& count_mechanism);
+
+  ConfidenceInterval Compute(double noised_sum, double noised_count) const;
+
+  double confidence_level() const { return confidence_level_; }
+
+ private:
+  // Noise confidence intervals of the sum and count for a noised result of 0.
+  struct SplitIntervals {
+    NumericalMechanism::NoiseConfidenceIntervalResult sum;
+    NumericalMechanism::NoiseConfidenceIntervalResult count;
+  };
+
+  double confidence_level_;
+  double lower_bound_;
+  double upper_bound_;
+  // Empty if one of the parameters is not finite.
+  std::vector<SplitIntervals> splits_;
+};
+
 }  // namespace internal
 }  // namespace differential_privacy
 
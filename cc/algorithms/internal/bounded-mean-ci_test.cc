@@ -20,6 +20,7 @@
 #include <limits>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "base/testing/proto_matchers.h"
 #include "base/testing/status_matchers.h"
@@ -263,6 +264,57 @@ TEST(BoundedMeanCiTest, InfiniteNoisedParamsReturnsDefaultCi) {
   EXPECT_THAT(BoundedMeanConfidenceInterval(params), EqualsProto(""));
 }
 
+TEST(BoundedMeanCiTest, ContextMatchesBoundedMeanConfidenceInterval) {
+  BoundedMeanConfidenceIntervalParams params;
+  params.confidence_level = 0.95;
+  params.lower_bound = -10.0;
+  params.upper_bound = 30.0;
+  std::unique_ptr<NumericalMechanism> sum_mechanism =
+      LaplaceSumForParams(params);
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> count_mechanism =
+      GaussianMechanism::Builder()
+          .SetEpsilon(kDefaultEpsilon / 2.0)
+          .SetDelta(1e-5)
+          .SetL0Sensitivity(1)
+          .SetLInfSensitivity(1)
+          .Build();
+  ASSERT_OK(count_mechanism);
+  params.sum_mechanism = sum_mechanism.get();
+  params.count_mechanism = count_mechanism->get();
+
+  const BoundedMeanConfidenceIntervalContext context(
+      params.confidence_level, params.lower_bound, params.upper_bound,
+      *params.sum_mechanism, *params.count_mechanism);
+
+  for (const auto& [noised_sum, noised_count] :
+       std::vector<std::pair<double, double>>{
+           {0, 0}, {500, 1000}, {-50, 100}, {1e6, 3}, {-7.5, 0.5}}) {
+    params.noised_sum = noised_sum;
+    params.noised_count = noised_count;
+    EXPECT_THAT(context.Compute(noised_sum, noised_count),
+                EqualsProto(BoundedMeanConfidenceInterval(params)));
+  }
+}
+
+TEST(BoundedMeanCiTest, ContextWithInfiniteParamsReturnsDefaultCi) {
+  const std::unique_ptr<NumericalMechanism> mechanism =
+      LaplaceMechanism::Builder()
+          .SetEpsilon(1)
+          .SetL0Sensitivity(1)
+          .SetLInfSensitivity(1)
+          .Build()
+          .value();
+  const BoundedMeanConfidenceIntervalContext context(0.9, -1.0, 1.0,
+                                                     *mechanism, *mechanism);
+  const BoundedMeanConfidenceIntervalContext infinite_bounds_context(
+      0.9, -std::numeric_limits<double>::infinity(), 1.0, *mechanism,
+      *mechanism);
+
+  EXPECT_THAT(context.Compute(std::numeric_limits<double>::infinity(), 10),
+              EqualsProto(""));
+  EXPECT_THAT(infinite_bounds_context.Compute(0, 10), EqualsProto(""));
+}
+
 }  // namespace
 }  // namespace internal
 }  // namespace differential_privacy
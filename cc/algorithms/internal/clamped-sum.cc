@@ -0,0 +1,536 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/clamped-sum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "algorithms/internal/cpu-dispatch.h"
+
+#if defined(DP_CPU_DISPATCH_X86)
+#include <immintrin.h>
+#elif defined(DP_CPU_DISPATCH_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "absl/numeric/bits.h"
+#include "absl/types/span.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+// Every kernel sums a prefix of the entries into the sum (and count) and
+// returns the length of the prefix. The scalar loops in ClampedSum add the
+// rest.
+
+template <typename Float>
+using FloatKernel = size_t (*)(const Float*, size_t, double, double, double,
+                               double*, int64_t*);
+template <typename Int>
+using IntKernel = size_t (*)(const Int*, size_t, Int, Int, uint64_t*);
+template <typename Float>
+using FixedPointKernel = size_t (*)(const Float*, size_t, double, double,
+                                    double, int64_t*, int64_t*);
+
+// Fixed point sums are accumulated in int64_t over chunks of at most this many
+// entries. Every rounded entry is at most 2^50 in magnitude, so neither the
+// sums of the chunks nor those of their lanes can overflow.
+constexpr size_t kFixedPointChunk = 1 << 12;
+
+// Adding 1.5 * 2^52 to a double of magnitude below 2^51 rounds it to an
+// integer with ties to even, and leaves that integer in the low bits of the
+// result, offset by the bits of the constant.
+constexpr double kRoundingMagic = 0x1.8p52;
+constexpr int64_t kRoundingMagicBits = 0x4338000000000000;
+
+namespace scalar {
+
+// The scalar variants leave all entries to the scalar loops.
+template <typename Float>
+size_t ClampedSum(const Float* data, size_t size, double lower, double upper,
+                  double offset, double* sum, int64_t* count) {
+  return 0;
+}
+
+template <typename Int>
+size_t ClampedSum(const Int* data, size_t size, Int lower, Int upper,
+                  uint64_t* sum) {
+  return 0;
+}
+
+template <typename Float>
+size_t ClampedFixedPointSum(const Float* data, size_t size, double lower,
+                            double upper, double scale, int64_t* sum,
+                            int64_t* count) {
+  return 0;
+}
+
+}  // namespace scalar
+
+#if defined(DP_CPU_DISPATCH_X86)
+
+namespace avx512 {
+
+// Loads consecutive entries as doubles. Converting floats to double is exact,
+// so clamping them in double gives the same values as clamping them in float.
+DP_TARGET_AVX512 inline __m512d Load(const double* entries) {
+  return _mm512_loadu_pd(entries);
+}
+DP_TARGET_AVX512 inline __m512d Load(const float* entries) {
+  return _mm512_cvtps_pd(_mm256_loadu_ps(entries));
+}
+
+template <typename Float>
+DP_TARGET_AVX512 size_t ClampedSum(const Float* data, size_t size,
+                                   double lower, double upper, double offset,
+                                   double* sum, int64_t* count) {
+  const __m512d lower_v = _mm512_set1_pd(lower);
+  const __m512d upper_v = _mm512_set1_pd(upper);
+  const __m512d offset_v = _mm512_set1_pd(offset);
+  __m512d sum_v = _mm512_setzero_pd();
+  size_t k = 0;
+  for (; k + 8 <= size; k += 8) {
+    const __m512d x = Load(data + k);
+    const __mmask8 not_nan = _mm512_cmp_pd_mask(x, x, _CMP_ORD_Q);
+    const __m512d clamped = _mm512_min_pd(_mm512_max_pd(x, lower_v), upper_v);
+    sum_v = _mm512_mask_add_pd(sum_v, not_nan, sum_v,
+                               _mm512_sub_pd(clamped, offset_v));
+    *count += absl::popcount(static_cast<uint32_t>(not_nan));
+  }
+  *sum = _mm512_reduce_add_pd(sum_v);
+  return k;
+}
+
+DP_TARGET_AVX512 size_t ClampedSum(const int64_t* data, size_t size,
+                                   int64_t lower, int64_t upper,
+                                   uint64_t* sum) {
+  const __m512i lower_v = _mm512_set1_epi64(lower);
+  const __m512i upper_v = _mm512_set1_epi64(upper);
+  __m512i sum_v = _mm512_setzero_si512();
+  size_t k = 0;
+  for (; k + 8 <= size; k += 8) {
+    const __m512i x = _mm512_loadu_si512(data + k);
+    sum_v = _mm512_add_epi64(
+        sum_v, _mm512_min_epi64(_mm512_max_epi64(x, lower_v), upper_v));
+  }
+  alignas(64) uint64_t lanes[8];
+  _mm512_store_si512(lanes, sum_v);
+  for (uint64_t lane : lanes) *sum += lane;
+  return k;
+}
+
+DP_TARGET_AVX512 size_t ClampedSum(const int32_t* data, size_t size,
+                                   int32_t lower, int32_t upper,
+                                   uint64_t* sum) {
+  const __m512i lower_v = _mm512_set1_epi32(lower);
+  const __m512i upper_v = _mm512_set1_epi32(upper);
+  __m512i sum_v = _mm512_setzero_si512();
+  size_t k = 0;
+  for (; k + 16 <= size; k += 16) {
+    const __m512i x = _mm512_loadu_si512(data + k);
+    const __m512i clamped =
+        _mm512_min_epi32(_mm512_max_epi32(x, lower_v), upper_v);
+    sum_v = _mm512_add_epi64(
+        sum_v, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(clamped)));
+    sum_v = _mm512_add_epi64(
+        sum_v, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(clamped, 1)));
+  }
+  alignas(64) uint64_t lanes[8];
+  _mm512_store_si512(lanes, sum_v);
+  for (uint64_t lane : lanes) *sum += lane;
+  return k;
+}
+
+template <typename Float>
+DP_TARGET_AVX512 size_t ClampedFixedPointSum(const Float* data, size_t size,
+                                             double lower, double upper,
+                                             double scale, int64_t* sum,
+                                             int64_t* count) {
+  const __m512d lower_v = _mm512_set1_pd(lower);
+  const __m512d upper_v = _mm512_set1_pd(upper);
+  const __m512d scale_v = _mm512_set1_pd(scale);
+  const __m512d magic_v = _mm512_set1_pd(kRoundingMagic);
+  const __m512i magic_bits_v = _mm512_set1_epi64(kRoundingMagicBits);
+  __m512i sum_v = _mm512_setzero_si512();
+  size_t k = 0;
+  for (; k + 8 <= size; k += 8) {
+    const __m512d x = Load(data + k);
+    const __mmask8 not_nan = _mm512_cmp_pd_mask(x, x, _CMP_ORD_Q);
+    const __m512d clamped = _mm512_min_pd(_mm512_max_pd(x, lower_v), upper_v);
+    const __m512d shifted =
+        _mm512_add_pd(_mm512_mul_pd(clamped, scale_v), magic_v);
+    const __m512i rounded =
+        _mm512_sub_epi64(_mm512_castpd_si512(shifted), magic_bits_v);
+    sum_v = _mm512_mask_add_epi64(sum_v, not_nan, sum_v, rounded);
+    *count += absl::popcount(static_cast<uint32_t>(not_nan));
+  }
+  *sum = _mm512_reduce_add_epi64(sum_v);
+  return k;
+}
+
+}  // namespace avx512
+
+namespace avx2 {
+
+DP_TARGET_AVX2 inline __m256d Load(const double* entries) {
+  return _mm256_loadu_pd(entries);
+}
+DP_TARGET_AVX2 inline __m256d Load(const float* entries) {
+  return _mm256_cvtps_pd(_mm_loadu_ps(entries));
+}
+
+template <typename Float>
+DP_TARGET_AVX2 size_t ClampedSum(const Float* data, size_t size, double lower,
+                                 double upper, double offset, double* sum,
+                                 int64_t* count) {
+  const __m256d lower_v = _mm256_set1_pd(lower);
+  const __m256d upper_v = _mm256_set1_pd(upper);
+  const __m256d offset_v = _mm256_set1_pd(offset);
+  __m256d sum_v = _mm256_setzero_pd();
+  size_t k = 0;
+  for (; k + 4 <= size; k += 4) {
+    const __m256d x = Load(data + k);
+    // All ones in the lanes that are not NaN.
+    const __m256d not_nan = _mm256_cmp_pd(x, x, _CMP_ORD_Q);
+    const __m256d clamped = _mm256_min_pd(_mm256_max_pd(x, lower_v), upper_v);
+    sum_v = _mm256_add_pd(
+        sum_v, _mm256_and_pd(not_nan, _mm256_sub_pd(clamped, offset_v)));
+    *count +=
+        absl::popcount(static_cast<uint32_t>(_mm256_movemask_pd(not_nan)));
+  }
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, sum_v);
+  *sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  return k;
+}
+
+DP_TARGET_AVX2 size_t ClampedSum(const int64_t* data, size_t size,
+                                 int64_t lower, int64_t upper, uint64_t* sum) {
+  const __m256i lower_v = _mm256_set1_epi64x(lower);
+  const __m256i upper_v = _mm256_set1_epi64x(upper);
+  __m256i sum_v = _mm256_setzero_si256();
+  size_t k = 0;
+  for (; k + 4 <= size; k += 4) {
+    const __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + k));
+    // AVX2 has no 64-bit min and max, so they are built from comparisons.
+    const __m256i at_least_lower =
+        _mm256_blendv_epi8(lower_v, x, _mm256_cmpgt_epi64(x, lower_v));
+    const __m256i clamped = _mm256_blendv_epi8(
+        upper_v, at_least_lower, _mm256_cmpgt_epi64(upper_v, at_least_lower));
+    sum_v = _mm256_add_epi64(sum_v, clamped);
+  }
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum_v);
+  for (uint64_t lane : lanes) *sum += lane;
+  return k;
+}
+
+DP_TARGET_AVX2 size_t ClampedSum(const int32_t* data, size_t size,
+                                 int32_t lower, int32_t upper, uint64_t* sum) {
+  const __m256i lower_v = _mm256_set1_epi32(lower);
+  const __m256i upper_v = _mm256_set1_epi32(upper);
+  __m256i sum_v = _mm256_setzero_si256();
+  size_t k = 0;
+  for (; k + 8 <= size; k += 8) {
+    const __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + k));
+    const __m256i clamped =
+        _mm256_min_epi32(_mm256_max_epi32(x, lower_v), upper_v);
+    sum_v = _mm256_add_epi64(
+        sum_v, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(clamped)));
+    sum_v = _mm256_add_epi64(
+        sum_v, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(clamped, 1)));
+  }
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum_v);
+  for (uint64_t lane : lanes) *sum += lane;
+  return k;
+}
+
+template <typename Float>
+DP_TARGET_AVX2 size_t ClampedFixedPointSum(const Float* data, size_t size,
+                                           double lower, double upper,
+                                           double scale, int64_t* sum,
+                                           int64_t* count) {
+  const __m256d lower_v = _mm256_set1_pd(lower);
+  const __m256d upper_v = _mm256_set1_pd(upper);
+  const __m256d scale_v = _mm256_set1_pd(scale);
+  const __m256d magic_v = _mm256_set1_pd(kRoundingMagic);
+  const __m256i magic_bits_v = _mm256_set1_epi64x(kRoundingMagicBits);
+  __m256i sum_v = _mm256_setzero_si256();
+  size_t k = 0;
+  for (; k + 4 <= size; k += 4) {
+    const __m256d x = Load(data + k);
+    const __m256d not_nan = _mm256_cmp_pd(x, x, _CMP_ORD_Q);
+    const __m256d clamped = _mm256_min_pd(_mm256_max_pd(x, lower_v), upper_v);
+    const __m256d shifted =
+        _mm256_add_pd(_mm256_mul_pd(clamped, scale_v), magic_v);
+    const __m256i rounded =
+        _mm256_sub_epi64(_mm256_castpd_si256(shifted), magic_bits_v);
+    sum_v = _mm256_add_epi64(
+        sum_v, _mm256_and_si256(_mm256_castpd_si256(not_nan), rounded));
+    *count +=
+        absl::popcount(static_cast<uint32_t>(_mm256_movemask_pd(not_nan)));
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum_v);
+  *sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  return k;
+}
+
+}  // namespace avx2
+
+#elif defined(DP_CPU_DISPATCH_NEON)
+
+namespace neon {
+
+inline float64x2_t Load(const double* entries) { return vld1q_f64(entries); }
+inline float64x2_t Load(const float* entries) {
+  return vcvt_f64_f32(vld1_f32(entries));
+}
+
+template <typename Float>
+size_t ClampedSum(const Float* data, size_t size, double lower, double upper,
+                  double offset, double* sum, int64_t* count) {
+  const float64x2_t lower_v = vdupq_n_f64(lower);
+  const float64x2_t upper_v = vdupq_n_f64(upper);
+  const float64x2_t offset_v = vdupq_n_f64(offset);
+  float64x2_t sum_v = vdupq_n_f64(0);
+  uint64x2_t count_v = vdupq_n_u64(0);
+  size_t k = 0;
+  for (; k + 2 <= size; k += 2) {
+    const float64x2_t x = Load(data + k);
+    // All ones, i.e., -1, in the lanes that are not NaN.
+    const uint64x2_t not_nan = vceqq_f64(x, x);
+    const float64x2_t clamped = vminq_f64(vmaxq_f64(x, lower_v), upper_v);
+    const uint64x2_t contribution =
+        vreinterpretq_u64_f64(vsubq_f64(clamped, offset_v));
+    sum_v = vaddq_f64(
+        sum_v, vreinterpretq_f64_u64(vandq_u64(not_nan, contribution)));
+    count_v = vsubq_u64(count_v, not_nan);
+  }
+  *sum = vaddvq_f64(sum_v);
+  *count = vaddvq_u64(count_v);
+  return k;
+}
+
+size_t ClampedSum(const int64_t* data, size_t size, int64_t lower,
+                  int64_t upper, uint64_t* sum) {
+  const int64x2_t lower_v = vdupq_n_s64(lower);
+  const int64x2_t upper_v = vdupq_n_s64(upper);
+  uint64x2_t sum_v = vdupq_n_u64(0);
+  size_t k = 0;
+  for (; k + 2 <= size; k += 2) {
+    const int64x2_t x = vld1q_s64(data + k);
+    const int64x2_t at_least_lower =
+        vbslq_s64(vcgtq_s64(x, lower_v), x, lower_v);
+    const int64x2_t clamped = vbslq_s64(vcgtq_s64(upper_v, at_least_lower),
+                                        at_least_lower, upper_v);
+    sum_v = vaddq_u64(sum_v, vreinterpretq_u64_s64(clamped));
+  }
+  *sum = vaddvq_u64(sum_v);
+  return k;
+}
+
+size_t ClampedSum(const int32_t* data, size_t size, int32_t lower,
+                  int32_t upper, uint64_t* sum) {
+  const int32x4_t lower_v = vdupq_n_s32(lower);
+  const int32x4_t upper_v = vdupq_n_s32(upper);
+  int64x2_t sum_v = vdupq_n_s64(0);
+  size_t k = 0;
+  for (; k + 4 <= size; k += 4) {
+    const int32x4_t x = vld1q_s32(data + k);
+    // Adds pairs of lanes, widened to 64 bits, to the sums.
+    sum_v = vpadalq_s32(sum_v, vminq_s32(vmaxq_s32(x, lower_v), upper_v));
+  }
+  *sum = vaddvq_u64(vreinterpretq_u64_s64(sum_v));
+  return k;
+}
+
+template <typename Float>
+size_t ClampedFixedPointSum(const Float* data, size_t size, double lower,
+                            double upper, double scale, int64_t* sum,
+                            int64_t* count) {
+  const float64x2_t lower_v = vdupq_n_f64(lower);
+  const float64x2_t upper_v = vdupq_n_f64(upper);
+  const float64x2_t scale_v = vdupq_n_f64(scale);
+  int64x2_t sum_v = vdupq_n_s64(0);
+  uint64x2_t count_v = vdupq_n_u64(0);
+  size_t k = 0;
+  for (; k + 2 <= size; k += 2) {
+    const float64x2_t x = Load(data + k);
+    const uint64x2_t not_nan = vceqq_f64(x, x);
+    const float64x2_t clamped = vminq_f64(vmaxq_f64(x, lower_v), upper_v);
+    // Rounds to the nearest integer with ties to even.
+    const int64x2_t rounded = vcvtnq_s64_f64(vmulq_f64(clamped, scale_v));
+    sum_v = vaddq_s64(sum_v, vandq_s64(vreinterpretq_s64_u64(not_nan), rounded));
+    count_v = vsubq_u64(count_v, not_nan);
+  }
+  *sum = vaddvq_s64(sum_v);
+  *count += vaddvq_u64(count_v);
+  return k;
+}
+
+}  // namespace neon
+
+#endif
+
+// Returns the clamp-and-sum kernel for floating point entries of the CPU.
+template <typename Float>
+FloatKernel<Float> GetFloatKernel() {
+  static const KernelDispatch<FloatKernel<Float>> kernel =
+      KernelDispatch<FloatKernel<Float>>(&scalar::ClampedSum<Float>)
+#if defined(DP_CPU_DISPATCH_X86)
+          .Register(Isa::kAvx2, &avx2::ClampedSum<Float>)
+          .Register(Isa::kAvx512, &avx512::ClampedSum<Float>)
+#elif defined(DP_CPU_DISPATCH_NEON)
+          .Register(Isa::kNeon, &neon::ClampedSum<Float>)
+#endif
+      ;
+  return kernel.Get();
+}
+
+// Same as above for integer entries.
+template <typename Int>
+IntKernel<Int> GetIntKernel() {
+  static const KernelDispatch<IntKernel<Int>> kernel =
+      KernelDispatch<IntKernel<Int>>(&scalar::ClampedSum<Int>)
+#if defined(DP_CPU_DISPATCH_X86)
+          .Register(Isa::kAvx2, &avx2::ClampedSum)
+          .Register(Isa::kAvx512, &avx512::ClampedSum)
+#elif defined(DP_CPU_DISPATCH_NEON)
+          .Register(Isa::kNeon, &neon::ClampedSum)
+#endif
+      ;
+  return kernel.Get();
+}
+
+// Same as above for fixed point sums.
+template <typename Float>
+FixedPointKernel<Float> GetFixedPointKernel() {
+  static const KernelDispatch<FixedPointKernel<Float>> kernel =
+      KernelDispatch<FixedPointKernel<Float>>(
+          &scalar::ClampedFixedPointSum<Float>)
+#if defined(DP_CPU_DISPATCH_X86)
+          .Register(Isa::kAvx2, &avx2::ClampedFixedPointSum<Float>)
+          .Register(Isa::kAvx512, &avx512::ClampedFixedPointSum<Float>)
+#elif defined(DP_CPU_DISPATCH_NEON)
+          .Register(Isa::kNeon, &neon::ClampedFixedPointSum<Float>)
+#endif
+      ;
+  return kernel.Get();
+}
+
+template <typename Float>
+ClampedSumResult ClampedSumImpl(absl::Span<const Float> entries, double lower,
+                                double upper, double offset) {
+  const Float* data = entries.data();
+  const size_t size = entries.size();
+  double sum = 0;
+  int64_t count = 0;
+  size_t k =
+      GetFloatKernel<Float>()(data, size, lower, upper, offset, &sum, &count);
+  for (; k < size; ++k) {
+    const double entry = data[k];
+    if (std::isnan(entry)) continue;
+    sum += std::min(std::max(entry, lower), upper) - offset;
+    ++count;
+  }
+  return {sum, count};
+}
+
+template <typename Float>
+FixedPointSumResult ClampedFixedPointSumImpl(absl::Span<const Float> entries,
+                                             double lower, double upper,
+                                             double scale) {
+  const FixedPointKernel<Float> kernel = GetFixedPointKernel<Float>();
+  absl::int128 sum = 0;
+  int64_t count = 0;
+  for (size_t begin = 0; begin < entries.size(); begin += kFixedPointChunk) {
+    const Float* data = entries.data() + begin;
+    const size_t size = std::min(kFixedPointChunk, entries.size() - begin);
+    int64_t chunk_sum = 0;
+    size_t k = kernel(data, size, lower, upper, scale, &chunk_sum, &count);
+    for (; k < size; ++k) {
+      const double entry = data[k];
+      if (std::isnan(entry)) continue;
+      // The rounding mode is never changed, so this rounds ties to even.
+      chunk_sum += static_cast<int64_t>(
+          std::nearbyint(std::min(std::max(entry, lower), upper) * scale));
+      ++count;
+    }
+    sum += chunk_sum;
+  }
+  return {sum, count};
+}
+
+}  // namespace
+
+ClampedSumResult ClampedSum(absl::Span<const double> entries, double lower,
+                            double upper, double offset) {
+  return ClampedSumImpl(entries, lower, upper, offset);
+}
+
+ClampedSumResult ClampedSum(absl::Span<const float> entries, float lower,
+                            float upper, double offset) {
+  return ClampedSumImpl(entries, lower, upper, offset);
+}
+
+int64_t ClampedSum(absl::Span<const int64_t> entries, int64_t lower,
+                   int64_t upper) {
+  const int64_t* data = entries.data();
+  const size_t size = entries.size();
+  // Unsigned, so that overflows wrap around without undefined behavior.
+  uint64_t sum = 0;
+  size_t k = GetIntKernel<int64_t>()(data, size, lower, upper, &sum);
+  for (; k < size; ++k) {
+    sum += static_cast<uint64_t>(std::min(std::max(data[k], lower), upper));
+  }
+  return static_cast<int64_t>(sum);
+}
+
+int64_t ClampedSum(absl::Span<const int32_t> entries, int32_t lower,
+                   int32_t upper) {
+  const int32_t* data = entries.data();
+  const size_t size = entries.size();
+  uint64_t sum = 0;
+  size_t k = GetIntKernel<int32_t>()(data, size, lower, upper, &sum);
+  for (; k < size; ++k) {
+    sum += static_cast<uint64_t>(
+        static_cast<int64_t>(std::min(std::max(data[k], lower), upper)));
+  }
+  return static_cast<int64_t>(sum);
+}
+
+FixedPointSumResult ClampedFixedPointSum(absl::Span<const double> entries,
+                                         double lower, double upper,
+                                         double scale) {
+  return ClampedFixedPointSumImpl(entries, lower, upper, scale);
+}
+
+FixedPointSumResult ClampedFixedPointSum(absl::Span<const float> entries,
+                                         double lower, double upper,
+                                         double scale) {
+  return ClampedFixedPointSumImpl(entries, lower, upper, scale);
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
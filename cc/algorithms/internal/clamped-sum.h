@@ -0,0 +1,84 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_CLAMPED_SUM_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_CLAMPED_SUM_H_
+
+#include <cstdint>
+
+#include "absl/numeric/int128.h"
+#include "absl/types/span.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// Clamp-and-sum kernels for the batched AddEntries of the bounded algorithms
+// with fixed bounds. On x86-64, they use AVX-512 or AVX2 if the CPU supports
+// them, picked at runtime, so that a portable build uses them too. On ARM,
+// they use NEON, and a scalar loop otherwise.
+
+struct ClampedSumResult {
+  double sum;
+  // Number of entries that are not NaN.
+  int64_t count;
+};
+
+// Returns the sum of Clamp(lower, upper, entry) - offset over the entries that
+// are not NaN. The sum is accumulated in several lanes, so it may differ from
+// a sequential sum by rounding.
+ClampedSumResult ClampedSum(absl::Span<const double> entries, double lower,
+                            double upper, double offset = 0);
+
+// Same as above for float entries, which are converted to and summed in
+// double.
+ClampedSumResult ClampedSum(absl::Span<const float> entries, float lower,
+                            float upper, double offset = 0);
+
+// Returns the sum of Clamp(lower, upper, entry) over all entries. The sum
+// wraps around on overflow, like the sequential sums of the algorithms, but
+// without undefined behavior. Wrapping addition is associative, so the result
+// is exactly the one of a sequential sum.
+int64_t ClampedSum(absl::Span<const int64_t> entries, int64_t lower,
+                   int64_t upper);
+
+// Same as above for int32_t entries, which are clamped in 32 bits and summed
+// in 64 bits.
+int64_t ClampedSum(absl::Span<const int32_t> entries, int32_t lower,
+                   int32_t upper);
+
+struct FixedPointSumResult {
+  absl::int128 sum;
+  // Number of entries that are not NaN.
+  int64_t count;
+};
+
+// Returns the sum of Clamp(lower, upper, entry) * scale, rounded to the
+// nearest integer with ties to even, over the entries that are not NaN. The
+// sum is exact, so it does not depend on the order of the entries. lower *
+// scale and upper * scale must not exceed 2^50 in magnitude.
+FixedPointSumResult ClampedFixedPointSum(absl::Span<const double> entries,
+                                         double lower, double upper,
+                                         double scale);
+
+// Same as above for float entries, which are converted to double.
+FixedPointSumResult ClampedFixedPointSum(absl::Span<const float> entries,
+                                         double lower, double upper,
+                                         double scale);
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_CLAMPED_SUM_H_
@@ -0,0 +1,241 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/clamped-sum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/numeric/int128.h"
+#include "absl/types/span.h"
+#include "algorithms/internal/cpu-dispatch.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+// Sizes that cover empty inputs, inputs shorter than a vector and remainders
+// after every vector width.
+constexpr int kMaxSize = 37;
+
+template <typename Float>
+std::vector<Float> FloatingEntries(int size) {
+  std::vector<Float> entries;
+  for (int i = 0; i < size; ++i) {
+    if (i % 5 == 3) {
+      entries.push_back(std::numeric_limits<Float>::quiet_NaN());
+    } else {
+      entries.push_back(static_cast<Float>((i * 7919) % 41) / 4 - 5);
+    }
+  }
+  return entries;
+}
+
+template <typename Float>
+ClampedSumResult SequentialClampedSum(const std::vector<Float>& entries,
+                                      double lower, double upper,
+                                      double offset) {
+  ClampedSumResult result = {0, 0};
+  for (Float entry : entries) {
+    if (std::isnan(entry)) continue;
+    result.sum += std::min<double>(std::max<double>(entry, lower), upper) -
+                  offset;
+    ++result.count;
+  }
+  return result;
+}
+
+// Runs every test with the kernels of every instruction set of the CPU.
+class ClampedSumTest : public ::testing::TestWithParam<Isa> {
+ protected:
+  void SetUp() override {
+    if (!ForceIsa(GetParam())) {
+      GTEST_SKIP() << "CPU does not support " << IsaName(GetParam());
+    }
+  }
+
+  void TearDown() override { ClearForcedIsa(); }
+};
+
+INSTANTIATE_TEST_SUITE_P(
+    AllIsas, ClampedSumTest,
+    ::testing::Values(Isa::kScalar, Isa::kNeon, Isa::kAvx2, Isa::kAvx512),
+    [](const ::testing::TestParamInfo<Isa>& info) {
+      return std::string(IsaName(info.param));
+    });
+
+TEST_P(ClampedSumTest, DoubleMatchesSequentialSum) {
+  for (int size = 0; size <= kMaxSize; ++size) {
+    const std::vector<double> entries = FloatingEntries<double>(size);
+    const ClampedSumResult expected =
+        SequentialClampedSum(entries, -2, 3.5, 0.75);
+
+    const ClampedSumResult result = ClampedSum(entries, -2, 3.5, 0.75);
+
+    EXPECT_NEAR(result.sum, expected.sum, 1e-12) << "size " << size;
+    EXPECT_EQ(result.count, expected.count) << "size " << size;
+  }
+}
+
+TEST_P(ClampedSumTest, FloatMatchesSequentialSum) {
+  for (int size = 0; size <= kMaxSize; ++size) {
+    const std::vector<float> entries = FloatingEntries<float>(size);
+    const ClampedSumResult expected =
+        SequentialClampedSum(entries, -2.5f, 3, 0.25);
+
+    const ClampedSumResult result = ClampedSum(entries, -2.5f, 3, 0.25);
+
+    EXPECT_NEAR(result.sum, expected.sum, 1e-12) << "size " << size;
+    EXPECT_EQ(result.count, expected.count) << "size " << size;
+  }
+}
+
+TEST_P(ClampedSumTest, ClampsInfinities) {
+  const std::vector<double> entries = {
+      std::numeric_limits<double>::infinity(),
+      -std::numeric_limits<double>::infinity(), 1};
+
+  const ClampedSumResult result = ClampedSum(entries, -10, 100);
+
+  EXPECT_EQ(result.sum, 91);
+  EXPECT_EQ(result.count, 3);
+}
+
+TEST_P(ClampedSumTest, Int64MatchesSequentialSum) {
+  for (int size = 0; size <= kMaxSize; ++size) {
+    std::vector<int64_t> entries;
+    int64_t expected = 0;
+    for (int i = 0; i < size; ++i) {
+      entries.push_back((i * 7919) % 1001 - 500);
+      expected += std::min<int64_t>(std::max<int64_t>(entries.back(), -300),
+                                    200);
+    }
+
+    EXPECT_EQ(ClampedSum(entries, -300, 200), expected) << "size " << size;
+  }
+}
+
+TEST_P(ClampedSumTest, Int64WrapsAroundOnOverflow) {
+  constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
+  for (int size = 2; size <= kMaxSize; ++size) {
+    // Pairs of kMax sum to -2 after wrapping around.
+    std::vector<int64_t> entries(size, kMax);
+    const int64_t expected = size % 2 == 0 ? -size : kMax - (size - 1);
+
+    EXPECT_EQ(ClampedSum(entries, 0, kMax), expected) << "size " << size;
+  }
+}
+
+TEST_P(ClampedSumTest, Int32MatchesSequentialSum) {
+  for (int size = 0; size <= kMaxSize; ++size) {
+    std::vector<int32_t> entries;
+    int64_t expected = 0;
+    for (int i = 0; i < size; ++i) {
+      entries.push_back((i * 7919) % 1001 - 500);
+      expected += std::min<int32_t>(std::max<int32_t>(entries.back(), -300),
+                                    200);
+    }
+
+    EXPECT_EQ(ClampedSum(entries, -300, 200), expected) << "size " << size;
+  }
+}
+
+TEST_P(ClampedSumTest, Int32SumsInInt64) {
+  constexpr int32_t kMax = std::numeric_limits<int32_t>::max();
+  constexpr int32_t kMin = std::numeric_limits<int32_t>::lowest();
+  for (int size = 0; size <= kMaxSize; ++size) {
+    std::vector<int32_t> entries(size, kMax);
+    std::vector<int32_t> negative_entries(size, kMin);
+
+    EXPECT_EQ(ClampedSum(entries, kMin, kMax), int64_t{kMax} * size)
+        << "size " << size;
+    EXPECT_EQ(ClampedSum(negative_entries, kMin, kMax), int64_t{kMin} * size)
+        << "size " << size;
+  }
+}
+
+template <typename Float>
+FixedPointSumResult SequentialFixedPointSum(const std::vector<Float>& entries,
+                                            double lower, double upper,
+                                            double scale) {
+  FixedPointSumResult result = {0, 0};
+  for (Float entry : entries) {
+    if (std::isnan(entry)) continue;
+    result.sum += static_cast<int64_t>(std::nearbyint(
+        std::min<double>(std::max<double>(entry, lower), upper) * scale));
+    ++result.count;
+  }
+  return result;
+}
+
+TEST_P(ClampedSumTest, FixedPointDoubleMatchesSequentialSum) {
+  for (int size = 0; size <= kMaxSize; ++size) {
+    const std::vector<double> entries = FloatingEntries<double>(size);
+    const FixedPointSumResult expected =
+        SequentialFixedPointSum(entries, -2, 3.5, 2);
+
+    const FixedPointSumResult result = ClampedFixedPointSum(entries, -2, 3.5, 2);
+
+    EXPECT_EQ(result.sum, expected.sum) << "size " << size;
+    EXPECT_EQ(result.count, expected.count) << "size " << size;
+  }
+}
+
+TEST_P(ClampedSumTest, FixedPointFloatMatchesSequentialSum) {
+  for (int size = 0; size <= kMaxSize; ++size) {
+    const std::vector<float> entries = FloatingEntries<float>(size);
+    const FixedPointSumResult expected =
+        SequentialFixedPointSum(entries, -2.5, 3, 0.5);
+
+    const FixedPointSumResult result =
+        ClampedFixedPointSum(entries, -2.5, 3, 0.5);
+
+    EXPECT_EQ(result.sum, expected.sum) << "size " << size;
+    EXPECT_EQ(result.count, expected.count) << "size " << size;
+  }
+}
+
+TEST_P(ClampedSumTest, FixedPointRoundsTiesToEven) {
+  const std::vector<double> entries = {0.5, 1.5, 2.5, -0.5, -1.5, -2.5, 0.25};
+
+  const FixedPointSumResult result = ClampedFixedPointSum(entries, -10, 10, 1);
+
+  // 0 + 2 + 2 - 0 - 2 - 2 + 0.
+  EXPECT_EQ(result.sum, 0);
+  EXPECT_EQ(result.count, 7);
+}
+
+TEST_P(ClampedSumTest, FixedPointSumDoesNotOverflow) {
+  // Every entry contributes 2^50, so the sum exceeds the range of int64_t.
+  constexpr double kBound = 0x1p50;
+  const std::vector<double> entries(1 << 14, kBound);
+
+  const FixedPointSumResult result =
+      ClampedFixedPointSum(entries, -kBound, kBound, 1);
+
+  EXPECT_EQ(result.sum, absl::int128(1) << 64);
+  EXPECT_EQ(result.count, 1 << 14);
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
@@ -0,0 +1,105 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/compact-counters.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
+#include <utility>
+
+#include "absl/types/span.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+// Returns the smallest width in bytes that holds value.
+int WidthFor(int64_t value) {
+  if (value >= std::numeric_limits<int16_t>::min() &&
+      value <= std::numeric_limits<int16_t>::max()) {
+    return 2;
+  }
+  if (value >= std::numeric_limits<int32_t>::min() &&
+      value <= std::numeric_limits<int32_t>::max()) {
+    return 4;
+  }
+  return 8;
+}
+
+}  // namespace
+
+void CompactCounters::AddAll(const CompactCounters& other) {
+  if (other.width_ > width_) {
+    Widen(other.width_);
+  }
+  for (int i = 0; i < size_; ++i) {
+    const int64_t increment = other.Get(i);
+    if (increment != 0) {
+      Add(i, increment);
+    }
+  }
+}
+
+void CompactCounters::CopyTo(absl::Span<int64_t> out) const {
+  for (int i = 0; i < size_; ++i) {
+    out[i] = Get(i);
+  }
+}
+
+void CompactCounters::AddAndWiden(int i, int64_t increment) {
+  const int64_t sum = Get(i) + increment;
+  // The sum does not fit the current width, so this always widens.
+  Widen(WidthFor(sum));
+  if (width_ == 4) {
+    Store<int32_t>(i, static_cast<int32_t>(sum));
+  } else {
+    Store<int64_t>(i, sum);
+  }
+}
+
+void CompactCounters::Widen(int width) {
+  if (width <= width_) {
+    return;
+  }
+  std::pmr::vector<unsigned char> bytes(static_cast<size_t>(size_) * width, 0,
+                                        bytes_.get_allocator());
+  std::swap(bytes, bytes_);
+  // Read the counters from the old bytes with the old width.
+  const int old_width = width_;
+  width_ = width;
+  for (int i = 0; i < size_; ++i) {
+    int64_t value;
+    if (old_width == 2) {
+      int16_t narrow;
+      std::memcpy(&narrow, bytes.data() + static_cast<size_t>(i) * 2, 2);
+      value = narrow;
+    } else {
+      int32_t narrow;
+      std::memcpy(&narrow, bytes.data() + static_cast<size_t>(i) * 4, 4);
+      value = narrow;
+    }
+    if (width_ == 4) {
+      Store<int32_t>(i, static_cast<int32_t>(value));
+    } else {
+      Store<int64_t>(i, value);
+    }
+  }
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
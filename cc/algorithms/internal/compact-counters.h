@@ -0,0 +1,161 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_COMPACT_COUNTERS_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_COMPACT_COUNTERS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
+#include <vector>
+
+#include "absl/types/span.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// Fixed number of int64_t counters that are stored with as few bytes as their
+// values allow. All counters start out as 16-bit integers; when an addition
+// does not fit, every counter is widened to 32 and then 64 bits. Most
+// partitions only ever see small counts, so this takes a quarter of the memory
+// of a std::vector<int64_t> in the common case, at the cost of a branch on
+// the width for every access.
+//
+// Counters are never narrowed again, not even by Clear, since a counter that
+// overflowed once is likely to overflow again when reused. Allocates from the
+// given memory resource, like the pmr containers of the algorithms.
+class CompactCounters {
+ public:
+  explicit CompactCounters(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : bytes_(resource) {}
+
+  CompactCounters(int size, std::pmr::memory_resource* resource)
+      : CompactCounters(resource) {
+    Resize(size);
+  }
+
+  // Copies the counters of other, allocating from resource.
+  CompactCounters(const CompactCounters& other,
+                  std::pmr::memory_resource* resource)
+      : width_(other.width_),
+        size_(other.size_),
+        bytes_(other.bytes_, resource) {}
+
+  CompactCounters(const CompactCounters&) = delete;
+  CompactCounters& operator=(const CompactCounters&) = delete;
+
+  int size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Number of bytes per counter: 2, 4 or 8.
+  int width() const { return width_; }
+
+  // Changes the number of counters. Added counters are 0.
+  void Resize(int size) {
+    size_ = size;
+    bytes_.resize(static_cast<size_t>(size) * width_, 0);
+  }
+
+  int64_t Get(int i) const {
+    switch (width_) {
+      case 2:
+        return Load<int16_t>(i);
+      case 4:
+        return Load<int32_t>(i);
+      default:
+        return Load<int64_t>(i);
+    }
+  }
+  int64_t operator[](int i) const { return Get(i); }
+
+  // Adds increment to the i-th counter, widening all counters if the sum does
+  // not fit.
+  void Add(int i, int64_t increment) {
+    switch (width_) {
+      case 2:
+        if (TryAdd<int16_t>(i, increment)) return;
+        break;
+      case 4:
+        if (TryAdd<int32_t>(i, increment)) return;
+        break;
+      default:
+        Store<int64_t>(i, Load<int64_t>(i) + increment);
+        return;
+    }
+    AddAndWiden(i, increment);
+  }
+
+  // Adds the counters of other, which must have the same size.
+  void AddAll(const CompactCounters& other);
+
+  // Sets all counters to 0, keeping their number and width.
+  void Clear() { std::fill(bytes_.begin(), bytes_.end(), 0); }
+
+  // Writes the counters to out, which must have the same size.
+  void CopyTo(absl::Span<int64_t> out) const;
+
+  std::vector<int64_t> ToVector() const {
+    std::vector<int64_t> counts(size_);
+    CopyTo(absl::MakeSpan(counts));
+    return counts;
+  }
+
+ private:
+  // Counters are read and written with memcpy since the bytes are only
+  // aligned for the narrowest width.
+  template <typename V>
+  V Load(int i) const {
+    V value;
+    std::memcpy(&value, bytes_.data() + static_cast<size_t>(i) * sizeof(V),
+                sizeof(V));
+    return value;
+  }
+
+  template <typename V>
+  void Store(int i, V value) {
+    std::memcpy(bytes_.data() + static_cast<size_t>(i) * sizeof(V), &value,
+                sizeof(V));
+  }
+
+  template <typename V>
+  bool TryAdd(int i, int64_t increment) {
+    const int64_t sum = Load<V>(i) + increment;
+    if (sum < std::numeric_limits<V>::min() ||
+        sum > std::numeric_limits<V>::max()) {
+      return false;
+    }
+    Store<V>(i, static_cast<V>(sum));
+    return true;
+  }
+
+  // Widens the counters until the sum fits, then stores it.
+  void AddAndWiden(int i, int64_t increment);
+
+  // Converts all counters to the given width.
+  void Widen(int width);
+
+  int width_ = 2;
+  int size_ = 0;
+  std::pmr::vector<unsigned char> bytes_;
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_COMPACT_COUNTERS_H_
@@ -0,0 +1,100 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/compact-counters.h"
+
+#include <cstdint>
+#include <limits>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "base/tracking_memory_resource.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using ::testing::ElementsAre;
+
+TEST(CompactCountersTest, StartsWithSmallZeroCounters) {
+  CompactCounters counters(4, std::pmr::get_default_resource());
+  EXPECT_EQ(counters.size(), 4);
+  EXPECT_EQ(counters.width(), 2);
+  EXPECT_THAT(counters.ToVector(), ElementsAre(0, 0, 0, 0));
+}
+
+TEST(CompactCountersTest, WidensOnOverflow) {
+  CompactCounters counters(3, std::pmr::get_default_resource());
+  counters.Add(0, 5);
+  counters.Add(1, -7);
+  counters.Add(2, std::numeric_limits<int16_t>::max());
+  EXPECT_EQ(counters.width(), 2);
+
+  counters.Add(2, 1);
+  EXPECT_EQ(counters.width(), 4);
+  EXPECT_THAT(counters.ToVector(),
+              ElementsAre(5, -7, int64_t{std::numeric_limits<int16_t>::max()} +
+                                     1));
+
+  counters.Add(1, std::numeric_limits<int32_t>::min());
+  EXPECT_EQ(counters.width(), 8);
+  EXPECT_THAT(counters.ToVector(),
+              ElementsAre(5, int64_t{std::numeric_limits<int32_t>::min()} - 7,
+                          int64_t{std::numeric_limits<int16_t>::max()} + 1));
+}
+
+TEST(CompactCountersTest, WidensDirectlyToFitLargeIncrements) {
+  CompactCounters counters(2, std::pmr::get_default_resource());
+  counters.Add(1, int64_t{1} << 40);
+  EXPECT_EQ(counters.width(), 8);
+  EXPECT_EQ(counters.Get(1), int64_t{1} << 40);
+  EXPECT_EQ(counters.Get(0), 0);
+}
+
+TEST(CompactCountersTest, AddAllWidensToOtherWidth) {
+  CompactCounters counters(2, std::pmr::get_default_resource());
+  counters.Add(0, 3);
+  CompactCounters other(2, std::pmr::get_default_resource());
+  other.Add(0, 1);
+  other.Add(1, 100000);
+  counters.AddAll(other);
+  EXPECT_EQ(counters.width(), 4);
+  EXPECT_THAT(counters.ToVector(), ElementsAre(4, 100000));
+}
+
+TEST(CompactCountersTest, ClearKeepsWidth) {
+  CompactCounters counters(2, std::pmr::get_default_resource());
+  counters.Add(0, 100000);
+  counters.Clear();
+  EXPECT_EQ(counters.width(), 4);
+  EXPECT_THAT(counters.ToVector(), ElementsAre(0, 0));
+}
+
+TEST(CompactCountersTest, AllocatesFromResource) {
+  base::TrackingMemoryResource memory;
+  CompactCounters counters(100, &memory);
+  EXPECT_EQ(memory.bytes_allocated(), 200);
+  counters.Add(0, int64_t{1} << 32);
+  EXPECT_EQ(memory.bytes_allocated(), 800);
+
+  CompactCounters copy(counters, &memory);
+  EXPECT_EQ(memory.bytes_allocated(), 1600);
+  EXPECT_EQ(copy.Get(0), int64_t{1} << 32);
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
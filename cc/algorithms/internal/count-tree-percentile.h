@@ -0,0 +1,201 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_COUNT_TREE_PERCENTILE_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_COUNT_TREE_PERCENTILE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/internal/count-tree.h"
+#include "proto/summary.pb.h"
+#include "proto/util.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// Relative ranks of inputs that are counted in a CountTree instead of being
+// stored, as an alternative to base::Percentile for the order statistics. The
+// range [lower, upper] is split into branching_factor^height buckets of equal
+// width, which are the leaves of the tree. Every input increments the counts
+// of its bucket and of all ancestors of the bucket, with inputs outside of the
+// range counted in the first or last bucket.
+//
+// Memory and the serialized summary only depend on the height and branching
+// factor, and the summaries of trees with the same parameters and range can be
+// merged. Relative ranks are exact at bucket boundaries and interpolated
+// linearly within a bucket; GetRelativeRank takes O(height * branching_factor)
+// time.
+template <typename T>
+class CountTreePercentile {
+ public:
+  // Returns an error if a tree with the given parameters is not supported.
+  static absl::Status ValidateParameters(int height, int branching_factor) {
+    if (height < 1) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Tree height must be at least 1, but was ", height));
+    }
+    if (branching_factor < 2) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Branching factor must be at least 2, but was ", branching_factor));
+    }
+    if (std::pow(static_cast<double>(branching_factor), height + 1) >
+        std::numeric_limits<int>::max()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("A tree of height ", height, " and branching factor ",
+                       branching_factor, " has too many nodes."));
+    }
+    return absl::OkStatus();
+  }
+
+  // The parameters must be valid according to ValidateParameters, and lower
+  // must not be greater than upper.
+  CountTreePercentile(T lower, T upper, int height, int branching_factor)
+      : lower_(lower), upper_(upper), tree_(height, branching_factor) {}
+
+  void Add(const T& t) { AddWithCount(t, 1); }
+
+  void Reset() {
+    tree_.ClearNodes();
+    num_values_ = 0;
+  }
+
+  int64_t num_values() const { return num_values_; }
+
+  int64_t Memory() {
+    return sizeof(CountTreePercentile<T>) + tree_.MemoryUsed();
+  }
+
+  // Writes the counts of the tree, along with the range, to the count_tree
+  // field of the summary.
+  void SerializeToProto(BinarySearchSummary* summary) {
+    BoundedQuantilesSummary* count_tree = summary->mutable_count_tree();
+    *count_tree = tree_.Serialize();
+    count_tree->set_lower(static_cast<double>(lower_));
+    count_tree->set_upper(static_cast<double>(upper_));
+  }
+
+  // Adds the inputs of the summary. Summaries written by base::Percentile are
+  // accepted as well if they store their inputs exactly, which lets existing
+  // summaries be merged into aggregations that count their inputs in a tree.
+  // Quantile sketch summaries are rejected: a sketch item stands for up to
+  // 2^level inputs, so a single input could change the counts by more than
+  // the sensitivity the noise is calibrated to.
+  absl::Status MergeFromProto(const BinarySearchSummary& summary) {
+    if (summary.has_sketch()) {
+      return absl::InvalidArgumentError(
+          "Cannot merge a quantile sketch summary into a count tree.");
+    }
+    if (summary.has_count_tree()) {
+      const BoundedQuantilesSummary& count_tree = summary.count_tree();
+      if (count_tree.lower() != static_cast<double>(lower_) ||
+          count_tree.upper() != static_cast<double>(upper_)) {
+        return absl::InvalidArgumentError(absl::StrCat(
+            "Cannot merge a count tree over [", count_tree.lower(), ", ",
+            count_tree.upper(), "] into a count tree over [",
+            static_cast<double>(lower_), ", ", static_cast<double>(upper_),
+            "]."));
+      }
+      RETURN_IF_ERROR(tree_.Merge(count_tree));
+      // Recount the inputs from the top level of the tree, since the summary
+      // does not contain their number.
+      num_values_ = 0;
+      const int first_child = tree_.LeftMostChild(tree_.GetRoot());
+      for (int i = 0; i < tree_.GetBranchingFactor(); ++i) {
+        num_values_ += tree_.GetNodeCount(first_child + i);
+      }
+    }
+    for (const ValueType& input : summary.input()) {
+      AddWithCount(GetValue<T>(input), 1);
+    }
+    return absl::OkStatus();
+  }
+
+  // Returns the fraction of inputs that are less than t, and the fraction
+  // that are less than or equal to t. Both are the same interpolated value,
+  // since the tree cannot tell inputs within a bucket apart.
+  std::pair<double, double> GetRelativeRank(double t) {
+    if (num_values_ == 0) {
+      return std::make_pair(0, 1);
+    }
+    const int num_leaves = tree_.GetNumberOfLeaves();
+    const double position = LeafPosition(t);
+    if (position >= num_leaves) {
+      return std::make_pair(1, 1);
+    }
+    const int leaf = static_cast<int>(position);
+
+    // Descend from the root to the bucket of t, adding up the counts of the
+    // subtrees to the left of the path.
+    double num_below = 0;
+    int node = tree_.GetRoot();
+    int leaves_per_child = num_leaves;
+    while (!tree_.IsLeaf(node)) {
+      leaves_per_child /= tree_.GetBranchingFactor();
+      const int child = (leaf / leaves_per_child) % tree_.GetBranchingFactor();
+      const int first_child = tree_.LeftMostChild(node);
+      for (int i = 0; i < child; ++i) {
+        num_below += tree_.GetNodeCount(first_child + i);
+      }
+      node = first_child + child;
+    }
+    num_below += tree_.GetNodeCount(node) * (position - leaf);
+    const double rank = num_below / num_values_;
+    return std::make_pair(rank, rank);
+  }
+
+ private:
+  // Returns the position of t in units of buckets, clamped to
+  // [0, number of leaves].
+  double LeafPosition(double t) const {
+    const double lower = static_cast<double>(lower_);
+    const double width = static_cast<double>(upper_) - lower;
+    if (!(width > 0)) {
+      return t < lower ? 0 : tree_.GetNumberOfLeaves();
+    }
+    return std::clamp((t - lower) / width * tree_.GetNumberOfLeaves(), 0.0,
+                      static_cast<double>(tree_.GetNumberOfLeaves()));
+  }
+
+  void AddWithCount(const T& t, int64_t count) {
+    // REF:
+    // https://stackoverflow.com/questions/61646166/how-to-resolve-fpclassify-ambiguous-call-to-overloaded-function
+    if (std::isnan(static_cast<double>(t))) {
+      return;
+    }
+    const int offset =
+        std::min(static_cast<int>(LeafPosition(static_cast<double>(t))),
+                 tree_.GetNumberOfLeaves() - 1);
+    tree_.IncrementLeafAndAncestorsBy(offset, count);
+    num_values_ += count;
+  }
+
+  T lower_;
+  T upper_;
+  CountTree tree_;
+  int64_t num_values_ = 0;
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_COUNT_TREE_PERCENTILE_H_
@@ -0,0 +1,108 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/count-tree-percentile.h"
+
+#include <cstdint>
+#include <utility>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::HasSubstr;
+
+TEST(CountTreePercentileTest, EmptyInputSet) {
+  CountTreePercentile<double> percentile(0, 100, 2, 10);
+  EXPECT_EQ(percentile.num_values(), 0);
+  EXPECT_EQ(percentile.GetRelativeRank(50), std::make_pair(0.0, 1.0));
+}
+
+TEST(CountTreePercentileTest, RanksAreExactAtBucketBoundaries) {
+  // 100 buckets of width 1.
+  CountTreePercentile<int64_t> percentile(0, 100, 2, 10);
+  for (int64_t i = 0; i < 100; ++i) {
+    percentile.Add(i);
+  }
+  EXPECT_EQ(percentile.num_values(), 100);
+  EXPECT_EQ(percentile.GetRelativeRank(0), std::make_pair(0.0, 0.0));
+  EXPECT_EQ(percentile.GetRelativeRank(37), std::make_pair(0.37, 0.37));
+  EXPECT_EQ(percentile.GetRelativeRank(100), std::make_pair(1.0, 1.0));
+  // Interpolated within the bucket [37, 38).
+  EXPECT_DOUBLE_EQ(percentile.GetRelativeRank(37.5).first, 0.375);
+}
+
+TEST(CountTreePercentileTest, ClampsInputsToRange) {
+  CountTreePercentile<double> percentile(0, 10, 1, 10);
+  percentile.Add(-5);
+  percentile.Add(15);
+  EXPECT_EQ(percentile.GetRelativeRank(1), std::make_pair(0.5, 0.5));
+  EXPECT_EQ(percentile.GetRelativeRank(9), std::make_pair(0.5, 0.5));
+}
+
+TEST(CountTreePercentileTest, SerializeMerge) {
+  CountTreePercentile<double> percentile1(0, 100, 3, 4);
+  CountTreePercentile<double> percentile2(0, 100, 3, 4);
+  for (int i = 0; i < 10; ++i) {
+    percentile1.Add(i);
+    percentile2.Add(90 + i);
+  }
+  BinarySearchSummary summary;
+  percentile1.SerializeToProto(&summary);
+  ASSERT_OK(percentile2.MergeFromProto(summary));
+  EXPECT_EQ(percentile2.num_values(), 20);
+  EXPECT_EQ(percentile2.GetRelativeRank(50), std::make_pair(0.5, 0.5));
+}
+
+TEST(CountTreePercentileTest, MergeFailsForSketch) {
+  CountTreePercentile<double> percentile(0, 100, 2, 10);
+  BinarySearchSummary summary;
+  summary.mutable_sketch()->add_level()->add_item()->set_float_value(20);
+  EXPECT_THAT(percentile.MergeFromProto(summary),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Cannot merge a quantile sketch summary")));
+}
+
+TEST(CountTreePercentileTest, MergeFailsForDifferentRange) {
+  CountTreePercentile<double> percentile1(0, 100, 2, 10);
+  CountTreePercentile<double> percentile2(0, 200, 2, 10);
+  BinarySearchSummary summary;
+  percentile1.SerializeToProto(&summary);
+  EXPECT_THAT(percentile2.MergeFromProto(summary),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Cannot merge a count tree")));
+}
+
+TEST(CountTreePercentileTest, ValidateParameters) {
+  EXPECT_OK(CountTreePercentile<double>::ValidateParameters(4, 16));
+  EXPECT_THAT(CountTreePercentile<double>::ValidateParameters(2, 1),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Branching factor must be at least 2")));
+  EXPECT_THAT(CountTreePercentile<double>::ValidateParameters(20, 16),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("too many nodes")));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
@@ -16,10 +16,13 @@
 
 #include "algorithms/internal/count-tree.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <utility>
+#include <vector>
 
+#include "absl/numeric/bits.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "proto/summary.pb.h"
@@ -27,14 +30,63 @@
 
 namespace differential_privacy {
 namespace internal {
+namespace {
 
-CountTree::CountTree(int height, int branching_factor)
+// Number of bytes of the varint encoding of value.
+int VarintSize(uint64_t value) {
+  int size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+// Returns log2(x) if x is a power of two, and -1 otherwise.
+int Log2IfPowerOfTwo(int x) {
+  if (x <= 0 || (x & (x - 1)) != 0) {
+    return -1;
+  }
+  return absl::countr_zero(static_cast<unsigned int>(x));
+}
+
+}  // namespace
+
+CountTree::CountTree(int height, int branching_factor,
+                     base::MemoryBudget* memory_budget)
     : height_(height),
       branching_factor_(branching_factor),
+      branching_shift_(Log2IfPowerOfTwo(branching_factor)),
       number_of_nodes_((std::pow(branching_factor_, height_ + 1) - 1) /
                        (branching_factor_ - 1)),
       number_of_leaves_(std::pow(branching_factor_, height_)),
-      left_most_leaf_(number_of_nodes_ - number_of_leaves_) {}
+      left_most_leaf_(number_of_nodes_ - number_of_leaves_),
+      dense_(number_of_nodes_ > 0 && number_of_nodes_ <= kMaxDenseNodes),
+      memory_budget_(memory_budget),
+      memory_(memory_budget != nullptr ? memory_budget
+                                       : std::pmr::get_default_resource()),
+      dense_tree_(&memory_),
+      tree_(&memory_) {
+  int level_start = root_node_;
+  for (int level = 0; level <= height_; ++level) {
+    level_starts_.push_back(level_start);
+    level_start = LeftMostChild(level_start);
+  }
+}
+
+CountTree::CountTree(const CountTree& other)
+    : height_(other.height_),
+      branching_factor_(other.branching_factor_),
+      branching_shift_(other.branching_shift_),
+      number_of_nodes_(other.number_of_nodes_),
+      number_of_leaves_(other.number_of_leaves_),
+      left_most_leaf_(other.left_most_leaf_),
+      level_starts_(other.level_starts_),
+      dense_(other.dense_),
+      memory_budget_(other.memory_budget_),
+      memory_(other.memory_.upstream()),
+      dense_tree_(other.dense_tree_, &memory_),
+      tree_(other.tree_, &memory_) {}
 
 int CountTree::GetLeftMostLeaf() const { return left_most_leaf_; }
 int CountTree::GetNthLeaf(int n) const { return GetLeftMostLeaf() + n; }
@@ -44,16 +96,6 @@ int CountTree::GetBranchingFactor() const { return branching_factor_; }
 int CountTree::GetHeight() const { return height_; }
 int CountTree::GetRoot() const { return root_node_; }
 
-int CountTree::Parent(int nodeIndex) const {
-  return (nodeIndex - 1) / branching_factor_;
-}
-int CountTree::LeftMostChild(int nodeIndex) const {
-  return nodeIndex * branching_factor_ + 1;
-}
-int CountTree::RightMostChild(int nodeIndex) const {
-  return (nodeIndex + 1) * branching_factor_;
-}
-
 bool CountTree::IsLeaf(int nodeIndex) const {
   return nodeIndex >= GetLeftMostLeaf() && nodeIndex < GetNumberOfNodes();
 }
@@ -71,14 +113,53 @@ int CountTree::RightMostInSubtree(int nodeIndex) const {
   return nodeIndex;
 }
 
-void CountTree::IncrementNode(int nodeIndex) { ++tree_[nodeIndex]; }
+void CountTree::IncrementNode(int nodeIndex) {
+  IncrementNodeBy(nodeIndex, 1);
+}
+void CountTree::AllocateDenseOrCompact() {
+  if (memory_budget_ != nullptr && memory_budget_->ShouldCompact()) {
+    dense_ = false;
+  } else {
+    dense_tree_.Resize(number_of_nodes_);
+  }
+}
+
 void CountTree::IncrementNodeBy(int nodeIndex, int64_t increment) {
-  tree_[nodeIndex] += increment;
+  if (dense_ && dense_tree_.empty()) {
+    AllocateDenseOrCompact();
+  }
+  if (dense_) {
+    dense_tree_.Add(nodeIndex, increment);
+  } else {
+    tree_[nodeIndex] += increment;
+  }
 }
 
-void CountTree::ClearNodes() { tree_.clear(); }
+void CountTree::IncrementLeafAndAncestorsBy(int n, int64_t increment) {
+  if (dense_ && dense_tree_.empty()) {
+    AllocateDenseOrCompact();
+  }
+  for (int level = height_; level > 0; --level) {
+    const int node = level_starts_[level] + n;
+    if (dense_) {
+      dense_tree_.Add(node, increment);
+    } else {
+      tree_[node] += increment;
+    }
+    n = branching_shift_ >= 0 ? n >> branching_shift_ : n / branching_factor_;
+  }
+}
+
+void CountTree::ClearNodes() {
+  // Keep the dense array allocated since the tree is likely to be reused.
+  dense_tree_.Clear();
+  tree_.clear();
+}
 
 int64_t CountTree::GetNodeCount(int nodeIndex) const {
+  if (dense_) {
+    return dense_tree_.empty() ? 0 : dense_tree_.Get(nodeIndex);
+  }
   auto node = tree_.find(nodeIndex);
   if (node == tree_.end()) {
     return 0;
@@ -88,7 +169,57 @@ int64_t CountTree::GetNodeCount(int nodeIndex) const {
 
 BoundedQuantilesSummary CountTree::Serialize() {
   BoundedQuantilesSummary to_return;
-  to_return.mutable_quantile_tree()->insert(tree_.begin(), tree_.end());
+
+  // Non-empty nodes in increasing order of index.
+  std::vector<std::pair<int, int64_t>> nodes;
+  if (dense_) {
+    for (int i = 0; i < dense_tree_.size(); ++i) {
+      const int64_t count = dense_tree_.Get(i);
+      if (count != 0) {
+        nodes.emplace_back(i, count);
+      }
+    }
+  } else {
+    nodes.reserve(tree_.size());
+    for (const auto& [node, count] : tree_) {
+      if (count != 0) {
+        nodes.emplace_back(node, count);
+      }
+    }
+    std::sort(nodes.begin(), nodes.end());
+  }
+
+  if (!nodes.empty()) {
+    // Sizes of the packed payloads. The dense encoding spends one byte on
+    // every empty node before the last non-empty one, the sparse encoding
+    // spends the delta of the index on every non-empty node.
+    int64_t dense_size = nodes.back().first + 1;
+    int64_t sparse_size = 0;
+    int previous = 0;
+    for (const auto& [node, count] : nodes) {
+      dense_size += VarintSize(count) - 1;
+      sparse_size += VarintSize(node - previous) + VarintSize(count);
+      previous = node;
+    }
+    if (dense_size <= sparse_size) {
+      auto* dense_tree = to_return.mutable_dense_quantile_tree();
+      dense_tree->Resize(nodes.back().first + 1, 0);
+      for (const auto& [node, count] : nodes) {
+        dense_tree->Set(node, count);
+      }
+    } else {
+      to_return.mutable_sparse_quantile_tree_index_deltas()->Reserve(
+          nodes.size());
+      to_return.mutable_sparse_quantile_tree_counts()->Reserve(nodes.size());
+      previous = 0;
+      for (const auto& [node, count] : nodes) {
+        to_return.add_sparse_quantile_tree_index_deltas(node - previous);
+        to_return.add_sparse_quantile_tree_counts(count);
+        previous = node;
+      }
+    }
+  }
+
   to_return.set_tree_height(height_);
   to_return.set_branching_factor(branching_factor_);
   return to_return;
@@ -99,27 +230,107 @@ absl::Status CountTree::Merge(const BoundedQuantilesSummary& summary) {
     return absl::InternalError(
         "Summary missing height and/or branching factor.");
   }
-  if (summary.tree_height() != height_) {
+  RETURN_IF_ERROR(
+      CheckCompatible(summary.tree_height(), summary.branching_factor()));
+  auto outside_error = [this](int64_t node) {
     return absl::InternalError(
-        absl::StrCat("Height mismatch. Tree had: ", height_,
-                     " but summary had: ", summary.tree_height()));
+        absl::StrCat("Summary contains node ", node,
+                     " which is outside of the tree with ", number_of_nodes_,
+                     " nodes."));
+  };
+
+  // Validate all encodings before changing any count.
+  for (std::pair<int32_t, int64_t> node : summary.quantile_tree()) {
+    if (node.first < 0 || node.first >= number_of_nodes_) {
+      return outside_error(node.first);
+    }
   }
-  if (summary.branching_factor() != branching_factor_) {
-    return absl::InternalError(
-        absl::StrCat("Branching factor mismatch. Tree had: ", branching_factor_,
-                     " but summary had: ", summary.branching_factor()));
+  if (summary.dense_quantile_tree_size() > number_of_nodes_) {
+    return outside_error(summary.dense_quantile_tree_size() - 1);
+  }
+  const int num_sparse_nodes = summary.sparse_quantile_tree_index_deltas_size();
+  if (num_sparse_nodes != summary.sparse_quantile_tree_counts_size()) {
+    return absl::InternalError(absl::StrCat(
+        "Summary contains ", num_sparse_nodes, " sparse node indices but ",
+        summary.sparse_quantile_tree_counts_size(), " sparse node counts."));
   }
+  int64_t sparse_node = 0;
+  for (int i = 0; i < num_sparse_nodes; ++i) {
+    const int32_t delta = summary.sparse_quantile_tree_index_deltas(i);
+    if (delta < 0 || (i > 0 && delta == 0)) {
+      return absl::InternalError(
+          "Summary contains sparse nodes that are not in increasing order.");
+    }
+    sparse_node += delta;
+    if (sparse_node >= number_of_nodes_) {
+      return outside_error(sparse_node);
+    }
+  }
+
   for (std::pair<int32_t, int64_t> node : summary.quantile_tree()) {
-    tree_[node.first] += node.second;
+    IncrementNodeBy(node.first, node.second);
+  }
+  for (int i = 0; i < summary.dense_quantile_tree_size(); ++i) {
+    if (summary.dense_quantile_tree(i) != 0) {
+      IncrementNodeBy(i, summary.dense_quantile_tree(i));
+    }
+  }
+  sparse_node = 0;
+  for (int i = 0; i < num_sparse_nodes; ++i) {
+    sparse_node += summary.sparse_quantile_tree_index_deltas(i);
+    IncrementNodeBy(sparse_node, summary.sparse_quantile_tree_counts(i));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status CountTree::MergeFrom(const CountTree& other) {
+  RETURN_IF_ERROR(CheckCompatible(other.height_, other.branching_factor_));
+  // Trees with the same parameters may still differ in their storage if one
+  // of them was stored sparsely to save memory.
+  if (other.dense_) {
+    if (other.dense_tree_.empty()) {
+      return absl::OkStatus();
+    }
+    if (dense_ && dense_tree_.empty()) {
+      AllocateDenseOrCompact();
+    }
+    if (dense_) {
+      dense_tree_.AddAll(other.dense_tree_);
+    } else {
+      for (int node = 0; node < other.dense_tree_.size(); ++node) {
+        const int64_t count = other.dense_tree_.Get(node);
+        if (count != 0) {
+          tree_[node] += count;
+        }
+      }
+    }
+  } else {
+    for (const auto& [node, count] : other.tree_) {
+      IncrementNodeBy(node, count);
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status CountTree::CheckCompatible(int height,
+                                        int branching_factor) const {
+  if (height != height_) {
+    return absl::InternalError(absl::StrCat(
+        "Height mismatch. Tree had: ", height_, " but summary had: ", height));
+  }
+  if (branching_factor != branching_factor_) {
+    return absl::InternalError(
+        absl::StrCat("Branching factor mismatch. Tree had: ", branching_factor_,
+                     " but summary had: ", branching_factor));
   }
   return absl::OkStatus();
 }
 
 int64_t CountTree::MemoryUsed() {
-  // https://abseil.io/docs/cpp/guides/container#memory-usage
-  return sizeof(CountTree) +
-         (sizeof(std::pair<int, int64_t>) + 1) * tree_.bucket_count();
+  return sizeof(CountTree) + memory_.bytes_allocated();
 }
 
+bool CountTree::IsDense() const { return dense_; }
+
 }  // namespace internal
 }  // namespace differential_privacy
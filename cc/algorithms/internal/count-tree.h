@@ -17,10 +17,20 @@
 #ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COUNT_TREE_H_
 #define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_COUNT_TREE_H_
 
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
 #include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
 #include "absl/status/status.h"
+#include "algorithms/internal/compact-counters.h"
 #include "proto/summary.pb.h"
 #include "base/status_macros.h"
+#include "base/memory_budget.h"
+#include "base/tracking_memory_resource.h"
 
 namespace differential_privacy {
 namespace internal {
@@ -34,13 +44,35 @@ namespace internal {
 // to merge the counts from a serialized tree with identical parameters into the
 // current tree.
 //
+// Trees with at most kMaxDenseNodes nodes store their counts in a dense array
+// that is allocated on the first increment, which makes updates and lookups
+// cheap. The dense counts start out as 16-bit integers and are widened when a
+// count outgrows them (see CompactCounters). Larger trees store only the non-empty nodes in a hash map. The
+// storage is an implementation detail: both produce the same Serialize output
+// and accept the same summaries in Merge.
+//
+// With a memory budget, the tree allocates from the budget, and a tree that
+// would be dense is stored sparsely instead if the budget asks for compact
+// storage when its first count is added. Most trees of a skewed input only
+// hold a few entries, for which the sparse storage is much smaller.
+//
 // This is used as the underlying data structure for implementing quantile
 // trees.
 class CountTree {
  public:
+  // Largest number of nodes for which counts are stored densely (256 KiB of
+  // counts, up to 1 MiB once they need 64 bits). The default quantile tree (height 4, branching factor 16) has
+  // 69905 nodes.
+  static constexpr int kMaxDenseNodes = 1 << 17;
+
   // height is the number of levels in the tree, not including the root.
   // branching_factor is the number of children each node will have.
-  CountTree(int height, int branching_factor);
+  CountTree(int height, int branching_factor,
+            base::MemoryBudget* memory_budget = nullptr);
+
+  // Copies the counts of other.
+  CountTree(const CountTree& other);
+  CountTree& operator=(const CountTree&) = delete;
 
   // Methods for finding a particular node in the tree. Note that the rightmost
   // leaf will be at index LeftMostLeaf() + NumberOfLeaves().
@@ -53,10 +85,21 @@ class CountTree {
   int GetNumberOfNodes() const;
   int GetNumberOfLeaves() const;
 
-  // Methods for navigating the tree from a given node.
-  int Parent(int nodeIndex) const;
-  int LeftMostChild(int nodeIndex) const;
-  int RightMostChild(int nodeIndex) const;
+  // Methods for navigating the tree from a given node. Defined inline since
+  // they are called for every level of every update; they use shifts when the
+  // branching factor is a power of two.
+  int Parent(int nodeIndex) const {
+    return branching_shift_ >= 0 ? (nodeIndex - 1) >> branching_shift_
+                                 : (nodeIndex - 1) / branching_factor_;
+  }
+  int LeftMostChild(int nodeIndex) const {
+    return branching_shift_ >= 0 ? (nodeIndex << branching_shift_) + 1
+                                 : nodeIndex * branching_factor_ + 1;
+  }
+  int RightMostChild(int nodeIndex) const {
+    return branching_shift_ >= 0 ? (nodeIndex + 1) << branching_shift_
+                                 : (nodeIndex + 1) * branching_factor_;
+  }
   int LeftMostInSubtree(int nodeIndex) const;
   int RightMostInSubtree(int nodeIndex) const;
 
@@ -66,28 +109,51 @@ class CountTree {
   void IncrementNode(int nodeIndex);
   void IncrementNodeBy(int nodeIndex, int64_t increment);
 
+  // Adds increment to the count of the n-th leaf and of all its ancestors
+  // except for the root. Equivalent to walking up from GetNthLeaf(n) with
+  // Parent, but the node of every level is found from a table of the first
+  // index of each level.
+  void IncrementLeafAndAncestorsBy(int n, int64_t increment);
+
   // Sets the counts of all nodes to 0.
   void ClearNodes();
 
   // Returns the count of a specified node.
   int64_t GetNodeCount(int nodeIndex) const;
 
-  // Serializes the CountTree to a proto representation.
+  // Serializes the CountTree to a proto representation. The non-empty nodes
+  // are written in the dense or the sparse packed encoding of the summary,
+  // whichever is smaller.
   BoundedQuantilesSummary Serialize();
 
   // Deserializes the proto representation and combines it with the current
-  // CountTree. This will add the counts of each node together.
+  // CountTree. This will add the counts of each node together. Accepts nodes
+  // in any of the encodings of the summary, including the quantile_tree map
+  // written by earlier versions and by other libraries.
   // Returns an error if the summary is malformed, or if the parameters (height
   // and branching factor) of the serialized tree do not match.
   absl::Status Merge(const BoundedQuantilesSummary& summary);
 
-  // Returns an estimate of the current memory footprint of the CountTree,
-  // in bytes.
+  // Adds the counts of another CountTree to this one. Returns an error if the
+  // height or branching factor of the trees do not match.
+  absl::Status MergeFrom(const CountTree& other);
+
+  // Returns the current memory footprint of the CountTree, in bytes. Takes
+  // constant time.
   int64_t MemoryUsed();
 
+  // Returns true if the counts are stored in a dense array.
+  bool IsDense() const;
+
  private:
+  // Returns an error if a tree with the given parameters cannot be merged into
+  // this one.
+  absl::Status CheckCompatible(int height, int branching_factor) const;
+
   const int height_;
   const int branching_factor_;
+  // log2 of the branching factor if it is a power of two, and -1 otherwise.
+  const int branching_shift_;
   // Quantities are all calculated from height and branching factor. Cached
   // to avoid re-calculation.
   const int number_of_nodes_;
@@ -98,9 +164,28 @@ class CountTree {
   const int left_most_leaf_;
   // The index of the root.
   static const int root_node_ = 0;
-  // We store the tree as an unordered map. This gives fast lookups, and means
-  // that we don't need space for empty nodes.
-  absl::flat_hash_map<int, int64_t> tree_;
+  // Index of the first node of each level, with the root at level 0.
+  std::vector<int> level_starts_;
+  // Allocates the dense counts on the first increment, or switches to sparse
+  // storage if the memory budget asks for compact storage.
+  void AllocateDenseOrCompact();
+
+  // Whether dense_tree_ or tree_ holds the counts. Can only change from dense
+  // to sparse before the first increment.
+  bool dense_;
+  // Budget that the counts are allocated from, if any.
+  base::MemoryBudget* const memory_budget_;
+  // Tracks the allocations of dense_tree_ and tree_ for MemoryUsed.
+  base::TrackingMemoryResource memory_;
+  // Counts of all nodes, indexed by node. Empty until the first increment.
+  CompactCounters dense_tree_;
+  // For trees that are too large for dense storage, we store the tree as an
+  // unordered map. This gives fast lookups, and means that we don't need space
+  // for empty nodes.
+  absl::flat_hash_map<
+      int, int64_t, absl::Hash<int>, std::equal_to<int>,
+      std::pmr::polymorphic_allocator<std::pair<const int, int64_t>>>
+      tree_;
 };
 
 }  // namespace internal
@@ -16,16 +16,26 @@
 
 #include "algorithms/internal/count-tree.h"
 
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "base/memory_budget.h"
 #include "base/testing/proto_matchers.h"
 #include "base/testing/status_matchers.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
+#include "proto/summary.pb.h"
 
 namespace differential_privacy {
 namespace internal {
 namespace {
 
+using ::differential_privacy::base::testing::EqualsProto;
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
 using ::testing::HasSubstr;
 using ::differential_privacy::base::testing::StatusIs;
 
@@ -73,6 +83,40 @@ TEST(CountTreeTest, ParentChildExamples) {
   EXPECT_EQ(test.Parent(2), 0);
 }
 
+TEST(CountTreeTest, ParentChildInversePowerOfTwoBranching) {
+  CountTree test(4, 8);
+  for (int i = 0; i < test.GetLeftMostLeaf(); ++i) {
+    EXPECT_EQ(test.LeftMostChild(i), i * 8 + 1);
+    EXPECT_EQ(test.RightMostChild(i), i * 8 + 8);
+    for (int child = test.LeftMostChild(i); child <= test.RightMostChild(i);
+         ++child) {
+      EXPECT_EQ(test.Parent(child), i);
+    }
+  }
+}
+
+TEST(CountTreeTest, IncrementLeafAndAncestorsMatchesWalkingUp) {
+  // The larger trees store their counts sparsely.
+  for (const auto& [height, branching_factor] :
+       std::vector<std::pair<int, int>>{{3, 4}, {3, 5}, {5, 16}, {7, 7}}) {
+    CountTree expected(height, branching_factor);
+    CountTree actual(height, branching_factor);
+    const int num_leaves = expected.GetNumberOfLeaves();
+    for (int n : {0, 1, num_leaves / 3, num_leaves / 2, num_leaves - 1}) {
+      for (int node = expected.GetNthLeaf(n); node != expected.GetRoot();
+           node = expected.Parent(node)) {
+        expected.IncrementNodeBy(node, n + 2);
+      }
+      actual.IncrementLeafAndAncestorsBy(n, n + 2);
+    }
+    for (int node = 0; node < expected.GetNumberOfNodes(); ++node) {
+      ASSERT_EQ(actual.GetNodeCount(node), expected.GetNodeCount(node))
+          << "node " << node << " of a tree of height " << height
+          << " and branching factor " << branching_factor;
+    }
+  }
+}
+
 TEST(CountTreeTest, IsLeaf) {
   CountTree test(3, 5);
   EXPECT_FALSE(test.IsLeaf(0));
@@ -145,6 +189,39 @@ TEST(CountTreeTest, MisatchMergeFails) {
               StatusIs(absl::StatusCode::kInternal, HasSubstr("Branching")));
 }
 
+TEST(CountTreeTest, MergeFromAddsCounts) {
+  // Dense and sparse trees.
+  for (int height : {3, 5}) {
+    CountTree test1(height, 16);
+    test1.IncrementNode(1);
+    test1.IncrementNodeBy(8, 2);
+
+    CountTree test2(height, 16);
+    test2.IncrementNode(8);
+    test2.IncrementNode(10);
+    EXPECT_OK(test2.MergeFrom(test1));
+
+    EXPECT_EQ(test2.GetNodeCount(1), 1);
+    EXPECT_EQ(test2.GetNodeCount(8), 3);
+    EXPECT_EQ(test2.GetNodeCount(10), 1);
+    EXPECT_EQ(test1.GetNodeCount(10), 0);
+
+    // Merging an empty tree does not change anything.
+    EXPECT_OK(test2.MergeFrom(CountTree(height, 16)));
+    EXPECT_EQ(test2.GetNodeCount(8), 3);
+  }
+}
+
+TEST(CountTreeTest, MismatchMergeFromFails) {
+  CountTree standard(3, 5);
+  CountTree shorter(2, 5);
+  CountTree wider(3, 6);
+  EXPECT_THAT(shorter.MergeFrom(standard),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("Height")));
+  EXPECT_THAT(wider.MergeFrom(standard),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("Branching")));
+}
+
 TEST(CountTreeTest, ClearNodes) {
   CountTree test1(3, 5);
   test1.IncrementNode(1);
@@ -163,6 +240,241 @@ TEST(CountTreeTest, ClearNodes) {
   }
 }
 
+TEST(CountTreeTest, StorageDependsOnNumberOfNodes) {
+  EXPECT_TRUE(CountTree(4, 16).IsDense());
+  EXPECT_FALSE(CountTree(5, 16).IsDense());
+}
+
+TEST(CountTreeTest, DenseAndSparseTreesSerializeIdentically) {
+  // Same branching factor and leaves, but only the smaller tree is dense.
+  CountTree dense(4, 16);
+  CountTree sparse(5, 16);
+  ASSERT_TRUE(dense.IsDense());
+  ASSERT_FALSE(sparse.IsDense());
+  for (int node : {0, 1, 17, 300, 69904}) {
+    dense.IncrementNodeBy(node, node + 1);
+    sparse.IncrementNodeBy(node, node + 1);
+  }
+
+  BoundedQuantilesSummary dense_summary = dense.Serialize();
+  BoundedQuantilesSummary sparse_summary = sparse.Serialize();
+  EXPECT_THAT(dense_summary.sparse_quantile_tree_index_deltas(),
+              ElementsAre(0, 1, 16, 283, 69604));
+  EXPECT_THAT(dense_summary.sparse_quantile_tree_counts(),
+              ElementsAre(1, 2, 18, 301, 69905));
+  EXPECT_THAT(
+      sparse_summary.sparse_quantile_tree_index_deltas(),
+      ElementsAreArray(dense_summary.sparse_quantile_tree_index_deltas()));
+  EXPECT_THAT(sparse_summary.sparse_quantile_tree_counts(),
+              ElementsAreArray(dense_summary.sparse_quantile_tree_counts()));
+}
+
+TEST(CountTreeTest, SerializeUsesDenseEncodingForPopulatedTrees) {
+  CountTree test(2, 4);
+  for (int node = 0; node < test.GetNumberOfNodes(); node += 2) {
+    test.IncrementNodeBy(node, node);
+  }
+  test.IncrementNode(1);
+
+  BoundedQuantilesSummary summary = test.Serialize();
+
+  EXPECT_EQ(summary.quantile_tree_size(), 0);
+  EXPECT_EQ(summary.sparse_quantile_tree_index_deltas_size(), 0);
+  ASSERT_EQ(summary.dense_quantile_tree_size(), 21);
+  for (int node = 0; node < test.GetNumberOfNodes(); ++node) {
+    EXPECT_EQ(summary.dense_quantile_tree(node), test.GetNodeCount(node));
+  }
+}
+
+TEST(CountTreeTest, SerializeOmitsEmptyNodes) {
+  CountTree test(2, 4);
+  EXPECT_THAT(test.Serialize(), EqualsProto(R"pb(tree_height: 2
+                                                 branching_factor: 4)pb"));
+}
+
+TEST(CountTreeTest, MergeAddsAllEncodings) {
+  CountTree test(2, 4);
+  BoundedQuantilesSummary summary;
+  summary.set_tree_height(2);
+  summary.set_branching_factor(4);
+  (*summary.mutable_quantile_tree())[3] = 1;
+  summary.add_dense_quantile_tree(0);
+  summary.add_dense_quantile_tree(5);
+  summary.add_dense_quantile_tree(0);
+  summary.add_dense_quantile_tree(2);
+  summary.add_sparse_quantile_tree_index_deltas(1);
+  summary.add_sparse_quantile_tree_counts(7);
+  summary.add_sparse_quantile_tree_index_deltas(19);
+  summary.add_sparse_quantile_tree_counts(4);
+
+  EXPECT_OK(test.Merge(summary));
+
+  EXPECT_EQ(test.GetNodeCount(0), 0);
+  EXPECT_EQ(test.GetNodeCount(1), 12);
+  EXPECT_EQ(test.GetNodeCount(3), 3);
+  EXPECT_EQ(test.GetNodeCount(20), 4);
+}
+
+TEST(CountTreeTest, MergeMalformedPackedNodesFails) {
+  CountTree test(2, 4);
+  BoundedQuantilesSummary empty = test.Serialize();
+
+  BoundedQuantilesSummary dense = empty;
+  dense.mutable_dense_quantile_tree()->Resize(22, 1);
+  EXPECT_THAT(test.Merge(dense),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("outside")));
+
+  BoundedQuantilesSummary mismatched = empty;
+  mismatched.add_sparse_quantile_tree_index_deltas(1);
+  EXPECT_THAT(test.Merge(mismatched),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("sparse node")));
+
+  BoundedQuantilesSummary unordered = empty;
+  for (int delta : {2, 0}) {
+    unordered.add_sparse_quantile_tree_index_deltas(delta);
+    unordered.add_sparse_quantile_tree_counts(1);
+  }
+  EXPECT_THAT(test.Merge(unordered),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("order")));
+
+  BoundedQuantilesSummary outside = empty;
+  for (int delta : {20, 1}) {
+    outside.add_sparse_quantile_tree_index_deltas(delta);
+    outside.add_sparse_quantile_tree_counts(1);
+  }
+  EXPECT_THAT(test.Merge(outside),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("outside")));
+
+  // Failed merges do not change any count.
+  for (int node = 0; node < test.GetNumberOfNodes(); ++node) {
+    EXPECT_EQ(test.GetNodeCount(node), 0);
+  }
+}
+
+TEST(CountTreeTest, DenseSerializeMergeRoundTrips) {
+  CountTree test1(4, 16);
+  test1.IncrementNode(3);
+  test1.IncrementNodeBy(69904, 7);
+
+  CountTree test2(4, 16);
+  test2.IncrementNode(3);
+  EXPECT_OK(test2.Merge(test1.Serialize()));
+
+  EXPECT_EQ(test2.GetNodeCount(3), 2);
+  EXPECT_EQ(test2.GetNodeCount(69904), 7);
+  EXPECT_EQ(test2.GetNodeCount(4), 0);
+}
+
+TEST(CountTreeTest, MergeOutOfRangeNodeFails) {
+  for (int height : {3, 5}) {
+    CountTree test(height, 16);
+    BoundedQuantilesSummary summary = test.Serialize();
+    (*summary.mutable_quantile_tree())[test.GetNumberOfNodes()] = 1;
+    EXPECT_THAT(test.Merge(summary),
+                StatusIs(absl::StatusCode::kInternal, HasSubstr("outside")));
+    (*summary.mutable_quantile_tree()).clear();
+    (*summary.mutable_quantile_tree())[-1] = 1;
+    EXPECT_THAT(test.Merge(summary),
+                StatusIs(absl::StatusCode::kInternal, HasSubstr("outside")));
+  }
+}
+
+TEST(CountTreeTest, DenseStorageIsAllocatedOnFirstIncrement) {
+  CountTree empty(4, 16);
+  CountTree once(4, 16);
+  once.IncrementNode(1);
+
+  EXPECT_LT(empty.MemoryUsed(), 1000);
+  EXPECT_GE(once.MemoryUsed(), once.GetNumberOfNodes() * sizeof(int16_t));
+  once.ClearNodes();
+  EXPECT_EQ(once.GetNodeCount(1), 0);
+}
+
+TEST(CountTreeTest, MemoryUsedIsExact) {
+  CountTree dense(4, 16);
+  EXPECT_EQ(dense.MemoryUsed(), sizeof(CountTree));
+  dense.IncrementNode(1);
+  // Small counts take 16 bits each, and are widened once they overflow.
+  EXPECT_EQ(dense.MemoryUsed(),
+            sizeof(CountTree) + dense.GetNumberOfNodes() * sizeof(int16_t));
+  dense.IncrementNodeBy(2, int64_t{1} << 40);
+  EXPECT_EQ(dense.MemoryUsed(),
+            sizeof(CountTree) + dense.GetNumberOfNodes() * sizeof(int64_t));
+  EXPECT_EQ(dense.GetNodeCount(1), 1);
+  EXPECT_EQ(dense.GetNodeCount(2), int64_t{1} << 40);
+
+  CountTree sparse(20, 16);
+  EXPECT_EQ(sparse.MemoryUsed(), sizeof(CountTree));
+  for (int i = 0; i < 1000; ++i) {
+    sparse.IncrementNode(i);
+  }
+  EXPECT_GT(sparse.MemoryUsed(), sizeof(CountTree) + 1000 * sizeof(int64_t));
+  sparse.ClearNodes();
+  sparse.IncrementNode(1);
+  EXPECT_LT(sparse.MemoryUsed(), sizeof(CountTree) + 1000 * sizeof(int64_t));
+}
+
+TEST(CountTreeTest, CopyTracksItsOwnMemory) {
+  CountTree tree(4, 16);
+  tree.IncrementNode(1);
+  tree.IncrementNode(5);
+
+  CountTree copy(tree);
+  tree.ClearNodes();
+
+  EXPECT_EQ(copy.GetNodeCount(1), 1);
+  EXPECT_EQ(copy.GetNodeCount(5), 1);
+  EXPECT_EQ(copy.MemoryUsed(),
+            sizeof(CountTree) + copy.GetNumberOfNodes() * sizeof(int16_t));
+}
+
+TEST(CountTreeTest, AllocatesFromMemoryBudget) {
+  base::MemoryBudget budget(/*limit=*/1 << 30);
+  {
+    CountTree tree(4, 16, &budget);
+    tree.IncrementNode(1);
+
+    EXPECT_TRUE(tree.IsDense());
+    EXPECT_EQ(budget.bytes_used(), tree.MemoryUsed() - sizeof(CountTree));
+  }
+  EXPECT_EQ(budget.bytes_used(), 0);
+}
+
+TEST(CountTreeTest, StoresSparselyWhenBudgetShouldCompact) {
+  base::MemoryBudget budget(/*limit=*/1000, /*compact_fraction=*/0.5);
+  budget.Charge(500);
+  CountTree compact(4, 16, &budget);
+  CountTree dense(4, 16);
+  compact.IncrementLeafAndAncestorsBy(7, 2);
+  dense.IncrementLeafAndAncestorsBy(7, 2);
+
+  EXPECT_FALSE(compact.IsDense());
+  EXPECT_LT(compact.MemoryUsed(), dense.MemoryUsed());
+  EXPECT_THAT(compact.Serialize(), EqualsProto(dense.Serialize()));
+}
+
+TEST(CountTreeTest, MergeFromAcrossStorages) {
+  base::MemoryBudget budget(/*limit=*/1000, /*compact_fraction=*/0.5);
+  budget.Charge(500);
+  CountTree sparse(4, 16, &budget);
+  sparse.IncrementNodeBy(3, 4);
+  CountTree dense(4, 16);
+  dense.IncrementNodeBy(3, 1);
+  dense.IncrementNodeBy(20, 2);
+  ASSERT_FALSE(sparse.IsDense());
+  ASSERT_TRUE(dense.IsDense());
+
+  CountTree sparse_copy(sparse);
+  ASSERT_OK(sparse.MergeFrom(dense));
+  ASSERT_OK(dense.MergeFrom(sparse_copy));
+
+  EXPECT_EQ(sparse.GetNodeCount(3), 5);
+  EXPECT_EQ(sparse.GetNodeCount(20), 2);
+  EXPECT_EQ(dense.GetNodeCount(3), 5);
+  EXPECT_EQ(dense.GetNodeCount(20), 2);
+  EXPECT_TRUE(dense.IsDense());
+}
+
 }  // namespace
 }  // namespace internal
 }  // namespace differential_privacy
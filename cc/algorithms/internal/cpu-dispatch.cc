@@ -0,0 +1,109 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/cpu-dispatch.h"
+
+#include <atomic>
+#include <cstdlib>
+
+#include "absl/strings/string_view.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+// The forced instruction set, or -1.
+std::atomic<int> forced_isa{-1};
+
+Isa Detect() {
+#if defined(DP_CPU_DISPATCH_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return Isa::kAvx512;
+  if (__builtin_cpu_supports("avx2")) return Isa::kAvx2;
+  return Isa::kScalar;
+#elif defined(DP_CPU_DISPATCH_NEON)
+  return Isa::kNeon;
+#else
+  return Isa::kScalar;
+#endif
+}
+
+// Forces the instruction set named by the DP_FORCE_ISA environment variable,
+// if set, so that benchmarks can compare kernels without code changes.
+bool ForceIsaFromEnvironment() {
+  const char* name = std::getenv("DP_FORCE_ISA");
+  if (name == nullptr) return false;
+  for (int i = 0; i < kNumIsas; ++i) {
+    if (IsaName(static_cast<Isa>(i)) == name) {
+      return ForceIsa(static_cast<Isa>(i));
+    }
+  }
+  return false;
+}
+
+const bool forced_from_environment = ForceIsaFromEnvironment();
+
+}  // namespace
+
+absl::string_view IsaName(Isa isa) {
+  switch (isa) {
+    case Isa::kScalar:
+      return "scalar";
+    case Isa::kNeon:
+      return "neon";
+    case Isa::kAvx2:
+      return "avx2";
+    case Isa::kAvx512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+Isa DetectedIsa() {
+  static const Isa isa = Detect();
+  return isa;
+}
+
+bool IsIsaSupported(Isa isa) {
+  const Isa detected = DetectedIsa();
+  switch (isa) {
+    case Isa::kScalar:
+      return true;
+    case Isa::kNeon:
+      return detected == Isa::kNeon;
+    case Isa::kAvx2:
+    case Isa::kAvx512:
+      // AVX-512 CPUs support AVX2 too.
+      return detected != Isa::kNeon && isa <= detected;
+  }
+  return false;
+}
+
+Isa ActiveIsa() {
+  const int forced = forced_isa.load(std::memory_order_relaxed);
+  return forced < 0 ? DetectedIsa() : static_cast<Isa>(forced);
+}
+
+bool ForceIsa(Isa isa) {
+  if (!IsIsaSupported(isa)) return false;
+  forced_isa.store(static_cast<int>(isa), std::memory_order_relaxed);
+  return true;
+}
+
+void ClearForcedIsa() { forced_isa.store(-1, std::memory_order_relaxed); }
+
+}  // namespace internal
+}  // namespace differential_privacy
@@ -0,0 +1,115 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_CPU_DISPATCH_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_CPU_DISPATCH_H_
+
+#include <array>
+#include <atomic>
+
+#include "absl/strings/string_view.h"
+
+// Kernels for x86-64 are compiled for AVX2 and AVX-512 with these target
+// attributes, whatever the flags of the library, and only called on CPUs that
+// support them. On aarch64, NEON is always available.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DP_CPU_DISPATCH_X86 1
+#define DP_TARGET_AVX2 __attribute__((target("avx2")))
+#define DP_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define DP_CPU_DISPATCH_NEON 1
+#endif
+
+namespace differential_privacy {
+namespace internal {
+
+// Instruction sets that kernels can be specialized for, from the narrowest to
+// the widest.
+enum class Isa { kScalar, kNeon, kAvx2, kAvx512 };
+
+inline constexpr int kNumIsas = static_cast<int>(Isa::kAvx512) + 1;
+
+absl::string_view IsaName(Isa isa);
+
+// Returns the widest instruction set of the CPU, as detected by CPUID on
+// x86-64, that the library has kernels for.
+Isa DetectedIsa();
+
+// Returns true if the CPU can run kernels for the instruction set.
+bool IsIsaSupported(Isa isa);
+
+// Returns the instruction set that kernels use: the forced one, if any, and
+// the detected one otherwise.
+Isa ActiveIsa();
+
+// Makes kernels use the instruction set, e.g., to compare the kernels in
+// benchmarks. Returns false and changes nothing if the CPU does not support
+// it. Kernels without a variant for the instruction set use the widest
+// narrower one. Setting the environment variable DP_FORCE_ISA to the name of
+// an instruction set, e.g., DP_FORCE_ISA=avx2, forces it at startup.
+bool ForceIsa(Isa isa);
+
+// Makes kernels use the detected instruction set again.
+void ClearForcedIsa();
+
+// Variants of a kernel for several instruction sets, of which calls use the
+// one for ActiveIsa(). Fn is a function pointer type. Variants are registered
+// once, e.g., in a function-local static, and looked up with an atomic load
+// per call.
+//
+// Example:
+//   using SumFn = double (*)(const double*, size_t);
+//   const KernelDispatch<SumFn>& SumKernel() {
+//     static const KernelDispatch<SumFn> kernel =
+//         KernelDispatch<SumFn>(&ScalarSum)
+//             .Register(Isa::kAvx2, &Avx2Sum)
+//             .Register(Isa::kAvx512, &Avx512Sum);
+//     return kernel;
+//   }
+//   double sum = SumKernel().Get()(data, size);
+template <typename Fn>
+class KernelDispatch {
+ public:
+  explicit KernelDispatch(Fn scalar) {
+    variants_.fill(nullptr);
+    variants_[static_cast<int>(Isa::kScalar)] = scalar;
+  }
+
+  // Registers the variant for the instruction set, which must be one of the
+  // build, i.e., AVX2 or AVX-512 with DP_CPU_DISPATCH_X86, and NEON with
+  // DP_CPU_DISPATCH_NEON.
+  KernelDispatch& Register(Isa isa, Fn variant) {
+    variants_[static_cast<int>(isa)] = variant;
+    return *this;
+  }
+
+  // Returns the variant for the active instruction set, or for the widest
+  // narrower one that has a variant.
+  Fn Get() const {
+    for (int i = static_cast<int>(ActiveIsa()); i > 0; --i) {
+      if (variants_[i] != nullptr) return variants_[i];
+    }
+    return variants_[static_cast<int>(Isa::kScalar)];
+  }
+
+ private:
+  std::array<Fn, kNumIsas> variants_;
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_CPU_DISPATCH_H_
@@ -0,0 +1,92 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/cpu-dispatch.h"
+
+#include "gtest/gtest.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+int Scalar() { return 0; }
+int Avx2() { return 2; }
+int Avx512() { return 3; }
+
+using KernelFn = int (*)();
+
+// Runs every test with the detected instruction set, also if DP_FORCE_ISA is
+// set.
+class CpuDispatchTest : public ::testing::Test {
+ protected:
+  CpuDispatchTest() { ClearForcedIsa(); }
+  ~CpuDispatchTest() override { ClearForcedIsa(); }
+};
+
+TEST_F(CpuDispatchTest, ScalarIsAlwaysSupported) {
+  EXPECT_TRUE(IsIsaSupported(Isa::kScalar));
+  EXPECT_TRUE(IsIsaSupported(DetectedIsa()));
+  EXPECT_EQ(ActiveIsa(), DetectedIsa());
+}
+
+TEST_F(CpuDispatchTest, ForceIsa) {
+  EXPECT_TRUE(ForceIsa(Isa::kScalar));
+  EXPECT_EQ(ActiveIsa(), Isa::kScalar);
+  ClearForcedIsa();
+  EXPECT_EQ(ActiveIsa(), DetectedIsa());
+}
+
+TEST_F(CpuDispatchTest, CannotForceUnsupportedIsa) {
+  for (Isa isa : {Isa::kNeon, Isa::kAvx2, Isa::kAvx512}) {
+    if (!IsIsaSupported(isa)) {
+      EXPECT_FALSE(ForceIsa(isa)) << IsaName(isa);
+      EXPECT_EQ(ActiveIsa(), DetectedIsa());
+    }
+  }
+}
+
+TEST_F(CpuDispatchTest, GetsVariantOfActiveIsa) {
+  const KernelDispatch<KernelFn> kernel = KernelDispatch<KernelFn>(&Scalar)
+                                              .Register(Isa::kAvx2, &Avx2)
+                                              .Register(Isa::kAvx512, &Avx512);
+  ASSERT_TRUE(ForceIsa(Isa::kScalar));
+  EXPECT_EQ(kernel.Get()(), 0);
+  if (ForceIsa(Isa::kAvx2)) {
+    EXPECT_EQ(kernel.Get()(), 2);
+  }
+  if (ForceIsa(Isa::kAvx512)) {
+    EXPECT_EQ(kernel.Get()(), 3);
+  }
+}
+
+TEST_F(CpuDispatchTest, FallsBackToNarrowerVariant) {
+  const KernelDispatch<KernelFn> kernel =
+      KernelDispatch<KernelFn>(&Scalar).Register(Isa::kAvx2, &Avx2);
+  if (ForceIsa(Isa::kAvx512)) {
+    EXPECT_EQ(kernel.Get()(), 2);
+  }
+  const KernelDispatch<KernelFn> scalar_only(&Scalar);
+  EXPECT_EQ(scalar_only.Get()(), 0);
+}
+
+TEST_F(CpuDispatchTest, IsaNames) {
+  EXPECT_EQ(IsaName(Isa::kScalar), "scalar");
+  EXPECT_EQ(IsaName(Isa::kAvx512), "avx512");
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
@@ -0,0 +1,97 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/gaussian-stddev-cache.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/log/check.h"
+#include "absl/synchronization/mutex.h"
+#include "algorithms/internal/gaussian-stddev-calculator.h"
+
+namespace differential_privacy {
+namespace internal {
+
+GaussianStddevCache::GaussianStddevCache(size_t capacity)
+    : capacity_(capacity) {
+  CHECK_GT(capacity, 0);
+}
+
+GaussianStddevCache& GaussianStddevCache::GetInstance() {
+  static auto* kInstance = new GaussianStddevCache(kDefaultCapacity);
+  return *kInstance;
+}
+
+double GaussianStddevCache::CalculateGaussianStddev(double epsilon,
+                                                    double delta,
+                                                    double l2_sensitivity) {
+  if (std::isnan(epsilon) || std::isnan(delta) || std::isnan(l2_sensitivity)) {
+    // NaN keys never compare equal and thus could never be looked up.
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return internal::CalculateGaussianStddev(epsilon, delta, l2_sensitivity);
+  }
+  const Key key{epsilon, delta, l2_sensitivity};
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second);
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return it->second->second;
+    }
+  }
+
+  // Calibrate without holding the lock. Concurrent misses for the same key
+  // compute the same value, so whichever finishes first wins.
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  const double stddev =
+      internal::CalculateGaussianStddev(epsilon, delta, l2_sensitivity);
+
+  absl::MutexLock lock(&mutex_);
+  if (index_.contains(key)) {
+    return stddev;
+  }
+  lru_.emplace_front(key, stddev);
+  index_.emplace(key, lru_.begin());
+  if (lru_.size() > capacity_) {
+    index_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+  return stddev;
+}
+
+GaussianStddevCache::Stats GaussianStddevCache::GetStats() const {
+  return Stats{hits_.load(std::memory_order_relaxed),
+               misses_.load(std::memory_order_relaxed)};
+}
+
+size_t GaussianStddevCache::Size() const {
+  absl::MutexLock lock(&mutex_);
+  return lru_.size();
+}
+
+void GaussianStddevCache::Clear() {
+  absl::MutexLock lock(&mutex_);
+  lru_.clear();
+  index_.clear();
+  hits_.store(0, std::memory_order_relaxed);
+  misses_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
@@ -0,0 +1,108 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_GAUSSIAN_STDDEV_CACHE_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_GAUSSIAN_STDDEV_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// Thread-safe, bounded LRU cache of Gaussian standard deviations calibrated by
+// CalculateGaussianStddev. Calibration runs a numerical search over
+// CalculateDeltaForGaussianStddev, and callers frequently build many
+// mechanisms with identical (epsilon, delta, l2_sensitivity), e.g., one per
+// partition and metric. The cache returns exactly the value that
+// CalculateGaussianStddev would return for the same parameters.
+class GaussianStddevCache {
+ public:
+  // Default number of parameter triples retained by GetInstance().
+  static constexpr size_t kDefaultCapacity = 1024;
+
+  struct Stats {
+    int64_t hits;
+    int64_t misses;
+  };
+
+  // capacity is the maximum number of cached entries and must be positive.
+  explicit GaussianStddevCache(size_t capacity);
+
+  GaussianStddevCache(const GaussianStddevCache&) = delete;
+  GaussianStddevCache& operator=(const GaussianStddevCache&) = delete;
+
+  // Returns the process-wide cache used by GaussianMechanism.
+  static GaussianStddevCache& GetInstance();
+
+  // Returns CalculateGaussianStddev(epsilon, delta, l2_sensitivity), computing
+  // it only if the parameters are not cached yet. NaN parameters bypass the
+  // cache.
+  double CalculateGaussianStddev(double epsilon, double delta,
+                                 double l2_sensitivity)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the number of cache hits and misses since construction or the last
+  // call to Clear().
+  Stats GetStats() const;
+
+  // Returns the number of cached entries.
+  size_t Size() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Removes all entries and resets the statistics.
+  void Clear() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Key {
+    double epsilon;
+    double delta;
+    double l2_sensitivity;
+
+    bool operator==(const Key& other) const {
+      return epsilon == other.epsilon && delta == other.delta &&
+             l2_sensitivity == other.l2_sensitivity;
+    }
+
+    template <typename H>
+    friend H AbslHashValue(H h, const Key& key) {
+      return H::combine(std::move(h), key.epsilon, key.delta,
+                        key.l2_sensitivity);
+    }
+  };
+
+  using Entry = std::pair<Key, double>;
+
+  const size_t capacity_;
+  mutable absl::Mutex mutex_;
+  // Most recently used entries are at the front.
+  std::list<Entry> lru_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<Key, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+  std::atomic<int64_t> hits_{0};
+  std::atomic<int64_t> misses_{0};
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_GAUSSIAN_STDDEV_CACHE_H_
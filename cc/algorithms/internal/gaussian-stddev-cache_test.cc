@@ -0,0 +1,110 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/gaussian-stddev-cache.h"
+
+#include <cmath>
+#include <limits>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "algorithms/internal/gaussian-stddev-calculator.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using ::testing::Eq;
+
+TEST(GaussianStddevCacheTest, ReturnsCalibratedStddev) {
+  GaussianStddevCache cache(/*capacity=*/4);
+  EXPECT_EQ(cache.CalculateGaussianStddev(std::log(3), 1e-7, 1.2),
+            CalculateGaussianStddev(std::log(3), 1e-7, 1.2));
+  // Second lookup is served from the cache and returns the same value.
+  EXPECT_EQ(cache.CalculateGaussianStddev(std::log(3), 1e-7, 1.2),
+            CalculateGaussianStddev(std::log(3), 1e-7, 1.2));
+}
+
+TEST(GaussianStddevCacheTest, CountsHitsAndMisses) {
+  GaussianStddevCache cache(/*capacity=*/4);
+  cache.CalculateGaussianStddev(1.0, 1e-5, 1.0);
+  cache.CalculateGaussianStddev(1.0, 1e-5, 1.0);
+  cache.CalculateGaussianStddev(1.0, 1e-5, 1.0);
+  cache.CalculateGaussianStddev(2.0, 1e-5, 1.0);
+
+  GaussianStddevCache::Stats stats = cache.GetStats();
+  EXPECT_THAT(stats.hits, Eq(2));
+  EXPECT_THAT(stats.misses, Eq(2));
+  EXPECT_THAT(cache.Size(), Eq(2));
+
+  cache.Clear();
+  stats = cache.GetStats();
+  EXPECT_THAT(stats.hits, Eq(0));
+  EXPECT_THAT(stats.misses, Eq(0));
+  EXPECT_THAT(cache.Size(), Eq(0));
+}
+
+TEST(GaussianStddevCacheTest, EvictsLeastRecentlyUsedEntry) {
+  GaussianStddevCache cache(/*capacity=*/2);
+  cache.CalculateGaussianStddev(1.0, 1e-5, 1.0);  // miss
+  cache.CalculateGaussianStddev(2.0, 1e-5, 1.0);  // miss
+  cache.CalculateGaussianStddev(1.0, 1e-5, 1.0);  // hit, 2.0 is now the LRU
+  cache.CalculateGaussianStddev(3.0, 1e-5, 1.0);  // miss, evicts 2.0
+  EXPECT_THAT(cache.Size(), Eq(2));
+
+  cache.CalculateGaussianStddev(1.0, 1e-5, 1.0);  // hit
+  cache.CalculateGaussianStddev(2.0, 1e-5, 1.0);  // miss
+  GaussianStddevCache::Stats stats = cache.GetStats();
+  EXPECT_THAT(stats.hits, Eq(2));
+  EXPECT_THAT(stats.misses, Eq(4));
+}
+
+TEST(GaussianStddevCacheTest, NanParametersBypassCache) {
+  GaussianStddevCache cache(/*capacity=*/2);
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  cache.CalculateGaussianStddev(nan, 1e-5, 1.0);
+  cache.CalculateGaussianStddev(nan, 1e-5, 1.0);
+  EXPECT_THAT(cache.Size(), Eq(0));
+  EXPECT_THAT(cache.GetStats().misses, Eq(2));
+}
+
+TEST(GaussianStddevCacheTest, IsThreadSafe) {
+  GaussianStddevCache cache(/*capacity=*/8);
+  constexpr int kNumThreads = 8;
+  constexpr int kLookupsPerThread = 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&cache]() {
+      for (int i = 0; i < kLookupsPerThread; ++i) {
+        const double epsilon = 0.5 + (i % 16) * 0.1;
+        EXPECT_EQ(cache.CalculateGaussianStddev(epsilon, 1e-6, 1.0),
+                  CalculateGaussianStddev(epsilon, 1e-6, 1.0));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  GaussianStddevCache::Stats stats = cache.GetStats();
+  EXPECT_THAT(stats.hits + stats.misses, Eq(kNumThreads * kLookupsPerThread));
+  EXPECT_THAT(cache.Size(), Eq(8));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
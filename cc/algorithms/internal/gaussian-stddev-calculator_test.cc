@@ -16,6 +16,8 @@
 
 #include "algorithms/internal/gaussian-stddev-calculator.h"
 
+#include <cmath>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -59,6 +61,25 @@ TEST(GaussianStddevCalculator,
               Le(Theorem1Stddev(epsilon, delta, l2_sensitivity)));
 }
 
+TEST(GaussianStddevCalculatorTest, CalculateGaussianStddevIsTight) {
+  for (double epsilon : {0.01, 0.5, std::log(3), 5.0, 20.0}) {
+    for (double delta : {1e-3, 1e-7, 1e-12, 1e-40}) {
+      for (double l2_sensitivity : {0.1, 1.0, 7.5}) {
+        const double stddev =
+            CalculateGaussianStddev(epsilon, delta, l2_sensitivity);
+        EXPECT_THAT(
+            CalculateDeltaForGaussianStddev(epsilon, l2_sensitivity, stddev),
+            Le(delta));
+        EXPECT_THAT(CalculateDeltaForGaussianStddev(epsilon, l2_sensitivity,
+                                                    stddev * (1 - 2e-9)),
+                    Gt(delta))
+            << "epsilon=" << epsilon << " delta=" << delta
+            << " l2_sensitivity=" << l2_sensitivity;
+      }
+    }
+  }
+}
+
 TEST(GaussianStddevCalculatorTest,
      CalculateDeltaForGaussianStddevReturnsPositiveValue) {
   const double epsilon = std::log(3);
@@ -0,0 +1,144 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_LOCK_FREE_RING_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_LOCK_FREE_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace differential_privacy {
+namespace internal {
+
+// Bounded first-in first-out queue of trivially copyable values that any
+// number of threads push to and pop from without taking a lock. Every pushed
+// value is popped exactly once. The capacity is rounded up to a power of two.
+//
+// Each slot carries a sequence number that tells whether it is ready to be
+// written or read in the current lap around the ring, so a push or pop
+// succeeds with a single compare-and-swap on the position when there is no
+// contention (see Dmitry Vyukov's bounded MPMC queue).
+template <typename T>
+class LockFreeRing {
+ public:
+  static_assert(std::is_trivially_copyable_v<T>,
+                "LockFreeRing only holds trivially copyable values.");
+
+  explicit LockFreeRing(int capacity)
+      : mask_(RoundUpToPowerOfTwo(capacity) - 1),
+        slots_(new Slot[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  LockFreeRing(const LockFreeRing&) = delete;
+  LockFreeRing& operator=(const LockFreeRing&) = delete;
+
+  // Appends value and returns true, or returns false if the ring is full.
+  bool TryPush(T value) {
+    size_t position = push_position_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[position & mask_];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t lap = static_cast<intptr_t>(sequence) -
+                           static_cast<intptr_t>(position);
+      if (lap == 0) {
+        if (push_position_.compare_exchange_weak(position, position + 1,
+                                                 std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lap < 0) {
+        return false;
+      } else {
+        position = push_position_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = value;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Removes the oldest value and writes it to value, or returns false if the
+  // ring is empty.
+  bool TryPop(T& value) {
+    size_t position = pop_position_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[position & mask_];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t lap = static_cast<intptr_t>(sequence) -
+                           static_cast<intptr_t>(position + 1);
+      if (lap == 0) {
+        if (pop_position_.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lap < 0) {
+        return false;
+      } else {
+        position = pop_position_.load(std::memory_order_relaxed);
+      }
+    }
+    value = slot->value;
+    slot->sequence.store(position + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns the number of values in the ring. Only approximate while other
+  // threads push or pop.
+  int size() const {
+    const size_t pushed = push_position_.load(std::memory_order_relaxed);
+    const size_t popped = pop_position_.load(std::memory_order_relaxed);
+    return pushed > popped ? static_cast<int>(pushed - popped) : 0;
+  }
+
+  int capacity() const { return static_cast<int>(mask_ + 1); }
+
+  int64_t MemoryUsed() const {
+    return sizeof(LockFreeRing<T>) + capacity() * sizeof(Slot);
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t RoundUpToPowerOfTwo(int n) {
+    size_t power = 1;
+    while (power < static_cast<size_t>(n)) {
+      power *= 2;
+    }
+    return power;
+  }
+
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  // Kept on separate cache lines so that producers and consumers do not
+  // invalidate each other's position.
+  alignas(64) std::atomic<size_t> push_position_{0};
+  alignas(64) std::atomic<size_t> pop_position_{0};
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_LOCK_FREE_RING_H_
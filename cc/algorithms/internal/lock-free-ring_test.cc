@@ -0,0 +1,106 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/lock-free-ring.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+TEST(LockFreeRingTest, PopsInPushOrderUntilEmpty) {
+  LockFreeRing<int64_t> ring(3);
+  EXPECT_EQ(ring.capacity(), 4);
+  for (int64_t i = 0; i < 4; ++i) {
+    EXPECT_TRUE(ring.TryPush(i));
+  }
+  EXPECT_FALSE(ring.TryPush(4));
+  EXPECT_EQ(ring.size(), 4);
+
+  int64_t value;
+  for (int64_t i = 0; i < 4; ++i) {
+    ASSERT_TRUE(ring.TryPop(value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_FALSE(ring.TryPop(value));
+  EXPECT_EQ(ring.size(), 0);
+}
+
+TEST(LockFreeRingTest, WrapsAround) {
+  LockFreeRing<double> ring(2);
+  double value;
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(ring.TryPush(i));
+    ASSERT_TRUE(ring.TryPop(value));
+    EXPECT_EQ(value, i);
+  }
+}
+
+TEST(LockFreeRingTest, EveryValueIsPoppedExactlyOnce) {
+  constexpr int kValuesPerProducer = 20000;
+  constexpr int kNumProducers = 2;
+  constexpr int kNumConsumers = 4;
+  LockFreeRing<int> ring(64);
+  std::vector<std::vector<int>> popped(kNumConsumers);
+  std::atomic<int> num_popped = 0;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kNumProducers; ++p) {
+    threads.emplace_back([&ring, p]() {
+      for (int i = 0; i < kValuesPerProducer; ++i) {
+        while (!ring.TryPush(p * kValuesPerProducer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (int c = 0; c < kNumConsumers; ++c) {
+    threads.emplace_back([&ring, &popped, &num_popped, c]() {
+      int value;
+      while (num_popped < kNumProducers * kValuesPerProducer) {
+        if (ring.TryPop(value)) {
+          popped[c].push_back(value);
+          ++num_popped;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<int> times_popped(kNumProducers * kValuesPerProducer, 0);
+  for (const std::vector<int>& values : popped) {
+    for (int value : values) {
+      ++times_popped[value];
+    }
+  }
+  for (int count : times_popped) {
+    ASSERT_EQ(count, 1);
+  }
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
@@ -0,0 +1,114 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/mapped-file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "absl/functional/function_ref.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+absl::Status ErrnoError(int error_number, absl::string_view message) {
+  return absl::Status(absl::ErrnoToStatusCode(error_number),
+                      absl::StrCat(message, ": ", std::strerror(error_number)));
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<MappedFile>> MappedFile::Open(
+    const std::string& path) {
+  std::unique_ptr<MappedFile> file = absl::WrapUnique(new MappedFile());
+  file->fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file->fd_ < 0) {
+    return ErrnoError(errno, absl::StrCat("Cannot open ", path));
+  }
+  struct stat file_stat;
+  if (fstat(file->fd_, &file_stat) != 0) {
+    return ErrnoError(errno, absl::StrCat("Cannot stat ", path));
+  }
+  file->size_ = file_stat.st_size;
+  // mmap fails for empty files, whose contents are empty anyway.
+  if (file->size_ == 0) return file;
+  void* data = mmap(nullptr, file->size_, PROT_READ, MAP_PRIVATE, file->fd_, 0);
+  if (data == MAP_FAILED) {
+    return ErrnoError(errno, absl::StrCat("Cannot map ", path));
+  }
+  file->data_ = data;
+  return file;
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) munmap(data_, size_);
+  if (fd_ >= 0) close(fd_);
+}
+
+absl::string_view MappedFile::contents() const {
+  return data_ == nullptr
+             ? absl::string_view()
+             : absl::string_view(static_cast<const char*>(data_), size_);
+}
+
+absl::Status WriteFileAtomically(
+    const std::string& path,
+    absl::FunctionRef<absl::Status(std::ostream&)> write) {
+  // Write to a file that is unique per process and call, then rename it.
+  static std::atomic<int> num_writes{0};
+  const std::string temporary_path =
+      absl::StrCat(path, ".tmp.", getpid(), ".", num_writes++);
+  {
+    std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+    const absl::Status status = write(output);
+    output.close();
+    if (!status.ok()) {
+      std::remove(temporary_path.c_str());
+      return status;
+    }
+    if (!output) {
+      std::remove(temporary_path.c_str());
+      return absl::InternalError(
+          absl::StrCat("Cannot write ", temporary_path));
+    }
+  }
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    const int error_number = errno;
+    std::remove(temporary_path.c_str());
+    return ErrnoError(error_number, absl::StrCat("Cannot rename to ", path));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
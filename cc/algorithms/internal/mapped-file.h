@@ -0,0 +1,68 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_MAPPED_FILE_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// A file mapped read-only into memory, e.g., a checkpoint that is restored
+// by reading its contents in place instead of copying them into buffers.
+class MappedFile {
+ public:
+  // Maps the file at path. Returns NotFoundError if it does not exist.
+  static absl::StatusOr<std::unique_ptr<MappedFile>> Open(
+      const std::string& path);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  // The contents of the file, valid as long as this MappedFile.
+  absl::string_view contents() const;
+
+ private:
+  MappedFile() = default;
+
+  int fd_ = -1;
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Replaces the file at path with the output of write. The output is written
+// to a temporary file next to path, which is renamed to path once complete,
+// so that readers, and restarts after a crash of the writer, only ever see
+// either the previous or the new file. If write returns an error, the file at
+// path is left unchanged and the error is returned.
+absl::Status WriteFileAtomically(
+    const std::string& path,
+    absl::FunctionRef<absl::Status(std::ostream&)> write);
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_MAPPED_FILE_H_
@@ -0,0 +1,94 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/mapped-file.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+
+std::string TestPath(absl::string_view name) {
+  const char* tmpdir = std::getenv("TEST_TMPDIR");
+  return absl::StrCat(tmpdir != nullptr ? tmpdir : "/tmp", "/", name);
+}
+
+TEST(MappedFileTest, MapsWrittenFile) {
+  const std::string path = TestPath("mapped-file-test");
+  ASSERT_OK(WriteFileAtomically(path, [](std::ostream& output) {
+    output << "first";
+    return absl::OkStatus();
+  }));
+  ASSERT_OK(WriteFileAtomically(path, [](std::ostream& output) {
+    output << "second";
+    output.put('\0');
+    return absl::OkStatus();
+  }));
+  // A failed write leaves the file unchanged.
+  EXPECT_THAT(WriteFileAtomically(path,
+                                  [](std::ostream& output) {
+                                    output << "third";
+                                    return absl::DataLossError("Lost.");
+                                  }),
+              StatusIs(absl::StatusCode::kDataLoss));
+
+  absl::StatusOr<std::unique_ptr<MappedFile>> file = MappedFile::Open(path);
+  ASSERT_OK(file);
+  EXPECT_EQ((*file)->contents(), absl::string_view("second\0", 7));
+  std::remove(path.c_str());
+}
+
+TEST(MappedFileTest, MapsEmptyFile) {
+  const std::string path = TestPath("mapped-file-empty-test");
+  ASSERT_OK(WriteFileAtomically(
+      path, [](std::ostream&) { return absl::OkStatus(); }));
+
+  absl::StatusOr<std::unique_ptr<MappedFile>> file = MappedFile::Open(path);
+  ASSERT_OK(file);
+  EXPECT_TRUE((*file)->contents().empty());
+  std::remove(path.c_str());
+}
+
+TEST(MappedFileTest, MissingFileIsNotFound) {
+  EXPECT_THAT(MappedFile::Open(TestPath("mapped-file-missing")),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(MappedFileTest, UnwritableDirectoryFails) {
+  EXPECT_THAT(WriteFileAtomically("/nonexistent/directory/file",
+                                  [](std::ostream& output) {
+                                    output << "x";
+                                    return absl::OkStatus();
+                                  }),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
@@ -0,0 +1,152 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_SHARDED_ACCUMULATOR_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_SHARDED_ACCUMULATOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+namespace differential_privacy {
+namespace internal {
+
+// Returns a small index that is fixed for the calling thread. Threads get
+// consecutive indices in the order in which they first call this.
+inline int ThreadShardIndex() {
+  static std::atomic<int> next_index{0};
+  thread_local const int index =
+      next_index.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+// Sum and count that many threads add to without taking a lock. The values
+// are split over shards of one cache line each, and every thread adds to the
+// shard of its ThreadShardIndex(), so threads on different cores rarely touch
+// the same cache line. Adding takes four atomic operations on the shard.
+//
+// Read() adds up the shards. Every Add is either fully included in the result
+// or not at all, so the sum and the count always describe the same inputs.
+// Reading retries a shard while an Add to it is in flight.
+//
+// Add and Read may be called concurrently from any number of threads; Clear
+// must not run concurrently with either.
+template <typename S>
+class ShardedAccumulator {
+ public:
+  struct Snapshot {
+    S sum = 0;
+    int64_t count = 0;
+  };
+
+  // Upper bound of the default number of shards.
+  static constexpr int kMaxDefaultShards = 64;
+
+  // A num_shards of 0 uses the smallest power of two that is at least the
+  // number of hardware threads, up to kMaxDefaultShards.
+  explicit ShardedAccumulator(int num_shards = 0)
+      : num_shards_(RoundUpToPowerOfTwo(
+            num_shards > 0 ? num_shards : DefaultNumShards())),
+        shards_(new Shard[num_shards_]) {}
+
+  ShardedAccumulator(const ShardedAccumulator&) = delete;
+  ShardedAccumulator& operator=(const ShardedAccumulator&) = delete;
+
+  void Add(S sum, int64_t count) {
+    Shard& shard = shards_[ThreadShardIndex() & (num_shards_ - 1)];
+    shard.begun.fetch_add(1);
+    AddTo(shard.sum, sum);
+    shard.count.fetch_add(count);
+    shard.ended.fetch_add(1);
+  }
+
+  Snapshot Read() const {
+    Snapshot snapshot;
+    for (int i = 0; i < num_shards_; ++i) {
+      const Shard& shard = shards_[i];
+      while (true) {
+        // Since ended never exceeds begun and both only grow, reading the
+        // same number from both means that no Add was in flight in between.
+        const uint64_t ended = shard.ended.load();
+        const S sum = shard.sum.load();
+        const int64_t count = shard.count.load();
+        if (shard.begun.load() == ended) {
+          snapshot.sum += sum;
+          snapshot.count += count;
+          break;
+        }
+        std::this_thread::yield();
+      }
+    }
+    return snapshot;
+  }
+
+  void Clear() {
+    for (int i = 0; i < num_shards_; ++i) {
+      shards_[i].sum.store(0);
+      shards_[i].count.store(0);
+    }
+  }
+
+  int num_shards() const { return num_shards_; }
+
+  int64_t MemoryUsed() const {
+    return sizeof(ShardedAccumulator<S>) + num_shards_ * sizeof(Shard);
+  }
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> begun{0};
+    std::atomic<uint64_t> ended{0};
+    std::atomic<S> sum{0};
+    std::atomic<int64_t> count{0};
+  };
+
+  static int DefaultNumShards() {
+    return std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1,
+                      kMaxDefaultShards);
+  }
+
+  static int RoundUpToPowerOfTwo(int n) {
+    int power = 1;
+    while (power < n) {
+      power *= 2;
+    }
+    return power;
+  }
+
+  static void AddTo(std::atomic<S>& target, S value) {
+    if constexpr (std::is_integral_v<S>) {
+      target.fetch_add(value);
+    } else {
+      // std::atomic<double>::fetch_add requires C++20.
+      S expected = target.load(std::memory_order_relaxed);
+      while (!target.compare_exchange_weak(expected, expected + value)) {
+      }
+    }
+  }
+
+  const int num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_SHARDED_ACCUMULATOR_H_
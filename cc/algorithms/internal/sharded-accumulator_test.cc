@@ -0,0 +1,91 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/sharded-accumulator.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+TEST(ShardedAccumulatorTest, NumberOfShardsIsAPowerOfTwo) {
+  EXPECT_EQ(ShardedAccumulator<int64_t>(3).num_shards(), 4);
+  EXPECT_EQ(ShardedAccumulator<int64_t>(8).num_shards(), 8);
+  const int num_default_shards = ShardedAccumulator<double>().num_shards();
+  EXPECT_GE(num_default_shards, 1);
+  EXPECT_LE(num_default_shards,
+            ShardedAccumulator<double>::kMaxDefaultShards);
+  EXPECT_EQ(num_default_shards & (num_default_shards - 1), 0);
+}
+
+TEST(ShardedAccumulatorTest, AddsFromManyThreads) {
+  ShardedAccumulator<double> accumulator(4);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&accumulator]() {
+      for (int j = 0; j < 10000; ++j) {
+        accumulator.Add(0.5, 1);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const ShardedAccumulator<double>::Snapshot snapshot = accumulator.Read();
+  EXPECT_EQ(snapshot.sum, 40000);
+  EXPECT_EQ(snapshot.count, 80000);
+}
+
+TEST(ShardedAccumulatorTest, SnapshotsMatchSumsWithCounts) {
+  ShardedAccumulator<int64_t> accumulator(2);
+  std::atomic<bool> done = false;
+  std::vector<std::thread> writers;
+  for (int i = 0; i < 4; ++i) {
+    writers.emplace_back([&accumulator, &done]() {
+      while (!done) {
+        accumulator.Add(3, 1);
+      }
+    });
+  }
+  for (int i = 0; i < 1000; ++i) {
+    const ShardedAccumulator<int64_t>::Snapshot snapshot = accumulator.Read();
+    ASSERT_EQ(snapshot.sum, 3 * snapshot.count);
+  }
+  done = true;
+  for (std::thread& writer : writers) {
+    writer.join();
+  }
+}
+
+TEST(ShardedAccumulatorTest, ClearSetsEverythingToZero) {
+  ShardedAccumulator<int64_t> accumulator;
+  accumulator.Add(5, 2);
+  accumulator.Clear();
+  EXPECT_EQ(accumulator.Read().sum, 0);
+  EXPECT_EQ(accumulator.Read().count, 0);
+  accumulator.Add(1, 1);
+  EXPECT_EQ(accumulator.Read().sum, 1);
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
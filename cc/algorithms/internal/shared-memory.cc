@@ -0,0 +1,107 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/shared-memory.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+absl::Status ErrnoError(int error_number, absl::string_view message) {
+  return absl::Status(absl::ErrnoToStatusCode(error_number),
+                      absl::StrCat(message, ": ", std::strerror(error_number)));
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<SharedMemoryRegion>>
+SharedMemoryRegion::OpenOrCreate(const std::string& name, size_t size) {
+  if (size == 0) {
+    return absl::InvalidArgumentError(
+        "Shared memory regions must not be empty.");
+  }
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    return ErrnoError(errno, absl::StrCat("Cannot open shared memory ", name));
+  }
+  std::unique_ptr<SharedMemoryRegion> region =
+      absl::WrapUnique(new SharedMemoryRegion());
+  const absl::Status status = region->Map(fd, name, size);
+  // The mapping keeps the object alive without the descriptor.
+  close(fd);
+  if (!status.ok()) return status;
+  return region;
+}
+
+absl::Status SharedMemoryRegion::Map(int fd, const std::string& name,
+                                     size_t size) {
+  struct stat object_stat;
+  if (fstat(fd, &object_stat) != 0) {
+    return ErrnoError(errno, absl::StrCat("Cannot stat shared memory ", name));
+  }
+  // A new object is empty. Processes that race to create it all resize it to
+  // the same size, and ftruncate fills it with zeros.
+  if (object_stat.st_size == 0) {
+    if (ftruncate(fd, size) != 0 || fstat(fd, &object_stat) != 0) {
+      return ErrnoError(errno,
+                        absl::StrCat("Cannot resize shared memory ", name));
+    }
+  }
+  if (static_cast<size_t>(object_stat.st_size) != size) {
+    return absl::FailedPreconditionError(
+        absl::StrCat("Shared memory ", name, " has ", object_stat.st_size,
+                     " bytes, but ", size, " bytes were requested."));
+  }
+  void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    return ErrnoError(errno, absl::StrCat("Cannot map shared memory ", name));
+  }
+  data_ = data;
+  size_ = size;
+  return absl::OkStatus();
+}
+
+absl::Status SharedMemoryRegion::Remove(const std::string& name) {
+  if (shm_unlink(name.c_str()) != 0) {
+    return ErrnoError(errno,
+                      absl::StrCat("Cannot remove shared memory ", name));
+  }
+  return absl::OkStatus();
+}
+
+SharedMemoryRegion::~SharedMemoryRegion() {
+  if (data_ != nullptr) munmap(data_, size_);
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
@@ -0,0 +1,67 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_SHARED_MEMORY_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_SHARED_MEMORY_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// A POSIX shared memory object mapped read-write into memory. Every process
+// that opens the same name maps the same pages, so state placed in the
+// region, e.g., as lock-free atomics, is shared by all processes on the host.
+// The object outlives the processes that use it until it is removed.
+class SharedMemoryRegion {
+ public:
+  // Maps the shared memory object with the given name, which must start with
+  // a slash and contain no other slash. The object is created with size
+  // zero bytes if it does not exist yet. Returns FailedPreconditionError if it
+  // exists with another size.
+  static absl::StatusOr<std::unique_ptr<SharedMemoryRegion>> OpenOrCreate(
+      const std::string& name, size_t size);
+
+  // Removes the shared memory object with the given name. Regions that are
+  // mapped already stay valid, but later calls to OpenOrCreate create a new
+  // object. Returns NotFoundError if it does not exist.
+  static absl::Status Remove(const std::string& name);
+
+  SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+  SharedMemoryRegion& operator=(const SharedMemoryRegion&) = delete;
+  ~SharedMemoryRegion();
+
+  void* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  SharedMemoryRegion() = default;
+
+  absl::Status Map(int fd, const std::string& name, size_t size);
+
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_SHARED_MEMORY_H_
@@ -0,0 +1,87 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/shared-memory.h"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+
+// Name that is unique per test process, since shared memory is host-wide.
+std::string TestName(absl::string_view name) {
+  return absl::StrCat("/", name, "-", getpid());
+}
+
+TEST(SharedMemoryRegionTest, RegionsOfSameNameShareMemory) {
+  const std::string name = TestName("shared-memory-test");
+  absl::StatusOr<std::unique_ptr<SharedMemoryRegion>> first =
+      SharedMemoryRegion::OpenOrCreate(name, 64);
+  ASSERT_OK(first);
+  absl::StatusOr<std::unique_ptr<SharedMemoryRegion>> second =
+      SharedMemoryRegion::OpenOrCreate(name, 64);
+  ASSERT_OK(second);
+  EXPECT_EQ((*second)->size(), 64);
+  EXPECT_NE((*first)->data(), (*second)->data());
+
+  const char* zeros = "\0\0\0\0";
+  EXPECT_EQ(std::memcmp((*second)->data(), zeros, 4), 0);
+  std::memcpy((*first)->data(), "abc", 4);
+  EXPECT_STREQ(static_cast<const char*>((*second)->data()), "abc");
+
+  // Removing the object keeps mapped regions, but a new one starts empty.
+  ASSERT_OK(SharedMemoryRegion::Remove(name));
+  EXPECT_STREQ(static_cast<const char*>((*second)->data()), "abc");
+  absl::StatusOr<std::unique_ptr<SharedMemoryRegion>> third =
+      SharedMemoryRegion::OpenOrCreate(name, 64);
+  ASSERT_OK(third);
+  EXPECT_EQ(std::memcmp((*third)->data(), zeros, 4), 0);
+  EXPECT_OK(SharedMemoryRegion::Remove(name));
+}
+
+TEST(SharedMemoryRegionTest, SizeMustMatch) {
+  const std::string name = TestName("shared-memory-size-test");
+  ASSERT_OK(SharedMemoryRegion::OpenOrCreate(name, 64));
+  EXPECT_THAT(SharedMemoryRegion::OpenOrCreate(name, 128),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_OK(SharedMemoryRegion::Remove(name));
+}
+
+TEST(SharedMemoryRegionTest, InvalidRequestsFail) {
+  EXPECT_THAT(SharedMemoryRegion::OpenOrCreate(TestName("empty"), 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(SharedMemoryRegion::OpenOrCreate("/no/slashes", 64),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(SharedMemoryRegion::Remove(TestName("missing")),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
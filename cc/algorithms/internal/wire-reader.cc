@@ -0,0 +1,145 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/wire-reader.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "absl/strings/string_view.h"
+
+namespace differential_privacy {
+namespace internal {
+
+bool WireReader::ReadTag(int* field, WireType* wire_type) {
+  uint64_t tag;
+  if (!ReadVarint(&tag)) return false;
+  const uint64_t type = tag & 7;
+  if (type != 0 && type != 1 && type != 2 && type != 5) return false;
+  if ((tag >> 3) == 0 || (tag >> 3) > (uint64_t{1} << 29) - 1) return false;
+  *field = static_cast<int>(tag >> 3);
+  *wire_type = static_cast<WireType>(type);
+  return true;
+}
+
+bool WireReader::ReadVarint(uint64_t* value) {
+  uint64_t result = 0;
+  // A varint has at most 10 bytes of 7 bits each.
+  for (int i = 0; i < 10 && i < data_.size(); ++i) {
+    const uint8_t byte = static_cast<uint8_t>(data_[i]);
+    result |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      data_.remove_prefix(i + 1);
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WireReader::ReadFixed64(uint64_t* value) {
+  if (data_.size() < sizeof(*value)) return false;
+  // The wire format is little endian.
+  uint64_t result = 0;
+  for (int i = 0; i < sizeof(*value); ++i) {
+    result |= static_cast<uint64_t>(static_cast<uint8_t>(data_[i])) << (8 * i);
+  }
+  data_.remove_prefix(sizeof(*value));
+  *value = result;
+  return true;
+}
+
+bool WireReader::ReadLengthDelimited(absl::string_view* value) {
+  uint64_t size;
+  if (!ReadVarint(&size) || size > data_.size()) return false;
+  *value = data_.substr(0, size);
+  data_.remove_prefix(size);
+  return true;
+}
+
+bool WireReader::SkipField(WireType wire_type) {
+  uint64_t value;
+  absl::string_view bytes;
+  switch (wire_type) {
+    case WireType::kVarint:
+      return ReadVarint(&value);
+    case WireType::kFixed64:
+      return ReadFixed64(&value);
+    case WireType::kLengthDelimited:
+      return ReadLengthDelimited(&bytes);
+    case WireType::kFixed32:
+      if (data_.size() < 4) return false;
+      data_.remove_prefix(4);
+      return true;
+  }
+  return false;
+}
+
+bool SummaryPayload(absl::string_view summary, absl::string_view type_name,
+                    absl::string_view* payload) {
+  // Summary has the Any in field 2, which has the type URL in field 1 and the
+  // serialized message in field 2.
+  WireReader reader(summary);
+  bool has_any = false;
+  absl::string_view any;
+  while (!reader.empty()) {
+    int field;
+    WireType wire_type;
+    if (!reader.ReadTag(&field, &wire_type)) return false;
+    if (field == 2) {
+      if (has_any || wire_type != WireType::kLengthDelimited ||
+          !reader.ReadLengthDelimited(&any)) {
+        return false;
+      }
+      has_any = true;
+    } else if (!reader.SkipField(wire_type)) {
+      return false;
+    }
+  }
+  if (!has_any) return false;
+
+  WireReader any_reader(any);
+  bool has_type_url = false;
+  bool has_value = false;
+  absl::string_view type_url;
+  absl::string_view value;
+  while (!any_reader.empty()) {
+    int field;
+    WireType wire_type;
+    if (!any_reader.ReadTag(&field, &wire_type)) return false;
+    if (field == 1 || field == 2) {
+      bool& seen = field == 1 ? has_type_url : has_value;
+      if (seen || wire_type != WireType::kLengthDelimited ||
+          !any_reader.ReadLengthDelimited(field == 1 ? &type_url : &value)) {
+        return false;
+      }
+      seen = true;
+    } else if (!any_reader.SkipField(wire_type)) {
+      return false;
+    }
+  }
+  // Like Any::UnpackTo, only compare the part after the last slash.
+  const size_t slash = type_url.rfind('/');
+  if (slash == absl::string_view::npos ||
+      type_url.substr(slash + 1) != type_name) {
+    return false;
+  }
+  *payload = value;
+  return true;
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
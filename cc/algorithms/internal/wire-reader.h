@@ -0,0 +1,180 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_WIRE_READER_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_WIRE_READER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "absl/strings/string_view.h"
+
+namespace differential_privacy {
+namespace internal {
+
+// Wire types of the protobuf encoding. Groups are not supported.
+enum class WireType : uint8_t {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+  kFixed32 = 5,
+};
+
+// Forward-only reader of the protobuf wire format over serialized bytes.
+// Fields are decoded in place without allocating messages, and
+// length-delimited fields are returned as views into the input. It lets
+// algorithms merge serialized summaries directly into their state instead of
+// parsing the Summary, and then the Any payload, into messages first.
+//
+// All methods return false if the input is malformed, after which the reader
+// must not be used anymore.
+class WireReader {
+ public:
+  explicit WireReader(absl::string_view data) : data_(data) {}
+
+  bool empty() const { return data_.empty(); }
+
+  // Reads the tag of the next field.
+  bool ReadTag(int* field, WireType* wire_type);
+
+  bool ReadVarint(uint64_t* value);
+
+  bool ReadFixed64(uint64_t* value);
+
+  bool ReadLengthDelimited(absl::string_view* value);
+
+  // Skips the value of a field whose tag was just read.
+  bool SkipField(WireType wire_type);
+
+ private:
+  absl::string_view data_;
+};
+
+inline int64_t ZigZagDecode64(uint64_t value) {
+  return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+inline double DoubleFromBits(uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Calls f with every element of a repeated varint field whose tag was just
+// read, in either the packed or the unpacked encoding.
+template <typename F>
+bool ForEachVarint(WireReader& reader, WireType wire_type, F f) {
+  uint64_t value;
+  if (wire_type == WireType::kVarint) {
+    if (!reader.ReadVarint(&value)) return false;
+    f(value);
+    return true;
+  }
+  absl::string_view packed;
+  if (wire_type != WireType::kLengthDelimited ||
+      !reader.ReadLengthDelimited(&packed)) {
+    return false;
+  }
+  WireReader elements(packed);
+  while (!elements.empty()) {
+    if (!elements.ReadVarint(&value)) return false;
+    f(value);
+  }
+  return true;
+}
+
+// Calls f with every element of a repeated double field whose tag was just
+// read, in either the packed or the unpacked encoding.
+template <typename F>
+bool ForEachDouble(WireReader& reader, WireType wire_type, F f) {
+  uint64_t bits;
+  if (wire_type == WireType::kFixed64) {
+    if (!reader.ReadFixed64(&bits)) return false;
+    f(DoubleFromBits(bits));
+    return true;
+  }
+  absl::string_view packed;
+  if (wire_type != WireType::kLengthDelimited ||
+      !reader.ReadLengthDelimited(&packed) ||
+      packed.size() % sizeof(double) != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < packed.size(); i += sizeof(double)) {
+    std::memcpy(&bits, packed.data() + i, sizeof(bits));
+    f(DoubleFromBits(bits));
+  }
+  return true;
+}
+
+// Decodes a serialized ValueType into the value returned by GetValue<V> for
+// an arithmetic V, i.e., int_value for integral and float_value for floating
+// point types, or zero if the other member of the oneof is set.
+template <typename V>
+bool ReadValueType(absl::string_view value_type, V* value) {
+  WireReader reader(value_type);
+  int64_t int_value = 0;
+  double float_value = 0;
+  while (!reader.empty()) {
+    int field;
+    WireType wire_type;
+    uint64_t raw;
+    if (!reader.ReadTag(&field, &wire_type)) return false;
+    if (field == 1 && wire_type == WireType::kVarint) {
+      if (!reader.ReadVarint(&raw)) return false;
+      int_value = static_cast<int64_t>(raw);
+      float_value = 0;
+    } else if (field == 2 && wire_type == WireType::kFixed64) {
+      if (!reader.ReadFixed64(&raw)) return false;
+      float_value = DoubleFromBits(raw);
+      int_value = 0;
+    } else {
+      if (!reader.SkipField(wire_type)) return false;
+      if (field == 3) {
+        int_value = 0;
+        float_value = 0;
+      }
+    }
+  }
+  if constexpr (std::is_integral_v<V>) {
+    *value = static_cast<V>(int_value);
+  } else {
+    *value = static_cast<V>(float_value);
+  }
+  return true;
+}
+
+// Finds the payload of a serialized Summary, i.e., the serialized message in
+// its Any, and checks that the Any holds a message of type type_name. Returns
+// false if the Summary is malformed, has no data or holds another type, and
+// also if a field occurs more than once, which the protobuf parser would
+// merge.
+bool SummaryPayload(absl::string_view summary, absl::string_view type_name,
+                    absl::string_view* payload);
+
+// Same as above with the type name of the message type M.
+template <typename M>
+bool SummaryPayload(absl::string_view summary, absl::string_view* payload) {
+  static const std::string* const type_name =
+      new std::string(M::default_instance().GetTypeName());
+  return SummaryPayload(summary, *type_name, payload);
+}
+
+}  // namespace internal
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_INTERNAL_WIRE_READER_H_
@@ -0,0 +1,167 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/internal/wire-reader.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+#include "proto/data.pb.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace internal {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+
+TEST(WireReaderTest, ReadsFieldsOfSerializedMessage) {
+  BoundedSumSummary summary;
+  summary.set_max_partitions_contributed(3);
+  summary.set_epsilon(1.5);
+  summary.mutable_bounds_summary()->set_num_bins(7);
+  const std::string bytes = summary.SerializeAsString();
+
+  WireReader reader(bytes);
+  int field;
+  WireType wire_type;
+  uint64_t value;
+  absl::string_view nested;
+  ASSERT_TRUE(reader.ReadTag(&field, &wire_type));
+  EXPECT_EQ(field, 3);
+  ASSERT_TRUE(reader.ReadLengthDelimited(&nested));
+  EXPECT_EQ(nested, summary.bounds_summary().SerializeAsString());
+  ASSERT_TRUE(reader.ReadTag(&field, &wire_type));
+  EXPECT_EQ(field, 5);
+  EXPECT_EQ(wire_type, WireType::kFixed64);
+  ASSERT_TRUE(reader.ReadFixed64(&value));
+  EXPECT_EQ(DoubleFromBits(value), 1.5);
+  ASSERT_TRUE(reader.ReadTag(&field, &wire_type));
+  EXPECT_EQ(field, 10);
+  ASSERT_TRUE(reader.ReadVarint(&value));
+  EXPECT_EQ(value, 3);
+  EXPECT_TRUE(reader.empty());
+}
+
+TEST(WireReaderTest, ReadsPackedAndUnpackedRepeatedFields) {
+  const std::vector<int64_t> values = {0, 1, -1, 300,
+                                       std::numeric_limits<int64_t>::min()};
+  BoundedSumSummary summary;
+  ApproxBoundsSummary* bounds = summary.mutable_bounds_summary();
+  for (int64_t value : values) {
+    // pos_bin_count is unpacked and compact_pos_int_sum is packed.
+    bounds->add_pos_bin_count(value);
+    summary.add_compact_pos_int_sum(value);
+    summary.add_compact_pos_float_sum(value / 2.0);
+  }
+  const std::string bytes = summary.SerializeAsString();
+
+  std::vector<int64_t> unpacked;
+  std::vector<int64_t> packed;
+  std::vector<double> doubles;
+  WireReader reader(bytes);
+  while (!reader.empty()) {
+    int field;
+    WireType wire_type;
+    ASSERT_TRUE(reader.ReadTag(&field, &wire_type));
+    if (field == 3) {
+      absl::string_view nested;
+      ASSERT_TRUE(reader.ReadLengthDelimited(&nested));
+      WireReader bounds_reader(nested);
+      while (!bounds_reader.empty()) {
+        ASSERT_TRUE(bounds_reader.ReadTag(&field, &wire_type));
+        EXPECT_EQ(wire_type, WireType::kVarint);
+        ASSERT_TRUE(ForEachVarint(bounds_reader, wire_type, [&](uint64_t v) {
+          unpacked.push_back(static_cast<int64_t>(v));
+        }));
+      }
+    } else if (field == 12) {
+      EXPECT_EQ(wire_type, WireType::kLengthDelimited);
+      ASSERT_TRUE(ForEachVarint(reader, wire_type, [&](uint64_t v) {
+        packed.push_back(ZigZagDecode64(v));
+      }));
+    } else if (field == 14) {
+      ASSERT_TRUE(ForEachDouble(reader, wire_type,
+                                [&](double v) { doubles.push_back(v); }));
+    } else {
+      ASSERT_TRUE(reader.SkipField(wire_type));
+    }
+  }
+  EXPECT_THAT(unpacked, ElementsAreArray(values));
+  EXPECT_THAT(packed, ElementsAreArray(values));
+  ASSERT_EQ(doubles.size(), values.size());
+  for (int i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(doubles[i], values[i] / 2.0);
+  }
+}
+
+TEST(WireReaderTest, ReadValueTypeFollowsGetValue) {
+  ValueType int_value;
+  int_value.set_int_value(-7);
+  ValueType float_value;
+  float_value.set_float_value(2.5);
+  int64_t i;
+  double d;
+  ASSERT_TRUE(ReadValueType(int_value.SerializeAsString(), &i));
+  EXPECT_EQ(i, -7);
+  ASSERT_TRUE(ReadValueType(int_value.SerializeAsString(), &d));
+  EXPECT_EQ(d, 0);
+  ASSERT_TRUE(ReadValueType(float_value.SerializeAsString(), &d));
+  EXPECT_EQ(d, 2.5);
+  ASSERT_TRUE(ReadValueType(float_value.SerializeAsString(), &i));
+  EXPECT_EQ(i, 0);
+}
+
+TEST(WireReaderTest, RejectsMalformedInput) {
+  uint64_t value;
+  absl::string_view nested;
+  // Unterminated varint.
+  EXPECT_FALSE(WireReader("\x80\x80").ReadVarint(&value));
+  // Length beyond the end of the input.
+  EXPECT_FALSE(WireReader("\x05" "ab").ReadLengthDelimited(&nested));
+  EXPECT_FALSE(WireReader("1234567").ReadFixed64(&value));
+  // Group wire type.
+  int field;
+  WireType wire_type;
+  EXPECT_FALSE(WireReader("\x0b").ReadTag(&field, &wire_type));
+}
+
+TEST(WireReaderTest, SummaryPayloadChecksType) {
+  CountSummary count_summary;
+  count_summary.set_count(5);
+  Summary summary;
+  summary.mutable_data()->PackFrom(count_summary);
+  const std::string bytes = summary.SerializeAsString();
+
+  absl::string_view payload;
+  ASSERT_TRUE(SummaryPayload<CountSummary>(bytes, &payload));
+  EXPECT_EQ(payload, count_summary.SerializeAsString());
+  EXPECT_FALSE(SummaryPayload<BoundedSumSummary>(bytes, &payload));
+  EXPECT_FALSE(
+      SummaryPayload<CountSummary>(Summary().SerializeAsString(), &payload));
+  // A second Any would be merged into the first one by the parser.
+  EXPECT_FALSE(SummaryPayload<CountSummary>(bytes + bytes, &payload));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace differential_privacy
@@ -0,0 +1,1064 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_KEYED_AGGREGATOR_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_KEYED_AGGREGATOR_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "algorithms/internal/binary-summary.h"
+#include "algorithms/internal/mapped-file.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/partition-selection.h"
+#include "algorithms/rand.h"
+#include "algorithms/util.h"
+#include "proto/util.h"
+#include "proto/data.pb.h"
+#include "base/instrumentation.h"
+#include "base/memory_budget.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Noisy results of the partitions kept by a KeyedAggregator, as one column
+// per field instead of one Output proto per partition. The keys are
+// concatenated in key_data, and key_offsets has size() + 1 elements, with the
+// key of partition i at [key_offsets[i], key_offsets[i + 1]). This is the
+// layout of an Arrow large binary array, so the columns can be handed to
+// columnar writers without copying them per partition.
+template <typename T>
+struct KeyedColumnarResult {
+  std::string key_data;
+  std::vector<int64_t> key_offsets = {0};
+  std::vector<int64_t> counts;
+  std::vector<T> sums;
+
+  int64_t size() const { return counts.size(); }
+
+  absl::string_view key(int64_t i) const {
+    return absl::string_view(key_data)
+        .substr(key_offsets[i], key_offsets[i + 1] - key_offsets[i]);
+  }
+};
+
+// Differentially private count and bounded sum per partition key, for data
+// where a privacy unit can contribute to many partitions.
+//
+// Algorithm classes like Count and BoundedSum aggregate a single partition and
+// assume contributions are already bounded. KeyedAggregator takes all
+// contributions of one privacy unit at a time and
+//   - keeps at most max_partitions_contributed distinct partitions and at most
+//     max_contributions_per_partition values per partition, chosen uniformly
+//     at random,
+//   - clamps values to [lower, upper] and accumulates the raw count and sum of
+//     each partition,
+//   - on PartialResult(), keeps partitions according to a
+//     PartitionSelectionStrategy on the number of privacy units and adds noise
+//     to the counts and sums of the kept partitions, in one batch each.
+//
+// Per-partition state is a small struct stored in a single contiguous vector,
+// partition keys are copied into a block arena, and both are indexed by an
+// open-addressing hash table. Noise mechanisms are built once and shared by all
+// partitions, like SharedMechanismBuilder does for per-partition algorithms.
+//
+// The budget is split equally between partition selection, the count, and the
+// sum: each gets a third of epsilon and of delta.
+//
+// With a memory budget and a spill directory set on the builder, the states of
+// all partitions in memory are written to a run file sorted by partition key
+// whenever MemoryUsed() exceeds the budget, and their memory is freed.
+// PartialResult() then merges the runs, adding up the states of partitions
+// that appear in several runs. Spilling does not change the result, since
+// contributions are bounded per privacy unit before they reach any state.
+// With a shared base::MemoryBudget, the aggregator charges its MemoryUsed() to
+// the budget and also spills when the budget is exceeded, e.g., by the
+// per-partition algorithms of the same pipeline, as long as its partitions
+// hold at least 1/kSharedBudgetSpillFraction of the limit. Smaller spills would
+// free too little memory to be worth a run file.
+//
+// Checkpoint() writes the raw state of all partitions to a file in the format
+// of the run files, and Restore() adds a checkpoint to an aggregator with the
+// same parameters, e.g., after a restart of a streaming pipeline. The
+// checkpoint is memory mapped and its blocks are read in place, so restoring
+// takes about as long as inserting the partitions. Checkpoints are not noised
+// and must be protected like the input data.
+//
+// KeyedAggregator is not thread safe.
+template <typename T>
+class KeyedAggregator {
+  static_assert(std::is_arithmetic<T>::value,
+                "KeyedAggregator can only be used for arithmetic types");
+
+ public:
+  class Builder;
+
+  // A single value of a privacy unit for a partition.
+  struct Contribution {
+    absl::string_view partition_key;
+    T value;
+  };
+
+  // Index of the elements in the Output of each partition.
+  static constexpr int kCountIndex = 0;
+  static constexpr int kSumIndex = 1;
+
+  // The result for a partition that passed partition selection. The output has
+  // the noisy count at kCountIndex and the noisy sum at kSumIndex.
+  struct PartitionResult {
+    std::string partition_key;
+    Output output;
+  };
+
+  using ColumnarResult = KeyedColumnarResult<T>;
+
+  KeyedAggregator(const KeyedAggregator&) = delete;
+  KeyedAggregator& operator=(const KeyedAggregator&) = delete;
+
+  ~KeyedAggregator() {
+    RemoveRuns();
+    ChargeSharedMemoryBudget(0);
+  }
+
+  // Adds all contributions of a single privacy unit. Must be called at most
+  // once per privacy unit, otherwise contributions are not bounded correctly.
+  // NaN values are ignored.
+  void AddPrivacyUnitContributions(
+      absl::Span<const Contribution> contributions) {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kKeyedAddContributions, contributions.size());
+    // Group the contributions by partition.
+    std::vector<const Contribution*> sorted;
+    sorted.reserve(contributions.size());
+    for (const Contribution& contribution : contributions) {
+      if (!std::isnan(static_cast<double>(contribution.value))) {
+        sorted.push_back(&contribution);
+      }
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Contribution* a, const Contribution* b) {
+                return a->partition_key < b->partition_key;
+              });
+    std::vector<absl::Span<const Contribution*>> groups;
+    for (size_t begin = 0, end = 0; begin < sorted.size(); begin = end) {
+      end = begin + 1;
+      while (end < sorted.size() &&
+             sorted[end]->partition_key == sorted[begin]->partition_key) {
+        ++end;
+      }
+      groups.push_back(absl::MakeSpan(&sorted[begin], end - begin));
+    }
+
+    // Bound the number of partitions and the contributions per partition.
+    SecureURBG& random = SecureURBG::GetInstance();
+    if (groups.size() > max_partitions_contributed_) {
+      std::shuffle(groups.begin(), groups.end(), random);
+      groups.resize(max_partitions_contributed_);
+    }
+    for (absl::Span<const Contribution*> group : groups) {
+      if (group.size() > max_contributions_per_partition_) {
+        std::shuffle(group.begin(), group.end(), random);
+        group = group.first(max_contributions_per_partition_);
+      }
+      PartitionState& state = FindOrInsert(group.front()->partition_key);
+      ++state.num_privacy_units;
+      state.count += group.size();
+      for (const Contribution* contribution : group) {
+        state.sum =
+            SafeAdd<T>(state.sum, Clamp<T>(lower_, upper_, contribution->value))
+                .value;
+      }
+    }
+
+    SpillIfOverBudget();
+  }
+
+  // Returns the number of partitions held in memory, before partition
+  // selection. Without spilling, this is the number of partitions with at
+  // least one contribution.
+  int64_t NumPartitions() const { return partitions_.size(); }
+
+  // Returns the number of runs spilled to disk since construction or the last
+  // Reset().
+  int64_t NumSpilledRuns() const { return runs_.size(); }
+
+  // Writes the states of all partitions in memory to a new run file in the
+  // spill directory and frees their memory. Called automatically when the
+  // memory budget is exceeded. Returns an error if no spill directory was set
+  // or the run cannot be written.
+  absl::Status Spill() {
+    if (spill_directory_.empty()) {
+      return absl::FailedPreconditionError(
+          "No spill directory was set for the KeyedAggregator.");
+    }
+    if (partitions_.empty()) {
+      return absl::OkStatus();
+    }
+
+    const std::string path =
+        absl::StrCat(spill_directory_, "/keyed-aggregator-", spill_id_, "-",
+                     runs_.size(), ".run");
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return absl::InternalError(
+          absl::StrCat("Cannot open spill file ", path, "."));
+    }
+    runs_.push_back(path);
+    WriteRunBlocks(SortedPartitions(), file);
+    file.close();
+    if (!file) {
+      return absl::InternalError(
+          absl::StrCat("Cannot write spill file ", path, "."));
+    }
+
+    std::vector<PartitionState>().swap(partitions_);
+    absl::flat_hash_map<absl::string_view, int>().swap(index_);
+    key_arena_.Clear();
+    memory_used_after_spill_ = MemoryUsed();
+    ChargeSharedMemoryBudget(memory_used_after_spill_);
+    return absl::OkStatus();
+  }
+
+  // Writes the states of all partitions, including spilled runs, to a
+  // checkpoint at path, replacing any previous checkpoint atomically. If
+  // partitions were spilled, the partitions in memory are spilled as well and
+  // the runs are merged into the checkpoint. Fails once the result was
+  // returned, since the budget of the state was consumed.
+  absl::Status Checkpoint(const std::string& path) {
+    if (result_returned_) {
+      return absl::FailedPreconditionError(
+          "A checkpoint cannot be written after the result was returned.");
+    }
+    RETURN_IF_ERROR(spill_status_);
+    if (!runs_.empty()) {
+      RETURN_IF_ERROR(Spill());
+    }
+    return internal::WriteFileAtomically(
+        path, [this](std::ostream& output) -> absl::Status {
+          WriteBlock(EncodeCheckpointHeader(), output);
+          if (runs_.empty()) {
+            WriteRunBlocks(SortedPartitions(), output);
+            return absl::OkStatus();
+          }
+          // Write the merged runs in blocks, copying their keys, which are
+          // only valid during the callback.
+          std::vector<PartitionState> block;
+          KeyArena keys;
+          auto write_block = [&]() {
+            std::vector<const PartitionState*> states;
+            states.reserve(block.size());
+            for (const PartitionState& state : block) {
+              states.push_back(&state);
+            }
+            WriteRunBlocks(states, output);
+            block.clear();
+            keys.Clear();
+          };
+          RETURN_IF_ERROR(MergeRuns([&](const PartitionState& state) {
+            PartitionState& copy = block.emplace_back(state);
+            copy.partition_key = keys.Store(state.partition_key);
+            if (block.size() == kPartitionsPerRunBlock) {
+              write_block();
+            }
+          }));
+          if (!block.empty()) {
+            write_block();
+          }
+          return absl::OkStatus();
+        });
+  }
+
+  // Adds the states of the partitions in the checkpoint at path, which must
+  // have been written by an aggregator with the same parameters. The state is
+  // left unchanged if the checkpoint is invalid. Returns NotFoundError if
+  // there is no checkpoint.
+  absl::Status Restore(const std::string& path) {
+    ASSIGN_OR_RETURN(std::unique_ptr<internal::MappedFile> file,
+                     internal::MappedFile::Open(path));
+    absl::string_view data = file->contents();
+    absl::string_view block;
+    if (!NextBlock(&data, &block)) {
+      return CorruptedCheckpointError(path);
+    }
+    RETURN_IF_ERROR(CheckCheckpointHeader(block));
+    // Decode all blocks once before changing any state.
+    std::vector<PartitionState> states;
+    for (absl::string_view blocks = data; !blocks.empty();) {
+      if (!NextBlock(&blocks, &block) || !DecodeRunBlock(block, &states)) {
+        return CorruptedCheckpointError(path);
+      }
+    }
+    while (NextBlock(&data, &block)) {
+      DecodeRunBlock(block, &states);
+      for (const PartitionState& restored : states) {
+        PartitionState& state = FindOrInsert(restored.partition_key);
+        state.num_privacy_units += restored.num_privacy_units;
+        state.count += restored.count;
+        state.sum = SafeAdd<T>(state.sum, restored.sum).value;
+      }
+      SpillIfOverBudget();
+    }
+    return absl::OkStatus();
+  }
+
+  // Returns the noisy count and sum of every partition kept by partition
+  // selection, in unspecified order. Can only be called once; the budget is
+  // consumed by the first call.
+  absl::StatusOr<std::vector<PartitionResult>> PartialResult() {
+    ASSIGN_OR_RETURN(KeptPartitions kept, SelectAndNoise());
+    std::vector<PartitionResult> results;
+    results.reserve(kept.counts.size());
+    for (size_t i = 0; i < kept.counts.size(); ++i) {
+      Output output;
+      AddToOutput<int64_t>(&output, kept.counts[i]);
+      AddToOutput<T>(&output, NoisedSumToValue(kept.sums[i]));
+      results.push_back(
+          {std::string(kept.key_data.data() + kept.key_offsets[i],
+                       kept.key_offsets[i + 1] - kept.key_offsets[i]),
+           std::move(output)});
+    }
+    return results;
+  }
+
+  // Same results as PartialResult(), as columns. Avoids an Output and a key
+  // string per partition, e.g., to write the results of many millions of
+  // partitions with WriteNdjson. Consumes the budget like PartialResult().
+  absl::StatusOr<ColumnarResult> PartialColumnarResult() {
+    ASSIGN_OR_RETURN(KeptPartitions kept, SelectAndNoise());
+    ColumnarResult result;
+    result.key_data = std::move(kept.key_data);
+    result.key_offsets = std::move(kept.key_offsets);
+    result.counts = std::move(kept.counts);
+    result.sums.reserve(kept.sums.size());
+    for (const NoisedSum sum : kept.sums) {
+      result.sums.push_back(NoisedSumToValue(sum));
+    }
+    return result;
+  }
+
+  // Discards all contributions, including spilled runs, and allows
+  // PartialResult() to be called again.
+  void Reset() {
+    result_returned_ = false;
+    partitions_.clear();
+    index_.clear();
+    key_arena_.Clear();
+    RemoveRuns();
+    spill_status_ = absl::OkStatus();
+  }
+
+  int64_t MemoryUsed() const {
+    return sizeof(KeyedAggregator) +
+           sizeof(PartitionState) * partitions_.capacity() +
+           // https://abseil.io/docs/cpp/guides/container#memory-usage
+           (sizeof(std::pair<absl::string_view, int>) + 1) *
+               index_.bucket_count() +
+           key_arena_.MemoryUsed() + count_mechanism_->MemoryUsed() +
+           sum_mechanism_->MemoryUsed();
+  }
+
+  double GetEpsilon() const { return epsilon_; }
+  double GetDelta() const { return delta_; }
+
+ private:
+  struct PartitionState {
+    absl::string_view partition_key;
+    int64_t num_privacy_units = 0;
+    int64_t count = 0;
+    T sum = 0;
+  };
+
+  // Copies partition keys into large blocks so that each partition does not
+  // need its own heap allocation. Views returned by Store stay valid until
+  // Clear is called.
+  class KeyArena {
+   public:
+    absl::string_view Store(absl::string_view key) {
+      if (key.size() > remaining_) {
+        const size_t block_size = std::max(kBlockSize, key.size());
+        blocks_.push_back(std::make_unique<char[]>(block_size));
+        next_ = blocks_.back().get();
+        remaining_ = block_size;
+        allocated_ += block_size;
+      }
+      if (!key.empty()) {
+        std::memcpy(next_, key.data(), key.size());
+      }
+      absl::string_view stored(next_, key.size());
+      next_ += key.size();
+      remaining_ -= key.size();
+      return stored;
+    }
+
+    void Clear() {
+      blocks_.clear();
+      next_ = nullptr;
+      remaining_ = 0;
+      allocated_ = 0;
+    }
+
+    int64_t MemoryUsed() const {
+      return allocated_ + sizeof(std::unique_ptr<char[]>) * blocks_.capacity();
+    }
+
+   private:
+    static constexpr size_t kBlockSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* next_ = nullptr;
+    size_t remaining_ = 0;
+    int64_t allocated_ = 0;
+  };
+
+  // Number of partitions per block of a run file. A run is read one block at
+  // a time, so this bounds the memory of every run while merging.
+  static constexpr size_t kPartitionsPerRunBlock = 4096;
+
+  // Spills for a shared memory budget only free at least this fraction of its
+  // limit, see the class comment.
+  static constexpr int64_t kSharedBudgetSpillFraction = 16;
+
+  // Reads the partitions of a run file in order. A run file is a sequence of
+  // blocks, each a uint64 size followed by a binary summary with the number of
+  // partitions, the sizes of their keys, the concatenated keys, and the
+  // numbers of privacy units, counts and sums.
+  class RunReader {
+   public:
+    explicit RunReader(const std::string& path)
+        : path_(path), file_(path, std::ios::binary) {}
+
+    // Advances to the next partition. Returns false at the end of the run.
+    absl::StatusOr<bool> Next() {
+      if (++position_ < states_.size()) {
+        return true;
+      }
+      return ReadBlock();
+    }
+
+    // The current partition. Its key is valid until the next call to Next.
+    const PartitionState& state() const { return states_[position_]; }
+
+   private:
+    absl::StatusOr<bool> ReadBlock() {
+      if (!file_.is_open()) {
+        return absl::InternalError(
+            absl::StrCat("Cannot open spill file ", path_, "."));
+      }
+      uint64_t size;
+      if (!file_.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+        if (file_.gcount() == 0 && file_.eof()) {
+          return false;
+        }
+        return TruncatedError();
+      }
+      block_.resize(size);
+      if (!file_.read(block_.data(), size) ||
+          !DecodeRunBlock(absl::string_view(block_.data(), block_.size()),
+                          &states_)) {
+        return TruncatedError();
+      }
+      position_ = 0;
+      return !states_.empty() ? absl::StatusOr<bool>(true) : ReadBlock();
+    }
+
+    absl::Status TruncatedError() const {
+      return absl::InternalError(
+          absl::StrCat("Spill file ", path_, " is truncated or corrupted."));
+    }
+
+    std::string path_;
+    std::ifstream file_;
+    // The current block. Keys of states_ point into it.
+    std::vector<char> block_;
+    std::vector<PartitionState> states_;
+    size_t position_ = 0;
+  };
+
+  KeyedAggregator(double epsilon, double delta, T lower, T upper,
+                  int max_partitions_contributed,
+                  int max_contributions_per_partition,
+                  std::unique_ptr<PartitionSelectionStrategy> partition_selection,
+                  std::unique_ptr<NumericalMechanism> count_mechanism,
+                  std::unique_ptr<NumericalMechanism> sum_mechanism,
+                  std::optional<int64_t> memory_budget,
+                  base::MemoryBudget* shared_memory_budget,
+                  std::string spill_directory)
+      : epsilon_(epsilon),
+        delta_(delta),
+        lower_(lower),
+        upper_(upper),
+        max_partitions_contributed_(max_partitions_contributed),
+        max_contributions_per_partition_(max_contributions_per_partition),
+        partition_selection_(std::move(partition_selection)),
+        count_mechanism_(std::move(count_mechanism)),
+        sum_mechanism_(std::move(sum_mechanism)),
+        memory_budget_(memory_budget),
+        shared_memory_budget_(shared_memory_budget),
+        spill_directory_(std::move(spill_directory)),
+        spill_id_(SecureURBG::GetInstance()()) {}
+
+  // Type that the sum mechanism adds noise to.
+  using NoisedSum =
+      std::conditional_t<std::is_integral<T>::value, int64_t, double>;
+
+  // Counts and sums of the partitions kept by partition selection. They are
+  // noised together after all partitions were selected, with one batched
+  // AddNoise call per mechanism. Keys are concatenated like in
+  // ColumnarResult, so that kept partitions do not allocate their keys.
+  struct KeptPartitions {
+    std::string key_data;
+    std::vector<int64_t> key_offsets = {0};
+    std::vector<int64_t> counts;
+    std::vector<NoisedSum> sums;
+  };
+
+  // Adds a partition to kept if it is kept by partition selection.
+  void AddResult(const PartitionState& state, KeptPartitions* kept) {
+    if (!partition_selection_->ShouldKeep(state.num_privacy_units)) {
+      return;
+    }
+    kept->key_data.append(state.partition_key.data(),
+                          state.partition_key.size());
+    kept->key_offsets.push_back(kept->key_data.size());
+    kept->counts.push_back(state.count);
+    kept->sums.push_back(static_cast<NoisedSum>(state.sum));
+  }
+
+  // Selects the partitions to keep, including those of spilled runs, and
+  // noises their counts and sums. Consumes the budget.
+  absl::StatusOr<KeptPartitions> SelectAndNoise() {
+    if (result_returned_) {
+      return absl::InvalidArgumentError(
+          "The algorithm can only produce results once for a given epsilon, "
+          "delta budget.");
+    }
+    RETURN_IF_ERROR(spill_status_);
+    result_returned_ = true;
+
+    KeptPartitions kept;
+    {
+      instrumentation::ScopedEvent event(
+          instrumentation::Event::kPartitionSelection);
+      int64_t considered = 0;
+      if (runs_.empty()) {
+        for (const PartitionState& state : partitions_) {
+          AddResult(state, &kept);
+        }
+        considered = partitions_.size();
+      } else {
+        RETURN_IF_ERROR(Spill());
+        RETURN_IF_ERROR(
+            MergeRuns([this, &kept, &considered](const PartitionState& state) {
+              AddResult(state, &kept);
+              ++considered;
+            }));
+        RemoveRuns();
+      }
+      event.set_count(considered);
+    }
+    RETURN_IF_ERROR(count_mechanism_->AddNoise(
+        absl::MakeConstSpan(kept.counts), absl::MakeSpan(kept.counts)));
+    RETURN_IF_ERROR(sum_mechanism_->AddNoise(absl::MakeConstSpan(kept.sums),
+                                             absl::MakeSpan(kept.sums)));
+    return kept;
+  }
+
+  static T NoisedSumToValue(NoisedSum noisy_sum) {
+    if constexpr (std::is_integral<T>::value) {
+      return SafeCastFromDouble<T>(std::round(static_cast<double>(noisy_sum)))
+          .value;
+    } else {
+      return static_cast<T>(noisy_sum);
+    }
+  }
+
+  static std::string EncodeRunBlock(
+      absl::Span<const PartitionState* const> states) {
+    const uint32_t num_partitions = states.size();
+    std::vector<uint32_t> key_sizes;
+    std::string keys;
+    std::vector<int64_t> privacy_units;
+    std::vector<int64_t> counts;
+    std::vector<T> sums;
+    key_sizes.reserve(states.size());
+    privacy_units.reserve(states.size());
+    counts.reserve(states.size());
+    sums.reserve(states.size());
+    for (const PartitionState* state : states) {
+      key_sizes.push_back(state->partition_key.size());
+      keys.append(state->partition_key.data(), state->partition_key.size());
+      privacy_units.push_back(state->num_privacy_units);
+      counts.push_back(state->count);
+      sums.push_back(state->sum);
+    }
+    internal::BinarySummaryWriter writer =
+        internal::MakeBinarySummaryWriter<T>(
+            internal::BinarySummaryType::kKeyedAggregatorRun);
+    writer.AppendArray<uint32_t>(absl::MakeConstSpan(&num_partitions, 1));
+    writer.AppendArray<uint32_t>(key_sizes);
+    writer.AppendBytes(keys);
+    writer.AppendArray<int64_t>(privacy_units);
+    writer.AppendArray<int64_t>(counts);
+    writer.AppendArray<T>(sums);
+    return std::move(writer).Finish();
+  }
+
+  // Decodes a block written by EncodeRunBlock into states, whose keys point
+  // into block. Returns false if the block is invalid.
+  static bool DecodeRunBlock(absl::string_view block,
+                             std::vector<PartitionState>* states) {
+    absl::StatusOr<internal::BinarySummaryReader> reader =
+        internal::MakeBinarySummaryReader<T>(
+            block, internal::BinarySummaryType::kKeyedAggregatorRun);
+    if (!reader.ok()) return false;
+    absl::StatusOr<internal::BinarySummaryArray<uint32_t>> num_partitions =
+        reader->ReadArray<uint32_t>(1);
+    if (!num_partitions.ok()) return false;
+    const size_t n = (*num_partitions)[0];
+    absl::StatusOr<internal::BinarySummaryArray<uint32_t>> key_sizes =
+        reader->ReadArray<uint32_t>(n);
+    absl::StatusOr<absl::string_view> keys = reader->ReadBytes();
+    absl::StatusOr<internal::BinarySummaryArray<int64_t>> privacy_units =
+        reader->ReadArray<int64_t>(n);
+    absl::StatusOr<internal::BinarySummaryArray<int64_t>> counts =
+        reader->ReadArray<int64_t>(n);
+    absl::StatusOr<internal::BinarySummaryArray<T>> sums =
+        reader->ReadArray<T>(n);
+    if (!key_sizes.ok() || !keys.ok() || !privacy_units.ok() || !counts.ok() ||
+        !sums.ok() || !reader->Finish().ok()) {
+      return false;
+    }
+
+    states->resize(n);
+    size_t offset = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if ((*key_sizes)[i] > keys->size() - offset) {
+        return false;
+      }
+      (*states)[i].partition_key = keys->substr(offset, (*key_sizes)[i]);
+      offset += (*key_sizes)[i];
+      (*states)[i].num_privacy_units = (*privacy_units)[i];
+      (*states)[i].count = (*counts)[i];
+      (*states)[i].sum = (*sums)[i];
+    }
+    return true;
+  }
+
+  // Writes a block prefixed with its size as uint64, the framing of run files
+  // and checkpoints.
+  static void WriteBlock(absl::string_view block, std::ostream& output) {
+    const uint64_t size = block.size();
+    output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    output.write(block.data(), block.size());
+  }
+
+  // Splits the next block written by WriteBlock off data. Returns false at
+  // the end of data or if the block is truncated.
+  static bool NextBlock(absl::string_view* data, absl::string_view* block) {
+    uint64_t size;
+    if (data->size() < sizeof(size)) return false;
+    std::memcpy(&size, data->data(), sizeof(size));
+    data->remove_prefix(sizeof(size));
+    if (size > data->size()) return false;
+    *block = data->substr(0, size);
+    data->remove_prefix(size);
+    return true;
+  }
+
+  // Writes sorted states as run blocks of kPartitionsPerRunBlock partitions.
+  static void WriteRunBlocks(absl::Span<const PartitionState* const> sorted,
+                             std::ostream& output) {
+    for (size_t begin = 0; begin < sorted.size();
+         begin += kPartitionsPerRunBlock) {
+      WriteBlock(EncodeRunBlock(sorted.subspan(begin, kPartitionsPerRunBlock)),
+                 output);
+    }
+  }
+
+  // Returns the partitions in memory sorted by key.
+  std::vector<const PartitionState*> SortedPartitions() const {
+    std::vector<const PartitionState*> sorted;
+    sorted.reserve(partitions_.size());
+    for (const PartitionState& state : partitions_) {
+      sorted.push_back(&state);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const PartitionState* a, const PartitionState* b) {
+                return a->partition_key < b->partition_key;
+              });
+    return sorted;
+  }
+
+  // The first block of a checkpoint holds the parameters of the aggregator,
+  // so that it is only restored into an aggregator with the same ones.
+  std::string EncodeCheckpointHeader() const {
+    const double privacy[] = {epsilon_, delta_};
+    const T bounds[] = {lower_, upper_};
+    const int64_t contributions[] = {
+        static_cast<int64_t>(max_partitions_contributed_),
+        static_cast<int64_t>(max_contributions_per_partition_)};
+    internal::BinarySummaryWriter writer =
+        internal::MakeBinarySummaryWriter<T>(
+            internal::BinarySummaryType::kKeyedAggregatorCheckpoint);
+    writer.AppendArray<double>(privacy);
+    writer.AppendArray<T>(bounds);
+    writer.AppendArray<int64_t>(contributions);
+    return std::move(writer).Finish();
+  }
+
+  absl::Status CheckCheckpointHeader(absl::string_view header) const {
+    ASSIGN_OR_RETURN(
+        internal::BinarySummaryReader reader,
+        internal::MakeBinarySummaryReader<T>(
+            header, internal::BinarySummaryType::kKeyedAggregatorCheckpoint));
+    ASSIGN_OR_RETURN(internal::BinarySummaryArray<double> privacy,
+                     reader.ReadArray<double>(2));
+    ASSIGN_OR_RETURN(internal::BinarySummaryArray<T> bounds,
+                     reader.ReadArray<T>(2));
+    ASSIGN_OR_RETURN(internal::BinarySummaryArray<int64_t> contributions,
+                     reader.ReadArray<int64_t>(2));
+    RETURN_IF_ERROR(reader.Finish());
+    if (privacy[0] != epsilon_ || privacy[1] != delta_ ||
+        bounds[0] != lower_ || bounds[1] != upper_ ||
+        contributions[0] != max_partitions_contributed_ ||
+        contributions[1] != max_contributions_per_partition_) {
+      return absl::InvalidArgumentError(
+          "Checkpoint was written by a KeyedAggregator with different "
+          "parameters.");
+    }
+    return absl::OkStatus();
+  }
+
+  static absl::Status CorruptedCheckpointError(const std::string& path) {
+    return absl::InternalError(
+        absl::StrCat("Checkpoint ", path, " is truncated or corrupted."));
+  }
+
+  // Replaces the bytes charged to the shared memory budget, if any.
+  void ChargeSharedMemoryBudget(int64_t bytes) {
+    if (shared_memory_budget_ != nullptr) {
+      shared_memory_budget_->Charge(bytes - charged_bytes_);
+      charged_bytes_ = bytes;
+    }
+  }
+
+  void SpillIfOverBudget() {
+    ChargeSharedMemoryBudget(MemoryUsed());
+    const bool over_budget =
+        (memory_budget_.has_value() && MemoryUsed() > *memory_budget_) ||
+        (shared_memory_budget_ != nullptr &&
+         shared_memory_budget_->Exceeded() &&
+         (MemoryUsed() - memory_used_after_spill_) *
+                 kSharedBudgetSpillFraction >=
+             shared_memory_budget_->limit());
+    if (over_budget && spill_status_.ok()) {
+      // Errors are returned by PartialResult, since they make the result
+      // incomplete.
+      spill_status_ = Spill();
+    }
+  }
+
+  // Merges the sorted runs, adding up the states of equal partition keys, and
+  // calls visit with the merged partitions in order of their keys. The key of
+  // a merged partition is only valid during the call.
+  absl::Status MergeRuns(
+      absl::FunctionRef<void(const PartitionState&)> visit) {
+    std::vector<RunReader> readers;
+    readers.reserve(runs_.size());
+    std::vector<size_t> heap;
+    for (const std::string& run : runs_) {
+      readers.emplace_back(run);
+      ASSIGN_OR_RETURN(bool has_partition, readers.back().Next());
+      if (has_partition) {
+        heap.push_back(readers.size() - 1);
+      }
+    }
+    // Min-heap of the readers by the key of their current partition.
+    auto greater = [&readers](size_t a, size_t b) {
+      return readers[a].state().partition_key >
+             readers[b].state().partition_key;
+    };
+    std::make_heap(heap.begin(), heap.end(), greater);
+    // Moves the reader with the smallest key to its next partition, after
+    // adding its current partition to merged.
+    auto pop = [&](PartitionState* merged) -> absl::Status {
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      RunReader& reader = readers[heap.back()];
+      merged->num_privacy_units += reader.state().num_privacy_units;
+      merged->count += reader.state().count;
+      merged->sum = SafeAdd<T>(merged->sum, reader.state().sum).value;
+      ASSIGN_OR_RETURN(bool has_partition, reader.Next());
+      if (has_partition) {
+        std::push_heap(heap.begin(), heap.end(), greater);
+      } else {
+        heap.pop_back();
+      }
+      return absl::OkStatus();
+    };
+
+    std::string key;
+    while (!heap.empty()) {
+      key = std::string(readers[heap.front()].state().partition_key);
+      PartitionState merged;
+      merged.partition_key = key;
+      RETURN_IF_ERROR(pop(&merged));
+      while (!heap.empty() &&
+             readers[heap.front()].state().partition_key == key) {
+        RETURN_IF_ERROR(pop(&merged));
+      }
+      visit(merged);
+    }
+    return absl::OkStatus();
+  }
+
+  void RemoveRuns() {
+    for (const std::string& run : runs_) {
+      std::remove(run.c_str());
+    }
+    runs_.clear();
+  }
+
+  PartitionState& FindOrInsert(absl::string_view partition_key) {
+    auto it = index_.find(partition_key);
+    if (it != index_.end()) {
+      return partitions_[it->second];
+    }
+    PartitionState& state = partitions_.emplace_back();
+    state.partition_key = key_arena_.Store(partition_key);
+    index_.emplace(state.partition_key, partitions_.size() - 1);
+    return state;
+  }
+
+  const double epsilon_;
+  const double delta_;
+  const T lower_;
+  const T upper_;
+  const size_t max_partitions_contributed_;
+  const size_t max_contributions_per_partition_;
+
+  std::unique_ptr<PartitionSelectionStrategy> partition_selection_;
+  std::unique_ptr<NumericalMechanism> count_mechanism_;
+  std::unique_ptr<NumericalMechanism> sum_mechanism_;
+
+  // State of all partitions, indexed by the values of index_.
+  std::vector<PartitionState> partitions_;
+  // Maps partition keys, which point into key_arena_, to their state.
+  absl::flat_hash_map<absl::string_view, int> index_;
+  KeyArena key_arena_;
+
+  bool result_returned_ = false;
+
+  // Spill configuration, see the Builder.
+  const std::optional<int64_t> memory_budget_;
+  base::MemoryBudget* const shared_memory_budget_;
+  // Bytes of MemoryUsed() currently charged to shared_memory_budget_.
+  int64_t charged_bytes_ = 0;
+  // MemoryUsed() after the last spill, without any partitions.
+  int64_t memory_used_after_spill_ = 0;
+  const std::string spill_directory_;
+  // Distinguishes the run files of different aggregators in a directory.
+  const uint64_t spill_id_;
+  // Paths of the spilled runs, in the order they were written.
+  std::vector<std::string> runs_;
+  // Error of the last automatic spill, returned by PartialResult.
+  absl::Status spill_status_;
+};
+
+template <typename T>
+class KeyedAggregator<T>::Builder {
+ public:
+  KeyedAggregator<T>::Builder& SetEpsilon(double epsilon) {
+    epsilon_ = epsilon;
+    return *this;
+  }
+
+  KeyedAggregator<T>::Builder& SetDelta(double delta) {
+    delta_ = delta;
+    return *this;
+  }
+
+  KeyedAggregator<T>::Builder& SetMaxPartitionsContributed(
+      int max_partitions_contributed) {
+    max_partitions_contributed_ = max_partitions_contributed;
+    return *this;
+  }
+
+  KeyedAggregator<T>::Builder& SetMaxContributionsPerPartition(
+      int max_contributions_per_partition) {
+    max_contributions_per_partition_ = max_contributions_per_partition;
+    return *this;
+  }
+
+  KeyedAggregator<T>::Builder& SetLower(T lower) {
+    lower_ = lower;
+    return *this;
+  }
+
+  KeyedAggregator<T>::Builder& SetUpper(T upper) {
+    upper_ = upper;
+    return *this;
+  }
+
+  // Mechanism used to add noise to the count and the sum. Defaults to Laplace.
+  KeyedAggregator<T>::Builder& SetLaplaceMechanism(
+      std::unique_ptr<NumericalMechanismBuilder> mechanism_builder) {
+    mechanism_builder_ = std::move(mechanism_builder);
+    return *this;
+  }
+
+  // Strategy used to decide which partitions are released. Epsilon, delta and
+  // max partitions contributed are set by this builder. Defaults to
+  // NearTruncatedGeometricPartitionSelection, which needs a positive delta.
+  KeyedAggregator<T>::Builder& SetPartitionSelectionStrategy(
+      std::unique_ptr<PartitionSelectionStrategyBuilder>
+          partition_selection_builder) {
+    partition_selection_builder_ = std::move(partition_selection_builder);
+    return *this;
+  }
+
+  // Number of bytes of MemoryUsed() above which the states of the partitions
+  // are spilled to a run file in the spill directory, which must be set as
+  // well. By default, all partitions are kept in memory.
+  KeyedAggregator<T>::Builder& SetMemoryBudget(int64_t memory_budget) {
+    memory_budget_ = memory_budget;
+    return *this;
+  }
+
+  // Memory budget shared with other aggregators and algorithms of a pipeline.
+  // The aggregator charges its MemoryUsed() to it and spills its partitions
+  // whenever the budget is exceeded, so the spill directory must be set as
+  // well. The budget must outlive the aggregator.
+  KeyedAggregator<T>::Builder& SetSharedMemoryBudget(
+      base::MemoryBudget* memory_budget) {
+    shared_memory_budget_ = memory_budget;
+    return *this;
+  }
+
+  // Directory for the run files of spilled partitions, e.g., a directory on a
+  // local disk. Run files are removed once the result is returned, on Reset(),
+  // and when the aggregator is destroyed.
+  KeyedAggregator<T>::Builder& SetSpillDirectory(std::string spill_directory) {
+    spill_directory_ = std::move(spill_directory);
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<T>>> Build() {
+    RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
+    RETURN_IF_ERROR(ValidateDelta(delta_));
+    RETURN_IF_ERROR(
+        ValidateMaxPartitionsContributed(max_partitions_contributed_));
+    RETURN_IF_ERROR(
+        ValidateMaxContributionsPerPartition(max_contributions_per_partition_));
+    if (!lower_.has_value() || !upper_.has_value()) {
+      return absl::InvalidArgumentError(
+          "Lower and upper bounds must be set for KeyedAggregator.");
+    }
+    RETURN_IF_ERROR(ValidateBounds(lower_, upper_));
+    if (memory_budget_.has_value()) {
+      if (*memory_budget_ <= 0) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Memory budget must be positive, but is ",
+                         *memory_budget_, "."));
+      }
+      if (spill_directory_.empty()) {
+        return absl::InvalidArgumentError(
+            "A spill directory must be set for a memory budget.");
+      }
+    }
+    if (shared_memory_budget_ != nullptr && spill_directory_.empty()) {
+      return absl::InvalidArgumentError(
+          "A spill directory must be set for a shared memory budget.");
+    }
+    if (lower_.value() < -1 * std::numeric_limits<T>::max()) {
+      return absl::InvalidArgumentError(
+          "Lower bound cannot be higher in magnitude than the max numeric "
+          "limit.");
+    }
+
+    const double epsilon = epsilon_.value() / 3;
+    const double delta = delta_ / 3;
+    ASSIGN_OR_RETURN(std::unique_ptr<PartitionSelectionStrategy> selection,
+                     partition_selection_builder_->SetEpsilon(epsilon)
+                         .SetDelta(delta)
+                         .SetMaxPartitionsContributed(
+                             max_partitions_contributed_)
+                         .Build());
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> count_mechanism,
+                     mechanism_builder_->Clone()
+                         ->SetEpsilon(epsilon)
+                         .SetDelta(delta)
+                         .SetL0Sensitivity(max_partitions_contributed_)
+                         .SetLInfSensitivity(max_contributions_per_partition_)
+                         .Build());
+    const double max_magnitude =
+        std::max(std::abs(static_cast<double>(lower_.value())),
+                 std::abs(static_cast<double>(upper_.value())));
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> sum_mechanism,
+                     mechanism_builder_->Clone()
+                         ->SetEpsilon(epsilon)
+                         .SetDelta(delta)
+                         .SetL0Sensitivity(max_partitions_contributed_)
+                         .SetLInfSensitivity(max_contributions_per_partition_ *
+                                             max_magnitude)
+                         .Build());
+    return absl::WrapUnique(new KeyedAggregator<T>(
+        epsilon_.value(), delta_, lower_.value(), upper_.value(),
+        max_partitions_contributed_, max_contributions_per_partition_,
+        std::move(selection), std::move(count_mechanism),
+        std::move(sum_mechanism), memory_budget_, shared_memory_budget_,
+        spill_directory_));
+  }
+
+ private:
+  std::optional<double> epsilon_;
+  double delta_ = 0;
+  std::optional<T> lower_;
+  std::optional<T> upper_;
+  int max_partitions_contributed_ = 1;
+  int max_contributions_per_partition_ = 1;
+  std::optional<int64_t> memory_budget_;
+  base::MemoryBudget* shared_memory_budget_ = nullptr;
+  std::string spill_directory_;
+  std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
+      std::make_unique<LaplaceMechanism::Builder>();
+  std::unique_ptr<PartitionSelectionStrategyBuilder>
+      partition_selection_builder_ =
+          std::make_unique<NearTruncatedGeometricPartitionSelection::Builder>();
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_KEYED_AGGREGATOR_H_
@@ -0,0 +1,607 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/keyed-aggregator.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/partition-selection.h"
+#include "proto/util.h"
+#include "base/instrumentation.h"
+#include "base/memory_budget.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::Pair;
+
+// Keeps exactly the partitions with at least `min_users` privacy units.
+class ThresholdPartitionSelection : public PartitionSelectionStrategy {
+ public:
+  class Builder : public PartitionSelectionStrategyBuilder {
+   public:
+    explicit Builder(int min_users) : min_users_(min_users) {}
+
+    absl::StatusOr<std::unique_ptr<PartitionSelectionStrategy>> Build()
+        override {
+      return absl::WrapUnique(new ThresholdPartitionSelection(
+          GetEpsilon().value(), GetDelta().value(),
+          GetMaxPartitionsContributed().value(), min_users_));
+    }
+
+   private:
+    int min_users_;
+  };
+
+  bool ShouldKeep(double num_users) override {
+    return num_users >= GetPreThreshold();
+  }
+
+  double ProbabilityOfKeep(double num_users) const override {
+    return num_users >= GetPreThreshold() ? 1 : 0;
+  }
+
+ private:
+  ThresholdPartitionSelection(double epsilon, double delta,
+                              int64_t max_partitions_contributed,
+                              int min_users)
+      : PartitionSelectionStrategy(epsilon, delta, max_partitions_contributed,
+                                   /*adjusted_delta=*/0, min_users) {}
+};
+
+template <typename T>
+using Contributions = std::vector<typename KeyedAggregator<T>::Contribution>;
+
+// Returns partition key -> (count, sum) of the result.
+template <typename T>
+std::map<std::string, std::pair<int64_t, T>> GetResults(
+    KeyedAggregator<T>& aggregator) {
+  std::map<std::string, std::pair<int64_t, T>> results;
+  absl::StatusOr<std::vector<typename KeyedAggregator<T>::PartitionResult>>
+      partitions = aggregator.PartialResult();
+  EXPECT_OK(partitions);
+  if (!partitions.ok()) return results;
+  for (const auto& partition : *partitions) {
+    results[partition.partition_key] = {
+        GetValue<int64_t>(
+            partition.output.elements(KeyedAggregator<T>::kCountIndex)
+                .value()),
+        GetValue<T>(
+            partition.output.elements(KeyedAggregator<T>::kSumIndex).value())};
+  }
+  return results;
+}
+
+template <typename T>
+typename KeyedAggregator<T>::Builder ZeroNoiseBuilder(int min_users = 1) {
+  typename KeyedAggregator<T>::Builder builder;
+  builder.SetEpsilon(1.0)
+      .SetLower(-10)
+      .SetUpper(10)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+      .SetPartitionSelectionStrategy(
+          std::make_unique<ThresholdPartitionSelection::Builder>(min_users));
+  return builder;
+}
+
+template <typename T>
+class KeyedAggregatorTest : public ::testing::Test {};
+
+typedef ::testing::Types<int64_t, double> NumericTypes;
+TYPED_TEST_SUITE(KeyedAggregatorTest, NumericTypes);
+
+TYPED_TEST(KeyedAggregatorTest, CountsAndSumsPerPartition) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> aggregator =
+      ZeroNoiseBuilder<TypeParam>()
+          .SetMaxPartitionsContributed(2)
+          .SetMaxContributionsPerPartition(3)
+          .Build();
+  ASSERT_OK(aggregator);
+
+  (*aggregator)
+      ->AddPrivacyUnitContributions(
+          Contributions<TypeParam>{{"apple", 1}, {"pear", 2}, {"apple", 3}});
+  (*aggregator)
+      ->AddPrivacyUnitContributions(Contributions<TypeParam>{{"apple", 20}});
+  EXPECT_EQ((*aggregator)->NumPartitions(), 2);
+
+  // The second contribution to apple is clamped to 10.
+  std::map<std::string, std::pair<int64_t, TypeParam>> expected = {
+      {"apple", {3, 14}}, {"pear", {1, 2}}};
+  EXPECT_EQ(GetResults(**aggregator), expected);
+}
+
+TYPED_TEST(KeyedAggregatorTest, BoundsPartitionsContributed) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> aggregator =
+      ZeroNoiseBuilder<TypeParam>().SetMaxPartitionsContributed(3).Build();
+  ASSERT_OK(aggregator);
+
+  Contributions<TypeParam> contributions;
+  std::vector<std::string> keys;
+  for (int i = 0; i < 10; ++i) {
+    keys.push_back(absl::StrCat("partition", i));
+  }
+  for (const std::string& key : keys) {
+    contributions.push_back({key, 1});
+  }
+  (*aggregator)->AddPrivacyUnitContributions(contributions);
+
+  EXPECT_EQ((*aggregator)->NumPartitions(), 3);
+  for (const auto& [key, count_and_sum] : GetResults(**aggregator)) {
+    EXPECT_EQ(count_and_sum.first, 1);
+  }
+}
+
+TYPED_TEST(KeyedAggregatorTest, BoundsContributionsPerPartition) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> aggregator =
+      ZeroNoiseBuilder<TypeParam>().SetMaxContributionsPerPartition(2).Build();
+  ASSERT_OK(aggregator);
+
+  (*aggregator)
+      ->AddPrivacyUnitContributions(Contributions<TypeParam>{
+          {"apple", 4}, {"apple", 4}, {"apple", 4}, {"apple", 4}});
+
+  EXPECT_THAT(GetResults(**aggregator),
+              ElementsAre(Pair("apple", Pair(2, 8))));
+}
+
+TYPED_TEST(KeyedAggregatorTest, PartitionSelectionUsesNumberOfPrivacyUnits) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> aggregator =
+      ZeroNoiseBuilder<TypeParam>(/*min_users=*/2)
+          .SetMaxPartitionsContributed(2)
+          .SetMaxContributionsPerPartition(5)
+          .Build();
+  ASSERT_OK(aggregator);
+
+  // A single privacy unit with many contributions does not make the partition
+  // pass selection.
+  (*aggregator)
+      ->AddPrivacyUnitContributions(Contributions<TypeParam>{
+          {"rare", 1}, {"rare", 1}, {"rare", 1}, {"common", 1}});
+  (*aggregator)
+      ->AddPrivacyUnitContributions(Contributions<TypeParam>{{"common", 1}});
+
+  EXPECT_THAT(GetResults(**aggregator),
+              ElementsAre(Pair("common", Pair(2, 2))));
+}
+
+TEST(KeyedAggregatorTest, IgnoresNaN) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<double>>> aggregator =
+      ZeroNoiseBuilder<double>().SetMaxContributionsPerPartition(2).Build();
+  ASSERT_OK(aggregator);
+
+  (*aggregator)
+      ->AddPrivacyUnitContributions(Contributions<double>{
+          {"apple", std::numeric_limits<double>::quiet_NaN()}, {"apple", 1}});
+  (*aggregator)
+      ->AddPrivacyUnitContributions(Contributions<double>{
+          {"pear", std::numeric_limits<double>::quiet_NaN()}});
+
+  EXPECT_THAT(GetResults(**aggregator),
+              ElementsAre(Pair("apple", Pair(1, 1.0))));
+}
+
+TEST(KeyedAggregatorTest, SumSaturatesInsteadOfOverflowing) {
+  constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+      ZeroNoiseBuilder<int64_t>().SetLower(0).SetUpper(kMax).Build();
+  ASSERT_OK(aggregator);
+
+  (*aggregator)
+      ->AddPrivacyUnitContributions(Contributions<int64_t>{{"apple", kMax}});
+  (*aggregator)
+      ->AddPrivacyUnitContributions(Contributions<int64_t>{{"apple", kMax}});
+
+  EXPECT_THAT(GetResults(**aggregator),
+              ElementsAre(Pair("apple", Pair(2, kMax))));
+}
+
+TEST(KeyedAggregatorTest, ReportsIngestionAndPartitionSelection) {
+  std::unique_ptr<KeyedAggregator<int64_t>> aggregator =
+      ZeroNoiseBuilder<int64_t>(/*min_users=*/2)
+          .SetMaxPartitionsContributed(2)
+          .Build()
+          .value();
+  instrumentation::AggregatingSink sink;
+  instrumentation::SetSink(&sink);
+  aggregator->AddPrivacyUnitContributions(
+      Contributions<int64_t>{{"apple", 1}, {"pear", 1}});
+  aggregator->AddPrivacyUnitContributions(Contributions<int64_t>{{"apple", 1}});
+  absl::StatusOr<std::vector<KeyedAggregator<int64_t>::PartitionResult>>
+      result = aggregator->PartialResult();
+  instrumentation::SetSink(nullptr);
+
+  ASSERT_OK(result);
+  EXPECT_EQ(result->size(), 1);
+  EXPECT_EQ(sink.Get(instrumentation::Event::kKeyedAddContributions).calls, 2);
+  EXPECT_EQ(sink.Get(instrumentation::Event::kKeyedAddContributions).count, 3);
+  EXPECT_EQ(sink.Get(instrumentation::Event::kPartitionSelection).calls, 1);
+  EXPECT_EQ(sink.Get(instrumentation::Event::kPartitionSelection).count, 2);
+}
+
+TEST(KeyedAggregatorTest, StoresManyPartitions) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+      ZeroNoiseBuilder<int64_t>().Build();
+  ASSERT_OK(aggregator);
+  const int64_t empty_memory = (*aggregator)->MemoryUsed();
+
+  constexpr int kNumPartitions = 100000;
+  for (int i = 0; i < kNumPartitions; ++i) {
+    const std::string key = absl::StrCat("a long partition key number ", i);
+    (*aggregator)->AddPrivacyUnitContributions(
+        Contributions<int64_t>{{key, i % 7}});
+  }
+
+  EXPECT_EQ((*aggregator)->NumPartitions(), kNumPartitions);
+  EXPECT_GT((*aggregator)->MemoryUsed(), empty_memory);
+  std::map<std::string, std::pair<int64_t, int64_t>> results =
+      GetResults(**aggregator);
+  ASSERT_EQ(results.size(), kNumPartitions);
+  EXPECT_THAT(results["a long partition key number 12345"],
+              Pair(1, 12345 % 7));
+}
+
+TEST(KeyedAggregatorTest, ResultCanOnlyBeReturnedOnce) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+      ZeroNoiseBuilder<int64_t>().Build();
+  ASSERT_OK(aggregator);
+  (*aggregator)->AddPrivacyUnitContributions(Contributions<int64_t>{{"a", 1}});
+
+  ASSERT_OK((*aggregator)->PartialResult());
+  EXPECT_THAT((*aggregator)->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("only produce results once")));
+
+  (*aggregator)->Reset();
+  EXPECT_EQ((*aggregator)->NumPartitions(), 0);
+  (*aggregator)->AddPrivacyUnitContributions(Contributions<int64_t>{{"b", 2}});
+  EXPECT_THAT(GetResults(**aggregator), ElementsAre(Pair("b", Pair(1, 2))));
+}
+
+TYPED_TEST(KeyedAggregatorTest, ColumnarResultMatchesPartialResult) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> aggregator =
+      ZeroNoiseBuilder<TypeParam>(/*min_users=*/2)
+          .SetMaxPartitionsContributed(2)
+          .Build();
+  ASSERT_OK(aggregator);
+  for (int i = 0; i < 100; ++i) {
+    (*aggregator)
+        ->AddPrivacyUnitContributions(Contributions<TypeParam>{
+            {absl::StrCat("key", i % 30), static_cast<TypeParam>(i % 7)},
+            {"rare", static_cast<TypeParam>(i)}});
+  }
+  const std::map<std::string, std::pair<int64_t, TypeParam>> expected =
+      GetResults(**aggregator);
+  (*aggregator)->Reset();
+  for (int i = 0; i < 100; ++i) {
+    (*aggregator)
+        ->AddPrivacyUnitContributions(Contributions<TypeParam>{
+            {absl::StrCat("key", i % 30), static_cast<TypeParam>(i % 7)},
+            {"rare", static_cast<TypeParam>(i)}});
+  }
+
+  absl::StatusOr<typename KeyedAggregator<TypeParam>::ColumnarResult> result =
+      (*aggregator)->PartialColumnarResult();
+  ASSERT_OK(result);
+  ASSERT_EQ(result->key_offsets.size(), result->size() + 1);
+  ASSERT_EQ(result->sums.size(), result->size());
+  EXPECT_EQ(result->key_offsets.back(), result->key_data.size());
+  std::map<std::string, std::pair<int64_t, TypeParam>> results;
+  for (int64_t i = 0; i < result->size(); ++i) {
+    results[std::string(result->key(i))] = {result->counts[i],
+                                            result->sums[i]};
+  }
+  EXPECT_EQ(results, expected);
+  EXPECT_THAT((*aggregator)->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+// Returns a new empty directory for spilled runs.
+std::string MakeSpillDirectory(absl::string_view name) {
+  const char* tmpdir = std::getenv("TEST_TMPDIR");
+  std::string directory =
+      absl::StrCat(tmpdir != nullptr ? tmpdir : "/tmp", "/", name, "XXXXXX");
+  return mkdtemp(directory.data()) != nullptr ? directory : "";
+}
+
+TYPED_TEST(KeyedAggregatorTest, SpillingDoesNotChangeResult) {
+  const std::string directory = MakeSpillDirectory("spill");
+  ASSERT_FALSE(directory.empty());
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> in_memory =
+      ZeroNoiseBuilder<TypeParam>().SetMaxPartitionsContributed(3).Build();
+  ASSERT_OK(in_memory);
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> spilling =
+      ZeroNoiseBuilder<TypeParam>()
+          .SetMaxPartitionsContributed(3)
+          .SetMemoryBudget(1)
+          .SetSpillDirectory(directory)
+          .Build();
+  ASSERT_OK(spilling);
+
+  for (int i = 0; i < 10000; ++i) {
+    const std::string key = absl::StrCat("key", i % 5000);
+    const Contributions<TypeParam> contributions = {
+        {key, static_cast<TypeParam>(i % 3)}, {"common", 1}};
+    (*in_memory)->AddPrivacyUnitContributions(contributions);
+    (*spilling)->AddPrivacyUnitContributions(contributions);
+  }
+
+  EXPECT_GT((*spilling)->NumSpilledRuns(), 1);
+  EXPECT_LT((*spilling)->NumPartitions(), 10);
+  std::map<std::string, std::pair<int64_t, TypeParam>> expected =
+      GetResults(**in_memory);
+  ASSERT_EQ(expected.size(), 5001);
+  EXPECT_EQ(GetResults(**spilling), expected);
+  EXPECT_EQ((*spilling)->NumSpilledRuns(), 0);
+}
+
+TEST(KeyedAggregatorTest, SpillsWhenMemoryBudgetIsExceeded) {
+  const std::string directory = MakeSpillDirectory("budget");
+  ASSERT_FALSE(directory.empty());
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+      ZeroNoiseBuilder<int64_t>()
+          .SetMemoryBudget(1 << 20)
+          .SetSpillDirectory(directory)
+          .Build();
+  ASSERT_OK(aggregator);
+
+  for (int i = 0; i < 100000; ++i) {
+    (*aggregator)->AddPrivacyUnitContributions(
+        Contributions<int64_t>{{absl::StrCat("a long partition key ", i), 1}});
+    EXPECT_LE((*aggregator)->MemoryUsed(), 1 << 20);
+  }
+
+  EXPECT_GT((*aggregator)->NumSpilledRuns(), 0);
+  EXPECT_EQ(GetResults(**aggregator).size(), 100000);
+}
+
+TEST(KeyedAggregatorTest, SpillsWhenSharedMemoryBudgetIsExceeded) {
+  constexpr int64_t kLimit = 1 << 20;
+  const std::string directory = MakeSpillDirectory("shared");
+  ASSERT_FALSE(directory.empty());
+  base::MemoryBudget budget(kLimit);
+  {
+    std::vector<std::unique_ptr<KeyedAggregator<int64_t>>> aggregators;
+    for (int a = 0; a < 2; ++a) {
+      absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+          ZeroNoiseBuilder<int64_t>()
+              .SetSharedMemoryBudget(&budget)
+              .SetSpillDirectory(directory)
+              .Build();
+      ASSERT_OK(aggregator);
+      aggregators.push_back(*std::move(aggregator));
+    }
+
+    for (int i = 0; i < 100000; ++i) {
+      for (auto& aggregator : aggregators) {
+        aggregator->AddPrivacyUnitContributions(Contributions<int64_t>{
+            {absl::StrCat("a long partition key ", i), 1}});
+      }
+      EXPECT_LE(budget.bytes_used(), 2 * kLimit);
+    }
+
+    EXPECT_EQ(budget.bytes_used(),
+              aggregators[0]->MemoryUsed() + aggregators[1]->MemoryUsed());
+    for (auto& aggregator : aggregators) {
+      EXPECT_GT(aggregator->NumSpilledRuns(), 0);
+      EXPECT_EQ(GetResults(*aggregator).size(), 100000);
+    }
+  }
+  EXPECT_EQ(budget.bytes_used(), 0);
+}
+
+TEST(KeyedAggregatorTest, SharedMemoryBudgetRequiresSpillDirectory) {
+  base::MemoryBudget budget(1 << 20);
+  EXPECT_THAT(ZeroNoiseBuilder<int64_t>().SetSharedMemoryBudget(&budget).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("spill directory")));
+}
+
+TEST(KeyedAggregatorTest, ResetRemovesSpilledRuns) {
+  const std::string directory = MakeSpillDirectory("reset");
+  ASSERT_FALSE(directory.empty());
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+      ZeroNoiseBuilder<int64_t>().SetSpillDirectory(directory).Build();
+  ASSERT_OK(aggregator);
+  (*aggregator)->AddPrivacyUnitContributions(Contributions<int64_t>{{"a", 1}});
+  ASSERT_OK((*aggregator)->Spill());
+  EXPECT_EQ((*aggregator)->NumSpilledRuns(), 1);
+
+  (*aggregator)->Reset();
+
+  EXPECT_EQ((*aggregator)->NumSpilledRuns(), 0);
+  (*aggregator)->AddPrivacyUnitContributions(Contributions<int64_t>{{"b", 2}});
+  EXPECT_THAT(GetResults(**aggregator), ElementsAre(Pair("b", Pair(1, 2))));
+}
+
+TEST(KeyedAggregatorTest, SpillWithoutDirectoryFails) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+      ZeroNoiseBuilder<int64_t>().Build();
+  ASSERT_OK(aggregator);
+  (*aggregator)->AddPrivacyUnitContributions(Contributions<int64_t>{{"a", 1}});
+
+  EXPECT_THAT((*aggregator)->Spill(),
+              StatusIs(absl::StatusCode::kFailedPrecondition,
+                       HasSubstr("spill directory")));
+}
+
+TEST(KeyedAggregatorTest, UnwritableSpillDirectoryFailsResult) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+      ZeroNoiseBuilder<int64_t>()
+          .SetMemoryBudget(1)
+          .SetSpillDirectory("/nonexistent/directory")
+          .Build();
+  ASSERT_OK(aggregator);
+  (*aggregator)->AddPrivacyUnitContributions(Contributions<int64_t>{{"a", 1}});
+
+  EXPECT_THAT((*aggregator)->PartialResult(),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("Cannot open spill file")));
+}
+
+TYPED_TEST(KeyedAggregatorTest, RestoredCheckpointDoesNotChangeResult) {
+  const std::string directory = MakeSpillDirectory("checkpoint");
+  ASSERT_FALSE(directory.empty());
+  const std::string path = absl::StrCat(directory, "/state.checkpoint");
+  for (const bool spill : {false, true}) {
+    typename KeyedAggregator<TypeParam>::Builder builder =
+        ZeroNoiseBuilder<TypeParam>();
+    builder.SetMaxPartitionsContributed(3).SetSpillDirectory(directory);
+    if (spill) builder.SetMemoryBudget(1);
+    absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> uninterrupted =
+        builder.Build();
+    ASSERT_OK(uninterrupted);
+    absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> before =
+        builder.Build();
+    ASSERT_OK(before);
+
+    for (int i = 0; i < 10000; ++i) {
+      const std::string key = absl::StrCat("key", i % 5000);
+      const Contributions<TypeParam> contributions = {
+          {key, static_cast<TypeParam>(i % 3)}, {"common", 1}};
+      (*uninterrupted)->AddPrivacyUnitContributions(contributions);
+      if (i < 6000) {
+        (*before)->AddPrivacyUnitContributions(contributions);
+      }
+    }
+    ASSERT_OK((*before)->Checkpoint(path));
+    EXPECT_EQ((*before)->NumSpilledRuns() > 0, spill);
+
+    // A restarted aggregator continues after the checkpoint.
+    absl::StatusOr<std::unique_ptr<KeyedAggregator<TypeParam>>> after =
+        builder.Build();
+    ASSERT_OK(after);
+    ASSERT_OK((*after)->Restore(path));
+    for (int i = 6000; i < 10000; ++i) {
+      const std::string key = absl::StrCat("key", i % 5000);
+      (*after)->AddPrivacyUnitContributions(Contributions<TypeParam>{
+          {key, static_cast<TypeParam>(i % 3)}, {"common", 1}});
+    }
+
+    std::map<std::string, std::pair<int64_t, TypeParam>> expected =
+        GetResults(**uninterrupted);
+    ASSERT_EQ(expected.size(), 5001);
+    EXPECT_EQ(GetResults(**after), expected);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(KeyedAggregatorTest, RestoreChecksCheckpoint) {
+  const std::string directory = MakeSpillDirectory("restore");
+  ASSERT_FALSE(directory.empty());
+  const std::string path = absl::StrCat(directory, "/state.checkpoint");
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+      ZeroNoiseBuilder<int64_t>().Build();
+  ASSERT_OK(aggregator);
+  EXPECT_THAT((*aggregator)->Restore(path),
+              StatusIs(absl::StatusCode::kNotFound));
+  (*aggregator)->AddPrivacyUnitContributions(Contributions<int64_t>{{"a", 1}});
+  ASSERT_OK((*aggregator)->Checkpoint(path));
+
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> other_bounds =
+      ZeroNoiseBuilder<int64_t>().SetUpper(20).Build();
+  ASSERT_OK(other_bounds);
+  EXPECT_THAT((*other_bounds)->Restore(path),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("different parameters")));
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<double>>> other_type =
+      ZeroNoiseBuilder<double>().Build();
+  ASSERT_OK(other_type);
+  EXPECT_THAT((*other_type)->Restore(path),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("different input type")));
+
+  // Truncate the checkpoint within its last block.
+  std::string contents;
+  {
+    std::ifstream file(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(file), {});
+  }
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(contents.data(), contents.size() - 1);
+  }
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> restored =
+      ZeroNoiseBuilder<int64_t>().Build();
+  ASSERT_OK(restored);
+  EXPECT_THAT((*restored)->Restore(path),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("truncated or corrupted")));
+  EXPECT_EQ((*restored)->NumPartitions(), 0);
+  std::remove(path.c_str());
+}
+
+TEST(KeyedAggregatorTest, CheckpointAfterResultFails) {
+  absl::StatusOr<std::unique_ptr<KeyedAggregator<int64_t>>> aggregator =
+      ZeroNoiseBuilder<int64_t>().Build();
+  ASSERT_OK(aggregator);
+  ASSERT_OK((*aggregator)->PartialResult());
+  EXPECT_THAT((*aggregator)->Checkpoint("/nonexistent/checkpoint"),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(KeyedAggregatorTest, BuildValidatesParameters) {
+  EXPECT_THAT(KeyedAggregator<int64_t>::Builder().SetEpsilon(1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("bounds must be set")));
+  EXPECT_THAT(ZeroNoiseBuilder<int64_t>().SetEpsilon(-1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Epsilon")));
+  EXPECT_THAT(ZeroNoiseBuilder<int64_t>().SetMaxPartitionsContributed(0)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Maximum number of partitions")));
+  EXPECT_THAT(ZeroNoiseBuilder<int64_t>().SetDelta(2).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Delta")));
+  EXPECT_THAT(ZeroNoiseBuilder<int64_t>().SetMemoryBudget(0).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Memory budget must be positive")));
+  EXPECT_THAT(ZeroNoiseBuilder<int64_t>().SetMemoryBudget(1 << 20).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("spill directory must be set")));
+  EXPECT_OK(KeyedAggregator<int64_t>::Builder()
+                .SetEpsilon(1)
+                .SetDelta(1e-5)
+                .SetLower(0)
+                .SetUpper(1)
+                .Build());
+}
+
+}  // namespace
+}  // namespace differential_privacy
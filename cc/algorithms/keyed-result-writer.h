@@ -0,0 +1,131 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_KEYED_RESULT_WRITER_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_KEYED_RESULT_WRITER_H_
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "algorithms/keyed-aggregator.h"
+
+namespace differential_privacy {
+
+// Size of the buffer that WriteNdjson fills before writing it to the stream.
+constexpr size_t kDefaultNdjsonBufferSize = 1 << 20;
+
+namespace internal {
+
+// Appends key to buffer as a JSON string. Quotes, backslashes and control
+// characters are escaped; all other bytes are copied as they are, so keys
+// must be valid UTF-8 for the output to be valid JSON.
+inline void AppendJsonString(absl::string_view key, std::string* buffer) {
+  static constexpr char kHexDigits[] = "0123456789abcdef";
+  buffer->push_back('"');
+  for (const char c : key) {
+    switch (c) {
+      case '"':
+        buffer->append("\\\"");
+        break;
+      case '\\':
+        buffer->append("\\\\");
+        break;
+      case '\n':
+        buffer->append("\\n");
+        break;
+      case '\r':
+        buffer->append("\\r");
+        break;
+      case '\t':
+        buffer->append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          buffer->append("\\u00");
+          buffer->push_back(kHexDigits[c >> 4]);
+          buffer->push_back(kHexDigits[c & 0xf]);
+        } else {
+          buffer->push_back(c);
+        }
+    }
+  }
+  buffer->push_back('"');
+}
+
+// Appends the shortest representation of value that parses back to it.
+// Values that are not finite have no JSON representation and are written as
+// null.
+template <typename V>
+void AppendJsonNumber(V value, std::string* buffer) {
+  if constexpr (std::is_floating_point<V>::value) {
+    if (!std::isfinite(value)) {
+      buffer->append("null");
+      return;
+    }
+  }
+  char digits[32];
+  const std::to_chars_result result =
+      std::to_chars(digits, digits + sizeof(digits), value);
+  buffer->append(digits, result.ptr);
+}
+
+}  // namespace internal
+
+// Writes the results of a KeyedAggregator to output as newline-delimited
+// JSON, with one object per partition:
+//
+//   {"partition_key":"apple","count":3,"sum":14}
+//
+// The lines are formatted into a buffer that is written to output whenever it
+// holds buffer_size bytes, so that writing the results of many millions of
+// partitions neither allocates per partition nor buffers the whole output.
+// Returns an error if output fails.
+template <typename T>
+absl::Status WriteNdjson(const KeyedColumnarResult<T>& result,
+                         std::ostream& output,
+                         size_t buffer_size = kDefaultNdjsonBufferSize) {
+  std::string buffer;
+  buffer.reserve(buffer_size + 256);
+  for (int64_t i = 0; i < result.size(); ++i) {
+    buffer.append("{\"partition_key\":");
+    internal::AppendJsonString(result.key(i), &buffer);
+    buffer.append(",\"count\":");
+    internal::AppendJsonNumber(result.counts[i], &buffer);
+    buffer.append(",\"sum\":");
+    internal::AppendJsonNumber(result.sums[i], &buffer);
+    buffer.append("}\n");
+    if (buffer.size() >= buffer_size) {
+      output.write(buffer.data(), buffer.size());
+      buffer.clear();
+    }
+  }
+  output.write(buffer.data(), buffer.size());
+  if (!output) {
+    return absl::InternalError("Cannot write the results.");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_KEYED_RESULT_WRITER_H_
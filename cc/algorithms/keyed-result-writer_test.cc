@@ -0,0 +1,94 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/keyed-result-writer.h"
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/keyed-aggregator.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+
+template <typename T>
+void AddPartition(absl::string_view key, int64_t count, T sum,
+                  KeyedColumnarResult<T>* result) {
+  result->key_data.append(key.data(), key.size());
+  result->key_offsets.push_back(result->key_data.size());
+  result->counts.push_back(count);
+  result->sums.push_back(sum);
+}
+
+TEST(KeyedResultWriterTest, WritesOneLinePerPartition) {
+  KeyedColumnarResult<int64_t> result;
+  AddPartition<int64_t>("apple", 3, 14, &result);
+  AddPartition<int64_t>("", -1, std::numeric_limits<int64_t>::min(), &result);
+  std::ostringstream output;
+  ASSERT_OK(WriteNdjson(result, output));
+  EXPECT_EQ(output.str(),
+            "{\"partition_key\":\"apple\",\"count\":3,\"sum\":14}\n"
+            "{\"partition_key\":\"\",\"count\":-1,"
+            "\"sum\":-9223372036854775808}\n");
+}
+
+TEST(KeyedResultWriterTest, EscapesKeysAndRoundTripsDoubles) {
+  KeyedColumnarResult<double> result;
+  AddPartition<double>("a\"b\\c\nd\x01", 1, 0.1, &result);
+  AddPartition<double>("caf\xc3\xa9", 2, -1e300, &result);
+  AddPartition<double>("nan", 0, std::numeric_limits<double>::quiet_NaN(),
+                       &result);
+  std::ostringstream output;
+  ASSERT_OK(WriteNdjson(result, output));
+  EXPECT_EQ(output.str(),
+            "{\"partition_key\":\"a\\\"b\\\\c\\nd\\u0001\",\"count\":1,"
+            "\"sum\":0.1}\n"
+            "{\"partition_key\":\"caf\xc3\xa9\",\"count\":2,\"sum\":-1e+300}\n"
+            "{\"partition_key\":\"nan\",\"count\":0,\"sum\":null}\n");
+}
+
+TEST(KeyedResultWriterTest, SmallBufferWritesSameOutput) {
+  KeyedColumnarResult<double> result;
+  for (int i = 0; i < 1000; ++i) {
+    AddPartition<double>(absl::StrCat("key", i), i, i / 8.0, &result);
+  }
+  std::ostringstream expected;
+  ASSERT_OK(WriteNdjson(result, expected));
+  std::ostringstream output;
+  ASSERT_OK(WriteNdjson(result, output, /*buffer_size=*/10));
+  EXPECT_EQ(output.str(), expected.str());
+}
+
+TEST(KeyedResultWriterTest, FailedStreamFails) {
+  KeyedColumnarResult<int64_t> result;
+  AddPartition<int64_t>("a", 1, 1, &result);
+  std::ostringstream output;
+  output.setstate(std::ios::badbit);
+  EXPECT_THAT(WriteNdjson(result, output),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+}  // namespace
+}  // namespace differential_privacy
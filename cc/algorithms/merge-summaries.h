@@ -0,0 +1,152 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_MERGE_SUMMARIES_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_MERGE_SUMMARIES_H_
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "proto/summary.pb.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Creates an empty algorithm with the same parameters as the algorithm that the
+// summaries are merged into, e.g., by calling Build() on the same builder.
+template <typename T>
+using AlgorithmFactory =
+    std::function<absl::StatusOr<std::unique_ptr<Algorithm<T>>>()>;
+
+namespace internal {
+
+// Runs task(0), ..., task(num_tasks - 1) on up to num_threads threads and
+// returns the first error. Runs on the calling thread if num_threads <= 1.
+inline absl::Status RunInParallel(int num_tasks, int num_threads,
+                                  const std::function<absl::Status(int)>& task) {
+  num_threads = std::min(num_threads, num_tasks);
+  if (num_threads <= 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      RETURN_IF_ERROR(task(i));
+    }
+    return absl::OkStatus();
+  }
+
+  std::atomic<int> next_task = 0;
+  absl::Mutex mutex;
+  absl::Status status;
+  auto worker = [&]() {
+    for (int i = next_task++; i < num_tasks; i = next_task++) {
+      absl::Status task_status = task(i);
+      if (!task_status.ok()) {
+        absl::MutexLock lock(&mutex);
+        status.Update(task_status);
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (int i = 1; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return status;
+}
+
+}  // namespace internal
+
+// Merges many summaries of the same algorithm into `algorithm` using
+// `num_threads` threads. This has the same result as calling
+// algorithm->Merge(summary) for each summary, up to floating-point rounding of
+// partial sums.
+//
+// The summaries are split into one contiguous chunk per thread. Each thread
+// merges its chunk into an empty algorithm created by `factory`, which must
+// have the same parameters as `algorithm`. The per-thread algorithms are then
+// combined with a parallel pairwise tree reduction using MergeFrom, which adds
+// their state directly and only checks compatibility once per pair instead of
+// once per summary. Finally, the result is merged into `algorithm`.
+//
+// Returns the first error encountered. In that case `algorithm` is not
+// modified.
+template <typename T>
+absl::Status MergeSummariesInParallel(absl::Span<const Summary> summaries,
+                                      const AlgorithmFactory<T>& factory,
+                                      int num_threads, Algorithm<T>* algorithm) {
+  if (algorithm == nullptr) {
+    return absl::InvalidArgumentError("Algorithm must not be null.");
+  }
+  if (num_threads < 1) {
+    return absl::InvalidArgumentError(
+        "Number of threads must be at least 1.");
+  }
+  if (summaries.empty()) {
+    return absl::OkStatus();
+  }
+
+  const int num_chunks =
+      static_cast<int>(std::min<size_t>(num_threads, summaries.size()));
+  std::vector<std::unique_ptr<Algorithm<T>>> partials(num_chunks);
+  for (std::unique_ptr<Algorithm<T>>& partial : partials) {
+    absl::StatusOr<std::unique_ptr<Algorithm<T>>> created = factory();
+    RETURN_IF_ERROR(created.status());
+    if (*created == nullptr) {
+      return absl::InvalidArgumentError("Factory returned a null algorithm.");
+    }
+    partial = std::move(created).value();
+  }
+
+  // Merge each chunk of summaries into its own algorithm.
+  const size_t chunk_size = (summaries.size() + num_chunks - 1) / num_chunks;
+  RETURN_IF_ERROR(internal::RunInParallel(
+      num_chunks, num_threads, [&](int chunk) -> absl::Status {
+        const size_t begin = chunk * chunk_size;
+        const size_t end = std::min(summaries.size(), begin + chunk_size);
+        for (size_t i = begin; i < end; ++i) {
+          RETURN_IF_ERROR(partials[chunk]->Merge(summaries[i]));
+        }
+        return absl::OkStatus();
+      }));
+
+  // Pairwise tree reduction: in each round, partials[i] absorbs
+  // partials[i + stride] for every i that is a multiple of 2 * stride.
+  for (int stride = 1; stride < num_chunks; stride *= 2) {
+    const int num_pairs = (num_chunks - stride + 2 * stride - 1) / (2 * stride);
+    RETURN_IF_ERROR(internal::RunInParallel(
+        num_pairs, num_threads, [&](int pair) -> absl::Status {
+          const int i = pair * 2 * stride;
+          return partials[i]->MergeFrom(*partials[i + stride]);
+        }));
+  }
+
+  return algorithm->MergeFrom(*partials[0]);
+}
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_MERGE_SUMMARIES_H_
@@ -0,0 +1,145 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/merge-summaries.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/testing/proto_matchers.h"
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::EqualsProto;
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::HasSubstr;
+
+constexpr double kEpsilon = 1.1;
+
+AlgorithmFactory<int64_t> BoundedSumFactory() {
+  return []() -> absl::StatusOr<std::unique_ptr<Algorithm<int64_t>>> {
+    return BoundedSum<int64_t>::Builder().SetEpsilon(kEpsilon).Build();
+  };
+}
+
+std::vector<Summary> BoundedSumSummaries(int num_summaries) {
+  std::vector<Summary> summaries;
+  for (int i = 0; i < num_summaries; ++i) {
+    std::unique_ptr<Algorithm<int64_t>> sum = BoundedSumFactory()().value();
+    sum->AddEntry(i);
+    sum->AddEntry(-3 * i);
+    summaries.push_back(sum->Serialize());
+  }
+  return summaries;
+}
+
+TEST(MergeSummariesInParallelTest, MatchesSerialMerge) {
+  const std::vector<Summary> summaries = BoundedSumSummaries(37);
+  std::unique_ptr<Algorithm<int64_t>> expected = BoundedSumFactory()().value();
+  expected->AddEntry(5);
+  for (const Summary& summary : summaries) {
+    ASSERT_OK(expected->Merge(summary));
+  }
+
+  for (int num_threads : {1, 2, 3, 8, 64}) {
+    std::unique_ptr<Algorithm<int64_t>> merged = BoundedSumFactory()().value();
+    merged->AddEntry(5);
+    EXPECT_OK(MergeSummariesInParallel<int64_t>(summaries, BoundedSumFactory(),
+                                                num_threads, merged.get()));
+    EXPECT_THAT(merged->Serialize(), EqualsProto(expected->Serialize()))
+        << "num_threads: " << num_threads;
+  }
+}
+
+TEST(MergeSummariesInParallelTest, MergesCounts) {
+  AlgorithmFactory<int64_t> factory =
+      []() -> absl::StatusOr<std::unique_ptr<Algorithm<int64_t>>> {
+    return Count<int64_t>::Builder().SetEpsilon(kEpsilon).Build();
+  };
+  std::vector<Summary> summaries;
+  for (int i = 0; i < 1000; ++i) {
+    CountSummary count_summary;
+    count_summary.set_count(i);
+    summaries.emplace_back().mutable_data()->PackFrom(count_summary);
+  }
+  std::unique_ptr<Algorithm<int64_t>> count = factory().value();
+
+  EXPECT_OK(MergeSummariesInParallel<int64_t>(summaries, factory,
+                                              /*num_threads=*/4, count.get()));
+
+  CountSummary merged;
+  ASSERT_TRUE(count->Serialize().data().UnpackTo(&merged));
+  EXPECT_EQ(merged.count(), 999 * 1000 / 2);
+}
+
+TEST(MergeSummariesInParallelTest, NoSummariesIsNoOp) {
+  std::unique_ptr<Algorithm<int64_t>> sum = BoundedSumFactory()().value();
+  sum->AddEntry(1);
+  const Summary before = sum->Serialize();
+
+  EXPECT_OK(MergeSummariesInParallel<int64_t>({}, BoundedSumFactory(),
+                                              /*num_threads=*/4, sum.get()));
+  EXPECT_THAT(sum->Serialize(), EqualsProto(before));
+}
+
+TEST(MergeSummariesInParallelTest, InvalidSummaryFailsWithoutChangingState) {
+  std::vector<Summary> summaries = BoundedSumSummaries(20);
+  summaries[13] = Summary();
+  std::unique_ptr<Algorithm<int64_t>> sum = BoundedSumFactory()().value();
+  sum->AddEntry(1);
+  const Summary before = sum->Serialize();
+
+  for (int num_threads : {1, 4}) {
+    EXPECT_THAT(MergeSummariesInParallel<int64_t>(
+                    summaries, BoundedSumFactory(), num_threads, sum.get()),
+                StatusIs(absl::StatusCode::kInternal, HasSubstr("no")));
+    EXPECT_THAT(sum->Serialize(), EqualsProto(before));
+  }
+}
+
+TEST(MergeSummariesInParallelTest, InvalidArgumentsFail) {
+  const std::vector<Summary> summaries = BoundedSumSummaries(2);
+  std::unique_ptr<Algorithm<int64_t>> sum = BoundedSumFactory()().value();
+
+  EXPECT_THAT(MergeSummariesInParallel<int64_t>(summaries, BoundedSumFactory(),
+                                                /*num_threads=*/0, sum.get()),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(MergeSummariesInParallel<int64_t>(summaries, BoundedSumFactory(),
+                                                /*num_threads=*/1, nullptr),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(
+      MergeSummariesInParallel<int64_t>(
+          summaries,
+          []() -> absl::StatusOr<std::unique_ptr<Algorithm<int64_t>>> {
+            return absl::InvalidArgumentError("Cannot build.");
+          },
+          /*num_threads=*/2, sum.get()),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("Cannot build")));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -17,6 +17,7 @@
 #ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_NUMERICAL_MECHANISMS_TESTING_H_
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_NUMERICAL_MECHANISMS_TESTING_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <optional>
@@ -26,6 +27,7 @@
 #include "absl/memory/memory.h"
 #include "absl/random/random.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "algorithms/distributions.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "proto/confidence-interval.pb.h"
@@ -84,6 +86,24 @@ class ZeroNoiseMechanism : public LaplaceMechanism {
 
   int64_t AddInt64Noise(int64_t result) override { return result; }
 
+  std::optional<double> RoundDoubleForNoise(double result) override {
+    return result;
+  }
+
+  std::optional<int64_t> RoundInt64ForNoise(int64_t result) override {
+    return result;
+  }
+
+  void AddDoubleNoiseBatch(absl::Span<const double> results,
+                           absl::Span<double> noised_results) override {
+    std::copy(results.begin(), results.end(), noised_results.begin());
+  }
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override {
+    std::copy(results.begin(), results.end(), noised_results.begin());
+  }
+
   absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
       double confidence_level) override {
     ConfidenceInterval confidence;
@@ -234,6 +254,17 @@ class MockLaplaceMechanism : public LaplaceMechanism {
   MOCK_METHOD(absl::StatusOr<ConfidenceInterval>, NoiseConfidenceInterval,
               (double confidence_level), (override));
   MOCK_METHOD(int64_t, MemoryUsed, (), (override));
+
+  // Route batched noise through the mocked per-value methods.
+  void AddDoubleNoiseBatch(absl::Span<const double> results,
+                           absl::Span<double> noised_results) override {
+    NumericalMechanism::AddDoubleNoiseBatch(results, noised_results);
+  }
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override {
+    NumericalMechanism::AddInt64NoiseBatch(results, noised_results);
+  }
 };
 
 }  // namespace test_utils
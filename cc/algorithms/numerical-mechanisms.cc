@@ -18,20 +18,27 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <deque>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/log/check.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "algorithms/distributions.h"
-#include "algorithms/internal/gaussian-stddev-calculator.h"
+#include "algorithms/internal/gaussian-stddev-cache.h"
 #include "algorithms/rand.h"
 #include "algorithms/util.h"
 #include "proto/confidence-interval.pb.h"
@@ -41,8 +48,9 @@
 namespace differential_privacy {
 namespace {
 
-// The maximum allowable probability that the noise will overflow.
-const double kMaxOverflowProbability = std::pow(2.0, -64);
+// The maximum allowable probability that the noise will overflow, 2^-64.
+// Constant-initialized, so that loading the library runs no code for it.
+constexpr double kMaxOverflowProbability = 0x1p-64;
 
 // The relative accuracy at which to stop the binary search to find the tightest
 // sigma such that Gaussian noise satisfies (epsilon, delta)-differential
@@ -102,6 +110,91 @@ absl::StatusOr<double> CalculateL1Sensitivity(
   return absl::InvalidArgumentError(error_string);
 }
 
+// Granularity should be a power of 2, and thus can be cast without losing
+// any meaningful fraction. If granularity is <1 (i.e., 2^x, where x<0),
+// then flooring the granularity we use here to 1 should be fine for integer
+// noise. If granularity is greater than an int64_t can represent, then
+// it's so high that the return value likely won't be terribly meaningful,
+// so just cap the granularity at the largest number int64_t can represent.
+int64_t GetInt64Granularity(double granularity) {
+  SafeOpResult<int64_t> granularity_cast_result =
+      SafeCastFromDouble<int64_t>(std::max(granularity, 1.0));
+  if (granularity_cast_result.overflow) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  return granularity_cast_result.value;
+}
+
+// Rounds the noise sample to an integer, saturating at the int64_t limits.
+int64_t RoundNoiseToInt64(double sample) {
+  return SafeCastFromDouble<int64_t>(std::round(sample)).value;
+}
+
+// Returns log(delta) of the (epsilon, delta)-DP guarantee of a rho-zCDP
+// mechanism at Renyi order alpha > 1 (Canonne, Kamath and Steinke, Corollary
+// 13). Every alpha gives a valid bound.
+double ZcdpLogDelta(double rho, double epsilon, double alpha) {
+  return (alpha - 1) * (alpha * rho - epsilon) +
+         alpha * std::log1p(-1 / alpha) - std::log(alpha - 1);
+}
+
+// Returns an approximately minimal log(delta) of the (epsilon, delta)-DP
+// guarantee of a rho-zCDP mechanism, minimizing ZcdpLogDelta over alpha with
+// a golden-section search.
+double ZcdpToLogDelta(double rho, double epsilon) {
+  const double golden = (std::sqrt(5.0) - 1) / 2;
+  double lo = 1;
+  double hi = 2 * (epsilon + rho) / (2 * rho) + 2;
+  for (int i = 0; i < 100; ++i) {
+    const double a = hi - golden * (hi - lo);
+    const double b = lo + golden * (hi - lo);
+    if (ZcdpLogDelta(rho, epsilon, a) < ZcdpLogDelta(rho, epsilon, b)) {
+      hi = b;
+    } else {
+      lo = a;
+    }
+  }
+  return ZcdpLogDelta(rho, epsilon, (lo + hi) / 2);
+}
+
+// Confidence interval of symmetric integer noise with the given quantile
+// function.
+template <typename Quantile>
+NumericalMechanism::NoiseConfidenceIntervalResult
+SymmetricNoiseConfidenceInterval(double confidence_level, double noised_result,
+                                 Quantile quantile) {
+  const double bound = quantile((1 + confidence_level) / 2);
+  NumericalMechanism::NoiseConfidenceIntervalResult ci;
+  ci.lower = noised_result - bound;
+  ci.upper = noised_result + bound;
+  return ci;
+}
+
+ConfidenceInterval ToConfidenceInterval(
+    double confidence_level,
+    NumericalMechanism::NoiseConfidenceIntervalResult ci) {
+  ConfidenceInterval result;
+  result.set_lower_bound(ci.lower);
+  result.set_upper_bound(ci.upper);
+  result.set_confidence_level(confidence_level);
+  return result;
+}
+
+// The discrete mechanisms round their results to integers, and the rounded
+// results of neighbouring inputs can differ by more than a fractional
+// sensitivity. A directly set sensitivity must therefore be an integer. Values
+// that are not finite are left to the other validations.
+absl::Status ValidateIsIntegerSensitivity(std::optional<double> sensitivity,
+                                          absl::string_view name) {
+  if (sensitivity.has_value() && std::isfinite(*sensitivity) &&
+      *sensitivity != std::floor(*sensitivity)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        name, " must be an integer, since results are rounded to integers "
+        "before noise is added, but is ", *sensitivity, "."));
+  }
+  return absl::OkStatus();
+}
+
 }  // namespace
 
 absl::StatusOr<std::unique_ptr<NumericalMechanism>>
@@ -125,8 +218,17 @@ LaplaceMechanism::Builder::Build() {
       internal::LaplaceDistribution::CalculateGranularity(epsilon, l1);
   if (!gran_or_status.ok()) return gran_or_status.status();
 
+  auto mechanism = absl::make_unique<LaplaceMechanism>(epsilon, l1);
+  if (GetRandomSource() != nullptr) {
+    ASSIGN_OR_RETURN(mechanism->distro_,
+                     internal::LaplaceDistribution::Builder()
+                         .SetEpsilon(epsilon)
+                         .SetSensitivity(l1)
+                         .SetRandomSource(GetRandomSource())
+                         .Build());
+  }
   return absl::StatusOr<std::unique_ptr<NumericalMechanism>>(
-      absl::make_unique<LaplaceMechanism>(epsilon, l1));
+      std::move(mechanism));
 }
 
 LaplaceMechanism::LaplaceMechanism(double epsilon, double sensitivity)
@@ -199,33 +301,44 @@ double LaplaceMechanism::AddDoubleNoise(double result) {
 
 int64_t LaplaceMechanism::AddInt64Noise(int64_t result) {
   double sample = distro_->Sample();
-  SafeOpResult<int64_t> noise_cast_result =
-      SafeCastFromDouble<int64_t>(std::round(sample));
-
-  // Granularity should be a power of 2, and thus can be cast without losing
-  // any meaningful fraction. If granularity is <1 (i.e., 2^x, where x<0),
-  // then flooring the granularity we use here to 1 should be fine for this
-  // function. If granularity is greater than an int64_t can represent, then
-  // it's so high that the return value likely won't be terribly meaningful,
-  // so just cap the granularity at the largest number int64_t can represent.
-  int64_t granularity;
-  SafeOpResult<int64_t> granularity_cast_result =
-      SafeCastFromDouble<int64_t>(std::max(distro_->GetGranularity(), 1.0));
-  if (granularity_cast_result.overflow) {
-    granularity = std::numeric_limits<int64_t>::max();
-  } else {
-    granularity = granularity_cast_result.value;
+  return RoundToNearestInt64Multiple(
+             result, GetInt64Granularity(distro_->GetGranularity())) +
+         RoundNoiseToInt64(sample);
+}
+
+std::optional<double> LaplaceMechanism::RoundDoubleForNoise(double result) {
+  return RoundToNearestMultiple(result, distro_->GetGranularity());
+}
+
+std::optional<int64_t> LaplaceMechanism::RoundInt64ForNoise(int64_t result) {
+  return RoundToNearestInt64Multiple(
+      result, GetInt64Granularity(distro_->GetGranularity()));
+}
+
+void LaplaceMechanism::AddDoubleNoiseBatch(absl::Span<const double> results,
+                                           absl::Span<double> noised_results) {
+  const double granularity = distro_->GetGranularity();
+  for (size_t i = 0; i < results.size(); ++i) {
+    noised_results[i] =
+        RoundToNearestMultiple(results[i], granularity) + distro_->Sample();
   }
+}
 
-  return RoundToNearestInt64Multiple(result, granularity) +
-         noise_cast_result.value;
+void LaplaceMechanism::AddInt64NoiseBatch(
+    absl::Span<const int64_t> results, absl::Span<int64_t> noised_results) {
+  const int64_t granularity = GetInt64Granularity(distro_->GetGranularity());
+  for (size_t i = 0; i < results.size(); ++i) {
+    noised_results[i] = RoundToNearestInt64Multiple(results[i], granularity) +
+                        RoundNoiseToInt64(distro_->Sample());
+  }
 }
 
 absl::StatusOr<std::unique_ptr<NumericalMechanism>>
 GaussianMechanism::Builder::Build() {
   internal::GaussianDistribution::Builder builder;
-  ASSIGN_OR_RETURN(std::unique_ptr<internal::GaussianDistribution> distro,
-                   builder.SetStddev(1).Build());
+  ASSIGN_OR_RETURN(
+      std::unique_ptr<internal::GaussianDistribution> distro,
+      builder.SetStddev(1).SetRandomSource(GetRandomSource()).Build());
 
   if (stddev_.has_value()) {
     if (GetEpsilon().has_value() || GetDelta().has_value() ||
@@ -239,10 +352,10 @@ GaussianMechanism::Builder::Build() {
       return absl::InvalidArgumentError(
           "Standard deviation must be finite and positive.");
     }
-    std::unique_ptr<NumericalMechanism> result =
-        absl::make_unique<GaussianMechanism>(stddev_.value(),
-                                             std::move(distro));
-    return result;
+    auto result = absl::make_unique<GaussianMechanism>(stddev_.value(),
+                                                       std::move(distro));
+    result->random_source_ = GetRandomSource();
+    return std::unique_ptr<NumericalMechanism>(std::move(result));
   }  // Else construct from DP parameters.
 
   std::optional<double> epsilon = GetEpsilon();
@@ -250,9 +363,11 @@ GaussianMechanism::Builder::Build() {
   RETURN_IF_ERROR(DeltaIsSetAndValid());
   ASSIGN_OR_RETURN(double l2, CalculateL2Sensitivity());
 
+  auto mechanism = absl::make_unique<GaussianMechanism>(
+      epsilon.value(), GetDelta().value(), l2, std::move(distro));
+  mechanism->random_source_ = GetRandomSource();
   return absl::StatusOr<std::unique_ptr<NumericalMechanism>>(
-      absl::make_unique<GaussianMechanism>(epsilon.value(), GetDelta().value(),
-                                           l2, std::move(distro)));
+      std::move(mechanism));
 }
 
 absl::StatusOr<double> GaussianMechanism::Builder::CalculateL2Sensitivity() {
@@ -320,6 +435,7 @@ GaussianMechanism::Deserialize(const serialization::GaussianMechanism& proto) {
 bool GaussianMechanism::NoisedValueAboveThreshold(double result,
                                                   double threshold) {
   double stddev = CalculateStddev();
+  ScopedRandomSource scoped_random_source(random_source_);
   return UniformDouble() >
          internal::GaussianDistribution::cdf(stddev, threshold - result);
 }
@@ -375,7 +491,8 @@ absl::StatusOr<ConfidenceInterval> GaussianMechanism::NoiseConfidenceInterval(
 
 double GaussianMechanism::CalculateStddev(double epsilon, double delta,
                                           double l2_sensitivity) {
-  return internal::CalculateGaussianStddev(epsilon, delta, l2_sensitivity);
+  return internal::GaussianStddevCache::GetInstance().CalculateGaussianStddev(
+      epsilon, delta, l2_sensitivity);
 }
 
 double GaussianMechanism::CalculateStddev() const { return stddev_; }
@@ -392,27 +509,432 @@ double GaussianMechanism::AddDoubleNoise(double result) {
 int64_t GaussianMechanism::AddInt64Noise(int64_t result) {
   double stddev = CalculateStddev();
   double sample = standard_gaussian_->Sample(stddev);
+  return RoundToNearestInt64Multiple(
+             result,
+             GetInt64Granularity(standard_gaussian_->GetGranularity(stddev))) +
+         RoundNoiseToInt64(sample);
+}
 
-  SafeOpResult<int64_t> noise_cast_result =
-      SafeCastFromDouble<int64_t>(std::round(sample));
-
-  // Granularity should be a power of 2, and thus can be cast without losing
-  // any meaningful fraction. If granularity is <1 (i.e., 2^x, where x<0),
-  // then flooring the granularity we use here to 1 should be fine for this
-  // function. If granularity is greater than an int64_t can represent, then
-  // it's so high that the return value likely won't be terribly meaningful,
-  // so just cap the granularity at the largest number int64_t can represent.
-  int64_t granularity;
-  SafeOpResult<int64_t> granularity_cast_result = SafeCastFromDouble<int64_t>(
-      std::max(standard_gaussian_->GetGranularity(stddev), 1.0));
-  if (granularity_cast_result.overflow) {
-    granularity = std::numeric_limits<int64_t>::max();
-  } else {
-    granularity = granularity_cast_result.value;
+std::optional<double> GaussianMechanism::RoundDoubleForNoise(double result) {
+  return RoundToNearestMultiple(
+      result, standard_gaussian_->GetGranularity(CalculateStddev()));
+}
+
+std::optional<int64_t> GaussianMechanism::RoundInt64ForNoise(int64_t result) {
+  const double stddev = CalculateStddev();
+  return RoundToNearestInt64Multiple(
+      result, GetInt64Granularity(standard_gaussian_->GetGranularity(stddev)));
+}
+
+void GaussianMechanism::AddDoubleNoiseBatch(absl::Span<const double> results,
+                                            absl::Span<double> noised_results) {
+  const double stddev = CalculateStddev();
+  const double granularity = standard_gaussian_->GetGranularity(stddev);
+  // Round first so that results and noised_results may alias.
+  for (size_t i = 0; i < results.size(); ++i) {
+    noised_results[i] = RoundToNearestMultiple(results[i], granularity);
+  }
+  std::vector<double> samples(results.size());
+  standard_gaussian_->SampleBatch(stddev, absl::MakeSpan(samples));
+  for (size_t i = 0; i < results.size(); ++i) {
+    noised_results[i] += samples[i];
+  }
+}
+
+void GaussianMechanism::AddInt64NoiseBatch(
+    absl::Span<const int64_t> results, absl::Span<int64_t> noised_results) {
+  const double stddev = CalculateStddev();
+  const int64_t granularity =
+      GetInt64Granularity(standard_gaussian_->GetGranularity(stddev));
+  std::vector<double> samples(results.size());
+  standard_gaussian_->SampleBatch(stddev, absl::MakeSpan(samples));
+  for (size_t i = 0; i < results.size(); ++i) {
+    noised_results[i] = RoundToNearestInt64Multiple(results[i], granularity) +
+                        RoundNoiseToInt64(samples[i]);
+  }
+}
+
+absl::StatusOr<std::unique_ptr<NumericalMechanism>>
+DiscreteLaplaceMechanism::Builder::Build() {
+  RETURN_IF_ERROR(ValidateIsFiniteAndPositive(GetEpsilon(), "Epsilon"));
+  RETURN_IF_ERROR(
+      ValidateIsIntegerSensitivity(l1_sensitivity_, "L1 sensitivity"));
+  const double epsilon = GetEpsilon().value();
+  std::optional<double> linf = GetLInfSensitivity();
+  if (linf.has_value()) {
+    linf = std::ceil(*linf);
+  }
+  ASSIGN_OR_RETURN(double l1, CalculateL1Sensitivity(GetL0Sensitivity(),
+                                                     l1_sensitivity_, linf));
+  ASSIGN_OR_RETURN(
+      std::unique_ptr<internal::DiscreteLaplaceDistribution> distro,
+      internal::DiscreteLaplaceDistribution::Builder()
+          .SetEpsilon(epsilon)
+          .SetSensitivity(l1)
+          .SetRandomSource(GetRandomSource())
+          .Build());
+  return absl::WrapUnique<NumericalMechanism>(
+      new DiscreteLaplaceMechanism(epsilon, l1, std::move(distro)));
+}
+
+bool DiscreteLaplaceMechanism::NoisedValueAboveThreshold(double result,
+                                                         double threshold) {
+  return AddDoubleNoise(result) > threshold;
+}
+
+double DiscreteLaplaceMechanism::ProbabilityOfNoisedValueAboveThreshold(
+    double result, double threshold) {
+  return 1 - Cdf(threshold - std::round(result));
+}
+
+NumericalMechanism::NoiseConfidenceIntervalResult
+DiscreteLaplaceMechanism::UncheckedNoiseConfidenceInterval(
+    double confidence_level, double noised_result) const {
+  return SymmetricNoiseConfidenceInterval(
+      confidence_level, noised_result,
+      [this](double p) { return Quantile(p); });
+}
+
+absl::StatusOr<ConfidenceInterval>
+DiscreteLaplaceMechanism::NoiseConfidenceInterval(double confidence_level,
+                                                  double noised_result) {
+  RETURN_IF_ERROR(CheckConfidenceLevel(confidence_level));
+  return ToConfidenceInterval(
+      confidence_level,
+      UncheckedNoiseConfidenceInterval(confidence_level, noised_result));
+}
+
+int64_t DiscreteLaplaceMechanism::MemoryUsed() {
+  return sizeof(DiscreteLaplaceMechanism) +
+         sizeof(internal::DiscreteLaplaceDistribution);
+}
+
+double DiscreteLaplaceMechanism::AddDoubleNoise(double result) {
+  return std::round(result) + distro_->Sample();
+}
+
+int64_t DiscreteLaplaceMechanism::AddInt64Noise(int64_t result) {
+  return SafeAdd(result, distro_->Sample()).value;
+}
+
+void DiscreteLaplaceMechanism::AddDoubleNoiseBatch(
+    absl::Span<const double> results, absl::Span<double> noised_results) {
+  std::vector<int64_t> samples(results.size());
+  distro_->SampleBatch(absl::MakeSpan(samples));
+  for (size_t i = 0; i < results.size(); ++i) {
+    noised_results[i] = std::round(results[i]) + samples[i];
+  }
+}
+
+void DiscreteLaplaceMechanism::AddInt64NoiseBatch(
+    absl::Span<const int64_t> results, absl::Span<int64_t> noised_results) {
+  std::vector<int64_t> samples(results.size());
+  distro_->SampleBatch(absl::MakeSpan(samples));
+  SafeAddBatch<int64_t>(results, samples, noised_results);
+}
+
+absl::StatusOr<std::unique_ptr<NumericalMechanism>>
+DiscreteGaussianMechanism::Builder::Build() {
+  if (stddev_.has_value()) {
+    if (GetEpsilon().has_value() || GetDelta().has_value() ||
+        GetL0Sensitivity().has_value() || GetLInfSensitivity().has_value() ||
+        l2_sensitivity_.has_value()) {
+      return absl::InvalidArgumentError(
+          "If standard deviation is set directly it must be the only "
+          "parameter.");
+    }
+    ASSIGN_OR_RETURN(
+        std::unique_ptr<internal::DiscreteGaussianDistribution> distro,
+        internal::DiscreteGaussianDistribution::Builder()
+            .SetStddev(stddev_.value())
+            .SetRandomSource(GetRandomSource())
+            .Build());
+    return absl::WrapUnique<NumericalMechanism>(
+        new DiscreteGaussianMechanism(0, 0, 0, std::move(distro)));
+  }
+
+  std::optional<double> epsilon = GetEpsilon();
+  RETURN_IF_ERROR(ValidateIsFiniteAndPositive(epsilon, "Epsilon"));
+  RETURN_IF_ERROR(DeltaIsSetAndValid());
+  RETURN_IF_ERROR(
+      ValidateIsIntegerSensitivity(l2_sensitivity_, "L2 sensitivity"));
+  Builder rounded = *this;
+  if (GetLInfSensitivity().has_value()) {
+    rounded.SetLInfSensitivity(std::ceil(GetLInfSensitivity().value()));
+  }
+  ASSIGN_OR_RETURN(double l2, rounded.CalculateL2Sensitivity());
+  ASSIGN_OR_RETURN(double stddev,
+                   CalculateStddev(epsilon.value(), GetDelta().value(), l2));
+  ASSIGN_OR_RETURN(
+      std::unique_ptr<internal::DiscreteGaussianDistribution> distro,
+      internal::DiscreteGaussianDistribution::Builder()
+          .SetStddev(stddev)
+          .SetRandomSource(GetRandomSource())
+          .Build());
+  return absl::WrapUnique<NumericalMechanism>(new DiscreteGaussianMechanism(
+      epsilon.value(), GetDelta().value(), l2, std::move(distro)));
+}
+
+absl::StatusOr<double> DiscreteGaussianMechanism::CalculateStddev(
+    double epsilon, double delta, double l2_sensitivity) {
+  const double log_delta = std::log(delta);
+  auto is_private = [&](double stddev) {
+    const double rho =
+        l2_sensitivity * l2_sensitivity / (2 * stddev * stddev);
+    return ZcdpToLogDelta(rho, epsilon) <= log_delta;
+  };
+  const double min_stddev =
+      internal::DiscreteGaussianDistribution::GetMinStddev();
+  const double max_stddev =
+      internal::DiscreteGaussianDistribution::GetMaxStddev();
+  double hi = std::max(l2_sensitivity, min_stddev);
+  while (!is_private(hi)) {
+    if (hi > max_stddev) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The standard deviation of the discrete Gaussian noise exceeds ",
+          max_stddev, ". Epsilon or delta are too small, or the L2 "
+          "sensitivity is too large."));
+    }
+    hi *= 2;
+  }
+  double lo = hi / 2;
+  while (lo > min_stddev && is_private(lo)) {
+    hi = lo;
+    lo /= 2;
+  }
+  while (hi - lo > kGaussianSigmaAccuracy * hi) {
+    const double mid = (lo + hi) / 2;
+    if (is_private(mid)) {
+      hi = mid;
+    } else {
+      lo = mid;
+    }
+  }
+  return std::clamp(hi, min_stddev, max_stddev);
+}
+
+bool DiscreteGaussianMechanism::NoisedValueAboveThreshold(double result,
+                                                          double threshold) {
+  return AddDoubleNoise(result) > threshold;
+}
+
+double DiscreteGaussianMechanism::ProbabilityOfNoisedValueAboveThreshold(
+    double result, double threshold) {
+  return 1 - Cdf(threshold - std::round(result));
+}
+
+NumericalMechanism::NoiseConfidenceIntervalResult
+DiscreteGaussianMechanism::UncheckedNoiseConfidenceInterval(
+    double confidence_level, double noised_result) const {
+  return SymmetricNoiseConfidenceInterval(
+      confidence_level, noised_result,
+      [this](double p) { return Quantile(p); });
+}
+
+absl::StatusOr<ConfidenceInterval>
+DiscreteGaussianMechanism::NoiseConfidenceInterval(double confidence_level,
+                                                   double noised_result) {
+  RETURN_IF_ERROR(CheckConfidenceLevel(confidence_level));
+  return ToConfidenceInterval(
+      confidence_level,
+      UncheckedNoiseConfidenceInterval(confidence_level, noised_result));
+}
+
+int64_t DiscreteGaussianMechanism::MemoryUsed() {
+  return sizeof(DiscreteGaussianMechanism) +
+         sizeof(internal::DiscreteGaussianDistribution);
+}
+
+double DiscreteGaussianMechanism::AddDoubleNoise(double result) {
+  return std::round(result) + distro_->Sample();
+}
+
+int64_t DiscreteGaussianMechanism::AddInt64Noise(int64_t result) {
+  return SafeAdd(result, distro_->Sample()).value;
+}
+
+void DiscreteGaussianMechanism::AddDoubleNoiseBatch(
+    absl::Span<const double> results, absl::Span<double> noised_results) {
+  std::vector<int64_t> samples(results.size());
+  distro_->SampleBatch(absl::MakeSpan(samples));
+  for (size_t i = 0; i < results.size(); ++i) {
+    noised_results[i] = std::round(results[i]) + samples[i];
+  }
+}
+
+void DiscreteGaussianMechanism::AddInt64NoiseBatch(
+    absl::Span<const int64_t> results, absl::Span<int64_t> noised_results) {
+  std::vector<int64_t> samples(results.size());
+  distro_->SampleBatch(absl::MakeSpan(samples));
+  SafeAddBatch<int64_t>(results, samples, noised_results);
+}
+
+namespace {
+
+// Forwards every call to a mechanism that is shared with other handles.
+class SharedMechanismHandle : public NumericalMechanism {
+ public:
+  explicit SharedMechanismHandle(std::shared_ptr<NumericalMechanism> mechanism)
+      : NumericalMechanism(mechanism->GetEpsilon()),
+        mechanism_(std::move(mechanism)) {}
+
+  bool NoisedValueAboveThreshold(double result, double threshold) override {
+    return mechanism_->NoisedValueAboveThreshold(result, threshold);
+  }
+
+  double ProbabilityOfNoisedValueAboveThreshold(double result,
+                                                double threshold) override {
+    return mechanism_->ProbabilityOfNoisedValueAboveThreshold(result,
+                                                              threshold);
   }
 
-  return RoundToNearestInt64Multiple(result, granularity) +
-         noise_cast_result.value;
+  // Only accounts for the handle itself; the memory of the shared mechanism is
+  // amortized over all handles.
+  int64_t MemoryUsed() override { return sizeof(SharedMechanismHandle); }
+
+  NumericalMechanism* NoiseSource() override {
+    return mechanism_->NoiseSource();
+  }
+
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level, double noised_result) override {
+    return mechanism_->NoiseConfidenceInterval(confidence_level,
+                                               noised_result);
+  }
+
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level) override {
+    return mechanism_->NoiseConfidenceInterval(confidence_level);
+  }
+
+  NoiseConfidenceIntervalResult UncheckedNoiseConfidenceInterval(
+      double confidence_level, double noised_result) const override {
+    return mechanism_->UncheckedNoiseConfidenceInterval(confidence_level,
+                                                        noised_result);
+  }
+
+  double GetVariance() const override { return mechanism_->GetVariance(); }
+
+  double Cdf(double x) const override { return mechanism_->Cdf(x); }
+
+  double Quantile(double p) const override { return mechanism_->Quantile(p); }
+
+  std::optional<double> RoundDoubleForNoise(double result) override {
+    return mechanism_->RoundDoubleForNoise(result);
+  }
+
+  std::optional<int64_t> RoundInt64ForNoise(int64_t result) override {
+    return mechanism_->RoundInt64ForNoise(result);
+  }
+
+ protected:
+  double AddDoubleNoise(double result) override {
+    return mechanism_->AddNoise(result);
+  }
+
+  int64_t AddInt64Noise(int64_t result) override {
+    return mechanism_->AddNoise(result);
+  }
+
+  void AddDoubleNoiseBatch(absl::Span<const double> results,
+                           absl::Span<double> noised_results) override {
+    // Sizes have already been checked by NumericalMechanism::AddNoise.
+    mechanism_->AddNoise(results, noised_results).IgnoreError();
+  }
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override {
+    mechanism_->AddNoise(results, noised_results).IgnoreError();
+  }
+
+ private:
+  const std::shared_ptr<NumericalMechanism> mechanism_;
+};
+
+}  // namespace
+
+struct SharedMechanismBuilder::State {
+  struct Entry {
+    std::optional<double> epsilon;
+    std::optional<double> delta;
+    std::optional<double> l0_sensitivity;
+    std::optional<double> linf_sensitivity;
+    RandomSource* random_source;
+    std::shared_ptr<NumericalMechanism> mechanism;
+  };
+
+  explicit State(std::unique_ptr<NumericalMechanismBuilder> builder)
+      : mechanism_builder(std::move(builder)) {}
+
+  const std::unique_ptr<NumericalMechanismBuilder> mechanism_builder;
+  mutable absl::Mutex mutex;
+  // Ordered from the least to the most recently built mechanism.
+  std::deque<Entry> entries ABSL_GUARDED_BY(mutex);
+};
+
+SharedMechanismBuilder::SharedMechanismBuilder(
+    std::unique_ptr<NumericalMechanismBuilder> mechanism_builder)
+    : state_(std::make_shared<State>(std::move(mechanism_builder))) {}
+
+absl::StatusOr<std::unique_ptr<NumericalMechanism>>
+SharedMechanismBuilder::Build() {
+  if (state_->mechanism_builder == nullptr) {
+    return absl::InvalidArgumentError(
+        "SharedMechanismBuilder requires a mechanism builder to wrap.");
+  }
+  auto matches = [this](const State::Entry& entry) {
+    return entry.epsilon == GetEpsilon() && entry.delta == GetDelta() &&
+           entry.l0_sensitivity == GetL0Sensitivity() &&
+           entry.linf_sensitivity == GetLInfSensitivity() &&
+           entry.random_source == GetRandomSource();
+  };
+
+  absl::MutexLock lock(&state_->mutex);
+  for (const State::Entry& entry : state_->entries) {
+    if (matches(entry)) {
+      return absl::make_unique<SharedMechanismHandle>(entry.mechanism);
+    }
+  }
+
+  std::unique_ptr<NumericalMechanismBuilder> builder =
+      state_->mechanism_builder->Clone();
+  CopyParametersTo(*builder);
+  ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mechanism,
+                   builder->Build());
+
+  if (state_->entries.size() >= kMaxSharedMechanisms) {
+    state_->entries.pop_front();
+  }
+  state_->entries.push_back({GetEpsilon(), GetDelta(), GetL0Sensitivity(),
+                             GetLInfSensitivity(), GetRandomSource(),
+                             std::move(mechanism)});
+  return absl::make_unique<SharedMechanismHandle>(
+      state_->entries.back().mechanism);
+}
+
+int SharedMechanismBuilder::NumSharedMechanisms() const {
+  absl::MutexLock lock(&state_->mutex);
+  return state_->entries.size();
+}
+
+absl::Status WarmUpNoiseMechanisms() {
+  SecureURBG::WarmUp();
+  ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> laplace,
+                   LaplaceMechanism::Builder()
+                       .SetEpsilon(1)
+                       .SetL0Sensitivity(1)
+                       .SetLInfSensitivity(1)
+                       .Build());
+  ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> gaussian,
+                   GaussianMechanism::Builder()
+                       .SetEpsilon(1)
+                       .SetDelta(1e-5)
+                       .SetL0Sensitivity(1)
+                       .SetLInfSensitivity(1)
+                       .Build());
+  laplace->AddNoise(0.0);
+  gaussian->AddNoise(0.0);
+  return absl::OkStatus();
 }
 
 }  // namespace differential_privacy
@@ -20,6 +20,7 @@
 #include <cmath>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <type_traits>
 #include <utility>
 
@@ -29,11 +30,13 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "algorithms/distributions.h"
 #include "algorithms/rand.h"
 #include "algorithms/util.h"
 #include "proto/confidence-interval.pb.h"
 #include "proto/numerical-mechanism.pb.h"
+#include "base/instrumentation.h"
 #include "base/status_macros.h"
 
 // A set of classes for adding differentially private noise to numerical data.
@@ -55,15 +58,43 @@ class NumericalMechanism {
 
   template <typename T, std::enable_if_t<std::is_integral<T>::value>* = nullptr>
   int64_t AddNoise(T result) {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kMechanismAddNoise);
     return AddInt64Noise(result);
   }
 
   template <typename T,
             std::enable_if_t<std::is_floating_point<T>::value>* = nullptr>
   double AddNoise(T result) {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kMechanismAddNoise);
     return AddDoubleNoise(result);
   }
 
+  // Adds noise independently to every element of results and writes the
+  // noised values to the element at the same index of noised_results. Both
+  // spans must have the same size; they may refer to the same memory.
+  // Per-value setup such as granularity computation is done once for the whole
+  // batch, which makes this considerably faster than calling AddNoise in a loop
+  // for large inputs (e.g., histograms with many buckets).
+  absl::Status AddNoise(absl::Span<const double> results,
+                        absl::Span<double> noised_results) {
+    RETURN_IF_ERROR(CheckBatchSizes(results.size(), noised_results.size()));
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kMechanismAddNoise, results.size());
+    AddDoubleNoiseBatch(results, noised_results);
+    return absl::OkStatus();
+  }
+
+  absl::Status AddNoise(absl::Span<const int64_t> results,
+                        absl::Span<int64_t> noised_results) {
+    RETURN_IF_ERROR(CheckBatchSizes(results.size(), noised_results.size()));
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kMechanismAddNoise, results.size());
+    AddInt64NoiseBatch(results, noised_results);
+    return absl::OkStatus();
+  }
+
   // Quickly determines if result with added noise is greater than threshold.
   // This method allows for quicker thresholding decisions by using a uniform
   // random number instead of the slower (i.e., more complex to compute) noise
@@ -102,6 +133,24 @@ class NumericalMechanism {
 
   double GetEpsilon() const { return epsilon_; }
 
+  // Returns the mechanism that draws the noise. Mechanisms that forward to
+  // another mechanism return it, so that callers can batch the noise of
+  // several mechanisms that draw from the same one.
+  virtual NumericalMechanism* NoiseSource() { return this; }
+
+  // Returns result rounded the way AddNoise rounds it before adding the noise,
+  // so that AddNoise(result) is distributed like the rounded result plus
+  // AddNoise(0). This lets the noise be drawn ahead of time (see
+  // PooledMechanism). Mechanisms whose noise depends on the result in any
+  // other way return nullopt, which is the default.
+  virtual std::optional<double> RoundDoubleForNoise(double result) {
+    return std::nullopt;
+  }
+
+  virtual std::optional<int64_t> RoundInt64ForNoise(int64_t result) {
+    return std::nullopt;
+  }
+
   // Returns the variance of the noise that will be added by the underlying
   // distribution.
   virtual double GetVariance() const { return 0; }
@@ -120,12 +169,41 @@ class NumericalMechanism {
 
   virtual int64_t AddInt64Noise(int64_t result) = 0;
 
+  // Batch versions of AddDoubleNoise and AddInt64Noise. The spans are
+  // guaranteed to have the same size. The default implementations add noise
+  // one element at a time; mechanisms override them to hoist per-value work out
+  // of the loop.
+  virtual void AddDoubleNoiseBatch(absl::Span<const double> results,
+                                   absl::Span<double> noised_results) {
+    for (size_t i = 0; i < results.size(); ++i) {
+      noised_results[i] = AddDoubleNoise(results[i]);
+    }
+  }
+
+  virtual void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                                  absl::Span<int64_t> noised_results) {
+    for (size_t i = 0; i < results.size(); ++i) {
+      noised_results[i] = AddInt64Noise(results[i]);
+    }
+  }
+
   static absl::Status CheckConfidenceLevel(const double confidence_level) {
     return ValidateIsInExclusiveInterval(confidence_level, 0, 1,
                                          "Confidence level");
   }
 
  private:
+  static absl::Status CheckBatchSizes(size_t input_size, size_t output_size) {
+    if (input_size != output_size) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Input and output of batched AddNoise must have the "
+                       "same size, but input has ",
+                       input_size, " elements and output has ", output_size,
+                       " elements."));
+    }
+    return absl::OkStatus();
+  }
+
   const double epsilon_;
 };
 
@@ -154,6 +232,15 @@ class NumericalMechanismBuilder {
     return *this;
   }
 
+  // Draws the noise from random_source instead of SecureURBG, e.g., to give
+  // every worker thread its own SecureRandomSource. The source must outlive the
+  // built mechanisms, which are then only safe to use from one thread at a
+  // time (see RandomSource).
+  NumericalMechanismBuilder& SetRandomSource(RandomSource* random_source) {
+    random_source_ = random_source;
+    return *this;
+  }
+
   virtual absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() = 0;
 
   virtual std::unique_ptr<NumericalMechanismBuilder> Clone() const = 0;
@@ -170,12 +257,35 @@ class NumericalMechanismBuilder {
   std::optional<double> GetDelta() const { return delta_; }
   std::optional<double> GetL0Sensitivity() const { return l0_sensitivity_; }
   std::optional<double> GetLInfSensitivity() const { return linf_sensitivity_; }
+  RandomSource* GetRandomSource() const { return random_source_; }
+
+  // Sets the privacy parameters and the random source of this builder on
+  // builder, leaving those that are unset here untouched. Used by builders that
+  // wrap another builder.
+  void CopyParametersTo(NumericalMechanismBuilder& builder) const {
+    if (epsilon_.has_value()) {
+      builder.SetEpsilon(epsilon_.value());
+    }
+    if (delta_.has_value()) {
+      builder.SetDelta(delta_.value());
+    }
+    if (l0_sensitivity_.has_value()) {
+      builder.SetL0Sensitivity(l0_sensitivity_.value());
+    }
+    if (linf_sensitivity_.has_value()) {
+      builder.SetLInfSensitivity(linf_sensitivity_.value());
+    }
+    if (random_source_ != nullptr) {
+      builder.SetRandomSource(random_source_);
+    }
+  }
 
  private:
   std::optional<double> epsilon_;
   std::optional<double> delta_;
   std::optional<double> l0_sensitivity_;
   std::optional<double> linf_sensitivity_;
+  RandomSource* random_source_ = nullptr;
 };
 
 // Provides differential privacy by adding Laplace noise. This class also
@@ -284,6 +394,10 @@ class LaplaceMechanism : public NumericalMechanism {
     return internal::LaplaceDistribution::Quantile(diversity_, p);
   }
 
+  std::optional<double> RoundDoubleForNoise(double result) override;
+
+  std::optional<int64_t> RoundInt64ForNoise(int64_t result) override;
+
  protected:
   // Adds differentially private noise to a provided value.
   double AddDoubleNoise(double result) override;
@@ -295,6 +409,12 @@ class LaplaceMechanism : public NumericalMechanism {
   // privacy-safe operation (for noise of moderate magnitude, i.e. < 2^53).
   int64_t AddInt64Noise(int64_t result) override;
 
+  void AddDoubleNoiseBatch(absl::Span<const double> results,
+                           absl::Span<double> noised_results) override;
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override;
+
  private:
   const double sensitivity_;
   const double diversity_;
@@ -331,13 +451,12 @@ class GaussianMechanism : public NumericalMechanism {
     }
 
    protected:
-    std::optional<double> l2_sensitivity_;
-    std::optional<double> stddev_;
-
-   private:
     // Returns the l2 sensitivity when it has been set or returns an upper bound
     // on the l2 sensitivity calculated from l0 and linf sensitivities.
     absl::StatusOr<double> CalculateL2Sensitivity();
+
+    std::optional<double> l2_sensitivity_;
+    std::optional<double> stddev_;
   };
 
   ABSL_DEPRECATED(
@@ -401,20 +520,26 @@ class GaussianMechanism : public NumericalMechanism {
   // Returns the standard deviation of the Gaussian noise necessary to obtain
   // (epsilon, delta)-differential privacy for the given L_2 sensitivity. The
   // result will deviate from the tightest possible value sigma_tight by at most
-  // kGaussianSigmaAccuracy * sigma_tight. To be on the safe side, the lowest
-  // result from this method is the minimum positive floating point number.
+  // 1e-9 * sigma_tight. To be on the safe side, the lowest result from this
+  // method is the minimum positive floating point number.
   //
-  // This implementation uses a binary search. Its runtime is roughly
-  // log(kGaussianSigmaAccuracy)
-  // + log(max{sigma_tight / l2_sensitivity, l2_sensitivity / sigma_tight}).
+  // This implementation brackets sigma_tight by doubling and then runs a
+  // safeguarded Newton iteration with the analytic derivative of delta (see
+  // internal::CalculateGaussianStddev). Its runtime is roughly
+  // log(max{sigma_tight / l2_sensitivity, l2_sensitivity / sigma_tight}) plus a
+  // handful of Newton steps.
   //
   // The calculation is based on <a
   // href="https://arxiv.org/abs/1805.06530v2">Balle and Wang's "Improving the
   // Gaussian Mechanism for Differential Privacy: Analytical Calibration and
   // Optimal Denoising"</a>. The paper states that the lower bound on sigma from
   // the original analysis of the Gaussian mechanism (sigma ≥ sqrt(2 *
-  // l2_sensitivity^2 * log(1.25/𝛿) / 𝜖^2)) is far from tight and binary search
-  // can give us a better lower bound.
+  // l2_sensitivity^2 * log(1.25/𝛿) / 𝜖^2)) is far from tight and a numerical
+  // search can give us a better lower bound.
+  //
+  // Results are memoized in a bounded, process-wide cache (see
+  // internal::GaussianStddevCache), so building many mechanisms with the same
+  // parameters runs the search only once.
   static double CalculateStddev(double epsilon, double delta,
                                 double l2_sensitivity);
 
@@ -437,17 +562,229 @@ class GaussianMechanism : public NumericalMechanism {
     return internal::GaussianDistribution::Quantile(CalculateStddev(), p);
   }
 
+  std::optional<double> RoundDoubleForNoise(double result) override;
+
+  std::optional<int64_t> RoundInt64ForNoise(int64_t result) override;
+
  protected:
   // Adds differentially private noise to a provided value.
   double AddDoubleNoise(double result) override;
 
   int64_t AddInt64Noise(int64_t result) override;
 
+  void AddDoubleNoiseBatch(absl::Span<const double> results,
+                           absl::Span<double> noised_results) override;
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override;
+
  private:
   const double delta_;
   const double l2_sensitivity_;
   std::unique_ptr<internal::GaussianDistribution> standard_gaussian_;
   const double stddev_;
+  // Source of the uniform draws of NoisedValueAboveThreshold, if set.
+  RandomSource* random_source_ = nullptr;
+};
+
+// Provides differential privacy by adding discrete Laplace noise, i.e.,
+// integers x with probability proportional to exp(-|x| * epsilon / l1), where
+// l1 is the L1 sensitivity of the results rounded to integers. Noise is sampled
+// with integer arithmetic only, from random words drawn in bulk, so integer
+// results never go through floating point. Double results are rounded to the
+// nearest integer before noise is added.
+//
+// When l1 is calculated from the L0 and LInf sensitivities, the LInf
+// sensitivity is rounded up to an integer, which bounds the change of the
+// rounded results. An L1 sensitivity set directly must be an integer.
+class DiscreteLaplaceMechanism : public NumericalMechanism {
+ public:
+  class Builder : public NumericalMechanismBuilder {
+   public:
+    Builder& SetL1Sensitivity(double l1_sensitivity) {
+      l1_sensitivity_ = l1_sensitivity;
+      return *this;
+    }
+
+    absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override;
+
+    std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
+      return absl::make_unique<Builder>(*this);
+    }
+
+   private:
+    std::optional<double> l1_sensitivity_;
+  };
+
+  using NumericalMechanism::AddNoise;
+
+  bool NoisedValueAboveThreshold(double result, double threshold) override;
+
+  double ProbabilityOfNoisedValueAboveThreshold(double result,
+                                                double threshold) override;
+
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level) override {
+    return NoiseConfidenceInterval(confidence_level, 0);
+  }
+
+  NoiseConfidenceIntervalResult UncheckedNoiseConfidenceInterval(
+      double confidence_level, double noised_result) const override;
+
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level, double noised_result) override;
+
+  int64_t MemoryUsed() override;
+
+  double GetL1Sensitivity() const { return l1_sensitivity_; }
+
+  // Returns the rate of the noise distribution, which is at most
+  // epsilon / l1.
+  double GetRate() const { return distro_->GetRate(); }
+
+  double GetVariance() const override { return distro_->GetVariance(); }
+
+  double Cdf(double x) const override {
+    return internal::DiscreteLaplaceDistribution::Cdf(GetRate(), x);
+  }
+
+  double Quantile(double p) const override {
+    return internal::DiscreteLaplaceDistribution::Quantile(GetRate(), p);
+  }
+
+  std::optional<double> RoundDoubleForNoise(double result) override {
+    return std::round(result);
+  }
+
+  std::optional<int64_t> RoundInt64ForNoise(int64_t result) override {
+    return result;
+  }
+
+ protected:
+  double AddDoubleNoise(double result) override;
+
+  int64_t AddInt64Noise(int64_t result) override;
+
+  void AddDoubleNoiseBatch(absl::Span<const double> results,
+                           absl::Span<double> noised_results) override;
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override;
+
+ private:
+  DiscreteLaplaceMechanism(
+      double epsilon, double l1_sensitivity,
+      std::unique_ptr<internal::DiscreteLaplaceDistribution> distro)
+      : NumericalMechanism(epsilon),
+        l1_sensitivity_(l1_sensitivity),
+        distro_(std::move(distro)) {}
+
+  const double l1_sensitivity_;
+  std::unique_ptr<internal::DiscreteLaplaceDistribution> distro_;
+};
+
+// Provides differential privacy by adding discrete Gaussian noise, i.e.,
+// integers x with probability proportional to exp(-x^2 / (2 * stddev^2)).
+// Like DiscreteLaplaceMechanism, noise is sampled with integer arithmetic only
+// and double results are rounded to the nearest integer; the L2 sensitivity
+// is that of the rounded results and must be an integer if set directly, and
+// the LInf sensitivity is rounded up.
+//
+// The standard deviation is calibrated via zero-concentrated differential
+// privacy: the discrete Gaussian mechanism is l2^2 / (2 * stddev^2)-zCDP
+// (Canonne, Kamath and Steinke, "The Discrete Gaussian for Differential
+// Privacy", Theorem 14), which is converted to (epsilon, delta)-DP with their
+// Corollary 13. The analytic calibration of GaussianMechanism does not carry
+// over to the discrete distribution, and the result is slightly larger than
+// GaussianMechanism::CalculateStddev.
+class DiscreteGaussianMechanism : public NumericalMechanism {
+ public:
+  class Builder : public GaussianMechanism::Builder {
+   public:
+    absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override;
+
+    std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
+      return absl::make_unique<Builder>(*this);
+    }
+  };
+
+  using NumericalMechanism::AddNoise;
+
+  bool NoisedValueAboveThreshold(double result, double threshold) override;
+
+  double ProbabilityOfNoisedValueAboveThreshold(double result,
+                                                double threshold) override;
+
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level) override {
+    return NoiseConfidenceInterval(confidence_level, 0);
+  }
+
+  NoiseConfidenceIntervalResult UncheckedNoiseConfidenceInterval(
+      double confidence_level, double noised_result) const override;
+
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level, double noised_result) override;
+
+  int64_t MemoryUsed() override;
+
+  // Returns the smallest standard deviation of the discrete Gaussian noise
+  // that provides (epsilon, delta)-differential privacy for the given L2
+  // sensitivity, up to a relative accuracy of 1e-3 (rounded up), or an error
+  // if it is larger than the largest supported standard deviation.
+  static absl::StatusOr<double> CalculateStddev(double epsilon, double delta,
+                                                double l2_sensitivity);
+
+  double GetDelta() const { return delta_; }
+
+  double GetL2Sensitivity() const { return l2_sensitivity_; }
+
+  // Returns the standard deviation parameter of the noise distribution.
+  double GetStddev() const { return distro_->Stddev(); }
+
+  double GetVariance() const override {
+    return std::pow(distro_->Stddev(), 2);
+  }
+
+  double Cdf(double x) const override {
+    return internal::DiscreteGaussianDistribution::Cdf(GetStddev(), x);
+  }
+
+  double Quantile(double p) const override {
+    return internal::DiscreteGaussianDistribution::Quantile(GetStddev(), p);
+  }
+
+  std::optional<double> RoundDoubleForNoise(double result) override {
+    return std::round(result);
+  }
+
+  std::optional<int64_t> RoundInt64ForNoise(int64_t result) override {
+    return result;
+  }
+
+ protected:
+  double AddDoubleNoise(double result) override;
+
+  int64_t AddInt64Noise(int64_t result) override;
+
+  void AddDoubleNoiseBatch(absl::Span<const double> results,
+                           absl::Span<double> noised_results) override;
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override;
+
+ private:
+  DiscreteGaussianMechanism(
+      double epsilon, double delta, double l2_sensitivity,
+      std::unique_ptr<internal::DiscreteGaussianDistribution> distro)
+      : NumericalMechanism(epsilon),
+        delta_(delta),
+        l2_sensitivity_(l2_sensitivity),
+        distro_(std::move(distro)) {}
+
+  const double delta_;
+  const double l2_sensitivity_;
+  std::unique_ptr<internal::DiscreteGaussianDistribution> distro_;
 };
 
 // Mechanism builder that returns the mechanism with minimum variance for given
@@ -514,10 +851,57 @@ class MinVarianceMechanismBuilder : public NumericalMechanismBuilder {
     if (GetLInfSensitivity().has_value()) {
       builder.SetLInfSensitivity(GetLInfSensitivity().value());
     }
+    builder.SetRandomSource(GetRandomSource());
     return builder.Build();
   }
 };
 
+// Mechanism builder that wraps another builder and reuses the mechanisms it
+// builds. The first call to Build() for a given combination of epsilon, delta,
+// L0 and LInf sensitivity builds a mechanism with the wrapped builder; later
+// calls with the same parameters return a lightweight handle to that same
+// mechanism instead of validating the parameters, calibrating the noise and
+// allocating the noise distributions again. Clones share the built mechanisms,
+// so a single SharedMechanismBuilder can be passed to the builder of an
+// algorithm (e.g., Count<T>::Builder::SetLaplaceMechanism) that is then built
+// once per partition.
+//
+// It is safe to call Build() on clones from several threads. The built
+// handles hold no per-result state and can be used concurrently as long as the
+// wrapped mechanism supports it, which is the case for the Laplace and
+// Gaussian mechanisms. At most kMaxSharedMechanisms parameter combinations are
+// kept; older ones are dropped (handles that refer to them stay valid).
+class SharedMechanismBuilder : public NumericalMechanismBuilder {
+ public:
+  static constexpr int kMaxSharedMechanisms = 16;
+
+  explicit SharedMechanismBuilder(
+      std::unique_ptr<NumericalMechanismBuilder> mechanism_builder);
+
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override;
+
+  std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
+    return absl::make_unique<SharedMechanismBuilder>(*this);
+  }
+
+  // Returns the number of mechanisms that are currently kept for reuse.
+  int NumSharedMechanisms() const;
+
+ private:
+  struct State;
+
+  std::shared_ptr<State> state_;
+};
+
+// Prepares the calling thread for drawing noise at low latency: initializes
+// OpenSSL and fills the random cache of the thread (see SecureURBG::WarmUp),
+// and builds and draws from a Laplace and a Gaussian mechanism once, which
+// loads their code and calibrates the Gaussian noise of the default
+// parameters. Servers that start often can call it at startup, before the
+// first request, so that the first noised result is not slower than the
+// others. Never required for correctness.
+absl::Status WarmUpNoiseMechanisms();
+
 }  // namespace differential_privacy
 
 #endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_NUMERICAL_MECHANISMS_H_
@@ -26,7 +26,10 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "algorithms/distributions.h"
+#include "algorithms/insecure-rand.h"
+#include "algorithms/rand.h"
 
 namespace differential_privacy {
 namespace {
@@ -1029,9 +1032,9 @@ TEST(NumericalMechanismsTest, GaussianMechanismCdf) {
                        .SetDelta(0.5)
                        .Build()
                        .value();
-  EXPECT_NEAR(mechanism->GetVariance(), 0.257378, 1e-6);
+  EXPECT_NEAR(mechanism->GetVariance(), 0.257115, 1e-6);
 
-  EXPECT_THAT(mechanism->Cdf(0.5), DoubleNear(0.837826, 1e-6));
+  EXPECT_THAT(mechanism->Cdf(0.5), DoubleNear(0.837950, 1e-6));
 }
 
 TEST(NumericalMechanismsTest, GaussianMechanismQuantile) {
@@ -1041,9 +1044,9 @@ TEST(NumericalMechanismsTest, GaussianMechanismQuantile) {
                        .SetDelta(0.5)
                        .Build()
                        .value();
-  EXPECT_NEAR(mechanism->GetVariance(), 0.257378, 1e-6);
+  EXPECT_NEAR(mechanism->GetVariance(), 0.257115, 1e-6);
 
-  EXPECT_THAT(mechanism->Quantile(0.837826), DoubleNear(0.5, 1e-6));
+  EXPECT_THAT(mechanism->Quantile(0.837950), DoubleNear(0.5, 1e-6));
 }
 
 TEST(NumericalMechanismsTest, GaussianMechanismNoisedValueAboveThreshold) {
@@ -1052,7 +1055,7 @@ TEST(NumericalMechanismsTest, GaussianMechanismNoisedValueAboveThreshold) {
       builder.SetL2Sensitivity(1).SetEpsilon(1).SetDelta(0.5).Build().value();
   // If the computed variance changes, then we need to update the probabilities
   // in test_scenarios below.
-  EXPECT_NEAR(mechanism->GetVariance(), 0.257378, 1e-6);
+  EXPECT_NEAR(mechanism->GetVariance(), 0.257115, 1e-6);
 
   struct TestScenario {
     double input;
@@ -1064,9 +1067,9 @@ TEST(NumericalMechanismsTest, GaussianMechanismNoisedValueAboveThreshold) {
   // the test successful if a sufficient expected number of trials provide the
   // expected result.
   std::vector<TestScenario> test_scenarios = {
-      {-0.5, -0.5, 0.5000}, {0.0, -0.5, 0.8378}, {0.5, -0.5, 0.9756},
-      {-0.5,  0.0, 0.1622}, {0.0,  0.0, 0.5000}, {0.5,  0.0, 0.8378},
-      {-0.5,  0.5, 0.0244}, {0.0,  0.5, 0.1622}, {0.5,  0.5, 0.5000},
+      {-0.5, -0.5, 0.5000}, {0.0, -0.5, 0.8380}, {0.5, -0.5, 0.9757},
+      {-0.5,  0.0, 0.1620}, {0.0,  0.0, 0.5000}, {0.5,  0.0, 0.8380},
+      {-0.5,  0.5, 0.0243}, {0.0,  0.5, 0.1620}, {0.5,  0.5, 0.5000},
   };
 
   double num_above_thresold;
@@ -1123,10 +1126,10 @@ TEST(NumericalMechanismsTest, Stddev) {
                        .SetDelta(0.00001)
                        .Build();
   auto gaussian = dynamic_cast<GaussianMechanism *>(mechanism.value().get());
-  EXPECT_DOUBLE_EQ(gaussian->CalculateStddev(), 3.42578125);
+  EXPECT_NEAR(gaussian->CalculateStddev(), 3.42466240, 1e-8);
   // Call CalculateStddev with parameters differing from the attributes.
-  EXPECT_DOUBLE_EQ(gaussian->CalculateStddev(std::log(4), 0.00002, 3.0),
-                   7.986328125);
+  EXPECT_NEAR(gaussian->CalculateStddev(std::log(4), 0.00002, 3.0),
+              7.98491162, 1e-8);
 }
 
 TEST(NumericalMechanismsTest, GaussianVarianceReturnsWallysResult) {
@@ -1307,5 +1310,398 @@ TEST(NumericalMechanismTest, AddNoiseReturnsNegativeValuesForUnsignedInt) {
   EXPECT_THAT(results, Contains(Lt(0)));
 }
 
+TEST(NumericalMechanismTest, BatchAddNoiseFailsOnSizeMismatch) {
+  std::unique_ptr<NumericalMechanism> mechanism =
+      LaplaceMechanism::Builder().SetL1Sensitivity(1).SetEpsilon(1).Build()
+          .value();
+  std::vector<double> input(3, 0.0);
+  std::vector<double> output(2);
+  EXPECT_THAT(mechanism->AddNoise(input, absl::MakeSpan(output)),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("same size")));
+}
+
+TEST(NumericalMechanismTest, LaplaceBatchAddNoiseUsesDistribution) {
+  auto distro = std::make_unique<MockLaplaceDistribution>();
+  EXPECT_CALL(*distro, Sample())
+      .WillOnce(Return(1.0))
+      .WillOnce(Return(-2.0))
+      .WillOnce(Return(3.0));
+  LaplaceMechanism mechanism(1.0, 1.0, std::move(distro));
+
+  std::vector<double> values = {10.0, 20.0, 30.0};
+  // Noise is added in place.
+  ASSERT_OK(mechanism.AddNoise(values, absl::MakeSpan(values)));
+  EXPECT_THAT(values, testing::ElementsAre(11.0, 18.0, 33.0));
+}
+
+TEST(NumericalMechanismTest, LaplaceBatchAddNoiseRoundsToGranularity) {
+  // Granularity of 2 for int and 1024 for double, see
+  // LaplaceRoundsToGranularity_* tests.
+  std::unique_ptr<NumericalMechanism> mechanism =
+      LaplaceMechanism::Builder()
+          .SetEpsilon(8.9e-16)
+          .SetL0Sensitivity(1)
+          .SetLInfSensitivity(1)
+          .Build()
+          .value();
+
+  std::vector<double> double_input(kSmallNumSamples);
+  std::vector<int64_t> int_input(kSmallNumSamples);
+  for (int i = 0; i < kSmallNumSamples; ++i) {
+    double_input[i] = UniformDouble() * 2e6 - 1e6;
+    int_input[i] = static_cast<int64_t>(double_input[i]);
+  }
+  std::vector<double> double_output(kSmallNumSamples);
+  std::vector<int64_t> int_output(kSmallNumSamples);
+  ASSERT_OK(mechanism->AddNoise(double_input, absl::MakeSpan(double_output)));
+  ASSERT_OK(mechanism->AddNoise(int_input, absl::MakeSpan(int_output)));
+  for (int i = 0; i < kSmallNumSamples; ++i) {
+    EXPECT_EQ(std::fmod(double_output[i], 1024), 0);
+    EXPECT_EQ(int_output[i] % 1024, 0);
+  }
+}
+
+TEST(NumericalMechanismTest, GaussianBatchAddNoiseHasExpectedMoments) {
+  std::unique_ptr<NumericalMechanism> mechanism = GaussianMechanism::Builder()
+                                                      .SetL2Sensitivity(1.0)
+                                                      .SetEpsilon(1.0)
+                                                      .SetDelta(1e-5)
+                                                      .Build()
+                                                      .value();
+  const double variance = mechanism->GetVariance();
+
+  std::vector<double> double_values(kNumSamples, 10.0);
+  std::vector<int64_t> int_values(kNumSamples, 10);
+  ASSERT_OK(
+      mechanism->AddNoise(double_values, absl::MakeSpan(double_values)));
+  ASSERT_OK(mechanism->AddNoise(int_values, absl::MakeSpan(int_values)));
+
+  double double_sum = 0, double_sum_of_squares = 0;
+  double int_sum = 0, int_sum_of_squares = 0;
+  for (int i = 0; i < kNumSamples; ++i) {
+    double_sum += double_values[i] - 10.0;
+    double_sum_of_squares += std::pow(double_values[i] - 10.0, 2);
+    int_sum += int_values[i] - 10;
+    int_sum_of_squares += std::pow(int_values[i] - 10, 2);
+  }
+  EXPECT_NEAR(double_sum / kNumSamples, 0.0, 0.05);
+  EXPECT_NEAR(double_sum_of_squares / kNumSamples, variance, 0.05 * variance);
+  EXPECT_NEAR(int_sum / kNumSamples, 0.0, 0.05);
+  // Rounding to integers adds 1/12 to the variance.
+  EXPECT_NEAR(int_sum_of_squares / kNumSamples, variance + 1.0 / 12,
+              0.05 * variance);
+}
+
+TEST(SharedMechanismBuilderTest, ReusesMechanismForSameParameters) {
+  SharedMechanismBuilder builder(
+      absl::make_unique<LaplaceMechanism::Builder>());
+  builder.SetEpsilon(1.0).SetL0Sensitivity(1).SetLInfSensitivity(2);
+
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> first = builder.Build();
+  ASSERT_OK(first);
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> second = builder.Build();
+  ASSERT_OK(second);
+
+  EXPECT_EQ(builder.NumSharedMechanisms(), 1);
+  EXPECT_EQ((*first)->GetEpsilon(), 1.0);
+  EXPECT_EQ((*second)->GetVariance(), (*first)->GetVariance());
+  // Laplace with scale 2 has variance 2 * 2^2.
+  EXPECT_DOUBLE_EQ((*first)->GetVariance(), 8.0);
+}
+
+TEST(SharedMechanismBuilderTest, BuildsNewMechanismForDifferentParameters) {
+  SharedMechanismBuilder builder(
+      absl::make_unique<LaplaceMechanism::Builder>());
+  builder.SetL0Sensitivity(1).SetLInfSensitivity(1);
+
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> first =
+      builder.SetEpsilon(1.0).Build();
+  ASSERT_OK(first);
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> second =
+      builder.SetEpsilon(2.0).Build();
+  ASSERT_OK(second);
+
+  EXPECT_EQ(builder.NumSharedMechanisms(), 2);
+  EXPECT_EQ((*first)->GetEpsilon(), 1.0);
+  EXPECT_EQ((*second)->GetEpsilon(), 2.0);
+  EXPECT_DOUBLE_EQ((*first)->GetVariance(), 4 * (*second)->GetVariance());
+}
+
+TEST(SharedMechanismBuilderTest, ClonesShareMechanisms) {
+  auto gaussian_builder = absl::make_unique<GaussianMechanism::Builder>();
+  gaussian_builder->SetL2Sensitivity(1.0);
+  SharedMechanismBuilder builder(std::move(gaussian_builder));
+  std::unique_ptr<NumericalMechanismBuilder> clone = builder.Clone();
+
+  ASSERT_OK(builder.SetEpsilon(1.0).SetDelta(1e-5).Build());
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> mechanism =
+      clone->SetEpsilon(1.0).SetDelta(1e-5).Build();
+  ASSERT_OK(mechanism);
+
+  EXPECT_EQ(builder.NumSharedMechanisms(), 1);
+  EXPECT_DOUBLE_EQ((*mechanism)->GetVariance(), GaussianMechanism::Builder()
+                                                    .SetL2Sensitivity(1.0)
+                                                    .SetEpsilon(1.0)
+                                                    .SetDelta(1e-5)
+                                                    .Build()
+                                                    .value()
+                                                    ->GetVariance());
+}
+
+TEST(SharedMechanismBuilderTest, ReturnsErrorsOfWrappedBuilder) {
+  SharedMechanismBuilder builder(
+      absl::make_unique<LaplaceMechanism::Builder>());
+
+  EXPECT_THAT(builder.SetEpsilon(-1.0).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Epsilon must be finite and positive")));
+  EXPECT_EQ(builder.NumSharedMechanisms(), 0);
+}
+
+TEST(SharedMechanismBuilderTest, ReturnsErrorWithoutWrappedBuilder) {
+  SharedMechanismBuilder builder(nullptr);
+
+  EXPECT_THAT(builder.SetEpsilon(1.0).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("requires a mechanism builder")));
+}
+
+TEST(SharedMechanismBuilderTest, KeepsBoundedNumberOfMechanisms) {
+  SharedMechanismBuilder builder(
+      absl::make_unique<LaplaceMechanism::Builder>());
+  builder.SetL0Sensitivity(1).SetLInfSensitivity(1);
+  std::vector<std::unique_ptr<NumericalMechanism>> mechanisms;
+  for (int i = 1; i <= SharedMechanismBuilder::kMaxSharedMechanisms + 5; ++i) {
+    absl::StatusOr<std::unique_ptr<NumericalMechanism>> mechanism =
+        builder.SetEpsilon(i).Build();
+    ASSERT_OK(mechanism);
+    mechanisms.push_back(std::move(mechanism).value());
+  }
+
+  EXPECT_EQ(builder.NumSharedMechanisms(),
+            SharedMechanismBuilder::kMaxSharedMechanisms);
+  // Handles to mechanisms that are no longer kept remain usable.
+  EXPECT_EQ(mechanisms.front()->GetEpsilon(), 1.0);
+  EXPECT_NE(mechanisms.front()->AddNoise(0.0), 0.0);
+}
+
+TEST(SharedMechanismBuilderTest, HandlesAddNoise) {
+  SharedMechanismBuilder builder(
+      absl::make_unique<LaplaceMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> mechanism =
+      builder.SetEpsilon(1.0).SetL0Sensitivity(1).SetLInfSensitivity(1).Build();
+  ASSERT_OK(mechanism);
+
+  std::vector<double> values(kSmallNumSamples, 10.0);
+  ASSERT_OK((*mechanism)->AddNoise(values, absl::MakeSpan(values)));
+  double sum = 0;
+  for (double value : values) {
+    sum += value;
+  }
+  EXPECT_NEAR(sum / kSmallNumSamples, 10.0, 0.5);
+  EXPECT_THAT(
+      (*mechanism)->AddNoise(values, absl::MakeSpan(values).subspan(1)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(DiscreteLaplaceMechanismTest, AddsIntegerNoise) {
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> mechanism =
+      DiscreteLaplaceMechanism::Builder()
+          .SetL1Sensitivity(1)
+          .SetEpsilon(1.0)
+          .Build();
+  ASSERT_OK(mechanism);
+
+  std::vector<int64_t> results(kSmallNumSamples, 10);
+  ASSERT_OK((*mechanism)->AddNoise(results, absl::MakeSpan(results)));
+  double sum = 0;
+  for (int64_t result : results) {
+    sum += result;
+  }
+  EXPECT_NEAR(sum / kSmallNumSamples, 10.0, 0.5);
+
+  for (int i = 0; i < 100; ++i) {
+    const double noised = (*mechanism)->AddNoise(2.4);
+    EXPECT_EQ(noised, std::round(noised));
+  }
+}
+
+TEST(DiscreteLaplaceMechanismTest, RoundsLInfSensitivityUp) {
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> mechanism =
+      DiscreteLaplaceMechanism::Builder()
+          .SetEpsilon(1.0)
+          .SetL0Sensitivity(2)
+          .SetLInfSensitivity(1.5)
+          .Build();
+  ASSERT_OK(mechanism);
+  auto* laplace = dynamic_cast<DiscreteLaplaceMechanism*>(mechanism->get());
+  ASSERT_NE(laplace, nullptr);
+  EXPECT_EQ(laplace->GetL1Sensitivity(), 4);
+  EXPECT_DOUBLE_EQ(laplace->GetRate(), 0.25);
+}
+
+TEST(DiscreteLaplaceMechanismTest, BuilderFailsWithFractionalL1Sensitivity) {
+  EXPECT_THAT(DiscreteLaplaceMechanism::Builder()
+                  .SetL1Sensitivity(0.5)
+                  .SetEpsilon(1.0)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("must be an integer")));
+}
+
+TEST(DiscreteLaplaceMechanismTest, BuilderFailsWithoutSensitivity) {
+  EXPECT_THAT(DiscreteLaplaceMechanism::Builder().SetEpsilon(1.0).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("L1 or (L0 and LInf)")));
+}
+
+TEST(DiscreteLaplaceMechanismTest, ConfidenceIntervalCoversNoise) {
+  std::unique_ptr<NumericalMechanism> mechanism =
+      DiscreteLaplaceMechanism::Builder()
+          .SetL1Sensitivity(1)
+          .SetEpsilon(0.5)
+          .Build()
+          .value();
+  absl::StatusOr<ConfidenceInterval> interval =
+      mechanism->NoiseConfidenceInterval(0.9, 0);
+  ASSERT_OK(interval);
+  int covered = 0;
+  for (int i = 0; i < kSmallNumSamples; ++i) {
+    const int64_t noise = mechanism->AddNoise(int64_t{0});
+    covered += noise >= interval->lower_bound() &&
+               noise <= interval->upper_bound();
+  }
+  EXPECT_GE(static_cast<double>(covered) / kSmallNumSamples, 0.88);
+  EXPECT_THAT(mechanism->NoiseConfidenceInterval(1.5),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(DiscreteGaussianMechanismTest, CalibratesAtLeastContinuousStddev) {
+  for (double epsilon : {0.1, 1.0, 5.0}) {
+    for (double delta : {1e-5, 1e-10}) {
+      absl::StatusOr<double> stddev =
+          DiscreteGaussianMechanism::CalculateStddev(epsilon, delta, 2);
+      ASSERT_OK(stddev);
+      const double continuous =
+          GaussianMechanism::CalculateStddev(epsilon, delta, 2);
+      EXPECT_GE(*stddev, 0.999 * continuous);
+      EXPECT_LE(*stddev, 1.5 * continuous);
+    }
+  }
+}
+
+TEST(DiscreteGaussianMechanismTest, AddsIntegerNoise) {
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> mechanism =
+      DiscreteGaussianMechanism::Builder()
+          .SetEpsilon(1.0)
+          .SetDelta(1e-5)
+          .SetL0Sensitivity(4)
+          .SetLInfSensitivity(1)
+          .Build();
+  ASSERT_OK(mechanism);
+  auto* gaussian = dynamic_cast<DiscreteGaussianMechanism*>(mechanism->get());
+  ASSERT_NE(gaussian, nullptr);
+  EXPECT_EQ(gaussian->GetL2Sensitivity(), 2);
+
+  std::vector<int64_t> results(kSmallNumSamples, -3);
+  ASSERT_OK((*mechanism)->AddNoise(results, absl::MakeSpan(results)));
+  double sum = 0;
+  double sum_of_squares = 0;
+  for (int64_t result : results) {
+    sum += result + 3;
+    sum_of_squares += std::pow(result + 3, 2);
+  }
+  EXPECT_NEAR(sum / kSmallNumSamples, 0, 0.5);
+  EXPECT_NEAR(sum_of_squares / kSmallNumSamples, gaussian->GetVariance(),
+              0.1 * gaussian->GetVariance());
+}
+
+TEST(DiscreteGaussianMechanismTest, SetStandardDeviation) {
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> mechanism =
+      DiscreteGaussianMechanism::Builder().SetStandardDeviation(3).Build();
+  ASSERT_OK(mechanism);
+  EXPECT_NEAR((*mechanism)->GetVariance(), 9, 1e-3);
+
+  DiscreteGaussianMechanism::Builder builder;
+  builder.SetStandardDeviation(3);
+  EXPECT_THAT(builder.SetEpsilon(1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("must be the only parameter")));
+}
+
+TEST(DiscreteGaussianMechanismTest, BuilderFailsWithFractionalL2Sensitivity) {
+  DiscreteGaussianMechanism::Builder builder;
+  builder.SetL2Sensitivity(0.5).SetEpsilon(1).SetDelta(1e-5);
+  EXPECT_THAT(builder.Build(), StatusIs(absl::StatusCode::kInvalidArgument,
+                                        HasSubstr("must be an integer")));
+}
+
+TEST(DiscreteGaussianMechanismTest, BuilderFailsWithoutDelta) {
+  EXPECT_THAT(DiscreteGaussianMechanism::Builder()
+                  .SetEpsilon(1)
+                  .SetL0Sensitivity(1)
+                  .SetLInfSensitivity(1)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("Delta")));
+}
+
+// Adds noise with a mechanism built from a copy of builder that draws from an
+// InsecureRandomSource with the given seed.
+std::vector<double> NoiseWithSeededSource(
+    const NumericalMechanismBuilder& builder, uint64_t seed) {
+  InsecureRandomSource source(seed);
+  std::unique_ptr<NumericalMechanismBuilder> copy = builder.Clone();
+  copy->SetEpsilon(1).SetDelta(1e-5).SetL0Sensitivity(1).SetLInfSensitivity(
+      1);
+  std::unique_ptr<NumericalMechanism> mechanism =
+      copy->SetRandomSource(&source).Build().value();
+  std::vector<double> noised;
+  for (int i = 0; i < 100; ++i) {
+    noised.push_back(mechanism->AddNoise(0.0));
+  }
+  return noised;
+}
+
+TEST(NumericalMechanismsTest, RandomSourceMakesNoiseReproducible) {
+  std::vector<std::unique_ptr<NumericalMechanismBuilder>> builders;
+  builders.push_back(absl::make_unique<LaplaceMechanism::Builder>());
+  builders.push_back(absl::make_unique<GaussianMechanism::Builder>());
+  builders.push_back(absl::make_unique<DiscreteLaplaceMechanism::Builder>());
+  builders.push_back(absl::make_unique<DiscreteGaussianMechanism::Builder>());
+  for (const std::unique_ptr<NumericalMechanismBuilder>& builder : builders) {
+    EXPECT_EQ(NoiseWithSeededSource(*builder, 17),
+              NoiseWithSeededSource(*builder, 17));
+    EXPECT_NE(NoiseWithSeededSource(*builder, 17),
+              NoiseWithSeededSource(*builder, 18));
+  }
+}
+
+TEST(NumericalMechanismsTest, RandomSourceDoesNotLeakIntoThreadRandomness) {
+  InsecureRandomSource source(19);
+  std::unique_ptr<NumericalMechanism> mechanism =
+      DiscreteLaplaceMechanism::Builder()
+          .SetEpsilon(1)
+          .SetL0Sensitivity(1)
+          .SetLInfSensitivity(1)
+          .SetRandomSource(&source)
+          .Build()
+          .value();
+  mechanism->AddNoise(0.0);
+  // Words drawn outside of the mechanism still come from SecureURBG, and not
+  // from the seeded stream.
+  InsecureURBG seeded(19);
+  const uint64_t word = SecureURBG::GetInstance()();
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_NE(word, seeded());
+  }
+}
+
+TEST(WarmUpNoiseMechanismsTest, Succeeds) {
+  EXPECT_OK(WarmUpNoiseMechanisms());
+  // Warming up again is harmless.
+  EXPECT_OK(WarmUpNoiseMechanisms());
+}
+
 }  // namespace
 }  // namespace differential_privacy
@@ -17,6 +17,8 @@
 #ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_ORDER_STATISTICS_H_
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_ORDER_STATISTICS_H_
 
+#include <optional>
+
 #include "base/percentile.h"
 #include "absl/base/attributes.h"
 #include "absl/status/status.h"
@@ -24,6 +26,7 @@
 #include "algorithms/algorithm.h"
 #include "algorithms/binary-search.h"
 #include "algorithms/bounded-algorithm.h"
+#include "algorithms/internal/count-tree-percentile.h"
 #include "algorithms/numerical-mechanisms.h"
 
 // Old classes for calculating order statistics (aka quantiles, aka
@@ -47,6 +50,18 @@ class OrderStatisticsBuilder
     BoundedBuilder::SetUpper(std::numeric_limits<T>::max());
   }
 
+  // Counts the inputs in a tree of branching_factor^height buckets of equal
+  // width over [lower, upper] instead of storing them, like QuantileTree does.
+  // Memory and summary size then only depend on the tree parameters, and the
+  // result is interpolated within the bucket that contains it. Summaries of
+  // aggregations that store their inputs can be merged into one that counts
+  // them in a tree, but not the other way around.
+  Builder& SetCountTree(int height, int branching_factor) {
+    count_tree_height_ = height;
+    count_tree_branching_factor_ = branching_factor;
+    return *static_cast<Builder*>(this);
+  }
+
  protected:
   // Check numeric parameters and construct quantiles and mechanism. Called
   // only at build.
@@ -71,13 +86,27 @@ class OrderStatisticsBuilder
           "Order statistics are only supported for Laplace mechanism.");
     }
 
-    quantiles_ = absl::make_unique<base::Percentile<T>>();
+    if (count_tree_height_.has_value()) {
+      RETURN_IF_ERROR(internal::CountTreePercentile<T>::ValidateParameters(
+          count_tree_height_.value(), count_tree_branching_factor_.value()));
+      count_tree_ = absl::make_unique<internal::CountTreePercentile<T>>(
+          BoundedBuilder::GetLower().value(),
+          BoundedBuilder::GetUpper().value(), count_tree_height_.value(),
+          count_tree_branching_factor_.value());
+    } else {
+      quantiles_ = absl::make_unique<base::Percentile<T>>();
+    }
     return absl::OkStatus();
   }
 
   // Constructed when processing parameters.
   std::unique_ptr<LaplaceMechanism> mechanism_;
   std::unique_ptr<base::Percentile<T>> quantiles_;
+  std::unique_ptr<internal::CountTreePercentile<T>> count_tree_;
+
+ private:
+  std::optional<int> count_tree_height_;
+  std::optional<int> count_tree_branching_factor_;
 };
 
 template <typename T>
@@ -103,7 +132,8 @@ class ABSL_DEPRECATED("Use Quantiles instead.") Max : public BinarySearch<T> {
           BoundedBuilder::GetUpper().value(),
           AlgorithmBuilder::GetMaxPartitionsContributed().value_or(1),
           AlgorithmBuilder::GetMaxContributionsPerPartition().value_or(1),
-          std::move(laplace_builder), std::move(OrderBuilder::quantiles_)));
+          std::move(laplace_builder), std::move(OrderBuilder::quantiles_),
+          std::move(OrderBuilder::count_tree_)));
     }
   };
 
@@ -111,10 +141,12 @@ class ABSL_DEPRECATED("Use Quantiles instead.") Max : public BinarySearch<T> {
   Max(double epsilon, T lower, T upper, int64_t max_partitions_contributed,
       int64_t max_contributions_per_partition,
       std::unique_ptr<LaplaceMechanism::Builder> mechanism_builder,
-      std::unique_ptr<base::Percentile<T>> quantiles)
+      std::unique_ptr<base::Percentile<T>> quantiles,
+      std::unique_ptr<internal::CountTreePercentile<T>> count_tree)
       : BinarySearch<T>(epsilon, lower, upper, max_partitions_contributed,
                         max_contributions_per_partition, /*quantile=*/1,
-                        std::move(mechanism_builder), std::move(quantiles)) {}
+                        std::move(mechanism_builder), std::move(quantiles),
+                        std::move(count_tree)) {}
 };
 
 template <typename T>
@@ -140,7 +172,8 @@ class ABSL_DEPRECATED("Use Quantiles instead.") Min : public BinarySearch<T> {
           BoundedBuilder::GetUpper().value(),
           AlgorithmBuilder::GetMaxPartitionsContributed().value_or(1),
           AlgorithmBuilder::GetMaxContributionsPerPartition().value_or(1),
-          std::move(laplace_builder), std::move(OrderBuilder::quantiles_)));
+          std::move(laplace_builder), std::move(OrderBuilder::quantiles_),
+          std::move(OrderBuilder::count_tree_)));
     }
   };
 
@@ -148,10 +181,12 @@ class ABSL_DEPRECATED("Use Quantiles instead.") Min : public BinarySearch<T> {
   Min(double epsilon, T lower, T upper, int64_t max_partitions_contributed,
       int64_t max_contributions_per_partition,
       std::unique_ptr<LaplaceMechanism::Builder> mechanism_builder,
-      std::unique_ptr<base::Percentile<T>> quantiles)
+      std::unique_ptr<base::Percentile<T>> quantiles,
+      std::unique_ptr<internal::CountTreePercentile<T>> count_tree)
       : BinarySearch<T>(epsilon, lower, upper, max_partitions_contributed,
                         max_contributions_per_partition, /*quantile=*/0,
-                        std::move(mechanism_builder), std::move(quantiles)) {}
+                        std::move(mechanism_builder), std::move(quantiles),
+                        std::move(count_tree)) {}
 };
 
 template <typename T>
@@ -179,7 +214,8 @@ class ABSL_DEPRECATED("Use Quantiles instead.") Median
           BoundedBuilder::GetUpper().value(),
           AlgorithmBuilder::GetMaxPartitionsContributed().value_or(1),
           AlgorithmBuilder::GetMaxContributionsPerPartition().value_or(1),
-          std::move(laplace_builder), std::move(OrderBuilder::quantiles_)));
+          std::move(laplace_builder), std::move(OrderBuilder::quantiles_),
+          std::move(OrderBuilder::count_tree_)));
     }
   };
 
@@ -187,10 +223,12 @@ class ABSL_DEPRECATED("Use Quantiles instead.") Median
   Median(double epsilon, T lower, T upper, int64_t max_partitions_contributed,
          int64_t max_contributions_per_partition,
          std::unique_ptr<LaplaceMechanism::Builder> mechanism_builder,
-         std::unique_ptr<base::Percentile<T>> quantiles)
+         std::unique_ptr<base::Percentile<T>> quantiles,
+         std::unique_ptr<internal::CountTreePercentile<T>> count_tree)
       : BinarySearch<T>(epsilon, lower, upper, max_partitions_contributed,
                         max_contributions_per_partition, /*quantile=*/0.5,
-                        std::move(mechanism_builder), std::move(quantiles)) {}
+                        std::move(mechanism_builder), std::move(quantiles),
+                        std::move(count_tree)) {}
 };
 
 template <typename T>
@@ -229,7 +267,8 @@ class ABSL_DEPRECATED("Use Quantiles instead.") Percentile
           BoundedBuilder::GetUpper().value(),
           AlgorithmBuilder::GetMaxPartitionsContributed().value_or(1),
           AlgorithmBuilder::GetMaxContributionsPerPartition().value_or(1),
-          std::move(laplace_builder), std::move(OrderBuilder::quantiles_)));
+          std::move(laplace_builder), std::move(OrderBuilder::quantiles_),
+          std::move(OrderBuilder::count_tree_)));
     }
 
     double percentile_;
@@ -242,10 +281,12 @@ class ABSL_DEPRECATED("Use Quantiles instead.") Percentile
              int64_t max_partitions_contributed,
              int64_t max_contributions_per_partition,
              std::unique_ptr<LaplaceMechanism::Builder> mechanism_builder,
-             std::unique_ptr<base::Percentile<T>> quantiles)
+             std::unique_ptr<base::Percentile<T>> quantiles,
+         std::unique_ptr<internal::CountTreePercentile<T>> count_tree)
       : BinarySearch<T>(epsilon, lower, upper, max_partitions_contributed,
                         max_contributions_per_partition, percentile,
-                        std::move(mechanism_builder), std::move(quantiles)),
+                        std::move(mechanism_builder), std::move(quantiles),
+                        std::move(count_tree)),
         percentile_(percentile) {}
 
   const double percentile_;
@@ -189,6 +189,81 @@ TEST(OrderStatisticsTest, Median_DefaultBounds) {
   EXPECT_EQ(GetValue<int64_t>(*result), 100);
 }
 
+TEST(OrderStatisticsTest, CountTreeSummaryHasFixedSize) {
+  Median<double>::Builder builder;
+  builder.SetEpsilon(1)
+      .SetLower(0)
+      .SetUpper(1000)
+      .SetCountTree(/*height=*/3, /*branching_factor=*/10)
+      .SetLaplaceMechanism(absl::make_unique<ZeroNoiseMechanism::Builder>());
+  absl::StatusOr<std::unique_ptr<Median<double>>> median1 = builder.Build();
+  ASSERT_OK(median1);
+  absl::StatusOr<std::unique_ptr<Median<double>>> median2 = builder.Build();
+  ASSERT_OK(median2);
+  for (int i = 0; i < kDataSize; ++i) {
+    (*median1)->AddEntry(i % 500);
+    (*median2)->AddEntry(500 + i % 500);
+  }
+
+  Summary summary = (*median1)->Serialize();
+  BinarySearchSummary bs_summary;
+  ASSERT_TRUE(summary.data().UnpackTo(&bs_summary));
+  EXPECT_EQ(bs_summary.input_size(), 0);
+  EXPECT_FALSE(bs_summary.has_sketch());
+  EXPECT_LE(bs_summary.count_tree().dense_quantile_tree_size() +
+                bs_summary.count_tree().sparse_quantile_tree_counts_size(),
+            1111);
+
+  ASSERT_OK((*median2)->Merge(summary));
+  absl::StatusOr<Output> result = (*median2)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_NEAR(GetValue<double>(*result), 500, 5);
+}
+
+TEST(OrderStatisticsTest, CountTreeMergesExactSummary) {
+  absl::StatusOr<std::unique_ptr<Median<int64_t>>> exact =
+      Median<int64_t>::Builder()
+          .SetEpsilon(1)
+          .SetLower(0)
+          .SetUpper(100)
+          .Build();
+  ASSERT_OK(exact);
+  absl::StatusOr<std::unique_ptr<Median<int64_t>>> tree =
+      Median<int64_t>::Builder()
+          .SetEpsilon(1)
+          .SetLower(0)
+          .SetUpper(100)
+          .SetCountTree(/*height=*/2, /*branching_factor=*/10)
+          .SetLaplaceMechanism(
+              absl::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build();
+  ASSERT_OK(tree);
+  for (int i = 0; i < kDataSize; ++i) {
+    (*exact)->AddEntry(i % 100);
+  }
+
+  ASSERT_OK((*tree)->Merge((*exact)->Serialize()));
+  absl::StatusOr<Output> result = (*tree)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_NEAR(GetValue<int64_t>(*result), 50, 2);
+
+  // The inputs cannot be recovered from the tree.
+  EXPECT_THAT((*exact)->Merge((*tree)->Serialize()),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Cannot merge a count tree summary")));
+}
+
+TEST(OrderStatisticsTest, InvalidCountTree) {
+  EXPECT_THAT(Median<int64_t>::Builder()
+                  .SetEpsilon(1)
+                  .SetLower(0)
+                  .SetUpper(10)
+                  .SetCountTree(/*height=*/0, /*branching_factor=*/10)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Tree height must be at least 1")));
+}
+
 }  // namespace
 }  // namespace continuous
 }  // namespace differential_privacy
@@ -0,0 +1,106 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_PARALLEL_ADD_ENTRIES_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_PARALLEL_ADD_ENTRIES_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/merge-summaries.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Runs a task, e.g., by handing it to a thread pool owned by the caller. Every
+// scheduled task must eventually run. Tasks may also run before the call
+// returns, e.g., on the calling thread.
+using TaskScheduler = std::function<void(std::function<void()>)>;
+
+// Adds the entries to `algorithm` using up to `num_slices` tasks scheduled with
+// `schedule`. This has the same result as algorithm->AddEntries(entries), up to
+// floating-point rounding of partial sums, and is meant for a single large
+// partition whose input does not fit the time budget of one thread.
+//
+// The entries are split into one contiguous slice per task. Each task adds its
+// slice with the batch AddEntries of its own empty algorithm created by
+// `factory`, which must have the same parameters as `algorithm`. Once all
+// tasks finished, the per-slice algorithms are merged into `algorithm` with
+// MergeFrom on the calling thread.
+//
+// Returns the first error. If an argument is invalid or the factory fails, no
+// task is scheduled and `algorithm` is not modified.
+template <typename T>
+absl::Status AddEntriesInParallel(absl::Span<const T> entries,
+                                  const AlgorithmFactory<T>& factory,
+                                  int num_slices,
+                                  const TaskScheduler& schedule,
+                                  Algorithm<T>* algorithm) {
+  if (algorithm == nullptr) {
+    return absl::InvalidArgumentError("Algorithm must not be null.");
+  }
+  if (num_slices < 1) {
+    return absl::InvalidArgumentError("Number of slices must be at least 1.");
+  }
+  if (!schedule) {
+    return absl::InvalidArgumentError("Task scheduler must not be null.");
+  }
+  if (entries.empty()) {
+    return absl::OkStatus();
+  }
+
+  // Every slice but the last has slice_size entries, and none is empty.
+  const size_t slice_size =
+      (entries.size() + num_slices - 1) / static_cast<size_t>(num_slices);
+  num_slices = static_cast<int>((entries.size() + slice_size - 1) / slice_size);
+  std::vector<std::unique_ptr<Algorithm<T>>> partials(num_slices);
+  for (std::unique_ptr<Algorithm<T>>& partial : partials) {
+    absl::StatusOr<std::unique_ptr<Algorithm<T>>> created = factory();
+    RETURN_IF_ERROR(created.status());
+    if (*created == nullptr) {
+      return absl::InvalidArgumentError("Factory returned a null algorithm.");
+    }
+    partial = std::move(created).value();
+  }
+
+  absl::BlockingCounter pending(num_slices);
+  for (int slice = 0; slice < num_slices; ++slice) {
+    schedule([&entries, &partials, &pending, slice, slice_size]() {
+      partials[slice]->AddEntries(entries.subspan(slice * slice_size,
+                                                  slice_size));
+      pending.DecrementCount();
+    });
+  }
+  pending.Wait();
+
+  for (const std::unique_ptr<Algorithm<T>>& partial : partials) {
+    RETURN_IF_ERROR(algorithm->MergeFrom(*partial));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_PARALLEL_ADD_ENTRIES_H_
@@ -0,0 +1,153 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "algorithms/parallel-add-entries.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "base/testing/proto_matchers.h"
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "algorithms/merge-summaries.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::EqualsProto;
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::HasSubstr;
+
+constexpr double kEpsilon = 1.1;
+
+AlgorithmFactory<int64_t> BoundedSumFactory() {
+  return []() -> absl::StatusOr<std::unique_ptr<Algorithm<int64_t>>> {
+    return BoundedSum<int64_t>::Builder().SetEpsilon(kEpsilon).Build();
+  };
+}
+
+std::vector<int64_t> Entries(int num_entries) {
+  std::vector<int64_t> entries;
+  for (int i = 0; i < num_entries; ++i) {
+    entries.push_back(i % 2 == 0 ? i : -3 * i);
+  }
+  return entries;
+}
+
+void RunInline(std::function<void()> task) { task(); }
+
+TEST(AddEntriesInParallelTest, MatchesSerialAddEntries) {
+  std::vector<int64_t> entries = Entries(10001);
+  std::unique_ptr<Algorithm<int64_t>> serial = BoundedSumFactory()().value();
+  serial->AddEntries(entries.begin(), entries.end());
+
+  std::vector<std::thread> threads;
+  auto schedule = [&threads](std::function<void()> task) {
+    threads.emplace_back(std::move(task));
+  };
+  std::unique_ptr<Algorithm<int64_t>> parallel =
+      BoundedSumFactory()().value();
+  EXPECT_OK(AddEntriesInParallel<int64_t>(entries, BoundedSumFactory(), 4,
+                                          schedule, parallel.get()));
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(threads.size(), 4);
+  EXPECT_THAT(parallel->Serialize(), EqualsProto(serial->Serialize()));
+}
+
+TEST(AddEntriesInParallelTest, AddsToEntriesAlreadyInAlgorithm) {
+  std::vector<int64_t> entries = Entries(10);
+  AlgorithmFactory<int64_t> factory =
+      []() -> absl::StatusOr<std::unique_ptr<Algorithm<int64_t>>> {
+    return Count<int64_t>::Builder().SetEpsilon(kEpsilon).Build();
+  };
+  std::unique_ptr<Algorithm<int64_t>> count = factory().value();
+  count->AddEntry(1);
+
+  EXPECT_OK(AddEntriesInParallel<int64_t>(entries, factory, 3, RunInline,
+                                          count.get()));
+
+  std::unique_ptr<Algorithm<int64_t>> serial = factory().value();
+  serial->AddEntry(1);
+  serial->AddEntries(entries.begin(), entries.end());
+  EXPECT_THAT(count->Serialize(), EqualsProto(serial->Serialize()));
+}
+
+TEST(AddEntriesInParallelTest, UsesAtMostOneSlicePerEntry) {
+  std::vector<int64_t> entries = Entries(5);
+  int num_tasks = 0;
+  auto schedule = [&num_tasks](std::function<void()> task) {
+    ++num_tasks;
+    task();
+  };
+  std::unique_ptr<Algorithm<int64_t>> sum = BoundedSumFactory()().value();
+
+  EXPECT_OK(AddEntriesInParallel<int64_t>(entries, BoundedSumFactory(), 4,
+                                          schedule, sum.get()));
+
+  // Slices of 2 entries, so the 4th slice would be empty.
+  EXPECT_EQ(num_tasks, 3);
+  std::unique_ptr<Algorithm<int64_t>> serial = BoundedSumFactory()().value();
+  serial->AddEntries(entries.begin(), entries.end());
+  EXPECT_THAT(sum->Serialize(), EqualsProto(serial->Serialize()));
+}
+
+TEST(AddEntriesInParallelTest, EmptyEntriesScheduleNothing) {
+  std::unique_ptr<Algorithm<int64_t>> sum = BoundedSumFactory()().value();
+  auto schedule = [](std::function<void()> task) { FAIL(); };
+  EXPECT_OK(AddEntriesInParallel<int64_t>({}, BoundedSumFactory(), 4,
+                                          schedule, sum.get()));
+}
+
+TEST(AddEntriesInParallelTest, InvalidArguments) {
+  std::vector<int64_t> entries = Entries(10);
+  std::unique_ptr<Algorithm<int64_t>> sum = BoundedSumFactory()().value();
+
+  EXPECT_THAT(AddEntriesInParallel<int64_t>(entries, BoundedSumFactory(), 2,
+                                            RunInline, nullptr),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("must not be null")));
+  EXPECT_THAT(AddEntriesInParallel<int64_t>(entries, BoundedSumFactory(), 0,
+                                            RunInline, sum.get()),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("at least 1")));
+  EXPECT_THAT(AddEntriesInParallel<int64_t>(entries, BoundedSumFactory(), 2,
+                                            nullptr, sum.get()),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("scheduler")));
+  AlgorithmFactory<int64_t> failing_factory =
+      []() -> absl::StatusOr<std::unique_ptr<Algorithm<int64_t>>> {
+    return absl::InternalError("Factory failed.");
+  };
+  EXPECT_THAT(AddEntriesInParallel<int64_t>(entries, failing_factory, 2,
+                                            RunInline, sum.get()),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+}  // namespace
+}  // namespace differential_privacy
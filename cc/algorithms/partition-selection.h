@@ -17,16 +17,21 @@
 #ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_PARTITION_SELECTION_H_
 #define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_PARTITION_SELECTION_H_
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "absl/base/call_once.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "algorithms/distributions.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "algorithms/rand.h"
@@ -61,6 +66,18 @@ class PartitionSelectionStrategy {
   // should be kept and false otherwise.
   virtual bool ShouldKeep(double num_users) = 0;
 
+  // Batched ShouldKeep for integer user counts: resizes out to the number of
+  // counts and sets (*out)[i] to whether the partition with counts[i] users
+  // should be kept. Strategies may override this to share work across
+  // partitions; the default calls ShouldKeep for every count.
+  virtual void ShouldKeep(absl::Span<const int64_t> counts,
+                          std::vector<bool>* out) {
+    out->resize(counts.size());
+    for (size_t i = 0; i < counts.size(); ++i) {
+      (*out)[i] = ShouldKeep(static_cast<double>(counts[i]));
+    }
+  }
+
   virtual double ProbabilityOfKeep(double num_users) const = 0;
 
  protected:
@@ -150,6 +167,31 @@ class PartitionSelectionStrategyBuilder {
     return *this;
   }
 
+  // Partitions whose probability of being dropped is at most tolerance are
+  // kept without drawing any randomness. This is only used by the Laplace and
+  // Gaussian strategies, which compute the smallest such number of users at
+  // build time. The probability of every outcome for a partition changes by at
+  // most tolerance. Since only the partitions a user contributes to differ
+  // between neighboring datasets, delta grows by at most
+  // (1 + e^epsilon) * max_partitions_contributed * tolerance. This extra delta
+  // is not included in the delta passed to SetDelta, so callers enabling the
+  // short-circuit have to account for it themselves. Defaults to 0, which
+  // disables the short-circuit.
+  PartitionSelectionStrategyBuilder& SetAlwaysKeepTolerance(double tolerance) {
+    always_keep_tolerance_ = tolerance;
+    return *this;
+  }
+
+  // Draws the randomness from random_source instead of SecureURBG. For the
+  // Laplace and Gaussian strategies, the source is also set on the mechanism
+  // builder. The source must outlive the built strategy, which is then only
+  // safe to use from one thread at a time (see RandomSource).
+  PartitionSelectionStrategyBuilder& SetRandomSource(
+      RandomSource* random_source) {
+    random_source_ = random_source;
+    return *this;
+  }
+
   virtual absl::StatusOr<std::unique_ptr<PartitionSelectionStrategy>>
   Build() = 0;
 
@@ -164,11 +206,26 @@ class PartitionSelectionStrategyBuilder {
     return max_partitions_contributed_;
   }
 
+  double GetAlwaysKeepTolerance() { return always_keep_tolerance_; }
+
+  RandomSource* GetRandomSource() { return random_source_; }
+
+  absl::Status ValidateAlwaysKeepTolerance() {
+    return ValidateIsInInterval(always_keep_tolerance_, 0, 0.5,
+                                /*include_lower=*/true,
+                                /*include_upper=*/false,
+                                "Always keep tolerance");
+  }
+
  private:
+  static constexpr double kDefaultAlwaysKeepTolerance = 0;
+
   std::optional<double> epsilon_;
   std::optional<double> delta_;
   std::optional<int> pre_threshold_;
   std::optional<int64_t> max_partitions_contributed_;
+  double always_keep_tolerance_ = kDefaultAlwaysKeepTolerance;
+  RandomSource* random_source_ = nullptr;
 };
 
 // NearTruncatedGeometricPartitionSelection implements magic partition selection
@@ -199,12 +256,15 @@ class NearTruncatedGeometricPartitionSelection
           CalculateAdjustedDelta(GetDelta().value(),
                                  GetMaxPartitionsContributed().value()));
 
-      std::unique_ptr<PartitionSelectionStrategy> magic_selection =
-          absl::WrapUnique(new NearTruncatedGeometricPartitionSelection(
-              GetEpsilon().value(), GetDelta().value(),
-              GetMaxPartitionsContributed().value(), adjusted_delta,
-              GetPreThreshold().value_or(1)));
-      return magic_selection;
+      std::unique_ptr<NearTruncatedGeometricPartitionSelection>
+          magic_selection =
+              absl::WrapUnique(new NearTruncatedGeometricPartitionSelection(
+                  GetEpsilon().value(), GetDelta().value(),
+                  GetMaxPartitionsContributed().value(), adjusted_delta,
+                  GetPreThreshold().value_or(1)));
+      magic_selection->random_source_ = GetRandomSource();
+      return std::unique_ptr<PartitionSelectionStrategy>(
+          std::move(magic_selection));
     }
   };
 
@@ -217,12 +277,51 @@ class NearTruncatedGeometricPartitionSelection
   double GetSecondCrossover() const { return crossover_2_; }
 
   bool ShouldKeep(double num_users) override {
+    ScopedRandomSource scoped_random_source(random_source_);
     // generate a random number between 0 and 1
     double rand_num = UniformDouble();
     // only keep partition if random number < expected probability of keep
     return (rand_num <= ProbabilityOfKeep(num_users));
   }
 
+  // Batched ShouldKeep. The keep probabilities of the counts between the
+  // pre-threshold and the second crossover are computed once per strategy and
+  // looked up, counts outside of that range are decided without randomness,
+  // and the uniform draws for the remaining counts are made in bulk.
+  void ShouldKeep(absl::Span<const int64_t> counts,
+                  std::vector<bool>* out) override {
+    absl::call_once(keep_probabilities_once_, [this] {
+      InitKeepProbabilities();
+    });
+    ScopedRandomSource scoped_random_source(random_source_);
+    out->assign(counts.size(), false);
+    constexpr size_t kBatchSize = 4096;
+    std::vector<size_t> indices;
+    std::vector<double> probabilities;
+    std::vector<double> uniforms;
+    auto decide_batch = [&]() {
+      uniforms.resize(indices.size());
+      FillUniformDoubles(absl::MakeSpan(uniforms));
+      for (size_t j = 0; j < indices.size(); ++j) {
+        if (uniforms[j] <= probabilities[j]) (*out)[indices[j]] = true;
+      }
+      indices.clear();
+      probabilities.clear();
+    };
+    for (size_t i = 0; i < counts.size(); ++i) {
+      const double probability = KeepProbabilityOfCount(counts[i]);
+      if (probability <= 0) continue;
+      if (probability >= 1) {
+        (*out)[i] = true;
+        continue;
+      }
+      indices.push_back(i);
+      probabilities.push_back(probability);
+      if (indices.size() == kBatchSize) decide_batch();
+    }
+    if (!indices.empty()) decide_batch();
+  }
+
   // ProbabilityOfKeep returns the probability with which a partition with
   // num_users
   // users should be kept, Thm. 1 of https://arxiv.org/pdf/2006.03684.pdf
@@ -277,9 +376,37 @@ class NearTruncatedGeometricPartitionSelection
                     (1 - ProbabilityOfKeep(crossover_1_))));
   }
 
+  // Upper bound on the number of keep probabilities computed up front. Small
+  // epsilons can move the second crossover to millions of users; counts
+  // beyond the table fall back to ProbabilityOfKeep.
+  static constexpr int64_t kMaxKeepProbabilityTableSize = 1 << 16;
+
+  void InitKeepProbabilities() {
+    const double num_counts = crossover_2_ - GetPreThreshold() + 1;
+    if (!(num_counts > 0)) return;
+    const int64_t table_size = static_cast<int64_t>(std::min(
+        num_counts, static_cast<double>(kMaxKeepProbabilityTableSize)));
+    keep_probabilities_.resize(table_size);
+    for (int64_t i = 0; i < table_size; ++i) {
+      keep_probabilities_[i] = ProbabilityOfKeep(GetPreThreshold() + i);
+    }
+  }
+
+  double KeepProbabilityOfCount(int64_t count) const {
+    const int64_t index = count - GetPreThreshold();
+    if (index < 0) return 0;
+    if (index < static_cast<int64_t>(keep_probabilities_.size())) {
+      return keep_probabilities_[index];
+    }
+    return ProbabilityOfKeep(count);
+  }
+
   double adjusted_epsilon_;
   double crossover_1_;
   double crossover_2_;
+  absl::once_flag keep_probabilities_once_;
+  std::vector<double> keep_probabilities_;
+  RandomSource* random_source_ = nullptr;
 };
 
 // PreaggPartitionSelection is the deprecated name for
@@ -308,10 +435,14 @@ class LaplacePartitionSelection : public PartitionSelectionStrategy {
       RETURN_IF_ERROR(
           ValidateMaxPartitionsContributed(GetMaxPartitionsContributed()));
       RETURN_IF_ERROR(ValidatePreThresholdOptional(GetPreThreshold()));
+      RETURN_IF_ERROR(ValidateAlwaysKeepTolerance());
 
       if (laplace_builder_ == nullptr) {
         laplace_builder_ = absl::make_unique<LaplaceMechanism::Builder>();
       }
+      if (GetRandomSource() != nullptr) {
+        laplace_builder_->SetRandomSource(GetRandomSource());
+      }
 
       double epsilon = GetEpsilon().value();
       double delta = GetDelta().value();
@@ -333,12 +464,13 @@ class LaplacePartitionSelection : public PartitionSelectionStrategy {
                            .SetL0Sensitivity(max_partitions_contributed)
                            .SetLInfSensitivity(1)
                            .Build());
-      std::unique_ptr<PartitionSelectionStrategy> laplace =
+      std::unique_ptr<LaplacePartitionSelection> laplace =
           absl::WrapUnique(new LaplacePartitionSelection(
               epsilon, delta, max_partitions_contributed, adjusted_delta,
               GetPreThreshold().value_or(1), threshold, std::move(mechanism_)));
+      laplace->SetAlwaysKeepNumUsers(GetAlwaysKeepTolerance());
 
-      return laplace;
+      return std::unique_ptr<PartitionSelectionStrategy>(std::move(laplace));
     }
 
    private:
@@ -347,10 +479,15 @@ class LaplacePartitionSelection : public PartitionSelectionStrategy {
 
   virtual ~LaplacePartitionSelection() = default;
 
+  using PartitionSelectionStrategy::ShouldKeep;
+
   bool ShouldKeep(double num_users) override {
     if (num_users < GetPreThreshold()) {
       return false;
     }
+    if (num_users >= always_keep_num_users_) {
+      return true;
+    }
     return mechanism_->NoisedValueAboveThreshold(num_users, threshold_);
   }
 
@@ -370,6 +507,10 @@ class LaplacePartitionSelection : public PartitionSelectionStrategy {
                                                               threshold_);
   }
 
+  // Returns the smallest number of users for which ShouldKeep keeps partitions
+  // without sampling, see SetAlwaysKeepTolerance. Infinite if disabled.
+  double GetAlwaysKeepNumUsers() const { return always_keep_num_users_; }
+
   static absl::StatusOr<double> CalculateDelta(
       double epsilon, double threshold, int64_t max_partitions_contributed) {
     RETURN_IF_ERROR(ValidateEpsilon(epsilon));
@@ -445,11 +586,24 @@ class LaplacePartitionSelection : public PartitionSelectionStrategy {
   }
 
  private:
+  // The probability of dropping a partition with n users is the Laplace CDF
+  // at threshold_ - n, which is at most tolerance from the returned number of
+  // users on.
+  void SetAlwaysKeepNumUsers(double tolerance) {
+    auto* laplace = dynamic_cast<LaplaceMechanism*>(mechanism_.get());
+    if (tolerance <= 0 || laplace == nullptr) return;
+    always_keep_num_users_ = std::ceil(
+        threshold_ -
+        internal::LaplaceDistribution::Quantile(laplace->GetDiversity(),
+                                                tolerance));
+  }
+
   int64_t l1_sensitivity_;
   double diversity_;
   // threshold_ includes the pre_threshold value as well.
   double threshold_;
   std::unique_ptr<NumericalMechanism> mechanism_;
+  double always_keep_num_users_ = std::numeric_limits<double>::infinity();
 };
 
 // GaussianPartitionSelection calculates a threshold based on the CDF of the
@@ -475,9 +629,13 @@ class GaussianPartitionSelection : public PartitionSelectionStrategy {
       RETURN_IF_ERROR(
           ValidateMaxPartitionsContributed(GetMaxPartitionsContributed()));
       RETURN_IF_ERROR(ValidatePreThresholdOptional(GetPreThreshold()));
+      RETURN_IF_ERROR(ValidateAlwaysKeepTolerance());
       if (gaussian_builder_ == nullptr) {
         gaussian_builder_ = absl::make_unique<GaussianMechanism::Builder>();
       }
+      if (GetRandomSource() != nullptr) {
+        gaussian_builder_->SetRandomSource(GetRandomSource());
+      }
 
       double epsilon = GetEpsilon().value();
       double delta = GetDelta().value();
@@ -503,13 +661,14 @@ class GaussianPartitionSelection : public PartitionSelectionStrategy {
           double adjusted_threshold_delta,
           CalculateAdjustedDelta(threshold_delta, max_partitions_contributed));
 
-      std::unique_ptr<PartitionSelectionStrategy> gaussian =
+      std::unique_ptr<GaussianPartitionSelection> gaussian =
           absl::WrapUnique(new GaussianPartitionSelection(
               epsilon, delta, threshold_delta, noise_delta,
               max_partitions_contributed, adjusted_threshold_delta,
               GetPreThreshold().value_or(1), threshold, std::move(mechanism_)));
+      gaussian->SetAlwaysKeepNumUsers(GetAlwaysKeepTolerance());
 
-      return gaussian;
+      return std::unique_ptr<PartitionSelectionStrategy>(std::move(gaussian));
     }
 
    private:
@@ -522,10 +681,15 @@ class GaussianPartitionSelection : public PartitionSelectionStrategy {
 
   double GetNoiseDelta() const { return noise_delta_; }
 
+  using PartitionSelectionStrategy::ShouldKeep;
+
   bool ShouldKeep(double num_users) override {
     if (num_users < GetPreThreshold()) {
       return false;
     }
+    if (num_users >= always_keep_num_users_) {
+      return true;
+    }
     return mechanism_->NoisedValueAboveThreshold(num_users, threshold_);
   }
 
@@ -545,6 +709,10 @@ class GaussianPartitionSelection : public PartitionSelectionStrategy {
                                                               threshold_);
   }
 
+  // Returns the smallest number of users for which ShouldKeep keeps partitions
+  // without sampling, see SetAlwaysKeepTolerance. Infinite if disabled.
+  double GetAlwaysKeepNumUsers() const { return always_keep_num_users_; }
+
   // CalculateThresholdDelta returns the threshold_delta for a threshold k. This
   // is the inverse of CalculateThreshold.
   static absl::StatusOr<double> CalculateThresholdDelta(
@@ -645,11 +813,21 @@ class GaussianPartitionSelection : public PartitionSelectionStrategy {
         mechanism_(std::move(gaussian)) {}
 
  private:
+  // Same as for LaplacePartitionSelection, with the Gaussian CDF.
+  void SetAlwaysKeepNumUsers(double tolerance) {
+    auto* gaussian = dynamic_cast<GaussianMechanism*>(mechanism_.get());
+    if (tolerance <= 0 || gaussian == nullptr) return;
+    always_keep_num_users_ = std::ceil(
+        threshold_ - internal::GaussianDistribution::Quantile(
+                         gaussian->CalculateStddev(), tolerance));
+  }
+
   double threshold_delta_;
   double noise_delta_;
   // threshold_ includes the pre_threshold value as well.
   double threshold_;
   std::unique_ptr<NumericalMechanism> mechanism_;
+  double always_keep_num_users_ = std::numeric_limits<double>::infinity();
 };
 
 // Prethresholds the user count before delegating the partition selection logic
@@ -764,6 +942,8 @@ class [[deprecated(
 
   double GetPreThreshold() const { return pre_threshold_; }
 
+  using PartitionSelectionStrategy::ShouldKeep;
+
   bool ShouldKeep(double num_users) override {
     double thresholded_num_users = num_users - (pre_threshold_ - 1);
     if (thresholded_num_users <= 0) return false;
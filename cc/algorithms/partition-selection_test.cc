@@ -17,6 +17,7 @@
 #include "algorithms/partition-selection.h"
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <optional>
 #include <utility>
@@ -28,8 +29,11 @@
 #include "absl/memory/memory.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
+#include "algorithms/distributions.h"
+#include "algorithms/insecure-rand.h"
 #include "algorithms/numerical-mechanisms.h"
 #include "algorithms/partition-selection-testing.h"
+#include "algorithms/rand.h"
 
 namespace differential_privacy {
 namespace {
@@ -1309,12 +1313,12 @@ TEST(PartitionSelectionTest, CalculateGaussianThresholdTests) {
     //             epsilon          delta  max_pc  threshold  tolerance
     //            --------  -------------  ------  ---------  ---------
     ThresholdTest(std::log(3.0),           0.0,      1,   kPosInf),
-    ThresholdTest(std::log(3.0), kDoubleMinPos,      1,   1278.4594),
-    ThresholdTest(std::log(3.0),        1e-308,      1,   1279.1838),
-    ThresholdTest(std::log(3.0),        1e-256,      1,   1061.4645),
-    ThresholdTest(std::log(3.0),        1e-128,      1,   526.3769),
+    ThresholdTest(std::log(3.0), kDoubleMinPos,      1,   1277.5913),
+    ThresholdTest(std::log(3.0),        1e-308,      1,   1279.0452),
+    ThresholdTest(std::log(3.0),        1e-256,      1,   1061.4093),
+    ThresholdTest(std::log(3.0),        1e-128,      1,   526.1286),
     ThresholdTest(std::log(3.0),         1e-64,      1,   259.1447),
-    ThresholdTest(std::log(3.0),         1e-32,      1,   126.3767),
+    ThresholdTest(std::log(3.0),         1e-32,      1,   126.2885),
     ThresholdTest(std::log(3.0),         1e-16,      1,   60.5608),
     ThresholdTest(std::log(3.0),          1e-8,      1,   28.3774),
     ThresholdTest(std::log(3.0),          1e-4,      1,   13.0061),
@@ -1350,14 +1354,14 @@ TEST(PartitionSelectionTest, CalculateGaussianThresholdTests) {
     //                                                    expected  test
     //                  epsilon          delta  max_pc   threshold  tolerance
     //            -------------  -------------  ------  ----------  -----------
-    ThresholdTest(kDoubleMinPos, 2.0894334e-14,     1,    2.90787e+14, 1e+09),
-    ThresholdTest(      1e-308, 2.0894334e-14,      1,    2.90787e+14, 1e+09),
-    ThresholdTest(      1e-100, 2.0894334e-14,      1,    2.90787e+14, 1e+09),
-    ThresholdTest(       1e-50, 2.0894334e-14,      1,    2.90787e+14, 1e+09),
-    ThresholdTest(       1e-20, 2.0894334e-14,      1,    2.91837e+14, 1e+09),
-    ThresholdTest(       1e-10, 2.0894334e-14,      1,    2.33308e+11, 1e+06),
-    ThresholdTest(         1e-5, 2.0894334e-14,      1,    4.13343e+06, 10),
-    ThresholdTest(         1e-2, 2.0894334e-14,      1,    4958.78),
+    ThresholdTest(kDoubleMinPos, 2.0894334e-14,     1,    2.90700e+14, 1e+09),
+    ThresholdTest(      1e-308, 2.0894334e-14,      1,    2.90700e+14, 1e+09),
+    ThresholdTest(      1e-100, 2.0894334e-14,      1,    2.90700e+14, 1e+09),
+    ThresholdTest(       1e-50, 2.0894334e-14,      1,    2.90700e+14, 1e+09),
+    ThresholdTest(       1e-20, 2.0894334e-14,      1,    2.91372e+14, 1e+09),
+    ThresholdTest(       1e-10, 2.0894334e-14,      1,    2.33250e+11, 1e+06),
+    ThresholdTest(         1e-5, 2.0894334e-14,      1,    4.13201e+06, 10),
+    ThresholdTest(         1e-2, 2.0894334e-14,      1,    4955.59),
     ThresholdTest(         1e-1, 2.0894334e-14,      1,    521.815),
     ThresholdTest(          0.5, 2.0894334e-14,      1,    108.925),
     ThresholdTest(          1.0, 2.0894334e-14,      1,    55.9185),
@@ -1384,13 +1388,13 @@ TEST(PartitionSelectionTest, CalculateGaussianThresholdTests) {
     ThresholdTest(std::log(3.0), 2.0894334e-14,         3,    89.4375),
     ThresholdTest(std::log(3.0), 2.0894334e-14,         4,    103.5948),
     ThresholdTest(std::log(3.0), 2.0894334e-14,         5,    116.1157),
-    ThresholdTest(std::log(3.0), 2.0894334e-14,        10,    165.5916),
-    ThresholdTest(std::log(3.0), 2.0894334e-14,       100,   539.9088),
-    ThresholdTest(std::log(3.0), 2.0894334e-14,      1000,  1761.5664),
-    ThresholdTest(std::log(3.0), 2.0894334e-14,     10000,  5741.3149),
-    ThresholdTest(std::log(3.0), 2.0894334e-14,    100000,  18684.6603),
-    ThresholdTest(std::log(3.0), 2.0894334e-14,   1000000,  60718.2913),
-    ThresholdTest(std::log(3.0), 2.0894334e-14, kInt64Max,  239762230815.2955),
+    ThresholdTest(std::log(3.0), 2.0894334e-14,        10,    165.5218),
+    ThresholdTest(std::log(3.0), 2.0894334e-14,       100,   539.6800),
+    ThresholdTest(std::log(3.0), 2.0894334e-14,      1000,  1760.8187),
+    ThresholdTest(std::log(3.0), 2.0894334e-14,     10000,  5738.8769),
+    ThresholdTest(std::log(3.0), 2.0894334e-14,    100000,  18676.7249),
+    ThresholdTest(std::log(3.0), 2.0894334e-14,   1000000,  60692.5030),
+    ThresholdTest(std::log(3.0), 2.0894334e-14, kInt64Max,  239660396821.4832),
 
     // Error cases.
     //
@@ -2600,7 +2604,7 @@ TEST(PartitionSelectionPreThresholdParameterBuildTest,
      TestGaussianPreThresholdProbabilityOfKeep) {
   GaussianPartitionSelection::Builder test_builder;
   const int kPreThreshold = 10, kNumUsers = 9;
-  const double kExpProbabilityOfKeep = 0.584958494;
+  const double kExpProbabilityOfKeep = 0.585438277;
   auto built_strategy = test_builder.SetEpsilon(0.5)
                             .SetDelta(0.02)
                             .SetMaxPartitionsContributed(1)
@@ -2665,7 +2669,7 @@ TEST(PartitionSelectionPreThresholdParameterBuildTest,
      TestGaussianPreThresholdShouldKeep) {
   GaussianPartitionSelection::Builder test_builder;
   const int kPreThreshold = 10, kNumUsers = 9;
-  const double kExpProbabilityOfKeep = 0.584958494;
+  const double kExpProbabilityOfKeep = 0.585438277;
   auto built_strategy = test_builder.SetEpsilon(0.5)
                             .SetDelta(0.02)
                             .SetMaxPartitionsContributed(1)
@@ -2732,5 +2736,238 @@ TEST(PartitionSelectionPreThresholdParameterBuildTest,
               kExpNoiseWithoutPrethreshold + kPreThreshold - 1, 0.2);
 }
 
+TEST(PartitionSelectionTest,
+     NearTruncatedGeometricPartitionSelectionBatchedShouldKeep) {
+  NearTruncatedGeometricPartitionSelection::Builder test_builder;
+  auto built_strategy = test_builder.SetEpsilon(0.5)
+                            .SetDelta(0.02)
+                            .SetMaxPartitionsContributed(1)
+                            .SetPreThreshold(2)
+                            .Build();
+  ASSERT_OK(built_strategy);
+  auto strategy = std::move(built_strategy.value());
+  const std::vector<int64_t> counts_per_sample = {-1, 0, 1, 2, 3, 4, 1000};
+
+  std::vector<int64_t> counts;
+  for (int i = 0; i < kTinyNumSamples * 10; ++i) {
+    counts.insert(counts.end(), counts_per_sample.begin(),
+                  counts_per_sample.end());
+  }
+  std::vector<bool> keep;
+  strategy->ShouldKeep(counts, &keep);
+  ASSERT_EQ(keep.size(), counts.size());
+
+  for (int j = 0; j < counts_per_sample.size(); ++j) {
+    int num_kept = 0;
+    for (int i = j; i < counts.size(); i += counts_per_sample.size()) {
+      if (keep[i]) ++num_kept;
+    }
+    EXPECT_THAT(static_cast<double>(num_kept) / (kTinyNumSamples * 10),
+                DoubleNear(strategy->ProbabilityOfKeep(counts_per_sample[j]),
+                           0.01))
+        << "count " << counts_per_sample[j];
+  }
+}
+
+// With a small epsilon the second crossover is beyond the precomputed keep
+// probabilities, which must not change the probability of keeping.
+TEST(PartitionSelectionTest,
+     NearTruncatedGeometricPartitionSelectionBatchedShouldKeepLargeCounts) {
+  NearTruncatedGeometricPartitionSelection::Builder test_builder;
+  auto built_strategy = test_builder.SetEpsilon(1e-5)
+                            .SetDelta(1e-10)
+                            .SetMaxPartitionsContributed(1)
+                            .Build();
+  ASSERT_OK(built_strategy);
+  auto* strategy = dynamic_cast<NearTruncatedGeometricPartitionSelection*>(
+      built_strategy.value().get());
+  ASSERT_THAT(strategy, testing::NotNull());
+  const int64_t count = strategy->GetFirstCrossover() + 50000;
+  ASSERT_GT(count, 1 << 16);
+  const double probability = strategy->ProbabilityOfKeep(count);
+  ASSERT_GT(probability, 0.1);
+  ASSERT_LT(probability, 0.9);
+
+  std::vector<bool> keep;
+  strategy->ShouldKeep(std::vector<int64_t>(kSmallNumSamples, count), &keep);
+  int num_kept = 0;
+  for (bool kept : keep) {
+    if (kept) ++num_kept;
+  }
+  EXPECT_THAT(static_cast<double>(num_kept) / kSmallNumSamples,
+              DoubleNear(probability, 0.005));
+}
+
+TEST(PartitionSelectionTest, LaplacePartitionSelectionBatchedShouldKeep) {
+  LaplacePartitionSelection::Builder test_builder;
+  auto built_strategy = test_builder.SetEpsilon(0.5)
+                            .SetDelta(0.02)
+                            .SetMaxPartitionsContributed(1)
+                            .Build();
+  ASSERT_OK(built_strategy);
+  auto strategy = std::move(built_strategy.value());
+  const int64_t count = std::round(
+      dynamic_cast<LaplacePartitionSelection*>(strategy.get())
+          ->GetThreshold());
+
+  std::vector<bool> keep;
+  strategy->ShouldKeep(std::vector<int64_t>(kTinyNumSamples * 10, count),
+                       &keep);
+  ASSERT_EQ(keep.size(), kTinyNumSamples * 10);
+  int num_kept = 0;
+  for (bool kept : keep) {
+    if (kept) ++num_kept;
+  }
+  EXPECT_THAT(static_cast<double>(num_kept) / (kTinyNumSamples * 10),
+              DoubleNear(strategy->ProbabilityOfKeep(count), 0.01));
+
+  strategy->ShouldKeep({}, &keep);
+  EXPECT_TRUE(keep.empty());
+}
+
+TEST(PartitionSelectionTest, LaplacePartitionSelectionAlwaysKeepNumUsers) {
+  LaplacePartitionSelection::Builder test_builder;
+  test_builder.SetAlwaysKeepTolerance(1e-20)
+      .SetEpsilon(0.5)
+      .SetDelta(1e-5)
+      .SetMaxPartitionsContributed(3)
+      .SetPreThreshold(5);
+  auto built_strategy = test_builder.Build();
+  ASSERT_OK(built_strategy);
+  auto* laplace_ps =
+      dynamic_cast<LaplacePartitionSelection*>(built_strategy.value().get());
+  ASSERT_THAT(laplace_ps, testing::NotNull());
+
+  const double always_keep_num_users = laplace_ps->GetAlwaysKeepNumUsers();
+  const double threshold = laplace_ps->GetThreshold();
+  const double diversity = laplace_ps->GetDiversity();
+  EXPECT_LE(internal::LaplaceDistribution::cdf(
+                diversity, threshold - always_keep_num_users),
+            1e-20);
+  EXPECT_GT(internal::LaplaceDistribution::cdf(
+                diversity, threshold - (always_keep_num_users - 1)),
+            1e-20);
+  EXPECT_TRUE(laplace_ps->ShouldKeep(always_keep_num_users));
+}
+
+TEST(PartitionSelectionTest, GaussianPartitionSelectionAlwaysKeepNumUsers) {
+  GaussianPartitionSelection::Builder test_builder;
+  test_builder.SetAlwaysKeepTolerance(1e-20)
+      .SetEpsilon(0.5)
+      .SetDelta(1e-5)
+      .SetMaxPartitionsContributed(3);
+  auto built_strategy = test_builder.Build();
+  ASSERT_OK(built_strategy);
+  auto* gaussian_ps =
+      dynamic_cast<GaussianPartitionSelection*>(built_strategy.value().get());
+  ASSERT_THAT(gaussian_ps, testing::NotNull());
+
+  const double always_keep_num_users = gaussian_ps->GetAlwaysKeepNumUsers();
+  const double threshold = gaussian_ps->GetThreshold();
+  const double stddev = GaussianMechanism::CalculateStddev(
+      0.5, gaussian_ps->GetNoiseDelta(), std::sqrt(3));
+  EXPECT_LE(internal::GaussianDistribution::cdf(
+                stddev, threshold - always_keep_num_users),
+            1e-20);
+  EXPECT_GT(internal::GaussianDistribution::cdf(
+                stddev, threshold - (always_keep_num_users - 1)),
+            1e-20);
+  EXPECT_TRUE(gaussian_ps->ShouldKeep(always_keep_num_users));
+}
+
+TEST(PartitionSelectionTest, AlwaysKeepToleranceZeroDisablesShortCircuit) {
+  LaplacePartitionSelection::Builder laplace_builder;
+  laplace_builder.SetAlwaysKeepTolerance(0)
+      .SetEpsilon(0.5)
+      .SetDelta(0.02)
+      .SetMaxPartitionsContributed(1);
+  auto laplace = laplace_builder.Build();
+  ASSERT_OK(laplace);
+  EXPECT_EQ(dynamic_cast<LaplacePartitionSelection*>(laplace.value().get())
+                ->GetAlwaysKeepNumUsers(),
+            kPosInf);
+
+  GaussianPartitionSelection::Builder gaussian_builder;
+  gaussian_builder.SetAlwaysKeepTolerance(0)
+      .SetEpsilon(0.5)
+      .SetDelta(0.02)
+      .SetMaxPartitionsContributed(1);
+  auto gaussian = gaussian_builder.Build();
+  ASSERT_OK(gaussian);
+  EXPECT_EQ(dynamic_cast<GaussianPartitionSelection*>(gaussian.value().get())
+                ->GetAlwaysKeepNumUsers(),
+            kPosInf);
+}
+
+TEST(PartitionSelectionTest, AlwaysKeepShortCircuitIsDisabledByDefault) {
+  LaplacePartitionSelection::Builder laplace_builder;
+  laplace_builder.SetEpsilon(0.5).SetDelta(1e-5).SetMaxPartitionsContributed(
+      1);
+  auto laplace = laplace_builder.Build();
+  ASSERT_OK(laplace);
+  EXPECT_EQ(dynamic_cast<LaplacePartitionSelection*>(laplace.value().get())
+                ->GetAlwaysKeepNumUsers(),
+            kPosInf);
+
+  GaussianPartitionSelection::Builder gaussian_builder;
+  gaussian_builder.SetEpsilon(0.5).SetDelta(1e-5).SetMaxPartitionsContributed(
+      1);
+  auto gaussian = gaussian_builder.Build();
+  ASSERT_OK(gaussian);
+  EXPECT_EQ(dynamic_cast<GaussianPartitionSelection*>(gaussian.value().get())
+                ->GetAlwaysKeepNumUsers(),
+            kPosInf);
+}
+
+TEST(PartitionSelectionTest, InvalidAlwaysKeepTolerance) {
+  for (double tolerance : {-1e-10, 0.5, kNaN}) {
+    LaplacePartitionSelection::Builder laplace_builder;
+    laplace_builder.SetAlwaysKeepTolerance(tolerance)
+        .SetEpsilon(0.5)
+        .SetDelta(0.02)
+        .SetMaxPartitionsContributed(1);
+    EXPECT_THAT(laplace_builder.Build(),
+                StatusIs(absl::StatusCode::kInvalidArgument,
+                         HasSubstr("Always keep tolerance")));
+
+    GaussianPartitionSelection::Builder gaussian_builder;
+    gaussian_builder.SetAlwaysKeepTolerance(tolerance)
+        .SetEpsilon(0.5)
+        .SetDelta(0.02)
+        .SetMaxPartitionsContributed(1);
+    EXPECT_THAT(gaussian_builder.Build(),
+                StatusIs(absl::StatusCode::kInvalidArgument,
+                         HasSubstr("Always keep tolerance")));
+  }
+}
+
+TEST(PartitionSelectionTest, RandomSourceMakesDecisionsReproducible) {
+  auto decisions = [](PartitionSelectionStrategyBuilder& builder,
+                      uint64_t seed) {
+    InsecureRandomSource source(seed);
+    std::unique_ptr<PartitionSelectionStrategy> strategy =
+        builder.SetEpsilon(0.5)
+            .SetDelta(0.01)
+            .SetMaxPartitionsContributed(1)
+            .SetRandomSource(&source)
+            .Build()
+            .value();
+    std::vector<bool> kept;
+    for (int i = 0; i < 200; ++i) {
+      kept.push_back(strategy->ShouldKeep(4));
+    }
+    return kept;
+  };
+  NearTruncatedGeometricPartitionSelection::Builder near_truncated;
+  LaplacePartitionSelection::Builder laplace;
+  GaussianPartitionSelection::Builder gaussian;
+  for (PartitionSelectionStrategyBuilder* builder :
+       std::vector<PartitionSelectionStrategyBuilder*>{&near_truncated,
+                                                       &laplace, &gaussian}) {
+    EXPECT_EQ(decisions(*builder, 23), decisions(*builder, 23));
+    EXPECT_NE(decisions(*builder, 23), decisions(*builder, 24));
+  }
+}
+
 }  // namespace
 }  // namespace differential_privacy
@@ -0,0 +1,139 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_POISSON_SAMPLER_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_POISSON_SAMPLER_H_
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/rand.h"
+
+namespace differential_privacy {
+
+// Poisson subsampling: every row of a stream is included independently with
+// the sampling probability, e.g., to aggregate only a fraction of a huge
+// source. Instead of one coin per row, the sampler draws the number of rows
+// to skip until the next included one, which is geometric, using uniform
+// doubles drawn in blocks. So the cost is proportional to the number of
+// included rows rather than to the number of all rows.
+//
+// Subsampling amplifies privacy if every row is the data of a different
+// privacy unit, or if the sampler is applied to privacy units: see
+// accounting::AmplifyBySubsampling for the parameters of an aggregation of
+// the sample.
+//
+// PoissonSampler is not thread safe.
+class PoissonSampler {
+ public:
+  // Returns a sampler that includes every row with the given probability in
+  // (0, 1].
+  static absl::StatusOr<std::unique_ptr<PoissonSampler>> Create(
+      double sampling_probability) {
+    if (!(sampling_probability > 0 && sampling_probability <= 1)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Sampling probability must be in (0, 1], but is ",
+                       sampling_probability, "."));
+    }
+    return absl::WrapUnique(new PoissonSampler(sampling_probability));
+  }
+
+  PoissonSampler(const PoissonSampler&) = delete;
+  PoissonSampler& operator=(const PoissonSampler&) = delete;
+
+  // Returns whether the next row is included.
+  bool Sample() {
+    if (skip_ > 0) {
+      --skip_;
+      return false;
+    }
+    skip_ = NextSkip();
+    return true;
+  }
+
+  // Appends the indices of the included rows among the next num_rows rows to
+  // indices, in increasing order. Equivalent to calling Sample num_rows times.
+  void SampleIndices(int64_t num_rows, std::vector<int64_t>* indices) {
+    int64_t index = skip_;
+    while (index < num_rows) {
+      indices->push_back(index);
+      index += 1 + NextSkip();
+    }
+    skip_ = index - num_rows;
+  }
+
+  // Adds the included entries of the next values.size() rows to the
+  // algorithm.
+  template <typename T>
+  void AddSampledEntries(absl::Span<const T> values, Algorithm<T>& algorithm) {
+    const int64_t num_rows = values.size();
+    int64_t index = skip_;
+    while (index < num_rows) {
+      algorithm.AddEntry(values[index]);
+      index += 1 + NextSkip();
+    }
+    skip_ = index - num_rows;
+  }
+
+  double sampling_probability() const { return sampling_probability_; }
+
+ private:
+  explicit PoissonSampler(double sampling_probability)
+      : sampling_probability_(sampling_probability),
+        log_exclusion_probability_(std::log1p(-sampling_probability)) {
+    skip_ = NextSkip();
+  }
+
+  // Returns the number of excluded rows before the next included one, which
+  // is floor(log(U) / log(1 - p)) for U uniform in (0, 1].
+  int64_t NextSkip() {
+    if (sampling_probability_ == 1) {
+      return 0;
+    }
+    if (next_uniform_ == kNumUniforms) {
+      FillUniformDoubles(absl::MakeSpan(uniforms_));
+      next_uniform_ = 0;
+    }
+    const double skip =
+        std::floor(std::log1p(-uniforms_[next_uniform_++]) /
+                   log_exclusion_probability_);
+    // Saturates skips beyond any row count so that indices do not overflow.
+    return skip < kMaxSkip ? static_cast<int64_t>(skip) : kMaxSkip;
+  }
+
+  static constexpr int kNumUniforms = 256;
+  static constexpr int64_t kMaxSkip = int64_t{1} << 61;
+
+  const double sampling_probability_;
+  const double log_exclusion_probability_;
+  // Number of rows to exclude before the next included one.
+  int64_t skip_ = 0;
+  std::array<double, kNumUniforms> uniforms_;
+  int next_uniform_ = kNumUniforms;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_POISSON_SAMPLER_H_
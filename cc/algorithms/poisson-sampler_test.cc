@@ -0,0 +1,124 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/poisson-sampler.h"
+
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "algorithms/count.h"
+#include "proto/util.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+
+TEST(PoissonSamplerTest, SamplesWithProbability) {
+  std::unique_ptr<PoissonSampler> sampler = PoissonSampler::Create(0.1).value();
+  const int num_rows = 1000000;
+  std::vector<int64_t> indices;
+  sampler->SampleIndices(num_rows, &indices);
+
+  // About 5 standard deviations.
+  EXPECT_NEAR(indices.size(), 100000, 1500);
+  EXPECT_TRUE(std::is_sorted(indices.begin(), indices.end()));
+  EXPECT_GE(indices.front(), 0);
+  EXPECT_LT(indices.back(), num_rows);
+}
+
+TEST(PoissonSamplerTest, GapsAreGeometric) {
+  std::unique_ptr<PoissonSampler> sampler =
+      PoissonSampler::Create(0.25).value();
+  std::vector<int64_t> indices;
+  sampler->SampleIndices(4000000, &indices);
+  // The fraction of consecutive included rows is the sampling probability,
+  // and the one of gaps of a single row is 0.25 * 0.75.
+  int num_adjacent = 0;
+  int num_single_gaps = 0;
+  for (size_t i = 1; i < indices.size(); ++i) {
+    num_adjacent += indices[i] - indices[i - 1] == 1;
+    num_single_gaps += indices[i] - indices[i - 1] == 2;
+  }
+  EXPECT_NEAR(static_cast<double>(num_adjacent) / indices.size(), 0.25, 0.005);
+  EXPECT_NEAR(static_cast<double>(num_single_gaps) / indices.size(), 0.1875,
+              0.005);
+}
+
+TEST(PoissonSamplerTest, SampleIndicesContinuesAcrossCalls) {
+  std::unique_ptr<PoissonSampler> sampler = PoissonSampler::Create(0.5).value();
+  int64_t num_included = 0;
+  for (int i = 0; i < 10000; ++i) {
+    std::vector<int64_t> indices;
+    sampler->SampleIndices(3, &indices);
+    for (int64_t index : indices) {
+      EXPECT_LT(index, 3);
+    }
+    num_included += indices.size();
+  }
+  for (int i = 0; i < 30000; ++i) {
+    num_included += sampler->Sample();
+  }
+  EXPECT_NEAR(num_included, 30000, 600);
+}
+
+TEST(PoissonSamplerTest, SamplesEverythingWithProbabilityOne) {
+  std::unique_ptr<PoissonSampler> sampler = PoissonSampler::Create(1).value();
+  std::vector<int64_t> indices;
+  sampler->SampleIndices(5, &indices);
+  EXPECT_EQ(indices, std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_TRUE(sampler->Sample());
+}
+
+TEST(PoissonSamplerTest, AddsSampledEntries) {
+  std::unique_ptr<PoissonSampler> sampler = PoissonSampler::Create(1).value();
+  std::unique_ptr<Count<int>> count =
+      Count<int>::Builder().SetEpsilon(1e10).Build().value();
+  const std::vector<int> values(100, 1);
+  sampler->AddSampledEntries(absl::MakeConstSpan(values), *count);
+
+  absl::StatusOr<Output> result = count->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_NEAR(GetValue<int64_t>(*result), 100, 1);
+}
+
+TEST(PoissonSamplerTest, HandlesTinyProbabilities) {
+  std::unique_ptr<PoissonSampler> sampler =
+      PoissonSampler::Create(1e-300).value();
+  std::vector<int64_t> indices;
+  sampler->SampleIndices(int64_t{1} << 60, &indices);
+  EXPECT_TRUE(indices.empty());
+}
+
+TEST(PoissonSamplerTest, RejectsInvalidProbabilities) {
+  EXPECT_THAT(PoissonSampler::Create(0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PoissonSampler::Create(1.5),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PoissonSampler::Create(std::nan("")),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,176 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/pooled-mechanism.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/util.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+absl::StatusOr<std::unique_ptr<PooledMechanism>> PooledMechanism::Create(
+    std::unique_ptr<NumericalMechanism> mechanism, int capacity) {
+  if (mechanism == nullptr) {
+    return absl::InvalidArgumentError(
+        "PooledMechanism requires a mechanism to wrap.");
+  }
+  RETURN_IF_ERROR(ValidateIsPositive(capacity, "Capacity"));
+  if (!mechanism->RoundDoubleForNoise(0).has_value() ||
+      !mechanism->RoundInt64ForNoise(0).has_value()) {
+    return absl::InvalidArgumentError(
+        "The noise of the wrapped mechanism cannot be drawn ahead of time.");
+  }
+  return absl::WrapUnique(new PooledMechanism(std::move(mechanism), capacity));
+}
+
+PooledMechanism::PooledMechanism(std::unique_ptr<NumericalMechanism> mechanism,
+                                 int capacity)
+    : NumericalMechanism(mechanism->GetEpsilon()),
+      mechanism_(std::move(mechanism)),
+      double_noise_(capacity),
+      int64_noise_(capacity) {
+  thread_ = std::thread(&PooledMechanism::Run, this);
+}
+
+PooledMechanism::~PooledMechanism() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopping_.store(true, std::memory_order_relaxed);
+  }
+  thread_.join();
+}
+
+void PooledMechanism::WaitUntilFull() {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &PooledMechanism::IsFull));
+}
+
+void PooledMechanism::Run() {
+  while (!stopping_.load(std::memory_order_relaxed)) {
+    // This is the only thread that pushes, so a ring that is not full has room
+    // for the sample and no drawn noise is discarded.
+    while (double_noise_.size() < double_noise_.capacity() &&
+           !stopping_.load(std::memory_order_relaxed)) {
+      double_noise_.TryPush(mechanism_->AddNoise(0.0));
+    }
+    while (int64_noise_.size() < int64_noise_.capacity() &&
+           !stopping_.load(std::memory_order_relaxed)) {
+      int64_noise_.TryPush(mechanism_->AddNoise(int64_t{0}));
+    }
+
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(this, &PooledMechanism::HasWork));
+    refill_requested_.store(false, std::memory_order_relaxed);
+  }
+}
+
+void PooledMechanism::RequestRefill() {
+  if (refill_requested_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  refill_requested_.store(true, std::memory_order_relaxed);
+}
+
+double PooledMechanism::AddDoubleNoise(double result) {
+  double noise;
+  if (!double_noise_.TryPop(noise)) {
+    RequestRefill();
+    return mechanism_->AddNoise(result);
+  }
+  MaybeRequestRefill(double_noise_);
+  return mechanism_->RoundDoubleForNoise(result).value() + noise;
+}
+
+int64_t PooledMechanism::AddInt64Noise(int64_t result) {
+  int64_t noise;
+  if (!int64_noise_.TryPop(noise)) {
+    RequestRefill();
+    return mechanism_->AddNoise(result);
+  }
+  MaybeRequestRefill(int64_noise_);
+  return SafeAdd(mechanism_->RoundInt64ForNoise(result).value(), noise).value;
+}
+
+void PooledMechanism::AddDoubleNoiseBatch(absl::Span<const double> results,
+                                          absl::Span<double> noised_results) {
+  for (size_t i = 0; i < results.size(); ++i) {
+    double noise;
+    if (!double_noise_.TryPop(noise)) {
+      // Sizes have already been checked by NumericalMechanism::AddNoise.
+      RequestRefill();
+      mechanism_
+          ->AddNoise(results.subspan(i), noised_results.subspan(i))
+          .IgnoreError();
+      return;
+    }
+    noised_results[i] =
+        mechanism_->RoundDoubleForNoise(results[i]).value() + noise;
+  }
+  MaybeRequestRefill(double_noise_);
+}
+
+void PooledMechanism::AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                                         absl::Span<int64_t> noised_results) {
+  for (size_t i = 0; i < results.size(); ++i) {
+    int64_t noise;
+    if (!int64_noise_.TryPop(noise)) {
+      RequestRefill();
+      mechanism_
+          ->AddNoise(results.subspan(i), noised_results.subspan(i))
+          .IgnoreError();
+      return;
+    }
+    noised_results[i] =
+        SafeAdd(mechanism_->RoundInt64ForNoise(results[i]).value(), noise)
+            .value;
+  }
+  MaybeRequestRefill(int64_noise_);
+}
+
+absl::StatusOr<std::unique_ptr<NumericalMechanism>>
+PooledMechanismBuilder::Build() {
+  if (mechanism_builder_ == nullptr) {
+    return absl::InvalidArgumentError(
+        "PooledMechanismBuilder requires a mechanism builder to wrap.");
+  }
+  if (GetRandomSource() != nullptr) {
+    return absl::InvalidArgumentError(
+        "PooledMechanismBuilder draws noise on a background thread and cannot "
+        "use a RandomSource, which is not thread safe.");
+  }
+  std::unique_ptr<NumericalMechanismBuilder> builder =
+      mechanism_builder_->Clone();
+  CopyParametersTo(*builder);
+  ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mechanism,
+                   builder->Build());
+  ASSIGN_OR_RETURN(std::unique_ptr<PooledMechanism> pooled,
+                   PooledMechanism::Create(std::move(mechanism), capacity_));
+  return std::unique_ptr<NumericalMechanism>(std::move(pooled));
+}
+
+}  // namespace differential_privacy
@@ -0,0 +1,206 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_POOLED_MECHANISM_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_POOLED_MECHANISM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/memory/memory.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "algorithms/internal/lock-free-ring.h"
+#include "algorithms/numerical-mechanisms.h"
+
+namespace differential_privacy {
+
+// Adds the noise of a wrapped mechanism, but draws the noise ahead of time on
+// a background thread. The samples are kept in lock-free rings (one for double
+// and one for int64 noise) of the given capacity, so adding noise on the
+// calling thread only pops a sample and adds it to the rounded result. Every
+// sample is used exactly once. When a ring is empty, the noise is drawn on the
+// calling thread as without the pool. The background thread refills a ring
+// once it is half empty and sleeps otherwise.
+//
+// The result of AddNoise has the same distribution as with the wrapped
+// mechanism. Only mechanisms that can round results separately from drawing
+// the noise (see NumericalMechanism::RoundDoubleForNoise) can be pooled; the
+// Laplace, Gaussian, discrete Laplace and discrete Gaussian mechanisms can.
+//
+// The wrapped mechanism is used from the background thread and the calling
+// threads at the same time, so it must not draw from a RandomSource (which is
+// not thread safe). Several threads may add noise concurrently; the pool is
+// meant for a mechanism that serves many requests, e.g. one built through a
+// SharedMechanismBuilder that wraps a PooledMechanismBuilder.
+class PooledMechanism : public NumericalMechanism {
+ public:
+  static constexpr int kDefaultCapacity = 1024;
+
+  // Starts the background thread. Fails if the noise of mechanism cannot be
+  // drawn ahead of time.
+  static absl::StatusOr<std::unique_ptr<PooledMechanism>> Create(
+      std::unique_ptr<NumericalMechanism> mechanism,
+      int capacity = kDefaultCapacity);
+
+  // Stops the background thread.
+  ~PooledMechanism() override;
+
+  using NumericalMechanism::AddNoise;
+
+  bool NoisedValueAboveThreshold(double result, double threshold) override {
+    return mechanism_->NoisedValueAboveThreshold(result, threshold);
+  }
+
+  double ProbabilityOfNoisedValueAboveThreshold(double result,
+                                                double threshold) override {
+    return mechanism_->ProbabilityOfNoisedValueAboveThreshold(result,
+                                                              threshold);
+  }
+
+  int64_t MemoryUsed() override {
+    return sizeof(PooledMechanism) + mechanism_->MemoryUsed() +
+           double_noise_.MemoryUsed() + int64_noise_.MemoryUsed();
+  }
+
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level, double noised_result) override {
+    return mechanism_->NoiseConfidenceInterval(confidence_level,
+                                               noised_result);
+  }
+
+  absl::StatusOr<ConfidenceInterval> NoiseConfidenceInterval(
+      double confidence_level) override {
+    return mechanism_->NoiseConfidenceInterval(confidence_level);
+  }
+
+  NoiseConfidenceIntervalResult UncheckedNoiseConfidenceInterval(
+      double confidence_level, double noised_result) const override {
+    return mechanism_->UncheckedNoiseConfidenceInterval(confidence_level,
+                                                        noised_result);
+  }
+
+  std::optional<double> RoundDoubleForNoise(double result) override {
+    return mechanism_->RoundDoubleForNoise(result);
+  }
+
+  std::optional<int64_t> RoundInt64ForNoise(int64_t result) override {
+    return mechanism_->RoundInt64ForNoise(result);
+  }
+
+  double GetVariance() const override { return mechanism_->GetVariance(); }
+
+  double Cdf(double x) const override { return mechanism_->Cdf(x); }
+
+  double Quantile(double p) const override { return mechanism_->Quantile(p); }
+
+  // Returns the number of samples that are ready to be used. Only approximate
+  // while noise is being added or drawn.
+  int NumPooledDoubleSamples() const { return double_noise_.size(); }
+  int NumPooledInt64Samples() const { return int64_noise_.size(); }
+
+  // Blocks until both rings are full, e.g., to warm up the pool before serving
+  // requests. Must not be called while other threads add noise.
+  void WaitUntilFull();
+
+ protected:
+  double AddDoubleNoise(double result) override;
+
+  int64_t AddInt64Noise(int64_t result) override;
+
+  void AddDoubleNoiseBatch(absl::Span<const double> results,
+                           absl::Span<double> noised_results) override;
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override;
+
+ private:
+  PooledMechanism(std::unique_ptr<NumericalMechanism> mechanism, int capacity);
+
+  // Draws noise until both rings are full, then waits for a refill request.
+  void Run();
+
+  // Wakes up the background thread unless it has already been asked to
+  // refill.
+  void RequestRefill();
+
+  // Requests a refill if ring is at most half full.
+  template <typename T>
+  void MaybeRequestRefill(const internal::LockFreeRing<T>& ring) {
+    if (ring.size() <= ring.capacity() / 2) {
+      RequestRefill();
+    }
+  }
+
+  bool HasWork() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return stopping_.load(std::memory_order_relaxed) ||
+           refill_requested_.load(std::memory_order_relaxed);
+  }
+
+  bool IsFull() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return stopping_.load(std::memory_order_relaxed) ||
+           (double_noise_.size() == double_noise_.capacity() &&
+            int64_noise_.size() == int64_noise_.capacity());
+  }
+
+  const std::unique_ptr<NumericalMechanism> mechanism_;
+  internal::LockFreeRing<double> double_noise_;
+  internal::LockFreeRing<int64_t> int64_noise_;
+
+  absl::Mutex mutex_;
+  // Both flags are only set with mutex_ held, so that the conditions waited for
+  // notice them, but are read without it: stopping_ while drawing noise and
+  // refill_requested_ on the hot path, so that only the first of many callers
+  // that find a ring half empty takes the lock.
+  std::atomic<bool> stopping_{false};
+  std::atomic<bool> refill_requested_{false};
+  std::thread thread_;
+};
+
+// Builds a PooledMechanism around every mechanism that the wrapped builder
+// builds, with the privacy parameters set on this builder. Each built
+// mechanism starts its own background thread, so building one per partition
+// is wasteful; wrap the builder in a SharedMechanismBuilder to share the pool
+// between all algorithms with the same parameters.
+class PooledMechanismBuilder : public NumericalMechanismBuilder {
+ public:
+  explicit PooledMechanismBuilder(
+      std::unique_ptr<NumericalMechanismBuilder> mechanism_builder,
+      int capacity = PooledMechanism::kDefaultCapacity)
+      : mechanism_builder_(std::move(mechanism_builder)),
+        capacity_(capacity) {}
+
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override;
+
+  std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
+    return absl::make_unique<PooledMechanismBuilder>(*this);
+  }
+
+ private:
+  // Only cloned from, so clones can share it.
+  std::shared_ptr<const NumericalMechanismBuilder> mechanism_builder_;
+  int capacity_;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_POOLED_MECHANISM_H_
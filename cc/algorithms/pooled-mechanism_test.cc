@@ -0,0 +1,201 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/pooled-mechanism.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/rand.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::HasSubstr;
+
+// Rounds results to integers and adds 1, 2, 3, ... as noise, so that every
+// noise value shows up only once.
+class CountingMechanism : public ZeroNoiseMechanism {
+ public:
+  CountingMechanism() : ZeroNoiseMechanism(1, 1) {}
+
+  double AddDoubleNoise(double result) override {
+    return std::round(result) + ++num_samples_;
+  }
+
+  int64_t AddInt64Noise(int64_t result) override {
+    return result + ++num_samples_;
+  }
+
+  void AddDoubleNoiseBatch(absl::Span<const double> results,
+                           absl::Span<double> noised_results) override {
+    NumericalMechanism::AddDoubleNoiseBatch(results, noised_results);
+  }
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override {
+    NumericalMechanism::AddInt64NoiseBatch(results, noised_results);
+  }
+
+  std::optional<double> RoundDoubleForNoise(double result) override {
+    return std::round(result);
+  }
+
+ private:
+  std::atomic<int64_t> num_samples_{0};
+};
+
+// A mechanism whose noise depends on the result.
+class ScalingMechanism : public ZeroNoiseMechanism {
+ public:
+  ScalingMechanism() : ZeroNoiseMechanism(1, 1) {}
+
+  double AddDoubleNoise(double result) override { return 2 * result; }
+
+  std::optional<double> RoundDoubleForNoise(double result) override {
+    return std::nullopt;
+  }
+};
+
+TEST(PooledMechanismTest, FillsThePoolInTheBackground) {
+  absl::StatusOr<std::unique_ptr<PooledMechanism>> pooled =
+      PooledMechanism::Create(absl::make_unique<CountingMechanism>(), 16);
+  ASSERT_OK(pooled);
+  (*pooled)->WaitUntilFull();
+  EXPECT_EQ((*pooled)->NumPooledDoubleSamples(), 16);
+  EXPECT_EQ((*pooled)->NumPooledInt64Samples(), 16);
+
+  // The double ring is filled first, so it holds the noise 1 to 16.
+  EXPECT_EQ((*pooled)->AddNoise(10.4), 11);
+  EXPECT_EQ((*pooled)->AddNoise(int64_t{10}), 27);
+  EXPECT_EQ((*pooled)->NumPooledDoubleSamples(), 15);
+}
+
+TEST(PooledMechanismTest, UsesEverySampleExactlyOnce) {
+  absl::StatusOr<std::unique_ptr<PooledMechanism>> pooled =
+      PooledMechanism::Create(absl::make_unique<CountingMechanism>(), 8);
+  ASSERT_OK(pooled);
+
+  absl::Mutex mutex;
+  std::multiset<double> noise;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&pooled, &mutex, &noise]() {
+      std::vector<double> values(10);
+      std::vector<int64_t> int_values(10);
+      for (int j = 0; j < 200; ++j) {
+        values.push_back((*pooled)->AddNoise(0.0));
+        int_values.push_back((*pooled)->AddNoise(int64_t{0}));
+      }
+      ASSERT_OK((*pooled)->AddNoise(absl::MakeSpan(values).subspan(0, 10),
+                                    absl::MakeSpan(values).subspan(0, 10)));
+      ASSERT_OK(
+          (*pooled)->AddNoise(absl::MakeSpan(int_values).subspan(0, 10),
+                              absl::MakeSpan(int_values).subspan(0, 10)));
+      absl::MutexLock lock(&mutex);
+      noise.insert(values.begin(), values.end());
+      noise.insert(int_values.begin(), int_values.end());
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(noise.size(), 4 * 2 * 210);
+  for (double value : noise) {
+    EXPECT_GT(value, 0);
+    ASSERT_EQ(noise.count(value), 1);
+  }
+}
+
+TEST(PooledMechanismTest, RejectsMechanismsWhoseNoiseDependsOnTheResult) {
+  EXPECT_THAT(
+      PooledMechanism::Create(absl::make_unique<ScalingMechanism>()),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               HasSubstr("cannot be drawn ahead of time")));
+  EXPECT_THAT(
+      PooledMechanism::Create(absl::make_unique<CountingMechanism>(), 0),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("Capacity")));
+}
+
+TEST(PooledMechanismBuilderTest, BuildsPooledLaplaceMechanism) {
+  PooledMechanismBuilder builder(absl::make_unique<LaplaceMechanism::Builder>(),
+                                 32);
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> mechanism =
+      builder.SetEpsilon(1.0).SetL0Sensitivity(1).SetLInfSensitivity(2).Build();
+  ASSERT_OK(mechanism);
+  EXPECT_EQ((*mechanism)->GetEpsilon(), 1.0);
+  auto* pooled = dynamic_cast<PooledMechanism*>(mechanism->get());
+  ASSERT_NE(pooled, nullptr);
+  pooled->WaitUntilFull();
+  EXPECT_EQ(pooled->NumPooledDoubleSamples(), 32);
+
+  // Laplace noise with diversity 2 is almost never as large as 100.
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_NEAR((*mechanism)->AddNoise(1000.0), 1000, 100);
+    EXPECT_NEAR((*mechanism)->AddNoise(int64_t{1000}), 1000, 100);
+  }
+}
+
+TEST(PooledMechanismBuilderTest, SharesThePoolThroughSharedMechanismBuilder) {
+  SharedMechanismBuilder builder(absl::make_unique<PooledMechanismBuilder>(
+      absl::make_unique<LaplaceMechanism::Builder>()));
+  builder.SetEpsilon(1.0).SetL0Sensitivity(1).SetLInfSensitivity(1);
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> first = builder.Build();
+  ASSERT_OK(first);
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> second = builder.Build();
+  ASSERT_OK(second);
+  EXPECT_EQ((*first)->NoiseSource(), (*second)->NoiseSource());
+  EXPECT_NE(dynamic_cast<PooledMechanism*>((*first)->NoiseSource()), nullptr);
+}
+
+TEST(PooledMechanismBuilderTest, RejectsRandomSource) {
+  SecureRandomSource random_source;
+  PooledMechanismBuilder builder(
+      absl::make_unique<LaplaceMechanism::Builder>());
+  builder.SetEpsilon(1.0).SetRandomSource(&random_source);
+  EXPECT_THAT(builder.Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("cannot use a RandomSource")));
+}
+
+TEST(PooledMechanismBuilderTest, PropagatesBuilderErrors) {
+  PooledMechanismBuilder builder(
+      absl::make_unique<LaplaceMechanism::Builder>());
+  builder.SetEpsilon(-1);
+  EXPECT_THAT(builder.Build(), StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,134 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_PREAGG_PARTITION_SELECTION_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_PREAGG_PARTITION_SELECTION_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/partition-selection.h"
+#include "proto/summary.pb.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Partition selection for partitions whose numbers of privacy units were
+// already counted upstream, e.g. columns of partition ids and counts read from
+// a columnar file, so counts do not have to be re-derived from raw rows.
+
+// Number of partitions decided by one call to the batched ShouldKeep.
+inline constexpr size_t kPreAggSelectionBatchSize = 1 << 16;
+
+// Appends the ids of the partitions kept by strategy to kept_ids.
+// partition_ids[i] is the id of a partition with counts[i] privacy units.
+// Every partition must appear once, with its count over the whole dataset.
+// Returns an error without appending anything if the columns have different
+// lengths or a count is negative.
+template <typename Id>
+absl::Status SelectPreAggregatedPartitions(
+    absl::Span<const Id> partition_ids, absl::Span<const int64_t> counts,
+    PartitionSelectionStrategy& strategy, std::vector<Id>* kept_ids) {
+  if (kept_ids == nullptr) {
+    return absl::InvalidArgumentError("Output must not be null.");
+  }
+  if (partition_ids.size() != counts.size()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Got ", partition_ids.size(), " partition ids but ",
+                     counts.size(), " counts."));
+  }
+  if (std::any_of(counts.begin(), counts.end(),
+                  [](int64_t count) { return count < 0; })) {
+    return absl::InvalidArgumentError("Counts must not be negative.");
+  }
+
+  std::vector<bool> keep;
+  for (size_t begin = 0; begin < counts.size();
+       begin += kPreAggSelectionBatchSize) {
+    const size_t size =
+        std::min(kPreAggSelectionBatchSize, counts.size() - begin);
+    strategy.ShouldKeep(counts.subspan(begin, size), &keep);
+    for (size_t i = 0; i < size; ++i) {
+      if (keep[i]) kept_ids->push_back(partition_ids[begin + i]);
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Creates the near truncated geometric partition selection that the
+// PreAggSelectPartition of the other libraries serializes into summary.
+inline absl::StatusOr<std::unique_ptr<PartitionSelectionStrategy>>
+CreateStrategyFromSummary(const PreAggSelectPartitionSummary& summary) {
+  if (!summary.has_epsilon() || !summary.has_delta() ||
+      !summary.has_max_partitions_contributed()) {
+    return absl::InvalidArgumentError(
+        "Summary must have epsilon, delta and max_partitions_contributed.");
+  }
+  NearTruncatedGeometricPartitionSelection::Builder builder;
+  builder.SetEpsilon(summary.epsilon())
+      .SetDelta(summary.delta())
+      .SetMaxPartitionsContributed(summary.max_partitions_contributed());
+  if (summary.has_pre_threshold()) {
+    builder.SetPreThreshold(summary.pre_threshold());
+  }
+  return builder.Build();
+}
+
+// Same as SelectPreAggregatedPartitions, with the count and the parameters of
+// every partition taken from its PreAggSelectPartitionSummary. All summaries
+// must have the same parameters.
+template <typename Id>
+absl::Status SelectPreAggregatedPartitions(
+    absl::Span<const Id> partition_ids,
+    absl::Span<const PreAggSelectPartitionSummary> summaries,
+    std::vector<Id>* kept_ids) {
+  if (partition_ids.size() != summaries.size()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Got ", partition_ids.size(), " partition ids but ",
+                     summaries.size(), " summaries."));
+  }
+  if (summaries.empty()) {
+    return absl::OkStatus();
+  }
+  const PreAggSelectPartitionSummary& first = summaries.front();
+  std::vector<int64_t> counts;
+  counts.reserve(summaries.size());
+  for (const PreAggSelectPartitionSummary& summary : summaries) {
+    if (summary.epsilon() != first.epsilon() ||
+        summary.delta() != first.delta() ||
+        summary.max_partitions_contributed() !=
+            first.max_partitions_contributed() ||
+        summary.pre_threshold() != first.pre_threshold()) {
+      return absl::InvalidArgumentError(
+          "All summaries must have the same parameters.");
+    }
+    counts.push_back(summary.ids_count());
+  }
+  ASSIGN_OR_RETURN(std::unique_ptr<PartitionSelectionStrategy> strategy,
+                   CreateStrategyFromSummary(first));
+  return SelectPreAggregatedPartitions<Id>(partition_ids, counts, *strategy,
+                                           kept_ids);
+}
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_PREAGG_PARTITION_SELECTION_H_
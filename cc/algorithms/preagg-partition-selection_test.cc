@@ -0,0 +1,158 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/preagg-partition-selection.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "algorithms/partition-selection.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+using ::testing::HasSubstr;
+
+// Partitions with no privacy units are always dropped and partitions with
+// kManyPrivacyUnits are always kept, so that results are deterministic.
+constexpr int64_t kManyPrivacyUnits = 1000;
+
+std::unique_ptr<PartitionSelectionStrategy> CreateStrategy() {
+  return NearTruncatedGeometricPartitionSelection::Builder()
+      .SetEpsilon(1)
+      .SetDelta(1e-5)
+      .SetMaxPartitionsContributed(1)
+      .Build()
+      .value();
+}
+
+PreAggSelectPartitionSummary CreateSummary(int64_t ids_count) {
+  PreAggSelectPartitionSummary summary;
+  summary.set_ids_count(ids_count);
+  summary.set_epsilon(1);
+  summary.set_delta(1e-5);
+  summary.set_max_partitions_contributed(1);
+  summary.set_pre_threshold(2);
+  return summary;
+}
+
+TEST(PreAggPartitionSelectionTest, KeepsPartitionsAcrossBatches) {
+  std::vector<int64_t> partition_ids;
+  std::vector<int64_t> counts;
+  std::vector<int64_t> expected;
+  for (int64_t i = 0; i < 3 * kPreAggSelectionBatchSize; ++i) {
+    partition_ids.push_back(i * 7);
+    counts.push_back(i % 5 == 0 ? kManyPrivacyUnits : 0);
+    if (i % 5 == 0) expected.push_back(i * 7);
+  }
+  std::unique_ptr<PartitionSelectionStrategy> strategy = CreateStrategy();
+  std::vector<int64_t> kept;
+
+  ASSERT_OK(SelectPreAggregatedPartitions<int64_t>(partition_ids, counts,
+                                                   *strategy, &kept));
+
+  EXPECT_THAT(kept, ElementsAreArray(expected));
+}
+
+TEST(PreAggPartitionSelectionTest, StringIds) {
+  std::vector<absl::string_view> partition_ids = {"a", "b", "c"};
+  std::vector<int64_t> counts = {kManyPrivacyUnits, 0, kManyPrivacyUnits};
+  std::unique_ptr<PartitionSelectionStrategy> strategy = CreateStrategy();
+  std::vector<absl::string_view> kept;
+
+  ASSERT_OK(SelectPreAggregatedPartitions<absl::string_view>(
+      partition_ids, counts, *strategy, &kept));
+
+  EXPECT_THAT(kept, ElementsAre("a", "c"));
+}
+
+TEST(PreAggPartitionSelectionTest, InvalidColumns) {
+  std::unique_ptr<PartitionSelectionStrategy> strategy = CreateStrategy();
+  std::vector<int64_t> kept;
+  std::vector<int64_t> partition_ids = {1, 2};
+
+  EXPECT_THAT(SelectPreAggregatedPartitions<int64_t>(
+                  partition_ids, std::vector<int64_t>{1}, *strategy, &kept),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("2 partition ids but 1 counts")));
+  EXPECT_THAT(SelectPreAggregatedPartitions<int64_t>(
+                  partition_ids, std::vector<int64_t>{kManyPrivacyUnits, -1},
+                  *strategy, &kept),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("negative")));
+  EXPECT_TRUE(kept.empty());
+}
+
+TEST(PreAggPartitionSelectionTest, SelectsFromSummaries) {
+  std::vector<int64_t> partition_ids = {10, 20, 30};
+  std::vector<PreAggSelectPartitionSummary> summaries = {
+      CreateSummary(kManyPrivacyUnits), CreateSummary(1),
+      CreateSummary(kManyPrivacyUnits)};
+  std::vector<int64_t> kept;
+
+  ASSERT_OK(
+      SelectPreAggregatedPartitions<int64_t>(partition_ids, summaries, &kept));
+
+  // The partition with one privacy unit is below the pre-threshold.
+  EXPECT_THAT(kept, ElementsAre(10, 30));
+}
+
+TEST(PreAggPartitionSelectionTest, SummariesWithDifferentParameters) {
+  std::vector<int64_t> partition_ids = {10, 20};
+  std::vector<PreAggSelectPartitionSummary> summaries = {CreateSummary(1),
+                                                         CreateSummary(1)};
+  summaries[1].set_epsilon(2);
+  std::vector<int64_t> kept;
+
+  EXPECT_THAT(
+      SelectPreAggregatedPartitions<int64_t>(partition_ids, summaries, &kept),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               HasSubstr("same parameters")));
+}
+
+TEST(PreAggPartitionSelectionTest, CreateStrategyFromIncompleteSummary) {
+  PreAggSelectPartitionSummary summary;
+  summary.set_epsilon(1);
+
+  EXPECT_THAT(CreateStrategyFromSummary(summary),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("max_partitions_contributed")));
+}
+
+TEST(PreAggPartitionSelectionTest, CreateStrategyFromSummary) {
+  absl::StatusOr<std::unique_ptr<PartitionSelectionStrategy>> strategy =
+      CreateStrategyFromSummary(CreateSummary(0));
+  ASSERT_OK(strategy);
+
+  EXPECT_EQ((*strategy)->GetEpsilon(), 1);
+  EXPECT_EQ((*strategy)->GetDelta(), 1e-5);
+  EXPECT_EQ((*strategy)->GetMaxPartitionsContributed(), 1);
+  EXPECT_EQ((*strategy)->GetPreThreshold(), 2);
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -17,14 +17,20 @@
 #ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_QUANTILE_TREE_H_
 #define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_QUANTILE_TREE_H_
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <limits>
 #include <optional>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "algorithms/algorithm.h"
 #include "algorithms/bounded-algorithm.h"
 #include "algorithms/internal/count-tree.h"
@@ -32,6 +38,7 @@
 #include "proto/util.h"
 #include "proto/confidence-interval.pb.h"
 #include "proto/summary.pb.h"
+#include "base/memory_budget.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
@@ -69,9 +76,33 @@ class QuantileTree {
  public:
   class Builder;
   class Privatized;
+  class PrivatizationContext;
 
   void AddEntry(const T& input) { AddMultipleEntries(input, 1); }
 
+  // Adds all inputs to the tree. Equivalent to calling AddEntry on each input,
+  // but the leaves of all inputs are computed first and their counts are
+  // aggregated, so that every node of the tree is updated at most once per
+  // call. Prefer this method for large batches of input.
+  void AddEntries(absl::Span<const T> inputs) {
+    std::vector<int> leaf_offsets;
+    leaf_offsets.reserve(inputs.size());
+    for (const T& input : inputs) {
+      if (!std::isnan(static_cast<double>(input))) {
+        leaf_offsets.push_back(getLeafOffset(Clamp(lower_, upper_, input)));
+      }
+    }
+    if (leaf_offsets.empty()) {
+      return;
+    }
+    if (leaf_offsets.size() >=
+        static_cast<size_t>(tree_.GetNumberOfLeaves())) {
+      AddLeafHistogram(leaf_offsets);
+    } else {
+      AddSortedLeafOffsets(std::move(leaf_offsets));
+    }
+  }
+
   // Removes all input from the QuantileTree. After calling this method, the
   // QuantileTree will be equivalent to one that is newly initialized with no
   // input added.
@@ -87,19 +118,172 @@ class QuantileTree {
 
   // Returns a private version of the quantile tree, which can be used to get
   // differentially private quantiles. Each call to this method expends the
-  // epsilon and delta specified in the params.
+  // epsilon and delta specified in the params. The private version holds a
+  // copy of the counts, so this tree may be modified or destroyed afterwards.
   absl::StatusOr<Privatized> MakePrivate(const DPParams& params) {
-    ASSIGN_OR_RETURN(
-        std::unique_ptr<NumericalMechanism> mech,
-        params.mechanism_builder->SetEpsilon(params.epsilon)
-            .SetDelta(params.delta)
-            .SetL0Sensitivity(params.max_partitions_contributed_to *
-                              tree_.GetHeight())
-            .SetLInfSensitivity(params.max_contributions_per_partition)
-            .Build());
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mech,
+                     BuildMechanism(params, tree_.GetHeight()));
+    return Privatized(upper_, lower_, std::move(mech),
+                      std::make_shared<const internal::CountTree>(tree_));
+  }
+
+  // Same as MakePrivate, but the private version reads the counts of this tree
+  // instead of copying them, which avoids doubling the memory of the counts
+  // during the release. This tree must outlive the private version and must
+  // not be modified (by adding entries, merging, or resetting) while the
+  // private version is in use.
+  absl::StatusOr<Privatized> MakePrivateView(const DPParams& params) const {
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mech,
+                     BuildMechanism(params, tree_.GetHeight()));
     return Privatized(upper_, lower_, std::move(mech), tree_);
   }
 
+  // Returns a context for privatizing many trees of the same height as this
+  // one with the same params, e.g., one tree per partition. The mechanism is
+  // built and calibrated once, when the context is made, and shared by all
+  // trees privatized with the context.
+  absl::StatusOr<PrivatizationContext> MakePrivatizationContext(
+      const DPParams& params) const {
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mech,
+                     BuildMechanism(params, tree_.GetHeight()));
+    return PrivatizationContext(tree_.GetHeight(), std::move(mech));
+  }
+
+  // Same as MakePrivate for the params of the context, without building a
+  // mechanism. Each call to this method expends the epsilon and delta of the
+  // context. Returns an error if the context was made for a different tree
+  // height.
+  absl::StatusOr<Privatized> MakePrivate(const PrivatizationContext& context) {
+    if (context.tree_height() != tree_.GetHeight()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The privatization context is for trees of height ",
+          context.tree_height(), ", but the tree has height ",
+          tree_.GetHeight(), "."));
+    }
+    return Privatized(upper_, lower_, context.mechanism_,
+                      std::make_shared<const internal::CountTree>(tree_));
+  }
+
+  // Same as MakePrivate(context), but reads the counts of this tree instead of
+  // copying them, with the same requirements as MakePrivateView(params).
+  absl::StatusOr<Privatized> MakePrivateView(
+      const PrivatizationContext& context) const {
+    if (context.tree_height() != tree_.GetHeight()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The privatization context is for trees of height ",
+          context.tree_height(), ", but the tree has height ",
+          tree_.GetHeight(), "."));
+    }
+    return Privatized(upper_, lower_, context.mechanism_, tree_);
+  }
+
+  // Computes the same quantiles of many trees with the mechanism of the
+  // context, e.g., the 50th, 90th and 99th percentile of every partition.
+  // Equivalent to calling MakePrivate(context) and GetQuantile on every tree,
+  // but the trees are not copied, and they are searched level by level so that
+  // the child counts of all nodes visited on a level, over all trees, are
+  // noised in one batch. Quantile j of tree i is written to
+  // results[j * trees.size() + i], i.e., results has one column per quantile.
+  // Expends the epsilon and delta of the context once per tree.
+  static absl::Status ComputeQuantiles(
+      absl::Span<const QuantileTree<T>* const> trees,
+      absl::Span<const double> quantiles, const PrivatizationContext& context,
+      absl::Span<double> results) {
+    const size_t num_trees = trees.size();
+    if (results.size() != num_trees * quantiles.size()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Expected space for ", num_trees * quantiles.size(),
+          " results, but got ", results.size(), "."));
+    }
+    for (double quantile : quantiles) {
+      if (quantile < 0 || quantile > 1) {
+        return absl::InvalidArgumentError(absl::StrCat(
+            "Requested quantile must be in [0, 1] but was ", quantile));
+      }
+    }
+    for (const QuantileTree<T>* tree : trees) {
+      if (tree->tree_.GetHeight() != context.tree_height()) {
+        return absl::InvalidArgumentError(absl::StrCat(
+            "The privatization context is for trees of height ",
+            context.tree_height(), ", but a tree has height ",
+            tree->tree_.GetHeight(), "."));
+      }
+    }
+
+    // The node and the quantile within the node of the search for every
+    // result, in the order of results, and whether the search continues.
+    std::vector<int> nodes(results.size());
+    std::vector<double> node_quantiles(results.size());
+    std::vector<bool> active(results.size(), true);
+    for (size_t j = 0; j < quantiles.size(); ++j) {
+      for (size_t i = 0; i < num_trees; ++i) {
+        nodes[j * num_trees + i] = trees[i]->tree_.GetRoot();
+        node_quantiles[j * num_trees + i] = ClampQuantile(quantiles[j]);
+      }
+    }
+    // Offsets of the noised child counts of the node of every search in
+    // counts. Searches of a tree that are at the same node share its counts,
+    // like the cache of Privatized.
+    std::vector<size_t> offsets(results.size());
+    std::vector<int64_t> counts;
+    for (int level = 0; level < context.tree_height(); ++level) {
+      counts.clear();
+      for (size_t i = 0; i < num_trees; ++i) {
+        const internal::CountTree& tree = trees[i]->tree_;
+        for (size_t j = 0; j < quantiles.size(); ++j) {
+          const size_t search = j * num_trees + i;
+          if (!active[search]) continue;
+          size_t shared = search;
+          for (size_t k = 0; k < j; ++k) {
+            const size_t other = k * num_trees + i;
+            if (active[other] && nodes[other] == nodes[search]) {
+              shared = other;
+              break;
+            }
+          }
+          if (shared != search) {
+            offsets[search] = offsets[shared];
+            continue;
+          }
+          offsets[search] = counts.size();
+          const int left_most_child = tree.LeftMostChild(nodes[search]);
+          for (int c = 0; c < tree.GetBranchingFactor(); ++c) {
+            counts.push_back(tree.GetNodeCount(left_most_child + c));
+          }
+        }
+      }
+      if (counts.empty()) break;
+      // The spans have the same size, so adding noise cannot fail.
+      context.mechanism_->AddNoise(counts, absl::MakeSpan(counts))
+          .IgnoreError();
+
+      for (size_t search = 0; search < results.size(); ++search) {
+        if (!active[search]) continue;
+        const internal::CountTree& tree = trees[search % num_trees]->tree_;
+        const int child = DescendForQuantile(
+            absl::MakeConstSpan(counts).subspan(offsets[search],
+                                                tree.GetBranchingFactor()),
+            &node_quantiles[search]);
+        if (child < 0) {
+          active[search] = false;
+        } else {
+          nodes[search] = tree.LeftMostChild(nodes[search]) + child;
+        }
+      }
+    }
+
+    for (size_t search = 0; search < results.size(); ++search) {
+      const QuantileTree<T>& tree = *trees[search % num_trees];
+      const double quantile = node_quantiles[search];
+      results[search] =
+          (1 - quantile) * SubtreeLowerBound(tree.tree_, tree.lower_,
+                                             tree.upper_, nodes[search]) +
+          quantile * SubtreeUpperBound(tree.tree_, tree.lower_, tree.upper_,
+                                       nodes[search]);
+    }
+    return absl::OkStatus();
+  }
+
   BoundedQuantilesSummary Serialize() {
     BoundedQuantilesSummary to_return = tree_.Serialize();
     to_return.set_lower(lower_);
@@ -117,6 +301,17 @@ class QuantileTree {
     return tree_.Merge(summary);
   }
 
+  // Adds the counts of another tree with the same bounds, height and
+  // branching factor without going through a summary.
+  absl::Status MergeFrom(const QuantileTree& other) {
+    if (lower_ != other.lower_ || upper_ != other.upper_) {
+      return absl::InternalError(absl::StrCat(
+          "Bounds mismatch. Tree: [", lower_, ", ", upper_, "] ",
+          ", other tree: [", other.lower_, ", ", other.upper_, "]"));
+    }
+    return tree_.MergeFrom(other.tree_);
+  }
+
   int64_t MemoryUsed() {
     return sizeof(QuantileTree) - sizeof(internal::CountTree) +
            tree_.MemoryUsed();
@@ -126,13 +321,161 @@ class QuantileTree {
   int GetBranchingFactor() { return tree_.GetBranchingFactor(); }
 
  private:
-  QuantileTree(T lower, T upper, int tree_height, int branching_factor)
-      : lower_(lower), upper_(upper), tree_(tree_height, branching_factor) {}
+  QuantileTree(T lower, T upper, int tree_height, int branching_factor,
+               base::MemoryBudget* memory_budget)
+      : lower_(lower),
+        upper_(upper),
+        tree_(tree_height, branching_factor, memory_budget),
+        leaf_scale_((tree_.GetNumberOfLeaves() - 1) /
+                    static_cast<double>(upper_ - lower_)) {}
+
+  // Clamps a quantile to a value between 0.005 and 0.995. This mitigates the
+  // inaccuracy of the quantile tree mechanism when finding a quantile close to
+  // 0 or 1.
+  static double ClampQuantile(double quantile) {
+    return std::min(std::max(0.005, quantile), 0.995);
+  }
+
+  // One step of the search for a quantile: given the noised counts of the
+  // children of a node and the quantile within the node, returns the index of
+  // the child to continue in and updates the quantile to the one within the
+  // child. Returns -1 if the search should stop at the node.
+  static int DescendForQuantile(absl::Span<const int64_t> child_counts,
+                                double* quantile) {
+    double total_count = 0.0;
+    for (int64_t count : child_counts) {
+      total_count += count;
+    }
+
+    // All child nodes appear to be empty. No need to continue down the tree.
+    if (total_count <= 0) return -1;
+
+    // Remove nodes that make up less than an alpha fraction of the total -
+    // these are likely empty.
+    double corrected_total_count = 0.0;
+    for (int64_t count : child_counts) {
+      corrected_total_count += count >= total_count * kAlpha ? count : 0.0;
+    }
+
+    // All child nodes have a negligible noisy count. We can't tell whether
+    // they have any elements in them, and if so how many, so we can stop and
+    // pick the middle of this range.
+    if (corrected_total_count <= 0) return -1;
+
+    double partial_count = 0.0;
+    for (size_t i = 0; i < child_counts.size(); ++i) {
+      double count = child_counts[i];
+      // Ignore nodes we think are empty.
+      partial_count += count >= total_count * kAlpha ? count : 0.0;
+      if (partial_count / corrected_total_count >=
+          *quantile - kNumericalTolerance) {
+        *quantile =
+            (*quantile - (partial_count - count) / corrected_total_count) /
+            (count / corrected_total_count);
+        *quantile = std::min(std::max(*quantile, 0.0), 1.0);
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  static double SubtreeLowerBound(const internal::CountTree& tree, T lower,
+                                  T upper, int index) {
+    int leaf_index = tree.LeftMostInSubtree(index) - tree.GetLeftMostLeaf();
+    double quantile =
+        static_cast<double>(leaf_index) / tree.GetNumberOfLeaves();
+    return quantile * upper + (1 - quantile) * lower;
+  }
+
+  static double SubtreeUpperBound(const internal::CountTree& tree, T lower,
+                                  T upper, int index) {
+    int leaf_index =
+        tree.RightMostInSubtree(index) - tree.GetLeftMostLeaf() + 1;
+    double quantile =
+        static_cast<double>(leaf_index) / tree.GetNumberOfLeaves();
+    return quantile * upper + (1 - quantile) * lower;
+  }
+
+  static absl::StatusOr<std::unique_ptr<NumericalMechanism>> BuildMechanism(
+      const DPParams& params, int tree_height) {
+    return params.mechanism_builder->SetEpsilon(params.epsilon)
+        .SetDelta(params.delta)
+        .SetL0Sensitivity(params.max_partitions_contributed_to * tree_height)
+        .SetLInfSensitivity(params.max_contributions_per_partition)
+        .Build();
+  }
+
+  // input must be in [lower_, upper_].
+  int getLeafOffset(T input) {
+    // The product can round to just below an integer where the quotient would
+    // not, so upper_ is mapped to the last leaf explicitly.
+    if (input >= upper_) {
+      return tree_.GetNumberOfLeaves() - 1;
+    }
+    return static_cast<double>(input - lower_) * leaf_scale_;
+  }
+
+  // Counts the leaf offsets in a histogram over all leaves and adds the
+  // histogram to the tree one level at a time. Used when there are at least
+  // as many offsets as leaves, so the histogram is cheap in comparison.
+  void AddLeafHistogram(const std::vector<int>& leaf_offsets) {
+    std::vector<int> level_starts = {tree_.GetLeftMostLeaf()};
+    while (tree_.Parent(level_starts.back()) > tree_.GetRoot()) {
+      level_starts.push_back(tree_.Parent(level_starts.back()));
+    }
+
+    std::vector<int64_t> counts(tree_.GetNumberOfLeaves());
+    for (int offset : leaf_offsets) {
+      ++counts[offset];
+    }
+    const int branching_factor = tree_.GetBranchingFactor();
+    for (int level_start : level_starts) {
+      for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] != 0) {
+          tree_.IncrementNodeBy(level_start + i, counts[i]);
+        }
+      }
+      // Sum up the counts of siblings to get the counts of the next level.
+      for (size_t i = 0; i < counts.size() / branching_factor; ++i) {
+        int64_t sum = 0;
+        for (int j = 0; j < branching_factor; ++j) {
+          sum += counts[i * branching_factor + j];
+        }
+        counts[i] = sum;
+      }
+      counts.resize(counts.size() / branching_factor);
+    }
+  }
 
-  int getLeafIndex(T input) {
-    double leaf_fraction =
-        static_cast<double>(input - lower_) / (upper_ - lower_);
-    return tree_.GetNthLeaf(leaf_fraction * (tree_.GetNumberOfLeaves() - 1));
+  // Sorts the leaf offsets, aggregates equal nodes and propagates the
+  // aggregated counts to the parents one level at a time.
+  void AddSortedLeafOffsets(std::vector<int> leaf_offsets) {
+    std::sort(leaf_offsets.begin(), leaf_offsets.end());
+    std::vector<std::pair<int, int64_t>> node_counts;
+    for (int offset : leaf_offsets) {
+      int node = tree_.GetNthLeaf(offset);
+      if (!node_counts.empty() && node_counts.back().first == node) {
+        ++node_counts.back().second;
+      } else {
+        node_counts.emplace_back(node, 1);
+      }
+    }
+    // All leaves are at the same depth, so all nodes reach the root at once.
+    while (node_counts.front().first > tree_.GetRoot()) {
+      // Parents of sorted nodes are sorted, so equal parents are adjacent and
+      // can be merged in place.
+      int num_parents = 0;
+      for (const auto& [node, count] : node_counts) {
+        tree_.IncrementNodeBy(node, count);
+        int parent = tree_.Parent(node);
+        if (num_parents > 0 && node_counts[num_parents - 1].first == parent) {
+          node_counts[num_parents - 1].second += count;
+        } else {
+          node_counts[num_parents++] = {parent, count};
+        }
+      }
+      node_counts.resize(num_parents);
+    }
   }
 
   void AddMultipleEntries(const T& input, const int64_t times) {
@@ -144,16 +487,16 @@ class QuantileTree {
     if (times <= 0) {
       return;
     }
-    int currentNode = getLeafIndex(Clamp(lower_, upper_, input));
-    while (currentNode > tree_.GetRoot()) {
-      tree_.IncrementNodeBy(currentNode, times);
-      currentNode = tree_.Parent(currentNode);
-    }
+    tree_.IncrementLeafAndAncestorsBy(
+        getLeafOffset(Clamp(lower_, upper_, input)), times);
   }
 
   T lower_;
   T upper_;
   internal::CountTree tree_;
+  // Number of leaves per unit of input, such that inputs in [lower_, upper_]
+  // map to leaf offsets in [0, number of leaves - 1].
+  const double leaf_scale_;
 
   friend class QuantileTreeTestPeer;
 };
@@ -174,45 +517,10 @@ class QuantileTree<T>::Privatized {
 
     int current_node = raw_tree_.GetRoot();
     while (!raw_tree_.IsLeaf(current_node)) {
-      int left_most_child = raw_tree_.LeftMostChild(current_node);
-      int right_most_child = raw_tree_.RightMostChild(current_node);
-
-      double total_count = 0.0;
-      for (int i = left_most_child; i <= right_most_child; ++i) {
-        total_count += GetNoisedCount(i);
-      }
-
-      // All child nodes appear to be empty. No need to continue down the tree.
-      if (total_count <= 0) break;
-
-      // Remove nodes that make up less than an alpha fraction of the total -
-      // these are likely empty.
-      double corrected_total_count = 0.0;
-      for (int i = left_most_child; i <= right_most_child; ++i) {
-        corrected_total_count +=
-            GetNoisedCount(i) >= total_count * kAlpha ? GetNoisedCount(i) : 0.0;
-      }
-
-      // All child nodes have a negligible noisy count. We can't tell whether
-      // they have any elements in them, and if so how many, so we can stop
-      // and pick the middle of this range.
-      if (corrected_total_count <= 0) break;
-
-      double partial_count = 0.0;
-      for (int i = left_most_child; i <= right_most_child; ++i) {
-        double count = GetNoisedCount(i);
-        // Ignore nodes we think are empty.
-        partial_count += count >= total_count * kAlpha ? count : 0.0;
-        if (partial_count / corrected_total_count >=
-            quantile - kNumericalTolerance) {
-          quantile =
-              (quantile - (partial_count - count) / corrected_total_count) /
-              (count / corrected_total_count);
-          quantile = std::min(std::max(quantile, 0.0), 1.0);
-          current_node = i;
-          break;
-        }
-      }
+      const int child =
+          DescendForQuantile(GetNoisedChildCounts(current_node), &quantile);
+      if (child < 0) break;
+      current_node = raw_tree_.LeftMostChild(current_node) + child;
     }
 
     double to_return = (1 - quantile) * GetSubtreeLowerBound(current_node) +
@@ -249,12 +557,22 @@ class QuantileTree<T>::Privatized {
  private:
   friend class QuantileTree<T>;
 
-  Privatized(T upper, T lower, std::unique_ptr<NumericalMechanism> mechanism,
+  // Owns the counts.
+  Privatized(T upper, T lower, std::shared_ptr<NumericalMechanism> mechanism,
+             std::shared_ptr<const internal::CountTree> raw_tree)
+      : upper_(upper),
+        lower_(lower),
+        mechanism_(std::move(mechanism)),
+        owned_raw_tree_(std::move(raw_tree)),
+        raw_tree_(*owned_raw_tree_) {}
+
+  // Borrows the counts, which must outlive the privatized tree.
+  Privatized(T upper, T lower, std::shared_ptr<NumericalMechanism> mechanism,
              const internal::CountTree& raw_tree)
-      : raw_tree_(raw_tree),
-        upper_(upper),
+      : upper_(upper),
         lower_(lower),
-        mechanism_(std::move(mechanism)) {}
+        mechanism_(std::move(mechanism)),
+        raw_tree_(raw_tree) {}
 
   // These are used by the confidence interval computation algorithm.
   enum class ConfidenceIntervalBoundType { LOWER, UPPER };
@@ -374,12 +692,20 @@ class QuantileTree<T>::Privatized {
       // set with the first update of next_index.
       double next_quantile = -1.0;
 
+      // Only counts that have been noised by a quantile search are used;
+      // children that have not been noised yet are treated as having a count
+      // of 0.
+      auto cached_counts = noised_child_counts_.find(index);
       std::unordered_map<int, ConfidenceInterval> child_confidence_intervals;
       for (int i = leftmost_child_index; i <= rightmost_child_index; i++) {
+        const double noised_count =
+            cached_counts == noised_child_counts_.end()
+                ? 0.0
+                : cached_counts->second[i - leftmost_child_index];
         ConfidenceInterval ci;
-        ci.set_lower_bound(noised_tree_[i] +
+        ci.set_lower_bound(noised_count +
                            zero_confidence_interval.lower_bound());
-        ci.set_upper_bound(noised_tree_[i] +
+        ci.set_upper_bound(noised_count +
                            zero_confidence_interval.upper_bound());
         child_confidence_intervals[i] = ci;
       }
@@ -467,41 +793,67 @@ class QuantileTree<T>::Privatized {
                : std::max(bound, linear_interpolation);
   }
 
-  double GetNoisedCount(int index) {
-    if (noised_tree_.find(index) == noised_tree_.end()) {
-      noised_tree_[index] = mechanism_->AddNoise(raw_tree_.GetNodeCount(index));
+  // Returns the noised counts of all children of the given node. Siblings are
+  // always inspected together, so the counts of all children are noised in a
+  // single batch the first time they are requested and cached afterwards. This
+  // way, every node is noised at most once no matter how many quantiles are
+  // computed.
+  absl::Span<const int64_t> GetNoisedChildCounts(int index) {
+    // The returned span points to the heap buffer of the vector, which stays
+    // valid when the map rehashes and moves the vector.
+    std::vector<int64_t>& counts = noised_child_counts_[index];
+    if (counts.empty()) {
+      const int left_most_child = raw_tree_.LeftMostChild(index);
+      counts.resize(raw_tree_.GetBranchingFactor());
+      for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] = raw_tree_.GetNodeCount(left_most_child + i);
+      }
+      // The spans have the same size, so adding noise cannot fail.
+      mechanism_->AddNoise(counts, absl::MakeSpan(counts)).IgnoreError();
     }
-    return noised_tree_[index];
+    return counts;
   }
 
   double GetSubtreeLowerBound(int index) {
-    int leaf_index =
-        raw_tree_.LeftMostInSubtree(index) - raw_tree_.GetLeftMostLeaf();
-    double quantile =
-        static_cast<double>(leaf_index) / raw_tree_.GetNumberOfLeaves();
-    return quantile * upper_ + (1 - quantile) * lower_;
+    return SubtreeLowerBound(raw_tree_, lower_, upper_, index);
   }
 
   double GetSubtreeUpperBound(int index) {
-    int leaf_index =
-        raw_tree_.RightMostInSubtree(index) - raw_tree_.GetLeftMostLeaf() + 1;
-    double quantile =
-        static_cast<double>(leaf_index) / raw_tree_.GetNumberOfLeaves();
-    return quantile * upper_ + (1 - quantile) * lower_;
-  }
-
-  // Clamps a quantile to a value between 0.005 and 0.995. This mitigates the
-  // inaccuracy of the quantile tree mechanism when finding a quantile close to
-  // 0 or 1.
-  static double ClampQuantile(double quantile) {
-    return std::min(std::max(0.005, quantile), 0.995);
+    return SubtreeUpperBound(raw_tree_, lower_, upper_, index);
   }
 
   const T upper_;
   const T lower_;
-  std::unique_ptr<NumericalMechanism> mechanism_;
-  const internal::CountTree raw_tree_;
-  std::unordered_map<int64_t, int64_t> noised_tree_;
+  // Shared with the other trees privatized with the same context, if any.
+  std::shared_ptr<NumericalMechanism> mechanism_;
+  // Set if the privatized tree owns its counts. Held by pointer so that moving
+  // the privatized tree does not copy the counts.
+  std::shared_ptr<const internal::CountTree> owned_raw_tree_;
+  // Either *owned_raw_tree_ or the counts of the tree that was privatized.
+  const internal::CountTree& raw_tree_;
+  // Noised counts of the children of a node, keyed by the index of the node.
+  absl::flat_hash_map<int, std::vector<int64_t>> noised_child_counts_;
+};
+
+// The mechanism for privatizing quantile trees of a given height with given
+// DPParams, see QuantileTree::MakePrivatizationContext. Copies share the
+// mechanism. Trees privatized with the same context may be used from several
+// threads if the mechanism supports it, which is the case for the Laplace and
+// Gaussian mechanisms.
+template <typename T>
+class QuantileTree<T>::PrivatizationContext {
+ public:
+  int tree_height() const { return tree_height_; }
+
+ private:
+  friend class QuantileTree<T>;
+
+  PrivatizationContext(int tree_height,
+                       std::shared_ptr<NumericalMechanism> mechanism)
+      : tree_height_(tree_height), mechanism_(std::move(mechanism)) {}
+
+  int tree_height_;
+  std::shared_ptr<NumericalMechanism> mechanism_;
 };
 
 template <typename T>
@@ -529,6 +881,14 @@ class QuantileTree<T>::Builder {
     return *static_cast<Builder*>(this);
   }
 
+  // Allocates the counts from the memory budget, and stores them sparsely
+  // while the budget asks for compact storage, see CountTree. The budget must
+  // outlive the built QuantileTree.
+  Builder& SetMemoryBudget(base::MemoryBudget* memory_budget) {
+    memory_budget_ = memory_budget;
+    return *static_cast<Builder*>(this);
+  }
+
   absl::StatusOr<std::unique_ptr<QuantileTree<T>>> Build() {
     if (!tree_height_.has_value()) {
       tree_height_ = kDefaultTreeHeight;
@@ -558,7 +918,7 @@ class QuantileTree<T>::Builder {
 
     return std::unique_ptr<QuantileTree>(
         new QuantileTree(lower_.value(), upper_.value(), tree_height_.value(),
-                         branching_factor_.value()));
+                         branching_factor_.value(), memory_budget_));
   }
 
  private:
@@ -566,7 +926,14 @@ class QuantileTree<T>::Builder {
   std::optional<int> branching_factor_;
   std::optional<T> lower_;
   std::optional<T> upper_;
+  base::MemoryBudget* memory_budget_ = nullptr;
 };
+
+// Instantiated once in quantile-tree.cc for the most common entry types,
+// instead of in every translation unit that uses them.
+extern template class QuantileTree<int64_t>;
+extern template class QuantileTree<double>;
+
 }  // namespace differential_privacy
 
 #endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_QUANTILE_TREE_H_
@@ -16,14 +16,20 @@
 
 #include "algorithms/quantile-tree.h"
 
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <vector>
 
 #include "base/testing/proto_matchers.h"
 #include "base/testing/status_matchers.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/log/check.h"
 #include "absl/random/random.h"
+#include "algorithms/internal/count-tree.h"
 #include "algorithms/numerical-mechanisms-testing.h"
+#include "base/instrumentation.h"
 #include "proto/confidence-interval.pb.h"
 
 namespace differential_privacy {
@@ -45,6 +51,43 @@ using ::differential_privacy::test_utils::ZeroNoiseMechanism;
 using ::testing::HasSubstr;
 using ::differential_privacy::base::testing::StatusIs;
 
+// Zero noise mechanism that counts the number of values it has noised.
+class CountingZeroNoiseMechanism : public ZeroNoiseMechanism {
+ public:
+  class Builder : public NumericalMechanismBuilder {
+   public:
+    explicit Builder(int* num_noised) : num_noised_(num_noised) {}
+
+    absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override {
+      return std::make_unique<CountingZeroNoiseMechanism>(num_noised_);
+    }
+
+    std::unique_ptr<NumericalMechanismBuilder> Clone() const override {
+      return std::make_unique<Builder>(*this);
+    }
+
+   private:
+    int* num_noised_;
+  };
+
+  explicit CountingZeroNoiseMechanism(int* num_noised)
+      : ZeroNoiseMechanism(1, 1), num_noised_(num_noised) {}
+
+  int64_t AddInt64Noise(int64_t result) override {
+    ++*num_noised_;
+    return result;
+  }
+
+  void AddInt64NoiseBatch(absl::Span<const int64_t> results,
+                          absl::Span<int64_t> noised_results) override {
+    *num_noised_ += results.size();
+    ZeroNoiseMechanism::AddInt64NoiseBatch(results, noised_results);
+  }
+
+ private:
+  int* num_noised_;
+};
+
 const double kTestDefaultEpsilon = 0.5;
 const double kDefaultDelta = 1e-5;
 const int kDefaultMaxContributionsPerPartition = 5;
@@ -803,6 +846,178 @@ TEST(QuantileTreeTest, TreeOverflowsWithNoise) {
   FAIL() << "No overflow occurred after 1e3 iterations.";
 }
 
+// Counts the mechanisms built by the wrapped builder.
+class CountingMechanismBuilder : public ZeroNoiseMechanism::Builder {
+ public:
+  explicit CountingMechanismBuilder(int* num_builds)
+      : num_builds_(num_builds) {}
+
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> Build() override {
+    ++*num_builds_;
+    return ZeroNoiseMechanism::Builder::Build();
+  }
+
+ private:
+  int* num_builds_;
+};
+
+TYPED_TEST(QuantileTreeTest, PrivatizationContextBuildsMechanismOnce) {
+  typename QuantileTree<TypeParam>::Builder builder;
+  builder.SetUpper(50).SetLower(-50).SetTreeHeight(3).SetBranchingFactor(10);
+  int num_builds = 0;
+  typename QuantileTree<TypeParam>::DPParams dp_params;
+  dp_params.epsilon = kTestDefaultEpsilon;
+  dp_params.delta = kDefaultDelta;
+  dp_params.max_contributions_per_partition =
+      kDefaultMaxContributionsPerPartition;
+  dp_params.max_partitions_contributed_to = kDefaultMaxPartitionsContributed;
+  dp_params.mechanism_builder =
+      std::make_unique<CountingMechanismBuilder>(&num_builds);
+
+  std::unique_ptr<QuantileTree<TypeParam>> first = builder.Build().value();
+  absl::StatusOr<typename QuantileTree<TypeParam>::PrivatizationContext>
+      context = first->MakePrivatizationContext(dp_params);
+  ASSERT_OK(context);
+  EXPECT_EQ(context->tree_height(), 3);
+  for (int i = 0; i < 10; ++i) {
+    std::unique_ptr<QuantileTree<TypeParam>> tree = builder.Build().value();
+    for (int j = 0; j < 100; ++j) {
+      tree->AddEntry(i * 5 - 25);
+    }
+    absl::StatusOr<typename QuantileTree<TypeParam>::Privatized> privatized =
+        tree->MakePrivate(*context);
+    ASSERT_OK(privatized);
+    EXPECT_NEAR(privatized->GetQuantile(0.5).value(), i * 5 - 25, 0.1);
+  }
+  EXPECT_EQ(num_builds, 1);
+
+  std::unique_ptr<QuantileTree<TypeParam>> other_height =
+      typename QuantileTree<TypeParam>::Builder()
+          .SetUpper(50)
+          .SetLower(-50)
+          .SetTreeHeight(4)
+          .Build()
+          .value();
+  EXPECT_THAT(other_height->MakePrivate(*context),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("height")));
+}
+
+TYPED_TEST(QuantileTreeTest, ComputeQuantilesMatchesPrivatized) {
+  typename QuantileTree<TypeParam>::Builder builder;
+  builder.SetUpper(50).SetLower(-50).SetTreeHeight(4).SetBranchingFactor(4);
+  typename QuantileTree<TypeParam>::DPParams dp_params;
+  dp_params.epsilon = kTestDefaultEpsilon;
+  dp_params.delta = kDefaultDelta;
+  dp_params.max_contributions_per_partition =
+      kDefaultMaxContributionsPerPartition;
+  dp_params.max_partitions_contributed_to = kDefaultMaxPartitionsContributed;
+  dp_params.mechanism_builder = std::make_unique<ZeroNoiseMechanism::Builder>();
+
+  std::vector<std::unique_ptr<QuantileTree<TypeParam>>> trees;
+  std::vector<const QuantileTree<TypeParam>*> tree_ptrs;
+  for (int i = 0; i < 5; ++i) {
+    trees.push_back(builder.Build().value());
+    for (int j = 0; j < 100 * (i + 1); ++j) {
+      trees.back()->AddEntry(j % (20 + 10 * i) - 25);
+    }
+    tree_ptrs.push_back(trees.back().get());
+  }
+  // An empty tree.
+  trees.push_back(builder.Build().value());
+  tree_ptrs.push_back(trees.back().get());
+  typename QuantileTree<TypeParam>::PrivatizationContext context =
+      trees[0]->MakePrivatizationContext(dp_params).value();
+
+  std::vector<double> results(tree_ptrs.size() * kQuantilesToTest.size());
+  ASSERT_OK(QuantileTree<TypeParam>::ComputeQuantiles(
+      tree_ptrs, kQuantilesToTest, context, absl::MakeSpan(results)));
+
+  for (int i = 0; i < tree_ptrs.size(); ++i) {
+    typename QuantileTree<TypeParam>::Privatized privatized =
+        trees[i]->MakePrivate(context).value();
+    for (int j = 0; j < kQuantilesToTest.size(); ++j) {
+      EXPECT_DOUBLE_EQ(results[j * tree_ptrs.size() + i],
+                       privatized.GetQuantile(kQuantilesToTest[j]).value())
+          << "tree " << i << ", quantile " << kQuantilesToTest[j];
+    }
+  }
+}
+
+TEST(QuantileTreeTest, ComputeQuantilesNoisesOncePerLevel) {
+  typename QuantileTree<double>::Builder builder;
+  builder.SetUpper(50).SetLower(-50).SetTreeHeight(4).SetBranchingFactor(10);
+  int num_noised = 0;
+  typename QuantileTree<double>::DPParams dp_params;
+  dp_params.epsilon = kTestDefaultEpsilon;
+  dp_params.delta = kDefaultDelta;
+  dp_params.max_contributions_per_partition =
+      kDefaultMaxContributionsPerPartition;
+  dp_params.max_partitions_contributed_to = kDefaultMaxPartitionsContributed;
+  dp_params.mechanism_builder =
+      std::make_unique<CountingZeroNoiseMechanism::Builder>(&num_noised);
+
+  std::vector<std::unique_ptr<QuantileTree<double>>> trees;
+  std::vector<const QuantileTree<double>*> tree_ptrs;
+  for (int i = 0; i < 20; ++i) {
+    trees.push_back(builder.Build().value());
+    for (int j = 0; j < 100; ++j) {
+      trees.back()->AddEntry(i);
+    }
+    tree_ptrs.push_back(trees.back().get());
+  }
+  typename QuantileTree<double>::PrivatizationContext context =
+      trees[0]->MakePrivatizationContext(dp_params).value();
+  // The values of every tree are in the same leaf, so all searches of a tree
+  // share their nodes.
+  const std::vector<double> quantiles = {0.1, 0.5, 0.9};
+  std::vector<double> results(tree_ptrs.size() * quantiles.size());
+
+  instrumentation::AggregatingSink sink;
+  instrumentation::SetSink(&sink);
+  ASSERT_OK(QuantileTree<double>::ComputeQuantiles(
+      tree_ptrs, quantiles, context, absl::MakeSpan(results)));
+  instrumentation::SetSink(nullptr);
+
+  EXPECT_EQ(sink.Get(instrumentation::Event::kMechanismAddNoise).calls, 4);
+  EXPECT_EQ(num_noised, 20 * 4 * 10);
+  for (int i = 0; i < tree_ptrs.size(); ++i) {
+    EXPECT_NEAR(results[tree_ptrs.size() + i], i, 0.1);
+  }
+}
+
+TEST(QuantileTreeTest, ComputeQuantilesInvalidArguments) {
+  typename QuantileTree<double>::Builder builder;
+  builder.SetUpper(50).SetLower(-50).SetTreeHeight(3);
+  typename QuantileTree<double>::DPParams dp_params;
+  dp_params.epsilon = kTestDefaultEpsilon;
+  dp_params.delta = kDefaultDelta;
+  dp_params.max_contributions_per_partition =
+      kDefaultMaxContributionsPerPartition;
+  dp_params.max_partitions_contributed_to = kDefaultMaxPartitionsContributed;
+  dp_params.mechanism_builder = std::make_unique<ZeroNoiseMechanism::Builder>();
+  std::unique_ptr<QuantileTree<double>> tree = builder.Build().value();
+  std::unique_ptr<QuantileTree<double>> other_height =
+      builder.SetTreeHeight(4).Build().value();
+  typename QuantileTree<double>::PrivatizationContext context =
+      tree->MakePrivatizationContext(dp_params).value();
+  std::vector<double> results(2);
+
+  EXPECT_THAT(
+      QuantileTree<double>::ComputeQuantiles(
+          {tree.get(), other_height.get()}, {0.5}, context,
+          absl::MakeSpan(results)),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("height")));
+  EXPECT_THAT(
+      QuantileTree<double>::ComputeQuantiles({tree.get()}, {0.5, 1.5},
+                                             context, absl::MakeSpan(results)),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("[0, 1]")));
+  EXPECT_THAT(
+      QuantileTree<double>::ComputeQuantiles({tree.get()}, {0.5}, context,
+                                             absl::MakeSpan(results)),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("results")));
+}
+
 TYPED_TEST(QuantileTreeTest, PrivatizedConstantWithExtraInput) {
   std::unique_ptr<QuantileTree<TypeParam>> test_quantiles =
       typename QuantileTree<TypeParam>::Builder()
@@ -1347,6 +1562,107 @@ TYPED_TEST(
       entries, builder, std::make_unique<LaplaceMechanism::Builder>());
 }
 
+// Returns the node counts of the serialized tree.
+template <typename T>
+std::map<int, int64_t> GetNodeCounts(QuantileTree<T>& tree) {
+  BoundedQuantilesSummary summary = tree.Serialize();
+  internal::CountTree count_tree(summary.tree_height(),
+                                 summary.branching_factor());
+  CHECK_OK(count_tree.Merge(summary));
+  std::map<int, int64_t> counts;
+  for (int node = 0; node < count_tree.GetNumberOfNodes(); ++node) {
+    if (count_tree.GetNodeCount(node) != 0) {
+      counts[node] = count_tree.GetNodeCount(node);
+    }
+  }
+  return counts;
+}
+
+TYPED_TEST(QuantileTreeTest, AddEntriesMatchesAddEntry) {
+  // Small batches are aggregated by sorting, batches with at least as many
+  // entries as leaves by a histogram over the leaves.
+  for (int num_entries : {1, 7, 100, 1000}) {
+    typename QuantileTree<TypeParam>::Builder builder;
+    builder.SetUpper(50).SetLower(-50).SetTreeHeight(3).SetBranchingFactor(5);
+    std::unique_ptr<QuantileTree<TypeParam>> one_by_one =
+        builder.Build().value();
+    std::unique_ptr<QuantileTree<TypeParam>> batched = builder.Build().value();
+
+    std::vector<TypeParam> entries;
+    for (int i = 0; i < num_entries; ++i) {
+      // Also covers entries outside of the bounds.
+      entries.push_back(static_cast<TypeParam>((i * 37) % 121 - 60));
+    }
+    for (const TypeParam& entry : entries) {
+      one_by_one->AddEntry(entry);
+    }
+    batched->AddEntries(entries);
+
+    EXPECT_EQ(GetNodeCounts(*batched), GetNodeCounts(*one_by_one))
+        << "num_entries: " << num_entries;
+  }
+}
+
+TEST(QuantileTreeTest, AddEntriesIgnoresNaN) {
+  std::unique_ptr<QuantileTree<double>> test_quantiles =
+      typename QuantileTree<double>::Builder()
+          .SetUpper(50)
+          .SetLower(-50)
+          .Build()
+          .value();
+
+  test_quantiles->AddEntries({std::nan(""), std::nan("")});
+  EXPECT_TRUE(GetNodeCounts(*test_quantiles).empty());
+
+  test_quantiles->AddEntries({std::nan(""), 5.0, std::nan("")});
+  std::map<int, int64_t> node_counts = GetNodeCounts(*test_quantiles);
+  EXPECT_EQ(node_counts.size(), kDefaultTreeHeight);
+  for (const auto& [node, count] : node_counts) {
+    EXPECT_EQ(count, 1);
+  }
+}
+
+TEST(QuantileTreeTest, PrivatizedNoisesEveryNodeAtMostOnce) {
+  std::unique_ptr<QuantileTree<double>> test_quantiles =
+      typename QuantileTree<double>::Builder()
+          .SetUpper(50)
+          .SetLower(-50)
+          .SetTreeHeight(4)
+          .SetBranchingFactor(10)
+          .Build()
+          .value();
+  for (int i = 0; i < kDefaultDatasetSize; ++i) {
+    test_quantiles->AddEntry(i % 100 - 50);
+  }
+
+  int num_noised = 0;
+  typename QuantileTree<double>::DPParams dp_params;
+  dp_params.epsilon = kTestDefaultEpsilon;
+  dp_params.delta = kDefaultDelta;
+  dp_params.max_contributions_per_partition =
+      kDefaultMaxContributionsPerPartition;
+  dp_params.max_partitions_contributed_to = kDefaultMaxPartitionsContributed;
+  dp_params.mechanism_builder =
+      std::make_unique<CountingZeroNoiseMechanism::Builder>(&num_noised);
+  typename QuantileTree<double>::Privatized privatized =
+      test_quantiles->MakePrivate(dp_params).value();
+
+  // The search for a single quantile visits the children of one node per
+  // level.
+  ASSERT_OK(privatized.GetQuantile(0.5));
+  EXPECT_EQ(num_noised, 4 * 10);
+  ASSERT_OK(privatized.GetQuantile(0.5));
+  ASSERT_OK(privatized.ComputeNoiseConfidenceInterval(0.5, 0.95));
+  EXPECT_EQ(num_noised, 4 * 10);
+
+  for (int i = 0; i <= 100; ++i) {
+    ASSERT_OK(privatized.GetQuantile(i / 100.0));
+    ASSERT_OK(privatized.ComputeNoiseConfidenceInterval(i / 100.0, 0.95));
+  }
+  // Every node except for the root is noised at most once.
+  EXPECT_LE(num_noised, 1 + 10 + 100 + 1000 + 10000 - 1);
+}
+
 TYPED_TEST(QuantileTreeTest, MemoryUsed) {
   std::unique_ptr<QuantileTree<TypeParam>> empty =
       typename QuantileTree<TypeParam>::Builder()
@@ -1380,5 +1696,48 @@ TYPED_TEST(QuantileTreeTest, MemoryUsed) {
   EXPECT_EQ(once->MemoryUsed(), twice->MemoryUsed());
 }
 
+TEST(QuantileTreeTest, MakePrivateViewMatchesMakePrivate) {
+  std::unique_ptr<QuantileTree<double>> test_quantiles =
+      typename QuantileTree<double>::Builder()
+          .SetUpper(50)
+          .SetLower(-50)
+          .SetTreeHeight(3)
+          .SetBranchingFactor(10)
+          .Build()
+          .value();
+  for (int i = 0; i < kDefaultDatasetSize; ++i) {
+    test_quantiles->AddEntry(i % 100 - 50);
+  }
+  auto make_params = []() {
+    typename QuantileTree<double>::DPParams dp_params;
+    dp_params.epsilon = kTestDefaultEpsilon;
+    dp_params.delta = kDefaultDelta;
+    dp_params.max_contributions_per_partition =
+        kDefaultMaxContributionsPerPartition;
+    dp_params.max_partitions_contributed_to = kDefaultMaxPartitionsContributed;
+    dp_params.mechanism_builder =
+        std::make_unique<ZeroNoiseMechanism::Builder>();
+    return dp_params;
+  };
+
+  typename QuantileTree<double>::Privatized copy =
+      test_quantiles->MakePrivate(make_params()).value();
+  double expected_quantile;
+  {
+    typename QuantileTree<double>::Privatized view =
+        test_quantiles->MakePrivateView(make_params()).value();
+    for (int i = 0; i <= 10; ++i) {
+      EXPECT_EQ(view.GetQuantile(i / 10.0).value(),
+                copy.GetQuantile(i / 10.0).value());
+    }
+    expected_quantile = view.GetQuantile(0.37).value();
+  }
+
+  // The copy does not depend on the tree anymore, also after being moved.
+  test_quantiles->Reset();
+  typename QuantileTree<double>::Privatized moved = std::move(copy);
+  EXPECT_EQ(moved.GetQuantile(0.37).value(), expected_quantile);
+}
+
 }  // namespace
 }  // namespace differential_privacy
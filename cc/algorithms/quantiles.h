@@ -22,9 +22,12 @@
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "algorithms/algorithm.h"
 #include "algorithms/bounded-algorithm.h"
 #include "algorithms/quantile-tree.h"
+#include "base/instrumentation.h"
+#include "base/memory_budget.h"
 
 namespace differential_privacy {
 
@@ -49,13 +52,26 @@ class Quantiles : public Algorithm<T> {
 
   void AddEntry(const T& t) override { return tree_->AddEntry(t); }
 
+  using Algorithm<T>::AddEntries;
+
+  // Adds all entries at once. Produces the same state as adding the entries
+  // one by one, but updates the underlying quantile tree once per batch
+  // instead of once per entry, see QuantileTree::AddEntries.
+  void AddEntries(absl::Span<const T> entries) override {
+    tree_->AddEntries(entries);
+  }
+
   Summary Serialize() const override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmSerialize);
     Summary to_return;
     to_return.mutable_data()->PackFrom(tree_->Serialize());
     return to_return;
   }
 
   absl::Status Merge(const Summary& summary) {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
     if (!summary.has_data()) {
       return absl::InternalError(
           "Cannot merge summary with no bounded quantiles data");
@@ -69,6 +85,16 @@ class Quantiles : public Algorithm<T> {
     return tree_->Merge(quantiles_summary);
   }
 
+  absl::Status MergeFrom(const Algorithm<T>& other) override {
+    instrumentation::ScopedEvent event(
+        instrumentation::Event::kAlgorithmMerge);
+    const auto* other_quantiles = dynamic_cast<const Quantiles<T>*>(&other);
+    if (other_quantiles == nullptr) {
+      return Algorithm<T>::MergeFrom(other);
+    }
+    return tree_->MergeFrom(*other_quantiles->tree_);
+  }
+
   int64_t MemoryUsed() override {
     return tree_->MemoryUsed() + sizeof(Quantiles<T>) +
            sizeof(NumericalMechanismBuilder) +
@@ -87,8 +113,10 @@ class Quantiles : public Algorithm<T> {
         max_contributions_per_partition_;
     dp_params.max_partitions_contributed_to = max_partitions_contributed_to_;
     dp_params.mechanism_builder = mechanism_builder_->Clone();
+    // The privatized tree is only used within this call, during which tree_
+    // is not modified, so it can read the counts of tree_ without a copy.
     absl::StatusOr<typename QuantileTree<T>::Privatized> result =
-        tree_->MakePrivate(dp_params);
+        tree_->MakePrivateView(dp_params);
     if (!result.ok()) {
       return result.status();
     }
@@ -177,6 +205,15 @@ class Quantiles<T>::Builder {
     return *this;
   }
 
+  // Accounts the quantile tree to a memory budget shared with other
+  // algorithms. While the budget asks for compact storage, new trees store
+  // their counts sparsely, which is much smaller for partitions with few
+  // entries. The budget must outlive the built Quantiles.
+  Quantiles<T>::Builder& SetMemoryBudget(base::MemoryBudget* memory_budget) {
+    memory_budget_ = memory_budget;
+    return *this;
+  }
+
   // The list of quantiles to be produced. It is required; the algorithm will
   // fail to build without a list of quantiles. If this method is called
   // more than once, it will overwrite any previous list of quantiles rather
@@ -222,6 +259,7 @@ class Quantiles<T>::Builder {
     if (upper_.has_value()) {
       tree_builder.SetUpper(upper_.value());
     }
+    tree_builder.SetMemoryBudget(memory_budget_);
     ASSIGN_OR_RETURN(std::unique_ptr<QuantileTree<T>> tree,
                      tree_builder.Build());
 
@@ -241,6 +279,7 @@ class Quantiles<T>::Builder {
   std::unique_ptr<NumericalMechanismBuilder> mechanism_builder_ =
       absl::make_unique<LaplaceMechanism::Builder>();
   std::vector<double> quantiles_;
+  base::MemoryBudget* memory_budget_ = nullptr;
 
   static absl::Status ValidateQuantiles(std::vector<double>& quantiles) {
     if (quantiles.empty()) {
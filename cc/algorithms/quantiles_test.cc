@@ -22,6 +22,7 @@
 #include <memory>
 #include <vector>
 
+#include "base/memory_budget.h"
 #include "base/testing/proto_matchers.h"
 #include "base/testing/status_matchers.h"
 #include "gmock/gmock.h"
@@ -299,6 +300,50 @@ TEST(QuantilesTest, MergeFailsWithBadBounds) {
               StatusIs(absl::StatusCode::kInternal, HasSubstr("Bounds")));
 }
 
+TYPED_TEST(QuantilesTest, MergeFromMatchesMerge) {
+  typename Quantiles<TypeParam>::Builder builder;
+  builder.SetUpper(50).SetLower(-50).SetQuantiles({0.1, 0.5, 0.9});
+  absl::StatusOr<std::unique_ptr<Quantiles<TypeParam>>> q1 = builder.Build();
+  ASSERT_OK(q1);
+  absl::StatusOr<std::unique_ptr<Quantiles<TypeParam>>> q2 = builder.Build();
+  ASSERT_OK(q2);
+  absl::StatusOr<std::unique_ptr<Quantiles<TypeParam>>> q3 = builder.Build();
+  ASSERT_OK(q3);
+
+  absl::BitGen gen;
+  for (int i = 0; i < kDefaultDatasetSize; ++i) {
+    (*q1)->AddEntry(absl::Uniform(gen, -25, 25));
+  }
+  (*q2)->AddEntry(10);
+  (*q3)->AddEntry(10);
+
+  EXPECT_OK((*q2)->MergeFrom(**q1));
+  EXPECT_OK((*q3)->Merge((*q1)->Serialize()));
+  EXPECT_THAT((*q2)->Serialize(),
+              ::differential_privacy::base::testing::EqualsProto(
+                  (*q3)->Serialize()));
+}
+
+TEST(QuantilesTest, MergeFromFailsWithBadBounds) {
+  std::unique_ptr<Quantiles<double>> test_quantiles =
+      typename Quantiles<double>::Builder()
+          .SetUpper(50)
+          .SetLower(-50)
+          .SetQuantiles({0.5})
+          .Build()
+          .value();
+  std::unique_ptr<Quantiles<double>> wrong_lower =
+      typename Quantiles<double>::Builder()
+          .SetUpper(50)
+          .SetLower(-49)
+          .SetQuantiles({0.5})
+          .Build()
+          .value();
+
+  EXPECT_THAT(wrong_lower->MergeFrom(*test_quantiles),
+              StatusIs(absl::StatusCode::kInternal, HasSubstr("Bounds")));
+}
+
 TYPED_TEST(QuantilesTest, MergeInDifferentOrderReturnsSameProto) {
   std::vector<double> quantiles = {0.3, 0.5, 0.9};
   absl::StatusOr<std::unique_ptr<Quantiles<TypeParam>>> q1 =
@@ -386,6 +431,34 @@ TEST(QuantilesTest, IgnoresNaN) {
   EXPECT_THAT(results1, ::differential_privacy::base::testing::EqualsProto(results2));
 }
 
+TYPED_TEST(QuantilesTest, AddEntriesMatchesAddEntry) {
+  std::vector<double> quantiles;
+  for (int i = 0; i < kNumRanksToTest; ++i) {
+    quantiles.push_back(static_cast<double>(i) / kNumRanksToTest);
+  }
+  typename Quantiles<TypeParam>::Builder builder;
+  builder.SetUpper(50)
+      .SetLower(-50)
+      .SetQuantiles(quantiles)
+      .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>());
+  std::unique_ptr<Quantiles<TypeParam>> one_by_one = builder.Build().value();
+  std::unique_ptr<Quantiles<TypeParam>> batched = builder.Build().value();
+
+  absl::BitGen gen;
+  std::vector<TypeParam> inputs;
+  for (int i = 0; i < kDefaultDatasetSize; ++i) {
+    inputs.push_back(absl::Uniform(gen, -25, 25));
+  }
+
+  for (TypeParam input : inputs) {
+    one_by_one->AddEntry(input);
+  }
+  batched->AddEntries(inputs);
+
+  EXPECT_THAT(batched->PartialResult().value(),
+              EqualsProto(one_by_one->PartialResult().value()));
+}
+
 TYPED_TEST(QuantilesTest, MemoryUsed) {
   std::unique_ptr<Quantiles<TypeParam>> empty =
       typename Quantiles<TypeParam>::Builder()
@@ -416,6 +489,35 @@ TYPED_TEST(QuantilesTest, MemoryUsed) {
   EXPECT_EQ(once->MemoryUsed(), twice->MemoryUsed());
 }
 
+TYPED_TEST(QuantilesTest, CompactsUnderMemoryPressure) {
+  base::MemoryBudget budget(/*limit=*/1 << 20);
+  auto build = [&budget]() {
+    return typename Quantiles<TypeParam>::Builder()
+        .SetUpper(50)
+        .SetLower(-50)
+        .SetQuantiles({0.25, 0.5, 0.75})
+        .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+        .SetMemoryBudget(&budget)
+        .Build()
+        .value();
+  };
+  std::unique_ptr<Quantiles<TypeParam>> dense = build();
+  dense->AddEntries({-10, 0, 10});
+  // The dense counts are allocated from the budget.
+  EXPECT_GT(budget.bytes_used(), dense->MemoryUsed() / 2);
+  EXPECT_LT(budget.bytes_used(), dense->MemoryUsed());
+
+  // Quantiles built under memory pressure store their trees sparsely, with the
+  // same results.
+  budget.Charge(budget.limit());
+  std::unique_ptr<Quantiles<TypeParam>> compact = build();
+  compact->AddEntries({-10, 0, 10});
+
+  EXPECT_LT(compact->MemoryUsed(), dense->MemoryUsed() / 10);
+  EXPECT_THAT(compact->PartialResult().value(),
+              EqualsProto(dense->PartialResult().value()));
+}
+
 TYPED_TEST(QuantilesTest, Reset) {
   std::vector<double> quantiles;
   for (int i = 0; i < kNumRanksToTest; ++i) {
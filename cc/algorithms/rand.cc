@@ -16,18 +16,32 @@
 
 #include "algorithms/rand.h"
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <limits>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
+#include "algorithms/internal/cpu-dispatch.h"
+
+#if defined(DP_CPU_DISPATCH_X86)
+#include <immintrin.h>
+#elif defined(DP_CPU_DISPATCH_NEON)
+#include <arm_neon.h>
+#endif
 
-#include "absl/base/const_init.h"
 #include "absl/base/optimization.h"
 #include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/numeric/bits.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "base/instrumentation.h"
 #include "openssl/rand.h"
 
 namespace differential_privacy {
@@ -42,11 +56,9 @@ static_assert(sizeof(double) == sizeof(uint64_t) &&
 const constexpr int kMantDigits = DBL_MANT_DIG - 1;
 const constexpr uint64_t kMantissaMask = (uint64_t{1} << kMantDigits) - 1ULL;
 
-ABSL_CONST_INIT absl::Mutex global_mutex(absl::kConstInit);
-}  // namespace
-
-double UniformDouble() {
-  uint64_t uint_64_number = SecureURBG::GetInstance()();
+// Converts a random word into a uniform double as documented for
+// UniformDouble().
+double UniformDoubleFromBits(uint64_t uint_64_number) {
   // A random integer of Uniform[0, 2^kMantDigits).
   uint64_t i = uint_64_number & kMantissaMask;
 
@@ -75,6 +87,70 @@ double UniformDouble() {
   return r;
 }
 
+// Branch-free version of UniformDoubleFromBits for words whose leading 12
+// bits j are not all zero.
+//
+// The number of leading zeros of j is computed without a count-leading-zeros
+// instruction, which SIMD units lack: j is converted exactly to a double by
+// placing it in the mantissa of 2^52 and subtracting 2^52; the biased exponent
+// of that double is 1023 + floor(log2(j)). UniformDoubleFromBits uses the
+// exponent 1023 - (12 - floor(log2(j))), i.e., the biased exponent of j minus
+// 12. The mantissa bits are copied unchanged.
+constexpr uint64_t kTwoPow52Bits = uint64_t{0x4330000000000000};
+constexpr double kTwoPow52 = 4503599627370496.0;
+constexpr uint64_t kExponentShift = 12;
+
+inline double UniformDoubleFromNonZeroLeadingBits(uint64_t uint_64_number) {
+  uint64_t j_bits = kTwoPow52Bits | (uint_64_number >> kMantDigits);
+  double j_double;
+  std::memcpy(&j_double, &j_bits, sizeof(j_double));
+  j_double -= kTwoPow52;
+  std::memcpy(&j_bits, &j_double, sizeof(j_bits));
+  uint64_t result = (((j_bits >> kMantDigits) - kExponentShift) << kMantDigits) +
+                    (uint_64_number & kMantissaMask);
+  double r;
+  std::memcpy(&r, &result, sizeof(r));
+  return r;
+}
+
+// Number of random words converted per block by FillUniformDoubles.
+constexpr size_t kUniformDoubleBlockSize = 256;
+
+// Source that replaces OpenSSL on the current thread, if any. Set by
+// ScopedRandomSource.
+thread_local RandomSource* random_source = nullptr;
+
+// Set by SecureURBG::SetBackgroundRefresh.
+std::atomic<bool> background_refresh{false};
+
+void FillWithRandomBytes(uint8_t* bytes, int size) {
+  instrumentation::ScopedEvent event(
+      instrumentation::Event::kSecureUrbgRefreshBuffer, size);
+  int one_on_success = RAND_bytes(bytes, size);
+  CHECK(one_on_success == 1)
+      << "Error during buffer refresh: OpenSSL's RAND_byte is expected to "
+         "return 1 on success, but returned "
+      << one_on_success;
+}
+
+}  // namespace
+
+double UniformDouble() {
+  return UniformDoubleFromBits(SecureURBG::GetInstance()());
+}
+
+void FillUniformDoubles(absl::Span<double> out) {
+  uint64_t bits[kUniformDoubleBlockSize];
+  SecureURBG& urbg = SecureURBG::GetInstance();
+  while (!out.empty()) {
+    const size_t block_size = std::min(out.size(), kUniformDoubleBlockSize);
+    absl::Span<uint64_t> block(bits, block_size);
+    urbg.Fill(block);
+    internal::UniformDoublesFromBits(block, out.subspan(0, block_size));
+    out.remove_prefix(block_size);
+  }
+}
+
 uint64_t Geometric() {
   uint64_t result = 1;
   uint64_t r = 0;
@@ -86,33 +162,318 @@ uint64_t Geometric() {
 }
 
 SecureURBG& SecureURBG::GetInstance() {
-
+  // SecureURBG carries no state of its own; the random bytes live in per-thread
+  // buffers, so sharing the instance across threads is safe.
   static auto* kInstance = new SecureURBG;
   return *kInstance;
 }
 
+SecureURBG::Buffer& SecureURBG::GetThreadBuffer() {
+  thread_local Buffer buffer;
+  return buffer;
+}
+
 SecureURBG::result_type SecureURBG::operator()() {
-  absl::WriterMutexLock lock(&mutex_);
-  if (current_index_ + sizeof(result_type) > kBufferSize) {
-    RefreshBuffer();
+  if (ABSL_PREDICT_FALSE(random_source != nullptr)) {
+    return random_source->Next();
+  }
+  return NextWord(GetThreadBuffer());
+}
+
+void SecureURBG::Fill(absl::Span<result_type> out) {
+  if (ABSL_PREDICT_FALSE(random_source != nullptr)) {
+    random_source->Fill(out);
+    return;
+  }
+  FillFromBuffer(GetThreadBuffer(), out);
+}
+
+SecureURBG::result_type SecureURBG::NextWord(Buffer& buffer) {
+  if (buffer.current_index + sizeof(result_type) > kBufferSize) {
+    RefreshBuffer(buffer);
   }
-  int old_index = current_index_;
-  current_index_ += sizeof(result_type);
+  int old_index = buffer.current_index;
+  buffer.current_index += sizeof(result_type);
   result_type result;
-  std::memcpy(&result, buffer_ + old_index, sizeof(result_type));
+  std::memcpy(&result, buffer.bytes + old_index, sizeof(result_type));
   return result;
 }
 
-void SecureURBG::RefreshBuffer() {
-  int one_on_success = 0;
-  {
-    absl::MutexLock lock(&global_mutex);
-    one_on_success = RAND_bytes(buffer_, kBufferSize);
+void SecureURBG::FillFromBuffer(Buffer& buffer, absl::Span<result_type> out) {
+  while (!out.empty()) {
+    if (buffer.current_index + sizeof(result_type) > kBufferSize) {
+      RefreshBuffer(buffer);
+    }
+    const size_t available =
+        (kBufferSize - buffer.current_index) / sizeof(result_type);
+    const size_t count = std::min(available, out.size());
+    std::memcpy(out.data(), buffer.bytes + buffer.current_index,
+                count * sizeof(result_type));
+    buffer.current_index += count * sizeof(result_type);
+    out.remove_prefix(count);
+  }
+}
+
+// Fills the spare blocks of the buffers queued by RefreshBuffer, one at a time
+// and in order. The refresher and its thread live until the process exits.
+class SecureURBG::Refresher {
+ public:
+  static Refresher& Get() {
+    static auto* kRefresher = new Refresher;
+    return *kRefresher;
+  }
+
+  // Queues buffer to have its spare block filled. buffer must not be queued
+  // already, and its spare block must not be ready.
+  void Enqueue(Buffer* buffer) {
+    absl::MutexLock lock(&mutex_);
+    queue_.push_back(buffer);
+  }
+
+  // Makes sure that the refresher does not touch buffer anymore, waiting for a
+  // fill in progress to finish if needed.
+  void Cancel(Buffer* buffer) {
+    absl::MutexLock lock(&mutex_);
+    queue_.erase(std::remove(queue_.begin(), queue_.end(), buffer),
+                 queue_.end());
+    while (in_flight_ == buffer) {
+      filled_.Wait(&mutex_);
+    }
+  }
+
+ private:
+  Refresher() { std::thread(&Refresher::Run, this).detach(); }
+
+  void Run() {
+    while (true) {
+      Buffer* buffer;
+      {
+        absl::MutexLock lock(&mutex_);
+        if (in_flight_ != nullptr) {
+          in_flight_ = nullptr;
+          filled_.SignalAll();
+        }
+        mutex_.Await(absl::Condition(this, &Refresher::HasWork));
+        buffer = queue_.front();
+        queue_.pop_front();
+        in_flight_ = buffer;
+      }
+      FillWithRandomBytes(buffer->spare, kBufferSize);
+      buffer->spare_ready.store(true, std::memory_order_release);
+    }
+  }
+
+  bool HasWork() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return !queue_.empty();
+  }
+
+  absl::Mutex mutex_;
+  std::deque<Buffer*> queue_ ABSL_GUARDED_BY(mutex_);
+  // The buffer whose spare block is being filled, if any.
+  Buffer* in_flight_ ABSL_GUARDED_BY(mutex_) = nullptr;
+  // Signaled when in_flight_ is reset.
+  absl::CondVar filled_;
+};
+
+SecureURBG::Buffer::~Buffer() {
+  if (spare != nullptr) {
+    Refresher::Get().Cancel(this);
+    delete[] spare;
+  }
+  delete[] bytes;
+}
+
+void SecureURBG::SetBackgroundRefresh(bool enabled) {
+  background_refresh.store(enabled, std::memory_order_relaxed);
+}
+
+void SecureURBG::WarmUp() {
+  GetInstance();
+  Buffer& buffer = GetThreadBuffer();
+  if (buffer.current_index + sizeof(result_type) > kBufferSize) {
+    buffer.refreshed = true;
+    RefreshBuffer(buffer);
+  }
+}
+
+void SecureURBG::RefreshBuffer(Buffer& buffer) {
+  // RAND_bytes is thread safe, so each thread refreshes its own buffer without
+  // coordinating with the others.
+  buffer.current_index =
+      buffer.refreshed ? 0 : kBufferSize - kInitialRefreshSize;
+  buffer.refreshed = true;
+  if (!background_refresh.load(std::memory_order_relaxed)) {
+    FillWithRandomBytes(buffer.bytes + buffer.current_index,
+                        kBufferSize - buffer.current_index);
+    return;
+  }
+  if (buffer.spare == nullptr) {
+    // Value-initializing the block writes it from this thread, which places
+    // its pages on the NUMA node of this thread.
+    buffer.spare = new uint8_t[kBufferSize]();
+    FillWithRandomBytes(buffer.bytes + buffer.current_index,
+                        kBufferSize - buffer.current_index);
+  } else if (buffer.spare_ready.load(std::memory_order_acquire)) {
+    std::swap(buffer.bytes, buffer.spare);
+    buffer.spare_ready.store(false, std::memory_order_relaxed);
+  } else {
+    // The refresher has not caught up, and the spare block is still queued.
+    FillWithRandomBytes(buffer.bytes, kBufferSize);
+    return;
+  }
+  Refresher::Get().Enqueue(&buffer);
+}
+
+void RandomSource::Fill(absl::Span<uint64_t> out) {
+  for (uint64_t& word : out) {
+    word = Next();
+  }
+}
+
+ScopedRandomSource::ScopedRandomSource(RandomSource* source)
+    : previous_(nullptr),
+      active_(source != nullptr && source != random_source) {
+  if (active_) {
+    previous_ = random_source;
+    random_source = source;
+    ++internal::random_source_generation;
+  }
+}
+
+ScopedRandomSource::~ScopedRandomSource() {
+  if (active_) {
+    random_source = previous_;
+    ++internal::random_source_generation;
   }
-  CHECK(one_on_success == 1)
-      << "Error during buffer refresh: OpenSSL's RAND_byte is expected to "
-         "return 1 on success, but returned "
-      << one_on_success;
-  current_index_ = 0;
 }
+
+namespace internal {
+
+thread_local uint64_t random_source_generation = 0;
+
+namespace {
+
+// Every kernel converts a prefix of the words, assuming that their leading
+// bits are not all zero, and returns the length of the prefix.
+using UniformDoublesKernel = size_t (*)(const uint64_t*, size_t, double*);
+
+size_t ScalarUniformDoubles(const uint64_t* bits, size_t size, double* out) {
+  return 0;
+}
+
+#if defined(DP_CPU_DISPATCH_X86)
+DP_TARGET_AVX512 size_t Avx512UniformDoubles(const uint64_t* bits,
+                                             size_t size, double* out) {
+  const __m512i two_pow_52_bits =
+      _mm512_set1_epi64(static_cast<int64_t>(kTwoPow52Bits));
+  const __m512d two_pow_52 = _mm512_set1_pd(kTwoPow52);
+  const __m512i exponent_shift =
+      _mm512_set1_epi64(static_cast<int64_t>(kExponentShift));
+  const __m512i mantissa_mask =
+      _mm512_set1_epi64(static_cast<int64_t>(kMantissaMask));
+  size_t k = 0;
+  for (; k + 8 <= size; k += 8) {
+    __m512i words = _mm512_loadu_si512(bits + k);
+    __m512d j_double = _mm512_sub_pd(
+        _mm512_castsi512_pd(_mm512_or_si512(
+            two_pow_52_bits, _mm512_srli_epi64(words, kMantDigits))),
+        two_pow_52);
+    __m512i exponent = _mm512_slli_epi64(
+        _mm512_sub_epi64(
+            _mm512_srli_epi64(_mm512_castpd_si512(j_double), kMantDigits),
+            exponent_shift),
+        kMantDigits);
+    __m512i result =
+        _mm512_add_epi64(exponent, _mm512_and_si512(words, mantissa_mask));
+    _mm512_storeu_pd(out + k, _mm512_castsi512_pd(result));
+  }
+  return k;
+}
+
+DP_TARGET_AVX2 size_t Avx2UniformDoubles(const uint64_t* bits, size_t size,
+                                         double* out) {
+  const __m256i two_pow_52_bits =
+      _mm256_set1_epi64x(static_cast<int64_t>(kTwoPow52Bits));
+  const __m256d two_pow_52 = _mm256_set1_pd(kTwoPow52);
+  const __m256i exponent_shift =
+      _mm256_set1_epi64x(static_cast<int64_t>(kExponentShift));
+  const __m256i mantissa_mask =
+      _mm256_set1_epi64x(static_cast<int64_t>(kMantissaMask));
+  size_t k = 0;
+  for (; k + 4 <= size; k += 4) {
+    __m256i words =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bits + k));
+    __m256d j_double = _mm256_sub_pd(
+        _mm256_castsi256_pd(_mm256_or_si256(
+            two_pow_52_bits, _mm256_srli_epi64(words, kMantDigits))),
+        two_pow_52);
+    __m256i exponent = _mm256_slli_epi64(
+        _mm256_sub_epi64(
+            _mm256_srli_epi64(_mm256_castpd_si256(j_double), kMantDigits),
+            exponent_shift),
+        kMantDigits);
+    __m256i result =
+        _mm256_add_epi64(exponent, _mm256_and_si256(words, mantissa_mask));
+    _mm256_storeu_pd(out + k, _mm256_castsi256_pd(result));
+  }
+  return k;
+}
+#elif defined(DP_CPU_DISPATCH_NEON)
+size_t NeonUniformDoubles(const uint64_t* bits, size_t size, double* out) {
+  const uint64x2_t two_pow_52_bits = vdupq_n_u64(kTwoPow52Bits);
+  const float64x2_t two_pow_52 = vdupq_n_f64(kTwoPow52);
+  const uint64x2_t exponent_shift = vdupq_n_u64(kExponentShift);
+  const uint64x2_t mantissa_mask = vdupq_n_u64(kMantissaMask);
+  size_t k = 0;
+  for (; k + 2 <= size; k += 2) {
+    uint64x2_t words = vld1q_u64(bits + k);
+    float64x2_t j_double = vsubq_f64(
+        vreinterpretq_f64_u64(
+            vorrq_u64(two_pow_52_bits, vshrq_n_u64(words, kMantDigits))),
+        two_pow_52);
+    uint64x2_t exponent = vshlq_n_u64(
+        vsubq_u64(vshrq_n_u64(vreinterpretq_u64_f64(j_double), kMantDigits),
+                  exponent_shift),
+        kMantDigits);
+    uint64x2_t result = vaddq_u64(exponent, vandq_u64(words, mantissa_mask));
+    vst1q_f64(out + k, vreinterpretq_f64_u64(result));
+  }
+  return k;
+}
+#endif
+
+UniformDoublesKernel GetUniformDoublesKernel() {
+  static const KernelDispatch<UniformDoublesKernel> kernel =
+      KernelDispatch<UniformDoublesKernel>(&ScalarUniformDoubles)
+#if defined(DP_CPU_DISPATCH_X86)
+          .Register(Isa::kAvx2, &Avx2UniformDoubles)
+          .Register(Isa::kAvx512, &Avx512UniformDoubles)
+#elif defined(DP_CPU_DISPATCH_NEON)
+          .Register(Isa::kNeon, &NeonUniformDoubles)
+#endif
+      ;
+  return kernel.Get();
+}
+
+}  // namespace
+
+void UniformDoublesFromBits(absl::Span<const uint64_t> bits,
+                            absl::Span<double> out) {
+  DCHECK_EQ(bits.size(), out.size());
+  const size_t size = bits.size();
+  size_t k = GetUniformDoublesKernel()(bits.data(), size, out.data());
+  for (; k < size; ++k) {
+    out[k] = UniformDoubleFromNonZeroLeadingBits(bits[k]);
+  }
+  // The vectorized conversion is only correct if the leading 12 bits are not
+  // all zero, which happens with probability 2^-12 per word. Those words need
+  // additional geometric sampling and are fixed up here.
+  for (k = 0; k < size; ++k) {
+    if (ABSL_PREDICT_FALSE((bits[k] >> kMantDigits) == 0)) {
+      out[k] = UniformDoubleFromBits(bits[k]);
+    }
+  }
+}
+
+}  // namespace internal
 }  // namespace differential_privacy
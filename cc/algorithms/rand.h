@@ -17,11 +17,11 @@
 #ifndef DIFFERENTIAL_PRIVACY_ALGORITHMS_RAND_H_
 #define DIFFERENTIAL_PRIVACY_ALGORITHMS_RAND_H_
 
+#include <atomic>
 #include <cstdint>
 #include <limits>
 
-#include "absl/base/thread_annotations.h"
-#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 
 namespace differential_privacy {
 
@@ -30,10 +30,24 @@ namespace differential_privacy {
 // largest double value less than or equal to r.
 double UniformDouble();
 
+// Fills out with independent samples of UniformDouble(). Random bits are drawn
+// from SecureURBG in blocks and converted to doubles with a branch-free kernel
+// (using AVX2 or NEON when the library is compiled for them), so this is
+// considerably faster than calling UniformDouble() once per element. The
+// distribution of every element is exactly the one of UniformDouble().
+void FillUniformDoubles(absl::Span<double> out);
+
 // geometric returns a number randomly picked from a geometric distribution of
 // parameter 0.5. Will not exceed 1025.
 uint64_t Geometric();
 
+// Uniform random bit generator backed by OpenSSL's RAND_bytes.
+//
+// Random bytes are requested from OpenSSL in large blocks and cached. Each
+// thread owns its own cache, so drawing from the generator does not take any
+// lock on the hot path and noise generation scales with the number of threads.
+// The cryptographic guarantees are the same as calling RAND_bytes directly:
+// every byte is produced by OpenSSL and handed out exactly once.
 class SecureURBG {
  public:
   using result_type = uint64_t;
@@ -45,20 +59,146 @@ class SecureURBG {
   static constexpr result_type(max)() {
     return (std::numeric_limits<result_type>::max)();
   }
-  result_type operator()() ABSL_LOCKS_EXCLUDED(mutex_);
+  result_type operator()();
+
+  // Fills out with random words. Equivalent to calling operator() for every
+  // element, but copies the words from the cache in bulk.
+  void Fill(absl::Span<result_type> out);
+
+  // Size in bytes of the per-thread cache of random bytes.
+  static constexpr int kBufferSize = 65536;
+
+  // Number of random bytes of the first refresh of a cache. The first refresh
+  // only fills the end of the cache, so that the first draw of a thread, e.g.,
+  // the first noised result after a cold start, does not wait for a full
+  // block from OpenSSL. Later refreshes fill the whole cache.
+  static constexpr int kInitialRefreshSize = 4096;
+
+  // Initializes OpenSSL's random generator and fills the whole cache of the
+  // calling thread, so that later draws on this thread do not pay for them.
+  // Meant to be called at startup, before the first request, by servers that
+  // start often; calling it is never required. Does nothing if the cache of
+  // the calling thread already holds random bytes.
+  static void WarmUp();
+
+  // Enables or disables refreshing the caches in the background. When enabled,
+  // every cache gets a second block of random bytes that a background thread
+  // fills from OpenSSL while the first one is being consumed. A thread that
+  // reaches the end of its cache swaps in the prefilled block instead of
+  // calling RAND_bytes, which removes the refresh from the latency of the
+  // calling thread. If the prefilled block is not ready yet, the thread
+  // refreshes synchronously as usual rather than waiting.
+  //
+  // The second block is allocated and first written by the thread that owns
+  // the cache, so on NUMA machines its memory is local to that thread like the
+  // first one. Disabled by default; takes effect at the next refresh of each
+  // cache.
+  static void SetBackgroundRefresh(bool enabled);
 
  private:
-  SecureURBG() { buffer_ = new uint8_t[kBufferSize]; }
-  ~SecureURBG() { delete[] buffer_; }
+  // Per-thread cache of random bytes.
+  struct Buffer {
+    Buffer() : bytes(new uint8_t[kBufferSize]) {}
+    ~Buffer();
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    // The current index in the cache.
+    int current_index = kBufferSize;
+    uint8_t* bytes;
+    // Whether the cache was refreshed before; see kInitialRefreshSize.
+    bool refreshed = false;
+    // Block prefilled by the background refresher, or null if background
+    // refresh was never used for this cache.
+    uint8_t* spare = nullptr;
+    // Set by the background refresher once spare holds fresh bytes.
+    std::atomic<bool> spare_ready{false};
+  };
+
+  // Background thread that prefills the spare blocks.
+  class Refresher;
+
+  SecureURBG() = default;
+  ~SecureURBG() = default;
+
+  // Returns the cache of the calling thread.
+  static Buffer& GetThreadBuffer();
+
   // Refresh the cache with new random bytes.
-  void RefreshBuffer() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void RefreshBuffer(Buffer& buffer);
 
-  static constexpr int kBufferSize = 65536;
-  // The current index in the cache.
-  int current_index_ ABSL_GUARDED_BY(mutex_) = kBufferSize;
-  uint8_t* buffer_ ABSL_GUARDED_BY(mutex_);
-  absl::Mutex mutex_;
+  // Draw words from a cache, refreshing it as needed.
+  static result_type NextWord(Buffer& buffer);
+  static void FillFromBuffer(Buffer& buffer, absl::Span<result_type> out);
+
+  friend class SecureRandomSource;
 };
+
+// Source of uniformly random 64-bit words. The builders of the distributions,
+// numerical mechanisms and partition selection strategies accept a source to
+// draw from instead of the per-thread caches of SecureURBG, e.g., to give every
+// worker thread a dedicated buffer. Sources are not thread safe unless an
+// implementation says otherwise, so an object built with a source must only be
+// used by one thread at a time.
+class RandomSource {
+ public:
+  virtual ~RandomSource() = default;
+
+  virtual uint64_t Next() = 0;
+
+  // Fills out with random words. Same as calling Next() for every element.
+  virtual void Fill(absl::Span<uint64_t> out);
+};
+
+// RandomSource with its own cache of bytes from OpenSSL's RAND_bytes, with the
+// same guarantees as SecureURBG. The cache is allocated by the thread that
+// creates the source, so creating the source on the worker thread that uses it
+// keeps the cache in memory close to that thread.
+class SecureRandomSource : public RandomSource {
+ public:
+  uint64_t Next() override { return SecureURBG::NextWord(buffer_); }
+
+  void Fill(absl::Span<uint64_t> out) override {
+    SecureURBG::FillFromBuffer(buffer_, out);
+  }
+
+ private:
+  SecureURBG::Buffer buffer_;
+};
+
+// While an instance is alive, every draw from SecureURBG on the calling thread
+// comes from source instead. This applies to UniformDouble(),
+// FillUniformDoubles(), Geometric() and everything built on them. Instances may
+// be nested; the destructor restores the previous source of the thread. Other
+// threads are not affected. A null source, or the current source of the
+// thread, leaves everything unchanged.
+class ScopedRandomSource {
+ public:
+  explicit ScopedRandomSource(RandomSource* source);
+  ~ScopedRandomSource();
+
+  ScopedRandomSource(const ScopedRandomSource&) = delete;
+  ScopedRandomSource& operator=(const ScopedRandomSource&) = delete;
+
+ private:
+  RandomSource* previous_;
+  bool active_;
+};
+
+namespace internal {
+
+// Converts random 64-bit words into uniform doubles exactly like
+// UniformDouble() converts the word it draws. The rare words whose leading 12
+// bits are all zero consume additional randomness from Geometric(). bits and
+// out must have the same size.
+void UniformDoublesFromBits(absl::Span<const uint64_t> bits,
+                            absl::Span<double> out);
+
+// Incremented whenever the random source of the calling thread changes. Lets
+// caches of random words notice that they were filled from another source.
+extern thread_local uint64_t random_source_generation;
+
+}  // namespace internal
 }  // namespace differential_privacy
 
 #endif  // DIFFERENTIAL_PRIVACY_ALGORITHMS_RAND_H_
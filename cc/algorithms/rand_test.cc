@@ -16,10 +16,21 @@
 
 #include "algorithms/rand.h"
 
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <cstring>
 #include <numeric>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/numeric/bits.h"
+#include "absl/types/span.h"
+#include "algorithms/insecure-rand.h"
+#include "algorithms/internal/cpu-dispatch.h"
+#include "base/instrumentation.h"
 
 namespace differential_privacy {
 namespace {
@@ -66,5 +77,301 @@ TEST_P(RandTest, Geometric) {
   RunTest(Geometric, /*expected_mean=*/2, /*expected_var=*/2);
 }
 
+double FillUniformDoublesOnce() {
+  double result;
+  FillUniformDoubles(absl::MakeSpan(&result, 1));
+  return result;
+}
+
+TEST_P(RandTest, FillUniformDoubles) {
+  RunTest(FillUniformDoublesOnce, /*expected_mean=*/0.5,
+          /*expected_var=*/1.0 / 12.0);
+}
+
+TEST(FillUniformDoublesTest, LargeBatchHasUniformMoments) {
+  std::vector<double> samples(sample_size);
+  FillUniformDoubles(absl::MakeSpan(samples));
+  double mean =
+      std::accumulate(samples.begin(), samples.end(), 0.0) / sample_size;
+  double var = 0;
+  for (double sample : samples) {
+    EXPECT_GE(sample, 0.0);
+    EXPECT_LT(sample, 1.0);
+    var += std::pow(sample - mean, 2);
+  }
+  var /= sample_size - 1;
+  EXPECT_NEAR(mean, 0.5, tolerance * 0.5);
+  EXPECT_NEAR(var, 1.0 / 12.0, tolerance / 12.0);
+}
+
+// Reference implementation of the conversion documented for UniformDouble()
+// for words whose leading 12 bits are not all zero.
+double ReferenceUniformDouble(uint64_t word) {
+  uint64_t i = word & ((uint64_t{1} << 52) - 1);
+  uint64_t j = word >> 52;
+  uint64_t exponent = absl::countl_zero(j) - 52 + 1;
+  i += (uint64_t{1023} - exponent) << 52;
+  double r;
+  std::memcpy(&r, &i, sizeof(r));
+  return r;
+}
+
+TEST(FillUniformDoublesTest, KernelMatchesScalarConversion) {
+  // Cover every value of the leading 12 bits, with random mantissas and an odd
+  // size to exercise the scalar tail of vectorized kernels.
+  std::vector<uint64_t> words;
+  for (uint64_t j = 1; j < 4096; ++j) {
+    words.push_back((j << 52) | (SecureURBG::GetInstance()() >> 12));
+  }
+  words.push_back(~uint64_t{0});
+  words.push_back(uint64_t{1} << 52);
+  for (internal::Isa isa : {internal::Isa::kScalar, internal::Isa::kNeon,
+                            internal::Isa::kAvx2, internal::Isa::kAvx512}) {
+    if (!internal::ForceIsa(isa)) continue;
+    std::vector<double> out(words.size());
+    internal::UniformDoublesFromBits(words, absl::MakeSpan(out));
+    for (size_t k = 0; k < words.size(); ++k) {
+      EXPECT_EQ(out[k], ReferenceUniformDouble(words[k]))
+          << words[k] << " with " << internal::IsaName(isa);
+    }
+  }
+  internal::ClearForcedIsa();
+}
+
+TEST(FillUniformDoublesTest, KernelHandlesZeroLeadingBits) {
+  std::vector<uint64_t> words(7, uint64_t{12345});
+  std::vector<double> out(words.size());
+  internal::UniformDoublesFromBits(words, absl::MakeSpan(out));
+  for (double sample : out) {
+    // With the leading 12 bits all zero the sample is below 2^-12.
+    EXPECT_GE(sample, 0.0);
+    EXPECT_LT(sample, std::pow(2.0, -12));
+  }
+}
+
+TEST(SecureURBGTest, FillCrossesBufferRefresh) {
+  std::vector<uint64_t> words(SecureURBG::kBufferSize / sizeof(uint64_t) + 3);
+  SecureURBG::GetInstance().Fill(absl::MakeSpan(words));
+  // The chance of a zero word, or of two consecutive equal words, is 2^-64.
+  for (size_t k = 0; k + 1 < words.size(); ++k) {
+    EXPECT_NE(words[k], words[k + 1]);
+  }
+}
+
+TEST(SecureURBGTest, ThreadsDrawIndependentStreams) {
+  constexpr int kNumThreads = 8;
+  // Enough draws to force every thread to refresh its buffer several times.
+  constexpr int kDrawsPerThread = 4 * SecureURBG::kBufferSize;
+  std::vector<std::vector<uint64_t>> first_draws(kNumThreads);
+  std::vector<double> means(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([t, &first_draws, &means]() {
+      SecureURBG& urbg = SecureURBG::GetInstance();
+      for (int i = 0; i < 16; ++i) {
+        first_draws[t].push_back(urbg());
+      }
+      double sum = 0;
+      for (int i = 0; i < kDrawsPerThread; ++i) {
+        sum += UniformDouble();
+      }
+      means[t] = sum / kDrawsPerThread;
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (int t = 0; t < kNumThreads; ++t) {
+    EXPECT_NEAR(means[t], 0.5, tolerance);
+    for (int u = t + 1; u < kNumThreads; ++u) {
+      EXPECT_NE(first_draws[t], first_draws[u]);
+    }
+  }
+}
+
+// Returns the number of random bytes that the refreshes of the cache of a new
+// thread request from OpenSSL while running draw on it.
+template <typename Draw>
+int64_t RefreshedBytesOnNewThread(Draw draw) {
+  instrumentation::AggregatingSink sink;
+  instrumentation::SetSink(&sink);
+  std::thread(draw).join();
+  instrumentation::SetSink(nullptr);
+  return sink.Get(instrumentation::Event::kSecureUrbgRefreshBuffer).count;
+}
+
+TEST(SecureURBGTest, FirstRefreshOfThreadIsSmall) {
+  EXPECT_EQ(RefreshedBytesOnNewThread([]() { SecureURBG::GetInstance()(); }),
+            SecureURBG::kInitialRefreshSize);
+  // The second refresh fills the whole cache.
+  EXPECT_EQ(RefreshedBytesOnNewThread([]() {
+              std::vector<uint64_t> words(SecureURBG::kInitialRefreshSize /
+                                              sizeof(uint64_t) +
+                                          1);
+              SecureURBG::GetInstance().Fill(absl::MakeSpan(words));
+            }),
+            SecureURBG::kInitialRefreshSize + SecureURBG::kBufferSize);
+}
+
+TEST(SecureURBGTest, WarmUpFillsWholeCache) {
+  EXPECT_EQ(RefreshedBytesOnNewThread([]() {
+              SecureURBG::WarmUp();
+              // Draws from the warmed cache, and warming up again keeps it.
+              std::vector<uint64_t> words(SecureURBG::kBufferSize /
+                                          sizeof(uint64_t));
+              SecureURBG::GetInstance().Fill(
+                  absl::MakeSpan(words).subspan(1));
+              SecureURBG::WarmUp();
+              SecureURBG::GetInstance().Fill(absl::MakeSpan(words).first(1));
+            }),
+            SecureURBG::kBufferSize);
+}
+
+TEST(SecureURBGTest, BackgroundRefreshHandsOutEveryBlockOnce) {
+  SecureURBG::SetBackgroundRefresh(true);
+  constexpr int kNumThreads = 8;
+  constexpr int kWordsPerBuffer = SecureURBG::kBufferSize / sizeof(uint64_t);
+  std::vector<std::vector<uint64_t>> words(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([t, &words]() {
+      // Alternate between draining the buffer right away and giving the
+      // background thread time to prefill the next block, so that both the
+      // synchronous and the swapping refreshes happen.
+      for (int i = 0; i < 6; ++i) {
+        std::vector<uint64_t> block(kWordsPerBuffer);
+        SecureURBG::GetInstance().Fill(absl::MakeSpan(block));
+        words[t].insert(words[t].end(), block.begin(), block.end());
+        if (i % 2 == 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+      }
+    });
+  }
+  // Threads exit while their blocks may still be queued for a refresh.
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  SecureURBG::SetBackgroundRefresh(false);
+
+  std::vector<uint64_t> all_words;
+  for (const std::vector<uint64_t>& thread_words : words) {
+    all_words.insert(all_words.end(), thread_words.begin(), thread_words.end());
+  }
+  // A block handed out twice would repeat words; by chance, a repetition among
+  // these words has probability below 2^-25.
+  std::sort(all_words.begin(), all_words.end());
+  EXPECT_EQ(std::unique(all_words.begin(), all_words.end()), all_words.end());
+}
+
+TEST(InsecureURBGTest, SameSeedGivesSameStream) {
+  InsecureURBG urbg1(42);
+  InsecureURBG urbg2(42);
+  InsecureURBG urbg3(43);
+  std::vector<uint64_t> words1(100), words2(100), words3(100);
+  urbg1.Fill(absl::MakeSpan(words1));
+  for (uint64_t& word : words2) {
+    word = urbg2();
+  }
+  urbg3.Fill(absl::MakeSpan(words3));
+  EXPECT_EQ(words1, words2);
+  EXPECT_NE(words1, words3);
+}
+
+TEST(ScopedInsecureRandomnessForSimulationTest, IsReproducible) {
+  std::vector<double> samples1(10), samples2(10);
+  {
+    ScopedInsecureRandomnessForSimulation insecure(7);
+    FillUniformDoubles(absl::MakeSpan(samples1));
+  }
+  {
+    ScopedInsecureRandomnessForSimulation insecure(7);
+    for (double& sample : samples2) {
+      sample = UniformDouble();
+    }
+  }
+  EXPECT_EQ(samples1, samples2);
+}
+
+TEST(ScopedInsecureRandomnessForSimulationTest, HasUniformMoments) {
+  ScopedInsecureRandomnessForSimulation insecure(1);
+  std::vector<double> samples(sample_size);
+  FillUniformDoubles(absl::MakeSpan(samples));
+  double mean =
+      std::accumulate(samples.begin(), samples.end(), 0.0) / sample_size;
+  double var = 0;
+  for (double sample : samples) {
+    var += std::pow(sample - mean, 2);
+  }
+  var /= sample_size - 1;
+  EXPECT_NEAR(mean, 0.5, tolerance * 0.5);
+  EXPECT_NEAR(var, 1.0 / 12.0, tolerance / 12.0);
+}
+
+TEST(ScopedInsecureRandomnessForSimulationTest, RestoresPreviousSource) {
+  uint64_t inner_first, outer_second;
+  {
+    ScopedInsecureRandomnessForSimulation outer(1);
+    SecureURBG::GetInstance()();
+    {
+      ScopedInsecureRandomnessForSimulation inner(2);
+      inner_first = SecureURBG::GetInstance()();
+    }
+    outer_second = SecureURBG::GetInstance()();
+  }
+  InsecureURBG expected_outer(1);
+  expected_outer();
+  EXPECT_EQ(inner_first, InsecureURBG(2)());
+  EXPECT_EQ(outer_second, expected_outer());
+}
+
+TEST(ScopedInsecureRandomnessForSimulationTest, DoesNotAffectOtherThreads) {
+  ScopedInsecureRandomnessForSimulation insecure(3);
+  uint64_t other_thread_word = 0;
+  std::thread thread([&other_thread_word]() {
+    other_thread_word = SecureURBG::GetInstance()();
+  });
+  thread.join();
+  // The chance that OpenSSL returns the first word of the seeded stream is
+  // 2^-64.
+  EXPECT_NE(other_thread_word, InsecureURBG(3)());
+}
+
+TEST(SecureRandomSourceTest, DrawsDistinctWords) {
+  SecureRandomSource source;
+  std::vector<uint64_t> words(100);
+  source.Fill(absl::MakeSpan(words));
+  words.push_back(source.Next());
+  std::sort(words.begin(), words.end());
+  EXPECT_EQ(std::unique(words.begin(), words.end()), words.end());
+}
+
+TEST(ScopedRandomSourceTest, DrawsFromSource) {
+  InsecureRandomSource source(5);
+  uint64_t first, second;
+  {
+    ScopedRandomSource scope(&source);
+    first = SecureURBG::GetInstance()();
+  }
+  {
+    ScopedRandomSource scope(&source);
+    second = SecureURBG::GetInstance()();
+  }
+  InsecureURBG expected(5);
+  EXPECT_EQ(first, expected());
+  EXPECT_EQ(second, expected());
+}
+
+TEST(ScopedRandomSourceTest, NullSourceKeepsCurrentSource) {
+  ScopedInsecureRandomnessForSimulation insecure(6);
+  uint64_t word;
+  {
+    ScopedRandomSource scope(nullptr);
+    word = SecureURBG::GetInstance()();
+  }
+  EXPECT_EQ(word, InsecureURBG(6)());
+}
+
 }  // namespace
 }  // namespace differential_privacy
@@ -0,0 +1,129 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/release-cache.h"
+
+#include <cstdint>
+#include <utility>
+
+#include "absl/hash/hash.h"
+#include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "proto/data.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+// Approximate memory of an entry besides its output: the list node and the
+// slot of the index.
+constexpr int64_t kEntryOverheadBytes =
+    sizeof(void*) * 4 + sizeof(ReleaseCache::Fingerprint) * 2;
+
+// Salts of the two halves of the fingerprint.
+constexpr uint64_t kHighSalt = 0x9e3779b97f4a7c15;
+constexpr uint64_t kLowSalt = 0xc2b2ae3d27d4eb4f;
+
+}  // namespace
+
+ReleaseCache::ReleaseCache(int64_t max_bytes) : max_bytes_(max_bytes) {
+  CHECK_GT(max_bytes, 0);
+}
+
+ReleaseCache::Fingerprint ReleaseCache::MakeFingerprint(
+    absl::string_view release_id, absl::string_view parameters) {
+  return {absl::HashOf(kHighSalt, release_id, parameters),
+          absl::HashOf(kLowSalt, release_id, parameters)};
+}
+
+const Output* ReleaseCache::Find(const Fingerprint& fingerprint) {
+  auto it = index_.find(fingerprint);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return &it->second->output;
+}
+
+absl::StatusOr<Output> ReleaseCache::GetOrRelease(
+    const Fingerprint& fingerprint,
+    absl::FunctionRef<absl::StatusOr<Output>()> release) {
+  {
+    absl::MutexLock lock(&mutex_);
+    if (const Output* output = Find(fingerprint)) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return *output;
+    }
+  }
+
+  absl::MutexLock release_lock(&release_mutex_);
+  {
+    // Another thread may have made the same release in the meantime.
+    absl::MutexLock lock(&mutex_);
+    if (const Output* output = Find(fingerprint)) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return *output;
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  absl::StatusOr<Output> output = release();
+  if (!output.ok()) {
+    return output;
+  }
+  const int64_t bytes =
+      static_cast<int64_t>(output->ByteSizeLong()) + kEntryOverheadBytes;
+  if (bytes > max_bytes_) {
+    return output;
+  }
+
+  absl::MutexLock lock(&mutex_);
+  while (bytes_used_ + bytes > max_bytes_) {
+    bytes_used_ -= lru_.back().bytes;
+    index_.erase(lru_.back().fingerprint);
+    lru_.pop_back();
+  }
+  lru_.push_front({fingerprint, *output, bytes});
+  index_[fingerprint] = lru_.begin();
+  bytes_used_ += bytes;
+  return output;
+}
+
+ReleaseCache::Stats ReleaseCache::GetStats() const {
+  return {hits_.load(std::memory_order_relaxed),
+          misses_.load(std::memory_order_relaxed)};
+}
+
+size_t ReleaseCache::Size() const {
+  absl::MutexLock lock(&mutex_);
+  return lru_.size();
+}
+
+int64_t ReleaseCache::BytesUsed() const {
+  absl::MutexLock lock(&mutex_);
+  return bytes_used_;
+}
+
+void ReleaseCache::Clear() {
+  absl::MutexLock lock(&mutex_);
+  lru_.clear();
+  index_.clear();
+  bytes_used_ = 0;
+  hits_.store(0, std::memory_order_relaxed);
+  misses_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace differential_privacy
@@ -0,0 +1,168 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_RELEASE_CACHE_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_RELEASE_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <typeinfo>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "algorithms/algorithm.h"
+#include "proto/data.pb.h"
+
+namespace differential_privacy {
+
+// Thread-safe LRU cache of released results, bounded by the bytes of the
+// cached outputs. Analysts often rerun the same report, and every
+// PartialResult draws new noise, which costs privacy budget and CPU.
+//
+// Releases are identified by a 128-bit fingerprint of a caller-supplied
+// release id and the parameters of the release, see CachedPartialResult, and
+// never by the state of the algorithm: whether a release is served from the
+// cache must not depend on the data, or a cache hit would reveal that two
+// datasets led to the same state, e.g., that a privacy unit contributed
+// nothing. A cache hit returns the earlier release of the same id, which is
+// post-processing of it, no matter which inputs were added since. Callers
+// that release on changed data have to use a new release id. Cached outputs
+// are as sensitive as any released result, and the cache must not outlive
+// the epoch of the budget that paid for them: results of a new epoch must be
+// released with new noise, e.g., by calling Clear().
+class ReleaseCache {
+ public:
+  struct Fingerprint {
+    uint64_t high;
+    uint64_t low;
+
+    bool operator==(const Fingerprint& other) const {
+      return high == other.high && low == other.low;
+    }
+
+    template <typename H>
+    friend H AbslHashValue(H h, const Fingerprint& fingerprint) {
+      return H::combine(std::move(h), fingerprint.high, fingerprint.low);
+    }
+  };
+
+  struct Stats {
+    int64_t hits;
+    int64_t misses;
+  };
+
+  // max_bytes bounds the approximate memory of the cached outputs and must be
+  // positive. Outputs larger than max_bytes are not cached.
+  explicit ReleaseCache(int64_t max_bytes);
+
+  ReleaseCache(const ReleaseCache&) = delete;
+  ReleaseCache& operator=(const ReleaseCache&) = delete;
+
+  // Returns the fingerprint of the release with the given id and parameters.
+  static Fingerprint MakeFingerprint(absl::string_view release_id,
+                                     absl::string_view parameters);
+
+  // Returns the cached output of the release with the given fingerprint, or
+  // calls release and caches its output if it succeeds. Concurrent misses for
+  // the same fingerprint are serialized, so that release is called once.
+  absl::StatusOr<Output> GetOrRelease(
+      const Fingerprint& fingerprint,
+      absl::FunctionRef<absl::StatusOr<Output>()> release)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the number of cache hits and misses since construction or the last
+  // call to Clear().
+  Stats GetStats() const;
+
+  // Returns the number of cached outputs.
+  size_t Size() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the approximate memory of the cached outputs, in bytes.
+  int64_t BytesUsed() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Removes all entries and resets the statistics.
+  void Clear() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    Fingerprint fingerprint;
+    Output output;
+    int64_t bytes;
+  };
+
+  // Returns the cached output and marks it as most recently used.
+  const Output* Find(const Fingerprint& fingerprint)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const int64_t max_bytes_;
+  // Held while releasing, so that a release is never computed twice.
+  absl::Mutex release_mutex_;
+  mutable absl::Mutex mutex_ ABSL_ACQUIRED_AFTER(release_mutex_);
+  // Most recently used entries are at the front.
+  std::list<Entry> lru_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<Fingerprint, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+  int64_t bytes_used_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::atomic<int64_t> hits_{0};
+  std::atomic<int64_t> misses_{0};
+};
+
+// Returns algorithm.PartialResult(noise_interval_level), or the result of an
+// earlier call with the same release_id for an algorithm of the same type
+// with the same epsilon, delta, noise_interval_level and parameters. A cached
+// result is returned no matter which inputs the algorithm has, and does not
+// consume its budget, so the call succeeds even if the algorithm already
+// returned its result. Errors are not cached.
+//
+// release_id names the release, e.g., a report and the snapshot of the data
+// it runs on, and must not be derived from the data. It must not be empty.
+// parameters must identify the parameters of the algorithm that are not
+// covered otherwise, e.g., its bounds; use an empty string if there are none.
+template <typename T>
+absl::StatusOr<Output> CachedPartialResult(
+    Algorithm<T>& algorithm, ReleaseCache& cache, absl::string_view release_id,
+    absl::string_view parameters,
+    double noise_interval_level = kDefaultConfidenceLevel) {
+  if (release_id.empty()) {
+    return absl::InvalidArgumentError("Release id must not be empty.");
+  }
+  // Doubles are fingerprinted by their bytes, so that they compare exactly.
+  const double numbers[] = {algorithm.GetEpsilon(), algorithm.GetDelta(),
+                            noise_interval_level};
+  std::string all_parameters(typeid(algorithm).name());
+  all_parameters.push_back('\0');
+  all_parameters.append(reinterpret_cast<const char*>(numbers),
+                        sizeof(numbers));
+  all_parameters.append(parameters.data(), parameters.size());
+  return cache.GetOrRelease(
+      ReleaseCache::MakeFingerprint(release_id, all_parameters),
+      [&algorithm, noise_interval_level]() {
+        return algorithm.PartialResult(noise_interval_level);
+      });
+}
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_RELEASE_CACHE_H_
@@ -0,0 +1,235 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/release-cache.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "base/testing/proto_matchers.h"
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "proto/data.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::EqualsProto;
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::HasSubstr;
+
+std::unique_ptr<Count<int64_t>> MakeCount(int num_entries,
+                                          double epsilon = 1.0) {
+  std::unique_ptr<Count<int64_t>> count =
+      Count<int64_t>::Builder().SetEpsilon(epsilon).Build().value();
+  for (int i = 0; i < num_entries; ++i) {
+    count->AddEntry(i);
+  }
+  return count;
+}
+
+TEST(ReleaseCacheTest, RepeatedReleaseReturnsCachedResult) {
+  ReleaseCache cache(/*max_bytes=*/1 << 20);
+  std::unique_ptr<Count<int64_t>> first = MakeCount(100);
+  std::unique_ptr<Count<int64_t>> second = MakeCount(100);
+
+  absl::StatusOr<Output> first_result =
+      CachedPartialResult(*first, cache, "report", "");
+  absl::StatusOr<Output> second_result =
+      CachedPartialResult(*second, cache, "report", "");
+
+  ASSERT_OK(first_result);
+  ASSERT_OK(second_result);
+  EXPECT_THAT(*second_result, EqualsProto(*first_result));
+  EXPECT_EQ(cache.GetStats().hits, 1);
+  EXPECT_EQ(cache.GetStats().misses, 1);
+  EXPECT_EQ(cache.Size(), 1);
+  // The cached release did not consume the budget of the second count.
+  EXPECT_OK(second->PartialResult());
+}
+
+TEST(ReleaseCacheTest, RepeatedReleaseOfSameAlgorithmIsCached) {
+  ReleaseCache cache(/*max_bytes=*/1 << 20);
+  std::unique_ptr<Count<int64_t>> count = MakeCount(10);
+
+  absl::StatusOr<Output> result =
+      CachedPartialResult(*count, cache, "report", "");
+  ASSERT_OK(result);
+
+  EXPECT_THAT(count->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  absl::StatusOr<Output> repeated =
+      CachedPartialResult(*count, cache, "report", "");
+  ASSERT_OK(repeated);
+  EXPECT_THAT(*repeated, EqualsProto(*result));
+}
+
+TEST(ReleaseCacheTest, HitDoesNotDependOnInputs) {
+  ReleaseCache cache(/*max_bytes=*/1 << 20);
+  absl::StatusOr<Output> result =
+      CachedPartialResult(*MakeCount(10), cache, "report", "");
+  ASSERT_OK(result);
+
+  // A dataset with one more privacy unit is served the same release, so
+  // whether the cache hits reveals nothing about the inputs.
+  absl::StatusOr<Output> other_result =
+      CachedPartialResult(*MakeCount(11), cache, "report", "");
+  ASSERT_OK(other_result);
+  EXPECT_THAT(*other_result, EqualsProto(*result));
+  EXPECT_EQ(cache.GetStats().hits, 1);
+}
+
+TEST(ReleaseCacheTest, DifferentIdOrParametersMiss) {
+  ReleaseCache cache(/*max_bytes=*/1 << 20);
+
+  ASSERT_OK(CachedPartialResult(*MakeCount(10), cache, "report", ""));
+  ASSERT_OK(CachedPartialResult(*MakeCount(10), cache, "other report", ""));
+  ASSERT_OK(CachedPartialResult(*MakeCount(10, /*epsilon=*/2.0), cache,
+                                "report", ""));
+  ASSERT_OK(CachedPartialResult(*MakeCount(10), cache, "report", "other"));
+  ASSERT_OK(CachedPartialResult(*MakeCount(10), cache, "report", "",
+                                /*noise_interval_level=*/0.5));
+
+  EXPECT_EQ(cache.GetStats().hits, 0);
+  EXPECT_EQ(cache.GetStats().misses, 5);
+  EXPECT_EQ(cache.Size(), 5);
+}
+
+TEST(ReleaseCacheTest, DifferentAlgorithmsWithSameIdMiss) {
+  ReleaseCache cache(/*max_bytes=*/1 << 20);
+  std::unique_ptr<BoundedSum<int64_t>> sum =
+      BoundedSum<int64_t>::Builder()
+          .SetEpsilon(1)
+          .SetLower(0)
+          .SetUpper(10)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  std::unique_ptr<BoundedSum<int64_t>> other_sum =
+      BoundedSum<int64_t>::Builder()
+          .SetEpsilon(1)
+          .SetLower(0)
+          .SetUpper(10)
+          .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+          .Build()
+          .value();
+  sum->AddEntry(5);
+  other_sum->AddEntry(5);
+
+  ASSERT_OK(CachedPartialResult(*sum, cache, "report", "bounds [0, 10]"));
+  absl::StatusOr<Output> count_result =
+      CachedPartialResult(*MakeCount(1), cache, "report", "bounds [0, 10]");
+  absl::StatusOr<Output> sum_result =
+      CachedPartialResult(*other_sum, cache, "report", "bounds [0, 10]");
+
+  ASSERT_OK(count_result);
+  ASSERT_OK(sum_result);
+  EXPECT_EQ(GetValue<int64_t>(*sum_result), 5);
+  EXPECT_EQ(cache.GetStats().hits, 1);
+  EXPECT_EQ(cache.GetStats().misses, 2);
+}
+
+TEST(ReleaseCacheTest, EmptyReleaseIdFails) {
+  ReleaseCache cache(/*max_bytes=*/1 << 20);
+  EXPECT_THAT(CachedPartialResult(*MakeCount(10), cache, "", ""),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Release id")));
+  EXPECT_EQ(cache.GetStats().misses, 0);
+}
+
+TEST(ReleaseCacheTest, EvictsLeastRecentlyUsedOverByteLimit) {
+  Output output;
+  AddToOutput<int64_t>(&output, 1);
+  const int64_t entry_bytes = [&output]() {
+    ReleaseCache cache(1 << 20);
+    EXPECT_OK(cache.GetOrRelease(ReleaseCache::MakeFingerprint("a", ""),
+                                 [&output]() { return output; }));
+    return cache.BytesUsed();
+  }();
+  // Room for two entries.
+  ReleaseCache cache(2 * entry_bytes);
+  auto release = [&cache, &output](absl::string_view release_id) {
+    return cache.GetOrRelease(ReleaseCache::MakeFingerprint(release_id, ""),
+                              [&output]() { return output; });
+  };
+
+  ASSERT_OK(release("a"));
+  ASSERT_OK(release("b"));
+  // Uses "a", so that "b" is the least recently used entry.
+  ASSERT_OK(release("a"));
+  ASSERT_OK(release("c"));
+
+  EXPECT_EQ(cache.Size(), 2);
+  EXPECT_EQ(cache.BytesUsed(), 2 * entry_bytes);
+  ASSERT_OK(release("a"));
+  EXPECT_EQ(cache.GetStats().hits, 2);
+  ASSERT_OK(release("b"));
+  EXPECT_EQ(cache.GetStats().hits, 2);
+}
+
+TEST(ReleaseCacheTest, DoesNotCacheErrors) {
+  ReleaseCache cache(/*max_bytes=*/1 << 20);
+  const ReleaseCache::Fingerprint fingerprint =
+      ReleaseCache::MakeFingerprint("report", "");
+
+  EXPECT_THAT(cache.GetOrRelease(fingerprint,
+                                 []() -> absl::StatusOr<Output> {
+                                   return absl::InternalError("failed");
+                                 }),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_EQ(cache.Size(), 0);
+
+  Output output;
+  AddToOutput<int64_t>(&output, 7);
+  absl::StatusOr<Output> result =
+      cache.GetOrRelease(fingerprint, [&output]() { return output; });
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 7);
+}
+
+TEST(ReleaseCacheTest, DoesNotCacheOutputsOverByteLimit) {
+  ReleaseCache cache(/*max_bytes=*/1);
+  Output output;
+  AddToOutput<int64_t>(&output, 7);
+
+  ASSERT_OK(cache.GetOrRelease(ReleaseCache::MakeFingerprint("report", ""),
+                               [&output]() { return output; }));
+
+  EXPECT_EQ(cache.Size(), 0);
+  EXPECT_EQ(cache.BytesUsed(), 0);
+}
+
+TEST(ReleaseCacheTest, ClearRemovesEntriesAndStats) {
+  ReleaseCache cache(/*max_bytes=*/1 << 20);
+  ASSERT_OK(CachedPartialResult(*MakeCount(10), cache, "report", ""));
+
+  cache.Clear();
+
+  EXPECT_EQ(cache.Size(), 0);
+  EXPECT_EQ(cache.BytesUsed(), 0);
+  EXPECT_EQ(cache.GetStats().misses, 0);
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,223 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_RELEASE_SCHEDULER_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_RELEASE_SCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/parallel-add-entries.h"
+#include "base/status_macros.h"
+#include "proto/data.pb.h"
+
+namespace differential_privacy {
+
+// Releases the results of many algorithms, e.g., of all metrics of all
+// partitions of a report, on several tasks. This returns the same outputs as
+// calling PartialResult on every algorithm in turn, up to the noise drawn, and
+// consumes the budget of every algorithm.
+//
+// Release runs in two phases like Algorithm::PrepareResult and
+// FinalizeResults. First, up to num_tasks tasks scheduled with `schedule`
+// prepare the results. Every task repeatedly claims the next
+// kReleasesPerClaim algorithms that no task claimed yet, so that tasks that
+// run early or on fast threads take over the work of the others. Then the
+// prepared results are finalized on the calling thread, one FinalizeResults
+// call per input type, which adds the noise to all results of the same
+// mechanism in one batch. Algorithms of the same metric should therefore be
+// built with the same SharedMechanismBuilder, so that their noise is drawn in
+// full batches.
+//
+// The algorithms are not owned and must not be used by other threads until
+// Release returns. A scheduler releases its algorithms once.
+class ReleaseScheduler {
+ public:
+  // Number of algorithms a task prepares per claim. Claiming several
+  // algorithms amortizes the contention on the shared counter.
+  static constexpr int kReleasesPerClaim = 64;
+
+  ReleaseScheduler(int num_tasks, TaskScheduler schedule)
+      : num_tasks_(num_tasks), schedule_(std::move(schedule)) {}
+
+  ReleaseScheduler(const ReleaseScheduler&) = delete;
+  ReleaseScheduler& operator=(const ReleaseScheduler&) = delete;
+
+  // Adds an algorithm to release with the given confidence level of the noise
+  // interval. Its output has the index of the number of previously added
+  // algorithms in the outputs of Release.
+  template <typename T>
+  void Add(Algorithm<T>* algorithm,
+           double noise_interval_level = kDefaultConfidenceLevel) {
+    const std::type_index type(typeid(T));
+    auto group = std::find_if(
+        groups_.begin(), groups_.end(),
+        [&type](const std::unique_ptr<Group>& g) { return g->type == type; });
+    if (group == groups_.end()) {
+      groups_.push_back(std::make_unique<TypedGroup<T>>());
+      group = groups_.end() - 1;
+    }
+    auto* typed_group = static_cast<TypedGroup<T>*>(group->get());
+    releases_.push_back(
+        {typed_group, static_cast<int>(typed_group->algorithms.size())});
+    typed_group->algorithms.push_back(algorithm);
+    typed_group->noise_interval_levels.push_back(noise_interval_level);
+  }
+
+  // Returns the number of added algorithms.
+  int size() const { return static_cast<int>(releases_.size()); }
+
+  // Returns the outputs of all added algorithms, in the order they were added,
+  // or the error of the first algorithm that failed. Algorithms after a failed
+  // one still consume their budget, like in a loop over PartialResult that
+  // keeps going.
+  absl::StatusOr<std::vector<Output>> Release() {
+    if (num_tasks_ < 1) {
+      return absl::InvalidArgumentError("Number of tasks must be at least 1.");
+    }
+    if (!schedule_) {
+      return absl::InvalidArgumentError("Task scheduler must not be null.");
+    }
+    if (released_) {
+      return absl::FailedPreconditionError(
+          "The release scheduler can only release its algorithms once.");
+    }
+    for (const Entry& release : releases_) {
+      if (release.group->IsNull(release.index)) {
+        return absl::InvalidArgumentError("Algorithm must not be null.");
+      }
+    }
+    released_ = true;
+
+    for (const std::unique_ptr<Group>& group : groups_) {
+      group->Resize();
+    }
+    std::vector<absl::Status> statuses(releases_.size());
+    const int num_claims =
+        (static_cast<int>(releases_.size()) + kReleasesPerClaim - 1) /
+        kReleasesPerClaim;
+    const int num_tasks = std::min(num_tasks_, num_claims);
+    std::atomic<int> next_claim{0};
+    absl::BlockingCounter pending(num_tasks);
+    for (int task = 0; task < num_tasks; ++task) {
+      schedule_([this, &statuses, &next_claim, &pending, num_claims]() {
+        for (int claim = next_claim.fetch_add(1, std::memory_order_relaxed);
+             claim < num_claims;
+             claim = next_claim.fetch_add(1, std::memory_order_relaxed)) {
+          const int begin = claim * kReleasesPerClaim;
+          const int end = std::min<int>(begin + kReleasesPerClaim,
+                                        static_cast<int>(releases_.size()));
+          for (int i = begin; i < end; ++i) {
+            statuses[i] = releases_[i].group->Prepare(releases_[i].index);
+          }
+        }
+        pending.DecrementCount();
+      });
+    }
+    pending.Wait();
+    for (const absl::Status& status : statuses) {
+      RETURN_IF_ERROR(status);
+    }
+
+    std::vector<Output> outputs(releases_.size());
+    for (const std::unique_ptr<Group>& group : groups_) {
+      RETURN_IF_ERROR(group->Finalize());
+    }
+    for (int i = 0; i < releases_.size(); ++i) {
+      outputs[i] = releases_[i].group->TakeOutput(releases_[i].index);
+    }
+    return outputs;
+  }
+
+ private:
+  // Algorithms of one input type, which FinalizeResults finalizes together.
+  struct Group {
+    explicit Group(std::type_index type) : type(type) {}
+    virtual ~Group() = default;
+
+    virtual bool IsNull(int index) const = 0;
+    virtual void Resize() = 0;
+    // Called concurrently for distinct indices.
+    virtual absl::Status Prepare(int index) = 0;
+    virtual absl::Status Finalize() = 0;
+    virtual Output TakeOutput(int index) = 0;
+
+    const std::type_index type;
+  };
+
+  template <typename T>
+  struct TypedGroup : Group {
+    TypedGroup() : Group(typeid(T)) {}
+
+    bool IsNull(int index) const override {
+      return algorithms[index] == nullptr;
+    }
+
+    void Resize() override { prepared.resize(algorithms.size()); }
+
+    absl::Status Prepare(int index) override {
+      ASSIGN_OR_RETURN(prepared[index], algorithms[index]->PrepareResult(
+                                            noise_interval_levels[index]));
+      return absl::OkStatus();
+    }
+
+    absl::Status Finalize() override {
+      std::vector<typename Algorithm<T>::PreparedResult> results;
+      results.reserve(prepared.size());
+      for (auto& result : prepared) {
+        results.push_back(*std::move(result));
+      }
+      ASSIGN_OR_RETURN(outputs, Algorithm<T>::FinalizeResults(
+                                    absl::MakeSpan(results)));
+      return absl::OkStatus();
+    }
+
+    Output TakeOutput(int index) override { return std::move(outputs[index]); }
+
+    std::vector<Algorithm<T>*> algorithms;
+    std::vector<double> noise_interval_levels;
+    std::vector<std::optional<typename Algorithm<T>::PreparedResult>> prepared;
+    std::vector<Output> outputs;
+  };
+
+  // Position of an added algorithm in its group.
+  struct Entry {
+    Group* group;
+    int index;
+  };
+
+  const int num_tasks_;
+  const TaskScheduler schedule_;
+  std::vector<std::unique_ptr<Group>> groups_;
+  std::vector<Entry> releases_;
+  bool released_ = false;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_RELEASE_SCHEDULER_H_
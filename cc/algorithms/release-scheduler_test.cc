@@ -0,0 +1,181 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/release-scheduler.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "proto/data.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::HasSubstr;
+
+// More partitions than one task claims at once.
+constexpr int kNumPartitions = 300;
+
+void RunInline(std::function<void()> task) { task(); }
+
+// Per-partition metrics of a report with inputs of two types, whose noise is
+// drawn by shared mechanisms.
+struct Report {
+  Report() {
+    SharedMechanismBuilder count_mechanism(
+        std::make_unique<ZeroNoiseMechanism::Builder>());
+    SharedMechanismBuilder sum_mechanism(
+        std::make_unique<ZeroNoiseMechanism::Builder>());
+    for (int partition = 0; partition < kNumPartitions; ++partition) {
+      counts.push_back(Count<int64_t>::Builder()
+                           .SetEpsilon(1)
+                           .SetLaplaceMechanism(count_mechanism.Clone())
+                           .Build()
+                           .value());
+      sums.push_back(BoundedSum<double>::Builder()
+                         .SetEpsilon(1)
+                         .SetLower(0)
+                         .SetUpper(10)
+                         .SetLaplaceMechanism(sum_mechanism.Clone())
+                         .Build()
+                         .value());
+      for (int i = 0; i < partition % 7; ++i) {
+        counts.back()->AddEntry(i);
+        sums.back()->AddEntry(1.5 * i);
+      }
+    }
+  }
+
+  void AddTo(ReleaseScheduler& scheduler) {
+    for (int partition = 0; partition < kNumPartitions; ++partition) {
+      scheduler.Add<int64_t>(counts[partition].get());
+      scheduler.Add<double>(sums[partition].get());
+    }
+  }
+
+  std::vector<std::unique_ptr<Count<int64_t>>> counts;
+  std::vector<std::unique_ptr<BoundedSum<double>>> sums;
+};
+
+TEST(ReleaseSchedulerTest, ReleasesAllAlgorithmsInOrder) {
+  Report report;
+  std::vector<std::thread> threads;
+  ReleaseScheduler scheduler(4, [&threads](std::function<void()> task) {
+    threads.emplace_back(std::move(task));
+  });
+  report.AddTo(scheduler);
+
+  absl::StatusOr<std::vector<Output>> outputs = scheduler.Release();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_OK(outputs);
+  EXPECT_EQ(threads.size(), 4);
+  ASSERT_EQ(outputs->size(), 2 * kNumPartitions);
+  for (int partition = 0; partition < kNumPartitions; ++partition) {
+    const int n = partition % 7;
+    EXPECT_EQ(GetValue<int64_t>((*outputs)[2 * partition]), n);
+    EXPECT_DOUBLE_EQ(GetValue<double>((*outputs)[2 * partition + 1]),
+                     1.5 * n * (n - 1) / 2);
+  }
+}
+
+TEST(ReleaseSchedulerTest, UsesNoMoreTasksThanClaims) {
+  Report report;
+  int num_tasks = 0;
+  ReleaseScheduler scheduler(100, [&num_tasks](std::function<void()> task) {
+    ++num_tasks;
+    task();
+  });
+  report.AddTo(scheduler);
+
+  ASSERT_OK(scheduler.Release());
+
+  constexpr int kClaim = ReleaseScheduler::kReleasesPerClaim;
+  EXPECT_EQ(num_tasks, (2 * kNumPartitions + kClaim - 1) / kClaim);
+}
+
+TEST(ReleaseSchedulerTest, ConsumesBudget) {
+  Report report;
+  ReleaseScheduler scheduler(2, RunInline);
+  report.AddTo(scheduler);
+
+  ASSERT_OK(scheduler.Release());
+
+  EXPECT_THAT(report.counts[0]->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(report.sums.back()->PartialResult(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(scheduler.Release(),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(ReleaseSchedulerTest, ReturnsErrorOfFailedAlgorithm) {
+  Report report;
+  ASSERT_OK(report.sums[kNumPartitions / 2]->PartialResult());
+  ReleaseScheduler scheduler(3, RunInline);
+  report.AddTo(scheduler);
+
+  EXPECT_THAT(scheduler.Release(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("only produce results once")));
+}
+
+TEST(ReleaseSchedulerTest, ReleasesNothing) {
+  ReleaseScheduler scheduler(2, RunInline);
+
+  absl::StatusOr<std::vector<Output>> outputs = scheduler.Release();
+
+  ASSERT_OK(outputs);
+  EXPECT_TRUE(outputs->empty());
+}
+
+TEST(ReleaseSchedulerTest, RejectsInvalidArguments) {
+  ReleaseScheduler no_tasks(0, RunInline);
+  EXPECT_THAT(no_tasks.Release(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Number of tasks")));
+
+  ReleaseScheduler no_scheduler(1, nullptr);
+  EXPECT_THAT(no_scheduler.Release(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("scheduler")));
+
+  ReleaseScheduler null_algorithm(1, RunInline);
+  null_algorithm.Add<int64_t>(nullptr);
+  EXPECT_THAT(null_algorithm.Release(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("must not be null")));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,234 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/sketched-partition-selection.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/hash/hash.h"
+#include "absl/memory/memory.h"
+#include "absl/numeric/bits.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "algorithms/partition-selection.h"
+#include "algorithms/rand.h"
+#include "openssl/evp.h"
+#include "openssl/hmac.h"
+
+namespace differential_privacy {
+namespace {
+
+constexpr uint32_t kSaturated = std::numeric_limits<uint32_t>::max();
+
+constexpr int kMantissaBits = 52;
+constexpr uint64_t kMantissaMask = (uint64_t{1} << kMantissaBits) - 1;
+
+// Hashes of a key, from which the counter of every row is derived as
+// h1 + row * h2 (Kirsch, Mitzenmacher: Less hashing, same performance), so
+// that only two hashes are computed per key.
+struct KeyHashes {
+  explicit KeyHashes(absl::string_view partition_key)
+      : h1(absl::Hash<absl::string_view>()(partition_key)),
+        h2(absl::Hash<std::pair<int, absl::string_view>>()({1, partition_key}) |
+           1) {}
+
+  size_t Counter(int row, int width) const {
+    return static_cast<size_t>(row) * width + (h1 + row * h2) % width;
+  }
+
+  uint64_t h1;
+  uint64_t h2;
+};
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<SketchedPartitionSelector>>
+SketchedPartitionSelector::Create(
+    std::unique_ptr<PartitionSelectionStrategy> strategy,
+    const Options& options) {
+  if (strategy == nullptr) {
+    return absl::InvalidArgumentError("Strategy must be set.");
+  }
+  if (options.width < 1) {
+    return absl::InvalidArgumentError("Sketch width must be at least 1.");
+  }
+  if (options.depth < 1) {
+    return absl::InvalidArgumentError("Sketch depth must be at least 1.");
+  }
+  return absl::WrapUnique(
+      new SketchedPartitionSelector(std::move(strategy), options));
+}
+
+SketchedPartitionSelector::SketchedPartitionSelector(
+    std::unique_ptr<PartitionSelectionStrategy> strategy,
+    const Options& options)
+    : strategy_(std::move(strategy)),
+      width_(options.width),
+      depth_(options.depth),
+      counters_(static_cast<size_t>(options.width) * options.depth, 0) {
+  SecureURBG& random = SecureURBG::GetInstance();
+  for (size_t i = 0; i < prf_key_.size(); i += sizeof(uint64_t)) {
+    const uint64_t bits = random();
+    std::memcpy(prf_key_.data() + i, &bits, sizeof(bits));
+  }
+}
+
+absl::Status SketchedPartitionSelector::AddToSketch(
+    absl::string_view partition_key, int64_t num_privacy_units) {
+  if (stage_ != Stage::kSketching) {
+    return absl::FailedPreconditionError(
+        "Contributions cannot be added to the sketch after the second pass "
+        "started.");
+  }
+  if (num_privacy_units < 0) {
+    return absl::InvalidArgumentError(
+        "Number of privacy units must be non-negative.");
+  }
+  const KeyHashes hashes(partition_key);
+  const uint64_t increment =
+      std::min<uint64_t>(num_privacy_units, kSaturated);
+  for (int row = 0; row < depth_; ++row) {
+    uint32_t& counter = counters_[hashes.Counter(row, width_)];
+    counter = static_cast<uint32_t>(
+        std::min<uint64_t>(uint64_t{counter} + increment, kSaturated));
+  }
+  return absl::OkStatus();
+}
+
+int64_t SketchedPartitionSelector::UpperBound(
+    absl::string_view partition_key) const {
+  const KeyHashes hashes(partition_key);
+  uint32_t estimate = kSaturated;
+  for (int row = 0; row < depth_; ++row) {
+    estimate = std::min(estimate, counters_[hashes.Counter(row, width_)]);
+  }
+  return estimate == kSaturated ? std::numeric_limits<int64_t>::max()
+                                : estimate;
+}
+
+double SketchedPartitionSelector::Uniform(
+    absl::string_view partition_key) const {
+  // Like UniformDouble: a uniform mantissa, and an exponent that is geometric
+  // with parameter 1/2, i.e., the number of leading zeros of further bits plus
+  // one. Every double in [0, 1) is drawn with the probability of the interval
+  // it stands for, so that small keep probabilities are not rounded.
+  std::array<uint64_t, kPrfWords> words = PrfBlock(partition_key, 0);
+  const uint64_t mantissa = words[0] & kMantissaMask;
+  uint64_t exponent = 1;
+  int word = 1;
+  for (uint8_t block = 1; exponent < 1023; ++word) {
+    if (word == kPrfWords) {
+      // Only reached if all bits so far are zero.
+      words = PrfBlock(partition_key, block++);
+      word = 0;
+    }
+    if (words[word] != 0) {
+      exponent += absl::countl_zero(words[word]);
+      break;
+    }
+    exponent += 64;
+  }
+  uint64_t bits = mantissa;
+  // Denormalized values, which have exponent 0, otherwise.
+  if (ABSL_PREDICT_TRUE(exponent < 1023)) {
+    bits += (uint64_t{1023} - exponent) << kMantissaBits;
+  }
+  double result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+std::array<uint64_t, SketchedPartitionSelector::kPrfWords>
+SketchedPartitionSelector::PrfBlock(absl::string_view partition_key,
+                                    uint8_t block) const {
+  // The block index is prepended, so that the inputs of different keys and
+  // blocks never coincide.
+  uint8_t digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_size = 0;
+  HMAC_CTX* ctx = HMAC_CTX_new();
+  HMAC_Init_ex(ctx, prf_key_.data(), prf_key_.size(), EVP_sha256(), nullptr);
+  HMAC_Update(ctx, &block, 1);
+  HMAC_Update(ctx, reinterpret_cast<const uint8_t*>(partition_key.data()),
+              partition_key.size());
+  HMAC_Final(ctx, digest, &digest_size);
+  HMAC_CTX_free(ctx);
+  std::array<uint64_t, kPrfWords> words;
+  std::memcpy(words.data(), digest, sizeof(words));
+  return words;
+}
+
+absl::Status SketchedPartitionSelector::AddToCandidates(
+    absl::string_view partition_key, int64_t num_privacy_units) {
+  if (stage_ == Stage::kDone) {
+    return absl::FailedPreconditionError(
+        "Contributions cannot be added after KeptPartitions().");
+  }
+  if (num_privacy_units < 0) {
+    return absl::InvalidArgumentError(
+        "Number of privacy units must be non-negative.");
+  }
+  stage_ = Stage::kCounting;
+  auto it = candidates_.find(partition_key);
+  if (it != candidates_.end()) {
+    it->second.num_privacy_units += num_privacy_units;
+    return absl::OkStatus();
+  }
+  const int64_t upper_bound = UpperBound(partition_key);
+  if (upper_bound != std::numeric_limits<int64_t>::max()) {
+    const double probability =
+        strategy_->ProbabilityOfKeep(static_cast<double>(upper_bound));
+    // E.g., keys below the pre-threshold, which need no draw.
+    if (probability <= 0) return absl::OkStatus();
+    const double uniform = Uniform(partition_key);
+    if (uniform >= probability) return absl::OkStatus();
+    candidates_.emplace(partition_key, Candidate{uniform, num_privacy_units});
+  } else {
+    candidates_.emplace(partition_key,
+                        Candidate{Uniform(partition_key), num_privacy_units});
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::vector<std::string>>
+SketchedPartitionSelector::KeptPartitions() {
+  if (stage_ == Stage::kDone) {
+    return absl::FailedPreconditionError(
+        "KeptPartitions() can only be called once.");
+  }
+  stage_ = Stage::kDone;
+  std::vector<std::string> kept;
+  for (auto& [partition_key, candidate] : candidates_) {
+    const double probability = strategy_->ProbabilityOfKeep(
+        static_cast<double>(candidate.num_privacy_units));
+    if (candidate.uniform < probability) {
+      kept.push_back(partition_key);
+    }
+  }
+  candidates_.clear();
+  return kept;
+}
+
+}  // namespace differential_privacy
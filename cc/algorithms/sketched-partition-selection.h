@@ -0,0 +1,137 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_SKETCHED_PARTITION_SELECTION_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_SKETCHED_PARTITION_SELECTION_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "algorithms/partition-selection.h"
+
+namespace differential_privacy {
+
+// Two-stage partition selection for key spaces that are too large to count
+// the privacy units of every candidate partition exactly.
+//
+// The contributions, i.e., one (partition key, privacy unit) pair per privacy
+// unit and partition after contribution bounding, are passed twice:
+//   1. AddToSketch counts them in a count-min sketch (Cormode, Muthukrishnan:
+//      An improved data stream summary: the count-min sketch and its
+//      applications), whose estimate of a key is an upper bound of its number
+//      of privacy units.
+//   2. AddToCandidates counts exactly the privacy units of the keys that
+//      survive the sketch, and skips all others.
+// KeptPartitions then decides the surviving keys with their exact counts.
+//
+// Every key gets a single uniform draw u(key) in [0, 1), a keyed
+// pseudorandom function of the key with a secret random key, so the draw is
+// the same whenever a key is seen. A key survives the sketch if u(key) is
+// below the keep probability of its upper bound, and is kept if u(key) is
+// below the keep probability of its exact count. Since keep probabilities do
+// not decrease with the count, a key that does not survive would not have
+// been kept with its exact count either. If u were truly random, the kept
+// keys would be distributed exactly as if every key was decided with
+// PartitionSelectionStrategy::ProbabilityOfKeep of its exact count. Since u is
+// computed with HMAC-SHA256, the guarantees of the strategy only hold against
+// adversaries that cannot tell HMAC-SHA256 with an unknown key from a random
+// function, i.e., they are computational. The sketch only decides how many
+// keys are counted exactly, which is about the sum of the keep probabilities
+// of the upper bounds.
+//
+// SketchedPartitionSelector is not thread safe.
+class SketchedPartitionSelector {
+ public:
+  struct Options {
+    // Number of counters of every row of the sketch. The estimate of a key
+    // exceeds its count by at most e / width times the number of
+    // contributions with probability 1 - exp(-depth).
+    int width = 1 << 20;
+    // Number of rows of the sketch.
+    int depth = 4;
+  };
+
+  static absl::StatusOr<std::unique_ptr<SketchedPartitionSelector>> Create(
+      std::unique_ptr<PartitionSelectionStrategy> strategy,
+      const Options& options);
+
+  // First pass: adds num_privacy_units contributions to partition_key.
+  absl::Status AddToSketch(absl::string_view partition_key,
+                           int64_t num_privacy_units = 1);
+
+  // Second pass: the same contributions as in the first pass. Ends the first
+  // pass on the first call.
+  absl::Status AddToCandidates(absl::string_view partition_key,
+                               int64_t num_privacy_units = 1);
+
+  // Returns the kept partition keys, in no particular order, and ends the
+  // second pass.
+  absl::StatusOr<std::vector<std::string>> KeptPartitions();
+
+  // Number of keys that survived the sketch so far, i.e., that are counted
+  // exactly.
+  int64_t NumCandidates() const { return candidates_.size(); }
+
+  // Upper bound of the number of privacy units of partition_key from the
+  // sketch. Exposed for testing.
+  int64_t UpperBound(absl::string_view partition_key) const;
+
+ private:
+  enum class Stage { kSketching, kCounting, kDone };
+
+  // The candidate state of a surviving key.
+  struct Candidate {
+    double uniform;
+    int64_t num_privacy_units;
+  };
+
+  SketchedPartitionSelector(
+      std::unique_ptr<PartitionSelectionStrategy> strategy,
+      const Options& options);
+
+  // Number of 64 bit words of a block of the pseudorandom function.
+  static constexpr int kPrfWords = 4;
+
+  // Returns the uniform draw of partition_key in [0, 1).
+  double Uniform(absl::string_view partition_key) const;
+
+  // Returns block number block of the pseudorandom function of
+  // partition_key. Uniform only needs more than the first block if its first
+  // 192 bits after the mantissa are zero.
+  std::array<uint64_t, kPrfWords> PrfBlock(absl::string_view partition_key,
+                                           uint8_t block) const;
+
+  std::unique_ptr<PartitionSelectionStrategy> strategy_;
+  const int width_;
+  const int depth_;
+  // depth_ rows of width_ counters. Counters saturate at the maximum, which
+  // stands for an unknown, possibly larger, count.
+  std::vector<uint32_t> counters_;
+  std::array<uint8_t, 32> prf_key_;
+  absl::flat_hash_map<std::string, Candidate> candidates_;
+  Stage stage_ = Stage::kSketching;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_SKETCHED_PARTITION_SELECTION_H_
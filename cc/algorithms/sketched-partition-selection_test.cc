@@ -0,0 +1,257 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/sketched-partition-selection.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/partition-selection.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::IsOkAndHolds;
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::UnorderedElementsAreArray;
+
+SketchedPartitionSelector::Options SketchOptions(int width, int depth) {
+  SketchedPartitionSelector::Options options;
+  options.width = width;
+  options.depth = depth;
+  return options;
+}
+
+// Strategy with the given keep probabilities.
+class FakeStrategy : public PartitionSelectionStrategy {
+ public:
+  explicit FakeStrategy(std::function<double(double)> probability_of_keep)
+      : PartitionSelectionStrategy(/*epsilon=*/1, /*delta=*/1e-5,
+                                   /*max_partitions_contributed=*/1,
+                                   /*adjusted_delta=*/1e-5,
+                                   /*pre_threshold=*/1),
+        probability_of_keep_(std::move(probability_of_keep)) {}
+
+  bool ShouldKeep(double num_users) override {
+    ADD_FAILURE() << "The selector must only use ProbabilityOfKeep.";
+    return false;
+  }
+
+  double ProbabilityOfKeep(double num_users) const override {
+    return probability_of_keep_(num_users);
+  }
+
+ private:
+  std::function<double(double)> probability_of_keep_;
+};
+
+// Passes the contributions to both stages and returns the kept keys.
+std::vector<std::string> Select(
+    SketchedPartitionSelector& selector,
+    const std::vector<std::pair<std::string, int64_t>>& contributions) {
+  for (const auto& [key, count] : contributions) {
+    EXPECT_OK(selector.AddToSketch(key, count));
+  }
+  for (const auto& [key, count] : contributions) {
+    EXPECT_OK(selector.AddToCandidates(key, count));
+  }
+  absl::StatusOr<std::vector<std::string>> kept = selector.KeptPartitions();
+  EXPECT_OK(kept);
+  return kept.value_or(std::vector<std::string>());
+}
+
+TEST(SketchedPartitionSelectorTest, ThresholdKeepsExactlyKeysAboveIt) {
+  std::unique_ptr<SketchedPartitionSelector> selector =
+      SketchedPartitionSelector::Create(
+          std::make_unique<FakeStrategy>(
+              [](double num_users) { return num_users >= 5 ? 1.0 : 0.0; }),
+          SketchOptions(1 << 16, 4))
+          .value();
+  std::vector<std::pair<std::string, int64_t>> contributions;
+  std::vector<std::string> expected;
+  for (int i = 0; i < 10000; ++i) {
+    contributions.push_back({absl::StrCat("small", i), 1});
+  }
+  for (int i = 0; i < 100; ++i) {
+    // Contributions of privacy units added one by one, just below and above
+    // the threshold.
+    for (int j = 0; j < 4; ++j) {
+      contributions.push_back({absl::StrCat("edge", i), 1});
+    }
+    for (int j = 0; j < 5; ++j) {
+      contributions.push_back({absl::StrCat("large", i), 1});
+    }
+    expected.push_back(absl::StrCat("large", i));
+  }
+
+  EXPECT_THAT(Select(*selector, contributions),
+              UnorderedElementsAreArray(expected));
+}
+
+TEST(SketchedPartitionSelectorTest, SketchFiltersMostKeys) {
+  std::unique_ptr<SketchedPartitionSelector> selector =
+      SketchedPartitionSelector::Create(
+          std::make_unique<FakeStrategy>(
+              [](double num_users) { return num_users >= 5 ? 1.0 : 0.0; }),
+          SketchOptions(1 << 16, 4))
+          .value();
+  for (int i = 0; i < 10000; ++i) {
+    ASSERT_OK(selector->AddToSketch(absl::StrCat("small", i)));
+  }
+  for (int i = 0; i < 10000; ++i) {
+    ASSERT_OK(selector->AddToCandidates(absl::StrCat("small", i)));
+  }
+  EXPECT_LT(selector->NumCandidates(), 10);
+}
+
+TEST(SketchedPartitionSelectorTest, UpperBoundIsAtLeastCount) {
+  // A narrow sketch, so that many keys share counters.
+  std::unique_ptr<SketchedPartitionSelector> selector =
+      SketchedPartitionSelector::Create(
+          std::make_unique<FakeStrategy>([](double) { return 0.0; }),
+          SketchOptions(64, 2))
+          .value();
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_OK(selector->AddToSketch(absl::StrCat("key", i), i % 10));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_GE(selector->UpperBound(absl::StrCat("key", i)), i % 10);
+  }
+}
+
+TEST(SketchedPartitionSelectorTest, KeepsWithProbabilityOfExactCount) {
+  // A narrow sketch overestimates most counts, which must not change the
+  // probability of keeping a key.
+  std::unique_ptr<SketchedPartitionSelector> selector =
+      SketchedPartitionSelector::Create(
+          std::make_unique<FakeStrategy>([](double num_users) {
+            return std::min(1.0, num_users / 10);
+          }),
+          SketchOptions(256, 2))
+          .value();
+  std::vector<std::pair<std::string, int64_t>> contributions;
+  for (int count = 1; count <= 10; ++count) {
+    for (int i = 0; i < 2000; ++i) {
+      contributions.push_back({absl::StrCat(count, "_", i), count});
+    }
+  }
+  std::vector<int> kept_per_count(11, 0);
+  for (const std::string& key : Select(*selector, contributions)) {
+    ++kept_per_count[std::stoi(key.substr(0, key.find('_')))];
+  }
+  for (int count = 1; count <= 10; ++count) {
+    EXPECT_NEAR(kept_per_count[count] / 2000.0, count / 10.0, 0.05)
+        << "count " << count;
+  }
+}
+
+TEST(SketchedPartitionSelectorTest, DecidesEveryKeyOnce) {
+  std::unique_ptr<SketchedPartitionSelector> selector =
+      SketchedPartitionSelector::Create(
+          std::make_unique<FakeStrategy>([](double) { return 0.5; }), {})
+          .value();
+  std::vector<std::pair<std::string, int64_t>> contributions;
+  for (int repetition = 0; repetition < 5; ++repetition) {
+    for (int i = 0; i < 4000; ++i) {
+      contributions.push_back({absl::StrCat("key", i), 1});
+    }
+  }
+  const std::vector<std::string> kept = Select(*selector, contributions);
+  EXPECT_EQ(absl::flat_hash_set<std::string>(kept.begin(), kept.end()).size(),
+            kept.size());
+  EXPECT_NEAR(kept.size() / 4000.0, 0.5, 0.05);
+}
+
+TEST(SketchedPartitionSelectorTest, LaplaceStrategyFiltersSingletons) {
+  std::unique_ptr<PartitionSelectionStrategy> strategy =
+      LaplacePartitionSelection::Builder()
+          .SetEpsilon(1)
+          .SetDelta(1e-5)
+          .SetMaxPartitionsContributed(1)
+          .Build()
+          .value();
+  std::unique_ptr<SketchedPartitionSelector> selector =
+      SketchedPartitionSelector::Create(std::move(strategy), {}).value();
+  std::vector<std::pair<std::string, int64_t>> contributions;
+  for (int i = 0; i < 100000; ++i) {
+    contributions.push_back({absl::StrCat("single", i), 1});
+  }
+  contributions.push_back({"popular", 1000});
+  for (const auto& [key, count] : contributions) {
+    ASSERT_OK(selector->AddToSketch(key, count));
+  }
+  for (const auto& [key, count] : contributions) {
+    ASSERT_OK(selector->AddToCandidates(key, count));
+  }
+  EXPECT_LT(selector->NumCandidates(), 10);
+  EXPECT_THAT(selector->KeptPartitions(),
+              IsOkAndHolds(testing::Contains("popular")));
+}
+
+TEST(SketchedPartitionSelectorTest, StagesMustBeInOrder) {
+  std::unique_ptr<SketchedPartitionSelector> selector =
+      SketchedPartitionSelector::Create(
+          std::make_unique<FakeStrategy>([](double) { return 1.0; }), {})
+          .value();
+  ASSERT_OK(selector->AddToSketch("key"));
+  ASSERT_OK(selector->AddToCandidates("key"));
+  EXPECT_THAT(selector->AddToSketch("key"),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  ASSERT_OK(selector->KeptPartitions());
+  EXPECT_THAT(selector->AddToCandidates("key"),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(selector->KeptPartitions(),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(SketchedPartitionSelectorTest, InvalidArgumentsFail) {
+  EXPECT_THAT(SketchedPartitionSelector::Create(nullptr, {}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(
+      SketchedPartitionSelector::Create(
+          std::make_unique<FakeStrategy>([](double) { return 1.0; }),
+          SketchOptions(/*width=*/0, /*depth=*/4)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(
+      SketchedPartitionSelector::Create(
+          std::make_unique<FakeStrategy>([](double) { return 1.0; }),
+          SketchOptions(/*width=*/64, /*depth=*/0)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+
+  std::unique_ptr<SketchedPartitionSelector> selector =
+      SketchedPartitionSelector::Create(
+          std::make_unique<FakeStrategy>([](double) { return 1.0; }), {})
+          .value();
+  EXPECT_THAT(selector->AddToSketch("key", -1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(selector->AddToCandidates("key", -1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,173 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_SLIDING_WINDOW_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_SLIDING_WINDOW_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/merge-summaries.h"
+#include "proto/summary.pb.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Differentially private results over a sliding window of the last
+// window_size intervals, e.g., a window of 24 hours that is released every
+// hour, without adding the entries of the whole window again for every
+// release.
+//
+// Entries are added to the current interval, and CloseInterval stores the
+// serialized summary of the interval in a ring of window_size slots, replacing
+// the summary of the oldest interval. The ring is the leaf level of a segment
+// tree whose inner nodes cache the merged summary of their children, so that
+// closing an interval recomputes the O(log window_size) ancestors of its slot
+// with two merges each, and the window is the summary of the root. Summaries
+// are merged with MergeFromBytes, which decodes them in place.
+//
+// Every release consumes the budget of a new algorithm from the factory. Since
+// an entry is part of up to window_size consecutive windows, the guarantee of
+// the releases follows from composition over the windows that contain it.
+//
+// SlidingWindow is not thread safe.
+template <typename T>
+class SlidingWindow {
+ public:
+  // The factory creates empty algorithms with the same parameters, e.g., by
+  // calling Build() on the same builder.
+  static absl::StatusOr<std::unique_ptr<SlidingWindow<T>>> Create(
+      int window_size, AlgorithmFactory<T> factory) {
+    if (window_size < 1) {
+      return absl::InvalidArgumentError("Window size must be at least 1.");
+    }
+    std::unique_ptr<SlidingWindow<T>> window =
+        absl::WrapUnique(new SlidingWindow<T>(window_size, std::move(factory)));
+    ASSIGN_OR_RETURN(window->current_, window->NewAlgorithm());
+    return window;
+  }
+
+  SlidingWindow(const SlidingWindow&) = delete;
+  SlidingWindow& operator=(const SlidingWindow&) = delete;
+
+  // Adds entries to the current interval.
+  void AddEntry(const T& entry) { current_->AddEntry(entry); }
+  void AddEntries(absl::Span<const T> entries) {
+    current_->AddEntries(entries);
+  }
+
+  // Merges a summary of entries of the current interval, e.g., of another
+  // worker, into the current interval.
+  absl::Status MergeIntoInterval(const Summary& summary) {
+    return current_->Merge(summary);
+  }
+
+  // Closes the current interval, which replaces the oldest interval of the
+  // window, and starts a new one.
+  absl::Status CloseInterval() {
+    size_t node = window_size_ + num_closed_intervals_ % window_size_;
+    tree_[node] = current_->Serialize().SerializeAsString();
+    for (node /= 2; node >= 1; node /= 2) {
+      ASSIGN_OR_RETURN(tree_[node], MergeNodes(node));
+    }
+    ++num_closed_intervals_;
+    current_->Reset();
+    return absl::OkStatus();
+  }
+
+  // Returns a new algorithm that holds the entries of the last window_size
+  // closed intervals, or of all of them if fewer were closed. Calling
+  // PartialResult on it releases the window.
+  absl::StatusOr<std::unique_ptr<Algorithm<T>>> Window() const {
+    ASSIGN_OR_RETURN(std::unique_ptr<Algorithm<T>> window, NewAlgorithm());
+    if (!tree_[1].empty()) {
+      RETURN_IF_ERROR(window->MergeFromBytes(tree_[1]));
+    }
+    return window;
+  }
+
+  // Returns the noisy result of the current window.
+  absl::StatusOr<Output> ReleaseWindow() {
+    ASSIGN_OR_RETURN(std::unique_ptr<Algorithm<T>> window, Window());
+    return window->PartialResult();
+  }
+
+  int window_size() const { return window_size_; }
+
+  int64_t num_closed_intervals() const { return num_closed_intervals_; }
+
+  int64_t MemoryUsed() const {
+    int64_t memory = sizeof(SlidingWindow<T>) + current_->MemoryUsed() +
+                     sizeof(std::string) * tree_.capacity();
+    for (const std::string& summary : tree_) {
+      memory += summary.capacity();
+    }
+    return memory;
+  }
+
+ private:
+  SlidingWindow(int window_size, AlgorithmFactory<T> factory)
+      : window_size_(window_size),
+        factory_(std::move(factory)),
+        tree_(2 * window_size) {}
+
+  absl::StatusOr<std::unique_ptr<Algorithm<T>>> NewAlgorithm() const {
+    ASSIGN_OR_RETURN(std::unique_ptr<Algorithm<T>> algorithm, factory_());
+    if (algorithm == nullptr) {
+      return absl::InvalidArgumentError("Factory returned a null algorithm.");
+    }
+    return algorithm;
+  }
+
+  // Returns the merged summary of the children of an inner node. Empty
+  // summaries stand for slots without a closed interval yet.
+  absl::StatusOr<std::string> MergeNodes(size_t node) const {
+    const std::string& left = tree_[2 * node];
+    const std::string& right = tree_[2 * node + 1];
+    if (left.empty() || right.empty()) {
+      return left.empty() ? right : left;
+    }
+    ASSIGN_OR_RETURN(std::unique_ptr<Algorithm<T>> merged, NewAlgorithm());
+    RETURN_IF_ERROR(merged->MergeFromBytes(left));
+    RETURN_IF_ERROR(merged->MergeFromBytes(right));
+    return merged->Serialize().SerializeAsString();
+  }
+
+  const int window_size_;
+  const AlgorithmFactory<T> factory_;
+  // Segment tree over the slots of the ring, with the serialized summary of
+  // slot i at window_size_ + i and the children of inner node n at 2n and
+  // 2n + 1. With a window size that is not a power of two, an inner node may
+  // cover slots that are not adjacent, which does not matter since merging is
+  // commutative; every slot is still below the root exactly once. Index 0 is
+  // unused.
+  std::vector<std::string> tree_;
+  int64_t num_closed_intervals_ = 0;
+  // Algorithm of the current interval.
+  std::unique_ptr<Algorithm<T>> current_;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_SLIDING_WINDOW_H_
@@ -0,0 +1,140 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/sliding-window.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/count.h"
+#include "algorithms/numerical-mechanisms-testing.h"
+#include "proto/summary.pb.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::differential_privacy::test_utils::ZeroNoiseMechanism;
+using ::testing::HasSubstr;
+
+AlgorithmFactory<int64_t> ExactSumFactory() {
+  return []() -> absl::StatusOr<std::unique_ptr<Algorithm<int64_t>>> {
+    return BoundedSum<int64_t>::Builder()
+        .SetEpsilon(1)
+        .SetLower(0)
+        .SetUpper(100)
+        .SetLaplaceMechanism(std::make_unique<ZeroNoiseMechanism::Builder>())
+        .Build();
+  };
+}
+
+TEST(SlidingWindowTest, WindowHoldsLastIntervals) {
+  // Window sizes that are and are not powers of two.
+  for (int window_size : {1, 3, 4, 5}) {
+    std::unique_ptr<SlidingWindow<int64_t>> window =
+        SlidingWindow<int64_t>::Create(window_size, ExactSumFactory()).value();
+    std::vector<int64_t> interval_sums;
+    for (int interval = 1; interval <= 12; ++interval) {
+      // The sum of interval i is i * i.
+      for (int i = 0; i < interval; ++i) {
+        window->AddEntry(interval);
+      }
+      ASSERT_OK(window->CloseInterval());
+      interval_sums.push_back(interval * interval);
+
+      int64_t expected = 0;
+      for (int i = std::max<int>(0, interval_sums.size() - window_size);
+           i < interval_sums.size(); ++i) {
+        expected += interval_sums[i];
+      }
+      absl::StatusOr<Output> result = window->ReleaseWindow();
+      ASSERT_OK(result);
+      EXPECT_EQ(GetValue<int64_t>(*result), expected)
+          << "window size " << window_size << ", interval " << interval;
+    }
+    EXPECT_EQ(window->num_closed_intervals(), 12);
+  }
+}
+
+TEST(SlidingWindowTest, CurrentIntervalIsNotInWindow) {
+  std::unique_ptr<SlidingWindow<int64_t>> window =
+      SlidingWindow<int64_t>::Create(2, ExactSumFactory()).value();
+  absl::StatusOr<Output> result = window->ReleaseWindow();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 0);
+
+  window->AddEntries({1, 2});
+  ASSERT_OK(window->CloseInterval());
+  window->AddEntry(5);
+  result = window->ReleaseWindow();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 3);
+}
+
+TEST(SlidingWindowTest, MergesSummariesIntoInterval) {
+  std::unique_ptr<SlidingWindow<int64_t>> window =
+      SlidingWindow<int64_t>::Create(2, ExactSumFactory()).value();
+  std::unique_ptr<Algorithm<int64_t>> worker = ExactSumFactory()().value();
+  worker->AddEntries({10, 20});
+  window->AddEntry(1);
+  ASSERT_OK(window->MergeIntoInterval(worker->Serialize()));
+  ASSERT_OK(window->CloseInterval());
+
+  absl::StatusOr<std::unique_ptr<Algorithm<int64_t>>> released =
+      window->Window();
+  ASSERT_OK(released);
+  // The window is a live algorithm that can be merged with others before it
+  // is released.
+  ASSERT_OK((*released)->MergeFrom(*worker));
+  absl::StatusOr<Output> result = (*released)->PartialResult();
+  ASSERT_OK(result);
+  EXPECT_EQ(GetValue<int64_t>(*result), 61);
+
+  std::unique_ptr<Algorithm<int64_t>> count =
+      Count<int64_t>::Builder().SetEpsilon(1).Build().value();
+  EXPECT_THAT(window->MergeIntoInterval(count->Serialize()),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(SlidingWindowTest, InvalidParametersFail) {
+  EXPECT_THAT(SlidingWindow<int64_t>::Create(0, ExactSumFactory()),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Window size")));
+  EXPECT_THAT(
+      SlidingWindow<int64_t>::Create(
+          2,
+          []() -> absl::StatusOr<std::unique_ptr<Algorithm<int64_t>>> {
+            return std::unique_ptr<Algorithm<int64_t>>();
+          }),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("null")));
+  AlgorithmFactory<int64_t> invalid_factory = []() {
+    return BoundedSum<int64_t>::Builder().SetEpsilon(-1).Build();
+  };
+  EXPECT_THAT(SlidingWindow<int64_t>::Create(2, invalid_factory),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace differential_privacy
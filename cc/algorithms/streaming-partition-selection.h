@@ -0,0 +1,255 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_STREAMING_PARTITION_SELECTION_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_STREAMING_PARTITION_SELECTION_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/hash/hash.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "algorithms/partition-selection.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Partition selection over a stream of (partition key, number of privacy
+// units) pairs, for pipelines that cannot materialize all candidate keys.
+//
+// Partitions are sharded by key over worker threads. Every worker owns a
+// strategy created by the factory, decides its partitions with the batched
+// PartitionSelectionStrategy::ShouldKeep, and draws its randomness from its
+// own thread's random buffers. Kept keys are passed to the callback in
+// batches of up to batch_size keys. Batches come from several workers in no
+// particular order, but the callback is never run concurrently.
+//
+// Every partition key must be added at most once, with the number of privacy
+// units aggregated over the whole dataset; the selector does not merge
+// counts of the same key. Add() blocks while the queue of the worker the key
+// is assigned to is full, which bounds the memory of a fast producer.
+//
+// Add() and Finish() must be called from a single producer thread.
+class StreamingPartitionSelector {
+ public:
+  using StrategyFactory = std::function<
+      absl::StatusOr<std::unique_ptr<PartitionSelectionStrategy>>()>;
+  using KeptPartitionsCallback =
+      std::function<void(std::vector<std::string> partition_keys)>;
+
+  struct Options {
+    int num_threads = 1;
+    // Number of partitions sent to a worker at once, and the maximum number
+    // of keys passed to the callback at once.
+    int batch_size = 4096;
+    // Number of batches that may wait for each worker.
+    int max_queued_batches = 4;
+  };
+
+  static absl::StatusOr<std::unique_ptr<StreamingPartitionSelector>> Create(
+      const StrategyFactory& strategy_factory,
+      KeptPartitionsCallback on_kept, const Options& options) {
+    if (options.num_threads < 1) {
+      return absl::InvalidArgumentError(
+          "Number of threads must be at least 1.");
+    }
+    if (options.batch_size < 1) {
+      return absl::InvalidArgumentError("Batch size must be at least 1.");
+    }
+    if (options.max_queued_batches < 1) {
+      return absl::InvalidArgumentError(
+          "Maximum number of queued batches must be at least 1.");
+    }
+    if (on_kept == nullptr) {
+      return absl::InvalidArgumentError("Callback must be set.");
+    }
+    std::vector<std::unique_ptr<PartitionSelectionStrategy>> strategies;
+    for (int i = 0; i < options.num_threads; ++i) {
+      ASSIGN_OR_RETURN(std::unique_ptr<PartitionSelectionStrategy> strategy,
+                       strategy_factory());
+      if (strategy == nullptr) {
+        return absl::InvalidArgumentError("Factory returned a null strategy.");
+      }
+      strategies.push_back(std::move(strategy));
+    }
+    return absl::WrapUnique(new StreamingPartitionSelector(
+        std::move(strategies), std::move(on_kept), options));
+  }
+
+  StreamingPartitionSelector(const StreamingPartitionSelector&) = delete;
+  StreamingPartitionSelector& operator=(const StreamingPartitionSelector&) =
+      delete;
+
+  // Waits for the workers. Kept keys that Finish() was not called for are
+  // still passed to the callback.
+  ~StreamingPartitionSelector() { Finish().IgnoreError(); }
+
+  // Adds a candidate partition.
+  absl::Status Add(std::string partition_key, int64_t num_privacy_units) {
+    if (finished_) {
+      return absl::FailedPreconditionError(
+          "Partitions cannot be added after Finish().");
+    }
+    Shard& shard =
+        *shards_[absl::Hash<absl::string_view>()(partition_key) %
+                 shards_.size()];
+    shard.pending.push_back({std::move(partition_key), num_privacy_units});
+    if (shard.pending.size() >= static_cast<size_t>(options_.batch_size)) {
+      shard.Push(std::move(shard.pending), options_.max_queued_batches);
+      shard.pending.clear();
+    }
+    return absl::OkStatus();
+  }
+
+  // Adds all (partition key, number of privacy units) pairs of a range.
+  template <typename Iterator>
+  absl::Status Add(Iterator begin, Iterator end) {
+    for (; begin != end; ++begin) {
+      RETURN_IF_ERROR(Add(std::string(begin->first), begin->second));
+    }
+    return absl::OkStatus();
+  }
+
+  // Decides all remaining partitions, passes the last kept keys to the
+  // callback, and stops the workers. No partitions can be added afterwards.
+  absl::Status Finish() {
+    if (finished_) {
+      return absl::OkStatus();
+    }
+    finished_ = true;
+    for (std::unique_ptr<Shard>& shard : shards_) {
+      if (!shard->pending.empty()) {
+        shard->Push(std::move(shard->pending), options_.max_queued_batches);
+      }
+      shard->Close();
+    }
+    for (std::unique_ptr<Shard>& shard : shards_) {
+      shard->thread.join();
+    }
+    return absl::OkStatus();
+  }
+
+ private:
+  struct Candidate {
+    std::string partition_key;
+    int64_t num_privacy_units;
+  };
+
+  // A worker with its strategy and its queue of batches to decide.
+  struct Shard {
+    void Push(std::vector<Candidate> batch, int max_queued_batches) {
+      const size_t capacity = max_queued_batches;
+      auto has_capacity = [this, capacity]()
+                              ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+                                return queue.size() < capacity;
+                              };
+      absl::MutexLock lock(&mutex, absl::Condition(&has_capacity));
+      queue.push_back(std::move(batch));
+    }
+
+    void Close() {
+      absl::MutexLock lock(&mutex);
+      closed = true;
+    }
+
+    // Returns false once the shard is closed and all batches are taken.
+    bool Pop(std::vector<Candidate>* batch) {
+      auto has_work = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+        return !queue.empty() || closed;
+      };
+      absl::MutexLock lock(&mutex, absl::Condition(&has_work));
+      if (queue.empty()) return false;
+      *batch = std::move(queue.front());
+      queue.pop_front();
+      return true;
+    }
+
+    std::unique_ptr<PartitionSelectionStrategy> strategy;
+    // Owned by the producer thread.
+    std::vector<Candidate> pending;
+    std::thread thread;
+
+    absl::Mutex mutex;
+    std::deque<std::vector<Candidate>> queue ABSL_GUARDED_BY(mutex);
+    bool closed ABSL_GUARDED_BY(mutex) = false;
+  };
+
+  StreamingPartitionSelector(
+      std::vector<std::unique_ptr<PartitionSelectionStrategy>> strategies,
+      KeptPartitionsCallback on_kept, const Options& options)
+      : on_kept_(std::move(on_kept)), options_(options) {
+    for (std::unique_ptr<PartitionSelectionStrategy>& strategy : strategies) {
+      shards_.push_back(std::make_unique<Shard>());
+      shards_.back()->strategy = std::move(strategy);
+      shards_.back()->pending.reserve(options_.batch_size);
+    }
+    for (std::unique_ptr<Shard>& shard : shards_) {
+      shard->thread = std::thread(&StreamingPartitionSelector::RunWorker, this,
+                                  shard.get());
+    }
+  }
+
+  void RunWorker(Shard* shard) {
+    std::vector<Candidate> batch;
+    std::vector<int64_t> counts;
+    std::vector<bool> keep;
+    std::vector<std::string> kept;
+    while (shard->Pop(&batch)) {
+      counts.resize(batch.size());
+      for (size_t i = 0; i < batch.size(); ++i) {
+        counts[i] = batch[i].num_privacy_units;
+      }
+      shard->strategy->ShouldKeep(counts, &keep);
+      for (size_t i = 0; i < batch.size(); ++i) {
+        if (!keep[i]) continue;
+        kept.push_back(std::move(batch[i].partition_key));
+        if (kept.size() == static_cast<size_t>(options_.batch_size)) {
+          Emit(std::move(kept));
+          kept.clear();
+        }
+      }
+    }
+    if (!kept.empty()) {
+      Emit(std::move(kept));
+    }
+  }
+
+  void Emit(std::vector<std::string> kept) {
+    absl::MutexLock lock(&callback_mutex_);
+    on_kept_(std::move(kept));
+  }
+
+  const KeptPartitionsCallback on_kept_;
+  const Options options_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  bool finished_ = false;
+  absl::Mutex callback_mutex_;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_STREAMING_PARTITION_SELECTION_H_
@@ -0,0 +1,169 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/streaming-partition-selection.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "algorithms/partition-selection.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::HasSubstr;
+using ::testing::UnorderedElementsAreArray;
+
+// Partitions with no privacy units are always dropped and partitions with
+// kManyPrivacyUnits are always kept, so that results are deterministic.
+constexpr int64_t kManyPrivacyUnits = 1000;
+
+absl::StatusOr<std::unique_ptr<PartitionSelectionStrategy>> CreateStrategy() {
+  return NearTruncatedGeometricPartitionSelection::Builder()
+      .SetEpsilon(1)
+      .SetDelta(1e-5)
+      .SetMaxPartitionsContributed(1)
+      .Build();
+}
+
+TEST(StreamingPartitionSelectorTest, KeepsPartitionsOnAllThreads) {
+  std::vector<std::string> kept;
+  std::atomic<bool> in_callback = false;
+  int max_batch_size = 0;
+  StreamingPartitionSelector::Options options;
+  options.num_threads = 4;
+  options.batch_size = 100;
+  absl::StatusOr<std::unique_ptr<StreamingPartitionSelector>> selector =
+      StreamingPartitionSelector::Create(
+          CreateStrategy,
+          [&](std::vector<std::string> batch) {
+            EXPECT_FALSE(in_callback.exchange(true));
+            max_batch_size = std::max<int>(max_batch_size, batch.size());
+            kept.insert(kept.end(), batch.begin(), batch.end());
+            in_callback = false;
+          },
+          options);
+  ASSERT_OK(selector);
+
+  std::vector<std::string> expected;
+  for (int i = 0; i < 10000; ++i) {
+    const std::string key = absl::StrCat("partition", i);
+    const int64_t num_privacy_units = i % 3 == 0 ? kManyPrivacyUnits : 0;
+    ASSERT_OK((*selector)->Add(key, num_privacy_units));
+    if (num_privacy_units > 0) expected.push_back(key);
+  }
+  ASSERT_OK((*selector)->Finish());
+
+  EXPECT_THAT(kept, UnorderedElementsAreArray(expected));
+  EXPECT_LE(max_batch_size, options.batch_size);
+}
+
+TEST(StreamingPartitionSelectorTest, AddsRange) {
+  std::vector<std::string> kept;
+  absl::StatusOr<std::unique_ptr<StreamingPartitionSelector>> selector =
+      StreamingPartitionSelector::Create(
+          CreateStrategy,
+          [&](std::vector<std::string> batch) {
+            kept.insert(kept.end(), batch.begin(), batch.end());
+          },
+          StreamingPartitionSelector::Options());
+  ASSERT_OK(selector);
+  const std::vector<std::pair<std::string, int64_t>> partitions = {
+      {"a", kManyPrivacyUnits}, {"b", 0}, {"c", kManyPrivacyUnits}};
+
+  ASSERT_OK((*selector)->Add(partitions.begin(), partitions.end()));
+  ASSERT_OK((*selector)->Finish());
+
+  EXPECT_THAT(kept, UnorderedElementsAreArray({"a", "c"}));
+}
+
+TEST(StreamingPartitionSelectorTest, DestructorFinishes) {
+  std::vector<std::string> kept;
+  {
+    StreamingPartitionSelector::Options options;
+    options.num_threads = 2;
+    absl::StatusOr<std::unique_ptr<StreamingPartitionSelector>> selector =
+        StreamingPartitionSelector::Create(
+            CreateStrategy,
+            [&](std::vector<std::string> batch) {
+              kept.insert(kept.end(), batch.begin(), batch.end());
+            },
+            options);
+    ASSERT_OK(selector);
+    ASSERT_OK((*selector)->Add("kept", kManyPrivacyUnits));
+  }
+
+  EXPECT_THAT(kept, UnorderedElementsAreArray({"kept"}));
+}
+
+TEST(StreamingPartitionSelectorTest, AddAfterFinishFails) {
+  absl::StatusOr<std::unique_ptr<StreamingPartitionSelector>> selector =
+      StreamingPartitionSelector::Create(
+          CreateStrategy, [](std::vector<std::string>) {},
+          StreamingPartitionSelector::Options());
+  ASSERT_OK(selector);
+  ASSERT_OK((*selector)->Finish());
+
+  EXPECT_THAT((*selector)->Add("key", 1),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(StreamingPartitionSelectorTest, InvalidOptions) {
+  auto callback = [](std::vector<std::string>) {};
+  StreamingPartitionSelector::Options no_threads;
+  no_threads.num_threads = 0;
+  EXPECT_THAT(
+      StreamingPartitionSelector::Create(CreateStrategy, callback, no_threads),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("threads")));
+
+  StreamingPartitionSelector::Options empty_batches;
+  empty_batches.batch_size = 0;
+  EXPECT_THAT(StreamingPartitionSelector::Create(CreateStrategy, callback,
+                                                 empty_batches),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Batch size")));
+
+  EXPECT_THAT(
+      StreamingPartitionSelector::Create(CreateStrategy, nullptr,
+                                         StreamingPartitionSelector::Options()),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("Callback")));
+}
+
+TEST(StreamingPartitionSelectorTest, PropagatesFactoryError) {
+  EXPECT_THAT(
+      StreamingPartitionSelector::Create(
+          []() -> absl::StatusOr<std::unique_ptr<PartitionSelectionStrategy>> {
+            return absl::InternalError("factory failed");
+          },
+          [](std::vector<std::string>) {},
+          StreamingPartitionSelector::Options()),
+      StatusIs(absl::StatusCode::kInternal, HasSubstr("factory failed")));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,280 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_TOP_K_SELECTION_H_
+#define DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_TOP_K_SELECTION_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/numeric/int128.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/distributions.h"
+#include "algorithms/rand.h"
+#include "algorithms/util.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+
+// Differentially private selection of the k candidates with the largest
+// scores, e.g., the most popular items by count.
+//
+// Peels the candidates: each of k rounds selects one of the remaining
+// candidates with the exponential mechanism with epsilon / k and removes it.
+// The exponential mechanism is sampled exactly with integer arithmetic, like
+// the discrete Laplace mechanism, so that artifacts of floating-point
+// arithmetic cannot reveal the scores: scores are rounded to a grid of about a
+// thousandth of the sensitivity, and a uniformly drawn candidate is accepted
+// with probability exp(-rate * (max_score - score)), which is drawn with the
+// Bernoulli(exp(-gamma)) sampler of Canonne, Kamath and Steinke. Every round
+// takes O(n) time plus the expected number of draws, which is at most the
+// number of remaining candidates.
+//
+// Alternatively, SetUseGumbelNoise adds Gumbel noise to every score once and
+// returns the k candidates with the largest noisy scores. This has the same
+// distribution as peeling (Durfee and Rogers, "Practical Differentially
+// Private Top-k Selection with Pay-what-you-get Composition") and runs in
+// O(n + k log k), but the Gumbel noise is computed in floating point and is
+// not protected against the attacks that the snapping of LaplaceMechanism and
+// the discrete samplers prevent.
+//
+// The L-infinity sensitivity is the largest change of any score when one
+// privacy unit is added or removed, e.g., max_contributions_per_partition for
+// counts. If adding a privacy unit never decreases any score, as for counts,
+// the scores are monotonic and half the noise suffices.
+//
+// TopKSelection is thread safe.
+class TopKSelection {
+ public:
+  class Builder;
+
+  TopKSelection(const TopKSelection&) = delete;
+  TopKSelection& operator=(const TopKSelection&) = delete;
+
+  // Returns the indices into scores of the selected candidates, in the order
+  // in which they were selected, i.e., roughly by decreasing score. Returns
+  // all candidates, in random order weighted by score, if there are at most
+  // k. Scores must be finite. Every call spends the budget again.
+  absl::StatusOr<std::vector<int64_t>> Select(
+      absl::Span<const double> scores) const {
+    for (double score : scores) {
+      if (!std::isfinite(score)) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Scores must be finite, but got ", score, "."));
+      }
+    }
+    if (use_gumbel_noise_) {
+      return SelectWithGumbelNoise(scores);
+    }
+    return SelectByPeeling(scores);
+  }
+
+  int k() const { return k_; }
+
+  // Returns the scale of the Gumbel noise added to every score. Peeling
+  // selects a candidate with probability proportional to exp(score / scale).
+  double GetGumbelScale() const { return gumbel_scale_; }
+
+  double GetEpsilon() const { return epsilon_; }
+
+ private:
+  TopKSelection(double epsilon, int k, double gumbel_scale,
+                bool use_gumbel_noise, double grid, uint64_t rate_numerator,
+                uint64_t rate_denominator)
+      : epsilon_(epsilon),
+        k_(k),
+        gumbel_scale_(gumbel_scale),
+        use_gumbel_noise_(use_gumbel_noise),
+        grid_(grid),
+        rate_numerator_(rate_numerator),
+        rate_denominator_(rate_denominator) {}
+
+  std::vector<int64_t> SelectByPeeling(absl::Span<const double> scores) const {
+    // Clamping keeps the differences of scores within 63 bits. Like rounding,
+    // it does not increase the change of any score.
+    constexpr double kMaxGridScore = 0x1p61;
+    std::vector<int64_t> grid_scores(scores.size());
+    for (size_t i = 0; i < scores.size(); ++i) {
+      // grid_ is a power of two, so the division is exact.
+      grid_scores[i] = static_cast<int64_t>(std::clamp(
+          std::floor(scores[i] / grid_ + 0.5), -kMaxGridScore, kMaxGridScore));
+    }
+
+    internal::RandomWords& random = internal::ThreadRandomWords();
+    std::vector<int64_t> remaining(scores.size());
+    std::iota(remaining.begin(), remaining.end(), 0);
+    std::vector<int64_t> selected;
+    selected.reserve(std::min<size_t>(k_, scores.size()));
+    while (selected.size() < static_cast<size_t>(k_) && !remaining.empty()) {
+      int64_t max_score = std::numeric_limits<int64_t>::lowest();
+      for (int64_t candidate : remaining) {
+        max_score = std::max(max_score, grid_scores[candidate]);
+      }
+      // Rejection sampling from the uniform distribution accepts candidate i
+      // with probability proportional to exp(rate * grid_scores[i]).
+      while (true) {
+        const uint64_t j = random.Uniform(remaining.size());
+        const uint64_t gap =
+            static_cast<uint64_t>(max_score - grid_scores[remaining[j]]);
+        if (random.BernoulliExp(absl::uint128(gap) * rate_numerator_,
+                                rate_denominator_)) {
+          selected.push_back(remaining[j]);
+          remaining[j] = remaining.back();
+          remaining.pop_back();
+          break;
+        }
+      }
+    }
+    return selected;
+  }
+
+  std::vector<int64_t> SelectWithGumbelNoise(
+      absl::Span<const double> scores) const {
+    std::vector<double> noisy(scores.size());
+    FillUniformDoubles(absl::MakeSpan(noisy));
+    for (size_t i = 0; i < scores.size(); ++i) {
+      // -log(-log(U)) is standard Gumbel distributed; U = 0 gives -inf.
+      noisy[i] = scores[i] - gumbel_scale_ * std::log(-std::log(noisy[i]));
+    }
+
+    std::vector<int64_t> selected(scores.size());
+    std::iota(selected.begin(), selected.end(), 0);
+    const auto larger = [&noisy](int64_t a, int64_t b) {
+      return noisy[a] > noisy[b];
+    };
+    if (selected.size() > static_cast<size_t>(k_)) {
+      std::nth_element(selected.begin(), selected.begin() + k_,
+                       selected.end(), larger);
+      selected.resize(k_);
+    }
+    std::sort(selected.begin(), selected.end(), larger);
+    return selected;
+  }
+
+  const double epsilon_;
+  const int k_;
+  const double gumbel_scale_;
+  const bool use_gumbel_noise_;
+  // Spacing of the grid that peeling rounds the scores to.
+  const double grid_;
+  // Rate of the exponential mechanism per grid step, rounded down.
+  const uint64_t rate_numerator_;
+  const uint64_t rate_denominator_;
+};
+
+class TopKSelection::Builder {
+ public:
+  Builder& SetEpsilon(double epsilon) {
+    epsilon_ = epsilon;
+    return *this;
+  }
+
+  // Number of candidates to select. Required.
+  Builder& SetK(int k) {
+    k_ = k;
+    return *this;
+  }
+
+  // Largest change of any score by one privacy unit. Defaults to 1.
+  Builder& SetLInfSensitivity(double l_inf_sensitivity) {
+    l_inf_sensitivity_ = l_inf_sensitivity;
+    return *this;
+  }
+
+  // Whether adding a privacy unit changes all scores in the same direction,
+  // e.g., for counts. Defaults to false.
+  Builder& SetMonotonicScores(bool monotonic_scores) {
+    monotonic_scores_ = monotonic_scores;
+    return *this;
+  }
+
+  // Whether to select with one-shot Gumbel noise in floating point instead of
+  // peeling with exact sampling; see the class comment. Defaults to false.
+  Builder& SetUseGumbelNoise(bool use_gumbel_noise) {
+    use_gumbel_noise_ = use_gumbel_noise;
+    return *this;
+  }
+
+  absl::StatusOr<std::unique_ptr<TopKSelection>> Build() {
+    RETURN_IF_ERROR(ValidateEpsilon(epsilon_));
+    if (!k_.has_value() || *k_ <= 0) {
+      return absl::InvalidArgumentError("K must be set and positive.");
+    }
+    RETURN_IF_ERROR(ValidateIsFiniteAndPositive(l_inf_sensitivity_,
+                                                "L-infinity sensitivity"));
+    // The exponential mechanism with epsilon / k per round samples with
+    // probability proportional to exp(epsilon / k * score / (2 * sensitivity)),
+    // or without the factor 2 for monotonic scores.
+    const double factor =
+        (monotonic_scores_ ? 1 : 2) * static_cast<double>(*k_);
+    const double gumbel_scale = factor * l_inf_sensitivity_ / epsilon_.value();
+
+    // The grid is a power of two between 2^-kGridBits and 2^(1 - kGridBits)
+    // times the sensitivity. Rounded scores change by at most
+    // ceil(sensitivity / grid) grid steps.
+    int exponent;
+    std::frexp(l_inf_sensitivity_, &exponent);
+    const double grid = std::ldexp(1.0, exponent - kGridBits);
+    const double rate =
+        epsilon_.value() / (factor * std::ceil(l_inf_sensitivity_ / grid));
+    // Round the rate down to numerator / 2^shift, as the discrete Laplace
+    // distribution does.
+    std::frexp(rate, &exponent);
+    const int shift = kRatePrecisionBits - exponent;
+    if (shift > 62) {
+      return absl::InvalidArgumentError(
+          "Epsilon is too small for k and the L-infinity sensitivity.");
+    }
+    uint64_t rate_numerator;
+    uint64_t rate_denominator;
+    if (shift <= 0) {
+      rate_numerator = static_cast<uint64_t>(
+          std::min(std::floor(rate), static_cast<double>(uint64_t{1} << 62)));
+      rate_denominator = 1;
+    } else {
+      rate_numerator =
+          static_cast<uint64_t>(std::floor(std::ldexp(rate, shift)));
+      rate_denominator = uint64_t{1} << shift;
+    }
+    return absl::WrapUnique(new TopKSelection(
+        epsilon_.value(), *k_, gumbel_scale, use_gumbel_noise_, grid,
+        rate_numerator, rate_denominator));
+  }
+
+ private:
+  static constexpr int kGridBits = 10;
+  static constexpr int kRatePrecisionBits = 25;
+
+  std::optional<double> epsilon_;
+  std::optional<int> k_;
+  double l_inf_sensitivity_ = 1;
+  bool monotonic_scores_ = false;
+  bool use_gumbel_noise_ = false;
+};
+
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_ALGORITHMS_TOP_K_SELECTION_H_
@@ -0,0 +1,166 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "algorithms/top-k-selection.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+namespace differential_privacy {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::DoubleEq;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::UnorderedElementsAre;
+
+TEST(TopKSelectionTest, SelectsLargestScoresInOrder) {
+  std::unique_ptr<TopKSelection> top_k =
+      TopKSelection::Builder().SetEpsilon(1).SetK(3).Build().value();
+  std::vector<double> scores(1000, 0);
+  scores[17] = 1e6;
+  scores[503] = 3e6;
+  scores[999] = 2e6;
+
+  absl::StatusOr<std::vector<int64_t>> selected = top_k->Select(scores);
+  ASSERT_OK(selected);
+  EXPECT_THAT(*selected, ElementsAre(503, 999, 17));
+}
+
+TEST(TopKSelectionTest, ReturnsAllCandidatesIfAtMostK) {
+  std::unique_ptr<TopKSelection> top_k =
+      TopKSelection::Builder().SetEpsilon(1).SetK(5).Build().value();
+
+  absl::StatusOr<std::vector<int64_t>> selected = top_k->Select({1, 2, 3});
+  ASSERT_OK(selected);
+  EXPECT_THAT(*selected, UnorderedElementsAre(0, 1, 2));
+  selected = top_k->Select({});
+  ASSERT_OK(selected);
+  EXPECT_TRUE(selected->empty());
+}
+
+TEST(TopKSelectionTest, CalibratesGumbelScale) {
+  EXPECT_THAT(TopKSelection::Builder()
+                  .SetEpsilon(2)
+                  .SetK(4)
+                  .SetLInfSensitivity(3)
+                  .Build()
+                  .value()
+                  ->GetGumbelScale(),
+              DoubleEq(12));
+  EXPECT_THAT(TopKSelection::Builder()
+                  .SetEpsilon(2)
+                  .SetK(4)
+                  .SetLInfSensitivity(3)
+                  .SetMonotonicScores(true)
+                  .Build()
+                  .value()
+                  ->GetGumbelScale(),
+              DoubleEq(6));
+}
+
+class TopKSelectionSamplerTest : public ::testing::TestWithParam<bool> {};
+
+INSTANTIATE_TEST_SUITE_P(PeelingAndGumbelNoise, TopKSelectionSamplerTest,
+                         ::testing::Bool());
+
+TEST_P(TopKSelectionSamplerTest, MatchesExponentialMechanismForTopOne) {
+  const double epsilon = 1;
+  std::unique_ptr<TopKSelection> top_k = TopKSelection::Builder()
+                                             .SetEpsilon(epsilon)
+                                             .SetK(1)
+                                             .SetUseGumbelNoise(GetParam())
+                                             .Build()
+                                             .value();
+  const std::vector<double> scores = {0, 1, 2, 4};
+  double normalization = 0;
+  for (double score : scores) {
+    normalization += std::exp(epsilon * score / 2);
+  }
+
+  const int num_trials = 20000;
+  std::vector<int> num_selected(scores.size(), 0);
+  for (int i = 0; i < num_trials; ++i) {
+    absl::StatusOr<std::vector<int64_t>> selected = top_k->Select(scores);
+    ASSERT_OK(selected);
+    ASSERT_EQ(selected->size(), 1);
+    ++num_selected[selected->front()];
+  }
+  for (size_t i = 0; i < scores.size(); ++i) {
+    const double expected = std::exp(epsilon * scores[i] / 2) / normalization;
+    // More than 5 standard deviations for every candidate.
+    EXPECT_NEAR(static_cast<double>(num_selected[i]) / num_trials, expected,
+                0.02)
+        << "candidate " << i;
+  }
+}
+
+TEST_P(TopKSelectionSamplerTest, SelectsLargestScoresInOrder) {
+  std::unique_ptr<TopKSelection> top_k = TopKSelection::Builder()
+                                             .SetEpsilon(1)
+                                             .SetK(2)
+                                             .SetUseGumbelNoise(GetParam())
+                                             .Build()
+                                             .value();
+
+  absl::StatusOr<std::vector<int64_t>> selected =
+      top_k->Select({-1e6, 1e9, 5, 1e8});
+  ASSERT_OK(selected);
+  EXPECT_THAT(*selected, ElementsAre(1, 3));
+}
+
+TEST(TopKSelectionTest, RejectsNonFiniteScores) {
+  std::unique_ptr<TopKSelection> top_k =
+      TopKSelection::Builder().SetEpsilon(1).SetK(1).Build().value();
+  EXPECT_THAT(top_k->Select({1, std::numeric_limits<double>::quiet_NaN()}),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("finite")));
+  EXPECT_THAT(top_k->Select({std::numeric_limits<double>::infinity()}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(TopKSelectionTest, ValidatesParameters) {
+  EXPECT_THAT(TopKSelection::Builder().SetK(1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Epsilon")));
+  EXPECT_THAT(TopKSelection::Builder().SetEpsilon(1).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("K")));
+  EXPECT_THAT(TopKSelection::Builder().SetEpsilon(1).SetK(0).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("K")));
+  EXPECT_THAT(TopKSelection::Builder()
+                  .SetEpsilon(1)
+                  .SetK(1)
+                  .SetLInfSensitivity(0)
+                  .Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("sensitivity")));
+  EXPECT_THAT(TopKSelection::Builder().SetEpsilon(1e-12).SetK(10).Build(),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("too small")));
+}
+
+}  // namespace
+}  // namespace differential_privacy
@@ -22,9 +22,11 @@
 #include <optional>
 #include <vector>
 
+#include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
@@ -33,56 +35,100 @@ double DefaultEpsilon() { return std::log(3); }
 
 double GetNextPowerOfTwo(double n) { return std::pow(2.0, ceil(log2(n))); }
 
-double InverseErrorFunction(double x) {
-  double LESS_THAN_FIVE_CONSTANTS[] = {
-      0.0000000281022636, 0.000000343273939, -0.0000035233877,
-      -0.00000439150654,  0.00021858087,     -0.00125372503,
-      -0.00417768164,     0.246640727,       1.50140941};
-  double GREATER_THAN_FIVE_CONSTANTS[] = {
-      -0.000200214257, 0.000100950558, 0.00134934322,
-      -0.00367342844,  0.00573950773,  -0.0076224613,
-      0.00943887047,   1.00167406,     2.83297682};
-
-  double constantArray[9];
-  double w = -std::log((1 - x) * (1 + x));
-  double ans = 0;
+namespace {
+
+// Coefficients of the polynomials in w from Table 5 in Giles' paper, highest
+// degree first.
+constexpr double kInverseErrorFunctionLessThanFive[] = {
+    0.0000000281022636, 0.000000343273939, -0.0000035233877,
+    -0.00000439150654,  0.00021858087,     -0.00125372503,
+    -0.00417768164,     0.246640727,       1.50140941};
+constexpr double kInverseErrorFunctionGreaterThanFive[] = {
+    -0.000200214257, 0.000100950558, 0.00134934322,
+    -0.00367342844,  0.00573950773,  -0.0076224613,
+    0.00943887047,   1.00167406,     2.83297682};
+
+// Coefficients of Abramowitz and Stegun formula 26.2.23.
+constexpr double kQnormC0 = 2.515517;
+constexpr double kQnormC1 = 0.802853;
+constexpr double kQnormC2 = 0.010328;
+constexpr double kQnormD0 = 1.432788;
+constexpr double kQnormD1 = 0.189269;
+constexpr double kQnormD2 = 0.001308;
+
+absl::Status ValidateQnormProbability(double p) {
+  if (p <= 0.0 || p >= 1.0) {
+    return absl::InvalidArgumentError(
+        "Probability must be between 0 and 1, exclusive.");
+  }
+  return absl::OkStatus();
+}
+
+// Qnorm for a p that has already been validated.
+double UncheckedQnorm(double p, double mu, double sigma) {
+  double t = std::sqrt(-2.0 * std::log(std::min(p, 1.0 - p)));
+  double normalized =
+      t - ((kQnormC2 * t + kQnormC1) * t + kQnormC0) /
+              (((kQnormD2 * t + kQnormD1) * t + kQnormD0) * t + 1.0);
+  if (p < .5) {
+    normalized *= -1;
+  }
+  return normalized * sigma + mu;
+}
+
+}  // namespace
 
+double InverseErrorFunction(double x) {
   if (std::abs(x) == 1) {
     return x * std::numeric_limits<double>::infinity();
   }
 
+  double w = -std::log((1 - x) * (1 + x));
+  const double* coefficients;
   if (w < 5) {
     w = w - 2.5;
-    std::copy(std::begin(LESS_THAN_FIVE_CONSTANTS),
-              std::end(LESS_THAN_FIVE_CONSTANTS), std::begin(constantArray));
+    coefficients = kInverseErrorFunctionLessThanFive;
   } else {
     w = std::sqrt(w) - 3;
-    std::copy(std::begin(GREATER_THAN_FIVE_CONSTANTS),
-              std::end(GREATER_THAN_FIVE_CONSTANTS), std::begin(constantArray));
+    coefficients = kInverseErrorFunctionGreaterThanFive;
   }
 
+  double ans = 0;
   for (int i = 0; i < 9; i++) {
-    double coefficient = constantArray[i];
-    ans = coefficient + ans * w;
+    ans = coefficients[i] + ans * w;
   }
 
   return ans * x;
 }
 
+void InverseErrorFunction(absl::Span<const double> x,
+                          absl::Span<double> result) {
+  DCHECK_EQ(x.size(), result.size());
+  for (size_t i = 0; i < x.size(); ++i) {
+    result[i] = InverseErrorFunction(x[i]);
+  }
+}
+
 absl::StatusOr<double> Qnorm(double p, double mu, double sigma) {
-  if (p <= 0.0 || p >= 1.0) {
+  RETURN_IF_ERROR(ValidateQnormProbability(p));
+  return UncheckedQnorm(p, mu, sigma);
+}
+
+absl::Status Qnorm(absl::Span<const double> p, absl::Span<double> result,
+                   double mu, double sigma) {
+  if (p.size() != result.size()) {
     return absl::InvalidArgumentError(
-        "Probability must be between 0 and 1, exclusive.");
+        absl::StrCat("Expected as many results as probabilities, but got ",
+                     result.size(), " results for ", p.size(),
+                     " probabilities."));
   }
-  double t = std::sqrt(-2.0 * std::log(std::min(p, 1.0 - p)));
-  std::vector<double> c = {2.515517, 0.802853, 0.010328};
-  std::vector<double> d = {1.432788, 0.189269, 0.001308};
-  double normalized = t - ((c[2] * t + c[1]) * t + c[0]) /
-                              (((d[2] * t + d[1]) * t + d[0]) * t + 1.0);
-  if (p < .5) {
-    normalized *= -1;
+  for (double probability : p) {
+    RETURN_IF_ERROR(ValidateQnormProbability(probability));
   }
-  return normalized * sigma + mu;
+  for (size_t i = 0; i < p.size(); ++i) {
+    result[i] = UncheckedQnorm(p[i], mu, sigma);
+  }
+  return absl::OkStatus();
 }
 
 double RoundToNearestDoubleMultiple(double n, double base) {
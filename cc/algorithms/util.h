@@ -34,6 +34,7 @@
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "base/status_macros.h"
 
 namespace differential_privacy {
@@ -83,12 +84,24 @@ T sign(T n) {
 // (https://people.maths.ox.ac.uk/gilesm/files/gems_erfinv.pdf).
 double InverseErrorFunction(double x);
 
+// Writes InverseErrorFunction(x[i]) to result[i]. The results are identical to
+// those of the scalar version. Both spans must have the same size.
+void InverseErrorFunction(absl::Span<const double> x,
+                          absl::Span<double> result);
+
 // Estimation of the inverse cdf of the normal distribution centered at mu with
 // standard deviation sigma, at probability p. Based on Abramowitz and Stegun
 // formula 26.2.23. The error of the estimation is bounded by 4.5 e-4. This
 // function will fail if higher accuracy is required.
 absl::StatusOr<double> Qnorm(double p, double mu = 0.0, double sigma = 1.0);
 
+// Writes Qnorm(p[i], mu, sigma) to result[i], with the same accuracy as the
+// scalar version, e.g., for the bounds of many confidence intervals. Fails
+// without writing any result if the spans have different sizes or any p[i] is
+// not in (0, 1).
+absl::Status Qnorm(absl::Span<const double> p, absl::Span<double> result,
+                   double mu = 0.0, double sigma = 1.0);
+
 template <typename T>
 inline const T& Clamp(const T& low, const T& high, const T& value) {
   // Prevents errors in ordering the arguments.
@@ -98,6 +111,30 @@ inline const T& Clamp(const T& low, const T& high, const T& value) {
   return value;
 }
 
+// Sum of doubles whose rounding error does not grow with the number of terms,
+// using Neumaier's variant of Kahan summation.
+class CompensatedSum {
+ public:
+  void Add(double value) {
+    const double sum = sum_ + value;
+    if (std::abs(sum_) >= std::abs(value)) {
+      compensation_ += (sum_ - sum) + value;
+    } else {
+      compensation_ += (value - sum) + sum_;
+    }
+    sum_ = sum;
+  }
+
+  double Value() const {
+    // The compensation is NaN once the sum is infinite.
+    return std::isfinite(sum_) ? sum_ + compensation_ : sum_;
+  }
+
+ private:
+  double sum_ = 0;
+  double compensation_ = 0;
+};
+
 // Return value for the Safe* operation functions below, including the cast
 // resulting value of the operation and whether or not the operation caused an
 // overflow.
@@ -310,6 +347,137 @@ inline SafeOpResult<T> SafeCastFromDouble(const double in) {
   return SafeOpResult<T>{static_cast<T>(in), false};
 }
 
+// Batch versions of the Safe* operations above. They compute the same values
+// element-wise into `out`, which must have the size of the inputs and may
+// alias them, and return whether any element overflowed. The loops have no
+// data-dependent branches, so that compilers vectorize them; for integral
+// types, overflows are detected from the sign bits of wrapping arithmetic
+// and the saturated values are selected instead of branched to. Only signed
+// integral and floating-point types are supported.
+template <typename T>
+inline bool SafeAddBatch(absl::Span<const T> lhs, absl::Span<const T> rhs,
+                         absl::Span<T> out) {
+  DCHECK_EQ(lhs.size(), rhs.size());
+  DCHECK_EQ(lhs.size(), out.size());
+  if constexpr (std::is_floating_point_v<T>) {
+    for (size_t i = 0; i < lhs.size(); ++i) out[i] = lhs[i] + rhs[i];
+    return false;
+  } else {
+    static_assert(std::is_signed_v<T>,
+                  "SafeAddBatch requires signed integral types");
+    using U = std::make_unsigned_t<T>;
+    constexpr int kSignBit = std::numeric_limits<U>::digits - 1;
+    U overflow = 0;
+    for (size_t i = 0; i < lhs.size(); ++i) {
+      const T a = lhs[i];
+      const T b = rhs[i];
+      const T sum = static_cast<T>(static_cast<U>(a) + static_cast<U>(b));
+      // Overflows iff both operands have the same sign and the sum the other.
+      const U overflowed = static_cast<U>((~(a ^ b)) & (a ^ sum)) >> kSignBit;
+      // max() for non-negative a, lowest() for negative a.
+      const T saturated = std::numeric_limits<T>::max() ^ (a >> kSignBit);
+      out[i] = overflowed ? saturated : sum;
+      overflow |= overflowed;
+    }
+    return overflow != 0;
+  }
+}
+
+template <typename T>
+inline bool SafeSubtractBatch(absl::Span<const T> lhs, absl::Span<const T> rhs,
+                              absl::Span<T> out) {
+  DCHECK_EQ(lhs.size(), rhs.size());
+  DCHECK_EQ(lhs.size(), out.size());
+  if constexpr (std::is_floating_point_v<T>) {
+    for (size_t i = 0; i < lhs.size(); ++i) out[i] = lhs[i] - rhs[i];
+    return false;
+  } else {
+    static_assert(std::is_signed_v<T>,
+                  "SafeSubtractBatch requires signed integral types");
+    using U = std::make_unsigned_t<T>;
+    constexpr int kSignBit = std::numeric_limits<U>::digits - 1;
+    U overflow = 0;
+    for (size_t i = 0; i < lhs.size(); ++i) {
+      const T a = lhs[i];
+      const T b = rhs[i];
+      const T difference =
+          static_cast<T>(static_cast<U>(a) - static_cast<U>(b));
+      // Overflows iff the operands have different signs and the difference
+      // has the sign of b.
+      const U overflowed =
+          static_cast<U>((a ^ b) & (a ^ difference)) >> kSignBit;
+      const T saturated = std::numeric_limits<T>::max() ^ (a >> kSignBit);
+      out[i] = overflowed ? saturated : difference;
+      overflow |= overflowed;
+    }
+    return overflow != 0;
+  }
+}
+
+// Like SafeSquare, overflowed elements are 0.
+template <typename T>
+inline bool SafeSquareBatch(absl::Span<const T> in, absl::Span<T> out) {
+  DCHECK_EQ(in.size(), out.size());
+  static_assert(std::is_integral_v<T> && std::is_signed_v<T>,
+                "SafeSquareBatch requires signed integral types");
+  using U = std::make_unsigned_t<T>;
+  // Same limit as SafeSquare.
+  const T max_root =
+      static_cast<T>(std::pow(std::numeric_limits<T>::max(), 0.5));
+  U overflow = 0;
+  for (size_t i = 0; i < in.size(); ++i) {
+    const T num = in[i];
+    const U overflowed = (num > max_root) | (num < -max_root);
+    const T square = static_cast<T>(static_cast<U>(num) * static_cast<U>(num));
+    out[i] = overflowed ? 0 : square;
+    overflow |= overflowed;
+  }
+  return overflow != 0;
+}
+
+// Casts the values that are within the limits of T in a vectorizable loop.
+// Only if some are not, those are cast again with SafeCastFromDouble, so that
+// out-of-range values wrap around the same way.
+template <typename T>
+inline bool SafeCastFromDoubleBatch(absl::Span<const double> in,
+                                    absl::Span<T> out) {
+  DCHECK_EQ(in.size(), out.size());
+  if constexpr (std::is_floating_point_v<T>) {
+    for (size_t i = 0; i < in.size(); ++i) out[i] = static_cast<T>(in[i]);
+    return false;
+  } else {
+    static_assert(std::is_signed_v<T>,
+                  "SafeCastFromDoubleBatch requires signed integral types");
+    // -lowest() is a power of two, so both limits are exact doubles. Values
+    // below the upper limit are at most max() when truncated; the comparisons
+    // are false for NaN.
+    constexpr double kLowest =
+        static_cast<double>(std::numeric_limits<T>::lowest());
+    const double upper_limit = std::min(
+        -kLowest, std::nextafter(static_cast<double>(
+                                     std::numeric_limits<T>::max()),
+                                 std::numeric_limits<double>::infinity()));
+    T out_of_range = 0;
+    for (size_t i = 0; i < in.size(); ++i) {
+      const double d = in[i];
+      const T in_range = (d >= kLowest) & (d < upper_limit);
+      out[i] = static_cast<T>(in_range ? d : 0);
+      out_of_range |= in_range ^ 1;
+    }
+    if (out_of_range == 0) return false;
+    bool overflow = false;
+    for (size_t i = 0; i < in.size(); ++i) {
+      const double d = in[i];
+      if (!(d >= kLowest && d < upper_limit)) {
+        const SafeOpResult<T> result = SafeCastFromDouble<T>(d);
+        out[i] = result.value;
+        overflow |= result.overflow;
+      }
+    }
+    return overflow;
+  }
+}
+
 template <typename T>
 inline double Mean(const std::vector<T>& v) {
   if (v.empty()) {
@@ -16,6 +16,8 @@
 
 #include "algorithms/util.h"
 
+#include <cmath>
+#include <cstdint>
 #include <limits>
 #include <optional>
 #include <vector>
@@ -24,12 +26,14 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
+#include "absl/types/span.h"
 #include "algorithms/distributions.h"
 #include "algorithms/numerical-mechanisms-testing.h"
 
 namespace differential_privacy {
 namespace {
 
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::differential_privacy::base::testing::StatusIs;
 
@@ -90,6 +94,15 @@ TEST(InverseErrorTest, EdgeCases) {
   EXPECT_EQ(InverseErrorFunction(0), 0);
 }
 
+TEST(InverseErrorTest, BatchMatchesScalarVersion) {
+  std::vector<double> x = {-1, -0.9999, -0.5, -0.0067, 0, 0.24, 0.99, 1};
+  std::vector<double> result(x.size());
+  InverseErrorFunction(x, absl::MakeSpan(result));
+  for (int i = 0; i < x.size(); ++i) {
+    EXPECT_EQ(result[i], InverseErrorFunction(x[i]));
+  }
+}
+
 // In RoundToNearestMultiple tests exact comparison of double is used, because
 // for rounding to multiple of power of 2 RoundToNearestMultiple should provide
 // exact value.
@@ -194,6 +207,27 @@ TEST(QnormTest, Accuracy) {
   }
 }
 
+TEST(QnormTest, BatchMatchesScalarVersion) {
+  std::vector<double> p = {0.0000001, 0.05, 0.45, 0.5, 0.55, 0.999};
+  std::vector<double> result(p.size());
+  ASSERT_OK(Qnorm(p, absl::MakeSpan(result), 3.0, 2.0));
+  for (int i = 0; i < p.size(); ++i) {
+    EXPECT_EQ(result[i], Qnorm(p[i], 3.0, 2.0).value());
+  }
+}
+
+TEST(QnormTest, BatchRejectsInvalidArguments) {
+  std::vector<double> p = {0.5, 1.0};
+  std::vector<double> result = {-1, -1};
+  EXPECT_THAT(Qnorm(p, absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("between 0 and 1")));
+  EXPECT_THAT(result, ElementsAre(-1, -1));
+  EXPECT_THAT(Qnorm(p, absl::MakeSpan(result).subspan(1)),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("as many results")));
+}
+
 TEST(ClampTest, DefaultTest) {
   EXPECT_EQ(Clamp(1, 3, 2), 2);
   EXPECT_EQ(Clamp(1.0, 3.0, 4.0), 3);
@@ -488,6 +522,114 @@ TEST(SafeCastFromDoubleTest, ForFloat) {
   EXPECT_FALSE(cast_result.overflow);
 }
 
+// Values around the limits of T, zero and a few ordinary values.
+template <typename T>
+std::vector<T> EdgeValues() {
+  constexpr T kMax = std::numeric_limits<T>::max();
+  constexpr T kLowest = std::numeric_limits<T>::lowest();
+  return {kLowest, kLowest + 1, kLowest / 2, -3, -1, 0,
+          1,       7,           kMax / 2,    kMax - 1, kMax};
+}
+
+template <typename T>
+class SafeBatchOperationsTest : public ::testing::Test {};
+
+using SignedIntegralTypes = ::testing::Types<int32_t, int64_t>;
+TYPED_TEST_SUITE(SafeBatchOperationsTest, SignedIntegralTypes);
+
+TYPED_TEST(SafeBatchOperationsTest, AddAndSubtractMatchScalarOperations) {
+  // All pairs of edge values.
+  std::vector<TypeParam> lhs;
+  std::vector<TypeParam> rhs;
+  for (TypeParam a : EdgeValues<TypeParam>()) {
+    for (TypeParam b : EdgeValues<TypeParam>()) {
+      lhs.push_back(a);
+      rhs.push_back(b);
+    }
+  }
+  std::vector<TypeParam> sums(lhs.size());
+  std::vector<TypeParam> differences(lhs.size());
+
+  const bool add_overflow =
+      SafeAddBatch<TypeParam>(lhs, rhs, absl::MakeSpan(sums));
+  const bool subtract_overflow =
+      SafeSubtractBatch<TypeParam>(lhs, rhs, absl::MakeSpan(differences));
+
+  EXPECT_TRUE(add_overflow);
+  EXPECT_TRUE(subtract_overflow);
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    EXPECT_EQ(sums[i], SafeAdd(lhs[i], rhs[i]).value)
+        << lhs[i] << " + " << rhs[i];
+    EXPECT_EQ(differences[i], SafeSubtract(lhs[i], rhs[i]).value)
+        << lhs[i] << " - " << rhs[i];
+  }
+}
+
+TYPED_TEST(SafeBatchOperationsTest, ReportsNoOverflowForInRangeBatches) {
+  const std::vector<TypeParam> lhs = {1, -2, 3, 0, 100, -100};
+  const std::vector<TypeParam> rhs = {-5, 6, 7, 0, 27, -27};
+  std::vector<TypeParam> out(lhs.size());
+
+  EXPECT_FALSE(SafeAddBatch<TypeParam>(lhs, rhs, absl::MakeSpan(out)));
+  EXPECT_THAT(out, ElementsAre(-4, 4, 10, 0, 127, -127));
+  EXPECT_FALSE(SafeSubtractBatch<TypeParam>(lhs, rhs, absl::MakeSpan(out)));
+  EXPECT_THAT(out, ElementsAre(6, -8, -4, 0, 73, -73));
+  EXPECT_FALSE(SafeSquareBatch<TypeParam>(lhs, absl::MakeSpan(out)));
+  EXPECT_THAT(out, ElementsAre(1, 4, 9, 0, 10000, 10000));
+}
+
+TYPED_TEST(SafeBatchOperationsTest, SquareMatchesSafeSquare) {
+  const std::vector<TypeParam> in = EdgeValues<TypeParam>();
+  std::vector<TypeParam> out(in.size());
+
+  EXPECT_TRUE(SafeSquareBatch<TypeParam>(in, absl::MakeSpan(out)));
+  for (size_t i = 0; i < in.size(); ++i) {
+    EXPECT_EQ(out[i], SafeSquare(in[i]).value) << in[i];
+  }
+}
+
+TYPED_TEST(SafeBatchOperationsTest, CastFromDoubleMatchesSafeCastFromDouble) {
+  const double max = std::numeric_limits<TypeParam>::max();
+  const double lowest = std::numeric_limits<TypeParam>::lowest();
+  const std::vector<double> in = {0,
+                                  -0.5,
+                                  20.7,
+                                  -20.7,
+                                  max,
+                                  max + 0.5,
+                                  max * 4,
+                                  lowest,
+                                  lowest - 0.5,
+                                  lowest * 4,
+                                  std::nextafter(-lowest, 0),
+                                  -lowest,
+                                  std::numeric_limits<double>::infinity(),
+                                  std::numeric_limits<double>::quiet_NaN()};
+  std::vector<TypeParam> out(in.size());
+
+  EXPECT_TRUE(SafeCastFromDoubleBatch<TypeParam>(in, absl::MakeSpan(out)));
+  for (size_t i = 0; i < in.size(); ++i) {
+    EXPECT_EQ(out[i], SafeCastFromDouble<TypeParam>(in[i]).value) << in[i];
+  }
+
+  // Only the in-range prefix.
+  EXPECT_FALSE(SafeCastFromDoubleBatch<TypeParam>(
+      absl::MakeConstSpan(in).first(5), absl::MakeSpan(out).first(5)));
+}
+
+TEST(SafeBatchOperationsTest, FloatingPointNeverOverflows) {
+  const std::vector<double> lhs = {1.5, std::numeric_limits<double>::max()};
+  const std::vector<double> rhs = {2, std::numeric_limits<double>::max()};
+  std::vector<double> out(2);
+
+  EXPECT_FALSE(SafeAddBatch<double>(lhs, rhs, absl::MakeSpan(out)));
+  EXPECT_THAT(out, ElementsAre(3.5, std::numeric_limits<double>::infinity()));
+  EXPECT_FALSE(SafeSubtractBatch<double>(lhs, rhs, absl::MakeSpan(out)));
+  EXPECT_THAT(out, ElementsAre(-0.5, 0));
+  EXPECT_FALSE(SafeCastFromDoubleBatch<double>(lhs, absl::MakeSpan(out)));
+  EXPECT_THAT(out, ElementsAre(1.5, std::numeric_limits<double>::max()));
+}
+
 TEST(ValidateTest, IsSet) {
   std::optional<double> opt;
   EXPECT_THAT(ValidateIsSet(opt, "Test value"),
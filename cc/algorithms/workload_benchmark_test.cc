@@ -0,0 +1,98 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// C++ side of the cross-language workload benchmarks described in
+// benchmarks/README.md. The workloads and their parameters must be kept in
+// sync with the Go and Java implementations. Every iteration builds the
+// algorithm, adds all entries one by one and computes the result, like the
+// other languages do, so that the numbers are comparable.
+
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/benchmark-fixtures.h"
+#include "algorithms/numerical-mechanisms.h"
+
+namespace differential_privacy {
+namespace {
+
+using benchmark_fixtures::AlgorithmFactory;
+using benchmark_fixtures::kEpsilon;
+using benchmark_fixtures::MakeBoundedMean;
+using benchmark_fixtures::MakeBoundedSum;
+using benchmark_fixtures::MakeCount;
+using benchmark_fixtures::MakeEntries;
+using benchmark_fixtures::MakeQuantiles;
+
+constexpr double kDelta = 1e-5;
+
+void WorkloadSizes(benchmark::internal::Benchmark* benchmark) {
+  benchmark->Arg(1 << 10)->Arg(1 << 15)->Arg(1 << 20);
+}
+
+void BM_Workload(benchmark::State& state, AlgorithmFactory make_algorithm) {
+  const std::vector<double> entries = MakeEntries(state.range(0));
+  for (auto _ : state) {
+    std::unique_ptr<Algorithm<double>> algorithm = make_algorithm();
+    for (double entry : entries) {
+      algorithm->AddEntry(entry);
+    }
+    benchmark::DoNotOptimize(algorithm->PartialResult());
+  }
+  state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK_CAPTURE(BM_Workload, Count, &MakeCount)->Apply(WorkloadSizes);
+BENCHMARK_CAPTURE(BM_Workload, BoundedSum, &MakeBoundedSum)
+    ->Apply(WorkloadSizes);
+BENCHMARK_CAPTURE(BM_Workload, BoundedMean, &MakeBoundedMean)
+    ->Apply(WorkloadSizes);
+BENCHMARK_CAPTURE(BM_Workload, Quantiles, &MakeQuantiles)
+    ->Apply(WorkloadSizes);
+
+void BM_NoiseWorkload(benchmark::State& state,
+                      std::unique_ptr<NumericalMechanism> mechanism) {
+  const std::vector<double> entries = MakeEntries(state.range(0));
+  for (auto _ : state) {
+    double result = 0;
+    for (double entry : entries) {
+      result += mechanism->AddNoise(entry);
+    }
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetItemsProcessed(state.iterations() * entries.size());
+}
+BENCHMARK_CAPTURE(BM_NoiseWorkload, LaplaceNoise,
+                  LaplaceMechanism::Builder()
+                      .SetEpsilon(kEpsilon)
+                      .SetL0Sensitivity(1)
+                      .SetLInfSensitivity(1)
+                      .Build()
+                      .value())
+    ->Apply(WorkloadSizes);
+BENCHMARK_CAPTURE(BM_NoiseWorkload, GaussianNoise,
+                  GaussianMechanism::Builder()
+                      .SetEpsilon(kEpsilon)
+                      .SetDelta(kDelta)
+                      .SetL0Sensitivity(1)
+                      .SetLInfSensitivity(1)
+                      .Build()
+                      .value())
+    ->Apply(WorkloadSizes);
+
+}  // namespace
+}  // namespace differential_privacy
@@ -0,0 +1,139 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "base/instrumentation.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace differential_privacy {
+namespace instrumentation {
+
+namespace internal {
+
+std::atomic<Sink*> sink{nullptr};
+thread_local std::array<int, kNumEvents> depth{};
+
+}  // namespace internal
+
+absl::string_view EventName(Event event) {
+  switch (event) {
+    case Event::kAlgorithmAddEntries:
+      return "algorithm_add_entries";
+    case Event::kAlgorithmPartialResult:
+      return "algorithm_partial_result";
+    case Event::kAlgorithmSerialize:
+      return "algorithm_serialize";
+    case Event::kAlgorithmMerge:
+      return "algorithm_merge";
+    case Event::kMechanismAddNoise:
+      return "mechanism_add_noise";
+    case Event::kSecureUrbgRefreshBuffer:
+      return "secure_urbg_refresh_buffer";
+    case Event::kPldCompose:
+      return "pld_compose";
+    case Event::kAlgorithmBuild:
+      return "algorithm_build";
+    case Event::kKeyedAddContributions:
+      return "keyed_add_contributions";
+    case Event::kPartitionSelection:
+      return "partition_selection";
+    case Event::kAccountantSearch:
+      return "accountant_search";
+  }
+  return "unknown";
+}
+
+void SetSink(Sink* sink) {
+  internal::sink.store(sink, std::memory_order_release);
+}
+
+Sink* GetSink() { return internal::sink.load(std::memory_order_acquire); }
+
+namespace {
+
+// Returns the latency bucket of a time, i.e., the number of bits of its
+// nanoseconds, capped at the last bucket.
+int LatencyBucket(int64_t nanos) {
+  int bucket = 0;
+  for (uint64_t n = std::max<int64_t>(nanos, 0); n != 0; n >>= 1) {
+    ++bucket;
+  }
+  return std::min(bucket, kNumLatencyBuckets - 1);
+}
+
+}  // namespace
+
+absl::Duration AggregatingSink::Totals::LatencyQuantile(double q) const {
+  int64_t calls_in_buckets = 0;
+  for (int64_t bucket_calls : latency_buckets) {
+    calls_in_buckets += bucket_calls;
+  }
+  const double rank = std::ceil(std::clamp(q, 0.0, 1.0) * calls_in_buckets);
+  int64_t calls_below = 0;
+  for (int i = 0; i < kNumLatencyBuckets; ++i) {
+    calls_below += latency_buckets[i];
+    if (calls_below > 0 && calls_below >= rank) {
+      return absl::Nanoseconds(int64_t{1} << i);
+    }
+  }
+  return absl::ZeroDuration();
+}
+
+void AggregatingSink::Record(Event event, int64_t count,
+                             absl::Duration elapsed) {
+  AtomicTotals& totals = totals_[static_cast<int>(event)];
+  const int64_t nanos = absl::ToInt64Nanoseconds(elapsed);
+  totals.calls.fetch_add(1, std::memory_order_relaxed);
+  totals.count.fetch_add(count, std::memory_order_relaxed);
+  totals.elapsed_nanos.fetch_add(nanos, std::memory_order_relaxed);
+  totals.latency_buckets[LatencyBucket(nanos)].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+AggregatingSink::Totals AggregatingSink::Get(Event event) const {
+  const AtomicTotals& totals = totals_[static_cast<int>(event)];
+  Totals result;
+  result.calls = totals.calls.load(std::memory_order_relaxed);
+  result.count = totals.count.load(std::memory_order_relaxed);
+  result.elapsed =
+      absl::Nanoseconds(totals.elapsed_nanos.load(std::memory_order_relaxed));
+  for (int i = 0; i < kNumLatencyBuckets; ++i) {
+    result.latency_buckets[i] =
+        totals.latency_buckets[i].load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+void AggregatingSink::Reset() {
+  for (AtomicTotals& totals : totals_) {
+    totals.calls.store(0, std::memory_order_relaxed);
+    totals.count.store(0, std::memory_order_relaxed);
+    totals.elapsed_nanos.store(0, std::memory_order_relaxed);
+    for (std::atomic<int64_t>& bucket_calls : totals.latency_buckets) {
+      bucket_calls.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+}  // namespace instrumentation
+}  // namespace differential_privacy
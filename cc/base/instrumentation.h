@@ -0,0 +1,228 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_BASE_INSTRUMENTATION_H_
+#define DIFFERENTIAL_PRIVACY_BASE_INSTRUMENTATION_H_
+
+// Counters and timers for the hot paths of the library, e.g., to find out how
+// much time is spent adding entries, noising, and serializing in production.
+//
+// Events are reported to the sink installed with SetSink, if any. Without a
+// sink, an instrumented call costs one atomic load. Defining
+// DIFFERENTIAL_PRIVACY_DISABLE_INSTRUMENTATION at compile time removes the
+// instrumentation entirely.
+//
+// Every event is a span: the sink is told when it begins and when it ends, so
+// that it can be forwarded to a tracer, e.g., to TRACE_EVENT_BEGIN and
+// TRACE_EVENT_END of Perfetto, or to start and end an OpenTelemetry span.
+// Spans of different events nest, e.g., noising within a partial result.
+//
+// Example:
+//   class MetricsSink : public instrumentation::Sink {
+//    public:
+//     void Record(instrumentation::Event event, int64_t count,
+//                 absl::Duration elapsed) override {
+//       // Export to the metrics system; must be thread safe.
+//     }
+//   };
+//   MetricsSink sink;
+//   instrumentation::SetSink(&sink);
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace differential_privacy {
+namespace instrumentation {
+
+#ifdef DIFFERENTIAL_PRIVACY_DISABLE_INSTRUMENTATION
+inline constexpr bool kEnabled = false;
+#else
+inline constexpr bool kEnabled = true;
+#endif
+
+// Instrumented operations.
+enum class Event {
+  // Algorithm::AddEntries, counting the entries. Entries added one by one with
+  // AddEntry are not instrumented, since timing them would cost more than
+  // adding them.
+  kAlgorithmAddEntries,
+  // Algorithm::PartialResult.
+  kAlgorithmPartialResult,
+  // Algorithm::Serialize.
+  kAlgorithmSerialize,
+  // Algorithm::Merge.
+  kAlgorithmMerge,
+  // NumericalMechanism::AddNoise, counting the noised values.
+  kMechanismAddNoise,
+  // Refill of the buffer of random bytes of SecureURBG, counting the bytes.
+  kSecureUrbgRefreshBuffer,
+  // PrivacyLossDistribution::Compose and ComposeAll, counting the composed
+  // distributions.
+  kPldCompose,
+  // AlgorithmBuilder::Build.
+  kAlgorithmBuild,
+  // KeyedAggregator::AddPrivacyUnitContributions, counting the contributions.
+  kKeyedAddContributions,
+  // Partition selection of KeyedAggregator, counting the partitions that are
+  // considered. Noising the kept partitions follows as kMechanismAddNoise.
+  kPartitionSelection,
+  // Search of an accountant for the smallest noise parameter.
+  kAccountantSearch,
+};
+
+inline constexpr int kNumEvents =
+    static_cast<int>(Event::kAccountantSearch) + 1;
+
+// Returns a stable name of the event, e.g., for metric names.
+absl::string_view EventName(Event event);
+
+// Receives the instrumented events. Record is called concurrently from all
+// threads that use the library, so implementations must be thread safe.
+class Sink {
+ public:
+  virtual ~Sink() = default;
+
+  // Called once per instrumented call, before it starts, on the thread that
+  // makes the call. Tracers open a span here. Does nothing by default.
+  virtual void Begin(Event event) {}
+
+  // Called once per instrumented call, after it returned, on the same thread
+  // as Begin. Tracers close the span here. count is the number
+  // of items the call processed, e.g., entries or noised values, and elapsed
+  // its wall time.
+  virtual void Record(Event event, int64_t count, absl::Duration elapsed) = 0;
+};
+
+// Installs the sink that receives all events from now on, or removes it if
+// sink is null. Does not take ownership; the sink must outlive all calls into
+// the library that may still report to it.
+void SetSink(Sink* sink);
+
+// Returns the installed sink, or null.
+Sink* GetSink();
+
+// Number of buckets of the latency histograms of AggregatingSink. Bucket i
+// holds the calls that took less than 2^i nanoseconds, but not less than
+// 2^(i-1).
+inline constexpr int kNumLatencyBuckets = 40;
+
+// Sink that sums up the calls, counts, and times of every event, for sinks
+// that are polled rather than pushed to.
+class AggregatingSink : public Sink {
+ public:
+  struct Totals {
+    int64_t calls = 0;
+    int64_t count = 0;
+    absl::Duration elapsed;
+    // Histogram of the times of the calls, with power of two buckets.
+    std::array<int64_t, kNumLatencyBuckets> latency_buckets{};
+
+    // Returns an upper bound of the q-quantile of the times of the calls,
+    // which is at most twice the exact quantile, or zero without calls.
+    absl::Duration LatencyQuantile(double q) const;
+  };
+
+  void Record(Event event, int64_t count, absl::Duration elapsed) override;
+
+  // Returns the totals of the event since construction or the last Reset.
+  Totals Get(Event event) const;
+
+  void Reset();
+
+ private:
+  struct AtomicTotals {
+    std::atomic<int64_t> calls{0};
+    std::atomic<int64_t> count{0};
+    std::atomic<int64_t> elapsed_nanos{0};
+    std::array<std::atomic<int64_t>, kNumLatencyBuckets> latency_buckets{};
+  };
+  std::array<AtomicTotals, kNumEvents> totals_;
+};
+
+namespace internal {
+
+extern std::atomic<Sink*> sink;
+
+// Depth of the instrumented calls of every event on the current thread, so
+// that calls nested in a call of the same event, e.g., the Serialize of an
+// algorithm used by another algorithm, are not counted twice.
+extern thread_local std::array<int, kNumEvents> depth;
+
+}  // namespace internal
+
+// Reports an event to the sink when it goes out of scope, with the time since
+// construction. Only the outermost instance per event and thread reports.
+//
+// Example:
+//   Summary Serialize() const override {
+//     instrumentation::ScopedEvent event(
+//         instrumentation::Event::kAlgorithmSerialize);
+//     ...
+//   }
+class ScopedEvent {
+ public:
+  explicit ScopedEvent(Event event, int64_t count = 1) {
+    if constexpr (kEnabled) {
+      Sink* sink = internal::sink.load(std::memory_order_acquire);
+      if (sink != nullptr) {
+        event_ = event;
+        entered_ = true;
+        if (internal::depth[static_cast<int>(event)]++ == 0) {
+          sink_ = sink;
+          count_ = count;
+          sink->Begin(event);
+          start_ = absl::Now();
+        }
+      }
+    }
+  }
+
+  ~ScopedEvent() {
+    if constexpr (kEnabled) {
+      if (entered_) {
+        --internal::depth[static_cast<int>(event_)];
+      }
+      if (sink_ != nullptr) {
+        sink_->Record(event_, count_, absl::Now() - start_);
+      }
+    }
+  }
+
+  // Sets the count to report, for calls that only know it at the end.
+  void set_count(int64_t count) { count_ = count; }
+
+  ScopedEvent(const ScopedEvent&) = delete;
+  ScopedEvent& operator=(const ScopedEvent&) = delete;
+
+ private:
+  // Whether the instance incremented the depth of its event.
+  bool entered_ = false;
+  // The sink to report to, if the instance is the outermost.
+  Sink* sink_ = nullptr;
+  Event event_ = Event::kAlgorithmAddEntries;
+  int64_t count_ = 0;
+  absl::Time start_;
+};
+
+}  // namespace instrumentation
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_BASE_INSTRUMENTATION_H_
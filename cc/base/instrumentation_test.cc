@@ -0,0 +1,176 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "base/instrumentation.h"
+
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+
+namespace differential_privacy {
+namespace instrumentation {
+namespace {
+
+using ::testing::ElementsAre;
+
+// Logs the spans it receives, like a tracer would open and close them.
+class TracingSink : public Sink {
+ public:
+  void Begin(Event event) override {
+    spans.push_back(absl::StrCat("begin ", EventName(event)));
+  }
+  void Record(Event event, int64_t count, absl::Duration elapsed) override {
+    spans.push_back(absl::StrCat("end ", EventName(event), " ", count));
+  }
+
+  std::vector<std::string> spans;
+};
+
+class ScopedSink {
+ public:
+  explicit ScopedSink(Sink* sink) { SetSink(sink); }
+  ~ScopedSink() { SetSink(nullptr); }
+};
+
+TEST(InstrumentationTest, NoSinkByDefault) { EXPECT_EQ(GetSink(), nullptr); }
+
+TEST(InstrumentationTest, RecordsEventsToSink) {
+  AggregatingSink sink;
+  {
+    ScopedSink scoped_sink(&sink);
+    { ScopedEvent event(Event::kMechanismAddNoise, 10); }
+    { ScopedEvent event(Event::kMechanismAddNoise, 5); }
+    { ScopedEvent event(Event::kAlgorithmSerialize); }
+  }
+  { ScopedEvent event(Event::kMechanismAddNoise, 100); }
+
+  AggregatingSink::Totals totals = sink.Get(Event::kMechanismAddNoise);
+  EXPECT_EQ(totals.calls, 2);
+  EXPECT_EQ(totals.count, 15);
+  EXPECT_GE(totals.elapsed, absl::ZeroDuration());
+  EXPECT_EQ(sink.Get(Event::kAlgorithmSerialize).calls, 1);
+  EXPECT_EQ(sink.Get(Event::kPldCompose).calls, 0);
+}
+
+TEST(InstrumentationTest, RecordsOnlyOutermostEventOfSameType) {
+  AggregatingSink sink;
+  ScopedSink scoped_sink(&sink);
+  {
+    ScopedEvent outer(Event::kAlgorithmMerge);
+    ScopedEvent inner(Event::kAlgorithmMerge);
+    ScopedEvent serialize(Event::kAlgorithmSerialize);
+  }
+  { ScopedEvent event(Event::kAlgorithmMerge); }
+
+  EXPECT_EQ(sink.Get(Event::kAlgorithmMerge).calls, 2);
+  EXPECT_EQ(sink.Get(Event::kAlgorithmSerialize).calls, 1);
+}
+
+TEST(InstrumentationTest, SetCountOverridesCount) {
+  AggregatingSink sink;
+  ScopedSink scoped_sink(&sink);
+  {
+    ScopedEvent event(Event::kAlgorithmAddEntries);
+    event.set_count(42);
+  }
+
+  EXPECT_EQ(sink.Get(Event::kAlgorithmAddEntries).count, 42);
+}
+
+TEST(InstrumentationTest, AggregatesConcurrentEvents) {
+  AggregatingSink sink;
+  ScopedSink scoped_sink(&sink);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < 1000; ++j) {
+        ScopedEvent event(Event::kSecureUrbgRefreshBuffer, 2);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  AggregatingSink::Totals totals = sink.Get(Event::kSecureUrbgRefreshBuffer);
+  EXPECT_EQ(totals.calls, 4000);
+  EXPECT_EQ(totals.count, 8000);
+}
+
+TEST(InstrumentationTest, ResetClearsTotals) {
+  AggregatingSink sink;
+  sink.Record(Event::kPldCompose, 3, absl::Seconds(1));
+  sink.Reset();
+
+  AggregatingSink::Totals totals = sink.Get(Event::kPldCompose);
+  EXPECT_EQ(totals.calls, 0);
+  EXPECT_EQ(totals.count, 0);
+  EXPECT_EQ(totals.elapsed, absl::ZeroDuration());
+}
+
+TEST(InstrumentationTest, ReportsNestedSpans) {
+  TracingSink sink;
+  {
+    ScopedSink scoped_sink(&sink);
+    ScopedEvent build(Event::kAlgorithmBuild);
+    {
+      ScopedEvent selection(Event::kPartitionSelection);
+      ScopedEvent nested_selection(Event::kPartitionSelection);
+      selection.set_count(7);
+    }
+    ScopedEvent noise(Event::kMechanismAddNoise, 3);
+  }
+
+  EXPECT_THAT(sink.spans,
+              ElementsAre("begin algorithm_build", "begin partition_selection",
+                          "end partition_selection 7",
+                          "begin mechanism_add_noise",
+                          "end mechanism_add_noise 3", "end algorithm_build 1"));
+}
+
+TEST(InstrumentationTest, LatencyQuantiles) {
+  AggregatingSink sink;
+  for (int i = 0; i < 90; ++i) {
+    sink.Record(Event::kAlgorithmMerge, 1, absl::Nanoseconds(100));
+  }
+  for (int i = 0; i < 10; ++i) {
+    sink.Record(Event::kAlgorithmMerge, 1, absl::Milliseconds(1));
+  }
+
+  AggregatingSink::Totals totals = sink.Get(Event::kAlgorithmMerge);
+  EXPECT_EQ(totals.latency_buckets[7], 90);
+  EXPECT_EQ(totals.LatencyQuantile(0.5), absl::Nanoseconds(128));
+  EXPECT_EQ(totals.LatencyQuantile(0.9), absl::Nanoseconds(128));
+  EXPECT_GE(totals.LatencyQuantile(0.99), absl::Milliseconds(1));
+  EXPECT_LT(totals.LatencyQuantile(0.99), absl::Milliseconds(2));
+  EXPECT_EQ(sink.Get(Event::kPldCompose).LatencyQuantile(0.5),
+            absl::ZeroDuration());
+}
+
+TEST(InstrumentationTest, EventNames) {
+  EXPECT_EQ(EventName(Event::kAlgorithmAddEntries), "algorithm_add_entries");
+  EXPECT_EQ(EventName(Event::kPldCompose), "pld_compose");
+  EXPECT_EQ(EventName(Event::kAccountantSearch), "accountant_search");
+}
+
+}  // namespace
+}  // namespace instrumentation
+}  // namespace differential_privacy
@@ -0,0 +1,100 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_BASE_MEMORY_BUDGET_H_
+#define DIFFERENTIAL_PRIVACY_BASE_MEMORY_BUDGET_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace differential_privacy {
+namespace base {
+
+// Memory budget shared by all algorithms of a pipeline. It is a memory
+// resource that forwards allocations to an upstream resource and counts the
+// bytes allocated through it, so algorithms built with SetMemoryBudget account
+// for their state exactly, like with TrackingMemoryResource. Owners of memory
+// that is not allocated through the budget, e.g., KeyedAggregator, report it
+// with Charge.
+//
+// Algorithms degrade gracefully instead of running out of memory: once the
+// usage reaches compact_fraction of the limit, they switch to more compact
+// representations (e.g., Quantiles stores new trees sparsely), and once it
+// exceeds the limit, aggregators with a spill directory spill their state.
+// The limit is not enforced on allocations.
+//
+// Thread safe if the upstream resource is, so it can be shared by algorithms
+// on different threads. It must outlive the algorithms that use it.
+class MemoryBudget : public std::pmr::memory_resource {
+ public:
+  explicit MemoryBudget(
+      int64_t limit, double compact_fraction = 0.75,
+      std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+      : limit_(limit),
+        compact_threshold_(static_cast<int64_t>(limit * compact_fraction)),
+        upstream_(upstream) {}
+
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+  int64_t limit() const { return limit_; }
+
+  // Number of bytes allocated through the budget and not yet deallocated,
+  // plus the charged bytes.
+  int64_t bytes_used() const {
+    return bytes_used_.load(std::memory_order_relaxed);
+  }
+
+  // Adds bytes, which may be negative, to the usage.
+  void Charge(int64_t bytes) {
+    bytes_used_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // Returns true if algorithms should switch to compact representations.
+  bool ShouldCompact() const { return bytes_used() >= compact_threshold_; }
+
+  // Returns true if the usage exceeds the limit.
+  bool Exceeded() const { return bytes_used() > limit_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    void* p = upstream_->allocate(bytes, alignment);
+    Charge(bytes);
+    return p;
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    upstream_->deallocate(p, bytes, alignment);
+    Charge(-static_cast<int64_t>(bytes));
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  const int64_t limit_;
+  const int64_t compact_threshold_;
+  std::pmr::memory_resource* upstream_;
+  std::atomic<int64_t> bytes_used_ = 0;
+};
+
+}  // namespace base
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_BASE_MEMORY_BUDGET_H_
@@ -0,0 +1,72 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "base/memory_budget.h"
+
+#include <cstdint>
+#include <memory_resource>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace differential_privacy {
+namespace base {
+namespace {
+
+TEST(MemoryBudgetTest, CountsAllocationsAndCharges) {
+  MemoryBudget budget(1000);
+  {
+    std::pmr::vector<int64_t> values(10, 0, &budget);
+    EXPECT_EQ(budget.bytes_used(), 10 * sizeof(int64_t));
+    budget.Charge(20);
+    EXPECT_EQ(budget.bytes_used(), 10 * sizeof(int64_t) + 20);
+  }
+  EXPECT_EQ(budget.bytes_used(), 20);
+  budget.Charge(-20);
+  EXPECT_EQ(budget.bytes_used(), 0);
+}
+
+TEST(MemoryBudgetTest, CompactsBeforeExceedingLimit) {
+  MemoryBudget budget(/*limit=*/100, /*compact_fraction=*/0.5);
+  EXPECT_FALSE(budget.ShouldCompact());
+  budget.Charge(50);
+  EXPECT_TRUE(budget.ShouldCompact());
+  EXPECT_FALSE(budget.Exceeded());
+  budget.Charge(51);
+  EXPECT_TRUE(budget.Exceeded());
+}
+
+TEST(MemoryBudgetTest, IsSharedAcrossThreads) {
+  MemoryBudget budget(1 << 20);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&budget]() {
+      for (int i = 0; i < 1000; ++i) {
+        std::pmr::vector<char> values(16, 0, &budget);
+        budget.Charge(1);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(budget.bytes_used(), 4000);
+}
+
+}  // namespace
+}  // namespace base
+}  // namespace differential_privacy
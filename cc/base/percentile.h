@@ -17,11 +17,21 @@
 #ifndef DIFFERENTIAL_PRIVACY_BASE_PERCENTILE_H_
 #define DIFFERENTIAL_PRIVACY_BASE_PERCENTILE_H_
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
 
 #include "google/protobuf/repeated_field.h"
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 #include "proto/util.h"
+#include "proto/summary.pb.h"
+#include "base/tracking_memory_resource.h"
 
 namespace differential_privacy {
 namespace base {
@@ -43,47 +53,137 @@ namespace base {
 // this value. This is useful to ascertain when an input list has many
 // instances of the same value, for example.
 //
-// Adding inputs is an O(1) operation. Retrieving a percentile sorts the
-// underlying vector only if there has been an addition since the previous sort.
-// Thus, retrieving a percentile is O(nlog n) worst case and O(log n) if no
-// additional inputs have been added.
+// Adding inputs is an O(1) operation. Retrieving a percentile sorts the inputs
+// added since the previous retrieval and merges them into the already sorted
+// inputs. Thus, retrieving a percentile after adding k inputs is
+// O(n + k log k), and O(log n) if no inputs have been added.
+//
+// When constructed with a sketch capacity, Percentile instead summarizes the
+// inputs in a KLL-style sketch (Karnin, Lang, Liberty: Optimal Quantile
+// Approximation in Streams) that uses O(capacity) memory and serializes to a
+// summary of O(capacity) size, no matter how many inputs are added. The
+// sketch keeps levels of items where every item of level i stands for 2^i
+// inputs. When a level is full, it is sorted and every second item is
+// promoted to the next level. Relative ranks are then approximate, with an
+// error that is roughly proportional to 1 / capacity. Since a single input can
+// change which items are promoted, it can move a rank by up to the weight of
+// the highest level rather than by 1. The sketch is therefore not used by the
+// differentially private order statistics, whose noise assumes a rank
+// sensitivity of 1.
 template <typename T>
 class Percentile {
  public:
-  Percentile() {}
+  // Smallest sketch capacity that is accepted.
+  static constexpr int kMinSketchCapacity = 2;
+
+  // Stores all inputs exactly.
+  Percentile() : levels_(1, &memory_) {}
+
+  // Summarizes the inputs in a sketch of the given capacity, which must be at
+  // least kMinSketchCapacity.
+  explicit Percentile(int sketch_capacity)
+      : levels_(1, &memory_),
+        sketch_capacity_(std::max(sketch_capacity, kMinSketchCapacity)),
+        random_state_(absl::Uniform<uint64_t>(absl::BitGen())) {}
 
   void Add(const T& t) {
     // REF:
     // https://stackoverflow.com/questions/61646166/how-to-resolve-fpclassify-ambiguous-call-to-overloaded-function
     if (!std::isnan(static_cast<double>(t))) {
-      inputs_.push_back(t);
-      sorted_ = false;
+      levels_[0].push_back(t);
+      ++num_values_;
+      ++version_;
+      if (IsSketch()) {
+        Compress();
+      }
     }
   }
 
   void Reset() {
-    inputs_.clear();
-    sorted_ = true;
+    levels_.clear();
+    levels_.emplace_back();
+    num_values_ = 0;
+    num_sorted_ = 0;
+    ++version_;
   }
 
+  // Returns true if the inputs are summarized in a bounded-memory sketch.
+  bool IsSketch() const { return sketch_capacity_ > 0; }
+
+  // Writes all inputs to values. Only supported when storing the inputs
+  // exactly; use the BinarySearchSummary overload for sketches.
   void SerializeToProto(google::protobuf::RepeatedPtrField<ValueType>* values) {
-    for (const T& t : inputs_) {
+    for (const T& t : levels_[0]) {
       values->Add(MakeValueType(t));
     }
   }
 
   void MergeFromProto(google::protobuf::RepeatedPtrField<ValueType> values) {
     for (const ValueType v : values) {
-      inputs_.push_back(GetValue<T>(v));
-      sorted_ = false;
+      Add(GetValue<T>(v));
+    }
+  }
+
+  // Writes the inputs to the summary: all inputs when storing them exactly,
+  // and the sketch otherwise.
+  void SerializeToProto(BinarySearchSummary* summary) {
+    if (!IsSketch()) {
+      SerializeToProto(summary->mutable_input());
+      return;
+    }
+    QuantileSketchSummary* sketch = summary->mutable_sketch();
+    sketch->set_capacity(sketch_capacity_);
+    for (const std::pmr::vector<T>& level : levels_) {
+      QuantileSketchLevel* level_summary = sketch->add_level();
+      for (const T& t : level) {
+        *level_summary->add_item() = MakeValueType(t);
+      }
+    }
+  }
+
+  // Adds the inputs of the summary. A summary that contains a sketch can only
+  // be merged when this Percentile is a sketch as well, since the exact inputs
+  // are unknown.
+  absl::Status MergeFromProto(const BinarySearchSummary& summary) {
+    if (summary.has_sketch() && !IsSketch()) {
+      return absl::InvalidArgumentError(
+          "Cannot merge a quantile sketch summary into a Percentile that "
+          "stores its inputs exactly.");
+    }
+    if (summary.has_sketch() &&
+        summary.sketch().level_size() > kMaxSketchLevels) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Quantile sketch summary has ",
+                       summary.sketch().level_size(), " levels, but at most ",
+                       kMaxSketchLevels, " are supported."));
+    }
+    MergeFromProto(summary.input());
+    if (!summary.has_sketch()) {
+      return absl::OkStatus();
+    }
+    const QuantileSketchSummary& sketch = summary.sketch();
+    if (levels_.size() < static_cast<size_t>(sketch.level_size())) {
+      levels_.resize(sketch.level_size());
     }
+    for (int i = 0; i < sketch.level_size(); ++i) {
+      for (const ValueType& item : sketch.level(i).item()) {
+        const T t = GetValue<T>(item);
+        if (!std::isnan(static_cast<double>(t))) {
+          levels_[i].push_back(t);
+          num_values_ += int64_t{1} << i;
+        }
+      }
+    }
+    ++version_;
+    Compress();
+    return absl::OkStatus();
   }
 
   int64_t Memory() {
-    return sizeof(Percentile<T>) + sizeof(T) * inputs_.capacity();
+    return sizeof(Percentile<T>) + memory_.bytes_allocated();
   }
 
-  int64_t num_values() { return inputs_.size(); }
+  int64_t num_values() { return num_values_; }
 
   // Obtain the relative rank of value t with respect to the added inputs.
   std::pair<double, double> GetRelativeRank(const T& t) {
@@ -91,21 +191,245 @@ class Percentile {
       return std::make_pair(0, 1);
     }
 
-    // If something has been added since the last sort, sort again.
-    if (!sorted_) {
-      std::sort(inputs_.begin(), inputs_.end());
-      sorted_ = true;
+    if (IsSketch()) {
+      // Sum up the weights of the items of all levels.
+      double num_lt = 0;
+      double num_le = 0;
+      for (size_t i = 0; i < levels_.size(); ++i) {
+        const double weight = std::ldexp(1.0, i);
+        for (const T& item : levels_[i]) {
+          num_lt += item < t ? weight : 0;
+          num_le += item <= t ? weight : 0;
+        }
+      }
+      return std::make_pair(num_lt / num_values(), num_le / num_values());
     }
-    auto lb = std::lower_bound(inputs_.begin(), inputs_.end(), t);
-    auto ub = std::upper_bound(lb, inputs_.end(), t);
-    double num_lt = std::distance(inputs_.begin(), lb);
-    double num_le = std::distance(inputs_.begin(), ub);
-    return std::make_pair(num_lt / num_values(), num_le / num_values());
+
+    SortInputs();
+    return ExactRelativeRank(t);
+  }
+
+  // Remembers where the previous rank query of a sequence of queries ended, so
+  // that the next query searches outward from there. Queries for values close
+  // to the previous one, such as the converging probes of a binary search,
+  // then take O(log d) time, where d is the number of inputs between the two
+  // values. For a sketch, the first query also sorts the items once, so that
+  // every query is a search instead of a scan of all items.
+  //
+  // A cursor must only be used with one Percentile. It notices when inputs
+  // were added or removed since its last query.
+  class RankCursor {
+   private:
+    friend class Percentile;
+
+    // Version of the inputs at the time of the previous query, or -1 if none.
+    int64_t version_ = -1;
+    // Index of the lower bound of the previous query.
+    size_t position_ = 0;
+    // For a sketch: the sorted items of all levels, and the total weight of
+    // the items before each index.
+    std::vector<T> items_;
+    std::vector<double> cumulative_weight_;
+  };
+
+  // Same as GetRelativeRank(t), but starts the search from the position of the
+  // previous query made with cursor.
+  std::pair<double, double> GetRelativeRank(const T& t, RankCursor* cursor) {
+    if (num_values() == 0) {
+      return std::make_pair(0, 1);
+    }
+    if (cursor->version_ != version_) {
+      cursor->version_ = version_;
+      cursor->position_ = 0;
+      if (IsSketch()) {
+        SortSketchItems(&cursor->items_, &cursor->cumulative_weight_);
+      }
+    }
+    if (!IsSketch()) {
+      SortInputs();
+    }
+    const std::pmr::vector<T>& inputs = levels_[0];
+    const T* items = IsSketch() ? cursor->items_.data() : inputs.data();
+    const size_t size = IsSketch() ? cursor->items_.size() : inputs.size();
+    const size_t lb = GallopingPartitionPoint(
+        items, size, cursor->position_,
+        [&t](const T& item) { return item < t; });
+    const size_t ub = GallopingPartitionPoint(
+        items, size, lb, [&t](const T& item) { return item <= t; });
+    cursor->position_ = lb;
+    if (IsSketch()) {
+      return std::make_pair(cursor->cumulative_weight_[lb] / num_values(),
+                            cursor->cumulative_weight_[ub] / num_values());
+    }
+    return std::make_pair(static_cast<double>(lb) / num_values(),
+                          static_cast<double>(ub) / num_values());
+  }
+
+  // Obtains the relative ranks of many values at once; the i-th result is
+  // GetRelativeRank(values[i]). For a sketch, this sorts the items once instead
+  // of scanning all of them for every value.
+  std::vector<std::pair<double, double>> GetRelativeRanks(
+      absl::Span<const T> values) {
+    std::vector<std::pair<double, double>> ranks;
+    ranks.reserve(values.size());
+    RankCursor cursor;
+    for (const T& t : values) {
+      ranks.push_back(GetRelativeRank(t, &cursor));
+    }
+    return ranks;
   }
 
  private:
-  std::vector<T> inputs_;
-  bool sorted_ = true;
+  // Bounds the number of levels of a merged summary. A sketch with this many
+  // levels represents more than 2^62 inputs.
+  static constexpr int kMaxSketchLevels = 62;
+
+  // Returns the capacity of a level. Lower levels get geometrically smaller
+  // capacities, with the top level having the full sketch capacity.
+  int LevelCapacity(int level) const {
+    const int depth = static_cast<int>(levels_.size()) - 1 - level;
+    return std::max(
+        kMinSketchCapacity,
+        static_cast<int>(
+            std::ceil(sketch_capacity_ * std::pow(2.0 / 3, depth))));
+  }
+
+  // Compacts levels until every level is within its capacity.
+  void Compress() {
+    for (int i = 0; i < static_cast<int>(levels_.size()); ++i) {
+      if (static_cast<int>(levels_[i].size()) >= LevelCapacity(i)) {
+        CompactLevel(i);
+        // Adding a level shrinks the capacities of all levels below it, so
+        // start over from the bottom.
+        i = -1;
+      }
+    }
+  }
+
+  // Sorts the inputs added since the previous call and merges them into the
+  // inputs sorted before. Only used without a sketch.
+  void SortInputs() {
+    std::pmr::vector<T>& inputs = levels_[0];
+    if (num_sorted_ == inputs.size()) {
+      return;
+    }
+    const auto middle = inputs.begin() + num_sorted_;
+    std::sort(middle, inputs.end());
+    std::inplace_merge(inputs.begin(), middle, inputs.end());
+    num_sorted_ = inputs.size();
+  }
+
+  // Sorts the items of all levels of the sketch into items, and stores the
+  // total weight of the items before each index into cumulative_weight.
+  void SortSketchItems(std::vector<T>* items,
+                       std::vector<double>* cumulative_weight) const {
+    std::vector<std::pair<T, double>> weighted_items;
+    for (size_t i = 0; i < levels_.size(); ++i) {
+      const double weight = std::ldexp(1.0, i);
+      for (const T& item : levels_[i]) {
+        weighted_items.emplace_back(item, weight);
+      }
+    }
+    std::sort(weighted_items.begin(), weighted_items.end(),
+              [](const std::pair<T, double>& a, const std::pair<T, double>& b) {
+                return a.first < b.first;
+              });
+    items->clear();
+    cumulative_weight->assign(1, 0);
+    for (const std::pair<T, double>& weighted_item : weighted_items) {
+      items->push_back(weighted_item.first);
+      cumulative_weight->push_back(cumulative_weight->back() +
+                                   weighted_item.second);
+    }
+  }
+
+  // Returns the first index of items[0, size) for which pred is false, given
+  // that pred is true for a prefix of the items. Searches with exponentially
+  // growing steps away from hint, and then with a binary search, so it takes
+  // O(log d) time where d is the distance between hint and the result.
+  template <typename Pred>
+  static size_t GallopingPartitionPoint(const T* items, size_t size,
+                                        size_t hint, Pred pred) {
+    hint = std::min(hint, size);
+    size_t lo;
+    size_t hi;
+    size_t step = 1;
+    if (hint < size && pred(items[hint])) {
+      // The result is after hint; pred is true before lo.
+      lo = hint + 1;
+      while (lo + step <= size && pred(items[lo + step - 1])) {
+        lo += step;
+        step *= 2;
+      }
+      hi = std::min(size, lo + step - 1);
+    } else {
+      // The result is at or before hint; pred is false from hi on.
+      hi = hint;
+      while (hi >= step && !pred(items[hi - step])) {
+        hi -= step;
+        step *= 2;
+      }
+      lo = hi >= step ? hi - step + 1 : 0;
+    }
+    return std::partition_point(items + lo, items + hi, pred) - items;
+  }
+
+  // Returns the relative rank of t among the sorted inputs.
+  std::pair<double, double> ExactRelativeRank(const T& t) {
+    const std::pmr::vector<T>& inputs = levels_[0];
+    auto lb = std::lower_bound(inputs.begin(), inputs.end(), t);
+    auto ub = std::upper_bound(lb, inputs.end(), t);
+    double num_lt = std::distance(inputs.begin(), lb);
+    double num_le = std::distance(inputs.begin(), ub);
+    return std::make_pair(num_lt / num_values(), num_le / num_values());
+  }
+
+  size_t NextRandomBit() {
+    uint64_t z = (random_state_ += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return (z ^ (z >> 31)) >> 63;
+  }
+
+  // Sorts the items of a level and promotes every second item to the next
+  // level, which preserves the total weight. If the number of items is odd,
+  // the smallest item stays in the level.
+  void CompactLevel(int level) {
+    if (level + 1 == static_cast<int>(levels_.size())) {
+      levels_.emplace_back();
+    }
+    // levels_ may have been reallocated, so only take references now.
+    std::pmr::vector<T>& items = levels_[level];
+    std::pmr::vector<T>& next = levels_[level + 1];
+    std::sort(items.begin(), items.end());
+    const size_t first = items.size() % 2;
+    // Promoting the even or the odd items at random makes the rank error of
+    // every compaction unbiased, so the errors cancel out rather than add up.
+    const size_t offset = NextRandomBit();
+    for (size_t i = first + offset; i < items.size(); i += 2) {
+      next.push_back(items[i]);
+    }
+    items.resize(first);
+  }
+
+  // Tracks the allocations of levels_ for Memory.
+  TrackingMemoryResource memory_;
+  // Level i holds items that stand for 2^i inputs each. Without a sketch, all
+  // inputs are stored in level 0. The levels allocate from memory_.
+  std::pmr::vector<std::pmr::vector<T>> levels_;
+  // Number of inputs, i.e., the total weight of all items.
+  int64_t num_values_ = 0;
+  // Incremented whenever the inputs change. Lets a RankCursor notice that its
+  // copy of the sketch items is stale.
+  int64_t version_ = 0;
+  // Length of the sorted prefix of level 0. Only used without a sketch.
+  size_t num_sorted_ = 0;
+  // Capacity of the sketch, or 0 if all inputs are stored exactly.
+  int sketch_capacity_ = 0;
+  // State of the generator for the random choices of the compactions. These
+  // only affect the accuracy of the sketch, so a fast non-cryptographic
+  // generator (SplitMix64) suffices.
+  uint64_t random_state_ = 0;
 };
 
 }  // namespace base
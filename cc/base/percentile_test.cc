@@ -16,8 +16,13 @@
 
 #include "base/percentile.h"
 
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/status/status.h"
 #include "proto/summary.pb.h"
 
 namespace differential_privacy {
@@ -108,6 +113,184 @@ TYPED_TEST(PercentileTest, SerializeMerge) {
   EXPECT_EQ(std::make_pair(.25, .5), percentile2.GetRelativeRank(2));
 }
 
+TYPED_TEST(PercentileTest, SketchApproximatesRanks) {
+  Percentile<TypeParam> exact;
+  Percentile<TypeParam> sketch(200);
+  ASSERT_FALSE(exact.IsSketch());
+  ASSERT_TRUE(sketch.IsSketch());
+  const int num_values = 100000;
+  for (int i = 0; i < num_values; ++i) {
+    // Permute the inputs so that they don't arrive in sorted order.
+    TypeParam value = (i * 7919) % num_values;
+    exact.Add(value);
+    sketch.Add(value);
+  }
+
+  EXPECT_EQ(sketch.num_values(), num_values);
+  for (TypeParam value = 0; value < num_values; value += 997) {
+    EXPECT_NEAR(sketch.GetRelativeRank(value).first,
+                exact.GetRelativeRank(value).first, 0.03);
+    EXPECT_NEAR(sketch.GetRelativeRank(value).second,
+                exact.GetRelativeRank(value).second, 0.03);
+  }
+  EXPECT_EQ(sketch.GetRelativeRank(-1), std::make_pair(0.0, 0.0));
+  EXPECT_EQ(sketch.GetRelativeRank(num_values), std::make_pair(1.0, 1.0));
+}
+
+TYPED_TEST(PercentileTest, SketchMemoryIsBounded) {
+  Percentile<TypeParam> sketch(100);
+  for (int i = 0; i < 100000; ++i) {
+    sketch.Add(i);
+  }
+  int64_t memory = sketch.Memory();
+  for (int i = 0; i < 900000; ++i) {
+    sketch.Add(i);
+  }
+  // Ten times the inputs only add a few small levels.
+  EXPECT_LT(sketch.Memory(), 1.5 * memory);
+  EXPECT_LT(sketch.Memory(), 10000 * sizeof(TypeParam));
+}
+
+TYPED_TEST(PercentileTest, SketchSerializeMerge) {
+  Percentile<TypeParam> sketch1(64);
+  Percentile<TypeParam> sketch2(64);
+  for (int i = 0; i < 10000; ++i) {
+    sketch1.Add(i % 100);
+    sketch2.Add(100 + i % 100);
+  }
+  BinarySearchSummary summary;
+  sketch1.SerializeToProto(&summary);
+  EXPECT_EQ(summary.input_size(), 0);
+  EXPECT_EQ(summary.sketch().capacity(), 64);
+
+  EXPECT_TRUE(sketch2.MergeFromProto(summary).ok());
+  EXPECT_EQ(sketch2.num_values(), 20000);
+  EXPECT_NEAR(sketch2.GetRelativeRank(100).first, 0.5, 0.05);
+}
+
+TYPED_TEST(PercentileTest, SketchMergesExactSummary) {
+  Percentile<TypeParam> exact;
+  exact.Add(1);
+  exact.Add(3);
+  BinarySearchSummary summary;
+  exact.SerializeToProto(&summary);
+
+  Percentile<TypeParam> sketch(16);
+  sketch.Add(2);
+  EXPECT_TRUE(sketch.MergeFromProto(summary).ok());
+  EXPECT_EQ(sketch.num_values(), 3);
+  EXPECT_EQ(sketch.GetRelativeRank(2), std::make_pair(1.0 / 3, 2.0 / 3));
+}
+
+TYPED_TEST(PercentileTest, ExactCannotMergeSketchSummary) {
+  Percentile<TypeParam> sketch(16);
+  sketch.Add(1);
+  BinarySearchSummary summary;
+  sketch.SerializeToProto(&summary);
+
+  Percentile<TypeParam> exact;
+  EXPECT_EQ(exact.MergeFromProto(summary).code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(exact.num_values(), 0);
+}
+
+TYPED_TEST(PercentileTest, SketchReset) {
+  Percentile<TypeParam> sketch(16);
+  for (int i = 0; i < 1000; ++i) {
+    sketch.Add(i);
+  }
+  sketch.Reset();
+  EXPECT_EQ(sketch.num_values(), 0);
+  EXPECT_TRUE(sketch.IsSketch());
+  sketch.Add(5);
+  EXPECT_EQ(sketch.GetRelativeRank(5), std::make_pair(0.0, 1.0));
+}
+
+TYPED_TEST(PercentileTest, AddsBetweenRankQueries) {
+  Percentile<TypeParam> percentile;
+  percentile.Add(5);
+  percentile.Add(1);
+  EXPECT_EQ(std::make_pair(0.5, 1.0), percentile.GetRelativeRank(5));
+  // Inputs added after a query are merged into the sorted inputs.
+  percentile.Add(3);
+  percentile.Add(0);
+  EXPECT_EQ(std::make_pair(0.5, 0.75), percentile.GetRelativeRank(3));
+  percentile.Add(6);
+  percentile.Add(3);
+  EXPECT_EQ(std::make_pair(2.0 / 6, 4.0 / 6), percentile.GetRelativeRank(3));
+  EXPECT_EQ(std::make_pair(5.0 / 6, 1.0), percentile.GetRelativeRank(6));
+}
+
+TYPED_TEST(PercentileTest, GetRelativeRanksMatchesGetRelativeRank) {
+  Percentile<TypeParam> exact;
+  Percentile<TypeParam> sketch(32);
+  for (int i = 0; i < 1000; ++i) {
+    exact.Add((i * 37) % 101);
+    sketch.Add((i * 37) % 101);
+  }
+  const std::vector<TypeParam> values = {50, -1, 0, 100, 101, 7, 50};
+  for (Percentile<TypeParam>* percentile : {&exact, &sketch}) {
+    const std::vector<std::pair<double, double>> ranks =
+        percentile->GetRelativeRanks(values);
+    ASSERT_EQ(ranks.size(), values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      EXPECT_DOUBLE_EQ(ranks[i].first,
+                       percentile->GetRelativeRank(values[i]).first);
+      EXPECT_DOUBLE_EQ(ranks[i].second,
+                       percentile->GetRelativeRank(values[i]).second);
+    }
+  }
+}
+
+TYPED_TEST(PercentileTest, GetRelativeRanksOfEmptyInputSet) {
+  Percentile<TypeParam> percentile;
+  const std::vector<TypeParam> values = {1, 2};
+  EXPECT_THAT(percentile.GetRelativeRanks(values),
+              ::testing::ElementsAre(std::make_pair(0.0, 1.0),
+                                     std::make_pair(0.0, 1.0)));
+}
+
+TYPED_TEST(PercentileTest, RankCursorMatchesGetRelativeRank) {
+  Percentile<TypeParam> exact;
+  Percentile<TypeParam> sketch(32);
+  for (int i = 0; i < 1000; ++i) {
+    exact.Add((i * 37) % 101);
+    sketch.Add((i * 37) % 101);
+  }
+  for (Percentile<TypeParam>* percentile : {&exact, &sketch}) {
+    typename Percentile<TypeParam>::RankCursor cursor;
+    // Converging probes, followed by jumps in both directions and values
+    // outside of the inputs.
+    for (TypeParam value : {50, 25, 37, 31, 34, 33, 33, 100, 0, -5, 200, 1}) {
+      EXPECT_EQ(percentile->GetRelativeRank(value, &cursor),
+                percentile->GetRelativeRank(value));
+    }
+  }
+}
+
+TYPED_TEST(PercentileTest, RankCursorNoticesChangedInputs) {
+  Percentile<TypeParam> exact;
+  Percentile<TypeParam> sketch(4);
+  for (Percentile<TypeParam>* percentile : {&exact, &sketch}) {
+    typename Percentile<TypeParam>::RankCursor cursor;
+    for (int i = 0; i < 10; ++i) {
+      percentile->Add(i);
+    }
+    EXPECT_EQ(percentile->GetRelativeRank(9, &cursor),
+              percentile->GetRelativeRank(9));
+    // The same number of inputs, but different ones.
+    percentile->Reset();
+    for (int i = 0; i < 10; ++i) {
+      percentile->Add(i + 100);
+    }
+    EXPECT_EQ(percentile->GetRelativeRank(9, &cursor),
+              std::make_pair(0.0, 0.0));
+    percentile->Add(0);
+    EXPECT_EQ(percentile->GetRelativeRank(100, &cursor),
+              percentile->GetRelativeRank(100));
+  }
+}
+
 }  // namespace
 }  // namespace base
 }  // namespace differential_privacy
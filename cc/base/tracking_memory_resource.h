@@ -0,0 +1,73 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_BASE_TRACKING_MEMORY_RESOURCE_H_
+#define DIFFERENTIAL_PRIVACY_BASE_TRACKING_MEMORY_RESOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace differential_privacy {
+namespace base {
+
+// Memory resource that forwards all allocations to an upstream resource and
+// keeps track of the number of bytes that are currently allocated through it.
+// Algorithms allocate their containers from a TrackingMemoryResource member so
+// that MemoryUsed() is exact and takes constant time, regardless of the
+// resource (e.g., an arena) the user provided.
+//
+// Not thread safe, like the algorithms that own it. Containers that allocate
+// from it must be destroyed before it; declare it before them.
+class TrackingMemoryResource : public std::pmr::memory_resource {
+ public:
+  explicit TrackingMemoryResource(
+      std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+      : upstream_(upstream) {}
+
+  TrackingMemoryResource(const TrackingMemoryResource&) = delete;
+  TrackingMemoryResource& operator=(const TrackingMemoryResource&) = delete;
+
+  // Number of bytes that were allocated and not yet deallocated.
+  int64_t bytes_allocated() const { return bytes_allocated_; }
+
+  std::pmr::memory_resource* upstream() const { return upstream_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    void* p = upstream_->allocate(bytes, alignment);
+    bytes_allocated_ += bytes;
+    return p;
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    upstream_->deallocate(p, bytes, alignment);
+    bytes_allocated_ -= bytes;
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream_;
+  int64_t bytes_allocated_ = 0;
+};
+
+}  // namespace base
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_BASE_TRACKING_MEMORY_RESOURCE_H_
@@ -0,0 +1,67 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "base/tracking_memory_resource.h"
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace differential_privacy {
+namespace base {
+namespace {
+
+TEST(TrackingMemoryResourceTest, TracksAllocatedBytes) {
+  TrackingMemoryResource memory;
+  EXPECT_EQ(memory.bytes_allocated(), 0);
+  {
+    std::pmr::vector<int64_t> values(&memory);
+    values.reserve(100);
+    EXPECT_EQ(memory.bytes_allocated(), 100 * sizeof(int64_t));
+    values.shrink_to_fit();
+    EXPECT_EQ(memory.bytes_allocated(), 0);
+    values.resize(10);
+    EXPECT_EQ(memory.bytes_allocated(), 10 * sizeof(int64_t));
+  }
+  EXPECT_EQ(memory.bytes_allocated(), 0);
+}
+
+TEST(TrackingMemoryResourceTest, TracksNestedContainers) {
+  TrackingMemoryResource memory;
+  std::pmr::vector<std::pmr::vector<double>> levels(1, &memory);
+  levels[0].reserve(8);
+  levels.emplace_back().reserve(4);
+
+  EXPECT_EQ(memory.bytes_allocated(),
+            sizeof(std::pmr::vector<double>) * levels.capacity() +
+                12 * sizeof(double));
+}
+
+TEST(TrackingMemoryResourceTest, ForwardsToUpstream) {
+  TrackingMemoryResource upstream;
+  TrackingMemoryResource memory(&upstream);
+  std::pmr::vector<int> values(5, 0, &memory);
+
+  EXPECT_EQ(memory.upstream(), &upstream);
+  EXPECT_EQ(memory.bytes_allocated(), 5 * sizeof(int));
+  EXPECT_EQ(upstream.bytes_allocated(), 5 * sizeof(int));
+}
+
+}  // namespace
+}  // namespace base
+}  // namespace differential_privacy
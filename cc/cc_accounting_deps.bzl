@@ -28,6 +28,19 @@ def cc_accounting_deps():
         sha256 = "93cfa11a344ad552472f7d93c228d55969ac586275692d73d5e7ce73a69b047f",
     )
 
+    # Python bindings of the accounting, see accounting/python.
+    http_archive(
+        name = "pybind11_bazel",
+        strip_prefix = "pybind11_bazel-2.11.1",
+        urls = ["https://github.com/pybind/pybind11_bazel/archive/refs/tags/v2.11.1.tar.gz"],
+    )
+    http_archive(
+        name = "pybind11",
+        build_file = "@pybind11_bazel//:pybind11.BUILD",
+        strip_prefix = "pybind11-2.11.1",
+        urls = ["https://github.com/pybind/pybind11/archive/refs/tags/v2.11.1.tar.gz"],
+    )
+
     # Begin Boost
     git_repository(
         name = "com_github_nelhage_rules_boost",
@@ -0,0 +1,185 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// JNI functions of com.google.privacy.differentialprivacy.pipelinedp4j
+// .dplibrary.NativeAlgorithms, which lets the combiners of pipelinedp4j add
+// noise with the C++ mechanisms and accumulate values in batches.
+//
+// Mechanisms are referred to by handles returned by createMechanism. The
+// handles are never freed: NativeAlgorithms creates one per distinct set of
+// parameters and keeps it for the lifetime of the process. Arrays are passed
+// as primitive Java arrays, so values are never boxed.
+
+#include <jni.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/util.h"
+
+namespace differential_privacy {
+namespace {
+
+// Must match NativeAlgorithms.MechanismKind.
+constexpr jint kLaplace = 0;
+constexpr jint kGaussian = 1;
+
+void ThrowIllegalArgument(JNIEnv* env, const std::string& message) {
+  jclass exception_class =
+      env->FindClass("java/lang/IllegalArgumentException");
+  if (exception_class != nullptr) {
+    env->ThrowNew(exception_class, message.c_str());
+  }
+}
+
+NumericalMechanism* ToMechanism(jlong handle) {
+  return reinterpret_cast<NumericalMechanism*>(handle);
+}
+
+absl::StatusOr<std::unique_ptr<NumericalMechanism>> BuildMechanism(
+    jint kind, double epsilon, double delta, double l0_sensitivity,
+    double linf_sensitivity) {
+  std::unique_ptr<NumericalMechanismBuilder> builder;
+  switch (kind) {
+    case kLaplace:
+      if (delta != 0) {
+        return absl::InvalidArgumentError(
+            "Delta must be 0 for Laplace noise.");
+      }
+      builder = std::make_unique<LaplaceMechanism::Builder>();
+      break;
+    case kGaussian:
+      builder = std::make_unique<GaussianMechanism::Builder>();
+      builder->SetDelta(delta);
+      break;
+    default:
+      return absl::InvalidArgumentError("Unknown mechanism kind.");
+  }
+  return builder->SetEpsilon(epsilon)
+      .SetL0Sensitivity(l0_sensitivity)
+      .SetLInfSensitivity(linf_sensitivity)
+      .Build();
+}
+
+}  // namespace
+}  // namespace differential_privacy
+
+extern "C" {
+
+using ::differential_privacy::BuildMechanism;
+using ::differential_privacy::CompensatedSum;
+using ::differential_privacy::NumericalMechanism;
+using ::differential_privacy::ThrowIllegalArgument;
+using ::differential_privacy::ToMechanism;
+
+JNIEXPORT jlong JNICALL
+Java_com_google_privacy_differentialprivacy_pipelinedp4j_dplibrary_NativeAlgorithms_createMechanism(
+    JNIEnv* env, jclass, jint kind, jdouble epsilon, jdouble delta,
+    jdouble l0_sensitivity, jdouble linf_sensitivity) {
+  absl::StatusOr<std::unique_ptr<NumericalMechanism>> mechanism =
+      BuildMechanism(kind, epsilon, delta, l0_sensitivity, linf_sensitivity);
+  if (!mechanism.ok()) {
+    ThrowIllegalArgument(env, std::string(mechanism.status().message()));
+    return 0;
+  }
+  return reinterpret_cast<jlong>(mechanism->release());
+}
+
+JNIEXPORT jdouble JNICALL
+Java_com_google_privacy_differentialprivacy_pipelinedp4j_dplibrary_NativeAlgorithms_addDoubleNoise(
+    JNIEnv*, jclass, jlong handle, jdouble value) {
+  return ToMechanism(handle)->AddNoise(value);
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_google_privacy_differentialprivacy_pipelinedp4j_dplibrary_NativeAlgorithms_addLongNoise(
+    JNIEnv*, jclass, jlong handle, jlong value) {
+  return ToMechanism(handle)->AddNoise(static_cast<int64_t>(value));
+}
+
+// Adds noise to every element of values in place. The elements are accessed
+// through Get<Type>ArrayElements rather than as a critical region, since
+// drawing noise may wait for the shared random generator.
+JNIEXPORT void JNICALL
+Java_com_google_privacy_differentialprivacy_pipelinedp4j_dplibrary_NativeAlgorithms_addDoubleNoiseInPlace(
+    JNIEnv* env, jclass, jdoubleArray values, jlong handle) {
+  const jsize size = env->GetArrayLength(values);
+  jdouble* elements = env->GetDoubleArrayElements(values, nullptr);
+  if (elements == nullptr) return;  // OutOfMemoryError is pending.
+  absl::Span<double> span(elements, size);
+  ToMechanism(handle)->AddNoise(span, span).IgnoreError();
+  env->ReleaseDoubleArrayElements(values, elements, 0);
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_privacy_differentialprivacy_pipelinedp4j_dplibrary_NativeAlgorithms_addLongNoiseInPlace(
+    JNIEnv* env, jclass, jlongArray values, jlong handle) {
+  static_assert(sizeof(jlong) == sizeof(int64_t));
+  const jsize size = env->GetArrayLength(values);
+  jlong* elements = env->GetLongArrayElements(values, nullptr);
+  if (elements == nullptr) return;
+  absl::Span<int64_t> span(reinterpret_cast<int64_t*>(elements), size);
+  ToMechanism(handle)->AddNoise(span, span).IgnoreError();
+  env->ReleaseLongArrayElements(values, elements, 0);
+}
+
+// Writes to sums[i] the sum of values[offsets[i]] to values[offsets[i + 1] -
+// 1], clamped to [lower, upper]. This is the accumulator of a bounded sum for
+// many privacy ids at once, one segment of values per privacy id. The offsets
+// have been validated by the caller.
+JNIEXPORT void JNICALL
+Java_com_google_privacy_differentialprivacy_pipelinedp4j_dplibrary_NativeAlgorithms_clampedSegmentSums(
+    JNIEnv* env, jclass, jdoubleArray values, jintArray offsets,
+    jdouble lower, jdouble upper, jdoubleArray sums) {
+  const jsize num_segments = env->GetArrayLength(sums);
+  // Nothing in between calls into the JVM or blocks, so critical regions,
+  // which avoid copying the arrays, are safe here.
+  auto* value_elements = static_cast<const jdouble*>(
+      env->GetPrimitiveArrayCritical(values, nullptr));
+  auto* offset_elements =
+      static_cast<const jint*>(env->GetPrimitiveArrayCritical(offsets, nullptr));
+  auto* sum_elements =
+      static_cast<jdouble*>(env->GetPrimitiveArrayCritical(sums, nullptr));
+  if (value_elements != nullptr && offset_elements != nullptr &&
+      sum_elements != nullptr) {
+    for (jsize i = 0; i < num_segments; ++i) {
+      CompensatedSum sum;
+      for (jint j = offset_elements[i]; j < offset_elements[i + 1]; ++j) {
+        sum.Add(value_elements[j]);
+      }
+      sum_elements[i] =
+          ::differential_privacy::Clamp<double>(lower, upper, sum.Value());
+    }
+  }
+  if (sum_elements != nullptr) {
+    env->ReleasePrimitiveArrayCritical(sums, sum_elements, 0);
+  }
+  if (offset_elements != nullptr) {
+    env->ReleasePrimitiveArrayCritical(
+        offsets, const_cast<jint*>(offset_elements), JNI_ABORT);
+  }
+  if (value_elements != nullptr) {
+    env->ReleasePrimitiveArrayCritical(
+        values, const_cast<jdouble*>(value_elements), JNI_ABORT);
+  }
+}
+
+}  // extern "C"
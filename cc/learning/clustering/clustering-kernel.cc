@@ -0,0 +1,396 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "learning/clustering/clustering-kernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+namespace clustering {
+namespace {
+
+// Smaller inputs are not worth starting a thread for.
+constexpr int64_t kMinPointsPerThread = 1 << 12;
+
+// Calls fn(chunk, begin, end) for consecutive chunks covering [0, size), on up
+// to num_threads threads, and returns the number of chunks.
+int ParallelForChunks(
+    int64_t size, int num_threads,
+    absl::FunctionRef<void(int chunk, int64_t begin, int64_t end)> fn) {
+  const int num_chunks = static_cast<int>(
+      std::clamp<int64_t>(size / kMinPointsPerThread, 1, num_threads));
+  const int64_t chunk_size = (size + num_chunks - 1) / num_chunks;
+  std::vector<std::thread> threads;
+  threads.reserve(num_chunks - 1);
+  for (int chunk = 1; chunk < num_chunks; ++chunk) {
+    threads.emplace_back(fn, chunk, chunk * chunk_size,
+                         std::min(size, (chunk + 1) * chunk_size));
+  }
+  fn(0, 0, std::min(size, chunk_size));
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return num_chunks;
+}
+
+// Returns the number of rows of a row-major matrix of dimension dim.
+absl::StatusOr<int64_t> NumRows(absl::Span<const double> matrix, int dim,
+                                absl::string_view name) {
+  if (dim <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Dimension must be positive, but is ", dim, "."));
+  }
+  if (matrix.size() % dim != 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("The number of values of the ", name,
+                     " must be a multiple of the dimension ", dim, ", but is ",
+                     matrix.size(), "."));
+  }
+  return static_cast<int64_t>(matrix.size() / dim);
+}
+
+absl::Status ValidateNumThreads(int num_threads) {
+  if (num_threads < 1) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Number of threads must be at least 1, but is ", num_threads, "."));
+  }
+  return absl::OkStatus();
+}
+
+// Four independent partial sums let the reductions vectorize without
+// reassociating floating point additions, see BoundedVectorSum.
+double Dot(const double* x, const double* y, int dim) {
+  double partial[4] = {0, 0, 0, 0};
+  int i = 0;
+  for (; i + 4 <= dim; i += 4) {
+    partial[0] += x[i] * y[i];
+    partial[1] += x[i + 1] * y[i + 1];
+    partial[2] += x[i + 2] * y[i + 2];
+    partial[3] += x[i + 3] * y[i + 3];
+  }
+  for (; i < dim; ++i) {
+    partial[0] += x[i] * y[i];
+  }
+  return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+}
+
+double SquaredDistance(const double* x, const double* y, int dim) {
+  double partial[4] = {0, 0, 0, 0};
+  int i = 0;
+  for (; i + 4 <= dim; i += 4) {
+    const double d0 = x[i] - y[i];
+    const double d1 = x[i + 1] - y[i + 1];
+    const double d2 = x[i + 2] - y[i + 2];
+    const double d3 = x[i + 3] - y[i + 3];
+    partial[0] += d0 * d0;
+    partial[1] += d1 * d1;
+    partial[2] += d2 * d2;
+    partial[3] += d3 * d3;
+  }
+  for (; i < dim; ++i) {
+    const double d = x[i] - y[i];
+    partial[0] += d * d;
+  }
+  return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+}
+
+// Returns the index of the closest center and the squared distance to it.
+std::pair<int64_t, double> NearestCenter(const double* point,
+                                         absl::Span<const double> centers,
+                                         int dim) {
+  int64_t best = 0;
+  double best_distance = std::numeric_limits<double>::infinity();
+  const int64_t num_centers = centers.size() / dim;
+  for (int64_t c = 0; c < num_centers; ++c) {
+    const double distance = SquaredDistance(point, &centers[c * dim], dim);
+    if (distance < best_distance) {
+      best = c;
+      best_distance = distance;
+    }
+  }
+  return {best, best_distance};
+}
+
+absl::StatusOr<int64_t> NumCenters(absl::Span<const double> centers, int dim) {
+  ASSIGN_OR_RETURN(const int64_t num_centers, NumRows(centers, dim, "centers"));
+  if (num_centers == 0) {
+    return absl::InvalidArgumentError("At least one center is required.");
+  }
+  return num_centers;
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<uint64_t>> SimHashCodes(
+    absl::Span<const double> points, int dim,
+    absl::Span<const double> projections, int num_threads) {
+  RETURN_IF_ERROR(ValidateNumThreads(num_threads));
+  ASSIGN_OR_RETURN(const int64_t num_points, NumRows(points, dim, "points"));
+  ASSIGN_OR_RETURN(const int64_t num_projections,
+                   NumRows(projections, dim, "projections"));
+  if (num_projections > 64) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "At most 64 projections are supported, but got ", num_projections,
+        "."));
+  }
+  std::vector<uint64_t> codes(num_points);
+  ParallelForChunks(num_points, num_threads,
+                    [&](int chunk, int64_t begin, int64_t end) {
+                      for (int64_t i = begin; i < end; ++i) {
+                        const double* point = &points[i * dim];
+                        uint64_t code = 0;
+                        for (int64_t j = 0; j < num_projections; ++j) {
+                          const double dot =
+                              Dot(point, &projections[j * dim], dim);
+                          code |= static_cast<uint64_t>(dot < 0) << j;
+                        }
+                        codes[i] = code;
+                      }
+                    });
+  return codes;
+}
+
+absl::StatusOr<BucketStats> SumByHashPrefix(absl::Span<const double> points,
+                                            int dim,
+                                            absl::Span<const uint64_t> codes,
+                                            int prefix_length,
+                                            int num_threads) {
+  RETURN_IF_ERROR(ValidateNumThreads(num_threads));
+  ASSIGN_OR_RETURN(const int64_t num_points, NumRows(points, dim, "points"));
+  if (codes.size() != num_points) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Expected one code per point, but got ", codes.size(),
+                     " codes for ", num_points, " points."));
+  }
+  if (prefix_length < 0 || prefix_length > 64) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Prefix length must be in [0, 64], but is ", prefix_length, "."));
+  }
+  const uint64_t mask =
+      prefix_length == 64 ? ~uint64_t{0} : (uint64_t{1} << prefix_length) - 1;
+
+  // Every chunk collects its buckets in the order of their first point.
+  struct ChunkBuckets {
+    absl::flat_hash_map<uint64_t, int64_t> index;
+    std::vector<uint64_t> prefixes;
+    std::vector<int64_t> counts;
+    std::vector<double> sums;
+  };
+  std::vector<ChunkBuckets> chunks(num_threads);
+  const int num_chunks = ParallelForChunks(
+      num_points, num_threads, [&](int chunk, int64_t begin, int64_t end) {
+        ChunkBuckets& buckets = chunks[chunk];
+        for (int64_t i = begin; i < end; ++i) {
+          const uint64_t prefix = codes[i] & mask;
+          auto [it, inserted] =
+              buckets.index.try_emplace(prefix, buckets.prefixes.size());
+          if (inserted) {
+            buckets.prefixes.push_back(prefix);
+            buckets.counts.push_back(0);
+            buckets.sums.resize(buckets.sums.size() + dim, 0);
+          }
+          ++buckets.counts[it->second];
+          double* sum = &buckets.sums[it->second * dim];
+          const double* point = &points[i * dim];
+          for (int k = 0; k < dim; ++k) {
+            sum[k] += point[k];
+          }
+        }
+      });
+
+  // Merges the chunks in order, so that the sums do not depend on timing.
+  std::vector<uint64_t> prefixes;
+  for (int chunk = 0; chunk < num_chunks; ++chunk) {
+    prefixes.insert(prefixes.end(), chunks[chunk].prefixes.begin(),
+                    chunks[chunk].prefixes.end());
+  }
+  std::sort(prefixes.begin(), prefixes.end());
+  prefixes.erase(std::unique(prefixes.begin(), prefixes.end()),
+                 prefixes.end());
+  absl::flat_hash_map<uint64_t, int64_t> index;
+  index.reserve(prefixes.size());
+  for (int64_t b = 0; b < prefixes.size(); ++b) {
+    index[prefixes[b]] = b;
+  }
+
+  BucketStats stats;
+  stats.counts.assign(prefixes.size(), 0);
+  stats.sums.assign(prefixes.size() * dim, 0);
+  for (int chunk = 0; chunk < num_chunks; ++chunk) {
+    const ChunkBuckets& buckets = chunks[chunk];
+    for (int64_t b = 0; b < buckets.prefixes.size(); ++b) {
+      const int64_t target = index[buckets.prefixes[b]];
+      stats.counts[target] += buckets.counts[b];
+      for (int k = 0; k < dim; ++k) {
+        stats.sums[target * dim + k] += buckets.sums[b * dim + k];
+      }
+    }
+  }
+  stats.prefixes = std::move(prefixes);
+  return stats;
+}
+
+absl::StatusOr<std::vector<int64_t>> PrivateCounts(
+    absl::Span<const int64_t> counts, double laplace_param) {
+  if (std::isnan(laplace_param) || laplace_param <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Discrete Laplace param must be positive, but is ",
+                     laplace_param, "."));
+  }
+  std::vector<int64_t> private_counts(counts.begin(), counts.end());
+  if (std::isinf(laplace_param)) {
+    return private_counts;
+  }
+  // With a sensitivity of 1, the rate of the discrete Laplace distribution is
+  // epsilon.
+  ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mechanism,
+                   DiscreteLaplaceMechanism::Builder()
+                       .SetL1Sensitivity(1)
+                       .SetEpsilon(laplace_param)
+                       .Build());
+  RETURN_IF_ERROR(mechanism->AddNoise(counts, absl::MakeSpan(private_counts)));
+  return private_counts;
+}
+
+absl::StatusOr<std::vector<double>> PrivateAverages(
+    absl::Span<const double> sums, int dim,
+    absl::Span<const int64_t> private_counts, double gaussian_stddev) {
+  ASSIGN_OR_RETURN(const int64_t num_buckets, NumRows(sums, dim, "sums"));
+  if (private_counts.size() != num_buckets) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Expected one private count per bucket, but got ",
+        private_counts.size(), " counts for ", num_buckets, " buckets."));
+  }
+  for (int64_t count : private_counts) {
+    if (count < 1) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Private counts must be at least 1, but got ", count, "."));
+    }
+  }
+  std::vector<double> averages(sums.begin(), sums.end());
+  // Standard deviation 0 means no noise, see AveragePrivacyParam.
+  if (gaussian_stddev != 0) {
+    ASSIGN_OR_RETURN(std::unique_ptr<NumericalMechanism> mechanism,
+                     GaussianMechanism::Builder()
+                         .SetStandardDeviation(gaussian_stddev)
+                         .Build());
+    RETURN_IF_ERROR(mechanism->AddNoise(sums, absl::MakeSpan(averages)));
+  }
+  for (int64_t b = 0; b < num_buckets; ++b) {
+    for (int k = 0; k < dim; ++k) {
+      averages[b * dim + k] /= private_counts[b];
+    }
+  }
+  return averages;
+}
+
+absl::StatusOr<CenterAssignment> AssignToNearestCenters(
+    absl::Span<const double> points, int dim, absl::Span<const double> centers,
+    int num_threads) {
+  RETURN_IF_ERROR(ValidateNumThreads(num_threads));
+  ASSIGN_OR_RETURN(const int64_t num_points, NumRows(points, dim, "points"));
+  RETURN_IF_ERROR(NumCenters(centers, dim).status());
+
+  CenterAssignment assignment;
+  assignment.labels.resize(num_points);
+  std::vector<double> losses(num_threads, 0);
+  const int num_chunks = ParallelForChunks(
+      num_points, num_threads, [&](int chunk, int64_t begin, int64_t end) {
+        double loss = 0;
+        for (int64_t i = begin; i < end; ++i) {
+          const auto [label, distance] =
+              NearestCenter(&points[i * dim], centers, dim);
+          assignment.labels[i] = label;
+          loss += distance;
+        }
+        losses[chunk] = loss;
+      });
+  assignment.loss = 0;
+  for (int chunk = 0; chunk < num_chunks; ++chunk) {
+    assignment.loss += losses[chunk];
+  }
+  return assignment;
+}
+
+absl::StatusOr<std::vector<double>> LloydStep(
+    absl::Span<const double> points, int dim, absl::Span<const double> weights,
+    absl::Span<const double> centers, int num_threads) {
+  RETURN_IF_ERROR(ValidateNumThreads(num_threads));
+  ASSIGN_OR_RETURN(const int64_t num_points, NumRows(points, dim, "points"));
+  ASSIGN_OR_RETURN(const int64_t num_centers, NumCenters(centers, dim));
+  if (!weights.empty() && weights.size() != num_points) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Expected one weight per point, but got ", weights.size(),
+                     " weights for ", num_points, " points."));
+  }
+
+  // Weighted sums of the points of every center, and their total weights, in
+  // one row of dim + 1 values per center and chunk.
+  const int row_size = dim + 1;
+  std::vector<std::vector<double>> chunk_sums(num_threads);
+  const int num_chunks = ParallelForChunks(
+      num_points, num_threads, [&](int chunk, int64_t begin, int64_t end) {
+        std::vector<double>& sums = chunk_sums[chunk];
+        sums.assign(num_centers * row_size, 0);
+        for (int64_t i = begin; i < end; ++i) {
+          const double* point = &points[i * dim];
+          const double weight = weights.empty() ? 1 : weights[i];
+          double* row =
+              &sums[NearestCenter(point, centers, dim).first * row_size];
+          for (int k = 0; k < dim; ++k) {
+            row[k] += weight * point[k];
+          }
+          row[dim] += weight;
+        }
+      });
+
+  std::vector<double> new_centers(centers.begin(), centers.end());
+  for (int64_t c = 0; c < num_centers; ++c) {
+    double total_weight = 0;
+    for (int chunk = 0; chunk < num_chunks; ++chunk) {
+      total_weight += chunk_sums[chunk][c * row_size + dim];
+    }
+    if (total_weight <= 0) continue;
+    for (int k = 0; k < dim; ++k) {
+      double sum = 0;
+      for (int chunk = 0; chunk < num_chunks; ++chunk) {
+        sum += chunk_sums[chunk][c * row_size + k];
+      }
+      new_centers[c * dim + k] = sum / total_weight;
+    }
+  }
+  return new_centers;
+}
+
+}  // namespace clustering
+}  // namespace differential_privacy
@@ -0,0 +1,105 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_LEARNING_CLUSTERING_CLUSTERING_KERNEL_H_
+#define DIFFERENTIAL_PRIVACY_CPP_LEARNING_CLUSTERING_CLUSTERING_KERNEL_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+
+namespace differential_privacy {
+namespace clustering {
+
+// Native kernels for the hot steps of the private LSH clustering in
+// learning/clustering: hashing the points, summing and counting them per hash
+// bucket, adding the noise of the private counts and averages, and assigning
+// points to centers.
+//
+// Points and centers are passed as row-major matrices: point i consists of the
+// values [i * dim, (i + 1) * dim). The kernels over points split them into
+// contiguous chunks processed on up to num_threads threads.
+//
+// The noise is calibrated by the privacy calculator of the Python package, so
+// the private kernels take the noise parameters it computed rather than
+// epsilon and delta.
+
+// Returns the SimHash code of every point for the given projection vectors,
+// which form a matrix of at most 64 rows of dimension dim. Bit j of a code is
+// set iff the dot product of the point with projection vector j is negative,
+// i.e., it is the j-th character of the hash in lsh.SimHash.
+absl::StatusOr<std::vector<uint64_t>> SimHashCodes(
+    absl::Span<const double> points, int dim,
+    absl::Span<const double> projections, int num_threads = 1);
+
+// Count and sum of the points per hash bucket, in increasing order of the
+// bucket prefix.
+struct BucketStats {
+  // The first prefix_length bits of the codes of the points in the bucket.
+  std::vector<uint64_t> prefixes;
+  std::vector<int64_t> counts;
+  // Row-major matrix with the sum of the points of every bucket.
+  std::vector<double> sums;
+};
+
+// Groups the points by the first prefix_length bits of their codes, which are
+// in [0, 64], and returns the count and sum of every non-empty group.
+absl::StatusOr<BucketStats> SumByHashPrefix(absl::Span<const double> points,
+                                            int dim,
+                                            absl::Span<const uint64_t> codes,
+                                            int prefix_length,
+                                            int num_threads = 1);
+
+// Returns the counts with discrete Laplace noise, with probabilities
+// proportional to exp(-laplace_param * |x|), like get_private_count.
+// An infinite laplace_param adds no noise.
+absl::StatusOr<std::vector<int64_t>> PrivateCounts(
+    absl::Span<const int64_t> counts, double laplace_param);
+
+// Returns the averages of the buckets with Gaussian noise of standard
+// deviation gaussian_stddev added to every coordinate of their sums, like
+// get_private_average. The private counts must be at least 1. A standard
+// deviation of 0 adds no noise.
+absl::StatusOr<std::vector<double>> PrivateAverages(
+    absl::Span<const double> sums, int dim,
+    absl::Span<const int64_t> private_counts, double gaussian_stddev);
+
+struct CenterAssignment {
+  // Index of the closest center of every point. Ties go to the lower index.
+  std::vector<int64_t> labels;
+  // Sum of the squared distances of the points to their closest centers.
+  double loss;
+};
+
+// Assigns every point to its closest center.
+absl::StatusOr<CenterAssignment> AssignToNearestCenters(
+    absl::Span<const double> points, int dim, absl::Span<const double> centers,
+    int num_threads = 1);
+
+// Runs one step of Lloyd's algorithm: assigns the points to their closest
+// centers and returns the weighted means of the points of every center.
+// Centers without points are kept. Empty weights weigh all points by 1.
+// Not private; used to cluster the private coreset.
+absl::StatusOr<std::vector<double>> LloydStep(
+    absl::Span<const double> points, int dim, absl::Span<const double> weights,
+    absl::Span<const double> centers, int num_threads = 1);
+
+}  // namespace clustering
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_LEARNING_CLUSTERING_CLUSTERING_KERNEL_H_
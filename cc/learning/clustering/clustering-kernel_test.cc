@@ -0,0 +1,241 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "learning/clustering/clustering-kernel.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+
+namespace differential_privacy {
+namespace clustering {
+namespace {
+
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
+using ::testing::Pointwise;
+using ::differential_privacy::base::testing::StatusIs;
+
+// Enough points to run on several threads.
+constexpr int kNumPoints = 20000;
+constexpr int kDim = 3;
+
+std::vector<double> ManyPoints() {
+  std::vector<double> points;
+  for (int i = 0; i < kNumPoints * kDim; ++i) {
+    points.push_back(static_cast<double>((i * 7919) % 201) / 100 - 1);
+  }
+  return points;
+}
+
+TEST(ClusteringKernelTest, SimHashCodesSetsBitsOfNegativeProjections) {
+  const std::vector<double> points = {1, 2, -3, -1};
+  const std::vector<double> projections = {1, 0, 0, 1, 1, 1};
+
+  auto codes = SimHashCodes(points, 2, projections);
+
+  ASSERT_OK(codes);
+  // (1, 2) projects to 1, 2, 3 and (-3, -1) to -3, -1, -4.
+  EXPECT_THAT(*codes, ElementsAre(0b000, 0b111));
+}
+
+TEST(ClusteringKernelTest, SimHashCodesRejectsMoreThan64Projections) {
+  const std::vector<double> points = {1};
+  const std::vector<double> projections(65, 1);
+
+  EXPECT_THAT(SimHashCodes(points, 1, projections),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(ClusteringKernelTest, RejectsPointsNotMatchingDimension) {
+  const std::vector<double> points = {1, 2, 3};
+  const std::vector<double> centers = {0, 0};
+
+  EXPECT_THAT(AssignToNearestCenters(points, 2, centers),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(AssignToNearestCenters(points, 0, centers),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(AssignToNearestCenters({1, 2}, 2, centers, 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(ClusteringKernelTest, SumByHashPrefixGroupsByPrefix) {
+  const std::vector<double> points = {1, 2, 3, 4, 5, 6};
+  const std::vector<uint64_t> codes = {0b110, 0b011, 0b010};
+
+  auto stats = SumByHashPrefix(points, 2, codes, 2);
+
+  ASSERT_OK(stats);
+  EXPECT_THAT(stats->prefixes, ElementsAre(0b10, 0b11));
+  EXPECT_THAT(stats->counts, ElementsAre(2, 1));
+  EXPECT_THAT(stats->sums, ElementsAre(6, 8, 3, 4));
+}
+
+TEST(ClusteringKernelTest, SumByHashPrefixOfLengthZeroSumsAllPoints) {
+  const std::vector<double> points = {1, 2, 3, 4};
+  const std::vector<uint64_t> codes = {5, 6};
+
+  auto stats = SumByHashPrefix(points, 2, codes, 0);
+
+  ASSERT_OK(stats);
+  EXPECT_THAT(stats->prefixes, ElementsAre(0));
+  EXPECT_THAT(stats->counts, ElementsAre(2));
+  EXPECT_THAT(stats->sums, ElementsAre(4, 6));
+}
+
+TEST(ClusteringKernelTest, SumByHashPrefixDoesNotDependOnThreads) {
+  const std::vector<double> points = ManyPoints();
+  const std::vector<double> projections = {1, -1, 0.5, 0.25, 1, -2};
+  auto codes = SimHashCodes(points, kDim, projections);
+  ASSERT_OK(codes);
+
+  auto sequential = SumByHashPrefix(points, kDim, *codes, 2);
+  auto parallel = SumByHashPrefix(points, kDim, *codes, 2, 4);
+
+  ASSERT_OK(sequential);
+  ASSERT_OK(parallel);
+  EXPECT_EQ(parallel->prefixes, sequential->prefixes);
+  EXPECT_EQ(parallel->counts, sequential->counts);
+  EXPECT_THAT(parallel->sums, Pointwise(DoubleNear(1e-9), sequential->sums));
+}
+
+TEST(ClusteringKernelTest, PrivateCountsWithoutNoise) {
+  const std::vector<int64_t> counts = {3, 0, 7};
+
+  auto private_counts =
+      PrivateCounts(counts, std::numeric_limits<double>::infinity());
+
+  ASSERT_OK(private_counts);
+  EXPECT_THAT(*private_counts, ElementsAre(3, 0, 7));
+}
+
+TEST(ClusteringKernelTest, PrivateCountsAddsNoise) {
+  const std::vector<int64_t> counts(1000, 100);
+
+  auto private_counts = PrivateCounts(counts, 0.1);
+
+  ASSERT_OK(private_counts);
+  double mean = 0;
+  for (int64_t count : *private_counts) mean += count;
+  mean /= counts.size();
+  EXPECT_NE(*private_counts, counts);
+  EXPECT_NEAR(mean, 100, 5);
+}
+
+TEST(ClusteringKernelTest, PrivateCountsRejectsNonPositiveParam) {
+  EXPECT_THAT(PrivateCounts({1}, 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(ClusteringKernelTest, PrivateAveragesWithoutNoise) {
+  const std::vector<double> sums = {2, 4, 9, 3};
+  const std::vector<int64_t> private_counts = {2, 3};
+
+  auto averages = PrivateAverages(sums, 2, private_counts, 0);
+
+  ASSERT_OK(averages);
+  EXPECT_THAT(*averages, ElementsAre(1, 2, 3, 1));
+}
+
+TEST(ClusteringKernelTest, PrivateAveragesAddsNoise) {
+  const std::vector<double> sums(1000, 10);
+  const std::vector<int64_t> private_counts = {10};
+
+  auto averages = PrivateAverages(sums, 1000, private_counts, 1);
+
+  ASSERT_OK(averages);
+  double mean = 0;
+  for (double average : *averages) mean += average;
+  mean /= averages->size();
+  EXPECT_NE((*averages)[0], 1);
+  EXPECT_NEAR(mean, 1, 0.05);
+}
+
+TEST(ClusteringKernelTest, PrivateAveragesRejectsCountsBelowOne) {
+  EXPECT_THAT(PrivateAverages({1, 2}, 2, {0}, 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PrivateAverages({1, 2}, 2, {1, 1}, 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(ClusteringKernelTest, AssignToNearestCenters) {
+  const std::vector<double> points = {0, 0, 4, 4, 1, 0, 2, 2};
+  const std::vector<double> centers = {0, 0, 4, 4};
+
+  auto assignment = AssignToNearestCenters(points, 2, centers);
+
+  ASSERT_OK(assignment);
+  // The last point is as close to both centers.
+  EXPECT_THAT(assignment->labels, ElementsAre(0, 1, 0, 0));
+  EXPECT_EQ(assignment->loss, 9);
+}
+
+TEST(ClusteringKernelTest, AssignToNearestCentersDoesNotDependOnThreads) {
+  const std::vector<double> points = ManyPoints();
+  const std::vector<double> centers = {0, 0, 0, 1, 1, 1, -1, 0.5, -0.5};
+
+  auto sequential = AssignToNearestCenters(points, kDim, centers);
+  auto parallel = AssignToNearestCenters(points, kDim, centers, 4);
+
+  ASSERT_OK(sequential);
+  ASSERT_OK(parallel);
+  EXPECT_EQ(parallel->labels, sequential->labels);
+  EXPECT_NEAR(parallel->loss, sequential->loss, 1e-9);
+}
+
+TEST(ClusteringKernelTest, LloydStepMovesCentersToWeightedMeans) {
+  const std::vector<double> points = {0, 0, 2, 0, 10, 10};
+  const std::vector<double> weights = {3, 1, 2};
+  const std::vector<double> centers = {1, 1, 9, 9, 100, 100};
+
+  auto new_centers = LloydStep(points, 2, weights, centers);
+
+  ASSERT_OK(new_centers);
+  // The last center has no points and is kept.
+  EXPECT_THAT(*new_centers, ElementsAre(0.5, 0, 10, 10, 100, 100));
+}
+
+TEST(ClusteringKernelTest, LloydStepWithoutWeights) {
+  const std::vector<double> points = {0, 0, 2, 0, 10, 10};
+  const std::vector<double> centers = {1, 1, 9, 9};
+
+  auto new_centers = LloydStep(points, 2, {}, centers);
+
+  ASSERT_OK(new_centers);
+  EXPECT_THAT(*new_centers, ElementsAre(1, 0, 10, 10));
+}
+
+TEST(ClusteringKernelTest, LloydStepDoesNotDependOnThreads) {
+  const std::vector<double> points = ManyPoints();
+  const std::vector<double> centers = {0, 0, 0, 1, 1, 1, -1, 0.5, -0.5};
+
+  auto sequential = LloydStep(points, kDim, {}, centers);
+  auto parallel = LloydStep(points, kDim, {}, centers, 4);
+
+  ASSERT_OK(sequential);
+  ASSERT_OK(parallel);
+  EXPECT_THAT(*parallel, Pointwise(DoubleNear(1e-9), *sequential));
+}
+
+}  // namespace
+}  // namespace clustering
+}  // namespace differential_privacy
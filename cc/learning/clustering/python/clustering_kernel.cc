@@ -0,0 +1,225 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Python bindings for the native kernels of the private LSH clustering.
+//
+// Points, centers and projection vectors are exchanged as two-dimensional
+// float64 NumPy arrays with one row per vector. C-contiguous inputs of the
+// right type are read in place and results are handed over to NumPy without a
+// copy. Other inputs are converted by NumPy first. The GIL is released while
+// the kernels run.
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "pybind11/numpy.h"
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+#include "learning/clustering/clustering-kernel.h"
+
+namespace differential_privacy {
+namespace clustering {
+namespace {
+
+namespace py = ::pybind11;
+
+template <typename T>
+using Array = py::array_t<T, py::array::c_style | py::array::forcecast>;
+
+// Raises ValueError for failed statuses; pybind11 translates the exception.
+void ThrowIfError(const absl::Status& status) {
+  if (!status.ok()) {
+    throw std::invalid_argument(std::string(status.message()));
+  }
+}
+
+template <typename T>
+T ValueOrThrow(absl::StatusOr<T> status_or) {
+  ThrowIfError(status_or.status());
+  return *std::move(status_or);
+}
+
+template <typename T>
+absl::Span<const T> AsSpan(const Array<T>& array, int ndim) {
+  if (array.ndim() != ndim) {
+    throw std::invalid_argument(
+        ndim == 1 ? "Expected a one-dimensional array."
+                  : "Expected a two-dimensional array.");
+  }
+  return absl::MakeConstSpan(array.data(), array.size());
+}
+
+// Returns the dimension of the rows of a two-dimensional array.
+int Dim(const Array<double>& matrix) {
+  if (matrix.ndim() != 2) {
+    throw std::invalid_argument("Expected a two-dimensional array.");
+  }
+  return static_cast<int>(matrix.shape(1));
+}
+
+// Moves values into a NumPy array of the given shape that owns them, without
+// copying.
+template <typename T>
+Array<T> ToArray(std::vector<T> values, std::vector<py::ssize_t> shape) {
+  auto* owned = new std::vector<T>(std::move(values));
+  py::capsule owner(
+      owned, [](void* ptr) { delete static_cast<std::vector<T>*>(ptr); });
+  return Array<T>(std::move(shape), owned->data(), owner);
+}
+
+template <typename T>
+Array<T> ToArray(std::vector<T> values) {
+  const py::ssize_t size = values.size();
+  return ToArray(std::move(values), {size});
+}
+
+Array<double> ToMatrix(std::vector<double> values, int dim) {
+  const py::ssize_t rows = values.size() / dim;
+  return ToArray(std::move(values), {rows, dim});
+}
+
+}  // namespace
+
+PYBIND11_MODULE(clustering_kernel, m) {
+  m.doc() = "Native kernels of the private LSH clustering.";
+
+  m.def(
+      "simhash_codes",
+      [](const Array<double>& points, const Array<double>& projections,
+         int num_threads) {
+        const int dim = Dim(points);
+        if (Dim(projections) != dim) {
+          throw std::invalid_argument(
+              "Points and projections must have the same dimension.");
+        }
+        std::vector<uint64_t> codes;
+        {
+          py::gil_scoped_release release;
+          codes = ValueOrThrow(
+              SimHashCodes(AsSpan(points, 2), dim, AsSpan(projections, 2),
+                           num_threads));
+        }
+        return ToArray(std::move(codes));
+      },
+      py::arg("points"), py::arg("projections"), py::arg("num_threads") = 1,
+      "Returns the SimHash codes of the points as uint64 values, with bit j "
+      "set iff the dot product with projection j is negative.");
+
+  m.def(
+      "sum_by_hash_prefix",
+      [](const Array<double>& points, const Array<uint64_t>& codes,
+         int prefix_length, int num_threads) {
+        const int dim = Dim(points);
+        BucketStats stats;
+        {
+          py::gil_scoped_release release;
+          stats = ValueOrThrow(SumByHashPrefix(AsSpan(points, 2), dim,
+                                               AsSpan(codes, 1), prefix_length,
+                                               num_threads));
+        }
+        return py::make_tuple(ToArray(std::move(stats.prefixes)),
+                              ToArray(std::move(stats.counts)),
+                              ToMatrix(std::move(stats.sums), dim));
+      },
+      py::arg("points"), py::arg("codes"), py::arg("prefix_length"),
+      py::arg("num_threads") = 1,
+      "Returns (prefixes, counts, sums) of the points grouped by the first "
+      "prefix_length bits of their codes.");
+
+  m.def(
+      "private_counts",
+      [](const Array<int64_t>& counts, double laplace_param) {
+        std::vector<int64_t> private_counts;
+        {
+          py::gil_scoped_release release;
+          private_counts =
+              ValueOrThrow(PrivateCounts(AsSpan(counts, 1), laplace_param));
+        }
+        return ToArray(std::move(private_counts));
+      },
+      py::arg("counts"), py::arg("laplace_param"),
+      "Returns the counts with discrete Laplace noise.");
+
+  m.def(
+      "private_averages",
+      [](const Array<double>& sums, const Array<int64_t>& private_counts,
+         double gaussian_stddev) {
+        const int dim = Dim(sums);
+        std::vector<double> averages;
+        {
+          py::gil_scoped_release release;
+          averages = ValueOrThrow(PrivateAverages(
+              AsSpan(sums, 2), dim, AsSpan(private_counts, 1),
+              gaussian_stddev));
+        }
+        return ToMatrix(std::move(averages), dim);
+      },
+      py::arg("sums"), py::arg("private_counts"), py::arg("gaussian_stddev"),
+      "Returns the averages of the sums with Gaussian noise.");
+
+  m.def(
+      "assign_to_nearest_centers",
+      [](const Array<double>& points, const Array<double>& centers,
+         int num_threads) {
+        const int dim = Dim(points);
+        if (Dim(centers) != dim) {
+          throw std::invalid_argument(
+              "Points and centers must have the same dimension.");
+        }
+        CenterAssignment assignment;
+        {
+          py::gil_scoped_release release;
+          assignment = ValueOrThrow(AssignToNearestCenters(
+              AsSpan(points, 2), dim, AsSpan(centers, 2), num_threads));
+        }
+        return py::make_tuple(ToArray(std::move(assignment.labels)),
+                              assignment.loss);
+      },
+      py::arg("points"), py::arg("centers"), py::arg("num_threads") = 1,
+      "Returns (labels, loss) of the assignment of the points to their "
+      "closest centers.");
+
+  m.def(
+      "lloyd_step",
+      [](const Array<double>& points, const Array<double>& weights,
+         const Array<double>& centers, int num_threads) {
+        const int dim = Dim(points);
+        if (Dim(centers) != dim) {
+          throw std::invalid_argument(
+              "Points and centers must have the same dimension.");
+        }
+        std::vector<double> new_centers;
+        {
+          py::gil_scoped_release release;
+          new_centers = ValueOrThrow(
+              LloydStep(AsSpan(points, 2), dim, AsSpan(weights, 1),
+                        AsSpan(centers, 2), num_threads));
+        }
+        return ToMatrix(std::move(new_centers), dim);
+      },
+      py::arg("points"), py::arg("weights"), py::arg("centers"),
+      py::arg("num_threads") = 1,
+      "Returns the centers after one step of Lloyd's algorithm.");
+}
+
+}  // namespace clustering
+}  // namespace differential_privacy
@@ -0,0 +1,75 @@
+#
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Tests for the Python bindings of the clustering kernels."""
+
+import unittest
+
+import numpy as np
+
+from learning.clustering.python import clustering_kernel
+
+
+class ClusteringKernelTest(unittest.TestCase):
+
+  def test_simhash_codes(self):
+    points = np.array([[1.0, 2.0], [-3.0, -1.0]])
+    projections = np.array([[1.0, 0.0], [0.0, 1.0], [1.0, 1.0]])
+    codes = clustering_kernel.simhash_codes(points, projections)
+    np.testing.assert_array_equal(codes, [0b000, 0b111])
+
+  def test_sum_by_hash_prefix(self):
+    points = np.array([[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]])
+    codes = np.array([0b110, 0b011, 0b010], dtype=np.uint64)
+    prefixes, counts, sums = clustering_kernel.sum_by_hash_prefix(
+        points, codes, prefix_length=2, num_threads=2)
+    np.testing.assert_array_equal(prefixes, [0b10, 0b11])
+    np.testing.assert_array_equal(counts, [2, 1])
+    np.testing.assert_array_equal(sums, [[6.0, 8.0], [3.0, 4.0]])
+
+  def test_private_outputs_without_noise(self):
+    counts = clustering_kernel.private_counts(
+        np.array([2, 3]), laplace_param=np.inf)
+    np.testing.assert_array_equal(counts, [2, 3])
+    averages = clustering_kernel.private_averages(
+        np.array([[2.0, 4.0], [9.0, 3.0]]), counts, gaussian_stddev=0)
+    np.testing.assert_array_equal(averages, [[1.0, 2.0], [3.0, 1.0]])
+
+  def test_assign_to_nearest_centers_matches_numpy(self):
+    rng = np.random.default_rng(0)
+    points = rng.normal(size=(1000, 4))
+    centers = rng.normal(size=(5, 4))
+    labels, loss = clustering_kernel.assign_to_nearest_centers(
+        points, centers, num_threads=4)
+    distances = np.sum((points[:, None, :] - centers[None, :, :])**2, axis=2)
+    np.testing.assert_array_equal(labels, np.argmin(distances, axis=1))
+    self.assertAlmostEqual(loss, np.sum(np.min(distances, axis=1)))
+
+  def test_lloyd_step(self):
+    points = np.array([[0.0, 0.0], [2.0, 0.0], [10.0, 10.0]])
+    centers = np.array([[1.0, 1.0], [9.0, 9.0]])
+    new_centers = clustering_kernel.lloyd_step(
+        points, np.array([3.0, 1.0, 2.0]), centers)
+    np.testing.assert_array_equal(new_centers, [[0.5, 0.0], [10.0, 10.0]])
+
+  def test_invalid_arguments_raise_value_error(self):
+    with self.assertRaises(ValueError):
+      clustering_kernel.assign_to_nearest_centers(
+          np.zeros((2, 2)), np.zeros((1, 3)))
+    with self.assertRaises(ValueError):
+      clustering_kernel.private_counts(np.array([1]), laplace_param=0)
+
+
+if __name__ == "__main__":
+  unittest.main()
@@ -16,6 +16,12 @@ limitations under the License.
 
 \echo Use "CREATE EXTENSION anon_func" to load this file. \quit
 
+/* The SSPACE of each aggregate is the approximate number of bytes that its
+ * state uses, as reported by DpFunc::MemoryUsed. The planner uses it to decide
+ * whether a hash aggregation fits into work_mem. Automatic bounding dominates
+ * the size of the bounded aggregates.
+ */
+
 /* Create the aggregates:
  *
  * ANON_COUNT(column, epsilon)
@@ -28,31 +34,83 @@ limitations under the License.
 CREATE FUNCTION anon_count_accum(internal, anyelement, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_count_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for with epsilon.
+CREATE FUNCTION anon_count_remove(internal, anyelement, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_count_remove'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for no epsilon.
 CREATE FUNCTION anon_count_accum(internal, anyelement)
 RETURNS internal AS
   'anon_func','anon_count_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for no epsilon.
+CREATE FUNCTION anon_count_remove(internal, anyelement)
+RETURNS internal AS
+  'anon_func','anon_count_remove'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Extract.
 CREATE FUNCTION anon_count_extract(internal) RETURNS bigint AS
   'anon_func','anon_count_extract'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Window frame extract.
+CREATE FUNCTION anon_count_frame_extract(internal) RETURNS bigint AS
+  'anon_func','anon_count_frame_extract'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Combine for parallel aggregation.
+CREATE FUNCTION anon_count_combine(internal, internal) RETURNS internal AS
+  'anon_func','anon_count_combine'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Serialize for parallel aggregation.
+CREATE FUNCTION anon_count_serialize(internal) RETURNS bytea AS
+  'anon_func','anon_count_serialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Deserialize for parallel aggregation.
+CREATE FUNCTION anon_count_deserialize(bytea, internal) RETURNS internal AS
+  'anon_func','anon_count_deserialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
 
 -- Aggregate for with epsilon.
 CREATE AGGREGATE anon_count(anyelement, epsilon double precision) (
   SFUNC = anon_count_accum,
   STYPE = internal,
-  FINALFUNC = anon_count_extract
+  SSPACE = 240,
+  FINALFUNC = anon_count_extract,
+  COMBINEFUNC = anon_count_combine,
+  SERIALFUNC = anon_count_serialize,
+  DESERIALFUNC = anon_count_deserialize,
+  MSFUNC = anon_count_accum,
+  MINVFUNC = anon_count_remove,
+  MSTYPE = internal,
+  MSSPACE = 240,
+  MFINALFUNC = anon_count_frame_extract,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for no epsilon.
 CREATE AGGREGATE anon_count(anyelement) (
   SFUNC = anon_count_accum,
   STYPE = internal,
-  FINALFUNC = anon_count_extract
+  SSPACE = 240,
+  FINALFUNC = anon_count_extract,
+  COMBINEFUNC = anon_count_combine,
+  SERIALFUNC = anon_count_serialize,
+  DESERIALFUNC = anon_count_deserialize,
+  MSFUNC = anon_count_accum,
+  MINVFUNC = anon_count_remove,
+  MSTYPE = internal,
+  MSSPACE = 240,
+  MFINALFUNC = anon_count_frame_extract,
+  PARALLEL = SAFE
 );
 
 
@@ -70,170 +128,306 @@ CREATE AGGREGATE anon_count(anyelement) (
 CREATE FUNCTION anon_sum_accum(internal, entry double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_sum_accum_double'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for double type, auto bounding, no epsilon.
 CREATE FUNCTION anon_sum_accum(internal, entry double precision)
 RETURNS internal AS
   'anon_func','anon_sum_accum_double'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for bigint type, auto bounding, with epsilon.
 CREATE FUNCTION anon_sum_accum(internal, entry bigint, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_sum_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for bigint type, auto bounding, no epsilon.
 CREATE FUNCTION anon_sum_accum(internal, entry bigint)
 RETURNS internal AS
   'anon_func','anon_sum_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for integer type, auto bounding, with epsilon.
 CREATE FUNCTION anon_sum_accum(internal, entry integer, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_sum_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for integer type, auto bounding, no epsilon.
 CREATE FUNCTION anon_sum_accum(internal, entry integer)
 RETURNS internal AS
   'anon_func','anon_sum_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for smallint type, auto bounding, with epsilon.
 CREATE FUNCTION anon_sum_accum(internal, entry smallint, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_sum_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for smallint type, auto bounding, no epsilon.
 CREATE FUNCTION anon_sum_accum(internal, entry smallint)
 RETURNS internal AS
   'anon_func','anon_sum_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for double type, manual bounding, with epsilon.
 CREATE FUNCTION anon_sum_with_bounds_accum(internal, entry double precision, lb double precision,
   ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_sum_with_bounds_accum_double'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for double type, manual bounding, with epsilon.
+CREATE FUNCTION anon_sum_with_bounds_remove(internal, entry double precision, lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_remove_double'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for double type, manual bounding, no epsilon.
 CREATE FUNCTION anon_sum_with_bounds_accum(internal, entry double precision, lb double precision,
   ub double precision)
 RETURNS internal AS
   'anon_func','anon_sum_with_bounds_accum_double'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for double type, manual bounding, no epsilon.
+CREATE FUNCTION anon_sum_with_bounds_remove(internal, entry double precision, lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_remove_double'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for bigint type, manual bounding, with epsilon.
 CREATE FUNCTION anon_sum_with_bounds_accum(internal, entry bigint, lb double precision,
   ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_sum_with_bounds_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for bigint type, manual bounding, with epsilon.
+CREATE FUNCTION anon_sum_with_bounds_remove(internal, entry bigint, lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_remove_int'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for bigint type, manual bounding, no epsilon.
 CREATE FUNCTION anon_sum_with_bounds_accum(internal, entry bigint, lb double precision,
   ub double precision)
 RETURNS internal AS
   'anon_func','anon_sum_with_bounds_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for bigint type, manual bounding, no epsilon.
+CREATE FUNCTION anon_sum_with_bounds_remove(internal, entry bigint, lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_remove_int'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for integer type, manual bounding, with epsilon.
 CREATE FUNCTION anon_sum_with_bounds_accum(internal, entry integer, lb double precision,
   ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_sum_with_bounds_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for integer type, manual bounding, with epsilon.
+CREATE FUNCTION anon_sum_with_bounds_remove(internal, entry integer, lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_remove_int'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for integer type, manual bounding, no epsilon.
 CREATE FUNCTION anon_sum_with_bounds_accum(internal, entry integer, lb double precision,
   ub double precision)
 RETURNS internal AS
   'anon_func','anon_sum_with_bounds_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for integer type, manual bounding, no epsilon.
+CREATE FUNCTION anon_sum_with_bounds_remove(internal, entry integer, lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_remove_int'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for smallint type, manual bounding, with epsilon.
 CREATE FUNCTION anon_sum_with_bounds_accum(internal, entry smallint, lb double precision,
   ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_sum_with_bounds_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for smallint type, manual bounding, with epsilon.
+CREATE FUNCTION anon_sum_with_bounds_remove(internal, entry smallint, lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_remove_int'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for smallint type, manual bounding, no epsilon.
 CREATE FUNCTION anon_sum_with_bounds_accum(internal, entry smallint, lb double precision,
   ub double precision)
 RETURNS internal AS
   'anon_func','anon_sum_with_bounds_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for smallint type, manual bounding, no epsilon.
+CREATE FUNCTION anon_sum_with_bounds_remove(internal, entry smallint, lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_remove_int'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Extract for double type.
 CREATE FUNCTION anon_sum_extract_double(internal) RETURNS double precision AS
   'anon_func','anon_sum_extract_double'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Window frame extract for double type.
+CREATE FUNCTION anon_sum_frame_extract_double(internal) RETURNS double precision AS
+  'anon_func','anon_sum_frame_extract_double'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Extract for int type.
 CREATE FUNCTION anon_sum_extract_int(internal) RETURNS bigint AS
   'anon_func','anon_sum_extract_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Window frame extract for int type.
+CREATE FUNCTION anon_sum_frame_extract_int(internal) RETURNS bigint AS
+  'anon_func','anon_sum_frame_extract_int'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Combine for parallel aggregation.
+CREATE FUNCTION anon_sum_combine(internal, internal) RETURNS internal AS
+  'anon_func','anon_sum_combine'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Serialize for parallel aggregation.
+CREATE FUNCTION anon_sum_serialize(internal) RETURNS bytea AS
+  'anon_func','anon_sum_serialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Deserialize for parallel aggregation.
+CREATE FUNCTION anon_sum_deserialize(bytea, internal) RETURNS internal AS
+  'anon_func','anon_sum_deserialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Combine for parallel aggregation of int types.
+CREATE FUNCTION anon_sum_int_combine(internal, internal) RETURNS internal AS
+  'anon_func','anon_sum_int_combine'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Serialize for parallel aggregation of int types.
+CREATE FUNCTION anon_sum_int_serialize(internal) RETURNS bytea AS
+  'anon_func','anon_sum_int_serialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Deserialize for parallel aggregation of int types.
+CREATE FUNCTION anon_sum_int_deserialize(bytea, internal) RETURNS internal AS
+  'anon_func','anon_sum_int_deserialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
 
 -- Aggregate for double type, auto bounding, with epsilon.
 CREATE AGGREGATE anon_sum(entry double precision, epsilon double precision) (
   SFUNC = anon_sum_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_double
+  SSPACE = 66000,
+  FINALFUNC = anon_sum_extract_double,
+  COMBINEFUNC = anon_sum_combine,
+  SERIALFUNC = anon_sum_serialize,
+  DESERIALFUNC = anon_sum_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for double type, auto bounding, no epsilon.
 CREATE AGGREGATE anon_sum(entry double precision) (
   SFUNC = anon_sum_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_double
+  SSPACE = 66000,
+  FINALFUNC = anon_sum_extract_double,
+  COMBINEFUNC = anon_sum_combine,
+  SERIALFUNC = anon_sum_serialize,
+  DESERIALFUNC = anon_sum_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for bigint type, auto bounding, with epsilon.
 CREATE AGGREGATE anon_sum(entry bigint, epsilon double precision) (
   SFUNC = anon_sum_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 2600,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for bigint type, auto bounding, no epsilon.
 CREATE AGGREGATE anon_sum(entry bigint) (
   SFUNC = anon_sum_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 2600,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for integer type, auto bounding, with epsilon.
 CREATE AGGREGATE anon_sum(entry integer, epsilon double precision) (
   SFUNC = anon_sum_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 2600,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for integer type, auto bounding, no epsilon.
 CREATE AGGREGATE anon_sum(entry integer) (
   SFUNC = anon_sum_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 2600,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for smallint type, auto bounding, with epsilon.
 CREATE AGGREGATE anon_sum(entry smallint, epsilon double precision) (
   SFUNC = anon_sum_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 2600,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for smallint type, auto bounding, no epsilon.
 CREATE AGGREGATE anon_sum(entry smallint) (
   SFUNC = anon_sum_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 2600,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for bigint type, manual bounding, with epsilon.
@@ -241,14 +435,34 @@ CREATE AGGREGATE anon_sum_with_bounds(entry bigint, lb double precision, ub doub
   epsilon double precision) (
   SFUNC = anon_sum_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 250,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  MSFUNC = anon_sum_with_bounds_accum,
+  MINVFUNC = anon_sum_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 250,
+  MFINALFUNC = anon_sum_frame_extract_int,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for bigint type, manual bounding, no epsilon.
 CREATE AGGREGATE anon_sum_with_bounds(entry bigint, lb double precision, ub double precision) (
   SFUNC = anon_sum_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 250,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  MSFUNC = anon_sum_with_bounds_accum,
+  MINVFUNC = anon_sum_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 250,
+  MFINALFUNC = anon_sum_frame_extract_int,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for double type, manual bounding, with epsilon.
@@ -256,7 +470,17 @@ CREATE AGGREGATE anon_sum_with_bounds(entry double precision, lb double precisio
     ub double precision, epsilon double precision) (
   SFUNC = anon_sum_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_double
+  SSPACE = 220,
+  FINALFUNC = anon_sum_extract_double,
+  COMBINEFUNC = anon_sum_combine,
+  SERIALFUNC = anon_sum_serialize,
+  DESERIALFUNC = anon_sum_deserialize,
+  MSFUNC = anon_sum_with_bounds_accum,
+  MINVFUNC = anon_sum_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 220,
+  MFINALFUNC = anon_sum_frame_extract_double,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for double type, manual bounding, no epsilon.
@@ -264,7 +488,17 @@ CREATE AGGREGATE anon_sum_with_bounds(entry double precision, lb double precisio
     ub double precision) (
   SFUNC = anon_sum_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_double
+  SSPACE = 220,
+  FINALFUNC = anon_sum_extract_double,
+  COMBINEFUNC = anon_sum_combine,
+  SERIALFUNC = anon_sum_serialize,
+  DESERIALFUNC = anon_sum_deserialize,
+  MSFUNC = anon_sum_with_bounds_accum,
+  MINVFUNC = anon_sum_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 220,
+  MFINALFUNC = anon_sum_frame_extract_double,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for integer type, manual bounding, with epsilon.
@@ -272,14 +506,34 @@ CREATE AGGREGATE anon_sum_with_bounds(entry integer, lb double precision, ub dou
     epsilon double precision) (
   SFUNC = anon_sum_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 250,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  MSFUNC = anon_sum_with_bounds_accum,
+  MINVFUNC = anon_sum_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 250,
+  MFINALFUNC = anon_sum_frame_extract_int,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for integer type, manual bounding, no epsilon.
 CREATE AGGREGATE anon_sum_with_bounds(entry integer, lb double precision, ub double precision) (
   SFUNC = anon_sum_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 250,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  MSFUNC = anon_sum_with_bounds_accum,
+  MINVFUNC = anon_sum_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 250,
+  MFINALFUNC = anon_sum_frame_extract_int,
+  PARALLEL = SAFE
 );
 
 
@@ -288,14 +542,34 @@ CREATE AGGREGATE anon_sum_with_bounds(entry smallint, lb double precision, ub do
     epsilon double precision) (
   SFUNC = anon_sum_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 250,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  MSFUNC = anon_sum_with_bounds_accum,
+  MINVFUNC = anon_sum_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 250,
+  MFINALFUNC = anon_sum_frame_extract_int,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for smallint type, manual bounding, no epsilon.
 CREATE AGGREGATE anon_sum_with_bounds(entry smallint, lb double precision, ub double precision) (
   SFUNC = anon_sum_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_sum_extract_int
+  SSPACE = 250,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  MSFUNC = anon_sum_with_bounds_accum,
+  MINVFUNC = anon_sum_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 250,
+  MFINALFUNC = anon_sum_frame_extract_int,
+  PARALLEL = SAFE
 );
 
 
@@ -313,45 +587,89 @@ CREATE AGGREGATE anon_sum_with_bounds(entry smallint, lb double precision, ub do
 CREATE FUNCTION anon_avg_accum(internal, entry double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_avg_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for auto bounding, no epsilon.
 CREATE FUNCTION anon_avg_accum(internal, entry double precision)
 RETURNS internal AS
   'anon_func','anon_avg_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for manual bounding, with epsilon.
 CREATE FUNCTION anon_avg_with_bounds_accum(internal, entry double precision, lb double precision,
   ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_avg_with_bounds_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for manual bounding, with epsilon.
+CREATE FUNCTION anon_avg_with_bounds_remove(internal, entry double precision, lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_avg_with_bounds_remove'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for manual bounding, no epsilon.
 CREATE FUNCTION anon_avg_with_bounds_accum(internal, entry double precision, lb double precision,
   ub double precision)
 RETURNS internal AS
   'anon_func','anon_avg_with_bounds_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for manual bounding, no epsilon.
+CREATE FUNCTION anon_avg_with_bounds_remove(internal, entry double precision, lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_avg_with_bounds_remove'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Extract.
 CREATE FUNCTION anon_avg_extract(internal) RETURNS double precision AS
   'anon_func','anon_avg_extract'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Window frame extract.
+CREATE FUNCTION anon_avg_frame_extract(internal) RETURNS double precision AS
+  'anon_func','anon_avg_frame_extract'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Combine for parallel aggregation.
+CREATE FUNCTION anon_avg_combine(internal, internal) RETURNS internal AS
+  'anon_func','anon_avg_combine'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Serialize for parallel aggregation.
+CREATE FUNCTION anon_avg_serialize(internal) RETURNS bytea AS
+  'anon_func','anon_avg_serialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Deserialize for parallel aggregation.
+CREATE FUNCTION anon_avg_deserialize(bytea, internal) RETURNS internal AS
+  'anon_func','anon_avg_deserialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
 
 -- Aggregate for auto bounding, with epsilon.
 CREATE AGGREGATE anon_avg(entry double precision, epsilon double precision) (
   SFUNC = anon_avg_accum,
   STYPE = internal,
-  FINALFUNC = anon_avg_extract
+  SSPACE = 66000,
+  FINALFUNC = anon_avg_extract,
+  COMBINEFUNC = anon_avg_combine,
+  SERIALFUNC = anon_avg_serialize,
+  DESERIALFUNC = anon_avg_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for auto bounding, no epsilon.
 CREATE AGGREGATE anon_avg(entry double precision) (
   SFUNC = anon_avg_accum,
   STYPE = internal,
-  FINALFUNC = anon_avg_extract
+  SSPACE = 66000,
+  FINALFUNC = anon_avg_extract,
+  COMBINEFUNC = anon_avg_combine,
+  SERIALFUNC = anon_avg_serialize,
+  DESERIALFUNC = anon_avg_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for manual bounding, with epsilon.
@@ -359,7 +677,17 @@ CREATE AGGREGATE anon_avg_with_bounds(entry double precision, lb double precisio
     ub double precision, epsilon double precision) (
   SFUNC = anon_avg_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_avg_extract
+  SSPACE = 330,
+  FINALFUNC = anon_avg_extract,
+  COMBINEFUNC = anon_avg_combine,
+  SERIALFUNC = anon_avg_serialize,
+  DESERIALFUNC = anon_avg_deserialize,
+  MSFUNC = anon_avg_with_bounds_accum,
+  MINVFUNC = anon_avg_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 330,
+  MFINALFUNC = anon_avg_frame_extract,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for manual bounding, no epsilon.
@@ -367,7 +695,17 @@ CREATE AGGREGATE anon_avg_with_bounds(entry double precision, lb double precisio
     ub double precision) (
   SFUNC = anon_avg_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_avg_extract
+  SSPACE = 330,
+  FINALFUNC = anon_avg_extract,
+  COMBINEFUNC = anon_avg_combine,
+  SERIALFUNC = anon_avg_serialize,
+  DESERIALFUNC = anon_avg_deserialize,
+  MSFUNC = anon_avg_with_bounds_accum,
+  MINVFUNC = anon_avg_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 330,
+  MFINALFUNC = anon_avg_frame_extract,
+  PARALLEL = SAFE
 );
 
 
@@ -385,45 +723,89 @@ CREATE AGGREGATE anon_avg_with_bounds(entry double precision, lb double precisio
 CREATE FUNCTION anon_var_accum(internal, entry double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_var_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for auto bounding, no epsilon.
 CREATE FUNCTION anon_var_accum(internal, entry double precision)
 RETURNS internal AS
   'anon_func','anon_var_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for manual bounding, with epsilon.
 CREATE FUNCTION anon_var_with_bounds_accum(internal, entry double precision, lb double precision,
   ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_var_with_bounds_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for manual bounding, with epsilon.
+CREATE FUNCTION anon_var_with_bounds_remove(internal, entry double precision, lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_var_with_bounds_remove'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for manual bounding, no epsilon.
 CREATE FUNCTION anon_var_with_bounds_accum(internal, entry double precision, lb double precision,
   ub double precision)
 RETURNS internal AS
   'anon_func','anon_var_with_bounds_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for manual bounding, no epsilon.
+CREATE FUNCTION anon_var_with_bounds_remove(internal, entry double precision, lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_var_with_bounds_remove'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Extract.
 CREATE FUNCTION anon_var_extract(internal) RETURNS double precision AS
   'anon_func','anon_var_extract'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Window frame extract.
+CREATE FUNCTION anon_var_frame_extract(internal) RETURNS double precision AS
+  'anon_func','anon_var_frame_extract'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Combine for parallel aggregation.
+CREATE FUNCTION anon_var_combine(internal, internal) RETURNS internal AS
+  'anon_func','anon_var_combine'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Serialize for parallel aggregation.
+CREATE FUNCTION anon_var_serialize(internal) RETURNS bytea AS
+  'anon_func','anon_var_serialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Deserialize for parallel aggregation.
+CREATE FUNCTION anon_var_deserialize(bytea, internal) RETURNS internal AS
+  'anon_func','anon_var_deserialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
 
 -- Aggregate for auto bounding, with epsilon.
 CREATE AGGREGATE anon_var(entry double precision, epsilon double precision) (
   SFUNC = anon_var_accum,
   STYPE = internal,
-  FINALFUNC = anon_var_extract
+  SSPACE = 99000,
+  FINALFUNC = anon_var_extract,
+  COMBINEFUNC = anon_var_combine,
+  SERIALFUNC = anon_var_serialize,
+  DESERIALFUNC = anon_var_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for auto bounding, no epsilon.
 CREATE AGGREGATE anon_var(entry double precision) (
   SFUNC = anon_var_accum,
   STYPE = internal,
-  FINALFUNC = anon_var_extract
+  SSPACE = 99000,
+  FINALFUNC = anon_var_extract,
+  COMBINEFUNC = anon_var_combine,
+  SERIALFUNC = anon_var_serialize,
+  DESERIALFUNC = anon_var_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for manual bounding, with epsilon.
@@ -431,7 +813,17 @@ CREATE AGGREGATE anon_var_with_bounds(entry double precision, lb double precisio
     ub double precision, epsilon double precision) (
   SFUNC = anon_var_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_var_extract
+  SSPACE = 440,
+  FINALFUNC = anon_var_extract,
+  COMBINEFUNC = anon_var_combine,
+  SERIALFUNC = anon_var_serialize,
+  DESERIALFUNC = anon_var_deserialize,
+  MSFUNC = anon_var_with_bounds_accum,
+  MINVFUNC = anon_var_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 440,
+  MFINALFUNC = anon_var_frame_extract,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for manual bounding, no epsilon.
@@ -439,7 +831,17 @@ CREATE AGGREGATE anon_var_with_bounds(entry double precision, lb double precisio
     ub double precision) (
   SFUNC = anon_var_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_var_extract
+  SSPACE = 440,
+  FINALFUNC = anon_var_extract,
+  COMBINEFUNC = anon_var_combine,
+  SERIALFUNC = anon_var_serialize,
+  DESERIALFUNC = anon_var_deserialize,
+  MSFUNC = anon_var_with_bounds_accum,
+  MINVFUNC = anon_var_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 440,
+  MFINALFUNC = anon_var_frame_extract,
+  PARALLEL = SAFE
 );
 
 
@@ -457,45 +859,89 @@ CREATE AGGREGATE anon_var_with_bounds(entry double precision, lb double precisio
 CREATE FUNCTION anon_stddev_accum(internal, entry double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_stddev_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for auto bounding, no epsilon.
 CREATE FUNCTION anon_stddev_accum(internal, entry double precision)
 RETURNS internal AS
   'anon_func','anon_stddev_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for manual bounding, with epsilon.
 CREATE FUNCTION anon_stddev_with_bounds_accum(internal, entry double precision, lb double precision,
   ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_stddev_with_bounds_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for manual bounding, with epsilon.
+CREATE FUNCTION anon_stddev_with_bounds_remove(internal, entry double precision, lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_stddev_with_bounds_remove'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for manual bounding, no epsilon.
 CREATE FUNCTION anon_stddev_with_bounds_accum(internal, entry double precision, lb double precision,
   ub double precision)
 RETURNS internal AS
   'anon_func','anon_stddev_with_bounds_accum'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Inverse transition for manual bounding, no epsilon.
+CREATE FUNCTION anon_stddev_with_bounds_remove(internal, entry double precision, lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_stddev_with_bounds_remove'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Extract.
 CREATE FUNCTION anon_stddev_extract(internal) RETURNS double precision AS
   'anon_func','anon_stddev_extract'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Window frame extract.
+CREATE FUNCTION anon_stddev_frame_extract(internal) RETURNS double precision AS
+  'anon_func','anon_stddev_frame_extract'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Combine for parallel aggregation.
+CREATE FUNCTION anon_stddev_combine(internal, internal) RETURNS internal AS
+  'anon_func','anon_stddev_combine'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Serialize for parallel aggregation.
+CREATE FUNCTION anon_stddev_serialize(internal) RETURNS bytea AS
+  'anon_func','anon_stddev_serialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Deserialize for parallel aggregation.
+CREATE FUNCTION anon_stddev_deserialize(bytea, internal) RETURNS internal AS
+  'anon_func','anon_stddev_deserialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
 
 -- Aggregate for auto bounding, with epsilon.
 CREATE AGGREGATE anon_stddev(entry double precision, epsilon double precision) (
   SFUNC = anon_stddev_accum,
   STYPE = internal,
-  FINALFUNC = anon_stddev_extract
+  SSPACE = 99000,
+  FINALFUNC = anon_stddev_extract,
+  COMBINEFUNC = anon_stddev_combine,
+  SERIALFUNC = anon_stddev_serialize,
+  DESERIALFUNC = anon_stddev_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for auto bounding, no epsilon.
 CREATE AGGREGATE anon_stddev(entry double precision) (
   SFUNC = anon_stddev_accum,
   STYPE = internal,
-  FINALFUNC = anon_stddev_extract
+  SSPACE = 99000,
+  FINALFUNC = anon_stddev_extract,
+  COMBINEFUNC = anon_stddev_combine,
+  SERIALFUNC = anon_stddev_serialize,
+  DESERIALFUNC = anon_stddev_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for manual bounding, with epsilon.
@@ -503,7 +949,17 @@ CREATE AGGREGATE anon_stddev_with_bounds(entry double precision, lb double preci
     ub double precision, epsilon double precision) (
   SFUNC = anon_stddev_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_stddev_extract
+  SSPACE = 480,
+  FINALFUNC = anon_stddev_extract,
+  COMBINEFUNC = anon_stddev_combine,
+  SERIALFUNC = anon_stddev_serialize,
+  DESERIALFUNC = anon_stddev_deserialize,
+  MSFUNC = anon_stddev_with_bounds_accum,
+  MINVFUNC = anon_stddev_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 480,
+  MFINALFUNC = anon_stddev_frame_extract,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for manual bounding, no epsilon.
@@ -511,7 +967,17 @@ CREATE AGGREGATE anon_stddev_with_bounds(entry double precision, lb double preci
     ub double precision) (
   SFUNC = anon_stddev_with_bounds_accum,
   STYPE = internal,
-  FINALFUNC = anon_stddev_extract
+  SSPACE = 480,
+  FINALFUNC = anon_stddev_extract,
+  COMBINEFUNC = anon_stddev_combine,
+  SERIALFUNC = anon_stddev_serialize,
+  DESERIALFUNC = anon_stddev_deserialize,
+  MSFUNC = anon_stddev_with_bounds_accum,
+  MINVFUNC = anon_stddev_with_bounds_remove,
+  MSTYPE = internal,
+  MSSPACE = 480,
+  MFINALFUNC = anon_stddev_frame_extract,
+  PARALLEL = SAFE
 );
 
 
@@ -528,73 +994,93 @@ CREATE FUNCTION anon_ntile_accum(internal, entry double precision, percentile do
   lb double precision, ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_ntile_accum_double'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for double type, no epsilon.
 CREATE FUNCTION anon_ntile_accum(internal, entry double precision, percentile double precision,
   lb double precision, ub double precision)
 RETURNS internal AS
   'anon_func','anon_ntile_accum_double'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for bigint type, with epsilon.
 CREATE FUNCTION anon_ntile_accum(internal, entry bigint, percentile double precision,
   lb double precision, ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_ntile_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for bigint type, no epsilon.
 CREATE FUNCTION anon_ntile_accum(internal, entry bigint, percentile double precision,
   lb double precision, ub double precision)
 RETURNS internal AS
   'anon_func','anon_ntile_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for integer type, with epsilon.
 CREATE FUNCTION anon_ntile_accum(internal, entry integer, percentile double precision,
   lb double precision, ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_ntile_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for integer type, no epsilon.
 CREATE FUNCTION anon_ntile_accum(internal, entry integer, percentile double precision,
   lb double precision, ub double precision)
 RETURNS internal AS
   'anon_func','anon_ntile_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for smallint type, with epsilon.
 CREATE FUNCTION anon_ntile_accum(internal, entry smallint, percentile double precision,
   lb double precision, ub double precision, epsilon double precision)
 RETURNS internal AS
   'anon_func','anon_ntile_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Accum for smallint type, no epsilon.
 CREATE FUNCTION anon_ntile_accum(internal, entry smallint, percentile double precision,
   lb double precision, ub double precision)
 RETURNS internal AS
   'anon_func','anon_ntile_accum_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Extract for double type.
 CREATE FUNCTION anon_ntile_extract_double(internal) RETURNS double precision AS
   'anon_func','anon_ntile_extract_double'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
 
 -- Extract for int type.
 CREATE FUNCTION anon_ntile_extract_int(internal) RETURNS bigint AS
   'anon_func','anon_ntile_extract_int'
-LANGUAGE C IMMUTABLE;
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Combine for parallel aggregation.
+CREATE FUNCTION anon_ntile_combine(internal, internal) RETURNS internal AS
+  'anon_func','anon_ntile_combine'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Serialize for parallel aggregation.
+CREATE FUNCTION anon_ntile_serialize(internal) RETURNS bytea AS
+  'anon_func','anon_ntile_serialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Deserialize for parallel aggregation.
+CREATE FUNCTION anon_ntile_deserialize(bytea, internal) RETURNS internal AS
+  'anon_func','anon_ntile_deserialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
 
 -- Aggregate for double type, with epsilon.
 CREATE AGGREGATE anon_ntile(entry double precision, percentile double precision,
     lb double precision, ub double precision, epsilon double precision) (
   SFUNC = anon_ntile_accum,
   STYPE = internal,
-  FINALFUNC = anon_ntile_extract_double
+  SSPACE = 8500,
+  FINALFUNC = anon_ntile_extract_double,
+  COMBINEFUNC = anon_ntile_combine,
+  SERIALFUNC = anon_ntile_serialize,
+  DESERIALFUNC = anon_ntile_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for double type, no epsilon.
@@ -602,7 +1088,12 @@ CREATE AGGREGATE anon_ntile(entry double precision, percentile double precision,
   lb double precision, ub double precision) (
   SFUNC = anon_ntile_accum,
   STYPE = internal,
-  FINALFUNC = anon_ntile_extract_double
+  SSPACE = 8500,
+  FINALFUNC = anon_ntile_extract_double,
+  COMBINEFUNC = anon_ntile_combine,
+  SERIALFUNC = anon_ntile_serialize,
+  DESERIALFUNC = anon_ntile_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for bigint type, with epsilon.
@@ -610,7 +1101,12 @@ CREATE AGGREGATE anon_ntile(entry bigint, percentile double precision, lb double
     ub double precision, epsilon double precision) (
   SFUNC = anon_ntile_accum,
   STYPE = internal,
-  FINALFUNC = anon_ntile_extract_int
+  SSPACE = 8500,
+  FINALFUNC = anon_ntile_extract_int,
+  COMBINEFUNC = anon_ntile_combine,
+  SERIALFUNC = anon_ntile_serialize,
+  DESERIALFUNC = anon_ntile_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for bigint type, no epsilon.
@@ -618,7 +1114,12 @@ CREATE AGGREGATE anon_ntile(entry bigint, percentile double precision, lb double
     ub double precision) (
   SFUNC = anon_ntile_accum,
   STYPE = internal,
-  FINALFUNC = anon_ntile_extract_int
+  SSPACE = 8500,
+  FINALFUNC = anon_ntile_extract_int,
+  COMBINEFUNC = anon_ntile_combine,
+  SERIALFUNC = anon_ntile_serialize,
+  DESERIALFUNC = anon_ntile_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for integer type, with epsilon.
@@ -626,7 +1127,12 @@ CREATE AGGREGATE anon_ntile(entry integer, percentile double precision,  lb doub
     ub double precision, epsilon double precision) (
   SFUNC = anon_ntile_accum,
   STYPE = internal,
-  FINALFUNC = anon_ntile_extract_int
+  SSPACE = 8500,
+  FINALFUNC = anon_ntile_extract_int,
+  COMBINEFUNC = anon_ntile_combine,
+  SERIALFUNC = anon_ntile_serialize,
+  DESERIALFUNC = anon_ntile_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for integer type, no epsilon.
@@ -634,7 +1140,12 @@ CREATE AGGREGATE anon_ntile(entry integer, percentile double precision,  lb doub
     ub double precision) (
   SFUNC = anon_ntile_accum,
   STYPE = internal,
-  FINALFUNC = anon_ntile_extract_int
+  SSPACE = 8500,
+  FINALFUNC = anon_ntile_extract_int,
+  COMBINEFUNC = anon_ntile_combine,
+  SERIALFUNC = anon_ntile_serialize,
+  DESERIALFUNC = anon_ntile_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for smallint type, with epsilon.
@@ -642,7 +1153,12 @@ CREATE AGGREGATE anon_ntile(entry smallint, percentile double precision,  lb dou
     ub double precision, epsilon double precision) (
   SFUNC = anon_ntile_accum,
   STYPE = internal,
-  FINALFUNC = anon_ntile_extract_int
+  SSPACE = 8500,
+  FINALFUNC = anon_ntile_extract_int,
+  COMBINEFUNC = anon_ntile_combine,
+  SERIALFUNC = anon_ntile_serialize,
+  DESERIALFUNC = anon_ntile_deserialize,
+  PARALLEL = SAFE
 );
 
 -- Aggregate for smallint type, no epsilon.
@@ -650,5 +1166,422 @@ CREATE AGGREGATE anon_ntile(entry smallint, percentile double precision,  lb dou
     ub double precision) (
   SFUNC = anon_ntile_accum,
   STYPE = internal,
-  FINALFUNC = anon_ntile_extract_int
+  SSPACE = 8500,
+  FINALFUNC = anon_ntile_extract_int,
+  COMBINEFUNC = anon_ntile_combine,
+  SERIALFUNC = anon_ntile_serialize,
+  DESERIALFUNC = anon_ntile_deserialize,
+  PARALLEL = SAFE
 );
+
+
+/* Create the array aggregates:
+ *
+ * ANON_SUM(column, epsilon)
+ * ANON_SUM(column)
+ * ANON_SUM_WITH_BOUNDS(column, lower, upper, epsilon)
+ * ANON_SUM_WITH_BOUNDS(column, lower, upper)
+ *
+ * and likewise for ANON_AVG, ANON_VAR and ANON_STDDEV, where column is of type
+ * double precision[] or, for ANON_SUM, bigint[]. Every non-null element of the
+ * arrays is an entry, which are added in batches.
+ */
+
+-- Accum for double array type, auto bounding, with epsilon.
+CREATE FUNCTION anon_sum_accum(internal, entries double precision[], epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_accum_double_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for double array type, auto bounding, no epsilon.
+CREATE FUNCTION anon_sum_accum(internal, entries double precision[])
+RETURNS internal AS
+  'anon_func','anon_sum_accum_double_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for double array type, manual bounding, with epsilon.
+CREATE FUNCTION anon_sum_with_bounds_accum(internal, entries double precision[], lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_accum_double_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for double array type, manual bounding, no epsilon.
+CREATE FUNCTION anon_sum_with_bounds_accum(internal, entries double precision[], lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_accum_double_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for bigint array type, auto bounding, with epsilon.
+CREATE FUNCTION anon_sum_accum(internal, entries bigint[], epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_accum_int_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for bigint array type, auto bounding, no epsilon.
+CREATE FUNCTION anon_sum_accum(internal, entries bigint[])
+RETURNS internal AS
+  'anon_func','anon_sum_accum_int_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for bigint array type, manual bounding, with epsilon.
+CREATE FUNCTION anon_sum_with_bounds_accum(internal, entries bigint[], lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_accum_int_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for bigint array type, manual bounding, no epsilon.
+CREATE FUNCTION anon_sum_with_bounds_accum(internal, entries bigint[], lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_sum_with_bounds_accum_int_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Aggregate for double array type, auto bounding, with epsilon.
+CREATE AGGREGATE anon_sum(entries double precision[], epsilon double precision) (
+  SFUNC = anon_sum_accum,
+  STYPE = internal,
+  SSPACE = 66000,
+  FINALFUNC = anon_sum_extract_double,
+  COMBINEFUNC = anon_sum_combine,
+  SERIALFUNC = anon_sum_serialize,
+  DESERIALFUNC = anon_sum_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for double array type, auto bounding, no epsilon.
+CREATE AGGREGATE anon_sum(entries double precision[]) (
+  SFUNC = anon_sum_accum,
+  STYPE = internal,
+  SSPACE = 66000,
+  FINALFUNC = anon_sum_extract_double,
+  COMBINEFUNC = anon_sum_combine,
+  SERIALFUNC = anon_sum_serialize,
+  DESERIALFUNC = anon_sum_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for double array type, manual bounding, with epsilon.
+CREATE AGGREGATE anon_sum_with_bounds(entries double precision[], lb double precision,
+    ub double precision, epsilon double precision) (
+  SFUNC = anon_sum_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 220,
+  FINALFUNC = anon_sum_extract_double,
+  COMBINEFUNC = anon_sum_combine,
+  SERIALFUNC = anon_sum_serialize,
+  DESERIALFUNC = anon_sum_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for double array type, manual bounding, no epsilon.
+CREATE AGGREGATE anon_sum_with_bounds(entries double precision[], lb double precision,
+    ub double precision) (
+  SFUNC = anon_sum_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 220,
+  FINALFUNC = anon_sum_extract_double,
+  COMBINEFUNC = anon_sum_combine,
+  SERIALFUNC = anon_sum_serialize,
+  DESERIALFUNC = anon_sum_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for bigint array type, auto bounding, with epsilon.
+CREATE AGGREGATE anon_sum(entries bigint[], epsilon double precision) (
+  SFUNC = anon_sum_accum,
+  STYPE = internal,
+  SSPACE = 2600,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for bigint array type, auto bounding, no epsilon.
+CREATE AGGREGATE anon_sum(entries bigint[]) (
+  SFUNC = anon_sum_accum,
+  STYPE = internal,
+  SSPACE = 2600,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for bigint array type, manual bounding, with epsilon.
+CREATE AGGREGATE anon_sum_with_bounds(entries bigint[], lb double precision,
+    ub double precision, epsilon double precision) (
+  SFUNC = anon_sum_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 250,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for bigint array type, manual bounding, no epsilon.
+CREATE AGGREGATE anon_sum_with_bounds(entries bigint[], lb double precision,
+    ub double precision) (
+  SFUNC = anon_sum_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 250,
+  FINALFUNC = anon_sum_extract_int,
+  COMBINEFUNC = anon_sum_int_combine,
+  SERIALFUNC = anon_sum_int_serialize,
+  DESERIALFUNC = anon_sum_int_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Accum for arrays, auto bounding, with epsilon.
+CREATE FUNCTION anon_avg_accum(internal, entries double precision[], epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_avg_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for arrays, auto bounding, no epsilon.
+CREATE FUNCTION anon_avg_accum(internal, entries double precision[])
+RETURNS internal AS
+  'anon_func','anon_avg_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for arrays, manual bounding, with epsilon.
+CREATE FUNCTION anon_avg_with_bounds_accum(internal, entries double precision[], lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_avg_with_bounds_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for arrays, manual bounding, no epsilon.
+CREATE FUNCTION anon_avg_with_bounds_accum(internal, entries double precision[], lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_avg_with_bounds_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Aggregate for arrays, auto bounding, with epsilon.
+CREATE AGGREGATE anon_avg(entries double precision[], epsilon double precision) (
+  SFUNC = anon_avg_accum,
+  STYPE = internal,
+  SSPACE = 66000,
+  FINALFUNC = anon_avg_extract,
+  COMBINEFUNC = anon_avg_combine,
+  SERIALFUNC = anon_avg_serialize,
+  DESERIALFUNC = anon_avg_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for arrays, auto bounding, no epsilon.
+CREATE AGGREGATE anon_avg(entries double precision[]) (
+  SFUNC = anon_avg_accum,
+  STYPE = internal,
+  SSPACE = 66000,
+  FINALFUNC = anon_avg_extract,
+  COMBINEFUNC = anon_avg_combine,
+  SERIALFUNC = anon_avg_serialize,
+  DESERIALFUNC = anon_avg_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for arrays, manual bounding, with epsilon.
+CREATE AGGREGATE anon_avg_with_bounds(entries double precision[], lb double precision,
+    ub double precision, epsilon double precision) (
+  SFUNC = anon_avg_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 330,
+  FINALFUNC = anon_avg_extract,
+  COMBINEFUNC = anon_avg_combine,
+  SERIALFUNC = anon_avg_serialize,
+  DESERIALFUNC = anon_avg_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for arrays, manual bounding, no epsilon.
+CREATE AGGREGATE anon_avg_with_bounds(entries double precision[], lb double precision,
+    ub double precision) (
+  SFUNC = anon_avg_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 330,
+  FINALFUNC = anon_avg_extract,
+  COMBINEFUNC = anon_avg_combine,
+  SERIALFUNC = anon_avg_serialize,
+  DESERIALFUNC = anon_avg_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Accum for arrays, auto bounding, with epsilon.
+CREATE FUNCTION anon_var_accum(internal, entries double precision[], epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_var_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for arrays, auto bounding, no epsilon.
+CREATE FUNCTION anon_var_accum(internal, entries double precision[])
+RETURNS internal AS
+  'anon_func','anon_var_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for arrays, manual bounding, with epsilon.
+CREATE FUNCTION anon_var_with_bounds_accum(internal, entries double precision[], lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_var_with_bounds_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for arrays, manual bounding, no epsilon.
+CREATE FUNCTION anon_var_with_bounds_accum(internal, entries double precision[], lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_var_with_bounds_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Aggregate for arrays, auto bounding, with epsilon.
+CREATE AGGREGATE anon_var(entries double precision[], epsilon double precision) (
+  SFUNC = anon_var_accum,
+  STYPE = internal,
+  SSPACE = 99000,
+  FINALFUNC = anon_var_extract,
+  COMBINEFUNC = anon_var_combine,
+  SERIALFUNC = anon_var_serialize,
+  DESERIALFUNC = anon_var_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for arrays, auto bounding, no epsilon.
+CREATE AGGREGATE anon_var(entries double precision[]) (
+  SFUNC = anon_var_accum,
+  STYPE = internal,
+  SSPACE = 99000,
+  FINALFUNC = anon_var_extract,
+  COMBINEFUNC = anon_var_combine,
+  SERIALFUNC = anon_var_serialize,
+  DESERIALFUNC = anon_var_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for arrays, manual bounding, with epsilon.
+CREATE AGGREGATE anon_var_with_bounds(entries double precision[], lb double precision,
+    ub double precision, epsilon double precision) (
+  SFUNC = anon_var_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 440,
+  FINALFUNC = anon_var_extract,
+  COMBINEFUNC = anon_var_combine,
+  SERIALFUNC = anon_var_serialize,
+  DESERIALFUNC = anon_var_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for arrays, manual bounding, no epsilon.
+CREATE AGGREGATE anon_var_with_bounds(entries double precision[], lb double precision,
+    ub double precision) (
+  SFUNC = anon_var_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 440,
+  FINALFUNC = anon_var_extract,
+  COMBINEFUNC = anon_var_combine,
+  SERIALFUNC = anon_var_serialize,
+  DESERIALFUNC = anon_var_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Accum for arrays, auto bounding, with epsilon.
+CREATE FUNCTION anon_stddev_accum(internal, entries double precision[], epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_stddev_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for arrays, auto bounding, no epsilon.
+CREATE FUNCTION anon_stddev_accum(internal, entries double precision[])
+RETURNS internal AS
+  'anon_func','anon_stddev_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for arrays, manual bounding, with epsilon.
+CREATE FUNCTION anon_stddev_with_bounds_accum(internal, entries double precision[], lb double precision,
+  ub double precision, epsilon double precision)
+RETURNS internal AS
+  'anon_func','anon_stddev_with_bounds_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Accum for arrays, manual bounding, no epsilon.
+CREATE FUNCTION anon_stddev_with_bounds_accum(internal, entries double precision[], lb double precision,
+  ub double precision)
+RETURNS internal AS
+  'anon_func','anon_stddev_with_bounds_accum_array'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- Aggregate for arrays, auto bounding, with epsilon.
+CREATE AGGREGATE anon_stddev(entries double precision[], epsilon double precision) (
+  SFUNC = anon_stddev_accum,
+  STYPE = internal,
+  SSPACE = 99000,
+  FINALFUNC = anon_stddev_extract,
+  COMBINEFUNC = anon_stddev_combine,
+  SERIALFUNC = anon_stddev_serialize,
+  DESERIALFUNC = anon_stddev_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for arrays, auto bounding, no epsilon.
+CREATE AGGREGATE anon_stddev(entries double precision[]) (
+  SFUNC = anon_stddev_accum,
+  STYPE = internal,
+  SSPACE = 99000,
+  FINALFUNC = anon_stddev_extract,
+  COMBINEFUNC = anon_stddev_combine,
+  SERIALFUNC = anon_stddev_serialize,
+  DESERIALFUNC = anon_stddev_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for arrays, manual bounding, with epsilon.
+CREATE AGGREGATE anon_stddev_with_bounds(entries double precision[], lb double precision,
+    ub double precision, epsilon double precision) (
+  SFUNC = anon_stddev_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 480,
+  FINALFUNC = anon_stddev_extract,
+  COMBINEFUNC = anon_stddev_combine,
+  SERIALFUNC = anon_stddev_serialize,
+  DESERIALFUNC = anon_stddev_deserialize,
+  PARALLEL = SAFE
+);
+
+-- Aggregate for arrays, manual bounding, no epsilon.
+CREATE AGGREGATE anon_stddev_with_bounds(entries double precision[], lb double precision,
+    ub double precision) (
+  SFUNC = anon_stddev_with_bounds_accum,
+  STYPE = internal,
+  SSPACE = 480,
+  FINALFUNC = anon_stddev_extract,
+  COMBINEFUNC = anon_stddev_combine,
+  SERIALFUNC = anon_stddev_serialize,
+  DESERIALFUNC = anon_stddev_deserialize,
+  PARALLEL = SAFE
+);
+
+/* Privacy budget:
+ *
+ * ANON_EPSILON_SPENT()
+ * ANON_RESET_EPSILON_SPENT(role)
+ *
+ * The epsilon spent by the current role, and resetting it for a role, which
+ * only superusers may do.
+ */
+
+CREATE FUNCTION anon_epsilon_spent()
+RETURNS double precision AS
+  'anon_func','anon_epsilon_spent'
+LANGUAGE C VOLATILE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION anon_reset_epsilon_spent(role regrole)
+RETURNS void AS
+  'anon_func','anon_reset_epsilon_spent'
+LANGUAGE C VOLATILE STRICT PARALLEL UNSAFE;
@@ -18,10 +18,20 @@ extern "C" {
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "miscadmin.h"
+#include "catalog/pg_type.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/array.h"
 #include "utils/datum.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
 
 PG_MODULE_MAGIC;
 
+void _PG_init(void);
+
 #define CHECK_AGG_CONTEXT(fcinfo)                                 \
   if (!AggCheckCallContext(fcinfo, NULL)) {                       \
     elog(ERROR, "Anon function called in non-aggregate context"); \
@@ -34,39 +44,216 @@ PG_MODULE_MAGIC;
 // ANON_COUNT
 PG_FUNCTION_INFO_V1(anon_count_accum);
 PG_FUNCTION_INFO_V1(anon_count_extract);
+PG_FUNCTION_INFO_V1(anon_count_combine);
+PG_FUNCTION_INFO_V1(anon_count_serialize);
+PG_FUNCTION_INFO_V1(anon_count_deserialize);
+PG_FUNCTION_INFO_V1(anon_count_remove);
+PG_FUNCTION_INFO_V1(anon_count_frame_extract);
 
 // ANON_SUM
 PG_FUNCTION_INFO_V1(anon_sum_accum_double);
 PG_FUNCTION_INFO_V1(anon_sum_accum_int);
 PG_FUNCTION_INFO_V1(anon_sum_with_bounds_accum_double);
 PG_FUNCTION_INFO_V1(anon_sum_with_bounds_accum_int);
+PG_FUNCTION_INFO_V1(anon_sum_accum_double_array);
+PG_FUNCTION_INFO_V1(anon_sum_with_bounds_accum_double_array);
+PG_FUNCTION_INFO_V1(anon_sum_accum_int_array);
+PG_FUNCTION_INFO_V1(anon_sum_with_bounds_accum_int_array);
 PG_FUNCTION_INFO_V1(anon_sum_extract_double);
 PG_FUNCTION_INFO_V1(anon_sum_extract_int);
+PG_FUNCTION_INFO_V1(anon_sum_combine);
+PG_FUNCTION_INFO_V1(anon_sum_serialize);
+PG_FUNCTION_INFO_V1(anon_sum_deserialize);
+PG_FUNCTION_INFO_V1(anon_sum_int_combine);
+PG_FUNCTION_INFO_V1(anon_sum_int_serialize);
+PG_FUNCTION_INFO_V1(anon_sum_int_deserialize);
+PG_FUNCTION_INFO_V1(anon_sum_with_bounds_remove_double);
+PG_FUNCTION_INFO_V1(anon_sum_with_bounds_remove_int);
+PG_FUNCTION_INFO_V1(anon_sum_frame_extract_double);
+PG_FUNCTION_INFO_V1(anon_sum_frame_extract_int);
 
 // ANON_AVG
 PG_FUNCTION_INFO_V1(anon_avg_accum);
 PG_FUNCTION_INFO_V1(anon_avg_with_bounds_accum);
+PG_FUNCTION_INFO_V1(anon_avg_accum_array);
+PG_FUNCTION_INFO_V1(anon_avg_with_bounds_accum_array);
 PG_FUNCTION_INFO_V1(anon_avg_extract);
+PG_FUNCTION_INFO_V1(anon_avg_combine);
+PG_FUNCTION_INFO_V1(anon_avg_serialize);
+PG_FUNCTION_INFO_V1(anon_avg_deserialize);
+PG_FUNCTION_INFO_V1(anon_avg_with_bounds_remove);
+PG_FUNCTION_INFO_V1(anon_avg_frame_extract);
 
 // ANON_VAR
 PG_FUNCTION_INFO_V1(anon_var_accum);
 PG_FUNCTION_INFO_V1(anon_var_with_bounds_accum);
+PG_FUNCTION_INFO_V1(anon_var_accum_array);
+PG_FUNCTION_INFO_V1(anon_var_with_bounds_accum_array);
 PG_FUNCTION_INFO_V1(anon_var_extract);
+PG_FUNCTION_INFO_V1(anon_var_combine);
+PG_FUNCTION_INFO_V1(anon_var_serialize);
+PG_FUNCTION_INFO_V1(anon_var_deserialize);
+PG_FUNCTION_INFO_V1(anon_var_with_bounds_remove);
+PG_FUNCTION_INFO_V1(anon_var_frame_extract);
 
 // ANON_STDDEV
 PG_FUNCTION_INFO_V1(anon_stddev_accum);
 PG_FUNCTION_INFO_V1(anon_stddev_with_bounds_accum);
+PG_FUNCTION_INFO_V1(anon_stddev_accum_array);
+PG_FUNCTION_INFO_V1(anon_stddev_with_bounds_accum_array);
 PG_FUNCTION_INFO_V1(anon_stddev_extract);
+PG_FUNCTION_INFO_V1(anon_stddev_combine);
+PG_FUNCTION_INFO_V1(anon_stddev_serialize);
+PG_FUNCTION_INFO_V1(anon_stddev_deserialize);
+PG_FUNCTION_INFO_V1(anon_stddev_with_bounds_remove);
+PG_FUNCTION_INFO_V1(anon_stddev_frame_extract);
 
 // ANON_NTILE
 PG_FUNCTION_INFO_V1(anon_ntile_accum_double);
 PG_FUNCTION_INFO_V1(anon_ntile_accum_int);
 PG_FUNCTION_INFO_V1(anon_ntile_extract_double);
 PG_FUNCTION_INFO_V1(anon_ntile_extract_int);
+PG_FUNCTION_INFO_V1(anon_ntile_combine);
+PG_FUNCTION_INFO_V1(anon_ntile_serialize);
+PG_FUNCTION_INFO_V1(anon_ntile_deserialize);
+
+// Privacy budget
+PG_FUNCTION_INFO_V1(anon_epsilon_spent);
+PG_FUNCTION_INFO_V1(anon_reset_epsilon_spent);
 }
 
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "budget_ledger.h"
 #include "dp_func.h"
 
+/*
+ * Memory management.
+ */
+
+// DP functions are allocated with palloc in the current memory context.
+void* dp_func_palloc(size_t size) { return palloc(size); }
+void dp_func_pfree(void* ptr) { pfree(ptr); }
+
+/*
+ * Privacy budget.
+ */
+
+// Number of roles whose spent epsilon the ledger can track.
+constexpr int kLedgerSlots = 1024;
+
+// Epsilon every role may spend in total, or 0 for no limit.
+double epsilon_budget = 0;
+
+// Epsilon spent by every role, in shared memory. Only attached if the library
+// is in shared_preload_libraries.
+BudgetLedger ledger;
+
+shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+#if PG_VERSION_NUM >= 150000
+shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+
+void request_ledger_shmem(void) {
+#if PG_VERSION_NUM >= 150000
+  if (prev_shmem_request_hook) {
+    prev_shmem_request_hook();
+  }
+#endif
+  RequestAddinShmemSpace(BudgetLedger::Size(kLedgerSlots));
+}
+
+void attach_ledger_shmem(void) {
+  if (prev_shmem_startup_hook) {
+    prev_shmem_startup_hook();
+  }
+  size_t size = BudgetLedger::Size(kLedgerSlots);
+  bool found;
+  LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+  void* memory = ShmemInitStruct("anon_func budget ledger", size, &found);
+  if (!found) {
+    memset(memory, 0, size);
+  }
+  LWLockRelease(AddinShmemInitLock);
+  ledger = BudgetLedger(memory, kLedgerSlots);
+}
+
+// Charges the epsilon of a release to the budget of the current role, and
+// fails the query if the budget is exhausted. Every call is charged: the
+// function info outlives an aggregation pass, e.g., when a correlated subquery
+// is rescanned for every outer row, and Postgres does not tell the final
+// function which pass a group belongs to.
+void charge_budget(const DpFunc* func) {
+  if (!ledger.attached()) {
+    return;
+  }
+  double budget = epsilon_budget > 0
+                      ? epsilon_budget
+                      : std::numeric_limits<double>::infinity();
+  std::string err;
+  if (!ledger.Charge(GetUserId(), func->GetEpsilon(), budget, &err)) {
+    ereport(ERROR, (errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+                    errmsg("%s", err.c_str())));
+  }
+}
+
+void _PG_init(void) {
+  SetDpFuncAllocator(dp_func_palloc, dp_func_pfree);
+  DefineCustomRealVariable(
+      "anon_func.epsilon_budget",
+      "Total epsilon each role may spend on anonymous functions.",
+      "0 disables the limit. Requires anon_func in "
+      "shared_preload_libraries.",
+      &epsilon_budget, 0, 0, std::numeric_limits<double>::max(), PGC_SUSET,
+      0, NULL, NULL, NULL);
+  if (!process_shared_preload_libraries_in_progress) {
+    return;
+  }
+#if PG_VERSION_NUM >= 150000
+  prev_shmem_request_hook = shmem_request_hook;
+  shmem_request_hook = request_ledger_shmem;
+#else
+  request_ledger_shmem();
+#endif
+  prev_shmem_startup_hook = shmem_startup_hook;
+  shmem_startup_hook = attach_ledger_shmem;
+}
+
+// Deletes a state when the memory context it was allocated in is reset.
+void delete_state(void* arg) { delete reinterpret_cast<DpFunc*>(arg); }
+
+// Returns the aggregate memory context, in which the states live.
+MemoryContext agg_context(PG_FUNCTION_ARGS) {
+  MemoryContext aggcontext;
+  if (!AggCheckCallContext(fcinfo, &aggcontext)) {
+    elog(ERROR, "Anon function called in non-aggregate context");
+  }
+  return aggcontext;
+}
+
+// Runs the constructor of a state in the aggregate memory context. The state
+// is deleted when the context is reset, which releases the states of all
+// groups at once at the end of the query, and also if the query fails. States
+// are never deleted otherwise, since transition values may be passed on
+// between aggregate support functions.
+template <typename DpFunction, typename Constructor>
+DpFunction* new_state(PG_FUNCTION_ARGS, Constructor constructor) {
+  MemoryContext aggcontext = agg_context(fcinfo);
+  MemoryContext old_context = MemoryContextSwitchTo(aggcontext);
+  DpFunction* func = constructor();
+  if (func) {
+    MemoryContextCallback* callback = reinterpret_cast<MemoryContextCallback*>(
+        palloc(sizeof(MemoryContextCallback)));
+    callback->func = delete_state;
+    callback->arg = func;
+    MemoryContextRegisterResetCallback(aggcontext, callback);
+  }
+  MemoryContextSwitchTo(old_context);
+  return func;
+}
+
 /*
  * Helper functions.
  */
@@ -87,9 +274,63 @@ void add_arg_entry(PG_FUNCTION_ARGS, DpFunction* func, bool is_integral) {
   }
 }
 
-// Common code for bounded accum functions.
+// Adds the elements of an array argument as entries, skipping nulls. Arrays
+// without nulls are added in place, without unboxing every element.
+template <typename DpFunction>
+void add_arg_entries(PG_FUNCTION_ARGS, DpFunction* func, bool is_integral) {
+  if (PG_ARGISNULL(1)) {
+    return;
+  }
+  ArrayType* array = PG_GETARG_ARRAYTYPE_P(1);
+  int size = ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array));
+  bool entries_added;
+  if (!ARR_HASNULL(array) && !is_integral) {
+    entries_added = func->AddEntries(
+        reinterpret_cast<const double*>(ARR_DATA_PTR(array)), size);
+  } else if (!ARR_HASNULL(array)) {
+    entries_added = func->AddEntries(
+        reinterpret_cast<const int64_t*>(ARR_DATA_PTR(array)), size);
+  } else if (is_integral) {
+    Datum* elements;
+    bool* nulls;
+    int num_elements;
+    deconstruct_array(array, INT8OID, sizeof(int64), FLOAT8PASSBYVAL, 'd',
+                      &elements, &nulls, &num_elements);
+    std::vector<int64_t> entries;
+    entries.reserve(num_elements);
+    for (int i = 0; i < num_elements; ++i) {
+      if (!nulls[i]) {
+        entries.push_back(DatumGetInt64(elements[i]));
+      }
+    }
+    entries_added = func->AddEntries(entries.data(), entries.size());
+  } else {
+    Datum* elements;
+    bool* nulls;
+    int num_elements;
+    deconstruct_array(array, FLOAT8OID, sizeof(float8), FLOAT8PASSBYVAL, 'd',
+                      &elements, &nulls, &num_elements);
+    std::vector<double> entries;
+    entries.reserve(num_elements);
+    for (int i = 0; i < num_elements; ++i) {
+      if (!nulls[i]) {
+        entries.push_back(DatumGetFloat8(elements[i]));
+      }
+    }
+    entries_added = func->AddEntries(entries.data(), entries.size());
+  }
+  if (!entries_added) {
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+            errmsg("Adding entry to dp function failed.")));
+  }
+}
+
+// Common code for bounded accum functions. If is_array, the entries are the
+// elements of an array.
 template <typename DpFunction>
-Datum bounded_accum(PG_FUNCTION_ARGS, bool with_bounds, bool is_integral) {
+Datum bounded_accum(PG_FUNCTION_ARGS, bool with_bounds, bool is_integral,
+                    bool is_array = false) {
   CHECK_AGG_CONTEXT(fcinfo);
   DpFunction* arg0;
 
@@ -118,8 +359,10 @@ Datum bounded_accum(PG_FUNCTION_ARGS, bool with_bounds, bool is_integral) {
 
     // Construct the DP function.
     std::string err;
-    arg0 = new DpFunction(&err, !with_epsilon, epsilon,
-                          !with_bounds, lower, upper);
+    arg0 = new_state<DpFunction>(fcinfo, [&]() {
+      return new DpFunction(&err, !with_epsilon, epsilon, !with_bounds, lower,
+                            upper);
+    });
     if (!err.empty()) {
       ereport(ERROR,
               (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
@@ -129,7 +372,11 @@ Datum bounded_accum(PG_FUNCTION_ARGS, bool with_bounds, bool is_integral) {
     arg0 = reinterpret_cast<DpFunction*>(PG_GETARG_POINTER(0));
   }
 
-  add_arg_entry(fcinfo, arg0, is_integral);
+  if (is_array) {
+    add_arg_entries(fcinfo, arg0, is_integral);
+  } else {
+    add_arg_entry(fcinfo, arg0, is_integral);
+  }
   PG_RETURN_POINTER(arg0);
 }
 
@@ -141,13 +388,13 @@ Datum int_extract(PG_FUNCTION_ARGS){
     PG_RETURN_NULL();
   }
   DpFunction* arg = reinterpret_cast<DpFunction*>(PG_GETARG_POINTER(0));
+  charge_budget(arg);
   std::string err;
   int64_t result = arg->ResultRounded(&err);
   if (!err.empty()) {
     ereport(INFO, (errmsg("%s Returning NULL.", err.c_str())));
     PG_RETURN_NULL();
   }
-  delete arg;
   PG_RETURN_INT64(result);
 }
 
@@ -159,16 +406,146 @@ Datum double_extract(PG_FUNCTION_ARGS){
     PG_RETURN_NULL();
   }
   DpFunction* arg = reinterpret_cast<DpFunction*>(PG_GETARG_POINTER(0));
+  charge_budget(arg);
   std::string err;
   double result = arg->Result(&err);
   if (!err.empty()) {
     ereport(INFO, (errmsg("%s Returning NULL.", err.c_str())));
     PG_RETURN_NULL();
   }
-  delete arg;
   PG_RETURN_FLOAT8(result);
 }
 
+// Common combine code for parallel aggregation. Merges the second state into
+// the first one.
+template <typename DpFunction>
+Datum combine(PG_FUNCTION_ARGS) {
+  CHECK_AGG_CONTEXT(fcinfo);
+  if (PG_ARGISNULL(1)) {
+    if (PG_ARGISNULL(0)) {
+      PG_RETURN_NULL();
+    }
+    PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+  }
+  DpFunction* arg1 = reinterpret_cast<DpFunction*>(PG_GETARG_POINTER(1));
+  // States live until the aggregate memory context is reset, so the second
+  // state can become the combined state without being copied.
+  if (PG_ARGISNULL(0)) {
+    PG_RETURN_POINTER(arg1);
+  }
+  DpFunction* arg0 = reinterpret_cast<DpFunction*>(PG_GETARG_POINTER(0));
+  std::string err;
+  if (!arg0->Merge(*arg1, &err)) {
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+            errmsg("%s", err.c_str())));
+  }
+  PG_RETURN_POINTER(arg0);
+}
+
+// Common serialize code for parallel aggregation. Returns the state as bytea.
+template <typename DpFunction>
+Datum serialize(PG_FUNCTION_ARGS) {
+  CHECK_AGG_CONTEXT(fcinfo);
+  DpFunction* arg = reinterpret_cast<DpFunction*>(PG_GETARG_POINTER(0));
+  std::string err;
+  std::string state = arg->Serialize(&err);
+  if (!err.empty()) {
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+            errmsg("%s", err.c_str())));
+  }
+  bytea* result = reinterpret_cast<bytea*>(palloc(VARHDRSZ + state.size()));
+  SET_VARSIZE(result, VARHDRSZ + state.size());
+  memcpy(VARDATA(result), state.data(), state.size());
+  PG_RETURN_BYTEA_P(result);
+}
+
+// Common deserialize code for parallel aggregation. Reconstructs the state
+// from bytea.
+template <typename DpFunction>
+Datum deserialize(PG_FUNCTION_ARGS) {
+  CHECK_AGG_CONTEXT(fcinfo);
+  bytea* arg = PG_GETARG_BYTEA_PP(0);
+  std::string err;
+  DpFunction* result = new_state<DpFunction>(fcinfo, [&]() {
+    return DeserializeDpFunc<DpFunction>(
+        std::string(VARDATA_ANY(arg), VARSIZE_ANY_EXHDR(arg)), &err);
+  });
+  if (!err.empty()) {
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+            errmsg("%s", err.c_str())));
+  }
+  PG_RETURN_POINTER(result);
+}
+
+// Common inverse transition code for moving aggregates. Removes the entry
+// that leaves the window frame.
+template <typename DpFunction>
+Datum bounded_remove(PG_FUNCTION_ARGS, bool is_integral) {
+  DpFunction* arg0 = reinterpret_cast<DpFunction*>(PG_GETARG_POINTER(0));
+  // Removing an entry may allocate scratch space that belongs to the state.
+  MemoryContext old_context = MemoryContextSwitchTo(agg_context(fcinfo));
+  std::string err;
+  bool entry_removed;
+  if (is_integral) {
+    entry_removed = arg0->RemoveEntry(PG_GETARG_INT64(1), &err);
+  } else {
+    entry_removed = arg0->RemoveEntry(PG_GETARG_FLOAT8(1), &err);
+  }
+  MemoryContextSwitchTo(old_context);
+  if (!entry_removed) {
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+            errmsg("%s", err.c_str())));
+  }
+  PG_RETURN_POINTER(arg0);
+}
+
+// Common extract code of moving aggregates for returning integer values, which
+// releases the entries of the current window frame. Return null if error.
+template <typename DpFunction>
+Datum int_frame_extract(PG_FUNCTION_ARGS) {
+  MemoryContext aggcontext = agg_context(fcinfo);
+  if (PG_ARGISNULL(0)) {
+    PG_RETURN_NULL();
+  }
+  DpFunction* arg = reinterpret_cast<DpFunction*>(PG_GETARG_POINTER(0));
+  charge_budget(arg);
+  MemoryContext old_context = MemoryContextSwitchTo(aggcontext);
+  std::string err;
+  int64_t result = arg->FrameResultRounded(&err);
+  MemoryContextSwitchTo(old_context);
+  if (!err.empty()) {
+    ereport(INFO, (errmsg("%s Returning NULL.", err.c_str())));
+    PG_RETURN_NULL();
+  }
+  PG_RETURN_INT64(result);
+}
+
+// Common extract code of moving aggregates for returning double values, which
+// releases the entries of the current window frame. Return null if error.
+template <typename DpFunction>
+Datum double_frame_extract(PG_FUNCTION_ARGS) {
+  MemoryContext aggcontext = agg_context(fcinfo);
+  if (PG_ARGISNULL(0)) {
+    PG_RETURN_NULL();
+  }
+  DpFunction* arg = reinterpret_cast<DpFunction*>(PG_GETARG_POINTER(0));
+  charge_budget(arg);
+  MemoryContext old_context = MemoryContextSwitchTo(aggcontext);
+  std::string err;
+  double result = arg->FrameResult(&err);
+  MemoryContextSwitchTo(old_context);
+  if (!err.empty()) {
+    ereport(INFO, (errmsg("%s Returning NULL.", err.c_str())));
+    PG_RETURN_NULL();
+  }
+  PG_RETURN_FLOAT8(result);
+}
+
+
 
 /*
  * ANON_COUNT functions.
@@ -179,12 +556,13 @@ Datum anon_count_accum(PG_FUNCTION_ARGS) {
   DpCount* arg0;
   if (PG_ARGISNULL(0)) {
     std::string err;
-    if (PG_NARGS() > 2) {
-      float8 epsilon = PG_GETARG_FLOAT8(2);
-      arg0 = new DpCount(&err, /*default_epsilon=*/false, epsilon);
-    } else {
-      arg0 = new DpCount(&err);
-    }
+    arg0 = new_state<DpCount>(fcinfo, [&]() {
+      if (PG_NARGS() > 2) {
+        float8 epsilon = PG_GETARG_FLOAT8(2);
+        return new DpCount(&err, /*default_epsilon=*/false, epsilon);
+      }
+      return new DpCount(&err);
+    });
     if (!err.empty()) {
       ereport(ERROR,
               (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
@@ -207,6 +585,36 @@ Datum anon_count_extract(PG_FUNCTION_ARGS) {
   return int_extract<DpCount>(fcinfo);
 }
 
+Datum anon_count_combine(PG_FUNCTION_ARGS) {
+  return combine<DpCount>(fcinfo);
+}
+
+Datum anon_count_serialize(PG_FUNCTION_ARGS) {
+  return serialize<DpCount>(fcinfo);
+}
+
+Datum anon_count_deserialize(PG_FUNCTION_ARGS) {
+  return deserialize<DpCount>(fcinfo);
+}
+
+Datum anon_count_remove(PG_FUNCTION_ARGS) {
+  DpCount* arg0 = reinterpret_cast<DpCount*>(PG_GETARG_POINTER(0));
+  MemoryContext old_context = MemoryContextSwitchTo(agg_context(fcinfo));
+  std::string err;
+  bool entry_removed = arg0->RemoveEntry(1, &err);
+  MemoryContextSwitchTo(old_context);
+  if (!entry_removed) {
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+            errmsg("%s", err.c_str())));
+  }
+  PG_RETURN_POINTER(arg0);
+}
+
+Datum anon_count_frame_extract(PG_FUNCTION_ARGS) {
+  return int_frame_extract<DpCount>(fcinfo);
+}
+
 
 /*
  * ANON_SUM functions.
@@ -222,11 +630,27 @@ Datum anon_sum_with_bounds_accum_double(PG_FUNCTION_ARGS) {
 }
 
 Datum anon_sum_accum_int(PG_FUNCTION_ARGS) {
-  return bounded_accum<DpSum>(fcinfo, false, true);
+  return bounded_accum<DpIntSum>(fcinfo, false, true);
 }
 
 Datum anon_sum_with_bounds_accum_int(PG_FUNCTION_ARGS) {
-  return bounded_accum<DpSum>(fcinfo, true, true);
+  return bounded_accum<DpIntSum>(fcinfo, true, true);
+}
+
+Datum anon_sum_accum_double_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpSum>(fcinfo, false, false, /*is_array=*/true);
+}
+
+Datum anon_sum_with_bounds_accum_double_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpSum>(fcinfo, true, false, /*is_array=*/true);
+}
+
+Datum anon_sum_accum_int_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpIntSum>(fcinfo, false, true, /*is_array=*/true);
+}
+
+Datum anon_sum_with_bounds_accum_int_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpIntSum>(fcinfo, true, true, /*is_array=*/true);
 }
 
 Datum anon_sum_extract_double(PG_FUNCTION_ARGS) {
@@ -234,7 +658,47 @@ Datum anon_sum_extract_double(PG_FUNCTION_ARGS) {
 }
 
 Datum anon_sum_extract_int(PG_FUNCTION_ARGS) {
-  return int_extract<DpSum>(fcinfo);
+  return int_extract<DpIntSum>(fcinfo);
+}
+
+Datum anon_sum_combine(PG_FUNCTION_ARGS) {
+  return combine<DpSum>(fcinfo);
+}
+
+Datum anon_sum_serialize(PG_FUNCTION_ARGS) {
+  return serialize<DpSum>(fcinfo);
+}
+
+Datum anon_sum_deserialize(PG_FUNCTION_ARGS) {
+  return deserialize<DpSum>(fcinfo);
+}
+
+Datum anon_sum_int_combine(PG_FUNCTION_ARGS) {
+  return combine<DpIntSum>(fcinfo);
+}
+
+Datum anon_sum_int_serialize(PG_FUNCTION_ARGS) {
+  return serialize<DpIntSum>(fcinfo);
+}
+
+Datum anon_sum_int_deserialize(PG_FUNCTION_ARGS) {
+  return deserialize<DpIntSum>(fcinfo);
+}
+
+Datum anon_sum_with_bounds_remove_double(PG_FUNCTION_ARGS) {
+  return bounded_remove<DpSum>(fcinfo, false);
+}
+
+Datum anon_sum_with_bounds_remove_int(PG_FUNCTION_ARGS) {
+  return bounded_remove<DpIntSum>(fcinfo, true);
+}
+
+Datum anon_sum_frame_extract_double(PG_FUNCTION_ARGS) {
+  return double_frame_extract<DpSum>(fcinfo);
+}
+
+Datum anon_sum_frame_extract_int(PG_FUNCTION_ARGS) {
+  return int_frame_extract<DpIntSum>(fcinfo);
 }
 
 
@@ -251,10 +715,38 @@ Datum anon_avg_with_bounds_accum(PG_FUNCTION_ARGS) {
   return bounded_accum<DpMean>(fcinfo, true, false);
 }
 
+Datum anon_avg_accum_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpMean>(fcinfo, false, false, /*is_array=*/true);
+}
+
+Datum anon_avg_with_bounds_accum_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpMean>(fcinfo, true, false, /*is_array=*/true);
+}
+
 Datum anon_avg_extract(PG_FUNCTION_ARGS) {
   return double_extract<DpMean>(fcinfo);
 }
 
+Datum anon_avg_combine(PG_FUNCTION_ARGS) {
+  return combine<DpMean>(fcinfo);
+}
+
+Datum anon_avg_serialize(PG_FUNCTION_ARGS) {
+  return serialize<DpMean>(fcinfo);
+}
+
+Datum anon_avg_deserialize(PG_FUNCTION_ARGS) {
+  return deserialize<DpMean>(fcinfo);
+}
+
+Datum anon_avg_with_bounds_remove(PG_FUNCTION_ARGS) {
+  return bounded_remove<DpMean>(fcinfo, false);
+}
+
+Datum anon_avg_frame_extract(PG_FUNCTION_ARGS) {
+  return double_frame_extract<DpMean>(fcinfo);
+}
+
 
 /*
  * ANON_VAR functions.
@@ -269,10 +761,38 @@ Datum anon_var_with_bounds_accum(PG_FUNCTION_ARGS) {
   return bounded_accum<DpVariance>(fcinfo, true, false);
 }
 
+Datum anon_var_accum_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpVariance>(fcinfo, false, false, /*is_array=*/true);
+}
+
+Datum anon_var_with_bounds_accum_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpVariance>(fcinfo, true, false, /*is_array=*/true);
+}
+
 Datum anon_var_extract(PG_FUNCTION_ARGS) {
   return double_extract<DpVariance>(fcinfo);
 }
 
+Datum anon_var_combine(PG_FUNCTION_ARGS) {
+  return combine<DpVariance>(fcinfo);
+}
+
+Datum anon_var_serialize(PG_FUNCTION_ARGS) {
+  return serialize<DpVariance>(fcinfo);
+}
+
+Datum anon_var_deserialize(PG_FUNCTION_ARGS) {
+  return deserialize<DpVariance>(fcinfo);
+}
+
+Datum anon_var_with_bounds_remove(PG_FUNCTION_ARGS) {
+  return bounded_remove<DpVariance>(fcinfo, false);
+}
+
+Datum anon_var_frame_extract(PG_FUNCTION_ARGS) {
+  return double_frame_extract<DpVariance>(fcinfo);
+}
+
 
 /*
  * ANON_STDDEV functions.
@@ -287,10 +807,40 @@ Datum anon_stddev_with_bounds_accum(PG_FUNCTION_ARGS) {
   return bounded_accum<DpStandardDeviation>(fcinfo, true, false);
 }
 
+Datum anon_stddev_accum_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpStandardDeviation>(fcinfo, false, false,
+                                            /*is_array=*/true);
+}
+
+Datum anon_stddev_with_bounds_accum_array(PG_FUNCTION_ARGS) {
+  return bounded_accum<DpStandardDeviation>(fcinfo, true, false,
+                                            /*is_array=*/true);
+}
+
 Datum anon_stddev_extract(PG_FUNCTION_ARGS) {
   return double_extract<DpStandardDeviation>(fcinfo);
 }
 
+Datum anon_stddev_combine(PG_FUNCTION_ARGS) {
+  return combine<DpStandardDeviation>(fcinfo);
+}
+
+Datum anon_stddev_serialize(PG_FUNCTION_ARGS) {
+  return serialize<DpStandardDeviation>(fcinfo);
+}
+
+Datum anon_stddev_deserialize(PG_FUNCTION_ARGS) {
+  return deserialize<DpStandardDeviation>(fcinfo);
+}
+
+Datum anon_stddev_with_bounds_remove(PG_FUNCTION_ARGS) {
+  return bounded_remove<DpStandardDeviation>(fcinfo, false);
+}
+
+Datum anon_stddev_frame_extract(PG_FUNCTION_ARGS) {
+  return double_frame_extract<DpStandardDeviation>(fcinfo);
+}
+
 
 
 /*
@@ -307,13 +857,14 @@ Datum ntile_accum(PG_FUNCTION_ARGS, bool is_integral) {
     float8 lower = PG_GETARG_FLOAT8(3);
     float8 upper = PG_GETARG_FLOAT8(4);
     std::string err;
-    if (PG_NARGS() > 5) {
-      float8 epsilon = PG_GETARG_FLOAT8(5);
-      arg0 = new DpNtile(&err, percentile, lower, upper,
-                         /*default_epsilon=*/false, epsilon);
-    } else {
-      arg0 = new DpNtile(&err, percentile, lower, upper);
-    }
+    arg0 = new_state<DpNtile>(fcinfo, [&]() {
+      if (PG_NARGS() > 5) {
+        float8 epsilon = PG_GETARG_FLOAT8(5);
+        return new DpNtile(&err, percentile, lower, upper,
+                           /*default_epsilon=*/false, epsilon);
+      }
+      return new DpNtile(&err, percentile, lower, upper);
+    });
     if (!err.empty()) {
       ereport(ERROR,
               (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("%s", err.c_str())));
@@ -342,3 +893,32 @@ Datum anon_ntile_extract_double(PG_FUNCTION_ARGS) {
 Datum anon_ntile_extract_int(PG_FUNCTION_ARGS) {
   return int_extract<DpNtile>(fcinfo);
 }
+
+Datum anon_ntile_combine(PG_FUNCTION_ARGS) {
+  return combine<DpNtile>(fcinfo);
+}
+
+Datum anon_ntile_serialize(PG_FUNCTION_ARGS) {
+  return serialize<DpNtile>(fcinfo);
+}
+
+Datum anon_ntile_deserialize(PG_FUNCTION_ARGS) {
+  return deserialize<DpNtile>(fcinfo);
+}
+
+/*
+ * Privacy budget functions.
+ */
+
+Datum anon_epsilon_spent(PG_FUNCTION_ARGS) {
+  PG_RETURN_FLOAT8(ledger.Spent(GetUserId()));
+}
+
+Datum anon_reset_epsilon_spent(PG_FUNCTION_ARGS) {
+  if (!superuser()) {
+    ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+                    errmsg("Only superusers can reset privacy budgets.")));
+  }
+  ledger.Reset(PG_GETARG_OID(0));
+  PG_RETURN_VOID();
+}
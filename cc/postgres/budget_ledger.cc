@@ -0,0 +1,92 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "budget_ledger.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<double>::is_always_lock_free,
+              "Shared memory requires address-free atomics");
+
+size_t BudgetLedger::Size(int num_slots) { return num_slots * sizeof(Slot); }
+
+BudgetLedger::BudgetLedger(void* memory, int num_slots)
+    : slots_(static_cast<Slot*>(memory)), num_slots_(num_slots) {}
+
+bool BudgetLedger::Charge(uint64_t analyst, double epsilon, double budget,
+                          std::string* err) {
+  Slot* slot = FindSlot(analyst, /*insert=*/true);
+  if (slot == nullptr) {
+    *err = absl::StrCat("The privacy budget ledger has no free slot for ",
+                        num_slots_, " analysts.");
+    return false;
+  }
+  double spent = slot->spent.load();
+  do {
+    if (spent + epsilon > budget) {
+      *err = absl::StrCat("Privacy budget exceeded: ", spent, " of ", budget,
+                          " epsilon spent, but ", epsilon, " more requested.");
+      return false;
+    }
+  } while (!slot->spent.compare_exchange_weak(spent, spent + epsilon));
+  return true;
+}
+
+double BudgetLedger::Spent(uint64_t analyst) const {
+  const Slot* slot = FindSlot(analyst, /*insert=*/false);
+  return slot == nullptr ? 0 : slot->spent.load();
+}
+
+void BudgetLedger::Reset(uint64_t analyst) {
+  Slot* slot = FindSlot(analyst, /*insert=*/false);
+  if (slot != nullptr) {
+    slot->spent.store(0);
+  }
+}
+
+BudgetLedger::Slot* BudgetLedger::FindSlot(uint64_t analyst,
+                                           bool insert) const {
+  if (slots_ == nullptr || num_slots_ == 0) {
+    return nullptr;
+  }
+  const uint64_t key = analyst + 1;
+  // Fibonacci hashing spreads consecutive ids, like role OIDs.
+  const size_t start = (key * 0x9E3779B97F4A7C15ull) % num_slots_;
+  for (int i = 0; i < num_slots_; ++i) {
+    Slot& slot = slots_[(start + i) % num_slots_];
+    uint64_t slot_key = slot.key.load();
+    if (slot_key == key) {
+      return &slot;
+    }
+    if (slot_key == 0) {
+      if (!insert) {
+        return nullptr;
+      }
+      // Claim the free slot, unless another process just claimed it, maybe
+      // for the same analyst.
+      if (slot.key.compare_exchange_strong(slot_key, key) || slot_key == key) {
+        return &slot;
+      }
+    }
+  }
+  return nullptr;
+}
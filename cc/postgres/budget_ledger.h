@@ -0,0 +1,81 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef THIRD_PARTY_DIFFERENTIAL_PRIVACY_POSTGRES_BUDGET_LEDGER_H
+#define THIRD_PARTY_DIFFERENTIAL_PRIVACY_POSTGRES_BUDGET_LEDGER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Epsilon spent so far by every analyst, e.g., by every role of a server, kept
+// in memory that all backends share. Charges of concurrent queries are
+// admitted or rejected with atomic compare-and-swap on the slot of their
+// analyst, without a lock or a table that every query would have to update.
+//
+// The spent epsilon is the sum of the charged epsilons, i.e., the ledger uses
+// basic composition, which is tight for the pure epsilon-DP functions of the
+// extension.
+//
+// Analysts are kept in a fixed number of slots, found by open addressing, and
+// are never evicted. Copies of a ledger refer to the same memory.
+class BudgetLedger {
+ public:
+  // Returns the number of bytes of the memory of a ledger with num_slots
+  // slots.
+  static size_t Size(int num_slots);
+
+  // A ledger without memory, which is not attached.
+  BudgetLedger() = default;
+
+  // A ledger in memory of Size(num_slots) bytes, which must have been zeroed
+  // before its first use, e.g., a new shared memory segment. Ledgers over the
+  // same memory share their state, also across processes.
+  BudgetLedger(void* memory, int num_slots);
+
+  bool attached() const { return slots_ != nullptr; }
+
+  // Adds epsilon to the epsilon spent by analyst if the total stays at most
+  // budget. Returns true if the charge is admitted. Otherwise, e.g., if the
+  // ledger has no free slot for a new analyst, the error std::string is
+  // populated and nothing is charged. Concurrent charges never exceed the
+  // budget together.
+  bool Charge(uint64_t analyst, double epsilon, double budget,
+              std::string* err);
+
+  // Returns the epsilon spent by analyst so far.
+  double Spent(uint64_t analyst) const;
+
+  // Sets the epsilon spent by analyst back to zero.
+  void Reset(uint64_t analyst);
+
+ private:
+  struct Slot {
+    // Analyst plus one, or zero if the slot is free.
+    std::atomic<uint64_t> key;
+    std::atomic<double> spent;
+  };
+
+  // Returns the slot of analyst. If the analyst has no slot, claims a free one
+  // if insert is true, and returns nullptr otherwise or if none is free.
+  Slot* FindSlot(uint64_t analyst, bool insert) const;
+
+  Slot* slots_ = nullptr;
+  int num_slots_ = 0;
+};
+
+#endif  // THIRD_PARTY_DIFFERENTIAL_PRIVACY_POSTGRES_BUDGET_LEDGER_H
@@ -0,0 +1,113 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "postgres/budget_ledger.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using ::testing::HasSubstr;
+
+// Zeroed memory for a ledger with num_slots slots.
+std::vector<char> LedgerMemory(int num_slots) {
+  return std::vector<char>(BudgetLedger::Size(num_slots) + alignof(double), 0);
+}
+
+void* Aligned(std::vector<char>& memory) {
+  void* ptr = memory.data();
+  size_t space = memory.size();
+  return std::align(alignof(double), 1, ptr, space);
+}
+
+TEST(BudgetLedger, ChargesWithinBudget) {
+  std::vector<char> memory = LedgerMemory(8);
+  BudgetLedger ledger(Aligned(memory), 8);
+  std::string err;
+  EXPECT_TRUE(ledger.Charge(10, 0.5, 1, &err));
+  EXPECT_TRUE(ledger.Charge(10, 0.5, 1, &err));
+  EXPECT_TRUE(err.empty());
+  EXPECT_FALSE(ledger.Charge(10, 0.25, 1, &err));
+  EXPECT_THAT(err, HasSubstr("Privacy budget exceeded"));
+  EXPECT_EQ(ledger.Spent(10), 1);
+
+  // Analysts have separate budgets.
+  err.clear();
+  EXPECT_TRUE(ledger.Charge(11, 1, 1, &err));
+  EXPECT_EQ(ledger.Spent(12), 0);
+
+  ledger.Reset(10);
+  EXPECT_EQ(ledger.Spent(10), 0);
+  EXPECT_TRUE(ledger.Charge(10, 1, 1, &err));
+}
+
+TEST(BudgetLedger, CopiesShareMemory) {
+  std::vector<char> memory = LedgerMemory(8);
+  BudgetLedger ledger(Aligned(memory), 8);
+  BudgetLedger other = ledger;
+  std::string err;
+  EXPECT_TRUE(other.Charge(0, 2, std::numeric_limits<double>::infinity(),
+                           &err));
+  EXPECT_EQ(ledger.Spent(0), 2);
+  EXPECT_FALSE(BudgetLedger().attached());
+}
+
+TEST(BudgetLedger, FullLedgerRejectsNewAnalysts) {
+  std::vector<char> memory = LedgerMemory(2);
+  BudgetLedger ledger(Aligned(memory), 2);
+  std::string err;
+  EXPECT_TRUE(ledger.Charge(1, 1, 10, &err));
+  EXPECT_TRUE(ledger.Charge(2, 1, 10, &err));
+  EXPECT_FALSE(ledger.Charge(3, 1, 10, &err));
+  EXPECT_THAT(err, HasSubstr("no free slot"));
+  EXPECT_TRUE(ledger.Charge(1, 1, 10, &err));
+}
+
+TEST(BudgetLedger, ConcurrentChargesDoNotExceedBudget) {
+  std::vector<char> memory = LedgerMemory(16);
+  BudgetLedger ledger(Aligned(memory), 16);
+  std::vector<std::thread> threads;
+  std::vector<int> admitted(8, 0);
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&ledger, &admitted, t]() {
+      std::string err;
+      for (int i = 0; i < 1000; ++i) {
+        admitted[t] += ledger.Charge(/*analyst=*/i % 4, 1, 500, &err);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  int total = 0;
+  for (int count : admitted) {
+    total += count;
+  }
+  EXPECT_EQ(total, 4 * 500);
+  for (uint64_t analyst = 0; analyst < 4; ++analyst) {
+    EXPECT_EQ(ledger.Spent(analyst), 500);
+  }
+}
+
+}  // namespace
@@ -16,29 +16,77 @@
 
 #include "dp_func.h"
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#include "absl/types/span.h"
 #include "algorithms/algorithm.h"
 #include "algorithms/bounded-mean.h"
 #include "algorithms/bounded-standard-deviation.h"
 #include "algorithms/bounded-sum.h"
 #include "algorithms/bounded-variance.h"
 #include "algorithms/count.h"
-#include "algorithms/order-statistics.h"
+#include "algorithms/quantiles.h"
+#include "proto/data.pb.h"
+#include "proto/summary.pb.h"
+#include "proto/util.h"
 using differential_privacy::Algorithm;
 using differential_privacy::BoundedMean;
+using differential_privacy::BoundedMeanSummary;
 using differential_privacy::BoundedStandardDeviation;
 using differential_privacy::BoundedSum;
+using differential_privacy::BoundedSumSummary;
 using differential_privacy::BoundedVariance;
+using differential_privacy::BoundedVarianceSummary;
 using differential_privacy::Count;
+using differential_privacy::CountSummary;
 using differential_privacy::GetValue;
-using differential_privacy::continuous::Percentile;
+using differential_privacy::Quantiles;
+using differential_privacy::SetValue;
+using differential_privacy::Summary;
+using differential_privacy::ValueType;
+
+// Allocation functions for DP functions.
+void* (*dp_func_allocate)(size_t size) = nullptr;
+void (*dp_func_deallocate)(void* ptr) = nullptr;
+
+void SetDpFuncAllocator(void* (*allocate)(size_t size),
+                        void (*deallocate)(void* ptr)) {
+  dp_func_allocate = allocate;
+  dp_func_deallocate = deallocate;
+}
+
+void* DpFunc::operator new(size_t size) {
+  if (dp_func_allocate) {
+    return dp_func_allocate(size);
+  }
+  return ::operator new(size);
+}
+
+void DpFunc::operator delete(void* ptr) {
+  if (dp_func_deallocate) {
+    dp_func_deallocate(ptr);
+  } else {
+    ::operator delete(ptr);
+  }
+}
+
+// Return the epsilon that algorithms are constructed with.
+double EpsilonOrDefault(bool default_epsilon, double epsilon) {
+  return default_epsilon ? std::log(3) : epsilon;
+}
 
 // Construct and return a bounded algorithm. Populate error if unsuccessful.
 template <typename Alg>
 Alg* BoundedAlgorithm(std::string* err, bool default_epsilon, double epsilon,
                       bool auto_bounds, double lower, double upper) {
-  if (default_epsilon) {
-    epsilon = std::log(3);
-  }
+  epsilon = EpsilonOrDefault(default_epsilon, epsilon);
   typename Alg::Builder builder;
   if (!auto_bounds) {
     builder.SetLower(lower).SetUpper(upper);
@@ -59,128 +107,572 @@ void DeleteAlgorithm(Alg* alg) {
   }
 }
 
-// Add an entry to the algorithm. Return true if the algorithm exists.
-bool AlgorithmAddEntry(Algorithm<double>* alg, double entry) {
-  if (alg) {
-    alg->AddEntry(entry);
-    return true;
-  }
-  return false;
-}
+// Maximum number of buffered entries of a DP function. Small, since every
+// group of an aggregation has its own function.
+constexpr size_t kMaxBufferedEntries = 64;
 
-// Return the result of return_type from the algorithm, populating error if
+// Return the result of value_type from the algorithm, populating error if
 // unsuccessful.
-template <typename return_type>
-double AlgorithmResult(Algorithm<double>* alg, std::string* err) {
-  double default_return = 0.0;
+template <typename value_type, typename T>
+value_type AlgorithmResult(Algorithm<T>* alg, std::string* err) {
+  value_type default_return = 0;
   if (!alg) {
     *err = "Underlying algorithm was never constructed.";
     return default_return;
   }
   auto result_statusor = alg->PartialResult();
   if (result_statusor.ok()) {
-    return static_cast<double>(GetValue<return_type>(result_statusor.value()));
+    return GetValue<value_type>(result_statusor.value());
   } else {
     *err = std::string(result_statusor.status().message());
   }
   return default_return;
 }
 
+// Convert an entry to the entry type T of an algorithm. Return false if the
+// entry has no value of type T, i.e., if it is NaN and T is integral, in which
+// case it is skipped like algorithms skip NaN entries.
+template <typename T>
+bool ConvertEntry(double entry, T* converted) {
+  if constexpr (std::is_integral_v<T>) {
+    if (std::isnan(entry)) {
+      return false;
+    }
+    constexpr double kMax = static_cast<double>(std::numeric_limits<T>::max());
+    constexpr double kMin = static_cast<double>(std::numeric_limits<T>::min());
+    if (entry >= kMax) {
+      *converted = std::numeric_limits<T>::max();
+    } else if (entry <= kMin) {
+      *converted = std::numeric_limits<T>::min();
+    } else {
+      *converted = std::llround(entry);
+    }
+  } else {
+    *converted = entry;
+  }
+  return true;
+}
+
+template <typename T>
+bool ConvertEntry(int64_t entry, T* converted) {
+  *converted = static_cast<T>(entry);
+  return true;
+}
+
+// Append the bytes of a value to a state.
+template <typename T>
+void AppendToState(const T& value, std::string* state) {
+  state->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Read a value at the offset of a state and advance the offset past it.
+// Return false if the state is too short.
+template <typename T>
+bool ReadFromState(const std::string& state, size_t* offset, T* value) {
+  if (state.size() - *offset < sizeof(T)) {
+    return false;
+  }
+  std::memcpy(value, state.data() + *offset, sizeof(T));
+  *offset += sizeof(T);
+  return true;
+}
+
+// Construct a function from the parameters of a state.
+template <typename DpFunction>
+DpFunction* NewDpFunc(std::string* err, const DpFunc::Params& params) {
+  return new DpFunction(err, /*default_epsilon=*/false, params.epsilon,
+                        params.auto_bounds, params.lower, params.upper);
+}
+
+template <>
+DpCount* NewDpFunc<DpCount>(std::string* err, const DpFunc::Params& params) {
+  return new DpCount(err, /*default_epsilon=*/false, params.epsilon);
+}
+
+template <>
+DpNtile* NewDpFunc<DpNtile>(std::string* err, const DpFunc::Params& params) {
+  return new DpNtile(err, params.percentile, params.lower, params.upper,
+                     /*default_epsilon=*/false, params.epsilon);
+}
+
+// Negate the values of type T of a repeated ValueType field of a summary.
+// Integers are negated with wraparound, like the algorithms add them.
+template <typename T>
+void NegateValues(google::protobuf::RepeatedPtrField<ValueType>* values) {
+  for (ValueType& value : *values) {
+    if constexpr (std::is_integral_v<T>) {
+      SetValue<T>(&value, static_cast<T>(-static_cast<uint64_t>(
+                              GetValue<T>(value))));
+    } else {
+      SetValue<T>(&value, -GetValue<T>(value));
+    }
+  }
+}
+
+// Negate the contributions of entries of type T to the summary of a count or
+// of a bounded algorithm with manual bounds, so that merging the summary
+// removes the entries. Return false for summaries of other algorithms, which
+// are not plain sums of contributions.
+template <typename T>
+bool NegateSummary(Summary* summary) {
+  if (summary->data().Is<CountSummary>()) {
+    CountSummary count_summary;
+    summary->data().UnpackTo(&count_summary);
+    count_summary.set_count(-count_summary.count());
+    summary->mutable_data()->PackFrom(count_summary);
+    return true;
+  }
+  if (summary->data().Is<BoundedSumSummary>()) {
+    BoundedSumSummary sum_summary;
+    summary->data().UnpackTo(&sum_summary);
+    if (sum_summary.has_bounds_summary()) {
+      return false;
+    }
+    NegateValues<T>(sum_summary.mutable_pos_sum());
+    summary->mutable_data()->PackFrom(sum_summary);
+    return true;
+  }
+  if (summary->data().Is<BoundedMeanSummary>()) {
+    BoundedMeanSummary mean_summary;
+    summary->data().UnpackTo(&mean_summary);
+    if (mean_summary.has_bounds_summary()) {
+      return false;
+    }
+    mean_summary.set_count(-mean_summary.count());
+    NegateValues<double>(mean_summary.mutable_pos_sum());
+    summary->mutable_data()->PackFrom(mean_summary);
+    return true;
+  }
+  if (summary->data().Is<BoundedVarianceSummary>()) {
+    BoundedVarianceSummary variance_summary;
+    summary->data().UnpackTo(&variance_summary);
+    if (variance_summary.has_bounds_summary()) {
+      return false;
+    }
+    variance_summary.set_count(-variance_summary.count());
+    NegateValues<double>(variance_summary.mutable_pos_sum());
+    for (double& sum_of_squares :
+         *variance_summary.mutable_pos_sum_of_squares()) {
+      sum_of_squares = -sum_of_squares;
+    }
+    summary->mutable_data()->PackFrom(variance_summary);
+    return true;
+  }
+  return false;
+}
+
+// DP function entries.
+template <typename T>
+bool TypedDpFunc<T>::BufferEntry(T entry) {
+  buffer_.push_back(entry);
+  if (buffer_.size() == kMaxBufferedEntries) {
+    FlushEntries();
+  }
+  return true;
+}
+
+template <typename T>
+bool TypedDpFunc<T>::AddEntry(double entry) {
+  if (!algorithm()) {
+    return false;
+  }
+  T converted;
+  return !ConvertEntry(entry, &converted) || BufferEntry(converted);
+}
+
+template <typename T>
+bool TypedDpFunc<T>::AddEntry(int64_t entry) {
+  if (!algorithm()) {
+    return false;
+  }
+  T converted;
+  return !ConvertEntry(entry, &converted) || BufferEntry(converted);
+}
+
+template <typename T>
+bool TypedDpFunc<T>::AddEntries(const double* entries, size_t size) {
+  if (!algorithm()) {
+    return false;
+  }
+  if constexpr (std::is_same_v<T, double>) {
+    FlushEntries();
+    algorithm()->AddEntries(absl::MakeConstSpan(entries, size));
+  } else {
+    for (size_t i = 0; i < size; ++i) {
+      AddEntry(entries[i]);
+    }
+  }
+  return true;
+}
+
+template <typename T>
+bool TypedDpFunc<T>::AddEntries(const int64_t* entries, size_t size) {
+  if (!algorithm()) {
+    return false;
+  }
+  if constexpr (std::is_same_v<T, int64_t>) {
+    FlushEntries();
+    algorithm()->AddEntries(absl::MakeConstSpan(entries, size));
+  } else {
+    for (size_t i = 0; i < size; ++i) {
+      AddEntry(entries[i]);
+    }
+  }
+  return true;
+}
+
+template <typename T>
+void TypedDpFunc<T>::FlushEntries() const {
+  if (!buffer_.empty()) {
+    algorithm()->AddEntries(absl::MakeConstSpan(buffer_));
+    buffer_.clear();
+  }
+}
+
+// DP function states.
+template <typename T>
+std::string TypedDpFunc<T>::Serialize(std::string* err) const {
+  if (!algorithm()) {
+    *err = "Underlying algorithm was never constructed.";
+    return "";
+  }
+  FlushEntries();
+  std::string state;
+  AppendToState(params_.epsilon, &state);
+  AppendToState(params_.auto_bounds, &state);
+  AppendToState(params_.lower, &state);
+  AppendToState(params_.upper, &state);
+  AppendToState(params_.percentile, &state);
+  state.append(algorithm()->Serialize().SerializeAsString());
+  return state;
+}
+
+template <typename T>
+bool TypedDpFunc<T>::Merge(const DpFunc& other, std::string* err) {
+  if (typeid(*this) != typeid(other)) {
+    *err = "Cannot merge dp functions of different types or parameters.";
+    return false;
+  }
+  const TypedDpFunc<T>& typed_other = static_cast<const TypedDpFunc<T>&>(other);
+  if (params_.epsilon != typed_other.params_.epsilon ||
+      params_.auto_bounds != typed_other.params_.auto_bounds ||
+      params_.lower != typed_other.params_.lower ||
+      params_.upper != typed_other.params_.upper ||
+      params_.percentile != typed_other.params_.percentile) {
+    *err = "Cannot merge dp functions of different types or parameters.";
+    return false;
+  }
+  if (!algorithm() || !typed_other.algorithm()) {
+    *err = "Underlying algorithm was never constructed.";
+    return false;
+  }
+  FlushEntries();
+  typed_other.FlushEntries();
+  absl::Status status = algorithm()->MergeFrom(*typed_other.algorithm());
+  if (!status.ok()) {
+    *err = std::string(status.message());
+    return false;
+  }
+  return true;
+}
+
+template <typename T>
+TypedDpFunc<T>* TypedDpFunc<T>::Scratch(std::string* err) {
+  if (!scratch_) {
+    std::unique_ptr<TypedDpFunc<T>> scratch(NewEmpty(err));
+    if (!err->empty()) {
+      return nullptr;
+    }
+    scratch_ = std::move(scratch);
+  }
+  return scratch_.get();
+}
+
+template <typename T>
+bool TypedDpFunc<T>::RemoveEntry(double entry, std::string* err) {
+  T converted;
+  return !ConvertEntry(entry, &converted) || RemoveTypedEntry(converted, err);
+}
+
+template <typename T>
+bool TypedDpFunc<T>::RemoveEntry(int64_t entry, std::string* err) {
+  T converted;
+  return !ConvertEntry(entry, &converted) || RemoveTypedEntry(converted, err);
+}
+
+template <typename T>
+bool TypedDpFunc<T>::RemoveTypedEntry(T entry, std::string* err) {
+  if (!algorithm()) {
+    *err = "Underlying algorithm was never constructed.";
+    return false;
+  }
+  TypedDpFunc<T>* scratch = Scratch(err);
+  if (!scratch) {
+    return false;
+  }
+  FlushEntries();
+  // Merging the negated summary of the entry alone subtracts its contribution.
+  scratch->algorithm()->Reset();
+  scratch->algorithm()->AddEntry(entry);
+  Summary summary = scratch->algorithm()->Serialize();
+  if (!NegateSummary<T>(&summary)) {
+    *err = "Removing entries is only supported by count and by functions with "
+            "manual bounds.";
+    return false;
+  }
+  absl::Status status = algorithm()->Merge(summary);
+  if (!status.ok()) {
+    *err = std::string(status.message());
+    return false;
+  }
+  return true;
+}
+
+template <typename T>
+double TypedDpFunc<T>::FrameResult(std::string* err) {
+  TypedDpFunc<T>* scratch = FrameScratch(err);
+  return scratch ? scratch->Result(err) : 0;
+}
+
+template <typename T>
+int64_t TypedDpFunc<T>::FrameResultRounded(std::string* err) {
+  TypedDpFunc<T>* scratch = FrameScratch(err);
+  return scratch ? scratch->ResultRounded(err) : 0;
+}
+
+template <typename T>
+TypedDpFunc<T>* TypedDpFunc<T>::FrameScratch(std::string* err) {
+  if (!algorithm()) {
+    *err = "Underlying algorithm was never constructed.";
+    return nullptr;
+  }
+  TypedDpFunc<T>* scratch = Scratch(err);
+  if (!scratch) {
+    return nullptr;
+  }
+  // The scratch function releases a copy of the entries, so that the entries
+  // themselves can be changed and released again.
+  FlushEntries();
+  scratch->algorithm()->Reset();
+  absl::Status status = scratch->algorithm()->MergeFrom(*algorithm());
+  if (!status.ok()) {
+    *err = std::string(status.message());
+    return nullptr;
+  }
+  return scratch;
+}
+
+template <typename T>
+int64_t TypedDpFunc<T>::MemoryUsed() {
+  // Every function holds one algorithm pointer in addition to the base.
+  int64_t memory = sizeof(TypedDpFunc<T>) + sizeof(Algorithm<T>*) +
+                   buffer_.capacity() * sizeof(T);
+  if (algorithm()) {
+    memory += algorithm()->MemoryUsed();
+  }
+  return memory;
+}
+
+template <typename T>
+bool TypedDpFunc<T>::MergeSummary(const std::string& summary,
+                                  std::string* err) {
+  Summary summary_proto;
+  if (!summary_proto.ParseFromString(summary)) {
+    *err = "Malformed state of dp function.";
+    return false;
+  }
+  if (!algorithm()) {
+    *err = "Underlying algorithm was never constructed.";
+    return false;
+  }
+  absl::Status status = algorithm()->Merge(summary_proto);
+  if (!status.ok()) {
+    *err = std::string(status.message());
+    return false;
+  }
+  return true;
+}
+
+template class TypedDpFunc<double>;
+template class TypedDpFunc<int64_t>;
+
+template <typename DpFunction>
+DpFunction* DeserializeDpFunc(const std::string& state, std::string* err) {
+  DpFunc::Params params;
+  size_t offset = 0;
+  if (!ReadFromState(state, &offset, &params.epsilon) ||
+      !ReadFromState(state, &offset, &params.auto_bounds) ||
+      !ReadFromState(state, &offset, &params.lower) ||
+      !ReadFromState(state, &offset, &params.upper) ||
+      !ReadFromState(state, &offset, &params.percentile)) {
+    *err = "Malformed state of dp function.";
+    return nullptr;
+  }
+  DpFunction* func = NewDpFunc<DpFunction>(err, params);
+  // MergeSummary is accessible through the base class, which befriends us.
+  DpFunc* base = func;
+  if (!err->empty() || !base->MergeSummary(state.substr(offset), err)) {
+    delete func;
+    return nullptr;
+  }
+  return func;
+}
+
+template DpCount* DeserializeDpFunc<DpCount>(const std::string&, std::string*);
+template DpSum* DeserializeDpFunc<DpSum>(const std::string&, std::string*);
+template DpIntSum* DeserializeDpFunc<DpIntSum>(const std::string&,
+                                               std::string*);
+template DpMean* DeserializeDpFunc<DpMean>(const std::string&, std::string*);
+template DpVariance* DeserializeDpFunc<DpVariance>(const std::string&,
+                                                   std::string*);
+template DpStandardDeviation* DeserializeDpFunc<DpStandardDeviation>(
+    const std::string&, std::string*);
+template DpNtile* DeserializeDpFunc<DpNtile>(const std::string&, std::string*);
+
 // DP count.
 DpCount::DpCount(std::string* err, bool default_epsilon, double epsilon) {
-  if (default_epsilon) {
-    epsilon = std::log(3);
-  }
-  auto count_statusor = Count<double>::Builder().SetEpsilon(epsilon).Build();
+  epsilon = EpsilonOrDefault(default_epsilon, epsilon);
+  params_.epsilon = epsilon;
+  auto count_statusor = Count<int64_t>::Builder().SetEpsilon(epsilon).Build();
   if (count_statusor.ok()) {
     count_ = count_statusor.value().release();
   } else {
     *err = std::string(count_statusor.status().message());
   }
 }
-DpCount::~DpCount() { DeleteAlgorithm<Count<double>>(count_); }
-bool DpCount::AddEntry(double entry) {
-  return AlgorithmAddEntry(count_, entry);
-}
-double DpCount::Result(std::string* err) {
+DpCount::~DpCount() { DeleteAlgorithm<Count<int64_t>>(count_); }
+double DpCount::Result(std::string* err) { return ResultRounded(err); }
+int64_t DpCount::ResultRounded(std::string* err) {
+  FlushEntries();
   return AlgorithmResult<int64_t>(count_, err);
 }
+Algorithm<int64_t>* DpCount::algorithm() const { return count_; }
+TypedDpFunc<int64_t>* DpCount::NewEmpty(std::string* err) const {
+  return NewDpFunc<DpCount>(err, params_);
+}
 
 // DP sum.
 DpSum::DpSum(std::string* err, bool default_epsilon, double epsilon,
              bool auto_bounds, double lower, double upper) {
+  params_ = {EpsilonOrDefault(default_epsilon, epsilon), auto_bounds, lower,
+             upper};
   sum_ = BoundedAlgorithm<BoundedSum<double>>(err, default_epsilon, epsilon,
                                               auto_bounds, lower, upper);
 }
 DpSum::~DpSum() { DeleteAlgorithm<BoundedSum<double>>(sum_); }
-bool DpSum::AddEntry(double entry) { return AlgorithmAddEntry(sum_, entry); }
 double DpSum::Result(std::string* err) {
+  FlushEntries();
   return AlgorithmResult<double>(sum_, err);
 }
+Algorithm<double>* DpSum::algorithm() const { return sum_; }
+TypedDpFunc<double>* DpSum::NewEmpty(std::string* err) const {
+  return NewDpFunc<DpSum>(err, params_);
+}
+
+// DP integer sum.
+DpIntSum::DpIntSum(std::string* err, bool default_epsilon, double epsilon,
+                   bool auto_bounds, double lower, double upper) {
+  params_ = {EpsilonOrDefault(default_epsilon, epsilon), auto_bounds, lower,
+             upper};
+  // Entries are integers, so rounding the bounds inwards clamps them the same.
+  int64_t int_lower;
+  int64_t int_upper;
+  ConvertEntry(std::ceil(lower), &int_lower);
+  ConvertEntry(std::floor(upper), &int_upper);
+  sum_ = BoundedAlgorithm<BoundedSum<int64_t>>(
+      err, default_epsilon, epsilon, auto_bounds, int_lower, int_upper);
+}
+DpIntSum::~DpIntSum() { DeleteAlgorithm<BoundedSum<int64_t>>(sum_); }
+double DpIntSum::Result(std::string* err) { return ResultRounded(err); }
+int64_t DpIntSum::ResultRounded(std::string* err) {
+  FlushEntries();
+  return AlgorithmResult<int64_t>(sum_, err);
+}
+Algorithm<int64_t>* DpIntSum::algorithm() const { return sum_; }
+TypedDpFunc<int64_t>* DpIntSum::NewEmpty(std::string* err) const {
+  return NewDpFunc<DpIntSum>(err, params_);
+}
 
 // DP mean.
 DpMean::DpMean(std::string* err, bool default_epsilon, double epsilon,
                bool auto_bounds, double lower, double upper) {
+  params_ = {EpsilonOrDefault(default_epsilon, epsilon), auto_bounds, lower,
+             upper};
   mean_ = BoundedAlgorithm<BoundedMean<double>>(err, default_epsilon, epsilon,
                                                 auto_bounds, lower, upper);
 }
 DpMean::~DpMean() { DeleteAlgorithm<BoundedMean<double>>(mean_); }
-bool DpMean::AddEntry(double entry) { return AlgorithmAddEntry(mean_, entry); }
 double DpMean::Result(std::string* err) {
+  FlushEntries();
   return AlgorithmResult<double>(mean_, err);
 }
+Algorithm<double>* DpMean::algorithm() const { return mean_; }
+TypedDpFunc<double>* DpMean::NewEmpty(std::string* err) const {
+  return NewDpFunc<DpMean>(err, params_);
+}
 
 // DP variance.
 DpVariance::DpVariance(std::string* err, bool default_epsilon, double epsilon,
                        bool auto_bounds, double lower, double upper) {
+  params_ = {EpsilonOrDefault(default_epsilon, epsilon), auto_bounds, lower,
+             upper};
   var_ = BoundedAlgorithm<BoundedVariance<double>>(
       err, default_epsilon, epsilon, auto_bounds, lower, upper);
 }
 DpVariance::~DpVariance() { DeleteAlgorithm<BoundedVariance<double>>(var_); }
-bool DpVariance::AddEntry(double entry) {
-  return AlgorithmAddEntry(var_, entry);
-}
 double DpVariance::Result(std::string* err) {
+  FlushEntries();
   return AlgorithmResult<double>(var_, err);
 }
+Algorithm<double>* DpVariance::algorithm() const { return var_; }
+TypedDpFunc<double>* DpVariance::NewEmpty(std::string* err) const {
+  return NewDpFunc<DpVariance>(err, params_);
+}
 
 // DP standard deviation.
 DpStandardDeviation::DpStandardDeviation(std::string* err, bool default_epsilon,
                                          double epsilon, bool auto_bounds,
                                          double lower, double upper) {
+  params_ = {EpsilonOrDefault(default_epsilon, epsilon), auto_bounds, lower,
+             upper};
   sd_ = BoundedAlgorithm<BoundedStandardDeviation<double>>(
       err, default_epsilon, epsilon, auto_bounds, lower, upper);
 }
 DpStandardDeviation::~DpStandardDeviation() {
   DeleteAlgorithm<BoundedStandardDeviation<double>>(sd_);
 }
-bool DpStandardDeviation::AddEntry(double entry) {
-  return AlgorithmAddEntry(sd_, entry);
-}
 double DpStandardDeviation::Result(std::string* err) {
+  FlushEntries();
   return AlgorithmResult<double>(sd_, err);
 }
+Algorithm<double>* DpStandardDeviation::algorithm() const { return sd_; }
+TypedDpFunc<double>* DpStandardDeviation::NewEmpty(std::string* err) const {
+  return NewDpFunc<DpStandardDeviation>(err, params_);
+}
 
 // DP Ntile.
 DpNtile::DpNtile(std::string* err, double percentile, double lower,
                  double upper, bool default_epsilon, double epsilon) {
-  if (default_epsilon) {
-    epsilon = std::log(3);
-  }
-  auto build_statusor = Percentile<double>::Builder()
-                            .SetPercentile(percentile)
+  epsilon = EpsilonOrDefault(default_epsilon, epsilon);
+  params_ = {epsilon, /*auto_bounds=*/false, lower, upper, percentile};
+  auto build_statusor = Quantiles<double>::Builder()
+                            .SetQuantiles({percentile})
                             .SetEpsilon(epsilon)
                             .SetLower(lower)
                             .SetUpper(upper)
                             .Build();
   if (build_statusor.ok()) {
-    perc_ = build_statusor.value().release();
+    quantiles_ = build_statusor.value().release();
   } else {
     *err = std::string(build_statusor.status().message());
   }
 }
-DpNtile::~DpNtile() { DeleteAlgorithm<Percentile<double>>(perc_); }
-bool DpNtile::AddEntry(double entry) { return AlgorithmAddEntry(perc_, entry); }
+DpNtile::~DpNtile() { DeleteAlgorithm<Quantiles<double>>(quantiles_); }
 double DpNtile::Result(std::string* err) {
-  return AlgorithmResult<double>(perc_, err);
+  FlushEntries();
+  return AlgorithmResult<double>(quantiles_, err);
+}
+Algorithm<double>* DpNtile::algorithm() const { return quantiles_; }
+TypedDpFunc<double>* DpNtile::NewEmpty(std::string* err) const {
+  return NewDpFunc<DpNtile>(err, params_);
 }
@@ -20,17 +20,23 @@
 #include <inttypes.h>
 
 #include <cmath>
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 // Forward declare classes from the differential privacy library. We cannot
 // include these directly into anon_func.cc.
 namespace differential_privacy {
 
 template <typename T>
-class Count;
+class Algorithm;
 
 template <typename T>
+class Count;
+
+template <typename T, typename Accumulator>
 class BoundedSum;
 
 template <typename T>
@@ -42,105 +48,280 @@ class BoundedVariance;
 template <typename T>
 class BoundedStandardDeviation;
 
-namespace continuous {
-
 template <typename T>
-class Percentile;
+class Quantiles;
 
-}
 }  // namespace differential_privacy
 
+// Allocation functions for DP functions. By default, DP functions are allocated
+// with the global operator new. The postgres extension replaces them with
+// palloc and pfree, so that functions live in the aggregate memory context.
+// Must be set before any DP function is constructed.
+void SetDpFuncAllocator(void* (*allocate)(size_t size),
+                        void (*deallocate)(void* ptr));
+
 // DP functions. Owns an underlying DP algorithm. This wrapping layer is
 // neccesary so that C++ dependencies don't conflict with postgres dependencies.
 class DpFunc {
  public:
+  // Allocates and deallocates with the functions set by SetDpFuncAllocator.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
+  // Parameters the function was constructed with. They are part of the state,
+  // so that a function can be reconstructed from its state alone.
+  struct Params {
+    double epsilon = 0;
+    bool auto_bounds = true;
+    double lower = 0;
+    double upper = 0;
+    double percentile = 0;
+  };
+
   virtual ~DpFunc() = default;
 
-  // Returns true if adding the entry is successful.
+  // Returns true if adding the entry is successful. Entries are converted to
+  // the entry type of the underlying algorithm, buffered, and added to the
+  // algorithm in batches, so that the batch paths of the algorithm are used
+  // and there is no virtual call per entry into the algorithm.
   virtual bool AddEntry(double entry) = 0;
-  bool AddEntry(int64_t entry) { return AddEntry(static_cast<double>(entry)); }
+  virtual bool AddEntry(int64_t entry) = 0;
+  bool AddEntry(int entry) { return AddEntry(static_cast<int64_t>(entry)); }
+
+  // Same as AddEntry for every one of the size entries.
+  virtual bool AddEntries(const double* entries, size_t size) = 0;
+  virtual bool AddEntries(const int64_t* entries, size_t size) = 0;
 
   // Result can only be called once per function. Iff grabbing the result fails,
   // the error std::string is populated and we return 0.
   virtual double Result(std::string* err) = 0;
 
   // Same as result, but the result is rounded to be an integer. Only Result or
-  // ResultRounded may be called per function.
-  int64_t ResultRounded(std::string* err) { return std::round(Result(err)); }
+  // ResultRounded may be called per function. Functions with integer results
+  // return them exactly.
+  virtual int64_t ResultRounded(std::string* err) = 0;
+
+  // Removes an entry that was added before, for the inverse transitions of
+  // moving aggregates. Supported by DpCount and by bounded functions with
+  // manual bounds, whose states are sums of the contributions of entries.
+  // Returns true if removing the entry is successful. Otherwise, the error
+  // std::string is populated.
+  virtual bool RemoveEntry(double entry, std::string* err) = 0;
+  virtual bool RemoveEntry(int64_t entry, std::string* err) = 0;
+  bool RemoveEntry(int entry, std::string* err) {
+    return RemoveEntry(static_cast<int64_t>(entry), err);
+  }
+
+  // Same as Result, but may be called whenever the entries change, e.g., once
+  // per window frame. Every call is a separate release of the current entries
+  // with the full epsilon of the function.
+  virtual double FrameResult(std::string* err) = 0;
+  virtual int64_t FrameResultRounded(std::string* err) = 0;
+
+  // Returns the state of the function, i.e., the parameters it was constructed
+  // with followed by the serialized summary of its algorithm, so that partial
+  // aggregates can be moved between processes. Iff serializing fails, the
+  // error std::string is populated and we return an empty state.
+  virtual std::string Serialize(std::string* err) const = 0;
+
+  // Merges the entries of another function of the same type and parameters
+  // into this one. Returns true if merging is successful. Otherwise, the error
+  // std::string is populated.
+  virtual bool Merge(const DpFunc& other, std::string* err) = 0;
+
+  // Returns the number of bytes used by the function, including the memory
+  // used by the underlying algorithm.
+  virtual int64_t MemoryUsed() = 0;
+
+  // Returns the epsilon that every release of a result consumes.
+  double GetEpsilon() const { return params_.epsilon; }
+
+ protected:
+  // Merges the summary part of a state into the underlying algorithm.
+  virtual bool MergeSummary(const std::string& summary, std::string* err) = 0;
+
+  Params params_;
+
+  template <typename DpFunction>
+  friend DpFunction* DeserializeDpFunc(const std::string& state,
+                                       std::string* err);
 };
 
-class DpCount : public DpFunc {
+// Reconstructs a function from a state returned by DpFunc::Serialize of a
+// function of the same type. Iff deserializing fails, the error std::string is
+// populated and we return nullptr.
+template <typename DpFunction>
+DpFunction* DeserializeDpFunc(const std::string& state, std::string* err);
+
+// Implementation of DP functions whose underlying algorithm takes entries of
+// type T. Instantiated for double and int64_t.
+template <typename T>
+class TypedDpFunc : public DpFunc {
+ public:
+  using DpFunc::AddEntry;
+  using DpFunc::RemoveEntry;
+
+  bool AddEntry(double entry) override;
+  bool AddEntry(int64_t entry) override;
+  bool AddEntries(const double* entries, size_t size) override;
+  bool AddEntries(const int64_t* entries, size_t size) override;
+  int64_t ResultRounded(std::string* err) override {
+    return std::round(Result(err));
+  }
+  bool RemoveEntry(double entry, std::string* err) override;
+  bool RemoveEntry(int64_t entry, std::string* err) override;
+  double FrameResult(std::string* err) override;
+  int64_t FrameResultRounded(std::string* err) override;
+  std::string Serialize(std::string* err) const override;
+  bool Merge(const DpFunc& other, std::string* err) override;
+  int64_t MemoryUsed() override;
+
+ protected:
+  // Returns the underlying algorithm, or nullptr if it was never constructed.
+  virtual differential_privacy::Algorithm<T>* algorithm() const = 0;
+
+  // Returns a new function with the same parameters and no entries.
+  virtual TypedDpFunc<T>* NewEmpty(std::string* err) const = 0;
+
+  bool MergeSummary(const std::string& summary, std::string* err) override;
+
+  // Adds the buffered entries to the underlying algorithm. Called before
+  // anything reads the state of the algorithm.
+  void FlushEntries() const;
+
+ private:
+  // Buffers an entry of the entry type of the algorithm.
+  bool BufferEntry(T entry);
+
+  // Removes an entry of the entry type of the algorithm.
+  bool RemoveTypedEntry(T entry, std::string* err);
+
+  // Returns an empty function with the same parameters, which RemoveEntry and
+  // FrameResult use as scratch space. Created when first needed.
+  TypedDpFunc<T>* Scratch(std::string* err);
+
+  // Returns the scratch function holding a copy of the entries, for
+  // FrameResult and FrameResultRounded.
+  TypedDpFunc<T>* FrameScratch(std::string* err);
+
+  std::unique_ptr<TypedDpFunc<T>> scratch_;
+  mutable std::vector<T> buffer_;
+};
+
+class DpCount final : public TypedDpFunc<int64_t> {
  public:
   DpCount(std::string* err, bool default_epsilon = true, double epsilon = 0);
   ~DpCount() override;
-  bool AddEntry(double entry) override;
   double Result(std::string* err) override;
+  int64_t ResultRounded(std::string* err) override;
+
+ protected:
+  differential_privacy::Algorithm<int64_t>* algorithm() const override;
+  TypedDpFunc<int64_t>* NewEmpty(std::string* err) const override;
 
  private:
-  differential_privacy::Count<double>* count_ = nullptr;
+  differential_privacy::Count<int64_t>* count_ = nullptr;
 };
 
-class DpSum : public DpFunc {
+class DpSum final : public TypedDpFunc<double> {
  public:
   DpSum(std::string* err, bool default_epsilon = true, double epsilon = 0,
         bool auto_bounds = true, double lower = 0, double upper = 0);
   ~DpSum() override;
-  bool AddEntry(double entry) override;
   double Result(std::string* err) override;
 
+ protected:
+  differential_privacy::Algorithm<double>* algorithm() const override;
+  TypedDpFunc<double>* NewEmpty(std::string* err) const override;
+
+ private:
+  differential_privacy::BoundedSum<double, double>* sum_ = nullptr;
+};
+
+// Sum of integer entries. Accumulates and adds noise in int64 arithmetic, so
+// the result is exact up to the noise. Manual bounds are rounded inwards to
+// integers.
+class DpIntSum final : public TypedDpFunc<int64_t> {
+ public:
+  DpIntSum(std::string* err, bool default_epsilon = true, double epsilon = 0,
+           bool auto_bounds = true, double lower = 0, double upper = 0);
+  ~DpIntSum() override;
+  double Result(std::string* err) override;
+  int64_t ResultRounded(std::string* err) override;
+
+ protected:
+  differential_privacy::Algorithm<int64_t>* algorithm() const override;
+  TypedDpFunc<int64_t>* NewEmpty(std::string* err) const override;
+
  private:
-  differential_privacy::BoundedSum<double>* sum_ = nullptr;
+  differential_privacy::BoundedSum<int64_t, int64_t>* sum_ = nullptr;
 };
 
-class DpMean : public DpFunc {
+class DpMean final : public TypedDpFunc<double> {
  public:
   DpMean(std::string* err, bool default_epsilon = true, double epsilon = 0,
          bool auto_bounds = true, double lower = 0, double upper = 0);
   ~DpMean() override;
-  bool AddEntry(double entry) override;
   double Result(std::string* err) override;
 
+ protected:
+  differential_privacy::Algorithm<double>* algorithm() const override;
+  TypedDpFunc<double>* NewEmpty(std::string* err) const override;
+
  private:
   differential_privacy::BoundedMean<double>* mean_ = nullptr;
 };
 
-class DpVariance : public DpFunc {
+class DpVariance final : public TypedDpFunc<double> {
  public:
   DpVariance(std::string* err, bool default_epsilon = true, double epsilon = 0,
              bool auto_bounds = true, double lower = 0, double upper = 0);
   ~DpVariance() override;
-  bool AddEntry(double entry) override;
   double Result(std::string* err) override;
 
+ protected:
+  differential_privacy::Algorithm<double>* algorithm() const override;
+  TypedDpFunc<double>* NewEmpty(std::string* err) const override;
+
  private:
   differential_privacy::BoundedVariance<double>* var_ = nullptr;
 };
 
-class DpStandardDeviation : public DpFunc {
+class DpStandardDeviation final : public TypedDpFunc<double> {
  public:
   DpStandardDeviation(std::string* err, bool default_epsilon = true,
                       double epsilon = 0, bool auto_bounds = true,
                       double lower = 0, double upper = 0);
   ~DpStandardDeviation() override;
-  bool AddEntry(double entry) override;
   double Result(std::string* err) override;
 
+ protected:
+  differential_privacy::Algorithm<double>* algorithm() const override;
+  TypedDpFunc<double>* NewEmpty(std::string* err) const override;
+
  private:
   differential_privacy::BoundedStandardDeviation<double>* sd_ = nullptr;
 };
 
-class DpNtile : public DpFunc {
+// Percentile of the entries, computed with a quantile tree over [lower, upper].
+// Unlike an algorithm that keeps every entry, the state has a fixed maximum
+// size regardless of the number of entries, and the states of parallel
+// workers are combined by adding up their tree counts.
+class DpNtile final : public TypedDpFunc<double> {
  public:
   // For the ntile function, require bounds because algorithm performs very
   // poorly without them.
   DpNtile(std::string* err, double percentile, double lower, double upper,
           bool default_epsilon = true, double epsilon = 0);
   ~DpNtile() override;
-  bool AddEntry(double entry) override;
   double Result(std::string* err) override;
 
+ protected:
+  differential_privacy::Algorithm<double>* algorithm() const override;
+  TypedDpFunc<double>* NewEmpty(std::string* err) const override;
+
  private:
-  differential_privacy::continuous::Percentile<double>* perc_ = nullptr;
+  differential_privacy::Quantiles<double>* quantiles_ = nullptr;
 };
 
 #endif  // THIRD_PARTY_DIFFERENTIAL_PRIVACY_POSTGRES_DP_FUNC_H
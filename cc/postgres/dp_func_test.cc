@@ -16,6 +16,12 @@
 
 #include "postgres/dp_func.h"
 
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -24,7 +30,8 @@ namespace {
 template <typename T>
 class BoundedDpFuncTest : public ::testing::Test {};
 
-typedef ::testing::Types<DpSum, DpMean, DpVariance, DpStandardDeviation>
+typedef ::testing::Types<DpSum, DpIntSum, DpMean, DpVariance,
+                         DpStandardDeviation>
     BoundedDpFuncs;
 TYPED_TEST_SUITE(BoundedDpFuncTest, BoundedDpFuncs);
 
@@ -65,11 +72,227 @@ TYPED_TEST(BoundedDpFuncTest, BasicTest) {
   EXPECT_TRUE(err.empty());
 }
 
+TYPED_TEST(BoundedDpFuncTest, GetEpsilon) {
+  std::string err;
+  EXPECT_EQ(TypeParam(&err, false, 0.5, false, 0, 5).GetEpsilon(), 0.5);
+  EXPECT_EQ(TypeParam(&err, true, 0, false, 0, 5).GetEpsilon(), std::log(3));
+}
+
+TYPED_TEST(BoundedDpFuncTest, DeserializeReconstructsState) {
+  std::string err;
+  auto func = TypeParam(&err, true, 0, false, 0, 5);
+  EXPECT_TRUE(func.AddEntry(1));
+  std::string state = func.Serialize(&err);
+  EXPECT_TRUE(err.empty());
+  std::unique_ptr<TypeParam> deserialized(
+      DeserializeDpFunc<TypeParam>(state, &err));
+  ASSERT_NE(deserialized, nullptr);
+  EXPECT_TRUE(err.empty());
+  EXPECT_TRUE(deserialized->Merge(func, &err));
+  static_cast<void>(deserialized->Result(&err));
+  EXPECT_TRUE(err.empty());
+}
+
+TYPED_TEST(BoundedDpFuncTest, MergeDifferentBounds) {
+  std::string err;
+  auto func = TypeParam(&err, true, 0, false, 0, 5);
+  auto other = TypeParam(&err, true, 0, false, 0, 10);
+  EXPECT_FALSE(func.Merge(other, &err));
+  EXPECT_EQ(err, "Cannot merge dp functions of different types or parameters.");
+}
+
+TEST(DpCount, MergeCountsEntries) {
+  std::string err;
+  // Large epsilon, so that the rounded result is exact.
+  auto func = DpCount(&err, false, 1e9);
+  auto other = DpCount(&err, false, 1e9);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(func.AddEntry(1));
+    EXPECT_TRUE(other.AddEntry(1));
+  }
+  EXPECT_TRUE(func.Merge(other, &err));
+  EXPECT_EQ(func.ResultRounded(&err), 20);
+  EXPECT_TRUE(err.empty());
+}
+
+TEST(DpCount, DeserializeKeepsEntries) {
+  std::string err;
+  auto func = DpCount(&err, false, 1e9);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(func.AddEntry(1));
+  }
+  std::unique_ptr<DpCount> deserialized(
+      DeserializeDpFunc<DpCount>(func.Serialize(&err), &err));
+  ASSERT_NE(deserialized, nullptr);
+  EXPECT_EQ(deserialized->ResultRounded(&err), 10);
+  EXPECT_TRUE(err.empty());
+}
+
+TEST(DpCount, DeserializeMalformedState) {
+  std::string err;
+  EXPECT_EQ(DeserializeDpFunc<DpCount>("abc", &err), nullptr);
+  EXPECT_EQ(err, "Malformed state of dp function.");
+}
+
+TEST(DpCount, MergeDifferentTypes) {
+  std::string err;
+  auto count = DpCount(&err);
+  auto sum = DpSum(&err);
+  EXPECT_FALSE(count.Merge(sum, &err));
+  EXPECT_EQ(err, "Cannot merge dp functions of different types or parameters.");
+}
+
+TYPED_TEST(BoundedDpFuncTest, FrameResultCanBeRepeated) {
+  std::string err;
+  auto func = TypeParam(&err, true, 0, false, 0, 5);
+  EXPECT_TRUE(func.AddEntry(1));
+  static_cast<void>(func.FrameResult(&err));
+  EXPECT_TRUE(func.AddEntry(2));
+  static_cast<void>(func.FrameResult(&err));
+  EXPECT_TRUE(err.empty());
+}
+
+TYPED_TEST(BoundedDpFuncTest, RemoveEntryRequiresManualBounds) {
+  std::string err;
+  auto func = TypeParam(&err, true, 0, true, 0, 0);
+  EXPECT_TRUE(func.AddEntry(1));
+  EXPECT_FALSE(func.RemoveEntry(1.0, &err));
+  EXPECT_EQ(err,
+            "Removing entries is only supported by count and by functions "
+            "with manual bounds.");
+}
+
+// Large epsilon, so that results are close to the exact ones.
+constexpr double kLargeEpsilon = 1e9;
+
+template <typename DpFunction>
+double FrameResultAfterRemoval() {
+  std::string err;
+  auto func = DpFunction(&err, false, kLargeEpsilon, false, 0, 5);
+  EXPECT_TRUE(func.AddEntry(1));
+  EXPECT_TRUE(func.AddEntry(2));
+  EXPECT_TRUE(func.AddEntry(7));
+  EXPECT_TRUE(func.RemoveEntry(2.0, &err));
+  double result = func.FrameResult(&err);
+  EXPECT_TRUE(err.empty());
+  return result;
+}
+
+TEST(DpSum, RemoveEntry) {
+  // 7 is clamped to 5.
+  EXPECT_NEAR(FrameResultAfterRemoval<DpSum>(), 6, 1e-6);
+}
+
+TEST(DpIntSum, RemoveEntry) {
+  EXPECT_NEAR(FrameResultAfterRemoval<DpIntSum>(), 6, 1e-6);
+}
+
+TEST(DpMean, RemoveEntry) {
+  EXPECT_NEAR(FrameResultAfterRemoval<DpMean>(), 3, 1e-6);
+}
+
+TEST(DpVariance, RemoveEntry) {
+  EXPECT_NEAR(FrameResultAfterRemoval<DpVariance>(), 4, 1e-6);
+}
+
+TEST(DpStandardDeviation, RemoveEntry) {
+  EXPECT_NEAR(FrameResultAfterRemoval<DpStandardDeviation>(), 2, 1e-6);
+}
+
+TEST(DpSum, AddEntriesMatchesAddEntry) {
+  std::string err;
+  auto batched = DpSum(&err, false, kLargeEpsilon, false, 0, 5);
+  auto sequential = DpSum(&err, false, kLargeEpsilon, false, 0, 5);
+  std::vector<double> entries;
+  // More entries than are buffered, with a partial batch at the end.
+  for (int i = 0; i < 150; ++i) {
+    entries.push_back(i % 7);
+    EXPECT_TRUE(sequential.AddEntry(entries.back()));
+  }
+  EXPECT_TRUE(batched.AddEntry(3));
+  EXPECT_TRUE(batched.AddEntries(entries.data(), entries.size()));
+  EXPECT_TRUE(sequential.AddEntry(3));
+  EXPECT_NEAR(batched.Result(&err), sequential.Result(&err), 1e-6);
+  EXPECT_TRUE(err.empty());
+}
+
+TEST(DpIntSum, ResultIsExact) {
+  std::string err;
+  auto func = DpIntSum(&err, false, kLargeEpsilon, false, 0, 10);
+  std::vector<int64_t> entries(1000, 7);
+  EXPECT_TRUE(func.AddEntries(entries.data(), entries.size()));
+  EXPECT_EQ(func.ResultRounded(&err), 7000);
+  EXPECT_TRUE(err.empty());
+}
+
+TEST(DpIntSum, RoundsBoundsInwards) {
+  std::string err;
+  auto func = DpIntSum(&err, false, kLargeEpsilon, false, 0.5, 9.5);
+  // Clamped to 1 and 9, and 2.4 is rounded to 2.
+  EXPECT_TRUE(func.AddEntry(0));
+  EXPECT_TRUE(func.AddEntry(10));
+  EXPECT_TRUE(func.AddEntry(2.4));
+  EXPECT_EQ(func.ResultRounded(&err), 12);
+  EXPECT_TRUE(err.empty());
+}
+
+TEST(DpCount, AddEntriesMissingAlgorithm) {
+  std::string err;
+  auto dp_count = DpCount(&err, false, 0);
+  const double entries[] = {1, 2};
+  EXPECT_FALSE(dp_count.AddEntries(entries, 2));
+}
+
+TEST(DpCount, RemoveEntry) {
+  std::string err;
+  auto func = DpCount(&err, false, kLargeEpsilon);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(func.AddEntry(1));
+  }
+  EXPECT_TRUE(func.RemoveEntry(1.0, &err));
+  EXPECT_EQ(func.FrameResultRounded(&err), 2);
+  EXPECT_TRUE(func.RemoveEntry(1.0, &err));
+  EXPECT_EQ(func.FrameResultRounded(&err), 1);
+  EXPECT_TRUE(err.empty());
+}
+
+int allocations = 0;
+int deallocations = 0;
+
+void* CountingAllocate(size_t size) {
+  ++allocations;
+  return ::operator new(size);
+}
+
+void CountingDeallocate(void* ptr) {
+  ++deallocations;
+  ::operator delete(ptr);
+}
+
+TEST(DpFunc, AllocatesWithAllocator) {
+  SetDpFuncAllocator(CountingAllocate, CountingDeallocate);
+  std::string err;
+  DpFunc* func = new DpSum(&err);
+  EXPECT_EQ(allocations, 1);
+  delete func;
+  EXPECT_EQ(deallocations, 1);
+  SetDpFuncAllocator(nullptr, nullptr);
+}
+
+TYPED_TEST(BoundedDpFuncTest, MemoryUsedIncludesAlgorithm) {
+  std::string err;
+  auto manual_bounds = TypeParam(&err, true, 0, false, 0, 5);
+  auto auto_bounds = TypeParam(&err, true, 0, true, 0, 0);
+  EXPECT_GT(manual_bounds.MemoryUsed(), sizeof(TypeParam));
+  // The bins of auto bounds are part of the algorithm.
+  EXPECT_GT(auto_bounds.MemoryUsed(), manual_bounds.MemoryUsed());
+}
+
 TEST(DpNtile, BadPercentile) {
   std::string err;
   auto func = DpNtile(&err, -1, 0, 10);
   EXPECT_EQ(err,
-            "Percentile must be in the inclusive interval [0,1], but is -1.");
+            "All quantiles to calculate must be in [0, 1], but one was: -1");
 }
 
 TEST(DpNtile, BadBounds) {
@@ -87,4 +310,55 @@ TEST(DpNtile, BasicTest) {
   EXPECT_TRUE(err.empty());
 }
 
+TEST(DpNtile, MemoryDoesNotGrowWithEntries) {
+  std::string err;
+  auto func = DpNtile(&err, .5, 0, 1000, /*default_epsilon=*/false, 10);
+  for (int i = 0; i < 100000; ++i) {
+    EXPECT_TRUE(func.AddEntry(static_cast<double>(i % 1000)));
+  }
+  const int64_t memory = func.MemoryUsed();
+  for (int i = 0; i < 100000; ++i) {
+    EXPECT_TRUE(func.AddEntry(static_cast<double>(i % 1000)));
+  }
+  EXPECT_EQ(func.MemoryUsed(), memory);
+  EXPECT_NEAR(func.Result(&err), 500, 50);
+  EXPECT_TRUE(err.empty());
+}
+
+TEST(DpNtile, MergeCombinesEntries) {
+  std::string err;
+  auto low = DpNtile(&err, .5, 0, 100, /*default_epsilon=*/false, 10);
+  auto high = DpNtile(&err, .5, 0, 100, /*default_epsilon=*/false, 10);
+  for (int i = 0; i < 4000; ++i) {
+    EXPECT_TRUE(low.AddEntry(10.0));
+  }
+  for (int i = 0; i < 6000; ++i) {
+    EXPECT_TRUE(high.AddEntry(80.0));
+  }
+  ASSERT_TRUE(low.Merge(high, &err));
+  // The median of the combined entries is in the entries of high.
+  EXPECT_NEAR(low.Result(&err), 80, 5);
+  EXPECT_TRUE(err.empty());
+}
+
+TEST(DpNtile, RemoveEntryUnsupported) {
+  std::string err;
+  auto func = DpNtile(&err, .5, 0, 10);
+  EXPECT_TRUE(func.AddEntry(1));
+  EXPECT_FALSE(func.RemoveEntry(1.0, &err));
+  EXPECT_FALSE(err.empty());
+}
+
+TEST(DpNtile, DeserializeReconstructsState) {
+  std::string err;
+  auto func = DpNtile(&err, .5, 0, 10);
+  EXPECT_TRUE(func.AddEntry(1));
+  std::unique_ptr<DpNtile> deserialized(
+      DeserializeDpFunc<DpNtile>(func.Serialize(&err), &err));
+  ASSERT_NE(deserialized, nullptr);
+  EXPECT_TRUE(deserialized->Merge(func, &err));
+  static_cast<void>(deserialized->Result(&err));
+  EXPECT_TRUE(err.empty());
+}
+
 }  // namespace
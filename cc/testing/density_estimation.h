@@ -29,6 +29,7 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/types/span.h"
 
 namespace differential_privacy {
 namespace testing {
@@ -71,6 +72,32 @@ class Histogram {
     return absl::OkStatus();
   }
 
+  // Increments the counts of the bins into which the elements fall, as Add does
+  // for each of them. The bin indices are computed in a first loop without
+  // branches, which also finds the lowest index, so that the bounds are checked
+  // once for the whole batch. Returns an error without adding any element if
+  // some element is out of bounds.
+  absl::Status AddAll(absl::Span<const T> elements) {
+    if (elements.empty()) {
+      return absl::OkStatus();
+    }
+    const double last_bin = NumBins() - 1;
+    std::vector<double> indices(elements.size());
+    double lowest_index = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < elements.size(); ++i) {
+      const double index = (elements[i] - lowest_) / width_;
+      lowest_index = std::min(lowest_index, index);
+      indices[i] = std::min(index, last_bin);
+    }
+    if (lowest_index < 0) {
+      return absl::InvalidArgumentError("An element is out of bounds.");
+    }
+    for (const double index : indices) {
+      ++bin_counts_[static_cast<int>(index)];
+    }
+    return absl::OkStatus();
+  }
+
   // Number of elements in bin index.
   absl::StatusOr<int> BinCount(int index) const {
     if (index < 0 || index >= NumBins()) {
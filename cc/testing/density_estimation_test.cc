@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <limits>
 #include <string>
+#include <vector>
 
 #include "base/testing/status_matchers.h"
 #include "gmock/gmock.h"
@@ -50,6 +51,26 @@ TYPED_TEST(HistogramTest, AddOutOfBounds) {
   EXPECT_EQ(hist.Add(-3).code(), absl::StatusCode::kInvalidArgument);
 }
 
+TYPED_TEST(HistogramTest, AddAllOutOfBounds) {
+  Histogram<TypeParam> hist(-2, .5, 8);
+  const std::vector<TypeParam> elements = {0, -3, 1};
+  EXPECT_EQ(hist.AddAll(elements).code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(hist.Total(), 0);
+}
+
+TYPED_TEST(HistogramTest, AddAllMatchesAdd) {
+  Histogram<TypeParam> hist(-2, 2, 3);
+  Histogram<TypeParam> batch_hist(-2, 2, 3);
+  const std::vector<TypeParam> elements = {-1, 0, 0, 2, 100, -2};
+  for (const TypeParam element : elements) {
+    EXPECT_OK(hist.Add(element));
+  }
+  EXPECT_OK(batch_hist.AddAll(elements));
+  for (int i = 0; i < hist.NumBins(); ++i) {
+    EXPECT_EQ(batch_hist.BinCountOrDie(i), hist.BinCountOrDie(i));
+  }
+}
+
 TYPED_TEST(HistogramTest, BinCountOutOfBounds) {
   const int num_bins = 8;
   Histogram<TypeParam> hist(-2, .5, num_bins);
@@ -53,15 +53,17 @@ static bool GenerateVote(
     std::vector<double> sample_a = sample_generator_a();
     std::vector<double> sample_b = sample_generator_b();
     for (int j = 0; j < num_ranks; ++j) {
-      samples_a[j].push_back(Bucketize(sample_a[j], lower, upper, num_buckets));
-      samples_b[j].push_back(Bucketize(sample_b[j], lower, upper, num_buckets));
+      samples_a[j].push_back(sample_a[j]);
+      samples_b[j].push_back(sample_b[j]);
     }
   }
 
   // Only vote to accept if all quantiles pass the test.
   for (int j = 0; j < num_ranks; ++j) {
-    if (!VerifyApproximateDp(samples_a[j], samples_b[j], epsilon, delta,
-                             delta_tolerance)) {
+    if (!VerifyApproximateDp(
+            Bucketize(samples_a[j], lower, upper, num_buckets),
+            Bucketize(samples_b[j], lower, upper, num_buckets), epsilon,
+            delta, delta_tolerance)) {
       return false;
     }
   }
@@ -0,0 +1,516 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "testing/scenario_benchmark.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/bounded-mean.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/bounded-variance.h"
+#include "algorithms/contribution-bounder.h"
+#include "algorithms/count.h"
+#include "algorithms/numerical-mechanisms.h"
+#include "algorithms/partition-selection.h"
+#include "algorithms/quantiles.h"
+#include "proto/summary.pb.h"
+#include "proto/testing/benchmark_scenario.pb.h"
+#include "proto/testing/statistical_tests.pb.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy::testing {
+namespace {
+
+using ::testing::BenchmarkScenario;
+
+struct Record {
+  int64_t privacy_unit;
+  int64_t partition;
+  double value;
+};
+
+// Synthetic data of a scenario. Records refer to the ids and keys by index.
+struct Data {
+  std::vector<std::string> privacy_ids;
+  std::vector<std::string> partition_keys;
+  std::vector<Record> records;
+};
+
+// Aggregation of a partition on a shard, or of all shards after the merge.
+struct PartitionState {
+  int64_t num_privacy_units = 0;
+  // One algorithm per metric of the scenario, in order.
+  std::vector<std::unique_ptr<Algorithm<double>>> metrics;
+};
+
+struct SerializedPartition {
+  std::string partition_key;
+  int64_t num_privacy_units;
+  std::vector<std::string> summaries;
+};
+
+// Parameters of the algorithms of every metric.
+struct MetricParameters {
+  double epsilon;
+  double delta;
+  ::testing::NoiseType noise_type;
+  int max_partitions_contributed;
+  int max_contributions_per_partition;
+  double lower;
+  double upper;
+  std::vector<double> quantiles;
+};
+
+absl::Status Validate(const BenchmarkScenario& scenario) {
+  if (scenario.num_privacy_units() < 1 || scenario.num_partitions() < 1) {
+    return absl::InvalidArgumentError(
+        "Scenario needs at least one privacy unit and partition.");
+  }
+  if (!(scenario.mean_records_per_privacy_unit() >= 1)) {
+    return absl::InvalidArgumentError(
+        "Mean records per privacy unit must be at least 1.");
+  }
+  switch (scenario.partition_distribution()) {
+    case ::testing::UNIFORM_PARTITIONS:
+      break;
+    case ::testing::ZIPF_PARTITIONS:
+      if (!(scenario.zipf_exponent() > 0)) {
+        return absl::InvalidArgumentError("Zipf exponent must be positive.");
+      }
+      break;
+    default:
+      return absl::InvalidArgumentError("Partition distribution must be set.");
+  }
+  if (!(scenario.value_stddev() >= 0)) {
+    return absl::InvalidArgumentError(
+        "Standard deviation of the values must be non-negative.");
+  }
+  if (scenario.metrics().empty()) {
+    return absl::InvalidArgumentError("Scenario needs at least one metric.");
+  }
+  if (scenario.noise_type() != ::testing::LAPLACE &&
+      scenario.noise_type() != ::testing::GAUSSIAN) {
+    return absl::InvalidArgumentError(
+        "Noise type must be LAPLACE or GAUSSIAN.");
+  }
+  if (scenario.noise_type() == ::testing::GAUSSIAN &&
+      std::count(scenario.metrics().begin(), scenario.metrics().end(),
+                 ::testing::VARIANCE) > 0) {
+    return absl::InvalidArgumentError(
+        "BoundedVariance does not support Gaussian noise.");
+  }
+  if (scenario.num_shards() < 1) {
+    return absl::InvalidArgumentError("Number of shards must be at least 1.");
+  }
+  return absl::OkStatus();
+}
+
+Data GenerateData(const BenchmarkScenario& scenario) {
+  Data data;
+  for (int64_t i = 0; i < scenario.num_privacy_units(); ++i) {
+    data.privacy_ids.push_back(absl::StrCat("unit", i));
+  }
+  for (int64_t i = 0; i < scenario.num_partitions(); ++i) {
+    data.partition_keys.push_back(absl::StrCat("partition", i));
+  }
+
+  // Cumulative weights of the partitions for ZIPF_PARTITIONS.
+  std::vector<double> zipf_cdf;
+  if (scenario.partition_distribution() == ::testing::ZIPF_PARTITIONS) {
+    double total = 0;
+    for (int64_t i = 1; i <= scenario.num_partitions(); ++i) {
+      total += std::pow(static_cast<double>(i), -scenario.zipf_exponent());
+      zipf_cdf.push_back(total);
+    }
+  }
+
+  std::mt19937_64 generator(scenario.seed());
+  std::uniform_int_distribution<int64_t> uniform_partition(
+      0, scenario.num_partitions() - 1);
+  std::uniform_real_distribution<double> uniform_weight(
+      0, zipf_cdf.empty() ? 1 : zipf_cdf.back());
+  std::geometric_distribution<int64_t> extra_records(
+      1 / scenario.mean_records_per_privacy_unit());
+  std::normal_distribution<double> values(
+      scenario.value_mean(),
+      scenario.value_stddev() > 0 ? scenario.value_stddev() : 1);
+  for (int64_t unit = 0; unit < scenario.num_privacy_units(); ++unit) {
+    const int64_t num_records = 1 + extra_records(generator);
+    for (int64_t i = 0; i < num_records; ++i) {
+      int64_t partition;
+      if (zipf_cdf.empty()) {
+        partition = uniform_partition(generator);
+      } else {
+        partition = std::min<int64_t>(
+            std::upper_bound(zipf_cdf.begin(), zipf_cdf.end(),
+                             uniform_weight(generator)) -
+                zipf_cdf.begin(),
+            scenario.num_partitions() - 1);
+      }
+      const double value = scenario.value_stddev() > 0
+                               ? values(generator)
+                               : scenario.value_mean();
+      data.records.push_back({unit, partition, value});
+    }
+  }
+  return data;
+}
+
+std::unique_ptr<NumericalMechanismBuilder> MechanismBuilder(
+    ::testing::NoiseType noise_type) {
+  if (noise_type == ::testing::GAUSSIAN) {
+    return std::make_unique<GaussianMechanism::Builder>();
+  }
+  return std::make_unique<LaplaceMechanism::Builder>();
+}
+
+template <typename Builder>
+absl::StatusOr<std::unique_ptr<Algorithm<double>>> BuildBounded(
+    Builder& builder, const MetricParameters& parameters) {
+  ASSIGN_OR_RETURN(
+      auto algorithm,
+      builder.SetEpsilon(parameters.epsilon)
+          .SetDelta(parameters.delta)
+          .SetMaxPartitionsContributed(parameters.max_partitions_contributed)
+          .SetMaxContributionsPerPartition(
+              parameters.max_contributions_per_partition)
+          .SetLower(parameters.lower)
+          .SetUpper(parameters.upper)
+          .SetLaplaceMechanism(MechanismBuilder(parameters.noise_type))
+          .Build());
+  return std::unique_ptr<Algorithm<double>>(std::move(algorithm));
+}
+
+absl::StatusOr<std::unique_ptr<Algorithm<double>>> BuildMetric(
+    ::testing::AggregationType metric, const MetricParameters& parameters) {
+  switch (metric) {
+    case ::testing::COUNT: {
+      ASSIGN_OR_RETURN(
+          std::unique_ptr<Count<double>> count,
+          Count<double>::Builder()
+              .SetEpsilon(parameters.epsilon)
+              .SetDelta(parameters.delta)
+              .SetMaxPartitionsContributed(
+                  parameters.max_partitions_contributed)
+              .SetMaxContributionsPerPartition(
+                  parameters.max_contributions_per_partition)
+              .SetLaplaceMechanism(MechanismBuilder(parameters.noise_type))
+              .Build());
+      return std::unique_ptr<Algorithm<double>>(std::move(count));
+    }
+    case ::testing::SUM: {
+      BoundedSum<double>::Builder builder;
+      return BuildBounded(builder, parameters);
+    }
+    case ::testing::MEAN: {
+      BoundedMean<double>::Builder builder;
+      return BuildBounded(builder, parameters);
+    }
+    case ::testing::VARIANCE: {
+      BoundedVariance<double>::Builder builder;
+      return BuildBounded(builder, parameters);
+    }
+    case ::testing::QUANTILE: {
+      Quantiles<double>::Builder builder;
+      builder.SetQuantiles(parameters.quantiles);
+      return BuildBounded(builder, parameters);
+    }
+    default:
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unsupported metric: ",
+                       ::testing::AggregationType_Name(metric)));
+  }
+}
+
+absl::StatusOr<std::vector<std::unique_ptr<Algorithm<double>>>> BuildMetrics(
+    const BenchmarkScenario& scenario, const MetricParameters& parameters) {
+  std::vector<std::unique_ptr<Algorithm<double>>> metrics;
+  for (int metric : scenario.metrics()) {
+    ASSIGN_OR_RETURN(
+        metrics.emplace_back(),
+        BuildMetric(static_cast<::testing::AggregationType>(metric),
+                    parameters));
+  }
+  return metrics;
+}
+
+int64_t MemoryUsed(PartitionState& state) {
+  int64_t memory = sizeof(state);
+  for (const std::unique_ptr<Algorithm<double>>& metric : state.metrics) {
+    memory += metric->MemoryUsed();
+  }
+  return memory;
+}
+
+int64_t PeakRssBytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  // Linux reports kilobytes.
+  return int64_t{usage.ru_maxrss} * 1024;
+#endif
+}
+
+}  // namespace
+
+absl::StatusOr<ScenarioReport> RunScenario(const BenchmarkScenario& scenario) {
+  RETURN_IF_ERROR(Validate(scenario));
+  const Data data = GenerateData(scenario);
+  const int num_shards = scenario.num_shards();
+
+  // Partition selection and every metric get an equal share of the budget.
+  // Laplace noise leaves all of delta to partition selection.
+  const double share = 1.0 / (scenario.metrics_size() + 1);
+  const bool gaussian = scenario.noise_type() == ::testing::GAUSSIAN;
+  MetricParameters parameters;
+  parameters.epsilon = scenario.epsilon() * share;
+  parameters.delta = gaussian ? scenario.delta() * share : 0;
+  parameters.noise_type = scenario.noise_type();
+  parameters.max_partitions_contributed = scenario.max_partitions_contributed();
+  parameters.max_contributions_per_partition =
+      scenario.max_contributions_per_partition();
+  parameters.lower = scenario.lower();
+  parameters.upper = scenario.upper();
+  parameters.quantiles.assign(scenario.quantiles().begin(),
+                              scenario.quantiles().end());
+  if (parameters.quantiles.empty()) {
+    parameters.quantiles.push_back(0.5);
+  }
+
+  std::unique_ptr<PartitionSelectionStrategyBuilder> selection_builder;
+  if (gaussian) {
+    selection_builder = std::make_unique<GaussianPartitionSelection::Builder>();
+  } else {
+    selection_builder = std::make_unique<LaplacePartitionSelection::Builder>();
+  }
+  ASSIGN_OR_RETURN(
+      std::unique_ptr<PartitionSelectionStrategy> selection,
+      selection_builder->SetEpsilon(scenario.epsilon() * share)
+          .SetDelta(gaussian ? scenario.delta() * share : scenario.delta())
+          .SetMaxPartitionsContributed(scenario.max_partitions_contributed())
+          .Build());
+  // Fails early on invalid parameters of the metrics.
+  RETURN_IF_ERROR(BuildMetrics(scenario, parameters).status());
+
+  std::vector<std::unique_ptr<ContributionBounder<double>>> bounders;
+  for (int shard = 0; shard < num_shards; ++shard) {
+    ASSIGN_OR_RETURN(
+        bounders.emplace_back(),
+        ContributionBounder<double>::Builder()
+            .SetMaxPartitionsContributed(scenario.max_partitions_contributed())
+            .SetMaxContributionsPerPartition(
+                scenario.max_contributions_per_partition())
+            .Build());
+  }
+
+  ScenarioReport report;
+  report.name = scenario.name();
+  report.num_records = data.records.size();
+  // The memory of the state is computed after the time of a stage is taken.
+  auto add_stage = [&report](absl::string_view stage, absl::Duration elapsed,
+                             int64_t state_bytes) {
+    report.stages.push_back(
+        {std::string(stage), elapsed, state_bytes, PeakRssBytes()});
+  };
+
+  absl::Time start = absl::Now();
+
+  // Privacy units are assigned to shards by their index, like a pipeline
+  // would shard them by privacy id.
+  for (const Record& record : data.records) {
+    bounders[record.privacy_unit % num_shards]->AddContribution(
+        data.privacy_ids[record.privacy_unit],
+        data.partition_keys[record.partition], record.value);
+  }
+  absl::Duration elapsed = absl::Now() - start;
+  int64_t state_bytes = 0;
+  for (const std::unique_ptr<ContributionBounder<double>>& bounder :
+       bounders) {
+    state_bytes += bounder->MemoryUsed();
+  }
+  add_stage("contribution_bounding", elapsed, state_bytes);
+
+  start = absl::Now();
+
+  std::vector<absl::flat_hash_map<std::string, PartitionState>>
+      shard_partitions(num_shards);
+  absl::Status status;
+  for (int shard = 0; shard < num_shards; ++shard) {
+    absl::flat_hash_map<std::string, PartitionState>& partitions =
+        shard_partitions[shard];
+    bounders[shard]->Flush(
+        [&](absl::Span<const ContributionBounder<double>::Contribution>
+                contributions) {
+          PartitionState* state = nullptr;
+          absl::string_view partition_key;
+          for (const auto& contribution : contributions) {
+            if (state == nullptr ||
+                contribution.partition_key != partition_key) {
+              partition_key = contribution.partition_key;
+              auto [it, inserted] = partitions.try_emplace(partition_key);
+              state = &it->second;
+              if (inserted) {
+                auto metrics = BuildMetrics(scenario, parameters);
+                status.Update(metrics.status());
+                if (metrics.ok()) {
+                  state->metrics = *std::move(metrics);
+                }
+              }
+              ++state->num_privacy_units;
+            }
+            for (const std::unique_ptr<Algorithm<double>>& metric :
+                 state->metrics) {
+              metric->AddEntry(contribution.value);
+            }
+          }
+        });
+  }
+  RETURN_IF_ERROR(status);
+  elapsed = absl::Now() - start;
+  state_bytes = 0;
+  for (auto& partitions : shard_partitions) {
+    for (auto& [partition_key, state] : partitions) {
+      state_bytes += partition_key.size() + MemoryUsed(state);
+    }
+  }
+  add_stage("ingestion", elapsed, state_bytes);
+
+  start = absl::Now();
+
+  std::vector<std::vector<SerializedPartition>> shard_summaries(num_shards);
+  state_bytes = 0;
+  for (int shard = 0; shard < num_shards; ++shard) {
+    for (auto& [partition_key, state] : shard_partitions[shard]) {
+      SerializedPartition& serialized = shard_summaries[shard].emplace_back();
+      serialized.partition_key = partition_key;
+      serialized.num_privacy_units = state.num_privacy_units;
+      for (const std::unique_ptr<Algorithm<double>>& metric : state.metrics) {
+        serialized.summaries.push_back(metric->Serialize().SerializeAsString());
+        state_bytes += serialized.summaries.back().size();
+      }
+      state_bytes += partition_key.size();
+    }
+    // The state of a shard is freed once it is sent to the combiners.
+    shard_partitions[shard].clear();
+  }
+  add_stage("serialization", absl::Now() - start, state_bytes);
+
+  start = absl::Now();
+
+  absl::flat_hash_map<std::string, PartitionState> partitions;
+  Summary summary;
+  for (std::vector<SerializedPartition>& summaries : shard_summaries) {
+    for (const SerializedPartition& serialized : summaries) {
+      auto [it, inserted] = partitions.try_emplace(serialized.partition_key);
+      PartitionState& state = it->second;
+      if (inserted) {
+        ASSIGN_OR_RETURN(state.metrics, BuildMetrics(scenario, parameters));
+      }
+      state.num_privacy_units += serialized.num_privacy_units;
+      for (int i = 0; i < state.metrics.size(); ++i) {
+        if (!summary.ParseFromString(serialized.summaries[i])) {
+          return absl::InternalError("Failed to parse a serialized summary.");
+        }
+        RETURN_IF_ERROR(state.metrics[i]->Merge(summary));
+      }
+    }
+    summaries.clear();
+  }
+  elapsed = absl::Now() - start;
+  state_bytes = 0;
+  for (auto& [partition_key, state] : partitions) {
+    state_bytes += partition_key.size() + MemoryUsed(state);
+  }
+  add_stage("merge", elapsed, state_bytes);
+
+  start = absl::Now();
+
+  std::vector<PartitionState*> states;
+  std::vector<int64_t> num_privacy_units;
+  for (auto& [partition_key, state] : partitions) {
+    states.push_back(&state);
+    num_privacy_units.push_back(state.num_privacy_units);
+  }
+  std::vector<bool> keep;
+  selection->ShouldKeep(num_privacy_units, &keep);
+  std::vector<PartitionState*> kept;
+  for (int i = 0; i < states.size(); ++i) {
+    if (keep[i]) {
+      kept.push_back(states[i]);
+    }
+  }
+  elapsed = absl::Now() - start;
+  state_bytes = 0;
+  for (PartitionState* state : kept) {
+    state_bytes += MemoryUsed(*state);
+  }
+  add_stage("partition_selection", elapsed, state_bytes);
+
+  start = absl::Now();
+
+  state_bytes = 0;
+  for (PartitionState* state : kept) {
+    for (const std::unique_ptr<Algorithm<double>>& metric : state->metrics) {
+      ASSIGN_OR_RETURN(Output output, metric->PartialResult());
+      state_bytes += output.ByteSizeLong();
+    }
+  }
+  add_stage("release", absl::Now() - start, state_bytes);
+
+  report.num_partitions = partitions.size();
+  report.num_released_partitions = kept.size();
+  return report;
+}
+
+std::string ReportsToCsv(absl::Span<const ScenarioReport> reports) {
+  std::string csv =
+      "scenario,records,partitions,released_partitions,stage,seconds,"
+      "state_bytes,peak_rss_bytes\n";
+  for (const ScenarioReport& report : reports) {
+    for (const StageReport& stage : report.stages) {
+      absl::StrAppend(&csv, report.name, ",", report.num_records, ",",
+                      report.num_partitions, ",",
+                      report.num_released_partitions, ",", stage.stage, ",",
+                      absl::ToDoubleSeconds(stage.elapsed), ",",
+                      stage.state_bytes, ",", stage.peak_rss_bytes, "\n");
+    }
+  }
+  return csv;
+}
+
+}  // namespace differential_privacy::testing
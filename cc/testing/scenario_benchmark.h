@@ -0,0 +1,85 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_CPP_TESTING_SCENARIO_BENCHMARK_H_
+#define DIFFERENTIAL_PRIVACY_CPP_TESTING_SCENARIO_BENCHMARK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "proto/testing/benchmark_scenario.pb.h"
+
+namespace differential_privacy::testing {
+
+// Runs the whole path of a differentially private aggregation with
+// per-partition algorithms on the synthetic data of a scenario, see
+// proto/testing/benchmark_scenario.proto, and measures every stage:
+//   - contribution_bounding: every shard bounds the records of its privacy
+//     units with a ContributionBounder,
+//   - ingestion: the bounded contributions are added to one algorithm per
+//     partition and metric,
+//   - serialization: every shard serializes the summaries of its partitions,
+//   - merge: the summaries of all shards are merged into new algorithms,
+//   - partition_selection: partitions are kept according to the number of
+//     their privacy units,
+//   - release: the results of the metrics of the kept partitions are computed.
+// Generating the data is not measured.
+//
+// Microbenchmarks of single algorithms on uniform data, like
+// workload_benchmark_test, miss the costs of skewed data: a few huge
+// partitions next to many tiny ones, and privacy units with many records.
+// Scenarios describe these shapes, so that changes can be measured on
+// workloads like the production ones.
+
+// Measurements of a stage.
+struct StageReport {
+  std::string stage;
+  absl::Duration elapsed;
+  // Memory of the state of the pipeline at the end of the stage, as reported
+  // by the MemoryUsed of the bounders and algorithms, or the size of the
+  // serialized summaries and outputs.
+  int64_t state_bytes = 0;
+  // High-water mark of the resident memory of the process at the end of the
+  // stage. It never decreases, so it is the peak of the stage only if it grew
+  // during the stage.
+  int64_t peak_rss_bytes = 0;
+};
+
+struct ScenarioReport {
+  std::string name;
+  int64_t num_records = 0;
+  // Partitions with at least one contribution after bounding.
+  int64_t num_partitions = 0;
+  int64_t num_released_partitions = 0;
+  std::vector<StageReport> stages;
+};
+
+// Runs the scenario once. Returns an error if the scenario is invalid or an
+// algorithm fails.
+absl::StatusOr<ScenarioReport> RunScenario(
+    const ::testing::BenchmarkScenario& scenario);
+
+// Returns the reports as CSV, with a header and one row per scenario and
+// stage.
+std::string ReportsToCsv(absl::Span<const ScenarioReport> reports);
+
+}  // namespace differential_privacy::testing
+
+#endif  // DIFFERENTIAL_PRIVACY_CPP_TESTING_SCENARIO_BENCHMARK_H_
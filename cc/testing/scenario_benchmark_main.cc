@@ -0,0 +1,68 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Runs the benchmark scenarios of a text proto file and prints the time and
+// memory of every stage as CSV; see scenario_benchmark.h. From cc/:
+//
+//   bazel run -c opt //testing:scenario_benchmark --
+//     --scenarios=$PWD/../benchmarks/scenarios.textproto > stages.csv
+
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/statusor.h"
+#include "proto/testing/benchmark_scenario.pb.h"
+#include "testing/scenario_benchmark.h"
+#include "testing/statistical_tests_utils.h"
+
+ABSL_FLAG(std::string, scenarios, "",
+          "Path of a text proto file with a testing.BenchmarkScenarios "
+          "message.");
+ABSL_FLAG(int, repetitions, 1,
+          "Number of runs of every scenario, each reported separately.");
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  using ::differential_privacy::testing::ReadProto;
+  using ::differential_privacy::testing::RunScenario;
+  using ::differential_privacy::testing::ScenarioReport;
+
+  std::optional<::testing::BenchmarkScenarios> scenarios =
+      ReadProto<::testing::BenchmarkScenarios>(absl::GetFlag(FLAGS_scenarios));
+  if (!scenarios.has_value()) {
+    std::cerr << "Cannot read scenarios from '"
+              << absl::GetFlag(FLAGS_scenarios) << "'.\n";
+    return 1;
+  }
+  std::vector<ScenarioReport> reports;
+  for (const ::testing::BenchmarkScenario& scenario : scenarios->scenario()) {
+    for (int i = 0; i < absl::GetFlag(FLAGS_repetitions); ++i) {
+      absl::StatusOr<ScenarioReport> report = RunScenario(scenario);
+      if (!report.ok()) {
+        std::cerr << "Scenario " << scenario.name()
+                  << " failed: " << report.status() << "\n";
+        return 1;
+      }
+      reports.push_back(*std::move(report));
+    }
+  }
+  std::cout << ::differential_privacy::testing::ReportsToCsv(reports);
+  return 0;
+}
@@ -0,0 +1,151 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "testing/scenario_benchmark.h"
+
+#include <string>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "proto/testing/benchmark_scenario.pb.h"
+#include "proto/testing/statistical_tests.pb.h"
+
+namespace differential_privacy::testing {
+namespace {
+
+using ::differential_privacy::base::testing::StatusIs;
+using ::testing::BenchmarkScenario;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::HasSubstr;
+using ::testing::StartsWith;
+
+BenchmarkScenario SmallScenario() {
+  BenchmarkScenario scenario;
+  scenario.set_name("small");
+  scenario.set_num_privacy_units(2000);
+  scenario.set_num_partitions(50);
+  scenario.set_partition_distribution(::testing::ZIPF_PARTITIONS);
+  scenario.set_mean_records_per_privacy_unit(3);
+  scenario.set_value_mean(5);
+  scenario.set_value_stddev(3);
+  scenario.set_lower(0);
+  scenario.set_upper(10);
+  scenario.set_max_partitions_contributed(2);
+  scenario.set_max_contributions_per_partition(2);
+  scenario.add_metrics(::testing::COUNT);
+  scenario.add_metrics(::testing::SUM);
+  scenario.add_metrics(::testing::MEAN);
+  scenario.add_metrics(::testing::VARIANCE);
+  scenario.add_metrics(::testing::QUANTILE);
+  scenario.set_noise_type(::testing::LAPLACE);
+  scenario.set_epsilon(10);
+  scenario.set_delta(1e-5);
+  scenario.set_num_shards(3);
+  scenario.set_seed(1);
+  return scenario;
+}
+
+TEST(ScenarioBenchmarkTest, ReportsEveryStage) {
+  absl::StatusOr<ScenarioReport> report = RunScenario(SmallScenario());
+
+  ASSERT_OK(report);
+  EXPECT_EQ(report->name, "small");
+  EXPECT_GE(report->num_records, 2000);
+  EXPECT_GT(report->num_partitions, 0);
+  EXPECT_LE(report->num_partitions, 50);
+  // The most popular partitions have enough privacy units to be kept.
+  EXPECT_GT(report->num_released_partitions, 0);
+  EXPECT_LE(report->num_released_partitions, report->num_partitions);
+  EXPECT_THAT(report->stages,
+              ElementsAre(Field(&StageReport::stage, "contribution_bounding"),
+                          Field(&StageReport::stage, "ingestion"),
+                          Field(&StageReport::stage, "serialization"),
+                          Field(&StageReport::stage, "merge"),
+                          Field(&StageReport::stage, "partition_selection"),
+                          Field(&StageReport::stage, "release")));
+  for (const StageReport& stage : report->stages) {
+    EXPECT_GT(stage.state_bytes, 0) << stage.stage;
+    EXPECT_GT(stage.peak_rss_bytes, 0) << stage.stage;
+  }
+}
+
+TEST(ScenarioBenchmarkTest, RunsGaussianAndUniformScenario) {
+  BenchmarkScenario scenario = SmallScenario();
+  scenario.set_partition_distribution(::testing::UNIFORM_PARTITIONS);
+  scenario.set_noise_type(::testing::GAUSSIAN);
+  scenario.clear_metrics();
+  scenario.add_metrics(::testing::COUNT);
+  scenario.add_metrics(::testing::MEAN);
+  scenario.set_num_shards(1);
+
+  absl::StatusOr<ScenarioReport> report = RunScenario(scenario);
+
+  ASSERT_OK(report);
+  EXPECT_EQ(report->stages.size(), 6);
+}
+
+TEST(ScenarioBenchmarkTest, RejectsInvalidScenarios) {
+  BenchmarkScenario no_metrics = SmallScenario();
+  no_metrics.clear_metrics();
+  EXPECT_THAT(RunScenario(no_metrics),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("metric")));
+
+  BenchmarkScenario unsupported_metric = SmallScenario();
+  unsupported_metric.add_metrics(::testing::SELECT_PARTITIONS);
+  EXPECT_THAT(RunScenario(unsupported_metric),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("SELECT_PARTITIONS")));
+
+  BenchmarkScenario gaussian_variance = SmallScenario();
+  gaussian_variance.set_noise_type(::testing::GAUSSIAN);
+  EXPECT_THAT(RunScenario(gaussian_variance),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("Gaussian")));
+
+  BenchmarkScenario no_distribution = SmallScenario();
+  no_distribution.clear_partition_distribution();
+  EXPECT_THAT(RunScenario(no_distribution),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  BenchmarkScenario no_epsilon = SmallScenario();
+  no_epsilon.clear_epsilon();
+  EXPECT_THAT(RunScenario(no_epsilon),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(ScenarioBenchmarkTest, ReportsToCsv) {
+  ScenarioReport report;
+  report.name = "s";
+  report.num_records = 10;
+  report.num_partitions = 3;
+  report.num_released_partitions = 2;
+  report.stages.push_back({"ingestion", absl::Milliseconds(1500), 100, 4096});
+
+  const std::string csv = ReportsToCsv({report});
+
+  EXPECT_THAT(csv, StartsWith("scenario,records,partitions,"));
+  EXPECT_THAT(csv, HasSubstr("\ns,10,3,2,ingestion,1.5,100,4096\n"));
+}
+
+}  // namespace
+}  // namespace differential_privacy::testing
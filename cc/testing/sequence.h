@@ -20,6 +20,8 @@
 #include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
 
 #include "absl/log/check.h"
@@ -40,6 +42,15 @@ class Sequence {
   // Returns the dimensions of the next `n` samples.
   virtual std::vector<int64_t> NextNDimensions(int n) = 0;
 
+  // Returns the sample at position `index` of the sequence, i.e., the sample
+  // that the (index + 1)-th call to GetSample() on a new sequence returns,
+  // without changing the state of the sequence. Safe to call concurrently.
+  // Returns nullopt if the samples of the sequence cannot be computed from
+  // their index.
+  virtual std::optional<std::vector<T>> GetSampleAt(int64_t index) const {
+    return std::nullopt;
+  }
+
   virtual ~Sequence() = default;
 };
 
@@ -74,6 +85,10 @@ class StoredSequence : public Sequence<T> {
     return dimensions;
   }
 
+  std::optional<std::vector<T>> GetSampleAt(int64_t index) const override {
+    return stored_sequence_[index % stored_sequence_.size()];
+  }
+
   StoredSequence() = delete;
   ~StoredSequence() override = default;
 
@@ -134,7 +149,7 @@ class Halton {
 
   // Returns the i'th value in the Halton sequence. Time complexity is
   // O(log(i)). We satisfy 0 < Get(i) < 1 for all i > 0.
-  double Get(int i) const {
+  double Get(int64_t i) const {
     CHECK_GT(i, 0);
     const double ib = 1.0 / base_;  // ib = inverted base
     double cdb = ib;                // cdb = current digit base = ib ^ position
@@ -190,18 +205,23 @@ class HaltonSequence : public HypercubeSequence<T> {
     InitializeHaltonGenerators(bases);
   }
   std::vector<T> GetSample() override {
-    std::vector<T> result(HypercubeSequence<T>::dimension_);
+    std::vector<T> result;
     do {
-      for (int i = 0; i < HypercubeSequence<T>::dimension_; ++i) {
-        result[i] = HypercubeSequence<T>::scale_ *
-                        halton_generators_[i]->Get(current_index_) +
-                    HypercubeSequence<T>::shift_;
-      }
-      ++current_index_;
+      result = PointAt(current_index_++);
     } while (sorted_only_ && !std::is_sorted(result.begin(), result.end()));
     return result;
   }
 
+  // Computes the Halton point of the index directly. Sequences that only keep
+  // sorted points cannot, since the index of a point depends on how many
+  // points were rejected before it.
+  std::optional<std::vector<T>> GetSampleAt(int64_t index) const override {
+    if (sorted_only_) {
+      return std::nullopt;
+    }
+    return PointAt(index + 1);
+  }
+
   HaltonSequence() = delete;
   ~HaltonSequence() override = default;
 
@@ -210,6 +230,17 @@ class HaltonSequence : public HypercubeSequence<T> {
   int64_t current_index_;
   bool sorted_only_;
 
+  // Returns the point at the given Halton index, which starts at 1.
+  std::vector<T> PointAt(int64_t halton_index) const {
+    std::vector<T> result(HypercubeSequence<T>::dimension_);
+    for (int i = 0; i < HypercubeSequence<T>::dimension_; ++i) {
+      result[i] = HypercubeSequence<T>::scale_ *
+                      halton_generators_[i]->Get(halton_index) +
+                  HypercubeSequence<T>::shift_;
+    }
+    return result;
+  }
+
   void InitializeHaltonGenerators(const std::vector<int>& bases) {
     CHECK(HypercubeSequence<T>::dimension_ == bases.size());
     halton_generators_.resize(bases.size());
@@ -218,6 +249,39 @@ class HaltonSequence : public HypercubeSequence<T> {
   }
 };
 
+// Index-addressable view of the first `size` samples of a sequence whose
+// samples can be computed from their index. Datasets are computed on access
+// and the view is immutable, so workers can fetch their shards of the datasets
+// in parallel without materializing the whole sequence. The sequence must
+// outlive the view.
+template <typename T>
+class LazyDatasets {
+ public:
+  LazyDatasets(const Sequence<T>* sequence, int64_t size)
+      : sequence_(sequence), size_(size) {
+    CHECK(sequence_->GetSampleAt(0).has_value())
+        << "The sequence cannot compute samples from their index.";
+  }
+
+  int64_t size() const { return size_; }
+
+  std::vector<T> operator[](int64_t index) const {
+    DCHECK(index >= 0 && index < size_);
+    return *sequence_->GetSampleAt(index);
+  }
+
+  // Returns the range [begin, end) of the indices of shard `shard` out of
+  // `num_shards` contiguous shards of about the same size.
+  std::pair<int64_t, int64_t> ShardBounds(int shard, int num_shards) const {
+    CHECK(shard >= 0 && shard < num_shards);
+    return {size_ * shard / num_shards, size_ * (shard + 1) / num_shards};
+  }
+
+ private:
+  const Sequence<T>* sequence_;
+  int64_t size_;
+};
+
 }  // namespace testing
 }  // namespace differential_privacy
 
@@ -16,6 +16,11 @@
 
 #include "testing/sequence.h"
 
+#include <cstdint>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/memory/memory.h"
@@ -127,6 +132,56 @@ TEST(HaltonTest, Base2) {
   }
 }
 
+TEST(StoredSequenceTest, GetSampleAtMatchesGetSample) {
+  StoredSequence<double> sequence({{1.0}, {1.0, 2.0}, {1.0, 2.0, 3.0}});
+  for (int i = 0; i < 7; ++i) {
+    const std::optional<std::vector<double>> sample = sequence.GetSampleAt(i);
+    ASSERT_TRUE(sample.has_value());
+    EXPECT_EQ(*sample, sequence.GetSample());
+  }
+}
+
+TEST(HaltonSequenceTest, GetSampleAtMatchesGetSample) {
+  HaltonSequence<double> sequence(kDimensions, /*sorted_only=*/false,
+                                  /*scale=*/2.0, /*shift=*/-1.0);
+  for (int i = 0; i < 100; ++i) {
+    const std::optional<std::vector<double>> sample = sequence.GetSampleAt(i);
+    ASSERT_TRUE(sample.has_value());
+    EXPECT_EQ(*sample, sequence.GetSample());
+  }
+}
+
+TEST(HaltonSequenceTest, SortedOnlyCannotGetSampleAt) {
+  HaltonSequence<double> sequence(kDimensions, /*sorted_only=*/true);
+  EXPECT_FALSE(sequence.GetSampleAt(0).has_value());
+}
+
+TEST(LazyDatasetsTest, ShardsCoverDatasetsInParallel) {
+  constexpr int kNumShards = 3;
+  HaltonSequence<double> sequence(kDimensions);
+  const LazyDatasets<double> datasets(&sequence, 100);
+
+  std::vector<std::vector<std::vector<double>>> shards(kNumShards);
+  std::vector<std::thread> threads;
+  for (int shard = 0; shard < kNumShards; ++shard) {
+    threads.emplace_back([&datasets, &shards, shard]() {
+      const auto [begin, end] = datasets.ShardBounds(shard, kNumShards);
+      for (int64_t i = begin; i < end; ++i) {
+        shards[shard].push_back(datasets[i]);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<std::vector<double>> merged;
+  for (const auto& shard : shards) {
+    merged.insert(merged.end(), shard.begin(), shard.end());
+  }
+  EXPECT_EQ(merged, GenerateSamplesFromSequence(&sequence, 100));
+}
+
 }  // namespace
 }  // namespace testing
 }  // namespace differential_privacy
@@ -16,11 +16,16 @@
 
 #include "testing/statistical_tests_utils.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
 
 #include "absl/random/distributions.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
 #include "algorithms/rand.h"
 #include "algorithms/util.h"
 #include "base/status_macros.h"
@@ -109,17 +114,94 @@ absl::StatusOr<bool> RunBallot(
   return accept_votes > reject_votes;
 }
 
+bool RunBallot(std::function<bool()> vote_generator, int number_of_votes,
+               int num_threads) {
+  return RunBallot([vote_generator = std::move(vote_generator)]()
+                       -> absl::StatusOr<bool> { return vote_generator(); },
+                   number_of_votes, num_threads)
+      .value_or(false);
+}
+
+absl::StatusOr<bool> RunBallot(
+    std::function<absl::StatusOr<bool>()> vote_generator, int number_of_votes,
+    int num_threads) {
+  DCHECK(number_of_votes > 0) << "The number of votes must be positive";
+  num_threads = std::clamp(num_threads, 1, number_of_votes);
+  if (num_threads == 1) {
+    return RunBallot(std::move(vote_generator), number_of_votes);
+  }
+
+  absl::Mutex mutex;
+  int started_votes = 0;
+  int accept_votes = 0;
+  int reject_votes = 0;
+  absl::Status status;
+  // Whether another vote may be started, i.e., no error occurred, the majority
+  // is not clear, and not all votes were started. Requires holding mutex.
+  auto needs_vote = [&]() {
+    return status.ok() &&
+           std::max(accept_votes, reject_votes) <= number_of_votes / 2 &&
+           started_votes < number_of_votes;
+  };
+  auto vote = [&]() {
+    while (true) {
+      {
+        absl::MutexLock lock(&mutex);
+        if (!needs_vote()) {
+          return;
+        }
+        ++started_votes;
+      }
+      absl::StatusOr<bool> result = vote_generator();
+      absl::MutexLock lock(&mutex);
+      if (!result.ok()) {
+        if (status.ok()) {
+          status = result.status();
+        }
+      } else {
+        (*result ? accept_votes : reject_votes)++;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (int i = 1; i < num_threads; ++i) {
+    threads.emplace_back(vote);
+  }
+  vote();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  RETURN_IF_ERROR(status);
+  return accept_votes > reject_votes;
+}
+
 bool GenerateClosenessVote(std::function<double()> sample_generator_a,
                            std::function<double()> sample_generator_b,
                            int number_of_samples, double l2_tolerance,
                            double granularity) {
+  return GenerateClosenessVote(
+      SampleFiller([&sample_generator_a](absl::Span<double> samples) {
+        for (double& sample : samples) sample = sample_generator_a();
+      }),
+      SampleFiller([&sample_generator_b](absl::Span<double> samples) {
+        for (double& sample : samples) sample = sample_generator_b();
+      }),
+      number_of_samples, l2_tolerance, granularity);
+}
+
+bool GenerateClosenessVote(const SampleFiller& sample_filler_a,
+                           const SampleFiller& sample_filler_b,
+                           int number_of_samples, double l2_tolerance,
+                           double granularity) {
   std::vector<double> samples_a(number_of_samples);
   std::vector<double> samples_b(number_of_samples);
+  sample_filler_a(absl::MakeSpan(samples_a));
+  sample_filler_b(absl::MakeSpan(samples_b));
   for (int i = 0; i < number_of_samples; i++) {
-    samples_a[i] =
-        RoundToNearestDoubleMultiple(sample_generator_a(), granularity);
-    samples_b[i] =
-        RoundToNearestDoubleMultiple(sample_generator_b(), granularity);
+    samples_a[i] = RoundToNearestDoubleMultiple(samples_a[i], granularity);
+    samples_b[i] = RoundToNearestDoubleMultiple(samples_b[i], granularity);
   }
   return VerifyCloseness(samples_a, samples_b, l2_tolerance);
 }
@@ -129,11 +211,28 @@ bool GenerateApproximateDpVote(std::function<double()> sample_generator_a,
                                int number_of_samples, double epsilon,
                                double delta, double delta_tolerance,
                                double granularity) {
+  return GenerateApproximateDpVote(
+      SampleFiller([&sample_generator_a](absl::Span<double> samples) {
+        for (double& sample : samples) sample = sample_generator_a();
+      }),
+      SampleFiller([&sample_generator_b](absl::Span<double> samples) {
+        for (double& sample : samples) sample = sample_generator_b();
+      }),
+      number_of_samples, epsilon, delta, delta_tolerance, granularity);
+}
+
+bool GenerateApproximateDpVote(const SampleFiller& sample_filler_a,
+                               const SampleFiller& sample_filler_b,
+                               int number_of_samples, double epsilon,
+                               double delta, double delta_tolerance,
+                               double granularity) {
   std::vector<double> samples_a(number_of_samples);
   std::vector<double> samples_b(number_of_samples);
+  sample_filler_a(absl::MakeSpan(samples_a));
+  sample_filler_b(absl::MakeSpan(samples_b));
   for (int i = 0; i < number_of_samples; ++i) {
-    samples_a[i] = RoundToNearestMultiple(sample_generator_a(), granularity);
-    samples_b[i] = RoundToNearestMultiple(sample_generator_b(), granularity);
+    samples_a[i] = RoundToNearestMultiple(samples_a[i], granularity);
+    samples_b[i] = RoundToNearestMultiple(samples_b[i], granularity);
   }
   return VerifyApproximateDp(samples_a, samples_b, epsilon, delta,
                              delta_tolerance);
@@ -146,4 +245,21 @@ int Bucketize(double sample, double lower, double upper, int num_buckets) {
                                          num_buckets))));
 }
 
+std::vector<int> Bucketize(absl::Span<const double> samples, double lower,
+                           double upper, int num_buckets) {
+  // Clamping in floating point before the conversion keeps the loop free of
+  // branches, and samples far out of bounds from overflowing the int. The
+  // bucket is computed exactly as by the scalar version, so that samples on
+  // bucket boundaries are assigned to the same bucket.
+  const double range = upper - lower;
+  const double last_bucket = num_buckets - 1;
+  std::vector<int> buckets(samples.size());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const double bucket =
+        std::floor(((samples[i] - lower) / range) * num_buckets);
+    buckets[i] = static_cast<int>(std::clamp(bucket, 0.0, last_bucket));
+  }
+  return buckets;
+}
+
 }  // namespace differential_privacy::testing
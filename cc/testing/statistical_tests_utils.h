@@ -20,12 +20,14 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <vector>
 
 #include "google/protobuf/text_format.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/log/check.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 #include "algorithms/rand.h"
 
 namespace differential_privacy::testing {
@@ -44,6 +46,18 @@ bool GenerateClosenessVote(std::function<double()> sample_generator_a,
                            int number_of_samples, double l2_tolerance,
                            double granularity);
 
+// Fills every element of the span with an independent sample of a
+// distribution. Generating the samples of a vote in one call saves the cost of
+// a call per sample, and lets generators reuse state, such as a mechanism,
+// across the samples.
+using SampleFiller = std::function<void(absl::Span<double>)>;
+
+// Same as above, with samples generated in batches.
+bool GenerateClosenessVote(const SampleFiller& sample_filler_a,
+                           const SampleFiller& sample_filler_b,
+                           int number_of_samples, double l2_tolerance,
+                           double granularity);
+
 template <typename T>
 double ComputeApproximateDpTestValue(
     absl::flat_hash_map<T, int64_t> histogram_a,
@@ -124,6 +138,13 @@ bool GenerateApproximateDpVote(std::function<double()> sample_generator_a,
                                double delta, double delta_tolerance,
                                double granularity);
 
+// Same as above, with samples generated in batches.
+bool GenerateApproximateDpVote(const SampleFiller& sample_filler_a,
+                               const SampleFiller& sample_filler_b,
+                               int number_of_samples, double epsilon,
+                               double delta, double delta_tolerance,
+                               double granularity);
+
 // Generates number_of_votes of votes from vote_generator to determine a
 // majority. Stops early as soon as the majority is clear. Returns the majority.
 bool RunBallot(std::function<bool()> vote_generator, int number_of_votes);
@@ -132,6 +153,17 @@ bool RunBallot(std::function<bool()> vote_generator, int number_of_votes);
 absl::StatusOr<bool> RunBallot(
     std::function<absl::StatusOr<bool>()> vote_generator, int number_of_votes);
 
+// Same as the overloads above, but generates the votes on num_threads threads,
+// so vote_generator must be safe to call concurrently. No new vote is started
+// once the majority is clear or a vote returned an error. The majority is the
+// same as for the serial ballot on the same votes, since no more than
+// number_of_votes votes are generated.
+bool RunBallot(std::function<bool()> vote_generator, int number_of_votes,
+               int num_threads);
+absl::StatusOr<bool> RunBallot(
+    std::function<absl::StatusOr<bool>()> vote_generator, int number_of_votes,
+    int num_threads);
+
 template <typename T>
 std::optional<T> ReadProto(std::istream* proto_file) {
   T tests;
@@ -165,6 +197,11 @@ std::optional<T> ReadProto(const std::string& path) {
 // assigned to the higher bin.
 int Bucketize(double sample, double lower, double upper, int num_buckets);
 
+// Bucketizes every sample as above and returns the bucket indices in the order
+// of the samples.
+std::vector<int> Bucketize(absl::Span<const double> samples, double lower,
+                           double upper, int num_buckets);
+
 }  // namespace differential_privacy::testing
 
 #endif  // DIFFERENTIAL_PRIVACY_CPP_TESTING_STATISTICAL_TESTS_UTILS_H_
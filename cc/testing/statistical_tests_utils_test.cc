@@ -16,10 +16,18 @@
 
 #include "testing/statistical_tests_utils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <vector>
+
 #include "google/protobuf/text_format.h"
 #include "base/testing/proto_matchers.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "algorithms/util.h"
 #include "proto/testing/statistical_tests.pb.h"
 
@@ -201,6 +209,31 @@ TEST(ApproximateDpVoteTest, InvariantToSampleOrder) {
       kDefaultL2Tolerance, /*granularity=*/1.0));
 }
 
+TEST(ApproximateDpVoteTest, SampleFillersMatchGenerators) {
+  std::vector<double> samples_a = {1.0, 2.0, 2.0, 3.0, 3.0, 3.0, 4.0, 4.0,
+                                   4.0, 4.0, 5.0, 5.0, 5.0, 5.0, 5.0};
+  std::vector<double> samples_b = {1.0, 1.0, 1.0, 1.0, 1.0, 2.0, 2.0, 2.0,
+                                   2.0, 3.0, 3.0, 3.0, 4.0, 4.0, 5.0};
+  auto filler = [](const std::vector<double>& samples) {
+    return SampleFiller([&samples](absl::Span<double> out) {
+      std::copy(samples.begin(), samples.begin() + out.size(), out.begin());
+    });
+  };
+
+  EXPECT_TRUE(GenerateApproximateDpVote(
+      filler(samples_a), filler(samples_b), samples_a.size(), kDefaultEpsilon,
+      kDefaultDelta, kHighDeltaTolerance, /*granularity=*/1.0));
+  EXPECT_FALSE(GenerateApproximateDpVote(
+      filler(samples_a), filler(samples_b), samples_a.size(), kDefaultEpsilon,
+      kDefaultDelta, kDefaultDeltaTolerance, /*granularity=*/1.0));
+  EXPECT_TRUE(GenerateClosenessVote(filler(samples_a), filler(samples_a),
+                                    samples_a.size(), kDefaultL2Tolerance,
+                                    /*granularity=*/1.0));
+  EXPECT_FALSE(GenerateClosenessVote(filler(samples_a), filler(samples_b),
+                                     samples_a.size(), kDefaultL2Tolerance,
+                                     /*granularity=*/1.0));
+}
+
 TEST(RunBallotTest, AcceptsMajorityTrue) {
   std::vector<bool> votes = {true, true, true, true, false, false, false};
   auto vote_it = votes.begin();
@@ -215,6 +248,39 @@ TEST(RunBallotTest, RejectsMajorityFalse) {
   EXPECT_FALSE(RunBallot(vote_generator, votes.size()));
 }
 
+TEST(RunBallotTest, ParallelBallotFindsMajority) {
+  for (const bool majority : {true, false}) {
+    std::atomic<int> num_votes = 0;
+    // Every third vote disagrees with the majority.
+    std::function<bool()> vote_generator = [&num_votes, majority]() {
+      return (num_votes++ % 3 == 2) != majority;
+    };
+    EXPECT_EQ(RunBallot(vote_generator, 101, /*num_threads=*/4), majority);
+    EXPECT_LE(num_votes, 101);
+  }
+}
+
+TEST(RunBallotTest, ParallelBallotStopsOnceMajorityIsClear) {
+  std::atomic<int> num_votes = 0;
+  std::function<bool()> vote_generator = [&num_votes]() {
+    ++num_votes;
+    return true;
+  };
+  EXPECT_TRUE(RunBallot(vote_generator, 1001, /*num_threads=*/4));
+  // At most one vote per thread may still be started before the majority of
+  // 501 votes is seen.
+  EXPECT_LE(num_votes, 501 + 4);
+}
+
+TEST(RunBallotTest, ParallelBallotReturnsError) {
+  std::function<absl::StatusOr<bool>()> vote_generator =
+      []() -> absl::StatusOr<bool> {
+    return absl::InternalError("Vote failed.");
+  };
+  EXPECT_EQ(RunBallot(vote_generator, 11, /*num_threads=*/4).status().code(),
+            absl::StatusCode::kInternal);
+}
+
 TEST(ReferenceLaplaceTest, HasAccurateStatisticalProperties) {
   double mean = 0.0;
   double variance = 2.0;
@@ -295,5 +361,16 @@ TEST(BucketizeTest, BucketizesCorrectly) {
   EXPECT_EQ(Bucketize(1, -5, 5, 10), 6);
 }
 
+TEST(BucketizeTest, BucketizesBatch) {
+  const std::vector<double> samples = {-4.5, -5, 0, 4.5, 5, 1, 9.99, -6};
+  std::vector<int> expected;
+  for (const double sample : samples) {
+    expected.push_back(Bucketize(sample, -5, 5, 10));
+  }
+  EXPECT_EQ(Bucketize(samples, -5, 5, 10), expected);
+  EXPECT_EQ(Bucketize(std::vector<double>{8, 7, 1e300, -1e300}, 0, 35, 5),
+            std::vector<int>({1, 1, 4, 0}));
+}
+
 }  // namespace
 }  // namespace differential_privacy::testing
@@ -18,12 +18,15 @@
 #ifndef DIFFERENTIAL_PRIVACY_TESTING_STOCHASTIC_TESTER_H_
 #define DIFFERENTIAL_PRIVACY_TESTING_STOCHASTIC_TESTER_H_
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <functional>
 #include <iomanip>
 #include <memory>
 #include <stack>
+#include <thread>  // NOLINT(build/c++11)
 #include <type_traits>
 #include <vector>
 
@@ -61,6 +64,10 @@ constexpr int MinimumBinCountSingle() { return 1; }
 template <typename OutputT>
 using AlgorithmResultSamples = std::vector<OutputT>;
 
+// Builds a new instance of the algorithm under test.
+template <typename T>
+using AlgorithmFactory = std::function<std::unique_ptr<Algorithm<T>>()>;
+
 using SelectionVector = std::vector<bool>;
 using SelectionVectorAndSizePair = std::pair<SelectionVector, size_t>;
 
@@ -90,22 +97,72 @@ class StochasticTester<T, OutputT> {
       int64_t num_datasets = DefaultNumDatasetsToTest(),
       int64_t num_samples_per_histogram = DefaultNumSamplesPerHistogram(),
       bool disable_search_branching = false)
-      : algorithm_(std::move(algorithm)),
-        sequence_(std::move(sequence)),
+      : sequence_(std::move(sequence)),
+        num_datasets_(num_datasets),
+        num_samples_per_histogram_(num_samples_per_histogram),
+        disable_search_branching_(disable_search_branching),
+        max_violation_pct_(0.0) {
+    algorithms_.push_back(std::move(algorithm));
+  }
+
+  // Generates the samples of every histogram on num_threads threads, each
+  // running its own instance of the algorithm built by algorithm_factory. The
+  // samples of the threads are merged before the histograms are compared, so
+  // the test is the same as with a single algorithm, only faster. The instances
+  // are built up front on the calling thread, so factories need not be thread
+  // safe; the algorithms themselves must not share mutable state.
+  StochasticTester(
+      const AlgorithmFactory<T>& algorithm_factory,
+      std::unique_ptr<Sequence<T>> sequence, int num_threads,
+      int64_t num_datasets = DefaultNumDatasetsToTest(),
+      int64_t num_samples_per_histogram = DefaultNumSamplesPerHistogram(),
+      bool disable_search_branching = false)
+      : sequence_(std::move(sequence)),
         num_datasets_(num_datasets),
         num_samples_per_histogram_(num_samples_per_histogram),
         disable_search_branching_(disable_search_branching),
-        max_violation_pct_(0.0) {}
+        max_violation_pct_(0.0) {
+    CHECK_GE(num_threads, 1);
+    for (int i = 0; i < num_threads; ++i) {
+      algorithms_.push_back(algorithm_factory());
+    }
+  }
 
   bool Run() {
-    Reset();
+    Reset(sequence_->NextNDimensions(num_datasets_));
+    return TestDatasets(num_datasets_,
+                        [this](int64_t) { return GenerateDataset(); });
+  }
+
+  // Tests only the datasets of shard `shard` out of `num_shards` contiguous
+  // shards of the first num_datasets samples of the sequence, which must
+  // support Sequence::GetSampleAt. The datasets are computed from their index
+  // without advancing the sequence, so testers on different workers can test
+  // their shards of the same sequence in parallel. The algorithm is DP on all
+  // datasets if every shard passes.
+  bool RunShard(int shard, int num_shards) {
+    const LazyDatasets<T> datasets(sequence_.get(), num_datasets_);
+    const auto [begin, end] = datasets.ShardBounds(shard, num_shards);
+    std::vector<int64_t> dimensions;
+    for (int64_t i = begin; i < end; ++i) {
+      dimensions.push_back(datasets[i].size());
+    }
+    Reset(dimensions);
+    return TestDatasets(end - begin, [&datasets, begin = begin](int64_t i) {
+      return datasets[begin + i];
+    });
+  }
 
-    // For each dataset, check each member of its powerset for whether it
-    // satisfies the dp predicate and record it in class variables. If too
-    // many failures are seen, return early.
+ private:
+  // For each of the num_datasets datasets returned by get_dataset, checks each
+  // member of its powerset for whether it satisfies the dp predicate and
+  // records it in class variables. If too many failures are seen, returns
+  // early.
+  template <typename GetDataset>
+  bool TestDatasets(int64_t num_datasets, GetDataset get_dataset) {
     const double num_failures_ok = kHistogramPaddingAlpha * num_comparison_;
-    for (int i = 0; i < num_datasets_; ++i) {
-      std::vector<T> dataset = GenerateDataset();
+    for (int64_t i = 0; i < num_datasets; ++i) {
+      const std::vector<T> dataset = get_dataset(i);
       CheckDifferentiallyPrivateOnDataset(dataset);
       if (num_comparison_failures_ > num_failures_ok) {
         LOG(INFO)
@@ -118,12 +175,11 @@ class StochasticTester<T, OutputT> {
     LOG(INFO) << "Across all datasets, proportion of comparisons failed: "
               << num_comparison_failures_ << " / " << num_comparison_;
     LOG(INFO) << absl::StrCat(
-        "Tested DP over ", num_datasets_,
+        "Tested DP over ", num_datasets,
         " dataset(s). (Maximum violation %: ", max_violation_pct_ * 100, ")");
     return true;
   }
 
- private:
   struct SelectionVectorHash {
     size_t operator()(const SelectionVector& v) const {
       const std::string serialized_v = absl::StrJoin(v, ".");
@@ -194,13 +250,49 @@ class StochasticTester<T, OutputT> {
 
   // Runs the DP algorithm over a dataset. In our case, the containers are
   // based on itertools iterators which do not necessarily have size functions,
-  // so we provide that interface here.
+  // so we provide that interface here. With several algorithm instances, every
+  // instance generates a contiguous block of the samples on its own thread.
   template <typename Container>
   std::vector<absl::StatusOr<OutputT>> GenerateSamples(Container* c,
                                                        size_t size) {
     std::vector<absl::StatusOr<OutputT>> samples(num_samples_per_histogram_);
-    for (int i = 0; i < num_samples_per_histogram_; ++i) {
-      absl::StatusOr<Output> output = algorithm_->Result(c->begin(), c->end());
+    const int64_t num_threads = std::min<int64_t>(algorithms_.size(),
+                                                  num_samples_per_histogram_);
+    if (num_threads <= 1) {
+      GenerateSampleRange(c, *algorithms_[0], 0, num_samples_per_histogram_,
+                          &samples);
+      return samples;
+    }
+    const int64_t chunk_size =
+        (num_samples_per_histogram_ + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (int64_t t = 1; t < num_threads; ++t) {
+      const int64_t begin =
+          std::min(num_samples_per_histogram_, t * chunk_size);
+      const int64_t end =
+          std::min(num_samples_per_histogram_, begin + chunk_size);
+      threads.emplace_back([this, c, begin, end, t, &samples]() {
+        GenerateSampleRange(c, *algorithms_[t], begin, end, &samples);
+      });
+    }
+    GenerateSampleRange(c, *algorithms_[0], 0,
+                        std::min(num_samples_per_histogram_, chunk_size),
+                        &samples);
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    return samples;
+  }
+
+  // Stores the results of running algorithm over the container in the samples
+  // with indices in [begin, end).
+  template <typename Container>
+  void GenerateSampleRange(Container* c, Algorithm<T>& algorithm,
+                           int64_t begin, int64_t end,
+                           std::vector<absl::StatusOr<OutputT>>* samples) {
+    for (int64_t i = begin; i < end; ++i) {
+      absl::StatusOr<Output> output = algorithm.Result(c->begin(), c->end());
 
       // Algorithms such as ApproxBounds may return an error status rather than
       // a value for some datasets on some occasions. In this case we wish to
@@ -208,12 +300,11 @@ class StochasticTester<T, OutputT> {
       // status as a regular value, to be substituted during histogram
       // generation.
       if (output.ok()) {
-        samples[i] = GetValue<OutputT>(output.value());
+        (*samples)[i] = GetValue<OutputT>(output.value());
       } else {
-        samples[i] = output.status();
+        (*samples)[i] = output.status();
       }
     }
-    return samples;
   }
 
   std::vector<T> GenerateDataset() { return sequence_->GetSample(); }
@@ -242,11 +333,12 @@ class StochasticTester<T, OutputT> {
     return value > boundary_max;
   }
 
-  void Reset() {
+  // Resets the counters for testing datasets of the given dimensions.
+  void Reset(const std::vector<int64_t>& dimensions) {
     max_violation_pct_ = 0.0;
     num_comparison_failures_ = 0;
     num_comparison_ = 0;
-    for (const int64_t d : sequence_->NextNDimensions(num_datasets_)) {
+    for (const int64_t d : dimensions) {
       // Without search branching, each subsequence only has 1 child.
       //
       // With search branching, for a sequence of size n, there are (n choose k)
@@ -266,7 +358,8 @@ class StochasticTester<T, OutputT> {
       std::vector<OutputT>* dx_value_samples,
       std::vector<OutputT>* dy_value_samples);
 
-  std::unique_ptr<Algorithm<T>> algorithm_;
+  // Instances of the algorithm under test, one per sampling thread.
+  std::vector<std::unique_ptr<Algorithm<T>>> algorithms_;
   std::unique_ptr<Sequence<T>> sequence_;
 
   int64_t num_datasets_;
@@ -424,7 +517,7 @@ bool StochasticTester<T, OutputT>::CheckDpPredicate(
   if (dx_samples.empty() || dy_samples.empty()) {
     return true;
   }
-  double epsilon = algorithm_->GetEpsilon();
+  double epsilon = algorithms_[0]->GetEpsilon();
 
   // Handle error outputs by replacing them with a default error value. We must
   // replace error values first and include them in the analysis to create the
@@ -445,14 +538,10 @@ bool StochasticTester<T, OutputT>::CheckDpPredicate(
   // small and far from this point.
   Histogram<OutputT> dx_hist(options.lowest, options.bin_width,
                              options.num_bins);
-  for (const OutputT& e : dx_value_samples) {
-    CHECK(dx_hist.Add(e).ok());
-  }
+  CHECK(dx_hist.AddAll(dx_value_samples).ok());
   Histogram<OutputT> dy_hist(options.lowest, options.bin_width,
                              options.num_bins);
-  for (const OutputT& e : dy_value_samples) {
-    CHECK(dy_hist.Add(e).ok());
-  }
+  CHECK(dy_hist.AddAll(dy_value_samples).ok());
 
   // The total number of actual buckets within the bounds is 1 fewer,
   // because there is an extra bucket on the upper extreme to consider values
@@ -199,6 +199,75 @@ TEST(StochasticTesterTest, SingleDatasetNonDpSumTest) {
   EXPECT_FALSE(tester.Run());
 }
 
+TEST(StochasticTesterTest, ParallelBoundedSumTest) {
+  auto sequence = std::make_unique<HaltonSequence<double>>(
+      DefaultDatasetSize(), /*sorted_only=*/true, DefaultDataScale(),
+      DefaultDataOffset());
+  const double lower = sequence->RangeMin();
+  const double upper = sequence->RangeMax();
+  AlgorithmFactory<double> factory = [lower, upper]() {
+    return std::unique_ptr<Algorithm<double>>(
+        BoundedSum<double>::Builder()
+            .SetLaplaceMechanism(
+                std::make_unique<test_utils::SeededLaplaceMechanism::Builder>())
+            .SetEpsilon(std::log(3))
+            .SetLower(lower)
+            .SetUpper(upper)
+            .Build()
+            .value());
+  };
+  StochasticTester<double> tester(factory, std::move(sequence),
+                                  /*num_threads=*/4, /*num_datasets=*/1,
+                                  DefaultNumSamplesPerHistogram());
+  EXPECT_TRUE(tester.Run());
+}
+
+TEST(StochasticTesterTest, ShardedBoundedSumTest) {
+  HaltonSequence<double> sequence(DefaultDatasetSize(), /*sorted_only=*/false,
+                                  DefaultDataScale(), DefaultDataOffset());
+  for (int shard = 0; shard < 2; ++shard) {
+    absl::StatusOr<std::unique_ptr<BoundedSum<double>>> algorithm =
+        BoundedSum<double>::Builder()
+            .SetLaplaceMechanism(
+                std::make_unique<test_utils::SeededLaplaceMechanism::Builder>())
+            .SetEpsilon(std::log(3))
+            .SetLower(sequence.RangeMin())
+            .SetUpper(sequence.RangeMax())
+            .Build();
+    ASSERT_TRUE(algorithm.ok());
+    StochasticTester<double, int64_t> tester(
+        std::move(*algorithm),
+        std::make_unique<HaltonSequence<double>>(
+            DefaultDatasetSize(), /*sorted_only=*/false, DefaultDataScale(),
+            DefaultDataOffset()),
+        /*num_datasets=*/4);
+    EXPECT_TRUE(tester.RunShard(shard, /*num_shards=*/2));
+  }
+}
+
+TEST(StochasticTesterTest, ShardedNonDpSumTest) {
+  auto algorithm = std::make_unique<NonDpSum<double>>();
+  auto sequence = std::make_unique<HaltonSequence<double>>(
+      DefaultDatasetSize(), /*sorted_only=*/false, DefaultDataScale(),
+      DefaultDataOffset());
+  StochasticTester<double> tester(std::move(algorithm), std::move(sequence),
+                                  /*num_datasets=*/2);
+  EXPECT_FALSE(tester.RunShard(/*shard=*/1, /*num_shards=*/2));
+}
+
+TEST(StochasticTesterTest, ParallelNonDpSumTest) {
+  auto sequence = std::make_unique<HaltonSequence<double>>(
+      DefaultDatasetSize(), /*sorted_only=*/true, DefaultDataScale(),
+      DefaultDataOffset());
+  AlgorithmFactory<double> factory = []() {
+    return std::make_unique<NonDpSum<double>>();
+  };
+  StochasticTester<double> tester(factory, std::move(sequence),
+                                  /*num_threads=*/4, /*num_datasets=*/1,
+                                  DefaultNumSamplesPerHistogram());
+  EXPECT_FALSE(tester.Run());
+}
+
 TEST(StochasticTesterTest, EmptySamplesCountTest) {
   std::vector<std::vector<double>> datasets({{1.0}});
   auto sequence = std::make_unique<StoredSequence<double>>(datasets);
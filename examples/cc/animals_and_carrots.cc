@@ -17,8 +17,7 @@
 #include "animals_and_carrots.h"
 
 #include <algorithm>
-#include <fstream>
-#include <map>
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -27,59 +26,97 @@
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
-#include "absl/strings/numbers.h"
-#include "absl/strings/str_split.h"
+#include "absl/types/span.h"
 #include "algorithms/bounded-mean.h"
 #include "algorithms/bounded-sum.h"
+#include "algorithms/columnar-input.h"
 #include "algorithms/count.h"
 #include "algorithms/quantiles.h"
 #include "proto/data.pb.h"
 #include "base/status_macros.h"
+#include "csv_reader.h"
 
 namespace differential_privacy {
 namespace example {
 
+namespace {
+
+// Column of the data file with the number of carrots eaten.
+constexpr int kCarrotsColumn = 1;
+
+}  // namespace
+
 CarrotReporter::CarrotReporter(std::string data_filename, double epsilon)
-    : total_epsilon_(epsilon), remaining_epsilon_(epsilon) {
-  std::ifstream file(data_filename);
-  CHECK(file.is_open()) << "could not open file " << data_filename;
-  std::string line;
-  while (getline(file, line)) {
-    std::vector<std::string> animal_and_count = absl::StrSplit(line, ',');
-    CHECK_EQ(animal_and_count.size(), 2);
-    int count;
-    CHECK(absl::SimpleAtoi(animal_and_count[1], &count));
-    carrots_per_animal_[animal_and_count[0]] = count;
+    : data_filename_(std::move(data_filename)),
+      total_epsilon_(epsilon),
+      remaining_epsilon_(epsilon) {
+  absl::StatusOr<std::unique_ptr<CsvReader>> reader =
+      CsvReader::Open(data_filename_);
+  CHECK(reader.ok()) << reader.status();
+}
+
+absl::Status CarrotReporter::ForEachChunk(
+    const std::function<void(absl::Span<const int> carrots)>& fn) {
+  ASSIGN_OR_RETURN(std::unique_ptr<CsvReader> reader,
+                   CsvReader::Open(data_filename_));
+  CsvChunk chunk;
+  std::vector<int> carrots;
+  while (true) {
+    ASSIGN_OR_RETURN(bool has_chunk, reader->NextChunk(&chunk));
+    if (!has_chunk) {
+      return absl::OkStatus();
+    }
+    if (chunk.columns.size() != 2) {
+      return absl::InvalidArgumentError(
+          "Every row must hold an animal and a number of carrots.");
+    }
+    RETURN_IF_ERROR(ParseColumn<int>(chunk.columns[kCarrotsColumn],
+                                     chunk.first_row, &carrots));
+    fn(carrots);
   }
 }
 
 int CarrotReporter::Sum() {
   int sum = 0;
-  for (const auto& pair : carrots_per_animal_) {
-    sum += pair.second;
-  }
+  CHECK_OK(ForEachChunk([&sum](absl::Span<const int> carrots) {
+    for (int count : carrots) {
+      sum += count;
+    }
+  }));
   return sum;
 }
 
 double CarrotReporter::Mean() {
-  return static_cast<double>(Sum()) / carrots_per_animal_.size();
+  int sum = 0;
+  int animals = 0;
+  CHECK_OK(ForEachChunk([&](absl::Span<const int> carrots) {
+    for (int count : carrots) {
+      sum += count;
+    }
+    animals += carrots.size();
+  }));
+  return static_cast<double>(sum) / animals;
 }
 
 int CarrotReporter::CountAbove(int limit) {
   int count = 0;
-  for (const auto& pair : carrots_per_animal_) {
-    if (pair.second > limit) {
-      ++count;
+  CHECK_OK(ForEachChunk([&](absl::Span<const int> carrots) {
+    for (int carrots_eaten : carrots) {
+      if (carrots_eaten > limit) {
+        ++count;
+      }
     }
-  }
+  }));
   return count;
 }
 
 int CarrotReporter::Max() {
   int max = 0;
-  for (const auto& pair : carrots_per_animal_) {
-    max = std::max(pair.second, max);
-  }
+  CHECK_OK(ForEachChunk([&max](absl::Span<const int> carrots) {
+    for (int count : carrots) {
+      max = std::max(count, max);
+    }
+  }));
   return max;
 }
 
@@ -96,9 +133,9 @@ absl::StatusOr<Output> CarrotReporter::PrivateSum(double epsilon) {
                        .SetLower(0)
                        .SetUpper(150)
                        .Build());
-  for (const auto& pair : carrots_per_animal_) {
-    sum_algorithm->AddEntry(pair.second);
-  }
+  RETURN_IF_ERROR(ForEachChunk([&](absl::Span<const int> carrots) {
+    AddColumn<int>(carrots, *sum_algorithm);
+  }));
   return sum_algorithm->PartialResult();
 }
 
@@ -109,9 +146,9 @@ absl::StatusOr<Output> CarrotReporter::PrivateMean(double epsilon) {
   remaining_epsilon_ -= epsilon;
   ASSIGN_OR_RETURN(std::unique_ptr<BoundedMean<int>> mean_algorithm,
                    BoundedMean<int>::Builder().SetEpsilon(epsilon).Build());
-  for (const auto& pair : carrots_per_animal_) {
-    mean_algorithm->AddEntry(pair.second);
-  }
+  RETURN_IF_ERROR(ForEachChunk([&](absl::Span<const int> carrots) {
+    AddColumn<int>(carrots, *mean_algorithm);
+  }));
   return mean_algorithm->PartialResult();
 }
 
@@ -121,14 +158,19 @@ absl::StatusOr<Output> CarrotReporter::PrivateCountAbove(double epsilon,
     return absl::InvalidArgumentError("Not enough privacy budget.");
   }
   remaining_epsilon_ -= epsilon;
-  ASSIGN_OR_RETURN(std::unique_ptr<Count<std::string>> count_algorithm,
-                   Count<std::string>::Builder().SetEpsilon(epsilon).Build());
-
-  for (const auto& pair : carrots_per_animal_) {
-    if (pair.second > limit) {
-      count_algorithm->AddEntry(pair.first);
+  ASSIGN_OR_RETURN(std::unique_ptr<Count<int>> count_algorithm,
+                   Count<int>::Builder().SetEpsilon(epsilon).Build());
+
+  std::vector<int> above;
+  RETURN_IF_ERROR(ForEachChunk([&](absl::Span<const int> carrots) {
+    above.clear();
+    for (int count : carrots) {
+      if (count > limit) {
+        above.push_back(count);
+      }
     }
-  }
+    AddColumn<int>(above, *count_algorithm);
+  }));
   return count_algorithm->PartialResult();
 }
 
@@ -144,9 +186,9 @@ absl::StatusOr<Output> CarrotReporter::PrivateMax(double epsilon) {
                        .SetUpper(150)
                        .SetQuantiles({1})
                        .Build());
-  for (const auto& pair : carrots_per_animal_) {
-    max_algorithm->AddEntry(pair.second);
-  }
+  RETURN_IF_ERROR(ForEachChunk([&](absl::Span<const int> carrots) {
+    AddColumn<int>(carrots, *max_algorithm);
+  }));
   return max_algorithm->PartialResult();
 }
 
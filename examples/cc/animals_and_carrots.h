@@ -17,10 +17,12 @@
 #ifndef DIFFERENTIAL_PRIVACY_EXAMPLE_ANIMALS_AND_CARROTS_H_
 #define DIFFERENTIAL_PRIVACY_EXAMPLE_ANIMALS_AND_CARROTS_H_
 
-#include <map>
+#include <functional>
 #include <string>
 
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "proto/data.pb.h"
 
 namespace differential_privacy {
@@ -31,10 +33,12 @@ namespace example {
 // Fred.
 class CarrotReporter {
  public:
-  // Loads all the animals and carrots data from the file specified by
-  // data_filename into the map carrots_per_animal_. Epsilon is the differential
-  // privacy parameter. Epsilon is shared between all private function calls.
-  // The fraction of epsilon remaining is tracked by remaining_epsilon_.
+  // Reads the animals and carrots data from the file specified by
+  // data_filename. The data is not loaded into memory: every statistic streams
+  // it from the file, so that the file may be larger than memory. Epsilon is
+  // the differential privacy parameter. Epsilon is shared between all private
+  // function calls. The fraction of epsilon remaining is tracked by
+  // remaining_epsilon_.
   CarrotReporter(std::string data_filename, double total_epsilon);
 
   // True sum of all the carrots eaten.
@@ -74,8 +78,13 @@ class CarrotReporter {
   absl::StatusOr<Output> PrivateMax(double epsilon);
 
  private:
-  // Map from the animal name to the number of carrots eaten by that animal.
-  std::map<std::string, int> carrots_per_animal_;
+  // Calls fn with the numbers of carrots eaten by the animals of every chunk of
+  // rows of the data file.
+  absl::Status ForEachChunk(
+      const std::function<void(absl::Span<const int> carrots)>& fn);
+
+  // File with one row per animal: its name and the number of carrots it ate.
+  std::string data_filename_;
 
   // Differential privacy parameter epsilon. A larger epsilon corresponds to
   // less privacy and more accuracy.
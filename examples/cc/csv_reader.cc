@@ -0,0 +1,209 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "csv_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace differential_privacy {
+namespace example {
+
+absl::StatusOr<std::unique_ptr<CsvReader>> CsvReader::Open(
+    const std::string& filename, Options options) {
+  if (options.chunk_rows == 0) {
+    return absl::InvalidArgumentError("Chunks must hold at least one row.");
+  }
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return absl::NotFoundError(absl::StrCat("Could not open file ", filename,
+                                            ": ", std::strerror(errno)));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    const int error = errno;
+    close(fd);
+    return absl::InternalError(absl::StrCat("Could not stat file ", filename,
+                                            ": ", std::strerror(error)));
+  }
+  const size_t size = file_stat.st_size;
+  const char* data = nullptr;
+  // Empty files cannot be mapped, and have no rows.
+  if (size > 0) {
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      const int error = errno;
+      close(fd);
+      return absl::InternalError(absl::StrCat("Could not map file ", filename,
+                                              ": ", std::strerror(error)));
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapping);
+  }
+  // The mapping stays valid after the file is closed.
+  close(fd);
+
+  std::unique_ptr<CsvReader> reader(new CsvReader(data, size, options));
+  if (options.has_header) {
+    std::vector<absl::string_view> fields;
+    std::deque<std::string> unescaped;
+    if (reader->NextRow(&fields, &unescaped)) {
+      for (absl::string_view field : fields) {
+        reader->header_.emplace_back(field);
+      }
+      reader->num_fields_ = fields.size();
+      ++reader->row_number_;
+    }
+  }
+  return reader;
+}
+
+CsvReader::~CsvReader() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+bool CsvReader::NextRow(std::vector<absl::string_view>* fields,
+                        std::deque<std::string>* unescaped) {
+  fields->clear();
+  if (position_ >= size_) {
+    return false;
+  }
+  const char delimiter = options_.delimiter;
+  while (true) {
+    size_t end;
+    if (data_[position_] == '"') {
+      // Quoted field. Doubled quotes stand for one quote, in which case the
+      // field is unescaped into the chunk.
+      const size_t begin = position_ + 1;
+      size_t i = begin;
+      bool escaped = false;
+      while (i < size_) {
+        if (data_[i] == '"') {
+          if (i + 1 < size_ && data_[i + 1] == '"') {
+            escaped = true;
+            i += 2;
+            continue;
+          }
+          break;
+        }
+        ++i;
+      }
+      absl::string_view field(data_ + begin, i - begin);
+      if (escaped) {
+        std::string& storage = unescaped->emplace_back();
+        storage.reserve(field.size());
+        for (size_t k = 0; k < field.size(); ++k) {
+          storage.push_back(field[k]);
+          if (field[k] == '"') ++k;
+        }
+        field = storage;
+      }
+      fields->push_back(field);
+      // Skip the closing quote.
+      end = i < size_ ? i + 1 : i;
+    } else {
+      end = position_;
+      while (end < size_ && data_[end] != delimiter && data_[end] != '\n') {
+        ++end;
+      }
+      absl::string_view field(data_ + position_, end - position_);
+      if (end < size_ && data_[end] == '\n' && !field.empty() &&
+          field.back() == '\r') {
+        field.remove_suffix(1);
+      }
+      fields->push_back(field);
+    }
+    if (end < size_ && data_[end] == '\r' && end + 1 < size_ &&
+        data_[end + 1] == '\n') {
+      ++end;
+    }
+    if (end >= size_ || data_[end] == '\n') {
+      position_ = end + 1;
+      return true;
+    }
+    // Anything but a delimiter after a quoted field is kept in the next field.
+    position_ = data_[end] == delimiter ? end + 1 : end;
+    if (position_ >= size_) {
+      // A trailing delimiter ends the row with an empty field.
+      fields->push_back(absl::string_view());
+      return true;
+    }
+  }
+}
+
+void CsvReader::ReleaseParsedPages() {
+  static const size_t kPageSize = sysconf(_SC_PAGESIZE);
+  const size_t release_end = position_ / kPageSize * kPageSize;
+  if (data_ != nullptr && release_end > released_) {
+    // Parsed pages are read again from the file if they are accessed again, so
+    // this only bounds the memory that the reader keeps resident.
+    madvise(const_cast<char*>(data_) + released_, release_end - released_,
+            MADV_DONTNEED);
+    released_ = release_end;
+  }
+}
+
+absl::StatusOr<bool> CsvReader::NextChunk(CsvChunk* chunk) {
+  ReleaseParsedPages();
+  chunk->columns.clear();
+  chunk->unescaped.clear();
+  std::vector<absl::string_view> fields;
+  while (chunk->num_rows() < options_.chunk_rows &&
+         NextRow(&fields, &chunk->unescaped)) {
+    const int64_t row_number = row_number_++;
+    // Empty lines hold no row.
+    if (fields.size() == 1 && fields[0].empty()) {
+      continue;
+    }
+    if (num_fields_ == 0) {
+      num_fields_ = fields.size();
+    } else if (fields.size() != num_fields_) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Row ", row_number, " has ", fields.size(),
+                       " fields, but the first row has ", num_fields_, "."));
+    }
+    if (chunk->columns.empty()) {
+      chunk->first_row = row_number;
+      chunk->columns.resize(num_fields_);
+      for (std::vector<absl::string_view>& column : chunk->columns) {
+        column.reserve(options_.chunk_rows);
+      }
+    }
+    for (size_t i = 0; i < fields.size(); ++i) {
+      chunk->columns[i].push_back(fields[i]);
+    }
+  }
+  return !chunk->columns.empty();
+}
+
+}  // namespace example
+}  // namespace differential_privacy
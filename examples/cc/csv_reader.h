@@ -0,0 +1,165 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef DIFFERENTIAL_PRIVACY_EXAMPLE_CSV_READER_H_
+#define DIFFERENTIAL_PRIVACY_EXAMPLE_CSV_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/columnar-input.h"
+#include "base/status_macros.h"
+
+namespace differential_privacy {
+namespace example {
+
+// A chunk of consecutive rows of a delimited file, stored by column. Fields
+// point into the memory mapped file, or into the chunk for quoted fields with
+// escaped quotes, and are valid until the next call to CsvReader::NextChunk.
+struct CsvChunk {
+  std::vector<std::vector<absl::string_view>> columns;
+  // Number of the first row of the chunk in the file, starting at 1.
+  int64_t first_row = 0;
+
+  size_t num_rows() const { return columns.empty() ? 0 : columns[0].size(); }
+
+  // Storage of unescaped quoted fields.
+  std::deque<std::string> unescaped;
+};
+
+// Streaming reader of comma- or tab-separated files. The file is memory mapped
+// and parsed in chunks of rows, so that files larger than memory can be read
+// with the memory of one chunk: pages of the file that were parsed are released
+// as the reader advances. Every row must have the same number of fields. Fields
+// may be enclosed in double quotes, in which case they may contain delimiters,
+// newlines and doubled double quotes.
+class CsvReader {
+ public:
+  struct Options {
+    char delimiter = ',';
+    // Maximum number of rows per chunk.
+    size_t chunk_rows = 4096;
+    // Whether the first row holds the column names, which are then skipped.
+    bool has_header = false;
+  };
+
+  static absl::StatusOr<std::unique_ptr<CsvReader>> Open(
+      const std::string& filename, Options options);
+  static absl::StatusOr<std::unique_ptr<CsvReader>> Open(
+      const std::string& filename) {
+    return Open(filename, Options());
+  }
+
+  ~CsvReader();
+
+  CsvReader(const CsvReader&) = delete;
+  CsvReader& operator=(const CsvReader&) = delete;
+
+  // Parses the next chunk of rows into chunk, replacing its contents. Returns
+  // false once all rows were read, and an error for malformed rows.
+  absl::StatusOr<bool> NextChunk(CsvChunk* chunk);
+
+  // Column names of the header row, if Options::has_header.
+  const std::vector<std::string>& header() const { return header_; }
+
+ private:
+  CsvReader(const char* data, size_t size, Options options)
+      : data_(data), size_(size), options_(options) {}
+
+  // Parses the next row into fields. Returns false at the end of the file.
+  bool NextRow(std::vector<absl::string_view>* fields,
+               std::deque<std::string>* unescaped);
+
+  // Releases the pages of the mapping before the current position.
+  void ReleaseParsedPages();
+
+  const char* data_;
+  size_t size_;
+  Options options_;
+  size_t position_ = 0;
+  size_t released_ = 0;
+  int64_t row_number_ = 1;
+  // Number of fields of every row, or 0 before the first row.
+  size_t num_fields_ = 0;
+  std::vector<std::string> header_;
+};
+
+// Parses the fields of a column as numbers into values, replacing its
+// contents. first_row is the number of the row of the first field. Returns an
+// error naming the row of the first field that is not a number of type T.
+template <typename T>
+absl::Status ParseColumn(absl::Span<const absl::string_view> fields,
+                         int64_t first_row, std::vector<T>* values) {
+  values->clear();
+  values->reserve(fields.size());
+  for (size_t i = 0; i < fields.size(); ++i) {
+    T value;
+    bool parsed;
+    if constexpr (std::is_integral_v<T>) {
+      parsed = absl::SimpleAtoi(fields[i], &value);
+    } else if constexpr (std::is_same_v<T, float>) {
+      parsed = absl::SimpleAtof(fields[i], &value);
+    } else {
+      parsed = absl::SimpleAtod(fields[i], &value);
+    }
+    if (!parsed) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Row ", first_row + i, ": \"", fields[i],
+                       "\" is not a number."));
+    }
+    values->push_back(value);
+  }
+  return absl::OkStatus();
+}
+
+// Reads the numbers of a column of every row of the reader and adds them to
+// the algorithm, one batch per chunk.
+template <typename T>
+absl::Status AddCsvColumn(CsvReader& reader, int column,
+                          Algorithm<T>& algorithm) {
+  CsvChunk chunk;
+  std::vector<T> values;
+  while (true) {
+    ASSIGN_OR_RETURN(bool has_chunk, reader.NextChunk(&chunk));
+    if (!has_chunk) {
+      return absl::OkStatus();
+    }
+    if (column < 0 || column >= static_cast<int>(chunk.columns.size())) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("The file has no column ", column, "."));
+    }
+    RETURN_IF_ERROR(
+        ParseColumn<T>(chunk.columns[column], chunk.first_row, &values));
+    AddColumn<T>(values, algorithm);
+  }
+}
+
+}  // namespace example
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_EXAMPLE_CSV_READER_H_
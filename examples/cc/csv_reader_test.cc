@@ -0,0 +1,175 @@
+//
+// Copyright 2019 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "csv_reader.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/testing/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "algorithms/bounded-sum.h"
+#include "proto/util.h"
+
+namespace differential_privacy {
+namespace example {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+// Writes contents to a new file in the test temporary directory.
+std::string WriteFile(absl::string_view name, absl::string_view contents) {
+  const char* tmpdir = std::getenv("TEST_TMPDIR");
+  const std::string path =
+      absl::StrCat(tmpdir != nullptr ? tmpdir : "/tmp", "/", name);
+  std::ofstream file(path, std::ios::binary);
+  file << contents;
+  return path;
+}
+
+std::vector<std::string> Strings(
+    const std::vector<absl::string_view>& strings) {
+  return std::vector<std::string>(strings.begin(), strings.end());
+}
+
+TEST(CsvReaderTest, ReadsColumnsInChunks) {
+  const std::string path = WriteFile("chunks.csv", "a,1\nb,2\nc,3\n");
+  CsvReader::Options options;
+  options.chunk_rows = 2;
+  std::unique_ptr<CsvReader> reader =
+      CsvReader::Open(path, options).value();
+  CsvChunk chunk;
+
+  absl::StatusOr<bool> has_chunk = reader->NextChunk(&chunk);
+  ASSERT_OK(has_chunk);
+  ASSERT_TRUE(*has_chunk);
+  EXPECT_EQ(chunk.first_row, 1);
+  EXPECT_THAT(Strings(chunk.columns[0]), ElementsAre("a", "b"));
+  EXPECT_THAT(Strings(chunk.columns[1]), ElementsAre("1", "2"));
+
+  has_chunk = reader->NextChunk(&chunk);
+  ASSERT_OK(has_chunk);
+  ASSERT_TRUE(*has_chunk);
+  EXPECT_EQ(chunk.first_row, 3);
+  EXPECT_THAT(Strings(chunk.columns[0]), ElementsAre("c"));
+
+  has_chunk = reader->NextChunk(&chunk);
+  ASSERT_OK(has_chunk);
+  EXPECT_FALSE(*has_chunk);
+}
+
+TEST(CsvReaderTest, ReadsHeaderTabsAndQuotes) {
+  const std::string path =
+      WriteFile("quotes.tsv",
+                "name\tcomment\r\nx\t\"tab\there\"\r\n"
+                "y\t\"say \"\"hi\"\"\"");
+  CsvReader::Options options;
+  options.delimiter = '\t';
+  options.has_header = true;
+  std::unique_ptr<CsvReader> reader =
+      CsvReader::Open(path, options).value();
+  EXPECT_THAT(reader->header(), ElementsAre("name", "comment"));
+  CsvChunk chunk;
+
+  absl::StatusOr<bool> has_chunk = reader->NextChunk(&chunk);
+  ASSERT_OK(has_chunk);
+  ASSERT_TRUE(*has_chunk);
+  EXPECT_EQ(chunk.first_row, 2);
+  EXPECT_THAT(Strings(chunk.columns[0]), ElementsAre("x", "y"));
+  EXPECT_THAT(Strings(chunk.columns[1]),
+              ElementsAre("tab\there", "say \"hi\""));
+}
+
+TEST(CsvReaderTest, RejectsRowsOfDifferentLengths) {
+  const std::string path = WriteFile("lengths.csv", "a,1\nb\n");
+  std::unique_ptr<CsvReader> reader = CsvReader::Open(path).value();
+  CsvChunk chunk;
+
+  absl::StatusOr<bool> has_chunk = reader->NextChunk(&chunk);
+
+  EXPECT_EQ(has_chunk.status().code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_THAT(has_chunk.status().message(), HasSubstr("Row 2 has 1 fields"));
+}
+
+TEST(CsvReaderTest, ReadsEmptyFile) {
+  const std::string path = WriteFile("empty.csv", "");
+  std::unique_ptr<CsvReader> reader = CsvReader::Open(path).value();
+  CsvChunk chunk;
+
+  absl::StatusOr<bool> has_chunk = reader->NextChunk(&chunk);
+  ASSERT_OK(has_chunk);
+
+  EXPECT_FALSE(*has_chunk);
+}
+
+TEST(CsvReaderTest, MissingFile) {
+  EXPECT_EQ(CsvReader::Open("/nonexistent/file.csv").status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST(CsvReaderTest, AddsColumnToAlgorithm) {
+  std::string contents;
+  int64_t expected = 0;
+  for (int i = 0; i < 10000; ++i) {
+    absl::StrAppend(&contents, "animal", i, ",", i % 100, "\n");
+    expected += i % 100;
+  }
+  const std::string path = WriteFile("column.csv", contents);
+  std::unique_ptr<CsvReader> reader = CsvReader::Open(path).value();
+  std::unique_ptr<BoundedSum<int64_t>> sum =
+      BoundedSum<int64_t>::Builder()
+          .SetEpsilon(1e10)
+          .SetLower(0)
+          .SetUpper(100)
+          .Build()
+          .value();
+
+  ASSERT_OK(AddCsvColumn<int64_t>(*reader, 1, *sum));
+
+  absl::StatusOr<Output> output = sum->PartialResult();
+  ASSERT_OK(output);
+  EXPECT_NEAR(GetValue<int64_t>(*output), expected, 10);
+}
+
+TEST(CsvReaderTest, ReportsMalformedNumbers) {
+  const std::string path = WriteFile("numbers.csv", "a,1\nb,two\n");
+  std::unique_ptr<CsvReader> reader = CsvReader::Open(path).value();
+  std::unique_ptr<BoundedSum<int64_t>> sum =
+      BoundedSum<int64_t>::Builder()
+          .SetEpsilon(1)
+          .SetLower(0)
+          .SetUpper(10)
+          .Build()
+          .value();
+
+  absl::Status status = AddCsvColumn<int64_t>(*reader, 1, *sum);
+
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_THAT(status.message(), HasSubstr("Row 2"));
+}
+
+}  // namespace
+}  // namespace example
+}  // namespace differential_privacy
@@ -0,0 +1,745 @@
+//
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "compiled_query.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/analyzer_options.h"
+#include "zetasql/public/analyzer_output.h"
+#include "zetasql/public/catalog.h"
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "algorithms/algorithm.h"
+#include "algorithms/bounded-mean.h"
+#include "algorithms/bounded-sum.h"
+#include "algorithms/partition-selection.h"
+#include "base/status_macros.h"
+#include "proto/data.pb.h"
+
+namespace differential_privacy {
+namespace zetasql_example {
+namespace {
+
+absl::Status Unsupported(absl::string_view what) {
+  return absl::UnimplementedError(
+      absl::StrCat("Compiled execution does not support ", what, "."));
+}
+
+enum class AggregateKind { kCount, kCountStar, kSum, kAvg };
+
+// A column of the table that the scan stage reads.
+struct InputColumn {
+  int table_index;
+  // Whether the values are cast to a number. Otherwise, they are read as group
+  // keys and for the nulls that ANON_COUNT skips.
+  bool numeric;
+};
+
+struct AggregateSpec {
+  AggregateKind kind;
+  // Index of the input column of the argument, or -1 for ANON_COUNT(*).
+  int input = -1;
+  std::optional<double> lower;
+  std::optional<double> upper;
+  bool integer_result = false;
+};
+
+// An output column is either a group by column or an aggregate.
+struct OutputColumn {
+  std::string name;
+  bool is_group;
+  int index;
+};
+
+struct Plan {
+  const zetasql::Table* table = nullptr;
+  int userid_index = -1;
+  std::vector<InputColumn> inputs;
+  // Indices of the input columns of the group by columns.
+  std::vector<int> group_inputs;
+  std::vector<AggregateSpec> aggregates;
+  std::vector<OutputColumn> outputs;
+  double epsilon = 0;
+  double delta = 0;
+  int64_t kappa = 0;
+};
+
+// Returns the value of a literal as a double.
+absl::StatusOr<double> LiteralAsDouble(const zetasql::ResolvedExpr* expr) {
+  if (!expr->Is<zetasql::ResolvedLiteral>()) {
+    return Unsupported("non-literal bounds and anonymization options");
+  }
+  const zetasql::Value& value =
+      expr->GetAs<zetasql::ResolvedLiteral>()->value();
+  switch (value.type_kind()) {
+    case zetasql::TypeKind::TYPE_INT32:
+      return value.int32_value();
+    case zetasql::TypeKind::TYPE_INT64:
+      return value.int64_value();
+    case zetasql::TypeKind::TYPE_DOUBLE:
+      return value.double_value();
+    default:
+      return Unsupported("literals that are not INT32, INT64 or DOUBLE");
+  }
+}
+
+// Compiles the anonymized aggregate scan of a query into a plan.
+class PlanCompiler {
+ public:
+  explicit PlanCompiler(absl::string_view userid_col)
+      : userid_col_(userid_col) {}
+
+  absl::StatusOr<Plan> Compile(const zetasql::ResolvedQueryStmt& stmt) {
+    const zetasql::ResolvedScan* scan = stmt.query();
+    // Project scans without expressions only select the aggregate columns.
+    while (scan->Is<zetasql::ResolvedProjectScan>() &&
+           scan->GetAs<zetasql::ResolvedProjectScan>()->expr_list().empty()) {
+      scan = scan->GetAs<zetasql::ResolvedProjectScan>()->input_scan();
+    }
+    if (!scan->Is<zetasql::ResolvedAnonymizedAggregateScan>()) {
+      return Unsupported(absl::StrCat("queries whose top scan is a ",
+                                      scan->node_kind_string()));
+    }
+    const auto* aggregate_scan =
+        scan->GetAs<zetasql::ResolvedAnonymizedAggregateScan>();
+    RETURN_IF_ERROR(CompileOptions(*aggregate_scan));
+    RETURN_IF_ERROR(CompileInputScan(aggregate_scan->input_scan()));
+
+    absl::flat_hash_map<int, OutputColumn> outputs_by_id;
+    for (const auto& group_by : aggregate_scan->group_by_list()) {
+      ASSIGN_OR_RETURN(int input, Input(group_by->expr()));
+      if (plan_.inputs[input].numeric) {
+        return Unsupported("grouping by numeric casts");
+      }
+      outputs_by_id[group_by->column().column_id()] = {
+          "", /*is_group=*/true, static_cast<int>(plan_.group_inputs.size())};
+      plan_.group_inputs.push_back(input);
+    }
+    for (const auto& aggregate : aggregate_scan->aggregate_list()) {
+      if (!aggregate->Is<zetasql::ResolvedComputedColumn>()) {
+        return Unsupported("deferred aggregate columns");
+      }
+      const auto* computed =
+          aggregate->GetAs<zetasql::ResolvedComputedColumn>();
+      ASSIGN_OR_RETURN(AggregateSpec spec, CompileAggregate(*computed));
+      outputs_by_id[computed->column().column_id()] = {
+          "", /*is_group=*/false, static_cast<int>(plan_.aggregates.size())};
+      plan_.aggregates.push_back(spec);
+    }
+
+    for (const auto& output_column : stmt.output_column_list()) {
+      auto it = outputs_by_id.find(output_column->column().column_id());
+      if (it == outputs_by_id.end()) {
+        return Unsupported("output columns computed after the aggregation");
+      }
+      OutputColumn column = it->second;
+      column.name = output_column->name();
+      plan_.outputs.push_back(column);
+    }
+    return std::move(plan_);
+  }
+
+ private:
+  // Reads epsilon, delta and kappa from the anonymization options.
+  absl::Status CompileOptions(
+      const zetasql::ResolvedAnonymizedAggregateScan& scan) {
+    for (const auto& option : scan.anonymization_option_list()) {
+      ASSIGN_OR_RETURN(double value, LiteralAsDouble(option->value()));
+      if (absl::EqualsIgnoreCase(option->name(), "epsilon")) {
+        plan_.epsilon = value;
+      } else if (absl::EqualsIgnoreCase(option->name(), "delta")) {
+        plan_.delta = value;
+      } else if (absl::EqualsIgnoreCase(option->name(), "kappa")) {
+        plan_.kappa = static_cast<int64_t>(value);
+      } else {
+        return Unsupported(
+            absl::StrCat("the anonymization option ", option->name()));
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  // Maps the columns of the input scan to the columns of the table.
+  absl::Status CompileInputScan(const zetasql::ResolvedScan* scan) {
+    if (scan->Is<zetasql::ResolvedProjectScan>()) {
+      const auto* project = scan->GetAs<zetasql::ResolvedProjectScan>();
+      RETURN_IF_ERROR(CompileInputScan(project->input_scan()));
+      for (const auto& computed : project->expr_list()) {
+        ASSIGN_OR_RETURN(ColumnSource source, Source(computed->expr()));
+        sources_[computed->column().column_id()] = source;
+      }
+      return absl::OkStatus();
+    }
+    if (!scan->Is<zetasql::ResolvedTableScan>()) {
+      return Unsupported(
+          absl::StrCat("input scans of kind ", scan->node_kind_string()));
+    }
+    const auto* table_scan = scan->GetAs<zetasql::ResolvedTableScan>();
+    plan_.table = table_scan->table();
+    for (int i = 0; i < table_scan->column_list_size(); ++i) {
+      sources_[table_scan->column_list(i).column_id()] = {
+          table_scan->column_index_list(i), /*numeric=*/false};
+    }
+    for (int i = 0; i < plan_.table->NumColumns(); ++i) {
+      if (plan_.table->GetColumn(i)->Name() == userid_col_) {
+        plan_.userid_index = i;
+      }
+    }
+    if (plan_.userid_index < 0) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("The table has no user id column ", userid_col_, "."));
+    }
+    return absl::OkStatus();
+  }
+
+  // A column of the table, optionally cast to a number.
+  struct ColumnSource {
+    int table_index;
+    bool numeric;
+  };
+
+  // Returns the column of the table that an expression reads. Supports column
+  // references and numeric casts of them.
+  absl::StatusOr<ColumnSource> Source(const zetasql::ResolvedExpr* expr) {
+    bool numeric = false;
+    if (expr->Is<zetasql::ResolvedCast>()) {
+      const zetasql::Type* type = expr->type();
+      if (!type->IsInteger() && !type->IsDouble()) {
+        return Unsupported("casts to types other than integers and DOUBLE");
+      }
+      numeric = true;
+      expr = expr->GetAs<zetasql::ResolvedCast>()->expr();
+    }
+    if (!expr->Is<zetasql::ResolvedColumnRef>()) {
+      return Unsupported(absl::StrCat("expressions of kind ",
+                                      expr->node_kind_string()));
+    }
+    auto it = sources_.find(
+        expr->GetAs<zetasql::ResolvedColumnRef>()->column().column_id());
+    if (it == sources_.end()) {
+      return absl::InternalError("Column reference to an unknown column.");
+    }
+    return ColumnSource{it->second.table_index, numeric || it->second.numeric};
+  }
+
+  // Returns the index of the input column that an expression reads, adding it
+  // to the plan if needed.
+  absl::StatusOr<int> Input(const zetasql::ResolvedExpr* expr) {
+    ASSIGN_OR_RETURN(ColumnSource source, Source(expr));
+    for (size_t i = 0; i < plan_.inputs.size(); ++i) {
+      if (plan_.inputs[i].table_index == source.table_index &&
+          plan_.inputs[i].numeric == source.numeric) {
+        return static_cast<int>(i);
+      }
+    }
+    plan_.inputs.push_back({source.table_index, source.numeric});
+    return static_cast<int>(plan_.inputs.size()) - 1;
+  }
+
+  absl::StatusOr<AggregateSpec> CompileAggregate(
+      const zetasql::ResolvedComputedColumn& computed) {
+    if (!computed.expr()->Is<zetasql::ResolvedAggregateFunctionCall>()) {
+      return Unsupported("aggregates that are not function calls");
+    }
+    const auto* call =
+        computed.expr()->GetAs<zetasql::ResolvedAggregateFunctionCall>();
+    const std::string name = absl::AsciiStrToLower(call->function()->Name());
+    AggregateSpec spec;
+    size_t num_bounds_args = call->argument_list_size();
+    if (name == "$anon_count_star") {
+      spec.kind = AggregateKind::kCountStar;
+    } else {
+      if (name == "anon_count") {
+        spec.kind = AggregateKind::kCount;
+      } else if (name == "anon_sum") {
+        spec.kind = AggregateKind::kSum;
+      } else if (name == "anon_avg") {
+        spec.kind = AggregateKind::kAvg;
+      } else {
+        return Unsupported(absl::StrCat("the aggregate function ", name));
+      }
+      if (call->argument_list_size() == 0) {
+        return absl::InternalError("Aggregate function without arguments.");
+      }
+      ASSIGN_OR_RETURN(spec.input, Input(call->argument_list(0)));
+      if (spec.kind != AggregateKind::kCount &&
+          !plan_.inputs[spec.input].numeric) {
+        return Unsupported("sums and averages of non-numeric columns");
+      }
+      --num_bounds_args;
+    }
+    // CLAMPED BETWEEN adds the bounds as the last two arguments.
+    if (num_bounds_args == 2) {
+      const int first = call->argument_list_size() - 2;
+      ASSIGN_OR_RETURN(spec.lower, LiteralAsDouble(call->argument_list(first)));
+      ASSIGN_OR_RETURN(spec.upper,
+                       LiteralAsDouble(call->argument_list(first + 1)));
+    } else if (num_bounds_args != 0) {
+      return Unsupported(absl::StrCat("the arguments of ", name));
+    }
+    spec.integer_result = computed.column().type()->IsInteger();
+    return spec;
+  }
+
+  const std::string userid_col_;
+  absl::flat_hash_map<int, ColumnSource> sources_;
+  Plan plan_;
+};
+
+// Output of the scan stage. Users and groups are dictionary encoded. Every
+// input column holds NaN for nulls, and non-numeric input columns hold 0
+// otherwise.
+struct ScannedColumns {
+  std::vector<int64_t> users;
+  std::vector<int64_t> groups;
+  int64_t num_users = 0;
+  // Values of the group by columns of every group.
+  std::vector<std::vector<std::string>> group_keys;
+  std::vector<std::vector<double>> numeric;
+};
+
+// Returns a value as a number, or NaN if it is null.
+absl::StatusOr<double> ValueAsDouble(const zetasql::Value& value) {
+  if (value.is_null()) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  switch (value.type_kind()) {
+    case zetasql::TypeKind::TYPE_STRING: {
+      double number;
+      if (!absl::SimpleAtod(value.string_value(), &number)) {
+        return absl::InvalidArgumentError(absl::StrCat(
+            "Bad numeric value: ", value.string_value(), "."));
+      }
+      return number;
+    }
+    case zetasql::TypeKind::TYPE_INT32:
+      return value.int32_value();
+    case zetasql::TypeKind::TYPE_INT64:
+      return value.int64_value();
+    case zetasql::TypeKind::TYPE_DOUBLE:
+      return value.double_value();
+    default:
+      return Unsupported("numeric columns of other types");
+  }
+}
+
+std::string ValueAsKey(const zetasql::Value& value) {
+  if (value.is_null()) {
+    return "NULL";
+  }
+  if (value.type_kind() == zetasql::TypeKind::TYPE_STRING) {
+    return value.string_value();
+  }
+  return value.DebugString();
+}
+
+absl::StatusOr<ScannedColumns> Scan(const Plan& plan) {
+  std::vector<int> table_indices = {plan.userid_index};
+  for (const InputColumn& input : plan.inputs) {
+    table_indices.push_back(input.table_index);
+  }
+  ASSIGN_OR_RETURN(std::unique_ptr<zetasql::EvaluatorTableIterator> iterator,
+                   plan.table->CreateEvaluatorTableIterator(table_indices));
+
+  ScannedColumns columns;
+  columns.numeric.resize(plan.inputs.size());
+  absl::flat_hash_map<std::string, int64_t> user_ids;
+  absl::flat_hash_map<std::string, int64_t> group_ids;
+  std::vector<std::string> key_values(plan.group_inputs.size());
+  while (iterator->NextRow()) {
+    const zetasql::Value& user = iterator->GetValue(0);
+    // Rows without a user cannot be attributed, so they are dropped.
+    if (user.is_null()) {
+      continue;
+    }
+    columns.users.push_back(
+        user_ids.try_emplace(ValueAsKey(user), user_ids.size()).first->second);
+
+    // Length prefixes keep keys of different values apart.
+    std::string group_key;
+    for (size_t i = 0; i < plan.group_inputs.size(); ++i) {
+      const zetasql::Value& value =
+          iterator->GetValue(plan.group_inputs[i] + 1);
+      key_values[i] = ValueAsKey(value);
+      if (value.is_null()) {
+        absl::StrAppend(&group_key, "-:");
+      } else {
+        absl::StrAppend(&group_key, key_values[i].size(), ":", key_values[i]);
+      }
+    }
+    auto [group, inserted] =
+        group_ids.try_emplace(group_key, columns.group_keys.size());
+    if (inserted) {
+      columns.group_keys.push_back(key_values);
+    }
+    columns.groups.push_back(group->second);
+
+    for (size_t i = 0; i < plan.inputs.size(); ++i) {
+      const zetasql::Value& value = iterator->GetValue(i + 1);
+      if (plan.inputs[i].numeric) {
+        ASSIGN_OR_RETURN(double number, ValueAsDouble(value));
+        columns.numeric[i].push_back(number);
+      } else {
+        columns.numeric[i].push_back(
+            value.is_null() ? std::numeric_limits<double>::quiet_NaN() : 0);
+      }
+    }
+  }
+  RETURN_IF_ERROR(iterator->Status());
+  columns.num_users = user_ids.size();
+  // A query without GROUP BY returns one row, even without any rows.
+  if (plan.group_inputs.empty() && columns.group_keys.empty()) {
+    columns.group_keys.emplace_back();
+  }
+  return columns;
+}
+
+// Output of the bound stage: the per-user aggregates of every group, after
+// every user is limited to kappa groups. The contributions of a group are the
+// range [group_offsets[g], group_offsets[g + 1]) of the per-user columns.
+struct BoundedContributions {
+  std::vector<int64_t> group_offsets;
+  // Per aggregate, the sum and the number of non-null values of every user.
+  std::vector<std::vector<double>> sums;
+  std::vector<std::vector<int64_t>> counts;
+};
+
+BoundedContributions Bound(const Plan& plan, const ScannedColumns& columns) {
+  const int64_t num_groups = columns.group_keys.size();
+  const size_t num_aggregates = plan.aggregates.size();
+
+  // Per-user aggregation: one slot per user and group.
+  absl::flat_hash_map<std::pair<int64_t, int64_t>, int64_t> slot_ids;
+  std::vector<int64_t> slot_users;
+  std::vector<int64_t> slot_groups;
+  std::vector<std::vector<double>> slot_sums(num_aggregates);
+  std::vector<std::vector<int64_t>> slot_counts(num_aggregates);
+  for (size_t row = 0; row < columns.users.size(); ++row) {
+    auto [slot, inserted] = slot_ids.try_emplace(
+        std::make_pair(columns.users[row], columns.groups[row]),
+        slot_users.size());
+    if (inserted) {
+      slot_users.push_back(columns.users[row]);
+      slot_groups.push_back(columns.groups[row]);
+      for (size_t a = 0; a < num_aggregates; ++a) {
+        slot_sums[a].push_back(0);
+        slot_counts[a].push_back(0);
+      }
+    }
+    for (size_t a = 0; a < num_aggregates; ++a) {
+      const AggregateSpec& spec = plan.aggregates[a];
+      if (spec.kind == AggregateKind::kCountStar) {
+        ++slot_counts[a][slot->second];
+      } else {
+        const double value = columns.numeric[spec.input][row];
+        if (!std::isnan(value)) {
+          slot_sums[a][slot->second] += value;
+          ++slot_counts[a][slot->second];
+        }
+      }
+    }
+  }
+  const int64_t num_slots = slot_users.size();
+
+  // Every user keeps at most kappa randomly chosen groups.
+  std::vector<int64_t> user_offsets(columns.num_users + 1, 0);
+  for (int64_t user : slot_users) {
+    ++user_offsets[user + 1];
+  }
+  for (int64_t u = 0; u < columns.num_users; ++u) {
+    user_offsets[u + 1] += user_offsets[u];
+  }
+  std::vector<int64_t> slots_by_user(num_slots);
+  {
+    std::vector<int64_t> next(user_offsets.begin(), user_offsets.end() - 1);
+    for (int64_t s = 0; s < num_slots; ++s) {
+      slots_by_user[next[slot_users[s]]++] = s;
+    }
+  }
+  std::vector<bool> kept(num_slots, true);
+  absl::BitGen gen;
+  for (int64_t u = 0; u < columns.num_users; ++u) {
+    auto begin = slots_by_user.begin() + user_offsets[u];
+    auto end = slots_by_user.begin() + user_offsets[u + 1];
+    if (end - begin > plan.kappa) {
+      std::shuffle(begin, end, gen);
+      for (auto it = begin + plan.kappa; it != end; ++it) {
+        kept[*it] = false;
+      }
+    }
+  }
+
+  // Lays out the kept contributions contiguously per group.
+  BoundedContributions contributions;
+  contributions.group_offsets.assign(num_groups + 1, 0);
+  for (int64_t s = 0; s < num_slots; ++s) {
+    if (kept[s]) {
+      ++contributions.group_offsets[slot_groups[s] + 1];
+    }
+  }
+  for (int64_t g = 0; g < num_groups; ++g) {
+    contributions.group_offsets[g + 1] += contributions.group_offsets[g];
+  }
+  const int64_t num_kept = contributions.group_offsets[num_groups];
+  contributions.sums.assign(num_aggregates, std::vector<double>(num_kept));
+  contributions.counts.assign(num_aggregates, std::vector<int64_t>(num_kept));
+  std::vector<int64_t> next(contributions.group_offsets.begin(),
+                            contributions.group_offsets.end() - 1);
+  for (int64_t s = 0; s < num_slots; ++s) {
+    if (!kept[s]) {
+      continue;
+    }
+    const int64_t position = next[slot_groups[s]]++;
+    for (size_t a = 0; a < num_aggregates; ++a) {
+      contributions.sums[a][position] = slot_sums[a][s];
+      contributions.counts[a][position] = slot_counts[a][s];
+    }
+  }
+  return contributions;
+}
+
+// The DP algorithm of an aggregate. Counts are sums of the clamped per-user
+// counts; sums and averages take the per-user sums and averages.
+struct AggregateAlgorithm {
+  std::unique_ptr<Algorithm<int64_t>> count;
+  std::unique_ptr<Algorithm<double>> value;
+};
+
+template <typename T, typename AlgorithmT>
+absl::StatusOr<std::unique_ptr<Algorithm<T>>> BuildAlgorithm(
+    const AggregateSpec& spec, double epsilon, int64_t kappa) {
+  typename AlgorithmT::Builder builder;
+  builder.SetEpsilon(epsilon).SetMaxPartitionsContributed(kappa);
+  if (spec.lower.has_value() && spec.upper.has_value()) {
+    builder.SetLower(*spec.lower).SetUpper(*spec.upper);
+  }
+  ASSIGN_OR_RETURN(std::unique_ptr<AlgorithmT> algorithm, builder.Build());
+  return std::unique_ptr<Algorithm<T>>(std::move(algorithm));
+}
+
+absl::StatusOr<AggregateAlgorithm> BuildAggregate(AggregateSpec spec,
+                                                  double epsilon,
+                                                  int64_t kappa) {
+  AggregateAlgorithm algorithm;
+  switch (spec.kind) {
+    case AggregateKind::kCount:
+    case AggregateKind::kCountStar: {
+      if (!spec.lower.has_value()) {
+        // Like ZetaSQL, every user counts at most once by default.
+        spec.lower = 0;
+        spec.upper = 1;
+      }
+      ASSIGN_OR_RETURN(algorithm.count,
+                       (BuildAlgorithm<int64_t, BoundedSum<int64_t>>(
+                           spec, epsilon, kappa)));
+      break;
+    }
+    case AggregateKind::kSum: {
+      ASSIGN_OR_RETURN(algorithm.value,
+                       (BuildAlgorithm<double, BoundedSum<double>>(
+                           spec, epsilon, kappa)));
+      break;
+    }
+    case AggregateKind::kAvg: {
+      ASSIGN_OR_RETURN(algorithm.value,
+                       (BuildAlgorithm<double, BoundedMean<double>>(
+                           spec, epsilon, kappa)));
+      break;
+    }
+  }
+  return algorithm;
+}
+
+// Output of the aggregate stage: the rows of the kept groups, with one value
+// per output column.
+using ResultRows = std::vector<std::vector<std::string>>;
+
+absl::StatusOr<ResultRows> Aggregate(const Plan& plan,
+                                     const ScannedColumns& columns,
+                                     const BoundedContributions& bounded) {
+  const bool grouped = !plan.group_inputs.empty();
+  // The budget is split evenly between the aggregates and, for grouped
+  // queries, the selection of the groups to release.
+  const double epsilon =
+      plan.epsilon / (plan.aggregates.size() + (grouped ? 1 : 0));
+  std::unique_ptr<PartitionSelectionStrategy> selection;
+  if (grouped) {
+    LaplacePartitionSelection::Builder builder;
+    builder.SetEpsilon(epsilon)
+        .SetDelta(plan.delta)
+        .SetMaxPartitionsContributed(plan.kappa);
+    ASSIGN_OR_RETURN(selection, builder.Build());
+  }
+  // One algorithm per aggregate, reset between groups.
+  std::vector<AggregateAlgorithm> algorithms;
+  for (const AggregateSpec& spec : plan.aggregates) {
+    ASSIGN_OR_RETURN(AggregateAlgorithm algorithm,
+                     BuildAggregate(spec, epsilon, plan.kappa));
+    algorithms.push_back(std::move(algorithm));
+  }
+
+  ResultRows rows;
+  std::vector<double> entries;
+  const int64_t num_groups = columns.group_keys.size();
+  for (int64_t g = 0; g < num_groups; ++g) {
+    const int64_t begin = bounded.group_offsets[g];
+    const int64_t end = bounded.group_offsets[g + 1];
+    if (grouped && !selection->ShouldKeep(static_cast<double>(end - begin))) {
+      continue;
+    }
+    std::vector<std::string> aggregate_values;
+    for (size_t a = 0; a < plan.aggregates.size(); ++a) {
+      const AggregateSpec& spec = plan.aggregates[a];
+      const std::vector<int64_t>& counts = bounded.counts[a];
+      absl::StatusOr<Output> output;
+      if (algorithms[a].count) {
+        Algorithm<int64_t>& count = *algorithms[a].count;
+        count.Reset();
+        count.AddEntries(counts.begin() + begin, counts.begin() + end);
+        output = count.PartialResult();
+      } else {
+        // Users without non-null values do not contribute.
+        entries.clear();
+        for (int64_t i = begin; i < end; ++i) {
+          if (counts[i] == 0) continue;
+          const double sum = bounded.sums[a][i];
+          entries.push_back(spec.kind == AggregateKind::kAvg ? sum / counts[i]
+                                                             : sum);
+        }
+        Algorithm<double>& value = *algorithms[a].value;
+        value.Reset();
+        value.AddEntries(entries.begin(), entries.end());
+        output = value.PartialResult();
+      }
+      RETURN_IF_ERROR(output.status());
+      const ValueType& result = output->elements(0).value();
+      if (result.has_int_value()) {
+        aggregate_values.push_back(absl::StrCat(result.int_value()));
+      } else if (spec.integer_result) {
+        aggregate_values.push_back(
+            absl::StrCat(std::llround(result.float_value())));
+      } else {
+        aggregate_values.push_back(absl::StrCat(result.float_value()));
+      }
+    }
+    std::vector<std::string> row;
+    for (const OutputColumn& output : plan.outputs) {
+      row.push_back(output.is_group ? columns.group_keys[g][output.index]
+                                    : aggregate_values[output.index]);
+    }
+    rows.push_back(std::move(row));
+  }
+  return rows;
+}
+
+// Records the wall time of consecutive stages.
+class StageTimer {
+ public:
+  explicit StageTimer(StageTimings* timings)
+      : timings_(timings), start_(absl::Now()) {}
+
+  void Finish(absl::string_view stage) {
+    const absl::Time now = absl::Now();
+    if (timings_ != nullptr) {
+      timings_->stages.emplace_back(std::string(stage), now - start_);
+    }
+    start_ = now;
+  }
+
+ private:
+  StageTimings* timings_;
+  absl::Time start_;
+};
+
+}  // namespace
+
+absl::Status ExecuteCompiledQuery(absl::string_view sql,
+                                  zetasql::ExecuteQueryConfig& config,
+                                  absl::string_view userid_col,
+                                  const ExamineResolvedAstCallback& examine,
+                                  std::ostream& out, StageTimings* timings) {
+  StageTimer timer(timings);
+  // The plan is compiled from the anonymized aggregate scan, which the
+  // anonymization rewrite would replace.
+  zetasql::AnalyzerOptions options = config.analyzer_options();
+  options.set_enabled_rewrites({});
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const zetasql::AnalyzerOutput> analyzer_output;
+  RETURN_IF_ERROR(zetasql::AnalyzeStatement(sql, options,
+                                            &config.mutable_catalog(),
+                                            &type_factory, &analyzer_output));
+  const zetasql::ResolvedStatement* stmt =
+      analyzer_output->resolved_statement();
+  if (examine) {
+    RETURN_IF_ERROR(examine(stmt));
+  }
+  if (!stmt->Is<zetasql::ResolvedQueryStmt>()) {
+    return Unsupported("statements other than queries");
+  }
+  timer.Finish("analyze");
+
+  PlanCompiler compiler(userid_col);
+  ASSIGN_OR_RETURN(
+      Plan plan, compiler.Compile(*stmt->GetAs<zetasql::ResolvedQueryStmt>()));
+  timer.Finish("compile");
+
+  ASSIGN_OR_RETURN(ScannedColumns columns, Scan(plan));
+  timer.Finish("scan");
+
+  BoundedContributions contributions = Bound(plan, columns);
+  timer.Finish("bound");
+
+  ASSIGN_OR_RETURN(ResultRows rows, Aggregate(plan, columns, contributions));
+  timer.Finish("aggregate");
+
+  std::vector<std::string> header;
+  for (const OutputColumn& output : plan.outputs) {
+    header.push_back(output.name);
+  }
+  out << absl::StrJoin(header, ",") << "\n";
+  for (const std::vector<std::string>& row : rows) {
+    out << absl::StrJoin(row, ",") << "\n";
+  }
+  timer.Finish("output");
+  return absl::OkStatus();
+}
+
+}  // namespace zetasql_example
+}  // namespace differential_privacy
@@ -0,0 +1,75 @@
+//
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Compiled execution of anonymized aggregation queries. Instead of evaluating
+// the rewritten query row by row, the anonymized aggregate scan is compiled
+// into a plan of column-at-a-time stages:
+//
+//   1. scan: reads the referenced columns of the table into contiguous
+//      columns, dictionary encoding users and groups;
+//   2. bound: aggregates the rows of every user per group and samples at most
+//      kappa groups per user;
+//   3. aggregate: per group, selects the partition and feeds the per-user
+//      contributions to the DP algorithms of the library in batches.
+//
+// Only a subset of queries can be compiled: a single anonymized aggregate scan
+// over a table, grouped by columns of the table, with ANON_COUNT, ANON_SUM and
+// ANON_AVG over columns of the table that are optionally cast to a numeric
+// type. Other queries return an Unimplemented error, so that callers can fall
+// back to the evaluator.
+
+#ifndef DIFFERENTIAL_PRIVACY_EXAMPLES_ZETASQL_COMPILED_QUERY_H_
+#define DIFFERENTIAL_PRIVACY_EXAMPLES_ZETASQL_COMPILED_QUERY_H_
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zetasql/resolved_ast/resolved_node.h"
+#include "zetasql/tools/execute_query/execute_query_tool.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace differential_privacy {
+namespace zetasql_example {
+
+// Wall time of every stage of a compiled execution, in execution order.
+struct StageTimings {
+  std::vector<std::pair<std::string, absl::Duration>> stages;
+};
+
+// Called with the resolved statement before it is compiled, e.g., to verify
+// the anonymization parameters.
+using ExamineResolvedAstCallback =
+    std::function<absl::Status(const zetasql::ResolvedNode*)>;
+
+// Executes sql with a compiled plan, using the catalog and analyzer options of
+// config, and writes the result rows to out as comma-separated values with a
+// header row. userid_col is the column of the table that identifies users. The
+// timings of the stages are stored in timings, which may be null.
+absl::Status ExecuteCompiledQuery(absl::string_view sql,
+                                  zetasql::ExecuteQueryConfig& config,
+                                  absl::string_view userid_col,
+                                  const ExamineResolvedAstCallback& examine,
+                                  std::ostream& out, StageTimings* timings);
+
+}  // namespace zetasql_example
+}  // namespace differential_privacy
+
+#endif  // DIFFERENTIAL_PRIVACY_EXAMPLES_ZETASQL_COMPILED_QUERY_H_
@@ -52,6 +52,8 @@
 #include "absl/strings/strip.h"
 #include "base/status_macros.h"
 #include "absl/flags/parse.h"
+#include "absl/time/time.h"
+#include "compiled_query.h"
 
 ABSL_FLAG(std::string, data_set, "",
           "A CSV file containing the data to be queried, whose std::string-typed "
@@ -64,6 +66,13 @@ ABSL_FLAG(
     "A std::string matching the name of the column in the  containing the user IDs, "
     "to be used in anonoymization queries.");
 
+ABSL_FLAG(std::string, execution_mode, "evaluator",
+          "How to execute the query: \"evaluator\" evaluates it row by row "
+          "with the ZetaSQL reference evaluator, \"compiled\" compiles the "
+          "anonymized aggregation into a plan that feeds the DP algorithms in "
+          "batches and reports the time of every stage. Queries that cannot be "
+          "compiled fall back to the evaluator.");
+
 // Verifies anonymization parameters to be within valid bounds
 class VerifyAnonymizationParametersVisitor
     : public zetasql::ResolvedASTVisitor {
@@ -184,13 +193,15 @@ static zetasql::SimpleCatalog& GetCatalogForConfig(
   return config.mutable_catalog();
 }
 
+static absl::Status VerifyAnonymizationParameters(
+    const zetasql::ResolvedNode* node) {
+  auto visitor = VerifyAnonymizationParametersVisitor();
+  return node->Accept(&visitor);
+}
+
 static absl::Status InitExecuteQueryConfig(
     zetasql::ExecuteQueryConfig& config) {
-  config.set_examine_resolved_ast_callback(
-      [](const zetasql::ResolvedNode* node) -> absl::Status {
-        auto visitor = VerifyAnonymizationParametersVisitor();
-        return node->Accept(&visitor);
-      });
+  config.set_examine_resolved_ast_callback(VerifyAnonymizationParameters);
 
   RETURN_IF_ERROR(SetToolModeFromFlags(config));
 
@@ -236,6 +247,30 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  if (absl::GetFlag(FLAGS_execution_mode) == "compiled") {
+    differential_privacy::zetasql_example::StageTimings timings;
+    status = differential_privacy::zetasql_example::ExecuteCompiledQuery(
+        sql, config, absl::GetFlag(FLAGS_userid_col),
+        VerifyAnonymizationParameters, std::cout, &timings);
+    if (status.ok()) {
+      for (const auto& [stage, duration] : timings.stages) {
+        std::cerr << "Stage " << stage << ": "
+                  << absl::FormatDuration(duration) << std::endl;
+      }
+      return 0;
+    }
+    if (!absl::IsUnimplemented(status)) {
+      std::cout << "ERROR: " << status << std::endl;
+      return 1;
+    }
+    std::cerr << "Falling back to the evaluator: " << status.message()
+              << std::endl;
+  } else if (absl::GetFlag(FLAGS_execution_mode) != "evaluator") {
+    std::cout << "ERROR: Unknown execution mode "
+              << absl::GetFlag(FLAGS_execution_mode) << std::endl;
+    return 1;
+  }
+
   status = ExecuteQuery(sql, config, *writer.value());
   if (!status.ok()) {
     std::cout << "ERROR: " << status << std::endl;
@@ -0,0 +1,169 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+package dpagg
+
+import (
+	"fmt"
+	"math/rand"
+	"testing"
+
+	"github.com/google/differential-privacy/go/v3/noise"
+)
+
+// This file contains the Go side of the cross-language workload benchmarks
+// described in benchmarks/README.md. The workloads and their parameters must
+// be kept in sync with the C++ and Java implementations.
+
+const (
+	workloadEpsilon = 1.0
+	workloadDelta   = 1e-5
+	workloadLower   = -100.0
+	workloadUpper   = 100.0
+)
+
+var (
+	workloadSizes  = []int{1 << 10, 1 << 15, 1 << 20}
+	workloadRanks  = []float64{0.1, 0.5, 0.9}
+	workloadResult float64
+)
+
+// workloadEntries returns n normally distributed entries. Some of them fall
+// outside of [workloadLower, workloadUpper], so that clamping is part of the
+// measured work.
+func workloadEntries(n int) []float64 {
+	r := rand.New(rand.NewSource(42))
+	entries := make([]float64, n)
+	for i := range entries {
+		entries[i] = r.NormFloat64() * workloadUpper / 2
+	}
+	return entries
+}
+
+// runWorkload runs fn once per iteration on entries of every workload size.
+// fn must build the aggregation, add all entries and compute its result.
+func runWorkload(b *testing.B, name string, fn func(b *testing.B, entries []float64) float64) {
+	for _, n := range workloadSizes {
+		entries := workloadEntries(n)
+		b.Run(fmt.Sprintf("%s/%d", name, n), func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				workloadResult = fn(b, entries)
+			}
+		})
+	}
+}
+
+func BenchmarkWorkload(b *testing.B) {
+	runWorkload(b, "Count", func(b *testing.B, entries []float64) float64 {
+		c, err := NewCount(&CountOptions{
+			Epsilon:                  workloadEpsilon,
+			MaxPartitionsContributed: 1,
+			Noise:                    noise.Laplace(),
+		})
+		if err != nil {
+			b.Fatalf("Couldn't initialize count: %v", err)
+		}
+		for range entries {
+			c.Increment()
+		}
+		result, err := c.Result()
+		if err != nil {
+			b.Fatalf("Couldn't compute count: %v", err)
+		}
+		return float64(result)
+	})
+	runWorkload(b, "BoundedSum", func(b *testing.B, entries []float64) float64 {
+		bs, err := NewBoundedSumFloat64(&BoundedSumFloat64Options{
+			Epsilon:                  workloadEpsilon,
+			MaxPartitionsContributed: 1,
+			Lower:                    workloadLower,
+			Upper:                    workloadUpper,
+			Noise:                    noise.Laplace(),
+		})
+		if err != nil {
+			b.Fatalf("Couldn't initialize sum: %v", err)
+		}
+		for _, e := range entries {
+			bs.Add(e)
+		}
+		result, err := bs.Result()
+		if err != nil {
+			b.Fatalf("Couldn't compute sum: %v", err)
+		}
+		return result
+	})
+	runWorkload(b, "BoundedMean", func(b *testing.B, entries []float64) float64 {
+		bm, err := NewBoundedMean(&BoundedMeanOptions{
+			Epsilon:                      workloadEpsilon,
+			MaxPartitionsContributed:     1,
+			MaxContributionsPerPartition: 1,
+			Lower:                        workloadLower,
+			Upper:                        workloadUpper,
+			Noise:                        noise.Laplace(),
+		})
+		if err != nil {
+			b.Fatalf("Couldn't initialize mean: %v", err)
+		}
+		for _, e := range entries {
+			bm.Add(e)
+		}
+		result, err := bm.Result()
+		if err != nil {
+			b.Fatalf("Couldn't compute mean: %v", err)
+		}
+		return result
+	})
+	runWorkload(b, "Quantiles", func(b *testing.B, entries []float64) float64 {
+		bq, err := NewBoundedQuantiles(&BoundedQuantilesOptions{
+			Epsilon:                      workloadEpsilon,
+			MaxPartitionsContributed:     1,
+			MaxContributionsPerPartition: 1,
+			Lower:                        workloadLower,
+			Upper:                        workloadUpper,
+			Noise:                        noise.Laplace(),
+		})
+		if err != nil {
+			b.Fatalf("Couldn't initialize quantiles: %v", err)
+		}
+		for _, e := range entries {
+			bq.Add(e)
+		}
+		var result float64
+		for _, rank := range workloadRanks {
+			q, err := bq.Result(rank)
+			if err != nil {
+				b.Fatalf("Couldn't compute quantile: %v", err)
+			}
+			result += q
+		}
+		return result
+	})
+	noiseWorkload := func(n noise.Noise, delta float64) func(b *testing.B, entries []float64) float64 {
+		return func(b *testing.B, entries []float64) float64 {
+			var result float64
+			for _, e := range entries {
+				noised, err := n.AddNoiseFloat64(e, 1, 1, workloadEpsilon, delta)
+				if err != nil {
+					b.Fatalf("Couldn't add noise: %v", err)
+				}
+				result += noised
+			}
+			return result
+		}
+	}
+	runWorkload(b, "LaplaceNoise", noiseWorkload(noise.Laplace(), 0))
+	runWorkload(b, "GaussianNoise", noiseWorkload(noise.Gaussian(), workloadDelta))
+}
@@ -544,6 +544,18 @@ public class BoundedQuantiles {
       long oldCount = tree.containsKey(index) ? tree.get(index) : 0;
       tree.put(index, oldCount + otherSummaryParsed.getQuantileTreeOrDefault(index, 0));
     }
+    // Summaries of the C++ library store the nodes in one of the packed encodings instead.
+    for (int index = 0; index < otherSummaryParsed.getDenseQuantileTreeCount(); index++) {
+      long count = otherSummaryParsed.getDenseQuantileTree(index);
+      if (count != 0) {
+        tree.merge(index, count, Long::sum);
+      }
+    }
+    int sparseIndex = 0;
+    for (int i = 0; i < otherSummaryParsed.getSparseQuantileTreeIndexDeltasCount(); i++) {
+      sparseIndex += otherSummaryParsed.getSparseQuantileTreeIndexDeltas(i);
+      tree.merge(sparseIndex, otherSummaryParsed.getSparseQuantileTreeCounts(i), Long::sum);
+    }
   }
 
   private void checkMergeParametersAreEqual(BoundedQuantilesSummary summary) {
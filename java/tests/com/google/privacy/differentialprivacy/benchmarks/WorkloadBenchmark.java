@@ -0,0 +1,169 @@
+//
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+package com.google.privacy.differentialprivacy.benchmarks;
+
+import com.google.privacy.differentialprivacy.BoundedMean;
+import com.google.privacy.differentialprivacy.BoundedQuantiles;
+import com.google.privacy.differentialprivacy.BoundedSum;
+import com.google.privacy.differentialprivacy.Count;
+import com.google.privacy.differentialprivacy.GaussianNoise;
+import com.google.privacy.differentialprivacy.LaplaceNoise;
+import com.google.privacy.differentialprivacy.Noise;
+import java.util.Random;
+import java.util.function.ToDoubleFunction;
+
+/**
+ * Java side of the cross-language workload benchmarks described in benchmarks/README.md. The
+ * workloads and their parameters must be kept in sync with the C++ and Go implementations.
+ *
+ * <p>Results are printed in the format of Go benchmarks, one line per workload and input size, so
+ * that they can be compared with the other languages by benchmarks/run_workloads.py. An optional
+ * argument restricts the run to the workloads whose name contains it.
+ */
+public final class WorkloadBenchmark {
+  private static final double EPSILON = 1.0;
+  private static final double DELTA = 1e-5;
+  private static final double LOWER = -100.0;
+  private static final double UPPER = 100.0;
+  private static final int[] SIZES = {1 << 10, 1 << 15, 1 << 20};
+  private static final double[] RANKS = {0.1, 0.5, 0.9};
+
+  /** Minimum duration of the warm up and of the measurement of every workload. */
+  private static final long MIN_DURATION_NANOS = 1_000_000_000L;
+
+  /** Keeps the results alive, so that the JIT compiler cannot drop the measured work. */
+  private static double sink;
+
+  private WorkloadBenchmark() {}
+
+  public static void main(String[] args) {
+    String filter = args.length > 0 ? args[0] : "";
+    run("Count", filter, WorkloadBenchmark::count);
+    run("BoundedSum", filter, WorkloadBenchmark::boundedSum);
+    run("BoundedMean", filter, WorkloadBenchmark::boundedMean);
+    run("Quantiles", filter, WorkloadBenchmark::quantiles);
+    run("LaplaceNoise", filter, entries -> addNoise(new LaplaceNoise(), 0.0, entries));
+    run("GaussianNoise", filter, entries -> addNoise(new GaussianNoise(), DELTA, entries));
+  }
+
+  /**
+   * Returns {@code size} normally distributed entries. Some of them fall outside of [LOWER, UPPER],
+   * so that clamping is part of the measured work.
+   */
+  private static double[] entries(int size) {
+    Random random = new Random(42);
+    double[] entries = new double[size];
+    for (int i = 0; i < size; ++i) {
+      entries[i] = random.nextGaussian() * UPPER / 2;
+    }
+    return entries;
+  }
+
+  private static void run(String name, String filter, ToDoubleFunction<double[]> workload) {
+    if (!name.contains(filter)) {
+      return;
+    }
+    for (int size : SIZES) {
+      double[] entries = entries(size);
+      measure(workload, entries);
+      long[] measurement = measure(workload, entries);
+      System.out.printf(
+          "BenchmarkWorkload/%s/%d\t%d\t%.1f ns/op%n",
+          name, size, measurement[0], (double) measurement[1] / measurement[0]);
+    }
+  }
+
+  /**
+   * Runs the workload until {@link #MIN_DURATION_NANOS} have elapsed. Returns the number of
+   * iterations and their total duration in nanoseconds.
+   */
+  private static long[] measure(ToDoubleFunction<double[]> workload, double[] entries) {
+    long iterations = 0;
+    long start = System.nanoTime();
+    long elapsed;
+    do {
+      sink += workload.applyAsDouble(entries);
+      ++iterations;
+      elapsed = System.nanoTime() - start;
+    } while (elapsed < MIN_DURATION_NANOS);
+    return new long[] {iterations, elapsed};
+  }
+
+  private static double count(double[] entries) {
+    Count count = Count.builder().epsilon(EPSILON).maxPartitionsContributed(1).build();
+    for (int i = 0; i < entries.length; ++i) {
+      count.increment();
+    }
+    return count.computeResult();
+  }
+
+  private static double boundedSum(double[] entries) {
+    BoundedSum sum =
+        BoundedSum.builder()
+            .epsilon(EPSILON)
+            .maxPartitionsContributed(1)
+            .lower(LOWER)
+            .upper(UPPER)
+            .build();
+    for (double entry : entries) {
+      sum.addEntry(entry);
+    }
+    return sum.computeResult();
+  }
+
+  private static double boundedMean(double[] entries) {
+    BoundedMean mean =
+        BoundedMean.builder()
+            .epsilon(EPSILON)
+            .maxPartitionsContributed(1)
+            .maxContributionsPerPartition(1)
+            .lower(LOWER)
+            .upper(UPPER)
+            .build();
+    for (double entry : entries) {
+      mean.addEntry(entry);
+    }
+    return mean.computeResult();
+  }
+
+  private static double quantiles(double[] entries) {
+    BoundedQuantiles quantiles =
+        BoundedQuantiles.builder()
+            .epsilon(EPSILON)
+            .maxPartitionsContributed(1)
+            .maxContributionsPerPartition(1)
+            .lower(LOWER)
+            .upper(UPPER)
+            .build();
+    for (double entry : entries) {
+      quantiles.addEntry(entry);
+    }
+    double result = 0;
+    for (double rank : RANKS) {
+      result += quantiles.computeResult(rank);
+    }
+    return result;
+  }
+
+  private static double addNoise(Noise noise, double delta, double[] entries) {
+    double result = 0;
+    for (double entry : entries) {
+      result += noise.addNoise(entry, 1, 1.0, EPSILON, delta);
+    }
+    return result;
+  }
+}
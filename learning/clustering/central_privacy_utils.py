@@ -14,10 +14,13 @@
 """Utilities for adding noise to satisfy central privacy."""
 
 import dataclasses
+import typing
 
 import numpy as np
 from scipy import stats
 
+from clustering import native
+
 
 @dataclasses.dataclass
 class AveragePrivacyParam():
@@ -67,6 +70,41 @@ def get_private_average(nonprivate_points: np.ndarray, private_count: int,
   return sum_points / private_count
 
 
+def get_private_averages(
+    nonprivate_points: typing.Sequence[np.ndarray],
+    private_counts: typing.Sequence[int],
+    average_privacy_param: AveragePrivacyParam,
+    dim: int) -> typing.List[np.ndarray]:
+  """Returns get_private_average() for every group of data points.
+
+  Uses a single call to the native kernel for all the groups if it is
+  available.
+
+  Args:
+    nonprivate_points: groups of data points to be averaged, may be empty.
+    private_counts: differentially private counts of the groups, all >= 1.
+    average_privacy_param: privacy parameters for the private averages.
+    dim: dimension of the data points.
+  """
+  if native.clustering_kernel is None or not nonprivate_points:
+    return [
+        get_private_average(points, private_count, average_privacy_param, dim)
+        for points, private_count in zip(nonprivate_points, private_counts)
+    ]
+  for private_count in private_counts:
+    if private_count < 1:
+      raise ValueError(
+          f'get_private_average() called with private_count={private_count}')
+  sums = np.array([
+      np.sum(points, axis=0) if len(points) else np.zeros(dim)
+      for points in nonprivate_points
+  ], dtype=np.float64)
+  return list(
+      native.clustering_kernel.private_averages(
+          sums, np.array(private_counts, dtype=np.int64),
+          average_privacy_param.gaussian_standard_deviation))
+
+
 @dataclasses.dataclass
 class CountPrivacyParam():
   """Privacy parameters for calling get_private_count()."""
@@ -97,3 +135,25 @@ def get_private_count(nonprivate_count: int,
     return nonprivate_count
   return nonprivate_count + stats.dlaplace.rvs(
       count_privacy_param.laplace_param)
+
+
+def get_private_counts(
+    nonprivate_counts: typing.Sequence[int],
+    count_privacy_param: CountPrivacyParam) -> typing.List[int]:
+  """Returns get_private_count() for every count.
+
+  Uses a single call to the native kernel for all the counts if it is available.
+
+  Args:
+    nonprivate_counts: the (unnoised) counts of the data points in the groups.
+    count_privacy_param: privacy parameters for calculating the private counts.
+  """
+  if native.clustering_kernel is None or not nonprivate_counts:
+    return [
+        get_private_count(count, count_privacy_param)
+        for count in nonprivate_counts
+    ]
+  private_counts = native.clustering_kernel.private_counts(
+      np.array(nonprivate_counts, dtype=np.int64),
+      count_privacy_param.laplace_param)
+  return [int(private_count) for private_count in private_counts]
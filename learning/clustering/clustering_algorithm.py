@@ -24,6 +24,7 @@ from clustering import clustering_params
 from clustering import coreset_params
 from clustering import default_clustering_params
 from clustering import lsh_tree
+from clustering import native
 from clustering import privacy_calculator
 from clustering import private_outputs
 
@@ -131,6 +132,12 @@ class ClusteringResult():
       min_index = np.argmin(squared_distances)
       return (min_index, squared_distances[min_index])
 
+    if (self.labels is None and self.loss is None and
+        native.clustering_kernel is not None):
+      labels, loss = native.clustering_kernel.assign_to_nearest_centers(
+          self.data.datapoints, self.centers, num_threads=native.NUM_THREADS)
+      object.__setattr__(self, "labels", labels.astype(int))
+      object.__setattr__(self, "loss", loss)
     if self.labels is None and self.loss is None:
       result = [closest_center(datapoint) for datapoint in self.data.datapoints]
       object.__setattr__(self, "labels",
@@ -292,11 +299,8 @@ def get_private_coreset(
   # Root node must have private count >= 1.
   root.private_count = max(1, root.private_count)
   leaves = lsh_tree.LshTree(root).leaves
-  coreset_points = []
-  coreset_point_weights = []
-  for leaf in leaves:
-    coreset_points.append(leaf.get_private_average())
-    coreset_point_weights.append(leaf.private_count)
+  coreset_points = lsh_tree.get_private_averages(leaves)
+  coreset_point_weights = [leaf.private_count for leaf in leaves]
 
   # To improve accuracy, we can clip the coreset points to the provided radius.
   coreset_points = data.clip_by_radius(np.array(coreset_points))
@@ -18,9 +18,14 @@ import typing
 
 import numpy as np
 
+from clustering import native
 
 HashChar = str
 HashCharToPoints = typing.Dict[HashChar, np.ndarray]
+# Hash codes of points, where bit j of a code is the j'th hash character.
+HashCodes = np.ndarray
+HashCharToPointsAndCodes = typing.Dict[HashChar, typing.Tuple[np.ndarray,
+                                                              HashCodes]]
 
 
 @dataclasses.dataclass
@@ -66,13 +71,67 @@ class SimHash():
     Raises:
       ValueError: if hash_prefix is not strictly smaller than max_hash_len.
     """
-    prefix_length = len(hash_prefix)
-    if prefix_length >= self.max_hash_len:
-      raise ValueError(f"Hash prefix {hash_prefix} has length greater than or "
-                       f"equal to max hash length ({self.max_hash_len})")
+    prefix_length = self._check_prefix_length(hash_prefix)
     projected_values = np.matmul(datapoints,
                                  self.projection_vectors[prefix_length])
     return {
         "0": datapoints[projected_values >= 0],
         "1": datapoints[projected_values < 0]
     }
+
+  def hash_codes(self,
+                 datapoints: np.ndarray) -> typing.Optional[HashCodes]:
+    """Returns the full hash codes of datapoints, if the native kernel is used.
+
+    Hashing all the points once with the native kernel is faster than
+    projecting them again for every hash character.
+
+    Args:
+      datapoints: Datapoints to hash.
+
+    Returns:
+      The hash codes of datapoints, or None if the native kernel is not
+      available or the hash does not fit in 64 bits.
+    """
+    if native.clustering_kernel is None or self.max_hash_len > 64:
+      return None
+    return native.clustering_kernel.simhash_codes(
+        datapoints, self.projection_vectors, num_threads=native.NUM_THREADS)
+
+  def group_codes_by_next_hash(
+      self,
+      datapoints: np.ndarray,
+      codes: HashCodes,
+      hash_prefix: str = "") -> HashCharToPointsAndCodes:
+    """Groups points by the next hash character after hash_prefix using codes.
+
+    Same as group_by_next_hash, for points whose codes were computed by
+    hash_codes.
+
+    Args:
+      datapoints: Datapoints to group, required to have the same hash_prefix.
+      codes: Hash codes of datapoints.
+      hash_prefix: Prefix for the hash of all the datapoints.
+
+    Returns:
+      HashCharToPointsAndCodes mapping the next character in the hash value to
+        the datapoints with that next character and their codes.
+
+    Raises:
+      ValueError: if hash_prefix is not strictly smaller than max_hash_len.
+    """
+    prefix_length = self._check_prefix_length(hash_prefix)
+    next_bits = np.bitwise_and(
+        np.right_shift(codes, np.uint64(prefix_length)), np.uint64(1))
+    return {
+        "0": (datapoints[next_bits == 0], codes[next_bits == 0]),
+        "1": (datapoints[next_bits == 1], codes[next_bits == 1])
+    }
+
+  def _check_prefix_length(self, hash_prefix: str) -> int:
+    """Returns the length of hash_prefix, which must be below max_hash_len."""
+    prefix_length = len(hash_prefix)
+    if prefix_length >= self.max_hash_len:
+      raise ValueError(f"Hash prefix {hash_prefix} has length greater than or "
+                       f"equal to max hash length ({self.max_hash_len})")
+    return prefix_length
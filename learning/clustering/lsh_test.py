@@ -59,6 +59,21 @@ class LshTest(absltest.TestCase):
     self.assertTrue((children["0"] == datapoints[[0, 1]]).all())
     self.assertTrue((children["1"] == datapoints[[2, 3, 4]]).all())
 
+  def test_group_codes_by_next_hash(self):
+    dim, max_hash_len = 5, 2
+    hash_prefix = "0"
+    sh = lsh.SimHash(dim, max_hash_len)
+    datapoints = np.arange(25, dtype=float).reshape(5, 5)
+    # Bit 1 of the codes is the second hash character.
+    codes = np.array([0, 1, 2, 3, 2], dtype=np.uint64)
+    children = sh.group_codes_by_next_hash(datapoints, codes, hash_prefix)
+    self.assertTrue((children["0"][0] == datapoints[[0, 1]]).all())
+    self.assertTrue((children["0"][1] == codes[[0, 1]]).all())
+    self.assertTrue((children["1"][0] == datapoints[[2, 3, 4]]).all())
+    self.assertTrue((children["1"][1] == codes[[2, 3, 4]]).all())
+    with self.assertRaises(ValueError):
+      sh.group_codes_by_next_hash(datapoints, codes, hash_prefix="01")
+
 
 if __name__ == "__main__":
   absltest.main()
@@ -37,6 +37,8 @@ class LshTreeNode():
     coreset_param: Clustering params used for constructing this node.
     sim_hash: LSH used for generating the hashes.
     private_count: Private count of the points in nonprivate_points.
+    nonprivate_codes: Full hash codes of nonprivate_points computed by
+      sim_hash.hash_codes, or None if they are hashed with NumPy.
     private_average: Private average of the points in nonprivate_points if
       get_private_average has been called in the past, otherwise None.
   """
@@ -45,6 +47,7 @@ class LshTreeNode():
   coreset_param: coreset_params.CoresetParam
   sim_hash: lsh.SimHash
   private_count: typing.Optional[int] = None
+  nonprivate_codes: typing.Optional[lsh.HashCodes] = None
   private_average: typing.Optional[np.ndarray] = dataclasses.field(
       init=False, default=None)
 
@@ -83,13 +86,33 @@ class LshTreeNode():
     more hash character. Note that children are returned regardless of
     self.coreset_param.tree_param.
     """
-    next_hash_char_to_points = self.sim_hash.group_by_next_hash(
-        self.nonprivate_points, hash_prefix=self.hash_prefix)
+    if self.nonprivate_codes is None:
+      next_hash_char_to_points_and_codes = {
+          next_hash_char: (points, None)
+          for next_hash_char, points in self.sim_hash.group_by_next_hash(
+              self.nonprivate_points, hash_prefix=self.hash_prefix).items()
+      }
+    else:
+      next_hash_char_to_points_and_codes = (
+          self.sim_hash.group_codes_by_next_hash(
+              self.nonprivate_points,
+              self.nonprivate_codes,
+              hash_prefix=self.hash_prefix))
+    nonprivate_counts = [
+        len(points) for points, _ in next_hash_char_to_points_and_codes.values()
+    ]
+    private_counts = central_privacy_utils.get_private_counts(
+        nonprivate_counts, self.coreset_param.pcalc.count_privacy_param)
     return [
-        LshTreeNode(self.hash_prefix + next_hash_char,
-                    nonprivate_points_with_hash_char, self.coreset_param,
-                    self.sim_hash) for next_hash_char,
-        nonprivate_points_with_hash_char in next_hash_char_to_points.items()
+        LshTreeNode(
+            self.hash_prefix + next_hash_char,
+            points,
+            self.coreset_param,
+            self.sim_hash,
+            private_count=private_count,
+            nonprivate_codes=codes)
+        for (next_hash_char, (points, codes)), private_count in zip(
+            next_hash_char_to_points_and_codes.items(), private_counts)
     ]
 
   def __repr__(self) -> str:
@@ -120,7 +143,34 @@ def root_node(data: clustering_params.Data,
   """
   sim_hash = lsh.SimHash(data.dim, coreset_param.tree_param.max_depth)
   return LshTreeNode(
-      "", data.datapoints, coreset_param, sim_hash, private_count=private_count)
+      "",
+      data.datapoints,
+      coreset_param,
+      sim_hash,
+      private_count=private_count,
+      nonprivate_codes=sim_hash.hash_codes(data.datapoints))
+
+
+def get_private_averages(nodes: typing.Sequence[LshTreeNode]
+                        ) -> typing.List[np.ndarray]:
+  """Returns and saves the private averages of the points in the nodes.
+
+  Same as calling get_private_average on every node, except that the averages
+  that have not been computed yet are computed together.
+
+  Args:
+    nodes: Nodes with private_count >= 1.
+  """
+  missing = [node for node in nodes if node.private_average is None]
+  if missing:
+    private_averages = central_privacy_utils.get_private_averages(
+        [node.nonprivate_points for node in missing],
+        [node.private_count for node in missing],
+        missing[0].coreset_param.pcalc.average_privacy_param,
+        missing[0].sim_hash.dim)
+    for node, private_average in zip(missing, private_averages):
+      node.private_average = private_average
+  return [node.private_average for node in nodes]
 
 
 class LshTree():
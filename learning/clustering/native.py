@@ -0,0 +1,29 @@
+# Copyright 2021 Google LLC.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Native kernels of the clustering library, if they are available.
+
+clustering_kernel is the module built from cc/learning/clustering/python, or
+None if it is not importable, in which case the library uses NumPy instead.
+"""
+
+import os
+
+try:
+  import clustering_kernel  # pylint: disable=g-import-not-at-top
+except ImportError:
+  clustering_kernel = None
+
+# Number of threads used by the kernels over points. Their results do not depend
+# on it.
+NUM_THREADS = os.cpu_count() or 1
@@ -75,11 +75,20 @@ internal constructor(
   private val computationalGraphFactory: ComputationalGraphFactory = ComputationalGraphFactory(),
 ) {
   companion object Factory {
-    fun create(encoderFactory: EncoderFactory, budgetSpec: DpEngineBudgetSpec) =
+    /**
+     * Creates a [DpEngine]. [noiseFactory] generates the noise of all metrics, e.g.
+     * [com.google.privacy.differentialprivacy.pipelinedp4j.dplibrary.NativeNoiseFactory] draws it
+     * with the C++ library.
+     */
+    fun create(
+      encoderFactory: EncoderFactory,
+      budgetSpec: DpEngineBudgetSpec,
+      noiseFactory: (NoiseKind) -> Noise = NoiseFactory(),
+    ) =
       DpEngine(
         encoderFactory,
         BudgetAccountantFactory.forStrategy(budgetSpec.accountingStrategy, budgetSpec.budget),
-        NoiseFactory(),
+        noiseFactory,
         ComputationalGraphFactory(),
       )
   }
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.google.privacy.differentialprivacy.pipelinedp4j.dplibrary
+
+import com.google.privacy.differentialprivacy.ConfidenceInterval
+import com.google.privacy.differentialprivacy.GaussianNoise
+import com.google.privacy.differentialprivacy.LaplaceNoise
+import com.google.privacy.differentialprivacy.MechanismType
+import com.google.privacy.differentialprivacy.Noise
+import com.google.privacy.differentialprivacy.pipelinedp4j.core.NoiseKind
+import com.google.privacy.differentialprivacy.pipelinedp4j.core.NoiseKind.GAUSSIAN
+import com.google.privacy.differentialprivacy.pipelinedp4j.core.NoiseKind.LAPLACE
+import com.google.privacy.differentialprivacy.pipelinedp4j.dplibrary.NativeAlgorithms.NoiseParams
+import java.io.Serializable
+import java.util.concurrent.ConcurrentHashMap
+
+/**
+ * Native backend that runs noise generation and value accumulation with the C++ library.
+ *
+ * The functions are implemented in `cc/jni` of the differential privacy repository, which builds
+ * `libpipelinedp4j_native.so`. The library is loaded from `java.library.path` when this object is
+ * first used, so it must be available on every worker that runs the combiners. Values are passed
+ * as primitive arrays, so they are never boxed.
+ */
+object NativeAlgorithms {
+  init {
+    System.loadLibrary("pipelinedp4j_native")
+  }
+
+  /** Kind of a native mechanism, must match the constants in `cc/jni`. */
+  private enum class MechanismKind(val id: Int) {
+    LAPLACE(0),
+    GAUSSIAN(1),
+  }
+
+  /** Privacy parameters of a native mechanism. */
+  internal data class NoiseParams(
+    val epsilon: Double,
+    val delta: Double,
+    val l0Sensitivity: Int,
+    val lInfSensitivity: Double,
+  )
+
+  /**
+   * Native mechanisms by their parameters. Pipelines use a handful of parameter sets, so the
+   * mechanisms are created once and kept for the lifetime of the process.
+   */
+  private val mechanisms = ConcurrentHashMap<Pair<MechanismKind, NoiseParams>, Long>()
+
+  /**
+   * Returns the handle of the native mechanism for the given parameters, creating it on first use.
+   *
+   * @throws IllegalArgumentException if the parameters are invalid.
+   */
+  private fun mechanism(noiseKind: NoiseKind, params: NoiseParams): Long {
+    val kind =
+      when (noiseKind) {
+        LAPLACE -> MechanismKind.LAPLACE
+        GAUSSIAN -> MechanismKind.GAUSSIAN
+      }
+    return mechanisms.computeIfAbsent(kind to params) {
+      createMechanism(
+        kind.id,
+        params.epsilon,
+        params.delta,
+        params.l0Sensitivity.toDouble(),
+        params.lInfSensitivity,
+      )
+    }
+  }
+
+  internal fun addNoise(value: Double, noiseKind: NoiseKind, params: NoiseParams): Double =
+    addDoubleNoise(mechanism(noiseKind, params), value)
+
+  internal fun addNoise(value: Long, noiseKind: NoiseKind, params: NoiseParams): Long =
+    addLongNoise(mechanism(noiseKind, params), value)
+
+  internal fun addNoiseInPlace(values: DoubleArray, noiseKind: NoiseKind, params: NoiseParams) {
+    addDoubleNoiseInPlace(values, mechanism(noiseKind, params))
+  }
+
+  internal fun addNoiseInPlace(values: LongArray, noiseKind: NoiseKind, params: NoiseParams) {
+    addLongNoiseInPlace(values, mechanism(noiseKind, params))
+  }
+
+  /**
+   * Computes the accumulators of a bounded sum for many privacy ids at once.
+   *
+   * The contributions of privacy id i are `values[offsets[i]]` to `values[offsets[i + 1] - 1]`.
+   * Returns the sum of the contributions of every privacy id, clamped to [[lower], [upper]].
+   */
+  fun clampedSums(
+    values: DoubleArray,
+    offsets: IntArray,
+    lower: Double,
+    upper: Double,
+  ): DoubleArray {
+    require(offsets.isNotEmpty()) { "offsets must contain at least one element." }
+    require(lower <= upper) { "lower must not be greater than upper." }
+    for (i in 0 until offsets.size - 1) {
+      require(offsets[i] <= offsets[i + 1]) { "offsets must be non-decreasing." }
+    }
+    require(offsets.first() >= 0 && offsets.last() <= values.size) {
+      "offsets must be within the bounds of values."
+    }
+    val sums = DoubleArray(offsets.size - 1)
+    clampedSegmentSums(values, offsets, lower, upper, sums)
+    return sums
+  }
+
+  @JvmStatic
+  private external fun createMechanism(
+    kind: Int,
+    epsilon: Double,
+    delta: Double,
+    l0Sensitivity: Double,
+    lInfSensitivity: Double,
+  ): Long
+
+  @JvmStatic private external fun addDoubleNoise(handle: Long, value: Double): Double
+
+  @JvmStatic private external fun addLongNoise(handle: Long, value: Long): Long
+
+  @JvmStatic private external fun addDoubleNoiseInPlace(values: DoubleArray, handle: Long)
+
+  @JvmStatic private external fun addLongNoiseInPlace(values: LongArray, handle: Long)
+
+  @JvmStatic
+  private external fun clampedSegmentSums(
+    values: DoubleArray,
+    offsets: IntArray,
+    lower: Double,
+    upper: Double,
+    sums: DoubleArray,
+  )
+}
+
+/**
+ * [Noise] that draws the noise with the C++ mechanism of the given [NoiseKind].
+ *
+ * Adding noise to single values has the same semantics as [LaplaceNoise] and [GaussianNoise]. The
+ * batch [addNoise] overloads add noise to all values of an array in a single native call.
+ * Confidence intervals and quantiles are computed by the Java implementation, since they do not
+ * draw noise.
+ */
+class NativeNoise(private val noiseKind: NoiseKind) : Noise, Serializable {
+  private val javaNoise: Noise
+    get() =
+      when (noiseKind) {
+        LAPLACE -> LaplaceNoise()
+        GAUSSIAN -> GaussianNoise()
+      }
+
+  override fun addNoise(
+    x: Double,
+    l0Sensitivity: Int,
+    lInfSensitivity: Double,
+    epsilon: Double,
+    delta: Double,
+  ): Double =
+    NativeAlgorithms.addNoise(
+      x,
+      noiseKind,
+      NoiseParams(epsilon, delta, l0Sensitivity, lInfSensitivity),
+    )
+
+  override fun addNoise(
+    x: Long,
+    l0Sensitivity: Int,
+    lInfSensitivity: Long,
+    epsilon: Double,
+    delta: Double,
+  ): Long =
+    NativeAlgorithms.addNoise(
+      x,
+      noiseKind,
+      NoiseParams(epsilon, delta, l0Sensitivity, lInfSensitivity.toDouble()),
+    )
+
+  /** Adds noise to every element of [values] in place. */
+  fun addNoise(
+    values: DoubleArray,
+    l0Sensitivity: Int,
+    lInfSensitivity: Double,
+    epsilon: Double,
+    delta: Double,
+  ) {
+    NativeAlgorithms.addNoiseInPlace(
+      values,
+      noiseKind,
+      NoiseParams(epsilon, delta, l0Sensitivity, lInfSensitivity),
+    )
+  }
+
+  /** Adds noise to every element of [values] in place. */
+  fun addNoise(
+    values: LongArray,
+    l0Sensitivity: Int,
+    lInfSensitivity: Long,
+    epsilon: Double,
+    delta: Double,
+  ) {
+    NativeAlgorithms.addNoiseInPlace(
+      values,
+      noiseKind,
+      NoiseParams(epsilon, delta, l0Sensitivity, lInfSensitivity.toDouble()),
+    )
+  }
+
+  override fun computeConfidenceInterval(
+    noisedX: Double,
+    l0Sensitivity: Int,
+    lInfSensitivity: Double,
+    epsilon: Double,
+    delta: Double?,
+    alpha: Double,
+  ): ConfidenceInterval =
+    javaNoise.computeConfidenceInterval(
+      noisedX,
+      l0Sensitivity,
+      lInfSensitivity,
+      epsilon,
+      delta,
+      alpha,
+    )
+
+  override fun computeConfidenceInterval(
+    noisedX: Long,
+    l0Sensitivity: Int,
+    lInfSensitivity: Long,
+    epsilon: Double,
+    delta: Double?,
+    alpha: Double,
+  ): ConfidenceInterval =
+    javaNoise.computeConfidenceInterval(
+      noisedX,
+      l0Sensitivity,
+      lInfSensitivity,
+      epsilon,
+      delta,
+      alpha,
+    )
+
+  override fun getMechanismType(): MechanismType = javaNoise.mechanismType
+
+  override fun computeQuantile(
+    rank: Double,
+    x: Double,
+    l0Sensitivity: Int,
+    lInfSensitivity: Double,
+    epsilon: Double,
+    delta: Double?,
+  ): Double = javaNoise.computeQuantile(rank, x, l0Sensitivity, lInfSensitivity, epsilon, delta)
+}
+
+/**
+ * Generates a [NativeNoise] instance with the given [NoiseKind].
+ *
+ * Pass it to [com.google.privacy.differentialprivacy.pipelinedp4j.core.DpEngine.create] to draw
+ * the noise of all metrics with the C++ library.
+ */
+class NativeNoiseFactory : (NoiseKind) -> Noise, Serializable {
+  override fun invoke(noiseKind: NoiseKind): Noise = NativeNoise(noiseKind)
+}